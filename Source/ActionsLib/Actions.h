@@ -44,6 +44,8 @@ template <typename ElemType>
 void DoEdit(const ConfigParameters& config);
 template <typename ElemType>
 void DoBatchNormalizationStat(const ConfigParameters& config);
+template <typename ElemType>
+void DoInt8Calibration(const ConfigParameters& config);
 
 // evaluation (EvalActions.cpp)
 template <typename ElemType>
@@ -62,9 +64,17 @@ template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
 template <typename ElemType>
 void DoTopologyPlot(const ConfigParameters& config);
+template <typename ElemType>
+void DoConvertToBinary(const ConfigParameters& config);
+template <typename ElemType>
+void DoReaderBenchmark(const ConfigParameters& config);
+template <typename ElemType>
+void DoReaderService(const ConfigParameters& config);
 
 // special purpose (SpecialPurposeActions.cpp)
 template <typename ElemType>
 void DoConvertFromDbn(const ConfigParameters& config);
 template<typename ElemType>
 void DoExportToDbn(const ConfigParameters& config);
+template <typename ElemType>
+void DoExportFrozen(const ConfigParameters& config);
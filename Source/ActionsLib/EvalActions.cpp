@@ -258,6 +258,11 @@ void DoWriteOutput(const ConfigParameters& config)
         wstring outputPath = config(L"outputPath");
         WriteFormattingOptions formattingOptions(config);
         bool nodeUnitTest = config(L"nodeUnitTest", "false");
+        wstring outputFormat = config(L"outputFormat", L"text");
+        if (outputFormat != L"text" && outputFormat != L"binary")
+            InvalidArgument("write command: outputFormat must be 'text' or 'binary'");
+        size_t pipelineDepth = config(L"outputPipelineDepth", (size_t)2);
+        writer.SetOutputOptions(outputFormat == L"binary" ? OutputFormat::binary : OutputFormat::text, pipelineDepth);
         writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, formattingOptions, epochSize, nodeUnitTest);
     }
     else
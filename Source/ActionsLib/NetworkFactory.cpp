@@ -98,16 +98,56 @@ bool TryGetNetworkFactory(const ConfigRecordType& config, function<ComputationNe
             (int)deviceId, traceLevel, ElemTypeName<ElemType>(), sourceOfNetwork.c_str());
         let expr = BS::ParseConfigDictFromString(sourceOfBS, L"BrainScriptNetworkBuilder", move(includePaths));
 
+        // Optionally, the constructed network is kept in 'networkCacheDir' under the fingerprint of the parse tree, which covers
+        // the included files and the deviceId and precision injected above, so that later runs with an unchanged network
+        // description read it instead of evaluating the BrainScript. Values read from other files (e.g. Parameter's initFromFilePath)
+        // are not covered; delete the cache when those change.
+        wstring networkCacheDir = config(L"networkCacheDir", L"");
+        wstring cachePath;
+        if (!networkCacheDir.empty())
+            cachePath = msra::strfun::wstrprintf(L"%ls/network.%016llx.v%d.model", networkCacheDir.c_str(), (unsigned long long) expr->Fingerprint(), (int) CURRENT_CNTK_MODEL_VERSION);
+
         // the rest is done in a lambda that is only evaluated when a virgin network is needed
         // Note that evaluating the BrainScript *is* instantiating the network, so the evaluate call must be inside the lambda.
-        createNetworkFn = [expr](DEVICEID_TYPE /*deviceId*/)
+        createNetworkFn = [expr, cachePath, traceLevel](DEVICEID_TYPE deviceId)
         {
+            if (!cachePath.empty() && fexists(cachePath))
+            {
+                fprintf(stderr, "BrainScriptNetworkBuilder: Reading the network from the cache '%ls'.\n", cachePath.c_str());
+                auto network = make_shared<ComputationNetwork>(deviceId);
+                network->SetTraceLevel(traceLevel);
+                network->Read<ElemType>(cachePath);
+                network->CompileNetwork();
+                return network;
+            }
+
             // evaluate the parse tree, particularly the top-level field 'network'
             // Evaluating it will create the network.
             let object = EvaluateField(expr, L"network");                   // this comes back as a BS::Object
             let network = dynamic_pointer_cast<ComputationNetwork>(object); // cast it
             if (!network)
                 LogicError("BuildNetworkFromDescription: ComputationNetwork not what it was meant to be");
+
+            if (!cachePath.empty())
+            {
+                // Each process writes its own file, then moves it into place, as parallel workers all get here.
+                // The cache is an optimization only, failing to write it does not fail the run.
+                let processCachePath = cachePath + msra::strfun::wstrprintf(L".%d", (int) GetCurrentProcessId());
+                try
+                {
+                    msra::files::make_intermediate_dirs(cachePath);
+                    network->Save(processCachePath);
+                    if (fexists(cachePath)) // another worker was first
+                        _wunlink(processCachePath.c_str());
+                    else
+                        renameOrDie(processCachePath, cachePath);
+                    fprintf(stderr, "BrainScriptNetworkBuilder: Saved the network to the cache '%ls'.\n", cachePath.c_str());
+                }
+                catch (const std::exception& e)
+                {
+                    fprintf(stderr, "BrainScriptNetworkBuilder: WARNING: Could not save the network to the cache '%ls': %s\n", cachePath.c_str(), e.what());
+                }
+            }
             return network;
         };
         return true;
@@ -179,6 +219,7 @@ ComputationNetworkPtr GetModelFromConfig(const ConfigRecordType& config, const w
         // By not compiling the network before patching, we avoid double log output for validation.
         net = make_shared<ComputationNetwork>(deviceId);
         net->SetTraceLevel(config(L"traceLevel", 0));
+        net->SetLazyParameterLoading(config(L"lazyParameterLoading", false)); // only read the parameters of the evaluated outputs
         net->Read<ElemType>(modelPath);
         if (outputNodeNames.size() > 0)
             PatchOutputNodes(net, outputNodeNames, outputNodeNamesVector);
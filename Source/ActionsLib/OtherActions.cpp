@@ -14,6 +14,7 @@
 #include "ComputationNetwork.h"
 #include "ComputationNode.h"
 #include "Config.h"
+#include "BestGpu.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
 
@@ -26,6 +27,7 @@
 #include <set>
 #include <memory>
 #include <map>
+#include <thread>
 
 #ifndef let
 #define let const auto
@@ -559,3 +561,210 @@ void DoTopologyPlot(const ConfigParameters& config)
 
 template void DoTopologyPlot<float>(const ConfigParameters& config);
 template void DoTopologyPlot<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoConvertToBinary() - implements CNTK "convert" command
+// Converts the input of a CNTKTextFormatReader section into the format of the CNTKBinaryReader:
+//   convert = [
+//       action = "convert"
+//       reader = [ readerType = "CNTKTextFormatReader" ; file = "train.ctf" ; input = [ ... ] ]
+//       outputFile = "train.bin"
+//       numThreads = 4 # default: number of hardware threads
+//       compression = "deflate" # per-chunk compression, default: "none"
+//   ]
+// ===========================================================================
+
+typedef void (*ConvertToBinaryProc)(const ConfigParameters& readerConfig, const std::wstring& outputFile, size_t numThreads, const std::wstring& compression);
+
+template <typename ElemType>
+void DoConvertToBinary(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    if (!readerConfig.ExistsCurrent(L"precision"))
+        readerConfig.Insert("precision", std::is_same<ElemType, float>::value ? "float" : "double");
+
+    wstring outputFile = config(L"outputFile");
+    size_t numThreads = config(L"numThreads", (size_t)0);
+    if (numThreads == 0)
+        numThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    wstring compression = config(L"compression", L"none");
+
+    wstring readerType = readerConfig(L"readerType", L"CNTKTextFormatReader");
+    if (readerType != L"CNTKTextFormatReader")
+        InvalidArgument("convert: only the CNTKTextFormatReader input can be converted, got '%ls'.", readerType.c_str());
+
+    Plugin plugin;
+    auto convertToBinary = (ConvertToBinaryProc) plugin.Load(readerType, "ConvertToBinary");
+    convertToBinary(readerConfig, outputFile, numThreads, compression);
+}
+
+template void DoConvertToBinary<float>(const ConfigParameters& config);
+template void DoConvertToBinary<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoReaderBenchmark() - implements CNTK "benchmarkReader" command
+// Reads epochs of the reader without a network and reports its throughput and where its time goes:
+//   benchmarkReader = [
+//       action = "benchmarkReader"
+//       reader = [ ... ]                # any reader, as for training
+//       streams = "features:labels"     # default: the features and labels of the reader section
+//       sparseStreams = "labels"        # streams to read into sparse matrices, as sparse inputs of a network would
+//       minibatchSize = 256
+//       epochSize = 0                   # 0: the whole data set
+//       numEpochs = 1
+//       numWorkers = 4                  # > 1: also read as worker 0 of that many, as in distributed training
+//   ]
+// ===========================================================================
+
+// returns the given quantile of sorted values
+static double Quantile(const vector<double>& sortedValues, double quantile)
+{
+    if (sortedValues.empty())
+        return 0;
+    return sortedValues[min((size_t)(quantile * sortedValues.size()), sortedValues.size() - 1)];
+}
+
+template <typename ElemType>
+static void BenchmarkReaderEpoch(DataReader& reader, StreamMinibatchInputs& matrices, const vector<wstring>& streamNames,
+                                 size_t minibatchSize, size_t epoch, size_t numWorkers, size_t epochSize)
+{
+    auto start = std::chrono::steady_clock::now();
+    if (numWorkers > 1)
+        reader.StartDistributedMinibatchLoop(minibatchSize, epoch, 0, numWorkers, matrices.GetStreamDescriptions(), epochSize);
+    else
+        reader.StartMinibatchLoop(minibatchSize, epoch, matrices.GetStreamDescriptions(), epochSize);
+
+    size_t numMinibatches = 0;
+    size_t numSamples = 0;
+    double numBytes = 0;
+    double firstMinibatchSeconds = 0;
+    while (reader.GetMinibatch(matrices))
+    {
+        // the samples are those of the first stream, the bytes those of all streams, as they arrive at the network
+        const auto& firstInput = matrices.GetInput(streamNames[0]);
+        numSamples += firstInput.pMBLayout->GetActualNumSamples();
+        for (const auto& name : streamNames)
+        {
+            const Matrix<ElemType>& matrix = matrices.GetInputMatrix<ElemType>(name);
+            if (matrix.GetMatrixType() == MatrixType::SPARSE)
+                numBytes += matrix.NzCount() * (sizeof(ElemType) + sizeof(CPUSPARSE_INDEX_TYPE)) + (matrix.GetNumCols() + 1) * sizeof(CPUSPARSE_INDEX_TYPE);
+            else
+                numBytes += matrix.GetNumElements() * sizeof(ElemType);
+        }
+        if (numMinibatches++ == 0)
+            firstMinibatchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "BenchmarkReader: epoch %d, worker 0 of %d: %d samples in %d minibatches, %.3f seconds (first minibatch after %.3f seconds): %.1f samples/s, %.2f MB/s\n",
+            (int)epoch + 1, (int)numWorkers, (int)numSamples, (int)numMinibatches, seconds, firstMinibatchSeconds,
+            seconds > 0 ? numSamples / seconds : 0, seconds > 0 ? numBytes / seconds / (1024 * 1024) : 0);
+
+    ReaderProfile profile;
+    if (!reader.GetProfile(profile))
+    {
+        fprintf(stderr, "BenchmarkReader: \tthis reader does not profile its chunk loads, randomizer and packer.\n");
+        return;
+    }
+    auto& chunkLoads = profile.m_chunkLoadSeconds;
+    sort(chunkLoads.begin(), chunkLoads.end());
+    fprintf(stderr, "BenchmarkReader: \t%d chunk loads, milliseconds: min %.2f, median %.2f, 90%% %.2f, 99%% %.2f, max %.2f\n",
+            (int)chunkLoads.size(), 1000 * Quantile(chunkLoads, 0), 1000 * Quantile(chunkLoads, 0.5), 1000 * Quantile(chunkLoads, 0.9),
+            1000 * Quantile(chunkLoads, 0.99), 1000 * Quantile(chunkLoads, 1));
+    fprintf(stderr, "BenchmarkReader: \trandomizer %.3f seconds (%.1f%%), packer %.3f seconds (%.1f%%) of the time\n",
+            profile.m_randomizerSeconds, seconds > 0 ? 100 * profile.m_randomizerSeconds / seconds : 0,
+            profile.m_packerSeconds, seconds > 0 ? 100 * profile.m_packerSeconds / seconds : 0);
+}
+
+template <typename ElemType>
+void DoReaderBenchmark(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    if (!readerConfig.ExistsCurrent(L"precision"))
+        readerConfig.Insert("precision", std::is_same<ElemType, float>::value ? "float" : "double");
+
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    size_t minibatchSize = config(L"minibatchSize", (size_t)256);
+    size_t epochSize = config(L"epochSize", (size_t)0);
+    if (epochSize == 0)
+        epochSize = requestDataSize;
+    size_t numEpochs = config(L"numEpochs", (size_t)1);
+    size_t numWorkers = config(L"numWorkers", (size_t)1);
+
+    vector<wstring> streamNames;
+    ConfigArray streams = config(L"streams", "");
+    for (int i = 0; i < streams.size(); ++i)
+        streamNames.push_back(streams[i]);
+    if (streamNames.empty())
+    {
+        vector<wstring> labelNames;
+        GetFileConfigNames(readerConfig, streamNames, labelNames);
+        streamNames.insert(streamNames.end(), labelNames.begin(), labelNames.end());
+    }
+    if (streamNames.empty())
+        InvalidArgument("benchmarkReader: No streams to read, please specify them with 'streams'.");
+
+    ConfigArray sparseStreamsConfig = config(L"sparseStreams", "");
+    set<wstring> sparseStreams;
+    for (int i = 0; i < sparseStreamsConfig.size(); ++i)
+        sparseStreams.insert(sparseStreamsConfig[i]);
+
+    // each stream gets its own layout, as streams of sequences of different lengths need
+    StreamMinibatchInputs matrices;
+    for (const auto& name : streamNames)
+    {
+        auto matrix = sparseStreams.find(name) != sparseStreams.end() ?
+                      make_shared<Matrix<ElemType>>(0, 0, deviceId, MatrixType::SPARSE, matrixFormatSparseCSC) :
+                      make_shared<Matrix<ElemType>>(deviceId);
+        matrices.AddInput(name, matrix, make_shared<MBLayout>(), TensorShape());
+    }
+
+    DataReader reader(readerConfig);
+    vector<size_t> workerCounts(1, 1);
+    if (numWorkers > 1)
+    {
+        if (reader.SupportsDistributedMBRead())
+            workerCounts.push_back(numWorkers);
+        else
+            fprintf(stderr, "BenchmarkReader: this reader does not support distributed reading, reading as a single worker only.\n");
+    }
+
+    size_t epoch = 0;
+    for (size_t workers : workerCounts)
+        for (size_t i = 0; i < numEpochs; i++)
+            BenchmarkReaderEpoch<ElemType>(reader, matrices, streamNames, minibatchSize, epoch++, workers, epochSize);
+}
+
+template void DoReaderBenchmark<float>(const ConfigParameters& config);
+template void DoReaderBenchmark<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoReaderService() - implements CNTK "readerService" command
+// Runs the reader shared by the training processes of this host until they are done, i.e. started
+// as a separate process on each host next to the training processes:
+//   readerService = [
+//       action = "readerService"
+//       reader = [ ... ]                # the reader of the training processes, with sharedReaderService = "<name>"
+//       numConsumers = 8                # the number of training processes of the host
+//       ringSizeMB = 256                # shared memory per training process
+//       timeout = 300                   # seconds
+//   ]
+// Only the composite reader (deserializers) can be shared, see SharedReader.h of the CompositeDataReader.
+// ===========================================================================
+
+template <typename ElemType>
+void DoReaderService(const ConfigParameters& config)
+{
+    ConfigParameters serviceConfig(config);
+    if (!serviceConfig.ExistsCurrent(L"precision"))
+        serviceConfig.Insert("precision", std::is_same<ElemType, float>::value ? "float" : "double");
+
+    typedef void (*RunSharedReaderServiceProc)(const ConfigParameters* config);
+    ConfigParameters readerConfig(config(L"reader"));
+    Plugin plugin;
+    auto runService = (RunSharedReaderServiceProc)plugin.Load(readerConfig(L"readerType", L"CompositeDataReader"), "RunSharedReaderService");
+    runService(&serviceConfig);
+}
+
+template void DoReaderService<float>(const ConfigParameters& config);
+template void DoReaderService<double>(const ConfigParameters& config);
@@ -69,7 +69,25 @@ void DoExportToDbn(const ConfigParameters& config)
     net->SaveToDbnFile<ElemType>(net, dbnModelPath);
 }
 
+// ===========================================================================
+// DoExportFrozen() - implements CNTK "exportFrozen" command
+// ===========================================================================
+
+// writes the model as a frozen model, which the evaluation loads without deserializing the parameters
+template <typename ElemType>
+void DoExportFrozen(const ConfigParameters& config)
+{
+    vector<wstring> outputNodeNamesVector;
+    ComputationNetworkPtr net = GetModelFromConfig<ConfigParameters, ElemType>(config, L"outputNodeNames", outputNodeNamesVector);
+
+    wstring frozenModelPath = config("frozenModelPath");
+    net->SaveFrozen<ElemType>(frozenModelPath);
+    fprintf(stderr, "Frozen model written to %ls.\n", frozenModelPath.c_str());
+}
+
 template void DoConvertFromDbn<float>(const ConfigParameters& config);
 template void DoConvertFromDbn<double>(const ConfigParameters& config);
 template void DoExportToDbn<float>(const ConfigParameters& config);
 template void DoExportToDbn<double>(const ConfigParameters& config);
+template void DoExportFrozen<float>(const ConfigParameters& config);
+template void DoExportFrozen<double>(const ConfigParameters& config);
@@ -67,6 +67,16 @@ shared_ptr<C> CreateObject(const ConfigParameters& config, const wchar_t* id)
     return make_shared<C>(readerConfig);                           // old CNTK config specifies a dictionary which then must be explicitly instantiated
 }
 
+// text of the reader configuration, to tell data sets apart in caches; BrainScript records have no such text
+static wstring ReaderConfigDescription(const ConfigParameters& config)
+{
+    return config.Exists(L"reader") ? msra::strfun::utf16(string(config(L"reader"))) : wstring();
+}
+static wstring ReaderConfigDescription(const ScriptableObjects::IConfigRecord&)
+{
+    return wstring();
+}
+
 template <class ConfigRecordType, typename ElemType>
 void DoTrain(const ConfigRecordType& config)
 {
@@ -116,6 +126,7 @@ void DoTrain(const ConfigRecordType& config)
         cvDataReader = CreateObject<DataReader>(config, L"cvReader");
 
     optimizer->InitMPI(MPIWrapper::GetInstance());
+    optimizer->SetReaderConfigDescription(ReaderConfigDescription(config));
     optimizer->Train(net, deviceId, dataReader.get(), cvDataReader.get(), startEpoch, loadNetworkFromCheckpoint);
 }
 
@@ -303,3 +314,40 @@ void DoBatchNormalizationStat(const ConfigParameters& config)
 template void DoBatchNormalizationStat<double>(const ConfigParameters& config);
 template void DoBatchNormalizationStat<float>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoInt8Calibration() - implements CNTK "int8calibration" command
+// Records the input ranges of Times and Convolution for int8 inference on the CPU and saves the model.
+// ===========================================================================
+
+template <typename ElemType>
+void DoInt8Calibration(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("traceLevel", config(L"traceLevel", "0"));
+
+    auto dataReader = make_shared<DataReader>(readerConfig);
+
+    int traceLevel = config(L"traceLevel", "0");
+    size_t numMinibatches = config(L"numMinibatches", (size_t)10);
+
+    ConfigArray minibatchSize = config(L"minibatchSize", "256");
+    intargvector mbSize = minibatchSize;
+
+    wstring curModelPath = config(L"modelPath", L"");
+    wstring newModelPath = config(L"newModelPath", L"");
+    if (newModelPath == L"")
+    {
+        newModelPath = curModelPath + L".int8";
+    }
+
+    std::vector<std::wstring> evalNodeNames;
+    let net = GetModelFromConfig<ConfigParameters, ElemType>(config, L"evalNodeNames", evalNodeNames);
+
+    PostComputingActions<ElemType> postComputingActions(net, MPIWrapper::GetInstance(), false, traceLevel);
+
+    postComputingActions.Int8Calibration(dataReader.get(), evalNodeNames, newModelPath, mbSize[0], numMinibatches);
+}
+
+template void DoInt8Calibration<double>(const ConfigParameters& config);
+template void DoInt8Calibration<float>(const ConfigParameters& config);
+
@@ -150,7 +150,7 @@ static const ConfigurableRuntimeType *FindRuntimeTypeInfo(const wstring &typeId)
 // name lookup
 // -----------------------------------------------------------------------
 
-static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &scope, wstring exprPath, const wstring &exprId); // forward declare
+static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &scope, const wstring &parentExprPath, const wstring &exprId); // forward declare
 
 // look up a member by id in the search scope
 // If it is not found, it tries all lexically enclosing scopes inside out. This is handled by the ConfigRecord itself.
@@ -202,13 +202,16 @@ typedef function<ConfigValuePtr(const ExpressionPtr &e, ConfigValuePtr leftVal,
 struct InfixOps
 {
     wstring prettyName;    // pretty-printable name of this op, e.g. "Plus" for +
+    wstring leftArgName;   // expression names of the operands, e.g. "PlusArgs[0]"
+    wstring rightArgName;
     InfixOp NumbersOp;     // number OP number -> number
     InfixOp StringsOp;     // string OP string -> string
     InfixOp BoolOp;        // bool OP bool -> bool
     InfixOp ComputeNodeOp; // one operand is ComputeNode -> ComputeNode
     InfixOp OtherOp;       // other OP other
     InfixOps(const wchar_t *name, InfixOp NumbersOp, InfixOp StringsOp, InfixOp BoolOp, InfixOp ComputeNodeOp, InfixOp OtherOp)
-        : prettyName(name), NumbersOp(NumbersOp), StringsOp(StringsOp), BoolOp(BoolOp), ComputeNodeOp(ComputeNodeOp), OtherOp(OtherOp)
+        : prettyName(name), leftArgName(prettyName + L"Args[0]"), rightArgName(prettyName + L"Args[1]"),
+          NumbersOp(NumbersOp), StringsOp(StringsOp), BoolOp(BoolOp), ComputeNodeOp(ComputeNodeOp), OtherOp(OtherOp)
     {
     }
 };
@@ -517,6 +520,65 @@ static map<wstring, InfixOps> infixOps =
     { L"<<",   InfixOps(L"Shift",        BadOp,    BadOp,    BoolOp, NodeOp,       OtherOp) }
 };
 
+// -----------------------------------------------------------------------
+// interned operations
+// -----------------------------------------------------------------------
+
+// Evaluate() dispatches on the 'op' of an expression. Upon its first evaluation, that string is interned into Expression::opCode,
+// so that the many later evaluations of the same expression (e.g. the body of a macro) neither compare strings nor look up infixOps[].
+enum class OpCode : int
+{
+    doubleLiteral, stringLiteral, boolLiteral, newObject, conditional, lambda, apply, record, identifier, member,
+    arrayConcat, arrayFromLambda, arrayIndex, unaryPlusMinus, unaryNot,
+    infix // infix operators follow, in the order of infixOps[]
+};
+
+static const vector<const InfixOps *> &InfixOpsByCode()
+{
+    static const vector<const InfixOps *> infixOpsByCode = []()
+    {
+        vector<const InfixOps *> ops;
+        for (let &op : infixOps)
+            ops.push_back(&op.second);
+        return ops;
+    }();
+    return infixOpsByCode;
+}
+
+static int InternedOpCode(const Expression &e)
+{
+    if (e.opCode < 0)
+    {
+        static const map<wstring, OpCode> opCodes =
+        {
+            { L"d", OpCode::doubleLiteral }, { L"s", OpCode::stringLiteral }, { L"b", OpCode::boolLiteral }, { L"new", OpCode::newObject },
+            { L"if", OpCode::conditional }, { L"=>", OpCode::lambda }, { L"(", OpCode::apply }, { L"{", OpCode::apply }, { L"[]", OpCode::record },
+            { L"id", OpCode::identifier }, { L".", OpCode::member }, { L":", OpCode::arrayConcat }, { L"array", OpCode::arrayFromLambda },
+            { L"[", OpCode::arrayIndex }, { L"+(", OpCode::unaryPlusMinus }, { L"-(", OpCode::unaryPlusMinus }, { L"!(", OpCode::unaryNot }
+        };
+        let iter = opCodes.find(e.op);
+        if (iter != opCodes.end())
+            e.opCode = (int) iter->second;
+        else
+        {
+            let opIter = infixOps.find(e.op);
+            if (opIter == infixOps.end())
+                LogicError("e->op '%ls' not implemented", e.op.c_str());
+            e.opCode = (int) OpCode::infix + (int) distance(infixOps.begin(), opIter);
+        }
+    }
+    return e.opCode;
+}
+
+// the value of a literal, which all evaluations of it share (values are immutable)
+template <typename T>
+static ConfigValuePtr LiteralValue(const ExpressionPtr &e, const T &val, const wstring &exprPath)
+{
+    if (!e->literal)
+        e->literal = MakePrimitiveConfigValuePtr(val, MakeFailFn(e->location), L"");
+    return ConfigValuePtr(e->literal, MakeFailFn(e->location), exprPath);
+}
+
 // -----------------------------------------------------------------------
 // thunked (delayed) evaluation
 // -----------------------------------------------------------------------
@@ -551,26 +613,38 @@ static ConfigValuePtr MakeEvaluateThunkPtr(const ExpressionPtr &expr, const ICon
 //  - not all nodes get their own path, in particular nodes with only one child, e.g. "-x", that would not be useful to address
 // Note that returned values may include complex value types like dictionaries (ConfigRecord) and functions (ConfigLambda).
 // TODO: This implementation takes a lot of stack space. Should break into many sub-functions.
-static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &scope, wstring exprPath, const wstring &exprId)
+static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &scope, const wstring &parentExprPath, const wstring &exprId)
 {
     try // catch clause for this will catch error, inject this tree node's TextLocation, and rethrow
     {
         // expression names
-        // Merge exprPath and exprId into one unless one is empty
-        if (!exprPath.empty() && !exprId.empty())
-            exprPath.append(L".");
-        exprPath.append(exprId);
+        // Merge exprPath and exprId into one unless one is empty (in which case no copy is made)
+        wstring mergedExprPath;
+        if (!exprId.empty())
+        {
+            mergedExprPath.reserve(parentExprPath.size() + 1 + exprId.size());
+            mergedExprPath = parentExprPath;
+            if (!mergedExprPath.empty())
+                mergedExprPath.append(L".");
+            mergedExprPath.append(exprId);
+        }
+        const wstring &exprPath = exprId.empty() ? parentExprPath : mergedExprPath;
         // tracing
         if (trace)
             TextLocation::Trace(e->location, msra::strfun::wstrprintf(L"eval SP=0x%p", &exprPath).c_str(), e->op.c_str(), exprPath.c_str());
+        let opCode = InternedOpCode(*e);
         // --- literals
-        if (e->op == L"d")
-            return MakePrimitiveConfigValuePtr(e->d, MakeFailFn(e->location), exprPath); // === double literal
-        else if (e->op == L"s")
-            return ConfigValuePtr(make_shared<String>(e->s), MakeFailFn(e->location), exprPath); // === string literal
-        else if (e->op == L"b")
-            return MakePrimitiveConfigValuePtr(e->b, MakeFailFn(e->location), exprPath); // === bool literal
-        else if (e->op == L"new")                                                        // === 'new' expression: instantiate C++ runtime object right here
+        if (opCode == (int) OpCode::doubleLiteral)
+            return LiteralValue(e, e->d, exprPath); // === double literal
+        else if (opCode == (int) OpCode::stringLiteral)
+        {
+            if (!e->literal)                        // === string literal
+                e->literal = make_shared<String>(e->s);
+            return ConfigValuePtr(e->literal, MakeFailFn(e->location), exprPath);
+        }
+        else if (opCode == (int) OpCode::boolLiteral)
+            return LiteralValue(e, e->b, exprPath); // === bool literal
+        else if (opCode == (int) OpCode::newObject) // === 'new' expression: instantiate C++ runtime object right here
         {
             // find the constructor lambda
             let rtInfo = FindRuntimeTypeInfo(e->id);
@@ -586,7 +660,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
                 valueWithName->SetName(value.GetExpressionName());
             return value; // we return the created but not initialized object as the value, so others can reference it
         }
-        else if (e->op == L"if") // === conditional expression
+        else if (opCode == (int) OpCode::conditional) // === conditional expression
         {
             let argValPtr = Evaluate(e->args[0], scope, exprPath, L"if");
             if (argValPtr.Is<ComputationNodeObject>()) // if ComputationNode becomes If(c,t,e)
@@ -601,7 +675,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
                 return Evaluate(e->args[2], scope, exprPath, L"");
         }
         // --- functions
-        else if (e->op == L"=>") // === lambda (all macros are stored as lambdas)
+        else if (opCode == (int) OpCode::lambda) // === lambda (all macros are stored as lambdas)
         {
             // on scope: The lambda expression remembers the lexical scope of the '=>'; this is how it captures its context.
             let &argListExpr = e->args[0]; // [0] = argument list ("()" expression of identifiers, possibly optional args)
@@ -677,7 +751,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
             }
             return ConfigValuePtr(make_shared<ConfigLambda>(move(paramNames), move(namedParams), f), MakeFailFn(e->location), exprPath);
         }
-        else if (e->op == L"(" || e->op == L"{") // === apply a function to its arguments
+        else if (opCode == (int) OpCode::apply) // === apply a function to its arguments ("(" or "{")
         {
             // Note: "{" is experimental and currently ignored as a distinction. To do it more completely, we need
             //  - remember how a function was declared (currently not possible for lambdas)
@@ -730,7 +804,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
             return lambda->Apply(move(argVals), move(namedArgVals), exprPath);
         }
         // --- variable access
-        else if (e->op == L"[]") // === record (-> ConfigRecord)
+        else if (opCode == (int) OpCode::record) // === record (-> ConfigRecord)
         {
             let newScope = make_shared<ConfigRecord>(scope, MakeFailFn(e->location)); // new scope: inside this record, all symbols from above are also visible
             // ^^ The failfn here will be used if C++ code uses operator[] to retrieve a value. It will report the text location where the record was defined.
@@ -750,15 +824,15 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
             // BUGBUG: wrong text location passed in. Should be the one of the identifier, not the RHS. NamedArgs store no location for their identifier.
             return ConfigValuePtr(newScope, MakeFailFn(e->location), exprPath);
         }
-        else if (e->op == L"id")
+        else if (opCode == (int) OpCode::identifier)
             return ResolveIdentifier(e->id, e->location, scope); // === variable/macro access within current scope
-        else if (e->op == L".")                                  // === variable/macro access in given ConfigRecord element
+        else if (opCode == (int) OpCode::member)                 // === variable/macro access in given ConfigRecord element
         {
             let &recordExpr = e->args[0];
             return RecordLookup(recordExpr, e->id, e->location, scope /*for evaluating recordExpr*/, exprPath);
         }
         // --- arrays
-        else if (e->op == L":") // === array expression (-> ConfigArray)
+        else if (opCode == (int) OpCode::arrayConcat) // === array expression (-> ConfigArray)
         {
             // this returns a flattened list of all members as a ConfigArray type
             let arr = make_shared<ConfigArray>();       // note: we could speed this up by keeping the left arg and appending to it
@@ -769,7 +843,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
             }
             return ConfigValuePtr(arr, MakeFailFn(e->location), exprPath); // location will be that of the first ':', not sure if that is best way
         }
-        else if (e->op == L"array") // === array constructor from lambda function
+        else if (opCode == (int) OpCode::arrayFromLambda) // === array constructor from lambda function
         {
             let &firstIndexExpr = e->args[0]; // first index
             let &lastIndexExpr = e->args[1];  // last index
@@ -806,7 +880,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
             auto arr = make_shared<ConfigArray>(firstIndex, move(elementThunks));
             return ConfigValuePtr(arr, MakeFailFn(e->location), exprPath);
         }
-        else if (e->op == L"[") // === access array element by index
+        else if (opCode == (int) OpCode::arrayIndex) // === access array element by index
         {
             let arrValue = Evaluate(e->args[0], scope, exprPath, L"_vector");
             let &indexExpr = e->args[1];
@@ -815,7 +889,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
             return arr->At(index, MakeFailFn(indexExpr->location)); // note: the array element may be as of now unresolved; this resolved it
         }
         // --- unary operators '+' '-' and '!'
-        else if (e->op == L"+(" || e->op == L"-(") // === unary operators + and -
+        else if (opCode == (int) OpCode::unaryPlusMinus) // === unary operators + and -
         {
             let argValPtr = Evaluate(e->args[0], scope, exprPath, e->op == L"+(" ? L"" : L"_negate");
             // note on exprPath: since - has only one argument, we do not include it in the expressionPath  --TODO: comment correct?
@@ -832,7 +906,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
             else
                 Fail(L"operator '" + e->op.substr(0, 1) + L"' cannot be applied to this operand (which has type " + msra::strfun::utf16(argValPtr.TypeName()) + L")", e->location);
         }
-        else if (e->op == L"!(") // === unary operator !
+        else if (opCode == (int) OpCode::unaryNot) // === unary operator !
         {
             let argValPtr = Evaluate(e->args[0], scope, exprPath, L"_not");
             // note on exprPath: since ! has only one argument, we do not include it in the expressionPath  --TODO: comment correct?
@@ -844,15 +918,12 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
         // --- regular infix operators such as '+' and '=='
         else
         {
-            let opIter = infixOps.find(e->op);
-            if (opIter == infixOps.end())
-                LogicError("e->op '%ls' not implemented", e->op.c_str());
-            let &functions = opIter->second;
+            let &functions = *InfixOpsByCode()[opCode - (int) OpCode::infix];
             let &leftArg = e->args[0];
             let &rightArg = e->args[1];
 #if 1
-            let leftValPtr  = Evaluate(leftArg,  scope, exprPath, functions.prettyName + L"Args[0]");
-            let rightValPtr = Evaluate(rightArg, scope, exprPath, functions.prettyName + L"Args[1]");
+            let leftValPtr  = Evaluate(leftArg,  scope, exprPath, functions.leftArgName);
+            let rightValPtr = Evaluate(rightArg, scope, exprPath, functions.rightArgName);
 #else       // This does not actually work.  --TODO: find out why
             // In the special case of >>, we evaluate the right arg first, as to mimic the same behavior
             // as writing the functions as a direct nested evaluation.
@@ -609,6 +609,44 @@ void Expression::DumpToStream(wstringstream & treeStream, int indent)
     treeStream << std::endl;
 }
 
+// FNV-1a hash over op, identifiers, literals, and the hashes of the arguments
+uint64_t Expression::Fingerprint() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto combine = [&hash](const void* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ ((const unsigned char*) data)[i]) * 1099511628211ULL;
+    };
+    auto combineString = [&](const wstring& str)
+    {
+        uint64_t length = str.size();
+        combine(&length, sizeof(length));
+        for (uint32_t ch : str) // (wchar_t differs in size across platforms)
+            combine(&ch, sizeof(ch));
+    };
+    combineString(op);
+    combineString(id);
+    combineString(s);
+    combine(&d, sizeof(d));
+    unsigned char bval = b;
+    combine(&bval, sizeof(bval));
+    uint64_t numArgs = args.size();
+    combine(&numArgs, sizeof(numArgs));
+    for (const auto& arg : args)
+    {
+        uint64_t argHash = arg ? arg->Fingerprint() : 0;
+        combine(&argHash, sizeof(argHash));
+    }
+    for (const auto& namedArg : namedArgs) // (ordered by name)
+    {
+        combineString(namedArg.first);
+        uint64_t argHash = namedArg.second.second ? namedArg.second.second->Fingerprint() : 0;
+        combine(&argHash, sizeof(argHash));
+    }
+    return hash;
+}
+
 class Parser : public Lexer
 {
     // errors
@@ -109,32 +109,37 @@ struct Expression
     vector<ExpressionPtr> args;                                // position-dependent expression/function args
     map<wstring, pair<TextLocation, ExpressionPtr>> namedArgs; // named expression/function args; also dictionary members (loc is of the identifier)
     TextLocation location;                                     // where in the source code (for downstream error reporting)
+    // cached by the evaluator upon first evaluation
+    mutable int opCode;                                        // 'op' interned (-1 if not yet)
+    mutable shared_ptr<ScriptableObjects::Object> literal;     // value of a literal, shared by all its evaluations
     // constructors
     Expression(TextLocation location)
-        : location(location), d(0.0), b(false)
+        : location(location), d(0.0), b(false), opCode(-1)
     {
     }
     Expression(TextLocation location, wstring op)
-        : location(location), d(0.0), b(false), op(op)
+        : location(location), d(0.0), b(false), op(op), opCode(-1)
     {
     }
     Expression(TextLocation location, wstring op, double d, wstring s, bool b)
-        : location(location), d(d), s(s), b(b), op(op)
+        : location(location), d(d), s(s), b(b), op(op), opCode(-1)
     {
     }
     Expression(TextLocation location, wstring op, ExpressionPtr arg)
-        : location(location), d(0.0), b(false), op(op)
+        : location(location), d(0.0), b(false), op(op), opCode(-1)
     {
         args.push_back(arg);
     }
     Expression(TextLocation location, wstring op, ExpressionPtr arg1, ExpressionPtr arg2)
-        : location(location), d(0.0), b(false), op(op)
+        : location(location), d(0.0), b(false), op(op), opCode(-1)
     {
         args.push_back(arg1);
         args.push_back(arg2);
     }
     // diagnostics helper: print the content
     void DumpToStream(wstringstream & treeStream, int indent = 0);
+    // hash of the content of the tree (not its source locations), e.g. to tell whether a config has changed
+    uint64_t Fingerprint() const;
 };
 typedef Expression::ExpressionPtr ExpressionPtr; // circumvent some circular definition problem
 
@@ -25,6 +25,7 @@
 #include "CPUMatrix.h" // used for SetNumThreads()
 #include "GPUMatrix.h" // used for SyncGuard::EnableSync()
 #include "CommonMatrix.h"
+#include "ConvolutionEngine.h" // used for ConvolutionAlgorithmCache
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "Config.h"
@@ -179,6 +180,11 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
         {
             LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
         }
+
+        // Pinning the CPU threads ('numa' or 'compact'), by default they are scheduled by the OS.
+        ThreadAffinity cpuThreadAffinity = ParseThreadAffinity(config(L"cpuThreadAffinity", L"none"));
+        if (cpuThreadAffinity != ThreadAffinity::None)
+            CPUMatrix<ElemType>::SetThreadAffinity(cpuThreadAffinity);
     }
 
     bool progressTracing = config(L"progressTracing", false);
@@ -275,6 +281,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoBatchNormalizationStat<ElemType>(commandParams);
                 }
+                else if (thisAction == "int8calibration")
+                {
+                    DoInt8Calibration<ElemType>(commandParams);
+                }
                 else if (thisAction == "adapt")
                 {
                     DoAdapt<ElemType>(commandParams);
@@ -311,6 +321,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoExportToDbn<ElemType>(commandParams);
                 }
+                else if (thisAction == "exportFrozen")
+                {
+                    DoExportFrozen<ElemType>(commandParams);
+                }
                 else if (thisAction == "createLabelMap")
                 {
                     DoCreateLabelMap<ElemType>(commandParams);
@@ -319,6 +333,18 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoWriteWordAndClassInfo<ElemType>(commandParams);
                 }
+                else if (thisAction == "convert")
+                {
+                    DoConvertToBinary<ElemType>(commandParams);
+                }
+                else if (thisAction == "benchmarkReader")
+                {
+                    DoReaderBenchmark<ElemType>(commandParams);
+                }
+                else if (thisAction == "readerService")
+                {
+                    DoReaderService<ElemType>(commandParams);
+                }
                 else if (thisAction == "plot")
                 {
                     DoTopologyPlot<ElemType>(commandParams);
@@ -521,9 +547,16 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     if (config(L"forceDeterministicAlgorithms", false))
         Globals::ForceDeterministicAlgorithms();
+    if (config(L"deterministicReductions", false))
+        DeterministicReductions::Enable(true);
     if (config(L"forceConstantRandomSeed", false))
         Globals::ForceConstantRandomSeed();
 
+    // algorithms selected by the cuDNN auto-tuner are kept in this file across runs
+    wstring convolutionAlgorithmCacheFile = config(L"convolutionAlgorithmCacheFile", L"");
+    if (!convolutionAlgorithmCacheFile.empty())
+        ConvolutionAlgorithmCache::Instance().SetFile(convolutionAlgorithmCacheFile);
+
 #ifndef CPUONLY
     auto valpp = config.Find(L"deviceId");
     if (valpp)
@@ -567,8 +600,23 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         Globals::EnableHyperCompressMemory();
     if (config(L"optimizeGradientAccumulation", true))
         Globals::EnableGradientAccumulationOptimization();
+    if (!config(L"fuseElementwiseOps", true))
+        Globals::DisableElementwiseFusion();
+    if (!config(L"aliasNodeValues", true))
+        Globals::DisableValueAliasing();
+    if (!config(L"computeInPlace", true))
+        Globals::DisableInPlaceComputation();
+    if (config(L"fuseDropout", false))
+        Globals::EnableFusedDropout();
+    if (config(L"checkNonFiniteValues", false))
+        Globals::EnableNonFiniteValueChecks();
+    if (config(L"optimizeNetworkGraph", false))
+        Globals::EnableGraphOptimization();
+    int numConcurrentStreams = config(L"numConcurrentStreams", 1);
+    Globals::SetNumConcurrentStreams(numConcurrentStreams);
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    TracingGPUMemoryAllocator::SetCachingEnabled(config(L"cacheGPUMemoryAllocations", false));
 
     bool synchronizeCUDAKernelExecutions = config(L"synchronizeCUDAKernelExecutions", false);
     if (synchronizeCUDAKernelExecutions)
@@ -599,6 +647,10 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         numCPUThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numCPUThreads);
         if (numCPUThreads > 0)
             LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
+
+        ThreadAffinity cpuThreadAffinity = ParseThreadAffinity(config(L"cpuThreadAffinity", L"none"));
+        if (cpuThreadAffinity != ThreadAffinity::None)
+            CPUMatrix<float /*any will do*/>::SetThreadAffinity(cpuThreadAffinity);
     }
 
     bool progressTracing = config(L"progressTracing", false);
@@ -685,9 +737,16 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
 
     if (config(L"forceDeterministicAlgorithms", false))
         Globals::ForceDeterministicAlgorithms();
+    if (config(L"deterministicReductions", false))
+        DeterministicReductions::Enable(true);
     if (config(L"forceConstantRandomSeed", false))
         Globals::ForceConstantRandomSeed();
 
+    // algorithms selected by the cuDNN auto-tuner are kept in this file across runs
+    wstring convolutionAlgorithmCacheFile = config(L"convolutionAlgorithmCacheFile", L"");
+    if (!convolutionAlgorithmCacheFile.empty())
+        ConvolutionAlgorithmCache::Instance().SetFile(convolutionAlgorithmCacheFile);
+
     // get the command param set they want
     wstring logpath = config(L"stderr", L"");
 
@@ -714,8 +773,23 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
         Globals::EnableHyperCompressMemory();
     if (config(L"optimizeGradientAccumulation", true))
         Globals::EnableGradientAccumulationOptimization();
+    if (!config(L"fuseElementwiseOps", true))
+        Globals::DisableElementwiseFusion();
+    if (!config(L"aliasNodeValues", true))
+        Globals::DisableValueAliasing();
+    if (!config(L"computeInPlace", true))
+        Globals::DisableInPlaceComputation();
+    if (config(L"fuseDropout", false))
+        Globals::EnableFusedDropout();
+    if (config(L"checkNonFiniteValues", false))
+        Globals::EnableNonFiniteValueChecks();
+    if (config(L"optimizeNetworkGraph", false))
+        Globals::EnableGraphOptimization();
+    int numConcurrentStreams = config(L"numConcurrentStreams", "1");
+    Globals::SetNumConcurrentStreams(numConcurrentStreams);
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    TracingGPUMemoryAllocator::SetCachingEnabled(config(L"cacheGPUMemoryAllocations", false));
 
     if (logpath != L"")
     {
@@ -353,6 +353,7 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
         {
             node->SetInput(inputNum, nodeFrom[0]);
         }
+        netNdlTo->cn->InvalidateCompiledNetwork(nodeTo);
     }
     else if (EqualInsensitive(name, "SetNodeInputs", "SetInputs"))
     {
@@ -386,6 +387,7 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
         }
 
         nodeTo[0]->AttachInputs(inputNodes);
+        netNdlTo->cn->InvalidateCompiledNetwork(nodeTo);
     }
     else if (EqualInsensitive(name, "SetProperty"))
     {
@@ -389,6 +389,30 @@ namespace CNTK
 
     static const unsigned long SentinelValueForAutoSelectRandomSeed = std::numeric_limits<unsigned long>::max() - 2; // An arbitrary choice of sentinel value
 
+    ///
+    /// The completion of a copy queued by NDArrayView::CopyFromAsync() or NDArrayView::DeepCloneAsync().
+    ///
+    class NDArrayViewCopyEvent final
+    {
+        friend class NDArrayView;
+
+        template <typename T, typename ...CtorArgTypes>
+        friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+    public:
+        ///
+        /// Blocks the calling thread until the copy has completed.
+        ///
+        CNTK_API void Wait() const;
+
+        CNTK_API ~NDArrayViewCopyEvent();
+
+    private:
+        NDArrayViewCopyEvent(const DeviceDescriptor& device);
+
+        std::unique_ptr<Microsoft::MSR::CNTK::MatrixComputeStreamEvent> m_event; // recorded on the destination device after the copy
+    };
+
     ///
     /// Denotes a multi-dimensional writable or read-only array of elemental values.
     /// This type denotes a view and there may be multiple simultaneous views of the data underlying a NDArrayView instance.
@@ -405,6 +429,8 @@ namespace CNTK
         friend class PackedValue;
         friend class MPICommunicatorImpl;
         friend class BlockMomentumDistributedLearner;
+        friend class SparseDataParallelDistributedLearner;
+        friend class Trainer;
         friend class Internal::VariableResolver;
 
         template <typename T, typename ...CtorArgTypes>
@@ -590,6 +616,12 @@ namespace CNTK
         ///
         CNTK_API NDArrayViewPtr DeepClone(const DeviceDescriptor& device, bool readOnly = false) const;
 
+        ///
+        /// Asynchronous variant of DeepClone(device, readOnly): the new view can be used right away on its device, the copy is
+        /// queued as with CopyFromAsync(), and 'copyEvent' tells when it has completed.
+        ///
+        CNTK_API NDArrayViewPtr DeepCloneAsync(const DeviceDescriptor& device, NDArrayViewCopyEventPtr& copyEvent, bool readOnly = false) const;
+
         ///
         /// Creates a new NDArrayView with newly allocated storage on the same device as 'this' view and copies 'this' view's contents into the newly allocated view.
         ///
@@ -617,6 +649,14 @@ namespace CNTK
         ///
         CNTK_API void CopyFrom(const NDArrayView& source);
 
+        ///
+        /// Asynchronous variant of CopyFrom(): queues the copy behind the pending work on the devices of both views and returns
+        /// without waiting for it. Work later queued on the device of 'this' view sees the copied contents; the returned event
+        /// tells the host when the copy has completed. Views on different GPUs are copied directly where the devices have peer
+        /// access, and staged through page-locked host memory by the driver otherwise. Copies from or to the CPU complete on return.
+        ///
+        CNTK_API NDArrayViewCopyEventPtr CopyFromAsync(const NDArrayView& source);
+
         ///
         /// Change the device of 'this' NDArrayView to the specified device
         ///
@@ -860,6 +900,47 @@ namespace CNTK
             return Create<ElementType>(vocabularySize, oneHotSequences, {}, device, readOnly);
         }
 
+        ///
+        /// Create a new Value object containing a collection of variable length sequences stored back to back in the dense 'packedData' buffer,
+        /// where sequence i holds 'sequenceLengths[i]' samples of shape 'sampleShape'.
+        /// When all sequences have the same length the buffer already has the layout of the Value, and a Value on the CPU wraps it without a copy;
+        /// the buffer must then outlive the Value. Otherwise the sequences are padded into newly allocated storage.
+        /// For a GPU 'device' the data is uploaded asynchronously and the upload is waited for when the Value's data is first accessed;
+        /// the buffer must stay valid until then. Uploads from page-locked buffers fully overlap with the caller's work.
+        ///
+        template <typename ElementType>
+        CNTK_API static ValuePtr CreateFromPackedBuffer(const NDShape& sampleShape, ElementType* packedData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly = false);
+
+        ///
+        /// Create a new Value object containing a collection of variable length sequences stored back to back in the dense 'packedData' buffer.
+        /// See above for the ownership of 'packedData'.
+        ///
+        template <typename ElementType>
+        static ValuePtr CreateFromPackedBuffer(const NDShape& sampleShape, ElementType* packedData, const std::vector<size_t>& sequenceLengths, const DeviceDescriptor& device, bool readOnly = false)
+        {
+            return CreateFromPackedBuffer(sampleShape, packedData, sequenceLengths, {}, device, readOnly);
+        }
+
+        ///
+        /// Create a new Value object containing a collection of variable length sequences stored back to back in sparse CSC format, one column per sample:
+        /// 'colStarts' has an entry for each sample of all the sequences plus a final entry 'numNonZeroValues', and 'rowIndices' and 'nonZeroValues'
+        /// hold 'numNonZeroValues' entries each. The leading axis of 'sampleShape' must span the whole sample.
+        /// The row indices and non-zero values are never repacked; only the column starts are rebuilt when the sequences have to be padded.
+        /// For a GPU 'device' the data is uploaded asynchronously as for dense buffers; on the CPU it is copied into the Value's sparse storage.
+        ///
+        template <typename ElementType>
+        CNTK_API static ValuePtr CreateFromPackedBuffer(const NDShape& sampleShape, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const ElementType* nonZeroValues, size_t numNonZeroValues, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly = false);
+
+        ///
+        /// Create a new Value object containing a collection of variable length sequences stored back to back in sparse CSC format.
+        /// See above for the layout of the buffers.
+        ///
+        template <typename ElementType>
+        static ValuePtr CreateFromPackedBuffer(const NDShape& sampleShape, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const ElementType* nonZeroValues, size_t numNonZeroValues, const std::vector<size_t>& sequenceLengths, const DeviceDescriptor& device, bool readOnly = false)
+        {
+            return CreateFromPackedBuffer(sampleShape, colStarts, rowIndices, nonZeroValues, numNonZeroValues, sequenceLengths, {}, device, readOnly);
+        }
+
         ///
         /// Destruct 'this' Value object.
         ///
@@ -940,6 +1021,24 @@ namespace CNTK
         ///
         virtual void CopyFrom(const Value& source);
 
+        ///
+        /// Copies the valid samples of 'this' Value, with samples of shape 'sampleShape', to the caller's dense 'packedData' buffer, the sequences
+        /// back to back without any padding, and the length of each sequence to 'sequenceLengths'; this is the layout taken by CreateFromPackedBuffer.
+        /// 'packedDataCapacity' is the size of 'packedData' in elements and 'sequenceLengthsCapacity' the number of entries of 'sequenceLengths',
+        /// which must be at least the number of sequences, the dimensionality of the last axis of Shape() if it has two axes beyond 'sampleShape'.
+        /// The gaps are removed on the device and the data is copied to the host in one transfer; nothing is allocated on the host.
+        /// Returns the number of samples written. Only dense Values are supported.
+        ///
+        template <typename ElementType>
+        CNTK_API size_t CopyToPackedBuffer(const NDShape& sampleShape, ElementType* packedData, size_t packedDataCapacity, size_t* sequenceLengths, size_t sequenceLengthsCapacity) const;
+
+        ///
+        /// Copies the valid samples of 'this' Value to 'packedData', the sequences back to back, and their lengths to 'sequenceLengths'.
+        /// Both vectors are resized to fit; reusing them across calls avoids reallocating their storage.
+        ///
+        template <typename ElementType>
+        CNTK_API void CopyToPackedBuffer(const NDShape& sampleShape, std::vector<ElementType>& packedData, std::vector<size_t>& sequenceLengths) const;
+
     private:
         template <typename ElementType>
         static void AppendSparseSequenceData(const NDArrayViewPtr& sequenceData, std::vector<SparseIndexType>& colStarts, std::vector<SparseIndexType>& rowIndices, std::vector<char>& nonZeroValues, size_t maxSequenceLength);
@@ -3019,6 +3118,44 @@ namespace CNTK
     ///
     CNTK_API FunctionPtr Alias(const Variable& operand, const std::wstring& name = L"");
 
+    ///
+    /// Native implementation of a user-defined operation, see NativeUserFunction(). Unlike a user-defined Function subclass,
+    /// a kernel works directly on NDArrayViews that alias the network's input, output and gradient buffers, so invoking it allocates nothing.
+    /// Each view has the sample shape followed by one axis over all samples of the minibatch in the engine's packed layout (none if the
+    /// operand has no dynamic axes); the values of gap samples are undefined. Only dense operands are supported.
+    ///
+    class NativeUserFunctionKernel
+    {
+    public:
+        ///
+        /// Called before Forward() whenever the shapes of the inputs differ from those of the previous call (i.e. at least once per
+        /// minibatch size), to let the kernel precompute launch parameters, workspaces etc. for these shapes.
+        ///
+        virtual void Specialize(const std::vector<NDShape>& /*inputShapes*/, const NDShape& /*outputShape*/, const DeviceDescriptor& /*device*/) {}
+
+        ///
+        /// Computes 'output' from 'inputs'. 'computeStream' is the CUDA stream (cudaStream_t) the engine computes on, or null on the CPU;
+        /// work queued on it is ordered with the rest of the computation.
+        ///
+        virtual void Forward(const std::vector<NDArrayViewPtr>& inputs, const NDArrayViewPtr& output, void* computeStream) = 0;
+
+        ///
+        /// Adds the gradient w.r.t. inputs[inputIndex] to 'inputGradient' (which must not be overwritten), given the gradient w.r.t. 'output'.
+        ///
+        virtual void Backward(size_t inputIndex, const std::vector<NDArrayViewPtr>& inputs, const NDArrayViewPtr& output,
+                              const NDArrayViewPtr& outputGradient, const NDArrayViewPtr& inputGradient, void* computeStream) = 0;
+
+        virtual ~NativeUserFunctionKernel() {}
+    };
+
+    typedef std::shared_ptr<NativeUserFunctionKernel> NativeUserFunctionKernelPtr;
+
+    ///
+    /// Create a Function that computes an output of the specified sample shape from the specified 'inputs' with a native 'kernel'.
+    /// The output has the dynamic axes of the inputs, all of which must have the same dynamic axes (or none).
+    ///
+    CNTK_API FunctionPtr NativeUserFunction(const std::vector<Variable>& inputs, const NDShape& outputShape, const NativeUserFunctionKernelPtr& kernel, const std::wstring& name = L"");
+
     namespace Sequence
     {
         CNTK_API FunctionPtr IsFirst(const Variable& operand, const std::wstring& name = L"");
@@ -3229,6 +3366,15 @@ namespace CNTK
 #endif
         double gradientClippingThresholdPerSample = std::numeric_limits<double>::infinity();
         bool gradientClippingWithTruncation = true;
+        // with block-sparse gradients (e.g. of embeddings of sparse input), the momentum SGD, Nesterov and FSAdaGrad learners
+        // update only the columns present in the gradient, catching up on the skipped updates when a column is next touched
+        bool lazySparseUpdate = false;
+        // decoupled weight decay of the Adam learner with lowMemory == false (AdamW), per sample; the parameters shrink by learning rate * decoupledWeightDecay.
+        // The LAMB learner adds it to its step before the trust ratio.
+        double decoupledWeightDecay = 0.0;
+        // keep an exponential moving average of each parameter (Polyak averaging), updated after each update with this decay; 0 for none.
+        // Learner::SwapExponentialMovingAverages() exchanges the averages with the parameter values, e.g. to evaluate or save the averaged model.
+        double exponentialMovingAverageDecay = 0.0;
     };
 
     ///
@@ -3283,6 +3429,12 @@ namespace CNTK
         ///
         virtual void ResetSmoothedGradients() = 0;
 
+        ///
+        /// Exchanges the values of the parameters with their exponential moving averages, if the learner keeps them
+        /// (AdditionalLearningOptions::exponentialMovingAverageDecay); a second call swaps them back.
+        ///
+        virtual void SwapExponentialMovingAverages() {}
+
         ///
         /// Returns current learning rate.
         ///
@@ -3354,7 +3506,8 @@ namespace CNTK
     static MomentumSchedule DefaultVarianceMomentum = MomentumAsTimeConstantSchedule(2 * 3600 * 100);
 
     ///
-    /// Create an instance of the CNTK built-in Adam learner (only the low-memory variant is supported at the moment).
+    /// Create an instance of the CNTK built-in Adam learner. The low-memory variant is FSAdaGrad; otherwise Adam with bias
+    /// correction is used, which also applies additionalOptions.decoupledWeightDecay (AdamW).
     ///
     CNTK_API LearnerPtr AdamLearner(const std::vector<Parameter>& parameters,
                                     const LearningRateSchedule& learningRateSchedule,
@@ -3363,6 +3516,24 @@ namespace CNTK
                                     bool lowMemory = true,
                                     AdditionalLearningOptions additionalOptions = AdditionalLearningOptions());
 
+    ///
+    /// Create an instance of the CNTK built-in LARS learner, momentum SGD with layer-wise adaptive learning rates for large minibatches.
+    ///
+    CNTK_API LearnerPtr LARSLearner(const std::vector<Parameter>& parameters,
+                                    const LearningRateSchedule& learningRateSchedule,
+                                    const MomentumSchedule& momentumSchedule,
+                                    double trustCoefficient = 0.001,
+                                    AdditionalLearningOptions additionalOptions = AdditionalLearningOptions());
+
+    ///
+    /// Create an instance of the CNTK built-in LAMB learner, Adam with layer-wise adaptive learning rates for large minibatches.
+    ///
+    CNTK_API LearnerPtr LAMBLearner(const std::vector<Parameter>& parameters,
+                                    const LearningRateSchedule& learningRateSchedule,
+                                    const MomentumSchedule& momentumSchedule,
+                                    const MomentumSchedule& varianceMomentumSchedule = DefaultVarianceMomentum,
+                                    AdditionalLearningOptions additionalOptions = AdditionalLearningOptions());
+
     ///
     /// Create an instance of the CNTK built-in AdaGrad learner.
     ///
@@ -3419,6 +3590,11 @@ namespace CNTK
             m_learner->ResetSmoothedGradients();
         }
 
+        void SwapExponentialMovingAverages() override
+        {
+            m_learner->SwapExponentialMovingAverages();
+        }
+
         //
         // Method to update the parameters associated with this learner. By returning false, this method indicates that
         // learning has stopped for all of the parameters associated with this learner
@@ -3450,6 +3626,12 @@ namespace CNTK
 
     CNTK_API DistributedLearnerPtr CreateQuantizedDataParallelDistributedLearner(QuantizedDistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributeAfterSamples, bool useAsyncBufferedParameterUpdate = false);
 
+    ///
+    /// Data parallel learner with top-k sparsification of the gradients: each worker sends only the fraction 'density' of
+    /// the entries of each gradient with the largest magnitude and keeps the others as a residual added to its next gradient.
+    ///
+    CNTK_API DistributedLearnerPtr CreateSparseDataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, double density, size_t distributeAfterSamples, bool useAsyncBufferedParameterUpdate = false);
+
     CNTK_API DistributedLearnerPtr CreateBlockMomentumDistributedLearner(
         DistributedCommunicatorPtr communicator,
         LearnerPtr learner,
@@ -3469,6 +3651,52 @@ namespace CNTK
         bool resetSGDMomentumAfterAggregation = true,
         double blockLearningRate = 1.0);
 
+    ///
+    /// The training loss and evaluation criterion of one minibatch trained with Trainer::TrainMinibatchAsync().
+    /// They are kept on the compute device until first read; reading them waits for the device to finish that
+    /// minibatch (and whatever was queued before it), but not the minibatches submitted after it.
+    ///
+    class MinibatchMetricsFuture final
+    {
+        friend class Trainer;
+
+        template <typename T, typename ...CtorArgTypes>
+        friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+    public:
+        ///
+        /// Returns false if all parameter learners indicated end of learning for this minibatch (like Trainer::TrainMinibatch()).
+        ///
+        bool ContinueTraining() const { return m_continueTraining; }
+
+        ///
+        /// Returns the number of samples in the minibatch (known without waiting for the device).
+        ///
+        size_t SampleCount() const { return m_numSamples; }
+
+        ///
+        /// Returns the average training loss per sample of the minibatch, waiting for it to be computed if needed.
+        ///
+        CNTK_API double LossAverage() const;
+
+        ///
+        /// Returns the average evaluation criterion value per sample of the minibatch, waiting for it to be computed if needed.
+        ///
+        CNTK_API double EvaluationAverage() const;
+
+    private:
+        MinibatchMetricsFuture(bool continueTraining, size_t numSamples, const NDArrayViewPtr& aggregateTrainingLoss, const NDArrayViewPtr& aggregateEvalCriterion, bool hasEvaluationFunction)
+            : m_continueTraining(continueTraining), m_numSamples(numSamples),
+              m_aggregateTrainingLoss(aggregateTrainingLoss), m_aggregateEvalCriterion(aggregateEvalCriterion), m_hasEvaluationFunction(hasEvaluationFunction)
+        {}
+
+        bool m_continueTraining;
+        size_t m_numSamples;
+        NDArrayViewPtr m_aggregateTrainingLoss;  // summed over the minibatch, still on the compute device
+        NDArrayViewPtr m_aggregateEvalCriterion;
+        bool m_hasEvaluationFunction;
+    };
+
     ///
     /// Trainer is the top-level abstraction responsible for the orchestration of the training of a model
     /// using the specified learners and training data either explicitly supplied as Value objects or from
@@ -3506,6 +3734,15 @@ namespace CNTK
         ///
         CNTK_API bool TrainMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice = DeviceDescriptor::UseDefaultDevice());
 
+        ///
+        /// Asynchronous variant of TrainMinibatch(): queues the forward/backward pass and the parameter update on the compute device and
+        /// returns without waiting for them, so that the caller can submit the next minibatch right away. The loss and evaluation criterion
+        /// are returned as a future that only synchronizes with the device when read, so reading them every N minibatches does not stall
+        /// the pipeline (whereas PreviousMinibatchLossAverage() after every TrainMinibatch() does). Dynamic loss scaling and distributed
+        /// learners still synchronize once per minibatch, since their decisions depend on the gradients.
+        ///
+        CNTK_API MinibatchMetricsFuturePtr TrainMinibatchAsync(const std::unordered_map<Variable, ValuePtr>& arguments, const DeviceDescriptor& computeDevice = DeviceDescriptor::UseDefaultDevice());
+
         ///
         /// Test the model on the specified batch of samples using the evaluation Function specified during construction of the Trainer
         /// Returns the average evaluation criterion value per sample for the tested minibatch of samples
@@ -3562,6 +3799,33 @@ namespace CNTK
         ///
         CNTK_API size_t TotalNumberOfSamplesSeen() const;
 
+        ///
+        /// Enables loss scaling for training with reduced precision arithmetic: the gradient of the loss is scaled by the loss scale
+        /// before backpropagation and the parameter gradients are divided by it before the update. With 'dynamic' loss scaling,
+        /// a minibatch with non-finite gradients is skipped and the scale is halved, and the scale is doubled after 'window'
+        /// consecutive minibatches with finite gradients. Dynamic loss scaling is not supported with distributed learners.
+        ///
+        CNTK_API void SetLossScaling(double initialScale, bool dynamic = false, size_t window = 2000);
+
+        ///
+        /// Current loss scale (1 if loss scaling is not enabled).
+        ///
+        CNTK_API double LossScale() const;
+
+        ///
+        /// Enables gradient accumulation: the gradients of 'numMicroBatches' consecutive calls to TrainMinibatch are summed in place
+        /// into persistent buffers, and the distributed aggregation and the learner update run only on the last of them, as for one
+        /// minibatch of all their samples. The other calls return true without updating the model. With distributed learners, all
+        /// workers must make the same number of calls; calls with an empty minibatch count as micro-batches without samples.
+        /// Micro-batches accumulated since the last update are not part of a checkpoint. 1 (the default) disables accumulation.
+        ///
+        CNTK_API void SetGradientAccumulation(size_t numMicroBatches);
+
+        ///
+        /// Number of micro-batches whose gradients are accumulated for one update (see SetGradientAccumulation()).
+        ///
+        size_t GradientAccumulationMicroBatches() const { return m_numAccumulationMicroBatches; }
+
     private:
         void ExecuteForwardBackward(
             const std::unordered_map<Variable, ValuePtr>& arguments,
@@ -3571,9 +3835,15 @@ namespace CNTK
 
         bool TrainLocalMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice);
         bool TrainDistributedMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice);
+        bool TrainAccumulatedMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice);
+        bool UpdateFromAccumulatedGradients(bool atEndOfData);
+        static void AccumulateInto(NDArrayViewPtr& target, const NDArrayViewPtr& source, bool assign);
 
         void Save(const std::wstring& modelFilePath, const std::vector<DictionaryValue>& learnerState, const Dictionary& externalState);
 
+        // Divides the gradients by the loss scale; returns false if the minibatch is to be skipped because of non-finite gradients.
+        bool UnscaleGradients(std::unordered_map<Parameter, NDArrayViewPtr>& gradients);
+
         FunctionPtr m_combinedTrainingFunction;
         FunctionPtr m_model;
         FunctionPtr m_lossFunction;
@@ -3585,10 +3855,19 @@ namespace CNTK
         LearnersPtr m_parameterLearners;
         bool        m_distributed;
         ValuePtr    m_rootGradientValue;
+        std::shared_ptr<Microsoft::MSR::CNTK::LossScaling> m_lossScaling;
 
         size_t   m_prevMinibatchNumSamples;
         ValuePtr m_prevMinibatchAggregateTrainingLossValue;
         ValuePtr m_prevMinibatchAggregateEvalCriterionValue;
+
+        // gradient accumulation over micro-batches, see SetGradientAccumulation()
+        size_t m_numAccumulationMicroBatches;
+        size_t m_numAccumulatedMicroBatches;
+        size_t m_accumulatedNumSamples;
+        std::unordered_map<Parameter, NDArrayViewPtr> m_accumulatedGradients;
+        NDArrayViewPtr m_accumulatedTrainingLoss;
+        NDArrayViewPtr m_accumulatedEvalCriterion;
     };
 
     ///
@@ -3710,6 +3989,10 @@ namespace CNTK
 
     ///
     /// Instantiate the CNTK built-in composite minibatch source.
+    /// With 'numParallelReaders' > 1 in the configuration, the source runs that many independent reader pipelines,
+    /// each reading a disjoint subset of the data of this worker, and returns their minibatches in turn; with
+    /// 'deterministicParallelReaders' set the pipelines are visited strictly round robin, otherwise a pipeline
+    /// with a minibatch ready is preferred.
     ///
     CNTK_API MinibatchSourcePtr CreateCompositeMinibatchSource(const Dictionary& configuration);
 
@@ -3773,6 +4056,18 @@ namespace CNTK
         std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndVariances,
         const DeviceDescriptor& device = DeviceDescriptor::CPUDevice());
 
+    ///
+    /// Same as above, but stops after 'maxNumSamples' samples and returns the number of samples the statistics are based on.
+    /// If the minibatchSource is distributed (create it with distributedAfterSampleCount = 0), each MPI worker reads and accumulates
+    /// its own share of the data on 'device', and the statistics of all workers are merged at the end; all workers must make this call then.
+    /// For N independent samples, the means are within +/-1.96/sqrt(N) standard deviations of the true ones, and the standard deviations
+    /// within a relative +/-1.96/sqrt(2(N-1)), with 95% confidence.
+    ///
+    CNTK_API size_t ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
+        std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndVariances,
+        size_t maxNumSamples,
+        const DeviceDescriptor& device = DeviceDescriptor::CPUDevice());
+
     ///
     /// Set the process-wide setting for maximum number of CPU threads to be used by any individual compute operation
     /// Note that this is a per compute operation limit and if the user performs multiple compute operations concurrently
@@ -3786,6 +4081,15 @@ namespace CNTK
     ///
     CNTK_API size_t GetMaxNumCPUThreads();
 
+    ///
+    /// Returns a snapshot of the process-wide performance counters of training: totals of samples, minibatches, time spent
+    /// waiting for the reader and for gradient communication (microseconds), bytes communicated, the smoothed throughput
+    /// ("samplesPerSecond"), the time since the last minibatch ("secondsSinceLastMinibatch", < 0 before the first one),
+    /// the memory of the GPU allocator cache per device ("deviceMemory", keyed by device id), and the forward and backward
+    /// time of each node in sampled minibatches ("nodes", keyed by node name; with nodeTimingInterval in BrainScript).
+    ///
+    CNTK_API Dictionary GetPerformanceCounters();
+
     struct DistributedWorkerDescriptor
     {
         size_t m_globalRank;
@@ -57,6 +57,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     class ComputationNodeBase;
     typedef std::shared_ptr<ComputationNodeBase> ComputationNodeBasePtr;
+
+    class LossScaling;
+
+    class MatrixComputeStreamEvent;
 }}}
 
 // TODO: The following should be reconciled with the equivalent code in the CNTK implementation
@@ -204,6 +208,12 @@ namespace CNTK
     class DistributedLearner;
     typedef std::shared_ptr<DistributedLearner> DistributedLearnerPtr;
 
+    class MinibatchMetricsFuture;
+    typedef std::shared_ptr<MinibatchMetricsFuture> MinibatchMetricsFuturePtr;
+
+    class NDArrayViewCopyEvent;
+    typedef std::shared_ptr<NDArrayViewCopyEvent> NDArrayViewCopyEventPtr;
+
     namespace Internal
     {
         CNTK_API FunctionPtr IsWithin(const Variable& operand, int offset, const std::wstring& name = L"");
@@ -245,6 +255,15 @@ namespace CNTK
         CNTK_API void ForceDeterministicAlgorithms();
         CNTK_API bool ShouldForceDeterministicAlgorithms();
 
+        // Bitwise reproducible training on the GPU at close to full speed (off by default): the fastest deterministic cuDNN
+        // algorithms of the auto-tuner, and fixed-order accumulation in scatter (e.g. gather gradients) and in sparse gradients.
+        // Unlike ForceDeterministicAlgorithms(), it keeps max pooling, the CPU threads, and algorithms with workspace.
+        CNTK_API void EnableDeterministicReductions();
+        CNTK_API void DisableDeterministicReductions();
+
+        // Keeps the convolution algorithms selected by the cuDNN auto-tuner in the given file across runs.
+        CNTK_API void SetConvolutionAlgorithmCacheFile(const std::wstring& path);
+
         CNTK_API void SetFixedRandomSeed(unsigned long fixedRandomSeed);
 
         CNTK_API void EnableForwardValuesSharing();
@@ -253,6 +272,52 @@ namespace CNTK
         CNTK_API void EnableGradientAccumulationOptimization();
         CNTK_API void DisableGradientAccumulationOptimization();
 
+        // Fusion of chains of element-wise operations that need no gradient into single GPU kernels (on by default).
+        CNTK_API void EnableElementwiseFusion();
+        CNTK_API void DisableElementwiseFusion();
+
+        // Replay of inference forward passes (Function::Evaluate) of a previously seen input shape as CUDA graphs (off by default).
+        // Needs a GPU and CUDA 10.1 or later; inputs with masks, recurrences, and nodes that synchronize with the host are evaluated normally.
+        CNTK_API void EnableCudaGraphs();
+        CNTK_API void DisableCudaGraphs();
+
+        // Number of CUDA streams that the GPU work of independent nodes in forward passes is spread over (default 1).
+        CNTK_API void SetNumConcurrentStreams(size_t numStreams);
+
+        // Gradient checkpointing for training (off by default): activations are released after the forward pass and recomputed
+        // segment by segment, with about sqrt(N) segments, during the backward pass. Takes effect for networks set up afterwards.
+        CNTK_API void EnableActivationRecomputation();
+        CNTK_API void DisableActivationRecomputation();
+
+        // Activation offloading for training on GPU (off by default): activations that the backward pass needs are copied to
+        // pinned host memory during the forward pass and back ahead of their use, overlapped with the computation.
+        // Takes effect for networks set up afterwards.
+        CNTK_API void EnableActivationOffloading();
+        CNTK_API void DisableActivationOffloading();
+
+        // Dropout that keeps no mask (off by default): the mask is drawn from a counter-based generator in the forward pass
+        // and regenerated in the backward pass. The masks differ from those of the default dropout for the same seed.
+        CNTK_API void EnableFusedDropout();
+        CNTK_API void DisableFusedDropout();
+
+        // Single precision GEMMs on the GPU with half precision inputs and single precision accumulation (Tensor Cores).
+        CNTK_API void EnableMixedPrecisionGemm(bool enable);
+
+        // Save models and trainer checkpoints in the segmented format (off by default): the graph in a protobuf message,
+        // and the tensors in separate aligned segments, deflated with 'compressTensors' (requires zlib). Files whose tensors
+        // exceed what a single protobuf message can hold are always saved this way. Loading detects either format.
+        CNTK_API void EnableSegmentedModelFormat(bool compressTensors = false);
+        CNTK_API void DisableSegmentedModelFormat();
+        bool IsSegmentedModelFormatEnabled();
+        bool ShouldCompressModelTensors();
+
+        // Number of compiled networks a composite Function keeps besides the one in use (default 4), so that Forward calls that
+        // alternate between sets of requested outputs or backprop roots do not rebuild the network. Each keeps its own activations.
+        // With 'perArgumentShape', the shapes of the arguments are part of the key as well, which suits inputs bucketed into a few shapes.
+        CNTK_API void SetComputationNetworkCacheSize(size_t numNetworks, bool perArgumentShape = false);
+        size_t GetComputationNetworkCacheSize();
+        bool IsComputationNetworkCachedPerArgumentShape();
+
         CNTK_API bool AreEquivalent(const ::CNTK::FunctionPtr& f1, const ::CNTK::FunctionPtr& f2);
         CNTK_API bool AreEquivalent(const ::CNTK::Variable& v1, const ::CNTK::Variable& v2, bool allowParameterAndConstantsEquivalence = false);
 
@@ -132,7 +132,7 @@ namespace CNTK
                     opType = PrimitiveOpType::Cos;
                 else if (node->OperationName() == OperationNameOf(SinNode))
                     opType = PrimitiveOpType::Sin;
-                else if (node->OperationName() == OperationNameOf(PassNode))
+                else if (node->OperationName() == OperationNameOf(PassNode) || node->OperationName() == OperationNameOf(CrossDeviceCopyNode)) // (a V1 network trained with model parallelism)
                     opType = PrimitiveOpType::Pass;
                 else if (node->OperationName() == OperationNameOf(RectifiedLinearNode))
                     opType = PrimitiveOpType::ReLU;
@@ -327,6 +327,9 @@ namespace CNTK
                         convolutionMapVar = convolutionMapVar.IsConstant() ? Variable(Constant(newConvolutionMapValue, convolutionMapVar.Name(), convolutionMapVar.Uid())) : Variable(Parameter(newConvolutionMapValue, convolutionMapVar.Name(), convolutionMapVar.Uid()));
                     }
 
+                    if (convolutionNode->Groups() > 1)
+                        InvalidArgument("Convolution '%S' is grouped, which is not supported by the V2 library.", node->NodeName().c_str());
+
                     primitiveFunctionConfigParameters[PrimitiveFunction::AttributeNameStrides] = AsNDShape(convolutionNode->Strides());
                     primitiveFunctionConfigParameters[PrimitiveFunction::AttributeNameSharing] = AsDictionaryValueVector(convolutionNode->Sharing());
                     primitiveFunctionConfigParameters[PrimitiveFunction::AttributeNameAutoPadding] = AsDictionaryValueVector(convolutionNode->AutoPad());
@@ -340,6 +343,8 @@ namespace CNTK
                 else if (node->OperationName() == OperationNameOf(ROIPoolingNode))
                 {
                     auto roiPoolingNode = node->As<ROIPoolingNode<ElementType>>();
+                    if (roiPoolingNode->ROIAlign())
+                        LogicError("ROIPooling with roiAlign is not supported when loading legacy CNTK model (node '%S').", node->NodeName().c_str());
                     primitiveFunctionConfigParameters[PrimitiveFunction::AttributeNameROIOutputShape] = AsNDShape(roiPoolingNode->ROIOutputShape());
 
                     opType = PrimitiveOpType::ROIPooling;
@@ -435,6 +440,16 @@ namespace CNTK
 
                 FunctionPtr primitiveFunction = MakeSharedObject<PrimitiveFunction>(opType, inputVars, std::move(primitiveFunctionConfigParameters), functionName, functionUid);
                 m_allPrimitiveFunctions.insert(primitiveFunction);
+
+                // A BatchNormalization node with a fused ReLU (ComputationNetwork::FuseBatchNormalizationAndRelu()) is two Functions here.
+                if (node->Is<BatchNormalizationNode<ElementType>>() && node->As<BatchNormalizationNode<ElementType>>()->FusedRelu())
+                {
+                    std::vector<Variable> reluInputs = { primitiveFunction->Output() };
+                    FunctionPtr reluFunction = MakeSharedObject<PrimitiveFunction>(PrimitiveOpType::ReLU, reluInputs, Dictionary(), functionName);
+                    m_allPrimitiveFunctions.insert(reluFunction);
+                    return reluFunction->Output();
+                }
+
                 return primitiveFunction->Output();
             }
         };
@@ -13,7 +13,10 @@
 #include <CPUMatrix.h> // For CPUMatrix::SetNumThreads
 #include <thread>
 #include "GPUMatrix.h"
+#include "Matrix.h"
+#include "ConvolutionEngine.h"
 #include "Globals.h"
+#include "PerformanceCounters.h"
 
 extern bool g_shareNodeValueMatrices;
 
@@ -80,6 +83,108 @@ namespace CNTK
             Microsoft::MSR::CNTK::Globals::DisableGradientAccumulationOptimization();
         }
 
+        void EnableElementwiseFusion()
+        {
+            Microsoft::MSR::CNTK::Globals::EnableElementwiseFusion();
+        }
+
+        void DisableElementwiseFusion()
+        {
+            Microsoft::MSR::CNTK::Globals::DisableElementwiseFusion();
+        }
+
+        void EnableCudaGraphs()
+        {
+            Microsoft::MSR::CNTK::Globals::EnableCudaGraphs();
+        }
+
+        void DisableCudaGraphs()
+        {
+            Microsoft::MSR::CNTK::Globals::DisableCudaGraphs();
+        }
+
+        void SetNumConcurrentStreams(size_t numStreams)
+        {
+            Microsoft::MSR::CNTK::Globals::SetNumConcurrentStreams(numStreams);
+        }
+
+        void EnableActivationRecomputation()
+        {
+            Microsoft::MSR::CNTK::Globals::EnableActivationRecomputation();
+        }
+
+        void DisableActivationRecomputation()
+        {
+            Microsoft::MSR::CNTK::Globals::DisableActivationRecomputation();
+        }
+
+        void EnableActivationOffloading()
+        {
+            Microsoft::MSR::CNTK::Globals::EnableActivationOffloading();
+        }
+
+        void DisableActivationOffloading()
+        {
+            Microsoft::MSR::CNTK::Globals::DisableActivationOffloading();
+        }
+
+        void EnableFusedDropout()
+        {
+            Microsoft::MSR::CNTK::Globals::EnableFusedDropout();
+        }
+
+        void DisableFusedDropout()
+        {
+            Microsoft::MSR::CNTK::Globals::DisableFusedDropout();
+        }
+
+        void EnableMixedPrecisionGemm(bool enable)
+        {
+            Microsoft::MSR::CNTK::Matrix<float>::UseMixedPrecisionGemm(enable);
+        }
+
+        std::atomic<bool> s_segmentedModelFormat(false);
+        std::atomic<bool> s_compressModelTensors(false);
+        void EnableSegmentedModelFormat(bool compressTensors)
+        {
+            s_compressModelTensors.store(compressTensors);
+            s_segmentedModelFormat.store(true);
+        }
+
+        void DisableSegmentedModelFormat()
+        {
+            s_segmentedModelFormat.store(false);
+            s_compressModelTensors.store(false);
+        }
+
+        bool IsSegmentedModelFormatEnabled()
+        {
+            return s_segmentedModelFormat.load();
+        }
+
+        bool ShouldCompressModelTensors()
+        {
+            return s_compressModelTensors.load();
+        }
+
+        std::atomic<size_t> s_computationNetworkCacheSize(4);
+        std::atomic<bool> s_computationNetworkCachedPerArgumentShape(false);
+        void SetComputationNetworkCacheSize(size_t numNetworks, bool perArgumentShape)
+        {
+            s_computationNetworkCacheSize.store(numNetworks);
+            s_computationNetworkCachedPerArgumentShape.store(perArgumentShape);
+        }
+
+        size_t GetComputationNetworkCacheSize()
+        {
+            return s_computationNetworkCacheSize.load();
+        }
+
+        bool IsComputationNetworkCachedPerArgumentShape()
+        {
+            return s_computationNetworkCachedPerArgumentShape.load();
+        }
+
         bool AreEquivalent(const Variable& var1, const Variable& var2, bool allowParameterAndConstantsEquivalence)
         {
             bool areDynamicAxesCompatible = (var1.DynamicAxes().size() == var2.DynamicAxes().size());
@@ -357,6 +462,21 @@ namespace CNTK
             return Microsoft::MSR::CNTK::Globals::ShouldForceDeterministicAlgorithms();
         }
 
+        void EnableDeterministicReductions()
+        {
+            Microsoft::MSR::CNTK::DeterministicReductions::Enable(true);
+        }
+
+        void DisableDeterministicReductions()
+        {
+            Microsoft::MSR::CNTK::DeterministicReductions::Enable(false);
+        }
+
+        void SetConvolutionAlgorithmCacheFile(const std::wstring& path)
+        {
+            Microsoft::MSR::CNTK::ConvolutionAlgorithmCache::Instance().SetFile(path);
+        }
+
         static std::atomic<bool> s_threadsAreSet(false);
         bool MaxNumCPUThreadsSet()
         {
@@ -517,4 +637,50 @@ namespace CNTK
     {
         return Microsoft::MSR::CNTK::CPUMatrix<float>::GetMaxNumThreads();
     }
+
+    Dictionary GetPerformanceCounters()
+    {
+        using Microsoft::MSR::CNTK::PerformanceCounters;
+        using Microsoft::MSR::CNTK::TracingGPUMemoryAllocator;
+
+        auto snapshot = PerformanceCounters::Instance().TakeSnapshot();
+        Dictionary counters;
+        for (const auto& counter : snapshot.m_counters)
+            counters[ToWString(counter.first)] = (size_t)counter.second;
+        counters[L"samplesPerSecond"] = snapshot.m_samplesPerSecond;
+        counters[L"secondsSinceLastMinibatch"] = snapshot.m_secondsSinceLastMinibatch;
+
+        Dictionary deviceMemory;
+        for (const auto& device : DeviceDescriptor::AllDevices())
+        {
+            if (device.Type() != DeviceKind::GPU)
+                continue;
+            auto statistics = TracingGPUMemoryAllocator::GetCacheStatistics((int)device.Id());
+            Dictionary memory;
+            memory[L"inUseBytes"] = statistics.inUseBytes;
+            memory[L"cachedBytes"] = statistics.cachedBytes;
+            memory[L"peakInUseBytes"] = statistics.peakInUseBytes;
+            memory[L"cacheHits"] = statistics.numHits;
+            memory[L"cacheMisses"] = statistics.numMisses;
+            deviceMemory[std::to_wstring(device.Id())] = memory;
+        }
+        counters[L"deviceMemory"] = deviceMemory;
+
+        Dictionary nodes;
+        for (const auto& node : snapshot.m_nodeTimings)
+        {
+            Dictionary timing;
+            timing[L"forwardSeconds"] = node.second.m_forwardSeconds;
+            timing[L"numForward"] = node.second.m_numForward;
+            timing[L"forwardFlops"] = node.second.m_forwardFlops;
+            timing[L"forwardBytes"] = node.second.m_forwardBytes;
+            timing[L"backwardSeconds"] = node.second.m_backwardSeconds;
+            timing[L"numBackward"] = node.second.m_numBackward;
+            timing[L"backwardFlops"] = node.second.m_backwardFlops;
+            timing[L"backwardBytes"] = node.second.m_backwardBytes;
+            nodes[node.first] = timing;
+        }
+        counters[L"nodes"] = nodes;
+        return counters;
+    }
 }
@@ -20,6 +20,7 @@
 #include "Value.h"
 #include "RNNNodes.h"
 #include "UserDefinedV2FunctionNode.h"
+#include "NativeUserFunction.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -276,6 +277,9 @@ namespace CNTK
 
     void CompositeFunction::UpdateInternalNetworkState()
     {
+        // Only the current network is updated; the others are set up again when needed
+        m_cachedComputationNetworks.clear();
+
         if (!m_computationNetwork)
         {
             return;
@@ -771,6 +775,8 @@ namespace CNTK
                 }
             }
         }
+        else if (auto nativeFunction = dynamic_cast<NativeKernelFunction*>(function))
+            computationNodePtr = New<NativeUserFunctionNode<ElementType>>(network->GetDeviceId(), internalNodeName, nativeFunction->Kernel(), nativeFunction->Output().Shape());
         else
             computationNodePtr = New<UserDefinedV2FunctionNode<ElementType>>(network->GetDeviceId(), internalNodeName, function->shared_from_this());
 
@@ -832,21 +838,24 @@ namespace CNTK
     }
 
     template <typename ElementType>
-    ComputationNetworkPtr CompositeFunction::GetComputationNetwork(const DeviceDescriptor& device, const std::unordered_set<Variable>& backpropRoots, const std::unordered_set<Variable>& outputs, bool allocateNetworkMatrices)
+    ComputationNetworkPtr CompositeFunction::GetComputationNetwork(const DeviceDescriptor& device, const std::unordered_set<Variable>& backpropRoots, const std::unordered_set<Variable>& outputs, bool allocateNetworkMatrices, const std::unordered_map<Variable, NDShape>& argumentShapes/* = {}*/)
     {
+        std::unordered_map<Variable, ComputationNodeBasePtr> previousVariableToNodeMap;
         if (m_computationNetwork != nullptr)
         {
-            // TODO: We should either invalidate and readapt the network if he backpropRoots change compared to what was specified when the network
-            // was last constructed, to just recreate a new network.
-            // For now just disallow changing the backpropRoots after the network is created
-            if (!backpropRoots.empty() && (m_currentBackpropRoots != backpropRoots))
-                LogicError("Changing backprop roots across different Forward calls on a CNTK composite Function is currently unsupported");
-
             // TODO: Support changing the device across different invocations of the forward method on a Function instance
             if (AsDeviceDescriptor(m_computationNetwork->GetDeviceId()) != device)
                 LogicError("Changing device across different Forward calls on a CNTK composite Function is currently unsupported");
+
+            // A network set up for other backprop roots, outputs or argument shapes is swapped for a cached or a new one
+            if (!CanComputationNetworkBeUsedFor(m_currentBackpropRoots, m_currentOutputs, m_networkMatricesAllocated, m_currentArgumentShapes, backpropRoots, outputs, argumentShapes))
+            {
+                previousVariableToNodeMap = m_variableToNodeMap;
+                SwitchComputationNetwork(backpropRoots, outputs, argumentShapes);
+            }
         }
-        else
+
+        if (m_computationNetwork == nullptr)
         {
             m_computationNetwork = std::make_shared<ComputationNetwork>(AsCNTKImplDeviceId(device));
 
@@ -888,6 +897,7 @@ namespace CNTK
             }
 
             m_currentBackpropRoots = backpropRoots;
+            m_currentArgumentShapes = argumentShapes;
 
             // In case of recurrence, the inputs of some of the ComputationNodes are not attached due to cycles.
             // Now attach those after we have created all ComputationNodes in the network
@@ -943,6 +953,9 @@ namespace CNTK
                 m_lastRecordedParameterValueTimeStamps.insert({ parameter, parameter.CurrentValueTimeStamp() });
         }
 
+        if (!previousVariableToNodeMap.empty())
+            CopyRngStateFrom(previousVariableToNodeMap);
+
 
         if (!m_networkMatricesAllocated && allocateNetworkMatrices)
         {
@@ -978,18 +991,84 @@ namespace CNTK
             m_currentOutputs.insert(rootFunctionOutputs.begin(), rootFunctionOutputs.end());
             m_currentOutputs.insert(m_currentBackpropRoots.begin(), m_currentBackpropRoots.end());
         }
-        else
+
+        return m_computationNetwork;
+    }
+
+    void CompositeFunction::SwapComputationNetworkState(ComputationNetworkState& state)
+    {
+        std::swap(m_computationNetwork, state.m_computationNetwork);
+        std::swap(m_variableToNodeMap, state.m_variableToNodeMap);
+        std::swap(m_isVariableRootMap, state.m_isVariableRootMap);
+        std::swap(m_currentBackpropRoots, state.m_currentBackpropRoots);
+        std::swap(m_currentOutputs, state.m_currentOutputs);
+        std::swap(m_currentArgumentShapes, state.m_currentArgumentShapes);
+        std::swap(m_networkMatricesAllocated, state.m_networkMatricesAllocated);
+        std::swap(m_lastRecordedParameterValueTimeStamps, state.m_lastRecordedParameterValueTimeStamps);
+    }
+
+    /*static*/ bool CompositeFunction::CanComputationNetworkBeUsedFor(const std::unordered_set<Variable>& networkBackpropRoots,
+                                                                       const std::unordered_set<Variable>& networkOutputs,
+                                                                       bool networkMatricesAllocated,
+                                                                       const std::unordered_map<Variable, NDShape>& networkArgumentShapes,
+                                                                       const std::unordered_set<Variable>& backpropRoots,
+                                                                       const std::unordered_set<Variable>& outputs,
+                                                                       const std::unordered_map<Variable, NDShape>& argumentShapes)
+    {
+        // Any network can evaluate without retaining backward state
+        if (!backpropRoots.empty() && (networkBackpropRoots != backpropRoots))
+            return false;
+
+        // The requested outputs must be a subset of the outputs the matrix allocation structure was set up for
+        if (networkMatricesAllocated)
         {
-            // Make sure the outputs requested are a subset of the outputs we setup the current matrix allocation structure
-            // in the cached computation network
-            for (auto output : outputs)
+            for (auto& output : outputs)
             {
-                if (m_currentOutputs.find(output) == m_currentOutputs.end())
-                    LogicError("Changing requested outputs across different Forward calls on a CNTK composite Function is currently unsupported");
+                if (networkOutputs.find(output) == networkOutputs.end())
+                    return false;
             }
         }
 
-        return m_computationNetwork;
+        return (networkArgumentShapes == argumentShapes);
+    }
+
+    void CompositeFunction::SwitchComputationNetwork(const std::unordered_set<Variable>& backpropRoots,
+                                                     const std::unordered_set<Variable>& outputs,
+                                                     const std::unordered_map<Variable, NDShape>& argumentShapes)
+    {
+        ComputationNetworkState current;
+        SwapComputationNetworkState(current);
+        m_cachedComputationNetworks.push_front(std::move(current));
+
+        for (auto iter = std::next(m_cachedComputationNetworks.begin()); iter != m_cachedComputationNetworks.end(); ++iter)
+        {
+            if (CanComputationNetworkBeUsedFor(iter->m_currentBackpropRoots, iter->m_currentOutputs, iter->m_networkMatricesAllocated, iter->m_currentArgumentShapes, backpropRoots, outputs, argumentShapes))
+            {
+                SwapComputationNetworkState(*iter);
+                m_cachedComputationNetworks.erase(iter);
+                break;
+            }
+        }
+
+        // Drop the least recently used networks, along with their matrices
+        while (m_cachedComputationNetworks.size() > Internal::GetComputationNetworkCacheSize())
+            m_cachedComputationNetworks.pop_back();
+    }
+
+    void CompositeFunction::CopyRngStateFrom(const std::unordered_map<Variable, ComputationNodeBasePtr>& variableToNodeMap)
+    {
+        for (const auto& varNodePair : variableToNodeMap)
+        {
+            if (!varNodePair.second->Is<RngUser>())
+                continue;
+
+            auto iter = m_variableToNodeMap.find(varNodePair.first);
+            if (iter != m_variableToNodeMap.end())
+            {
+                auto rng = varNodePair.second->As<RngUser>();
+                iter->second->As<RngUser>()->SetRngState(rng->GetRngSeed(), rng->GetRngOffset());
+            }
+        }
     }
 
     template <typename ElementType>
@@ -1234,10 +1313,17 @@ namespace CNTK
         for (auto output : outputs)
             requestedOutputVariables.insert(output.first);
 
+        std::unordered_map<Variable, NDShape> argumentShapes;
+        if (Internal::IsComputationNetworkCachedPerArgumentShape())
+        {
+            for (auto& argumentValuePair : arguments)
+                argumentShapes.insert({ argumentValuePair.first, argumentValuePair.second->Shape() });
+        }
+
         if (dataType == DataType::Float)
-            GetComputationNetwork<float>(computeDevice, outputsToRetainBackwardStateFor, requestedOutputVariables, true);
+            GetComputationNetwork<float>(computeDevice, outputsToRetainBackwardStateFor, requestedOutputVariables, true, argumentShapes);
         else if (dataType == DataType::Double)
-            GetComputationNetwork<double>(computeDevice, outputsToRetainBackwardStateFor, requestedOutputVariables, true);
+            GetComputationNetwork<double>(computeDevice, outputsToRetainBackwardStateFor, requestedOutputVariables, true, argumentShapes);
         else
             InvalidArgument("Unsupported DataType %s", DataTypeName(dataType));
 
@@ -1314,7 +1400,31 @@ namespace CNTK
 
         ScopedNetworkOperationMode modeGuard(m_computationNetwork, outputsToRetainBackwardStateFor.empty() ? NetworkOperationMode::inferring : NetworkOperationMode::training);
 
-        m_computationNetwork->ForwardProp(outputsToEvaluate);
+        if (outputsToRetainBackwardStateFor.empty() && Globals::ShouldUseCudaGraphs())
+        {
+            // the graph of a forward pass depends on the shapes of the arguments (in an order independent of the hash map);
+            // variable-length sequences come with masks on the GPU that a replay would not update
+            std::map<size_t, std::vector<size_t>> argumentShapes;
+            bool hasMasks = false;
+            for (const auto& argumentValuePair : arguments)
+            {
+                argumentShapes[(size_t)m_variableToNodeMap[argumentValuePair.first].get()] = argumentValuePair.second->Shape().Dimensions();
+                hasMasks |= (argumentValuePair.second->Mask() != nullptr);
+            }
+            std::vector<size_t> shapeKey;
+            for (const auto& argumentShape : argumentShapes)
+            {
+                shapeKey.push_back(argumentShape.first);
+                shapeKey.push_back(argumentShape.second.size());
+                shapeKey.insert(shapeKey.end(), argumentShape.second.begin(), argumentShape.second.end());
+            }
+            if (hasMasks)
+                m_computationNetwork->ForwardProp(outputsToEvaluate);
+            else
+                m_computationNetwork->ForwardPropCaptured(outputsToEvaluate, shapeKey);
+        }
+        else
+            m_computationNetwork->ForwardProp(outputsToEvaluate);
 
         GetNetworkOutputs(outputs);
 
@@ -1342,6 +1452,24 @@ namespace CNTK
 
         // TODO: Support multiple concurrent backprop states
         std::unordered_map<Variable, uint64_t> currentBackpropRootTimeStamps = GetCurrentBackpropRootsTimeStamps();
+        if (backpropState->BackpropRootsForwardTimeStamps() != currentBackpropRootTimeStamps)
+        {
+            // Forward calls after the one that produced the state may have switched to another network
+            for (auto iter = m_cachedComputationNetworks.begin(); iter != m_cachedComputationNetworks.end(); ++iter)
+            {
+                SwapComputationNetworkState(*iter);
+                currentBackpropRootTimeStamps = GetCurrentBackpropRootsTimeStamps();
+                if (backpropState->BackpropRootsForwardTimeStamps() == currentBackpropRootTimeStamps)
+                {
+                    // Keep the cache in most recently used order
+                    m_cachedComputationNetworks.splice(m_cachedComputationNetworks.begin(), m_cachedComputationNetworks, iter);
+                    break;
+                }
+
+                SwapComputationNetworkState(*iter);
+            }
+        }
+
         if (backpropState->BackpropRootsForwardTimeStamps() != currentBackpropRootTimeStamps)
             LogicError("The specified backprop state specified cannot be used for backpropagation as the Function's internal state was modified by subsequent Forward calls to the function."
                        "This is not a user error but a shortcoming of the current implementation where multiple independent backprop states are not simultaneously supported");
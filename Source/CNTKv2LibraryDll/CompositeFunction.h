@@ -10,6 +10,7 @@
 #include "PrimitiveFunction.h"
 #include "ComputationNetwork.h"
 #include "BackCompat.h"
+#include <list>
 
 namespace CNTK
 {
@@ -48,6 +49,10 @@ namespace CNTK
         friend void ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
                                                          std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
                                                          const DeviceDescriptor& device /*= DeviceDescriptor::CPUDevice()*/);
+        friend size_t ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
+                                                           std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
+                                                           size_t maxNumSamples,
+                                                           const DeviceDescriptor& device /*= DeviceDescriptor::CPUDevice()*/);
 
         static std::atomic<unsigned int> s_nextAutoGeneratedDynamicAxis;
 
@@ -174,7 +179,40 @@ namespace CNTK
         Microsoft::MSR::CNTK::ComputationNetworkPtr GetComputationNetwork(const DeviceDescriptor& device,
                                                                           const std::unordered_set<Variable>& backpropRoots,
                                                                           const std::unordered_set<Variable>& outputs,
-                                                                          bool allocateNetworkMatrices);
+                                                                          bool allocateNetworkMatrices,
+                                                                          const std::unordered_map<Variable, NDShape>& argumentShapes = {});
+
+        // A compiled ComputationNetwork together with the state of 'this' Function that refers to it; see m_cachedComputationNetworks.
+        struct ComputationNetworkState
+        {
+            Microsoft::MSR::CNTK::ComputationNetworkPtr m_computationNetwork;
+            std::unordered_map<Variable, Microsoft::MSR::CNTK::ComputationNodeBasePtr> m_variableToNodeMap;
+            std::unordered_map<Variable, bool> m_isVariableRootMap;
+            std::unordered_set<Variable> m_currentBackpropRoots;
+            std::unordered_set<Variable> m_currentOutputs;
+            std::unordered_map<Variable, NDShape> m_currentArgumentShapes;
+            bool m_networkMatricesAllocated = false;
+            std::unordered_map<Parameter, size_t> m_lastRecordedParameterValueTimeStamps;
+        };
+
+        void SwapComputationNetworkState(ComputationNetworkState& state);
+
+        static bool CanComputationNetworkBeUsedFor(const std::unordered_set<Variable>& networkBackpropRoots,
+                                                   const std::unordered_set<Variable>& networkOutputs,
+                                                   bool networkMatricesAllocated,
+                                                   const std::unordered_map<Variable, NDShape>& networkArgumentShapes,
+                                                   const std::unordered_set<Variable>& backpropRoots,
+                                                   const std::unordered_set<Variable>& outputs,
+                                                   const std::unordered_map<Variable, NDShape>& argumentShapes);
+
+        // Parks the current network in the cache and makes a cached one that fits the request current, if any;
+        // otherwise leaves 'this' Function without a network, to be built anew.
+        void SwitchComputationNetwork(const std::unordered_set<Variable>& backpropRoots,
+                                      const std::unordered_set<Variable>& outputs,
+                                      const std::unordered_map<Variable, NDShape>& argumentShapes);
+
+        // Continues the random number streams of the stateful nodes of the current network from those of another network of 'this' Function.
+        void CopyRngStateFrom(const std::unordered_map<Variable, Microsoft::MSR::CNTK::ComputationNodeBasePtr>& variableToNodeMap);
 
         template <typename ElementType>
         static Microsoft::MSR::CNTK::ComputationNodeBasePtr CreateComputationNode(const Variable& variable,
@@ -239,12 +277,20 @@ namespace CNTK
         // network memory sharing structure.
         std::unordered_set<Variable> m_currentOutputs;
 
+        // The argument shapes the cached computation network was set up for, if networks are cached per argument shape
+        // (see Internal::SetComputationNetworkCacheSize); empty otherwise.
+        std::unordered_map<Variable, NDShape> m_currentArgumentShapes;
+
         std::unordered_map<Variable, std::vector<Variable>> m_perOutputVarArgumentDependencies;
 
         bool m_networkMatricesAllocated;
 
         std::unordered_map<Parameter, size_t> m_lastRecordedParameterValueTimeStamps;
 
+        // Networks set up for earlier Forward calls with other outputs, backprop roots or argument shapes, most recently used first.
+        // Switching between them swaps their state with the members above; they share the Parameter values but not their activations.
+        std::list<ComputationNetworkState> m_cachedComputationNetworks;
+
         // Version history:
         // 1 -- initial version.
         // 2 -- add support for stateful functions (with corresponding nodes inheriting from RngUser).
@@ -9,6 +9,7 @@
 #include "CompositeFunction.h"
 #include <tuple>
 #include "ComputationNetworkBuilder.h"
+#include "MPIWrapper.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -18,6 +19,17 @@ namespace CNTK
                                               std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
                                               const DeviceDescriptor& device /*= DeviceDescriptor::CPUDevice()*/)
     {
+        ComputeInputPerDimMeansAndInvStdDevs(minibatchSource, computedMeanAndInvStdDevs, SIZE_MAX, device);
+    }
+
+    size_t ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
+                                                std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
+                                                size_t maxNumSamples,
+                                                const DeviceDescriptor& device /*= DeviceDescriptor::CPUDevice()*/)
+    {
+        if (computedMeanAndInvStdDevs.empty())
+            InvalidArgument("ComputeMeanAndVariance: No streams specified for which mean and variance are to be computed");
+
         typedef std::shared_ptr<ComputationNode<float>> ComputationNodePtr;
         const auto& minibatchSourceStreams = minibatchSource->StreamInfos();
 
@@ -74,22 +86,41 @@ namespace CNTK
         for (auto & preComputeNode : preComputeNodes)
             dynamic_pointer_cast<IPreComputeNode>(preComputeNode)->MarkComputed(false /*begin accumulating*/);
 
+        // With a distributed source, each worker only sees its own share of the data, and the statistics get merged at the end.
+        MPIWrapperPtr mpi = minibatchSource->IsDistributed() ? MPIWrapper::GetInstance(true) : nullptr;
+        size_t numWorkers = mpi ? mpi->NumNodesInUse() : 1;
+        size_t maxNumLocalSamples = (maxNumSamples == SIZE_MAX) ? SIZE_MAX : (maxNumSamples + numWorkers - 1) / numWorkers;
+        const auto& primaryStream = computedMeanAndInvStdDevs.begin()->first;
+
         const size_t maxMinibatchDataSize = (1 << 27); // 128 MB
         const size_t minibatchSize = maxMinibatchDataSize / totalSizePerSample;
-        for (;;)
+        size_t numLocalSamples = 0;
+        while (numLocalSamples < maxNumLocalSamples)
         {
-            auto minibatchData = minibatchSource->GetNextMinibatch(minibatchSize, device);
+            // (the minibatch size is over all workers)
+            size_t numSamplesToRead = minibatchSize;
+            if (maxNumLocalSamples != SIZE_MAX)
+                numSamplesToRead = std::min(numSamplesToRead, (maxNumLocalSamples - numLocalSamples) * numWorkers);
+
+            auto minibatchData = minibatchSource->GetNextMinibatch(numSamplesToRead, device);
             if (minibatchData.empty())
                 break;
 
+            if (!mpi && minibatchSource->IsDistributed())
+                InvalidArgument("ComputeMeanAndVariance: The minibatchSource turned distributed during the pass; create it with distributedAfterSampleCount = 0 to compute statistics in parallel.");
+
             for (auto& currentStreamKV : computedMeanAndInvStdDevs)
                 CompositeFunction::PopulateComputationNodeValue<float>({ streamToDummyInputVariableMap[currentStreamKV.first], minibatchData[currentStreamKV.first].m_data }, streamToInputNodeMap[currentStreamKV.first]);
 
             ComputationNetwork::BumpEvalTimeStamp(allInputNodes);
 
             computationNetwork->ForwardProp(preComputeNodes);
+            numLocalSamples += minibatchData[primaryStream].m_numSamples;
         }
 
+        // merge the statistics of all workers
+        size_t numSamples = ComputationNetwork::AggregatePreComputedStatistics(preComputeNodes, numWorkers > 1 ? mpi : nullptr);
+
         // finalize
         for (auto & preComputeNode : preComputeNodes)
             dynamic_pointer_cast<IPreComputeNode>(preComputeNode)->MarkComputed(true /*done accumulating*/);
@@ -113,5 +144,7 @@ namespace CNTK
             if (computedMeanAndInvStdDevs[currentStreamKV.first].second == nullptr)
                 computedMeanAndInvStdDevs[currentStreamKV.first].second = invStdDev->Data();
         }
+
+        return numSamples;
     }
 }
@@ -16,6 +16,8 @@
 
 namespace CNTK
 {
+    using Microsoft::MSR::CNTK::GradientSparsifier;
+
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
     QuantizedDistributedCommunicatorPtr QuantizedMPICommunicator(bool zeroThresholdFor1Bit, bool useQuantizationForSelfStripe, size_t numQuantizationBits)
     {
@@ -113,6 +115,11 @@ namespace CNTK
         return MakeSharedObject<DataParallelDistributedLearner>(communicator, learner, distributedAfterSamples, useAsyncBufferedParameterUpdate);
     }
 
+    DistributedLearnerPtr CreateSparseDataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, double density, size_t distributedAfterSamples, bool useAsyncBufferedParameterUpdate)
+    {
+        return MakeSharedObject<SparseDataParallelDistributedLearner>(communicator, learner, density, distributedAfterSamples, useAsyncBufferedParameterUpdate);
+    }
+
     DataParallelDistributedLearner::DataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributedAfterSamples, bool useAsyncBufferedParameterUpdate)
         : DistributedLearnerBase(communicator, learner, distributedAfterSamples)
     {
@@ -149,4 +156,89 @@ namespace CNTK
 
         return m_learner->Update(gradientValues, info.numberOfSamples);
     }
+
+    SparseDataParallelDistributedLearner::SparseDataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, double density, size_t distributedAfterSamples, bool useAsyncBufferedParameterUpdate)
+        : DistributedLearnerBase(communicator, learner, distributedAfterSamples), m_density(density)
+    {
+        if (useAsyncBufferedParameterUpdate)
+            LogicError("Asynchronous parameter update is not yet supported.");
+        GradientSparsifier<float>::NumEntriesToSend(1, density); // (validates it)
+    }
+
+    bool SparseDataParallelDistributedLearner::Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& info)
+    {
+        if (m_sampleCount >= m_distributeAfterSamples)
+        {
+            if (info.IsEmpty())
+                PrepaireZeroGradients(gradientValues, info);
+            ConvertToOrdered(gradientValues, m_gradientBuffer);
+
+            // the criteria and the number of samples are aggregated as they are
+            auto value = MakeSharedObject<NDArrayView>(static_cast<double>(info.numberOfSamples), NDShape{ 1 }, DeviceDescriptor::CPUDevice());
+            std::vector<NDArrayViewPtr> valuesToAggregate{ info.evalCriterionValue, info.trainingLossValue, value };
+            m_communicator->AggregateInPlace(valuesToAggregate, m_communicator->Workers());
+            info.numberOfSamples = static_cast<size_t>(*valuesToAggregate.back()->WritableDataBuffer<double>());
+
+            // select the entries of the gradients, into CPU buffers of the same size on all workers; the indices are
+            // stored as doubles (exact up to 2^53), as the communicator concatenates float and double values only
+            std::vector<NDArrayViewPtr> entries;
+            for (const auto& i : m_gradientBuffer)
+            {
+                const auto& gradient = i.second;
+                auto& residual = m_residuals[i.first];
+                if (!residual)
+                    residual = MakeSharedObject<NDArrayView>(0.0, gradient->GetDataType(), gradient->Shape(), gradient->Device());
+
+                size_t numEntries = GradientSparsifier<float>::NumEntriesToSend(gradient->Shape().TotalSize(), m_density);
+                auto indices = MakeSharedObject<NDArrayView>(DataType::Double, NDShape{ numEntries }, DeviceDescriptor::CPUDevice());
+                auto values = MakeSharedObject<NDArrayView>(gradient->GetDataType(), NDShape{ numEntries }, DeviceDescriptor::CPUDevice());
+                if (gradient->GetDataType() == DataType::Float)
+                    Sparsify<float>(m_floatSparsifier, gradient, residual, indices, values);
+                else if (gradient->GetDataType() == DataType::Double)
+                    Sparsify<double>(m_doubleSparsifier, gradient, residual, indices, values);
+                else
+                    LogicError("Unknown DataType");
+                entries.push_back(indices);
+                entries.push_back(values);
+            }
+
+            std::vector<NDArrayViewPtr> allEntries;
+            m_communicator->Concatenate(entries, allEntries, m_communicator->Workers());
+
+            for (size_t i = 0; i < m_gradientBuffer.size(); ++i)
+            {
+                const auto& gradient = m_gradientBuffer[i].second;
+                if (gradient->GetDataType() == DataType::Float)
+                    Merge<float>(m_floatSparsifier, allEntries[2 * i], allEntries[2 * i + 1], gradient);
+                else
+                    Merge<double>(m_doubleSparsifier, allEntries[2 * i], allEntries[2 * i + 1], gradient);
+            }
+        }
+
+        m_sampleCount += info.numberOfSamples;
+        m_gradientBuffer.clear();
+
+        if (info.IsEmpty())
+            return false;
+
+        return m_learner->Update(gradientValues, info.numberOfSamples);
+    }
+
+    template <typename ElementType>
+    void SparseDataParallelDistributedLearner::Sparsify(GradientSparsifier<ElementType>& sparsifier, const NDArrayViewPtr& gradient, const NDArrayViewPtr& residual,
+                                                        const NDArrayViewPtr& indices, const NDArrayViewPtr& values)
+    {
+        sparsifier.Sparsify(*gradient->GetMatrix<ElementType>(), *residual->GetWritableMatrix<ElementType>(), indices->Shape().TotalSize(),
+                            indices->WritableDataBuffer<double>(), values->WritableDataBuffer<ElementType>());
+    }
+
+    template <typename ElementType>
+    void SparseDataParallelDistributedLearner::Merge(GradientSparsifier<ElementType>& sparsifier, const NDArrayViewPtr& allIndices, const NDArrayViewPtr& allValues,
+                                                     const NDArrayViewPtr& gradient)
+    {
+        size_t numWorkers = m_communicator->Workers().size();
+        size_t numEntries = allIndices->Shape().TotalSize() / numWorkers;
+        sparsifier.Merge(allIndices->DataBuffer<double>(), allValues->DataBuffer<ElementType>(), numEntries, *gradient->GetWritableMatrix<ElementType>(),
+                         numWorkers, numEntries);
+    }
 }
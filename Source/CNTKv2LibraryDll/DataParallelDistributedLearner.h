@@ -7,6 +7,7 @@
 
 #include "CNTKLibrary.h"
 #include "DistributedLearnerBase.h"
+#include "GradientSparsifier.h"
 
 namespace CNTK
 {
@@ -21,4 +22,29 @@ namespace CNTK
         // Optional override that gets called per minibatch after finishing gradient computation but before updating model parameters
         bool Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& trainingSampleCount) override;
     };
+
+    ///
+    /// Distributed Trainer that exchanges the top-k entries of each gradient (see GradientSparsifier.h).
+    ///
+    class SparseDataParallelDistributedLearner : public DistributedLearnerBase
+    {
+    public:
+        SparseDataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, double density, size_t distributedAfterSamples, bool useAsyncBufferedParameterUpdate);
+
+        bool Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& trainingSampleCount) override;
+
+    private:
+        template <typename ElementType>
+        void Sparsify(Microsoft::MSR::CNTK::GradientSparsifier<ElementType>& sparsifier, const NDArrayViewPtr& gradient, const NDArrayViewPtr& residual,
+                      const NDArrayViewPtr& indices, const NDArrayViewPtr& values);
+
+        template <typename ElementType>
+        void Merge(Microsoft::MSR::CNTK::GradientSparsifier<ElementType>& sparsifier, const NDArrayViewPtr& allIndices, const NDArrayViewPtr& allValues,
+                   const NDArrayViewPtr& gradient);
+
+        double m_density;
+        std::unordered_map<Parameter, NDArrayViewPtr> m_residuals;
+        Microsoft::MSR::CNTK::GradientSparsifier<float> m_floatSparsifier;
+        Microsoft::MSR::CNTK::GradientSparsifier<double> m_doubleSparsifier;
+    };
 }
\ No newline at end of file
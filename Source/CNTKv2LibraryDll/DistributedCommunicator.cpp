@@ -12,6 +12,7 @@
 #include "CUDAPageLockedMemAllocator.h"
 #include "MatrixQuantizerImpl.h"
 #include "GPUDataTransferer.h"
+#include "NcclComm.h"
 #include <numeric>
 
 using namespace Microsoft::MSR::CNTK;
@@ -86,6 +87,14 @@ namespace CNTK
     void MPICommunicatorImpl::Initialize(const std::vector<NDArrayViewPtr>& values)
     {
         assert(CPUDEVICE < 0); // just in case somebody decides to change CPUDEVICE macro.
+
+        // (collective; all workers get here with their first aggregation)
+        if (!m_nccl)
+        {
+            auto device = GetNonCPUDevice(values);
+            m_nccl = std::make_shared<NcclComm>(device.Type() == DeviceKind::GPU ? (int)device.Id() : CPUDEVICE, m_mpi);
+        }
+
         DeviceDescriptor lastGpuDevice = DeviceDescriptor::CPUDevice();
         m_gpuDataTransferers.resize(values.size());
         m_intermediateCPUBuffers.resize(values.size());
@@ -111,6 +120,9 @@ namespace CNTK
                 else if (device.Id() != lastGpuDevice.Id()) // For the time being, assume all devices have the same id.
                     LogicError("Not all values are on the same GPU device id");
 
+                if (m_nccl->IsSupported())
+                    continue;
+
                 auto requiredSize = GetBufferSize(view);
                 m_gpuDataTransferers[i] = std::make_shared<GPUDataTransferer>(device.Id(), true);
                 if (m_intermediateCPUBuffers[i].totalSize < requiredSize)
@@ -301,12 +313,14 @@ namespace CNTK
             return;
 
         Initialize(inputValues);
+        // Initialize() checked that all GPU values are on the same device
+        bool reduceGpuValuesWithNccl = m_nccl->IsSupported();
 
         // for all values residing on GPU initiate async transfer to CPU buffers.
         for (auto i = 0; i < numValues; ++i)
         {
             auto view = inputValues[i];
-            if (view->Device() != DeviceDescriptor::CPUDevice())
+            if (view->Device() != DeviceDescriptor::CPUDevice() && !reduceGpuValuesWithNccl)
             {
                 auto& transferer = m_gpuDataTransferers[i];
                 auto& buffer = m_intermediateCPUBuffers[i];
@@ -314,11 +328,46 @@ namespace CNTK
             }
         }
 
-        std::vector<MPI_Request> allReduceRequests(numValues);
+        // or reduce them on the GPU, in place in the output values
+        bool anyNcclReductions = false;
+        if (reduceGpuValuesWithNccl)
+        {
+            for (auto i = 0; i < numValues; ++i)
+            {
+                if (inputValues[i]->Device() != DeviceDescriptor::CPUDevice())
+                {
+                    if (outputValues[i] != inputValues[i])
+                        outputValues[i]->CopyFrom(*inputValues[i]);
+                    anyNcclReductions = true;
+                }
+            }
+
+            if (anyNcclReductions)
+                m_nccl->WaitForComputeStream();
+
+            for (auto i = 0; i < numValues; ++i)
+            {
+                auto& outputValue = outputValues[i];
+                if (outputValue->Device() == DeviceDescriptor::CPUDevice())
+                    continue;
+                auto numElements = outputValue->Shape().TotalSize();
+                if (outputValue->GetDataType() == DataType::Float)
+                    m_nccl->AllReduce(outputValue->WritableDataBuffer<float>(), numElements);
+                else if (outputValue->GetDataType() == DataType::Double)
+                    m_nccl->AllReduce(outputValue->WritableDataBuffer<double>(), numElements);
+                else
+                    LogicError("Unknown DataType");
+            }
+        }
+
+        std::vector<MPI_Request> allReduceRequests(numValues, MPI_REQUEST_NULL);
         for (auto i = 0; i < numValues; ++i)
         {
             auto inputValue = inputValues[i];
 
+            if (inputValue->Device() != DeviceDescriptor::CPUDevice() && reduceGpuValuesWithNccl)
+                continue; // reduced above
+
             if (inputValue->Device() != DeviceDescriptor::CPUDevice())
             {
                 // TODO: actually, we can start reducing all cpu values first, and then wait for the gpu->cpu transfer to finish.
@@ -355,7 +404,7 @@ namespace CNTK
                 LogicError("Unknown DataType");
         }
 
-        // wait for async all reduce to complete. As soon as one of the requests is finished,
+        // wait for async all reduce to complete (the requests of the values reduced with NCCL are null). As soon as one of the requests is finished,
         // check if corresponding value is gpu bound and, if it is the case, initiate a cpu-to-gpu transfer.
         size_t numAllReduceRequestsCompleted = 0;
         while (numAllReduceRequestsCompleted < numValues)
@@ -385,9 +434,12 @@ namespace CNTK
         // TODO: Should not wait, simply publishing event on the compute stream should be sufficient.
         for (auto i = 0; i < numValues; ++i)
         {
-            if (inputValues[i]->Device() != DeviceDescriptor::CPUDevice())
+            if (inputValues[i]->Device() != DeviceDescriptor::CPUDevice() && !reduceGpuValuesWithNccl)
                 m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
         }
+
+        if (anyNcclReductions)
+            m_nccl->Sync();
     }
 
     void  MPICommunicatorImpl::Barrier()
@@ -10,6 +10,7 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
     class GPUDataTransferer;
+    class NcclComm;
 
     class MPIWrapper;
     typedef std::shared_ptr<MPIWrapper> MPIWrapperPtr;
@@ -82,6 +83,9 @@ namespace CNTK
         // TODO: these two are always parallel, merge them together?
         std::vector<std::shared_ptr<Microsoft::MSR::CNTK::GPUDataTransferer>> m_gpuDataTransferers;
 
+        // Reduces the values on the GPU if NCCL is supported (on multiple hosts, in two levels), otherwise they go through the CPU buffers.
+        std::shared_ptr<Microsoft::MSR::CNTK::NcclComm> m_nccl;
+
     protected:
         DeviceDescriptor GetNonCPUDevice(const std::vector<NDArrayViewPtr>& values)
         {
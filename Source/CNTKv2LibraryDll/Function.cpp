@@ -7,6 +7,8 @@
 #include "CNTKLibrary.h"
 #include "PrimitiveFunction.h"
 #include "CompositeFunction.h"
+#include "NativeUserFunction.h"
+#include "Serialization.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -189,6 +191,12 @@ namespace CNTK
     void Function::SaveModel(const std::wstring& modelFilePath)
     {
         Dictionary model = Serialize();
+        if (ShouldSaveSegmented(model))
+        {
+            SaveSegmented(model, modelFilePath);
+            return;
+        }
+
         auto stream = GetFstream(modelFilePath, false);
         *stream << model;
         stream->flush();
@@ -197,7 +205,14 @@ namespace CNTK
     /*static*/ FunctionPtr Function::LoadModel(const std::wstring& modelFile, const DeviceDescriptor& computeDevice)
     {
         auto stream = GetFstream(modelFile, true);
-        if (!Internal::IsLegacyModel(*stream))
+        if (IsSegmentedFile(*stream))
+        {
+            // the parameters are copied to the device straight from the mapping of the file
+            std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile> mapping;
+            Dictionary model = LoadSegmented(modelFile, &mapping);
+            return Function::Deserialize(model, computeDevice);
+        }
+        else if (!Internal::IsLegacyModel(*stream))
         {
             Dictionary model;
             *stream >> model;
@@ -212,7 +227,13 @@ namespace CNTK
     void Function::RestoreModel(const std::wstring& modelFilePath)
     {
         auto stream = GetFstream(modelFilePath, true);
-        if (!Internal::IsLegacyModel(*stream))
+        if (IsSegmentedFile(*stream))
+        {
+            std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile> mapping;
+            RestoreFromCheckpoint(LoadSegmented(modelFilePath, &mapping));
+            return;
+        }
+        else if (!Internal::IsLegacyModel(*stream))
         {
             Dictionary model;
             *stream >> model;
@@ -1017,6 +1038,15 @@ namespace CNTK
         return UnaryOp(PrimitiveOpType::Pass, operand, Dictionary(), name);
     }
 
+    FunctionPtr NativeUserFunction(const std::vector<Variable>& inputs, const NDShape& outputShape, const NativeUserFunctionKernelPtr& kernel, const std::wstring& name)
+    {
+        if (!kernel)
+            InvalidArgument("NativeUserFunction: The kernel must not be null.");
+
+        auto nativeFunction = MakeSharedObject<NativeKernelFunction>(inputs, outputShape, kernel, name);
+        return Combine({ nativeFunction->Output() });
+    }
+
     FunctionPtr OptimizedRNNStack(const Variable& operand, const Variable& weights, size_t hiddenSize, size_t numLayers, bool bidirectional, const std::wstring& recurrentOp, const std::wstring& name)
     {
         auto additionalProperties = Dictionary();
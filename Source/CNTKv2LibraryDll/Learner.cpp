@@ -84,6 +84,20 @@ namespace CNTK
             else
                 LogicError("Unsupported DataType %s", DataTypeName(v.second->GetDataType()));
         }
+        m_lazyUpdateStates.clear();
+    }
+
+    void LearnerBase::SwapExponentialMovingAverages()
+    {
+        for (const auto& ema : m_emaValues)
+        {
+            auto parameterValue = ema.first.Value();
+            auto value = parameterValue->DeepClone();
+            parameterValue->CopyFrom(*ema.second);
+            ema.second->CopyFrom(*value);
+            auto paramRef = ema.first;
+            paramRef.RecordValueUpdate();
+        }
     }
 
     // Clipping gradients to prevent outliers,
@@ -194,6 +208,14 @@ namespace CNTK
             NDArrayViewPtr view = AllocateNDArrayView(parameter, parameter.Shape());
             m_smoothedGradientValues.insert(make_pair(parameter, view));
         }
+
+        if (m_additionalOptions.exponentialMovingAverageDecay < 0 || m_additionalOptions.exponentialMovingAverageDecay >= 1)
+            InvalidArgument("exponentialMovingAverageDecay must be in [0, 1).");
+        if (m_additionalOptions.exponentialMovingAverageDecay > 0)
+        {
+            for (const auto& parameter : parameters)
+                m_emaValues.insert(make_pair(parameter, parameter.Value()->DeepClone()));
+        }
     }
 
     /*static*/ NDArrayViewPtr LearnerBase::AllocateNDArrayView(const Parameter& parameter, const NDShape& shape)
@@ -222,6 +244,13 @@ namespace CNTK
         }
     }
 
+    LearnerBase::LazyUpdateState* LearnerBase::GetLazyUpdateState(const Parameter& parameter, const NDArrayViewPtr& gradientValue) const
+    {
+        if (!m_additionalOptions.lazySparseUpdate || (!gradientValue->IsSparse() && m_lazyUpdateStates.find(parameter) == m_lazyUpdateStates.end()))
+            return nullptr;
+        return &m_lazyUpdateStates[parameter];
+    }
+
     /*virtual*/ bool LearnerBase::Update(unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount) /*override*/
     {
         if (LearningRate(trainingSampleCount) == 0.0)
@@ -281,17 +310,30 @@ namespace CNTK
         PreProcess<ElementType>(parameterValue, gradientValue, trainingSampleCount);
         Update(parameter, gradientValue, smoothedGradientValue, trainingSampleCount);
         PostProcess<ElementType>(parameter, gradientValue, trainingSampleCount);
+        UpdateEmaValue<ElementType>(parameter);
 
         auto paramRef = parameter;
         paramRef.RecordValueUpdate();
     }
 
+    template <typename ElementType>
+    void LearnerBase::UpdateEmaValue(const Parameter& parameter) const
+    {
+        auto emaIter = m_emaValues.find(parameter);
+        if (emaIter == m_emaValues.end())
+            return;
+        const auto& emaMatrix = GetWritableMatrix<ElementType>(emaIter->second);
+        const auto& parameterMatrix = GetMatrix<ElementType>(parameter.Value());
+        Matrix<ElementType>::AddScaledDifference(ElementType(1 - m_additionalOptions.exponentialMovingAverageDecay), *parameterMatrix, *emaMatrix, *emaMatrix);
+    }
+
     string LearnerBase::LearnerType() const
     {
         return Typename(this);
     }
 
     static const std::wstring s_learnerTypeValue = L"Learner";
+    static const std::wstring s_emaKeySuffix = L"_ema"; // checkpoint key of the moving average of a parameter, after its uid
 
     /*virtual*/ Dictionary LearnerBase::CreateCheckpoint() /*override*/
     {
@@ -303,6 +345,14 @@ namespace CNTK
         checkpoint[minibatchCountKey] = m_minibatchCount;
         checkpoint[learningRateScheduleKey] = m_learningRateSchedule.Serialize();
 
+        // the smoothed gradients (and the model saved along) must be those of the dense update
+        for (auto& lazyUpdateState : m_lazyUpdateStates)
+        {
+            CatchUpLazyUpdate(lazyUpdateState.first, m_smoothedGradientValues.at(lazyUpdateState.first), lazyUpdateState.second);
+            auto paramRef = lazyUpdateState.first;
+            paramRef.RecordValueUpdate();
+        }
+
         // TODO: should we also save momentum schedule into the checkpoint?
         // If that is the case, need to be able to override this method in subclasses,
         // TODO: we now store mapping from UID to Parameter value in the checkpoint,
@@ -320,6 +370,9 @@ namespace CNTK
             checkpoint[parameter.Uid()] = *smoothedGradientValue;
         }
 
+        for (const auto& ema : m_emaValues)
+            checkpoint[ema.first.Uid() + s_emaKeySuffix] = *ema.second;
+
         return checkpoint;
     }
 
@@ -334,6 +387,7 @@ namespace CNTK
         // TODO: which learning rate schedule should take precedence here? 
         // The one given at construction time or the one loaded from a checkpoint?
         m_learningRateSchedule = TrainingParameterSchedule<double>::Deserialize(checkpoint[learningRateScheduleKey].Value<Dictionary>());
+        m_lazyUpdateStates.clear(); // (checkpoints are taken with all lazy updates caught up)
 
         const auto parameters = Parameters();
 
@@ -362,6 +416,16 @@ namespace CNTK
 
             smoothedGradientValue->CopyFrom(checkpointedValue);
         }
+
+        // the moving averages restart from the parameter values if the checkpoint has none
+        for (const auto& ema : m_emaValues)
+        {
+            const auto emaKey = ema.first.Uid() + s_emaKeySuffix;
+            if (checkpoint.Contains(emaKey))
+                ema.second->CopyFrom(checkpoint[emaKey].Value<NDArrayView>());
+            else
+                ema.second->CopyFrom(*ema.first.Value());
+        }
     }
 
     /*virtual*/ void LearnerSGD::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
@@ -383,8 +447,38 @@ namespace CNTK
         // TODO: break up the NormalGrad into 3 different functions, each with its own set of parameters
         // Also, come up with a better name for NormalGrad (Default? Regular? Plain?).
         // (one for vanilla SGD, the other for momentum SGD, and the third one for NAG).
-        smoothedGradientMatrix->NormalGrad(*gradientMatrix, *parameterMatrix,
-                                           learningRate, momentum, UseNesterovMomentum());
+        if (auto lazyUpdateState = GetLazyUpdateState(parameter, gradientValue))
+        {
+            lazyUpdateState->momentum = momentum;
+            smoothedGradientMatrix->LazyNormalGrad(*gradientMatrix, *parameterMatrix, lazyUpdateState->lastUpdates, m_minibatchCount + 1,
+                                                   learningRate, momentum, UseNesterovMomentum());
+        }
+        else
+            smoothedGradientMatrix->NormalGrad(*gradientMatrix, *parameterMatrix,
+                                               learningRate, momentum, UseNesterovMomentum());
+    }
+
+    /*virtual*/ void LearnerSGD::CatchUpLazyUpdate(const Parameter& parameter, const NDArrayViewPtr& smoothedGradientValue, LazyUpdateState& state) const /*override*/
+    {
+        switch (smoothedGradientValue->GetDataType())
+        {
+        case DataType::Float:
+            CatchUpLazyUpdate<float>(parameter, smoothedGradientValue, state);
+            break;
+        case DataType::Double:
+            CatchUpLazyUpdate<double>(parameter, smoothedGradientValue, state);
+            break;
+        default:
+            NOT_IMPLEMENTED;
+        }
+    }
+
+    template <typename ElementType>
+    void LearnerSGD::CatchUpLazyUpdate(const Parameter& parameter, const NDArrayViewPtr& smoothedGradientValue, LazyUpdateState& state) const
+    {
+        const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(smoothedGradientValue);
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameter.Value());
+        smoothedGradientMatrix->CatchUpLazyNormalGrad(*parameterMatrix, state.lastUpdates, m_minibatchCount, ElementType(state.momentum), UseNesterovMomentum());
     }
 
     double LearnerMomentumSGD::MomentumValueForMB(const MomentumSchedule& schedule, size_t minibatchSize) const
@@ -480,7 +574,143 @@ namespace CNTK
 
         double& smoothedCount = m_smoothedCounts.at(parameter);
 
-        smoothedGradientMatrix->FSAdagradUpdate(trainingSampleCount, *gradientMatrix, *parameterMatrix, smoothedCount, learningRate, s_targetAdagradAvDenom, momentum, varMomentum);
+        if (auto lazyUpdateState = GetLazyUpdateState(parameter, gradientValue))
+        {
+            lazyUpdateState->learningRate = learningRate;
+            lazyUpdateState->momentum = momentum;
+            lazyUpdateState->varianceMomentum = varMomentum;
+            smoothedGradientMatrix->LazyFSAdagradUpdate(trainingSampleCount, *gradientMatrix, *parameterMatrix, smoothedCount, lazyUpdateState->lastUpdates, m_minibatchCount + 1,
+                                                        learningRate, s_targetAdagradAvDenom, momentum, varMomentum);
+        }
+        else
+            smoothedGradientMatrix->FSAdagradUpdate(trainingSampleCount, *gradientMatrix, *parameterMatrix, smoothedCount, learningRate, s_targetAdagradAvDenom, momentum, varMomentum);
+    }
+
+    /*virtual*/ void LearnerFSAdaGrad::CatchUpLazyUpdate(const Parameter& parameter, const NDArrayViewPtr& smoothedGradientValue, LazyUpdateState& state) const /*override*/
+    {
+        switch (smoothedGradientValue->GetDataType())
+        {
+        case DataType::Float:
+            CatchUpLazyUpdate<float>(parameter, smoothedGradientValue, state);
+            break;
+        case DataType::Double:
+            CatchUpLazyUpdate<double>(parameter, smoothedGradientValue, state);
+            break;
+        default:
+            NOT_IMPLEMENTED;
+        }
+    }
+
+    template <typename ElementType>
+    void LearnerFSAdaGrad::CatchUpLazyUpdate(const Parameter& parameter, const NDArrayViewPtr& smoothedGradientValue, LazyUpdateState& state) const
+    {
+        const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(smoothedGradientValue);
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameter.Value());
+        smoothedGradientMatrix->CatchUpLazyFSAdagrad(*parameterMatrix, state.lastUpdates, m_minibatchCount, state.learningRate, state.momentum, state.varianceMomentum);
+    }
+
+    /*static*/ const double LearnerAdam::s_epsilon = 1e-8;
+
+    LearnerAdam::LearnerAdam(const vector<Parameter>& parameters,
+                             const LearningRateSchedule& learningRateSchedule,
+                             const MomentumSchedule& momentumSchedule,
+                             const MomentumSchedule& varianceMomentumSchedule,
+                             AdditionalLearningOptions additionalOptions)
+                             : LearnerMomentumSGD(parameters, learningRateSchedule, momentumSchedule, additionalOptions, /*allocateSmoothGradients*/ false),
+                             m_varianceMomentumSchedule(varianceMomentumSchedule),
+                             m_decoupledWeightDecay(additionalOptions.decoupledWeightDecay)
+    {
+        // same layout as FSAdaGrad: second moments, then first moments
+        for (const auto& parameter : parameters)
+        {
+            const auto shape = GetMatrixShape(parameter);
+            NDArrayViewPtr view = AllocateNDArrayView(parameter, { shape[0], 2 * shape[1] });
+            m_smoothedGradientValues.insert(make_pair(parameter, view));
+        }
+    }
+
+    /*virtual*/ void LearnerAdam::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
+    {
+        UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerAdam::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+    {
+        const auto& parameterValue = parameter.Value();
+        const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(smoothedGradientValue);
+        const auto& gradientMatrix = GetWritableMatrix<ElementType>(gradientValue);
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameterValue);
+
+        const auto learningRate = LearningRate(trainingSampleCount);
+        const auto momentum = MomentumValueForMB(trainingSampleCount);
+        const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+
+        // the bias correction counts the updates, which are the minibatches seen (and checkpointed) by the learner
+        double updateCount = (double) m_minibatchCount;
+        smoothedGradientMatrix->AdamUpdate(*gradientMatrix, *parameterMatrix, updateCount, learningRate, momentum, varMomentum, s_epsilon, m_decoupledWeightDecay);
+    }
+
+    /*virtual*/ void LearnerLARS::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
+    {
+        UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerLARS::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+    {
+        const auto& parameterValue = parameter.Value();
+        const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(smoothedGradientValue);
+        const auto& gradientMatrix = GetWritableMatrix<ElementType>(gradientValue);
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameterValue);
+
+        // (the gradient already includes the L2 term, see PreProcess())
+        const auto trustRatio = GetLarsTrustRatio(parameterMatrix->FrobeniusNorm(), gradientMatrix->FrobeniusNorm(), /*l2RegWeight=*/0, m_trustCoefficient);
+        const auto learningRate = ElementType(LearningRate(trainingSampleCount) * trustRatio);
+        const auto momentum = ElementType(MomentumValueForMB(trainingSampleCount));
+        smoothedGradientMatrix->NormalGrad(*gradientMatrix, *parameterMatrix, learningRate, momentum, UseNesterovMomentum());
+    }
+
+    /*static*/ const double LearnerLAMB::s_epsilon = 1e-6;
+
+    LearnerLAMB::LearnerLAMB(const vector<Parameter>& parameters,
+                             const LearningRateSchedule& learningRateSchedule,
+                             const MomentumSchedule& momentumSchedule,
+                             const MomentumSchedule& varianceMomentumSchedule,
+                             AdditionalLearningOptions additionalOptions)
+                             : LearnerMomentumSGD(parameters, learningRateSchedule, momentumSchedule, additionalOptions, /*allocateSmoothGradients*/ false),
+                             m_varianceMomentumSchedule(varianceMomentumSchedule),
+                             m_decoupledWeightDecay(additionalOptions.decoupledWeightDecay)
+    {
+        // same layout as Adam: second moments, then first moments
+        for (const auto& parameter : parameters)
+        {
+            const auto shape = GetMatrixShape(parameter);
+            NDArrayViewPtr view = AllocateNDArrayView(parameter, { shape[0], 2 * shape[1] });
+            m_smoothedGradientValues.insert(make_pair(parameter, view));
+        }
+    }
+
+    /*virtual*/ void LearnerLAMB::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
+    {
+        UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerLAMB::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+    {
+        const auto& parameterValue = parameter.Value();
+        const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(smoothedGradientValue);
+        const auto& gradientMatrix = GetWritableMatrix<ElementType>(gradientValue);
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameterValue);
+
+        const auto learningRate = LearningRate(trainingSampleCount);
+        const auto momentum = MomentumValueForMB(trainingSampleCount);
+        const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+
+        // the bias correction counts the updates, as in LearnerAdam
+        double updateCount = (double) m_minibatchCount;
+        smoothedGradientMatrix->LambUpdate(*gradientMatrix, *parameterMatrix, updateCount, learningRate, momentum, varMomentum, s_epsilon, m_decoupledWeightDecay);
     }
 
     LearnerRMSProp::LearnerRMSProp(const vector<Parameter>& parameters,
@@ -569,12 +799,28 @@ namespace CNTK
                            AdditionalLearningOptions additionalOptions /*= AdditionalLearningOptions()*/)
     {
         if (!lowMemory)
-        {
-            LogicError("AdamLearner: only the low-memory variant is supported at the moment.");
-        }
+            return MakeSharedObject<LearnerAdam>(parameters, learningRateSchedule, momentumSchedule, varianceMomentumSchedule, additionalOptions);
         return MakeSharedObject<LearnerFSAdaGrad>(parameters, learningRateSchedule, momentumSchedule, varianceMomentumSchedule, additionalOptions);
     }
 
+    LearnerPtr LARSLearner(const vector<Parameter>& parameters,
+                           const LearningRateSchedule& learningRateSchedule,
+                           const MomentumSchedule& momentumSchedule,
+                           double trustCoefficient, /*= 0.001*/
+                           AdditionalLearningOptions additionalOptions /*= AdditionalLearningOptions()*/)
+    {
+        return MakeSharedObject<LearnerLARS>(parameters, learningRateSchedule, momentumSchedule, trustCoefficient, additionalOptions);
+    }
+
+    LearnerPtr LAMBLearner(const vector<Parameter>& parameters,
+                           const LearningRateSchedule& learningRateSchedule,
+                           const MomentumSchedule& momentumSchedule,
+                           const MomentumSchedule& varianceMomentumSchedule, /*= MomentumAsTimeConstantSchedulePerSample(2 * 3600 * 100)*/
+                           AdditionalLearningOptions additionalOptions /*= AdditionalLearningOptions()*/)
+    {
+        return MakeSharedObject<LearnerLAMB>(parameters, learningRateSchedule, momentumSchedule, varianceMomentumSchedule, additionalOptions);
+    }
+
     LearnerPtr AdaGradLearner(const vector<Parameter>& parameters,
                               const LearningRateSchedule& learningRateSchedule,
                               bool needAveMultiplier /*= true*/,
@@ -27,6 +27,8 @@ namespace CNTK
 
         virtual void ResetSmoothedGradients() override final;
 
+        virtual void SwapExponentialMovingAverages() override final;
+
     protected:
         // allocateSmoothGradients flag specifies whether NDArrayViews for smoothed gradients can be allocated 
         // in the base class constructor (in which case they are allocated with the shapes identical to the shapes of
@@ -94,12 +96,37 @@ namespace CNTK
 
         size_t m_minibatchCount;
 
+        // state of the lazy sparse updates (AdditionalLearningOptions::lazySparseUpdate) of a parameter, see Matrix::LazyNormalGrad()
+        struct LazyUpdateState
+        {
+            std::vector<size_t> lastUpdates; // per column, the minibatch count of its last update
+            double learningRate = 0;         // the rates of the most recent update, with which CatchUpLazyUpdate() catches up
+            double momentum = 0;
+            double varianceMomentum = 0;
+        };
+
+        // Returns the lazy update state of the parameter if it is to be updated lazily, nullptr otherwise.
+        // Parameters are updated lazily from their first sparse gradient on.
+        LazyUpdateState* GetLazyUpdateState(const Parameter& parameter, const NDArrayViewPtr& gradientValue) const;
+
+        // Brings a lazily updated parameter up to date with the dense update; invoked before checkpointing.
+        virtual void CatchUpLazyUpdate(const Parameter& /*parameter*/, const NDArrayViewPtr& /*smoothedGradientValue*/, LazyUpdateState& /*state*/) const {}
+
+        mutable std::unordered_map<Parameter, LazyUpdateState> m_lazyUpdateStates;
+
+        // exponential moving averages of the parameters (AdditionalLearningOptions::exponentialMovingAverageDecay)
+        std::unordered_map<Parameter, NDArrayViewPtr> m_emaValues;
+
     private:
         // Templatized update function, it invokes preprocess and postprocess using the provided
         // template parameter and also invokes virtual Update method implemented in one of the subclasses.
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        // ema += (1 - decay) * (value - ema), after the update of the parameter
+        template <typename ElementType>
+        void UpdateEmaValue(const Parameter& parameter) const;
+
         // TODO: make these functions friends of NDViewArray and move to Utils?
         static bool HasNan(const NDArrayViewPtr& value, const char* name);
         static void Print(const NDArrayViewPtr& value, const char* msg);
@@ -135,6 +162,11 @@ namespace CNTK
 
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        virtual void CatchUpLazyUpdate(const Parameter& parameter, const NDArrayViewPtr& smoothedGradientValue, LazyUpdateState& state) const override;
+
+        template <typename ElementType>
+        void CatchUpLazyUpdate(const Parameter& parameter, const NDArrayViewPtr& smoothedGradientValue, LazyUpdateState& state) const;
     };
 
     // SGD optimization with momentum. 
@@ -216,6 +248,11 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        virtual void CatchUpLazyUpdate(const Parameter& parameter, const NDArrayViewPtr& smoothedGradientValue, LazyUpdateState& state) const override;
+
+        template <typename ElementType>
+        void CatchUpLazyUpdate(const Parameter& parameter, const NDArrayViewPtr& smoothedGradientValue, LazyUpdateState& state) const;
+
     private:
         static const double s_targetAdagradAvDenom;
 
@@ -229,6 +266,95 @@ namespace CNTK
         MomentumSchedule m_varianceMomentumSchedule;
     };
 
+    // Adam with bias correction, one fused pass per parameter (see Matrix::AdamUpdate()); AdamW with a decoupled weight decay.
+    class LearnerAdam : public LearnerMomentumSGD
+    {
+    public:
+
+        LearnerAdam(const std::vector<Parameter>& parameters,
+                    const LearningRateSchedule& learningRateSchedule,
+                    const MomentumSchedule& momentumSchedule,
+                    const MomentumSchedule& varianceMomentumSchedule,
+                    AdditionalLearningOptions additionalOptions);
+
+    protected:
+
+        virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+    private:
+        static const double s_epsilon;
+
+        // returns current per-minibatch variance momentum value.
+        double VarianceMomentumValueForMB(size_t minibatchSize) const
+        {
+            return MomentumValueForMB(m_varianceMomentumSchedule, minibatchSize);
+        }
+
+        MomentumSchedule m_varianceMomentumSchedule;
+        double m_decoupledWeightDecay;
+    };
+
+    // LARS: momentum SGD with the learning rate of each parameter scaled by its trust ratio (see GetLarsTrustRatio()),
+    // for large minibatches. Under a distributed learner the norms are those of the aggregated gradients.
+    class LearnerLARS : public LearnerMomentumSGD
+    {
+    public:
+
+        LearnerLARS(const std::vector<Parameter>& parameters,
+                    const LearningRateSchedule& learningRateSchedule,
+                    const MomentumSchedule& momentumSchedule,
+                    double trustCoefficient,
+                    AdditionalLearningOptions additionalOptions)
+                    : LearnerMomentumSGD(parameters, learningRateSchedule, momentumSchedule, additionalOptions, /*allocateSmoothGradients*/ true),
+                    m_trustCoefficient(trustCoefficient)
+        {}
+
+    protected:
+
+        virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+    private:
+        double m_trustCoefficient;
+    };
+
+    // LAMB: Adam with decoupled weight decay and the step of each parameter scaled by its trust ratio (see Matrix::LambUpdate()),
+    // for large minibatches. Under a distributed learner the norms are those of the aggregated gradients.
+    class LearnerLAMB : public LearnerMomentumSGD
+    {
+    public:
+
+        LearnerLAMB(const std::vector<Parameter>& parameters,
+                    const LearningRateSchedule& learningRateSchedule,
+                    const MomentumSchedule& momentumSchedule,
+                    const MomentumSchedule& varianceMomentumSchedule,
+                    AdditionalLearningOptions additionalOptions);
+
+    protected:
+
+        virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+    private:
+        static const double s_epsilon;
+
+        // returns current per-minibatch variance momentum value.
+        double VarianceMomentumValueForMB(size_t minibatchSize) const
+        {
+            return MomentumValueForMB(m_varianceMomentumSchedule, minibatchSize);
+        }
+
+        MomentumSchedule m_varianceMomentumSchedule;
+        double m_decoupledWeightDecay;
+    };
+
     class LearnerRMSProp : public LearnerBase
     {
     public:
@@ -69,6 +69,8 @@ namespace CNTK
 
     /*static*/ const std::wstring CompositeMinibatchSource::PositionAttributeName = L"minibatchSourcePosition";
     /*static*/ const std::wstring CompositeMinibatchSource::DistributedAfterSampleCountAttributeName = L"minibatchDistributedAfterSampleCount";
+    /*static*/ const std::wstring CompositeMinibatchSource::PipelinePositionsAttributeName = L"minibatchSourcePipelinePositions";
+    /*static*/ const std::wstring CompositeMinibatchSource::ReaderStatesAttributeName = L"minibatchSourceReaderStates";
 
     CompositeMinibatchSource::CompositeMinibatchSource(const Dictionary& configuration)
         : m_epochEndReached(false),
@@ -78,7 +80,9 @@ namespace CNTK
           m_numWorkers(1),
           m_workerRank(0),
           m_distributed(false),
-          m_distributedAfterSampleCount(MinibatchSource::InfiniteSamples)
+          m_distributedAfterSampleCount(MinibatchSource::InfiniteSamples),
+          m_nextPipeline(0),
+          m_deterministicParallelReaders(false)
     {
         // The CNTK reader implementation requires for each deserializer both the module and deserializer type be specified
         // This is redundant and the V2 API users will just specify type from which the module is automatically inferred
@@ -155,16 +159,37 @@ namespace CNTK
         if (augmentedConfiguration.Contains(distributedAfterSampleCountConfigurationKey))
             m_distributedAfterSampleCount = augmentedConfiguration[distributedAfterSampleCountConfigurationKey].Value<size_t>();
 
+        size_t numParallelReaders = 1;
+        const wchar_t* numParallelReadersConfigurationKey = L"numParallelReaders";
+        if (augmentedConfiguration.Contains(numParallelReadersConfigurationKey))
+            numParallelReaders = augmentedConfiguration[numParallelReadersConfigurationKey].Value<size_t>();
+
+        if (numParallelReaders == 0)
+            InvalidArgument("The number of parallel readers of a MinibatchSource must be > 0.");
+
+        const wchar_t* deterministicParallelReadersConfigurationKey = L"deterministicParallelReaders";
+        if (augmentedConfiguration.Contains(deterministicParallelReadersConfigurationKey))
+            m_deterministicParallelReaders = augmentedConfiguration[deterministicParallelReadersConfigurationKey].Value<bool>();
+
         typedef Reader*(*CreateCompositeDataReaderProc)(const ConfigParameters* parameters);
         CreateCompositeDataReaderProc createReaderProc = (CreateCompositeDataReaderProc)Plugin().Load(L"CompositeDataReader", "CreateCompositeDataReader");
-        std::shared_ptr<Microsoft::MSR::CNTK::Reader> compositeDataReader(createReaderProc(&config));
 
-        m_compositeDataReaderStreamDescs = compositeDataReader->GetStreamDescriptions();
-        for (auto streamDesc : m_compositeDataReaderStreamDescs)
-            m_streamInfos.insert({ streamDesc->m_name, streamDesc->m_id, AsStorageFormat(streamDesc->m_storageType), AsDataType(streamDesc->m_elementType), AsNDShape(*(streamDesc->m_sampleLayout)) });
+        // All readers are created from the same configuration, so they randomize the chunks identically
+        // and the subsets they read as different virtual workers do not overlap.
+        m_pipelines.resize(numParallelReaders);
+        for (auto& pipeline : m_pipelines)
+        {
+            std::shared_ptr<Microsoft::MSR::CNTK::Reader> compositeDataReader(createReaderProc(&config));
+            if (m_compositeDataReaderStreamDescs.empty())
+            {
+                m_compositeDataReaderStreamDescs = compositeDataReader->GetStreamDescriptions();
+                for (auto streamDesc : m_compositeDataReaderStreamDescs)
+                    m_streamInfos.insert({ streamDesc->m_name, streamDesc->m_id, AsStorageFormat(streamDesc->m_storageType), AsDataType(streamDesc->m_elementType), AsNDShape(*(streamDesc->m_sampleLayout)) });
+            }
 
-        m_shim = std::shared_ptr<ReaderShim<float>>(new ReaderShim<float>(compositeDataReader), [](ReaderShim<float>* x) { x->Destroy(); });
-        m_shim->Init(config);
+            pipeline.m_shim = std::shared_ptr<ReaderShim<float>>(new ReaderShim<float>(compositeDataReader), [](ReaderShim<float>* x) { x->Destroy(); });
+            pipeline.m_shim->Init(config);
+        }
 
         const wchar_t* numWorkersConfigurationKey = L"numWorkers";
         if (configuration.Contains(numWorkersConfigurationKey))
@@ -183,6 +208,44 @@ namespace CNTK
         }
     }
 
+    void CompositeMinibatchSource::ConfigurePipeline(ReaderConfiguration& config, size_t pipelineIndex, size_t minibatchSizeInSamples) const
+    {
+        size_t numPipelines = m_pipelines.size();
+        config.m_numberOfWorkers = (m_distributed ? m_numWorkers : 1) * numPipelines;
+        config.m_workerRank = (m_distributed ? m_workerRank : 0) * numPipelines + pipelineIndex;
+        config.m_minibatchSizeInSamples = minibatchSizeInSamples * numPipelines;
+        config.m_truncationSize = m_truncationLength;
+    }
+
+    size_t CompositeMinibatchSource::SelectPipeline()
+    {
+        size_t numPipelines = m_pipelines.size();
+        size_t selected = numPipelines;
+        for (size_t i = 0; i < numPipelines; ++i)
+        {
+            size_t index = (m_nextPipeline + i) % numPipelines;
+            auto& shim = m_pipelines[index].m_shim;
+            if (shim->IsEndOfEpoch())
+                continue;
+
+            if (selected == numPipelines)
+                selected = index;
+
+            if (m_deterministicParallelReaders || shim->IsMinibatchReady())
+            {
+                selected = index;
+                break;
+            }
+        }
+
+        // All pipelines are at the end of the epoch, any of them will return no data.
+        if (selected == numPipelines)
+            selected = m_nextPipeline;
+
+        m_nextPipeline = (selected + 1) % numPipelines;
+        return selected;
+    }
+
     /*virtual*/ const std::unordered_map<StreamInformation, MinibatchData>&
     CompositeMinibatchSource::GetNextMinibatch(size_t minibatchSizeInSequences,
                                                size_t minibatchSizeInSamples,
@@ -219,40 +282,42 @@ namespace CNTK
 
             if (m_prevMinibatchSize == 0)
             {
-                EpochConfiguration epochConfig;
-                epochConfig.m_numberOfWorkers = m_distributed ? m_numWorkers : 1;
-                epochConfig.m_workerRank = m_distributed ? m_workerRank : 0;
-                epochConfig.m_minibatchSizeInSamples = minibatchSizeInSamples;
-                epochConfig.m_truncationSize = m_truncationLength;
-
-                epochConfig.m_totalEpochSizeInSamples = m_epochSize;
-                epochConfig.m_epochIndex = 0;
-                m_matrices.clear();
-
                 std::unordered_set<InputStreamDescription> inputs;
                 for (const auto& s : m_streamInfos)
                 {
-                    auto inputStreamDescription = GetInputStreamDescription(s, device);
-                    inputs.insert(inputStreamDescription);
+                    if (s.m_elementType != DataType::Float)
+                        LogicError("Input data of type other than DataType::Float is currently unsupported by the CNTK built-in composite MinibatchSource!");
 
-                    if (s.m_elementType == DataType::Float)
+                    inputs.insert(GetInputStreamDescription(s, device));
+                }
+
+                for (size_t i = 0; i < m_pipelines.size(); ++i)
+                {
+                    EpochConfiguration epochConfig;
+                    ConfigurePipeline(epochConfig, i, minibatchSizeInSamples);
+                    epochConfig.m_totalEpochSizeInSamples = m_epochSize;
+                    epochConfig.m_epochIndex = 0;
+
+                    auto& matrices = m_pipelines[i].m_matrices;
+                    matrices.clear();
+                    for (const auto& s : m_streamInfos)
                     {
+                        auto inputStreamDescription = GetInputStreamDescription(s, device);
                         auto iter = std::find_if(m_compositeDataReaderStreamDescs.begin(), m_compositeDataReaderStreamDescs.end(), [s](StreamDescriptionPtr& streamInfo) {
                             return streamInfo->m_id == s.m_id;
                         });
                         assert(iter != m_compositeDataReaderStreamDescs.end());
 
-                        m_matrices.AddInput(
+                        matrices.AddInput(
                             s.m_name,
                             std::make_shared<Matrix<float>>(0, 0, inputStreamDescription.GetDeviceId(), inputStreamDescription.GetMatrixType(), inputStreamDescription.GetMatrixFormat()),
                             std::make_shared<MBLayout>(),
                             *(*iter)->m_sampleLayout);
                     }
-                    else
-                        LogicError("Input data of type other than DataType::Float is currently unsupported by the CNTK built-in composite MinibatchSource!");
+
+                    m_pipelines[i].m_shim->StartEpoch(epochConfig, inputs);
                 }
 
-                m_shim->StartEpoch(epochConfig, inputs);
                 m_prevMinibatchSize = minibatchSizeInSamples;
                 wasDistributed = m_distributed;
             }
@@ -263,25 +328,32 @@ namespace CNTK
                 for (const auto& s : m_streamInfos)
                     inputDescriptions[s.m_name] = AsCNTKImplDeviceId(device);
 
-                ReaderConfiguration newConfig;
-                newConfig.m_numberOfWorkers = m_distributed ? m_numWorkers : 1;
-                newConfig.m_workerRank = m_distributed ? m_workerRank : 0;
-                newConfig.m_minibatchSizeInSamples = minibatchSizeInSamples;
-                newConfig.m_truncationSize = m_truncationLength;
-
-                m_shim->SetConfiguration(newConfig, inputDescriptions);
+                for (size_t i = 0; i < m_pipelines.size(); ++i)
+                {
+                    ReaderConfiguration newConfig;
+                    ConfigurePipeline(newConfig, i, minibatchSizeInSamples);
+                    m_pipelines[i].m_shim->SetConfiguration(newConfig, inputDescriptions);
+                }
 
                 m_prevMinibatchSize = minibatchSizeInSamples;
             }
 
-            auto hasData = m_shim->GetMinibatch(m_matrices);
-            m_epochEndReached = m_shim->IsEndOfEpoch();
+            // A pipeline that reaches the end of the epoch may not return data, then the next one is asked.
+            bool hasData = false;
+            Pipeline* pipeline = nullptr;
+            for (size_t attempt = 0; attempt < m_pipelines.size() && !hasData; ++attempt)
+            {
+                pipeline = &m_pipelines[SelectPipeline()];
+                hasData = pipeline->m_shim->GetMinibatch(pipeline->m_matrices);
+            }
+
+            m_epochEndReached = std::all_of(m_pipelines.begin(), m_pipelines.end(), [](const Pipeline& p) { return p.m_shim->IsEndOfEpoch(); });
             if (m_epochEndReached && !hasData)
                 return m_minibatchData;
 
             for (const auto& s: m_streamInfos)
             {
-                auto input = m_matrices.GetInput(s.m_name);
+                auto input = pipeline->m_matrices.GetInput(s.m_name);
                 auto& currentStreamInfo = s;
 
                 ValuePtr minibatchValuePtr;
@@ -315,15 +387,50 @@ namespace CNTK
     /*virtual*/ Dictionary CompositeMinibatchSource::GetCheckpointState() const /*override*/
     {
         Dictionary checkpointState;
-        checkpointState[PositionAttributeName] = m_shim->GetCurrentSamplePosition();
+        checkpointState[PositionAttributeName] = m_pipelines.front().m_shim->GetCurrentSamplePosition();
         checkpointState[DistributedAfterSampleCountAttributeName] = m_distributedAfterSampleCount;
+
+        if (m_pipelines.size() > 1)
+        {
+            std::vector<DictionaryValue> positions;
+            for (const auto& pipeline : m_pipelines)
+                positions.push_back(pipeline.m_shim->GetCurrentSamplePosition());
+            checkpointState[PipelinePositionsAttributeName] = positions;
+        }
+
+        // The exact state of the randomizers, so that restoring does not replay the sweep up to the position.
+        // Readers that do not support it return an empty state.
+        std::vector<DictionaryValue> readerStates;
+        for (const auto& pipeline : m_pipelines)
+            readerStates.push_back(msra::strfun::utf16(pipeline.m_shim->GetReaderState()));
+        checkpointState[ReaderStatesAttributeName] = readerStates;
+
         return checkpointState;
     }
 
     /*virtual*/ void CompositeMinibatchSource::RestoreFromCheckpoint(const Dictionary& checkpoint) /*override*/
     {
         auto checkpointedMinibatchSourcePosition = checkpoint[PositionAttributeName].Value<size_t>();
-        m_shim->SetCurrentSamplePosition(checkpointedMinibatchSourcePosition);
+
+        // Checkpoints of a source with a different number of pipelines restore all pipelines to the position of the first one.
+        std::vector<DictionaryValue> positions;
+        if (checkpoint.Contains(PipelinePositionsAttributeName))
+            positions = checkpoint[PipelinePositionsAttributeName].Value<std::vector<DictionaryValue>>();
+
+        std::vector<DictionaryValue> readerStates;
+        if (checkpoint.Contains(ReaderStatesAttributeName))
+            readerStates = checkpoint[ReaderStatesAttributeName].Value<std::vector<DictionaryValue>>();
+
+        for (size_t i = 0; i < m_pipelines.size(); ++i)
+        {
+            // With the restored state, the position below is within the randomization window and is set without replaying the sweep.
+            if (readerStates.size() == m_pipelines.size())
+                m_pipelines[i].m_shim->SetReaderState(msra::strfun::utf8(readerStates[i].Value<std::wstring>()));
+
+            auto position = (positions.size() == m_pipelines.size()) ? positions[i].Value<size_t>() : checkpointedMinibatchSourcePosition;
+            m_pipelines[i].m_shim->SetCurrentSamplePosition(position);
+        }
+
         m_distributedAfterSampleCount = checkpoint[DistributedAfterSampleCountAttributeName].Value<size_t>();
     }
 }
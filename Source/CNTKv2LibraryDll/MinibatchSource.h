@@ -18,6 +18,8 @@ namespace CNTK
     {
         static const std::wstring PositionAttributeName;
         static const std::wstring DistributedAfterSampleCountAttributeName;
+        static const std::wstring PipelinePositionsAttributeName;
+        static const std::wstring ReaderStatesAttributeName;
 
     public:
         CompositeMinibatchSource(const Dictionary& configuration);
@@ -33,7 +35,7 @@ namespace CNTK
 
         virtual bool IsDistributed() const override
         {
-            return m_shim->GetCurrentSamplePosition() >= m_distributedAfterSampleCount;
+            return m_pipelines.front().m_shim->GetCurrentSamplePosition() >= m_distributedAfterSampleCount;
         }
 
     private:
@@ -46,6 +48,16 @@ namespace CNTK
             return Microsoft::MSR::CNTK::InputStreamDescription(s.m_name, CNTKdeviceId, CNTKMatrixType, CNTKMatrixFormat);
         }
 
+        // Each pipeline reads the subset of the data of a virtual worker: pipeline i of this worker is
+        // worker (rank * #pipelines + i) of (#workers * #pipelines). The minibatch size is scaled by the
+        // number of pipelines, so that each pipeline returns minibatches of the size requested from the source.
+        void ConfigurePipeline(Microsoft::MSR::CNTK::ReaderConfiguration& config, size_t pipelineIndex, size_t minibatchSizeInSamples) const;
+
+        // Index of the pipeline to take the next minibatch from. In deterministic mode pipelines are
+        // visited round robin, otherwise the first pipeline (in round robin order) that has a minibatch ready is taken.
+        // Pipelines that reached the end of the epoch are skipped.
+        size_t SelectPipeline();
+
     private: 
         std::unordered_set<StreamInformation> m_streamInfos;
         bool m_epochEndReached;
@@ -63,7 +75,15 @@ namespace CNTK
         // Please only use a subset of the shim interface that includes
         // Init()/StartEpoch()/GetMinibatch()/IsEndOfEpoch()
         // Shim will be deleted in the future versions.
-        std::shared_ptr<Microsoft::MSR::CNTK::ReaderShim<float>> m_shim;
-        Microsoft::MSR::CNTK::StreamMinibatchInputs m_matrices;
+        struct Pipeline
+        {
+            std::shared_ptr<Microsoft::MSR::CNTK::ReaderShim<float>> m_shim;
+            Microsoft::MSR::CNTK::StreamMinibatchInputs m_matrices;
+        };
+
+        // Independent reader instances (config 'numParallelReaders'), each with its own prefetch thread.
+        std::vector<Pipeline> m_pipelines;
+        size_t m_nextPipeline;
+        bool m_deterministicParallelReaders;
     };
 }
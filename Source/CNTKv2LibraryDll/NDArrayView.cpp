@@ -8,6 +8,7 @@
 #include "Utils.h"
 #include "TensorView.h"
 #include "Matrix.h"
+#include "MatrixQuantizerImpl.h"
 #include <algorithm>
 #include "TensorShape.h"
 
@@ -214,33 +215,31 @@ namespace CNTK
 
     NDArrayViewPtr NDArrayView::DeepClone(const DeviceDescriptor& device, bool readOnly/* = false*/) const
     {
-        NDArrayViewPtr newView = MakeSharedObject<NDArrayView>(this->GetDataType(), this->GetStorageFormat(), this->Shape(), device);
-        switch (m_dataType)
-        {
-        case DataType::Float:
-        {
-            auto newMatrix = newView->GetWritableMatrix<float>();
-            auto thisMatrix = GetMatrix<float>();
-            newMatrix->AssignValuesOf(*thisMatrix);
-            break;
-        }
-        case DataType::Double:
-        {
-            auto newMatrix = newView->GetWritableMatrix<double>();
-            auto thisMatrix = GetMatrix<double>();
-            newMatrix->AssignValuesOf(*thisMatrix);
-            break;
-        }
-        default:
-            LogicError("Unsupported DataType %s", DataTypeName(m_dataType));
-            break;
-        }
+        NDArrayViewCopyEventPtr copyEvent;
+        auto newView = DeepCloneAsync(device, copyEvent, readOnly);
+        if (device != Device())
+            copyEvent->Wait();
+        return newView;
+    }
 
+    NDArrayViewPtr NDArrayView::DeepCloneAsync(const DeviceDescriptor& device, NDArrayViewCopyEventPtr& copyEvent, bool readOnly/* = false*/) const
+    {
+        NDArrayViewPtr newView = MakeSharedObject<NDArrayView>(this->GetDataType(), this->GetStorageFormat(), this->Shape(), device);
+        copyEvent = newView->CopyFromAsync(*this);
         newView->m_isReadOnly = readOnly;
         return newView;
     }
 
     void NDArrayView::CopyFrom(const NDArrayView& source)
+    {
+        auto copyEvent = CopyFromAsync(source);
+        if (source.Device() != Device())
+            copyEvent->Wait();
+    }
+
+    // Copies between GPUs go through Matrix::AssignPeerCopyOf(), which keeps the destination on its device and orders the copy
+    // with the work on both devices.
+    NDArrayViewCopyEventPtr NDArrayView::CopyFromAsync(const NDArrayView& source)
     {
         if ((source.Shape() != Shape()) && (AsTensorShape(source.Shape()) != AsTensorShape(Shape())))
             InvalidArgument("NDArrayView::CopyFrom: The 'source' view's shape must be same as the shape of this NDArrayView");
@@ -254,20 +253,34 @@ namespace CNTK
         {
             auto sourceMatrix = source.GetMatrix<float>();
             auto destMatrix = GetWritableMatrix<float>();
-            destMatrix->AssignValuesOf(*sourceMatrix);
+            destMatrix->AssignPeerCopyOf(*sourceMatrix);
             break;
         }
         case DataType::Double:
         {
             auto sourceMatrix = source.GetMatrix<double>();
             auto destMatrix = GetWritableMatrix<double>();
-            destMatrix->AssignValuesOf(*sourceMatrix);
+            destMatrix->AssignPeerCopyOf(*sourceMatrix);
             break;
         }
         default:
             LogicError("Unsupported DataType %s", DataTypeName(m_dataType));
             break;
         }
+
+        return MakeSharedObject<NDArrayViewCopyEvent>(Device());
+    }
+
+    NDArrayViewCopyEvent::NDArrayViewCopyEvent(const DeviceDescriptor& device)
+        : m_event(MatrixComputeStreamEvent::Create(AsCNTKImplDeviceId(device)))
+    {}
+
+    NDArrayViewCopyEvent::~NDArrayViewCopyEvent()
+    {}
+
+    void NDArrayViewCopyEvent::Wait() const
+    {
+        m_event->SynchronizeEvent();
     }
 
     NDArrayViewPtr NDArrayView::Alias(bool readOnly/* = false*/) const
@@ -0,0 +1,94 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+
+namespace CNTK
+{
+    // A user-defined Function whose computation is done by a NativeUserFunctionKernel (see NativeUserFunction()).
+    // It is only a placeholder in the Function graph: when the graph is compiled into a ComputationNetwork,
+    // the kernel is invoked by a NativeUserFunctionNode, without going through Forward()/Backward() and Value maps.
+    class NativeKernelFunction final : public Function
+    {
+        template <typename T, typename ...CtorArgTypes>
+        friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+    public:
+        BackPropStatePtr Forward(const std::unordered_map<Variable, ValuePtr>& /*arguments*/,
+                                 std::unordered_map<Variable, ValuePtr>& /*outputs*/,
+                                 const DeviceDescriptor& /*computeDevice*/,
+                                 const std::unordered_set<Variable>& /*outputsToRetainBackwardStateFor*/) override
+        {
+            LogicError("NativeUserFunction '%S': Forward can only be called on a composite Function containing it.", Name().c_str());
+        }
+
+        void Backward(const BackPropStatePtr& /*state*/,
+                      const std::unordered_map<Variable, ValuePtr>& /*rootGradientValues*/,
+                      std::unordered_map<Variable, ValuePtr>& /*backPropagatedGradientValuesForInputs*/) override
+        {
+            LogicError("NativeUserFunction '%S': Backward can only be called on a composite Function containing it.", Name().c_str());
+        }
+
+        const std::wstring& OpName() const override
+        {
+            static const std::wstring opName = L"NativeUserFunction";
+            return opName;
+        }
+
+        // The kernel is native code that cannot be restored when a model is loaded, so saving a model that contains
+        // the Function fails before anything is written.
+        Dictionary Serialize() const override
+        {
+            InvalidArgument("NativeUserFunction '%S': A Function with a native kernel cannot be saved, the kernel cannot be restored when the model is loaded.", Name().c_str());
+        }
+
+        size_t CurrentVersion() const override { return s_serializationVersion; }
+
+        const NativeUserFunctionKernelPtr& Kernel() const { return m_kernel; }
+
+    private:
+        NativeKernelFunction(const std::vector<Variable>& inputs, const NDShape& outputShape, const NativeUserFunctionKernelPtr& kernel, const std::wstring& name)
+            : Function(inputs, GetOutputVariables(inputs, outputShape), Dictionary(), name), m_kernel(kernel)
+        {}
+
+        std::vector<Variable> GetOutputVariables(const std::vector<Variable>& inputs, const NDShape& outputShape)
+        {
+            DataType dataType = DataType::Unknown;
+            std::vector<Axis> dynamicAxes;
+            bool dynamicAxesFound = false;
+            for (const auto& input : inputs)
+            {
+                if (input.GetDataType() != DataType::Unknown)
+                {
+                    if (dataType != DataType::Unknown && dataType != input.GetDataType())
+                        InvalidArgument("NativeUserFunction: All inputs must have the same DataType.");
+                    dataType = input.GetDataType();
+                }
+
+                if (!input.DynamicAxes().empty())
+                {
+                    if (dynamicAxesFound && dynamicAxes != input.DynamicAxes())
+                        InvalidArgument("NativeUserFunction: All inputs with dynamic axes must have the same dynamic axes.");
+                    dynamicAxes = input.DynamicAxes();
+                    dynamicAxesFound = true;
+                }
+            }
+
+            if (dataType == DataType::Unknown)
+                InvalidArgument("NativeUserFunction: The DataType of the output cannot be determined from the inputs.");
+            if (outputShape.IsUnknown() || outputShape.HasInferredDimension())
+                InvalidArgument("NativeUserFunction: The output shape must be fully specified.");
+
+            return { OutputVariable(outputShape, dataType, this, dynamicAxes) };
+        }
+
+        NativeUserFunctionKernelPtr m_kernel;
+
+        static const size_t s_serializationVersion = 1;
+    };
+}
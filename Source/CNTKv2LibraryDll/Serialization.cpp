@@ -6,6 +6,9 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Utils.h"
+#include "Serialization.h"
+#include "MemoryMappedFile.h"
+#include "ChunkCodec.h"
 #include <istream>
 #include <ostream>
 #include <string>
@@ -27,6 +30,13 @@ namespace CNTK
 {
 
     using namespace ::google::protobuf;
+    using Microsoft::MSR::CNTK::ChunkCodec;
+    using Microsoft::MSR::CNTK::CompressChunk;
+    using Microsoft::MSR::CNTK::DecompressChunk;
+    using Microsoft::MSR::CNTK::IsChunkCodecSupported;
+
+    class TensorSegmentWriter;
+    class TensorSegmentReader;
 
     class Serializer
     {
@@ -34,26 +44,30 @@ namespace CNTK
         friend std::istream& operator>>(std::istream&, Dictionary&);
         friend std::ostream& operator<<(std::ostream&, const DictionaryValue&);
         friend std::istream& operator>>(std::istream&, DictionaryValue&);
+        friend void SaveSegmented(const Dictionary&, const std::wstring&);
+        friend Dictionary LoadSegmented(const std::wstring&, std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile>*);
 
         friend class Dictionary;
         friend class DictionaryValue;
 
     private:
-        static proto::DictionaryValue* CreateProto(const DictionaryValue& src, Arena* arena = nullptr);
-        static proto::Dictionary* CreateProto(const Dictionary& src, Arena* arena = nullptr);
-        static proto::Vector* CreateProto(const std::vector<DictionaryValue>& src, Arena* arena = nullptr);
+        // With 'segments', the tensors that are large enough for a segment of their own are written to it,
+        // and the protobuf only references them (see SaveSegmented()).
+        static proto::DictionaryValue* CreateProto(const DictionaryValue& src, Arena* arena = nullptr, TensorSegmentWriter* segments = nullptr);
+        static proto::Dictionary* CreateProto(const Dictionary& src, Arena* arena = nullptr, TensorSegmentWriter* segments = nullptr);
+        static proto::Vector* CreateProto(const std::vector<DictionaryValue>& src, Arena* arena = nullptr, TensorSegmentWriter* segments = nullptr);
         static proto::NDArrayView* CreateProto(const NDArrayView& src, Arena* arena = nullptr);
         static proto::Axis* CreateProto(const Axis& src, Arena* arena = nullptr);
         static proto::NDShape* CreateProto(const NDShape& src, Arena* arena = nullptr);
 
-        static Dictionary* CreateFromProto(const proto::Dictionary& src);
-        static std::vector<DictionaryValue>* CreateFromProto(const proto::Vector& src);
+        static Dictionary* CreateFromProto(const proto::Dictionary& src, const TensorSegmentReader* segments = nullptr);
+        static std::vector<DictionaryValue>* CreateFromProto(const proto::Vector& src, const TensorSegmentReader* segments = nullptr);
         static NDArrayView* CreateFromProto(const proto::NDArrayView& src);
         static Axis* CreateFromProto(const proto::Axis& src);
         static NDShape* CreateFromProto(const proto::NDShape& src);
 
-        static void Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena = nullptr);
-        static void Copy(const proto::DictionaryValue& src, DictionaryValue& dst);
+        static void Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena = nullptr, TensorSegmentWriter* segments = nullptr);
+        static void Copy(const proto::DictionaryValue& src, DictionaryValue& dst, const TensorSegmentReader* segments = nullptr);
 
         static proto::NDArrayView::DataType ToProtoType(DataType type)
         {
@@ -133,6 +147,190 @@ namespace CNTK
 
     };
 
+    // Segmented format, for models and checkpoints whose tensors do not fit into one protobuf message (2GB), and
+    // that are written and read one tensor at a time instead of through a copy of the whole file in memory:
+    //
+    //   header | tensor segments, each at a multiple of SegmentAlignment | dictionary protobuf | segment table
+    //
+    // In the dictionary, each dense tensor of at least SegmentAlignment bytes is replaced by a reference
+    // { tensor_segment: index, data_type, shape } to its segment. The segments are stored as is or deflated.
+    // Uncompressed segments can be used in place from a memory mapping of the file, so that loading a parameter
+    // onto a device copies it once, from the page cache.
+    static const char segmentedFileMagic[8] = { 'C', 'N', 'T', 'K', 'S', 'E', 'G', 0 };
+    static const uint32_t segmentedFileVersion = 1;
+    static const size_t SegmentAlignment = 4096;
+    static const std::wstring tensorSegmentKey = L"tensor_segment";
+
+    struct SegmentedFileHeader
+    {
+        char m_magic[8];
+        uint32_t m_version;
+        uint32_t m_reserved;
+        uint64_t m_dictionaryOffset;
+        uint64_t m_dictionarySize;
+        uint64_t m_tableOffset;
+        uint64_t m_numSegments;
+    };
+
+    struct TensorSegment
+    {
+        uint64_t m_offset;
+        uint64_t m_storedSize; // (compressed)
+        uint64_t m_size;
+        int32_t m_codec;       // ChunkCodec
+        int32_t m_reserved;
+    };
+
+    class TensorSegmentWriter
+    {
+    public:
+        TensorSegmentWriter(std::ostream& stream, ChunkCodec codec) : m_stream(stream), m_codec(codec)
+        {
+            SegmentedFileHeader header = {};
+            m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+
+        static bool Accepts(const NDArrayView& view)
+        {
+            return !view.IsSparse() && (view.GetDataType() == DataType::Float || view.GetDataType() == DataType::Double) &&
+                   view.Shape().TotalSize() * DataTypeSize(view.GetDataType()) >= SegmentAlignment;
+        }
+
+        // Writes the data of 'view' as the next segment, and returns the reference to it.
+        Dictionary Write(const NDArrayView& view)
+        {
+            size_t size = view.Shape().TotalSize() * DataTypeSize(view.GetDataType());
+            const char* data = (view.GetDataType() == DataType::Float) ? reinterpret_cast<const char*>(view.DataBuffer<float>()) :
+                                                                         reinterpret_cast<const char*>(view.DataBuffer<double>());
+            Align();
+            TensorSegment segment = { (uint64_t)m_stream.tellp(), size, size, (int32_t)m_codec, 0 };
+            if (m_codec == ChunkCodec::None)
+            {
+                m_stream.write(data, size);
+            }
+            else
+            {
+                CompressChunk(m_codec, data, size, m_buffer);
+                m_stream.write(m_buffer.data(), m_buffer.size());
+                segment.m_storedSize = m_buffer.size();
+            }
+            m_segments.push_back(segment);
+
+            Dictionary reference;
+            reference[tensorSegmentKey] = m_segments.size() - 1;
+            reference[dataTypeKey] = (size_t)view.GetDataType();
+            reference[shapeKey] = view.Shape();
+            return reference;
+        }
+
+        // Writes the dictionary that references the segments, and the header.
+        void Finish(const proto::Dictionary& dictionary)
+        {
+            SegmentedFileHeader header = {};
+            memcpy(header.m_magic, segmentedFileMagic, sizeof(header.m_magic));
+            header.m_version = segmentedFileVersion;
+            header.m_dictionaryOffset = (uint64_t)m_stream.tellp();
+            if (!dictionary.SerializeToOstream(&m_stream))
+                RuntimeError("Failed to serialize the dictionary of a segmented file.");
+            header.m_dictionarySize = (uint64_t)m_stream.tellp() - header.m_dictionaryOffset;
+            header.m_tableOffset = (uint64_t)m_stream.tellp();
+            header.m_numSegments = m_segments.size();
+            if (!m_segments.empty())
+                m_stream.write(reinterpret_cast<const char*>(m_segments.data()), m_segments.size() * sizeof(TensorSegment));
+            m_stream.seekp(0);
+            m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            m_stream.seekp(0, std::ios_base::end);
+        }
+
+    private:
+        void Align()
+        {
+            static const char zeros[SegmentAlignment] = {};
+            size_t position = (size_t)m_stream.tellp();
+            if (position % SegmentAlignment != 0)
+                m_stream.write(zeros, SegmentAlignment - position % SegmentAlignment);
+        }
+
+        std::ostream& m_stream;
+        ChunkCodec m_codec;
+        std::vector<TensorSegment> m_segments;
+        std::vector<char> m_buffer; // compressed segment
+    };
+
+    class TensorSegmentReader
+    {
+    public:
+        // With 'inPlace', uncompressed tensors are read-only views of the mapping of the file, which must outlive them.
+        TensorSegmentReader(const std::wstring& filename, bool inPlace)
+            : m_filename(filename), m_file(std::make_shared<Microsoft::MSR::CNTK::MemoryMappedFile>(filename)), m_inPlace(inPlace)
+        {
+            if (m_file->GetSize() < sizeof(SegmentedFileHeader))
+                RuntimeError("Segmented file %ls is truncated.", m_filename.c_str());
+            memcpy(&m_header, m_file->GetData(), sizeof(m_header));
+            if (memcmp(m_header.m_magic, segmentedFileMagic, sizeof(segmentedFileMagic)) != 0)
+                RuntimeError("File %ls is not in the segmented format.", m_filename.c_str());
+            if (m_header.m_version > segmentedFileVersion)
+                RuntimeError("Segmented file %ls has version %d, this build reads up to version %d.", m_filename.c_str(), (int)m_header.m_version, (int)segmentedFileVersion);
+            if (!IsInFile(m_header.m_dictionaryOffset, m_header.m_dictionarySize) ||
+                m_header.m_numSegments > m_file->GetSize() / sizeof(TensorSegment) ||
+                !IsInFile(m_header.m_tableOffset, m_header.m_numSegments * sizeof(TensorSegment)))
+                RuntimeError("Segmented file %ls is corrupt or truncated.", m_filename.c_str());
+
+            m_segments.resize(m_header.m_numSegments);
+            if (!m_segments.empty())
+                memcpy(m_segments.data(), m_file->GetData() + m_header.m_tableOffset, m_segments.size() * sizeof(TensorSegment));
+            for (const auto& segment : m_segments)
+            {
+                if (!IsInFile(segment.m_offset, segment.m_storedSize))
+                    RuntimeError("Segmented file %ls is corrupt or truncated.", m_filename.c_str());
+            }
+        }
+
+        const char* DictionaryData() const { return m_file->GetData() + m_header.m_dictionaryOffset; }
+        size_t DictionarySize() const { return (size_t)m_header.m_dictionarySize; }
+        const std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile>& File() const { return m_file; }
+
+        static bool IsReference(const proto::Dictionary& dictionary)
+        {
+            return dictionary.data().find(ToString(tensorSegmentKey)) != dictionary.data().end();
+        }
+
+        // Returns the (CPU) tensor that 'reference' refers to.
+        NDArrayView* Read(const Dictionary& reference) const
+        {
+            size_t index = reference[tensorSegmentKey].Value<size_t>();
+            auto dataType = (DataType)reference[dataTypeKey].Value<size_t>();
+            const auto& shape = reference[shapeKey].Value<NDShape>();
+            if (index >= m_segments.size() || (dataType != DataType::Float && dataType != DataType::Double) ||
+                m_segments[index].m_size != shape.TotalSize() * DataTypeSize(dataType))
+                RuntimeError("Segmented file %ls references a tensor segment that does not exist or does not match.", m_filename.c_str());
+
+            const auto& segment = m_segments[index];
+            const char* data = m_file->GetData() + segment.m_offset;
+            if (m_inPlace && (ChunkCodec)segment.m_codec == ChunkCodec::None)
+                return new NDArrayView(dataType, shape, (const void*)data, (size_t)segment.m_size, DeviceDescriptor::CPUDevice());
+
+            NDArrayView* view = new NDArrayView(dataType, StorageFormat::Dense, shape, DeviceDescriptor::CPUDevice());
+            char* buffer = (dataType == DataType::Float) ? reinterpret_cast<char*>(view->WritableDataBuffer<float>()) :
+                                                           reinterpret_cast<char*>(view->WritableDataBuffer<double>());
+            DecompressChunk((ChunkCodec)segment.m_codec, data, (size_t)segment.m_storedSize, buffer, (size_t)segment.m_size);
+            m_file->DontNeed((size_t)segment.m_offset, (size_t)segment.m_storedSize);
+            return view;
+        }
+
+    private:
+        bool IsInFile(uint64_t offset, uint64_t size) const
+        {
+            return offset <= m_file->GetSize() && size <= m_file->GetSize() - offset;
+        }
+
+        std::wstring m_filename;
+        std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile> m_file;
+        bool m_inPlace;
+        SegmentedFileHeader m_header;
+        std::vector<TensorSegment> m_segments;
+    };
+
     /*static*/ proto::NDShape* Serializer::CreateProto(const NDShape& src, Arena* arena)
     {
         proto::NDShape* dst = (arena != nullptr) ? 
@@ -221,60 +419,60 @@ namespace CNTK
         return dst;
     }
 
-    /*static*/ proto::Vector* Serializer::CreateProto(const std::vector<DictionaryValue>& src, Arena* arena)
+    /*static*/ proto::Vector* Serializer::CreateProto(const std::vector<DictionaryValue>& src, Arena* arena, TensorSegmentWriter* segments)
     {
         proto::Vector* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::Vector>(arena) : new proto::Vector();
         dst->mutable_value()->Reserve((int)src.size());
         for (const auto& value : src)
         {
-            dst->mutable_value()->AddAllocated(CreateProto(value, arena));
+            dst->mutable_value()->AddAllocated(CreateProto(value, arena, segments));
         }
         return dst;
     }
 
-    /*static*/ std::vector<DictionaryValue>* Serializer::CreateFromProto(const proto::Vector& src)
+    /*static*/ std::vector<DictionaryValue>* Serializer::CreateFromProto(const proto::Vector& src, const TensorSegmentReader* segments)
     {
         std::vector<DictionaryValue>* dst = new std::vector<DictionaryValue>(src.value_size());
         for (auto i = 0; i < src.value_size(); ++i)
         {
-            Copy(src.value()[i], dst->at(i));
+            Copy(src.value()[i], dst->at(i), segments);
         }
         return dst;
     }
 
-    /*static*/ proto::Dictionary* Serializer::CreateProto(const Dictionary& src, Arena* arena)
+    /*static*/ proto::Dictionary* Serializer::CreateProto(const Dictionary& src, Arena* arena, TensorSegmentWriter* segments)
     {
         proto::Dictionary* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::Dictionary>(arena) : new proto::Dictionary();
         dst->set_version(src.s_version);
         for (const auto& kv : src)
         {
-            Copy(kv.second, dst->mutable_data()->operator[](ToString(kv.first)), arena);
+            Copy(kv.second, dst->mutable_data()->operator[](ToString(kv.first)), arena, segments);
         }
         return dst;
     }
 
-    /*static*/ Dictionary* Serializer::CreateFromProto(const proto::Dictionary& src)
+    /*static*/ Dictionary* Serializer::CreateFromProto(const proto::Dictionary& src, const TensorSegmentReader* segments)
     {
         Dictionary* dst = new Dictionary();
         for (const auto& kv : src.data())
         {
-            Copy(kv.second, dst->operator[](ToWString(kv.first)));
+            Copy(kv.second, dst->operator[](ToWString(kv.first)), segments);
         }
         return dst;
     }
 
-    /*static*/ proto::DictionaryValue* Serializer::CreateProto(const DictionaryValue& src, Arena* arena)
+    /*static*/ proto::DictionaryValue* Serializer::CreateProto(const DictionaryValue& src, Arena* arena, TensorSegmentWriter* segments)
     {
         proto::DictionaryValue* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::DictionaryValue>(arena) : new proto::DictionaryValue();
         dst->set_version(src.s_version);
-        Copy(src, *dst, arena);
+        Copy(src, *dst, arena, segments);
         return dst;
     }
 
-    /*static*/ void Serializer::Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena)
+    /*static*/ void Serializer::Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena, TensorSegmentWriter* segments)
     {
         auto valueType = src.ValueType();
         dst.set_value_type(ToProtoType(valueType));
@@ -308,20 +506,29 @@ namespace CNTK
             dst.set_allocated_axis_value(CreateProto(src.Value<Axis>(), arena));
             break;
         case DictionaryValue::Type::Vector:
-            dst.set_allocated_vector_value(CreateProto(src.Value<std::vector<DictionaryValue>>(), arena));
+            dst.set_allocated_vector_value(CreateProto(src.Value<std::vector<DictionaryValue>>(), arena, segments));
             break;
         case DictionaryValue::Type::Dictionary:
-            dst.set_allocated_dictionary_value(CreateProto(src.Value<Dictionary>(), arena));
+            dst.set_allocated_dictionary_value(CreateProto(src.Value<Dictionary>(), arena, segments));
             break;
         case DictionaryValue::Type::NDArrayView:
-            dst.set_allocated_nd_array_view_value(CreateProto(src.Value<NDArrayView>(), arena));
+            if (segments != nullptr && TensorSegmentWriter::Accepts(src.Value<NDArrayView>()))
+            {
+                // written to a segment, and replaced by a reference to it
+                dst.set_value_type(ToProtoType(DictionaryValue::Type::Dictionary));
+                dst.set_allocated_dictionary_value(CreateProto(segments->Write(src.Value<NDArrayView>()), arena));
+            }
+            else
+            {
+                dst.set_allocated_nd_array_view_value(CreateProto(src.Value<NDArrayView>(), arena));
+            }
             break;
         default:
             NOT_IMPLEMENTED
         }
     }
 
-    /*static*/ void Serializer::Copy(const proto::DictionaryValue& src, DictionaryValue& dst)
+    /*static*/ void Serializer::Copy(const proto::DictionaryValue& src, DictionaryValue& dst, const TensorSegmentReader* segments)
     {
         auto valueType = src.value_type();
 
@@ -360,10 +567,19 @@ namespace CNTK
             dst.m_data.m_ptr = CreateFromProto(src.axis_value());
             break;
         case proto::DictionaryValue::Vector:
-            dst.m_data.m_ptr = CreateFromProto(src.vector_value());
+            dst.m_data.m_ptr = CreateFromProto(src.vector_value(), segments);
             break;
         case proto::DictionaryValue::Dictionary:
-            dst.m_data.m_ptr = CreateFromProto(src.dictionary_value());
+            if (segments != nullptr && TensorSegmentReader::IsReference(src.dictionary_value()))
+            {
+                std::unique_ptr<Dictionary> reference(CreateFromProto(src.dictionary_value()));
+                dst.m_valueType = DictionaryValue::Type::NDArrayView;
+                dst.m_data.m_ptr = segments->Read(*reference);
+            }
+            else
+            {
+                dst.m_data.m_ptr = CreateFromProto(src.dictionary_value(), segments);
+            }
             break;
         case proto::DictionaryValue::NDArrayView:
             dst.m_data.m_ptr = CreateFromProto(src.nd_array_view_value());
@@ -472,8 +688,104 @@ namespace CNTK
         return stream;
     }
 
+    // The dense tensor data in 'value', in bytes.
+    static size_t TensorDataSize(const DictionaryValue& value)
+    {
+        size_t size = 0;
+        if (value.ValueType() == DictionaryValue::Type::NDArrayView)
+        {
+            const auto& view = value.Value<NDArrayView>();
+            if (!view.IsSparse())
+                size = view.Shape().TotalSize() * DataTypeSize(view.GetDataType());
+        }
+        else if (value.ValueType() == DictionaryValue::Type::Vector)
+        {
+            for (const auto& element : value.Value<std::vector<DictionaryValue>>())
+                size += TensorDataSize(element);
+        }
+        else if (value.ValueType() == DictionaryValue::Type::Dictionary)
+        {
+            for (const auto& kv : value.Value<Dictionary>())
+                size += TensorDataSize(kv.second);
+        }
+        return size;
+    }
+
+    bool ShouldSaveSegmented(const Dictionary& dictionary)
+    {
+        // well below the 2GB of a protobuf message, which is also built in memory in full before it is written
+        const size_t maxProtobufTensorDataSize = (size_t)1 << 30;
+        if (Internal::IsSegmentedModelFormatEnabled())
+            return true;
+        size_t size = 0;
+        for (const auto& kv : dictionary)
+        {
+            size += TensorDataSize(kv.second);
+            if (size > maxProtobufTensorDataSize)
+                return true;
+        }
+        return false;
+    }
+
+    bool IsSegmentedFile(std::istream& stream)
+    {
+        char magic[sizeof(segmentedFileMagic)] = {};
+        const auto position = stream.tellg();
+        stream.read(magic, sizeof(magic));
+        bool isSegmented = stream.gcount() == sizeof(magic) && memcmp(magic, segmentedFileMagic, sizeof(magic)) == 0;
+        stream.clear();
+        stream.seekg(position);
+        return isSegmented;
+    }
+
+    void SaveSegmented(const Dictionary& dictionary, const std::wstring& filename)
+    {
+        UsingUTF8 locale;
+        auto codec = Internal::ShouldCompressModelTensors() ? ChunkCodec::Deflate : ChunkCodec::None;
+        if (!IsChunkCodecSupported(codec))
+            RuntimeError("Cannot compress the tensors of %ls: this build has no zlib support.", filename.c_str());
+
+        auto stream = GetFstream(filename, false);
+        TensorSegmentWriter segments(*stream, codec);
+        Arena arena;
+        proto::Dictionary* proto(Serializer::CreateProto(dictionary, &arena, &segments));
+        segments.Finish(*proto);
+        stream->flush();
+    }
+
+    Dictionary LoadSegmented(const std::wstring& filename, std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile>* mapping)
+    {
+        UsingUTF8 locale;
+        TensorSegmentReader segments(filename, /*inPlace=*/mapping != nullptr);
+        if (segments.DictionarySize() > INT_MAX)
+            RuntimeError("The dictionary of segmented file %ls is too large.", filename.c_str());
+
+        Arena arena;
+        proto::Dictionary* proto = Arena::CreateMessage<proto::Dictionary>(&arena);
+        io::ArrayInputStream raw_input(segments.DictionaryData(), (int)segments.DictionarySize());
+        io::CodedInputStream coded_input(&raw_input);
+        if (!ParseMessage(coded_input, *proto))
+            RuntimeError("Failed to parse the dictionary of segmented file %ls.", filename.c_str());
+
+        Dictionary dictionary;
+        for (const auto& kv : proto->data())
+        {
+            Serializer::Copy(kv.second, dictionary[ToWString(kv.first)], &segments);
+        }
+
+        if (mapping != nullptr)
+            *mapping = segments.File();
+        return dictionary;
+    }
+
     void Dictionary::Save(const std::wstring& filename)
     {
+        if (ShouldSaveSegmented(*this))
+        {
+            SaveSegmented(*this, filename);
+            return;
+        }
+
         UsingUTF8 locale;
         auto fd = GetFileDescriptor(filename, false);
         Arena arena;
@@ -488,6 +800,9 @@ namespace CNTK
 
     /*static*/ Dictionary Dictionary::Load(const std::wstring& filename)
     {
+        if (IsSegmentedFile(*GetFstream(filename, true)))
+            return LoadSegmented(filename);
+
         UsingUTF8 locale;
         Arena arena;
         proto::Dictionary* proto = Arena::CreateMessage<proto::Dictionary>(&arena);
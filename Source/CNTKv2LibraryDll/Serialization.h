@@ -9,6 +9,10 @@
 #include "CNTKLibrary.h"
 #include "Utils.h"
 
+namespace Microsoft { namespace MSR { namespace CNTK {
+    class MemoryMappedFile;
+}}}
+
 namespace CNTK
 {
     const std::wstring versionKey = L"version";
@@ -37,6 +41,15 @@ namespace CNTK
     const std::wstring rngSeedKey = L"rng_seed";
     const std::wstring rngOffsetKey = L"rng_offset";
 
+    // Dictionaries with tensors beyond what one protobuf message can hold, in the segmented format (see Serialization.cpp).
+    // Used for models and trainer checkpoints when ShouldSaveSegmented(); IsSegmentedFile() leaves the stream position unchanged.
+    bool ShouldSaveSegmented(const Dictionary& dictionary);
+    bool IsSegmentedFile(std::istream& stream);
+    void SaveSegmented(const Dictionary& dictionary, const std::wstring& filename);
+    // With 'mapping', uncompressed tensors are read-only views of a memory mapping of the file, which it keeps alive
+    // and which must outlive them (e.g. while the model is deserialized onto its device); otherwise they are copied.
+    Dictionary LoadSegmented(const std::wstring& filename, std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile>* mapping = nullptr);
+
     template <typename T> 
     inline std::string GetVersionsString(size_t currentVersion, size_t dictVersion)
     {
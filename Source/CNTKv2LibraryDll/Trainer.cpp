@@ -6,7 +6,11 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Utils.h"
+#include "Serialization.h"
 #include "Learner.h"
+#include "LossScaling.h"
+#include "PerformanceCounters.h"
+#include <cmath>
 namespace
 {
     const std::wstring learnersPropertyName = L"Learners";
@@ -25,7 +29,10 @@ namespace CNTK
           m_evaluationFunction(evaluationFunction),
           m_parameterLearners(std::make_shared<Learners>(parameterLearners)),
           m_prevMinibatchNumSamples(1),
-          m_distributed(false)
+          m_distributed(false),
+          m_numAccumulationMicroBatches(1),
+          m_numAccumulatedMicroBatches(0),
+          m_accumulatedNumSamples(0)
     {
         // By default we set the number of threads to hardware concurrency.
         if (!Internal::MaxNumCPUThreadsSet())
@@ -137,9 +144,34 @@ namespace CNTK
 
     bool Trainer::TrainMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice /*= DeviceDescriptor::UseDefaultDevice()*/)
     {
-        if (!m_distributed)
-            return TrainLocalMinibatch(arguments, outputsToFetch, computeDevice);
-        return TrainDistributedMinibatch(arguments, outputsToFetch, computeDevice);
+        auto& performanceCounters = Microsoft::MSR::CNTK::PerformanceCounters::Instance();
+        performanceCounters.BeginMinibatch();
+        bool continueTraining;
+        if (m_numAccumulationMicroBatches > 1)
+            continueTraining = TrainAccumulatedMinibatch(arguments, outputsToFetch, computeDevice);
+        else if (!m_distributed)
+            continueTraining = TrainLocalMinibatch(arguments, outputsToFetch, computeDevice);
+        else
+            continueTraining = TrainDistributedMinibatch(arguments, outputsToFetch, computeDevice);
+        performanceCounters.EndMinibatch(m_prevMinibatchNumSamples);
+        return continueTraining;
+    }
+
+    MinibatchMetricsFuturePtr Trainer::TrainMinibatchAsync(const std::unordered_map<Variable, ValuePtr>& arguments, const DeviceDescriptor& computeDevice /*= DeviceDescriptor::UseDefaultDevice()*/)
+    {
+        bool emptyMinibatch = arguments.empty() || (arguments.begin()->second == nullptr);
+        std::unordered_map<Variable, ValuePtr> outputsToFetch = {};
+        bool continueTraining = TrainMinibatch(arguments, outputsToFetch, computeDevice);
+        if (emptyMinibatch && !m_distributed) // nothing was trained
+            return MakeSharedObject<MinibatchMetricsFuture>(continueTraining, 0, nullptr, nullptr, m_evaluationFunction != nullptr);
+
+        // The aggregate values alias the network's output buffers, which the next minibatch overwrites.
+        // Snapshot them with a copy on the device, which is queued like everything else.
+        auto snapshot = [](const ValuePtr& value) { return value ? value->Data()->DeepClone(/*readOnly =*/ true) : nullptr; };
+        return MakeSharedObject<MinibatchMetricsFuture>(continueTraining, m_prevMinibatchNumSamples,
+                                                        snapshot(m_prevMinibatchAggregateTrainingLossValue),
+                                                        m_evaluationFunction ? snapshot(m_prevMinibatchAggregateEvalCriterionValue) : nullptr,
+                                                        m_evaluationFunction != nullptr);
     }
 
     bool Trainer::TrainLocalMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice /*= DeviceDescriptor::UseDefaultDevice()*/)
@@ -154,6 +186,11 @@ namespace CNTK
         std::unordered_map<Parameter, NDArrayViewPtr> gradients;
         for (const auto& parameter : m_combinedTrainingFunction->Parameters())
             gradients[parameter] = parameterGradients[parameter]->Data();
+
+        // A minibatch skipped because of overflowing gradients does not end the learning.
+        if (!UnscaleGradients(gradients))
+            return true;
+
         return m_parameterLearners->Update(gradients, m_prevMinibatchNumSamples);
     }
 
@@ -180,6 +217,7 @@ namespace CNTK
             ExecuteForwardBackward(arguments, outputsToFetch, computeDevice, parameterGradients);
             for (const auto& parameter : modelParameters)
                 gradients[parameter] = parameterGradients[parameter]->Data();
+            UnscaleGradients(gradients); // static scaling only, so that all workers take the same decision
             trainingLoss = m_prevMinibatchAggregateTrainingLossValue->Data();
             evalCriterion = m_prevMinibatchAggregateEvalCriterionValue->Data();
         }
@@ -198,6 +236,128 @@ namespace CNTK
         return updated;
     }
 
+    void Trainer::SetGradientAccumulation(size_t numMicroBatches)
+    {
+        if (numMicroBatches == 0)
+            InvalidArgument("Trainer::SetGradientAccumulation: The number of micro-batches must be at least 1.");
+        if (m_numAccumulatedMicroBatches > 0)
+            LogicError("Trainer::SetGradientAccumulation: Cannot change the number of micro-batches while gradients are being accumulated.");
+
+        m_numAccumulationMicroBatches = numMicroBatches;
+        if (numMicroBatches == 1)
+        {
+            m_accumulatedGradients.clear();
+            m_accumulatedTrainingLoss = nullptr;
+            m_accumulatedEvalCriterion = nullptr;
+        }
+    }
+
+    // target = source (if 'assign') or target += source; target is allocated dense, like source, on first use
+    /*static*/ void Trainer::AccumulateInto(NDArrayViewPtr& target, const NDArrayViewPtr& source, bool assign)
+    {
+        if (!target)
+            target = MakeSharedObject<NDArrayView>(source->GetDataType(), source->Shape(), source->Device());
+
+        if (assign && !source->IsSparse())
+        {
+            target->CopyFrom(*source);
+            return;
+        }
+
+        if (source->GetDataType() == DataType::Float)
+        {
+            auto& targetMatrix = *target->GetWritableMatrix<float>();
+            if (assign)
+                targetMatrix.SetValue(0);
+            Microsoft::MSR::CNTK::Matrix<float>::ScaleAndAdd(1, *source->GetMatrix<float>(), targetMatrix);
+        }
+        else
+        {
+            auto& targetMatrix = *target->GetWritableMatrix<double>();
+            if (assign)
+                targetMatrix.SetValue(0);
+            Microsoft::MSR::CNTK::Matrix<double>::ScaleAndAdd(1, *source->GetMatrix<double>(), targetMatrix);
+        }
+    }
+
+    // Accumulates the gradients of micro-batches and updates on every m_numAccumulationMicroBatches-th call, so that the
+    // aggregation across workers (and the learners) run once per accumulated minibatch. Memory is that of one micro-batch,
+    // plus one gradient-sized buffer per parameter.
+    bool Trainer::TrainAccumulatedMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice)
+    {
+        bool emptyMinibatch = arguments.empty() || (arguments.begin()->second == nullptr);
+        if (!emptyMinibatch)
+        {
+            std::unordered_map<Variable, ValuePtr> parameterGradients;
+            ExecuteForwardBackward(arguments, outputsToFetch, computeDevice, parameterGradients);
+
+            // the first micro-batch since the last update overwrites the buffers
+            bool assign = m_accumulatedNumSamples == 0;
+            for (const auto& parameter : m_combinedTrainingFunction->Parameters())
+                AccumulateInto(m_accumulatedGradients[parameter], parameterGradients[parameter]->Data(), assign);
+            AccumulateInto(m_accumulatedTrainingLoss, m_prevMinibatchAggregateTrainingLossValue->Data(), assign);
+            if (m_aggregatedEvaluationFunction)
+                AccumulateInto(m_accumulatedEvalCriterion, m_prevMinibatchAggregateEvalCriterionValue->Data(), assign);
+            m_accumulatedNumSamples += m_prevMinibatchNumSamples;
+        }
+        else if (!m_distributed)
+        {
+            // end of the data: a partial accumulation is still applied
+            return m_accumulatedNumSamples > 0 ? UpdateFromAccumulatedGradients(/*atEndOfData=*/true) : false;
+        }
+
+        // With distributed learners, empty micro-batches count as well, so that all workers aggregate on the same call.
+        if (++m_numAccumulatedMicroBatches < m_numAccumulationMicroBatches)
+            return true;
+        return UpdateFromAccumulatedGradients(emptyMinibatch);
+    }
+
+    bool Trainer::UpdateFromAccumulatedGradients(bool atEndOfData)
+    {
+        size_t numSamples = m_accumulatedNumSamples;
+        m_numAccumulatedMicroBatches = 0;
+        m_accumulatedNumSamples = 0;
+
+        // from here on, the previous minibatch is the accumulated one
+        std::unordered_map<Parameter, NDArrayViewPtr> gradients;
+        for (const auto& parameter : m_combinedTrainingFunction->Parameters())
+            gradients[parameter] = numSamples > 0 ? m_accumulatedGradients.at(parameter) : nullptr;
+        m_prevMinibatchNumSamples = numSamples;
+        if (numSamples > 0)
+        {
+            m_prevMinibatchAggregateTrainingLossValue = MakeSharedObject<Value>(m_accumulatedTrainingLoss);
+            if (m_accumulatedEvalCriterion)
+                m_prevMinibatchAggregateEvalCriterionValue = MakeSharedObject<Value>(m_accumulatedEvalCriterion);
+        }
+
+        if (!m_distributed)
+        {
+            // A minibatch skipped because of overflowing gradients does not end the learning.
+            if (!UnscaleGradients(gradients))
+                return true;
+            return m_parameterLearners->Update(gradients, numSamples);
+        }
+
+        NDArrayViewPtr trainingLoss = nullptr;
+        NDArrayViewPtr evalCriterion = nullptr;
+        if (numSamples > 0)
+        {
+            UnscaleGradients(gradients); // static scaling only, so that all workers take the same decision
+            trainingLoss = m_accumulatedTrainingLoss;
+            evalCriterion = m_accumulatedEvalCriterion;
+        }
+
+        MinibatchInfo info { atEndOfData, numSamples, trainingLoss, evalCriterion };
+        bool updated = m_parameterLearners->Update(gradients, info);
+        m_prevMinibatchNumSamples = info.numberOfSamples;
+        if (numSamples == 0)
+        {
+            m_prevMinibatchAggregateEvalCriterionValue = std::make_shared<Value>(info.evalCriterionValue);
+            m_prevMinibatchAggregateTrainingLossValue = std::make_shared<Value>(info.trainingLossValue);
+        }
+        return updated;
+    }
+
     void Trainer::ExecuteForwardBackward(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice, std::unordered_map<Variable, ValuePtr>& parameterGradients)
     {
         std::unordered_map<Variable, ValuePtr> outputs = { { m_aggregatedLossFunction, nullptr }, { m_trainingSampleCountVar, nullptr } };
@@ -226,10 +386,11 @@ namespace CNTK
             m_rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(m_aggregatedLossFunction->Output().GetDataType(), m_prevMinibatchAggregateTrainingLossValue->Shape(), computeDevice), outputs.at(m_aggregatedLossFunction)->Mask());
         }
 
+        double rootGradient = LossScale();
         if (m_aggregatedLossFunction->Output().GetDataType() == DataType::Float)
-            m_rootGradientValue->Data()->SetValue(1.0f);
+            m_rootGradientValue->Data()->SetValue((float)rootGradient);
         else
-            m_rootGradientValue->Data()->SetValue(1.0);
+            m_rootGradientValue->Data()->SetValue(rootGradient);
 
         auto modelParameters = m_combinedTrainingFunction->Parameters();
         for (const auto& parameter : modelParameters)
@@ -242,6 +403,72 @@ namespace CNTK
         m_prevMinibatchNumSamples = GetSampleCount(m_trainingSampleCountVar, outputs[m_trainingSampleCountVar]);
     }
 
+    void Trainer::SetLossScaling(double initialScale, bool dynamic /*= false*/, size_t window /*= 2000*/)
+    {
+        if (initialScale < 1)
+            InvalidArgument("Trainer::SetLossScaling: The loss scale must be at least 1.");
+        if (dynamic && m_distributed)
+            InvalidArgument("Trainer::SetLossScaling: Dynamic loss scaling is not supported with distributed learners.");
+
+        m_lossScaling = std::make_shared<Microsoft::MSR::CNTK::LossScaling>(initialScale, dynamic, window);
+    }
+
+    double Trainer::LossScale() const
+    {
+        return m_lossScaling ? m_lossScaling->GetScale() : 1.0;
+    }
+
+    template <typename ElementType>
+    static bool IsFinite(const Microsoft::MSR::CNTK::Matrix<ElementType>& gradient)
+    {
+        // A single non-finite element makes the sum of all absolute values non-finite.
+        return std::isfinite((double)gradient.SumOfAbsElements());
+    }
+
+    bool Trainer::UnscaleGradients(std::unordered_map<Parameter, NDArrayViewPtr>& gradients)
+    {
+        if (!m_lossScaling || !m_lossScaling->IsEnabled())
+            return true;
+
+        bool gradientsAreFinite = true;
+        if (m_lossScaling->IsDynamic())
+        {
+            for (const auto& gradient : gradients)
+            {
+                if (!gradient.second)
+                    continue;
+
+                bool isFinite = gradient.second->GetDataType() == DataType::Float ?
+                    IsFinite(*gradient.second->GetMatrix<float>()) :
+                    IsFinite(*gradient.second->GetMatrix<double>());
+                if (!isFinite)
+                {
+                    gradientsAreFinite = false;
+                    break;
+                }
+            }
+        }
+
+        double scale = m_lossScaling->GetScale();
+        if (!m_lossScaling->Update(gradientsAreFinite))
+            return false;
+
+        if (scale != 1)
+        {
+            for (const auto& gradient : gradients)
+            {
+                if (!gradient.second)
+                    continue;
+
+                if (gradient.second->GetDataType() == DataType::Float)
+                    Microsoft::MSR::CNTK::Matrix<float>::Scale((float)(1 / scale), *gradient.second->GetWritableMatrix<float>());
+                else
+                    Microsoft::MSR::CNTK::Matrix<double>::Scale(1 / scale, *gradient.second->GetWritableMatrix<double>());
+            }
+        }
+        return true;
+    }
+
     static std::wstring GetTrainerStateCheckpointFilePath(const std::wstring& modelFilePath)
     {
         const wchar_t* checkpointExt = L".ckp";
@@ -283,6 +510,12 @@ namespace CNTK
 
         m_combinedTrainingFunction->SaveModel(modelFilePath);
         std::wstring trainerStateCheckpointFilePath = GetTrainerStateCheckpointFilePath(modelFilePath);
+        if (ShouldSaveSegmented(state))
+        {
+            SaveSegmented(state, trainerStateCheckpointFilePath);
+            return;
+        }
+
         auto ckpStream = GetFstream(trainerStateCheckpointFilePath, false);
         *ckpStream << state;
         ckpStream->flush();
@@ -296,11 +529,18 @@ namespace CNTK
         std::wstring trainerStateCheckpointFilePath = GetTrainerStateCheckpointFilePath(modelFilePath);
         auto ckpStream = GetFstream(trainerStateCheckpointFilePath, true);
         Dictionary checkpoint;
-        *ckpStream >> checkpoint;
+        if (IsSegmentedFile(*ckpStream))
+            checkpoint = LoadSegmented(trainerStateCheckpointFilePath);
+        else
+            *ckpStream >> checkpoint;
 
         auto learnerState = checkpoint[learnersPropertyName].Value<std::vector<DictionaryValue>>();
         auto externalState = checkpoint[externalStatePropertyName].Value<Dictionary>();
 
+        // micro-batches accumulated before the restore do not belong to the restored state
+        m_numAccumulatedMicroBatches = 0;
+        m_accumulatedNumSamples = 0;
+
         if (!m_distributed)
         {
             m_parameterLearners->RestoreFromCheckpoint(learnerState);
@@ -332,6 +572,22 @@ namespace CNTK
         return (GetScalarValue(m_prevMinibatchAggregateEvalCriterionValue) / m_prevMinibatchNumSamples);
     }
 
+    double MinibatchMetricsFuture::LossAverage() const
+    {
+        if (!m_aggregateTrainingLoss)
+            return std::numeric_limits<double>::quiet_NaN(); // empty minibatch
+        return (GetScalarValue(MakeSharedObject<Value>(m_aggregateTrainingLoss)) / m_numSamples);
+    }
+
+    double MinibatchMetricsFuture::EvaluationAverage() const
+    {
+        if (!m_hasEvaluationFunction)
+            InvalidArgument("MinibatchMetricsFuture::EvaluationAverage: Cannot get evaluation criterion value when no evaluation function was specified during the trainer's construction");
+        if (!m_aggregateEvalCriterion)
+            return std::numeric_limits<double>::quiet_NaN(); // empty minibatch
+        return (GetScalarValue(MakeSharedObject<Value>(m_aggregateEvalCriterion)) / m_numSamples);
+    }
+
     const std::vector<LearnerPtr>& Trainer::ParameterLearners() const
     {
         return m_parameterLearners->ParameterLearners();
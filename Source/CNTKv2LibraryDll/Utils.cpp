@@ -16,6 +16,7 @@
 #include <fcntl.h>
 #include "PrimitiveFunction.h"
 #include "RecurrentNodes.h"
+#include "GPUMatrix.h"
 
 using namespace std;
 using namespace Microsoft::MSR::CNTK;
@@ -814,6 +815,28 @@ namespace CNTK
 
         return GetValueObjectFromCNTKImplMatrixAndMBLayout(var.Shape(), matrix, layout, readOnly);
     }
+
+    template <typename ElementType>
+    NDArrayViewPtr Utils::GetNDArrayViewAliasingCNTKImplMatrix(const NDShape& shape, const Matrix<ElementType>& matrix, bool readOnly)
+    {
+        if (shape.TotalSize() != matrix.GetNumElements())
+            LogicError("The shape %S does not match the number of elements (%d) of the matrix", AsStringForErrorReporting(shape).c_str(), (int)matrix.GetNumElements());
+
+        auto tensorView = new TensorView<ElementType>(std::make_shared<Matrix<ElementType>>(matrix.AsReference()), AsTensorViewShape(shape));
+        return MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), AsDeviceDescriptor(matrix.GetDeviceId()), AsStorageFormat(matrix.GetFormat()), shape, readOnly, tensorView);
+    }
+
+    /*static*/ void* Utils::GetComputeStream(const DeviceDescriptor& device)
+    {
+#ifndef CPUONLY
+        if (device.Type() == DeviceKind::GPU)
+            return ::GetStream();
+#else
+        UNUSED(device);
+#endif
+        return nullptr;
+    }
+
     template void DictionaryValue::AllocateDataPtr<NDShape>(const NDShape& value);
     template void DictionaryValue::AllocateDataPtr<Axis>(const Axis& value);
     template void DictionaryValue::AllocateDataPtr<vector<DictionaryValue>>(const vector<DictionaryValue>& value);
@@ -930,4 +953,7 @@ namespace CNTK
 
     template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(const Variable& var, const Matrix<float>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/);
     template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(const Variable& var, const Matrix<double>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/);
+
+    template NDArrayViewPtr Utils::GetNDArrayViewAliasingCNTKImplMatrix<float>(const NDShape& shape, const Matrix<float>& matrix, bool readOnly);
+    template NDArrayViewPtr Utils::GetNDArrayViewAliasingCNTKImplMatrix<double>(const NDShape& shape, const Matrix<double>& matrix, bool readOnly);
 }
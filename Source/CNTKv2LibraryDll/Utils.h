@@ -546,5 +546,12 @@ namespace CNTK
 
         template <typename ElementType>
         static ValuePtr GetValueObjectFromCNTKImplMatrixAndMBLayout(const Variable& var, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, bool readOnly = true);
+
+        // NDArrayView of the specified shape over the buffer of 'matrix' (no copy); only valid until the matrix is reallocated
+        template <typename ElementType>
+        static NDArrayViewPtr GetNDArrayViewAliasingCNTKImplMatrix(const NDShape& shape, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, bool readOnly);
+
+        // the CUDA stream (cudaStream_t) the engine computes on for 'device', or null for the CPU
+        static void* GetComputeStream(const DeviceDescriptor& device);
     };
 }
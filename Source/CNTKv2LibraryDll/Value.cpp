@@ -15,6 +15,9 @@
 #include "Value.h"
 #include "Matrix.h"
 #include "CPUSparseMatrix.h"
+#include "DataTransferer.h"
+#include <map>
+#include <mutex>
 
 namespace CNTK
 {
@@ -312,6 +315,172 @@ namespace CNTK
         return Create(sampleShape, sequencesData, sequenceStartFlags, device, readOnly, /*createNewCopy =*/ true);
     }
 
+    // Uploads from caller buffers share one transferer per GPU; its copy stream orders them, so waiting for the
+    // latest recorded copy also covers all earlier ones.
+    static std::mutex s_uploadMutex;
+
+    // Must be called under s_uploadMutex.
+    static Microsoft::MSR::CNTK::DataTransfererPtr GetUploadTransferer(const DeviceDescriptor& device)
+    {
+        // Intentionally leaked: the transferers must not be destroyed after the CUDA runtime has shut down.
+        static auto* transferers = new std::map<int, Microsoft::MSR::CNTK::DataTransfererPtr>();
+        auto deviceId = AsCNTKImplDeviceId(device);
+        auto& transferer = (*transferers)[deviceId];
+        if (!transferer)
+            transferer = Microsoft::MSR::CNTK::CreatePrefetchDataTransferer(deviceId);
+
+        return transferer;
+    }
+
+    static size_t ValidatePackedSequenceLengths(const std::vector<size_t>& sequenceLengths, size_t& maxSequenceLength)
+    {
+        if (sequenceLengths.empty())
+            InvalidArgument("Value::CreateFromPackedBuffer: The number of sequences is 0");
+
+        size_t numSamples = 0;
+        maxSequenceLength = 0;
+        for (auto sequenceLength : sequenceLengths)
+        {
+            numSamples += sequenceLength;
+            maxSequenceLength = std::max(maxSequenceLength, sequenceLength);
+        }
+
+        if (maxSequenceLength == 0)
+            InvalidArgument("Value::CreateFromPackedBuffer: All the sequences are empty");
+
+        return numSamples;
+    }
+
+    template <typename ElementType>
+    /*static*/ ValuePtr Value::CreateFromPackedBuffer(const NDShape& sampleShape, ElementType* packedData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/)
+    {
+        if (packedData == nullptr)
+            InvalidArgument("Value::CreateFromPackedBuffer: The data buffer is null");
+
+        size_t maxSequenceLength;
+        auto numSamples = ValidatePackedSequenceLengths(sequenceLengths, maxSequenceLength);
+        auto numSequences = sequenceLengths.size();
+        auto sampleSize = sampleShape.TotalSize();
+        auto valueDataShape = sampleShape.AppendShape({ maxSequenceLength, numSequences });
+        auto deviceValueMask = CreateMask(sequenceLengths, sequenceStartFlags, DeviceDescriptor::CPUDevice());
+
+        // Without a mask, all the sequences have the same length and the buffer is laid out exactly like the Value
+        bool isPadded = (numSamples != (maxSequenceLength * numSequences));
+        if (device == DeviceDescriptor::CPUDevice())
+        {
+            NDArrayViewPtr valueData;
+            if (!isPadded)
+                valueData = MakeSharedObject<NDArrayView>(valueDataShape, packedData, numSamples * sampleSize, device, readOnly);
+            else
+            {
+                valueData = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), valueDataShape, device);
+                auto dataBuffer = valueData->WritableDataBuffer<ElementType>();
+                const ElementType* currentSequenceBuffer = packedData;
+                for (size_t i = 0; i < numSequences; ++i)
+                {
+                    auto currentSequenceSizeInElements = sequenceLengths[i] * sampleSize;
+                    std::copy(currentSequenceBuffer, currentSequenceBuffer + currentSequenceSizeInElements, dataBuffer + (maxSequenceLength * sampleSize * i));
+                    currentSequenceBuffer += currentSequenceSizeInElements;
+                }
+
+                if (readOnly)
+                    valueData = valueData->Alias(readOnly);
+            }
+
+            return MakeSharedObject<Value>(valueData, deviceValueMask);
+        }
+
+        // The padding is done by the copies themselves, one per sequence, directly from the caller's buffer
+        NDArrayViewPtr valueData = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), valueDataShape, device);
+        auto deviceBuffer = valueData->GetWritableMatrix<ElementType>()->Data();
+        Microsoft::MSR::CNTK::DataTransfererPtr transferer;
+        {
+            std::lock_guard<std::mutex> lock(s_uploadMutex);
+            transferer = GetUploadTransferer(device);
+
+            // The allocation of the destination may still be pending on the compute stream
+            transferer->RecordComputeStreamSyncPoint();
+            transferer->WaitForSyncPointOnAssignStreamAsync();
+            if (!isPadded)
+                transferer->CopyCPUToGPUAsync(packedData, numSamples * sampleSize, sizeof(ElementType), deviceBuffer);
+            else
+            {
+                const ElementType* currentSequenceBuffer = packedData;
+                for (size_t i = 0; i < numSequences; ++i)
+                {
+                    auto currentSequenceSizeInElements = sequenceLengths[i] * sampleSize;
+                    if (currentSequenceSizeInElements > 0)
+                        transferer->CopyCPUToGPUAsync(currentSequenceBuffer, currentSequenceSizeInElements, sizeof(ElementType), deviceBuffer + (maxSequenceLength * sampleSize * i));
+                    currentSequenceBuffer += currentSequenceSizeInElements;
+                }
+            }
+
+            transferer->RecordCPUToGPUCopy();
+        }
+
+        if (readOnly)
+            valueData = valueData->Alias(readOnly);
+
+        return MakeSharedObject<UploadingValue>(valueData, deviceValueMask, transferer, std::vector<SparseIndexType>());
+    }
+
+    template <typename ElementType>
+    /*static*/ ValuePtr Value::CreateFromPackedBuffer(const NDShape& sampleShape, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const ElementType* nonZeroValues, size_t numNonZeroValues, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/)
+    {
+        if ((colStarts == nullptr) || (rowIndices == nullptr) || (nonZeroValues == nullptr))
+            InvalidArgument("Value::CreateFromPackedBuffer: The sparse CSC buffers must not be null");
+
+        if (sampleShape[0] != sampleShape.TotalSize())
+            InvalidArgument("Value::CreateFromPackedBuffer: The sample shape's leading axis dimensionality must equal the total size of the sample for sparse data");
+
+        size_t maxSequenceLength;
+        auto numSamples = ValidatePackedSequenceLengths(sequenceLengths, maxSequenceLength);
+        if ((colStarts[0] != 0) || ((size_t)colStarts[numSamples] != numNonZeroValues))
+            InvalidArgument("Value::CreateFromPackedBuffer: The column starts of the sparse CSC data must run from 0 to the number of non-zero values (%lu)", (unsigned long)numNonZeroValues);
+
+        auto numSequences = sequenceLengths.size();
+        auto valueDataShape = sampleShape.AppendShape({ maxSequenceLength, numSequences });
+        auto deviceValueMask = CreateMask(sequenceLengths, sequenceStartFlags, DeviceDescriptor::CPUDevice());
+
+        // Padding only adds empty columns, so the row indices and values are used as they are
+        std::vector<SparseIndexType> paddedColStarts;
+        if (numSamples != (maxSequenceLength * numSequences))
+        {
+            paddedColStarts.reserve((maxSequenceLength * numSequences) + 1);
+            const SparseIndexType* currentSequenceColStarts = colStarts;
+            for (size_t i = 0; i < numSequences; ++i)
+            {
+                paddedColStarts.insert(paddedColStarts.end(), currentSequenceColStarts, currentSequenceColStarts + sequenceLengths[i]);
+                currentSequenceColStarts += sequenceLengths[i];
+                paddedColStarts.insert(paddedColStarts.end(), maxSequenceLength - sequenceLengths[i], *currentSequenceColStarts);
+            }
+
+            paddedColStarts.push_back((SparseIndexType)numNonZeroValues);
+            colStarts = paddedColStarts.data();
+        }
+
+        if (device == DeviceDescriptor::CPUDevice())
+        {
+            auto valueData = MakeSharedObject<NDArrayView>(valueDataShape, colStarts, rowIndices, nonZeroValues, numNonZeroValues, device, readOnly);
+            return MakeSharedObject<Value>(valueData, deviceValueMask);
+        }
+
+        NDArrayViewPtr valueData = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), StorageFormat::SparseCSC, valueDataShape, device);
+        auto sparseMatrix = valueData->GetWritableMatrix<ElementType>(1);
+        Microsoft::MSR::CNTK::DataTransfererPtr transferer;
+        {
+            std::lock_guard<std::mutex> lock(s_uploadMutex);
+            transferer = GetUploadTransferer(device);
+            sparseMatrix->SetMatrixFromCSCFormat(colStarts, rowIndices, nonZeroValues, numNonZeroValues, sparseMatrix->GetNumRows(), sparseMatrix->GetNumCols(), transferer.get());
+            transferer->RecordCPUToGPUCopy();
+        }
+
+        if (readOnly)
+            valueData = valueData->Alias(readOnly);
+
+        return MakeSharedObject<UploadingValue>(valueData, deviceValueMask, transferer, std::move(paddedColStarts));
+    }
+
     /*virtual*/ Value::~Value()
     {
     }
@@ -359,6 +528,160 @@ namespace CNTK
         }
     }
 
+    // The number of sequences and the maximum sequence length of a Value with samples of shape 'sampleShape'; the data has at most
+    // a sequence axis and a batch axis beyond the sample.
+    static void GetSequenceDimensions(const NDShape& valueShape, const NDShape& sampleShape, size_t& maxSequenceLength, size_t& numSequences)
+    {
+        auto sampleRank = sampleShape.Rank();
+        if ((valueShape.Rank() < sampleRank) || (valueShape.Rank() > (sampleRank + 2)) || (valueShape.SubShape(0, sampleRank) != sampleShape))
+            InvalidArgument("Value::CopyToPackedBuffer: The shape of the Value (%S) is not compatible with the sample shape (%S)", AsStringForErrorReporting(valueShape).c_str(), AsStringForErrorReporting(sampleShape).c_str());
+
+        maxSequenceLength = (valueShape.Rank() > sampleRank) ? valueShape[sampleRank] : 1;
+        numSequences = (valueShape.Rank() > (sampleRank + 1)) ? valueShape[sampleRank + 1] : 1;
+    }
+
+    template <typename ElementType>
+    size_t PackedValue::CopyPackedSamplesTo(ElementType* packedData, size_t packedDataCapacity, size_t* sequenceLengths, size_t sequenceLengthsCapacity) const
+    {
+        auto matrix = m_packedData->GetMatrix<ElementType>();
+        auto sampleSize = m_sampleShape.TotalSize();
+        if (!m_packedSampleColumns)
+        {
+            // Sequence i of the unpacked Value is the i-th sequence of the layout that is not a gap, as in Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout
+            size_t maxNumTimeSteps = m_packedDataLayout->GetNumTimeSteps();
+            size_t numParallelSequences = m_packedDataLayout->GetNumParallelSequences();
+            std::vector<ElementType> sampleColumns;
+            sampleColumns.reserve(m_packedDataLayout->GetActualNumSamples());
+            for (auto& sequenceInfo : m_packedDataLayout->GetAllSequences())
+            {
+                if (sequenceInfo.seqId == GAP_SEQUENCE_ID)
+                    continue;
+
+                auto currentSequenceBeginIdx = (size_t)std::max<ptrdiff_t>(0, sequenceInfo.tBegin);
+                auto currentSequenceEndIdx = std::min(maxNumTimeSteps, sequenceInfo.tEnd);
+                for (size_t t = currentSequenceBeginIdx; t < currentSequenceEndIdx; ++t)
+                    sampleColumns.push_back((ElementType)((t * numParallelSequences) + sequenceInfo.s));
+
+                m_packedSequenceLengths.push_back(currentSequenceEndIdx - currentSequenceBeginIdx);
+            }
+
+            auto numSamples = sampleColumns.size();
+            m_packedSampleColumns = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), NDShape({ 1, numSamples }), m_packedData->Device());
+            m_compactedData = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), NDShape({ sampleSize, numSamples }), m_packedData->Device());
+            if (numSamples > 0)
+                m_packedSampleColumns->GetWritableMatrix<ElementType>()->SetValue(1, numSamples, matrix->GetDeviceId(), sampleColumns.data());
+        }
+
+        auto numSequences = m_packedSequenceLengths.size();
+        auto numSamples = m_packedSampleColumns->Shape()[1];
+        if (sequenceLengthsCapacity < numSequences)
+            InvalidArgument("Value::CopyToPackedBuffer: The buffer for the sequence lengths has room for %lu entries, but the Value has %lu sequences", (unsigned long)sequenceLengthsCapacity, (unsigned long)numSequences);
+
+        if (packedDataCapacity < (numSamples * sampleSize))
+            InvalidArgument("Value::CopyToPackedBuffer: The data buffer has room for %lu elements, but the Value has %lu valid ones", (unsigned long)packedDataCapacity, (unsigned long)(numSamples * sampleSize));
+
+        std::copy(m_packedSequenceLengths.begin(), m_packedSequenceLengths.end(), sequenceLengths);
+        if (numSamples > 0)
+        {
+            auto compactedData = m_compactedData->GetWritableMatrix<ElementType>();
+            compactedData->DoGatherColumnsOf(0, *m_packedSampleColumns->GetMatrix<ElementType>(), *matrix, 1);
+            compactedData->CopySection(sampleSize, numSamples, packedData, sampleSize);
+        }
+
+        return numSamples;
+    }
+
+    template <typename ElementType>
+    size_t Value::CopyToPackedBuffer(const NDShape& sampleShape, ElementType* packedData, size_t packedDataCapacity, size_t* sequenceLengths, size_t sequenceLengthsCapacity) const
+    {
+        if ((packedData == nullptr) || (sequenceLengths == nullptr))
+            InvalidArgument("Value::CopyToPackedBuffer: The buffers must not be null");
+
+        if (IsSparse())
+            InvalidArgument("Value::CopyToPackedBuffer: Only dense Values are supported");
+
+        if (GetDataType() != AsDataType<ElementType>())
+            InvalidArgument("Value::CopyToPackedBuffer: The data type %s of the buffer does not match the Value's data type %s", DataTypeName(AsDataType<ElementType>()), DataTypeName(GetDataType()));
+
+        size_t maxSequenceLength, numSequences;
+        GetSequenceDimensions(Shape(), sampleShape, maxSequenceLength, numSequences);
+
+        // Packed data with interleaved sequences is compacted by a gather on the device rather than unpacked first
+        auto packedValue = dynamic_cast<const PackedValue*>(this);
+        if ((packedValue != nullptr) && packedValue->NeedsReshuffling())
+            return packedValue->CopyPackedSamplesTo(packedData, packedDataCapacity, sequenceLengths, sequenceLengthsCapacity);
+
+        if (sequenceLengthsCapacity < numSequences)
+            InvalidArgument("Value::CopyToPackedBuffer: The buffer for the sequence lengths has room for %lu entries, but the Value has %lu sequences", (unsigned long)sequenceLengthsCapacity, (unsigned long)numSequences);
+
+        // The valid samples of a sequence are the leading ones of its padded columns
+        auto mask = Mask();
+        if ((mask != nullptr) && (mask->Device() != DeviceDescriptor::CPUDevice()))
+            mask = mask->DeepClone(DeviceDescriptor::CPUDevice());
+
+        const MaskKind* maskBuffer = nullptr;
+        if (mask != nullptr)
+        {
+            if (mask->Shape().TotalSize() != (maxSequenceLength * numSequences))
+                InvalidArgument("Value::CopyToPackedBuffer: The mask of shape %S does not match the sequence axes of the Value of shape %S", AsStringForErrorReporting(mask->Shape()).c_str(), AsStringForErrorReporting(Shape()).c_str());
+
+            maskBuffer = mask->DataBuffer();
+        }
+
+        size_t numSamples = 0;
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            size_t currentSequenceLength = 0;
+            while ((currentSequenceLength < maxSequenceLength) && ((maskBuffer == nullptr) || (maskBuffer[(i * maxSequenceLength) + currentSequenceLength] != MaskKind::Invalid)))
+                currentSequenceLength++;
+
+            sequenceLengths[i] = currentSequenceLength;
+            numSamples += currentSequenceLength;
+        }
+
+        auto sampleSize = sampleShape.TotalSize();
+        if (packedDataCapacity < (numSamples * sampleSize))
+            InvalidArgument("Value::CopyToPackedBuffer: The data buffer has room for %lu elements, but the Value has %lu valid ones", (unsigned long)packedDataCapacity, (unsigned long)(numSamples * sampleSize));
+
+        // One copy per run of columns without padding in between
+        auto matrix = Data()->GetMatrix<ElementType>(sampleShape.Rank());
+        size_t runBeginIdx = 0;
+        size_t runLength = 0;
+        auto currentBuffer = packedData;
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            runLength += sequenceLengths[i];
+            if ((sequenceLengths[i] == maxSequenceLength) && ((i + 1) < numSequences))
+                continue;
+
+            if (runLength > 0)
+            {
+                matrix->ColumnSlice(runBeginIdx, runLength).CopySection(sampleSize, runLength, currentBuffer, sampleSize);
+                currentBuffer += runLength * sampleSize;
+            }
+
+            runBeginIdx = (i + 1) * maxSequenceLength;
+            runLength = 0;
+        }
+
+        return numSamples;
+    }
+
+    template <typename ElementType>
+    void Value::CopyToPackedBuffer(const NDShape& sampleShape, std::vector<ElementType>& packedData, std::vector<size_t>& sequenceLengths) const
+    {
+        size_t maxSequenceLength, numSequences;
+        GetSequenceDimensions(Shape(), sampleShape, maxSequenceLength, numSequences);
+
+        // MaskedCount() is known without unpacking
+        auto sampleSize = sampleShape.TotalSize();
+        auto numSamples = (maxSequenceLength * numSequences) - MaskedCount();
+        sequenceLengths.resize(numSequences);
+        packedData.resize(numSamples * sampleSize);
+        numSamples = CopyToPackedBuffer(sampleShape, packedData.data(), packedData.size(), sequenceLengths.data(), sequenceLengths.size());
+        packedData.resize(numSamples * sampleSize);
+    }
+
     void PackedValue::Unpack() const
     {
         if (m_packedDataLayout && (m_packedDataLayout->GetNumTimeSteps() != 1) && (m_packedDataLayout->GetNumSequences() != 1) && Internal::IsAutomaticUnpackingOfPackedValuesDisabled())
@@ -397,4 +720,12 @@ namespace CNTK
     template /*static*/ CNTK_API ValuePtr Value::Create<double>(const NDShape& sampleShape, const std::vector<std::vector<double>>& sequences, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
     template /*static*/ CNTK_API ValuePtr Value::Create<float>(size_t vocabSize, const std::vector<std::vector<size_t>>& oneHotSequences, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
     template /*static*/ CNTK_API ValuePtr Value::Create<double>(size_t vocabSize, const std::vector<std::vector<size_t>>& oneHotSequences, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreateFromPackedBuffer<float>(const NDShape& sampleShape, float* packedData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreateFromPackedBuffer<double>(const NDShape& sampleShape, double* packedData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreateFromPackedBuffer<float>(const NDShape& sampleShape, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const float* nonZeroValues, size_t numNonZeroValues, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreateFromPackedBuffer<double>(const NDShape& sampleShape, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const double* nonZeroValues, size_t numNonZeroValues, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template CNTK_API size_t Value::CopyToPackedBuffer<float>(const NDShape& sampleShape, float* packedData, size_t packedDataCapacity, size_t* sequenceLengths, size_t sequenceLengthsCapacity) const;
+    template CNTK_API size_t Value::CopyToPackedBuffer<double>(const NDShape& sampleShape, double* packedData, size_t packedDataCapacity, size_t* sequenceLengths, size_t sequenceLengthsCapacity) const;
+    template CNTK_API void Value::CopyToPackedBuffer<float>(const NDShape& sampleShape, std::vector<float>& packedData, std::vector<size_t>& sequenceLengths) const;
+    template CNTK_API void Value::CopyToPackedBuffer<double>(const NDShape& sampleShape, std::vector<double>& packedData, std::vector<size_t>& sequenceLengths) const;
 }
@@ -10,6 +10,7 @@
 #include "Sequences.h"
 #include "TensorView.h"
 #include "Utils.h"
+#include "DataTransferer.h"
 
 namespace CNTK
 {
@@ -35,6 +36,17 @@ namespace CNTK
 
         void Unpack() const;
 
+        // Whether the data is still packed and would be reshuffled by unpacking; only the sequences of such data are interleaved.
+        bool NeedsReshuffling() const
+        {
+            return m_isPacked && m_packedDataLayout && (m_packedDataLayout->GetNumTimeSteps() != 1) && (m_packedDataLayout->GetNumSequences() != 1);
+        }
+
+        // Copies the valid samples of the packed data back to back, in the order of the sequences of the unpacked Value (see Value::CopyToPackedBuffer).
+        // The columns to gather only depend on the layout, so they are uploaded on the first call and reused along with the compacted matrix.
+        template <typename ElementType>
+        size_t CopyPackedSamplesTo(ElementType* packedData, size_t packedDataCapacity, size_t* sequenceLengths, size_t sequenceLengthsCapacity) const;
+
         const NDShape& Shape() const override { return m_unpackedShape; }
         DeviceDescriptor Device() const override { return m_isPacked ? m_packedData->Device() : Value::Device(); }
         DataType GetDataType() const override { return m_isPacked ? m_packedData->GetDataType() : Value::GetDataType(); }
@@ -115,5 +127,59 @@ namespace CNTK
         mutable bool m_isPacked;
         mutable NDArrayViewPtr m_packedData;
         mutable std::shared_ptr<Microsoft::MSR::CNTK::MBLayout> m_packedDataLayout;
+
+        // Cached by CopyPackedSamplesTo
+        mutable std::vector<size_t> m_packedSequenceLengths;
+        mutable NDArrayViewPtr m_packedSampleColumns;
+        mutable NDArrayViewPtr m_compactedData;
+    };
+
+    // A Value whose data is still being uploaded from a caller's buffer to the GPU (see Value::CreateFromPackedBuffer).
+    // The first access to the data waits for the upload; until then the caller's buffer and the staged column starts
+    // of sparse data must stay alive.
+    class UploadingValue final : public Value
+    {
+        template <typename T, typename ...CtorArgTypes>
+        friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+    public:
+        UploadingValue(const NDArrayViewPtr& data, const NDMaskPtr& mask, const Microsoft::MSR::CNTK::DataTransfererPtr& transferer, std::vector<SparseIndexType>&& stagedColStarts)
+            : Value(data, mask), m_transferer(transferer), m_stagedColStarts(std::move(stagedColStarts))
+        {
+        }
+
+        ~UploadingValue()
+        {
+            // The device memory must not be released while the copy is in flight.
+            try
+            {
+                WaitForUpload();
+            }
+            catch (...)
+            {
+            }
+        }
+
+        // DeepClone(), Alias() and CopyFrom() all go through Data().
+        NDArrayViewPtr Data() const override
+        {
+            WaitForUpload();
+            return Value::Data();
+        }
+
+    private:
+        void WaitForUpload() const
+        {
+            if (!m_transferer)
+                return;
+
+            m_transferer->WaitForCopyCPUToGPU();
+            m_transferer = nullptr;
+            m_stagedColStarts = std::vector<SparseIndexType>();
+        }
+
+    private:
+        mutable Microsoft::MSR::CNTK::DataTransfererPtr m_transferer;
+        mutable std::vector<SparseIndexType> m_stagedColStarts;
     };
 }
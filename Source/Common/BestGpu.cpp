@@ -45,9 +45,15 @@ int bestGPUDummy = 42; // put something into this CPP, as to avoid a linker warn
 #include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#include <tuple>
 
 #include <memory>
 #include "CrossProcessMutex.h"
+#include "ThreadAffinity.h"
+#ifdef __UNIX__
+#include <dirent.h>
+#include <limits.h>
+#endif
 
 // ---------------------------------------------------------------------------
 // BestGpu class
@@ -55,6 +61,60 @@ int bestGPUDummy = 42; // put something into this CPP, as to avoid a linker warn
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// ---------------------------------------------------------------------------
+// host topology, for gpuPlacement = "topology"
+// ---------------------------------------------------------------------------
+
+// rank of this process among the MPI ranks on this host, as exported by the common launchers; -1 if not launched by MPI
+static int GetLocalMpiRank()
+{
+    for (const char* name : {"OMPI_COMM_WORLD_LOCAL_RANK", "MV2_COMM_WORLD_LOCAL_RANK", "MPI_LOCALRANKID", "SLURM_LOCALID"})
+    {
+        const char* value = getenv(name);
+        if (value && *value)
+            return atoi(value);
+    }
+    return -1;
+}
+
+// NUMA node the GPU is attached to, -1 if unknown
+static int GetDeviceNumaNode(const cudaDeviceProp& deviceProp)
+{
+    char busId[32];
+    sprintf(busId, "%04x:%02x:%02x.0", deviceProp.pciDomainID, deviceProp.pciBusID, deviceProp.pciDeviceID);
+    return GetNumaNodeOfPciDevice(busId);
+}
+
+// RDMA devices (InfiniBand/RoCE) attached to a NUMA node. These are only looked up on Linux, the only platform on
+// which NCCL uses them (see SelectNearestNetworkDevices()).
+static std::vector<std::string> GetNetworkDevicesOnNode(int node)
+{
+    std::vector<std::string> devices;
+#ifdef __UNIX__
+    DIR* dir = opendir("/sys/class/infiniband");
+    if (!dir)
+        return devices;
+    while (struct dirent* entry = readdir(dir))
+    {
+        // 'device' links to the PCI device, whose directory is named after its bus id
+        std::string name = entry->d_name;
+        if (name[0] == '.')
+            continue;
+        char pciPath[PATH_MAX];
+        if (!realpath(("/sys/class/infiniband/" + name + "/device").c_str(), pciPath))
+            continue;
+        const char* busId = strrchr(pciPath, '/');
+        if (GetNumaNodeOfPciDevice(busId ? busId + 1 : pciPath) == node)
+            devices.push_back(name);
+    }
+    closedir(dir);
+    sort(devices.begin(), devices.end());
+#else
+    UNUSED(node);
+#endif
+    return devices;
+}
+
 struct ProcessorData
 {
     int cores;
@@ -65,6 +125,7 @@ struct ProcessorData
     size_t cudaTotalMem;
     bool cntkFound;
     int deviceId; // the deviceId (cuda side) for this processor
+    int numaNode; // NUMA node the device is attached to, -1 if unknown
 };
 
 enum BestGpuFlags
@@ -75,6 +136,7 @@ enum BestGpuFlags
     bestGpuFavorUtilization = 4, // favor low utilization
     bestGpuFavorSpeed = 8,       // favor fastest processor
     bestGpuExclusiveLock = 16,   // obtain mutex for selected GPU
+    bestGpuTopology = 32,        // order by NUMA proximity and local MPI rank instead of by score
     bestGpuRequery = 256,        // rerun the last query, updating statistics
 };
 
@@ -93,13 +155,14 @@ private:
     std::vector<ProcessorData*> m_procData;
     int m_allowedDevices; // bitfield of allowed devices
     bool m_disallowCPUDevice;
+    int m_maxProcessesPerGpu; // 1: devices are locked exclusively, otherwise by one of this many slots
     void GetCudaProperties();
     void GetNvmlData();
     void QueryNvmlData();
 
 public:
     BestGpu()
-        : m_initialized(false), m_nvmlData(false), m_cudaData(false), m_deviceCount(0), m_queryCount(0), m_lastFlags(bestGpuNormal), m_lastCount(0), m_allowedDevices(-1), m_disallowCPUDevice(false)
+        : m_initialized(false), m_nvmlData(false), m_cudaData(false), m_deviceCount(0), m_queryCount(0), m_lastFlags(bestGpuNormal), m_lastCount(0), m_allowedDevices(-1), m_disallowCPUDevice(false), m_maxProcessesPerGpu(1)
     {
         Init();
     }
@@ -115,24 +178,78 @@ public:
     static const int AllDevices = -1;                                                         // can be used to specify all GPUs in GetDevices() call
     static const int RequeryDevices = -2;                                                     // Requery refreshing statistics and picking the same number as last query
     static const int MininumCCMajorForGpu = 3;                                                // cntk supports GPUs with Compute Capability > 3.0
+    static const int MaxProcessesPerGpu = 16;                                                 // number of lock slots of a shared device
     std::vector<int> GetDevices(int number = AllDevices, BestGpuFlags flags = bestGpuNormal); // get multiple devices
     std::vector<ProcessorData *> GetProcessorData();
     void UnlockDevice(int deviceId);
+    void SetMaxProcessesPerGpu(int maxProcessesPerGpu);
+    int GetNumaNode(int deviceId) const;
 
 private:
     bool LockDevice(int deviceId, bool trial = true);
+    bool AcquireDeviceLock(const std::string& name, int deviceId, bool trial);
+    int CountSharingProcesses(int deviceId);
+    std::vector<int> OrderByTopology(const std::vector<int>& devices) const;
 };
 
 static DEVICEID_TYPE s_bestDeviceId = DEVICEID_NOTYETDETERMINED;
 static std::unique_ptr<BestGpu> s_bestGpu = nullptr;
 
+// how 'auto' hands out devices, see DeviceFromConfig() in BestGpu.h
+struct GpuPlacement
+{
+    bool topology;
+    int maxProcessesPerGpu;
+
+    GpuPlacement()
+        : topology(false), maxProcessesPerGpu(1)
+    {
+    }
+
+    GpuPlacement(const std::string& placement, int maxProcessesPerGpu)
+        : maxProcessesPerGpu(maxProcessesPerGpu)
+    {
+        if (EqualCI(placement, "topology"))
+            topology = true;
+        else if (EqualCI(placement, "score"))
+            topology = false;
+        else
+            InvalidArgument("Invalid value '%s' for gpuPlacement parameter. Allowed are 'score' and 'topology'.", placement.c_str());
+        if (maxProcessesPerGpu < 1 || maxProcessesPerGpu > BestGpu::MaxProcessesPerGpu)
+            InvalidArgument("maxProcessesPerGpu must be between 1 and %d.", BestGpu::MaxProcessesPerGpu);
+    }
+};
+
+// With topology placement, points NCCL at the RDMA devices next to the selected GPU, unless the user chose them already.
+static void SelectNearestNetworkDevices(DEVICEID_TYPE deviceId)
+{
+    int node = s_bestGpu->GetNumaNode(deviceId);
+    if (node < 0)
+        return;
+
+    std::vector<std::string> networkDevices = GetNetworkDevicesOnNode(node);
+    std::string list;
+    for (const auto& device : networkDevices)
+        list += (list.empty() ? "" : ",") + device;
+
+    fprintf(stderr, "SelectDevice: GPU %d is on NUMA node %d%s%s.\n", (int)deviceId, node, list.empty() ? "" : " with network devices ", list.c_str());
+    if (!list.empty() && !getenv("NCCL_IB_HCA"))
+    {
+#ifdef _WIN32
+        _putenv_s("NCCL_IB_HCA", list.c_str());
+#else
+        setenv("NCCL_IB_HCA", list.c_str(), /*overwrite=*/0);
+#endif
+    }
+}
+
 // DeviceFromConfig - Parse 'deviceId' config parameter to determine what type of behavior is desired
 //Symbol - Meaning
 // 'auto' - automatically pick a single GPU based on ?BestGpu? score
 // 'cpu'  - use the CPU
 // 0      - or some other single number, use a single GPU with CUDA ID same as the number
 // This can only be called with the same parameters each time, and 'auto' is determined upon first call.
-static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const intargvector& excludedDevices)
+static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const intargvector& excludedDevices, const GpuPlacement& placement = GpuPlacement())
 {
     // This can only be called with the same parameter.
     static DEVICEID_TYPE selectedDeviceId = DEVICEID_NOTYETDETERMINED;
@@ -156,10 +273,16 @@ static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const i
                 }
 
                 s_bestGpu->DisallowUnsupportedDevices();
+                s_bestGpu->SetMaxProcessesPerGpu(placement.maxProcessesPerGpu);
             }
 
-            s_bestDeviceId = (DEVICEID_TYPE)s_bestGpu->GetDevice(BestGpuFlags(bLockGPU ? (bestGpuAvoidSharing | bestGpuExclusiveLock) : bestGpuAvoidSharing));
-            // TODO: Do we need to hold this pointer at all? We will only query it once. Or is it used to hold lock to a GPU?
+            int flags = bLockGPU ? (bestGpuAvoidSharing | bestGpuExclusiveLock) : bestGpuAvoidSharing;
+            if (placement.topology)
+                flags |= bestGpuTopology;
+            s_bestDeviceId = (DEVICEID_TYPE)s_bestGpu->GetDevice(BestGpuFlags(flags));
+            // the BestGpu instance is kept since it holds the lock on the selected device
+            if (placement.topology && s_bestDeviceId >= 0)
+                SelectNearestNetworkDevices(s_bestDeviceId);
         }
         // already chosen
         deviceId = s_bestDeviceId;
@@ -173,6 +296,21 @@ DEVICEID_TYPE GetBestDevice()
      return SelectDevice(DEVICEID_AUTO, true, intargvector());
 }
 
+int GetGpuNumaNode(DEVICEID_TYPE deviceId)
+{
+    if (deviceId < 0)
+        return -1;
+
+    // unlike BestGpu this does not touch the device state, so it can be called while the device is in use
+    char busId[32];
+    if (cudaDeviceGetPCIBusId(busId, sizeof(busId), deviceId) != cudaSuccess)
+    {
+        cudaGetLastError(); // clear the error state
+        return -1;
+    }
+    return GetNumaNodeOfPciDevice(busId);
+}
+
 void OnDeviceSelected(DEVICEID_TYPE deviceId)
 {
     if (s_bestDeviceId != DEVICEID_NOTYETDETERMINED && s_bestDeviceId != deviceId && s_bestDeviceId >= 0)
@@ -193,10 +331,11 @@ DEVICEID_TYPE DeviceFromConfig(const ScriptableObjects::IConfigRecord& config)
 {
     intargvector excludedDevices = ConfigArray(config(L"excludedDevices", ""), ':', false);
     bool bLockGPU = config(L"lockGPU", true);
+    GpuPlacement placement(config(L"gpuPlacement", "score"), config(L"maxProcessesPerGpu", 1));
     // we need to deal with the old CNTK config semantics where 'deviceId' can be either a string or an int
     auto valpp = config.Find(L"deviceId");
     if (!valpp)
-        return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices); // not given at all: default
+        return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices, placement); // not given at all: default
     auto valp = *valpp;                               // (the type is not determined at this point)
     if (valp.Is<ScriptableObjects::String>())
     {
@@ -204,7 +343,7 @@ DEVICEID_TYPE DeviceFromConfig(const ScriptableObjects::IConfigRecord& config)
         if (val == L"cpu")
             return SelectDevice(CPUDEVICE, false, excludedDevices);
         else if (val == L"auto")
-            return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices);
+            return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices, placement);
         else
             InvalidArgument("Invalid value '%ls' for deviceId parameter. Allowed are 'auto' and 'cpu' (case-sensitive).", val.c_str());
     }
@@ -220,9 +359,11 @@ DEVICEID_TYPE DeviceFromConfig(const ConfigParameters& config)
     intargvector excludedDevices = ConfigArray(config("excludedDevices", ""), ':', false);
     ConfigValue val = config("deviceId", "auto");
     bool bLockGPU = config(L"lockGPU", true);
+    ConfigValue placementVal = config("gpuPlacement", "score");
+    GpuPlacement placement(placementVal, config(L"maxProcessesPerGpu", 1));
 
     if (EqualCI(val, "cpu"))  return SelectDevice(CPUDEVICE, false, excludedDevices);
-    else if (EqualCI(val, "auto")) return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices);
+    else if (EqualCI(val, "auto")) return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices, placement);
     else                           return SelectDevice((int)val, bLockGPU, excludedDevices);
 }
 
@@ -285,6 +426,7 @@ void BestGpu::GetCudaProperties()
         pd->cores = _ConvertSMVer2Cores(pd->deviceProp.major, pd->deviceProp.minor) * pd->deviceProp.multiProcessorCount;
         pd->cudaFreeMem = free;
         pd->cudaTotalMem = total;
+        pd->numaNode = GetDeviceNumaNode(pd->deviceProp);
         dev++;
         cudaDeviceReset();
     }
@@ -520,6 +662,9 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
             break;
     }
 
+    if (bestFlags & bestGpuTopology)
+        best = OrderByTopology(best);
+
     // global lock for this process
     CrossProcessMutex deviceAllocationLock("DBN.exe GPGPU querying lock");
 
@@ -540,6 +685,16 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
             }
         }
         best = bestAndAvaialbe;
+
+        // shared devices: hand out the least occupied one first, so that concurrent jobs spread over the host
+        if (m_maxProcessesPerGpu > 1)
+        {
+            std::map<int, int> occupancy;
+            for (auto i : best)
+                occupancy[i] = CountSharingProcesses(i);
+            std::stable_sort(best.begin(), best.end(), [&occupancy](int a, int b) { return occupancy[a] < occupancy[b]; });
+        }
+
         if (best.size() > number)
         {
             best.resize(number);
@@ -616,6 +771,9 @@ std::vector<GpuData> GetAllGpusData()
 
         size_t totalMemory = pd->deviceProp.totalGlobalMem/(1024*1024); //From bytes to MBytes
         GpuData gpuData = GpuData(pd->deviceProp.major, pd->deviceProp.minor, pd->deviceId, pd->cores, validity, string(pd->deviceProp.name), totalMemory);
+        // clock rates are in kHz; the memory transfers on both clock edges
+        gpuData.peakFlops = 2.0 * pd->cores * pd->deviceProp.clockRate * 1000.0;
+        gpuData.peakBytesPerSecond = 2.0 * pd->deviceProp.memoryClockRate * 1000.0 * pd->deviceProp.memoryBusWidth / 8;
         data.push_back(gpuData);
     }
 
@@ -732,20 +890,123 @@ void BestGpu::UnlockDevice(int deviceId)
     delete m_GPUMutex[deviceId].release();
 }
 
+void BestGpu::SetMaxProcessesPerGpu(int maxProcessesPerGpu)
+{
+    assert(maxProcessesPerGpu >= 1 && maxProcessesPerGpu <= MaxProcessesPerGpu);
+    m_maxProcessesPerGpu = maxProcessesPerGpu;
+}
+
+int BestGpu::GetNumaNode(int deviceId) const
+{
+    for (ProcessorData* pd : m_procData)
+    {
+        if (pd->deviceId == deviceId)
+            return pd->numaNode;
+    }
+    return -1;
+}
+
+// OrderByTopology - reorder the candidate devices for topology placement
+// Devices on the NUMA node of this process come first, each group in PCI order rotated by the local MPI rank,
+// so that the ranks of a host start their search at different devices instead of all at the best scored one.
+std::vector<int> BestGpu::OrderByTopology(const std::vector<int>& devices) const
+{
+    auto pciOrder = [this](int a, int b)
+    {
+        const cudaDeviceProp& pa = m_procData[a]->deviceProp;
+        const cudaDeviceProp& pb = m_procData[b]->deviceProp;
+        return std::make_tuple(pa.pciDomainID, pa.pciBusID, pa.pciDeviceID) < std::make_tuple(pb.pciDomainID, pb.pciBusID, pb.pciDeviceID);
+    };
+    std::vector<int> sorted = devices;
+    std::sort(sorted.begin(), sorted.end(), pciOrder);
+
+    int processNode = GetProcessNumaNode();
+    std::vector<int> nearby, remote;
+    for (int deviceId : sorted)
+        (processNode >= 0 && GetNumaNode(deviceId) == processNode ? nearby : remote).push_back(deviceId);
+
+    int localRank = std::max(GetLocalMpiRank(), 0);
+    for (auto* group : {&nearby, &remote})
+    {
+        if (!group->empty())
+            std::rotate(group->begin(), group->begin() + localRank % group->size(), group->end());
+    }
+
+    nearby.insert(nearby.end(), remote.begin(), remote.end());
+    return nearby;
+}
+
+// CountSharingProcesses - number of processes holding one of the shared lock slots of a device
+int BestGpu::CountSharingProcesses(int deviceId)
+{
+    int count = 0;
+    char buffer[80];
+    for (int slot = 0; slot < MaxProcessesPerGpu; slot++)
+    {
+        sprintf(buffer, "CNTK GPGPU shared lock for device %d slot %d", deviceId, slot);
+        CrossProcessMutex mutex(buffer);
+        if (mutex.Acquire(/*wait=*/false))
+            mutex.Release();
+        else
+            count++;
+    }
+    return count;
+}
+
+// LockDevice - lock a device for this process
+// With maxProcessesPerGpu = 1 the device is locked exclusively, which requires that no process shares it. Otherwise
+// one of its first maxProcessesPerGpu slots is taken, which requires that no process holds it exclusively.
+// trial - only test whether the lock could be taken
 bool BestGpu::LockDevice(int deviceId, bool trial)
 {
     if (deviceId < 0) // don't lock CPU, always return true
     {
         return true;
     }
+    // we hold it already; note that testing our own lock again would release it (fcntl locks belong to the process)
+    auto held = m_GPUMutex.find(deviceId);
+    if (held != m_GPUMutex.end() && held->second)
+        return true;
+
     // ported from dbn.exe, not perfect but it works in practice
     char buffer[80];
     sprintf(buffer, "DBN.exe GPGPU exclusive lock for device %d", deviceId);
-    std::unique_ptr<CrossProcessMutex> mutex(new CrossProcessMutex(buffer));
+    if (m_maxProcessesPerGpu <= 1)
+    {
+        if (CountSharingProcesses(deviceId) > 0)
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "LockDevice: GPU %d is shared by other processes.\n", deviceId);
+            return false;
+        }
+        return AcquireDeviceLock(buffer, deviceId, trial);
+    }
+
+    {
+        CrossProcessMutex exclusive(buffer);
+        if (!exclusive.Acquire(/*wait=*/false))
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "LockDevice: GPU %d is locked for exclusive use.\n", deviceId);
+            return false;
+        }
+    }
+    for (int slot = 0; slot < m_maxProcessesPerGpu; slot++)
+    {
+        sprintf(buffer, "CNTK GPGPU shared lock for device %d slot %d", deviceId, slot);
+        if (AcquireDeviceLock(buffer, deviceId, trial))
+            return true;
+    }
+    return false;
+}
+
+bool BestGpu::AcquireDeviceLock(const std::string& name, int deviceId, bool trial)
+{
+    std::unique_ptr<CrossProcessMutex> mutex(new CrossProcessMutex(name));
     if (!mutex->Acquire(/*wait=*/false)) // GPU not available
     {
         if (GetMathLibTraceLevel() > 0)
-            fprintf(stderr, "LockDevice: Failed to lock GPU %d for exclusive use.\n", deviceId);
+            fprintf(stderr, "LockDevice: Failed to lock GPU %d (%s).\n", deviceId, name.c_str());
 
         return false;
     }
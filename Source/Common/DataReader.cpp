@@ -231,6 +231,22 @@ size_t DataReader::GetCurrentSamplePosition()
     return m_dataReaders[m_ioNames.back()]->GetCurrentSamplePosition();
 }
 
+std::string DataReader::GetReaderState()
+{
+    // Same as for the sample position, only the last reader.
+    return m_dataReaders[m_ioNames.back()]->GetReaderState();
+}
+
+bool DataReader::SetReaderState(const std::string& state)
+{
+    return m_dataReaders[m_ioNames.back()]->SetReaderState(state);
+}
+
+bool DataReader::GetProfile(ReaderProfile& profile)
+{
+    return m_dataReaders[m_ioNames.back()]->GetProfile(profile);
+}
+
 // GetMinibatch - Get the next minibatch (features and labels)
 // matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
 //             [out] each matrix resized if necessary containing data.
@@ -19,10 +19,13 @@
 #include "Windows.h"
 #include <VersionHelpers.h>
 #include <Shlwapi.h>
+#include <io.h> // for _get_osfhandle()
 #pragma comment(lib, "Shlwapi.lib")
 #endif
 #ifdef __unix__
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <linux/limits.h> // for PATH_MAX
 #endif
 
@@ -85,6 +88,11 @@ void File::Init(const wchar_t* filename, int fileOptions)
 {
     m_filename = filename;
     m_options = fileOptions;
+    m_mappedData = nullptr;
+    m_mappedSize = 0;
+#ifdef _WIN32
+    m_mappingHandle = NULL;
+#endif
     if (m_filename.empty())
         RuntimeError("File: filename is empty");
     const auto outputPipe = (m_filename.front() == '|');
@@ -145,6 +153,49 @@ void File::Init(const wchar_t* filename, int fileOptions)
                     m_file = fopenOrDie(filename, options.c_str());
                     m_seekable = true;
                 });
+    // map binary files that are only read, all other operations keep going through m_file
+    if ((fileOptions & fileOptionsMemoryMapped) && m_seekable && reading && !writing && (fileOptions & fileOptionsBinary))
+        MapIntoMemory();
+}
+
+// map the whole file read-only into memory (an empty file stays unmapped)
+void File::MapIntoMemory()
+{
+    m_mappedSize = filesize(m_file);
+    if (m_mappedSize == 0)
+        return;
+#ifdef _WIN32
+    m_mappingHandle = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(m_file)), NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mappingHandle != NULL)
+        m_mappedData = (const char*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (m_mappedData == nullptr)
+    {
+        DWORD error = GetLastError();
+        UnmapFromMemory();
+        RuntimeError("File: cannot memory map %ls, error %x.", m_filename.c_str(), (unsigned int)error);
+    }
+#else
+    void* data = mmap(nullptr, m_mappedSize, PROT_READ, MAP_SHARED, fileno(m_file), 0);
+    if (data == MAP_FAILED)
+        RuntimeError("File: cannot memory map %ls: %s", m_filename.c_str(), strerror(errno));
+    m_mappedData = (const char*)data;
+    madvise(data, m_mappedSize, (m_options & fileOptionsSequential) ? MADV_SEQUENTIAL : MADV_NORMAL);
+#endif
+}
+
+void File::UnmapFromMemory()
+{
+#ifdef _WIN32
+    if (m_mappedData != nullptr)
+        UnmapViewOfFile(m_mappedData);
+    if (m_mappingHandle != NULL)
+        CloseHandle(m_mappingHandle);
+    m_mappingHandle = NULL;
+#else
+    if (m_mappedData != nullptr)
+        munmap((void*)m_mappedData, m_mappedSize);
+#endif
+    m_mappedData = nullptr;
 }
 
 // determine the directory for a given pathname
@@ -258,6 +309,7 @@ bool File::IsTextBased()
 // Note: this does not check for errors when the File corresponds to pipe stream. In this case, use Flush() before closing a file you are writing.
 File::~File(void)
 {
+    UnmapFromMemory();
     int rc = 0;
     if (m_pcloseNeeded)
     {
@@ -843,6 +895,27 @@ void File::SetPosition(uint64_t pos)
     fsetpos(m_file, pos);
 }
 
+// ReadBuffer - get the next 'numBytes' bytes of a binary file, and move past them
+// For a memory-mapped file, this moves the position of m_file, such that all other reads continue after the buffer.
+const char* File::ReadBuffer(size_t numBytes)
+{
+    if (IsTextBased())
+        LogicError("File: ReadBuffer() is for binary files only");
+    if (IsMemoryMapped())
+    {
+        uint64_t pos = GetPosition();
+        if (pos + numBytes > m_mappedSize)
+            RuntimeError("File: attempted to read %d bytes past the end of %ls", (int)(pos + numBytes - m_mappedSize), m_filename.c_str());
+        SetPosition(pos + numBytes);
+        return m_mappedData + pos;
+    }
+    if (m_readBuffer.size() < numBytes)
+        m_readBuffer.resize(numBytes);
+    if (numBytes > 0)
+        freadOrDie(m_readBuffer.data(), 1, numBytes, m_file);
+    return m_readBuffer.data();
+}
+
 // helper to load a matrix from a stream (file or string literal)
 // The input string is expected to contain one line per matrix row (natural printing order for humans).
 // Inputs:
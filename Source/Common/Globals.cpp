@@ -16,5 +16,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     std::atomic<bool> Globals::m_enableShareNodeValueMatrices(false);
     std::atomic<bool> Globals::m_enableHyperCompressMemory(false);
     std::atomic<bool> Globals::m_optimizeGradientAccumulation(true);
+    std::atomic<bool> Globals::m_fuseElementwiseOps(true);
+    std::atomic<bool> Globals::m_aliasInputValues(true);
+    std::atomic<bool> Globals::m_computeInPlace(true);
+    std::atomic<bool> Globals::m_useCudaGraphs(false);
+    std::atomic<size_t> Globals::m_numConcurrentStreams(1);
+    std::atomic<bool> Globals::m_recomputeActivations(false);
+    std::atomic<bool> Globals::m_offloadActivations(false);
+    std::atomic<bool> Globals::m_fuseDropout(false);
+    std::atomic<bool> Globals::m_checkNonFiniteValues(false);
+    std::atomic<bool> Globals::m_optimizeNetworkGraph(false);
 
 }}}
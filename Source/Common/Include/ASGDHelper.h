@@ -6,6 +6,7 @@
 
 #include <list>
 #include "ComputationNetwork.h"
+#include "MPIWrapper.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -62,6 +63,8 @@ ASGDHelper<ElemType>* NewASGDHelper(
     double adjustCoef = 0.2,                                                 // see in DecayCoefficient()
     size_t adjustPerMinibatches = 600,                                       //
     int traceLevel = 0,                                                      // log level
-    int syncPerfStats = 0);                                                  // shown perf data every syncPerfStats
+    int syncPerfStats = 0,                                                   // shown perf data every syncPerfStats
+    const MPIWrapperPtr& pMPI = nullptr,                                     // required by the MPI parameter server
+    bool useMPIParameterServer = false);                                     // Using the built-in parameter server over MPI one-sided communication rather than Multiverso
 
 }}}
@@ -34,8 +34,11 @@ struct GpuData
     GpuValidity validity;
     string name;
     size_t totalMemory;
+    double peakFlops;          // single precision, a multiply-add counted as 2; 0 if unknown
+    double peakBytesPerSecond; // of the device memory; 0 if unknown
     GpuData(int versionMajor, int versionMinor, int deviceId, int cudaCores, GpuValidity validity, const string& name, size_t totalMemory)
-        :versionMajor(versionMajor), versionMinor(versionMinor), deviceId(deviceId), cudaCores(cudaCores), validity(validity), name(name), totalMemory(totalMemory)
+        :versionMajor(versionMajor), versionMinor(versionMinor), deviceId(deviceId), cudaCores(cudaCores), validity(validity), name(name), totalMemory(totalMemory),
+        peakFlops(0), peakBytesPerSecond(0)
     {
     }
 
@@ -45,6 +48,13 @@ std::vector<GpuData> GetAllGpusData();
 GpuData GetGpuData(DEVICEID_TYPE deviceId);
 
 class ConfigParameters;
+// Determines the device from the 'deviceId' parameter ('auto', 'cpu' or a GPU id). For 'auto', these parameters control the placement:
+//     lockGPU = true                 # hold a cross-process lock on the selected GPU for the lifetime of the process
+//     excludedDevices = 1:3          # GPUs never to select
+//     gpuPlacement = "score"         # pick the GPU with the best NVML memory/utilization score (default);
+//                                    # "topology": prefer GPUs on the NUMA node of this process and spread the MPI ranks of a host across GPUs
+//     maxProcessesPerGpu = 1         # >1: up to this many 'auto' processes share a GPU, each holding one of its lock slots,
+//                                    # and the least occupied GPU is handed out first
 DEVICEID_TYPE DeviceFromConfig(const ConfigParameters& config);
 DEVICEID_TYPE DeviceFromConfig(const ScriptableObjects::IConfigRecord& config);
 
@@ -57,6 +67,9 @@ DEVICEID_TYPE GetBestDevice();
 // is different from the best GPU id.
 void OnDeviceSelected(DEVICEID_TYPE deviceId);
 
+// NUMA node the GPU is attached to, -1 if unknown.
+int GetGpuNumaNode(DEVICEID_TYPE deviceId);
+
 #else
 
 static inline DEVICEID_TYPE GetBestDevice()
@@ -66,6 +79,8 @@ static inline DEVICEID_TYPE GetBestDevice()
 
 static inline void OnDeviceSelected(DEVICEID_TYPE) {}
 
+static inline int GetGpuNumaNode(DEVICEID_TYPE) { return -1; }
+
 template <class ConfigRecordType>
 static inline DEVICEID_TYPE DeviceFromConfig(const ConfigRecordType& /*config*/)
 {
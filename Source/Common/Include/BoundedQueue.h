@@ -0,0 +1,74 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BoundedQueue.h -- a blocking FIFO queue of limited capacity, to connect the stages of a pipeline of threads
+
+#pragma once
+
+#include "Basics.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Push() waits while the queue is full, Pop() while it is empty, so that a fast stage cannot run
+// more than 'capacity' items ahead of the next one.
+// Close() ends the queue: the items in it can still be popped, after that Pop() returns false; Push() returns false right away.
+template <class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : m_capacity(capacity), m_closed(false)
+    {
+        if (capacity == 0)
+            InvalidArgument("BoundedQueue: The capacity must be at least 1.");
+    }
+
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed)
+            return false;
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty())
+            return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    size_t Capacity() const { return m_capacity; }
+
+private:
+    const size_t m_capacity;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque<T> m_items;
+    bool m_closed;
+
+    DISABLE_COPY_AND_MOVE(BoundedQueue);
+};
+
+}}}
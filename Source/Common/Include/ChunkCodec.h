@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <limits>
+#include <string>
+#include <vector>
+#include "Basics.h"
+#ifdef USE_ZIP
+// zlib is a dependency of libzip, so it is available whenever libzip is.
+#include <zlib.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Codecs for the payload of a chunk in the binary format (version 2 and later), and of a tensor segment
+// in the segmented model format of the library (see CNTKv2LibraryDll/Serialization.cpp).
+// The codec and the size of the uncompressed chunk are recorded in the offsets table,
+// so that chunks stay individually addressable.
+enum class ChunkCodec : int32_t
+{
+    None = 0,
+    Deflate = 1 // zlib
+};
+
+inline bool IsChunkCodecSupported(ChunkCodec codec)
+{
+#ifdef USE_ZIP
+    return codec == ChunkCodec::None || codec == ChunkCodec::Deflate;
+#else
+    return codec == ChunkCodec::None;
+#endif
+}
+
+inline ChunkCodec ChunkCodecFromName(const std::wstring& name)
+{
+    if (name.empty() || name == L"none")
+        return ChunkCodec::None;
+    if (name == L"deflate" || name == L"zlib")
+        return ChunkCodec::Deflate;
+    InvalidArgument("Unknown chunk compression '%ls', expected 'none' or 'deflate'.", name.c_str());
+}
+
+// Compresses 'size' bytes of 'data' into 'result'.
+inline void CompressChunk(ChunkCodec codec, const char* data, size_t size, std::vector<char>& result)
+{
+    if (!IsChunkCodecSupported(codec))
+        RuntimeError("Chunk codec %d is not supported by this build.", (int)codec);
+
+    if (codec == ChunkCodec::None)
+    {
+        result.assign(data, data + size);
+        return;
+    }
+
+#ifdef USE_ZIP
+    if (size > (size_t)std::numeric_limits<uLong>::max())
+        RuntimeError("Chunk of %llu bytes is too large to be compressed.", (unsigned long long)size);
+
+    uLongf compressedSize = compressBound((uLong)size);
+    result.resize(compressedSize);
+    int rc = compress2(reinterpret_cast<Bytef*>(result.data()), &compressedSize, reinterpret_cast<const Bytef*>(data), (uLong)size, Z_DEFAULT_COMPRESSION);
+    if (rc != Z_OK)
+        RuntimeError("Failed to compress a chunk of %d bytes (zlib error %d).", (int)size, rc);
+    result.resize(compressedSize);
+#endif
+}
+
+// Decompresses 'size' bytes of 'data' into 'result', which must have room for exactly 'uncompressedSize' bytes.
+inline void DecompressChunk(ChunkCodec codec, const char* data, size_t size, char* result, size_t uncompressedSize)
+{
+    if (!IsChunkCodecSupported(codec))
+        RuntimeError("Chunk codec %d is not supported by this build (was it built without zlib?).", (int)codec);
+
+    if (codec == ChunkCodec::None)
+    {
+        if (size != uncompressedSize)
+            RuntimeError("Unexpected size of an uncompressed chunk (%d vs. %d bytes).", (int)size, (int)uncompressedSize);
+        memcpy(result, data, size);
+        return;
+    }
+
+#ifdef USE_ZIP
+    uLongf actualSize = (uLongf)uncompressedSize;
+    int rc = uncompress(reinterpret_cast<Bytef*>(result), &actualSize, reinterpret_cast<const Bytef*>(data), (uLong)size);
+    if (rc != Z_OK || actualSize != uncompressedSize)
+        RuntimeError("Failed to decompress a chunk (zlib error %d, got %d of %d bytes).", rc, (int)actualSize, (int)uncompressedSize);
+#endif
+}
+
+}}}
@@ -25,6 +25,7 @@
 #include "Basics.h"
 #include "Matrix.h"
 #include "Sequences.h"
+#include "ReaderProfile.h"
 #include "Config.h" // for ConfigParameters
 #include "ScriptableObjects.h"
 #include <map>
@@ -251,6 +252,26 @@ public:
         NOT_IMPLEMENTED;
     }
 
+    // Gets the exact state of the reader at the current sample position, empty if the reader does not support it.
+    virtual std::string GetReaderState()
+    {
+        return std::string();
+    }
+
+    // Restores a state returned by GetReaderState, so that the next minibatch loop starting close to its position
+    // does not replay the input. Returns false if the reader does not support it.
+    virtual bool SetReaderState(const std::string&)
+    {
+        return false;
+    }
+
+    // Gets the profile of the reader since the start of the current minibatch loop. Returns false if the reader
+    // does not collect one.
+    virtual bool GetProfile(ReaderProfile&)
+    {
+        return false;
+    }
+
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize)
     {
         if (SupportsDistributedMBRead() || (numSubsets != 1) || (subsetNum != 0))
@@ -424,6 +445,10 @@ public:
 
     size_t GetCurrentSamplePosition() override;
 
+    std::string GetReaderState() override;
+    bool SetReaderState(const std::string& state) override;
+    bool GetProfile(ReaderProfile& profile) override;
+
     // StartMinibatchLoop - Startup a minibatch loop
     // mbSize - [in] size of the minibatch (number of frames, etc.)
     // epoch - [in] epoch number for this loop
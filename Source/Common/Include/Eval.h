@@ -26,6 +26,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -37,6 +38,13 @@ public:
     // Load a model based on configuration. The syntax is the same as when calling the cntk executable.
     // e.g. "modelFile=model.dat deviceId=0".
     // numCPUThreads can be used to set the thread count of BLAS.
+    // optimizeForEvaluation=true makes StartForwardEvaluation() remove all nodes not needed for the requested outputs,
+    // fold BatchNormalization into preceding Times/Convolution weights, and precompute parameter-only subgraphs.
+    // cudaGraphs=true makes ForwardPass() on a GPU record the forward pass per input shape as a CUDA graph and replay it
+    // for later minibatches of that shape, which saves the cost of launching each kernel (requires CUDA 10.1 or later).
+    // numConcurrentStreams=N lets independent nodes (e.g. parallel branches) run concurrently on N CUDA streams.
+    // outputTopK=K makes the extended interface return only the K largest values of each output sample: its K indices,
+    // then their K scores, in descending order, selected on the device so that only 2K values per sample are transferred.
     // 
     virtual void Init(const std::string& config) = 0;
 
@@ -355,6 +363,198 @@ public:
     // resetRNN - flags whether to reset memory cells of RNN. 
     //
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) = 0;
+
+    //
+    // CreateSession - create another evaluator for the model created by CreateNetwork(). It shares the parameters
+    // of the model (read-only), but has its own internal state (activations and minibatch layout), so that
+    // its ForwardPass() can be called concurrently with that of this object and of other sessions.
+    // The session must be started with StartForwardEvaluation() and released with Destroy(). It does not depend
+    // on the lifetime of this object.
+    //
+    virtual IEvaluateModelExtended<ElemType>* CreateSession() = 0;
+
+    //
+    // ForwardPassBatch - Evaluate several independent requests in one forward pass. Each request is passed to
+    // the network as one sequence of the minibatch; its inputs and outputs are laid out as for ForwardPass().
+    // Only dense inputs are supported. The inputs of a request must all have the same number of samples.
+    // inputs - one vector of input buffers per request
+    // outputs - one vector of output buffers per request. Must be sized to fit output schema.
+    //
+    virtual void ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) = 0;
+
+    //
+    // BindInput, BindOutput - register caller-owned memory for a dense input or output (by its index in the input
+    // or output schema after StartForwardEvaluation()), for ForwardPassBound(). The memory must hold maxNumSamples
+    // samples, laid out as for ForwardPass(), and stay valid while it is bound; a nullptr buffer unbinds it.
+    // deviceId is where the memory is: -1 for host memory (preferably pinned), else the GPU.
+    // Memory on the device of the model is used by the network directly, without copying; other memory is
+    // copied from and to.
+    //
+    virtual void BindInput(size_t index, ElemType* buffer, int deviceId, size_t maxNumSamples) = 0;
+    virtual void BindOutput(size_t index, ElemType* buffer, int deviceId, size_t maxNumSamples) = 0;
+
+    //
+    // ForwardPassBound - Same as ForwardPass(), with all inputs and outputs in the bound memory.
+    // numSamples - the number of samples of the inputs
+    // numOutputSamples - receives the number of samples of each output. Must be sized to the number of outputs.
+    //
+    virtual void ForwardPassBound(size_t numSamples, std::vector<size_t>& numOutputSamples, bool resetRNN) = 0;
+};
+
+//
+// Statistics of an IEvaluateModelBatching.
+//
+struct BatchingStatistics
+{
+    // Number of requests by the time they were queued: entry i counts those that waited less than 2^i microseconds
+    // (and, for i > 0, at least 2^(i-1)).
+    std::vector<size_t> m_queueTimeHistogram;
+
+    // Number of forward passes by the number of requests in them (entry 0 is not used).
+    std::vector<size_t> m_batchSizeHistogram;
+};
+
+//
+// Batching front-end for an IEvaluateModelExtended (after StartForwardEvaluation()), for servers that get
+// single requests from many callers: the requests are queued, and evaluated together by ForwardPassBatch()
+// once there are maxBatchSize of them or the first of them has waited maxLatencyInMicroseconds.
+// The IEvaluateModelExtended must not be used otherwise while this object exists, and must be destroyed after it.
+//
+template <typename ElemType>
+class IEvaluateModelBatching
+{
+public:
+    //
+    // Evaluate - queue a request, given as for ForwardPass(). The future returns its outputs, or the error
+    // from the forward pass of its batch.
+    //
+    virtual std::future<Values<ElemType>> Evaluate(Values<ElemType>&& inputs) = 0;
+
+    virtual BatchingStatistics GetStatistics() const = 0;
+
+    //
+    // Evaluate the requests still queued and release this object.
+    //
+    virtual void Destroy() = 0;
+};
+
+//
+// Streaming front-end for an IEvaluateModelExtended (after StartForwardEvaluation()) of a recurrent model, for
+// applications that get the frames of many concurrent streams (e.g. audio) chunk by chunk: the chunks of several
+// streams are evaluated as one minibatch, and the recurrent state (PastValue) of each stream is kept on the
+// device between its chunks. Models with FutureValue need a lookahead: the last 'lookahead' frames of each
+// chunk are held back and evaluated again with the next chunk, when the frames after them are known.
+// The IEvaluateModelExtended must not be used otherwise while this object exists, and must be destroyed after it.
+//
+template <typename ElemType>
+class IEvaluateModelStreaming
+{
+public:
+    //
+    // OpenStream - start a new stream, and return its handle.
+    //
+    virtual size_t OpenStream() = 0;
+
+    //
+    // CloseStream - release a stream, discarding the frames that are held back.
+    //
+    virtual void CloseStream(size_t stream) = 0;
+
+    //
+    // ForwardPass - evaluate the next chunk of each of the given streams, in one forward pass.
+    // streams - the stream handles, each at most once
+    // inputs - for each stream, the frames of its chunk, laid out as for ForwardPass(). Only dense inputs are supported.
+    // outputs - for each stream, receives the outputs of the frames that are complete, which lag the inputs by the
+    //           lookahead. Must be sized to fit output schema, for the frames of the chunk plus the lookahead.
+    // endOfStream - for each stream, whether this is its last chunk: then all its frames are completed, and the stream is closed.
+    //
+    virtual void ForwardPass(const std::vector<size_t>& streams, const std::vector<Values<ElemType>>& inputs,
+                             std::vector<Values<ElemType>>& outputs, const std::vector<bool>& endOfStream) = 0;
+
+    virtual void Destroy() = 0;
+};
+
+//
+// A hypothesis of an IEvaluateModelBeamSearch.
+//
+struct BeamSearchHypothesis
+{
+    std::vector<size_t> m_tokens; // without the start and the end token
+    double m_score;               // the sum of the scores of its tokens, including the end token
+    bool m_complete;              // whether it ends with the end token, or was cut off at the maximum length
+};
+
+//
+// Beam search front-end for an IEvaluateModelExtended (after StartForwardEvaluation()) of the decoder of an
+// encoder/decoder model, run one token at a time: the model gets the previous token as a one-hot vector (preferably
+// through a sparse input) and gives the scores of the next token as its only output. The scores are added up along a
+// hypothesis, so they should be log-probabilities. All other inputs are a context that is the same for all steps of a
+// sequence, e.g. the encoding of the source sentence. The recurrent state of the decoder (PastValue) is carried from step to step.
+// The beams of all sequences of a Decode() call are expanded together in one forward pass per step. The best expansions
+// are selected on the device, and the recurrent state of the beams is reordered there by their backpointers, so that
+// only the selected tokens and their scores are copied to the CPU.
+// The IEvaluateModelExtended must not be used otherwise while this object exists, and must be destroyed after it.
+//
+template <typename ElemType>
+class IEvaluateModelBeamSearch
+{
+public:
+    //
+    // Decode - decode several sequences at once.
+    // contexts - for each sequence, one frame of each input of the model except for the token input, in the order of the
+    //            input schema (empty if the token is the only input)
+    // results - receives for each sequence up to beamWidth hypotheses, best first. A sequence is done once it has as many
+    //           complete hypotheses that score at least as well as the best one still being expanded.
+    //
+    virtual void Decode(const std::vector<Values<ElemType>>& contexts, std::vector<std::vector<BeamSearchHypothesis>>& results) = 0;
+
+    virtual void Destroy() = 0;
+};
+
+//
+// Usage of a model in an IEvaluateModelRegistry.
+//
+struct ModelUsage
+{
+    std::wstring m_name;
+    size_t m_parameterBytes;  // size of the parameters of the model
+    bool m_resident;          // whether the parameters are on the device
+    size_t m_numAcquisitions; // number of Acquire() calls
+    size_t m_numPageIns;      // number of times the parameters were brought to the device
+};
+
+//
+// Registry for hosting many models on one device in one process. The models share the CUDA context and the
+// caching allocator of the device. The parameters of models that are not in use are kept in host memory:
+// Acquire() brings them to the device, and evicts those of the least recently used models that are not acquired,
+// as long as the parameters on the device exceed the budget.
+//
+template <typename ElemType>
+class IEvaluateModelRegistry
+{
+public:
+    //
+    // AddModel - create a model from a configuration as for Init() and CreateNetwork() (e.g. "modelPath=model.dnn"),
+    // and start its evaluation for the given outputs (empty for the default ones). Its parameters start in host memory.
+    //
+    virtual void AddModel(const std::wstring& name, const std::string& config, const std::vector<std::wstring>& outputs) = 0;
+
+    //
+    // RemoveModel - release a model. It must not be acquired.
+    //
+    virtual void RemoveModel(const std::wstring& name) = 0;
+
+    //
+    // Acquire - bring the parameters of a model to the device, and return its evaluator (owned by the registry).
+    // The model is not evicted until it is released. Like any evaluator, it is not reentrant; concurrent callers
+    // can use sessions (CreateSession()) of it, which share its parameters and so may also only be used while it is acquired.
+    //
+    virtual IEvaluateModelExtended<ElemType>* Acquire(const std::wstring& name) = 0;
+    virtual void Release(const std::wstring& name) = 0;
+
+    virtual std::vector<ModelUsage> GetUsage() const = 0;
+
+    virtual void Destroy() = 0;
 };
 
 template <typename ElemType>
@@ -362,4 +562,30 @@ void EVAL_API GetEvalExtended(IEvaluateModelExtended<ElemType>** peval);
 extern "C" EVAL_API void GetEvalExtendedF(IEvaluateModelExtended<float>** peval);
 extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval);
 
+template <typename ElemType>
+void EVAL_API GetEvalBatching(IEvaluateModelExtended<ElemType>* eval, size_t maxBatchSize, size_t maxLatencyInMicroseconds, IEvaluateModelBatching<ElemType>** pbatching);
+extern "C" EVAL_API void GetEvalBatchingF(IEvaluateModelExtended<float>* eval, size_t maxBatchSize, size_t maxLatencyInMicroseconds, IEvaluateModelBatching<float>** pbatching);
+extern "C" EVAL_API void GetEvalBatchingD(IEvaluateModelExtended<double>* eval, size_t maxBatchSize, size_t maxLatencyInMicroseconds, IEvaluateModelBatching<double>** pbatching);
+
+template <typename ElemType>
+void EVAL_API GetEvalStreaming(IEvaluateModelExtended<ElemType>* eval, size_t maxNumStreams, size_t lookahead, IEvaluateModelStreaming<ElemType>** pstreaming);
+extern "C" EVAL_API void GetEvalStreamingF(IEvaluateModelExtended<float>* eval, size_t maxNumStreams, size_t lookahead, IEvaluateModelStreaming<float>** pstreaming);
+extern "C" EVAL_API void GetEvalStreamingD(IEvaluateModelExtended<double>* eval, size_t maxNumStreams, size_t lookahead, IEvaluateModelStreaming<double>** pstreaming);
+
+// tokenInputName - the input that gets the previous token; the first step gets startToken, and a hypothesis is complete with endToken
+// maxLength - the maximum number of tokens of a hypothesis, not counting the start and the end token
+template <typename ElemType>
+void EVAL_API GetEvalBeamSearch(IEvaluateModelExtended<ElemType>* eval, const std::wstring& tokenInputName, size_t beamWidth,
+                                size_t startToken, size_t endToken, size_t maxLength, IEvaluateModelBeamSearch<ElemType>** pbeamSearch);
+extern "C" EVAL_API void GetEvalBeamSearchF(IEvaluateModelExtended<float>* eval, const std::wstring& tokenInputName, size_t beamWidth,
+                                            size_t startToken, size_t endToken, size_t maxLength, IEvaluateModelBeamSearch<float>** pbeamSearch);
+extern "C" EVAL_API void GetEvalBeamSearchD(IEvaluateModelExtended<double>* eval, const std::wstring& tokenInputName, size_t beamWidth,
+                                            size_t startToken, size_t endToken, size_t maxLength, IEvaluateModelBeamSearch<double>** pbeamSearch);
+
+// deviceId - the device of all models (-1 for the CPU); maxResidentParameterBytes - the budget for parameters on the device
+template <typename ElemType>
+void EVAL_API GetEvalRegistry(int deviceId, size_t maxResidentParameterBytes, IEvaluateModelRegistry<ElemType>** pregistry);
+extern "C" EVAL_API void GetEvalRegistryF(int deviceId, size_t maxResidentParameterBytes, IEvaluateModelRegistry<float>** pregistry);
+extern "C" EVAL_API void GetEvalRegistryD(int deviceId, size_t maxResidentParameterBytes, IEvaluateModelRegistry<double>** pregistry);
+
 } } }
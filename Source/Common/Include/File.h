@@ -19,6 +19,7 @@
 #include "fileutil.h" // for f{ge,pu}t{,Text}()
 #include <fstream>    // for LoadMatrixFromTextFile() --TODO: change to using this File class
 #include <sstream>
+#include <type_traits>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -34,6 +35,7 @@ enum FileOptions
     fileOptionsRead = 8,                                        // open in read mode
     fileOptionsWrite = 16,                                      // open in write mode
     fileOptionsSequential = 32,                                 // optimize for sequential reads (allocates big buffer)
+    fileOptionsMemoryMapped = 64,                               // map binary files opened for reading into memory, for bulk reads through ReadBuffer()
     fileOptionsReadWrite = fileOptionsRead | fileOptionsWrite,  // read/write mode
 };
 
@@ -99,7 +101,15 @@ private:
     bool m_pcloseNeeded; // was opened with popen(), use pclose() when destructing
     bool m_seekable;     // this stream is seekable
     int m_options;       // FileOptions ored togther
+    const char* m_mappedData; // the whole file if opened with fileOptionsMemoryMapped, else nullptr
+    size_t m_mappedSize;
+#ifdef _WIN32
+    HANDLE m_mappingHandle;
+#endif
+    std::vector<char> m_readBuffer; // backs the spans returned by ReadBuffer() for files that are not mapped
     void Init(const wchar_t* filename, int fileOptions);
+    void MapIntoMemory();
+    void UnmapFromMemory();
 
 public:
     File(const std::wstring& filename, int fileOptions);
@@ -116,6 +126,7 @@ public:
     void SkipToDelimiter(int delim);
 
     bool IsTextBased();
+    bool IsMemoryMapped() const { return m_mappedData != nullptr; }
 
     bool IsUnicodeBOM(bool skip = false);
     bool IsEOF();
@@ -213,6 +224,27 @@ public:
 
     bool IsMarker(FileMarker marker, bool skip = true);
 
+    // ReadBuffer - get the next 'numBytes' bytes of a binary file, and move past them
+    // For a memory-mapped file this is the mapped data itself, otherwise a buffer filled by a single fread(),
+    // which stays valid until the next call to ReadBuffer().
+    const char* ReadBuffer(size_t numBytes);
+
+    // ReadArray - get 'count' values at once, with a single copy in binary files
+    template <typename T>
+    void ReadArray(T* data, size_t count)
+    {
+        static_assert(std::is_arithmetic<T>::value, "ReadArray() is for basic types only");
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                *this >> data[i];
+        }
+        else if (IsMemoryMapped())
+            memcpy(data, ReadBuffer(count * sizeof(T)), count * sizeof(T));
+        else if (count > 0)
+            freadOrDie(data, sizeof(T), count, m_file);
+    }
+
     // get a vector of types
     template <typename T>
     File& operator>>(std::vector<T>& val)
@@ -223,15 +255,8 @@ public:
         this->GetMarker(fileMarkerBeginList, size);
         if (size > 0)
         {
-            for (int i = 0; i < size; i++)
-            {
-                // get list separators if not the first element
-                if (i > 0)
-                    *this >> fileMarkerListSeparator;
-                *this >> element;
-                val.push_back(element);
-            }
-            *this >> fileMarkerEndList;
+            // binary lists of basic types have no separators, so get all elements at once
+            GetListElements(val, size, std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>());
         }
         else
         {
@@ -248,6 +273,31 @@ public:
         return *this;
     }
 
+private:
+    template <typename T>
+    void GetListElements(std::vector<T>& val, size_t size, std::true_type /*basic type*/)
+    {
+        if (IsTextBased())
+            return GetListElements(val, size, std::false_type());
+        val.resize(size);
+        ReadArray(val.data(), size);
+    }
+    template <typename T>
+    void GetListElements(std::vector<T>& val, size_t size, std::false_type /*basic type*/)
+    {
+        T element;
+        for (size_t i = 0; i < size; i++)
+        {
+            // get list separators if not the first element
+            if (i > 0)
+                *this >> fileMarkerListSeparator;
+            *this >> element;
+            val.push_back(element);
+        }
+        *this >> fileMarkerEndList;
+    }
+
+public:
     operator FILE*() const { return m_file; }
 
     // Read a matrix stored in text format from 'filePath' (whitespace-separated columns, newline-separated rows),
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,6 +24,59 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static void DisableGradientAccumulationOptimization() { m_optimizeGradientAccumulation = false; }
         static bool ShouldOptimizeGradientAccumulation() { return m_optimizeGradientAccumulation; }
 
+        // fuse chains of element-wise nodes that need no gradient into single tensor ops (see ComputationNetwork::FuseElementwiseOps())
+        static void EnableElementwiseFusion() { m_fuseElementwiseOps = true; }
+        static void DisableElementwiseFusion() { m_fuseElementwiseOps = false; }
+        static bool ShouldFuseElementwiseOps() { return m_fuseElementwiseOps; }
+
+        // let reshaping nodes use the value matrix of their input instead of a copy (see ComputationNetwork::AliasInputValues())
+        static void EnableValueAliasing() { m_aliasInputValues = true; }
+        static void DisableValueAliasing() { m_aliasInputValues = false; }
+        static bool ShouldAliasInputValues() { return m_aliasInputValues; }
+
+        // let element-wise nodes compute their value over their input's value if nothing else reads it (see ComputationNetwork::ComputeInPlace())
+        static void EnableInPlaceComputation() { m_computeInPlace = true; }
+        static void DisableInPlaceComputation() { m_computeInPlace = false; }
+        static bool ShouldComputeInPlace() { return m_computeInPlace; }
+
+        // replay inference forward passes of a known input shape as CUDA graphs (see ComputationNetwork::ForwardPropCaptured())
+        static void EnableCudaGraphs() { m_useCudaGraphs = true; }
+        static void DisableCudaGraphs() { m_useCudaGraphs = false; }
+        static bool ShouldUseCudaGraphs() { return m_useCudaGraphs; }
+
+        // spread the GPU work of independent nodes over this many CUDA streams (1 = all on the thread's stream)
+        static void SetNumConcurrentStreams(size_t numStreams) { m_numConcurrentStreams = numStreams; }
+        static size_t GetNumConcurrentStreams() { return m_numConcurrentStreams; }
+
+        // recompute activations during backprop instead of keeping them from forward prop, with sqrt(N) segments
+        // (see ComputationNetwork::EnableActivationRecomputation(), which also takes explicit checkpoints)
+        static void EnableActivationRecomputation() { m_recomputeActivations = true; }
+        static void DisableActivationRecomputation() { m_recomputeActivations = false; }
+        static bool ShouldRecomputeActivations() { return m_recomputeActivations; }
+
+        // keep activations that backprop needs in pinned host memory between forward prop and backprop, on GPU
+        // (see ComputationNetwork::EnableActivationOffloading())
+        static void EnableActivationOffloading() { m_offloadActivations = true; }
+        static void DisableActivationOffloading() { m_offloadActivations = false; }
+        static bool ShouldOffloadActivations() { return m_offloadActivations; }
+
+        // dropout that regenerates its mask in backprop from a counter-based generator instead of storing it
+        // (see DropoutNode and Matrix::Dropout()); off by default since the masks differ from those of the node's RNG
+        static void EnableFusedDropout() { m_fuseDropout = true; }
+        static void DisableFusedDropout() { m_fuseDropout = false; }
+        static bool ShouldFuseDropout() { return m_fuseDropout; }
+
+        // merge duplicate nodes and fold constant subgraphs in CompileNetwork() (see ComputationNetwork::OptimizeNetworkGraph())
+        static void EnableGraphOptimization() { m_optimizeNetworkGraph = true; }
+        static void DisableGraphOptimization() { m_optimizeNetworkGraph = false; }
+        static bool ShouldOptimizeNetworkGraph() { return m_optimizeNetworkGraph; }
+
+        // check the value and the input gradients of every node for NaN/Inf, one host sync per node
+        // (SGD turns this on to rerun a minibatch whose device-side check failed, to find the node; see SGD::CheckNonFiniteValues())
+        static void EnableNonFiniteValueChecks() { m_checkNonFiniteValues = true; }
+        static void DisableNonFiniteValueChecks() { m_checkNonFiniteValues = false; }
+        static bool ShouldCheckNonFiniteValues() { return m_checkNonFiniteValues; }
+
         // TODO: Currently the flag is set to false. Should be switched to true after more rigorous testing.
         static bool UseV2Aggregator() { return false; }
 
@@ -54,5 +108,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static std::atomic<bool> m_enableHyperCompressMemory;
         static std::atomic<bool> m_forceConstantRandomSeed;
         static std::atomic<bool> m_optimizeGradientAccumulation;
+        static std::atomic<bool> m_fuseElementwiseOps;
+        static std::atomic<bool> m_aliasInputValues;
+        static std::atomic<bool> m_computeInPlace;
+        static std::atomic<bool> m_useCudaGraphs;
+        static std::atomic<size_t> m_numConcurrentStreams;
+        static std::atomic<bool> m_recomputeActivations;
+        static std::atomic<bool> m_offloadActivations;
+        static std::atomic<bool> m_fuseDropout;
+        static std::atomic<bool> m_checkNonFiniteValues;
+        static std::atomic<bool> m_optimizeNetworkGraph;
     };
 }}}
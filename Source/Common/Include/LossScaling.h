@@ -0,0 +1,79 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LossScaling.h -- loss scaling for training with reduced precision arithmetic, shared by SGD and the V2 Trainer
+//
+
+#pragma once
+
+#include <stddef.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// The gradient of the training criterion is scaled by a factor before backpropagation, so that small gradients
+// do not underflow in reduced precision, and the parameter gradients are divided by it again before the update.
+// With dynamic scaling, a minibatch with non-finite gradients is skipped and the scale is halved, and the scale is
+// doubled after a window of consecutive minibatches with finite gradients.
+class LossScaling
+{
+public:
+    LossScaling(double initialScale = 1, bool dynamic = false, size_t window = 2000)
+        : m_scale(initialScale), m_dynamic(dynamic), m_window(window), m_numFiniteSteps(0), m_numSkippedSteps(0)
+    {
+    }
+
+    // Whether the gradients need to be scaled or checked at all.
+    bool IsEnabled() const
+    {
+        return m_scale != 1 || m_dynamic;
+    }
+
+    bool IsDynamic() const
+    {
+        return m_dynamic;
+    }
+
+    double GetScale() const
+    {
+        return m_scale;
+    }
+
+    // Number of minibatches that were skipped because of non-finite gradients.
+    size_t GetNumSkippedSteps() const
+    {
+        return m_numSkippedSteps;
+    }
+
+    // Called once per minibatch with the result of the check of the gradients (which is only needed when dynamic).
+    // Returns whether the parameters should be updated with the gradients of this minibatch.
+    bool Update(bool gradientsAreFinite)
+    {
+        if (!m_dynamic)
+            return true;
+
+        if (!gradientsAreFinite)
+        {
+            m_scale = m_scale > 1 ? m_scale / 2 : 1;
+            m_numFiniteSteps = 0;
+            m_numSkippedSteps++;
+            return false;
+        }
+
+        if (++m_numFiniteSteps >= m_window)
+        {
+            m_scale *= 2;
+            m_numFiniteSteps = 0;
+        }
+        return true;
+    }
+
+private:
+    double m_scale;
+    bool m_dynamic;
+    size_t m_window;
+    size_t m_numFiniteSteps;
+    size_t m_numSkippedSteps;
+};
+
+}}}
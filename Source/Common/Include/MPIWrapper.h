@@ -20,7 +20,17 @@
 #endif
 #pragma comment(lib, "msmpi.lib")
 
+// The ULFM fault-tolerance extensions (MPIX_Comm_revoke(), MPIX_Comm_shrink()), needed for elastic training,
+// come with Open MPI builds that enable them (--with-ft=ulfm).
+#if defined(OPEN_MPI) && OPEN_MPI
+#include "mpi-ext.h"
+#endif
+#ifdef MPIX_ERR_PROC_FAILED
+#define CNTK_MPI_ULFM
+#endif
+
 #include <errno.h> 
+#include <stdexcept>
 #include <string>
 #include <array>
 #include <vector>
@@ -40,6 +50,16 @@ struct MpiFail : public std::string
     }
 };
 
+// Thrown instead of aborting when an MPI operation failed because another rank died, after MPIWrapper::EnableFaultTolerance().
+// The surviving ranks catch it and continue through MPIWrapper::ShrinkToSurvivors().
+struct MpiWorkerFailure : public std::runtime_error
+{
+    MpiWorkerFailure(const std::string &what)
+        : std::runtime_error(what)
+    {
+    }
+};
+
 static int operator||(int rc, const MpiFail &what)
 {
     if (rc == MPI_SUCCESS)
@@ -50,6 +70,14 @@ static int operator||(int rc, const MpiFail &what)
     fprintf(stderr, "%s, MPI error %d\n", what.c_str(), rc);
     fflush(stderr);
 
+#ifdef CNTK_MPI_ULFM
+    // (errors are only returned rather than fatal with fault tolerance enabled)
+    int errorClass = MPI_SUCCESS;
+    MPI_Error_class(rc, &errorClass);
+    if (errorClass == MPIX_ERR_PROC_FAILED || errorClass == MPIX_ERR_REVOKED)
+        throw MpiWorkerFailure(what);
+#endif
+
     // (special case: we use that code to indicate a missing msmpi.dll...)
     if (rc != MPI_ERR_INTERN)
     {
@@ -82,6 +110,13 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
     // MPI communicator that reflects the current subset selection
     MPI_Comm m_currentComm;
 
+    // On multiple hosts with the same number of ranks each: the ranks of this host, and the ranks
+    // with the same local rank on all hosts (MPI_COMM_NULL otherwise). See HasHostCommunicators().
+    MPI_Comm m_intraHostComm;
+    MPI_Comm m_interHostComm;
+    size_t m_localRank;
+    size_t m_numRanksPerHost;
+
     static MPIWrapperPtr s_mpi;
 
     // MPI_Init() with delay-loading the msmpi.dll (possibly causing a failure if missing; we want to catch that)
@@ -132,7 +167,7 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
 
 public:
     MPIWrapper()
-        : m_currentComm(MPI_COMM_WORLD)
+        : m_currentComm(MPI_COMM_WORLD), m_intraHostComm(MPI_COMM_NULL), m_interHostComm(MPI_COMM_NULL), m_localRank(0), m_numRanksPerHost(1)
     {
         static bool initialized = false;
         if (initialized)
@@ -314,6 +349,16 @@ private:
         }
         Ping("requestnodes (after change)");
 
+        SetUpHostCommunicators(msg);
+
+        fprintf(stderr, "requestnodes [%s]: using %d out of %d MPI nodes on %s (%d requested); we (%d) are %s\n",
+                msg, (int) m_numNodesInUse, (int) m_numMPINodes, m_multiHost ? "multiple hosts" : "a single host",
+                (int) requestednodes, (int) CurrentNodeRank(), IsIdle() ? "out (idle)" : "in (participating)");
+        fflush(stderr);
+    }
+
+    void SetUpHostCommunicators(const char *msg)
+    {
         // If all ranks run on a single host, we can enable optimized communication
         // paths (e.g. NCCL). To determine if a single machine is being used, we
         // check that MPI_Get_processor_name matches for all ranks.
@@ -338,10 +383,46 @@ private:
             }
         }
 
-        fprintf(stderr, "requestnodes [%s]: using %d out of %d MPI nodes on %s (%d requested); we (%d) are %s\n",
-                msg, (int) m_numNodesInUse, (int) m_numMPINodes, m_multiHost ? "multiple hosts" : "a single host",
-                (int) requestednodes, (int) CurrentNodeRank(), IsIdle() ? "out (idle)" : "in (participating)");
-        fflush(stderr);
+        // On multiple hosts, split into a communicator per host and one per local rank across the hosts,
+        // for two-level reductions. Only done if all hosts run the same number of ranks, so that the local
+        // ranks line up. All ranks see the same names, hence take the same decision here.
+        if (m_intraHostComm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_intraHostComm) || MpiFail("requestnodes: MPI_Comm_free");
+        if (m_interHostComm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_interHostComm) || MpiFail("requestnodes: MPI_Comm_free");
+        m_localRank = 0;
+        m_numRanksPerHost = 1;
+        if (m_multiHost && !IsIdle())
+        {
+            std::vector<int> hostOf(m_numNodesInUse); // host = lowest rank on it
+            std::vector<size_t> localRankOf(m_numNodesInUse);
+            std::vector<size_t> ranksOnHost(m_numNodesInUse, 0);
+            for (size_t i = 0; i < m_numNodesInUse; i++)
+            {
+                size_t j = 0;
+                while (strcmp(allNames + j*nameMax, allNames + i*nameMax) != 0)
+                    j++;
+                hostOf[i] = (int) j;
+                localRankOf[i] = ranksOnHost[j]++;
+            }
+            size_t numRanksPerHost = ranksOnHost[0];
+            bool uniform = true;
+            for (size_t i = 0; i < m_numNodesInUse; i++)
+                uniform &= (ranksOnHost[hostOf[i]] == numRanksPerHost);
+
+            if (uniform && numRanksPerHost > 1)
+            {
+                m_localRank = localRankOf[m_myRank];
+                m_numRanksPerHost = numRanksPerHost;
+                MPI_Comm_split(m_currentComm, hostOf[m_myRank], m_myRank, &m_intraHostComm) || MpiFail("requestnodes: MPI_Comm_split");
+                MPI_Comm_split(m_currentComm, (int) m_localRank, m_myRank, &m_interHostComm) || MpiFail("requestnodes: MPI_Comm_split");
+            }
+            else
+            {
+                fprintf(stderr, "requestnodes [%s]: hosts run %s, no per-host communicators\n",
+                        msg, uniform ? "a single rank each" : "different numbers of ranks");
+            }
+        }
     }
 
 public:
@@ -402,6 +483,101 @@ public:
         return m_multiHost;
     }
 
+    // Whether IntraHostCommunicator() and InterHostCommunicator() are available: multiple hosts that run
+    // the same number (> 1) of ranks each. Rank LocalRank() of a host communicates with the ranks with the
+    // same local rank on the other hosts through InterHostCommunicator().
+    bool HasHostCommunicators() const
+    {
+        return m_intraHostComm != MPI_COMM_NULL;
+    }
+    MPI_Comm IntraHostCommunicator() const
+    {
+        return m_intraHostComm;
+    }
+    MPI_Comm InterHostCommunicator() const
+    {
+        return m_interHostComm;
+    }
+    size_t LocalRank() const
+    {
+        return m_localRank;
+    }
+    size_t NumRanksPerHost() const
+    {
+        return m_numRanksPerHost;
+    }
+
+    // -----------------------------------------------------------------------
+    // elastic training (requires an MPI with the ULFM fault-tolerance extensions)
+    // -----------------------------------------------------------------------
+
+    static bool IsFaultToleranceSupported()
+    {
+#ifdef CNTK_MPI_ULFM
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // From now on, the failure of a rank makes the MPI operations of the others throw MpiWorkerFailure instead of aborting the job.
+    void EnableFaultTolerance()
+    {
+#ifdef CNTK_MPI_ULFM
+        MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN) || MpiFail("enablefaulttolerance: MPI_Comm_set_errhandler");
+        if (m_currentComm != MPI_COMM_WORLD)
+            MPI_Comm_set_errhandler(m_currentComm, MPI_ERRORS_RETURN) || MpiFail("enablefaulttolerance: MPI_Comm_set_errhandler");
+        for (MPI_Comm comm : { m_intraHostComm, m_interHostComm })
+        {
+            if (comm != MPI_COMM_NULL)
+                MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN) || MpiFail("enablefaulttolerance: MPI_Comm_set_errhandler");
+        }
+#else
+        RuntimeError("MPIWrapper: elastic training requires an MPI implementation with the ULFM fault-tolerance extensions.");
+#endif
+    }
+
+    // After an MpiWorkerFailure: replaces the communicator by one of the surviving ranks, which are renumbered in their
+    // previous order (the main node is thus the lowest surviving rank). All survivors must call this. Communicators
+    // derived from the old one (e.g. in NcclComm) must be re-created.
+    void ShrinkToSurvivors(const char *msg)
+    {
+#ifdef CNTK_MPI_ULFM
+        int oldRank = m_myRank;
+        size_t oldNumNodes = m_numNodesInUse;
+
+        // make the ranks still blocked in an operation on the old communicator return, then agree on the survivors
+        MPIX_Comm_revoke(m_currentComm);
+        MPI_Comm survivors;
+        MPIX_Comm_shrink(m_currentComm, &survivors) || MpiFail("shrinktosurvivors: MPIX_Comm_shrink");
+        MPI_Comm_set_errhandler(survivors, MPI_ERRORS_RETURN) || MpiFail("shrinktosurvivors: MPI_Comm_set_errhandler");
+
+        // (the old communicators are revoked; errors from freeing them are of no interest)
+        for (MPI_Comm* comm : { &m_intraHostComm, &m_interHostComm })
+        {
+            if (*comm != MPI_COMM_NULL)
+                MPI_Comm_free(comm);
+            *comm = MPI_COMM_NULL;
+        }
+        if (m_currentComm != MPI_COMM_WORLD)
+            MPI_Comm_free(&m_currentComm);
+        m_currentComm = survivors;
+
+        MPI_Comm_rank(m_currentComm, &m_myRank) || MpiFail("shrinktosurvivors: MPI_Comm_rank");
+        MPI_Comm_size(m_currentComm, &m_numMPINodes) || MpiFail("shrinktosurvivors: MPI_Comm_size");
+        m_numNodesInUse = m_numMPINodes;
+        s_myRank = m_myRank;
+        SetUpHostCommunicators(msg);
+
+        fprintf(stderr, "shrinktosurvivors [%s]: %d out of %d MPI nodes survived on %s; we (previously %d) are now %d\n",
+                msg, (int) m_numNodesInUse, (int) oldNumNodes, m_multiHost ? "multiple hosts" : "a single host", oldRank, (int) m_myRank);
+        fflush(stderr);
+#else
+        UNUSED(msg);
+        RuntimeError("MPIWrapper: elastic training requires an MPI implementation with the ULFM fault-tolerance extensions.");
+#endif
+    }
+
     // -----------------------------------------------------------------------
     // data-exchange functions (wrappers around MPI functions)
     // -----------------------------------------------------------------------
@@ -488,6 +664,12 @@ public:
         MPI_Gatherv(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, recvCounts, offsets, GetDataType(receiveData), (int)rootRank, Communicator()) || MpiFail("AllReduceAsync: MPI_Gatherv");
     }
 
+    template <class ElemType>
+    void AllGatherv(const ElemType *sendData, size_t numSendElements, ElemType *receiveData, int recvCounts[], int offsets[]) const
+    {
+        MPI_Allgatherv(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, recvCounts, offsets, GetDataType(receiveData), Communicator()) || MpiFail("AllGatherv: MPI_Allgatherv");
+    }
+
     template <class ElemType>
     void Bcast(ElemType *pData, size_t nData, size_t srcRank)
     {
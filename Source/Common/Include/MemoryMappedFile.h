@@ -0,0 +1,65 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A read-only memory mapping of a whole file.
+// Used by the text format reader to index and parse the input directly from the page cache,
+// without copying it into intermediate buffers, and to load the parameters of frozen models.
+// With 'copyOnWrite', the mapped pages may also be written to; this creates private copies of them
+// and never changes the file.
+class MemoryMappedFile
+{
+public:
+    explicit MemoryMappedFile(const std::wstring& filename, bool copyOnWrite = false);
+    ~MemoryMappedFile();
+
+    // Returns the beginning of the mapped region (nullptr for an empty file).
+    const char* GetData() const { return m_data; }
+
+    // Same, for a mapping with 'copyOnWrite'.
+    char* GetWritableData() const
+    {
+        if (!m_copyOnWrite)
+            LogicError("MemoryMappedFile: The file is mapped read-only.");
+        return const_cast<char*>(m_data);
+    }
+
+    // Returns the size of the mapped region in bytes.
+    size_t GetSize() const { return m_size; }
+
+    // Hints the OS that the given region is going to be read sequentially soon,
+    // so that it can be paged in ahead of the parser.
+    void WillNeed(size_t offset, size_t size) const;
+
+    // Hints the OS that the given region is not going to be read again soon.
+    void DontNeed(size_t offset, size_t size) const;
+
+    // Hints the OS that the file is going to be accessed in a random order (i.e. by chunks),
+    // so that it does not read ahead beyond the regions passed to WillNeed.
+    void AdviseRandomAccess() const;
+
+private:
+    const char* m_data;
+    size_t m_size;
+    bool m_copyOnWrite;
+
+#ifdef _WIN32
+    void* m_fileHandle;    // HANDLE
+    void* m_mappingHandle; // HANDLE
+#else
+    int m_fileDescriptor;
+#endif
+
+    DISABLE_COPY_AND_MOVE(MemoryMappedFile);
+};
+
+}}}
@@ -0,0 +1,117 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// PerformanceCounters -- always-on counters of the training hot path, cheap enough to update every minibatch:
+// throughput, time spent waiting for the reader, device memory of the allocator cache, bytes and wait time of the
+// gradient communication, and, every N-th minibatch only, forward and backward time per node.
+// A snapshot can be taken at any time from any thread (e.g. by the V2 API), and a background thread can write it
+// periodically to a JSON file for dashboards and stall detection.
+// -----------------------------------------------------------------------
+class PerformanceCounters
+{
+public:
+    enum Counter
+    {
+        // accumulating
+        TrainingSamples,
+        TrainingMinibatches,
+        ReaderWaitMicroseconds,
+        CommunicationBytes,
+        CommunicationWaitMicroseconds,
+        DeviceMemoryCacheHits,
+        DeviceMemoryCacheMisses,
+        // current values
+        DeviceMemoryInUseBytes,
+        DeviceMemoryCachedBytes,
+        DeviceMemoryPeakInUseBytes,
+        NumCounters
+    };
+
+    struct NodeTiming
+    {
+        double m_forwardSeconds;  // totals over the sampled minibatches
+        double m_backwardSeconds;
+        size_t m_numForward;
+        size_t m_numBackward;
+        double m_forwardFlops;    // estimated work in these, 0 if unknown
+        double m_forwardBytes;
+        double m_backwardFlops;
+        double m_backwardBytes;
+    };
+
+    struct Snapshot
+    {
+        std::vector<std::pair<std::string, uint64_t>> m_counters;
+        double m_samplesPerSecond;          // exponentially smoothed over about the last 10 seconds
+        double m_secondsSinceLastMinibatch; // < 0 before the first minibatch
+        std::map<std::wstring, NodeTiming> m_nodeTimings;
+    };
+
+    static PerformanceCounters& Instance();
+
+    static const char* GetName(Counter counter);
+
+    void Add(Counter counter, uint64_t value) { m_counters[counter].fetch_add(value, std::memory_order_relaxed); }
+    void Set(Counter counter, uint64_t value) { m_counters[counter].store(value, std::memory_order_relaxed); }
+    uint64_t Get(Counter counter) const { return m_counters[counter].load(std::memory_order_relaxed); }
+
+    // Per-node timing synchronizes the device around each node, so it is only done for every 'interval'-th minibatch
+    // (0 = never). BeginMinibatch() decides whether the coming minibatch is one of them.
+    void SetNodeTimingInterval(size_t interval) { m_nodeTimingInterval = interval; }
+    void BeginMinibatch();
+    bool IsTimingNodes() const { return m_isTimingNodes; }
+    void AddNodeTiming(const std::wstring& nodeName, double seconds, bool isBackward, double flops = 0, double bytes = 0);
+
+    // counts a minibatch of 'numSamples' samples and updates the throughput
+    void EndMinibatch(size_t numSamples);
+
+    Snapshot TakeSnapshot();
+
+    // Writes a snapshot as JSON to 'path' every 'intervalSeconds' from a background thread, atomically by writing to a
+    // temporary file first, and once more at StopExport(). Another export replaces the running one.
+    void StartExport(const std::wstring& path, double intervalSeconds);
+    void StopExport();
+
+private:
+    PerformanceCounters();
+    ~PerformanceCounters();
+
+    void WriteSnapshot(const std::wstring& path);
+
+    std::atomic<uint64_t> m_counters[NumCounters];
+
+    // throughput; updated by the training thread only, read under the mutex
+    std::mutex m_mutex;
+    std::chrono::steady_clock::time_point m_lastMinibatchTime;
+    bool m_hasMinibatch;
+    double m_samplesPerSecond;
+    size_t m_numRateUpdates;
+
+    size_t m_nodeTimingInterval;
+    size_t m_numMinibatchesBegun;
+    bool m_isTimingNodes;
+    std::map<std::wstring, NodeTiming> m_nodeTimings; // under m_mutex
+
+    std::thread m_exportThread;
+    std::mutex m_exportMutex;
+    std::condition_variable m_exportCondition;
+    bool m_stopExport;
+};
+
+}}}
@@ -0,0 +1,24 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Where the time of a reader goes, collected by the readers built on ReaderLib since the start of the epoch.
+// The times are those of the thread that reads the minibatches (the prefetch thread of the ReaderShim), except
+// for the chunk loads, which may run on their own threads ahead of being needed.
+struct ReaderProfile
+{
+    std::vector<double> m_chunkLoadSeconds; // duration of each chunk load (reading and deserializing the chunk)
+    double m_randomizerSeconds = 0;         // getting the sequences of the minibatches from the randomizer, including
+                                            // waiting for chunk loads and the deserialization and transforms of the sequences
+    double m_packerSeconds = 0;             // packing the sequences into minibatches
+    size_t m_numMinibatches = 0;
+};
+
+}}}
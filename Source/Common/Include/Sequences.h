@@ -109,7 +109,7 @@ struct MBLayout
     // -------------------------------------------------------------------
 
     MBLayout(size_t numParallelSequences, size_t numTimeSteps, const std::wstring &name)
-        : m_distanceToStart(CPUDEVICE), m_distanceToEnd(CPUDEVICE), m_columnsValidityMask(CPUDEVICE)
+        : m_distanceToStart(CPUDEVICE), m_distanceToEnd(CPUDEVICE)
     {
         Init(numParallelSequences, numTimeSteps);
         SetUniqueAxisName(name != L"" ? name : L"DynamicAxis");
@@ -123,8 +123,21 @@ struct MBLayout
     // Use this instead of actual assignment to make it super-obvious that this is not copying the pointer but actual content. The pointer is kept fixed.
     // Use "keepName" if the "identity" of the target is to be preserved, e.g. 
     // while copying from reader space to network space.
+    // If both layouts are complete and have the same structure (e.g. frame mode, or fixed-length sequences), which is
+    // the common case from minibatch to minibatch, only the sequence ids are copied, and the lookup tables are kept.
     void CopyFrom(const MBLayoutPtr& other, bool keepName=false)
     {
+        if (other.get() != this && IsComplete() && other->IsComplete() && HasSameStructure(*other))
+        {
+            m_sequences = other->m_sequences;
+            if (other->m_writable || !m_columnsValidityMask) // (a mask only exists once a layout is locked)
+                m_columnsValidityMask = other->m_columnsValidityMask;
+            m_writable = other->m_writable;
+            if (!keepName)
+                m_axisName = other->m_axisName;
+            return;
+        }
+
         m_numTimeSteps = other->m_numTimeSteps;
         m_numParallelSequences = other->m_numParallelSequences;
         m_sequences = other->m_sequences;
@@ -139,7 +152,7 @@ struct MBLayout
 
         m_timeStepHasGap = other->m_timeStepHasGap;
 
-        m_columnsValidityMask.SetValue(other->m_columnsValidityMask);
+        m_columnsValidityMask = other->m_columnsValidityMask; // (immutable once created, hence shared)
         m_writable = other->m_writable;
 
         if (!keepName)
@@ -186,7 +199,7 @@ public:
         m_distanceToNearestStart.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_distanceToNearestEnd.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_timeStepHasGap.assign(m_numTimeSteps, false);
-        m_columnsValidityMask.Resize(0, 0); // invalidate
+        m_columnsValidityMask.reset(); // invalidate
         // reset state
         m_numFramesDeclared = 0;
         m_numGapFrames = 0;
@@ -201,7 +214,7 @@ public:
     template<typename SequenceInfoVector>
     void InitAsPackedSequences(const SequenceInfoVector& inputSequences,
         /*temp buffer*/std::vector<std::pair<size_t, size_t>>& placement,
-        /*temp buffer*/std::vector<size_t> rowAllocations)
+        /*temp buffer*/std::vector<size_t>& rowAllocations)
     {
         placement.resize(inputSequences.size()); // [sequence index] result goes here (entries are invalid for gaps)
         // determine width of MBLayout
@@ -322,6 +335,40 @@ public:
         return !(*this == other);
     } // duh
 
+    // compare whether two layouts are the same except for their sequence ids
+    // All information derived from a layout (lookup tables, gaps, validity mask) depends on its structure only.
+    bool HasSameStructure(const MBLayout& other) const
+    {
+        return this == &other ||
+               (m_numTimeSteps == other.m_numTimeSteps &&
+                m_numParallelSequences == other.m_numParallelSequences &&
+                HaveSameStructure(m_sequences, other.m_sequences));
+    }
+
+    // the same for the sequences of two layouts of the same dimensions
+    static bool HaveSameStructure(const vector<SequenceInfo>& sequences, const vector<SequenceInfo>& otherSequences)
+    {
+        if (sequences.size() != otherSequences.size())
+            return false;
+        for (size_t i = 0; i < sequences.size(); i++)
+        {
+            const auto& a = sequences[i];
+            const auto& b = otherSequences[i];
+            if (a.s != b.s || a.tBegin != b.tBegin || a.tEnd != b.tEnd || (a.seqId == GAP_SEQUENCE_ID) != (b.seqId == GAP_SEQUENCE_ID))
+                return false;
+        }
+        return true;
+    }
+
+    // hash of the structure, consistent with HasSameStructure()
+    size_t GetStructureHash() const
+    {
+        size_t hash = m_numTimeSteps * 1000003 + m_numParallelSequences;
+        for (const auto& seq : m_sequences)
+            hash = (((hash * 31 + seq.s) * 31 + (size_t) seq.tBegin) * 31 + seq.tEnd) * 2 + (seq.seqId == GAP_SEQUENCE_ID);
+        return hash;
+    }
+
     operator std::string() const
     {
         std::stringstream s;
@@ -518,6 +565,14 @@ private:
             LogicError("Modification attempted on a MBLayout that is no longer writable.");
     }
 
+    // all frames have been declared
+    bool IsComplete() const { return m_numFramesDeclared == GetNumCols(); }
+
+    // Validity masks are cached across layouts of the same structure (per device), since the structure of most
+    // minibatches repeats. This saves computing the mask and copying it to the device for every minibatch.
+    static std::shared_ptr<Matrix<char>> FindCachedColumnsValidityMask(const MBLayout& layout, DEVICEID_TYPE deviceId);
+    static void CacheColumnsValidityMask(const MBLayout& layout, const std::shared_ptr<Matrix<char>>& mask);
+
     // Freeze the MBLayout disallowing further modifications through set operations
     void Lock() const
     {
@@ -569,7 +624,8 @@ private:
     // TODO: We actually just need a boolean matrix for this.
     // A value of 1 indicates that the column has valid content
     // and 0 indicates invalid (aka MinibatchPackingFlags::NoInput)
-    mutable Matrix<char> m_columnsValidityMask;
+    // It is immutable once created, and shared by all layouts of the same structure (see FindCachedColumnsValidityMask()).
+    mutable std::shared_ptr<Matrix<char>> m_columnsValidityMask;
 
     // A boolean flag indicating whether the MBLayout can be further modified
     // When it's value is false, no set operations are allowed on the MBLayout.
@@ -585,6 +641,18 @@ private:
     static std::mutex s_nameIndiciesMutex;
     static std::map<std::wstring, size_t> s_nameIndices;
 
+    // cache of validity masks, see FindCachedColumnsValidityMask()
+    struct ColumnsValidityMaskCacheEntry
+    {
+        size_t structureHash;
+        size_t numTimeSteps;
+        size_t numParallelSequences;
+        vector<SequenceInfo> sequences;
+        std::shared_ptr<Matrix<char>> mask;
+    };
+    static std::mutex s_columnsValidityMaskCacheMutex;
+    static std::vector<ColumnsValidityMaskCacheEntry> s_columnsValidityMaskCache; // (oldest first)
+
 public:
 
     // special accessor for sequence training  --TODO: must be replaced by a different mechanism
@@ -873,7 +941,7 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
 // TODO: Remove this version (with sanity checks) after this has been tested. Then the function can be inlined above.
 inline size_t MBLayout::GetActualNumSamples() const { return m_numFramesDeclared - m_numGapFrames; }
 
-// return m_columnsValidityMask(,), which is lazily created here upon first call
+// return m_columnsValidityMask(,), which is lazily created here upon first call, or taken from the cache of masks
 // only called from MaskMissingColumnsTo()
 // TODO: Can probably be faster by using the sequence array directly.
 // TODO: Or should we just blast m_distanceToStart to GPU, and maks based on that? It is small compared to features.
@@ -881,11 +949,15 @@ inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE device
 {
     CheckIsValid();
     // lazily compute the validity mask
-    if (m_columnsValidityMask.IsEmpty())
+    if (!m_columnsValidityMask || m_columnsValidityMask->GetDeviceId() != deviceId)
     {
         assert(HasGaps()); // must only be called if there are gaps
         Lock();
 
+        m_columnsValidityMask = FindCachedColumnsValidityMask(*this, deviceId);
+        if (m_columnsValidityMask)
+            return *m_columnsValidityMask;
+
         // Determine indices of all invalid columns in the minibatch
         // TODO: This can be done more efficiently by using m_sequences[].
         size_t nT = GetNumTimeSteps();
@@ -910,11 +982,12 @@ inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE device
         }
         assert(gapsFound == m_numGapFrames); // sanity check
 
-        if (deviceId != m_columnsValidityMask.GetDeviceId())
-            m_columnsValidityMask = Matrix<char>(deviceId);
-        m_columnsValidityMask.SetValue(1, nS * nT, deviceId, columnsValidityMask.data());
+        auto mask = std::make_shared<Matrix<char>>(deviceId);
+        mask->SetValue(1, nS * nT, deviceId, columnsValidityMask.data());
+        CacheColumnsValidityMask(*this, mask);
+        m_columnsValidityMask = mask;
     }
-    return m_columnsValidityMask;
+    return *m_columnsValidityMask;
 }
 
 // class for defining an iteration over a sequence, forward and backward
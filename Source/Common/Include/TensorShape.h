@@ -794,10 +794,13 @@ private:
 // Nodes that do semantic interpretation of width, height, channel information must know which index they are in.
 // Eventually this can go away once we switch completely to cudnn layout.
 // The cudnn layout is actually our layout in order W,H,C.
+// NHWC stores images channels-last like HWC, i.e. as tensors of (C, W, H), but runs them with the ND engines
+// (cuDNN in NHWC format, or the channels-last GEMM engine on the CPU) instead of the legacy engine.
 enum ImageLayoutKind
 {
     HWC, // legacy; default for NDL
-    CHW  // cudnn; default for BrainScript
+    CHW, // cudnn; default for BrainScript
+    NHWC // channels-last
 };
 static inline std::string ToString(ImageLayoutKind imageLayoutKind)
 {
@@ -805,6 +808,8 @@ static inline std::string ToString(ImageLayoutKind imageLayoutKind)
         return "CHW";
     else if (imageLayoutKind == ImageLayoutKind::HWC)
         return "HWC";
+    else if (imageLayoutKind == ImageLayoutKind::NHWC)
+        return "NHWC";
     else
         LogicError("ImageLayout: Invalid ImageLayoutKind");
 }
@@ -814,8 +819,10 @@ static inline ImageLayoutKind ImageLayoutKindFrom(const wstring& s)
         return ImageLayoutKind::CHW;
     else if (s == L"HWC" || s == L"legacy")
         return ImageLayoutKind::HWC;
+    else if (s == L"NHWC" || s == L"channelsLast")
+        return ImageLayoutKind::NHWC;
     else
-        InvalidArgument("ImageLayoutKindFrom: Unknown ImageLayoutKind '%ls', must be 'CHW' (cudnn) or 'HWC' (CNTK legacy)", s.c_str());
+        InvalidArgument("ImageLayoutKindFrom: Unknown ImageLayoutKind '%ls', must be 'CHW' (cudnn), 'HWC' (CNTK legacy) or 'NHWC' (channelsLast)", s.c_str());
 }
 
 // interpret TensorShape as an image descriptor
@@ -839,7 +846,7 @@ struct ImageDimensions
             m_height      = shape[1];
             m_numChannels = shape[2];
         }
-        else if (imageLayoutKind == ImageLayoutKind::HWC)
+        else if (imageLayoutKind == ImageLayoutKind::HWC || imageLayoutKind == ImageLayoutKind::NHWC)
         {
             m_width      = shape[1];
             m_height     = shape[2];
@@ -857,7 +864,7 @@ struct ImageDimensions
     {
         if (imageLayoutKind == ImageLayoutKind::CHW)
             return TensorShape(width, height, numChannels);
-        else if (imageLayoutKind == ImageLayoutKind::HWC)
+        else if (imageLayoutKind == ImageLayoutKind::HWC || imageLayoutKind == ImageLayoutKind::NHWC)
             return TensorShape(numChannels, width, height);
         else
             LogicError("ImageLayout: Invalid ImageLayoutKind");
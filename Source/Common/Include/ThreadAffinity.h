@@ -0,0 +1,52 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Placement of threads on the CPUs of the machine, used for the OpenMP threads of CPUMatrix
+// and for the threads of the readers.
+// Memory follows the threads: Linux and Windows place a page on the NUMA node of the thread that
+// first touches it, so buffers that pinned threads allocate and fill (including page-locked ones,
+// which are touched when they are locked) stay on the node of these threads.
+enum class ThreadAffinity
+{
+    // Threads are scheduled by the operating system.
+    None = 0,
+    // Threads are distributed round-robin over the NUMA nodes and each is pinned to the CPUs of its node.
+    Numa = 1,
+    // Threads are pinned to the CPUs of the NUMA node nearest to the GPU that consumes their work.
+    Device = 2,
+    // Thread i is pinned to the i-th CPU the process may run on.
+    Compact = 3
+};
+
+// Parses "none", "numa", "device" or "compact" (case-insensitive).
+ThreadAffinity ParseThreadAffinity(const std::wstring& name);
+
+// CPUs of each NUMA node of the machine, indexed by node (nodes without CPUs have none);
+// empty if the topology cannot be determined.
+const std::vector<std::vector<int>>& GetNumaNodeCpus();
+
+// NUMA node of a PCI device given by its bus id (e.g. "0000:3b:00.0"), -1 if unknown.
+int GetNumaNodeOfPciDevice(const std::string& pciBusId);
+
+// NUMA node all CPUs of this process belong to, -1 if the process may run on several nodes.
+int GetProcessNumaNode();
+
+// CPUs the thread 'threadIndex' of 'numThreads' is pinned to under the given affinity, restricted to the
+// CPUs this process may run on. ThreadAffinity::None gives all of those. 'deviceNode' is the node for
+// ThreadAffinity::Device. Empty if the placement cannot be determined, in which case the thread stays as it is.
+std::vector<int> GetThreadCpus(ThreadAffinity affinity, size_t threadIndex, size_t numThreads, int deviceNode = -1);
+
+// Pins the calling thread to the given CPUs. Returns false if there are none or pinning failed.
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus);
+
+}}}
@@ -403,6 +403,25 @@ static inline void byteswap(V &v) throw()
         bytereverse(v[i]);
 }
 
+// byte-swap a buffer of 16-bit or 32-bit values in place
+// These are plain shift loops over the whole buffer, which compilers turn into vector shuffles.
+static inline void byteswap16(void *data, size_t n) throw()
+{
+    uint16_t *p = (uint16_t *) data;
+    for (size_t i = 0; i < n; i++)
+        p[i] = (uint16_t)((p[i] >> 8) | (p[i] << 8));
+}
+
+static inline void byteswap32(void *data, size_t n) throw()
+{
+    uint32_t *p = (uint32_t *) data;
+    for (size_t i = 0; i < n; i++)
+    {
+        const uint32_t v = p[i];
+        p[i] = (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+    }
+}
+
 // execute a block with retry
 // Block must be restartable.
 // Use this when writing/reading small files to those unreliable Windows servers.
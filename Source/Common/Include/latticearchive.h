@@ -23,6 +23,8 @@
 #include <algorithm> // for find()
 #include "simplesenonehmm.h"
 #include "Matrix.h"
+#include "MemoryMappedFile.h"
+#include <memory>
 
 namespace msra { namespace math {
 
@@ -942,19 +944,78 @@ public:
     {
     }
 
-    size_t freadtag(FILE* f, const char* tag)
+    // sources that fread() can decode a lattice from: a file at its current position, or a lattice in memory
+    class filesource
     {
-        fcheckTag(f, tag);
-        return (unsigned int) fgetint(f);
+        FILE* f;
+
+    public:
+        filesource(FILE* f)
+            : f(f)
+        {
+        }
+        void checktag(const char* tag)
+        {
+            fcheckTag(f, tag);
+        }
+        int getint()
+        {
+            return fgetint(f);
+        }
+        void read(void* p, size_t numbytes)
+        {
+            freadOrDie(p, numbytes, 1, f);
+        }
+    };
+
+    class memorysource // e.g. a memory-mapped archive
+    {
+        const char* p;
+        const char* end;
+
+    public:
+        memorysource(const char* data, size_t size)
+            : p(data), end(data + size)
+        {
+        }
+        void checktag(const char* tag)
+        {
+            char buf[4];
+            read(buf, sizeof(buf));
+            if (memcmp(buf, tag, sizeof(buf)) != 0)
+                RuntimeError("fread: invalid tag '%.4s' found; expected '%s'", buf, tag);
+        }
+        int getint()
+        {
+            int v;
+            read(&v, sizeof(v));
+            return v;
+        }
+        void read(void* dst, size_t numbytes)
+        {
+            if (numbytes > (size_t)(end - p))
+                RuntimeError("fread: unexpected end of lattice data");
+            memcpy(dst, p, numbytes);
+            p += numbytes;
+        }
+    };
+
+    template <class SOURCE>
+    size_t freadtag(SOURCE& source, const char* tag)
+    {
+        source.checktag(tag);
+        return (unsigned int) source.getint();
     }
 
-    template <class VECTOR>
-    void freadvector(FILE* f, const char* tag, VECTOR& v, size_t expectedsize = SIZE_MAX)
+    template <class SOURCE, class VECTOR>
+    void freadvector(SOURCE& source, const char* tag, VECTOR& v, size_t expectedsize = SIZE_MAX)
     {
-        const size_t sz = freadtag(f, tag);
+        const size_t sz = freadtag(source, tag);
         if (expectedsize != SIZE_MAX && sz != expectedsize)
             RuntimeError("freadvector: malformed file, number of vector elements differs from head, for tag %s", tag);
-        freadOrDie(v, sz, f);
+        v.resize(sz);
+        if (sz > 0)
+            source.read(&v[0], sz * sizeof(v[0]));
     }
 
     // read from a stream
@@ -966,30 +1027,45 @@ public:
     // V1 lattices will be converted. 'spsenoneid' is used in that process.
     template <class IDMAP>
     void fread(FILE* f, const IDMAP& idmap, size_t spunit)
+    {
+        filesource source(f);
+        freadfrom(source, idmap, spunit);
+    }
+
+    // same from memory, e.g. from a memory-mapped archive; 'size' only bounds the reading, the lattice may end before
+    template <class IDMAP>
+    void fread(const char* data, size_t size, const IDMAP& idmap, size_t spunit)
+    {
+        memorysource source(data, size);
+        freadfrom(source, idmap, spunit);
+    }
+
+    template <class SOURCE, class IDMAP>
+    void freadfrom(SOURCE& f, const IDMAP& idmap, size_t spunit)
     {
         size_t version = freadtag(f, "LAT ");
         if (version == 1)
         {
-            freadOrDie(&info, sizeof(info), 1, f);
+            f.read(&info, sizeof(info));
             freadvector(f, "NODE", nodes, info.numnodes);
             if (nodes.back().t != info.numframes)
                 RuntimeError("fread: mismatch between info.numframes and last node's time");
             freadvector(f, "EDGE", edges, info.numedges);
             freadvector(f, "ALIG", align);
-            fcheckTag(f, "END ");
+            f.checktag("END ");
             // map align ids to user's symmap  --the lattice gets updated in place here
             foreach_index (k, align)
                 align[k].updateunit(idmap); // updates itself
         }
         else if (version == 2)
         {
-            freadOrDie(&info, sizeof(info), 1, f);
+            f.read(&info, sizeof(info));
             freadvector(f, "NODS", nodes, info.numnodes);
             if (nodes.back().t != info.numframes)
                 RuntimeError("fread: mismatch between info.numframes and last node's time");
             freadvector(f, "EDGS", edges2, info.numedges); // uniqued edges
             freadvector(f, "ALNS", uniquededgedatatokens); // uniqued alignments
-            fcheckTag(f, "END ");
+            f.checktag("END ");
 // check if we need to map
 #if 1                                                                                     // post-bugfix for incorrect inference of spunit
             if (info.impliedspunitid != SIZE_MAX && info.impliedspunitid >= idmap.size()) // we have buggy lattices like that--what do they mean??
@@ -1098,6 +1174,8 @@ public:
         void setloglls(const Microsoft::MSR::CNTK::Matrix<double>& loglls);
         void getgamma(Microsoft::MSR::CNTK::Matrix<float>& loglls);
         void getgamma(Microsoft::MSR::CNTK::Matrix<double>& loglls);
+        // device memory for keeping lattices on the GPU across epochs (0 = upload each lattice every time)
+        void setlatticecachesize(size_t maxbytes);
     };
 
     // forward-backward function
@@ -1210,12 +1288,44 @@ class archive
     };
     static_assert(sizeof(latticeref) == 8, "unexpected byte size of struct latticeref");
 
-    mutable size_t currentarchiveindex;               // which archive is open
-    mutable auto_file_ptr f;                          // cached archive file handle of currentarchiveindex
     std::unordered_map<std::wstring, latticeref> toc; // [key] -> (file, offset)  --table of content (.toc file)
+
+    // Archive files are memory-mapped on first use, and lattices are decoded directly from the mapping,
+    // i.e. without a file handle to seek and without intermediate buffers.
+    mutable std::vector<std::unique_ptr<Microsoft::MSR::CNTK::MemoryMappedFile>> mappedarchives; // [archiveindex]
+    const Microsoft::MSR::CNTK::MemoryMappedFile& getmappedarchive(size_t archiveindex) const
+    {
+        auto& mapped = mappedarchives[archiveindex];
+        if (!mapped)
+        {
+            if (verbosity > 0)
+                fprintf(stderr, "getmappedarchive: mapping '%S'\n", archivepaths[archiveindex].c_str());
+            mapped.reset(new Microsoft::MSR::CNTK::MemoryMappedFile(archivepaths[archiveindex]));
+            mapped->AdviseRandomAccess(); // lattices are read in the (random) order of the chunks that use them
+        }
+        return *mapped;
+    }
+
+    // [archiveindex] sorted offsets of all lattices, to know where a lattice ends (built on first use)
+    mutable std::vector<std::vector<uint64_t>> archiveoffsets;
+    size_t getlatticebytes(const latticeref& ref) const
+    {
+        if (archiveoffsets.empty())
+        {
+            archiveoffsets.resize(archivepaths.size());
+            for (const auto& entry : toc)
+                archiveoffsets[entry.second.archiveindex].push_back(entry.second.offset);
+            for (auto& offsets : archiveoffsets)
+                std::sort(offsets.begin(), offsets.end());
+        }
+        const auto& offsets = archiveoffsets[ref.archiveindex];
+        auto next = std::upper_bound(offsets.begin(), offsets.end(), (uint64_t) ref.offset);
+        const size_t archivesize = getmappedarchive(ref.archiveindex).GetSize();
+        return (size_t)((next != offsets.end() ? *next : archivesize) - ref.offset);
+    }
+
 public:
     // construct = open the archive
-    // archive() : currentarchiveindex (SIZE_MAX) {}
     void setverbosity(int veb) const
     {
         verbosity = veb;
@@ -1228,7 +1338,7 @@ public:
 
     // construct from a list of TOC files
     archive(const std::vector<std::wstring>& tocpaths, const std::unordered_map<std::string, size_t>& modelsymmap, const std::wstring prefixPath = L"")
-        : currentarchiveindex(SIZE_MAX), modelsymmap(modelsymmap), prefixPathInToc(prefixPath), verbosity(0)
+        : modelsymmap(modelsymmap), prefixPathInToc(prefixPath), verbosity(0)
     {
         if (tocpaths.empty()) // nothing to read--keep silent
             return;
@@ -1293,6 +1403,8 @@ public:
 
         // initialize symmaps  --alloc the array, but actually read the symmap on demand
         symmaps.resize(archivepaths.size());
+        mappedarchives.resize(archivepaths.size());
+        archiveoffsets.clear(); // (rebuilt on first use)
     }
 
     // check if a lattice for a given key is available  --do this during initial check ideally
@@ -1313,6 +1425,18 @@ public:
     }
 #endif
 
+    // hint the OS to page in the given lattices ahead of getlattice(), e.g. for the utterances of a chunk
+    // while its features are being read
+    void prefetchlattices(const std::vector<std::wstring>& keys) const
+    {
+        for (const auto& key : keys)
+        {
+            auto iter = toc.find(key);
+            if (iter != toc.end())
+                getmappedarchive(iter->second.archiveindex).WillNeed(iter->second.offset, getlatticebytes(iter->second));
+        }
+    }
+
     // get a lattice
     // This function is designed to be called from a retry loop due to the realistic chance of server disconnects or other server failures.
     // 'key' is supposed to be known to exist. Use haslattice() to ensure. This is because this function is called from a retry loop.
@@ -1335,31 +1459,17 @@ public:
         if (spunit2 != spunit)
             LogicError("getlattice: huh? same lookup of /sp/ gives different result?");
 #endif
-        // open archive file in case it is not the current one
-        if (archiveindex != currentarchiveindex)
-        {
-            f = fopenOrDie(archivepaths[archiveindex], L"rbS"); // or throw (will close old 'f' iff succeeded)
-            currentarchiveindex = archiveindex;
-        }
-        try // (for read operation)
-        {
-            // seek to start
-            fsetpos(f, offset);
-            // get it
-            L.fread(f, idmap, spunit);
-            L.setverbosity(verbosity);
+        // decode it from the mapped archive
+        const auto& mapped = getmappedarchive(archiveindex);
+        if (offset >= mapped.GetSize())
+            RuntimeError("getlattice: offset of lattice '%S' is beyond the end of its archive", key.c_str());
+        L.fread(mapped.GetData() + offset, (size_t)(mapped.GetSize() - offset), idmap, spunit);
+        L.setverbosity(verbosity);
 #ifdef HACK_IN_SILENCE // hack to simulate DEL in the lattice
-            const size_t silunit = getid(modelsymmap, "sil");
-            const bool addsp = true;
-            L.hackinsilencesubstitutionedges(silunit, spunit, addsp);
+        const size_t silunit = getid(modelsymmap, "sil");
+        const bool addsp = true;
+        L.hackinsilencesubstitutionedges(silunit, spunit, addsp);
 #endif
-        }
-        catch (...) // to retry a read error due to a disconnected file handle, we need to reopen the file
-        {
-            currentarchiveindex = SIZE_MAX;
-            f = NULL; // this closes the file handle
-            throw;
-        }
         // check if number of frames is as expected
         if (expectedframes != SIZE_MAX && L.getnumframes() != expectedframes)
             LogicError("getlattice: number of frames mismatch between numerator lattice and features");
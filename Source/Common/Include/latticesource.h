@@ -69,6 +69,12 @@ public:
         L = LP;
     }
 
+    // hint that getlattices() will soon be called for these keys, so that the lattices are paged in meanwhile
+    void prefetchlattices(const std::vector<std::wstring>& keys) const
+    {
+        denlattices.prefetchlattices(keys);
+    }
+
     void setverbosity(int veb)
     {
         verbosity = veb;
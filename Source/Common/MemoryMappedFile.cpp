@@ -0,0 +1,165 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#endif
+#include "MemoryMappedFile.h"
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& filename, bool copyOnWrite) :
+    m_data(nullptr),
+    m_size(0),
+    m_copyOnWrite(copyOnWrite),
+    m_fileHandle(INVALID_HANDLE_VALUE),
+    m_mappingHandle(NULL)
+{
+    m_fileHandle = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+        RuntimeError("Cannot open the input file (%ls), error %x.", filename.c_str(), GetLastError());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_fileHandle, &size))
+    {
+        CloseHandle(m_fileHandle);
+        RuntimeError("Cannot retrieve the size of the input file (%ls), error %x.", filename.c_str(), GetLastError());
+    }
+
+    m_size = (size_t)size.QuadPart;
+    if (m_size == 0)
+        return; // empty files cannot be mapped
+
+    m_mappingHandle = CreateFileMapping(m_fileHandle, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    if (m_mappingHandle != NULL)
+        m_data = (const char*)MapViewOfFile(m_mappingHandle, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+
+    if (m_data == nullptr)
+    {
+        DWORD error = GetLastError();
+        if (m_mappingHandle != NULL)
+            CloseHandle(m_mappingHandle);
+        CloseHandle(m_fileHandle);
+        RuntimeError("Cannot memory map the input file (%ls), error %x.", filename.c_str(), error);
+    }
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mappingHandle != NULL)
+        CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+}
+
+void MemoryMappedFile::WillNeed(size_t offset, size_t size) const
+{
+    if (m_data == nullptr || offset >= m_size)
+        return;
+
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (PVOID)(m_data + offset);
+    range.NumberOfBytes = size < m_size - offset ? size : m_size - offset;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0); // only a hint, errors are ignored
+}
+
+void MemoryMappedFile::DontNeed(size_t, size_t) const
+{
+    // There is no equivalent of MADV_DONTNEED for file views, the working set is trimmed by the OS.
+}
+
+void MemoryMappedFile::AdviseRandomAccess() const
+{
+}
+
+#else
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& filename, bool copyOnWrite) :
+    m_data(nullptr),
+    m_size(0),
+    m_copyOnWrite(copyOnWrite),
+    m_fileDescriptor(-1)
+{
+    m_fileDescriptor = open(msra::strfun::utf8(filename).c_str(), O_RDONLY);
+    if (m_fileDescriptor == -1)
+        RuntimeError("Cannot open the input file (%ls).", filename.c_str());
+
+    struct stat sb;
+    if (fstat(m_fileDescriptor, &sb) == -1)
+    {
+        close(m_fileDescriptor);
+        RuntimeError("Cannot retrieve the size of the input file (%ls).", filename.c_str());
+    }
+
+    m_size = (size_t)sb.st_size;
+    if (m_size == 0)
+        return; // empty files cannot be mapped
+
+    void* data = copyOnWrite ? mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_fileDescriptor, 0)
+                             : mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fileDescriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        close(m_fileDescriptor);
+        RuntimeError("Cannot memory map the input file (%ls).", filename.c_str());
+    }
+
+    m_data = (const char*)data;
+
+    // The index is built in a single sequential pass over the whole file.
+    madvise(data, m_size, MADV_SEQUENTIAL);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data != nullptr)
+        munmap((void*)m_data, m_size);
+    if (m_fileDescriptor != -1)
+        close(m_fileDescriptor);
+}
+
+// madvise requires a page aligned address, rounds the region down to the page boundary
+// and calls madvise with the given advice.
+static void Advise(const char* data, size_t dataSize, size_t offset, size_t size, int advice)
+{
+    if (data == nullptr || offset >= dataSize)
+        return;
+
+    size = std::min(size, dataSize - offset);
+    static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t alignedOffset = offset - offset % pageSize;
+    madvise((void*)(data + alignedOffset), size + (offset - alignedOffset), advice); // only a hint, errors are ignored
+}
+
+void MemoryMappedFile::WillNeed(size_t offset, size_t size) const
+{
+    Advise(m_data, m_size, offset, size, MADV_SEQUENTIAL);
+    Advise(m_data, m_size, offset, size, MADV_WILLNEED);
+}
+
+void MemoryMappedFile::DontNeed(size_t offset, size_t size) const
+{
+    Advise(m_data, m_size, offset, size, MADV_DONTNEED);
+}
+
+void MemoryMappedFile::AdviseRandomAccess() const
+{
+    Advise(m_data, m_size, 0, m_size, MADV_RANDOM);
+}
+
+#endif
+
+}}}
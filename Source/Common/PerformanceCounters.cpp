@@ -0,0 +1,197 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "PerformanceCounters.h"
+#include "Basics.h"
+#include "fileutil.h"
+#include <cmath>
+#include <stdio.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+/*static*/ PerformanceCounters& PerformanceCounters::Instance()
+{
+    static PerformanceCounters s_instance;
+    return s_instance;
+}
+
+PerformanceCounters::PerformanceCounters()
+    : m_hasMinibatch(false), m_samplesPerSecond(0), m_numRateUpdates(0), m_nodeTimingInterval(0), m_numMinibatchesBegun(0), m_isTimingNodes(false), m_stopExport(false)
+{
+    for (auto& counter : m_counters)
+        counter.store(0);
+}
+
+PerformanceCounters::~PerformanceCounters()
+{
+    StopExport();
+}
+
+/*static*/ const char* PerformanceCounters::GetName(Counter counter)
+{
+    switch (counter)
+    {
+    case TrainingSamples:               return "trainingSamples";
+    case TrainingMinibatches:           return "trainingMinibatches";
+    case ReaderWaitMicroseconds:        return "readerWaitMicroseconds";
+    case CommunicationBytes:            return "communicationBytes";
+    case CommunicationWaitMicroseconds: return "communicationWaitMicroseconds";
+    case DeviceMemoryCacheHits:         return "deviceMemoryCacheHits";
+    case DeviceMemoryCacheMisses:       return "deviceMemoryCacheMisses";
+    case DeviceMemoryInUseBytes:        return "deviceMemoryInUseBytes";
+    case DeviceMemoryCachedBytes:       return "deviceMemoryCachedBytes";
+    case DeviceMemoryPeakInUseBytes:    return "deviceMemoryPeakInUseBytes";
+    default:
+        LogicError("PerformanceCounters: Unexpected counter %d.", (int)counter);
+    }
+}
+
+void PerformanceCounters::BeginMinibatch()
+{
+    m_isTimingNodes = m_nodeTimingInterval > 0 && m_numMinibatchesBegun % m_nodeTimingInterval == 0;
+    m_numMinibatchesBegun++;
+}
+
+void PerformanceCounters::AddNodeTiming(const std::wstring& nodeName, double seconds, bool isBackward, double flops, double bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& timing = m_nodeTimings.insert(std::make_pair(nodeName, NodeTiming{0, 0, 0, 0, 0, 0, 0, 0})).first->second;
+    if (isBackward)
+    {
+        timing.m_backwardSeconds += seconds;
+        timing.m_numBackward++;
+        timing.m_backwardFlops += flops;
+        timing.m_backwardBytes += bytes;
+    }
+    else
+    {
+        timing.m_forwardSeconds += seconds;
+        timing.m_numForward++;
+        timing.m_forwardFlops += flops;
+        timing.m_forwardBytes += bytes;
+    }
+}
+
+void PerformanceCounters::EndMinibatch(size_t numSamples)
+{
+    Add(TrainingSamples, numSamples);
+    Add(TrainingMinibatches, 1);
+
+    // Exponential smoothing weighted by time, so that the rate follows the last ~10 seconds regardless of the minibatch rate.
+    const double timeConstantSeconds = 10;
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_hasMinibatch)
+    {
+        double elapsed = std::chrono::duration<double>(now - m_lastMinibatchTime).count();
+        if (elapsed > 0)
+        {
+            double weight = m_numRateUpdates == 0 ? 1 : 1 - exp(-elapsed / timeConstantSeconds); // the first interval sets the rate
+            m_samplesPerSecond += weight * (numSamples / elapsed - m_samplesPerSecond);
+            m_numRateUpdates++;
+        }
+    }
+    m_lastMinibatchTime = now;
+    m_hasMinibatch = true;
+}
+
+PerformanceCounters::Snapshot PerformanceCounters::TakeSnapshot()
+{
+    Snapshot snapshot;
+    for (int counter = 0; counter < NumCounters; counter++)
+        snapshot.m_counters.push_back(std::make_pair(std::string(GetName((Counter)counter)), Get((Counter)counter)));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    snapshot.m_samplesPerSecond = m_samplesPerSecond;
+    snapshot.m_secondsSinceLastMinibatch = m_hasMinibatch ? std::chrono::duration<double>(std::chrono::steady_clock::now() - m_lastMinibatchTime).count() : -1;
+    snapshot.m_nodeTimings = m_nodeTimings;
+    return snapshot;
+}
+
+static void WriteJsonString(FILE* f, const std::string& s)
+{
+    fputc('"', f);
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if ((unsigned char)c < 0x20)
+            fprintf(f, "\\u%04x", (int)c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+void PerformanceCounters::WriteSnapshot(const std::wstring& path)
+{
+    Snapshot snapshot = TakeSnapshot();
+
+    std::wstring tempPath = path + L".tmp";
+    FILE* f = fopenOrDie(tempPath, L"w");
+    fprintf(f, "{\n");
+    for (const auto& counter : snapshot.m_counters)
+        fprintf(f, "  \"%s\": %llu,\n", counter.first.c_str(), (unsigned long long)counter.second);
+    fprintf(f, "  \"samplesPerSecond\": %.3f,\n", snapshot.m_samplesPerSecond);
+    fprintf(f, "  \"secondsSinceLastMinibatch\": %.3f,\n", snapshot.m_secondsSinceLastMinibatch);
+    fprintf(f, "  \"nodes\": {");
+    const char* separator = "\n";
+    for (const auto& node : snapshot.m_nodeTimings)
+    {
+        fprintf(f, "%s    ", separator);
+        WriteJsonString(f, msra::strfun::utf8(node.first));
+        fprintf(f, ": { \"forwardSeconds\": %.6f, \"numForward\": %llu, \"forwardFlops\": %.0f, \"forwardBytes\": %.0f, "
+                "\"backwardSeconds\": %.6f, \"numBackward\": %llu, \"backwardFlops\": %.0f, \"backwardBytes\": %.0f }",
+                node.second.m_forwardSeconds, (unsigned long long)node.second.m_numForward, node.second.m_forwardFlops, node.second.m_forwardBytes,
+                node.second.m_backwardSeconds, (unsigned long long)node.second.m_numBackward, node.second.m_backwardFlops, node.second.m_backwardBytes);
+        separator = ",\n";
+    }
+    fprintf(f, "\n  }\n}\n");
+    fcloseOrDie(f);
+    renameOrDie(tempPath, path);
+}
+
+void PerformanceCounters::StartExport(const std::wstring& path, double intervalSeconds)
+{
+    if (intervalSeconds <= 0)
+        InvalidArgument("PerformanceCounters: The export interval must be positive.");
+
+    StopExport();
+    m_stopExport = false;
+    m_exportThread = std::thread([this, path, intervalSeconds]()
+    {
+        for (bool stop = false; !stop;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_exportMutex);
+                stop = m_exportCondition.wait_for(lock, std::chrono::duration<double>(intervalSeconds), [this]() { return m_stopExport; });
+            }
+            try
+            {
+                WriteSnapshot(path);
+            }
+            catch (const std::exception& e) // e.g. a full disk; training goes on
+            {
+                fprintf(stderr, "PerformanceCounters: Failed to write '%ls': %s\n", path.c_str(), e.what());
+            }
+        }
+    });
+}
+
+void PerformanceCounters::StopExport()
+{
+    if (!m_exportThread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_exportMutex);
+        m_stopExport = true;
+    }
+    m_exportCondition.notify_all();
+    m_exportThread.join();
+}
+
+}}}
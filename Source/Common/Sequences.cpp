@@ -14,4 +14,34 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     // Todo: After upgrade to VS2015, remove them after both statics are moved into SetUnqiueAxisName as local static variables.
     std::mutex MBLayout::s_nameIndiciesMutex;
     std::map<std::wstring, size_t> MBLayout::s_nameIndices;
+
+    std::mutex MBLayout::s_columnsValidityMaskCacheMutex;
+    std::vector<MBLayout::ColumnsValidityMaskCacheEntry> MBLayout::s_columnsValidityMaskCache;
+
+    // number of distinct layout structures whose validity masks are kept (per device)
+    // Masks are small (one byte per column), but few structures repeat beyond the first few (e.g. the last, partial minibatch).
+    static const size_t c_columnsValidityMaskCacheCapacity = 64;
+
+    std::shared_ptr<Matrix<char>> MBLayout::FindCachedColumnsValidityMask(const MBLayout& layout, DEVICEID_TYPE deviceId)
+    {
+        const size_t structureHash = layout.GetStructureHash();
+        std::lock_guard<std::mutex> lock(s_columnsValidityMaskCacheMutex);
+        for (const auto& entry : s_columnsValidityMaskCache)
+        {
+            if (entry.structureHash == structureHash && entry.mask->GetDeviceId() == deviceId &&
+                entry.numTimeSteps == layout.m_numTimeSteps && entry.numParallelSequences == layout.m_numParallelSequences &&
+                HaveSameStructure(entry.sequences, layout.m_sequences))
+                return entry.mask;
+        }
+        return nullptr;
+    }
+
+    void MBLayout::CacheColumnsValidityMask(const MBLayout& layout, const std::shared_ptr<Matrix<char>>& mask)
+    {
+        ColumnsValidityMaskCacheEntry entry{ layout.GetStructureHash(), layout.m_numTimeSteps, layout.m_numParallelSequences, layout.m_sequences, mask };
+        std::lock_guard<std::mutex> lock(s_columnsValidityMaskCacheMutex);
+        if (s_columnsValidityMaskCache.size() >= c_columnsValidityMaskCacheCapacity)
+            s_columnsValidityMaskCache.erase(s_columnsValidityMaskCache.begin());
+        s_columnsValidityMaskCache.push_back(std::move(entry));
+    }
 }}}
@@ -0,0 +1,273 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#include <SetupAPI.h>
+#include <devpkey.h>
+#pragma comment(lib, "setupapi.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+#include "ThreadAffinity.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ThreadAffinity ParseThreadAffinity(const std::wstring& name)
+{
+    if (name.empty() || EqualCI(name, L"none"))
+        return ThreadAffinity::None;
+    if (EqualCI(name, L"numa"))
+        return ThreadAffinity::Numa;
+    if (EqualCI(name, L"device"))
+        return ThreadAffinity::Device;
+    if (EqualCI(name, L"compact"))
+        return ThreadAffinity::Compact;
+    InvalidArgument("Invalid thread affinity '%ls', must be 'none', 'numa', 'device' or 'compact'.", name.c_str());
+}
+
+#ifndef _WIN32
+// Parses a Linux CPU/node list such as "0-3,8-11".
+static std::vector<int> ParseIdList(const std::string& list)
+{
+    std::vector<int> ids;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        int first, last;
+        char dash;
+        std::stringstream rangeStream(range);
+        if (!(rangeStream >> first))
+            continue;
+        if (!(rangeStream >> dash >> last))
+            last = first;
+        for (int id = first; id <= last; ++id)
+            ids.push_back(id);
+    }
+    return ids;
+}
+#endif
+
+static std::vector<std::vector<int>> QueryNumaNodeCpus()
+{
+    std::vector<std::vector<int>> nodes;
+#ifdef _WIN32
+    ULONG highestNode = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode))
+        return nodes;
+
+    nodes.resize(highestNode + 1);
+    for (ULONG node = 0; node <= highestNode; ++node)
+    {
+        ULONGLONG mask = 0;
+        if (!GetNumaNodeProcessorMask((UCHAR)node, &mask))
+            continue;
+
+        for (int cpu = 0; cpu < 64; ++cpu)
+        {
+            if (mask & (1ull << cpu))
+                nodes[node].push_back(cpu);
+        }
+    }
+#else
+    std::string online;
+    std::ifstream onlineFile("/sys/devices/system/node/online");
+    if (!std::getline(onlineFile, online))
+        return nodes;
+
+    for (int node : ParseIdList(online))
+    {
+        std::string cpuList;
+        std::ifstream cpuListFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!std::getline(cpuListFile, cpuList))
+            continue;
+
+        if (nodes.size() <= (size_t)node)
+            nodes.resize(node + 1);
+        nodes[node] = ParseIdList(cpuList);
+    }
+#endif
+    return nodes;
+}
+
+const std::vector<std::vector<int>>& GetNumaNodeCpus()
+{
+    static const std::vector<std::vector<int>> s_nodes = QueryNumaNodeCpus();
+    return s_nodes;
+}
+
+// CPUs this process may run on, as they were when first asked (before any thread got pinned).
+static const std::vector<int>& GetProcessCpus()
+{
+    static const std::vector<int> s_cpus = []()
+    {
+        std::vector<int> cpus;
+#ifdef _WIN32
+        DWORD_PTR processMask = 0, systemMask = 0;
+        if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        {
+            for (int cpu = 0; cpu < (int)(8 * sizeof(DWORD_PTR)); ++cpu)
+            {
+                if (processMask & ((DWORD_PTR)1 << cpu))
+                    cpus.push_back(cpu);
+            }
+        }
+#else
+        // the affinity of the main thread, which stands for the process
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(getpid(), sizeof(set), &set) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+            }
+        }
+#endif
+        return cpus;
+    }();
+    return s_cpus;
+}
+
+// CPUs of a node this process may run on.
+static std::vector<int> GetProcessCpusOnNode(int node)
+{
+    std::vector<int> cpus;
+    const auto& nodes = GetNumaNodeCpus();
+    if (node < 0 || (size_t)node >= nodes.size())
+        return cpus;
+
+    const auto& processCpus = GetProcessCpus();
+    for (int cpu : nodes[node])
+    {
+        if (std::find(processCpus.begin(), processCpus.end(), cpu) != processCpus.end())
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+int GetNumaNodeOfPciDevice(const std::string& pciBusId)
+{
+#ifdef _WIN32
+    // domain:bus:device.function in hex; Windows reports the bus number and (device << 16 | function) of each PCI device
+    unsigned int domain, bus, device, function;
+    if (sscanf(pciBusId.c_str(), "%x:%x:%x.%x", &domain, &bus, &device, &function) != 4)
+        return -1;
+
+    HDEVINFO deviceInfoSet = SetupDiGetClassDevsW(NULL, L"PCI", NULL, DIGCF_PRESENT | DIGCF_ALLCLASSES);
+    if (deviceInfoSet == INVALID_HANDLE_VALUE)
+        return -1;
+    int node = -1;
+    SP_DEVINFO_DATA deviceInfo = { sizeof(SP_DEVINFO_DATA) };
+    for (DWORD index = 0; SetupDiEnumDeviceInfo(deviceInfoSet, index, &deviceInfo); ++index)
+    {
+        DWORD busNumber, address;
+        if (!SetupDiGetDeviceRegistryPropertyW(deviceInfoSet, &deviceInfo, SPDRP_BUSNUMBER, NULL, (PBYTE)&busNumber, sizeof(busNumber), NULL) ||
+            !SetupDiGetDeviceRegistryPropertyW(deviceInfoSet, &deviceInfo, SPDRP_ADDRESS, NULL, (PBYTE)&address, sizeof(address), NULL) ||
+            busNumber != bus || address != ((device << 16) | function))
+            continue;
+
+        DEVPROPTYPE type;
+        ULONG numaNode;
+        if (SetupDiGetDevicePropertyW(deviceInfoSet, &deviceInfo, &DEVPKEY_Numa_Node, &type, (PBYTE)&numaNode, sizeof(numaNode), NULL, 0) &&
+            type == DEVPROP_TYPE_UINT32)
+            node = (int)numaNode;
+        break; // machines with several PCI segments may repeat a bus number; the first match is taken
+    }
+    SetupDiDestroyDeviceInfoList(deviceInfoSet);
+    return node;
+#else
+    // sysfs uses lower case hex digits, while CUDA reports upper case ones
+    std::string busId = pciBusId;
+    std::transform(busId.begin(), busId.end(), busId.begin(), ::tolower);
+    std::ifstream numaNodeFile("/sys/bus/pci/devices/" + busId + "/numa_node");
+    int node = -1;
+    if (!(numaNodeFile >> node)) // the kernel reports -1 itself if the platform has no NUMA information
+        node = -1;
+    return node;
+#endif
+}
+
+int GetProcessNumaNode()
+{
+    const auto& nodes = GetNumaNodeCpus();
+    for (int node = 0; node < (int)nodes.size(); ++node)
+    {
+        size_t numCpusOnNode = GetProcessCpusOnNode(node).size();
+        if (numCpusOnNode == 0)
+            continue;
+        return numCpusOnNode == GetProcessCpus().size() ? node : -1;
+    }
+    return -1;
+}
+
+std::vector<int> GetThreadCpus(ThreadAffinity affinity, size_t threadIndex, size_t numThreads, int deviceNode)
+{
+    UNUSED(numThreads);
+    const auto& processCpus = GetProcessCpus();
+    switch (affinity)
+    {
+    case ThreadAffinity::None:
+        return processCpus;
+    case ThreadAffinity::Compact:
+        if (processCpus.empty())
+            return std::vector<int>();
+        return std::vector<int>{processCpus[threadIndex % processCpus.size()]};
+    case ThreadAffinity::Device:
+        return GetProcessCpusOnNode(deviceNode);
+    case ThreadAffinity::Numa:
+    {
+        // round-robin over the nodes that have CPUs for us
+        std::vector<std::vector<int>> usableNodes;
+        for (int node = 0; node < (int)GetNumaNodeCpus().size(); ++node)
+        {
+            auto cpus = GetProcessCpusOnNode(node);
+            if (!cpus.empty())
+                usableNodes.push_back(std::move(cpus));
+        }
+        if (usableNodes.empty())
+            return std::vector<int>();
+        return usableNodes[threadIndex % usableNodes.size()];
+    }
+    default:
+        LogicError("GetThreadCpus: Unexpected thread affinity %d.", (int)affinity);
+    }
+}
+
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus)
+{
+    if (cpus.empty())
+        return false;
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+    {
+        if (cpu < (int)(8 * sizeof(DWORD_PTR)))
+            mask |= (DWORD_PTR)1 << cpu;
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+}}}
@@ -48,6 +48,9 @@ struct ComputationEnvironment
     // Extreme tracing of node outputs. Make space on your disk.
     bool IsLogLevelNodeTrace() const { return traceLevel >= 1000000; }
 
+    // packed sequence execution: nodes that support it compute on the valid columns of a minibatch only, skipping its gaps
+    bool packedSequenceExecution = false;
+
     // more properties should be added here as needed
 };
 typedef std::shared_ptr<ComputationEnvironment> ComputationEnvironmentPtr;
@@ -21,11 +21,17 @@
 #include "SpecialPurposeNodes.h"
 #include "DeprecatedNodes.h" // (for SaveToDbnFile(), which is also deprecated)
 #include "MPIWrapper.h" // TODO: does not belong here
+#include "MemoryMappedFile.h"
+#include "CUDAPageLockedMemAllocator.h"
 #include <string>
 #include <vector>
 #include <stack>
 #include <list>
 #include <set>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
 
 using namespace std;
 
@@ -36,15 +42,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <>
-vector<shared_ptr<Matrix<float>>>& MatrixPool::GetReleasedMatrices<float>()
+MatrixPool::PoolState<float>& MatrixPool::GetState<float>()
 {
-    return m_releasedFloatMatrices;
+    return m_floatState;
 }
 
 template <>
-vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
+MatrixPool::PoolState<double>& MatrixPool::GetState<double>()
 {
-    return m_releasedDoubleMatrices;
+    return m_doubleState;
 }
 
 // -----------------------------------------------------------------------
@@ -76,6 +82,7 @@ void ComputationNetwork::ClearNetwork()
     }
 
     m_nameToNodeMap.clear();
+    m_deferredParameterValues.clear();
 
     m_pMBLayoutOfNetwork->Init(1, 0);
 }
@@ -95,6 +102,7 @@ void ComputationNetwork::SaveEdited(const wstring& fileName, const FileOptions f
 void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFormat) const
 {
     VerifyIsCompiled("Save");
+    LoadDeferredParameterValues();
     // Saving into temporary file and then renaming it to the requested fileName
     // This is a standard trick to avoid havign corrupted model files if process dies during writing
     wstring tmpFileName = fileName + L".tmp";
@@ -141,6 +149,16 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
 
+    SaveRelationsAndRootNodes(fstream);
+
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECN");
+
+    fstream.Flush();
+}
+
+// save the connections between the nodes and the node groups (shared by Save() and SaveFrozen())
+void ComputationNetwork::SaveRelationsAndRootNodes(File& fstream) const
+{
     // put relationship
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BRelation");
     for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
@@ -190,17 +208,25 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EOutputNodes");
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ERootNodes");
+}
 
-    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECN");
-
-    fstream.Flush();
+// helper of ReadPersistableParameters(): loads the node if it is a LearnableParameter<ElemType>, deferring the read of its value if possible
+template <class ElemType>
+static bool TryLoadParameterDeferringValue(const ComputationNodeBasePtr& node, File& fstream, size_t modelVersion, bool& isValueDeferred, uint64_t& valuePosition)
+{
+    auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+    if (!parameter)
+        return false;
+    isValueDeferred = parameter->LoadDeferringValue(fstream, modelVersion, valuePosition);
+    return true;
 }
 
 // load the section of nodes that contain persistable parameters
 // This is also used for reloading a model without recreating it, e.g. during training.
+// With 'deferValues', the values of the parameters are only skipped, for LoadDeferredParameterValues().
 // TODO: Why not just reload it? Because SGD::Train() holds pointers to the parameters directly? That should be fixed.
 template <class ElemType> // ElemType is the default for models prior to CNTK_MODEL_VERSION_7; after that, it is serialized, and ElemType is ignored
-void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
+void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create, bool deferValues)
 {
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BCN");
 
@@ -240,7 +266,14 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
         else
             RuntimeError("Read: Unexpected precision tag '%ls'", precision.c_str());
 
-        node->Load(fstream, modelVersion);
+        bool isValueDeferred = false;
+        uint64_t valuePosition = 0;
+        if (!deferValues ||
+            (!TryLoadParameterDeferringValue<float> (node, fstream, modelVersion, isValueDeferred, valuePosition) &&
+             !TryLoadParameterDeferringValue<double>(node, fstream, modelVersion, isValueDeferred, valuePosition)))
+            node->Load(fstream, modelVersion);
+        if (isValueDeferred)
+            m_deferredParameterValues.push_back(DeferredParameterValue{ node, valuePosition });
 
         if (create) // loaded from scratch
             AddNodeToNet(node);
@@ -259,6 +292,9 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
     }
 
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
+
+    if (!create) // reloaded all values, including those that were still deferred
+        m_deferredParameterValues.clear();
 }
 
 // deserialize the model
@@ -266,12 +302,147 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
 template <class ElemType> // for ReadPersistableParameters()
 void ComputationNetwork::Read(const wstring& fileName)
 {
+    if (IsFrozenModelFile(fileName))
+        return ReadFrozen<ElemType>(fileName);
+
     ClearNetwork();
 
-    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead | FileOptions::fileOptionsMemoryMapped);
 
-    ReadPersistableParameters<ElemType>(fstream, true);
+    // the parameter values are read after the rest, if we can come back to them in the file
+    bool deferValues = fstream.CanSeek();
+    m_deferredParameterFileName = fileName;
 
+    ReadPersistableParameters<ElemType>(fstream, true, deferValues);
+
+    ReadRelationsAndRootNodes(fstream);
+
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECN");
+
+    if (!m_lazyParameterLoading)
+        LoadDeferredParameterValues();
+}
+
+// a pinned buffer that grows as needed, through which LoadDeferredParameterValues() reads values for the GPU
+class PinnedReadBuffer
+{
+public:
+    PinnedReadBuffer(DEVICEID_TYPE deviceId) : m_deviceId(deviceId), m_data(nullptr), m_size(0) { }
+    ~PinnedReadBuffer()
+    {
+        if (m_data)
+            CUDAPageLockedMemAllocator::Free(m_data, m_deviceId);
+    }
+    void* Get(size_t size) // null on the CPU, where values are read in place
+    {
+        if (m_deviceId == CPUDEVICE)
+            return nullptr;
+        if (size > m_size)
+        {
+            if (m_data)
+                CUDAPageLockedMemAllocator::Free(m_data, m_deviceId);
+            m_data = nullptr; // (in case Malloc() throws)
+            m_data = CUDAPageLockedMemAllocator::Malloc(size, m_deviceId);
+            m_size = size;
+        }
+        return m_data;
+    }
+
+private:
+    DEVICEID_TYPE m_deviceId;
+    void* m_data;
+    size_t m_size;
+};
+
+// helper of LoadDeferredParameterValues()
+template <class ElemType>
+static bool TryLoadDeferredParameterValue(const ComputationNodeBasePtr& node, File& fstream, uint64_t valuePosition, PinnedReadBuffer& buffer, size_t& numBytes)
+{
+    auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+    if (!parameter)
+        return false;
+    numBytes = parameter->Value().GetNumElements() * sizeof(ElemType);
+    parameter->LoadDeferredValue(fstream, valuePosition, (ElemType*) buffer.Get(numBytes));
+    return true;
+}
+
+void ComputationNetwork::LoadDeferredParameterValues(const ComputationNodeBasePtr& rootNode) const
+{
+    if (m_deferredParameterValues.empty())
+        return;
+
+    // select the values to read
+    vector<DeferredParameterValue> values;
+    if (rootNode)
+    {
+        set<ComputationNodeBasePtr> nodesOfRoot;
+        vector<ComputationNodeBasePtr> nodesToVisit(1, rootNode);
+        while (!nodesToVisit.empty())
+        {
+            auto node = nodesToVisit.back();
+            nodesToVisit.pop_back();
+            if (node && nodesOfRoot.insert(node).second)
+                nodesToVisit.insert(nodesToVisit.end(), node->GetInputs().begin(), node->GetInputs().end());
+        }
+        auto iter = stable_partition(m_deferredParameterValues.begin(), m_deferredParameterValues.end(),
+                                     [&](const DeferredParameterValue& value) { return nodesOfRoot.find(value.m_node) == nodesOfRoot.end(); });
+        values.assign(iter, m_deferredParameterValues.end());
+        m_deferredParameterValues.erase(iter, m_deferredParameterValues.end());
+    }
+    else
+        values.swap(m_deferredParameterValues);
+    if (values.empty())
+        return;
+
+    // Read them with a few threads, each through a File of its own, for the GPU through a pinned buffer of its own,
+    // so that the reads of some threads overlap with the transfers of the others.
+    const size_t maxThreads = 8;
+    size_t numThreads = min(values.size(), min(maxThreads, max<size_t>(thread::hardware_concurrency(), 1)));
+    auto start = chrono::steady_clock::now();
+    atomic<size_t> nextValue(0);
+    atomic<size_t> totalBytes(0);
+    vector<exception_ptr> errors(numThreads);
+    auto ReadValues = [&](size_t threadIndex)
+    {
+        try
+        {
+            File fstream(m_deferredParameterFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+            PinnedReadBuffer buffer(m_deviceId);
+            for (size_t i; (i = nextValue++) < values.size();)
+            {
+                size_t numBytes = 0;
+                if (!TryLoadDeferredParameterValue<float> (values[i].m_node, fstream, values[i].m_position, buffer, numBytes) &&
+                    !TryLoadDeferredParameterValue<double>(values[i].m_node, fstream, values[i].m_position, buffer, numBytes))
+                    LogicError("LoadDeferredParameterValues: %ls is not a LearnableParameter.", values[i].m_node->NodeName().c_str());
+                totalBytes += numBytes;
+            }
+        }
+        catch (...)
+        {
+            errors[threadIndex] = current_exception();
+            nextValue = values.size(); // stop the others
+        }
+    };
+    vector<thread> threads;
+    for (size_t k = 1; k < numThreads; k++)
+        threads.emplace_back(ReadValues, k);
+    ReadValues(0);
+    for (auto& readerThread : threads)
+        readerThread.join();
+    for (const auto& error : errors)
+    {
+        if (error)
+            rethrow_exception(error);
+    }
+
+    if (TraceLevel() > 0)
+        fprintf(stderr, "LoadDeferredParameterValues: Read %d parameter values (%.1f MB) in %.3f seconds with %d threads.\n",
+                (int) values.size(), totalBytes / 1e6, chrono::duration<double>(chrono::steady_clock::now() - start).count(), (int) numThreads);
+}
+
+// counterpart of SaveRelationsAndRootNodes(); all nodes must have been read already
+void ComputationNetwork::ReadRelationsAndRootNodes(File& fstream)
+{
     size_t numNodes = m_nameToNodeMap.size();
 
     // get relationship
@@ -387,8 +558,199 @@ void ComputationNetwork::Read(const wstring& fileName)
         }
     }
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ERootNodes");
+}
 
-    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECN");
+// -----------------------------------------------------------------------
+// frozen models
+// -----------------------------------------------------------------------
+
+// A frozen model consists of
+//  - the network as in Save(), except that the LearnableParameters store the byte offset and matrix dimensions of their value
+//    within the parameter blob instead of the value itself,
+//  - the offset and size of the parameter blob,
+//  - the blob itself, starting at a page boundary, with each value aligned to s_frozenParameterAlignment.
+static const size_t s_frozenModelVersion = 1;
+static const uint64_t s_frozenBlobAlignment = 4096;     // the page size, so that the blob can be mapped as it is
+static const uint64_t s_frozenParameterAlignment = 256; // the alignment of cudaMalloc()
+
+static uint64_t AlignUp(uint64_t offset, uint64_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/*static*/ bool ComputationNetwork::IsFrozenModelFile(const wstring& fileName)
+{
+    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    return fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BFrozenCN");
+}
+
+template <class ElemType>
+void ComputationNetwork::SaveFrozen(const wstring& fileName) const
+{
+    VerifyIsCompiled("SaveFrozen");
+    LoadDeferredParameterValues();
+
+    // lay out the blob
+    map<wstring, uint64_t> parameterOffsets;
+    uint64_t blobSize = 0;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        if (!node->Is<ComputationNode<ElemType>>())
+            RuntimeError("SaveFrozen: %ls is not of the precision of the model (%ls).", node->NodeDescription().c_str(), ElemTypeName<ElemType>());
+        if (node->OperationName() != OperationNameOf(LearnableParameter))
+            continue;
+        const auto& value = node->As<LearnableParameter<ElemType>>()->Value();
+        if (value.GetMatrixType() != MatrixType::DENSE)
+            RuntimeError("SaveFrozen: %ls has a sparse value, which frozen models do not support.", node->NodeDescription().c_str());
+        parameterOffsets[node->NodeName()] = blobSize;
+        blobSize += AlignUp(value.GetNumElements() * sizeof(ElemType), s_frozenParameterAlignment);
+    }
+
+    wstring tmpFileName = fileName + L".tmp";
+    {
+        File fstream(tmpFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.Setvbuf();
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BFrozenCN");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion");
+        fstream << s_frozenModelVersion << (size_t) CURRENT_CNTK_MODEL_VERSION;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+
+        fstream << wstring(ElemTypeName<ElemType>());
+        fstream << (size_t) m_nameToNodeMap.size();
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
+        for (const auto& iter : m_nameToNodeMap)
+        {
+            const auto& node = iter.second;
+            fstream << node->OperationName() << node->NodeName();
+            if (node->OperationName() == OperationNameOf(LearnableParameter))
+            {
+                auto parameter = node->As<LearnableParameter<ElemType>>();
+                parameter->SaveWithoutValue(fstream);
+                fstream << parameterOffsets[node->NodeName()] << parameter->Value().GetNumRows() << parameter->Value().GetNumCols();
+            }
+            else
+                node->Save(fstream);
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
+
+        SaveRelationsAndRootNodes(fstream);
+
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EFrozenCN");
+
+        uint64_t blobOffset = AlignUp(fstream.GetPosition() + 2 * sizeof(uint64_t), s_frozenBlobAlignment);
+        fstream << blobOffset << blobSize;
+
+        // the blob, in the order of parameterOffsets
+        vector<char> padding((size_t) max(s_frozenBlobAlignment, s_frozenParameterAlignment), 0);
+        fwriteOrDie(padding.data(), 1, (size_t) (blobOffset - fstream.GetPosition()), fstream);
+        for (const auto& iter : m_nameToNodeMap)
+        {
+            if (iter.second->OperationName() != OperationNameOf(LearnableParameter))
+                continue;
+            const auto& value = iter.second->As<LearnableParameter<ElemType>>()->Value();
+            size_t numBytes = value.GetNumElements() * sizeof(ElemType);
+            if (numBytes > 0)
+            {
+                unique_ptr<ElemType[]> data(value.CopyToArray());
+                fwriteOrDie(data.get(), sizeof(ElemType), value.GetNumElements(), fstream);
+            }
+            fwriteOrDie(padding.data(), 1, (size_t) (AlignUp(numBytes, s_frozenParameterAlignment) - numBytes), fstream);
+        }
+
+        fstream.Flush();
+    }
+    renameOrDie(tmpFileName, fileName);
+}
+
+// deserialize a frozen model
+// Like Read(), this does not post-process the model (CompileNetwork()).
+template <class ElemType>
+void ComputationNetwork::ReadFrozen(const wstring& fileName)
+{
+    ClearNetwork();
+    m_frozenParameterStorage.reset();
+
+    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BFrozenCN");
+
+    size_t frozenModelVersion, modelVersion;
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BVersion");
+    fstream >> frozenModelVersion >> modelVersion;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+    if (frozenModelVersion > s_frozenModelVersion || modelVersion > CURRENT_CNTK_MODEL_VERSION)
+        InvalidArgument("ReadFrozen: The frozen model %ls has a newer format version than this CNTK version can handle.", fileName.c_str());
+
+    wstring precision;
+    fstream >> precision;
+    if (precision != ElemTypeName<ElemType>())
+        InvalidArgument("ReadFrozen: The frozen model %ls is of precision %ls, but %ls was requested.", fileName.c_str(), precision.c_str(), ElemTypeName<ElemType>());
+
+    size_t numNodes;
+    fstream >> numNodes;
+
+    struct ParameterInBlob
+    {
+        shared_ptr<LearnableParameter<ElemType>> m_node;
+        uint64_t m_offset;
+        size_t m_numRows;
+        size_t m_numCols;
+    };
+    vector<ParameterInBlob> parameters;
+
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        wstring opName, nodeName;
+        fstream >> opName >> nodeName;
+
+        auto node = ComputationNetworkBuilder<ElemType>::NewNode(opName, m_deviceId, nodeName);
+        if (opName == OperationNameOf(LearnableParameter))
+        {
+            ParameterInBlob parameter;
+            parameter.m_node = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+            parameter.m_node->LoadWithoutValue(fstream, modelVersion);
+            fstream >> parameter.m_offset >> parameter.m_numRows >> parameter.m_numCols;
+            parameters.push_back(parameter);
+        }
+        else
+            node->Load(fstream, modelVersion);
+
+        AddNodeToNet(node);
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
+
+    ReadRelationsAndRootNodes(fstream);
+
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EFrozenCN");
+
+    uint64_t blobOffset, blobSize;
+    fstream >> blobOffset >> blobSize;
+
+    // map the blob
+    // On the CPU, the pages are copy-on-write, so that a node that writes into its parameter does not fail (nor change the file).
+    auto mappedFile = make_shared<MemoryMappedFile>(fileName, /*copyOnWrite=*/m_deviceId == CPUDEVICE);
+    if (blobOffset + blobSize > mappedFile->GetSize())
+        RuntimeError("ReadFrozen: The frozen model %ls is truncated.", fileName.c_str());
+    ElemType* blob = (ElemType*) (const_cast<char*>(mappedFile->GetData()) + blobOffset);
+    if (m_deviceId == CPUDEVICE)
+        m_frozenParameterStorage = mappedFile;
+    else if (blobSize > 0)
+    {
+        mappedFile->WillNeed(blobOffset, blobSize);
+        auto deviceBlob = make_shared<Matrix<ElemType>>(1, blobSize / sizeof(ElemType), blob, m_deviceId);
+        m_frozenParameterStorage = deviceBlob; // the mapping is released once the blob is on the device
+        blob = deviceBlob->Data();
+    }
+
+    for (const auto& parameter : parameters)
+    {
+        if (parameter.m_offset + parameter.m_numRows * parameter.m_numCols * sizeof(ElemType) > blobSize)
+            RuntimeError("ReadFrozen: The value of parameter %ls lies outside of the parameter blob.", parameter.m_node->NodeName().c_str());
+        parameter.m_node->BindValue(blob + parameter.m_offset / sizeof(ElemType), parameter.m_numRows, parameter.m_numCols);
+    }
 }
 
 // -----------------------------------------------------------------------
@@ -399,12 +761,12 @@ void ComputationNetwork::Read(const wstring& fileName)
 // Note: This should really be done through an interface without <ElemType> that LearnableParameter would derive from.
 // However, this is only for NDL (which is deprecated), so I rather not pollute the code with more interfaces just for a deprecated cause.
 template<class ElemType>
-static bool TryPostInitParameters(const ComputationNodeBasePtr& node, const wchar_t* initString, double initValue, unsigned long randomSeed, bool initOnCPUOnly)
+static bool TryPostInitParameters(const ComputationNodeBasePtr& node, const wchar_t* initString, double initValue, unsigned long randomSeed, bool initOnCPUOnly, bool initByCounter)
 {
     auto learnableParameterNode = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
     if (!learnableParameterNode)
         return false;
-    learnableParameterNode->PostInitParameters(initString, (ElemType) initValue, randomSeed, initOnCPUOnly);
+    learnableParameterNode->PostInitParameters(initString, (ElemType) initValue, randomSeed, initOnCPUOnly, initByCounter);
     return true;
 }
 
@@ -413,20 +775,21 @@ void ComputationNetwork::InitLearnableParameters(const ComputationNodeBasePtr& n
                                                  const wchar_t* initString, // "uniform"|"gaussian"|"fixedValue"
                                                  double initValue,        //  scale   | scale    | value
                                                  unsigned long randomSeed /*= 0*/,
-                                                 bool initOnCPUOnly /*= false*/) const
+                                                 bool initOnCPUOnly /*= false*/,
+                                                 bool initByCounter /*= false*/) const
 {
     randomSeed += GetRandomSeedOffset();
-    if (TryPostInitParameters<float> (node, initString, initValue, randomSeed, initOnCPUOnly) ||
-        TryPostInitParameters<double>(node, initString, initValue, randomSeed, initOnCPUOnly))
+    if (TryPostInitParameters<float> (node, initString, initValue, randomSeed, initOnCPUOnly, initByCounter) ||
+        TryPostInitParameters<double>(node, initString, initValue, randomSeed, initOnCPUOnly, initByCounter))
         return;
     LogicError("InitLearnableParameters: Input node is not a LearnableParameter<float or double>");
 }
 
 // non-static version needed because it accesses m_randomSeedOffset
 // Legacy version that is for random only.
-void ComputationNetwork::RandomInitLearnableParameters(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly) const
+void ComputationNetwork::RandomInitLearnableParameters(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly, bool initByCounter) const
 {
-    InitLearnableParameters(node, uniformInit ? L"uniform" : L"gaussian", initValueScale, randomSeed, initOnCPUOnly);
+    InitLearnableParameters(node, uniformInit ? L"uniform" : L"gaussian", initValueScale, randomSeed, initOnCPUOnly, initByCounter);
 }
 
 template <class ElemType>
@@ -445,10 +808,10 @@ bool ComputationNetwork::IsTypicalCriterionNode(ComputationNodeBasePtr nodePtr)
         nodePtr->OperationName() == OperationNameOf(SequenceWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(CrossEntropyNode) ||
         nodePtr->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
+        nodePtr->OperationName() == OperationNameOf(SampledSoftmaxWithCrossEntropyNode) ||
+        nodePtr->OperationName() == OperationNameOf(ShardedSoftmaxWithCrossEntropyNode) ||
         nodePtr->OperationName() == OperationNameOf(ClassificationErrorNode) ||
-#ifdef COMING_SOON
         nodePtr->OperationName() == OperationNameOf(CRFNode) ||
-#endif
         nodePtr->OperationName() == OperationNameOf(DummyCriterionNode))
         return true;
 
@@ -472,6 +835,83 @@ list<ComputationNodeBasePtr> ComputationNetwork::GetNodesRequiringPreComputation
     return nodes;
 }
 
+template <class ElemType>
+static bool AggregateMeanInvStdDevStatistics(const ComputationNodeBasePtr& node, const MPIWrapperPtr& mpi, size_t& numSamples)
+{
+    auto statsNode = dynamic_pointer_cast<MeanInvStdDevNodeBase<ElemType>>(node);
+    if (!statsNode)
+        return false;
+
+    // gather the partial statistics of all workers, then let each worker merge them in rank order,
+    // so that all end up with bit-identical results
+    auto stats = statsNode->GetPartialStatistics();
+    size_t numWorkers = mpi ? mpi->NumNodesInUse() : 1;
+    if (numWorkers > 1)
+    {
+        vector<double> allStats(stats.size() * numWorkers);
+        mpi->AllGather(stats.data(), stats.size(), allStats.data(), stats.size());
+        stats.assign(allStats.begin(), allStats.begin() + stats.size());
+        for (size_t i = 1; i < numWorkers; i++)
+            statsNode->MergePartialStatistics(stats, vector<double>(allStats.begin() + i * stats.size(), allStats.begin() + (i + 1) * stats.size()));
+        statsNode->SetPartialStatistics(stats);
+    }
+    numSamples = statsNode->NumAccumulatedSamples();
+    return true;
+}
+
+/*static*/ size_t ComputationNetwork::AggregatePreComputedStatistics(const list<ComputationNodeBasePtr>& nodes, const MPIWrapperPtr& mpi)
+{
+    size_t totalNumSamples = SIZE_MAX;
+    for (const auto& node : nodes)
+    {
+        size_t numSamples;
+        if (AggregateMeanInvStdDevStatistics<float>(node, mpi, numSamples) || AggregateMeanInvStdDevStatistics<double>(node, mpi, numSamples))
+            totalNumSamples = min(totalNumSamples, numSamples);
+    }
+    return totalNumSamples == SIZE_MAX ? 0 : totalNumSamples;
+}
+
+template <class ElemType>
+static shared_ptr<MeanInvStdDevNodeBase<ElemType>> AsMeanInvStdDevNode(const ComputationNodeBasePtr& node)
+{
+    return dynamic_pointer_cast<MeanInvStdDevNodeBase<ElemType>>(node);
+}
+
+/*static*/ map<wstring, vector<double>> ComputationNetwork::GetPreComputedStatistics(const list<ComputationNodeBasePtr>& nodes)
+{
+    map<wstring, vector<double>> stats;
+    for (const auto& node : nodes)
+    {
+        if (auto floatNode = AsMeanInvStdDevNode<float>(node))
+            stats[node->NodeName()] = floatNode->GetPartialStatistics();
+        else if (auto doubleNode = AsMeanInvStdDevNode<double>(node))
+            stats[node->NodeName()] = doubleNode->GetPartialStatistics();
+    }
+    return stats;
+}
+
+/*static*/ bool ComputationNetwork::SetPreComputedStatistics(const list<ComputationNodeBasePtr>& nodes, const map<wstring, vector<double>>& stats)
+{
+    auto current = GetPreComputedStatistics(nodes);
+    if (current.size() != nodes.size()) // (not all of them are Mean/InvStdDev nodes)
+        return false;
+    for (const auto& entry : current)
+    {
+        auto iter = stats.find(entry.first);
+        if (iter == stats.end() || iter->second.size() != entry.second.size())
+            return false;
+    }
+    for (const auto& node : nodes)
+    {
+        const auto& nodeStats = stats.at(node->NodeName());
+        if (auto floatNode = AsMeanInvStdDevNode<float>(node))
+            floatNode->SetPartialStatistics(nodeStats);
+        else
+            AsMeanInvStdDevNode<double>(node)->SetPartialStatistics(nodeStats);
+    }
+    return true;
+}
+
 // create the m_inputValues[] and m_learnableParameters[] lists
 // This enumerates all leaves reachable from rootNode.
 // Leaves are:
@@ -596,6 +1036,82 @@ template <class ElemType>
     }
 }
 
+template <class ElemType>
+/*static*/ void ComputationNetwork::SetBatchNormalizationCommunicator(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const std::shared_ptr<NcclComm>& comm)
+{
+    for (auto& nodeIter : net->GetNodesWithType(OperationNameOf(BatchNormalizationNode), criterionNode))
+    {
+        auto node = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(nodeIter);
+        if (comm && !node->UseCNTKEngine())
+            InvalidArgument("%ls: Batch normalization statistics can only be synchronized across ranks with the CNTK engine (useCntkEngine=true).", node->NodeName().c_str());
+        node->SetStatisticsCommunicator(comm);
+    }
+}
+
+template <class ElemType>
+/*static*/ std::set<ComputationNodeBasePtr> ComputationNetwork::ShardVocabularyParallelNodes(ComputationNetworkPtr net, const std::shared_ptr<NcclComm>& comm, size_t rank, size_t numShards)
+{
+    net->LoadDeferredParameterValues();
+
+    // the sharded nodes and their weights, which must not be read by any other node
+    std::set<ComputationNodeBasePtr> parameters;
+    std::vector<VocabularyShard<ElemType>*> shardedNodes;
+    for (const auto& node : net->GetEvalOrder(nullptr))
+    {
+        auto shard = dynamic_cast<VocabularyShard<ElemType>*>(node.get());
+        if (!shard)
+            continue;
+        auto weights = node->Input(shard->WeightsInputIndex());
+        if (!dynamic_pointer_cast<LearnableParameter<ElemType>>(weights))
+            InvalidArgument("%ls %ls operation: The weights %ls of a vocabulary-parallel node must be a parameter.", node->NodeName().c_str(), node->OperationName().c_str(), weights->NodeName().c_str());
+        if (weights->GetAsMatrixNumCols() != shard->VocabSize())
+            InvalidArgument("%ls %ls operation: The weights %ls must have one column for each of the %d words.", node->NodeName().c_str(), node->OperationName().c_str(), weights->NodeName().c_str(), (int) shard->VocabSize());
+        parameters.insert(weights);
+        shardedNodes.push_back(shard);
+    }
+    for (const auto& node : net->GetEvalOrder(nullptr))
+    {
+        auto shard = dynamic_cast<VocabularyShard<ElemType>*>(node.get());
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            if (parameters.find(node->Input(i)) != parameters.end() && (!shard || i != shard->WeightsInputIndex()))
+                InvalidArgument("%ls %ls operation: The parameter %ls is sharded by words across the ranks and cannot be an input of this node.",
+                                node->NodeName().c_str(), node->OperationName().c_str(), node->Input(i)->NodeName().c_str());
+        }
+    }
+
+    for (auto shard : shardedNodes)
+        shard->SetShard(comm, rank, numShards);
+    SetVocabularyShardsFull<ElemType>(net, false);
+    return parameters;
+}
+
+template <class ElemType>
+/*static*/ void ComputationNetwork::SetVocabularyShardsFull(ComputationNetworkPtr net, bool full)
+{
+    std::set<ComputationNodeBasePtr> visited;
+    for (const auto& node : net->GetEvalOrder(nullptr))
+    {
+        auto shard = dynamic_cast<VocabularyShard<ElemType>*>(node.get());
+        if (!shard)
+            continue;
+        auto weights = node->Input(shard->WeightsInputIndex());
+        if (!visited.insert(weights).second)
+            continue;
+        size_t vocabSize = shard->VocabSize();
+        size_t numCols = full ? vocabSize : shard->ShardEnd(vocabSize) - shard->ShardBegin(vocabSize);
+        auto& value = dynamic_pointer_cast<LearnableParameter<ElemType>>(weights)->Value();
+        if (value.GetNumCols() != numCols)
+        {
+            if (full)
+                shard->GatherWeights(value);
+            else
+                shard->CutWeights(value);
+        }
+        weights->SetDims(TensorShape(value.GetNumRows(), numCols), false);
+    }
+}
+
 //set sequence training parameters, e.g. smoothing weight, frame drop threshhold
 template <class ElemType>
 void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
@@ -607,12 +1123,13 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
                                      const double& lmf /*= 14.0f*/,
                                      const double& wp /*= 0.0f*/,
                                      const double& bMMIfactor /*= 0.0f*/,
-                                     const bool& sMBR /*= false*/
+                                     const bool& sMBR /*= false*/,
+                                     const size_t latticeCacheMB /*= 512*/
                                      )
 {
     fprintf(stderr, "Setting Hsmoothing weight to %.8g and frame-dropping threshhold to %.8g\n", hsmoothingWeight, frameDropThresh);
-    fprintf(stderr, "Setting SeqGammar-related parameters: amf=%.2f, lmf=%.2f, wp=%.2f, bMMIFactor=%.2f, usesMBR=%s\n",
-            amf, lmf, wp, bMMIfactor, sMBR ? "true" : "false");
+    fprintf(stderr, "Setting SeqGammar-related parameters: amf=%.2f, lmf=%.2f, wp=%.2f, bMMIFactor=%.2f, usesMBR=%s, latticeCacheMB=%d\n",
+            amf, lmf, wp, bMMIfactor, sMBR ? "true" : "false", (int) latticeCacheMB);
     list<ComputationNodeBasePtr> seqNodes = net->GetNodesWithType(OperationNameOf(SequenceWithSoftmaxNode), criterionNode);
     if (seqNodes.size() == 0)
     {
@@ -626,7 +1143,7 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
             node->SetSmoothWeight(hsmoothingWeight);
             node->SetFrameDropThresh(frameDropThresh);
             node->SetReferenceAlign(doreferencealign);
-            node->SetGammarCalculationParam(amf, lmf, wp, bMMIfactor, sMBR);
+            node->SetGammarCalculationParam(amf, lmf, wp, bMMIfactor, sMBR, latticeCacheMB);
         }
     }
 }
@@ -1504,24 +2021,34 @@ void ComputationNetwork::SaveToDbnFile(ComputationNetworkPtr net, const std::wst
 
 template void ComputationNetwork::InitLearnableParametersWithBilinearFill<float>(const ComputationNodeBasePtr& node, size_t kernelWidth, size_t kernelHeight);
 template void ComputationNetwork::Read<float>(const wstring& fileName);
-template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
+template void ComputationNetwork::ReadFrozen<float>(const wstring& fileName);
+template void ComputationNetwork::SaveFrozen<float>(const wstring& fileName) const;
+template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create, bool deferValues);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate);
 template /*static*/ void ComputationNetwork::SetIRngUserSeed<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
+template /*static*/ void ComputationNetwork::SetBatchNormalizationCommunicator<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const std::shared_ptr<NcclComm>& comm);
+template /*static*/ std::set<ComputationNodeBasePtr> ComputationNetwork::ShardVocabularyParallelNodes<float>(ComputationNetworkPtr net, const std::shared_ptr<NcclComm>& comm, size_t rank, size_t numShards);
+template /*static*/ void ComputationNetwork::SetVocabularyShardsFull<float>(ComputationNetworkPtr net, bool full);
 template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
-                                                     const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
+                                                     const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR, const size_t latticeCacheMB);
 template void ComputationNetwork::SaveToDbnFile<float>(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
 template void ComputationNetwork::InitLearnableParametersWithBilinearFill<double>(const ComputationNodeBasePtr& node, size_t kernelWidth, size_t kernelHeight);
 template void ComputationNetwork::Read<double>(const wstring& fileName);
-template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
+template void ComputationNetwork::ReadFrozen<double>(const wstring& fileName);
+template void ComputationNetwork::SaveFrozen<double>(const wstring& fileName) const;
+template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create, bool deferValues);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate);
 template /*static*/ void ComputationNetwork::SetIRngUserSeed<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
+template /*static*/ void ComputationNetwork::SetBatchNormalizationCommunicator<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const std::shared_ptr<NcclComm>& comm);
+template /*static*/ std::set<ComputationNodeBasePtr> ComputationNetwork::ShardVocabularyParallelNodes<double>(ComputationNetworkPtr net, const std::shared_ptr<NcclComm>& comm, size_t rank, size_t numShards);
+template /*static*/ void ComputationNetwork::SetVocabularyShardsFull<double>(ComputationNetworkPtr net, bool full);
 template void ComputationNetwork::SetSeqParam<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
-                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
+                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR, const size_t latticeCacheMB);
 template void ComputationNetwork::SaveToDbnFile<double>(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
 // register ComputationNetwork with the ScriptableObject system
@@ -29,9 +29,17 @@
 #include <chrono>
 #include <unordered_map>
 #include <set>
+#include <functional>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class CudaGraph;
+class GPUStreamPool;
+class ActivationOffloader;
+class MemoryTimeline;
+class NcclComm;
+class MPIWrapper;
+
 // ===========================================================================
 // ComputationNetwork -- computation graph and operations
 // ===========================================================================
@@ -52,8 +60,12 @@ public:
         m_randomSeedOffset(0),
         m_isCompiled(false),
         m_areMatricesAllocated(false),
+        m_recomputeActivations(false),
+        m_offloadActivations(false),
+        m_staticMemoryPlanMaxColumns(0),
         m_pMBLayoutOfNetwork(make_shared<MBLayout>(1, 0, L"*")),
-        m_environment(make_shared<ComputationEnvironment>())
+        m_environment(make_shared<ComputationEnvironment>()),
+        m_lazyParameterLoading(false)
     {
         //m_pMBLayoutOfNetwork->SetAxisName(L"T");
     }
@@ -72,6 +84,10 @@ public:
 
     void ClearNetwork();
     void InvalidateCompiledNetwork();
+    // Like InvalidateCompiledNetwork(), for an edit that changed the inputs or the configuration of 'editedNodes' only.
+    // The next CompileNetwork() then revalidates just these, nodes that were added since, and the nodes depending on them.
+    // Code that modifies nodes directly must report them here, or call InvalidateCompiledNetwork() to have all revalidated.
+    void InvalidateCompiledNetwork(const std::vector<ComputationNodeBasePtr>& editedNodes);
 
     void SetDeviceId(DEVICEID_TYPE deviceId)
     {
@@ -90,12 +106,12 @@ public:
     // -----------------------------------------------------------------------
 
     template <class ElemType>
-    void ReadPersistableParameters(File& fstream, bool create);
+    void ReadPersistableParameters(File& fstream, bool create, bool deferValues = false);
     // reload node content only, e.g. used by SGD::Train() when going back to an older model that had better training objective
     template <class ElemType>
     void RereadPersistableParameters(const std::wstring& fileName)
     {
-        File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+        File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead | FileOptions::fileOptionsMemoryMapped);
         ReadPersistableParameters<ElemType>(fstream, false);
     }
     // design BUGBUG: binary files do not know whether they are float or double.
@@ -117,12 +133,32 @@ public:
         return net;
     }
 
+    // Read() reads the parameter values after the rest of the model, with a few threads. With lazy parameter loading,
+    // it leaves them unread until they are needed: by the evaluation of a root that depends on them
+    // (StartEvaluateMinibatchLoop()), or by saving the model. This is for evaluating a few outputs of a large model.
+    void SetLazyParameterLoading(bool lazy) { m_lazyParameterLoading = lazy; }
+    // reads the parameter values that Read() has deferred, of the parameters 'rootNode' depends on, or all
+    void LoadDeferredParameterValues(const ComputationNodeBasePtr& rootNode = nullptr) const;
+
     void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
 
+    // Frozen models are meant for evaluation. They keep the parameter values in an aligned blob at the end of the file,
+    // which ReadFrozen() memory maps instead of deserializing it: on the CPU the parameters are views on the mapped pages,
+    // on a GPU the blob is copied to the device in a single transfer. Read() detects frozen models by itself.
+    template <class ElemType> void SaveFrozen(const std::wstring& fileName) const;
+    template <class ElemType> void ReadFrozen(const std::wstring& fileName);
+    static bool IsFrozenModelFile(const std::wstring& fileName);
+
+    // the memory the parameters of a frozen model are views on; a network that shares these parameters must hold it as well
+    const std::shared_ptr<void>& FrozenParameterStorage() const { return m_frozenParameterStorage; }
+    void ShareFrozenParameterStorage(const std::shared_ptr<void>& storage) { m_frozenParameterStorage = storage; }
+
 private:
 
     void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat) const;
+    void SaveRelationsAndRootNodes(File& fstream) const;
+    void ReadRelationsAndRootNodes(File& fstream);
 
 public:
 
@@ -134,7 +170,11 @@ public:
     void ForwardProp(const ComputationNodeBasePtr rootNode);
 
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // The gradient of the root node is set to 'rootGradient', i.e. the loss scale when training with loss scaling.
+    // If given, 'onGradientComplete' is called for every node that needs a gradient, as soon as that gradient is final,
+    // e.g. to start communicating the gradients of parameters while backprop continues.
+    void Backprop(const ComputationNodeBasePtr rootNode, double rootGradient = 1,
+                  const std::function<void(const ComputationNodeBasePtr&)>& onGradientComplete = nullptr);
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -143,6 +183,13 @@ public:
             ForwardProp(node);
     }
 
+    // ForwardProp() of the roots that records their GPU work as a CUDA graph the first time a 'shapeKey' (chosen by the
+    // caller to describe the input shapes) is seen, and replays it when the same roots are evaluated again for the same key
+    // and nothing was reallocated since. Falls back to ForwardProp() where that is not possible: on CPU, without CUDA graph
+    // support, outside inference, with recurrent loops or random sampling, or if a node synchronizes with the host.
+    // As for ForwardProp(), the inputs must have been updated and their time stamps bumped.
+    void ForwardPropCaptured(const std::vector<ComputationNodeBasePtr>& roots, const std::vector<size_t>& shapeKey);
+
     static void BumpEvalTimeStamp(const std::vector<ComputationNodeBasePtr>& nodes);
     void ResetEvalTimeStamps();
 
@@ -150,6 +197,7 @@ public:
     void StartEvaluateMinibatchLoop(const ComputationNodeBasePtr& rootNode) // (ugly name; meant to be unique so we can rename if needed)
     {
         VerifyIsCompiled("StartEvaluateMinibatchLoop");
+        LoadDeferredParameterValues(rootNode);
         ResetEvalTimeStamps(); // invalidate all m_value fields  --TODO: redundant (called over again for every root node). Make this private and only call for sets of nodes.
         for (auto& node : GetEvalOrder(rootNode))
             node->OnEpochStart();
@@ -174,29 +222,80 @@ public:
     void CompileNetwork(); // call this after creation, Load(), and any modification
 
 private:
-    void ValidateNetwork();
+    void ClearCompiledState();
+    std::list<ComputationNodeBasePtr> NodesAffectedByEdits() const;
+    void ValidateNetwork(const std::list<ComputationNodeBasePtr>& nodes);
     size_t ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass);
     bool ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass) const;
     void MarkValueNonSharableNodes();
     void ChangeNodeInputs(ComputationNodeBasePtr fromNode, ComputationNodeBasePtr toNode);
+    size_t OptimizeNetworkGraph();
+    size_t EliminateCommonSubexpressions();
 
 private:
     void DetermineSetOfAllRoots();
     void CollectInputAndLearnableParameters(const ComputationNodeBasePtr& rootNode);
     void CollectInputAndLearnableParametersRec(const ComputationNodeBasePtr& node, set<ComputationNodeBasePtr>& visited, list<ComputationNodeBasePtr>& inputs, list<ComputationNodeBasePtr>& learnableParameters);
-    void ResetMBLayouts();
+    void ResetMBLayouts(const std::list<ComputationNodeBasePtr>& nodes);
     bool IsCompiled() const { return m_isCompiled; }
     bool AreMatricesAllocated() const { return m_areMatricesAllocated; }
     void VerifyIsCompiled(const char* where) const;
 public:
-    void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
+    // With forwardPropOnly (no trainRootNode), the value of every node other than the roots is returned to the matrix pool
+    // right after its last consumer, independent of shareNodeValueMatrices. The network can then not be used for backprop.
+    void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode,
+                             bool forwardPropOnly = false);
+
+    // Activation recomputation (gradient checkpointing) trades compute for memory in training: the backprop order of the
+    // criterion is split into segments that end at the given checkpoint nodes (or about sqrt(N) segments if none are given),
+    // and values that are only needed within their segment are released after forward prop and recomputed segment by segment
+    // during backprop. Must be called before AllocateAllMatrices(). See also Globals::EnableActivationRecomputation().
+    void EnableActivationRecomputation(const std::vector<std::wstring>& checkpointNodeNames = std::vector<std::wstring>());
+
+    // Activation offloading trades PCIe bandwidth for memory in training on GPU: values of the criterion that backprop needs
+    // are copied to pinned host memory after their last consumer in forward prop, and copied back a few nodes ahead of their
+    // first use in backprop, on a separate stream that overlaps with the computation. Their device buffers are shared in
+    // between. Not combined with activation recomputation, which takes precedence. Must be called before AllocateAllMatrices().
+    // See also Globals::EnableActivationOffloading().
+    void EnableActivationOffloading();
+
+    // A static memory plan places the values and gradients of all nodes into one arena per device, at offsets that are
+    // planned once from their lifetimes for minibatches of up to 'maxColumns' columns (samples and gaps), instead of
+    // sharing whole matrices greedily. Resizing them for each minibatch then does not allocate; a larger minibatch is an
+    // error. Must be called before AllocateAllMatrices(). See MatrixPool.
+    void EnableStaticMemoryPlan(size_t maxColumns);
 
     // From the set of nodes extract all nodes which are used as accumulator nodes.
     std::set<ComputationNodeBasePtr> ExtractNodesWhichAccumulateResult(std::set<ComputationNodeBasePtr> nodes);
 
+    // bytes held by the shared matrix pool; pool buffers only grow, so this is the peak over all minibatches so far
+    size_t GetMatrixPoolAllocatedBytes() const { return m_matrixPool.GetAllocatedBytes(); }
+
+    // Records the bytes of the values, gradients and workspaces per node over the ForwardProp() and Backprop() calls
+    // until EndMemoryTimeline(), which returns the recording. Meant for one minibatch (see MemoryTimeline).
+    void BeginMemoryTimeline();
+    std::shared_ptr<MemoryTimeline> EndMemoryTimeline();
+
 private:
     void PrintMemorySharingStructure(const std::vector<ComputationNodeBasePtr>& nodes);
-    void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount);
+    void FuseElementwiseOps(const std::vector<ComputationNodeBasePtr>& evalOrder,
+                            const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                            bool performingBackPropagation);
+    size_t AliasInputValues(const std::vector<ComputationNodeBasePtr>& evalOrder,
+                            std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp);
+    size_t ComputeInPlace(const std::vector<ComputationNodeBasePtr>& evalOrder,
+                          const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                          std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp);
+    void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount,
+                                             const ActivationOffloader* offloader = nullptr, std::vector<ComputationNodeBasePtr>* offloadedNodes = nullptr);
+    void ReleaseValueAfterConsumer(const ComputationNodeBasePtr& pNode, std::unordered_map<ComputationNodeBasePtr, int>& parentCount,
+                                   const ActivationOffloader* offloader, std::vector<ComputationNodeBasePtr>* offloadedNodes);
+    size_t PlanActivationRecomputation(const ComputationNodeBasePtr& trainRootNode,
+                                       const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                       std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp);
+    std::shared_ptr<ActivationOffloader> PlanActivationOffloading(const ComputationNodeBasePtr& trainRootNode,
+                                                                  const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                                                  std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
 public:
@@ -349,10 +448,12 @@ public:
                                  const wchar_t* initString, // "uniform"|"gaussian"|"fixedValue"
                                  double initValue,          //  scale   | scale    | value
                                  unsigned long randomSeed = 0,
-                                 bool initOnCPUOnly = false) const;
+                                 bool initOnCPUOnly = false,
+                                 bool initByCounter = false) const;
     // non-static version needed because it accesses m_randomSeedOffset
     // Legacy version that is for random only.
-    void RandomInitLearnableParameters(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly = false) const;
+    // With 'initByCounter', the values are generated on the device of the node, keyed by the seed and the node name (see Matrix::SetCounterBasedUniformRandomValue()).
+    void RandomInitLearnableParameters(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly = false, bool initByCounter = false) const;
 
     template <class ElemType>
     void InitLearnableParametersWithBilinearFill(const ComputationNodeBasePtr& node, size_t kernelWidth, size_t kernelHeight);
@@ -386,6 +487,63 @@ public:
     //ComputationNodeBasePtr RemoveFeatureNode(ComputationNodeBasePtr featureNode);
     void SetLearnableNodesBelowLearningRateMultiplier(const float learningRateMultiplier, const ComputationNodeBasePtr& rootNode = nullptr);
 
+    // Rewrites the network for inference of the given outputs only: removes all nodes they do not depend on
+    // (criteria, evaluation nodes, training-only branches), folds BatchNormalization into a preceding Times or
+    // Convolution, and replaces subgraphs that depend on parameters only by their precomputed values.
+    // The network must be compiled; it is compiled again on return. Other outputs are no longer available afterwards.
+    template <class ElemType>
+    void OptimizeForEvaluation(const std::vector<ComputationNodeBasePtr>& outputNodes);
+
+    // Merges each ReLU whose input is a BatchNormalization read by nothing else into that node, which then applies the ReLU
+    // itself and recomputes the normalization in backprop instead of keeping the activation between the two. ReLUs that are
+    // outputs, criteria, or otherwise read from outside are kept. Must be called before the matrices are allocated; compiles
+    // the network again if it changed. Returns the number of merged ReLUs.
+    template <class ElemType>
+    size_t FuseBatchNormalizationAndRelu();
+
+    // Model parallelism within one process: distributes the nodes that 'rootNode' depends on over 'devices' and inserts a
+    // CrossDeviceCopy node wherever a node reads a node on another device (one per input and device). See PlanDevicePlacement()
+    // for the assignment. Must be called before the matrices are allocated; compiles the network again if it changed.
+    // Returns the number of inserted copy nodes.
+    template <class ElemType>
+    size_t PlaceNodesOnDevices(const ComputationNodeBasePtr& rootNode, const std::vector<DEVICEID_TYPE>& devices,
+                               const std::map<std::wstring, DEVICEID_TYPE>& manualPlacement,
+                               const std::vector<ComputationNodeBasePtr>& nodesOnNetworkDevice, size_t numSamplesHint);
+
+    // The device assignment of PlaceNodesOnDevices(). Nodes named in 'manualPlacement' go where they are told. The other
+    // computing nodes are cut into contiguous stages of the evaluation order, one per device in the given order, of about
+    // the same estimated memory: their values and gradients for 'numSamplesHint' samples, plus the parameters they read
+    // first, with gradients and optimizer state. A recurrent loop stays on one device. Parameters go to the device of their
+    // first reader, input nodes and 'nodesOnNetworkDevice' (criteria, evaluation nodes, which SGD reads) to the device of the network.
+    std::map<ComputationNodeBasePtr, DEVICEID_TYPE> PlanDevicePlacement(const ComputationNodeBasePtr& rootNode, const std::vector<DEVICEID_TYPE>& devices,
+                                                                        const std::map<std::wstring, DEVICEID_TYPE>& manualPlacement,
+                                                                        const std::vector<ComputationNodeBasePtr>& nodesOnNetworkDevice, size_t numSamplesHint);
+
+    // Pipeline parallelism (GPipe) for a network placed on several devices: a minibatch is trained as micro-batches that flow
+    // through the stages of the criterion, the maximal runs of its evaluation order on one device, so that the devices work
+    // on different micro-batches at the same time. The caller sets the inputs of each micro-batch in turn and calls
+    // ForwardPropPipelined() for all of them, then BackpropPipelined() in reverse order; the gradients add up over the
+    // micro-batches. A stage keeps only the values of the micro-batch it last computed; those of the others are recomputed
+    // from the copies into the stage and the values read from other stages, which are kept per micro-batch. Must be called
+    // after AllocateAllMatrices(), without activation recomputation or offloading, a static memory plan, or shared node values.
+    // Returns the number of stages.
+    size_t FormPipelineStages(const ComputationNodeBasePtr& rootNode);
+    // Forward prop of micro-batch 'microBatch' through all stages, after 'evalNodes' (which are evaluated first, as the
+    // memory-sharing plan expects). The inputs must have been set and their time stamps bumped.
+    void ForwardPropPipelined(size_t microBatch, const std::vector<ComputationNodeBasePtr>& evalNodes);
+    // Backprop of micro-batch 'microBatch' through the stages in reverse order, each recomputing its values first unless it
+    // still holds them. The inputs must be those of the micro-batch again, unless it was the last one forward.
+    void BackpropPipelined(size_t microBatch, double rootGradient = 1);
+
+private:
+    void PruneUnreachableNodes(const std::vector<ComputationNodeBasePtr>& outputNodes);
+    template <class ElemType>
+    size_t FoldBatchNormalizationNodes();
+    template <class ElemType>
+    size_t FoldConstantSubgraphs(const std::vector<ComputationNodeBasePtr>& outputNodes, bool foldLearnableParameters = true);
+
+public:
+
     // -----------------------------------------------------------------------
     // node access
     // -----------------------------------------------------------------------
@@ -457,6 +615,19 @@ public:
                                                    double normalizationTimeConstant, double& prevNormalizationTimeConstant,
                                                    double blendTimeConstant, double& prevBlendTimeConstant);
 
+    // Synchronized batch normalization: the batch normalization nodes reduce their minibatch statistics across the ranks of 'comm'.
+    template <class ElemType>
+    static void SetBatchNormalizationCommunicator(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const std::shared_ptr<NcclComm>& comm);
+
+    // Vocabulary parallelism: the ranks of 'comm' share the weights of the ShardedSoftmaxWithCrossEntropy and ShardedEmbedding
+    // nodes by words, this one keeping shard 'rank' of 'numShards'. Returns the sharded parameters, whose gradients are
+    // complete on each rank and must not be aggregated.
+    template <class ElemType>
+    static std::set<ComputationNodeBasePtr> ShardVocabularyParallelNodes(ComputationNetworkPtr net, const std::shared_ptr<NcclComm>& comm, size_t rank, size_t numShards);
+    // Gathers the full weights of all words on each rank ('full'), e.g. to save the model, resp. cuts them back to the shard. Collective.
+    template <class ElemType>
+    static void SetVocabularyShardsFull(ComputationNetworkPtr net, bool full);
+
     template <class ElemType>
     static void SetSeqParam(ComputationNetworkPtr net,
                             const ComputationNodeBasePtr criterionNode,
@@ -467,7 +638,8 @@ public:
                             const double& lmf = 14.0f,
                             const double& wp = 0.0f,
                             const double& bMMIfactor = 0.0f,
-                            const bool& sMBR = false);
+                            const bool& sMBR = false,
+                            const size_t latticeCacheMB = 512);
     static void SetMaxTempMemSizeForCNN(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const size_t maxTempMemSizeInSamples);
 
     // -----------------------------------------------------------------------
@@ -734,6 +906,15 @@ public:
     // return list of nodes that require precomputation and not precomputed yet
     std::list<ComputationNodeBasePtr> GetNodesRequiringPreComputation(const ComputationNodeBasePtr& rootNode = nullptr, bool checkComputed = true);
 
+    // merge the statistics that the given accumulating Mean/InvStdDev nodes gathered on each MPI worker, so that every
+    // worker ends up with those over the union of their data; to be called before MarkComputed(true). Returns the total #samples.
+    static size_t AggregatePreComputedStatistics(const std::list<ComputationNodeBasePtr>& nodes, const std::shared_ptr<MPIWrapper>& mpi);
+
+    // the statistics of the given accumulating Mean/InvStdDev nodes by node name, e.g. to cache them across runs, and to
+    // restore them before MarkComputed(true). Set...() returns false, changing nothing, unless 'stats' fits all the nodes.
+    static std::map<std::wstring, std::vector<double>> GetPreComputedStatistics(const std::list<ComputationNodeBasePtr>& nodes);
+    static bool SetPreComputedStatistics(const std::list<ComputationNodeBasePtr>& nodes, const std::map<std::wstring, std::vector<double>>& stats);
+
     // -----------------------------------------------------------------------
     // unit testing
     // -----------------------------------------------------------------------
@@ -866,6 +1047,17 @@ public:
     }
     int TraceLevel() const { return m_environment->traceLevel; }
 
+    // Prints a roofline table of the nodes timed so far by the PerformanceCounters (SGD's nodeTimingInterval), slowest first:
+    // time per minibatch, achieved GFLOP/s and GB/s from the estimated cost (ICostEstimable), and the fraction of the
+    // device's peak of the resource that bounds the node--compute if its FLOPs per byte are above those of the device.
+    void PrintNodeProfile() const;
+
+    // let nodes that support it skip the gaps of minibatches of variable-length sequences (see ComputationEnvironment)
+    void EnablePackedSequenceExecution(bool enable = true)
+    {
+        m_environment->packedSequenceExecution = enable;
+    }
+
     // call EnableNodeTracing() on the given nodes for real, category, and sparse printing
     void EnableNodeTracing(const std::vector<std::wstring>& traceNodeNamesReal,
                            const std::vector<std::wstring>& traceNodeNamesCategory,
@@ -1102,6 +1294,30 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // called by Backprop() after each node, once all consumers of the node have back-propagated into it
+        std::function<void(const ComputationNodeBasePtr&)> m_onGradientComplete;
+
+        // activation recomputation, see ComputationNetwork::PlanActivationRecomputation(); empty if not enabled
+        std::vector<size_t> m_recomputationSegments;                        // [i] segment of m_nestedNodes[i]
+        std::vector<std::vector<ComputationNodeBasePtr>> m_recomputedNodes; // [segment] nodes whose values are recomputed, in evaluation order
+
+        // activation offloading, see ComputationNetwork::PlanActivationOffloading(); shared by all nested networks, null if not enabled
+        std::shared_ptr<ActivationOffloader> m_activationOffloader;
+
+        // the matrices of the nodes are placed by a static memory plan, see ComputationNetwork::EnableStaticMemoryPlan()
+        bool m_hasStaticMemoryPlan = false;
+
+        // records each node after it ran, see ComputationNetwork::BeginMemoryTimeline(); shared by all nested networks, null if not recording
+        std::shared_ptr<MemoryTimeline> m_memoryTimeline;
+
+    private:
+        void BeginRecomputation(size_t segment, const FrameRange& fr);
+        void EndRecomputation(size_t segment);
+
+        // streams for ForwardProp() of independent nodes, if Globals::GetNumConcurrentStreams() > 1 and on GPU; else null
+        GPUStreamPool* GetStreamPool();
+        std::shared_ptr<GPUStreamPool> m_streamPool;
     };
 
 public:
@@ -1146,6 +1362,28 @@ private:
     // environment information that nodes may want to inquire, e.g. to know whether we are training
     ComputationEnvironmentPtr m_environment;
 
+    std::shared_ptr<void> m_frozenParameterStorage; // see ReadFrozen()
+
+    // the parameter values Read() has not read yet, see LoadDeferredParameterValues()
+    // Reading them does not change the model, hence they are mutable, so that they can be read by Save() as well.
+    struct DeferredParameterValue
+    {
+        ComputationNodeBasePtr m_node;
+        uint64_t m_position; // of the elements in m_deferredParameterFileName
+    };
+    mutable std::vector<DeferredParameterValue> m_deferredParameterValues;
+    std::wstring m_deferredParameterFileName;
+    bool m_lazyParameterLoading;
+
+    // see ForwardPropCaptured()
+    struct CapturedForwardProp
+    {
+        std::shared_ptr<CudaGraph> m_graph;  // null if the work cannot be captured
+        std::vector<const void*> m_buffers;  // the value buffers of all nodes involved, which a replay writes to
+    };
+    std::map<std::vector<size_t>, CapturedForwardProp> m_capturedForwardProps; // [shapeKey and roots]
+    std::vector<size_t> m_lastCapturedForwardPropKey;                          // the key of the last ForwardPropCaptured()
+
     std::map<std::wstring, std::vector<ComputationNodeBasePtr>> m_namedCriterionNodes;
 
 private:
@@ -1161,8 +1399,36 @@ private:
 
     // cache for evaluation ordering:
     bool m_isCompiled; // CompileNetwork has been called
+
+    // incremental revalidation after edits, see InvalidateCompiledNetwork(editedNodes)
+    std::set<ComputationNodeBasePtr> m_validatedNodes; // nodes validated by the last CompileNetwork(); empty if that no longer holds
+    std::set<ComputationNodeBasePtr> m_editedNodes;    // nodes edited since
     bool m_areMatricesAllocated; // AllocateAllMatrices has been called
 
+    // activation recomputation, see EnableActivationRecomputation()
+    bool m_recomputeActivations;
+    std::vector<std::wstring> m_recomputationCheckpointNames; // (empty: sqrt(N) heuristic)
+
+    // activation offloading, see EnableActivationOffloading()
+    bool m_offloadActivations;
+
+    // static memory plan, see EnableStaticMemoryPlan(); 0 if not enabled
+    size_t m_staticMemoryPlanMaxColumns;
+
+    // pipeline parallelism, see FormPipelineStages()
+    struct PipelineStage
+    {
+        DEVICEID_TYPE deviceId;
+        std::vector<ComputationNodeBasePtr> nodes;        // nested nodes of the criterion (including loops), in evaluation order
+        std::vector<ComputationNodeBasePtr> stashedNodes; // restored instead of recomputed: copies into the stage, and nodes of other stages it reads
+        std::vector<ComputationNodeBasePtr> rngUsers;     // nodes that draw random numbers, which draw the same ones again when recomputed
+        size_t microBatch;                                // the micro-batch whose values the stage holds
+    };
+    ComputationNodeBasePtr m_pipelineRootNode;
+    std::vector<PipelineStage> m_pipelineStages;
+    std::map<ComputationNodeBasePtr, std::vector<std::pair<MatrixBasePtr, MBLayoutPtr>>> m_pipelineStash; // [node][microBatch] value, and MBLayout unless the network's
+    std::map<ComputationNodeBasePtr, std::vector<uint64_t>> m_pipelineRngOffsets;                          // [node][microBatch] random-number offset of the nodes that draw random numbers
+
     // cached network iterations
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_evalOrders; // [out node] flat depth-first traversal starting from out node
     std::map<const ComputationNodeBasePtr, ComputationNodeBasePtr> m_nestedNetworks;        // [out node] network rewritten as recursive traveral, potentially optimized; execution plan
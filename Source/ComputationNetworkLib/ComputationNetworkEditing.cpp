@@ -9,10 +9,18 @@
 #include "ComputationNode.h"
 #include "ComputationNetwork.h"
 #include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "ConvolutionalNodes.h"
+#include "NonlinearityNodes.h"
 #include "TrainingNodes.h"
+#include "ComputationNetworkBuilder.h"
 #include <string>
 #include <vector>
 #include <list>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 
@@ -29,8 +37,6 @@ ComputationNodeBasePtr ComputationNetwork::CopyNode(const ComputationNetwork& fr
                                                     std::wstring toName,
                                                     const CopyNodeFlags flags)
 {
-    InvalidateCompiledNetwork();
-
     if (toName == L"")
         toName = fromName;
 
@@ -60,6 +66,7 @@ ComputationNodeBasePtr ComputationNetwork::CopyNode(const ComputationNetwork& fr
         else
             pFromNode->CopyTo(pToNode, toName, flags); // blast it over the existing node
     }
+    InvalidateCompiledNetwork({ pToNode });
     return pToNode;
 }
 
@@ -69,7 +76,7 @@ void ComputationNetwork::CopySubTree(const ComputationNetwork& fromNet,
                                      const std::wstring fromName, std::wstring toNamePrefix,
                                      const CopyNodeFlags flags)
 {
-    InvalidateCompiledNetwork();
+    InvalidateCompiledNetwork(/*editedNodes=*/{}); // (CopyNode() reports the copies)
 
     if (!(flags & CopyNodeFlags::copyNodeValue))
         LogicError("CopySubTree: you cannot copy a tree without copying the node values.");
@@ -118,7 +125,7 @@ void ComputationNetwork::RenameNode(ComputationNodeBasePtr node, const std::wstr
     if (iter != m_nameToNodeMap.end()) // found
         RuntimeError("RenameNode: Target name already exists.");
 
-    InvalidateCompiledNetwork();
+    InvalidateCompiledNetwork({ node });
 
     RemoveNodeFromNet(node);        // take it out remporarily
     node->SetNodeName(newNodeName); // change the name
@@ -128,11 +135,10 @@ void ComputationNetwork::RenameNode(ComputationNodeBasePtr node, const std::wstr
 // deletes a node from the network including setting all input links to it to null, and removing it from the node groups
 void ComputationNetwork::DeleteNode(const std::wstring& nodeName)
 {
-    InvalidateCompiledNetwork();
-
     ComputationNodeBasePtr nodeToDelete = GetNodeFromName(nodeName);
 
     // first delete links, if this node is involved, the whole connection will be removed
+    vector<ComputationNodeBasePtr> consumers;
     for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
     {
         ComputationNodeBasePtr node = nodeIter->second;
@@ -145,11 +151,14 @@ void ComputationNetwork::DeleteNode(const std::wstring& nodeName)
             {
                 // this used to call DetatchInputs(), but it's better for MEL to retain other inputs
                 node->SetInput(i, nullptr);
+                consumers.push_back(node);
                 break;
             }
         }
     }
 
+    InvalidateCompiledNetwork(consumers);
+
     // nodeToDelete is a parent
     nodeToDelete->DetachInputs(); // deref all its inputs; if we don't do that, we might end up with a mem leak due to a circular reference
 
@@ -161,7 +170,7 @@ void ComputationNetwork::DeleteNode(const std::wstring& nodeName)
             groupIter->erase(search);
     }
 
-    // Note: the necessary update of m_allSEQNodes is hanlded by the InvalidateCompiledNetwork() call above
+    // Note: the necessary update of m_allSEQNodes is handled by the InvalidateCompiledNetwork() call above
 
     // delete the node itself
     RemoveNodeFromNet(nodeToDelete);
@@ -179,7 +188,7 @@ void ComputationNetwork::ReplaceNode(wstring nodeName, ComputationNodeBasePtr ne
     if (newNode->NodeName() != nodeName) // TODO: This was not tested for earlier; I hope no code depends on this.
         InvalidArgument("ChangeNode: newNode must have the same name as the old node.");
 
-    InvalidateCompiledNetwork();
+    InvalidateCompiledNetwork({ newNode });
 
     // change all nodes that have old node as input to point to the new node instead
     ChangeNodeInputs(oldNode, newNode);
@@ -213,7 +222,7 @@ void ComputationNetwork::InsertNode(wstring inputNodeName, ComputationNodeBasePt
 
     ComputationNodeBasePtr inputNode = GetNodeFromName(inputNodeName);
 
-    InvalidateCompiledNetwork();
+    InvalidateCompiledNetwork({ newNode });
 
     // change all nodes that have old node as input to point to the new node instead
     ChangeNodeInputs(inputNode, newNode);
@@ -229,14 +238,20 @@ void ComputationNetwork::InsertNode(wstring inputNodeName, ComputationNodeBasePt
 }
 
 // change all nodes that have fromNode as input to have toNode as input instead
+// The changed nodes are noted for the next validation; the caller is responsible for invalidating the compiled network.
 void ComputationNetwork::ChangeNodeInputs(ComputationNodeBasePtr fromNode, ComputationNodeBasePtr toNode)
 {
     for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
     {
         ComputationNodeBasePtr node = nodeIter->second;
         for (int i = 0; i < node->GetNumInputs(); i++)
+        {
             if (node->GetInputs()[i] == fromNode)
+            {
                 node->SetInput(i, toNode);
+                m_editedNodes.insert(node);
+            }
+        }
     }
 }
 
@@ -248,7 +263,7 @@ void ComputationNetwork::ChangeNodeInputs(ComputationNodeBasePtr fromNode, Compu
 // BUGBUG: Or what if an unrelated node of the same name exists?
 void ComputationNetwork::ReplaceLeafNode(wstring oldNodeName, ComputationNodeBasePtr newNode)
 {
-    InvalidateCompiledNetwork();
+    InvalidateCompiledNetwork({ newNode });
 
     ComputationNodeBasePtr oldNode = GetNodeFromName(oldNodeName);
 
@@ -271,7 +286,7 @@ void ComputationNetwork::ReplaceLeafNode(wstring oldNodeName, ComputationNodeBas
 // BUGBUG: Can this operate on both new and existing nodes?
 void ComputationNetwork::ReplaceFinalCriterionNode(wstring oldNodeName, ComputationNodeBasePtr newNode)
 {
-    InvalidateCompiledNetwork();
+    InvalidateCompiledNetwork({ newNode });
 
     // remove old criterion node
     // BUGBUG: The old node is not removed from the network. Seems strangely inconsistent.
@@ -298,7 +313,7 @@ void ComputationNetwork::ReplaceFinalCriterionNode(wstring oldNodeName, Computat
 
 void ComputationNetwork::AddFeatureNode(ComputationNodeBasePtr featureNode)
 {
-    InvalidateCompiledNetwork();
+    InvalidateCompiledNetwork({ featureNode });
 
     AddNodeToNet(featureNode);
     AddToNodeGroup(L"feature", featureNode);
@@ -367,4 +382,549 @@ void ComputationNetwork::SetLearnableNodesBelowLearningRateMultiplier(const floa
     }
 }
 
+// -----------------------------------------------------------------------
+// optimization for evaluation
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static vector<ElemType> CopyToVector(const Matrix<ElemType>& m)
+{
+    unique_ptr<ElemType[]> data(m.CopyToArray());
+    return vector<ElemType>(data.get(), data.get() + m.GetNumElements());
+}
+
+// removes all nodes that the given outputs do not depend on, and restricts the node groups accordingly
+void ComputationNetwork::PruneUnreachableNodes(const std::vector<ComputationNodeBasePtr>& outputNodes)
+{
+    InvalidateCompiledNetwork(/*editedNodes=*/{}); // (the remaining nodes are unchanged)
+
+    const auto reachableNodes = ComputationNodeBase::EnumerateNodes(outputNodes);
+    const set<ComputationNodeBasePtr> reachable(reachableNodes.begin(), reachableNodes.end());
+
+    vector<ComputationNodeBasePtr> unreachable;
+    for (const auto& iter : m_nameToNodeMap)
+        if (reachable.find(iter.second) == reachable.end())
+            unreachable.push_back(iter.second);
+    for (const auto& node : unreachable)
+    {
+        node->DetachInputs(); // (also breaks reference cycles through recurrent nodes)
+        RemoveNodeFromNet(node);
+    }
+
+    for (auto groupIter : GetAllNodeGroups())
+    {
+        auto& group = *groupIter;
+        group.erase(remove_if(group.begin(), group.end(), [&](const ComputationNodeBasePtr& node) { return reachable.find(node) == reachable.end(); }), group.end());
+    }
+    m_outputNodes = outputNodes;
+}
+
+// replaces BatchNormalization(Times(W, x)) and spatial BatchNormalization(Convolution(W, x)) by Plus(Times/Convolution(W', x), b'),
+// where W' has the normalization scale folded into each output channel, and b' is the remaining shift.
+// Only applies if the weights and the product have no other consumers. Returns the number of folded nodes.
+template <class ElemType>
+size_t ComputationNetwork::FoldBatchNormalizationNodes()
+{
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            numConsumers[input]++;
+    for (auto groupIter : GetAllNodeGroups()) // a node that is read from outside must keep its value
+        for (const auto& node : *groupIter)
+            numConsumers[node]++;
+
+    vector<ComputationNodeBasePtr> batchNormNodes;
+    for (const auto& iter : m_nameToNodeMap)
+        if (dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(iter.second))
+            batchNormNodes.push_back(iter.second);
+
+    ComputationNetworkBuilder<ElemType> builder(*this);
+    size_t numFolded = 0;
+    for (const auto& batchNorm : batchNormNodes)
+    {
+        const auto& inputs = batchNorm->GetInputs();
+        auto product = dynamic_pointer_cast<ComputationNode<ElemType>>(inputs[0]);
+        if (!product || product->IsLeaf())
+            continue;
+        auto weights = product->GetInputs()[0];
+        if (!dynamic_pointer_cast<LearnableParameter<ElemType>>(weights) || numConsumers[product] != 1 || numConsumers[weights] != 1)
+            continue;
+        bool statisticsAreParameters = true;
+        for (size_t i = 1; i < inputs.size(); i++)
+            statisticsAreParameters &= dynamic_pointer_cast<LearnableParameter<ElemType>>(inputs[i]) != nullptr;
+        if (!statisticsAreParameters)
+            continue;
+        auto batchNormNode = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(batchNorm);
+        const auto& weightValue = dynamic_pointer_cast<ComputationNode<ElemType>>(weights)->Value();
+        auto parameterValue = [&](size_t i) { return CopyToVector(dynamic_pointer_cast<ComputationNode<ElemType>>(inputs[i])->Value()); };
+
+        // Each of the numChannels normalized channels corresponds to a row of the [numChannels x rest] weight matrix
+        // of a Times, or to a column of the [kernel size x numChannels] kernel matrix of a CHW Convolution.
+        size_t numChannels;
+        bool channelIsRow;
+        TensorShape biasShape = batchNorm->GetSampleLayout();
+        auto times = dynamic_pointer_cast<TimesNode<ElemType>>(product);
+        auto convolution = dynamic_pointer_cast<ConvolutionNode<ElemType>>(product);
+        if (times && !batchNormNode->Spatial())
+        {
+            numChannels = product->GetSampleLayout().GetNumElements();
+            if (weightValue.GetNumElements() != numChannels * product->GetInputs()[1]->GetSampleLayout().GetNumElements())
+                continue;
+            channelIsRow = true;
+        }
+        else if (convolution && batchNormNode->Spatial() && !convolution->Transpose() && convolution->ImageLayout() == ImageLayoutKind::CHW)
+        {
+            numChannels = convolution->MapCount().GetNumElements();
+            if (weightValue.GetNumElements() != numChannels * convolution->KernelShape().GetNumElements() ||
+                biasShape.GetRank() == 0 || biasShape.GetDims().back() != numChannels)
+                continue;
+            vector<size_t> biasDims(biasShape.GetRank(), 1);
+            biasDims.back() = numChannels;
+            biasShape = TensorShape(biasDims);
+            channelIsRow = false;
+        }
+        else
+            continue;
+        if (inputs[1]->GetSampleLayout().GetNumElements() != numChannels)
+            continue;
+
+        const auto scale    = parameterValue(1);
+        const auto bias     = parameterValue(2);
+        const auto mean     = parameterValue(3);
+        const auto variance = parameterValue(4);
+        const double epsilon = batchNormNode->UseCNTKEngine() ? batchNormNode->Epsilon() : max(batchNormNode->Epsilon(), 1e-5); // cuDNN raises epsilon to CUDNN_BN_MIN_EPSILON
+        vector<ElemType> factor(numChannels), shift(numChannels);
+        for (size_t c = 0; c < numChannels; c++)
+        {
+            factor[c] = (ElemType) (scale[c] / sqrt(variance[c] + epsilon));
+            shift[c] = bias[c] - factor[c] * mean[c];
+        }
+
+        auto foldedWeightValues = CopyToVector(weightValue);
+        const size_t rest = foldedWeightValues.size() / numChannels;
+        for (size_t i = 0; i < foldedWeightValues.size(); i++)
+            foldedWeightValues[i] *= factor[channelIsRow ? i % numChannels : i / rest];
+
+        // The scaled weights go into a new node under the same name, since the original value may be shared with other networks.
+        RemoveNodeFromNet(weights);
+        auto foldedWeights = builder.CreateLearnableParameter(weights->NodeName(), weights->GetSampleLayout());
+        foldedWeights->Value().SetValue(weightValue.GetNumRows(), weightValue.GetNumCols(), foldedWeights->GetDeviceId(), foldedWeightValues.data());
+        foldedWeights->SetLearningRateMultiplier(0);
+        inputs[0]->SetInput(0, foldedWeights);
+
+        // replace the BatchNormalization node by Plus(product, shift) under the same name
+        auto foldedBias = builder.CreateLearnableParameter(batchNorm->NodeName() + L".foldedBias", biasShape);
+        foldedBias->Value().SetValue(foldedBias->Value().GetNumRows(), foldedBias->Value().GetNumCols(), foldedBias->GetDeviceId(), shift.data());
+        foldedBias->SetLearningRateMultiplier(0);
+        // (and a fused ReLU by a ReLU on top, which then takes the name)
+        RemoveNodeFromNet(batchNorm);
+        auto plus = builder.Plus(product, foldedBias, batchNormNode->FusedRelu() ? batchNorm->NodeName() + L".folded" : batchNorm->NodeName());
+        ComputationNodeBasePtr replacement = batchNormNode->FusedRelu() ? builder.RectifiedLinear(plus, batchNorm->NodeName()) : plus;
+        ChangeNodeInputs(batchNorm, replacement);
+        for (auto groupIter : GetAllNodeGroups())
+            replace(groupIter->begin(), groupIter->end(), batchNorm, replacement);
+        batchNorm->DetachInputs();
+        numFolded++;
+    }
+    return numFolded;
+}
+
+// evaluates all nodes that depend on parameters only, and replaces those among them that are read by other nodes or
+// are outputs by parameters holding their value. The remaining ones become unreachable. Returns the number of replaced nodes.
+// Without 'foldLearnableParameters' (for training), only parameters that are not learned count as constants.
+// The network must be compiled, so that all dimensions are known.
+template <class ElemType>
+size_t ComputationNetwork::FoldConstantSubgraphs(const std::vector<ComputationNodeBasePtr>& outputNodes, bool foldLearnableParameters)
+{
+    // A node is constant if it is a parameter, or if it has no dynamic axis and computes a deterministic function of constant inputs.
+    // (Note that EnumerateNodes() returns inputs before their consumers.)
+    const auto nodes = ComputationNodeBase::EnumerateNodes(outputNodes);
+    set<ComputationNodeBasePtr> constants;
+    for (const auto& node : nodes)
+    {
+        bool isConstant;
+        if (node->IsLeaf())
+            isConstant = node->OperationName() == OperationNameOf(LearnableParameter) && (foldLearnableParameters || !node->IsParameterUpdateRequired());
+        else
+            isConstant = !node->HasMBLayout() && !node->RequiresPreCompute() &&
+                         !dynamic_pointer_cast<IStatefulNode>(node) && !dynamic_pointer_cast<IRngUser>(node) &&
+                         dynamic_pointer_cast<ComputationNode<ElemType>>(node) &&
+                         all_of(node->GetInputs().begin(), node->GetInputs().end(), [&](const ComputationNodeBasePtr& input) { return constants.find(input) != constants.end(); });
+        if (isConstant)
+            constants.insert(node);
+    }
+
+    // the frontier: non-trivial constant nodes that are read by non-constant nodes or from outside
+    set<ComputationNodeBasePtr> frontierSet;
+    for (const auto& node : nodes)
+    {
+        if (constants.find(node) != constants.end())
+            continue;
+        for (const auto& input : node->GetInputs())
+            if (!input->IsLeaf() && constants.find(input) != constants.end())
+                frontierSet.insert(input);
+    }
+    for (const auto& node : outputNodes)
+        if (!node->IsLeaf() && constants.find(node) != constants.end())
+            frontierSet.insert(node);
+    if (frontierSet.empty())
+        return 0;
+    const vector<ComputationNodeBasePtr> frontier(frontierSet.begin(), frontierSet.end());
+
+    // evaluate the constant subgraphs once, into private value matrices
+    MatrixPool matrixPool;
+    for (const auto& node : ComputationNodeBase::EnumerateNodes(frontier))
+    {
+        if (node->IsLeaf())
+            continue;
+        node->MarkValueNonSharable();
+        node->RequestMatricesBeforeForwardProp(matrixPool);
+        node->BeginForwardProp();
+        node->ForwardProp(FrameRange(nullptr));
+        node->EndForwardProp();
+    }
+
+    ComputationNetworkBuilder<ElemType> builder(*this);
+    size_t numFolded = 0;
+    for (const auto& node : frontier)
+    {
+        const auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        if (value.GetMatrixType() != MatrixType::DENSE)
+            continue; // (parameters are dense)
+
+        RemoveNodeFromNet(node);
+        auto folded = builder.CreateLearnableParameter(node->NodeName(), node->GetSampleLayout());
+        folded->Value().SetValue(value);
+        folded->SetLearningRateMultiplier(0);
+        ChangeNodeInputs(node, folded);
+        for (auto groupIter : GetAllNodeGroups())
+            replace(groupIter->begin(), groupIter->end(), node, ComputationNodeBasePtr(folded));
+        numFolded++;
+    }
+    return numFolded;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::FuseBatchNormalizationAndRelu()
+{
+    if (AreMatricesAllocated())
+        LogicError("FuseBatchNormalizationAndRelu: Must be called before the matrices are allocated.");
+
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            numConsumers[input]++;
+    set<ComputationNodeBasePtr> readFromOutside;
+    for (auto groupIter : GetAllNodeGroups())
+        for (const auto& node : *groupIter)
+        {
+            numConsumers[node]++;
+            readFromOutside.insert(node);
+        }
+
+    vector<ComputationNodeBasePtr> reluNodes;
+    for (const auto& iter : m_nameToNodeMap)
+        if (dynamic_pointer_cast<RectifiedLinearNode<ElemType>>(iter.second))
+            reluNodes.push_back(iter.second);
+
+    size_t numFused = 0;
+    for (const auto& relu : reluNodes)
+    {
+        auto batchNorm = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(relu->GetInputs()[0]);
+        if (!batchNorm || batchNorm->FusedRelu() || numConsumers[batchNorm] != 1 || readFromOutside.count(relu) > 0)
+            continue;
+        batchNorm->FuseRelu();
+        ChangeNodeInputs(relu, batchNorm);
+        RemoveNodeFromNet(relu);
+        relu->DetachInputs();
+        numFused++;
+    }
+    if (numFused > 0)
+        CompileNetwork();
+    return numFused;
+}
+
+template size_t ComputationNetwork::FuseBatchNormalizationAndRelu<float>();
+template size_t ComputationNetwork::FuseBatchNormalizationAndRelu<double>();
+
+map<ComputationNodeBasePtr, DEVICEID_TYPE> ComputationNetwork::PlanDevicePlacement(const ComputationNodeBasePtr& rootNode, const vector<DEVICEID_TYPE>& devices,
+                                                                                   const map<wstring, DEVICEID_TYPE>& manualPlacement,
+                                                                                   const vector<ComputationNodeBasePtr>& nodesOnNetworkDevice, size_t numSamplesHint)
+{
+    VerifyIsCompiled("PlanDevicePlacement");
+    if (devices.empty())
+        InvalidArgument("PlanDevicePlacement: No devices were given.");
+
+    map<ComputationNodeBasePtr, DEVICEID_TYPE> placement;
+    for (const auto& iter : manualPlacement)
+        placement[GetNodeFromName(iter.first)] = iter.second;
+    for (const auto& node : nodesOnNetworkDevice)
+        placement.insert(make_pair(node, m_deviceId)); // (unless placed manually)
+
+    const auto& evalOrder = GetEvalOrder(rootNode);
+    auto isParameter = [](const ComputationNodeBasePtr& node) { return node->OperationName() == OperationNameOf(LearnableParameter); };
+
+    // estimated memory of the nodes to place, in elements; a parameter counts for the first node that reads it
+    const double parameterFactor = 4; // value, gradient, and up to two smoothed gradients
+    const double activationFactor = 2; // value and gradient
+    map<ComputationNodeBasePtr, double> cost;
+    set<ComputationNodeBasePtr> countedParameters;
+    double totalCost = 0;
+    for (const auto& node : evalOrder)
+    {
+        if (node->IsLeaf() || placement.find(node) != placement.end())
+            continue;
+        double nodeCost = activationFactor * node->GetSampleLayout().GetNumElements() * (node->HasMBLayout() ? numSamplesHint : 1);
+        for (const auto& input : node->GetInputs())
+        {
+            if (isParameter(input) && placement.find(input) == placement.end() && countedParameters.insert(input).second)
+                nodeCost += parameterFactor * input->GetSampleLayout().GetNumElements();
+        }
+        cost[node] = nodeCost;
+        totalCost += nodeCost;
+    }
+
+    // cut the computing nodes into stages of about equal cost; a loop goes with the stage of its first node
+    const double stageCost = totalCost / devices.size();
+    map<shared_ptr<SEQTraversalFlowControlNode>, DEVICEID_TYPE> loopDevices;
+    size_t stage = 0;
+    double cumulativeCost = 0;
+    for (const auto& node : evalOrder)
+    {
+        auto costIter = cost.find(node);
+        if (costIter == cost.end())
+            continue;
+        // move on to the next stage once this node would end up mostly beyond the current one
+        while (stage + 1 < devices.size() && cumulativeCost + costIter->second / 2 > stageCost * (stage + 1))
+            stage++;
+        cumulativeCost += costIter->second;
+
+        auto loop = FindInRecurrentLoops(m_allSEQNodes, node);
+        if (loop)
+            placement[node] = loopDevices.insert(make_pair(loop, devices[stage])).first->second;
+        else
+            placement[node] = devices[stage];
+    }
+
+    // the leaves: parameters with their first reader, inputs on the device of the network
+    for (const auto& node : evalOrder)
+    {
+        if (node->IsLeaf())
+            continue;
+        for (const auto& input : node->GetInputs())
+        {
+            if (input->IsLeaf())
+                placement.insert(make_pair(input, isParameter(input) ? placement[node] : m_deviceId));
+        }
+    }
+
+    // a loop must not span devices, as its nodes exchange values frame by frame
+    for (const auto& node : evalOrder)
+    {
+        auto loop = FindInRecurrentLoops(m_allSEQNodes, node);
+        if (!loop)
+            continue;
+        auto device = loopDevices.insert(make_pair(loop, placement[node])).first->second;
+        if (device != placement[node])
+            InvalidArgument("PlanDevicePlacement: The recurrent loop of %ls %ls operation would span devices %d and %d, it must be placed on one device.",
+                            node->NodeName().c_str(), node->OperationName().c_str(), (int) device, (int) placement[node]);
+    }
+    return placement;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::PlaceNodesOnDevices(const ComputationNodeBasePtr& rootNode, const vector<DEVICEID_TYPE>& devices,
+                                               const map<wstring, DEVICEID_TYPE>& manualPlacement,
+                                               const vector<ComputationNodeBasePtr>& nodesOnNetworkDevice, size_t numSamplesHint)
+{
+    if (AreMatricesAllocated())
+        LogicError("PlaceNodesOnDevices: Must be called before the matrices are allocated.");
+
+    for (const auto& iter : PlanDevicePlacement(rootNode, devices, manualPlacement, nodesOnNetworkDevice, numSamplesHint))
+    {
+        if (iter.first->GetDeviceId() != iter.second)
+            iter.first->MoveToDevice(iter.second);
+    }
+
+    ComputationNetworkBuilder<ElemType> builder(*this);
+    map<pair<ComputationNodeBasePtr, DEVICEID_TYPE>, ComputationNodeBasePtr> copies; // [input, device] -> copy of the input on that device
+    const auto& allNodes = GetEvalOrder(nullptr); // (also nodes that 'rootNode' does not depend on, e.g. evaluation nodes)
+    const vector<ComputationNodeBasePtr> evalOrder(allNodes.begin(), allNodes.end()); // (the network changes below)
+    for (const auto& node : evalOrder)
+    {
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            const auto& input = node->GetInputs()[i];
+            if (input->GetDeviceId() == node->GetDeviceId())
+                continue;
+            auto& copy = copies[make_pair(input, node->GetDeviceId())];
+            if (!copy)
+            {
+                auto typedInput = dynamic_pointer_cast<ComputationNode<ElemType>>(input);
+                if (!typedInput)
+                    LogicError("PlaceNodesOnDevices: %ls %ls operation has an unexpected element type.", input->NodeName().c_str(), input->OperationName().c_str());
+                copy = builder.CrossDeviceCopy(typedInput, node->GetDeviceId(), input->NodeName() + L".copyToDevice" + to_wstring(node->GetDeviceId()));
+            }
+            node->SetInput(i, copy);
+        }
+    }
+    if (!copies.empty())
+        CompileNetwork();
+    return copies.size();
+}
+
+template size_t ComputationNetwork::PlaceNodesOnDevices<float>(const ComputationNodeBasePtr&, const vector<DEVICEID_TYPE>&, const map<wstring, DEVICEID_TYPE>&, const vector<ComputationNodeBasePtr>&, size_t);
+template size_t ComputationNetwork::PlaceNodesOnDevices<double>(const ComputationNodeBasePtr&, const vector<DEVICEID_TYPE>&, const map<wstring, DEVICEID_TYPE>&, const vector<ComputationNodeBasePtr>&, size_t);
+
+template <class ElemType>
+void ComputationNetwork::OptimizeForEvaluation(const std::vector<ComputationNodeBasePtr>& outputNodes)
+{
+    VerifyIsCompiled("OptimizeForEvaluation");
+
+    // Nodes may get replaced by others of the same name, so we track the outputs by name.
+    vector<wstring> outputNodeNames;
+    for (const auto& node : outputNodes)
+        outputNodeNames.push_back(node->NodeName());
+    auto currentOutputNodes = [&]()
+    {
+        vector<ComputationNodeBasePtr> nodes;
+        for (const auto& name : outputNodeNames)
+            nodes.push_back(GetNodeFromName(name));
+        return nodes;
+    };
+
+    const size_t numNodesBefore = m_nameToNodeMap.size();
+    PruneUnreachableNodes(outputNodes);
+    CompileNetwork();
+
+    size_t numFoldedBatchNorm = FoldBatchNormalizationNodes<ElemType>();
+    if (numFoldedBatchNorm > 0)
+        CompileNetwork();
+
+    size_t numFoldedConstants = FoldConstantSubgraphs<ElemType>(currentOutputNodes());
+    PruneUnreachableNodes(currentOutputNodes());
+    CompileNetwork();
+
+    if (TraceLevel() > 0)
+        fprintf(stderr, "OptimizeForEvaluation: reduced network from %d to %d nodes (%d BatchNormalization nodes folded, %d constant subgraphs precomputed).\n",
+                (int) numNodesBefore, (int) m_nameToNodeMap.size(), (int) numFoldedBatchNorm, (int) numFoldedConstants);
+}
+
+template void ComputationNetwork::OptimizeForEvaluation<float>(const std::vector<ComputationNodeBasePtr>& outputNodes);
+template void ComputationNetwork::OptimizeForEvaluation<double>(const std::vector<ComputationNodeBasePtr>& outputNodes);
+
+// -----------------------------------------------------------------------
+// graph optimization in CompileNetwork()
+// -----------------------------------------------------------------------
+
+// a node whose value is a deterministic function of its inputs: no state, no random numbers, no precomputation, no recurrence
+static bool IsPureFunctionOfInputs(const ComputationNodeBasePtr& node)
+{
+    return !node->IsLeaf() && !node->IsPartOfLoop() && !node->RequiresPreCompute() &&
+           !dynamic_pointer_cast<IStatefulNode>(node) && !dynamic_pointer_cast<IRngUser>(node);
+}
+
+static bool HaveSamePrecision(const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b)
+{
+    return (a->Is<ComputationNode<float>>() && b->Is<ComputationNode<float>>()) || (a->Is<ComputationNode<double>>() && b->Is<ComputationNode<double>>());
+}
+
+// Of the nodes of the same operation with the same inputs that compute the same value (HasSameComputationAs()), keeps
+// only one and connects the consumers of the others to it. Roots and members of node groups are kept, as anything
+// may refer to them by name, unless they are duplicates of each other. Since consumers come after their inputs in the
+// evaluation order, whose inputs are replaced by then, duplicate chains collapse in a single pass.
+// Returns the number of removed nodes. The network must be compiled.
+size_t ComputationNetwork::EliminateCommonSubexpressions()
+{
+    set<ComputationNodeBasePtr> pinned(m_allRoots.begin(), m_allRoots.end());
+    for (auto groupIter : GetAllNodeGroups())
+        pinned.insert(groupIter->begin(), groupIter->end());
+    auto replace = [this](const ComputationNodeBasePtr& fromNode, const ComputationNodeBasePtr& toNode)
+    {
+        ChangeNodeInputs(fromNode, toNode);
+        fromNode->DetachInputs();
+        RemoveNodeFromNet(fromNode);
+    };
+
+    size_t numMerged = 0;
+    map<vector<ComputationNodeBasePtr>, vector<ComputationNodeBasePtr>> keptNodes; // inputs -> the kept nodes with these inputs
+    const auto evalOrder = GetEvalOrder(nullptr); // (a copy, which stays valid while we edit)
+    for (const auto& node : evalOrder)
+    {
+        if (!IsPureFunctionOfInputs(node))
+            continue;
+        auto& candidates = keptNodes[node->GetInputs()];
+        auto duplicateOf = find_if(candidates.begin(), candidates.end(), [&node](const ComputationNodeBasePtr& other)
+        {
+            return other->OperationName() == node->OperationName() && HaveSamePrecision(other, node) && other->HasSameComputationAs(*node);
+        });
+        if (duplicateOf == candidates.end())
+            candidates.push_back(node);
+        else if (pinned.find(node) == pinned.end())
+        {
+            replace(node, *duplicateOf);
+            numMerged++;
+        }
+        else if (pinned.find(*duplicateOf) == pinned.end()) // keep the pinned one
+        {
+            replace(*duplicateOf, node);
+            *duplicateOf = node;
+            numMerged++;
+        }
+    }
+    return numMerged;
+}
+
+// Removes duplicate and constant computations from the validated network (Globals::EnableGraphOptimization()):
+// merges duplicate nodes (EliminateCommonSubexpressions()) and replaces the nodes that depend on parameters that are
+// not learned only, without a time axis, by such parameters holding their value (FoldConstantSubgraphs()). The nodes
+// that the roots no longer depend on are removed, except members of node groups. Returns the number of removed nodes.
+// This changes the nodes behind the names, hence it is off by default: other than by name, nothing may refer to the
+// nodes of the network (e.g. the V2 library does, by its map of variables to nodes).
+size_t ComputationNetwork::OptimizeNetworkGraph()
+{
+    const size_t numNodesBefore = m_nameToNodeMap.size();
+    vector<wstring> rootNames;
+    for (const auto& root : m_allRoots)
+        rootNames.push_back(root->NodeName());
+    auto currentRoots = [&]() // (folding replaces nodes by others of the same name)
+    {
+        vector<ComputationNodeBasePtr> roots;
+        for (const auto& name : rootNames)
+            roots.push_back(GetNodeFromName(name));
+        return roots;
+    };
+    const auto reachableBefore = ComputationNodeBase::EnumerateNodes(currentRoots());
+
+    size_t numMerged = EliminateCommonSubexpressions();
+    LoadDeferredParameterValues(); // (the folding reads them)
+    size_t numFolded = FoldConstantSubgraphs<float>(currentRoots(), /*foldLearnableParameters=*/false) +
+                       FoldConstantSubgraphs<double>(currentRoots(), /*foldLearnableParameters=*/false);
+
+    // remove what only the folded nodes depended on
+    const auto reachableNodes = ComputationNodeBase::EnumerateNodes(currentRoots());
+    const set<ComputationNodeBasePtr> reachable(reachableNodes.begin(), reachableNodes.end());
+    set<ComputationNodeBasePtr> grouped;
+    for (auto groupIter : GetAllNodeGroups())
+        grouped.insert(groupIter->begin(), groupIter->end());
+    for (const auto& node : reachableBefore)
+    {
+        if (reachable.find(node) != reachable.end() || grouped.find(node) != grouped.end() || !NodeNameExists(node->NodeName()) || GetNodeFromName(node->NodeName()) != node)
+            continue;
+        node->DetachInputs();
+        RemoveNodeFromNet(node);
+    }
+    for (const auto& node : reachableBefore) // (the folded nodes, which had to keep their inputs for the above)
+    {
+        if (reachable.find(node) == reachable.end())
+            node->DetachInputs();
+    }
+
+    const size_t numRemoved = numNodesBefore - m_nameToNodeMap.size();
+    if (TraceLevel() > 0 && (numMerged > 0 || numFolded > 0))
+        fprintf(stderr, "Graph optimization: %d nodes eliminated (%d duplicate nodes merged, %d constant subgraphs precomputed).\n",
+                (int) numRemoved, (int) numMerged, (int) numFolded);
+    return numMerged + numFolded;
+}
+
 }}}
@@ -11,12 +11,24 @@
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
+#include "TrainingNodes.h"
+#include "ReshapingNodes.h"
+#include "CudaGraph.h"
+#include "GPUStreamPool.h"
+#include "GPUCopyStream.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "Globals.h"
+#include "CuDnnFactories.h" // for CudaTimer
+#include "PerformanceCounters.h"
+#include "MemoryTimeline.h"
+#include "BestGpu.h"
 #include <string>
 #include <vector>
 #include <list>
 #include <set>
 #include <algorithm>
 #include <map>
+#include <functional>
 
 using namespace std;
 
@@ -40,21 +52,32 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
 {
     VerifyIsCompiled("ForwardProp");
 
+    // with a static memory plan, the node matrices have room for a limited number of columns
+    if (m_matrixPool.HasStaticPlan())
+    {
+        for (const auto& input : InputNodes(rootNode))
+        {
+            if (input->HasMBLayout() && input->GetMBLayout()->GetNumCols() > m_matrixPool.GetPlannedMaxColumns())
+                RuntimeError("ForwardProp: The minibatch has %d columns (samples and gaps), but the static memory plan has room for %d.",
+                             (int) input->GetMBLayout()->GetNumCols(), (int) m_matrixPool.GetPlannedMaxColumns());
+        }
+    }
+
     // traverse all nodes in the pre-determined evaluation order
     GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
 }
 
-// set the gradient matrix of a (root) node 1.0
+// set the gradient matrix of a (root) node to a scalar (1.0 unless the loss is scaled)
 // Returns false if the node is not a ComputationNode<ElemType>; see Backprop() below for intended use.
 template <class ElemType>
-static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
+static bool SetRootGradientToScalar(ComputationNodeBasePtr nodep, double value)
 {
     auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
     bool hasMatchingType = (node != nullptr);
     if (hasMatchingType)
     {
-        // reset the root gradient to 1
-        node->ResetGradient(1);
+        // reset the root gradient to the value
+        node->ResetGradient((ElemType)value);
     }
     return hasMatchingType;
 }
@@ -64,20 +87,24 @@ static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, double rootGradient, // training criterion to compute the gradients for
+                                  const std::function<void(const ComputationNodeBasePtr&)>& onGradientComplete)
 {
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
 
-    // initialize root gradient with a scalar value of 1.0
-    if (!SetRootGradientToScalarOne<float>(rootNode) && !SetRootGradientToScalarOne<double>(rootNode))
+    // initialize root gradient with a scalar value of 1.0 (or the loss scale)
+    if (!SetRootGradientToScalar<float>(rootNode, rootGradient) && !SetRootGradientToScalar<double>(rootNode, rootGradient))
         LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
 
     // reset all gradients below rootNode to zero (actually, internally, this is lazy, but we don't care here)
     ZeroInputGradients(rootNode);
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    network->m_onGradientComplete = onGradientComplete;
+    network->Backprop(FrameRange(nullptr), true, true);
+    network->m_onGradientComplete = nullptr;
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -132,8 +159,406 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
         }
     }
 }
+// -----------------------------------------------------------------------
+// ConcurrentNodeScheduler -- spreads the GPU work of the nodes of a PAR traversal over the streams of a GPUStreamPool
+// The nodes are still issued one by one in evaluation order; only the stream they go to differs. A node continues
+// on the stream of the producer of its first input, unless another consumer already did, and otherwise takes the
+// next stream round-robin. Dependencies are tracked per buffer: a node waits for the last writer of each buffer it
+// reads, and for the last writer and the readers since of each buffer it writes, which also covers buffers that
+// nodes share through the MatrixPool. Nodes whose buffers are not known run as barriers on the thread's stream.
+// -----------------------------------------------------------------------
+
+class ConcurrentNodeScheduler
+{
+public:
+    ConcurrentNodeScheduler(GPUStreamPool& pool)
+        : m_pool(pool), m_nextStream(0), m_currentStream(0), m_begun(false)
+    {
+        m_pool.Begin();
+        m_begun = true;
+    }
+    ~ConcurrentNodeScheduler()
+    {
+        if (m_begun)
+        {
+            try { m_pool.End(); } catch (...) { } // (unwinding)
+        }
+    }
+
+    // the dependencies of a node's work, or false if they cannot be determined
+    static bool GetForwardPropBuffers(const ComputationNodeBasePtr& node, std::vector<const void*>& reads, std::vector<const void*>& writes)
+    {
+        if (dynamic_pointer_cast<FlowControlNode>(node))
+            return false;
+        auto output = BufferOf(node->ValuePtr());
+        if (!output)
+            return false;
+        writes.push_back(output);
+        auto inputs = node->GetInputs();
+        if (node->GetElementwiseFusion()) // the fused nodes are computed by this one from their inputs
+        {
+            const auto& members = node->GetElementwiseFusion()->m_members;
+            for (const auto& member : members)
+                for (const auto& input : member->GetInputs())
+                    if (find(members.begin(), members.end(), input) == members.end())
+                        inputs.push_back(input);
+        }
+        for (const auto& input : inputs)
+        {
+            auto buffer = BufferOf(input->ValuePtr());
+            if (!buffer)
+                return false;
+            reads.push_back(buffer);
+        }
+        return true;
+    }
+
+    // run 'work' on a stream after everything it depends on
+    void Run(const std::vector<const void*>& reads, const std::vector<const void*>& writes, const std::function<void()>& work)
+    {
+        // pick the stream
+        m_currentStream = m_nextStream;
+        auto first = reads.empty() ? m_buffers.end() : m_buffers.find(reads.front());
+        if (first != m_buffers.end() && first->second.m_hasWriter && !first->second.m_continued)
+        {
+            m_currentStream = first->second.m_writer.first;
+            first->second.m_continued = true;
+        }
+        else
+            m_nextStream = (m_nextStream + 1) % m_pool.GetNumStreams();
+        m_pool.Use(m_currentStream);
+
+        // wait for the dependencies
+        for (const auto& buffer : reads)
+        {
+            auto iter = m_buffers.find(buffer);
+            if (iter != m_buffers.end() && iter->second.m_hasWriter)
+                WaitFor(iter->second.m_writer);
+        }
+        for (const auto& buffer : writes)
+        {
+            auto iter = m_buffers.find(buffer);
+            if (iter == m_buffers.end())
+                continue;
+            if (iter->second.m_hasWriter)
+                WaitFor(iter->second.m_writer);
+            for (const auto& reader : iter->second.m_readers)
+                WaitFor(reader);
+        }
+
+        work();
+
+        auto done = make_pair(m_currentStream, m_pool.Record());
+        for (const auto& buffer : reads)
+            m_buffers[buffer].m_readers.push_back(done);
+        for (const auto& buffer : writes)
+        {
+            auto& state = m_buffers[buffer];
+            state.m_hasWriter = true;
+            state.m_writer = done;
+            state.m_readers.clear();
+            state.m_continued = false;
+        }
+    }
+
+    // run 'work' after all work issued so far, and before all work that follows
+    void RunAsBarrier(const std::function<void()>& work)
+    {
+        m_pool.End();
+        m_begun = false;
+        work();
+        m_pool.Begin();
+        m_begun = true;
+        m_buffers.clear(); // (all ordered by the barrier)
+    }
+
+private:
+    static const void* BufferOf(const MatrixBasePtr& value)
+    {
+        if (auto matrix = dynamic_pointer_cast<Matrix<float>>(value))
+            return matrix->Data();
+        if (auto matrix = dynamic_pointer_cast<Matrix<double>>(value))
+            return matrix->Data();
+        return nullptr;
+    }
+
+    void WaitFor(const std::pair<size_t, size_t>& streamAndEvent)
+    {
+        if (streamAndEvent.first != m_currentStream) // (a stream is ordered anyway)
+            m_pool.Wait(streamAndEvent.second);
+    }
+
+    struct BufferState
+    {
+        bool m_hasWriter = false;
+        std::pair<size_t, size_t> m_writer;                 // (stream, event) of the last node that wrote the buffer
+        std::vector<std::pair<size_t, size_t>> m_readers;   // (stream, event) of the nodes that read it since
+        bool m_continued = false;                           // a reader has continued on the writer's stream
+    };
+    GPUStreamPool& m_pool;
+    std::map<const void*, BufferState> m_buffers;
+    size_t m_nextStream;
+    size_t m_currentStream;
+    bool m_begun;
+};
+
+// -----------------------------------------------------------------------
+// ActivationOffloader -- copies values that backprop needs to pinned host memory after their last consumer in forward prop,
+// and back ahead of their first use in backprop (see ComputationNetwork::PlanActivationOffloading()).
+// The copies run on a GPUCopyStream and overlap with the computation of the following nodes: the memory-sharing plan
+// reuses the device buffer of an offloaded value only after the node that follows its last consumer, and assigns a second
+// matrix for the value from the prefetch point until the node's own backprop (see ComputationNodeBase::SwapBackpropValue()).
+// The hooks are called by PARTraversalFlowControlNode, for all nested networks, since the last consumer of a value
+// may be computed on behalf of any root.
+// -----------------------------------------------------------------------
+
+class ActivationOffloader
+{
+public:
+    ActivationOffloader(DEVICEID_TYPE deviceId)
+        : m_deviceId(deviceId), m_copyStream(deviceId)
+    {
+    }
+
+    ~ActivationOffloader()
+    {
+        for (auto& value : m_values)
+            if (value.m_hostBuffer)
+                CUDAPageLockedMemAllocator::Free(value.m_hostBuffer, m_deviceId);
+    }
+
+    // --- plan
+
+    // position of a node that runs in forward prop, in the order of the memory-sharing plan
+    void SetForwardIndex(const ComputationNodeBasePtr& node, size_t index) { m_forwardIndex[node] = index; }
+
+    void AddValue(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& prefetchBefore, const ComputationNodeBasePtr& firstUse)
+    {
+        m_valueIndex[node] = m_values.size();
+        m_prefetchBefore[prefetchBefore].push_back(m_values.size());
+        m_waitBefore[firstUse].push_back(m_values.size());
+        m_values.push_back(OffloadedValue());
+        m_values.back().m_node = node;
+    }
+
+    // the copy to the host starts after 'lastConsumer' has run, and must be complete before the node at 'reusableFrom'
+    void SetLastConsumer(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& lastConsumer) { m_offloadAfter[lastConsumer].push_back(m_valueIndex.at(node)); }
+    void SetReusableFrom(const ComputationNodeBasePtr& node, size_t reusableFrom) { m_values[m_valueIndex.at(node)].m_reusableFrom = reusableFrom; }
+
+    bool IsOffloaded(const ComputationNodeBasePtr& node) const { return m_valueIndex.find(node) != m_valueIndex.end(); }
+    std::vector<ComputationNodeBasePtr> GetPrefetchesBefore(const ComputationNodeBasePtr& node) const
+    {
+        std::vector<ComputationNodeBasePtr> nodes;
+        auto prefetches = m_prefetchBefore.find(node);
+        if (prefetches != m_prefetchBefore.end())
+            for (auto i : prefetches->second)
+                nodes.push_back(m_values[i].m_node);
+        return nodes;
+    }
+    size_t GetNumValues() const { return m_values.size(); }
+
+    // --- forward prop
+
+    // wait for the copies of the values whose device buffers the node may overwrite
+    void BeforeForwardProp(const ComputationNodeBasePtr& node)
+    {
+        auto index = m_forwardIndex.find(node);
+        if (index == m_forwardIndex.end())
+            return;
+        for (size_t i = 0; i < m_inFlight.size();)
+        {
+            if (m_values[m_inFlight[i]].m_reusableFrom <= index->second)
+            {
+                m_copyStream.Wait(m_values[m_inFlight[i]].m_copy);
+                m_inFlight.erase(m_inFlight.begin() + i);
+            }
+            else
+                i++;
+        }
+    }
+
+    // start copying the values whose last consumer this node is
+    void AfterForwardProp(const ComputationNodeBasePtr& node)
+    {
+        auto offloads = m_offloadAfter.find(node);
+        if (offloads == m_offloadAfter.end())
+            return;
+        for (auto i : offloads->second)
+        {
+            auto& value = m_values[i];
+            if (!value.m_node->HasEnvironmentPtr() || !value.m_node->Environment().IsTraining()) // (no backprop will follow)
+                continue;
+            const void* data = GetDeviceData(value.m_node->ValuePtr(), value.m_numRows, value.m_numCols, value.m_numBytes);
+            if (value.m_numBytes > value.m_hostBufferBytes)
+            {
+                if (value.m_hostBuffer)
+                    CUDAPageLockedMemAllocator::Free(value.m_hostBuffer, m_deviceId);
+                value.m_hostBuffer = nullptr; // (in case Malloc() throws)
+                value.m_hostBuffer = CUDAPageLockedMemAllocator::Malloc(value.m_numBytes, m_deviceId);
+                value.m_hostBufferBytes = value.m_numBytes;
+            }
+            value.m_copy = m_copyStream.CopyAsync(value.m_hostBuffer, data, value.m_numBytes);
+            value.m_onHost = true;
+            m_inFlight.push_back(i);
+        }
+    }
+
+    // at the end of a forward pass, the device buffers may be reused by anything
+    void EndForwardProp()
+    {
+        for (auto i : m_inFlight)
+            m_copyStream.Wait(m_values[i].m_copy);
+        m_inFlight.clear();
+    }
+
+    // --- backprop
+
+    // start copying back the values that are used a few nodes later, and wait for the ones this node uses
+    void BeforeBackprop(const ComputationNodeBasePtr& node)
+    {
+        auto prefetches = m_prefetchBefore.find(node);
+        if (prefetches != m_prefetchBefore.end())
+        {
+            for (auto i : prefetches->second)
+            {
+                auto& value = m_values[i];
+                if (!value.m_onHost)
+                    LogicError("ActivationOffloader: The value of %ls %ls operation was not copied to the host in forward prop.", value.m_node->NodeName().c_str(), value.m_node->OperationName().c_str());
+                value.m_node->SwapBackpropValue();
+                value.m_restored = true;
+                void* data = ResizeDeviceData(value.m_node->ValuePtr(), value.m_numRows, value.m_numCols);
+                value.m_copy = m_copyStream.CopyAsync(data, value.m_hostBuffer, value.m_numBytes);
+            }
+        }
+        auto waits = m_waitBefore.find(node);
+        if (waits != m_waitBefore.end())
+            for (auto i : waits->second)
+                m_copyStream.Wait(m_values[i].m_copy);
+    }
+
+    // switch back to the values of forward prop (also if backprop was aborted)
+    void EndBackprop()
+    {
+        for (auto& value : m_values)
+        {
+            if (value.m_restored)
+                value.m_node->SwapBackpropValue();
+            value.m_restored = false;
+            value.m_onHost = false;
+        }
+    }
+
+private:
+    struct OffloadedValue
+    {
+        ComputationNodeBasePtr m_node;
+        size_t m_reusableFrom = SIZE_MAX;   // forward index of the first node that may get the device buffer
+        void* m_hostBuffer = nullptr;       // pinned
+        size_t m_hostBufferBytes = 0;
+        size_t m_numRows = 0, m_numCols = 0, m_numBytes = 0; // of the value in forward prop
+        size_t m_copy = 0;                  // pending copy
+        bool m_onHost = false;              // copied to the host in this forward pass
+        bool m_restored = false;            // the node's value is the backprop value
+    };
+
+    template <class ElemType>
+    static Matrix<ElemType>* AsDenseMatrix(const MatrixBasePtr& matrix)
+    {
+        auto typed = dynamic_cast<Matrix<ElemType>*>(matrix.get());
+        if (typed && (typed->GetMatrixType() != MatrixType::DENSE || typed->GetCurrentMatrixLocation() != CurrentDataLocation::GPU))
+            LogicError("ActivationOffloader: Only dense values on the GPU can be offloaded.");
+        return typed;
+    }
+
+    static const void* GetDeviceData(const MatrixBasePtr& matrix, size_t& numRows, size_t& numCols, size_t& numBytes)
+    {
+        if (auto floatMatrix = AsDenseMatrix<float>(matrix))
+            return GetDeviceData(*floatMatrix, numRows, numCols, numBytes);
+        else if (auto doubleMatrix = AsDenseMatrix<double>(matrix))
+            return GetDeviceData(*doubleMatrix, numRows, numCols, numBytes);
+        LogicError("ActivationOffloader: Unexpected element type.");
+    }
+
+    template <class ElemType>
+    static const void* GetDeviceData(const Matrix<ElemType>& matrix, size_t& numRows, size_t& numCols, size_t& numBytes)
+    {
+        numRows = matrix.GetNumRows();
+        numCols = matrix.GetNumCols();
+        numBytes = matrix.GetNumElements() * sizeof(ElemType);
+        return matrix.Data();
+    }
+
+    static void* ResizeDeviceData(const MatrixBasePtr& matrix, size_t numRows, size_t numCols)
+    {
+        if (auto floatMatrix = dynamic_cast<Matrix<float>*>(matrix.get()))
+        {
+            floatMatrix->Resize(numRows, numCols);
+            return floatMatrix->Data();
+        }
+        else if (auto doubleMatrix = dynamic_cast<Matrix<double>*>(matrix.get()))
+        {
+            doubleMatrix->Resize(numRows, numCols);
+            return doubleMatrix->Data();
+        }
+        LogicError("ActivationOffloader: Unexpected element type.");
+    }
+
+    DEVICEID_TYPE m_deviceId;
+    GPUCopyStream m_copyStream;
+    std::vector<OffloadedValue> m_values;
+    std::unordered_map<ComputationNodeBasePtr, size_t> m_valueIndex;
+    std::unordered_map<ComputationNodeBasePtr, size_t> m_forwardIndex;
+    std::unordered_map<ComputationNodeBasePtr, std::vector<size_t>> m_offloadAfter;   // [last consumer] values to copy to the host
+    std::unordered_map<ComputationNodeBasePtr, std::vector<size_t>> m_prefetchBefore; // [nested node of the criterion] values to copy back
+    std::unordered_map<ComputationNodeBasePtr, std::vector<size_t>> m_waitBefore;     // [nested node of the criterion] values it uses
+    std::vector<size_t> m_inFlight;                                                   // values being copied to the host
+};
+
+GPUStreamPool* ComputationNetwork::PARTraversalFlowControlNode::GetStreamPool()
+{
+    size_t numStreams = Globals::GetNumConcurrentStreams();
+    if (numStreams <= 1 || m_nestedNodes.size() <= 1 || !GPUStreamPool::IsSupported(m_nestedNodes.front()->GetDeviceId()))
+        return nullptr;
+    if (!m_streamPool || m_streamPool->GetNumStreams() != numStreams)
+        m_streamPool = make_shared<GPUStreamPool>(m_nestedNodes.front()->GetDeviceId(), numStreams);
+    return m_streamPool.get();
+}
+
+// Runs the forward or backward computation of a node and adds its duration and estimated cost (ICostEstimable) to the
+// PerformanceCounters. On the GPU, this waits for the node's work to complete, which is why it is done for sampled
+// minibatches only.
+template <class F>
+static void RunTimed(const ComputationNodeBasePtr& node, bool isBackward, const F& work)
+{
+    double seconds;
+    if (node->GetDeviceId() >= 0)
+    {
+        CudaTimer timer;
+        timer.Start();
+        work();
+        timer.Stop();
+        seconds = timer.Elapsed() / 1000.0;
+    }
+    else
+    {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    NodeCost cost{0, 0};
+    if (auto costEstimable = dynamic_cast<const ICostEstimable*>(node.get()))
+        cost = isBackward ? costEstimable->GetBackwardCost() : costEstimable->GetForwardCost();
+    PerformanceCounters::Instance().AddNodeTiming(node->NodeName(), seconds, isBackward, cost.m_flops, cost.m_bytes);
+}
+
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    // with multiple streams, independent nodes (e.g. parallel branches) may run concurrently on the GPU
+    // (not with activation offloading, whose copies are ordered against the thread's stream, nor with a static memory plan,
+    // whose buffers overlap in ways that the scheduler does not track)
+    auto streamPool = m_activationOffloader || m_hasStaticMemoryPlan ? nullptr : GetStreamPool();
+    unique_ptr<ConcurrentNodeScheduler> scheduler(streamPool ? new ConcurrentNodeScheduler(*streamPool) : nullptr);
+
     for (auto& node : m_nestedNodes)
     {
 #if 0
@@ -142,9 +567,33 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 #endif
         if (node->IsOutOfDateWrtInputs())
         {
-            node->BeginForwardProp();
-            node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
-            node->EndForwardProp();
+            if (!node->IsFusedIntoConsumer()) // (computed by its consumer, see FuseElementwiseOps())
+            {
+                if (m_activationOffloader)
+                    m_activationOffloader->BeforeForwardProp(node);
+                node->BeginForwardProp();
+                auto work = [&]()
+                {
+                    if (node->GetElementwiseFusion())
+                        node->ForwardPropFused(fr.WithLayout(node->GetMBLayout()));
+                    else
+                        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+                };
+                std::vector<const void*> reads, writes;
+                if (PerformanceCounters::Instance().IsTimingNodes() && !scheduler)
+                    RunTimed(node, /*isBackward=*/false, work);
+                else if (!scheduler)
+                    work();
+                else if (ConcurrentNodeScheduler::GetForwardPropBuffers(node, reads, writes))
+                    scheduler->Run(reads, writes, work);
+                else
+                    scheduler->RunAsBarrier(work);
+                node->EndForwardProp();
+                if (m_activationOffloader)
+                    m_activationOffloader->AfterForwardProp(node);
+                if (m_memoryTimeline)
+                    m_memoryTimeline->Record(node, /*isBackward=*/false);
+            }
 
             node->BumpEvalTimeStamp();
         }
@@ -153,24 +602,93 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
         if (node->HasEnvironmentPtr() && node->Environment().IsLogLevelNodeTrace())
             DumpNode<float>(node, /*dumpGradient=*/false) || DumpNode<double>(node, false);
     }
+    if (m_activationOffloader)
+        m_activationOffloader->EndForwardProp();
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
-    // process nodes in pre-determined order
-    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    const size_t noSegment = SIZE_MAX;
+    size_t activeSegment = noSegment; // segment whose values are currently recomputed (activation recomputation only)
+    try
     {
-        auto& node = *pnode;
+        // process nodes in pre-determined order
+        for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+        {
+            auto& node = *pnode;
 
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+            // with activation recomputation, recompute the values of a segment when entering it
+            if (!m_recomputationSegments.empty())
+            {
+                size_t segment = m_recomputationSegments[m_nestedNodes.rend() - pnode - 1];
+                if (segment != activeSegment)
+                {
+                    if (activeSegment != noSegment)
+                        EndRecomputation(activeSegment);
+                    activeSegment = segment;
+                    BeginRecomputation(segment, fr);
+                }
+            }
 
-        // Extreme Tracing, part 2/4
-        if (node->HasEnvironmentPtr() && node->Environment().IsLogLevelNodeTrace() && node->NeedsGradient())
-            DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+            // with activation offloading, copy values back from the host ahead of their use
+            if (m_activationOffloader)
+                m_activationOffloader->BeforeBackprop(node);
+
+            node->BeginBackprop();
+            auto work = [&]()
+            {
+                node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+            };
+            if (PerformanceCounters::Instance().IsTimingNodes())
+                RunTimed(node, /*isBackward=*/true, work);
+            else
+                work();
+            node->EndBackprop();
+            if (m_memoryTimeline)
+                m_memoryTimeline->Record(node, /*isBackward=*/true);
+
+            // all consumers come later in the evaluation order, hence the gradient of the node is final now
+            if (m_onGradientComplete && node->NeedsGradient())
+                m_onGradientComplete(node);
+
+            // Extreme Tracing, part 2/4
+            if (node->HasEnvironmentPtr() && node->Environment().IsLogLevelNodeTrace() && node->NeedsGradient())
+                DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+        }
+    }
+    catch (...)
+    {
+        if (activeSegment != noSegment) // the next forward prop must find the values where the memory-sharing plan expects them
+            EndRecomputation(activeSegment);
+        if (m_activationOffloader)
+            m_activationOffloader->EndBackprop();
+        throw;
+    }
+    if (activeSegment != noSegment)
+        EndRecomputation(activeSegment);
+    if (m_activationOffloader)
+        m_activationOffloader->EndBackprop();
+}
+
+// recompute the values of a segment into their recomputation matrices (see ComputationNetwork::PlanActivationRecomputation())
+void ComputationNetwork::PARTraversalFlowControlNode::BeginRecomputation(size_t segment, const FrameRange& fr)
+{
+    for (auto& node : m_recomputedNodes[segment])
+        node->SwapBackpropValue();
+    for (auto& node : m_recomputedNodes[segment])
+    {
+        node->BeginForwardProp();
+        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
     }
 }
+
+// switch back to the values of forward prop
+void ComputationNetwork::PARTraversalFlowControlNode::EndRecomputation(size_t segment)
+{
+    for (auto& node : m_recomputedNodes[segment])
+        node->SwapBackpropValue();
+}
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
 }
@@ -228,7 +746,8 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
 
     // tell all that loop is about to commence
     for (auto& node : m_nestedNodes)
-        node->BeginForwardProp();
+        if (!node->IsFusedIntoConsumer()) // (has no value, see FuseElementwiseOps())
+            node->BeginForwardProp();
 }
 
 // evaluation of a SEQTraversalFlowControlNode FlowControlNode
@@ -249,7 +768,11 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     {
         for (auto& node : m_nestedNodes)
         {
-            node->ForwardProp(t);
+            // element-wise nodes of the loop may be fused, which saves kernel launches in each time step
+            if (node->GetElementwiseFusion())
+                node->ForwardPropFused(t);
+            else if (!node->IsFusedIntoConsumer()) // (computed by its consumer)
+                node->ForwardProp(t);
             node->BumpEvalTimeStamp();
         }
     }
@@ -268,7 +791,8 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
 {
     // tell all that loop is done  --e.g. PastValueNode will capture its state for BPTT processing
     for (auto& node : m_nestedNodes)
-        node->EndForwardProp();
+        if (!node->IsFusedIntoConsumer())
+            node->EndForwardProp();
 }
 
 // called before first iteration step of ComputeGradient()
@@ -324,7 +848,8 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
 /*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
     for (auto& nodeLoopIter : m_nestedNodes)
-        nodeLoopIter->RequestMatricesBeforeForwardProp(matrixPool);
+        if (!nodeLoopIter->IsFusedIntoConsumer())
+            nodeLoopIter->RequestMatricesBeforeForwardProp(matrixPool);
 }
 /*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) /*override*/
 {
@@ -393,6 +918,96 @@ void ComputationNetwork::ResetEvalTimeStamps()
         nodes[i]->BumpEvalTimeStamp();
 }
 
+// the device buffer of a node's value, or nullptr if it is not a dense matrix (which we do not capture)
+static const void* DenseValueBuffer(const ComputationNodeBasePtr& node)
+{
+    const auto& value = node->ValuePtr();
+    if (!value || value->GetMatrixType() != MatrixType::DENSE)
+        return nullptr;
+    if (auto matrix = dynamic_pointer_cast<Matrix<float>>(value))
+        return matrix->Data();
+    if (auto matrix = dynamic_pointer_cast<Matrix<double>>(value))
+        return matrix->Data();
+    return nullptr;
+}
+
+void ComputationNetwork::ForwardPropCaptured(const std::vector<ComputationNodeBasePtr>& roots, const std::vector<size_t>& shapeKey)
+{
+    VerifyIsCompiled("ForwardPropCaptured");
+
+    // a replay only reproduces the GPU work, so all host-side state the nodes compute must be the same as in the captured pass
+    bool capturable = CudaGraph::IsSupported(GetDeviceId()) && Environment().IsInferring();
+    auto key = shapeKey;
+    std::vector<const void*> buffers;
+    for (const auto& root : roots)
+    {
+        key.push_back((size_t)root.get());
+        for (const auto& node : GetEvalOrder(root))
+        {
+            auto buffer = DenseValueBuffer(node);
+            if (!buffer || node->IsPartOfLoop() || dynamic_pointer_cast<IRngUser>(node))
+                capturable = false;
+            buffers.push_back(buffer);
+        }
+    }
+    if (!capturable)
+    {
+        ForwardProp(roots);
+        return;
+    }
+
+    // The buffers and sizes left by the previous call are valid for a replay only if that call had the same key.
+    auto& captured = m_capturedForwardProps[key];
+    bool sameAsLastCall = (key == m_lastCapturedForwardPropKey);
+    m_lastCapturedForwardPropKey = key;
+    if (sameAsLastCall && captured.m_graph && captured.m_buffers == buffers)
+    {
+        captured.m_graph->Launch();
+        for (const auto& root : roots)
+            for (const auto& node : GetEvalOrder(root))
+                node->BumpEvalTimeStamp();
+        return;
+    }
+
+    // Otherwise run normally, which sizes all values for this key, and record the pass again for the next call.
+    // A failed capture is remembered as an entry without graph, so that we do not keep trying.
+    ForwardProp(roots);
+    buffers.clear();
+    for (const auto& root : roots)
+        for (const auto& node : GetEvalOrder(root))
+            buffers.push_back(DenseValueBuffer(node));
+    bool failedBefore = !captured.m_graph && !captured.m_buffers.empty();
+    if (failedBefore || (captured.m_graph && captured.m_buffers == buffers))
+        return;
+    captured.m_buffers = buffers;
+    captured.m_graph = make_shared<CudaGraph>(GetDeviceId());
+    captured.m_graph->BeginCapture();
+    bool succeeded;
+    try
+    {
+        for (const auto& root : roots)
+            for (const auto& node : GetEvalOrder(root))
+                node->SetEvalTimeStampOutdatedWrtAll();
+        ForwardProp(roots);
+        succeeded = captured.m_graph->EndCapture();
+    }
+    catch (const std::exception&)
+    {
+        // typically a call that is not allowed while capturing, e.g. a synchronous copy
+        captured.m_graph->EndCapture();
+        succeeded = false;
+    }
+    // Nothing has run while capturing, so the values are still those of the normal pass above.
+    for (const auto& root : roots)
+        for (const auto& node : GetEvalOrder(root))
+            node->BumpEvalTimeStamp();
+    if (!succeeded)
+    {
+        fprintf(stderr, "ForwardPropCaptured: The forward pass cannot be captured as a CUDA graph and will be evaluated normally for this input shape.\n");
+        captured.m_graph = nullptr;
+    }
+}
+
 // for debugging
 void ComputationNetwork::PrintComputationTree(const ComputationNodeBasePtr& rootNode,
                                               const bool forwardCompute,
@@ -424,7 +1039,23 @@ void ComputationNetwork::PrintComputationTree(const ComputationNodeBasePtr& root
 
 // called by model editing operations, such as DeleteNode(); and by RebuildNetwork()
 // These invalidates any post-processed structures. If they are accessed, we will fail.
+// The next CompileNetwork() will validate all nodes again.
 void ComputationNetwork::InvalidateCompiledNetwork()
+{
+    ClearCompiledState();
+    m_validatedNodes.clear();
+    m_editedNodes.clear();
+}
+
+// called by model editing operations that know which nodes they changed, such as ReplaceNode()
+// The next CompileNetwork() will only revalidate what depends on these, as long as nothing else was invalidated since the last one.
+void ComputationNetwork::InvalidateCompiledNetwork(const vector<ComputationNodeBasePtr>& editedNodes)
+{
+    ClearCompiledState();
+    m_editedNodes.insert(editedNodes.begin(), editedNodes.end());
+}
+
+void ComputationNetwork::ClearCompiledState()
 {
     m_isCompiled = false;
     m_allSEQNodes.clear();
@@ -432,6 +1063,10 @@ void ComputationNetwork::InvalidateCompiledNetwork()
     m_nestedNetworks.clear();
     m_inputValues.clear();
     m_learnableParameters.clear();
+    m_pipelineRootNode = nullptr;
+    m_pipelineStages.clear();
+    m_pipelineStash.clear();
+    m_pipelineRngOffsets.clear();
 }
 
 // verify that network has undergone CompileNetwork()
@@ -452,7 +1087,10 @@ void ComputationNetwork::CompileNetwork()
 
     // We may only get here if not !IsCompiled(). We could now verify each member to be virgin.
     // Or just invalidate it again, which is easier and safer.
-    InvalidateCompiledNetwork();
+    // If the network was only invalidated by edits that reported their nodes, the nodes they do not affect remain valid.
+    // Compiling a compiled network again validates all nodes.
+    const bool isIncremental = !m_isCompiled && !m_validatedNodes.empty();
+    ClearCompiledState();
 
     // all steps below have to be repeated for all root nodes (=nodes without parents and PreComputeNodes)
     DetermineSetOfAllRoots();
@@ -476,10 +1114,15 @@ void ComputationNetwork::CompileNetwork()
     // TODO: Move this further down; or decide whether the 'nullptr' version is needed, other than ResetMBLayouts() which could use the global order and filter by itself.
     CollectInputAndLearnableParameters(nullptr);
 
+    // STEP: Determine the nodes to validate: all, or after edits only those affected by them.
+    const auto nodesToValidate = isIncremental ? NodesAffectedByEdits() : GetEvalOrder(nullptr);
+    if (TraceLevel() > 0 && isIncremental)
+        fprintf(stderr, "\n%d out of %d nodes are affected by edits.\n", (int) nodesToValidate.size(), (int) GetEvalOrder(nullptr).size());
+
     // STEP: Establish time-axis relationships.
     // This sets all MBLayout pointers of Input nodes according to user spec of time axes.
     // TODO: Don't use m_inputValues, traverse ourselves, to remove dependency on FormEvalOrder().
-    ResetMBLayouts();
+    ResetMBLayouts(nodesToValidate);
 
     // STEP: Discover nested loops.
     FormRecurrentLoops(nullptr); // form the global one  --TODO: just use this; should be no need to do this for each root
@@ -498,10 +1141,20 @@ void ComputationNetwork::CompileNetwork()
         FormNestedNetwork(node);
 
     // STEP: Infer node dimensions.
-    ValidateNetwork();
+    ValidateNetwork(nodesToValidate);
+    const auto& allNodes = GetEvalOrder(nullptr);
+    m_validatedNodes = set<ComputationNodeBasePtr>(allNodes.begin(), allNodes.end());
+    m_editedNodes.clear();
 
     // STEP: Optimize the network.
-    // :)
+    // After changes to the graph, it is compiled again from scratch (where the optimization then finds nothing left to do).
+    // (Fusion of element-wise ops depends on the roots being evaluated and is therefore done in AllocateAllMatrices().)
+    if (Globals::ShouldOptimizeNetworkGraph() && OptimizeNetworkGraph() > 0)
+    {
+        InvalidateCompiledNetwork();
+        CompileNetwork();
+        return;
+    }
 
     // STEP: Some final details.
     ResetEvalTimeStamps(); // invalidate all m_value fields. Really belongs into StartEvaluateMinibatchLoop()
@@ -568,27 +1221,34 @@ void ComputationNetwork::DetermineSetOfAllRoots()
     });
 }
 
-// initial setup of MBLayout pointers
+// initial setup of MBLayout pointers of the nodes about to be validated
 //  - link all input nodes to one or more MBLayouts
 //  - reset all others to nullptr, in expectation of a ValidateNetwork() pass
-void ComputationNetwork::ResetMBLayouts()
+// The nodes not passed keep theirs from the previous validation.
+void ComputationNetwork::ResetMBLayouts(const list<ComputationNodeBasePtr>& nodes)
 {
     // reset to a well-defined MBLayout (any meaningful layout should do here)
     // Note that Validate is never called during operation. Any actual computation will lead to MBLayout to be set.
     m_pMBLayoutOfNetwork->Init(1, 0);
 
     // first reset all
-    for (const auto& node : GetAllNodesForRoot(nullptr))
+    for (const auto& node : nodes)
         node->LinkToMBLayout(nullptr);
+    const set<ComputationNodeBasePtr> nodeSet(nodes.begin(), nodes.end());
 
     // DynamicAxis nodes are (apart from the soon-to-be-deprecated network-wide MBLayout) the main holders of MBLayouts. Initialize them.
     // The only other instances are nodes that change the MBLayout, like WhereNode. 
     for (auto node : GetNodesWithType(L"DynamicAxis"))
-        node->LinkToMBLayout(make_shared<MBLayout>(1, 0, node->GetName()));
+    {
+        if (nodeSet.find(node) != nodeSet.end() || !node->HasMBLayout())
+            node->LinkToMBLayout(make_shared<MBLayout>(1, 0, node->GetName()));
+    }
 
     // This is now initialized inside of the Input nodes, with the proper connections.
     for (auto node : InputNodes(nullptr))
     {
+        if (nodeSet.find(node) == nodeSet.end())
+            continue;
         // TODO: use if (!Is<ITakesDynamicAxis>(node))...
         auto n = dynamic_pointer_cast<ITakesDynamicAxis>(node);
         if (!n)
@@ -623,22 +1283,83 @@ void ComputationNetwork::ResetMBLayouts()
 // validation
 // -----------------------------------------------------------------------
 
+// determine the nodes that need to be validated again after edits, in evaluation order:
+// the edited nodes, those added since the last validation, and all nodes that depend on any of them
+list<ComputationNodeBasePtr> ComputationNetwork::NodesAffectedByEdits() const
+{
+    const auto& allNodes = GetEvalOrder(nullptr);
+    set<ComputationNodeBasePtr> affected;
+    for (const auto& node : allNodes)
+    {
+        if (m_editedNodes.find(node) != m_editedNodes.end() || m_validatedNodes.find(node) == m_validatedNodes.end())
+            affected.insert(node);
+    }
+
+    // Inputs come before their consumers in the evaluation order, except for the delayed inputs in recurrent loops.
+    // Hence one pass finds the consumers, and another one per loop pulls in the rest of the loop.
+    for (size_t numAffected = 0; numAffected != affected.size();)
+    {
+        numAffected = affected.size();
+        for (const auto& node : allNodes)
+        {
+            if (affected.find(node) != affected.end())
+                continue;
+            for (const auto& input : node->GetInputs())
+            {
+                if (affected.find(input) != affected.end())
+                {
+                    affected.insert(node);
+                    break;
+                }
+            }
+        }
+    }
+
+    list<ComputationNodeBasePtr> nodes;
+    for (const auto& node : allNodes)
+    {
+        if (affected.find(node) != affected.end())
+            nodes.push_back(node);
+    }
+    return nodes;
+}
+
 // validate sub-network needed to evalute a specific output node
 // This calls Validate() on every node in evaluation order (allowing to propagate things forwards through the net).
 // This is called lazily but once only per node until next ClearCache().
 // MBLayout links are expected to have been set up already for inputs, and reset to nullptr for all other nodes.
-void ComputationNetwork::ValidateNetwork()
+// 'nodes' are the nodes to validate, in evaluation order; the others must have been validated before and remain unchanged.
+void ComputationNetwork::ValidateNetwork(const list<ComputationNodeBasePtr>& nodes)
 {
     // we call all nodes' Validate() in order to validate, that is, set up MBLayout and FunctionValues dimension
     // A problem is that recurrent loops may require partial validation.
     // Nodes validated on partial input (i.e. some children not yet validated) will be revisited.
-    const auto& nodes = GetEvalOrder(nullptr);
+    const auto& allNodes = GetEvalOrder(nullptr);
 
-    for (auto& node : nodes)
+    for (auto& node : allNodes)
     {
-        node->m_visited = false;
+        node->m_visited = true; // (the nodes not validated again count as visited)
         node->m_needsGradient = node->IsParameterUpdateRequired(); // these get propagated upwards in the following
     }
+    for (auto& node : nodes)
+        node->m_visited = false;
+
+    // m_needsGradient is propagated by ValidateNode(), which the nodes not validated again do not get, so propagate it for all upfront
+    if (nodes.size() != allNodes.size())
+    {
+        for (bool changed = true; changed;) // (repeats only for recurrent loops)
+        {
+            changed = false;
+            for (auto& node : allNodes)
+            {
+                for (auto& input : node->GetInputs())
+                {
+                    if (input->m_needsGradient && !node->m_needsGradient)
+                        node->m_needsGradient = changed = true;
+                }
+            }
+        }
+    }
 
     // loop and validate until we are done
     // steps:
@@ -922,25 +1643,86 @@ set<ComputationNodeBasePtr> ComputationNetwork::ExtractNodesWhichAccumulateResul
     return intersection;
 }
 
-// print memory-sharing information to log
-void ComputationNetwork::PrintMemorySharingStructure(const vector<ComputationNodeBasePtr>& nodes)
+void ComputationNetwork::PrintNodeProfile() const
 {
-    map <const MatrixBase*, set<wstring>> memSharingStructure;
-    size_t numMatrices = 0;
-    for (const auto& node : nodes)
+    auto nodeTimings = PerformanceCounters::Instance().TakeSnapshot().m_nodeTimings;
+    if (nodeTimings.empty())
+        return;
+
+    double peakFlops = 0, peakBytesPerSecond = 0;
+#ifndef CPUONLY
+    if (GetDeviceId() >= 0)
     {
-        set<pair<const MatrixBase*, wstring>> matrixInfo = node->GetMatrixInfo();
-        for (const auto& item : matrixInfo) // {value} or {value, gradient}
-        {
-            memSharingStructure[item.first].insert(item.second);
-            numMatrices++;
-        }
+        auto gpuData = GetGpuData(GetDeviceId());
+        peakFlops = gpuData.peakFlops;
+        peakBytesPerSecond = gpuData.peakBytesPerSecond;
     }
+#endif
+    bool hasPeak = peakFlops > 0 && peakBytesPerSecond > 0;
 
-    // count shared/unshared
-    size_t numShared = 0;
-    size_t numUnshared = 0;
-    for (const auto& item : memSharingStructure)
+    typedef pair<wstring, PerformanceCounters::NodeTiming> NodeEntry;
+    vector<NodeEntry> nodes(nodeTimings.begin(), nodeTimings.end());
+    auto timePerMinibatch = [](const PerformanceCounters::NodeTiming& timing)
+    {
+        return (timing.m_numForward ? timing.m_forwardSeconds / timing.m_numForward : 0) +
+               (timing.m_numBackward ? timing.m_backwardSeconds / timing.m_numBackward : 0);
+    };
+    sort(nodes.begin(), nodes.end(), [&](const NodeEntry& a, const NodeEntry& b) { return timePerMinibatch(a.second) > timePerMinibatch(b.second); });
+    double totalTime = 0;
+    for (const auto& node : nodes)
+        totalTime += timePerMinibatch(node.second);
+
+    if (hasPeak)
+        fprintf(stderr, "\nNode profile (device peak %.1f GFLOP/s, %.1f GB/s; bound: C = compute, M = memory):\n", peakFlops * 1e-9, peakBytesPerSecond * 1e-9);
+    else
+        fprintf(stderr, "\nNode profile (device peak unknown):\n");
+    fprintf(stderr, "%10s %6s %10s %9s %8s %10s %9s %8s  %s\n", "fwd ms", "%", "GFLOP/s", "GB/s", "peak", "bwd ms", "GFLOP/s", "peak", "node");
+    for (const auto& node : nodes)
+    {
+        const auto& timing = node.second;
+        fprintf(stderr, "%10.3f %6.1f", timing.m_numForward ? 1000 * timing.m_forwardSeconds / timing.m_numForward : 0, totalTime > 0 ? 100 * timePerMinibatch(timing) / totalTime : 0);
+
+        // achieved rates and the fraction of the peak of the bounding resource
+        auto printRoofline = [&](double seconds, double flops, double bytes, bool withBytesPerSecond)
+        {
+            double flopsPerSecond = seconds > 0 ? flops / seconds : 0;
+            double bytesPerSecond = seconds > 0 ? bytes / seconds : 0;
+            fprintf(stderr, " %10.1f", flopsPerSecond * 1e-9);
+            if (withBytesPerSecond)
+                fprintf(stderr, " %9.1f", bytesPerSecond * 1e-9);
+            if (!hasPeak || bytes == 0)
+                fprintf(stderr, " %8s", "-");
+            else if (flops / bytes > peakFlops / peakBytesPerSecond)
+                fprintf(stderr, " %6.1f%%C", 100 * flopsPerSecond / peakFlops);
+            else
+                fprintf(stderr, " %6.1f%%M", 100 * bytesPerSecond / peakBytesPerSecond);
+        };
+        printRoofline(timing.m_forwardSeconds, timing.m_forwardFlops, timing.m_forwardBytes, /*withBytesPerSecond=*/true);
+        fprintf(stderr, " %10.3f", timing.m_numBackward ? 1000 * timing.m_backwardSeconds / timing.m_numBackward : 0);
+        printRoofline(timing.m_backwardSeconds, timing.m_backwardFlops, timing.m_backwardBytes, /*withBytesPerSecond=*/false);
+        fprintf(stderr, "  %ls (%ls)\n", node.first.c_str(), NodeNameExists(node.first) ? GetNodeFromName(node.first)->OperationName().c_str() : L"?");
+    }
+}
+
+// print memory-sharing information to log
+void ComputationNetwork::PrintMemorySharingStructure(const vector<ComputationNodeBasePtr>& nodes)
+{
+    map <const MatrixBase*, set<wstring>> memSharingStructure;
+    size_t numMatrices = 0;
+    for (const auto& node : nodes)
+    {
+        set<pair<const MatrixBase*, wstring>> matrixInfo = node->GetMatrixInfo();
+        for (const auto& item : matrixInfo) // {value} or {value, gradient}
+        {
+            memSharingStructure[item.first].insert(item.second);
+            numMatrices++;
+        }
+    }
+
+    // count shared/unshared
+    size_t numShared = 0;
+    size_t numUnshared = 0;
+    for (const auto& item : memSharingStructure)
     {
         if (item.second.size() < 2) // only print actually shared matrices
             numUnshared++;
@@ -969,8 +1751,248 @@ void ComputationNetwork::PrintMemorySharingStructure(const vector<ComputationNod
         fprintf(stderr, " }\n");
     }
     fprintf(stderr, "\n");
+
+    // with a static plan, the values and gradients are not shared as whole matrices but placed into overlapping parts of an arena
+    if (m_matrixPool.HasStaticPlan() && m_matrixPool.GetPlannedMaxColumns() > 0)
+    {
+        const size_t plannedBytes = m_matrixPool.GetPlannedPeakBytes(), achievedBytes = m_matrixPool.GetArenaBytes();
+        fprintf(stderr, "Static memory plan for up to %d columns: peak of the node values and gradients %.1f MB, achieved by the arena layout %.1f MB (%.1f%% more).\n\n",
+                (int) m_matrixPool.GetPlannedMaxColumns(), plannedBytes / (1024.0 * 1024.0), achievedBytes / (1024.0 * 1024.0),
+                plannedBytes > 0 ? 100.0 * (achievedBytes - plannedBytes) / plannedBytes : 0.0);
+    }
+}
+
+// -----------------------------------------------------------------------
+// element-wise fusion
+// -----------------------------------------------------------------------
+
+// true if the node is a ComputationNode<ElemType> whose value is not sparse (not yet allocated counts as dense)
+template <class ElemType>
+static bool HasDenseValueOfType(const ComputationNodeBasePtr& node)
+{
+    auto n = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+    return n && (!n->ValuePtr() || n->Value().GetMatrixType() != SPARSE);
+}
+
+static bool HaveDenseValuesOfSameType(const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b)
+{
+    return (HasDenseValueOfType<float>(a) && HasDenseValueOfType<float>(b)) || (HasDenseValueOfType<double>(a) && HasDenseValueOfType<double>(b));
+}
+
+// Find groups of element-wise nodes whose values are consumed by nothing but another node of the group, e.g. Sigmoid(Plus(x, b)) .* y,
+// and let the consumer ('head') compute each group as a single fused tensor op (ForwardPropFused()).
+// The other nodes of a group get no value matrix, which saves their memory and the memory passes to write and re-read them.
+// Nodes whose values are needed otherwise are not fused: roots, nodes that need a gradient (when training), and nodes in loops.
+// This is done at matrix allocation rather than in CompileNetwork() (where network optimizations would otherwise go),
+// since only here it is known which roots are evaluated and whether there will be a backprop.
+// Only GPU nodes are fused: on the CPU, the vectorized kernels of the individual ops are faster than interpreting the fused program per element.
+void ComputationNetwork::FuseElementwiseOps(const std::vector<ComputationNodeBasePtr>& evalOrder,
+                                            const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                            bool performingBackPropagation)
+{
+    if (!Globals::ShouldFuseElementwiseOps())
+        return;
+
+    auto isFusable = [performingBackPropagation](const ComputationNodeBasePtr& node)
+    {
+        ElementWiseOperator op;
+        return node->GetElementwiseForwardOp(op) && node->GetNumInputs() <= FusedElementwiseOp::MaxInputs &&
+               !node->IsFusedIntoConsumer() && !node->GetElementwiseFusion() &&
+               node->GetDeviceId() >= 0 && !(performingBackPropagation && node->NeedsGradient());
+    };
+    // A group inside a recurrent loop is computed per time step by SEQTraversalFlowControlNode::ForwardProp(), hence all members
+    // must be in the head's loop. (Nodes that do not depend on the loop are outside of it and run over all time steps at once.)
+    auto loopOf = [this](const ComputationNodeBasePtr& node)
+    {
+        return node->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, node) : nullptr;
+    };
+    auto countLeaves = [](const std::set<ComputationNodeBasePtr>& group)
+    {
+        std::set<ComputationNodeBasePtr> leaves;
+        for (const auto& node : group)
+            for (const auto& input : node->GetInputs())
+                if (group.find(input) == group.end())
+                    leaves.insert(input);
+        return leaves.size();
+    };
+
+    size_t numGroups = 0, numFusedNodes = 0;
+    for (auto iter = evalOrder.rbegin(); iter != evalOrder.rend(); iter++) // consumers first, so that each group is as large as possible
+    {
+        const auto& head = *iter;
+        if (!isFusable(head) || !HaveDenseValuesOfSameType(head, head))
+            continue;
+
+        // grow the group from the head towards the inputs, as long as it fits into a FusedElementwiseOp
+        // Roots are never absorbed: they, like all nodes whose values must be kept, are not value-sharable.
+        auto headLoop = loopOf(head);
+        std::set<ComputationNodeBasePtr> group = { head };
+        std::list<ComputationNodeBasePtr> candidates(head->GetInputs().begin(), head->GetInputs().end());
+        while (!candidates.empty())
+        {
+            auto node = candidates.front();
+            candidates.pop_front();
+            auto parents = parentsMap.find(node);
+            if (group.find(node) != group.end() || !isFusable(node) || !node->IsValueSharable() ||
+                parents == parentsMap.end() || parents->second.size() != 1 || group.find(*parents->second.begin()) == group.end() ||
+                node->GetDeviceId() != head->GetDeviceId() || !HaveDenseValuesOfSameType(node, head) || loopOf(node) != headLoop)
+                continue;
+            group.insert(node);
+            if (group.size() > FusedElementwiseOp::MaxSteps || countLeaves(group) > FusedElementwiseOp::MaxInputs)
+            {
+                group.erase(node);
+                continue;
+            }
+            candidates.insert(candidates.end(), node->GetInputs().begin(), node->GetInputs().end());
+        }
+        if (group.size() < 2)
+            continue;
+
+        // emit the program, inputs before their consumers, so that the head is the last step
+        auto fusion = make_shared<ElementwiseFusion>();
+        auto& program = fusion->m_program;
+        program.numSteps = 0;
+        std::map<ComputationNodeBasePtr, unsigned char> operands;
+        std::function<unsigned char(const ComputationNodeBasePtr&)> emit = [&](const ComputationNodeBasePtr& node) -> unsigned char
+        {
+            auto found = operands.find(node);
+            if (found != operands.end())
+                return found->second;
+            unsigned char operand;
+            if (group.find(node) == group.end()) // a leaf
+            {
+                operand = (unsigned char) fusion->m_leaves.size();
+                fusion->m_leaves.push_back(node);
+            }
+            else
+            {
+                FusedElementwiseOp::Step step = {};
+                node->GetElementwiseForwardOp(step.op);
+                step.arity = (unsigned char) node->GetNumInputs();
+                for (size_t i = 0; i < node->GetNumInputs(); i++)
+                    step.args[i] = emit(node->Input(i));
+                operand = (unsigned char) (FusedElementwiseOp::MaxInputs + program.numSteps);
+                program.steps[program.numSteps++] = step;
+                fusion->m_members.push_back(node);
+            }
+            operands[node] = operand;
+            return operand;
+        };
+        emit(head);
+
+        if (!std::all_of(fusion->m_leaves.begin(), fusion->m_leaves.end(), [&head](const ComputationNodeBasePtr& leaf) { return HaveDenseValuesOfSameType(leaf, head); }))
+            continue;
+
+        head->m_elementwiseFusion = fusion;
+        for (const auto& node : group)
+        {
+            if (node != head)
+                node->m_fusedIntoConsumer = true;
+        }
+        numGroups++;
+        numFusedNodes += group.size();
+    }
+
+    if (TraceLevel() > 0 && numGroups > 0)
+        fprintf(stderr, "Element-wise fusion: %d nodes are computed by %d fused operations.\n", (int) numFusedNodes, (int) numGroups);
+}
+
+// -----------------------------------------------------------------------
+// value aliasing
+// -----------------------------------------------------------------------
+
+// Let nodes whose value is nothing but a copy of their input's value matrix (CanAliasInputValue(), e.g. Reshape) use the
+// input's matrix instead, which saves the copy and a matrix. The input's value is then kept until the consumers of the aliasing
+// node have run (see ReleaseValueAfterConsumer()), and until backprop if either of them is needed there.
+// Values that must be kept (roots, values induced by parameters only) are not sharable and never alias; nor do nodes in loops.
+// Only dense values are aliased, and only those with an MB layout, for which the matrix dimensions are determined by the layout.
+size_t ComputationNetwork::AliasInputValues(const std::vector<ComputationNodeBasePtr>& evalOrder,
+                                            std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp)
+{
+    if (!Globals::ShouldAliasInputValues())
+        return 0;
+
+    size_t numAliased = 0;
+    for (const auto& node : evalOrder)
+    {
+        if (!node->CanAliasInputValue() || !node->IsValueSharable() || node->IsPartOfLoop() || node->IsFusedIntoConsumer() || node->GetElementwiseFusion())
+            continue;
+        const auto& inputs = node->GetInputs();
+        const auto& input = inputs[0];
+        if (input->IsFusedIntoConsumer() || !input->HasMBLayout() || !node->HasMBLayout() ||
+            input->GetSampleLayout().GetNumElements() != node->GetSampleLayout().GetNumElements() ||
+            input->GetDeviceId() != node->GetDeviceId() || !HaveDenseValuesOfSameType(input, node) ||
+            std::count(inputs.begin(), inputs.end(), input) != 1) // (the input is held once, for the consumer of input 0)
+            continue;
+        node->m_valueAliasesInput = true;
+        numAliased++;
+    }
+
+    // consumers come after their inputs, hence backwards for chains of aliases
+    for (auto iter = evalOrder.rbegin(); iter != evalOrder.rend(); iter++)
+    {
+        if ((*iter)->AliasesInputValue())
+            outputValueNeededDuringBackProp[(*iter)->GetInputs()[0]] |= outputValueNeededDuringBackProp[*iter];
+    }
+    return numAliased;
 }
 
+// -----------------------------------------------------------------------
+// in-place computation
+// -----------------------------------------------------------------------
+
+// Let element-wise nodes (CanComputeInPlace(), e.g. Sigmoid, ReLU or Dropout) compute their value over the value matrix of their
+// input if nothing reads the input's value afterwards: the input has no other consumer, and neither it nor the node needs it in
+// backprop. The node then aliases the input's matrix as in AliasInputValues(). If the input is itself an alias, the same must
+// hold for every node along the chain of aliases, down to the node that owns the matrix.
+// If, in addition, the node overwrites the input's gradient (ParentOverwritesGradient()) and no other input needs a gradient,
+// the input's gradient is computed in place as well, over the node's gradient, which then serves as both.
+// Nodes with a value alias are handled by AliasInputValues() first, so that the chains are known here.
+size_t ComputationNetwork::ComputeInPlace(const std::vector<ComputationNodeBasePtr>& evalOrder,
+                                          const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                          std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp)
+{
+    if (!Globals::ShouldComputeInPlace())
+        return 0;
+
+    // whether the value of 'node' is read by its only consumer, and not kept beyond that
+    auto isReadOnce = [&](const ComputationNodeBasePtr& node)
+    {
+        auto parents = parentsMap.find(node);
+        return node->IsValueSharable() && !node->IsPartOfLoop() && !node->IsFusedIntoConsumer() &&
+               parents != parentsMap.end() && parents->second.size() == 1 && !outputValueNeededDuringBackProp[node];
+    };
+
+    size_t numInPlace = 0;
+    for (const auto& node : evalOrder)
+    {
+        if (!node->CanComputeInPlace() || node->AliasesInputValue() || !node->IsValueSharable() ||
+            node->IsPartOfLoop() || node->IsFusedIntoConsumer() || node->GetElementwiseFusion())
+            continue;
+        const auto& inputs = node->GetInputs();
+        const auto& input = inputs[0];
+        if (!input->HasMBLayout() || !node->HasMBLayout() ||
+            input->GetSampleLayout().GetNumElements() != node->GetSampleLayout().GetNumElements() ||
+            input->GetDeviceId() != node->GetDeviceId() || !HaveDenseValuesOfSameType(input, node) ||
+            std::count(inputs.begin(), inputs.end(), input) != 1)
+            continue;
+        bool canOverwrite = isReadOnce(input);
+        for (auto alias = input; canOverwrite && alias->AliasesInputValue(); alias = alias->GetInputs()[0])
+            canOverwrite = isReadOnce(alias->GetInputs()[0]);
+        if (!canOverwrite)
+            continue;
+
+        node->m_valueAliasesInput = true;
+        node->m_inputGradientInPlace = input->NeedsGradient() && input->ParentOverwritesGradient() &&
+                                       std::none_of(inputs.begin() + 1, inputs.end(), [](const ComputationNodeBasePtr& other) { return other->NeedsGradient(); });
+        numInPlace++;
+
+        // the matrix now holds the node's value, which backprop may need
+        for (auto alias = node; alias->AliasesInputValue(); alias = alias->GetInputs()[0])
+            outputValueNeededDuringBackProp[alias->GetInputs()[0]] |= outputValueNeededDuringBackProp[node];
+    }
+    return numInPlace;
+}
 
 // this function will need to be called before actual validation and execution to
 // predetermine how to share matrices to reduce memory usage.
@@ -978,10 +2000,13 @@ void ComputationNetwork::PrintMemorySharingStructure(const vector<ComputationNod
 // without passing in eval, out, and train nodes.
 void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes,
                                              const std::vector<ComputationNodeBasePtr>& outValueRootNodes,
-                                             ComputationNodeBasePtr trainRootNode)
+                                             ComputationNodeBasePtr trainRootNode,
+                                             bool forwardPropOnly)
 {
     if (AreMatricesAllocated())
         return;
+    if (forwardPropOnly && trainRootNode != nullptr)
+        LogicError("AllocateAllMatrices: A forward-prop-only allocation cannot have a training root node.");
 
     // Allocate memory for forward/backward computation
     if (TraceLevel() > 0)
@@ -1002,7 +2027,15 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     // Due to special topology, if a node is solely induced by parameters, its function value should not be shared
     MarkValueNonSharableNodes();
 
-    bool performingBackPropagation = (trainRootNode != nullptr) || (Globals::ShouldEnableHyperCompressMemory());
+    bool performingBackPropagation = !forwardPropOnly && ((trainRootNode != nullptr) || (Globals::ShouldEnableHyperCompressMemory()));
+
+    if (m_staticMemoryPlanMaxColumns > 0)
+    {
+        if (Globals::ShouldEnableHyperCompressMemory()) // (which frees values by resizing them, while arena memory is never freed)
+            fprintf(stderr, "WARNING: The static memory plan is not supported together with hyperCompressMemory and is disabled.\n");
+        else
+            m_matrixPool.EnableStaticPlan();
+    }
 
     // Create a composite Eval order with the specified nodes as roots
     // For each node determine parents and whether the output of the
@@ -1068,11 +2101,60 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    FuseElementwiseOps(compositeForwardPropEvalOrder, parentsMap, performingBackPropagation);
+
+    // gradient checkpointing: values that can be recomputed in backprop are not kept from forward prop
+    bool recomputeActivations = trainRootNode != nullptr && (m_recomputeActivations || Globals::ShouldRecomputeActivations());
+    if (recomputeActivations)
+    {
+        if (Globals::ShouldEnableHyperCompressMemory()) // (which resizes the values of inputs after forward prop, also during recomputation)
+            fprintf(stderr, "WARNING: Activation recomputation is not supported together with hyperCompressMemory and is disabled.\n");
+        else
+        {
+            size_t numRecomputedNodes = PlanActivationRecomputation(trainRootNode, parentsMap, outputValueNeededDuringBackProp);
+            if (TraceLevel() > 0)
+                fprintf(stderr, "Activation recomputation: the values of %d nodes are recomputed during backprop.\n", (int) numRecomputedNodes);
+        }
+    }
+
+    // activation offloading: values that backprop needs live in pinned host memory in between
+    shared_ptr<ActivationOffloader> offloader;
+    if (trainRootNode != nullptr && (m_offloadActivations || Globals::ShouldOffloadActivations()))
+    {
+        if (recomputeActivations)
+            fprintf(stderr, "WARNING: Activation offloading is not supported together with activation recomputation and is disabled.\n");
+        else if (Globals::ShouldEnableHyperCompressMemory())
+            fprintf(stderr, "WARNING: Activation offloading is not supported together with hyperCompressMemory and is disabled.\n");
+        else if (!GPUCopyStream::IsSupported(trainRootNode->GetDeviceId()))
+            fprintf(stderr, "WARNING: Activation offloading requires a GPU and is disabled.\n");
+        else
+        {
+            offloader = PlanActivationOffloading(trainRootNode, parentsMap, outputValueNeededDuringBackProp);
+            if (TraceLevel() > 0)
+                fprintf(stderr, "Activation offloading: the values of %d nodes are kept in host memory between forward prop and backprop.\n", offloader ? (int) offloader->GetNumValues() : 0);
+        }
+    }
+
+    // value aliasing and in-place computation; not together with the above, which restore values of their own for backprop,
+    // nor with hyperCompressMemory, which frees the values of inputs after forward prop
+    if (!recomputeActivations && !offloader && !Globals::ShouldEnableHyperCompressMemory())
+    {
+        size_t numAliased = AliasInputValues(compositeForwardPropEvalOrder, outputValueNeededDuringBackProp);
+        if (TraceLevel() > 0 && numAliased > 0)
+            fprintf(stderr, "Value aliasing: %d nodes use the value matrix of their input instead of a copy.\n", (int) numAliased);
+        size_t numInPlace = ComputeInPlace(compositeForwardPropEvalOrder, parentsMap, outputValueNeededDuringBackProp);
+        if (TraceLevel() > 0 && numInPlace > 0)
+            fprintf(stderr, "In-place computation: %d nodes compute their value over the value matrix of their input.\n", (int) numInPlace);
+    }
+
     set<ComputationNodeBasePtr> completedEvaluate;
-    for (auto& nodeIter : compositeForwardPropEvalOrder)
+    std::vector<ComputationNodeBasePtr> offloadedNodes, offloadsInFlight; // (see below)
+    for (size_t forwardIndex = 0; forwardIndex < compositeForwardPropEvalOrder.size(); forwardIndex++)
     {
-        nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter]);
+        auto& nodeIter = compositeForwardPropEvalOrder[forwardIndex];
+        nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter], forwardPropOnly);
 
+        ComputationNodeBasePtr computedNode; // node that runs at this point in forward prop, if any
         if (nodeIter->IsPartOfLoop())
         {
             // TODO: use FormNestedNetwork() here to avoid completedEvaluate[] check
@@ -1084,18 +2166,46 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
                 for (auto& nodeLoopIter : recInfo->m_nestedNodes)
                 {
-                    ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount);
+                    ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount, offloader.get(), &offloadedNodes);
                 }
+                computedNode = recInfo;
             }
         }
-        else
+        else if (nodeIter->GetElementwiseFusion())
+        {
+            // the inputs of the whole group are read by the head, and only the head has a value
+            nodeIter->RequestMatricesBeforeForwardProp(m_matrixPool);
+            for (auto& member : nodeIter->GetElementwiseFusion()->m_members)
+                ReleaseMatricesAfterEvalForChildren(member, parentCount, offloader.get(), &offloadedNodes);
+            computedNode = nodeIter;
+        }
+        else if (!nodeIter->IsFusedIntoConsumer()) // (fused nodes are handled with their head)
         {
             nodeIter->RequestMatricesBeforeForwardProp(m_matrixPool);
             // we only release matrices for the children since the root node's information will be used and should not be shared
             // with others
-            ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount);
+            ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount, offloader.get(), &offloadedNodes);
+            computedNode = nodeIter;
+        }
+
+        // The values that are offloaded after this node are released only after the next node, which thus runs
+        // concurrently with the copies, while nodes after that wait for them (see ActivationOffloader::BeforeForwardProp()).
+        if (offloader && computedNode)
+        {
+            offloader->SetForwardIndex(computedNode, forwardIndex);
+            for (auto& node : offloadsInFlight)
+            {
+                node->ReleaseMatricesAfterForwardProp(m_matrixPool);
+                offloader->SetReusableFrom(node, forwardIndex + 1);
+            }
+            for (auto& node : offloadedNodes)
+                offloader->SetLastConsumer(node, computedNode);
+            offloadsInFlight = move(offloadedNodes);
+            offloadedNodes.clear();
         }
     }
+    for (auto& node : offloadsInFlight)
+        node->ReleaseMatricesAfterForwardProp(m_matrixPool);
 
     if (trainRootNode != nullptr)
     {
@@ -1107,9 +2217,59 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         // we need to call it here since we always compute gradients for children and root node is not children of other node
         trainRootNode->RequestMatricesBeforeBackprop(m_matrixPool);
 
+        // with activation recomputation, the recomputed values of a segment live while backprop is in that segment
+        auto trainNetwork = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode));
+        std::unordered_map<ComputationNodeBasePtr, size_t> recomputationSegmentOf;
+        for (size_t i = 0; i < trainNetwork->m_recomputationSegments.size(); i++)
+        {
+            const auto& nestedNode = static_cast<FlowControlNode&>(*trainNetwork).m_nestedNodes[i];
+            recomputationSegmentOf[nestedNode] = trainNetwork->m_recomputationSegments[i];
+            if (auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(nestedNode))
+                for (const auto& node : loop->m_nestedNodes)
+                    recomputationSegmentOf[node] = trainNetwork->m_recomputationSegments[i];
+        }
+        const size_t noSegment = SIZE_MAX;
+        size_t activeSegment = noSegment;
+
+        // with activation offloading, values copied back from the host live from their prefetch point until the node's own backprop
+        std::unordered_map<ComputationNodeBasePtr, ComputationNodeBasePtr> nestedNodeOf;
+        std::unordered_map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> prefetchesBefore;
+        if (offloader)
+        {
+            for (const auto& nestedNode : static_cast<FlowControlNode&>(*trainNetwork).m_nestedNodes)
+            {
+                nestedNodeOf[nestedNode] = nestedNode;
+                if (auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(nestedNode))
+                    for (const auto& node : loop->m_nestedNodes)
+                        nestedNodeOf[node] = nestedNode;
+                prefetchesBefore[nestedNode] = offloader->GetPrefetchesBefore(nestedNode);
+            }
+        }
+
         for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++) // for gradient computation, traverse in reverse order
         {
             auto n = *iter;
+            auto nestedNode = nestedNodeOf.find(n);
+            if (nestedNode != nestedNodeOf.end())
+            {
+                auto prefetches = prefetchesBefore.find(nestedNode->second);
+                if (prefetches != prefetchesBefore.end()) // (first member of a loop)
+                {
+                    for (const auto& node : prefetches->second)
+                        node->RequestBackpropValueFromPool(m_matrixPool);
+                    prefetchesBefore.erase(prefetches);
+                }
+            }
+            auto segment = recomputationSegmentOf.find(n);
+            if (segment != recomputationSegmentOf.end() && segment->second != activeSegment)
+            {
+                if (activeSegment != noSegment)
+                    for (const auto& node : trainNetwork->m_recomputedNodes[activeSegment])
+                        node->ReleaseBackpropValueToPool(m_matrixPool);
+                activeSegment = segment->second;
+                for (const auto& node : trainNetwork->m_recomputedNodes[activeSegment])
+                    node->RequestBackpropValueFromPool(m_matrixPool);
+            }
             if (n->IsPartOfLoop())
             {
                 std::vector<ComputationNodeBasePtr> recurrentNodes;
@@ -1131,25 +2291,658 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
                 // Root node's information will be used and should not be shared with others, also it's small (1x1)
                 if ((n != trainRootNode) && n->NeedsGradient())
                     n->ReleaseMatricesAfterBackprop(m_matrixPool);
+                if (offloader && offloader->IsOffloaded(n))
+                    n->ReleaseBackpropValueToPool(m_matrixPool);
             }
         }
+        if (activeSegment != noSegment)
+            for (const auto& node : trainNetwork->m_recomputedNodes[activeSegment])
+                node->ReleaseBackpropValueToPool(m_matrixPool);
+    }
+
+    // all nested networks run the forward-prop part of offloading, since any of them may compute the last consumer of a value
+    for (auto& nestedNetwork : m_nestedNetworks)
+        if (auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(nestedNetwork.second))
+            network->m_activationOffloader = offloader;
+
+    if (m_matrixPool.HasStaticPlan())
+    {
+        m_matrixPool.PlanStaticMemory(m_staticMemoryPlanMaxColumns);
+        for (auto& nestedNetwork : m_nestedNetworks)
+            if (auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(nestedNetwork.second))
+                network->m_hasStaticMemoryPlan = true;
     }
 
     m_areMatricesAllocated = true;
 
     // print the memory sharing structure
     if (TraceLevel() > 0)
-    PrintMemorySharingStructure(GetAllNodes());
+    {
+        PrintMemorySharingStructure(GetAllNodes());
+
+        size_t numElementsPerColumn, numFixedElements;
+        m_matrixPool.GetPlannedNumElements<float>(numElementsPerColumn, numFixedElements);
+        size_t plannedBytesPerColumn = numElementsPerColumn * sizeof(float), plannedFixedBytes = numFixedElements * sizeof(float);
+        m_matrixPool.GetPlannedNumElements<double>(numElementsPerColumn, numFixedElements);
+        plannedBytesPerColumn += numElementsPerColumn * sizeof(double);
+        plannedFixedBytes += numFixedElements * sizeof(double);
+        fprintf(stderr, "Memory Sharing: %d pooled buffers, planned size %.1f KB per minibatch column + %.1f MB fixed.\n\n",
+                (int) (m_matrixPool.GetNumBuffers<float>() + m_matrixPool.GetNumBuffers<double>()),
+                plannedBytesPerColumn / 1024.0, plannedFixedBytes / (1024.0 * 1024.0));
+    }
+}
+
+// -----------------------------------------------------------------------
+// memory timeline
+// -----------------------------------------------------------------------
+
+void ComputationNetwork::BeginMemoryTimeline()
+{
+    if (!AreMatricesAllocated())
+        LogicError("BeginMemoryTimeline: The matrices must be allocated first.");
+
+    auto timeline = make_shared<MemoryTimeline>(GetAllNodes());
+    for (auto& nestedNetwork : m_nestedNetworks)
+        if (auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(nestedNetwork.second))
+            network->m_memoryTimeline = timeline;
+}
+
+shared_ptr<MemoryTimeline> ComputationNetwork::EndMemoryTimeline()
+{
+    shared_ptr<MemoryTimeline> timeline;
+    for (auto& nestedNetwork : m_nestedNetworks)
+    {
+        if (auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(nestedNetwork.second))
+        {
+            if (network->m_memoryTimeline)
+                timeline = network->m_memoryTimeline;
+            network->m_memoryTimeline = nullptr;
+        }
+    }
+    return timeline;
+}
+
+static size_t GetAllocatedBytes(const MatrixBase* matrix)
+{
+    if (auto floatMatrix = dynamic_cast<const Matrix<float>*>(matrix))
+        return floatMatrix->BufferSize();
+    if (auto doubleMatrix = dynamic_cast<const Matrix<double>*>(matrix))
+        return doubleMatrix->BufferSize();
+    return 0;
+}
+
+template <class ElemType>
+static bool TryGetGradientMatrix(const ComputationNodeBase* node, const MatrixBase*& gradient)
+{
+    auto typedNode = dynamic_cast<const ComputationNode<ElemType>*>(node);
+    if (!typedNode)
+        return false;
+    gradient = typedNode->GradientPtr().get();
+    return true;
+}
+
+static const MatrixBase* GetGradientMatrix(const ComputationNodeBase* node)
+{
+    const MatrixBase* gradient = nullptr;
+    TryGetGradientMatrix<float>(node, gradient) || TryGetGradientMatrix<double>(node, gradient);
+    return gradient;
+}
+
+MemoryTimeline::MemoryTimeline(const vector<ComputationNodeBasePtr>& nodes)
+    : m_nodes(nodes), m_peakAllocatedBytes(0), m_peakStep(0)
+{
+    for (const auto& buffer : CollectBuffers())
+        m_holders[buffer.m_matrix] = buffer.m_node;
+}
+
+vector<MemoryTimeline::Buffer> MemoryTimeline::CollectBuffers() const
+{
+    vector<Buffer> buffers;
+    unordered_set<const MatrixBase*> seen;
+    auto add = [&](const MatrixBase* matrix, ComputationNodeBase* node, bool isWorkspace)
+    {
+        if (matrix && seen.insert(matrix).second)
+            buffers.push_back(Buffer{ matrix, node, isWorkspace });
+    };
+    for (const auto& node : m_nodes)
+    {
+        add(node->ValuePtr().get(), node.get(), false);
+        add(GetGradientMatrix(node.get()), node.get(), false);
+        for (const auto& workspace : node->GetWorkspaceMatrices())
+            add(workspace, node.get(), true);
+    }
+    return buffers;
+}
+
+void MemoryTimeline::Record(const ComputationNodeBasePtr& node, bool isBackward)
+{
+    auto loop = dynamic_pointer_cast<FlowControlNode>(node);
+    if (!loop)
+        RecordNode(node, isBackward);
+    else if (!isBackward)
+        for (const auto& nestedNode : loop->m_nestedNodes)
+            RecordNode(nestedNode, isBackward);
+    else
+        for (auto nestedNode = loop->m_nestedNodes.rbegin(); nestedNode != loop->m_nestedNodes.rend(); nestedNode++)
+            RecordNode(*nestedNode, isBackward);
+}
+
+void MemoryTimeline::RecordNode(const ComputationNodeBasePtr& node, bool isBackward)
+{
+    // the buffers this node has written
+    if (!isBackward)
+    {
+        if (node->ValuePtr())
+            m_holders[node->ValuePtr().get()] = node.get();
+    }
+    else
+    {
+        for (const auto& input : node->GetInputs())
+            if (input->NeedsGradient() && GetGradientMatrix(input.get()))
+                m_holders[GetGradientMatrix(input.get())] = input.get();
+    }
+    auto workspaces = node->GetWorkspaceMatrices();
+    for (const auto& workspace : workspaces)
+        m_holders[workspace] = node.get();
+
+    // take stock of all buffers
+    size_t allocatedBytes = 0;
+    unordered_map<ComputationNodeBase*, size_t> heldBytes;
+    for (const auto& buffer : CollectBuffers())
+    {
+        size_t bytes = GetAllocatedBytes(buffer.m_matrix);
+        allocatedBytes += bytes;
+        auto holder = m_holders.find(buffer.m_matrix);
+        heldBytes[holder != m_holders.end() ? holder->second : buffer.m_node] += bytes;
+    }
+
+    Event event;
+    event.m_step = m_events.size();
+    event.m_isBackward = isBackward;
+    event.m_nodeName = node->NodeName();
+    event.m_operationName = node->OperationName();
+    event.m_valueBytes = node->ValuePtr() ? GetAllocatedBytes(node->ValuePtr().get()) : 0;
+    event.m_gradientBytes = GetGradientMatrix(node.get()) ? GetAllocatedBytes(GetGradientMatrix(node.get())) : 0;
+    event.m_workspaceBytes = 0;
+    for (const auto& workspace : workspaces)
+        event.m_workspaceBytes += GetAllocatedBytes(workspace);
+    event.m_heldBytes = heldBytes[node.get()];
+    event.m_allocatedBytes = allocatedBytes;
+    m_events.push_back(event);
+
+    if (m_events.size() == 1 || allocatedBytes > m_peakAllocatedBytes)
+    {
+        m_peakAllocatedBytes = allocatedBytes;
+        m_peakStep = event.m_step;
+        m_peakHolders.clear();
+        for (const auto& holder : heldBytes)
+            if (holder.second > 0)
+                m_peakHolders.push_back(make_pair(holder.first->NodeName(), holder.second));
+        sort(m_peakHolders.begin(), m_peakHolders.end(), [](const pair<wstring, size_t>& a, const pair<wstring, size_t>& b) { return a.second > b.second; });
+    }
+}
+
+void MemoryTimeline::Save(const wstring& path) const
+{
+    FILE* f = fopenOrDie(path, L"w");
+    fprintf(f, "step,phase,node,operation,valueBytes,gradientBytes,workspaceBytes,heldBytes,allocatedBytes\n");
+    for (const auto& event : m_events)
+        fprintf(f, "%d,%s,\"%ls\",%ls,%llu,%llu,%llu,%llu,%llu\n", (int) event.m_step, event.m_isBackward ? "backward" : "forward",
+                event.m_nodeName.c_str(), event.m_operationName.c_str(), (unsigned long long) event.m_valueBytes, (unsigned long long) event.m_gradientBytes,
+                (unsigned long long) event.m_workspaceBytes, (unsigned long long) event.m_heldBytes, (unsigned long long) event.m_allocatedBytes);
+    fcloseOrDie(f);
+}
+
+void MemoryTimeline::PrintReport(size_t topN) const
+{
+    if (m_events.empty())
+        return;
+
+    const double MB = 1024.0 * 1024.0;
+    const auto& peak = m_events[m_peakStep];
+    fprintf(stderr, "\nMemory timeline: peak of %.1f MB after %s of %ls (%ls), step %d of %d.\n", m_peakAllocatedBytes / MB,
+            peak.m_isBackward ? "backward" : "forward", peak.m_nodeName.c_str(), peak.m_operationName.c_str(), (int) m_peakStep + 1, (int) m_events.size());
+    fprintf(stderr, "Nodes holding the most memory at the peak:\n");
+    for (size_t i = 0; i < m_peakHolders.size() && i < topN; i++)
+        fprintf(stderr, "%10.1f MB %6.1f%%  %ls\n", m_peakHolders[i].second / MB, 100.0 * m_peakHolders[i].second / max(m_peakAllocatedBytes, (size_t) 1),
+                m_peakHolders[i].first.c_str());
+
+    map<wstring, size_t> workspaceBytes;
+    for (const auto& event : m_events)
+        if (event.m_workspaceBytes > 0)
+            workspaceBytes[event.m_nodeName] = max(workspaceBytes[event.m_nodeName], event.m_workspaceBytes);
+    if (workspaceBytes.empty())
+        return;
+    vector<pair<wstring, size_t>> largestWorkspaces(workspaceBytes.begin(), workspaceBytes.end());
+    sort(largestWorkspaces.begin(), largestWorkspaces.end(), [](const pair<wstring, size_t>& a, const pair<wstring, size_t>& b) { return a.second > b.second; });
+    fprintf(stderr, "Largest workspaces:\n");
+    for (size_t i = 0; i < largestWorkspaces.size() && i < topN; i++)
+        fprintf(stderr, "%10.1f MB  %ls\n", largestWorkspaces[i].second / MB, largestWorkspaces[i].first.c_str());
+}
+
+void ComputationNetwork::EnableActivationRecomputation(const std::vector<std::wstring>& checkpointNodeNames)
+{
+    if (AreMatricesAllocated())
+        LogicError("EnableActivationRecomputation: Must be called before the matrices are allocated.");
+    m_recomputeActivations = true;
+    m_recomputationCheckpointNames = checkpointNodeNames;
+}
+
+// activation recomputation (gradient checkpointing), see EnableActivationRecomputation()
+// Splits the backprop order of the criterion into segments, and selects the nodes whose values are needed in backprop only
+// within their own segment. These values are released after forward prop like any value that backprop does not need, and
+// recomputed from the inputs, which are kept instead, when backprop enters the segment (see PARTraversalFlowControlNode::Backprop()).
+// Nodes in loops, nodes that draw random numbers or update state in ForwardProp(), and fused nodes are always kept.
+// Returns the number of nodes whose values are recomputed.
+size_t ComputationNetwork::PlanActivationRecomputation(const ComputationNodeBasePtr& trainRootNode,
+                                                       const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                                       std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp)
+{
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode));
+    const auto& nestedNodes = static_cast<FlowControlNode&>(*network).m_nestedNodes;
+
+    // segments end at the checkpoint nodes, or at every sqrt(N)-th node
+    std::set<ComputationNodeBasePtr> checkpoints;
+    if (!m_recomputationCheckpointNames.empty())
+    {
+        for (const auto& name : m_recomputationCheckpointNames)
+        {
+            auto node = GetNodeFromName(name);
+            if (find(nestedNodes.begin(), nestedNodes.end(), node) == nestedNodes.end())
+                InvalidArgument("EnableActivationRecomputation: Checkpoint node '%ls' is not a non-recurrent node of the criterion '%ls'.", name.c_str(), trainRootNode->NodeName().c_str());
+            checkpoints.insert(node);
+        }
+    }
+    else
+    {
+        size_t segmentLength = (size_t) ceil(sqrt((double) nestedNodes.size()));
+        for (size_t i = segmentLength - 1; i < nestedNodes.size(); i += segmentLength)
+            checkpoints.insert(nestedNodes[i]);
+    }
+    std::vector<size_t> segments(nestedNodes.size());
+    std::unordered_map<ComputationNodeBasePtr, size_t> segmentOf; // (including the nodes inside loops)
+    size_t segment = 0;
+    for (size_t i = 0; i < nestedNodes.size(); i++)
+    {
+        segments[i] = segment;
+        segmentOf[nestedNodes[i]] = segment;
+        if (auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(nestedNodes[i]))
+            for (const auto& node : loop->m_nestedNodes)
+                segmentOf[node] = segment;
+        if (checkpoints.find(nestedNodes[i]) != checkpoints.end())
+            segment++;
+    }
+
+    // a value is recomputed if backprop needs it, and all consumers are in its segment (or do not take part in backprop)
+    auto isRecomputable = [&](const ComputationNodeBasePtr& node)
+    {
+        auto needed = outputValueNeededDuringBackProp.find(node);
+        return needed != outputValueNeededDuringBackProp.end() && needed->second && checkpoints.find(node) == checkpoints.end() &&
+               !dynamic_pointer_cast<FlowControlNode>(node) && node->GetNumInputs() > 0 && !node->RequiresPreCompute() &&
+               node->IsValueSharable() && !node->IsFusedIntoConsumer() && !node->GetElementwiseFusion() &&
+               node->ForwardPropIsRepeatable() && !dynamic_pointer_cast<IRngUser>(node);
+    };
+    std::vector<std::vector<ComputationNodeBasePtr>> recomputedNodes(segments.empty() ? 0 : segments.back() + 1);
+    std::set<ComputationNodeBasePtr> recomputed;
+    for (size_t i = 0; i < nestedNodes.size(); i++)
+    {
+        const auto& node = nestedNodes[i];
+        if (!isRecomputable(node))
+            continue;
+        bool consumersInSegment = true;
+        auto parents = parentsMap.find(node);
+        if (parents != parentsMap.end())
+        {
+            for (const auto& parent : parents->second)
+            {
+                auto parentSegment = segmentOf.find(parent);
+                if (parentSegment != segmentOf.end() && parentSegment->second != segments[i])
+                    consumersInSegment = false;
+            }
+        }
+        if (consumersInSegment)
+        {
+            recomputedNodes[segments[i]].push_back(node);
+            recomputed.insert(node);
+        }
+    }
+
+    // the recomputation reads the inputs, so these must be kept instead
+    for (const auto& node : recomputed)
+    {
+        node->MarkValueRestoredForBackprop();
+        outputValueNeededDuringBackProp[node] = false;
+        for (const auto& input : node->GetInputs())
+        {
+            if (recomputed.find(input) == recomputed.end())
+                outputValueNeededDuringBackProp[input] = true;
+        }
+    }
+
+    network->m_recomputationSegments = move(segments);
+    network->m_recomputedNodes = move(recomputedNodes);
+    return recomputed.size();
 }
 
-void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount)
+// Values that are offloaded to the host are not released here but returned in 'offloadedNodes', since their copies start only now.
+void ComputationNetwork::EnableActivationOffloading()
+{
+    if (AreMatricesAllocated())
+        LogicError("EnableActivationOffloading: Must be called before the matrices are allocated.");
+    m_offloadActivations = true;
+}
+
+void ComputationNetwork::EnableStaticMemoryPlan(size_t maxColumns)
+{
+    if (AreMatricesAllocated())
+        LogicError("EnableStaticMemoryPlan: Must be called before the matrices are allocated.");
+    if (maxColumns == 0)
+        InvalidArgument("EnableStaticMemoryPlan: The maximum number of minibatch columns must not be 0.");
+    m_staticMemoryPlanMaxColumns = maxColumns;
+}
+
+// activation offloading, see EnableActivationOffloading()
+// Selects the values that backprop needs, of non-recurrent nodes of the criterion that scale with the minibatch, and determines
+// where in backprop they are copied back. These values are released after forward prop like any value that backprop does not
+// need (the copies are ordered in AllocateAllMatrices()). Values used again within the last few nodes are kept.
+// Returns null if there is nothing to offload.
+shared_ptr<ActivationOffloader> ComputationNetwork::PlanActivationOffloading(const ComputationNodeBasePtr& trainRootNode,
+                                                                             const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                                                             std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp)
+{
+    const size_t prefetchDistance = 2; // copies back start this many nodes ahead of the first use in backprop
+
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode));
+    const auto& nestedNodes = static_cast<FlowControlNode&>(*network).m_nestedNodes;
+    std::unordered_map<ComputationNodeBasePtr, size_t> nestedIndexOf; // (including the nodes inside loops)
+    for (size_t i = 0; i < nestedNodes.size(); i++)
+    {
+        nestedIndexOf[nestedNodes[i]] = i;
+        if (auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(nestedNodes[i]))
+            for (const auto& node : loop->m_nestedNodes)
+                nestedIndexOf[node] = i;
+    }
+
+    auto isOffloadable = [&](const ComputationNodeBasePtr& node)
+    {
+        auto needed = outputValueNeededDuringBackProp.find(node);
+        return needed != outputValueNeededDuringBackProp.end() && needed->second && !dynamic_pointer_cast<FlowControlNode>(node) &&
+               node->GetNumInputs() > 0 && !node->RequiresPreCompute() && node->IsValueSharable() && !node->IsFusedIntoConsumer() &&
+               node->HasMBLayout();
+    };
+    auto offloader = make_shared<ActivationOffloader>(trainRootNode->GetDeviceId());
+    for (size_t i = 0; i < nestedNodes.size(); i++)
+    {
+        const auto& node = nestedNodes[i];
+        if (!isOffloadable(node))
+            continue;
+        // backprop first uses the value at the last consumer in the criterion (or at the node itself)
+        size_t firstUse = i;
+        auto parents = parentsMap.find(node);
+        if (parents != parentsMap.end())
+        {
+            for (const auto& parent : parents->second)
+            {
+                auto parentIndex = nestedIndexOf.find(parent);
+                if (parentIndex != nestedIndexOf.end())
+                    firstUse = max(firstUse, parentIndex->second);
+            }
+        }
+        if (firstUse + prefetchDistance >= nestedNodes.size() - 1)
+            continue;
+        offloader->AddValue(node, nestedNodes[firstUse + prefetchDistance], nestedNodes[firstUse]);
+        node->MarkValueRestoredForBackprop();
+        outputValueNeededDuringBackProp[node] = false;
+    }
+    return offloader->GetNumValues() > 0 ? offloader : nullptr;
+}
+
+// -----------------------------------------------------------------------
+// pipeline parallelism
+// -----------------------------------------------------------------------
+
+// Forms the stages of FormPipelineStages(): the non-leaf nested nodes of the criterion, cut wherever the device changes.
+// A stage restores instead of recomputing the CrossDeviceCopy nodes in it (rather than copying again), and the values it
+// reads from other stages, which are overwritten by then; both are kept for each micro-batch after its forward prop.
+size_t ComputationNetwork::FormPipelineStages(const ComputationNodeBasePtr& rootNode)
+{
+    VerifyIsCompiled("FormPipelineStages");
+    if (!AreMatricesAllocated())
+        LogicError("FormPipelineStages: Must be called after the matrices are allocated.");
+    if (m_recomputeActivations || m_offloadActivations || m_staticMemoryPlanMaxColumns > 0 ||
+        Globals::ShouldEnableShareNodeValueMatrices() || Globals::ShouldEnableHyperCompressMemory())
+        InvalidArgument("FormPipelineStages: Pipeline parallelism keeps the values of the stages from forward prop to backprop. "
+                        "It cannot be combined with activation recomputation or offloading, a static memory plan, or shareNodeValueMatrices.");
+
+    m_pipelineRootNode = rootNode;
+    m_pipelineStages.clear();
+    m_pipelineStash.clear();
+    m_pipelineRngOffsets.clear();
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    std::map<ComputationNodeBasePtr, size_t> stageOf; // (including the nodes inside loops)
+    for (const auto& node : static_cast<FlowControlNode&>(*network).m_nestedNodes)
+    {
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+        if (!loop && node->IsLeaf())
+            continue;
+        auto deviceId = loop ? loop->m_nestedNodes.front()->GetDeviceId() : node->GetDeviceId();
+        if (m_pipelineStages.empty() || m_pipelineStages.back().deviceId != deviceId)
+            m_pipelineStages.push_back(PipelineStage{ deviceId, {}, {}, {}, SIZE_MAX });
+        m_pipelineStages.back().nodes.push_back(node);
+        stageOf[node] = m_pipelineStages.size() - 1;
+        if (loop)
+            for (const auto& loopNode : loop->m_nestedNodes)
+                stageOf[loopNode] = m_pipelineStages.size() - 1;
+    }
+
+    for (size_t s = 0; s < m_pipelineStages.size(); s++)
+    {
+        auto& stage = m_pipelineStages[s];
+        auto stash = [&](const ComputationNodeBasePtr& node)
+        {
+            if (find(stage.stashedNodes.begin(), stage.stashedNodes.end(), node) == stage.stashedNodes.end())
+                stage.stashedNodes.push_back(node);
+            m_pipelineStash[node];
+        };
+        std::vector<ComputationNodeBasePtr> stageNodes; // (with the nodes inside loops instead of the loops)
+        for (const auto& node : stage.nodes)
+        {
+            if (auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node))
+                stageNodes.insert(stageNodes.end(), loop->m_nestedNodes.begin(), loop->m_nestedNodes.end());
+            else
+                stageNodes.push_back(node);
+        }
+        for (const auto& node : stageNodes)
+        {
+            if (node->OperationName() == OperationNameOf(CrossDeviceCopyNode) && !node->IsPartOfLoop())
+            {
+                stash(node);
+                continue;
+            }
+            if (!node->ForwardPropIsRepeatable())
+                InvalidArgument("FormPipelineStages: %ls %ls operation cannot be computed again for a micro-batch, which pipeline parallelism requires.",
+                                node->NodeName().c_str(), node->OperationName().c_str());
+            if (dynamic_pointer_cast<IRngUser>(node))
+            {
+                if (node->OperationName() != OperationNameOf(DropoutNode))
+                    InvalidArgument("FormPipelineStages: %ls %ls operation cannot draw the same random numbers again for a micro-batch, which pipeline parallelism requires.",
+                                    node->NodeName().c_str(), node->OperationName().c_str());
+                stage.rngUsers.push_back(node);
+                m_pipelineRngOffsets[node];
+            }
+            for (const auto& input : node->GetInputs())
+            {
+                auto inputStage = stageOf.find(input);
+                if (inputStage != stageOf.end() && inputStage->second != s && !input->RequiresPreCompute())
+                    stash(input);
+            }
+        }
+    }
+    return m_pipelineStages.size();
+}
+
+// copy the value of a node into a stash matrix on its device (created when first used), or back
+// Returns false if the node is not a ComputationNode<ElemType>.
+template <class ElemType>
+static bool StashValue(const ComputationNodeBasePtr& nodep, MatrixBasePtr& stash, bool restore)
+{
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
+    if (!node)
+        return false;
+    if (restore)
+        node->Value().SetValue(*static_pointer_cast<Matrix<ElemType>>(stash));
+    else
+    {
+        if (!stash)
+            stash = make_shared<Matrix<ElemType>>(node->Value().GetDeviceId());
+        static_pointer_cast<Matrix<ElemType>>(stash)->SetValue(node->Value());
+    }
+    return true;
+}
+
+// forward prop of the nodes of a pipeline stage that are out of date, except 'restoredNodes' (cf. PARTraversalFlowControlNode::ForwardProp())
+static void ForwardPropPipelineStage(const std::vector<ComputationNodeBasePtr>& nodes, const std::vector<ComputationNodeBasePtr>& restoredNodes)
+{
+    for (const auto& node : nodes)
+    {
+        if (!node->IsOutOfDateWrtInputs() || find(restoredNodes.begin(), restoredNodes.end(), node) != restoredNodes.end())
+            continue;
+        if (!node->IsFusedIntoConsumer()) // (computed by its consumer, see FuseElementwiseOps())
+        {
+            node->BeginForwardProp();
+            if (node->GetElementwiseFusion())
+                node->ForwardPropFused(FrameRange(nullptr).WithLayout(node->GetMBLayout()));
+            else
+                node->ForwardProp(FrameRange(nullptr).WithLayout(node->GetMBLayout()));
+            node->EndForwardProp();
+        }
+        node->BumpEvalTimeStamp();
+    }
+}
+
+void ComputationNetwork::ForwardPropPipelined(size_t microBatch, const std::vector<ComputationNodeBasePtr>& evalNodes)
+{
+    if (m_pipelineStages.empty())
+        LogicError("ForwardPropPipelined: FormPipelineStages() must be called first.");
+
+    // a micro-batch draws its random numbers from where it starts now, in forward prop as when recomputed in backprop
+    for (auto& iter : m_pipelineRngOffsets)
+    {
+        auto rngUser = dynamic_pointer_cast<RngUser>(iter.first);
+        if (iter.second.size() <= microBatch)
+            iter.second.resize(microBatch + 1);
+        iter.second[microBatch] = rngUser->GetRngOffset();
+        rngUser->SetRngState(rngUser->GetRngSeed(), iter.second[microBatch]);
+    }
+
+    // The host does not wait for the devices, so the stages overlap: a stage starts on this micro-batch while the next
+    // ones are still working on the previous one.
+    for (const auto& evalNode : evalNodes)
+        ForwardProp(evalNode);
+    for (auto& stage : m_pipelineStages)
+    {
+        ForwardPropPipelineStage(stage.nodes, {});
+        stage.microBatch = microBatch;
+    }
+
+    // keep what the stages need to recompute this micro-batch in backprop
+    for (auto& iter : m_pipelineStash)
+    {
+        const auto& node = iter.first;
+        if (iter.second.size() <= microBatch)
+            iter.second.resize(microBatch + 1);
+        auto& stash = iter.second[microBatch];
+        if (!StashValue<float>(node, stash.first, /*restore=*/false) && !StashValue<double>(node, stash.first, /*restore=*/false))
+            LogicError("ForwardPropPipelined: %ls %ls operation is neither ComputationNode<float> nor ComputationNode<double>.", node->NodeName().c_str(), node->OperationName().c_str());
+        if (node->HasMBLayout() && node->GetMBLayout() != m_pMBLayoutOfNetwork)
+        {
+            if (!stash.second)
+                stash.second = make_shared<MBLayout>();
+            stash.second->CopyFrom(node->GetMBLayout());
+        }
+    }
+}
+
+void ComputationNetwork::BackpropPipelined(size_t microBatch, double rootGradient)
+{
+    if (!Environment().IsTraining())
+        LogicError("BackpropPipelined: Requires network is to be in training mode.");
+    if (m_pipelineStages.empty())
+        LogicError("BackpropPipelined: FormPipelineStages() must be called first.");
+
+    if (!SetRootGradientToScalar<float>(m_pipelineRootNode, rootGradient) && !SetRootGradientToScalar<double>(m_pipelineRootNode, rootGradient))
+        LogicError("BackpropPipelined: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
+    ZeroInputGradients(m_pipelineRootNode);
+
+    for (auto stage = m_pipelineStages.rbegin(); stage != m_pipelineStages.rend(); stage++)
+    {
+        // recompute the values of the micro-batch, unless the stage still holds them
+        if (stage->microBatch != microBatch)
+        {
+            for (const auto& node : stage->stashedNodes)
+            {
+                const auto& stashes = m_pipelineStash[node];
+                if (stashes.size() <= microBatch || !stashes[microBatch].first)
+                    LogicError("BackpropPipelined: Micro-batch %d was not propagated forward.", (int) microBatch);
+                auto stash = stashes[microBatch];
+                if (!StashValue<float>(node, stash.first, /*restore=*/true))
+                    StashValue<double>(node, stash.first, /*restore=*/true);
+                if (stash.second)
+                    node->GetMBLayout()->CopyFrom(stash.second);
+                node->BumpEvalTimeStamp();
+            }
+            std::vector<uint64_t> rngOffsets; // (continued from after the recomputation)
+            for (const auto& node : stage->rngUsers)
+            {
+                auto rngUser = dynamic_pointer_cast<RngUser>(node);
+                rngOffsets.push_back(rngUser->GetRngOffset());
+                rngUser->SetRngState(rngUser->GetRngSeed(), m_pipelineRngOffsets[node][microBatch]);
+            }
+            ForwardPropPipelineStage(stage->nodes, stage->stashedNodes);
+            for (size_t i = 0; i < stage->rngUsers.size(); i++)
+            {
+                auto rngUser = dynamic_pointer_cast<RngUser>(stage->rngUsers[i]);
+                rngUser->SetRngState(rngUser->GetRngSeed(), rngOffsets[i]);
+            }
+            stage->microBatch = microBatch;
+        }
+
+        // the gradients of the inputs from earlier stages are complete once all later stages are done
+        for (auto pnode = stage->nodes.rbegin(); pnode != stage->nodes.rend(); pnode++)
+        {
+            auto& node = *pnode;
+            node->BeginBackprop();
+            node->Backprop(FrameRange(nullptr).WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+            node->EndBackprop();
+        }
+    }
+}
+
+void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount,
+                                                             const ActivationOffloader* offloader, std::vector<ComputationNodeBasePtr>* offloadedNodes)
 {
     for (int i = 0; i < n->GetNumInputs(); i++)
     {
-        ComputationNodeBasePtr pNode = n->GetInputs()[i];
-        parentCount[pNode]--;
-        if (parentCount[pNode] == 0)
+        if (i == 0 && n->AliasesInputValue()) // (held until the consumers of 'n' have run)
+            continue;
+        ReleaseValueAfterConsumer(n->GetInputs()[i], parentCount, offloader, offloadedNodes);
+    }
+}
+
+// One consumer of 'pNode' has run; after the last one, its matrices are released. A node that aliases its input's value
+// holds the input until then (see AliasInputValues()).
+void ComputationNetwork::ReleaseValueAfterConsumer(const ComputationNodeBasePtr& pNode, std::unordered_map<ComputationNodeBasePtr, int>& parentCount,
+                                                   const ActivationOffloader* offloader, std::vector<ComputationNodeBasePtr>* offloadedNodes)
+{
+    parentCount[pNode]--;
+    if (parentCount[pNode] == 0 && !pNode->IsFusedIntoConsumer())
+    {
+        if (offloader && offloader->IsOffloaded(pNode))
+            offloadedNodes->push_back(pNode);
+        else
             pNode->ReleaseMatricesAfterForwardProp(m_matrixPool);
+        if (pNode->AliasesInputValue())
+            ReleaseValueAfterConsumer(pNode->GetInputs()[0], parentCount, offloader, offloadedNodes);
     }
 }
 
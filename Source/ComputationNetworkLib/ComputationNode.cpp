@@ -9,6 +9,8 @@
 #include "InputAndParamNodes.h"
 #include "ComputationNetworkBuilder.h" // TODO: We should only pull in NewComputationNodeFromConfig(). Nodes should not know about network at large.
 #include "TensorShape.h"
+#include <atomic>
+#include <cstdarg>
 
 #ifndef let
 #define let const auto
@@ -502,6 +504,30 @@ template <class ElemType>
     }
 }
 
+// append printf-formatted text to a string, for FormatMinibatch() below
+static void AppendFormatted(string& out, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    char buffer[256];
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (n < 0)
+        RuntimeError("AppendFormatted: Invalid format string '%s'.", format);
+    if ((size_t)n < sizeof(buffer))
+    {
+        out.append(buffer, n);
+        return;
+    }
+    // longer than the buffer (e.g. a long label string): format again into the string itself
+    size_t size = out.size();
+    out.resize(size + n + 1);
+    va_start(args, format);
+    vsnprintf(&out[size], n + 1, format, args);
+    va_end(args);
+    out.resize(size + n);
+}
+
 // write out the content of a node in formatted/readable form
 // 'transpose' means print one row per sample (non-transposed is one column per sample).
 // 'isSparse' will print all non-zero values as one row (non-transposed, which makes sense for one-hot) or column (transposed).
@@ -514,28 +540,45 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
                                                              string valueFormatString,
                                                              bool outputGradient) const
 {
-    // get minibatch matrix -> matData, matRows, matStride
+    // get minibatch matrix -> matData, matRows
     const Matrix<ElemType>& outputValues = outputGradient ? Gradient() : Value();
-    let matRows   = outputValues.GetNumRows();
-    let matStride = matRows; // how to get from one column to the next
     unique_ptr<ElemType[]> matDataPtr(outputValues.CopyToArray());
-    ElemType* matData = matDataPtr.get();
-    let sampleLayout = GetSampleLayout(); // this is currently only used for sparse; dense tensors are linearized
+
+    string text;
+    FormatMinibatch(text, matDataPtr.get(), outputValues.GetNumRows(), outputValues.GetNumCols(), GetMBLayout(), GetSampleLayout(), fr,
+                    onlyUpToRow, onlyUpToT, transpose, isCategoryLabel, isSparse, labelMapping, sequenceSeparator,
+                    sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator, valueFormatString);
+    if (!text.empty())
+        fwriteOrDie(text.data(), sizeof(char), text.size(), f);
+    fflushOrDie(f);
+}
+
+// the formatting of WriteMinibatchWithFormatting(), from a copy of the minibatch on the CPU into 'out' (appended)
+// This does not touch the node, so that SimpleOutputWriter can format on other threads while the network goes on.
+// 'matData' is [matRows x matCols] in column-major order; with 'isCategoryLabel' it is modified in place.
+template <class ElemType>
+/*static*/ void ComputationNode<ElemType>::FormatMinibatch(string& out, ElemType* matData, size_t matRows, size_t matCols,
+                                                         MBLayoutPtr pMBLayout, const TensorShape& sampleLayout, const FrameRange& fr,
+                                                         size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel, bool isSparse,
+                                                         const vector<string>& labelMapping, const string& sequenceSeparator,
+                                                         const string& sequencePrologue, const string& sequenceEpilogue,
+                                                         const string& elementSeparator, const string& sampleSeparator,
+                                                         string valueFormatString, size_t topK)
+{
+    let matStride = matRows; // how to get from one column to the next
 
     // process all sequences one by one
-    MBLayoutPtr pMBLayout = GetMBLayout();
     if (!pMBLayout) // no MBLayout: We are printing aggregates (or LearnableParameters?)
     {
         pMBLayout = make_shared<MBLayout>();
-        pMBLayout->Init(1, outputValues.GetNumCols()); // treat this as if we have one single sequence consisting of the columns
-        pMBLayout->AddSequence(0, 0, 0, outputValues.GetNumCols());
+        pMBLayout->Init(1, matCols); // treat this as if we have one single sequence consisting of the columns
+        pMBLayout->AddSequence(0, 0, 0, matCols);
     }
     let& sequences = pMBLayout->GetAllSequences();
     let  width     = pMBLayout->GetNumTimeSteps();
 
-    TensorShape tensorShape = GetSampleLayout();
     stringstream str;
-    let dims = tensorShape.GetDims();
+    let dims = sampleLayout.GetDims();
     for (auto dim : dims)
         str << dim << ' ';
     let shape = str.str(); // BUGBUG: change to string(tensorShape) to make sure we always use the same format
@@ -594,19 +637,19 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
         }
 
         if (s > 0)
-            fprintfOrDie(f, "%s", sequenceSeparator.c_str());
-        fprintfOrDie(f, "%s", seqProl.c_str());
+            out += sequenceSeparator;
+        out += seqProl;
 
         // output it according to our format specification
         auto formatChar = valueFormatString.back();
-        if (isCategoryLabel) // if is category then find the max value and output its index (possibly mapped to a string)
+        if (isCategoryLabel || topK > 0) // if is category then find the max value and output its index (possibly mapped to a string)
         {
             if (formatChar == 's') // verify label dimension
             {
-                if (outputValues.GetNumRows() != labelMapping.size() &&
+                if (matRows != labelMapping.size() &&
                     sampleLayout[0] != labelMapping.size()) // if we match the first dim then use that
                 {
-                    static size_t warnings = 0;
+                    static std::atomic<size_t> warnings(0); // (formatting may run on several threads)
                     if (warnings++ < 5)
                         fprintf(stderr, "write: Row dimension %d does not match number of entries %d in labelMappingFile, not using mapping\n", (int)seqRows, (int)labelMapping.size());
                     valueFormatString.back() = 'u'; // this is a fallback
@@ -615,7 +658,7 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
             }
             // update the matrix in-place from one-hot (or max) to index
             // find the max in each column
-            for (size_t j = 0; j < seqCols; j++) // loop over all time steps of the sequence
+            for (size_t j = 0; j < seqCols && topK == 0; j++) // loop over all time steps of the sequence (the top-k are selected already)
             {
                 double maxLoc = -1;
                 double maxVal = 0;
@@ -630,7 +673,8 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
                 }
                 seqData[0 + j * seqStride] = (ElemType)maxLoc; // overwrite first element in-place
             }
-            seqRows = 1; // ignore remaining dimensions
+            if (topK == 0)
+                seqRows = 1; // ignore remaining dimensions
         }
         // function to print a value
         auto print = [&](double dval)
@@ -638,11 +682,11 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
             if (formatChar == 'f') // print as real number
             {
                 if (dval == 0) dval = fabs(dval);    // clear the sign of a negative 0, which are produced inconsistently between CPU and GPU
-                fprintfOrDie(f, valueFormatString.c_str(), dval);
+                AppendFormatted(out, valueFormatString.c_str(), dval);
             }
             else if (formatChar == 'u') // print category as integer index
             {
-                fprintfOrDie(f, valueFormatString.c_str(), (unsigned int)dval);
+                AppendFormatted(out, valueFormatString.c_str(), (unsigned int)dval);
             }
             else if (formatChar == 's') // print category as a label string
             {
@@ -651,7 +695,7 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
                     uval %= labelMapping.size();
                 assert(uval < labelMapping.size());
                 const char * sval = labelMapping[uval].c_str();
-                fprintfOrDie(f, valueFormatString.c_str(), sval);
+                AppendFormatted(out, valueFormatString.c_str(), sval);
             }
         };
         // bounds for printing
@@ -661,7 +705,26 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
         let jstop   = transpose ?   onlyUpToT : onlyUpToRow;
         let istride = transpose ?           1 : seqStride;
         let jstride = transpose ?   seqStride : 1;
-        if (isSparse)
+        if (topK > 0)
+        {
+            // one row per sample, with the topK elements in descending order, each as its index (or label) and its score
+            auto scoreFormatString = valueFormatString;
+            scoreFormatString.back() = 'f';
+            for (size_t j = 0; j < seqCols; j++)
+            {
+                if (j > 0)
+                    out += sampleSep;
+                for (size_t i = 0; i < topK; i++)
+                {
+                    if (i > 0)
+                        out += elementSeparator;
+                    print(seqData[i + j * seqStride]);
+                    out += ':';
+                    AppendFormatted(out, scoreFormatString.c_str(), (double)seqData[topK + i + j * seqStride]);
+                }
+            }
+        }
+        else if (isSparse)
         {
             // sparse linearizes the entire matrix into a single vector, and prints that one with coordinates
             // TODO: This can be done more nicely. We should keep the block structure.
@@ -674,21 +737,21 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
                     if (dval == 0) // only print non-0 values
                         continue;
                     if (numPrinted++ > 0)
-                        fprintfOrDie(f, "%s", transpose ? sampleSeparator.c_str() : elementSeparator.c_str());
+                        out += transpose ? sampleSeparator : elementSeparator;
                     if (dval != 1.0 || formatChar != 'f') // hack: we assume that we are either one-hot or never precisely hitting 1.0
                         print(dval);
                     size_t row = transpose ? i : j;
                     size_t col = transpose ? j : i;
                     for (size_t k = 0; k < sampleLayout.size(); k++)
                     {
-                        fprintfOrDie(f, "%c%d", k == 0 ? '[' : ',', row % sampleLayout[k]);
+                        AppendFormatted(out, "%c%d", k == 0 ? '[' : ',', row % sampleLayout[k]);
                         if (sampleLayout[k] == labelMapping.size()) // annotate index with label if dimensions match (which may misfire once in a while)
-                            fprintfOrDie(f, "=%s", labelMapping[row % sampleLayout[k]].c_str());
+                            AppendFormatted(out, "=%s", labelMapping[row % sampleLayout[k]].c_str());
                         row /= sampleLayout[k];
                     }
                     if (seqInfo.GetNumTimeSteps() > 1)
-                        fprintfOrDie(f, ";%d", col);
-                    fprintfOrDie(f, "]");
+                        AppendFormatted(out, ";%d", col);
+                    out += "]";
                 }
             }
         }
@@ -697,27 +760,27 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
             for (size_t j = 0; j < jend; j++) // loop over output rows     --BUGBUG: row index is 'i'!! Rename these!!
             {
                 if (j > 0)
-                    fprintfOrDie(f, "%s", sampleSep.c_str());
+                    out += sampleSep;
                 if (j == jstop && jstop < jend - 1) // if jstop == jend-1 we may as well just print the value instead of '...'
                 {
-                    fprintfOrDie(f, "...+%d", (int)(jend - jstop)); // 'nuff said
+                    AppendFormatted(out, "...+%d", (int)(jend - jstop)); // 'nuff said
                     break;
                 }
                 // inject sample tensor index if we are printing row-wise and it's a tensor
                 if (!transpose && sampleLayout.size() > 1 && !isCategoryLabel) // each row is a different sample dimension
                 {
                     for (size_t k = 0; k < sampleLayout.size(); k++)
-                        fprintfOrDie(f, "%c%d", k == 0 ? '[' : ',', (int)((j / sampleLayout.GetStrides()[k])) % sampleLayout[k]);
-                    fprintfOrDie(f, "]\t");
+                        AppendFormatted(out, "%c%d", k == 0 ? '[' : ',', (int)((j / sampleLayout.GetStrides()[k])) % sampleLayout[k]);
+                    out += "]\t";
                 }
                 // print a row of values
                 for (size_t i = 0; i < iend; i++) // loop over elements
                 {
                     if (i > 0)
-                        fprintfOrDie(f, "%s", elementSeparator.c_str());
+                        out += elementSeparator;
                     if (i == istop && istop < iend - 1)
                     {
-                        fprintfOrDie(f, "...+%d", (int)(iend - istop));
+                        AppendFormatted(out, "...+%d", (int)(iend - istop));
                         break;
                     }
                     double dval = seqData[i * istride + j * jstride];
@@ -725,9 +788,8 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
                 }
             }
         }
-        fprintfOrDie(f, "%s", sequenceEpilogue.c_str());
+        out += sequenceEpilogue;
     } // end loop over sequences
-    fflushOrDie(f);
 }
 
 /*static*/ string WriteFormattingOptions::Processed(const wstring& nodeName, string fragment, size_t minibatchId)
@@ -762,6 +824,7 @@ WriteFormattingOptions::WriteFormattingOptions(const ConfigRecordType& config) :
             labelMappingFile = (wstring)formatConfig(L"labelMappingFile", L"");
         }
         transpose = formatConfig(L"transpose", transpose);
+        topK      = formatConfig(L"topK",      topK);
         prologue  = formatConfig(L"prologue",  prologue);
         epilogue  = formatConfig(L"epilogue",  epilogue);
         sequenceSeparator = msra::strfun::utf8(formatConfig(L"sequenceSeparator", (wstring)msra::strfun::utf16(sequenceSeparator)));
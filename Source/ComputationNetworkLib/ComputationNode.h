@@ -48,7 +48,12 @@
 #define CNTK_MODEL_VERSION_16 16 // save/load rng state for Dropout and RandomSample nodes.
 #define CNTK_MODEL_VERSION_17 17 // use 8 bytes for rng seeds on both platforms
 #define CNTK_MODEL_VERSION_18 18 // reserving 18 for dilated convolution, write out one more TensorShape 
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_18
+#define CNTK_MODEL_VERSION_19 19 // int8 input range of Times and Convolution, recorded by calibration
+#define CNTK_MODEL_VERSION_20 20 // ReLU fused into BatchNormalization
+#define CNTK_MODEL_VERSION_21 21 // groups of ConvolutionNode
+#define CNTK_MODEL_VERSION_22 22 // ROIAlign mode of ROIPoolingNode
+#define CNTK_MODEL_VERSION_23 23 // in-batch negatives of CosDistanceWithNegativeSamplesNode
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_23
 
 
 // helper mode for debugging
@@ -149,13 +154,21 @@ typedef IStatefulNode::NodeStatePtr NodeStatePtr;
 // These members are only to be set, changed, and read by ComputationNetwork code.
 // =======================================================================
 
+// a group of element-wise nodes that is computed as one fused operation by the node that consumes them (see ComputationNetwork::FuseElementwiseOps())
+struct ElementwiseFusion
+{
+    std::vector<shared_ptr<ComputationNodeBase>> m_leaves;  // inputs of the group, in the order of the program's inputs
+    std::vector<shared_ptr<ComputationNodeBase>> m_members; // nodes of the group, including the consuming one
+    FusedElementwiseOp m_program;
+};
+
 class ComputationNetwork;
 struct ComputationNetworkOwnedNodeState
 {
     friend class ComputationNetwork;
 
     ComputationNetworkOwnedNodeState()
-        : m_needsGradient(false), m_valueSharable(true), m_parentOverwritesGradient(false)
+        : m_needsGradient(false), m_valueSharable(true), m_parentOverwritesGradient(false), m_fusedIntoConsumer(false), m_valueAliasesInput(false), m_inputGradientInPlace(false)
     {
         PurgeStateForFormingRecurrentLoops();
         m_isPartOfLoop = false;
@@ -183,6 +196,20 @@ struct ComputationNetworkOwnedNodeState
     virtual void MarkValueSharable() { m_valueSharable = true; }
     bool IsValueSharable() const { return m_valueSharable; }
 
+    // element-wise fusion
+    // A node that is fused into its consumer has no value of its own; the consumer holds the fused group and computes it in ForwardPropFused().
+    bool IsFusedIntoConsumer() const { return m_fusedIntoConsumer; }
+    const shared_ptr<ElementwiseFusion>& GetElementwiseFusion() const { return m_elementwiseFusion; }
+
+    // value aliasing
+    // A node whose value aliases its input uses the value matrix of Input(0) instead of computing a copy of it,
+    // or, if it computes in place, computes its value over the input's.
+    bool AliasesInputValue() const { return m_valueAliasesInput; }
+
+    // in-place computation
+    // The gradient of Input(0) is the gradient matrix of this node, which BackpropTo() overwrites with it.
+    bool ComputesInputGradientInPlace() const { return m_inputGradientInPlace; }
+
     // tracing flags
     // Enable to print the value of the function-value matrix in somewhat readable format.
     // These are public since you are meant to set these flags manually in the debugger or temporarily poke into them from code as needed.
@@ -204,6 +231,11 @@ protected:                // TODO: should be fully encapsulated here
 
     bool m_parentOverwritesGradient; // flag indicating whether the parent of this node overwrites the gradient of this node instead of accumulating to it
 
+    bool m_fusedIntoConsumer;                          // computed by its consumer, no value of its own
+    shared_ptr<ElementwiseFusion> m_elementwiseFusion; // the group of nodes fused into this one, if any
+    bool m_valueAliasesInput;                          // value is the value matrix of Input(0), see ComputationNetwork::AliasInputValues()
+    bool m_inputGradientInPlace;                       // gradient is the gradient matrix of Input(0), see ComputationNetwork::ComputeInPlace()
+
 private:
     bool m_isPartOfLoop; // true if this loop is part of a recurrent loop
 
@@ -279,6 +311,25 @@ private:
     uint64_t m_evalTimeStamp; // this is used to reduce unnecessary recomputation when a different node in the model is reevaluated
 };
 
+// =======================================================================
+// ICostEstimable -- nodes that can estimate the work of ForwardProp() and Backprop() on the current minibatch
+// This is for the roofline profile (ComputationNetwork::PrintNodeProfile()), hence analytical and approximate: FLOPs
+// count a multiply-add as 2, and bytes are the least traffic to the device memory, each operand read and each result
+// written once. Sparse operands are counted as dense.
+// =======================================================================
+
+struct NodeCost
+{
+    double m_flops;
+    double m_bytes;
+};
+
+struct ICostEstimable
+{
+    virtual NodeCost GetForwardCost() const = 0;
+    virtual NodeCost GetBackwardCost() const = 0; // for the inputs that need a gradient
+};
+
 // =======================================================================
 // ComputationNodeBase -- abstract base class for all computation nodes
 // =======================================================================
@@ -302,7 +353,7 @@ public:
     // -----------------------------------------------------------------------
 
     ComputationNodeBase(DEVICEID_TYPE deviceId, const wstring& name) :
-        m_deviceId(deviceId), m_outputNeededDuringBackprop(true), m_learningRateMultiplier(0),
+        m_deviceId(deviceId), m_outputNeededDuringBackprop(true), m_forwardPropOnly(false), m_valueRestoredForBackprop(false), m_learningRateMultiplier(0),
         m_gradientInitialized(false), m_nodeName(name == L"" ? CreateUniqNodeName() : name)
     {
         // TODO: should m_learningRateMultiplier be set to 0? Or should every node have a way to add its own say on the learning rate for all its inputs?
@@ -631,6 +682,8 @@ public:
     // -----------------------------------------------------------------------
 
     DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
+    // moves the node to another device, with the matrices it already has (see ComputationNetwork::PlaceNodesOnDevices())
+    virtual void MoveToDevice(DEVICEID_TYPE deviceId) { m_deviceId = deviceId; }
 
     // helper to access to element(0,0) without having to type-cast
     virtual double Get00Element() const = 0;
@@ -674,6 +727,9 @@ public:
 
     virtual std::set<std::pair<const MatrixBase*, std::wstring>> GetMatrixInfo() const = 0; // to be defined by <ElemType> version
 
+    // temporary matrices that ForwardProp() and Backprop() use besides the value and gradient, e.g. convolution workspaces (see MemoryTimeline)
+    virtual std::vector<const MatrixBase*> GetWorkspaceMatrices() const { return std::vector<const MatrixBase*>(); }
+
     // -----------------------------------------------------------------------
     // validation
     // -----------------------------------------------------------------------
@@ -787,10 +843,63 @@ public:
     // Base-class version makes conservative assumption that it is. Override if not.
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const { return true; }
 
-    void SetOutputNeededDuringBackprop(bool f) { m_outputNeededDuringBackprop = f; }
+    // Can ForwardProp() be run once more after the minibatch's forward prop, with the same result and no side effects?
+    // This is required for activation recomputation (see ComputationNetwork::PlanActivationRecomputation()).
+    // Override if ForwardProp() updates state, such as running statistics. Nodes that draw random numbers are excluded anyway.
+    virtual bool ForwardPropIsRepeatable() const { return true; }
+
+    // A node whose value is recomputed or offloaded to the host releases it after forward prop like any value not needed for
+    // backprop, and restores it during backprop into a second matrix that the memory-sharing plan assigns at that point.
+    // SwapBackpropValue() switches between the two.
+    virtual void RequestBackpropValueFromPool(MatrixPool&) { LogicError("%ls %ls operation: RequestBackpropValueFromPool() is not implemented.", NodeName().c_str(), OperationName().c_str()); }
+    virtual void ReleaseBackpropValueToPool(MatrixPool&) { LogicError("%ls %ls operation: ReleaseBackpropValueToPool() is not implemented.", NodeName().c_str(), OperationName().c_str()); }
+    virtual void SwapBackpropValue() { LogicError("%ls %ls operation: SwapBackpropValue() is not implemented.", NodeName().c_str(), OperationName().c_str()); }
+
+    // -----------------------------------------------------------------------
+    // element-wise fusion (see ComputationNetwork::FuseElementwiseOps())
+    // -----------------------------------------------------------------------
+
+    // If ForwardProp() computes nothing but the element-wise operation 'op' of all inputs, with broadcasting, return true and the op code.
+    virtual bool GetElementwiseForwardOp(ElementWiseOperator& /*op*/) const { return false; }
+
+    // forward prop of the group in GetElementwiseFusion(), instead of ForwardProp()
+    virtual void ForwardPropFused(const FrameRange&) { LogicError("%ls %ls operation: ForwardPropFused() is not implemented.", NodeName().c_str(), OperationName().c_str()); }
+
+    // -----------------------------------------------------------------------
+    // common-subexpression elimination (see ComputationNetwork::OptimizeNetworkGraph())
+    // -----------------------------------------------------------------------
+
+    // Return true if 'other', a node of the same operation and precision with the same inputs, computes the same value,
+    // i.e. if the nodes do not differ in any attribute. Element-wise ops have none; nodes with attributes must compare them.
+    virtual bool HasSameComputationAs(const ComputationNodeBase& other) const
+    {
+        ElementWiseOperator op, otherOp;
+        return GetElementwiseForwardOp(op) && other.GetElementwiseForwardOp(otherOp) && op == otherOp;
+    }
+
+    // -----------------------------------------------------------------------
+    // value aliasing (see ComputationNetwork::AliasInputValues())
+    // -----------------------------------------------------------------------
+
+    // Return true if the value is always an exact copy of the value matrix of Input(0), with the same matrix dimensions, e.g. a reshape.
+    // ForwardProp() must then skip the copy if the value is the input's (copy-to-self check).
+    virtual bool CanAliasInputValue() const { return false; }
+
+    // -----------------------------------------------------------------------
+    // in-place computation (see ComputationNetwork::ComputeInPlace())
+    // -----------------------------------------------------------------------
+
+    // Return true if ForwardProp() may write the value over the value matrix of Input(0), which has the same number of elements:
+    // each element of the value depends on the same element of Input(0) only (and on inputs other than Input(0)).
+    // Whether the input's value is still needed afterwards, e.g. by BackpropTo(), is decided by the network.
+    virtual bool CanComputeInPlace() const { return false; }
+
+    // With forwardPropOnly, there is no backprop, and the value can be shared once the consumers have run, irrespective of the global switches.
+    void SetOutputNeededDuringBackprop(bool f, bool forwardPropOnly = false) { m_outputNeededDuringBackprop = f; m_forwardPropOnly = forwardPropOnly; }
+    void MarkValueRestoredForBackprop() { m_valueRestoredForBackprop = true; } // (see ComputationNetwork::PlanActivationRecomputation() and PlanActivationOffloading())
     bool IsOutputNeededDuringBackprop() const 
     { 
-        return (!Globals::ShouldEnableShareNodeValueMatrices() && !Globals::ShouldEnableHyperCompressMemory())
+        return (!Globals::ShouldEnableShareNodeValueMatrices() && !Globals::ShouldEnableHyperCompressMemory() && !m_forwardPropOnly && !m_valueRestoredForBackprop)
             || m_outputNeededDuringBackprop; 
     }
 
@@ -920,6 +1029,8 @@ protected:
     float m_learningRateMultiplier;    // update parameters? Only used for LearnableParameters.    --TODO: Should we make this a member of LearnableParameters actually? And require a type cast? Currently it is read out for all leaves.
     bool m_gradientInitialized;        // indicates whether the gradient matrix has been resized and initialized to 0
     bool m_outputNeededDuringBackprop; // indicates whether the output value of the node is needed during backprop
+    bool m_forwardPropOnly;            // the matrices were allocated for forward prop only (see ComputationNetwork::AllocateAllMatrices())
+    bool m_valueRestoredForBackprop;   // the value is released after forward prop and recomputed or copied back during backprop, even without value sharing
 };
 typedef ComputationNodeBase::ComputationNodeBasePtr ComputationNodeBasePtr;
 
@@ -1358,6 +1469,40 @@ protected:
         return static_cast<ComputationNode<ElemType>&>(*m_inputs[inputIndex].get());
     }
 
+    // number of elements of the value of an input, or of this node if inputIndex is SIZE_MAX, on the current minibatch
+    double GetNumElementsInMinibatch(size_t inputIndex = SIZE_MAX) const
+    {
+        const ComputationNodeBase& node = inputIndex == SIZE_MAX ? static_cast<const ComputationNodeBase&>(*this) : *m_inputs[inputIndex];
+        return (double) node.GetSampleMatrixNumRows() * node.GetSampleMatrixNumCols();
+    }
+
+    // ICostEstimable for nodes that compute each element of their value from the corresponding (broadcast) elements of their inputs
+    NodeCost GetElementwiseForwardCost() const
+    {
+        double numElements = GetNumElementsInMinibatch();
+        double numBytes = numElements;
+        for (size_t i = 0; i < GetNumInputs(); i++)
+            numBytes += GetNumElementsInMinibatch(i);
+        return NodeCost{numElements * std::max<size_t>(GetNumInputs() - 1, 1), numBytes * sizeof(ElemType)};
+    }
+
+    NodeCost GetElementwiseBackwardCost() const
+    {
+        double numElements = GetNumElementsInMinibatch();
+        NodeCost cost{0, 0};
+        for (size_t i = 0; i < GetNumInputs(); i++)
+        {
+            if (!m_inputs[i]->NeedsGradient())
+                continue;
+            double numInputElements = GetNumElementsInMinibatch(i);
+            cost.m_flops += 2 * numElements; // derivative times the gradient
+            cost.m_bytes += (numElements + 2 * numInputElements + (InputUsedInComputingInputNodesGradients(i) ? numInputElements : 0)) * sizeof(ElemType);
+        }
+        if (cost.m_flops > 0 && OutputUsedInComputingInputNodesGradients())
+            cost.m_bytes += numElements * sizeof(ElemType);
+        return cost;
+    }
+
     void /*ComputationNodeBase::*/ SetInput(const size_t childIndex, const ComputationNodeBasePtr& inode) override
     {
         ClearConfigMemberCache();
@@ -1423,6 +1568,23 @@ public:
         MaskMissingColumnsTo(*m_gradient, m_pMBLayout, fr, Matrix<ElemType>::MakeNan(__LINE__));
     }
 
+    // the sequences of a minibatch as a 2 x numSequences matrix of (first column, number of frames), as the CRF operations
+    // of Matrix take them (see LinearChainCRF.h); used by nodes that operate on whole sequences
+    void AssignSequenceRanges(Matrix<ElemType>& sequences, const MBLayoutPtr& pMBLayout) const
+    {
+        std::vector<ElemType> ranges;
+        for (const auto& sequence : pMBLayout->GetAllSequences())
+        {
+            if (sequence.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (sequence.tBegin < 0 || sequence.tEnd > pMBLayout->GetNumTimeSteps())
+                InvalidArgument("%ls %ls operation needs whole sequences, but a sequence extends beyond the minibatch (truncated BPTT is not supported).", NodeName().c_str(), OperationName().c_str());
+            ranges.push_back((ElemType)(sequence.tBegin * pMBLayout->GetNumParallelSequences() + sequence.s));
+            ranges.push_back((ElemType)sequence.GetNumTimeSteps());
+        }
+        sequences.SetValue(2, ranges.size() / 2, sequences.GetDeviceId(), ranges.data());
+    }
+
     // -----------------------------------------------------------------------
     // accessors for value and gradient
     // -----------------------------------------------------------------------
@@ -1552,6 +1714,15 @@ public:
     // TODO: Are all these meant to read out a scalar? Then rename and verify dimensions.
     virtual double Get00Element() const override final { return Value().Get00Element(); }
 
+    virtual void /*ComputationNodeBase::*/ MoveToDevice(DEVICEID_TYPE deviceId) override
+    {
+        Base::MoveToDevice(deviceId);
+        if (m_value)
+            m_value->TransferToDeviceIfNotThere(deviceId, /*isBeingMoved=*/true);
+        if (m_gradient)
+            m_gradient->TransferToDeviceIfNotThere(deviceId, /*isBeingMoved=*/true);
+    }
+
     // -----------------------------------------------------------------------
     // dimensions and allocation
     // -----------------------------------------------------------------------
@@ -1626,6 +1797,17 @@ public:
     {
         Base::BeginForwardProp();
 
+        // an aliased value follows the input's matrix, which may have been exchanged, e.g. by the Eval DLL binding it to a user buffer
+        // A sparse input value is copied into a matrix of our own, as if it was not aliased.
+        if (AliasesInputValue())
+        {
+            const auto& inputValue = InputRef(0).m_value;
+            if (inputValue->GetMatrixType() != SPARSE)
+                m_value = inputValue;
+            else if (m_value == inputValue)
+                m_value = make_shared<Matrix<ElemType>>(m_deviceId);
+        }
+
         // update the actual m_value allocation
         if (!IsLeaf() && !RequiresPreCompute()) // TODO: guard this through overrides instead
             UpdateFunctionValuesSize();
@@ -1653,16 +1835,23 @@ public:
 #endif
         InvalidateMissingValueColumns(FrameRange(m_pMBLayout)); // blast NaNs into columns that are gaps in a packed layout
 #endif
+        if (Globals::ShouldCheckNonFiniteValues())
+        {
+            MaskMissingValueColumnsToZero(FrameRange(m_pMBLayout)); // gaps may hold anything
+            if (Value().HasNonFiniteValues())
+                RuntimeError("%ls %ls operation produced NaN or Inf values.", NodeName().c_str(), OperationName().c_str());
+        }
         // tracing
         Trace();
 
         // Any memory not needed could resize to zero immediately when HyperCompressMemory active. Since the memory won't really release,
         // all these memory blocks are gathered into a memory pool. When the next request coming, the best fitting block will be chosen.
-        if (Globals::ShouldEnableHyperCompressMemory()) 
+        // (Not for a forward-prop-only allocation, where the pool already hands the buffer on after the last consumer.)
+        if (Globals::ShouldEnableHyperCompressMemory() && !m_forwardPropOnly)
         {
             for (auto& input : GetInputs())
             {
-                if (!input->IsOutputNeededDuringBackprop() && input->IsValueSharable())
+                if (!input->IsOutputNeededDuringBackprop() && input->IsValueSharable() && !input->IsFusedIntoConsumer())
                 {
                     auto inputNodePtr = DownCast(input);
                     inputNodePtr->Value().Resize(0, 0);
@@ -1671,6 +1860,25 @@ public:
         }
     }
 
+    // forward prop of a group of element-wise nodes fused into this one: a single tensor op over the group's inputs
+    // All tensors use the largest rank in the group, like DetermineElementwiseTensorRank() of a single node.
+    virtual void /*ComputationNodeBase::*/ ForwardPropFused(const FrameRange& fr) override
+    {
+        const auto& fusion = *GetElementwiseFusion();
+        size_t rank = 0;
+        for (const auto& node : fusion.m_members)
+            rank = max(rank, node->GetSampleLayout().GetRank());
+        for (const auto& leaf : fusion.m_leaves)
+            rank = max(rank, leaf->GetSampleLayout().GetRank());
+        auto result = ValueTensorFor(rank, fr);
+        std::vector<TensorView<ElemType>> inputs;
+        for (const auto& leaf : fusion.m_leaves)
+            inputs.push_back(DownCast(leaf)->ValueTensorFor(rank, fr.AllowBroadcast()));
+        while (inputs.size() < FusedElementwiseOp::MaxInputs) // unused inputs of the program
+            inputs.push_back(inputs.front());
+        result.AssignFusedOpOf(inputs[0], inputs[1], inputs[2], fusion.m_program);
+    }
+
 #if 0   // (keep it around in case we need to add stuff in the future)
         virtual void /*IComputationNode::*/BeginBackprop() override
         {
@@ -1695,6 +1903,19 @@ public:
         }
 #endif
 #endif
+        if (Globals::ShouldCheckNonFiniteValues())
+        {
+            for (size_t i = 0; i < m_inputs.size(); i++)
+            {
+                ComputationNodePtr child = Input(i);
+                if (child->m_needsGradient && child->GradientPtr())
+                {
+                    child->MaskMissingGradientColumnsToZero(FrameRange(child->GetMBLayout()));
+                    if (child->Gradient().HasNonFiniteValues())
+                        RuntimeError("%ls %ls operation produced NaN or Inf gradients for its input %ls.", NodeName().c_str(), OperationName().c_str(), child->NodeName().c_str());
+                }
+            }
+        }
         // We could release the gradient of value sharable nodes and all no-longer used memory generated in forward.
         if (IsValueSharable() && Globals::ShouldEnableHyperCompressMemory())
         {
@@ -1759,7 +1980,8 @@ public:
     virtual std::set<std::pair<const MatrixBase*, std::wstring>> GetMatrixInfo() const override
     {
         std::set<std::pair<const MatrixBase*, std::wstring>> matrixInfo;
-        matrixInfo.insert    (make_pair(ValuePtr().get(),    NodeName() + L" : " + msra::strfun::utf16(ShapeDescription())));
+        if (ValuePtr()) // (nodes fused into their consumer have none)
+            matrixInfo.insert(make_pair(ValuePtr().get(),    NodeName() + L" : " + msra::strfun::utf16(ShapeDescription())));
         if (GradientPtr())
             matrixInfo.insert(make_pair(GradientPtr().get(), NodeName() + L" : " + msra::strfun::utf16(ShapeDescription()) + L" (gradient)"));
         return matrixInfo;
@@ -1768,8 +1990,10 @@ public:
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
-        if (IsValueSharable())
-            RequestMatrixFromPool(m_value, matrixPool);
+        if (AliasesInputValue()) // (the input's value is kept while this node's consumers run, see ComputationNetwork::AliasInputValues())
+            m_value = InputRef(0).m_value;
+        else if (IsValueSharable())
+            RequestMatrixFromPool(m_value, matrixPool, GetSampleLayout().GetNumElements(), HasMBLayout(), /*isNodeOutput=*/true);
         else
             CreateMatrixIfNull(m_value);
     }
@@ -1778,7 +2002,7 @@ public:
     // don't release matrices that need to be used in the gradient computation
     virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
     {
-        if (!IsOutputNeededDuringBackprop() && (m_value->GetMatrixType() != SPARSE) && IsValueSharable())
+        if (!IsOutputNeededDuringBackprop() && IsValueSharable() && !AliasesInputValue()) // (an aliased value is released by its input)
             ReleaseMatrixToPool(m_value, matrixPool);
     }
 
@@ -1786,7 +2010,9 @@ public:
     {
         for (int i = 0; i < m_inputs.size(); i++)
         {
-            if (m_inputs[i]->NeedsGradient())
+            if (i == 0 && ComputesInputGradientInPlace()) // (released by the input, see ComputationNetwork::ComputeInPlace())
+                InputRef(0).m_gradient = m_gradient;
+            else if (m_inputs[i]->NeedsGradient())
                 m_inputs[i]->RequestMatricesBeforeBackprop(matrixPool);
         }
     }
@@ -1794,7 +2020,7 @@ public:
     // request matrices that are needed for gradient computation
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
     {
-        RequestMatrixFromPool(m_gradient, matrixPool);
+        RequestMatrixFromPool(m_gradient, matrixPool, GetSampleLayout().GetNumElements(), HasMBLayout(), /*isNodeOutput=*/true);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1802,16 +2028,32 @@ public:
     {
         if (!IsLeaf() && !RequiresPreCompute())
         {
-            if (m_gradient != nullptr && m_gradient->GetMatrixType() != SPARSE) // since we don't have a sparse pool yet
+            if (m_gradient != nullptr && !ComputesInputGradientInPlace())
                 ReleaseMatrixToPool(m_gradient, matrixPool);
 
             // Release the Value matrix only if the output value is needed during backprop
             // since in the case it isn't used, we release it during forward prop itself
-            if (IsOutputNeededDuringBackprop() && m_value->GetMatrixType() != SPARSE && IsValueSharable())
+            if (IsOutputNeededDuringBackprop() && IsValueSharable() && !AliasesInputValue())
                 ReleaseMatrixToPool(m_value, matrixPool);
         }
     }
 
+    // activation recomputation and offloading, see ComputationNodeBase::SwapBackpropValue()
+    virtual void RequestBackpropValueFromPool(MatrixPool& matrixPool) override
+    {
+        RequestMatrixFromPool(m_backpropValue, matrixPool, GetSampleLayout().GetNumElements(), HasMBLayout(), /*isNodeOutput=*/true);
+    }
+
+    virtual void ReleaseBackpropValueToPool(MatrixPool& matrixPool) override
+    {
+        ReleaseMatrixToPool(m_backpropValue, matrixPool);
+    }
+
+    virtual void SwapBackpropValue() override
+    {
+        m_value.swap(m_backpropValue);
+    }
+
     void CreateValueMatrixIfNull()
     {
         CreateMatrixIfNull(m_value);
@@ -1839,11 +2081,19 @@ protected:
             matrixPtr = make_shared<Matrix<ElemType>>(m_deviceId);
     }
 
+    // The node's own sample layout is used as the size hint for the pool (see MatrixPool).
+    // Nodes whose temp matrices have a different shape can pass an explicit hint.
     void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
+    {
+        RequestMatrixFromPool(matrixPtr, matrixPool, GetSampleLayout().GetNumElements(), HasMBLayout());
+    }
+
+    // 'isNodeOutput' is set for the node's value and gradient, which a static memory plan places (see MatrixPool).
+    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool, size_t numElementsHint, bool mbScaled, bool isNodeOutput = false)
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            matrixPtr = matrixPool.Request<ElemType>(m_deviceId, numElementsHint, mbScaled, isNodeOutput);
         }
     }
 
@@ -1866,6 +2116,12 @@ public:
                                       const std::string& sequencePrologue, const std::string& sequenceEpilogue, const std::string& elementSeparator,
                                       const std::string& sampleSeparator, std::string valueFormatString,
                                       bool outputGradient = false) const;
+    static void FormatMinibatch(std::string& out, ElemType* matData, size_t matRows, size_t matCols, MBLayoutPtr pMBLayout, const TensorShape& sampleLayout,
+                                const FrameRange& fr, size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel, bool isSparse,
+                                const std::vector<std::string>& labelMapping, const std::string& sequenceSeparator,
+                                const std::string& sequencePrologue, const std::string& sequenceEpilogue, const std::string& elementSeparator,
+                                const std::string& sampleSeparator, std::string valueFormatString,
+                                size_t topK = 0); // topK > 0: matData holds the topK indices, then their scores, of each sample (see VectorMax())
 
     // simple helper to log the content of a minibatch
     void DebugLogMinibatch(bool outputGradient = false) const
@@ -2034,6 +2290,7 @@ public:
 protected:
 
     shared_ptr<Matrix<ElemType>> m_value, m_gradient;
+    shared_ptr<Matrix<ElemType>> m_backpropValue;  // value during backprop if it is recomputed or offloaded (see SwapBackpropValue())
 
     static std::map<size_t, std::map<size_t, shared_ptr<Matrix<ElemType>>>> s_constOnes;
 };
@@ -2054,6 +2311,7 @@ struct WriteFormattingOptions
     std::wstring labelMappingFile; // optional dictionary for pretty-printing category labels
     bool isSparse = false;
     bool transpose = true;         // true: one line per sample, each sample (column vector) forms one line; false: one column per sample
+    size_t topK = 0;               // > 0: output the indices (or labels) and scores of the topK largest values of each sample, selected on the device
     // The following strings are interspersed with the data:
     // overall
     std::string prologue; // print this at the start (e.g. a global header or opening bracket)
@@ -2213,6 +2471,22 @@ struct IRecurrentNode { virtual int GetRecurrenceSteppingDirection() const = 0;
 
 struct IFreezable { virtual void FreezeParameters() { } };
 
+// =======================================================================
+// IInt8Quantizable -- nodes that multiply their weights with data and can do so in int8 when inferring on the CPU
+// The weights are quantized per output channel, the data with the range that calibration has recorded in the node
+// (see Int8ChannelwiseMultiplier and PostComputingActions::Int8Calibration()). The range is saved with the model.
+// =======================================================================
+
+struct IInt8Quantizable
+{
+    // whether the node is configured such that it can be quantized, e.g. its weights are a LearnableParameter
+    virtual bool IsInt8Quantizable() const = 0;
+    // while calibrating, ForwardProp() computes in ElemType and records the absolute maximum of the data
+    virtual void StartInt8Calibration() = 0;
+    // ends calibration and returns the recorded range; int8 is used from now on if it is not 0
+    virtual double EndInt8Calibration() = 0;
+};
+
 // =======================================================================
 // PreComputedNodeBase -- interface implemented by ComputationNodes that precompute
 // TODO: We can use this interface in more places.
@@ -2243,6 +2517,7 @@ struct IPreComputeNode
     \
 protected:                                                                                                                                               \
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;                                                                                    \
+    using Base::AssignSequenceRanges;                                                                                                                    \
     using Base::BackpropTo;                                                                                                                              \
     using Base::ConstOnes;                                                                                                                               \
     using Base::CopyTo;                                                                                                                                  \
@@ -2376,7 +2651,7 @@ protected: /* some boilerplate goes here */
 // -----------------------------------------------------------------------
 
 template <class ElemType>
-class UnaryElementWiseNode : public ComputationNode<ElemType>, public NumInputs<1>
+class UnaryElementWiseNode : public ComputationNode<ElemType>, public NumInputs<1>, public ICostEstimable
 {
     typedef ComputationNode<ElemType> Base;
     UsingComputationNodeMembers;
@@ -2387,6 +2662,9 @@ public:
     {
     }
 
+    virtual NodeCost GetForwardCost() const override { return Base::GetElementwiseForwardCost(); }
+    virtual NodeCost GetBackwardCost() const override { return Base::GetElementwiseBackwardCost(); }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         ValidateUnaryMap(isFinalValidationPass);
@@ -2404,7 +2682,7 @@ public:
 // -----------------------------------------------------------------------
 
 template <class ElemType>
-class BinaryElementWiseNode : public ComputationNode<ElemType>, public NumInputs<2>, public IdentityTransformerNode
+class BinaryElementWiseNode : public ComputationNode<ElemType>, public NumInputs<2>, public IdentityTransformerNode, public ICostEstimable
 {
     typedef ComputationNode<ElemType> Base;
     UsingComputationNodeMembers;
@@ -2415,6 +2693,9 @@ public:
     {
     }
 
+    virtual NodeCost GetForwardCost() const override { return Base::GetElementwiseForwardCost(); }
+    virtual NodeCost GetBackwardCost() const override { return Base::GetElementwiseBackwardCost(); }
+
 #if DUMPOUTPUT
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return true; }
 #else
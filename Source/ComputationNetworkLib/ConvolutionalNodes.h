@@ -9,6 +9,7 @@
 #include "Matrix.h"
 #include "ComputationNode.h"
 #include "ConvolutionEngine.h"
+#include "InputAndParamNodes.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -150,6 +151,7 @@ public:
     bool Transpose() const { return m_transpose; }
     size_t MaxTempMemSizeInSamples() const { return m_maxTempMemSizeInSamples; }
     PoolKind PoolingKind() const { return m_poolKind; }
+    ImageLayoutKind ImageLayout() const { return m_imageLayout; }
 
     // bottomlessly expand shape to filterRank, then expand to inputRank using defaults or given 'from' values
     template<class V, typename T>
@@ -187,6 +189,34 @@ protected:
         FixVectorShape(filterRank, inputShape.size(), m_sharing,     true);
     }
 
+    // NHWC samples are [C x W x H], channels first in column-major notation, while the kernel, stride, sharing and padding
+    // are given, and validated, in the [W x H x C] order of the cudnn layout. These rotate the channels between the two.
+    // Parameters of rank 1 apply to all dimensions and remain as they are.
+    template<class V>
+    static V RotateChannels(const V& v, bool toFront)
+    {
+        V res(v);
+        size_t n = v.size();
+        for (size_t i = 0; i < n; i++)
+            res[toFront ? (i + 1) % n : i] = v[toFront ? i : (i + 1) % n];
+        return res;
+    }
+    static TensorShape ToNHWC(const TensorShape& shape)   { return TensorShape(RotateChannels(shape.GetDims(), /*toFront=*/true)); }
+    static TensorShape FromNHWC(const TensorShape& shape) { return TensorShape(RotateChannels(shape.GetDims(), /*toFront=*/false)); }
+
+    // The geometry for a [W x H x C] input, which NHWC runs as [C x W x H], with all maps on the channel dimension.
+    ConvolveGeometryPtr CreateGeometry(const TensorShape& inputShape, size_t groups = 1) const
+    {
+        if (m_imageLayout != ImageLayoutKind::NHWC)
+            return std::make_shared<ConvolveGeometry>(inputShape, m_kernelShape, m_mapCount, m_stride,
+                                                      m_sharing, m_autoPad, m_lowerPad, m_upperPad, groups);
+        SmallVector<size_t> mapCount(inputShape.GetRank(), 1);
+        mapCount[0] = m_mapCount.GetNumElements();
+        return std::make_shared<ConvolveGeometry>(ToNHWC(inputShape), ToNHWC(m_kernelShape), TensorShape(mapCount), ToNHWC(m_stride),
+                                                  RotateChannels(m_sharing, true), RotateChannels(m_autoPad, true),
+                                                  ToNHWC(m_lowerPad), ToNHWC(m_upperPad), groups);
+    }
+
     // Derived classes implement transforms calculation. Since all derived classes are filter based we consolidate common
     // filter transform calculation here to be reused by derived classes. For example convolution and de-convolution
     // have same transform but inversed, hence both of them may reuse this method and one will call inverse in addition
@@ -198,15 +228,25 @@ protected:
         SpaceTransform result;
         result.m_axisTransforms.resize(2);
 
-        result.m_axisTransforms[0].scale = (float)(geometry->GetStride(0));
-        result.m_axisTransforms[0].translate = (float)((geometry->KernelShape()[0] - 1) / 2 - geometry->GetLowerPad(0));
+        // NHWC geometries have the channels first
+        size_t x = m_imageLayout == ImageLayoutKind::NHWC ? 1 : 0, y = x + 1;
+        result.m_axisTransforms[0].scale = (float)(geometry->GetStride(x));
+        result.m_axisTransforms[0].translate = (float)((geometry->KernelShape()[x] - 1) / 2 - geometry->GetLowerPad(x));
 
-        result.m_axisTransforms[1].scale = (float)(geometry->GetStride(1));
-        result.m_axisTransforms[1].translate = (float)((geometry->KernelShape()[1] - 1) / 2 - geometry->GetLowerPad(1));
+        result.m_axisTransforms[1].scale = (float)(geometry->GetStride(y));
+        result.m_axisTransforms[1].translate = (float)((geometry->KernelShape()[y] - 1) / 2 - geometry->GetLowerPad(y));
 
         return result;
     }
 
+    virtual std::vector<const MatrixBase*> GetWorkspaceMatrices() const override
+    {
+        std::vector<const MatrixBase*> matrices;
+        if (m_tempMatrix) // (also the cuDNN workspace)
+            matrices.push_back(m_tempMatrix.get());
+        return matrices;
+    }
+
 protected:
     TensorShape m_kernelShape;
     TensorShape m_mapCount;
@@ -242,6 +282,9 @@ protected:                                  \
     using Base::m_tempMatrix;               \
     using Base::m_convEng;                  \
     using Base::InferReductionDims;         \
+    using Base::ToNHWC;                     \
+    using Base::FromNHWC;                   \
+    using Base::CreateGeometry;             \
 public:
 
 // -----------------------------------------------------------------------
@@ -249,20 +292,20 @@ public:
 // -----------------------------------------------------------------------
 
 template <class ElemType>
-class ConvolutionNode : public ConvolutionNodeBase<ElemType>, public NumInputs<2>, public TransformerNode
+class ConvolutionNode : public ConvolutionNodeBase<ElemType>, public NumInputs<2>, public TransformerNode, public IInt8Quantizable, public ICostEstimable
 {
     typedef ConvolutionNodeBase<ElemType> Base; UsingConvolutionNodeBaseMembers;
     static const std::wstring TypeName() { return L"Convolution"; }
 public:
     ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_groups(1), m_int8InputRange(0), m_int8Calibrating(false)
     {
     }
     ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& kernelShape, const TensorShape& mapCount, const TensorShape& strideShape,
                     const std::vector<bool>& sharing, const std::vector<bool>& autoPadding, const TensorShape& lowerPad, const TensorShape& upperPad,
-                    bool transpose, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples)
+                    bool transpose, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, size_t groups = 1)
                     : Base(deviceId, name, kernelShape, mapCount, strideShape, sharing, autoPadding, lowerPad, upperPad, PoolKind::None, transpose, imageLayout, maxTempMemSizeInSamples),
-                    m_convolution2D(false)
+                    m_convolution2D(false), m_groups(groups), m_int8InputRange(0), m_int8Calibrating(false)
     {
     }
     ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t kernelWidth, const size_t kernelHeight, const size_t outputChannels,
@@ -280,6 +323,8 @@ public:
                           configp->Get(L"dimSharing"), configp->Get(L"dimPadding"), configp->Get(L"dimPadLower"), configp->Get(L"dimPadUpper"),
                           configp->Get(L"transpose"), ImageLayoutKindFrom(configp->Get(L"imageLayout")), configp->Get(L"maxTempMemSizeInSamples"))
     {
+        if (configp->Exists(L"groups"))
+            m_groups = configp->Get(L"groups");
         AttachInputsFromConfig(configp, GetExpectedNumInputs());
     }
 
@@ -291,6 +336,8 @@ public:
         Base::Save(fstream);
         fstream << m_convolution2D;
         TensorShape(1).Save(fstream); // Write out a dummy tensor, so that model created can be used later after implementing reading this tensor in this model version
+        fstream << m_int8InputRange;
+        fstream << m_groups;
     }
 
     void Load(File& fstream, size_t modelVersion) override
@@ -333,6 +380,13 @@ public:
                 if(dummyTensorHolder!=TensorShape(1)) LogicError("Loading tensor that is currently not supported.");
             }
         }
+
+        m_int8InputRange = 0;
+        if (modelVersion >= CNTK_MODEL_VERSION_19)
+            fstream >> m_int8InputRange;
+        m_groups = 1;
+        if (modelVersion >= CNTK_MODEL_VERSION_21)
+            fstream >> m_groups;
     }
 
     void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
@@ -342,14 +396,75 @@ public:
         {
             auto node = dynamic_pointer_cast<ConvolutionNode<ElemType>>(nodeP);
             node->m_convolution2D = m_convolution2D;
+            node->m_groups = m_groups;
+            node->m_int8InputRange = m_int8InputRange;
         }
     }
 
+    // IInt8Quantizable: the kernel must be a LearnableParameter, and the engine must support int8 (GEMM on the CPU)
+    bool IsInt8Quantizable() const override
+    {
+        return !m_transpose && m_convEng && m_convEng->SupportsInt8Forward() && dynamic_pointer_cast<LearnableParameter<ElemType>>(Input(0)) != nullptr;
+    }
+
+    void StartInt8Calibration() override
+    {
+        m_int8Calibrating = true;
+        m_int8InputRange = 0;
+    }
+
+    double EndInt8Calibration() override
+    {
+        m_int8Calibrating = false;
+        return m_int8InputRange;
+    }
+
+    // ICostEstimable: each output of the (forward) convolution takes one multiply-add per kernel element, and so does each
+    // element of the gradients of the data and of the kernel; a transposed convolution does the same work in reverse
+    NodeCost GetForwardCost() const override
+    {
+        NodeCost cost{0, 0};
+        if (m_convEng)
+        {
+            cost.m_flops = 2 * GetMultiplyAddsPerSample() * Input(1)->GetSampleMatrixNumCols();
+            cost.m_bytes = (Base::GetNumElementsInMinibatch(0) + Base::GetNumElementsInMinibatch(1) + Base::GetNumElementsInMinibatch()) * sizeof(ElemType);
+        }
+        return cost;
+    }
+
+    NodeCost GetBackwardCost() const override
+    {
+        NodeCost cost{0, 0};
+        if (!m_convEng)
+            return cost;
+        double numKernel = Base::GetNumElementsInMinibatch(0), numData = Base::GetNumElementsInMinibatch(1), numOutput = Base::GetNumElementsInMinibatch();
+        for (size_t i = 0; i < 2; i++)
+        {
+            if (!Input(i)->NeedsGradient())
+                continue;
+            cost.m_flops += 2 * GetMultiplyAddsPerSample() * Input(1)->GetSampleMatrixNumCols();
+            cost.m_bytes += (numOutput + (i == 0 ? numData + 2 * numKernel : numKernel + 2 * numData)) * sizeof(ElemType);
+        }
+        return cost;
+    }
+
+private:
+    double GetMultiplyAddsPerSample() const
+    {
+        const auto& geometry = *m_convEng->Geometry();
+        return (double) geometry.OutputShape().GetNumElements() * geometry.KernelShape().GetNumElements();
+    }
+
+public:
     void ForwardProp(const FrameRange& fr) override
     {
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
         const Matrix<ElemType>& input0 = InputRef(0).ValueAsMatrix();
         Matrix<ElemType> sliceInput1Value = InputRef(1).ValueFor(fr);
+        if (m_int8Calibrating)
+            m_int8InputRange = std::max(m_int8InputRange, (double)sliceInput1Value.MatrixNormInf());
+        // int8 only while inferring, since the kernel changes while training
+        m_convEng->SetInt8InputRange(!m_int8Calibrating && Environment().IsInferring() ? (ElemType)m_int8InputRange : 0);
         if (!m_transpose)
             m_convEng->Forward(sliceInput1Value, input0, sliceOutputValue, *m_tempMatrix);
         else
@@ -399,6 +514,10 @@ public:
         if (m_convolution2D)
         // NOTE: when m_convolution2D is true, it's a legacy branch. Code should not enter here any more. 
         {
+            if (m_groups > 1)
+                InvalidArgument("%ls: Grouped convolution requires the ND convolution syntax.", NodeDescription().c_str());
+            if (m_imageLayout == ImageLayoutKind::NHWC)
+                InvalidArgument("%ls: The NHWC layout requires the ND convolution syntax.", NodeDescription().c_str());
             // Need to update some tensors with correct input dims.
             auto inDims = ImageDimensions(GetInputSampleLayout(inputIdx), m_imageLayout);
             // inputShape is used in ConvolveGeometry which supports only CHW layout.
@@ -435,12 +554,35 @@ public:
         else
         {
             inputShape = GetInputSampleLayout(inputIdx);
+            // NHWC is validated in the [W x H x C] order of the parameters, see CreateGeometry()
+            if (m_imageLayout == ImageLayoutKind::NHWC)
+            {
+                if (m_groups > 1 || m_transpose)
+                    InvalidArgument("%ls: Grouped and transposed convolutions are not supported with the NHWC layout.", NodeDescription().c_str());
+                inputShape = FromNHWC(inputShape);
+            }
             // infer reduction dimensions if not given
             InferReductionDims(inputShape, inputShape);
+            if (m_groups > 1)
+            {
+                if (m_transpose)
+                    InvalidArgument("%ls: Grouped convolution is not supported with transpose.", NodeDescription().c_str());
+                // the kernel covers the channels of one group; it was inferred as all of them if not given
+                size_t channels = inputShape[inputShape.GetRank() - 1];
+                auto kernelDims = m_kernelShape.GetDims();
+                if (kernelDims.size() == inputShape.GetRank() && kernelDims.back() == channels && channels % m_groups == 0)
+                {
+                    kernelDims.back() = channels / m_groups;
+                    m_kernelShape = TensorShape(kernelDims);
+                }
+                // there is a single kernel position per group along the channels, so nothing to pad
+                if (m_autoPad.size() == inputShape.GetRank())
+                    m_autoPad.back() = false;
+            }
             if (!m_transpose)
             {
                 outputShape = ConvolveGeometry::ComputeOutputShape(inputShape, m_kernelShape, m_mapCount, m_stride,
-                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad);
+                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad, m_groups);
             }
             else
             {
@@ -452,6 +594,8 @@ public:
 
             if (m_imageLayout == ImageLayoutKind::CHW) 
                 SetDims(outputShape, HasMBLayout());
+            else if (m_imageLayout == ImageLayoutKind::NHWC)
+                SetDims(ToNHWC(outputShape), HasMBLayout());
             else    // legacy format 
                 SetDims(ImageDimensions(outputShape, ImageLayoutKind::CHW).AsTensorShape(m_imageLayout), HasMBLayout());
         }
@@ -468,7 +612,8 @@ public:
             else
 #endif
             {
-                auto weightShape = m_kernelShape.GetDims();
+                // NHWC kernels are [C x X x Y] per map, the KHWC (row-major) filters of cuDNN's NHWC format
+                auto weightShape = m_imageLayout == ImageLayoutKind::NHWC ? ToNHWC(m_kernelShape).GetDims() : m_kernelShape.GetDims();
                 for (auto outDim : m_mapCount.GetDims())
                     weightShape.push_back(outDim);
                 Input(0)->ValidateInferInputDimsFrom(TensorShape(weightShape));
@@ -479,9 +624,7 @@ public:
         {
             if (m_convEng == nullptr)
             {
-                auto geometry = std::make_shared<ConvolveGeometry>(!m_transpose ? inputShape : outputShape,
-                                                                   m_kernelShape, m_mapCount, m_stride, 
-                                                                   m_sharing, m_autoPad, m_lowerPad, m_upperPad);
+                auto geometry = CreateGeometry(!m_transpose ? inputShape : outputShape, m_groups);
                 m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
                                                                 m_maxTempMemSizeInSamples, m_poolKind,
                                                                 ConvolutionEngineKind::All, NodeName(), Globals::ShouldForceDeterministicAlgorithms());
@@ -517,6 +660,7 @@ public:
     }
 
     bool IsConvolution2D() const { return m_convolution2D; }
+    size_t Groups() const { return m_groups; }
 
 private:
     using TransformerNode::m_transforms;
@@ -546,6 +690,13 @@ private:
 protected:
     // Flag that indicates whether the node is created using 2D-syntax.
     bool m_convolution2D;
+
+    // The input channels and the output maps are split into this many groups, each convolved separately (see ConvolveGeometry::Groups()).
+    size_t m_groups;
+
+    // int8 inference (see IInt8Quantizable); the range is 0 if the node is not quantized
+    double m_int8InputRange;
+    bool m_int8Calibrating;
 };
 
 // -----------------------------------------------------------------------
@@ -562,12 +713,17 @@ protected:
 // so that each ROI output has the spatial size expected by the first
 // fully-connected layer. Images are Input(0). ROIs are Input(1). 
 //
+// With roiAlign, the ROIs are not rounded to the pixel grid, and each
+// pooled location is instead the average of the input, bilinearly
+// interpolated at samplingRatio x samplingRatio points of its window
+// (or, if samplingRatio is 0, at as many points as the window spans pixels).
+//
 // Input0: Images       [W x H x C x N]
 // Input1: ROIs         [4 x roisPerImage x N], 
 // output: Pooled ROIs  [PW x PH x C x roisPerImage x N]
 // where PW = Pooled Width, PH = Pooled Height, C = Channels, N = Batch Size
 //
-// See http://arxiv.org/abs/1504.08083
+// See http://arxiv.org/abs/1504.08083, and for ROIAlign http://arxiv.org/abs/1703.06870
 // -----------------------------------------------------------------------
 template <class ElemType>
 class ROIPoolingNode : public ComputationNode<ElemType>, public NumInputs<2>
@@ -575,13 +731,17 @@ class ROIPoolingNode : public ComputationNode<ElemType>, public NumInputs<2>
     typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
     static const std::wstring TypeName() { return L"ROIPooling"; }
 public:
-    ROIPoolingNode(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& roiOutputShape = TensorShape())
-        : Base(deviceId, name), m_roiOutputShape(roiOutputShape), m_argmaxData(Matrix<ElemType>::Zeros(1, 1, deviceId))
+    ROIPoolingNode(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& roiOutputShape = TensorShape(), bool roiAlign = false, size_t samplingRatio = 0)
+        : Base(deviceId, name), m_roiOutputShape(roiOutputShape), m_roiAlign(roiAlign), m_samplingRatio(samplingRatio), m_argmaxData(Matrix<ElemType>::Zeros(1, 1, deviceId))
     {
     }
     ROIPoolingNode(const ScriptableObjects::IConfigRecordPtr configp)
         : ROIPoolingNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"roiOutputShape"))
     {
+        if (configp->Exists(L"roiAlign"))
+            m_roiAlign = configp->Get(L"roiAlign");
+        if (configp->Exists(L"samplingRatio"))
+            m_samplingRatio = configp->Get(L"samplingRatio");
         AttachInputsFromConfig(configp, GetExpectedNumInputs());
     }
 
@@ -636,6 +796,13 @@ public:
         size_t outW = m_roiOutputShape[0];
         size_t outH = m_roiOutputShape[1];
 
+        if (m_roiAlign)
+        {
+            inputSlice.ROIAlignForward(roisPerImage, inputSlice.GetNumCols(),
+                numChannels, inputW, inputH, outW, outH, m_samplingRatio, ROIs, outputSlice);
+            return;
+        }
+
         m_tempMatrix->Resize(outW * outH * numChannels * roisPerImage, inputSlice.GetNumCols());
         inputSlice.ROIPoolingForward(roisPerImage, inputSlice.GetNumCols(), 
             numChannels, inputW, inputH, outW, outH, ROIs, outputSlice, *m_tempMatrix);
@@ -645,12 +812,21 @@ public:
     {
         Base::Save(fstream);
         m_roiOutputShape.Save(fstream);
+        fstream << m_roiAlign;
+        fstream << m_samplingRatio;
     }
 
     void Load(File& fstream, size_t modelVersion) override
     {
         Base::Load(fstream, modelVersion);
         m_roiOutputShape.Load(fstream);
+        m_roiAlign = false;
+        m_samplingRatio = 0;
+        if (modelVersion >= CNTK_MODEL_VERSION_22)
+        {
+            fstream >> m_roiAlign;
+            fstream >> m_samplingRatio;
+        }
     }
 
     void Validate(bool isFinalValidationPass) override
@@ -685,8 +861,13 @@ public:
     // difference: needs to sum gradients over all the ROIs that may
     // have used that location. One image location could be in
     // multiple ROIs--in that case each ROI may contribute a gradient term.
-    void BackpropTo(const size_t /*inputIndex*/, const FrameRange& fr) override
+    // With roiAlign, the gradients go to the interpolated locations instead.
+    // The gradients are added to those of the images; the ROIs get none.
+    void BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (inputIndex != 0)
+            return;
+
         auto inputShape = GetInputSampleLayout(0);
         Matrix<ElemType> inputSlice = Input(0)->ValueFor(fr);
 
@@ -700,8 +881,12 @@ public:
         int roisPerImage = GetInputSampleLayout(1)[1];
         auto roiData = Input(1)->ValueFor(fr);
 
-        pooledGrad.ROIPoolingBackward(roisPerImage, inputSlice.GetNumCols(), numChannels, 
-            inputW, inputH, m_roiOutputShape[0], m_roiOutputShape[1], roiData, inputGrad, *m_tempMatrix);
+        if (m_roiAlign)
+            pooledGrad.ROIAlignBackward(roisPerImage, inputSlice.GetNumCols(), numChannels,
+                inputW, inputH, m_roiOutputShape[0], m_roiOutputShape[1], m_samplingRatio, roiData, inputGrad);
+        else
+            pooledGrad.ROIPoolingBackward(roisPerImage, inputSlice.GetNumCols(), numChannels, 
+                inputW, inputH, m_roiOutputShape[0], m_roiOutputShape[1], roiData, inputGrad, *m_tempMatrix);
     }
 
     void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
@@ -711,13 +896,27 @@ public:
         {
             auto node = dynamic_pointer_cast<ROIPoolingNode<ElemType>>(nodeP);
             node->m_roiOutputShape = m_roiOutputShape;
+            node->m_roiAlign = m_roiAlign;
+            node->m_samplingRatio = m_samplingRatio;
         }
     }
 
     TensorShape ROIOutputShape() const { return m_roiOutputShape; }
+    bool ROIAlign() const { return m_roiAlign; }
+    size_t SamplingRatio() const { return m_samplingRatio; }
+
+    virtual std::vector<const MatrixBase*> GetWorkspaceMatrices() const override
+    {
+        std::vector<const MatrixBase*> matrices{ &m_argmaxData };
+        if (m_tempMatrix)
+            matrices.push_back(m_tempMatrix.get());
+        return matrices;
+    }
 
 protected:
     TensorShape m_roiOutputShape;
+    bool m_roiAlign;
+    size_t m_samplingRatio; // samples per bin and dimension of ROIAlign; 0 to adapt them to the bin size
     shared_ptr<Matrix<ElemType>> m_tempMatrix;
     Matrix<ElemType> m_argmaxData;
 };
@@ -782,28 +981,29 @@ public:
         Base::Validate(isFinalValidationPass);
         InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
 
-        if (m_imageLayout != ImageLayoutKind::CHW)
+        if (m_imageLayout != ImageLayoutKind::CHW && m_imageLayout != ImageLayoutKind::NHWC)
         {
             InvalidArgument(
-                "%ls %ls supports only cuDNN (CHW) data layout. "
+                "%ls %ls supports only cuDNN (CHW) or NHWC data layout. "
                 "Please specify imageLayout=\"cudnn\" in %ls node in your script "
                 "and make sure input data layout is CHW", NodeName().c_str(), OperationName().c_str(), NodeName().c_str());
         }
 
-        const auto& inputShape = GetInputSampleLayout(0);
+        // NHWC is validated in the [W x H x C] order of the parameters, see CreateGeometry()
+        bool nhwc = m_imageLayout == ImageLayoutKind::NHWC;
+        auto inputShape = nhwc ? FromNHWC(GetInputSampleLayout(0)) : GetInputSampleLayout(0);
 
         // infer reduction dimensions if not given
         InferReductionDims(inputShape, TensorShape());
 
         auto outDims = ConvolveGeometry::ComputeOutputShape(inputShape, m_kernelShape, m_mapCount, m_stride,
                                                             m_sharing, m_autoPad, m_lowerPad, m_upperPad);
-        SetDims(outDims, HasMBLayout());
+        SetDims(nhwc ? ToNHWC(outDims) : outDims, HasMBLayout());
         if (isFinalValidationPass)
         {
             if (m_convEng == nullptr)
             {
-                auto geometry = std::make_shared<ConvolveGeometry>(inputShape, m_kernelShape, m_mapCount, m_stride,
-                                                                   m_sharing, m_autoPad, m_lowerPad, m_upperPad);
+                auto geometry = CreateGeometry(inputShape);
                 m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
                                                                 m_maxTempMemSizeInSamples, m_poolKind,
                                                                 ConvolutionEngineKind::All, NodeName());
@@ -101,6 +101,7 @@ LearnableParameter<ElemType>::LearnableParameter(const ScriptableObjects::IConfi
         m_initFilterRank = configp->Get(L"initFilterRank"); 
         m_initOutputRank = configp->Get(L"initOutputRank");
         m_initOnCPUOnly  = configp->Get(L"initOnCPUOnly");
+        m_initByCounter  = configp->Exists(L"initByCounter") ? (bool)configp->Get(L"initByCounter") : false;
     }
     else if (initString == L"zero")
     {
@@ -176,7 +177,8 @@ template <class ElemType>
 void LearnableParameter<ElemType>::PostInitParameters(const wstring& initString, // "uniform"|"gaussian"|"fixedValue"
                                                       ElemType initValue,        //  scale   | scale    | value
                                                       unsigned long randomSeed /*= 0*/,
-                                                      bool initOnCPUOnly /*= false*/)
+                                                      bool initOnCPUOnly /*= false*/,
+                                                      bool initByCounter /*= false*/)
 {
     if (ParseRandomizationType(initString).second != 0) // random init
     {
@@ -186,6 +188,7 @@ void LearnableParameter<ElemType>::PostInitParameters(const wstring& initString,
         m_initFilterRank = 0; // default. NDL (deprecated) cannot specify a different value.  
         m_initOutputRank = 1; // default. NDL (deprecated) cannot specify a different value.
         m_initOnCPUOnly = initOnCPUOnly;
+        m_initByCounter = initByCounter;
     }
     else if (initString == L"fixedValue") // from constant value
     {
@@ -228,8 +231,20 @@ static pair<bool/*uniform*/,double/*stddev or range*/> ParseRandomizationType(co
     else                                               return make_pair(false, 0.0);
 }
 
+// key of the counter-based initialization of a parameter: FNV-1a over the seed and the characters of the name
+// (std::hash is not the same across platforms)
+static uint64_t CounterBasedInitKey(unsigned long randomSeed, const wstring& name)
+{
+    uint64_t key = 0xCBF29CE484222325ull;
+    key = (key ^ (uint64_t)randomSeed) * 0x100000001B3ull;
+    for (wchar_t c : name)
+        key = (key ^ (uint64_t)c) * 0x100000001B3ull;
+    return key;
+}
+
 // initialize with random numbers
 // if 'initOnCPUOnly' then always init on CPU, making initialization consistent across both (for testing)
+// if 'initByCounter' then init in place, element i from (seed, name, i), which gives the same values on either device
 template <class ElemType>
 std::tuple<size_t, size_t, ElemType> LearnableParameter<ElemType>::InitRandom(Matrix<ElemType>& valueMatrix,
                                                                               const TensorShape& sampleShape,
@@ -239,7 +254,9 @@ std::tuple<size_t, size_t, ElemType> LearnableParameter<ElemType>::InitRandom(Ma
                                                                               const size_t initFilterRank,
                                                                               const int initOutputRank,
                                                                               const bool initOnCPUOnly,
-                                                                              DEVICEID_TYPE deviceId)
+                                                                              DEVICEID_TYPE deviceId,
+                                                                              const bool initByCounter /*= false*/,
+                                                                              const wstring& name /*= wstring()*/)
 {
     let& sampleLayout = sampleShape;
     let numElements = sampleLayout.GetNumElements();
@@ -272,6 +289,16 @@ std::tuple<size_t, size_t, ElemType> LearnableParameter<ElemType>::InitRandom(Ma
 
     range *= initValueScale;
 
+    if (initByCounter)
+    {
+        let key = CounterBasedInitKey(randomSeed, name);
+        if (isUniform)
+            valueMatrix.SetCounterBasedUniformRandomValue(-range, range, key);
+        else
+            valueMatrix.SetCounterBasedGaussianRandomValue(0, range, key);
+        return std::make_tuple(fanOut, fanIn, range);
+    }
+
     // the random seed offset is set via the "randomSeedOffset" parameter in config
     if (initOnCPUOnly)
         valueMatrix.TransferToDeviceIfNotThere(CPUDEVICE, true);
@@ -423,6 +450,24 @@ void LearnableParameter<ElemType>::Save(File& fstream) const /*override*/
 
 template <class ElemType>
 void LearnableParameter<ElemType>::Load(File& fstream, size_t modelVersion) /*override*/
+{
+    LoadImpl(fstream, modelVersion, /*deferredValuePosition=*/nullptr);
+}
+
+template <class ElemType>
+bool LearnableParameter<ElemType>::LoadDeferringValue(File& fstream, size_t modelVersion, uint64_t& valuePosition)
+{
+    return LoadImpl(fstream, modelVersion, &valuePosition);
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::LoadDeferredValue(File& fstream, uint64_t valuePosition, ElemType* hostBuffer)
+{
+    Value().ReadElements(fstream, valuePosition, hostBuffer);
+}
+
+template <class ElemType>
+bool LearnableParameter<ElemType>::LoadImpl(File& fstream, size_t modelVersion, uint64_t* deferredValuePosition)
 {
     Base::Load(fstream, modelVersion);
 
@@ -451,11 +496,50 @@ void LearnableParameter<ElemType>::Load(File& fstream, size_t modelVersion) /*ov
         }
     }
 
-    LoadValue(fstream);
+    bool isValueDeferred = false;
+    if (deferredValuePosition)
+    {
+        CreateMatrixIfNull(m_value);
+        isValueDeferred = Value().TryReadWithoutElements(fstream, *deferredValuePosition);
+    }
+    if (!isValueDeferred)
+        LoadValue(fstream);
     SetDims(sampleLayout, false); // note: call this after LoadValue() since LoadValue() overwrites m_sampleLayout
     VerifyDataSize(Value());      // sanity check
 
     m_initString.clear(); // deferred initialization not possible after loading
+    return isValueDeferred;
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::SaveWithoutValue(File& fstream) const
+{
+    if (!m_initString.empty())
+        LogicError("LearnableParameter: Cannot Save() before deferred initialization has completed.");
+    Base::Save(fstream);
+    fstream << m_learningRateMultiplier;
+    m_sampleLayout.Save(fstream);
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::LoadWithoutValue(File& fstream, size_t modelVersion)
+{
+    Base::Load(fstream, modelVersion);
+
+    TensorShape sampleLayout;
+    fstream >> m_learningRateMultiplier;
+    sampleLayout.Load(fstream);
+    SetDims(sampleLayout, false);
+
+    m_initString.clear();
+}
+
+// the memory is not owned; it must outlive the node's use of the value (see ComputationNetwork::ReadFrozen())
+template <class ElemType>
+void LearnableParameter<ElemType>::BindValue(ElemType* data, size_t numRows, size_t numCols)
+{
+    this->ValuePtrRef() = make_shared<Matrix<ElemType>>(numRows, numCols, data, m_deviceId, matrixFlagDontOwnBuffer);
+    VerifyDataSize(Value()); // sanity check
 }
 
 template <class ElemType>
@@ -471,6 +555,7 @@ template <class ElemType>
         node->m_initFilterRank = m_initFilterRank; 
         node->m_initOutputRank = m_initOutputRank;
         node->m_initOnCPUOnly  = m_initOnCPUOnly;
+        node->m_initByCounter  = m_initByCounter;
         node->m_initValue      = m_initValue;
     }
 }
@@ -546,7 +631,7 @@ void LearnableParameter<ElemType>::LazyInitParameters()
     else if (ParseRandomizationType(m_initString).second != 0)
     {
         let randomSeed = Globals::ShouldForceConstantRandomSeed() ? 1UL : m_randomSeed; // debugging feature to enforce identical results across NDL, BrainScript, and V2 API/Python
-        InitRandom(m_initString, randomSeed, m_initValueScale, m_initFilterRank, m_initOutputRank, m_initOnCPUOnly);
+        InitRandom(m_initString, randomSeed, m_initValueScale, m_initFilterRank, m_initOutputRank, m_initOnCPUOnly, m_initByCounter);
     }
     else
         LogicError("LearnableParameter: Invalid value of m_initString '%ls' for deferred initialization for %ls.", m_initString.c_str(), NodeDescription().c_str());
@@ -67,7 +67,8 @@ public:
     void PostInitParameters(const std::wstring& initString, // "uniform"|"gaussian"|"fixedValue"
                             ElemType initValue,             //  scale   | scale    | value
                             unsigned long randomSeed = 0,
-                            bool initOnCPUOnly = false);
+                            bool initOnCPUOnly = false,
+                            bool initByCounter = false);
 
     // Initialize with bilinear interpolation coefficients (useful for deconvolution layer).
     void InitBilinear(size_t kernelWidth, size_t kernelHeight)
@@ -81,6 +82,8 @@ public:
 public:
     // initialize with random numbers
     // If 'initOnCPUOnly' then always init on CPU, making initialization consistent across both (for testing).
+    // If 'initByCounter' then init on the device by a counter-based generator keyed by the seed and 'name' instead,
+    // which is consistent across both as well, without a copy of the values in host memory.
     static std::tuple<size_t, size_t, ElemType> InitRandom(Matrix<ElemType>& valueMatrix,
                                                            const TensorShape& sampleShape,
                                                            const std::wstring& type,
@@ -89,25 +92,27 @@ public:
                                                            const size_t initFilterRank,
                                                            const int initOutputRank,
                                                            const bool initOnCPUOnly,
-                                                           DEVICEID_TYPE deviceId);
+                                                           DEVICEID_TYPE deviceId,
+                                                           const bool initByCounter = false,
+                                                           const std::wstring& name = std::wstring());
 
     static void InitBilinear(Matrix<ElemType>& valueMatrix, const TensorShape& sampleShape, size_t kernelWidth, size_t kernelHeight, DEVICEID_TYPE deviceId);
 
 private:
-    void InitRandom(const std::wstring& type, const unsigned long randomSeed, const ElemType initValueScale, const size_t initFilterRank, const int initOutputRank, const bool initOnCPUOnly)
+    void InitRandom(const std::wstring& type, const unsigned long randomSeed, const ElemType initValueScale, const size_t initFilterRank, const int initOutputRank, const bool initOnCPUOnly, const bool initByCounter)
     {
         size_t fanOut, fanIn;
         ElemType range;
-        std::tie(fanOut, fanIn, range) = InitRandom(Value(), GetSampleLayout(), type, randomSeed, initValueScale, initFilterRank, initOutputRank, initOnCPUOnly, m_deviceId);
+        std::tie(fanOut, fanIn, range) = InitRandom(Value(), GetSampleLayout(), type, randomSeed, initValueScale, initFilterRank, initOutputRank, initOnCPUOnly, m_deviceId, initByCounter, NodeName());
         if (fanOut == 0) // Shape not yet initialized
             return;
 
         bool log = GetEnvironmentPtr() && Environment().traceLevel > 0; // note: this will not log before node is part of network
         if (log)
         {
-            fprintf(stderr, "%ls: Initializing Parameter[%s] <- %ls(seed=%d, init dims=[%d x %d], range=%f(%f*%f), onCPU=%s.\n)",
+            fprintf(stderr, "%ls: Initializing Parameter[%s] <- %ls(seed=%d, init dims=[%d x %d], range=%f(%f*%f), onCPU=%s, byCounter=%s.\n)",
                     NodeDescription().c_str(), string(GetSampleLayout()).c_str(), m_initString.c_str(),
-                    (int)randomSeed, (int)fanOut, (int)fanIn, range, range/initValueScale, initValueScale, initOnCPUOnly ? "true" : "false");
+                    (int)randomSeed, (int)fanOut, (int)fanIn, range, range/initValueScale, initValueScale, initOnCPUOnly ? "true" : "false", initByCounter ? "true" : "false");
         }
     }
 
@@ -117,6 +122,9 @@ private:
     // deferred initialization
     void LazyInitParameters();
 
+    // shared part of Load() and LoadDeferringValue()
+    bool LoadImpl(File& fstream, size_t modelVersion, uint64_t* deferredValuePosition);
+
 public:
     // reload parameters from file
     // This is called from MEL.
@@ -125,6 +133,18 @@ public:
     virtual void Save(File& fstream) const override;
     virtual void Load(File& fstream, size_t modelVersion) override;
 
+    // frozen models (ComputationNetwork::SaveFrozen()) keep the values in a parameter blob of their own
+    // LoadWithoutValue() leaves the value empty until BindValue() makes it a view on the blob.
+    void SaveWithoutValue(File& fstream) const;
+    void LoadWithoutValue(File& fstream, size_t modelVersion);
+    void BindValue(ElemType* data, size_t numRows, size_t numCols);
+
+    // ComputationNetwork::Read() may defer reading the elements of the value to read them in parallel, or lazily
+    // LoadDeferringValue() is Load() with the value only getting its dimensions, if it is dense; then it returns true
+    // and the position of the elements, which LoadDeferredValue() reads, through any File on the same file.
+    bool LoadDeferringValue(File& fstream, size_t modelVersion, uint64_t& valuePosition);
+    void LoadDeferredValue(File& fstream, uint64_t valuePosition, ElemType* hostBuffer);
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
 
     // computation functions don't do anything for parameter nodes
@@ -161,6 +181,7 @@ private:
     size_t m_initFilterRank;
     int m_initOutputRank;
     bool m_initOnCPUOnly;
+    bool m_initByCounter;
     ElemType m_initValue;
 
     // flags related to gradient update
@@ -7,6 +7,7 @@
 #include "Basics.h"
 #include "ComputationNode.h"
 #include "Matrix.h"
+#include "PackedMatrixMultiplier.h"
 #include "TensorView.h"
 #include <unordered_set>
 #include <map>
@@ -50,6 +51,8 @@ public:
         result.AssignSumOf(input0, input1);
     }
 
+    virtual bool /*ComputationNodeBase::*/ GetElementwiseForwardOp(ElementWiseOperator& op) const override { op = ElementWiseOperator::opSum; return true; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         size_t rank = DetermineElementwiseTensorRank();
@@ -100,6 +103,8 @@ public:
         result.AssignLogSumOf(input0, input1);
     }
 
+    virtual bool /*ComputationNodeBase::*/ GetElementwiseForwardOp(ElementWiseOperator& op) const override { op = ElementWiseOperator::opLogSum; return true; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         size_t rank = DetermineElementwiseTensorRank();
@@ -156,6 +161,8 @@ public:
         result.AssignDifferenceOf(input0, input1);
     }
 
+    virtual bool /*ComputationNodeBase::*/ GetElementwiseForwardOp(ElementWiseOperator& op) const override { op = ElementWiseOperator::opDifference; return true; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         size_t rank = DetermineElementwiseTensorRank();
@@ -202,6 +209,8 @@ public:
         ForwardPropImpl(*this, fr, true/*allowBroadcast*/);
     }
 
+    virtual bool /*ComputationNodeBase::*/ GetElementwiseForwardOp(ElementWiseOperator& op) const override { op = ElementWiseOperator::opElementwiseProduct; return true; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         BackpropToImpl(*this, inputIndex, fr, true/*allowBroadcast*/);
@@ -209,6 +218,13 @@ public:
 
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return true; }
 
+    // scaling by a constant, which does not change between forward props of the same input
+    virtual bool /*ComputationNodeBase::*/ CanComputeInPlace() const override
+    {
+        const auto& scale = Input(1);
+        return scale->IsLeaf() && !scale->NeedsGradient() && !scale->HasMBLayout() && scale->GetSampleLayout().GetNumElements() == 1;
+    }
+
     template <typename classType>
     static void ForwardPropImpl(classType& c, const FrameRange& fr, bool allowBroadcast)
     {
@@ -252,7 +268,7 @@ template class ElementTimesNode<double>;
 // -----------------------------------------------------------------------
 
 template <class ElemType, bool m_transpose>
-class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>
+class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>, public IInt8Quantizable, public ICostEstimable
 {
     friend class ElementTimesNode<ElemType>;
 
@@ -260,7 +276,7 @@ class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>
 
 public:
     TimesNodeBase(DEVICEID_TYPE deviceId, const wstring& name, size_t outputRank = 1, int inferInputRankToMap = -1)
-        : Base(deviceId, name), m_outputRank(outputRank), m_inferInputRankToMap(inferInputRankToMap)
+        : Base(deviceId, name), m_outputRank(outputRank), m_inferInputRankToMap(inferInputRankToMap), m_int8InputRange(0), m_int8Calibrating(false), m_packedTimeStamp(0)
     {
     }
 
@@ -272,6 +288,7 @@ public:
             auto node = dynamic_pointer_cast<TimesNodeBase<ElemType, m_transpose>>(nodeP);
             node->m_outputRank          = m_outputRank;
             node->m_inferInputRankToMap = m_inferInputRankToMap;
+            node->m_int8InputRange      = m_int8InputRange;
         }
     }
 
@@ -280,6 +297,14 @@ public:
         Base::Save(fstream);
         fstream << m_outputRank;
         fstream << m_inferInputRankToMap;
+        fstream << m_int8InputRange;
+    }
+
+    virtual bool HasSameComputationAs(const ComputationNodeBase& otherBase) const override
+    {
+        auto other = dynamic_cast<const TimesNodeBase<ElemType, m_transpose>*>(&otherBase);
+        return other && other->m_outputRank == m_outputRank && other->m_inferInputRankToMap == m_inferInputRankToMap &&
+               other->m_int8InputRange == m_int8InputRange && !m_int8Calibrating && !other->m_int8Calibrating;
     }
 
     virtual void Load(File& fstream, size_t modelVersion) override
@@ -293,6 +318,62 @@ public:
             fstream >> m_inferInputRankToMap;
         else
             m_inferInputRankToMap = -1;
+        if (modelVersion >= CNTK_MODEL_VERSION_19)
+            fstream >> m_int8InputRange;
+        else
+            m_int8InputRange = 0;
+    }
+
+    // IInt8Quantizable: the product must be one with weights (see IsWeightProduct())
+    virtual bool IsInt8Quantizable() const override
+    {
+        return IsWeightProduct();
+    }
+
+    virtual void StartInt8Calibration() override
+    {
+        m_int8Calibrating = true;
+        m_int8InputRange = 0;
+        m_int8Multiplier.reset();
+    }
+
+    virtual double EndInt8Calibration() override
+    {
+        m_int8Calibrating = false;
+        return m_int8InputRange;
+    }
+
+    // ICostEstimable: C[m,n] = A[m,k] * B[k,n], where (with A not a minibatch) m*k = |A| and k*n = |B| and m*n = |C| give k
+    virtual NodeCost GetForwardCost() const override
+    {
+        double numA = Base::GetNumElementsInMinibatch(0), numB = Base::GetNumElementsInMinibatch(1), numC = Base::GetNumElementsInMinibatch();
+        return NodeCost{2 * numC * GetInnerDimension(), (numA + numB + numC) * sizeof(ElemType)};
+    }
+
+    virtual NodeCost GetBackwardCost() const override
+    {
+        double numA = Base::GetNumElementsInMinibatch(0), numB = Base::GetNumElementsInMinibatch(1), numC = Base::GetNumElementsInMinibatch();
+        NodeCost cost{0, 0};
+        if (Input(0)->NeedsGradient()) // dA += dC * B'
+        {
+            cost.m_flops += 2 * numC * GetInnerDimension();
+            cost.m_bytes += (numC + numB + 2 * numA) * sizeof(ElemType);
+        }
+        if (Input(1)->NeedsGradient()) // dB += A' * dC
+        {
+            cost.m_flops += 2 * numC * GetInnerDimension();
+            cost.m_bytes += (numC + numA + 2 * numB) * sizeof(ElemType);
+        }
+        return cost;
+    }
+
+private:
+    double GetInnerDimension() const
+    {
+        double numA = Input(0)->GetSampleMatrixNumRows(), numB = Input(1)->GetSampleMatrixNumRows(), numC = GetSampleMatrixNumRows();
+        if (Input(0)->HasMBLayout() || numC == 0)
+            return Input(1)->GetSampleLayout().GetRank() > 0 ? Input(1)->GetSampleLayout()[0] : 1;
+        return sqrt(numA * numB / numC); // (m*k) * (k*n) / (m*n) = k*k per sample
     }
 
 protected:
@@ -311,7 +392,100 @@ protected:
         return TensorView<ElemType>(data, tensorShape);
     }
 
+    // Same as OneSampleTensorFor() but for all samples in 'fr', with one trailing batch axis for TensorView::DoBatchedMatrixProductOf().
+    // Inputs without MBLayout get a batch dimension of 1, i.e. they are shared by all samples.
+    // Returns false if this is not possible, which is the case for sparse data, for inputs with a different MBLayout than the
+    // left argument, if the samples referred to by 'fr' are not consecutive in memory, or with a quantized multiplier.
+    bool BatchedTensorFor(int inputIndex/*-1 for output*/, bool gradient/*instead of value*/, const FrameRange& fr, TensorView<ElemType>& tensor)
+    {
+        if (m_pQuantizedMultiplier)
+            return false;
+        auto input = inputIndex < 0 ? this : Input(inputIndex).get();
+        if ((gradient ? input->Gradient() : input->Value()).GetMatrixType() != DENSE)
+            return false;
+        auto data = gradient ? input->GradientPtr() : input->ValuePtr();
+        size_t rank = input->GetSampleLayout().GetRank();
+        if (inputIndex == 0 && m_transpose && rank == 1)
+            rank = 2;
+        auto tensorShape = input->GetTensorSliceFor(rank, fr);
+        if (!input->HasMBLayout())
+            tensorShape.AppendInPlace(rank, 1);
+        else if (input->GetMBLayout() != InputRef(0).GetMBLayout() || !tensorShape.CanFlatten(rank + 1))
+            return false;
+        else
+        {
+            tensorShape.FlattenInPlace(rank + 1); // (sequence, time) -> one batch axis
+            SmallVector<bool> sequenceAxis(rank + 2, false);
+            sequenceAxis[rank] = true;
+            tensorShape.DropDimsInPlace(sequenceAxis);
+        }
+        tensor = TensorView<ElemType>(data, tensorShape);
+        return true;
+    }
+
 private:
+    // A product of weights and data, A * B with a LearnableParameter A that is not transposed, for which inference
+    // may use the int8 or the packed multiplication
+    bool IsWeightProduct() const
+    {
+        return !m_transpose && !m_pQuantizedMultiplier && dynamic_pointer_cast<LearnableParameter<ElemType>>(Input(0)) != nullptr;
+    }
+
+    // The dimensions of C[m,n] = A[m,k] * B[k,n] as plain matrices on the CPU, A flattened into its first outputRank and its
+    // remaining dimensions. Returns false if the inputs are on the GPU or sparse, or do not flatten that way.
+    bool GetDenseCPUProductDims(const FrameRange& fr, size_t& m, size_t& k, size_t& n)
+    {
+        const auto& matA = InputRef(0).Value();
+        const auto& matB = InputRef(1).Value();
+        if (matA.GetDeviceId() != CPUDEVICE || matB.GetDeviceId() != CPUDEVICE || matA.GetMatrixType() != DENSE || matB.GetMatrixType() != DENSE)
+            return false;
+
+        const auto& shapeA = InputRef(0).GetSampleLayout();
+        m = 1;
+        for (size_t i = 0; i < m_outputRank && i < shapeA.GetRank(); i++)
+            m *= shapeA[i];
+        k = shapeA.GetNumElements() / m;
+        size_t numB = InputRef(1).ValueFor(fr).GetNumElements();
+        n = numB / k;
+        return numB == k * n && ValueFor(fr).GetNumElements() == m * n;
+    }
+
+    // C = A * B with int8 (see IInt8Quantizable). Returns false if that is not possible, i.e. on the GPU or for sparse
+    // inputs, which are multiplied in ElemType.
+    bool ForwardPropInt8(const FrameRange& fr)
+    {
+        size_t m, k, n;
+        if (!GetDenseCPUProductDims(fr, m, k, n))
+            return false;
+
+        if (!m_int8Multiplier)
+            m_int8Multiplier = make_shared<Int8ChannelwiseMultiplier<ElemType>>((ElemType)m_int8InputRange, /*weightsTransposed=*/false);
+        m_int8Multiplier->Multiply((int)m, (int)n, (int)k, InputRef(0).Value().Data(), InputRef(1).ValueFor(fr).Data(), ValueFor(fr).Data());
+        return true;
+    }
+
+    // C = A * B in inference, with the weights packed once (see PackedMatrixMultiplier) instead of in every GEMM, which is
+    // faster for large weights and small minibatches, such as one frame of a recurrence. The weights are repacked when
+    // their value changes. Returns false if the product is not of that kind.
+    bool ForwardPropPacked(const FrameRange& fr)
+    {
+        size_t m, k, n;
+        if (!IsWeightProduct() || !GetDenseCPUProductDims(fr, m, k, n) ||
+            n > PackedMatrixMultiplier<ElemType>::MaxColumns || !PackedMatrixMultiplier<ElemType>::IsWorthPacking(m, k))
+            return false;
+
+        if (!m_packedMultiplier || m_packedTimeStamp != InputRef(0).GetEvalTimeStamp() ||
+            m_packedMultiplier->GetNumRows() != m || m_packedMultiplier->GetNumCols() != k)
+        {
+            if (!m_packedMultiplier)
+                m_packedMultiplier = make_shared<PackedMatrixMultiplier<ElemType>>();
+            m_packedMultiplier->Pack(InputRef(0).Value().Data(), m, k, /*transposeA=*/false);
+            m_packedTimeStamp = InputRef(0).GetEvalTimeStamp();
+        }
+        m_packedMultiplier->Multiply(1, InputRef(1).ValueFor(fr).Data(), n, 0, ValueFor(fr).Data());
+        return true;
+    }
+
     // Check if TimesNodeBase could be simplified to ElementTimes to avoid unroll when:
     // 1. input0: DENSE, is rank-1 and transposed, or is rank-2 with Dim(0)==1
     // 2. input1: DENSE, is rank-1
@@ -342,6 +516,26 @@ private:
 public:
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (m_int8Calibrating)
+        {
+            if (InputRef(1).Value().GetMatrixType() == DENSE)
+                m_int8InputRange = std::max(m_int8InputRange, (double)InputRef(1).ValueFor(fr).MatrixNormInf());
+        }
+        else if (Environment().IsInferring())
+        {
+            if (m_int8InputRange > 0 ? ForwardPropInt8(fr) : ForwardPropPacked(fr))
+                return;
+        }
+        else
+        {
+            // the weights may change while training
+            m_int8Multiplier.reset();
+            m_packedMultiplier.reset();
+        }
+
+        if (ForwardPropValidColumns(fr))
+            return;
+
         // If argument A is minibatch data, then this must be performed frame-by-frame, sequence-by-sequence, one GEMM call each.
         // This will be inefficient. We hope this will be the baseline of a future, more efficient TensorView-based implementation.
         if (!fr.IsOneColumnWrt(InputRef(0).GetMBLayout()))
@@ -353,6 +547,14 @@ public:
                 return;
             }
 
+            // all samples with one batched GEMM call, if their layout permits
+            TensorView<ElemType> input0, input1, output;
+            if (BatchedTensorFor(0, /*gradient=*/false, fr, input0) && BatchedTensorFor(1, /*gradient=*/false, fr, input1) && BatchedTensorFor(-1, /*gradient=*/false, fr, output))
+            {
+                output.AssignBatchedMatrixProductOf(false/*transC*/, input0, m_transpose/*transA*/, input1, false/*transB*/);
+                return;
+            }
+
             // recursively call ourselves for each individual time and sequence
             auto timeRange     = fr.GetTimeRange();
             auto sequenceRange = fr.GetSequenceRange();
@@ -373,6 +575,9 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (BackpropToValidColumns(inputIndex, fr))
+            return;
+
         // special treatment if A is minibatch data; see Forward() for comment
         if (!fr.IsOneColumnWrt(InputRef(0).GetMBLayout()))
         {
@@ -383,6 +588,9 @@ public:
                 return;
             }
 
+            if (BackpropToBatched(inputIndex, fr))
+                return;
+
             auto timeRange     = fr.GetTimeRange();
             auto sequenceRange = fr.GetSequenceRange();
             for (auto t = timeRange.first; t < timeRange.second; t++) // step left to right to allow to build a sparse matrix
@@ -438,6 +646,143 @@ public:
         }
     }
 
+private:
+    // -----------------------------------------------------------------------
+    // packed sequence execution (see ComputationEnvironment::packedSequenceExecution)
+    // A * B for minibatch data B of variable-length sequences is computed on the valid columns of B only, gathered into
+    // a compact matrix; the result is scattered back, with the gap columns set to 0. This skips the products of the gaps,
+    // which are a large part of poorly packed minibatches. The recurrence of OptimizedRNNStack is packed that way already.
+    // -----------------------------------------------------------------------
+
+    // Returns false if not applicable: per-frame calls inside loops, A that is minibatch data, sparse or quantized inputs,
+    // and minibatches with too few gaps to pay for the gather and scatter.
+    // 'aRows' and 'aCols' are the dimensions of A flattened into a matrix (as stored, i.e. before the transposition).
+    bool UseValidColumnsOnly(const FrameRange& fr, size_t& aRows, size_t& aCols)
+    {
+        if (!GetEnvironmentPtr() || !Environment().packedSequenceExecution || !fr.IsAllFrames() || m_pQuantizedMultiplier)
+            return false;
+        if (InputRef(0).HasMBLayout() || !InputRef(1).HasMBLayout() || InputRef(1).GetMBLayout() != GetMBLayout() ||
+            InputRef(0).Value().GetMatrixType() != DENSE || InputRef(1).Value().GetMatrixType() != DENSE)
+            return false;
+
+        const auto& mb = *GetMBLayout();
+        const size_t numCols = mb.GetNumCols();
+        if (!mb.HasGaps() || mb.GetActualNumSamples() * 8 > numCols * 7) // (at least 1/8 gaps)
+            return false;
+
+        const auto& shapeA = InputRef(0).GetSampleLayout();
+        aRows = 1;
+        for (size_t i = 0; i < m_outputRank && i < shapeA.GetRank(); i++)
+            aRows *= shapeA[i];
+        aCols = shapeA.GetNumElements() / aRows;
+        const size_t m = m_transpose ? aCols : aRows;
+        const size_t k = m_transpose ? aRows : aCols;
+        if ((m_transpose && shapeA.GetRank() > 2) || InputRef(1).GetSampleLayout().GetNumElements() != k || GetSampleLayout().GetNumElements() != m)
+            return false;
+
+        // the index of the valid columns, rebuilt when the structure of the minibatch changes
+        if (!m_validColumns || m_validColumnsNumTimeSteps != mb.GetNumTimeSteps() || m_validColumnsNumParallelSequences != mb.GetNumParallelSequences() ||
+            !MBLayout::HaveSameStructure(m_validColumnsSequences, mb.GetAllSequences()))
+        {
+            vector<char> isValid(numCols, 0);
+            for (const auto& seq : mb.GetAllSequences())
+            {
+                if (seq.seqId == GAP_SEQUENCE_ID)
+                    continue;
+                for (size_t t = (size_t) max(seq.tBegin, (ptrdiff_t) 0); t < min(seq.tEnd, mb.GetNumTimeSteps()); t++)
+                    isValid[t * mb.GetNumParallelSequences() + seq.s] = 1;
+            }
+            vector<ElemType> validColumns;
+            for (size_t j = 0; j < numCols; j++)
+                if (isValid[j])
+                    validColumns.push_back((ElemType) j);
+            if (!m_validColumns)
+                m_validColumns = make_shared<Matrix<ElemType>>(InputRef(1).Value().GetDeviceId());
+            m_validColumns->SetValue(1, validColumns.size(), InputRef(1).Value().GetDeviceId(), validColumns.data());
+            m_validColumnsNumTimeSteps = mb.GetNumTimeSteps();
+            m_validColumnsNumParallelSequences = mb.GetNumParallelSequences();
+            m_validColumnsSequences = mb.GetAllSequences();
+        }
+        if (!m_compactedB)
+        {
+            m_compactedB = make_shared<Matrix<ElemType>>(InputRef(1).Value().GetDeviceId());
+            m_compactedC = make_shared<Matrix<ElemType>>(InputRef(1).Value().GetDeviceId());
+        }
+        return true;
+    }
+
+    bool ForwardPropValidColumns(const FrameRange& fr)
+    {
+        size_t aRows, aCols;
+        if (!UseValidColumnsOnly(fr, aRows, aCols))
+            return false;
+
+        const auto a = InputRef(0).Value().Reshaped(aRows, aCols);
+        m_compactedB->DoGatherColumnsOf(0, *m_validColumns, InputRef(1).Value(), 1);
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, a, m_transpose, *m_compactedB, false, 0, *m_compactedC);
+        Value().DoScatterColumnsOf(0, *m_validColumns, *m_compactedC, 1);
+        return true;
+    }
+
+    bool BackpropToValidColumns(const size_t inputIndex, const FrameRange& fr)
+    {
+        size_t aRows, aCols;
+        if (!UseValidColumnsOnly(fr, aRows, aCols) || (inputIndex == 0 && InputRef(0).Gradient().GetMatrixType() != DENSE))
+            return false;
+
+        const ElemType beta = Input(inputIndex)->ParentOverwritesGradient() ? 0 : 1;
+        m_compactedC->DoGatherColumnsOf(0, *m_validColumns, Gradient(), 1);
+        if (inputIndex == 0) // left derivative: dA += dC * B' (or B * dC' if A is transposed)
+        {
+            auto inputGradient = InputRef(0).Gradient().Reshaped(aRows, aCols);
+            m_compactedB->DoGatherColumnsOf(0, *m_validColumns, InputRef(1).Value(), 1);
+            if (m_transpose)
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_compactedB, false, *m_compactedC, true, beta, inputGradient);
+            else
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_compactedC, false, *m_compactedB, true, beta, inputGradient);
+        }
+        else // right derivative: dB += A' * dC (or A * dC if A is transposed), into the valid columns
+        {
+            const auto a = InputRef(0).Value().Reshaped(aRows, aCols);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, a, !m_transpose, *m_compactedC, false, 0, *m_compactedB);
+            InputRef(1).Gradient().DoScatterColumnsOf(beta, *m_validColumns, *m_compactedB, 1);
+        }
+        return true;
+    }
+
+    // BackpropTo() for all samples with one batched GEMM call, if A is minibatch data (see ForwardProp()). Returns false if not possible.
+    // The gradient of a B without MBLayout would be a sum over the batch, which the batched GEMM cannot write, so it is left to the per-sample path.
+    bool BackpropToBatched(const size_t inputIndex, const FrameRange& fr)
+    {
+        if (inputIndex == 1 && !InputRef(1).HasMBLayout())
+            return false;
+
+        TensorView<ElemType> input0, input1, outputGradient, inputGradient;
+        if (!BatchedTensorFor(-1, /*gradient=*/true, fr, outputGradient) || !BatchedTensorFor(inputIndex, /*gradient=*/true, fr, inputGradient))
+            return false;
+
+        if (inputIndex == 0) // left derivative
+        {
+            if (!BatchedTensorFor(1, /*gradient=*/false, fr, input1))
+                return false;
+            if (Input(inputIndex)->ParentOverwritesGradient())
+                inputGradient.AssignBatchedMatrixProductOf(m_transpose/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/);
+            else
+                inputGradient.AddBatchedMatrixProductOf(m_transpose/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/);
+        }
+        else // right derivative
+        {
+            if (!BatchedTensorFor(0, /*gradient=*/false, fr, input0))
+                return false;
+            if (Input(inputIndex)->ParentOverwritesGradient())
+                inputGradient.AssignBatchedMatrixProductOf(false/*transC*/, input0, !m_transpose/*transA*/, outputGradient, false/*transB*/);
+            else
+                inputGradient.AddBatchedMatrixProductOf(false/*transC*/, input0, !m_transpose/*transA*/, outputGradient, false/*transB*/);
+        }
+        return true;
+    }
+
+public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     // but both *inputs* are used, so we don't overload the InputUsed-() function which defaults to 'true'
 
@@ -569,25 +914,18 @@ public:
 
     virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
     {
-        // this is a special handling case. We need to allocate sparse matrix directly instead of from pool.
+        // this is a special handling case. If the input data is sparse, the gradient of the weights is block sparse.
+        // We request a sparse matrix from the pool instead of switching the type in place,
+        // since switching in place may affect other nodes who share this matrix due to memory sharing.
+        // (Its nonzeros are bounded by the size of the weights.)
         if (Input(0)->NeedsGradient() && Input(1)->Value().GetMatrixType() == SPARSE)
         {
-            Input(0)->CreateGradientMatrixIfNull();
-
-            // We need a sparse matrix for the gradient. We allocate a new one instead of switching the type in place
-            // since switching in place may affect other nodes who share this matrix due to memory sharing
-            auto& currentInput0GradientMatrixRef = InputRef(0).Gradient();
-            if (currentInput0GradientMatrixRef.GetMatrixType() != SPARSE)
+            auto& input0GradientPtr = InputRef(0).GradientPtrRef();
+            if (!input0GradientPtr || input0GradientPtr->GetMatrixType() != SPARSE)
             {
-                auto newInput0SparseGradientMatrix = std::make_shared<Matrix<ElemType>>(currentInput0GradientMatrixRef.GetNumRows(),
-                                                                                        currentInput0GradientMatrixRef.GetNumCols(),
-                                                                                        currentInput0GradientMatrixRef.GetPreferredDeviceId(),
-                                                                                        SPARSE,
-                                                                                        MatrixFormat::matrixFormatSparseBlockCol);
-
                 // BUGBUG: Copy over the current contents since we accumulate into the gradient matrix instead of overwriting the content
-                // newInput0SparseGradientMatrix.AssignValuesOf(currentInput0GradientMatrixRef);
-                InputRef(0).GradientPtrRef() = newInput0SparseGradientMatrix;
+                input0GradientPtr = matrixPool.RequestSparse<ElemType>(Input(0)->GetDeviceId(), matrixFormatSparseBlockCol,
+                                                                       Input(0)->GetSampleLayout().GetNumElements(), Input(0)->HasMBLayout());
             }
         }
 
@@ -605,6 +943,24 @@ protected:
 private:
     size_t m_outputRank;
     int m_inferInputRankToMap;  // -1 (not specified) or says how to expand shape of W, to keep this many mapping dims
+
+    // int8 inference (see IInt8Quantizable); the range is 0 if the node is not quantized
+    double m_int8InputRange;
+    bool m_int8Calibrating;
+    shared_ptr<Int8ChannelwiseMultiplier<ElemType>> m_int8Multiplier;
+
+    // weights packed for inference, and the time stamp of their value (see ForwardPropPacked())
+    shared_ptr<PackedMatrixMultiplier<ElemType>> m_packedMultiplier;
+    uint64_t m_packedTimeStamp;
+
+    // packed sequence execution: the indices of the valid columns, the structure of the minibatch they are for,
+    // and the compacted B and C (see UseValidColumnsOnly())
+    shared_ptr<Matrix<ElemType>> m_validColumns;
+    size_t m_validColumnsNumTimeSteps = 0;
+    size_t m_validColumnsNumParallelSequences = 0;
+    vector<MBLayout::SequenceInfo> m_validColumnsSequences;
+    shared_ptr<Matrix<ElemType>> m_compactedB;
+    shared_ptr<Matrix<ElemType>> m_compactedC;
 };
 
 // -----------------------------------------------------------------------
@@ -1138,13 +1494,18 @@ template class KhatriRaoProductNode<float>;
 template class KhatriRaoProductNode<double>;
 
 // -----------------------------------------------------------------------
-// CosDistanceWithNegativeSamplesNode (left, right, shift, neg)
+// CosDistanceWithNegativeSamplesNode (left, right, shift, neg, inBatchNegatives=false)
 //
 // Left and right forms pairs of positive samples. They are symmetric but usually
 // the search key is used as the left. For example, Left is search query and right is document.
 // The negative samples are formed on the fly by shifting the right side.
 // The 'shift' indicates how many samples in the right node you should shift to form each negative sample pair.
 // It is often choose to be one. 'Neg' indicates how many negative samples you want to generate.
+// With inBatchNegatives, the negatives of each left sample are instead the 'neg' right samples of the minibatch
+// that are most similar to it (and 'shift' is ignored).
+//
+// The cosines of all left with all right samples are computed at once, as a single GEMM of the normalized
+// columns, from which the pairs are picked (see CosineWithNegativeSamples.h); the gradients are a GEMM each as well.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -1158,155 +1519,94 @@ class CosDistanceWithNegativeSamplesNode : public ComputationNode<ElemType>, pub
     }
 
 public:
-    DeclareConstructorFromConfigWithNumInputs(CosDistanceWithNegativeSamplesNode);
-    CosDistanceWithNegativeSamplesNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+    CosDistanceWithNegativeSamplesNode(DEVICEID_TYPE deviceId, const wstring& name, bool inBatchNegatives = false)
+        : Base(deviceId, name), m_inBatchNegatives(inBatchNegatives)
     {
     }
-
-    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    CosDistanceWithNegativeSamplesNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : CosDistanceWithNegativeSamplesNode(configp->Get(L"deviceId"), L"<placeholder>")
     {
-        Matrix<ElemType> sliceInput0Value = InputRef(0).ValueFor(fr);
-        Matrix<ElemType> sliceInput1Value = InputRef(1).ValueFor(fr);
-        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
-        Matrix<ElemType> sliceInputGrad = Input(inputIndex)->GradientFor(fr);
-        Matrix<ElemType> sliceThisGrad = GradientFor(fr);
-
-        BackpropToS(inputIndex, *m_invNorm0, *m_invNorm1, sliceOutputValue, *m_temp, *m_rightTerm, *m_leftTerm, *m_invNormSquare, sliceInput0Value, sliceInput1Value, InputRef(2).Value(), InputRef(3).Value(), sliceInputGrad, sliceThisGrad);
+        if (configp->Exists(L"inBatchNegatives"))
+            m_inBatchNegatives = configp->Get(L"inBatchNegatives");
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
     }
 
-    // functionValues, invNorm0, invNorm1 - output from the EvaluateNode() method
-    // temp, rightTerm, leftTerm - temporary matrices
-    // in0, in1, in2, in3 - input functionValues from other nodes
-    // inputGradientValues(x) - gradients to update, where x matches inputIndex
-    /*TODO: merge with call site*/ void BackpropToS(const size_t inputIndex, const Matrix<ElemType>& invNorm0, const Matrix<ElemType>& invNorm1, const Matrix<ElemType>& functionValues,
-                                                    Matrix<ElemType>& temp, Matrix<ElemType>& rightTerm, Matrix<ElemType>& leftTerm, Matrix<ElemType>& invNormSquare, // the temporary variables
-                                                    const Matrix<ElemType>& in0, const Matrix<ElemType>& in1, const Matrix<ElemType>& in2, const Matrix<ElemType>& in3,
-                                                    Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& thisGradientValues)
+    virtual void Save(File& fstream) const override
     {
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-        size_t numCols = in0.GetNumCols(); // used in computing right child's graident
-
-        if (inputIndex == 0) // left derivative
-        {
-            invNormSquare.AssignElementProductOf(invNorm0, invNorm0);
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-                temp.ElementMultiplyWith(invNormSquare);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, rightTerm, 0, true);
-
-                if (m == 0)
-                {
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, 0, true);
-                }
-                else
-                {
-                    size_t currshift = m + shift - 1; // for current line, how much should we shift
-
-                    temp.AssignElementProductOfWithShift(invNorm0, invNorm1, currshift); // this is a row vector
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, currshift, true);
-                }
-
-                leftTerm -= rightTerm;
-
-                temp.GetARowByIndex(thisGradientValues, m);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                inputGradientValues += rightTerm;
-            }
-        }
-        else // right part
-        {
-            invNormSquare.AssignElementProductOf(invNorm1, invNorm1); // this matrix should be save and unchanged. It should not be changed
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-
-                if (m == 0) // this is the first line. computation should be symmetric
-                {
-                    // the following is for the right part
-                    temp.ElementMultiplyWith(invNormSquare);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, rightTerm, 0, true);
-
-                    // the following is for the left part
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, 0, true);
-
-                    leftTerm -= rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                    inputGradientValues += rightTerm;
-                }
-                else // this requires shift
-                {
-                    size_t currshift = (m + shift - 1) % numCols;
-                    size_t reverseshift = numCols - currshift;
+        Base::Save(fstream);
+        fstream << m_inBatchNegatives;
+    }
 
-                    leftTerm.AssignElementProductOfWithShift(invNormSquare, temp, reverseshift); // use leftTerm as a temp variable here
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        if (modelVersion >= CNTK_MODEL_VERSION_23)
+            fstream >> m_inBatchNegatives;
+    }
 
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(leftTerm, in1, rightTerm, 0, true);
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        if (inputIndex > 1) // the shift and the number of negatives are constants
+            return;
 
-                    temp.AssignElementProductOfWithShift(invNorm1, invNorm0, reverseshift);
+        // gaps must not pass gradients on to the samples they were paired with
+        MaskMissingGradientColumnsToZero(fr);
+        Matrix<ElemType> sliceThisGrad = GradientFor(fr);
+        Matrix<ElemType> sliceDocuments = DataFor(*m_documents, fr);
+        m_gradientMatrix->AssignNegativeSamplesGradientMatrix(sliceThisGrad, sliceDocuments);
 
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, reverseshift, true);
+        // gradient of the normalized columns: the left ones are paired with the rows of the gradient matrix, the right ones with its columns
+        Matrix<ElemType> sliceNormalized0 = DataFor(*m_normalized0, fr);
+        Matrix<ElemType> sliceNormalized1 = DataFor(*m_normalized1, fr);
+        if (inputIndex == 0)
+            Matrix<ElemType>::Multiply(sliceNormalized1, false, *m_gradientMatrix, true, *m_temp);
+        else
+            Matrix<ElemType>::Multiply(sliceNormalized0, false, *m_gradientMatrix, false, *m_temp);
 
-                    leftTerm -= rightTerm;
+        Matrix<ElemType> sliceInputGrad = Input(inputIndex)->GradientFor(fr);
+        Matrix<ElemType> sliceInvNorm = DataFor(inputIndex == 0 ? *m_invNorm0 : *m_invNorm1, fr);
+        sliceInputGrad.AddColumnNormalizationGradient(*m_temp, inputIndex == 0 ? sliceNormalized0 : sliceNormalized1, sliceInvNorm);
+    }
 
-                    temp.GetARowByIndex(thisGradientValues, m);
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, reverseshift, false);
+    virtual void UpdateFunctionMBSize() override
+    {
+        Base::UpdateFunctionMBSize();
 
-                    inputGradientValues += rightTerm;
-                }
-            }
-        }
+        size_t numCols = Input(0)->GetSampleMatrixNumCols();
+        size_t dim = Input(0)->GetSampleMatrixNumRows();
+        m_invNorm0->Resize(1, numCols);
+        m_invNorm1->Resize(1, numCols);
+        m_normalized0->Resize(dim, numCols);
+        m_normalized1->Resize(dim, numCols);
+        m_documents->Resize(GetSampleMatrixNumRows(), numCols);
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        // gaps become zero vectors, of cosine 0 with everything
+        InputRef(0).MaskMissingValueColumnsToZero(fr);
+        InputRef(1).MaskMissingValueColumnsToZero(fr);
+
         Matrix<ElemType> sliceInput0Value = InputRef(0).ValueFor(fr);
         Matrix<ElemType> sliceInput1Value = InputRef(1).ValueFor(fr);
+        Matrix<ElemType> sliceInvNorm0 = DataFor(*m_invNorm0, fr);
+        Matrix<ElemType> sliceInvNorm1 = DataFor(*m_invNorm1, fr);
+        Matrix<ElemType> sliceNormalized0 = DataFor(*m_normalized0, fr);
+        Matrix<ElemType> sliceNormalized1 = DataFor(*m_normalized1, fr);
+        NormalizeColumns(sliceInput0Value, sliceInvNorm0, sliceNormalized0);
+        NormalizeColumns(sliceInput1Value, sliceInvNorm1, sliceNormalized1);
+
+        // the cosines of all left with all right samples, of which the pairs are picked
+        Matrix<ElemType>::Multiply(sliceNormalized0, true, sliceNormalized1, false, *m_similarities);
+
+        size_t shift = (size_t) InputRef(2).Get00Element();
+        size_t negNumber = (size_t) InputRef(3).Get00Element();
+        Matrix<ElemType> sliceDocuments = DataFor(*m_documents, fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
-
-        ForwardPropS(*m_invNorm0, *m_invNorm1, sliceOutputValue, sliceInput0Value, sliceInput1Value, InputRef(2).Value(), InputRef(3).Value(), *m_leftTerm, *m_rightTerm);
-    }
-
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& invNorm0, Matrix<ElemType>& invNorm1, Matrix<ElemType>& functionValues, Matrix<ElemType>& in0, Matrix<ElemType>& in1, Matrix<ElemType>& in2, Matrix<ElemType>& in3, Matrix<ElemType>& leftTermTemp, Matrix<ElemType>& rightTermTemp)
-    {
-        invNorm0.AssignVectorNorm2Of(in0, true); // seems to modify input (in0)
-        invNorm0.AssignElementInverseOf(invNorm0);
-
-        invNorm1.AssignVectorNorm2Of(in1, true); // seems to modify the input (in1)
-        invNorm1.AssignElementInverseOf(invNorm1);
-
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-
-        // mutiply invNorm0 and invNorm1 with shift and neg.
-        // The result is a matrix of (numberneg+1, invNorm0.Cols)
-        leftTermTemp.AssignElementProductOfWithShiftNeg(invNorm0, invNorm1, shift, negNumber);
-
-        // compute the right values
-        // Again, the output is a matrix of (negNumber+1, invNorm0.cols)
-        rightTermTemp.AssignInnerProductOfWithShiftNeg(in0, in1, true, shift, negNumber);
-
-        // compute the evaluation result matrix by multiply these two matrices, element by element
-        // we get a (negNumber+1, n) matrix
-        functionValues.AssignElementProductOf(leftTermTemp, rightTermTemp);
+        sliceOutputValue.AssignSimilaritiesWithNegativeSamples(*m_similarities, shift, negNumber, m_inBatchNegatives, sliceDocuments);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -1335,12 +1635,12 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CosDistanceWithNegativeSamplesNode<ElemType>>(nodeP);
+            node->m_inBatchNegatives = m_inBatchNegatives;
             node->m_invNorm0->SetValue(*m_invNorm0);
             node->m_invNorm1->SetValue(*m_invNorm1);
-            node->m_invNormSquare->SetValue(*m_invNormSquare);
-            node->m_leftTerm->SetValue(*m_leftTerm);
-            node->m_rightTerm->SetValue(*m_rightTerm);
-            node->m_temp->SetValue(*m_temp);
+            node->m_normalized0->SetValue(*m_normalized0);
+            node->m_normalized1->SetValue(*m_normalized1);
+            node->m_documents->SetValue(*m_documents);
         }
     }
     // request matrices needed to do node function value evaluation
@@ -1349,15 +1649,24 @@ public:
         Base::RequestMatricesBeforeForwardProp(matrixPool);
         RequestMatrixFromPool(m_invNorm0, matrixPool);
         RequestMatrixFromPool(m_invNorm1, matrixPool);
-        RequestMatrixFromPool(m_leftTerm, matrixPool);
-        RequestMatrixFromPool(m_rightTerm, matrixPool);
+        RequestMatrixFromPool(m_normalized0, matrixPool);
+        RequestMatrixFromPool(m_normalized1, matrixPool);
+        RequestMatrixFromPool(m_documents, matrixPool);
+        RequestMatrixFromPool(m_similarities, matrixPool);
+    }
+
+    // release temp matrices that are only used by forward computation
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool)
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_similarities, matrixPool);
     }
 
     // request matrices that are needed for gradient computation
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_invNormSquare, matrixPool);
+        RequestMatrixFromPool(m_gradientMatrix, matrixPool);
         RequestMatrixFromPool(m_temp, matrixPool);
     }
 
@@ -1367,20 +1676,34 @@ public:
         Base::ReleaseMatricesAfterBackprop(matrixPool);
         ReleaseMatrixToPool(m_invNorm0, matrixPool);
         ReleaseMatrixToPool(m_invNorm1, matrixPool);
-        ReleaseMatrixToPool(m_leftTerm, matrixPool);
-        ReleaseMatrixToPool(m_rightTerm, matrixPool);
-        ReleaseMatrixToPool(m_invNormSquare, matrixPool);
+        ReleaseMatrixToPool(m_normalized0, matrixPool);
+        ReleaseMatrixToPool(m_normalized1, matrixPool);
+        ReleaseMatrixToPool(m_documents, matrixPool);
+        ReleaseMatrixToPool(m_gradientMatrix, matrixPool);
         ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
 private:
-    // invNorm nodes tranfer data between ForwardProp and BackpropTo
+    // invNorms = 1 / |x|, normalized = x / |x|, per column
+    static void NormalizeColumns(Matrix<ElemType>& input, Matrix<ElemType>& invNorms, Matrix<ElemType>& normalized)
+    {
+        invNorms.AssignVectorNorm2Of(input, true);
+        invNorms.AssignElementInverseOf(invNorms);
+        normalized.SetValue(input);
+        normalized.RowElementMultiplyWith(invNorms);
+    }
+
+    bool m_inBatchNegatives;
+
+    // transfer data between ForwardProp and BackpropTo
     shared_ptr<Matrix<ElemType>> m_invNorm0;
     shared_ptr<Matrix<ElemType>> m_invNorm1;
-    shared_ptr<Matrix<ElemType>> m_leftTerm;
-    shared_ptr<Matrix<ElemType>> m_rightTerm;
+    shared_ptr<Matrix<ElemType>> m_normalized0;
+    shared_ptr<Matrix<ElemType>> m_normalized1;
+    shared_ptr<Matrix<ElemType>> m_documents; // the right column of each pair
     // the rest are temporaries, values don't need to be maintained
-    shared_ptr<Matrix<ElemType>> m_invNormSquare;
+    shared_ptr<Matrix<ElemType>> m_similarities;
+    shared_ptr<Matrix<ElemType>> m_gradientMatrix;
     shared_ptr<Matrix<ElemType>> m_temp;
 };
 
@@ -1430,6 +1753,8 @@ public:
 
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
+    virtual bool ForwardPropIsRepeatable() const override { return false; } // (ForwardProp() accumulates)
+
     virtual void OnEpochStart() override;
 
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
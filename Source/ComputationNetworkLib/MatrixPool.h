@@ -9,6 +9,8 @@
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
+#include <map>
 #include <stdlib.h>
 
 #include "Basics.h"
@@ -20,25 +22,154 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
+//
+// Matrix assignment is planned once, in ComputationNetwork::AllocateAllMatrices(), which simulates the lifetimes
+// of all node matrices by calling Request() and Release() in evaluation order. At that point the matrices are still
+// empty, so each request carries a size hint: the number of elements per column (per sample) if the matrix
+// scales with the minibatch, or the total number of elements otherwise. Released buffers are grouped by
+// (device, minibatch-scaled, power-of-two size class), and Request() picks the best-fitting one:
+//  - the smallest buffer that is at least as large as the request, or, failing that,
+//  - the largest buffer that is smaller than the request (it will grow, but less memory is wasted than
+//    by keeping a large buffer pinned to a small node).
+// Buffers are never handed across devices, and buffers whose size scales with the minibatch are never
+// handed to requests that do not (and vice versa), since their actual sizes are not comparable.
+// Sparse matrices (RequestSparse()) are shared the same way, but only with requests of the same format (CSC, CSR or
+// block-column); for them, the size is the number of nonzeros, so a released sparse matrix is handed to the request
+// whose nonzeros best fit the capacity of its nonzero buffer.
+//
+// With a static plan (EnableStaticPlan()), node values and gradients are not shared greedily. Instead, the simulation
+// gives each of them a matrix of its own and records its lifetime, and PlanStaticMemory() then places all of them at
+// offsets in one arena per device, for minibatches of up to a given number of columns. This is an interval-packing
+// problem over the lifetimes, solved greedily by decreasing size: each matrix goes to the lowest offset at which it
+// does not overlap a larger matrix that lives at the same time. The matrices become views into the arena, so that
+// resizing them from minibatch to minibatch does not allocate. Temporary matrices of nodes, whose sizes are not known
+// from the node's sample layout, are still shared greedily.
 class MatrixPool
 {
-    vector<shared_ptr<Matrix<float>>>  m_releasedFloatMatrices;
-    vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
+public:
+    // a request as recorded by the pool: the size is the largest hint of all requests that shared this buffer
+    struct MemRequestInfo
+    {
+        DEVICEID_TYPE deviceId;
+        size_t numElements;  // per column if mbScaled, otherwise total (for sparse matrices: nonzeros)
+        bool mbScaled;       // buffer size scales with the minibatch size
+        MatrixFormat format; // buffers are only shared between requests of the same format
+
+        MemRequestInfo() : deviceId(CPUDEVICE), numElements(0), mbScaled(true), format(matrixFormatDense) {}
+        MemRequestInfo(DEVICEID_TYPE deviceId, size_t numElements, bool mbScaled, MatrixFormat format = matrixFormatDense)
+            : deviceId(deviceId), numElements(numElements), mbScaled(mbScaled), format(format) {}
+
+        // power-of-two size class this request falls into
+        size_t SizeClass() const
+        {
+            size_t sizeClass = 0;
+            for (size_t n = numElements; n > 1; n >>= 1)
+                sizeClass++;
+            return sizeClass;
+        }
+    };
 
+private:
     template <class ElemType>
-    vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
+    struct PoolState
+    {
+        vector<shared_ptr<Matrix<ElemType>>> m_releasedMatrices;
+        unordered_map<const Matrix<ElemType>*, MemRequestInfo> m_requestInfo;   // planned size of every matrix that went through the pool
+        vector<weak_ptr<Matrix<ElemType>>> m_allMatrices;                       // all distinct buffers handed out, for memory accounting
+        unordered_map<shared_ptr<Matrix<ElemType>>, size_t> m_plannedMatrices;  // static plan: node values and gradients -> index into m_lifetimes
+    };
+
+    // static plan: a node value or gradient, from its request until its release (SIZE_MAX if never released)
+    struct Lifetime
+    {
+        MemRequestInfo info;
+        size_t elementSize;
+        size_t begin;
+        size_t end;
+        size_t numBytes; // (set by PlanStaticMemory())
+        size_t offset;
+    };
+
+    bool m_staticPlan = false;
+    size_t m_time = 0;              // static plan: position of the next request or release
+    vector<Lifetime> m_lifetimes;   // static plan: of all node values and gradients, in the order of their request
+    vector<shared_ptr<Matrix<char>>> m_arenas;
+    size_t m_plannedMaxColumns = 0;
+    size_t m_plannedPeakBytes = 0;  // largest total size of the matrices that live at the same time
+    size_t m_arenaBytes = 0;        // total size of the arenas
+
+    PoolState<float>  m_floatState;
+    PoolState<double> m_doubleState;
+
+    template <class ElemType>
+    PoolState<ElemType>& GetState();
+
+    template <class ElemType>
+    const PoolState<ElemType>& GetState() const
+    {
+        return const_cast<MatrixPool*>(this)->GetState<ElemType>();
+    }
+
+    // find the index of the best-fitting released matrix for a request, or -1 if there is none
+    template <class ElemType>
+    int FindBestFit(const MemRequestInfo& request) const
+    {
+        const PoolState<ElemType>& state = GetState<ElemType>();
+        const size_t requestedClass = request.SizeClass();
+        int bestIndex = -1;
+        bool bestIsLargeEnough = false;
+        size_t bestSizeClass = 0;
+        size_t bestNumElements = 0;
+        for (int i = 0; i < (int) state.m_releasedMatrices.size(); i++)
+        {
+            const auto& matrix = state.m_releasedMatrices[i];
+            auto iter = state.m_requestInfo.find(matrix.get());
+            MemRequestInfo info = (iter != state.m_requestInfo.end()) ? iter->second : MemRequestInfo(matrix->GetDeviceId(), 0, request.mbScaled, matrix->GetFormat());
+            if (info.deviceId != request.deviceId || info.mbScaled != request.mbScaled || info.format != request.format)
+                continue;
+
+            const size_t sizeClass = info.SizeClass();
+            const bool isLargeEnough = sizeClass >= requestedClass;
+            bool isBetter;
+            if (bestIndex < 0)
+                isBetter = true;
+            else if (isLargeEnough != bestIsLargeEnough)
+                isBetter = isLargeEnough;                // a buffer that fits beats one that would have to grow
+            else if (sizeClass != bestSizeClass)
+                isBetter = isLargeEnough ? (sizeClass < bestSizeClass) : (sizeClass > bestSizeClass);
+            else if (isLargeEnough)
+                isBetter = info.numElements < bestNumElements; // within the same class, prefer the tightest fit
+            else
+                isBetter = info.numElements > bestNumElements;
+
+            if (isBetter)
+            {
+                bestIndex = i;
+                bestIsLargeEnough = isLargeEnough;
+                bestSizeClass = sizeClass;
+                bestNumElements = info.numElements;
+            }
+        }
+        return bestIndex;
+    }
 
 public:
     // release here means the matrix can be put back and shared by others
     template <class ElemType>
     void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
     {
-        if (freeMatrix == nullptr || freeMatrix->GetMatrixType() == SPARSE)
-            LogicError("MatrixPool::Release: freeMatrix should not be null or sparse.");
+        if (freeMatrix == nullptr)
+            LogicError("MatrixPool::Release: freeMatrix should not be null.");
 //#define SUPRESS_MEMSHARING // #define this to disable memory sharing through this structure
         // TODO: Make this a runtime option.
+        auto planned = GetState<ElemType>().m_plannedMatrices.find(freeMatrix);
+        if (planned != GetState<ElemType>().m_plannedMatrices.end())
+        {
+            m_lifetimes[planned->second].end = m_time++;
+            return;
+        }
 #ifndef SUPRESS_MEMSHARING
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetState<ElemType>().m_releasedMatrices;
 #ifdef _DEBUG
         for (int i = 0; i < releasedMatrices.size(); i++)
         {
@@ -47,23 +178,69 @@ public:
         }
 
 #endif
+        // a matrix may have changed its format since it was requested (e.g. a node that made its value sparse in validation)
+        auto iter = GetState<ElemType>().m_requestInfo.find(freeMatrix.get());
+        if (iter != GetState<ElemType>().m_requestInfo.end())
+            iter->second.format = freeMatrix->GetFormat();
         releasedMatrices.push_back(freeMatrix);
 #endif
     }
 
+    // request a matrix on 'deviceId' that is expected to hold 'numElements' elements
+    // (per column if 'mbScaled', since the minibatch size is not known at planning time)
+    // 'isNodeOutput' marks node values and gradients, whose size is exactly that, and which a static plan places.
+    template <class ElemType>
+    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId, size_t numElements = 0, bool mbScaled = true, bool isNodeOutput = false)
+    {
+        PoolState<ElemType>& state = GetState<ElemType>();
+        MemRequestInfo request(deviceId, numElements, mbScaled);
+        if (m_staticPlan && isNodeOutput && numElements > 0)
+        {
+            auto matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            state.m_plannedMatrices[matrixPtr] = m_lifetimes.size();
+            m_lifetimes.push_back(Lifetime{ request, sizeof(ElemType), m_time++, SIZE_MAX, 0, 0 });
+            return matrixPtr;
+        }
+        return RequestShared<ElemType>(request);
+    }
+
+    // request a sparse matrix of the given format on 'deviceId' that is expected to hold 'numNonZeros' nonzeros
+    // (per column if 'mbScaled'), e.g. the block-column gradient of weights applied to a sparse input
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    shared_ptr<Matrix<ElemType>> RequestSparse(DEVICEID_TYPE deviceId, MatrixFormat format, size_t numNonZeros, bool mbScaled)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        if (format == matrixFormatDense || format == matrixFormatDenseRowMajor) // (the block formats carry no sparse bit)
+            LogicError("MatrixPool::RequestSparse: The format must be sparse.");
+        return RequestShared<ElemType>(MemRequestInfo(deviceId, numNonZeros, mbScaled, format));
+    }
+
+private:
+    template <class ElemType>
+    shared_ptr<Matrix<ElemType>> RequestShared(const MemRequestInfo& request)
+    {
+        PoolState<ElemType>& state = GetState<ElemType>();
         shared_ptr<Matrix<ElemType>> matrixPtr;
-        if (releasedMatrices.empty())
+        int bestIndex = FindBestFit<ElemType>(request);
+        if (bestIndex < 0)
         {
-            matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            if (request.format == matrixFormatDense)
+                matrixPtr = make_shared<Matrix<ElemType>>(request.deviceId);
+            else
+                matrixPtr = make_shared<Matrix<ElemType>>(0, 0, request.deviceId, SPARSE, request.format);
+            state.m_allMatrices.push_back(matrixPtr);
+            state.m_requestInfo[matrixPtr.get()] = request; // (overwrites a stale entry of a matrix that lived at this address)
         }
         else
         {
-            matrixPtr = releasedMatrices.back();
-            releasedMatrices.pop_back();
+            matrixPtr = state.m_releasedMatrices[bestIndex];
+            state.m_releasedMatrices.erase(state.m_releasedMatrices.begin() + bestIndex);
+
+            // the planned size of a shared buffer is the largest of all requests it serves
+            auto& info = state.m_requestInfo[matrixPtr.get()];
+            info.deviceId = request.deviceId;
+            info.mbScaled = request.mbScaled;
+            info.format = request.format;
+            info.numElements = max(info.numElements, request.numElements);
         }
 
         if (!matrixPtr) // this can't really happen
@@ -71,6 +248,163 @@ public:
 
         return matrixPtr;
     }
+
+public:
+
+    // static plan, see class comment; must be enabled before the first request
+    void EnableStaticPlan()
+    {
+        if (m_time > 0 || !m_lifetimes.empty())
+            LogicError("MatrixPool::EnableStaticPlan: Must be enabled before matrices are requested.");
+        m_staticPlan = true;
+    }
+
+    bool HasStaticPlan() const { return m_staticPlan; }
+
+    // place all node values and gradients requested so far into one arena per device, for up to 'maxColumns' columns
+    // of the minibatch, and bind them to it
+    void PlanStaticMemory(size_t maxColumns)
+    {
+        if (!m_staticPlan || !m_arenas.empty())
+            LogicError("MatrixPool::PlanStaticMemory: The static plan is not enabled or already made.");
+        const size_t alignment = 256; // (as cudaMalloc())
+
+        map<DEVICEID_TYPE, vector<size_t>> lifetimesOf; // [deviceId] indices into m_lifetimes, by decreasing size
+        for (size_t i = 0; i < m_lifetimes.size(); i++)
+        {
+            auto& lifetime = m_lifetimes[i];
+            size_t numElements = lifetime.info.numElements * (lifetime.info.mbScaled ? maxColumns : 1);
+            lifetime.numBytes = (numElements * lifetime.elementSize + alignment - 1) / alignment * alignment;
+            lifetimesOf[lifetime.info.deviceId].push_back(i);
+        }
+
+        m_plannedMaxColumns = maxColumns;
+        m_plannedPeakBytes = 0;
+        m_arenaBytes = 0;
+        for (auto& device : lifetimesOf)
+        {
+            auto& indices = device.second;
+            stable_sort(indices.begin(), indices.end(), [this](size_t a, size_t b) { return m_lifetimes[a].numBytes > m_lifetimes[b].numBytes; });
+            vector<size_t> placed; // by increasing offset
+            size_t arenaBytes = 0;
+            for (size_t i : indices)
+            {
+                auto& lifetime = m_lifetimes[i];
+                size_t offset = 0;
+                for (size_t j : placed) // lowest gap between the placed matrices that live at the same time
+                {
+                    const auto& other = m_lifetimes[j];
+                    if (other.begin >= lifetime.end || lifetime.begin >= other.end)
+                        continue;
+                    if (offset + lifetime.numBytes <= other.offset)
+                        break;
+                    offset = max(offset, other.offset + other.numBytes);
+                }
+                lifetime.offset = offset;
+                placed.insert(upper_bound(placed.begin(), placed.end(), i, [this](size_t a, size_t b) { return m_lifetimes[a].offset < m_lifetimes[b].offset; }), i);
+                arenaBytes = max(arenaBytes, offset + lifetime.numBytes);
+            }
+            m_plannedPeakBytes += GetPeakBytes(indices);
+            m_arenaBytes += arenaBytes;
+            m_arenas.push_back(make_shared<Matrix<char>>(1, arenaBytes, device.first));
+        }
+
+        BindToArenas<float>(lifetimesOf);
+        BindToArenas<double>(lifetimesOf);
+    }
+
+    // static plan: the minibatch size it was made for, the largest total size of the matrices that live at the same time,
+    // which bounds the size of any plan from below, and the size of the arenas of this plan
+    size_t GetPlannedMaxColumns() const { return m_plannedMaxColumns; }
+    size_t GetPlannedPeakBytes() const { return m_plannedPeakBytes; }
+    size_t GetArenaBytes() const { return m_arenaBytes; }
+
+    // number of distinct buffers that the pool has handed out so far
+    template <class ElemType>
+    size_t GetNumBuffers() const
+    {
+        size_t numBuffers = 0;
+        for (const auto& weakMatrix : GetState<ElemType>().m_allMatrices)
+        {
+            if (!weakMatrix.expired())
+                numBuffers++;
+        }
+        return numBuffers;
+    }
+
+    // planned number of elements of all distinct buffers, split into the minibatch-scaled
+    // part (elements per column) and the fixed part (total elements)
+    template <class ElemType>
+    void GetPlannedNumElements(size_t& numElementsPerColumn, size_t& numFixedElements) const
+    {
+        numElementsPerColumn = 0;
+        numFixedElements = 0;
+        const PoolState<ElemType>& state = GetState<ElemType>();
+        for (const auto& weakMatrix : state.m_allMatrices)
+        {
+            auto matrix = weakMatrix.lock();
+            if (!matrix)
+                continue;
+            auto iter = state.m_requestInfo.find(matrix.get());
+            if (iter == state.m_requestInfo.end())
+                continue;
+            (iter->second.mbScaled ? numElementsPerColumn : numFixedElements) += iter->second.numElements;
+        }
+    }
+
+    // bytes currently held by all distinct buffers handed out by the pool
+    // Since pool buffers are sized on first use and only grow, this is the peak footprint over all minibatches seen so far.
+    size_t GetAllocatedBytes() const
+    {
+        return GetAllocatedBytes<float>() + GetAllocatedBytes<double>() + m_arenaBytes;
+    }
+
+private:
+    // largest total size of the given lifetimes at any time
+    size_t GetPeakBytes(const vector<size_t>& indices) const
+    {
+        map<size_t, ptrdiff_t> changes; // [time] change of the total size
+        for (size_t i : indices)
+        {
+            changes[m_lifetimes[i].begin] += m_lifetimes[i].numBytes;
+            changes[m_lifetimes[i].end] -= m_lifetimes[i].numBytes; // (at SIZE_MAX, after everything)
+        }
+        size_t peakBytes = 0;
+        ptrdiff_t numBytes = 0;
+        for (const auto& change : changes)
+        {
+            numBytes += change.second;
+            peakBytes = max(peakBytes, (size_t) numBytes);
+        }
+        return peakBytes;
+    }
+
+    template <class ElemType>
+    void BindToArenas(const map<DEVICEID_TYPE, vector<size_t>>& lifetimesOf)
+    {
+        for (const auto& planned : GetState<ElemType>().m_plannedMatrices)
+        {
+            const auto& lifetime = m_lifetimes[planned.second];
+            const auto& arena = m_arenas[distance(lifetimesOf.begin(), lifetimesOf.find(lifetime.info.deviceId))];
+            const size_t numElements = lifetime.numBytes / sizeof(ElemType);
+            auto& matrix = *planned.first;
+            matrix.SetValue(numElements, 1, lifetime.info.deviceId, reinterpret_cast<ElemType*>(arena->Data() + lifetime.offset), matrixFlagDontOwnBuffer);
+            matrix.Resize(0, 0); // (keeps the view)
+        }
+    }
+
+    template <class ElemType>
+    size_t GetAllocatedBytes() const
+    {
+        size_t numBytes = 0;
+        for (const auto& weakMatrix : GetState<ElemType>().m_allMatrices)
+        {
+            auto matrix = weakMatrix.lock();
+            if (matrix)
+                numBytes += matrix->BufferSize();
+        }
+        return numBytes;
+    }
 };
 
 }}}
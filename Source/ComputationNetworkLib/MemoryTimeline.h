@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "ComputationNode.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// MemoryTimeline -- bytes held per node over the execution order of one minibatch
+//
+// While recording (ComputationNetwork::BeginMemoryTimeline()), forward and backward prop call Record() after each node.
+// It then takes stock of all matrices of the network, i.e. the values, gradients and workspaces
+// (ComputationNodeBase::GetWorkspaceMatrices(), e.g. the convolution and cuDNN workspace), counting matrices that
+// are shared through the MatrixPool once:
+//  - the allocated bytes of all of them, which is the memory of the network at that point of the minibatch;
+//    since buffers grow on first use, recording the first minibatch shows when the peak is reached, and
+//  - the bytes held by each node: a shared buffer is attributed to the node whose value or gradient it currently
+//    holds, i.e. to the node that last wrote it (forward prop writes the value of the node, backprop the gradients
+//    of its inputs); workspaces to the node that last ran.
+// Unlike PrintMemorySharingStructure(), which shows which matrices may share memory, this shows where the bytes are
+// when the peak happens, i.e. where checkpointing, offloading or a different layout would pay off.
+class MemoryTimeline
+{
+public:
+    struct Event
+    {
+        size_t m_step; // position in the execution of the minibatch
+        bool m_isBackward;
+        std::wstring m_nodeName;
+        std::wstring m_operationName;
+        size_t m_valueBytes; // allocated bytes of the node's own matrices
+        size_t m_gradientBytes;
+        size_t m_workspaceBytes;
+        size_t m_heldBytes;      // bytes of the buffers the node holds after it ran
+        size_t m_allocatedBytes; // bytes of all buffers of the network after the node ran
+    };
+
+    // 'nodes' are all nodes of the network
+    explicit MemoryTimeline(const std::vector<ComputationNodeBasePtr>& nodes);
+
+    // Records the execution of a node (of all nodes nested in a recurrent loop, for its flow-control node).
+    void Record(const ComputationNodeBasePtr& node, bool isBackward);
+
+    const std::vector<Event>& GetEvents() const { return m_events; }
+
+    // The event with the most allocated bytes, and the nodes that hold the most bytes at that point, largest first.
+    size_t GetPeakAllocatedBytes() const { return m_peakAllocatedBytes; }
+    const std::vector<std::pair<std::wstring, size_t>>& GetPeakHolders() const { return m_peakHolders; }
+
+    // Writes the events as CSV:
+    //     step,phase,node,operation,valueBytes,gradientBytes,workspaceBytes,heldBytes,allocatedBytes
+    void Save(const std::wstring& path) const;
+
+    // Prints the peak and the 'topN' nodes that hold the most bytes at the peak, and that have the largest
+    // workspaces, to the log.
+    void PrintReport(size_t topN) const;
+
+private:
+    struct Buffer
+    {
+        const MatrixBase* m_matrix;
+        ComputationNodeBase* m_node; // of the value or gradient, or whose workspace it is
+        bool m_isWorkspace;
+    };
+
+    void RecordNode(const ComputationNodeBasePtr& node, bool isBackward);
+
+    // all distinct matrices of the network, in a stable order
+    std::vector<Buffer> CollectBuffers() const;
+
+    std::vector<ComputationNodeBasePtr> m_nodes;
+    std::unordered_map<const MatrixBase*, ComputationNodeBase*> m_holders; // [buffer] node that last wrote it
+    std::vector<Event> m_events;
+    size_t m_peakAllocatedBytes;
+    size_t m_peakStep;
+    std::vector<std::pair<std::wstring, size_t>> m_peakHolders;
+};
+
+}}}
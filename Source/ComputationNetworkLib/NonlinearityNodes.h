@@ -36,7 +36,7 @@ enum GradientOperationType
 };
 
 template <class ElemType, ElementWiseOperator opForward, ElementWiseOperator opBackward, GradientOperationType opType>
-class UnaryElementWiseWithOpCodeNodeBase : public ComputationNode<ElemType>, public NumInputs<1>, public IdentityTransformerNode
+class UnaryElementWiseWithOpCodeNodeBase : public ComputationNode<ElemType>, public NumInputs<1>, public IdentityTransformerNode, public ICostEstimable
 {
     typedef ComputationNode<ElemType> Base;
     UsingComputationNodeMembers;
@@ -47,6 +47,9 @@ public:
     {
     }
 
+    virtual NodeCost GetForwardCost() const override { return Base::GetElementwiseForwardCost(); }
+    virtual NodeCost GetBackwardCost() const override { return Base::GetElementwiseBackwardCost(); }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         size_t rank = DetermineElementwiseTensorRank();
@@ -55,6 +58,9 @@ public:
         result.DoUnaryOpOf(0, input, 1, opForward, opSum);
     }
 
+    virtual bool /*ComputationNodeBase::*/ GetElementwiseForwardOp(ElementWiseOperator& op) const override { op = opForward; return true; }
+    virtual bool /*ComputationNodeBase::*/ CanComputeInPlace() const override { return true; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         assert(inputIndex == 0), inputIndex;
@@ -190,7 +190,84 @@ public:
         }
     }
 
+    // -----------------------------------------------------------------------
+    // merging the statistics of several workers
+    // Data-parallel workers each accumulate over their own share of the data. Before MarkComputed(true),
+    // their partial statistics get combined with the pairwise update of Chan et al., which is as accurate
+    // as a single pass no matter how the samples were split. See ComputationNetwork::AggregatePreComputedStatistics().
+    // -----------------------------------------------------------------------
+
+    size_t NumAccumulatedSamples() const { return IsAccumulating() ? m_numSamples : 0; }
+
+    // statistics accumulated so far, as [ #samples, mean[0..dim-1], variance[0..dim-1] (InvStdDev only) ]
+    std::vector<double> GetPartialStatistics() const
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: GetPartialStatistics() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+        std::vector<double> stats(1, (double) m_numSamples);
+        for (const auto& accumulator : Accumulators())
+        {
+            unique_ptr<ElemType[]> px(accumulator->CopyToArray());
+            stats.insert(stats.end(), px.get(), px.get() + accumulator->GetNumElements());
+        }
+        return stats;
+    }
+
+    // replace the statistics accumulated so far, e.g. by the merged ones of all workers
+    void SetPartialStatistics(const std::vector<double>& stats)
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: SetPartialStatistics() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+        auto accumulators = Accumulators();
+        size_t expectedSize = 1;
+        for (const auto& accumulator : accumulators)
+            expectedSize += accumulator->GetNumElements();
+        if (stats.size() != expectedSize)
+            LogicError("%ls %ls operation: SetPartialStatistics() expects %d values but got %d.", NodeName().c_str(), OperationName().c_str(), (int) expectedSize, (int) stats.size());
+
+        m_numSamples = (size_t) stats[0];
+        auto p = stats.begin() + 1;
+        for (const auto& accumulator : accumulators)
+        {
+            std::vector<ElemType> values(p, p + accumulator->GetNumElements());
+            accumulator->SetValue(accumulator->GetNumRows(), accumulator->GetNumCols(), accumulator->GetDeviceId(), values.data());
+            p += accumulator->GetNumElements();
+        }
+    }
+
+    // stats <- statistics of the union of the samples underlying 'stats' and 'other' (both in the format of GetPartialStatistics())
+    void MergePartialStatistics(std::vector<double>& stats, const std::vector<double>& other) const
+    {
+        if (stats.size() != other.size())
+            LogicError("%ls %ls operation: MergePartialStatistics() called with mismatching statistics.", NodeName().c_str(), OperationName().c_str());
+        double nA = stats[0];
+        double nB = other[0];
+        if (nB == 0)
+            return;
+        if (nA == 0)
+        {
+            stats = other;
+            return;
+        }
+        double n = nA + nB;
+        bool hasVariance = Accumulators().size() > 1;
+        size_t dim = (stats.size() - 1) / (hasVariance ? 2 : 1);
+        double* meanA = stats.data() + 1;
+        const double* meanB = other.data() + 1;
+        for (size_t i = 0; i < dim; i++)
+        {
+            double delta = meanB[i] - meanA[i];
+            if (hasVariance) // var = (nA varA + nB varB) / n + delta^2 nA nB / n^2
+                meanA[dim + i] = (nA * meanA[dim + i] + nB * meanB[dim + i]) / n + delta * delta * (nA / n) * (nB / n);
+            meanA[i] += delta * (nB / n);
+        }
+        stats[0] = n;
+    }
+
 protected:
+    // the device-side accumulators: the running mean, followed by the running variance for InvStdDev
+    virtual std::vector<shared_ptr<Matrix<ElemType>>> Accumulators() const = 0;
+
     size_t m_numSamples; // (SIZE_MAX while outside accumulation state)
     bool IsAccumulating() const { return m_numSamples != SIZE_MAX; }
 };
@@ -248,6 +325,9 @@ public:
 
         UpdateRunningAverage(InputRef(0), mean, m_numSamples);
     }
+
+protected:
+    virtual std::vector<shared_ptr<Matrix<ElemType>>> Accumulators() const override { return { m_value }; } // mean is formed directly in our m_value
 };
 
 template class MeanNode<float>;
@@ -354,6 +434,9 @@ public:
         }
     }
 
+protected:
+    virtual std::vector<shared_ptr<Matrix<ElemType>>> Accumulators() const override { return { m_mean, m_var }; }
+
 private:
     shared_ptr<Matrix<ElemType>> m_mean;
     shared_ptr<Matrix<ElemType>> m_var;
@@ -39,7 +39,8 @@ OptimizedRNNStackNode<ElemType>::OptimizedRNNStackNode(DEVICEID_TYPE deviceId, c
 template<class ElemType>
 OptimizedRNNStackNode<ElemType>::OptimizedRNNStackNode(const ScriptableObjects::IConfigRecordPtr configp)
     : Base(configp->Get(L"deviceId"), L"<placeholder>"), 
-    m_rnnAttributes(configp->Get(L"bidirectional"), configp->Get(L"numLayers"), configp->Get(L"hiddenDims"), configp->Get(L"recurrentOp"), configp->Get(L"axis")),
+    m_rnnAttributes(configp->Get(L"bidirectional"), configp->Get(L"numLayers"), configp->Get(L"hiddenDims"), configp->Get(L"recurrentOp"), configp->Get(L"axis"),
+                    configp->Exists(L"algorithm") ? (const wstring&) configp->Get(L"algorithm") : wstring(L"auto")),
     m_BackwardDataCalledYet(false)
 {
     AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
@@ -77,7 +78,7 @@ void OptimizedRNNStackNode<ElemType>::Load(File& fstream, size_t modelVersion)
     Base::Load(fstream, modelVersion);
     bool isLegacyVersion = modelVersion < CNTK_MODEL_VERSION_14; // (to support an internal legacy version)
     m_legacySwapInputsPending = isLegacyVersion;
-    m_rnnAttributes.Read(fstream, /*readAxis=*/ !isLegacyVersion);
+    m_rnnAttributes.Read(fstream, /*readAxis=*/ !isLegacyVersion); // (the algorithm stays 'auto', see RnnAttributes)
 }
 
 template<class ElemType>
@@ -103,6 +104,9 @@ void OptimizedRNNStackNode<ElemType>::ForwardProp(const FrameRange& fr)
     // The parameters are stored in a column matrix
     Matrix<ElemType>& paramW = InputRef(0).Value();
 
+    // without backprop, cuDNN needs no reserve, and the executor keeps the workspace across calls
+    bool inferenceOnly = !Environment().IsTraining();
+
     MBLayoutPtr mb = GetMBLayout();
     if (m_rnnAttributes.IsSpatialRecurrence())
     {
@@ -131,7 +135,7 @@ void OptimizedRNNStackNode<ElemType>::ForwardProp(const FrameRange& fr)
 
         // create a vector with the correct number of timesteps(shapeXT[2]) containing the sequence count (shapeXT[1])
         numSequencesForFrame = vector<size_t>(shapeXT[2], shapeXT[1]);
-        m_transposedOutput->RNNForward(*m_transposedInput, paramW, shapeXT[0], shapeYT[0], numSequencesForFrame, m_rnnAttributes, *m_reserve, *m_workspace);
+        m_transposedOutput->RNNForward(*m_transposedInput, paramW, shapeXT[0], shapeYT[0], numSequencesForFrame, m_rnnAttributes, inferenceOnly, *m_reserve, *m_workspace);
 
         // No one uses shapeY, but it is necessary
         TensorShape shapeY;
@@ -151,7 +155,7 @@ void OptimizedRNNStackNode<ElemType>::ForwardProp(const FrameRange& fr)
         // ensure enough storage
         m_transposedOutput->Resize(this->Value().GetNumRows(), m_transposedInput->GetNumCols());
 
-        m_transposedOutput->RNNForward(*m_transposedInput, paramW, shapeXT[0], shapeYT[0], numSequencesForFrame, m_rnnAttributes, *m_reserve, *m_workspace);
+        m_transposedOutput->RNNForward(*m_transposedInput, paramW, shapeXT[0], shapeYT[0], numSequencesForFrame, m_rnnAttributes, inferenceOnly, *m_reserve, *m_workspace);
         this->UnpackSequencesFromCuDNN(*m_transposedOutput, this->Value());
     }
     m_BackwardDataCalledYet = false;
@@ -28,7 +28,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <class ElemType>
-class OptimizedRNNStackNode : public ComputationNode<ElemType>, public NumInputs<2>
+class OptimizedRNNStackNode : public ComputationNode<ElemType>, public NumInputs<2>, public ICostEstimable
 {
     typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
     static const std::wstring TypeName() { return L"OptimizedRNNStack"; }
@@ -86,6 +86,35 @@ public:
     virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const { return 0 == childIndex; }
     RnnAttributes Attributes() const { return m_rnnAttributes; }
 
+    virtual std::vector<const MatrixBase*> GetWorkspaceMatrices() const override
+    {
+        std::vector<const MatrixBase*> matrices;
+        for (const auto& matrix : { m_transposedInput, m_transposedOutput, m_transposedDInput, m_transposedDOutput, m_workspace, m_reserve, m_packingIndex })
+        {
+            if (matrix)
+                matrices.push_back(matrix.get());
+        }
+        return matrices;
+    }
+
+    // ICostEstimable: each frame multiplies with all weights (the gate nonlinearities are not counted); backprop does
+    // that for the gradient of the data and, over the whole sequence, for the gradient of the weights
+    virtual NodeCost GetForwardCost() const override
+    {
+        double numFrames = GetNumFrames();
+        double numBytes = Base::GetNumElementsInMinibatch(0) + Base::GetNumElementsInMinibatch(1) + Base::GetNumElementsInMinibatch();
+        return NodeCost{2 * Input(0)->GetSampleMatrixNumRows() * numFrames, numBytes * sizeof(ElemType)};
+    }
+
+    virtual NodeCost GetBackwardCost() const override
+    {
+        NodeCost cost = GetForwardCost();
+        double numBytes = Base::GetNumElementsInMinibatch(0) + Base::GetNumElementsInMinibatch(1) + Base::GetNumElementsInMinibatch();
+        cost.m_flops *= (Input(0)->NeedsGradient() ? 1 : 0) + 1; // the data gradient is needed for the weight gradient as well
+        cost.m_bytes += numBytes * sizeof(ElemType); // the gradients of the output, the data and the weights
+        return cost;
+    }
+
 protected:
     bool m_BackwardDataCalledYet;
     TensorShape shapeXT;
@@ -99,6 +128,13 @@ protected:
     shared_ptr<Matrix<ElemType>> m_packingIndex;
 
 private:
+    double GetNumFrames() const
+    {
+        const auto& shape = Input(1)->GetSampleLayout();
+        double numFramesPerSample = shape.GetRank() > 0 && shape[0] > 0 ? (double) shape.GetNumElements() / shape[0] : 1; // axis 2: frames in the sample
+        return numFramesPerSample * Input(1)->GetSampleMatrixNumCols();
+    }
+
     void TransposeHelper(const MatrixBasePtr matX, const TensorShape &shapeX, MatrixBasePtr matY, TensorShape &shapeY);
 
     void PackSequencesForCuDNN(const Matrix<ElemType>& src, Matrix<ElemType>& dst, vector<size_t>& numSequencesForFrame);
@@ -76,6 +76,46 @@ public:
     int TimeStep() const { return m_timeStep; }
     ElemType InitialActivationValue() const { return m_initialStateValue; }
 
+    // Streaming evaluation (CNTKEvalStreaming) carries over one frame per parallel sequence, [dim x S]: the sequences
+    // that continue in the next minibatch (tBegin = -1) start from it. Like ExportState(), only for timeStep=1.
+    void SetCarriedOverFrames(const Matrix<ElemType>& frames)
+    {
+        if (m_timeStep != 1)
+            RuntimeError("%ls %ls operation: Carrying over state is only supported for timeStep=1.", NodeName().c_str(), OperationName().c_str());
+        m_delayedValue->SetValue(frames);
+        if (!m_delayedActivationMBLayout)
+            m_delayedActivationMBLayout = make_shared<MBLayout>();
+        m_delayedActivationMBLayout->Init(frames.GetNumCols(), 1);
+        for (size_t s = 0; s < frames.GetNumCols(); s++)
+            m_delayedActivationMBLayout->AddSequence(s, s, 0, 2); // (continues beyond the end)
+    }
+
+    // frame t of parallel sequence s of the input of the most recent minibatch, which is kept for carrying over
+    Matrix<ElemType> CarriedOverFrame(size_t t, size_t s) const
+    {
+        return m_delayedValue->ColumnSlice(t * m_delayedActivationMBLayout->GetNumParallelSequences() + s, 1);
+    }
+
+    // Beam search (CNTKEvalBeamSearch) reorders the beams, each a parallel sequence, between its steps: parallel sequence s
+    // continues from the last frame of parallel sequence backpointers[s] of the most recent minibatch. 'backpointers' is
+    // [1 x S] on the device of the node, and the frames are gathered there.
+    void ReorderCarriedOverFrames(const Matrix<ElemType>& backpointers)
+    {
+        if (m_timeStep != 1)
+            RuntimeError("%ls %ls operation: Carrying over state is only supported for timeStep=1.", NodeName().c_str(), OperationName().c_str());
+        if (!m_delayedActivationMBLayout)
+            LogicError("%ls %ls operation: There is no minibatch to carry over state from.", NodeName().c_str(), OperationName().c_str());
+        size_t numSequences = m_delayedActivationMBLayout->GetNumParallelSequences();
+        size_t numTimeSteps = m_delayedActivationMBLayout->GetNumTimeSteps();
+        if (!m_reorderedValue)
+            m_reorderedValue = make_shared<Matrix<ElemType>>(m_delayedValue->GetDeviceId());
+        m_reorderedValue->DoGatherColumnsOf(0, backpointers, m_delayedValue->ColumnSlice((numTimeSteps - 1) * numSequences, numSequences), 1);
+        std::swap(m_delayedValue, m_reorderedValue);
+        m_delayedActivationMBLayout->Init(backpointers.GetNumCols(), 1);
+        for (size_t s = 0; s < backpointers.GetNumCols(); s++)
+            m_delayedActivationMBLayout->AddSequence(s, s, 0, 2); // (continues beyond the end)
+    }
+
 protected:
     ElemType m_initialStateValue;                           // starting value for hidden activation vector at boundary
     int m_timeStep;                                         // delay in frames (typ. 1)
@@ -91,6 +131,7 @@ protected:
 
     shared_ptr<Matrix<ElemType>> m_delayedValue;            // saves the activation of the previous step that this node points to
     MBLayoutPtr m_delayedActivationMBLayout;                // layout for m_delayedValue
+    shared_ptr<Matrix<ElemType>> m_reorderedValue;          // the other buffer of ReorderCarriedOverFrames()
 };
 
 #define UsingDelayedValueNodeMembers        \
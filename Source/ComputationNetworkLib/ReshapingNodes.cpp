@@ -212,77 +212,56 @@ template class ReduceElementsNode<double>;
 // Where(bitVector) -- extract indices of non-0 values in a sequence
 // -----------------------------------------------------------------------
 
-// wrapper class to pass MBLayout sequence vector to PackSequences()
-struct SequenceLengthVector
-{
-    typedef vector<vector<size_t>> SequenceVector;
-    typedef MBLayout::SequenceInfo SequenceInfo;
-    const SequenceVector& m_sequenceVector;        // vector of sequences (to get sequence length)
-    const vector<SequenceInfo>& m_sequenceInfo;    // original sequence info (for seqId)
-    SequenceLengthVector(const vector<SequenceInfo>& sequenceInfo, const SequenceVector& sequenceVector) : m_sequenceInfo(sequenceInfo), m_sequenceVector(sequenceVector) { }
-    size_t size() const { return m_sequenceInfo.size(); }
-    MBLayout::SequenceInfo operator[](size_t i) const // return a descriptor of the new sequence
-    {
-        SequenceInfo seq;
-        seq.seqId = m_sequenceInfo[i].seqId;
-        seq.s = i;
-        seq.tBegin = 0;
-        seq.tEnd = m_sequenceVector[i].size();
-        return seq;
-    }
-    void operator=(const SequenceLengthVector&) = delete;
-};
+// (first column, number of frames) of a sequence, as Matrix::AssignNonZeroCountsOfSequences() and the CRF operations take them
+template <class ElemType>
+static void AppendSequenceRange(std::vector<ElemType>& ranges, const MBLayoutPtr& pMBLayout, const MBLayout::SequenceInfo& seq, const ComputationNodeBase& node)
+{
+    if (seq.tBegin < 0 || seq.tEnd > pMBLayout->GetNumTimeSteps())
+        InvalidArgument("%ls operation needs whole sequences, but a sequence extends beyond the minibatch (truncated BPTT is not supported).", node.NodeDescription().c_str());
+    ranges.push_back((ElemType)(seq.tBegin * pMBLayout->GetNumParallelSequences() + seq.s));
+    ranges.push_back((ElemType)seq.GetNumTimeSteps());
+}
 
 // TODO: Where should the MBLayout be created--in BeginForwardProp() or ForwardProp()?
 //       BeginForwardProp() should generally have no access to the actual values,
 //       while ForwardProp() might be too late. We may have to define the semantics here.
 // BUGBUG: This is the first node with value-dependent MBLayout. It resizes Value(), which we otherwise always do before.
+// The indices are found by stream compaction on the device of the input; only the number of indices of each sequence
+// is copied to the CPU, which is what the new MBLayout needs.
 template <class ElemType>
 /*virtual*/ void WhereNode<ElemType>::ForwardPropNonLooping() /*override*/
 {
-    // gather all sequences
+    // count the non-0 values of each sequence
     let& inMBLayout = InputRef(0).GetMBLayout();
     let& input = InputRef(0).Value();
-    let& sequences = inMBLayout->GetAllSequences();
-    auto& indexSequences = m_indexSequenceBuffer;
-    if (indexSequences.size() < sequences.size())
-        indexSequences.resize(sequences.size());
-    for (size_t i = 0; i < sequences.size(); i++)
+    AssignSequenceRanges(*m_inputSequences, inMBLayout);
+    m_counts->AssignNonZeroCountsOfSequences(input, *m_inputSequences, inMBLayout->GetNumParallelSequences());
+    m_countBuffer.resize(m_counts->GetNumElements());
+    if (!m_countBuffer.empty())
+        m_counts->CopySection(1, m_countBuffer.size(), m_countBuffer.data(), 1);
+
+    // create a new MBLayout, with a sequence of that length for each input sequence (the gaps are skipped in both)
+    m_outputSequenceBuffer.clear();
+    for (let& seq : inMBLayout->GetAllSequences())
     {
-        let& seq = sequences[i];
         if (seq.seqId == GAP_SEQUENCE_ID)
             continue;
-        auto& indexSequence = indexSequences[i];
-        indexSequence.clear();
-        for (size_t t = 0; t < seq.GetNumTimeSteps(); t++)
-            if (input(0, inMBLayout->GetColumnIndex(seq, t))) // this is the condition check that this node performs; the meat
-                indexSequence.push_back(t);
-        // Note: The above accesses m_value directly on the CPU, putting it into BOTH state, possibly for other consumers as well.
+        MBLayout::SequenceInfo outSeq;
+        outSeq.seqId = seq.seqId;
+        outSeq.s = m_outputSequenceBuffer.size();
+        outSeq.tBegin = 0;
+        outSeq.tEnd = (size_t)m_countBuffer[m_outputSequenceBuffer.size()];
+        m_outputSequenceBuffer.push_back(outSeq);
     }
-    input.CollapseDataLocation(); // BUGBUG: Move back, since BOTH state is broken at present.
-    // create a new MBLayout
     let& outMBLayout = GetMBLayout();
-    outMBLayout->InitAsPackedSequences(SequenceLengthVector(sequences, indexSequences), /*temp*/m_placementBuffer, /*temp*/m_rowAllocationsBuffer);
-    // copy to output
-    vector<ElemType> buf(outMBLayout->GetNumCols(), numeric_limits<ElemType>::quiet_NaN()); // STL cannot easily avoid initializing, so we might as well init with NaN for gaps
-    let size = min(sequences.size(), outMBLayout->GetAllSequences().size()); // no non-gap sequence has an index beyond this
-    for (size_t i = 0; i < size; i++)
-    {
-        let& seq = outMBLayout->GetAllSequences()[i];
-        if (seq.seqId == GAP_SEQUENCE_ID) // gaps will keep the NaN
-            continue;
-        let& indexSequence = indexSequences[i];
-        for (size_t t = 0; t < seq.GetNumTimeSteps(); t++)
-            buf[outMBLayout->GetColumnIndex(seq, t)] = (ElemType)indexSequence[t];
-    }
-    // there may be dangling gaps at the end. Take the opportunity to verify this.
-    for (size_t i = size; i < sequences.size(); i++)
-        assert(sequences[i].seqId == GAP_SEQUENCE_ID);
-    for (size_t i = size; i < outMBLayout->GetAllSequences().size(); i++)
-        assert(outMBLayout->GetAllSequences()[i].seqId == GAP_SEQUENCE_ID);
-    // the result will be kept in CPUDEVICE, since most likely we will access it again in PackedIndexNode
-    Value().TransferToDeviceIfNotThere(CPUDEVICE, /*isBeingMoved=*/ true, /*emptyTransfer=*/ true, /*updatePreferredDevice=*/ true);
-    Value().SetValue(1, outMBLayout->GetNumCols(), CPUDEVICE, buf.data(), MatrixFormat::matrixFormatColMajor);
+    outMBLayout->InitAsPackedSequences(m_outputSequenceBuffer, /*temp*/m_placementBuffer, /*temp*/m_rowAllocationsBuffer);
+    AssignSequenceRanges(*m_outputSequences, outMBLayout); // (the sequences are in the same order)
+
+    // write the indices into the sequences of the new layout; gaps are NaN
+    auto& result = Value();
+    result.Resize(1, outMBLayout->GetNumCols());
+    result.SetValue(numeric_limits<ElemType>::quiet_NaN());
+    result.AssignNonZeroPositionsOfSequences(input, *m_inputSequences, inMBLayout->GetNumParallelSequences(), *m_outputSequences, outMBLayout->GetNumParallelSequences());
 }
 
 template <class ElemType>
@@ -317,6 +296,10 @@ template class WhereNode<double>;
 // PackedIndexNode(targetObject, indexSequence) -- map sequence
 // -----------------------------------------------------------------------
 
+// Input matrix contains time indices for each sequence that refer to frames inside that sequence.
+// We replace every per-sequence index by the resolved column index w.r.t. the MBLayout of the source data.
+// The sequences are paired up on the CPU, from the layouts alone; the index values are mapped on the device.
+// An index beyond its source sequence is mapped to -1, which GatherPacked and ScatterPacked treat as a missing column.
 template <class ElemType>
 /*virtual*/ void PackedIndexNode<ElemType>::ForwardPropNonLooping() /*override*/
 {
@@ -324,26 +307,19 @@ template <class ElemType>
     let& indexMBLayout  = InputRef(INDEXDATA).GetMBLayout();
     let&  index  = InputRef(INDEXDATA).Value(); // per-seq index values that are to be mapped
     auto& result =                   Value(); // packed index values as mapped to sourceData's layout
-    // loop over sourceSequences
-    // Input matrix contains time indices for each sequence that refer to frames inside that sequence.
-    // We replace every per-sequence index by the resolved column index w.r.t. the same MBLayout.
-    let& sourceSequences = sourceMBLayout->GetAllSequences();
-    for (size_t i = 0; i < sourceSequences.size(); i++)
+    m_indexRangeBuffer.clear();
+    m_sourceRangeBuffer.clear();
+    for (let& sourceSeq : sourceMBLayout->GetAllSequences())
     {
-        let& sourceSeq = sourceSequences[i];
         if (sourceSeq.seqId == GAP_SEQUENCE_ID)
             continue;
-        let& indexSeq = indexMBLayout->FindSequence(sourceSeq.seqId);          // find corresponding entry in indexMBLayout
-        for (size_t tIndex = 0; tIndex < indexSeq.GetNumTimeSteps(); tIndex++) // map all index values in index sequence
-        {
-            let jIndex  = indexMBLayout->GetColumnIndex(indexSeq, tIndex);    // map time index to actual location in the matrix storage object
-            let tSource = (size_t)index(0, jIndex);                           // the new time location (relative to source sequence)
-            let jSource = sourceMBLayout->GetColumnIndex(sourceSeq, tSource); // map new time index as well. This performs a range check.
-            result(0, jIndex) = (ElemType)jSource;
-        }
+        let& indexSeq = indexMBLayout->FindSequence(sourceSeq.seqId); // find corresponding entry in indexMBLayout
+        AppendSequenceRange(m_indexRangeBuffer, indexMBLayout, indexSeq, *this);
+        AppendSequenceRange(m_sourceRangeBuffer, sourceMBLayout, sourceSeq, *this);
     }
-    // Note: maybe this is no longer needed, now that we do the same inside UpdateFunctionValueSize() for all nodes.
-    result.CollapseDataLocation(); // BUGBUG: Move back, since BOTH state is broken at present.
+    m_indexSequences->SetValue(2, m_indexRangeBuffer.size() / 2, m_indexSequences->GetDeviceId(), m_indexRangeBuffer.data());
+    m_sourceSequences->SetValue(2, m_sourceRangeBuffer.size() / 2, m_sourceSequences->GetDeviceId(), m_sourceRangeBuffer.data());
+    result.AssignColumnsOfSequencePositions(index, *m_indexSequences, indexMBLayout->GetNumParallelSequences(), *m_sourceSequences, sourceMBLayout->GetNumParallelSequences());
 }
 
 template <class ElemType>
@@ -150,7 +150,8 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        ValueFor(fr).AssignValuesOf(InputRef(0).ValueFor(fr));
+        if (ValuePtr() != InputRef(0).ValuePtr()) // (copy-to-self check: the value may alias the input's)
+            ValueFor(fr).AssignValuesOf(InputRef(0).ValueFor(fr));
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
@@ -161,6 +162,9 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
+    // the value matrix has the same elements as the input's, only the sample is interpreted differently
+    virtual bool /*ComputationNodeBase::*/ CanAliasInputValue() const override { return true; }
+
 private:
     TensorShape m_replacementSampleLayout; // user-specified dimensions to replace dimensions [beginAxis, endAxis]
     int m_beginDimParameter;               // 1-based index range as specified
@@ -262,8 +266,8 @@ public:
                             InputRef(1).NodeName().c_str(), InputRef(1).OperationName().c_str());
 
         // copy the data from 'dataInput'
-        ValueFor(fr).AssignValuesOf(InputRef(0).ValueFor(fr.WithLayout(InputRef(0).GetMBLayout()))); // just propagate through
-        // TODO: Once we do in-place, the above must include a copy-to-self check (either here or inside the matrix lib).
+        if (ValuePtr() != InputRef(0).ValuePtr()) // (copy-to-self check: the value may alias the input's)
+            ValueFor(fr).AssignValuesOf(InputRef(0).ValueFor(fr.WithLayout(InputRef(0).GetMBLayout()))); // just propagate through
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
@@ -276,6 +280,9 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
+    // the layouts are identical (see ForwardProp()), and so are the value matrices
+    virtual bool /*ComputationNodeBase::*/ CanAliasInputValue() const override { return true; }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -291,6 +298,55 @@ public:
 template class ReconcileDynamicAxisNode<float>;
 template class ReconcileDynamicAxisNode<double>;
 
+// -----------------------------------------------------------------------
+// CrossDeviceCopyNode (input)
+// The value of the input, on the device of this node, which may differ from that of the input.
+// Inserted by ComputationNetwork::PlaceNodesOnDevices() wherever a node reads the value of a node placed on another device;
+// not meant to be used directly. The gradient is copied back to the device of the input and added there.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class CrossDeviceCopyNode : public ComputationNode<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"CrossDeviceCopy"; }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(CrossDeviceCopyNode);
+    CrossDeviceCopyNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        ValueFor(fr).AssignPeerCopyOf(InputRef(0).ValueFor(fr));
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        auto inputGradient = InputRef(0).GradientFor(fr);
+        if (!m_transferBuffer || m_transferBuffer->GetDeviceId() != inputGradient.GetDeviceId())
+            m_transferBuffer = make_shared<Matrix<ElemType>>(inputGradient.GetDeviceId());
+        m_transferBuffer->AssignPeerCopyOf(GradientFor(fr));
+        inputGradient += *m_transferBuffer;
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        ValidateUnaryMap(isFinalValidationPass);
+    }
+
+private:
+    shared_ptr<Matrix<ElemType>> m_transferBuffer; // the gradient, on the device of the input
+};
+
+template class CrossDeviceCopyNode<float>;
+template class CrossDeviceCopyNode<double>;
+
 // -----------------------------------------------------------------------
 // SliceNode (input)
 // This node extracts a slice of the first tensor dimension (row).
@@ -803,11 +859,33 @@ public:
 
     std::wstring DynamicAxisName() const { return m_dynamicAxisName; }
 
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_inputSequences, matrixPool);
+        RequestMatrixFromPool(m_outputSequences, matrixPool);
+        RequestMatrixFromPool(m_counts, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_inputSequences, matrixPool);
+        ReleaseMatrixToPool(m_outputSequences, matrixPool);
+        ReleaseMatrixToPool(m_counts, matrixPool);
+    }
+
 private:
+    // (first column, number of frames) of the input and the result sequences, and the number of non-0 values of each input sequence,
+    // on the device; only the counts are copied to the CPU, to create the new MBLayout
+    shared_ptr<Matrix<ElemType>> m_inputSequences;
+    shared_ptr<Matrix<ElemType>> m_outputSequences;
+    shared_ptr<Matrix<ElemType>> m_counts;
     // buffers for creating the result sequences (kept as object state to avoid memory allocations)
-    std::vector<std::vector<size_t>>   m_indexSequenceBuffer; // [sequenceIndex][t] for creating the result sequences
-    std::vector<size_t>               m_rowAllocationsBuffer; // [row] for determining new MBLayout packing
-    std::vector<std::pair<size_t, size_t>> m_placementBuffer; // [sequenceIndex] assigned location for a sequence
+    std::vector<ElemType>                           m_countBuffer; // [sequenceIndex] the counts, on the CPU
+    std::vector<MBLayout::SequenceInfo>    m_outputSequenceBuffer; // [sequenceIndex] the result sequences, for the new MBLayout
+    std::vector<size_t>                    m_rowAllocationsBuffer; // [row] for determining new MBLayout packing
+    std::vector<std::pair<size_t, size_t>>      m_placementBuffer; // [sequenceIndex] assigned location for a sequence
     std::wstring m_dynamicAxisName;
 };
 
@@ -844,6 +922,26 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
     virtual void Validate(bool isFinalValidationPass) override;
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_indexSequences, matrixPool);
+        RequestMatrixFromPool(m_sourceSequences, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_indexSequences, matrixPool);
+        ReleaseMatrixToPool(m_sourceSequences, matrixPool);
+    }
+
+private:
+    // (first column, number of frames) of each index sequence, and of the source sequence of the same id
+    shared_ptr<Matrix<ElemType>> m_indexSequences;
+    shared_ptr<Matrix<ElemType>> m_sourceSequences;
+    std::vector<ElemType> m_indexRangeBuffer, m_sourceRangeBuffer;
 };
 
 // -----------------------------------------------------------------------
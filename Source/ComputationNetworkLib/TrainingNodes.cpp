@@ -4,7 +4,7 @@
 //
 
 #include "TrainingNodes.h"
-#include <boost/random/uniform_real_distribution.hpp>
+#include "NcclComm.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -59,82 +59,42 @@ void RandomSampleNodeBase<ElemType>::Load(File& fstream, size_t modelVersion)
 }
 
 template<class ElemType>
-void RandomSampleNodeBase<ElemType>::UpdateWeightsPrefixSum()
+void RandomSampleNodeBase<ElemType>::VerifySamplingWeights()
 {
-    const Matrix<ElemType>& samplingWeights = Input(0)->ValueAsMatrix();
-    m_samplingWeightsPrefixSum.clear();
-    double runningWeightsSum = 0;
-    for (int iClass = 0; iClass < samplingWeights.GetNumRows(); iClass++)
-    {
-        ElemType currentWeight = samplingWeights.GetValue(iClass, 0);
-        if (currentWeight < 0)
-            InvalidArgument("Sampling weights contain negative number %f.", currentWeight);
+    if (Input(0)->GetEvalTimeStamp() == m_verifiedWeightsTimeStamp)
+        return;
 
-        runningWeightsSum += currentWeight;
-        m_samplingWeightsPrefixSum.push_back(runningWeightsSum);
-    }
+    const Matrix<ElemType>& samplingWeights = Input(0)->ValueAsMatrix();
+    Matrix<ElemType> minIndex(samplingWeights.GetDeviceId()), minWeight(samplingWeights.GetDeviceId());
+    samplingWeights.VectorMin(minIndex, minWeight, /*isColWise=*/true);
+    ElemType currentWeight = minWeight.Get00Element();
+    if (currentWeight < 0)
+        InvalidArgument("Sampling weights contain negative number %f.", currentWeight);
+    m_verifiedWeightsTimeStamp = Input(0)->GetEvalTimeStamp();
 }
 
-// Runs the sampling returning a vector with the id's of the samples. The parameter nTries is used to return the number of draws that was needed
-// to get the expected number of samples.
+// Runs the sampling on the device of the weights. With duplicates, each sample takes a draw; without, each class takes one,
+// and the sample is the classes with the largest random keys, which gives the distribution of the rejection sampling we did
+// before (draw with replacement, skip what was drawn already) without its unbounded number of draws.
 template<class ElemType>
-const std::vector<size_t> RandomSampleNodeBase<ElemType>::RunSampling(size_t& nTries)
+void RandomSampleNodeBase<ElemType>::RunSampling(Matrix<ElemType>& samples)
 {
-    boost::random::uniform_real_distribution<double> r(0, m_samplingWeightsPrefixSum.back());
-    std::unordered_set<int> alreadySampled;
-    std::vector<size_t> samples;
-    CPURNGHandle* cpuRNGHandle = dynamic_cast<CPURNGHandle*>(&GetRNGHandle(CPUDEVICE));
-
-    // find random samples using the specified weight
-    if (m_allowDuplicates)
-        nTries = m_sizeOfSampledSet;
-    else
-        nTries = 0; // just initialize and count how many tries we need.
-
+    VerifySamplingWeights();
+    const Matrix<ElemType>& samplingWeights = Input(0)->ValueAsMatrix();
     auto offset = GetRngOffset();
-    while (samples.size() < m_sizeOfSampledSet)
-    {
-        double randomValue = r(cpuRNGHandle->Generator());
-        offset++;
-        // Find the first index where value[idx] >= randomValue.
-        auto lower = std::lower_bound(m_samplingWeightsPrefixSum.begin(), m_samplingWeightsPrefixSum.end(), randomValue);
-        int idx = (int)(lower - m_samplingWeightsPrefixSum.begin());
-
-        if (m_allowDuplicates)
-            samples.push_back(idx);
-        else
-        {
-            // Sampling without replacement: each value can be sampled at most once. 
-            // The implementation below using rejection sampling is problematic.
-            // E.g if first class has probability p = 0.999 we typically will have to sample 1000 times or more to hit another class.
-            // BUGBUG Alternative implementions, e.g:
-            // * Weighted Random Sampling with Reservoir: http://utopia.duth.gr/~pefraimi/research/data/2007EncOfAlg.pdf
-            // * Binary tree with classes as leafes and branch probs on non-leafes.
-            // * As in numpy: https://github.com/numpy/numpy/blob/master/numpy/random/mtrand/mtrand.pyx#L1440
-            nTries++;
-            if (alreadySampled.find(idx) != alreadySampled.end()) continue;
-            else
-            {
-                samples.push_back(idx);
-                alreadySampled.insert(idx);
-            }
-        }
-    }
-    UpdateRngOffset(offset);
-    return samples;
+    samples.AssignWeightedRandomSamples(samplingWeights, m_sizeOfSampledSet, m_allowDuplicates, GetRngSeed(), offset, *m_samplingWorkspace);
+    UpdateRngOffset(offset + (m_allowDuplicates ? m_sizeOfSampledSet : samplingWeights.GetNumRows()));
 }
 
 template<class ElemType>
 void RandomSampleNode<ElemType>::ForwardPropNonLooping()
 {
-    Base::UpdateWeightsPrefixSum();
-
     if (ValueAsMatrix().GetMatrixType() != SPARSE)
     {
         // BUGBUG: matrix type should be configured during validation
         // Note: We allocate a new one instead of switching the type in place since switching in place may
         // affect other nodes who share this matrix due to memory sharing
-        auto newSparseValueMatrix = std::make_shared<Matrix<ElemType>>(ValueAsMatrix().GetNumRows(), ValueAsMatrix().GetNumCols(), CPUDEVICE, SPARSE, matrixFormatSparseCSC);
+        auto newSparseValueMatrix = std::make_shared<Matrix<ElemType>>(ValueAsMatrix().GetNumRows(), ValueAsMatrix().GetNumCols(), m_deviceId, SPARSE, matrixFormatSparseCSC);
 #ifdef _MSC_VER
         ValuePtrRef() = newSparseValueMatrix;
 #else
@@ -142,30 +102,9 @@ void RandomSampleNode<ElemType>::ForwardPropNonLooping()
 #endif
     }
 
-    Matrix<ElemType>& valueMatrix = ValueAsMatrix();
-
-    // TODO: Should we prepare the CSC data directly on the CPU and move it in one go?
-    // Currently the reader will place the data onto the GPU. It will then be pulled on-demand to the CPU once (and cached there).
-    valueMatrix.TransferToDeviceIfNotThere(CPUDEVICE, /*ismoved =*/ true/*means: BOTH state not ok */, /*emptyTransfer =*/ true, /*updatePreferredDevice =*/ true);
-    valueMatrix.Reset();
-
-    // Get vector with indices of randomly sampled classes
-    const std::vector<size_t> samples = GetWeightedSamples();
-
-    // Set columns of (sparse) result matrix as indicator vectors
-    for (size_t i = 0; i < Base::m_sizeOfSampledSet; i++)
-    {
-        int sample = samples[i];
-        valueMatrix.SetValue(sample, i, 1);
-    }
-}
-
-template<class ElemType>
-const std::vector<size_t> RandomSampleNode<ElemType>::GetWeightedSamples()
-{
-    size_t dummy;
-    // Here we are not interested in the number of sampling tries needed, which is returned in the parameter.
-    return Base::RunSampling(dummy);
+    // Set columns of (sparse) result matrix as indicator vectors of the randomly sampled classes
+    Base::RunSampling(*Base::m_samples);
+    ValueAsMatrix().AssignOneHotColumns(*Base::m_samples, Input(0)->GetSampleMatrixNumRows());
 }
 
 template<class ElemType>
@@ -192,59 +131,31 @@ bool RandomSampleNode<ElemType>::IsOutOfDateWrtInputs() const
 template class RandomSampleNode<float>;
 template class RandomSampleNode<double>;
 
-template<class ElemType>
-double RandomSampleInclusionFrequencyNode<ElemType>::EstimateNumberOfTries()
-{
-    // We estimate the average numver of tries by repeating a fixed number of experiments
-    const size_t numExperiments = 10; // We choose 10 without any deep justification.
-    long totalTries = 0;
-    for (int i = 0; i < numExperiments; i++)
-    {
-        size_t nTries;
-        Base::RunSampling(nTries);
-        totalTries += nTries;
-    }
-    return totalTries / (double)numExperiments;
-}
-
 // Estimates the expected number of occurences of each class in the sampled set.
 // For sampling without replacement we use estimate using average number of tries. (Inspired by TensorFlow)
+// The number of tries of a sampled set is the expected one given the order of its samples, rather than that of a run of
+// rejection sampling, which has a lower variance and takes no draws beyond the samples.
 // BUGBUG: Consider to reimplement using a less biased estimate as proposed by Nikos.
 template<class ElemType>
-double RandomSampleInclusionFrequencyNode<ElemType>::EstimateInSampleFrequency(double p, double estimatedNumTries) const
+void RandomSampleInclusionFrequencyNode<ElemType>::ForwardPropNonLooping()
 {
+    const Matrix<ElemType>& samplingWeights = Input(0)->ValueAsMatrix();
     if (Base::m_allowDuplicates)
+        Base::VerifySamplingWeights();
+    else
     {
-        return p * Base::m_sizeOfSampledSet;
-    }
-    else /* No duplicates allowed. Estimated count is same as probability of inclusion. */
-    {
-        return -expm1(estimatedNumTries * log1p(-p));
+        Base::m_samples->Resize(Base::m_sizeOfSampledSet, s_numExperiments);
+        for (size_t i = 0; i < s_numExperiments; i++)
+        {
+            Matrix<ElemType> samples = Base::m_samples->ColumnSlice(i, 1);
+            Base::RunSampling(samples);
+        }
     }
-}
-
-template<class ElemType>
-void RandomSampleInclusionFrequencyNode<ElemType>::ForwardPropNonLooping()
-{
-    Base::UpdateWeightsPrefixSum();
-    Matrix<ElemType>& valueMatrix = ValueAsMatrix();
-    valueMatrix.TransferToDeviceIfNotThere(CPUDEVICE, /*ismoved =*/ true/*means: BOTH state not ok */, /*emptyTransfer =*/ true, /*updatePreferredDevice =*/ false);
-    valueMatrix.SetDevice(CPUDEVICE);
 
     // BUGBUG: matrix type should be configured during validation
+    Matrix<ElemType>& valueMatrix = ValueAsMatrix();
     valueMatrix.SwitchToMatrixType(DENSE, matrixFormatDense, false);
-    double sumOfWeights = Base::m_samplingWeightsPrefixSum.back();
-    const Matrix<ElemType>& samplingWeights = Input(0)->ValueAsMatrix();
-
-    double estimatedNumTries = EstimateNumberOfTries();
-
-    for (int i = 0; i < Base::m_samplingWeightsPrefixSum.size(); i++)
-    {
-        // Get the sampling probablility for from the weights for i-th class.
-        double samplingProb = samplingWeights.GetValue(i, 0) / sumOfWeights;
-        double estimatedCount = EstimateInSampleFrequency(samplingProb, estimatedNumTries);
-        valueMatrix.SetValue(i, 0, (ElemType)estimatedCount);
-    }
+    valueMatrix.AssignWeightedSampleInclusionFrequencies(samplingWeights, Base::m_sizeOfSampledSet, Base::m_allowDuplicates, *Base::m_samples);
 }
 
 template<class ElemType>
@@ -281,4 +192,124 @@ void DropoutNode<ElemType>::Load(File& fstream, size_t modelVersion)
 template class DropoutNode<float>;
 template class DropoutNode<double>;
 
+// -----------------------------------------------------------------------
+// VocabularyShard
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void VocabularyShard<ElemType>::GatherWeights(Matrix<ElemType>& weights) const
+{
+    size_t vocabSize = VocabSize();
+    Matrix<ElemType> all(weights.GetNumRows(), vocabSize, weights.GetDeviceId());
+    all.SetValue(0);
+    all.ColumnSlice(ShardBegin(vocabSize), ShardEnd(vocabSize) - ShardBegin(vocabSize)).AssignValuesOf(weights);
+    SumOverShards(all);
+    weights.AssignValuesOf(all);
+}
+
+template <class ElemType>
+void VocabularyShard<ElemType>::CutWeights(Matrix<ElemType>& weights) const
+{
+    size_t vocabSize = VocabSize();
+    Matrix<ElemType> shard = weights.ColumnSlice(ShardBegin(vocabSize), ShardEnd(vocabSize) - ShardBegin(vocabSize)).DeepClone();
+    weights.AssignValuesOf(shard);
+}
+
+template <class ElemType>
+void VocabularyShard<ElemType>::ExchangeNumColumns(size_t numColumns, DEVICEID_TYPE deviceId)
+{
+    m_numColumns = numColumns;
+    m_maxColumns = numColumns;
+    if (!IsSharded())
+        return;
+
+    // each rank fills in its own slot
+    m_hostBuffer.assign(m_numShards, 0);
+    m_hostBuffer[m_rank] = (ElemType) numColumns;
+    Matrix<ElemType> counts(1, m_numShards, m_hostBuffer.data(), deviceId);
+    SumOverShards(counts);
+    counts.CopySection(1, m_numShards, m_hostBuffer.data(), 1);
+    for (auto count : m_hostBuffer)
+        m_maxColumns = max(m_maxColumns, (size_t) count);
+}
+
+template <class ElemType>
+void VocabularyShard<ElemType>::GatherColumns(const Matrix<ElemType>& mine, Matrix<ElemType>& all) const
+{
+    if (!IsSharded())
+    {
+        all.AssignValuesOf(mine);
+        return;
+    }
+    all.Resize(mine.GetNumRows(), NumGatheredColumns());
+    all.SetValue(0);
+    if (m_numColumns > 0)
+        all.ColumnSlice(FirstOwnColumn(), m_numColumns).AssignValuesOf(mine);
+    SumOverShards(all);
+}
+
+template <class ElemType>
+void VocabularyShard<ElemType>::SumOverShards(Matrix<ElemType>& all) const
+{
+    if (!IsSharded() || all.GetNumElements() == 0)
+        return;
+    m_comm->WaitForComputeStream();
+    m_comm->AllReduce(all.Data(), all.GetNumElements());
+    m_comm->Sync();
+}
+
+template <class ElemType>
+const Matrix<ElemType>& VocabularyShard<ElemType>::WordIds(DEVICEID_TYPE deviceId)
+{
+    size_t vocabSize = VocabSize();
+    if (!m_wordIds || m_wordIds->GetNumCols() != vocabSize || m_wordIds->GetDeviceId() != deviceId)
+    {
+        std::vector<ElemType> ids(vocabSize);
+        for (size_t i = 0; i < vocabSize; i++)
+            ids[i] = (ElemType) (i + 1);
+        m_wordIds = std::make_shared<Matrix<ElemType>>(1, vocabSize, ids.data(), deviceId);
+    }
+    return *m_wordIds;
+}
+
+template <class ElemType>
+void VocabularyShard<ElemType>::AssignShardLabels(const Matrix<ElemType>& gatheredWordIds, Matrix<ElemType>* validColumns)
+{
+    size_t numCols = gatheredWordIds.GetNumCols();
+    size_t vocabSize = VocabSize();
+    size_t begin = ShardBegin(vocabSize);
+    size_t end = ShardEnd(vocabSize);
+    m_hostBuffer.resize(numCols);
+    if (numCols > 0)
+        gatheredWordIds.CopySection(1, numCols, m_hostBuffer.data(), 1);
+
+    // one-hot columns of the words in [begin, end), and empty columns for the other words, gaps and padding
+    std::vector<CPUSPARSE_INDEX_TYPE> colStarts(numCols + 1, 0);
+    std::vector<CPUSPARSE_INDEX_TYPE> rows;
+    std::vector<ElemType> valid(numCols, 0);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        size_t id = (size_t) (m_hostBuffer[j] + 0.5); // 1-based, 0 if none
+        if (id > 0)
+        {
+            valid[j] = 1;
+            if (id - 1 >= begin && id - 1 < end)
+                rows.push_back((CPUSPARSE_INDEX_TYPE) (id - 1 - begin));
+        }
+        colStarts[j + 1] = (CPUSPARSE_INDEX_TYPE) rows.size();
+    }
+    m_numShardLabels = rows.size();
+
+    DEVICEID_TYPE deviceId = gatheredWordIds.GetDeviceId();
+    if (!m_shardLabels || m_shardLabels->GetDeviceId() != deviceId)
+        m_shardLabels = std::make_shared<Matrix<ElemType>>(0, 0, deviceId, SPARSE, matrixFormatSparseCSC);
+    std::vector<ElemType> ones(rows.size(), 1);
+    m_shardLabels->SetMatrixFromCSCFormat(colStarts.data(), rows.data(), ones.data(), rows.size(), end - begin, numCols);
+    if (validColumns)
+        validColumns->SetValue(1, numCols, deviceId, valid.data());
+}
+
+template class VocabularyShard<float>;
+template class VocabularyShard<double>;
+
 }}}
\ No newline at end of file
@@ -108,6 +108,9 @@ template class SquareErrorNode<double>;
 // -----------------------------------------------------------------------
 // CrossEntropyWithSoftmaxNode (labels, prediction)
 // calculates: -sum(left_i * log(softmax_i(right)))
+// Unless the labels need a gradient, no softmax is kept between forward and backprop: ForwardProp only keeps the
+// column-wise log-sum-exp of the prediction, and BackpropTo recomputes the softmax from it while writing the gradient,
+// each in a single pass. For large vocabularies the softmax matrices would otherwise be the largest activations.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -119,7 +122,7 @@ class CrossEntropyWithSoftmaxNode : public ComputationNodeNonLooping /*Computati
 public:
     DeclareConstructorFromConfigWithNumInputs(CrossEntropyWithSoftmaxNode);
     CrossEntropyWithSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_recomputeSoftmax(false)
     {
     }
 
@@ -129,6 +132,8 @@ public:
         // left input is scalar
         if (inputIndex == 0) // left derivative
         {
+            if (m_recomputeSoftmax)
+                LogicError("%ls %ls operation: The softmax was not kept for the gradient of the labels.", NodeName().c_str(), OperationName().c_str());
 #if DUMPOUTPUT
             m_logSoftmaxOfRight->Print("CrossEntropyWithSoftmax Partial-logSoftmaxOfRight");
             Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
@@ -152,7 +157,14 @@ public:
 #endif
 
             auto gradient = InputRef(1).GradientFor(fr);
-            Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, InputRef(0).ValueFor(fr), gradient);
+            if (m_recomputeSoftmax)
+            {
+                Matrix<ElemType>::AddSoftmaxCrossEntropyGradient(Gradient(), InputRef(1).ValueFor(fr), *m_logSumExpOfRight, InputRef(0).ValueFor(fr), gradient);
+                // gaps hold the softmax of the zeroed logits, which must not be propagated
+                MaskMissingColumnsToZero(gradient, InputRef(1).GetMBLayout(), fr);
+            }
+            else
+                Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, InputRef(0).ValueFor(fr), gradient);
 #if DUMPOUTPUT
             InputRef(1).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right");
 #endif
@@ -169,6 +181,12 @@ public:
 
     virtual void UpdateFunctionMBSize() override
     {
+        if (m_recomputeSoftmax)
+        {
+            m_logSumExpOfRight->Resize(1, Input(1)->Value().GetNumCols());
+            m_crossEntropyOfColumns->Resize(*m_logSumExpOfRight);
+            return;
+        }
         m_logSoftmaxOfRight->Resize(Input(1)->Value());
         m_softmaxOfRight->Resize(*m_logSoftmaxOfRight);
     }
@@ -176,6 +194,16 @@ public:
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
     {
         FrameRange fr(InputRef(0).GetMBLayout());
+        if (m_recomputeSoftmax)
+        {
+            // gaps are flattened to zero in both inputs, where the labels then contribute zero to the sum
+            m_crossEntropyOfColumns->AssignSoftmaxCrossEntropyOf(InputRef(0).MaskedValueFor(fr), InputRef(1).MaskedValueFor(fr), *m_logSumExpOfRight);
+            Value().AssignSumOfElements(*m_crossEntropyOfColumns);
+#if NANCHECK
+            Value().HasNan("CrossEntropyWithSoftmax");
+#endif
+            return;
+        }
         // first compute the softmax (column-wise)
         // Note that we need both log and non-log for gradient computation.
         m_logSoftmaxOfRight->AssignLogSoftmaxOf(InputRef(1).ValueFor(fr), true);
@@ -206,8 +234,17 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
-            node->m_logSoftmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-            node->m_softmaxOfRight->SetValue(*m_softmaxOfRight);
+            node->m_recomputeSoftmax = m_recomputeSoftmax;
+            if (m_recomputeSoftmax)
+            {
+                node->m_logSumExpOfRight->SetValue(*m_logSumExpOfRight);
+                node->m_crossEntropyOfColumns->SetValue(*m_crossEntropyOfColumns);
+            }
+            else
+            {
+                node->m_logSoftmaxOfRight->SetValue(*m_logSoftmaxOfRight);
+                node->m_softmaxOfRight->SetValue(*m_softmaxOfRight);
+            }
         }
     }
 
@@ -215,13 +252,26 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
-        RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        // the fused kernels take dense labels; the gradient of the labels needs the log-softmax itself
+        m_recomputeSoftmax = !Input(0)->NeedsGradient() && InputRef(0).ValuePtr() && InputRef(0).Value().GetMatrixType() == MatrixType::DENSE;
+        if (m_recomputeSoftmax)
+        {
+            RequestMatrixFromPool(m_logSumExpOfRight, matrixPool);
+            RequestMatrixFromPool(m_crossEntropyOfColumns, matrixPool);
+        }
+        else
+        {
+            RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
+            RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        }
     }
 
 protected:
     shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;
     shared_ptr<Matrix<ElemType>> m_softmaxOfRight;
+    shared_ptr<Matrix<ElemType>> m_logSumExpOfRight;     // [1 x numCols], when m_recomputeSoftmax
+    shared_ptr<Matrix<ElemType>> m_crossEntropyOfColumns; // [1 x numCols], when m_recomputeSoftmax
+    bool m_recomputeSoftmax;
 };
 
 template class CrossEntropyWithSoftmaxNode<float>;
@@ -474,66 +524,11 @@ public:
     {
         FrameRange fr(Input(0)->GetMBLayout());
 
-        if (inputIndex == 1 &&  // right derivative
-            m_numberOfUrlPairs > 0)   // 
+        if (inputIndex == 1) // right derivative
         {
+            // The lambdas of all url pairs, computed on the device of the inputs (see LearningToRank.h).
             auto gradient = Input(1)->GradientFor(fr);
-
-            // sigma * (si - sj)
-            *m_pairwiseDifferences *= m_sigma;
-            // exp(sigma * (si - sj))
-            m_lambdas->AssignExpOf(*m_pairwiseDifferences);
-            // 1 + exp(sigma * (si - sj))
-            *m_lambdas += 1;
-            // 1 / (1 + exp(sigma * (si - sj)))
-            m_lambdas->AssignElementInverseOf(*m_lambdas);
-            // -sigma/(1+exp(sigma*(si - sj)))
-            m_lambdas->AssignProductOf(-m_sigma, *m_lambdas);
-
-            // Get the update of weight.
-            const Matrix<ElemType>& lambdas = *m_lambdas;
-            m_weightUpdate->SetValue(gradient);
-            size_t pairsCount = 0;
-            ElemType discountI, discountJ;
-            ElemType gainI;
-            ElemType lambdaIJ;
-            for (auto qu : m_queryUrls)
-            {
-                ElemType idealMetric = qu.m_idealMetric;
-                for (typename std::vector<Url>::iterator itUrlI = qu.m_urls.begin(); itUrlI != qu.m_urls.end(); itUrlI++)
-                {
-                    Url& UrlI = *itUrlI;
-                    size_t k = UrlI.m_K;
-                    discountI = m_logWeights[UrlI.m_rank];
-                    gainI = UrlI.m_gain;
-                    if (k == 0) continue;
-                    for (typename std::vector<Url>::iterator itUrlJ = itUrlI + 1; itUrlJ <= itUrlI + k; itUrlJ++)
-                    {
-                        Url& UrlJ = *itUrlJ;
-                        discountJ = m_logWeights[UrlJ.m_rank];
-                        if (abs(gainI - UrlJ.m_gain) < 0.0000001)
-                        {
-                            continue;
-                        }
-
-                        // delta DCG
-                        lambdaIJ = (gainI - UrlJ.m_gain) * (discountI - discountJ) / (discountI * discountJ);
-
-                        // |delta NDCG|
-                        lambdaIJ = (idealMetric == 0.0 ? (ElemType) 0.0 : abs(lambdaIJ / idealMetric));
-
-                        // Combine lambda
-                        lambdaIJ = lambdas(0, pairsCount++) * lambdaIJ;
-
-                        // Assign to gradient
-                        (*m_weightUpdate)(0, UrlI.m_id) += lambdaIJ;
-                        (*m_weightUpdate)(0, UrlJ.m_id) -= lambdaIJ;
-                        
-                    }
-                }
-            }
-
-            gradient.SetValue(*m_weightUpdate);
+            gradient.AddLambdaRankGradient(Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), *m_ranks, Input(2)->ValueFor(fr), m_sigma);
         }
     }
 
@@ -542,35 +537,6 @@ public:
         return false;
     }
 
-    virtual void UpdateFunctionMBSize() override
-    {
-        UpdateCounts();
-
-        // clean up first
-        if (!m_queryUrls.empty()) m_queryUrls.clear();
-        if (!m_urlSorter.empty()) m_urlSorter.clear();
-        if (!m_logWeights.empty()) m_logWeights.clear();
-
-        m_pairwiseDifferences->Resize(1, m_numberOfUrlPairs);
-        m_lambdas->Resize(1, m_numberOfUrlPairs);
-
-        m_urlGain0->Resize(1, m_numberOfQueryUrls);
-        m_urlGain1->Resize(1, m_numberOfQueryUrls);
-        m_urlDiscount0->Resize(1, m_numberOfQueryUrls);
-        m_urlDiscount1->Resize(1, m_numberOfQueryUrls);
-
-        // keep one additional space to avoid pointer moving out
-        m_urlSorter.resize(m_maxNumberOfUrlsPerQuery + 1);
-        
-        // prepared lookup table
-        m_logWeights.resize(m_maxNumberOfUrlsPerQuery);
-        size_t i = 0;
-        for (typename std::vector<ElemType>::iterator it = m_logWeights.begin(); it != m_logWeights.end(); it++, i++)
-        {
-            *it = (ElemType) log(2.0 + i);
-        }
-    }
-
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         // Inputs:
@@ -587,132 +553,26 @@ public:
         // 0,   0.3,    1
         FrameRange fr(Input(0)->GetMBLayout());
 
-        // Construct matrices for further computation.
         const Matrix<ElemType>& gains = Input(0)->ValueFor(fr);
         const Matrix<ElemType>& preds = Input(1)->ValueFor(fr);
         const Matrix<ElemType>& queryIds = Input(2)->ValueFor(fr);
 
-        // Iterate through all samples
         size_t numberOfSamples = gains.GetNumCols();
-        QueryUrls aqu;
-        int previousQueryId = -1;
-        int numberOfQueries = 0;
-
-        // Iterate all samples and populate m_queryUrls table. 
-        for (size_t i = 0; i < numberOfSamples; i++)
-        {
-            int queryId = (int)queryIds(0, i);
-            // Samples are grouped by queries. Find all the urls 
-            // belonging to each individual query.
-            if (queryId != previousQueryId)
-            {
-                m_queryUrls.push_back(aqu);
-                numberOfQueries++;
-                previousQueryId = queryId;
-            }
-
-            // Get the last QueryUrls and add the Url.
-            QueryUrls& qu = m_queryUrls.back();
-            Url u(i, qu.m_urls.size(), preds(0, i), gains(0, i));
-            qu.m_urls.push_back(u);
-        }
-
-        // Update K (number of url pairs that have smaller or equal gain), rk (rank of 
-        // score in descending order) and and m_pairwiseDifferences (save for gradient 
-        // computation).
-        size_t pairCount = 0;
-        for (auto &qu : m_queryUrls)
-        {
-            std::vector<Url>& urls = qu.m_urls;
-            size_t numberOfUrls = urls.size();
-            // Urls are pre-sorted in descending order of gains.
-            ElemType minGain = urls[numberOfUrls - 1].m_gain;
-            for (size_t j = 0; j < urls.size(); j++)
-            {
-                if (urls[j].m_gain > minGain)
-                {
-                    size_t numberOfPairs = numberOfUrls - j - 1;
-                    urls[j].m_K = numberOfPairs;
-                    if (numberOfPairs > 0)
-                    {
-                        for (size_t k = 0; k < numberOfPairs; k++)
-                        {
-                            (*m_pairwiseDifferences)(0, pairCount++) = urls[j].m_score - urls[j + 1 + k].m_score;
-                        }
-                    }
-                }
-                // Skip urls with gain equal to min (0).
-                else 
-                {
-                    urls[j].m_K = 0;
-                }
-            }
-
-            typename std::vector<Url>::iterator its = m_urlSorter.begin(), it = urls.begin();
-            typename std::vector<Url>::iterator its0 = its;
-            its = std::copy(it, urls.end(), its);
-            std::sort(its0, its);
-            // Set the sorted rk order to each url and 
-            // the urls are still in the original order
-            int rk = 0;
-            for (it = its0; it != its; it++)
-            {
-                urls[it->m_rank0].m_rank = rk++;
-            }
-        }
-
-        // Compute ir metric.
-        size_t sampleCount = 0;
-        for (const auto &qu: m_queryUrls)
-        {
-            for (const auto &url : qu.m_urls)
-            {
-                (*m_urlGain0)(0, sampleCount) = url.m_gain;
-                (*m_urlGain1)(0, sampleCount) = url.m_gain;
-                (*m_urlDiscount0)(0, sampleCount) = (ElemType)url.m_rank0;
-                (*m_urlDiscount1)(0, sampleCount) = (ElemType)url.m_rank;
-                sampleCount++;
-            }
-        }
-        
-        // log(2+rank)
-        *m_urlDiscount0 += 2.0;
-        m_urlDiscount0->InplaceLog();
-        *m_urlDiscount1 += 2.0;
-        m_urlDiscount1->InplaceLog();
-        // gain/log(2+rank)
-        m_urlGain0->AssignElementDivisionOf(*m_urlGain0, *m_urlDiscount0);
-        m_urlGain1->AssignElementDivisionOf(*m_urlGain1, *m_urlDiscount1);
-
-        // Aggregate at query level.
-        const Matrix<ElemType>& urlDiscountedGain0 = *m_urlGain0;
-        const Matrix<ElemType>& urlDiscountedGain1 = *m_urlGain1;
-        ElemType irMetricValue = 0.0;
-        for (auto &qu : m_queryUrls)
-        {
-            qu.m_idealMetric = 0.0;
-            qu.m_metric = 0.0;
-
-            for (const auto &url : qu.m_urls)
-            {
-                qu.m_idealMetric += urlDiscountedGain0(0, url.m_id);
-                qu.m_metric += urlDiscountedGain1(0, url.m_id);
-            }
-
-            if (qu.m_idealMetric != 0.0)
-            {
-                irMetricValue += (qu.m_metric / qu.m_idealMetric);
-            }
-        }
-
-        if (numberOfQueries == 0)
+        if (numberOfSamples == 0)
         {
             LogicError("In %ls %ls numberOfQueries==0, check your data.", NodeName().c_str(), OperationName().c_str());
         }
 
-        // to make up the reporting
-        irMetricValue = (1.0f - irMetricValue / numberOfQueries) * 100 * numberOfSamples;
-        Value().SetValue(irMetricValue);
+        // Rank of each url by score within its query (saved for gradient computation), and NDCG, all on the device.
+        m_ranks->AssignRanksWithinQueries(preds, gains, queryIds);
+        m_urlNDCG->AssignNDCGContributions(gains, *m_ranks, queryIds, /*atOne=*/false, *m_queryStarts);
+        m_sumOfNDCG->AssignSumOfElements(*m_urlNDCG);
+        m_numberOfQueries->AssignSumOfElements(*m_queryStarts);
+
+        // to make up the reporting: (1 - average NDCG) * 100 * numberOfSamples
+        Value().AssignElementDivisionOf(*m_sumOfNDCG, *m_numberOfQueries);
+        Value() *= -(ElemType)(100 * numberOfSamples);
+        Value() += (ElemType)(100 * numberOfSamples);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -735,17 +595,11 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<LambdaRankNode<ElemType>>(nodeP);
-            node->m_pairwiseDifferences->SetValue(*m_pairwiseDifferences);
-            node->m_lambdas->SetValue(*m_lambdas);
-            node->m_weightUpdate->SetValue(*m_weightUpdate);
-            node->m_urlGain0->SetValue(*m_urlGain0);
-            node->m_urlGain1->SetValue(*m_urlGain1);
-            node->m_urlDiscount0->SetValue(*m_urlDiscount0);
-            node->m_urlDiscount1->SetValue(*m_urlDiscount1);
-
-            node->m_queryUrls = m_queryUrls;
-            node->m_urlSorter = m_urlSorter;
-            node->m_logWeights = m_logWeights;
+            node->m_ranks->SetValue(*m_ranks);
+            node->m_urlNDCG->SetValue(*m_urlNDCG);
+            node->m_queryStarts->SetValue(*m_queryStarts);
+            node->m_sumOfNDCG->SetValue(*m_sumOfNDCG);
+            node->m_numberOfQueries->SetValue(*m_numberOfQueries);
         }
     }
 
@@ -753,154 +607,35 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_pairwiseDifferences, matrixPool);
-        RequestMatrixFromPool(m_lambdas, matrixPool);
-        RequestMatrixFromPool(m_weightUpdate, matrixPool);
-        RequestMatrixFromPool(m_urlGain0, matrixPool);
-        RequestMatrixFromPool(m_urlGain1, matrixPool);
-        RequestMatrixFromPool(m_urlDiscount0, matrixPool);
-        RequestMatrixFromPool(m_urlDiscount1, matrixPool);
+        RequestMatrixFromPool(m_ranks, matrixPool);
+        RequestMatrixFromPool(m_urlNDCG, matrixPool);
+        RequestMatrixFromPool(m_queryStarts, matrixPool);
+        RequestMatrixFromPool(m_sumOfNDCG, matrixPool);
+        RequestMatrixFromPool(m_numberOfQueries, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_pairwiseDifferences, matrixPool);
-        ReleaseMatrixToPool(m_lambdas, matrixPool);
-        ReleaseMatrixToPool(m_weightUpdate, matrixPool);
-        ReleaseMatrixToPool(m_urlGain0, matrixPool);
-        ReleaseMatrixToPool(m_urlGain1, matrixPool);
-        ReleaseMatrixToPool(m_urlDiscount0, matrixPool);
-        ReleaseMatrixToPool(m_urlDiscount1, matrixPool);
-        
-        // is this the right place?  it was not called after bp.
-        m_queryUrls.clear();
-        m_urlSorter.clear();
-        m_logWeights.clear();
+        ReleaseMatrixToPool(m_ranks, matrixPool);
+        ReleaseMatrixToPool(m_urlNDCG, matrixPool);
+        ReleaseMatrixToPool(m_queryStarts, matrixPool);
+        ReleaseMatrixToPool(m_sumOfNDCG, matrixPool);
+        ReleaseMatrixToPool(m_numberOfQueries, matrixPool);
     }
 
 protected:
-
-    void UpdateCounts()
-    {
-        FrameRange fr(Input(0)->GetMBLayout());
-        const Matrix<ElemType>& gains = Input(0)->ValueFor(fr);
-        const Matrix<ElemType>& queryIds = Input(2)->ValueFor(fr);
-        const size_t numberOfQueryUrls = gains.GetNumCols();
-        int previousQueryId = -1;
-
-        // Number of urls we have seen for the current query
-        size_t numberOfUrls = 0;
-
-        // Number of urls that have gains greater than 0 for the current query 
-        size_t numberOfUrlsWithNonZeroGain = 0;
-        size_t numberOfUrlPairs = 0;
-        size_t maxNumberOfUrlsPerQuery = 0;
-        for (size_t i = 0; i < numberOfQueryUrls; i++)
-        {
-            int queryId = (int)queryIds(0, i);
-            ElemType gain = gains(0, i);
-            if (queryId != previousQueryId)
-            {
-                // Ignore pairs between urls with zero gains.
-                numberOfUrlPairs += (2 * numberOfUrls - 1 - numberOfUrlsWithNonZeroGain) * numberOfUrlsWithNonZeroGain / 2;
-                if (numberOfUrls > maxNumberOfUrlsPerQuery)
-                {
-                    maxNumberOfUrlsPerQuery = numberOfUrls;
-                }
-
-                // New query
-                numberOfUrls = 0;
-                numberOfUrlsWithNonZeroGain = 0;
-                previousQueryId = queryId;
-            }
-            
-            numberOfUrls++;
-            if (gain > 0)
-            {
-                numberOfUrlsWithNonZeroGain++;
-            }
-        }
-
-        // Add last query.
-        {
-            numberOfUrlPairs += (2 * numberOfUrls - 1 - numberOfUrlsWithNonZeroGain) * numberOfUrlsWithNonZeroGain / 2;
-            if (numberOfUrls > maxNumberOfUrlsPerQuery)
-            {
-                maxNumberOfUrlsPerQuery = numberOfUrls;
-            }
-        }
-
-        m_numberOfQueryUrls = numberOfQueryUrls;
-        m_numberOfUrlPairs = numberOfUrlPairs;
-        m_maxNumberOfUrlsPerQuery = maxNumberOfUrlsPerQuery;
-    }
-
-    struct Url
-    {
-        Url()
-        {
-            m_id = 0;
-            m_rank0 = 0;
-            m_rank = 0;
-            m_score = (ElemType)0;
-            m_gain = (ElemType)0;
-            m_K = 0;
-        }
-
-        Url(int id, int rk0, ElemType sc, ElemType gn) : m_id(id), m_rank0(rk0), m_rank(0), m_score(sc), m_gain(gn), m_K(0) {}
-
-        int m_id;           // sample id
-        int m_rank0;        // original rank based on label
-        int m_rank;         // rank based on s in the associated query
-        ElemType m_score;   // score
-        ElemType m_gain;    // gain
-        int m_K;            // the pair index
-        bool operator < (const Url &url) const {
-            // tie breaking
-            if (m_score == url.m_score || std::isnan(m_score) || std::isnan(url.m_score))
-            {
-                return m_gain < url.m_gain;
-            }
-
-            return m_score > url.m_score;
-        }
-    };
-
-    struct QueryUrls
-    {
-        ElemType m_idealMetric;  // the ideal NDCG
-        ElemType m_metric;   // NDCG based on the current scores
-
-        std::vector<Url> m_urls;
-    };
-
-    // master data structure
-    std::list<QueryUrls> m_queryUrls;
-    // buffer for sorting
-    std::vector<Url> m_urlSorter;
-    // lookup table for position based weights
-    std::vector<ElemType> m_logWeights;
-
-    size_t m_numberOfQueryUrls;
-    size_t m_numberOfUrlPairs;
-    size_t m_maxNumberOfUrlsPerQuery;
-
     ElemType m_sigma;
-    // Score differences between url pairs
-    shared_ptr<Matrix<ElemType>> m_pairwiseDifferences;
-    // 1/(1+exp(sigma*(si - sj)))
-    shared_ptr<Matrix<ElemType>> m_lambdas;
-    
-    // update of weight matrix
-    shared_ptr<Matrix<ElemType>> m_weightUpdate;
-    
-    // store the gains and position discounts
-    shared_ptr<Matrix<ElemType>> m_urlGain0;
-    shared_ptr<Matrix<ElemType>> m_urlGain1;
-    shared_ptr<Matrix<ElemType>> m_urlDiscount0;
-    shared_ptr<Matrix<ElemType>> m_urlDiscount1;
+
+    // rank of each url by score within its query
+    shared_ptr<Matrix<ElemType>> m_ranks;
+    // part of the NDCG of its query each url contributes, and 1 for the first url of each query
+    shared_ptr<Matrix<ElemType>> m_urlNDCG;
+    shared_ptr<Matrix<ElemType>> m_queryStarts;
+    // sums of the above (1 x 1)
+    shared_ptr<Matrix<ElemType>> m_sumOfNDCG;
+    shared_ptr<Matrix<ElemType>> m_numberOfQueries;
 };
 
 template class LambdaRankNode<float>;
@@ -1227,7 +962,7 @@ protected:
 // ------------------------------------------------------------------------------------------------------------------------------------------------
 // RandomSampleNodeBase(samplingWeights, sizeOfSampledSet, allowDuplicates): 
 // Base class for RandomSampleNode and RandomSampleInclusionFrequencyNode.
-// Provides random sampling functionality.
+// Provides random sampling functionality, on the device of the node (see Matrix::AssignWeightedRandomSamples()).
 //
 // Parameters:
 // * Input(0) Sampling weight vector: Matrix of shape [numClasses x 1] providing sampling weights >= 0.
@@ -1259,13 +994,27 @@ public:
     virtual void Save(File& fstream) const override;
     virtual void Load(File& fstream, size_t modelVersion) override;
 
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_samples, matrixPool);
+        RequestMatrixFromPool(m_samplingWorkspace, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_samples, matrixPool);
+        ReleaseMatrixToPool(m_samplingWorkspace, matrixPool);
+    }
+
 protected:
 
-    void UpdateWeightsPrefixSum();
+    // Checks the weights for negative values. This reads them on the CPU, hence it is only done when they have changed.
+    void VerifySamplingWeights();
 
-    // Runs the sampling returning a vector with the id's of the samples. The parameter nTries is used to return the number of draws that was needed
-    // to get the expected number of samples.
-    const std::vector<size_t> RunSampling(size_t& nTries);
+    // Runs the sampling into the column 'samples' of the ids of the samples, without leaving the device.
+    void RunSampling(Matrix<ElemType>& samples);
 
 public:
     virtual void /*ComputationNode::*/ BackpropToNonLooping(size_t inputIndex) override {} // This node does not propagate gradients.
@@ -1279,7 +1028,9 @@ public:
 protected:
     bool m_allowDuplicates; // The node can create samples allowing for duplicates (sampling with replacement) or not (sampling without replacement).
     size_t m_sizeOfSampledSet; // Requested size of sample in case of run-mode = CREATE_SAMPLES.
-    std::vector<double> m_samplingWeightsPrefixSum;
+    uint64_t m_verifiedWeightsTimeStamp = std::numeric_limits<uint64_t>::max(); // eval time stamp of the weights when they were verified
+    shared_ptr<Matrix<ElemType>> m_samples;
+    shared_ptr<Matrix<ElemType>> m_samplingWorkspace;
 };
 
 // ------------------------------------------------------------------------------------------------------------------------------------------------
@@ -1316,7 +1067,6 @@ public:
     }
 
     virtual void /*ComputationNode::*/ ForwardPropNonLooping() override;
-    const std::vector<size_t> GetWeightedSamples();
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
     virtual bool IsOutOfDateWrtInputs() const override;
 };
@@ -1355,11 +1105,769 @@ private:
     // Assuming (falsely) that the number of tries to get a sampled set with the requested number of distinct values is always estimatedNumTries
     // the probability that a specific class in in the sampled set is (1 - (1-p)^estimatedNumTries), where p is the probablity to pick the clas in one draw.
     // The estimate can be quite a bit off but should be better than nothing. Better alternatives?
-    double EstimateInSampleFrequency(double p, double estimatedNumTries) const;
+    // estimatedNumTries is averaged over a few sampled sets, see Matrix::AssignWeightedSampleInclusionFrequencies().
+    static const size_t s_numExperiments = 10; // number of sampled sets; 10 without any deep justification
+};
 
-    double EstimateNumberOfTries();
+// -----------------------------------------------------------------------
+// SampledSoftmaxWithCrossEntropyNode (labels, hidden, weights, bias, samples, inclusionFrequencies)
+// Cross entropy of a softmax over a sampled set of candidate classes, for softmax layers over large vocabularies:
+//  - Input(0) [V x T] labels, one-hot (preferably sparse)
+//  - Input(1) [d x T] hidden activation, the input of the softmax layer
+//  - Input(2) [d x V] output embeddings, the logits of all classes would be weights^T hidden + bias
+//  - Input(3) [V] bias
+//  - Input(4) [V x K] samples, one set of K negative classes shared by the whole minibatch, e.g. RandomSample (sampleWeights, K, allowDuplicates)
+//  - Input(5) [V] expected number of occurrences of each class in the samples, e.g. RandomSampleInclusionFrequency (sampleWeights, K, allowDuplicates)
+// For each frame the softmax is taken over the true class and the K samples, with the logits corrected by the log of their
+// expected counts, and samples that happen to be the true class of a frame masked out (accidental hits).
+// Only the K + T columns of the weights selected by the samples and labels are gathered (sparse products with the samples
+// and labels), so forward and backward cost O(d K T) instead of O(d V T); the cross entropy and its gradient are
+// computed by the fused softmax kernels of CrossEntropyWithSoftmaxNode. With sparse labels the gradient of the weights
+// is block-sparse over the candidate classes. The value is the sampled criterion, also at evaluation time; use the full
+// softmax (e.g. CrossEntropyWithSoftmax of the same weights) to evaluate the model.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SampledSoftmaxWithCrossEntropyNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<6>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"SampledSoftmaxWithCrossEntropy"; }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(SampledSoftmaxWithCrossEntropyNode);
+    SampledSoftmaxWithCrossEntropyNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name), m_classIndices(deviceId), m_candidateLabels(deviceId), m_recomputeLogitsGradient(true)
+    {
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        // labels, samples and their frequencies are constants of the criterion
+        if (inputIndex == 0 || inputIndex > 3)
+            return;
+
+        if (m_recomputeLogitsGradient)
+        {
+            ComputeLogitsGradient();
+            m_recomputeLogitsGradient = false;
+        }
+
+        FrameRange fr(InputRef(0).GetMBLayout());
+        auto labels = InputRef(0).ValueFor(fr);
+        const auto& samples = InputRef(4).ValueAsMatrix();
+
+        if (inputIndex == 1) // hidden: weights_k dZ_k + weights_y .* dz_y
+        {
+            auto gradient = InputRef(1).GradientFor(fr);
+            Matrix<ElemType>::MultiplyAndAdd(*m_sampledWeights, false, *m_sampledLogitsGradient, false, gradient);
+            m_scaledColumns->SetValue(*m_labelWeights);
+            m_scaledColumns->RowElementMultiplyWith(*m_labelLogitsGradient);
+            gradient += *m_scaledColumns;
+        }
+        else if (inputIndex == 2) // weights: (hidden dZ_k^T) samples^T + (hidden .* dz_y) labels^T, only the candidate columns are touched
+        {
+            auto hidden = InputRef(1).MaskedValueFor(fr);
+            auto& gradient = InputRef(2).GradientAsMatrix();
+            m_sampledWeightsGradient->AssignProductOf(hidden, false, *m_sampledLogitsGradient, true);
+            Matrix<ElemType>::MultiplyAndAdd(*m_sampledWeightsGradient, false, samples, true, gradient);
+            m_scaledColumns->SetValue(hidden);
+            m_scaledColumns->RowElementMultiplyWith(*m_labelLogitsGradient);
+            Matrix<ElemType>::MultiplyAndAdd(*m_scaledColumns, false, labels, true, gradient);
+        }
+        else // bias: (sum_t dZ_k)^T samples^T + dz_y labels^T
+        {
+            size_t numClasses = samples.GetNumRows();
+            size_t numSamples = samples.GetNumCols();
+            auto gradient = InputRef(3).GradientAsMatrix().Reshaped(1, numClasses);
+            Matrix<ElemType>::VectorSum(*m_sampledLogitsGradient, *m_sampledBiasGradient, /*isColWise=*/false);
+            Matrix<ElemType>::MultiplyAndAdd(m_sampledBiasGradient->Reshaped(1, numSamples), false, samples, true, gradient);
+            Matrix<ElemType>::MultiplyAndAdd(*m_labelLogitsGradient, false, labels, true, gradient);
+        }
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+
+    virtual void UpdateFunctionMBSize() override
+    {
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(InputRef(0).GetMBLayout());
+        auto labels = InputRef(0).ValueFor(fr);
+        auto hidden = InputRef(1).MaskedValueFor(fr);
+        const auto& weights = InputRef(2).ValueAsMatrix();
+        const auto& samples = InputRef(4).ValueAsMatrix();
+        size_t numSamples = samples.GetNumCols();
+        size_t numCols = labels.GetNumCols();
+
+        // gather the output embeddings of the candidates
+        Matrix<ElemType>::Multiply(weights, false, samples, false, *m_sampledWeights);
+        Matrix<ElemType>::Multiply(weights, false, labels, false, *m_labelWeights);
+
+        // logits of the samples [K x T] and of the true classes [1 x T]
+        Matrix<ElemType>::Multiply(*m_sampledWeights, true, hidden, false, *m_sampledLogits);
+        AssignCandidateBiases(samples);
+        Matrix<ElemType>::ScaleAndAdd(1, m_candidateBiases->Reshaped(numSamples, 1), *m_sampledLogits);
+        Matrix<ElemType>::InnerProduct(*m_labelWeights, hidden, *m_labelLogits, /*isColWise=*/true);
+        AssignCandidateBiases(labels);
+        *m_labelLogits += *m_candidateBiases;
+
+        // remove the samples that are the true class of a frame: logits_k += LZERO * (sampleId_k == labelId_t)
+        Matrix<ElemType>::Multiply(ClassIndices(samples.GetNumRows()), false, samples, false, *m_sampleIds);
+        Matrix<ElemType>::Multiply(ClassIndices(samples.GetNumRows()), false, labels, false, *m_labelIds);
+        auto sampledLogits = TensorView<ElemType>(m_sampledLogits, TensorShape(numSamples, numCols));
+        sampledLogits.DoBinaryOpOf(1, TensorView<ElemType>(m_sampleIds, TensorShape(numSamples, 1)), TensorView<ElemType>(m_labelIds, TensorShape(1, numCols)),
+                                   (ElemType) LZERO, ElementWiseOperator::opEqual, ElementWiseOperator::opSum);
+
+        // candidate logits [(1 + K) x T], the true class first
+        m_logits->Resize(1 + numSamples, numCols);
+        m_logits->AssignToRowSliceValuesOf(*m_labelLogits, 0, 1);
+        m_logits->AssignToRowSliceValuesOf(*m_sampledLogits, 1, numSamples);
+        MaskMissingColumnsToZero(*m_logits, InputRef(0).GetMBLayout(), fr);
+
+        m_crossEntropyOfColumns->AssignSoftmaxCrossEntropyOf(CandidateLabels(1 + numSamples, numCols), *m_logits, *m_logSumExp);
+        // gaps hold the cross entropy of the zeroed logits
+        MaskMissingColumnsToZero(*m_crossEntropyOfColumns, InputRef(0).GetMBLayout(), fr);
+        Value().AssignSumOfElements(*m_crossEntropyOfColumns);
+        m_recomputeLogitsGradient = true;
+#if NANCHECK
+        Value().HasNan("SampledSoftmaxWithCrossEntropy");
+#endif
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        size_t numClasses = Input(0)->GetSampleMatrixNumRows();
+        size_t hiddenDim = Input(1)->GetSampleMatrixNumRows();
+
+        // infer the dimensions of the parameters from labels and hidden activation
+        Input(2)->ValidateInferInputDimsFrom(TensorShape(hiddenDim, numClasses));
+        Input(3)->ValidateInferInputDimsFrom(TensorShape(numClasses));
+
+        if (isFinalValidationPass)
+        {
+            if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout() || Input(2)->HasMBLayout() || Input(3)->HasMBLayout() || Input(4)->HasMBLayout() || Input(5)->HasMBLayout())
+                InvalidArgument("%ls %ls operation requires inputs 0 and 1 to be a minibatch, and inputs 2 to 5 to be matrices.", NodeName().c_str(), OperationName().c_str());
+            if (Input(0)->GetMBLayout() != Input(1)->GetMBLayout())
+                InvalidArgument("%ls %ls operation requires labels and hidden activation to have the same layout.", NodeName().c_str(), OperationName().c_str());
+            if (Input(2)->GetAsMatrixNumRows() != hiddenDim || Input(2)->GetAsMatrixNumCols() != numClasses)
+                InvalidArgument("%ls %ls operation: The weights [%d x %d] do not match the hidden activation [%d] and the labels [%d].", NodeName().c_str(), OperationName().c_str(),
+                                (int) Input(2)->GetAsMatrixNumRows(), (int) Input(2)->GetAsMatrixNumCols(), (int) hiddenDim, (int) numClasses);
+            if (Input(3)->GetSampleLayout().GetNumElements() != numClasses || Input(5)->GetSampleLayout().GetNumElements() != numClasses)
+                InvalidArgument("%ls %ls operation: The bias and the inclusion frequencies must have the dimension of the labels [%d].", NodeName().c_str(), OperationName().c_str(), (int) numClasses);
+            if (Input(4)->GetAsMatrixNumRows() != numClasses)
+                InvalidArgument("%ls %ls operation: The samples must be a [%d x numSamples] matrix.", NodeName().c_str(), OperationName().c_str(), (int) numClasses);
+            // class ids are compared as ElemType to find accidental hits
+            if (numClasses > (size_t) 1 << std::numeric_limits<ElemType>::digits)
+                InvalidArgument("%ls %ls operation: %d classes cannot be told apart in single precision.", NodeName().c_str(), OperationName().c_str(), (int) numClasses);
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<SampledSoftmaxWithCrossEntropyNode<ElemType>>(nodeP);
+            node->m_sampledWeights->SetValue(*m_sampledWeights);
+            node->m_labelWeights->SetValue(*m_labelWeights);
+            node->m_logits->SetValue(*m_logits);
+            node->m_logSumExp->SetValue(*m_logSumExp);
+            node->m_recomputeLogitsGradient = true;
+        }
+    }
+
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // As in TimesNode, the gradient of the weights is block sparse if both products with it are sparse:
+        // it then only holds the columns of the candidate classes.
+        if (Input(2)->NeedsGradient() && Input(0)->Value().GetMatrixType() == SPARSE && dynamic_pointer_cast<RandomSampleNode<ElemType>>(Input(4)))
+        {
+            auto& weightsGradientPtr = InputRef(2).GradientPtrRef();
+            if (!weightsGradientPtr || weightsGradientPtr->GetMatrixType() != SPARSE)
+                weightsGradientPtr = matrixPool.RequestSparse<ElemType>(Input(2)->GetDeviceId(), matrixFormatSparseBlockCol,
+                                                                        Input(2)->GetSampleLayout().GetNumElements(), Input(2)->HasMBLayout());
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_sampledWeights, matrixPool);
+        RequestMatrixFromPool(m_labelWeights, matrixPool);
+        RequestMatrixFromPool(m_sampledLogits, matrixPool);
+        RequestMatrixFromPool(m_labelLogits, matrixPool);
+        RequestMatrixFromPool(m_candidateBiases, matrixPool);
+        RequestMatrixFromPool(m_candidateFrequencies, matrixPool);
+        RequestMatrixFromPool(m_sampleIds, matrixPool);
+        RequestMatrixFromPool(m_labelIds, matrixPool);
+        RequestMatrixFromPool(m_logits, matrixPool);
+        RequestMatrixFromPool(m_logSumExp, matrixPool);
+        RequestMatrixFromPool(m_crossEntropyOfColumns, matrixPool);
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_logitsGradient, matrixPool);
+        RequestMatrixFromPool(m_sampledLogitsGradient, matrixPool);
+        RequestMatrixFromPool(m_labelLogitsGradient, matrixPool);
+        RequestMatrixFromPool(m_sampledWeightsGradient, matrixPool);
+        RequestMatrixFromPool(m_sampledBiasGradient, matrixPool);
+        RequestMatrixFromPool(m_scaledColumns, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_logitsGradient, matrixPool);
+        ReleaseMatrixToPool(m_sampledLogitsGradient, matrixPool);
+        ReleaseMatrixToPool(m_labelLogitsGradient, matrixPool);
+        ReleaseMatrixToPool(m_sampledWeightsGradient, matrixPool);
+        ReleaseMatrixToPool(m_sampledBiasGradient, matrixPool);
+        ReleaseMatrixToPool(m_scaledColumns, matrixPool);
+    }
+
+private:
+    // bias^T candidates - log(inclusionFrequencies^T candidates) into m_candidateBiases [1 x numCandidates]
+    void AssignCandidateBiases(const Matrix<ElemType>& candidates)
+    {
+        size_t numClasses = candidates.GetNumRows();
+        Matrix<ElemType>::Multiply(InputRef(3).ValueAsMatrix().Reshaped(1, numClasses), false, candidates, false, *m_candidateBiases);
+        Matrix<ElemType>::Multiply(InputRef(5).ValueAsMatrix().Reshaped(1, numClasses), false, candidates, false, *m_candidateFrequencies);
+        m_candidateFrequencies->InplaceLog();
+        *m_candidateBiases -= *m_candidateFrequencies;
+    }
+
+    // [1 x V] row (0, 1, ..., V - 1), times a one-hot matrix it yields the class ids of its columns
+    const Matrix<ElemType>& ClassIndices(size_t numClasses)
+    {
+        if (m_classIndices.GetNumCols() != numClasses)
+        {
+            std::vector<ElemType> indices(numClasses);
+            for (size_t i = 0; i < numClasses; i++)
+                indices[i] = (ElemType) i;
+            m_classIndices.SetValue(1, numClasses, m_deviceId, indices.data());
+        }
+        return m_classIndices;
+    }
+
+    // [(1 + K) x T] labels of the candidate logits, the true class is always the first candidate
+    const Matrix<ElemType>& CandidateLabels(size_t numCandidates, size_t numCols)
+    {
+        if (m_candidateLabels.GetNumRows() != numCandidates || m_candidateLabels.GetNumCols() != numCols)
+        {
+            m_candidateLabels.Resize(numCandidates, numCols);
+            m_candidateLabels.SetValue(0);
+            m_candidateLabels.AssignToRowSliceValuesOf(Matrix<ElemType>::Ones(1, numCols, m_deviceId), 0, 1);
+        }
+        return m_candidateLabels;
+    }
+
+    // gradient of the criterion w.r.t. the candidate logits, split into samples [K x T] and true classes [1 x T]
+    void ComputeLogitsGradient()
+    {
+        FrameRange fr(InputRef(0).GetMBLayout());
+        size_t numSamples = m_sampledLogits->GetNumRows();
+        m_logitsGradient->Resize(*m_logits);
+        m_logitsGradient->SetValue(0);
+        Matrix<ElemType>::AddSoftmaxCrossEntropyGradient(Gradient(), *m_logits, *m_logSumExp, m_candidateLabels, *m_logitsGradient);
+        MaskMissingColumnsToZero(*m_logitsGradient, InputRef(0).GetMBLayout(), fr);
+        m_labelLogitsGradient->AssignRowSliceValuesOf(*m_logitsGradient, 0, 1);
+        m_sampledLogitsGradient->AssignRowSliceValuesOf(*m_logitsGradient, 1, numSamples);
+    }
+
+    Matrix<ElemType> m_classIndices;    // [1 x V], see ClassIndices()
+    Matrix<ElemType> m_candidateLabels; // [(1 + K) x T], see CandidateLabels()
+
+    shared_ptr<Matrix<ElemType>> m_sampledWeights;       // [d x K]
+    shared_ptr<Matrix<ElemType>> m_labelWeights;         // [d x T]
+    shared_ptr<Matrix<ElemType>> m_sampledLogits;        // [K x T]
+    shared_ptr<Matrix<ElemType>> m_labelLogits;          // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_candidateBiases;      // [1 x K] or [1 x T]
+    shared_ptr<Matrix<ElemType>> m_candidateFrequencies; // [1 x K] or [1 x T]
+    shared_ptr<Matrix<ElemType>> m_sampleIds;            // [1 x K]
+    shared_ptr<Matrix<ElemType>> m_labelIds;             // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_logits;               // [(1 + K) x T]
+    shared_ptr<Matrix<ElemType>> m_logSumExp;            // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_crossEntropyOfColumns; // [1 x T]
+
+    shared_ptr<Matrix<ElemType>> m_logitsGradient;         // [(1 + K) x T]
+    shared_ptr<Matrix<ElemType>> m_sampledLogitsGradient;  // [K x T]
+    shared_ptr<Matrix<ElemType>> m_labelLogitsGradient;    // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_sampledWeightsGradient; // [d x K]
+    shared_ptr<Matrix<ElemType>> m_sampledBiasGradient;    // [K x 1]
+    shared_ptr<Matrix<ElemType>> m_scaledColumns;          // [d x T]
+
+    bool m_recomputeLogitsGradient;
+};
+
+template class SampledSoftmaxWithCrossEntropyNode<float>;
+template class SampledSoftmaxWithCrossEntropyNode<double>;
+
+// -----------------------------------------------------------------------
+// VocabularyShard -- the words of a vocabulary-parallel node that this rank holds, and the exchange of its columns
+// -----------------------------------------------------------------------
+
+// ShardedSoftmaxWithCrossEntropyNode and ShardedEmbeddingNode have weights [d x V] with one column per word of a large
+// vocabulary. With vocabulary parallelism (ComputationNetwork::ShardVocabularyParallelNodes()), each of the N ranks of a
+// communicator keeps only the columns of a contiguous shard of the words, [V * rank / N, V * (rank + 1) / N), and computes
+// that shard for the samples of all ranks: the ranks gather the columns of their minibatches (GatherColumns()) and sum the
+// partial results of the shards (SumOverShards()), both all-reduces of buffers with room for the largest minibatch of
+// each rank, zero where a rank has fewer columns. Without a communicator, a single shard holds all words, and the nodes
+// compute what CrossEntropyWithSoftmax() and Times() would.
+template <class ElemType>
+class VocabularyShard
+{
+public:
+    VocabularyShard()
+        : m_rank(0), m_numShards(1), m_numColumns(0), m_maxColumns(0), m_numShardLabels(0)
+    {
+    }
+    virtual ~VocabularyShard() {}
+
+    // makes this rank hold shard 'rank' of 'numShards', exchanging with the other ranks through 'comm' (nullptr for 1 shard)
+    void SetShard(const std::shared_ptr<NcclComm>& comm, size_t rank, size_t numShards)
+    {
+        if (rank >= numShards || (numShards > 1) != (comm != nullptr))
+            LogicError("SetShard: Shard %d of %d is not valid, or a communicator is missing.", (int) rank, (int) numShards);
+        m_comm = comm;
+        m_rank = rank;
+        m_numShards = numShards;
+    }
+    bool IsSharded() const { return m_numShards > 1; }
+    size_t ShardRank() const { return m_rank; }
+    size_t NumShards() const { return m_numShards; }
+
+    // the words [ShardBegin(), ShardEnd()) of this shard of 'vocabSize' words
+    size_t ShardBegin(size_t vocabSize) const { return vocabSize * m_rank / m_numShards; }
+    size_t ShardEnd(size_t vocabSize) const { return vocabSize * (m_rank + 1) / m_numShards; }
+
+    // the number of words, and the input that holds the weights
+    virtual size_t VocabSize() const = 0;
+    virtual size_t WeightsInputIndex() const = 0;
+
+    // the weights [d x V'] of this shard -> [d x V] of all words, collective, resp. back
+    void GatherWeights(Matrix<ElemType>& weights) const;
+    void CutWeights(Matrix<ElemType>& weights) const;
+
+protected:
+    // Exchanges the number of columns of the minibatches of all ranks: those of rank r go to the columns
+    // [r * m_maxColumns, r * m_maxColumns + (its number of columns)) of the gathered matrices. Collective, as are the following.
+    void ExchangeNumColumns(size_t numColumns, DEVICEID_TYPE deviceId);
+    size_t NumGatheredColumns() const { return m_numShards * m_maxColumns; }
+    size_t FirstOwnColumn() const { return m_rank * m_maxColumns; }
+    size_t NumOwnColumns() const { return m_numColumns; }
+
+    // 'all' [R x NumGatheredColumns()] = the columns 'mine' [R x numColumns] of all ranks
+    void GatherColumns(const Matrix<ElemType>& mine, Matrix<ElemType>& all) const;
+    // 'all' = the sum of 'all' over the ranks
+    void SumOverShards(Matrix<ElemType>& all) const;
+
+    // [1 x V] row (1, 2, ..., V); times a one-hot matrix it yields the word ids of its columns, counted from 1 so that gaps yield 0
+    const Matrix<ElemType>& WordIds(DEVICEID_TYPE deviceId);
+    // Sets ShardLabels() [V' x T_all], sparse, to the one-hot labels of the words of this shard from the gathered word ids
+    // [1 x T_all], and 'validColumns' (optional) to 1 in the columns of any word, 0 in gaps and padding.
+    void AssignShardLabels(const Matrix<ElemType>& gatheredWordIds, Matrix<ElemType>* validColumns);
+    const Matrix<ElemType>& ShardLabels() const { return *m_shardLabels; }
+    size_t NumShardLabels() const { return m_numShardLabels; }
+
+    void CopyShardTo(VocabularyShard<ElemType>& other) const { other.SetShard(m_comm, m_rank, m_numShards); }
+
+private:
+    std::shared_ptr<NcclComm> m_comm;
+    size_t m_rank;
+    size_t m_numShards;
+
+    size_t m_numColumns; // of the minibatch of this rank
+    size_t m_maxColumns; // of the largest minibatch of all ranks
+
+    std::shared_ptr<Matrix<ElemType>> m_wordIds;     // [1 x V], see WordIds()
+    std::shared_ptr<Matrix<ElemType>> m_shardLabels; // [V' x T_all], sparse, see AssignShardLabels()
+    size_t m_numShardLabels;
+    std::vector<ElemType> m_hostBuffer;
 };
 
+// -----------------------------------------------------------------------
+// ShardedSoftmaxWithCrossEntropyNode (labels, hidden, weights)
+// Cross entropy with softmax of an output layer over a large vocabulary, CrossEntropyWithSoftmax (labels, weights^T hidden),
+// whose weights can be sharded across ranks by words (vocabulary parallelism, see VocabularyShard):
+//  - Input(0) [V x T] labels, one-hot (preferably sparse)
+//  - Input(1) [d x T] hidden activation, the input of the softmax layer
+//  - Input(2) [d x V] output embeddings, resp. [d x V'] the columns of the words of the shard of this rank
+// Each rank computes the logits of the words of its shard for the samples of all ranks [V' x T_all], and the ranks combine
+// the maxima and the sums of the exponentials of them into the log-sum-exp over all words, in one all-reduce that also
+// carries the logits of the true words. The value is the cross entropy of the samples of this rank. The gradient of the
+// weights covers the samples of all ranks and is thus complete for the shard; it must not be aggregated across the ranks.
+// The gradient of the criterion (e.g. a loss scale) must be the same on all ranks.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class ShardedSoftmaxWithCrossEntropyNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<3>, public VocabularyShard<ElemType>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    typedef VocabularyShard<ElemType> Shard;
+    static const std::wstring TypeName() { return L"ShardedSoftmaxWithCrossEntropy"; }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(ShardedSoftmaxWithCrossEntropyNode);
+    ShardedSoftmaxWithCrossEntropyNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name), m_recomputeLogitsGradient(true)
+    {
+    }
+
+    virtual size_t VocabSize() const override { return Input(0)->GetSampleMatrixNumRows(); }
+    virtual size_t WeightsInputIndex() const override { return 2; }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        // the labels are constants of the criterion
+        if (inputIndex == 0)
+            return;
+
+        if (m_recomputeLogitsGradient)
+        {
+            // gradient of the logits of the shard: (softmax - labels) times the gradient of the criterion
+            if (Shard::NumShardLabels() > 0)
+                Matrix<ElemType>::ScaleAndAdd(-1, Shard::ShardLabels(), *m_softmax);
+            Matrix<ElemType>::Scale(Gradient(), *m_softmax);
+            m_recomputeLogitsGradient = false;
+        }
+
+        if (inputIndex == 1) // hidden: weights dZ, summed over the shards, of the samples of this rank
+        {
+            Matrix<ElemType>::Multiply(InputRef(2).ValueAsMatrix(), false, *m_softmax, false, *m_gatheredHiddenGradient);
+            Shard::SumOverShards(*m_gatheredHiddenGradient);
+            FrameRange fr(InputRef(0).GetMBLayout());
+            auto gradient = InputRef(1).GradientFor(fr);
+            if (Shard::NumOwnColumns() > 0)
+                gradient += m_gatheredHiddenGradient->ColumnSlice(Shard::FirstOwnColumn(), Shard::NumOwnColumns());
+        }
+        else // weights: hidden dZ^T over the samples of all ranks
+            Matrix<ElemType>::MultiplyAndAdd(*m_gatheredHidden, false, *m_softmax, true, InputRef(2).GradientAsMatrix());
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+
+    virtual void UpdateFunctionMBSize() override
+    {
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(InputRef(0).GetMBLayout());
+        auto labels = InputRef(0).ValueFor(fr);
+        auto hidden = InputRef(1).MaskedValueFor(fr);
+        const auto& weights = InputRef(2).ValueAsMatrix();
+
+        // the hidden activations and the labels of the samples of all ranks
+        Matrix<ElemType>::Multiply(Shard::WordIds(m_deviceId), false, labels, false, *m_wordIdsOfColumns);
+        Shard::ExchangeNumColumns(labels.GetNumCols(), m_deviceId);
+        Shard::GatherColumns(hidden, *m_gatheredHidden);
+        Shard::GatherColumns(*m_wordIdsOfColumns, *m_gatheredWordIds);
+        Shard::AssignShardLabels(*m_gatheredWordIds, m_validColumns.get());
+        size_t shardSize = weights.GetNumCols();
+        size_t numCols = Shard::NumGatheredColumns();
+
+        // logits of the true words that are in this shard [1 x T_all], 0 for the others
+        m_labelLogits->Resize(1, numCols);
+        m_labelLogits->SetValue(0);
+        if (Shard::NumShardLabels() > 0)
+        {
+            Matrix<ElemType>::Multiply(weights, false, Shard::ShardLabels(), false, *m_labelWeights);
+            Matrix<ElemType>::InnerProduct(*m_labelWeights, *m_gatheredHidden, *m_labelLogits, /*isColWise=*/true);
+        }
+
+        // logits of the words of this shard [V' x T_all] relative to their maximum, and the sum of their exponentials
+        Matrix<ElemType>::Multiply(weights, true, *m_gatheredHidden, false, *m_softmax);
+        m_softmax->VectorMax(*m_maxIndexes, *m_maxOfColumns, /*isColWise=*/true);
+        auto logits = TensorView<ElemType>(m_softmax, TensorShape(shardSize, numCols));
+        auto maxOfColumns = TensorView<ElemType>(m_maxOfColumns, TensorShape(1, numCols));
+        logits.AssignDifferenceOf(logits, maxOfColumns);
+        m_sumOfColumns->Resize(1, numCols);
+        TensorView<ElemType>(m_sumOfColumns, TensorShape(1, numCols)).DoUnaryOpOf(0, logits, 1, ElementWiseOperator::opExp, ElementWiseOperator::opSum);
+
+        // log-sum-exp over all words: max + log(sum_r sum_r exp(max_r - max)) over the shards r with their maxima max_r
+        if (Shard::IsSharded())
+        {
+            size_t numShards = Shard::NumShards();
+            size_t rank = Shard::ShardRank();
+            m_columnStats->Resize(2 * numShards + 1, numCols);
+            m_columnStats->SetValue(0);
+            m_columnStats->AssignToRowSliceValuesOf(*m_maxOfColumns, rank, 1);
+            m_columnStats->AssignToRowSliceValuesOf(*m_sumOfColumns, numShards + rank, 1);
+            m_columnStats->AssignToRowSliceValuesOf(*m_labelLogits, 2 * numShards, 1);
+            Shard::SumOverShards(*m_columnStats);
+            m_shardMaxima->AssignRowSliceValuesOf(*m_columnStats, 0, numShards);
+            m_shardSums->AssignRowSliceValuesOf(*m_columnStats, numShards, numShards);
+            m_labelLogits->AssignRowSliceValuesOf(*m_columnStats, 2 * numShards, 1);
+            m_shardMaxima->VectorMax(*m_maxIndexes, *m_logSumExp, /*isColWise=*/true);
+            auto shardSums = TensorView<ElemType>(m_shardSums, TensorShape(numShards, numCols));
+            shardSums.AssignElementwiseProductWithExpOfDiffOf(shardSums, TensorView<ElemType>(m_shardMaxima, TensorShape(numShards, numCols)),
+                                                             TensorView<ElemType>(m_logSumExp, TensorShape(1, numCols)));
+            Matrix<ElemType>::VectorSum(*m_shardSums, *m_sumOfColumns, /*isColWise=*/true);
+        }
+        else
+            m_logSumExp->AssignValuesOf(*m_maxOfColumns);
+        m_sumOfColumns->InplaceLog();
+        *m_logSumExp += *m_sumOfColumns;
+
+        // softmax of the words of this shard, exp(logit - max - (logSumExp - max)), zero in gaps and padding
+        maxOfColumns.AssignDifferenceOf(TensorView<ElemType>(m_logSumExp, TensorShape(1, numCols)), maxOfColumns);
+        logits.AssignElementwiseProductWithExpOfDiffOf(TensorView<ElemType>(m_validColumns, TensorShape(1, numCols)), logits, maxOfColumns);
+
+        // cross entropy of the samples of this rank
+        m_crossEntropyOfColumns->AssignDifferenceOf(*m_logSumExp, *m_labelLogits);
+        m_crossEntropyOfColumns->ElementMultiplyWith(*m_validColumns);
+        if (Shard::NumOwnColumns() > 0)
+            Value().AssignSumOfElements(m_crossEntropyOfColumns->ColumnSlice(Shard::FirstOwnColumn(), Shard::NumOwnColumns()));
+        else
+            Value().SetValue(0);
+        m_recomputeLogitsGradient = true;
+#if NANCHECK
+        Value().HasNan("ShardedSoftmaxWithCrossEntropy");
+#endif
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        size_t vocabSize = Input(0)->GetSampleMatrixNumRows();
+        size_t hiddenDim = Input(1)->GetSampleMatrixNumRows();
+        size_t shardSize = Shard::ShardEnd(vocabSize) - Shard::ShardBegin(vocabSize);
+
+        // infer the dimensions of the weights from labels and hidden activation
+        Input(2)->ValidateInferInputDimsFrom(TensorShape(hiddenDim, shardSize));
+
+        if (isFinalValidationPass)
+        {
+            if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout() || Input(2)->HasMBLayout())
+                InvalidArgument("%ls %ls operation requires inputs 0 and 1 to be a minibatch, and input 2 to be a matrix.", NodeName().c_str(), OperationName().c_str());
+            if (Input(0)->GetMBLayout() != Input(1)->GetMBLayout())
+                InvalidArgument("%ls %ls operation requires labels and hidden activation to have the same layout.", NodeName().c_str(), OperationName().c_str());
+            if (Input(2)->GetAsMatrixNumRows() != hiddenDim || Input(2)->GetAsMatrixNumCols() != shardSize)
+                InvalidArgument("%ls %ls operation: The weights [%d x %d] do not match the hidden activation [%d] and the %d words of the shard.", NodeName().c_str(), OperationName().c_str(),
+                                (int) Input(2)->GetAsMatrixNumRows(), (int) Input(2)->GetAsMatrixNumCols(), (int) hiddenDim, (int) shardSize);
+            // word ids are passed as ElemType
+            if (vocabSize > (size_t) 1 << std::numeric_limits<ElemType>::digits)
+                InvalidArgument("%ls %ls operation: %d words cannot be told apart in single precision.", NodeName().c_str(), OperationName().c_str(), (int) vocabSize);
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<ShardedSoftmaxWithCrossEntropyNode<ElemType>>(nodeP);
+            Shard::CopyShardTo(*node);
+            node->m_recomputeLogitsGradient = true;
+        }
+    }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_wordIdsOfColumns, matrixPool);
+        RequestMatrixFromPool(m_gatheredHidden, matrixPool);
+        RequestMatrixFromPool(m_gatheredWordIds, matrixPool);
+        RequestMatrixFromPool(m_validColumns, matrixPool);
+        RequestMatrixFromPool(m_labelWeights, matrixPool);
+        RequestMatrixFromPool(m_labelLogits, matrixPool);
+        RequestMatrixFromPool(m_softmax, matrixPool);
+        RequestMatrixFromPool(m_maxIndexes, matrixPool);
+        RequestMatrixFromPool(m_maxOfColumns, matrixPool);
+        RequestMatrixFromPool(m_sumOfColumns, matrixPool);
+        RequestMatrixFromPool(m_columnStats, matrixPool);
+        RequestMatrixFromPool(m_shardMaxima, matrixPool);
+        RequestMatrixFromPool(m_shardSums, matrixPool);
+        RequestMatrixFromPool(m_logSumExp, matrixPool);
+        RequestMatrixFromPool(m_crossEntropyOfColumns, matrixPool);
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_gatheredHiddenGradient, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gatheredHiddenGradient, matrixPool);
+    }
+
+private:
+    shared_ptr<Matrix<ElemType>> m_wordIdsOfColumns;      // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_gatheredHidden;        // [d x T_all]
+    shared_ptr<Matrix<ElemType>> m_gatheredWordIds;       // [1 x T_all]
+    shared_ptr<Matrix<ElemType>> m_validColumns;          // [1 x T_all]
+    shared_ptr<Matrix<ElemType>> m_labelWeights;          // [d x T_all]
+    shared_ptr<Matrix<ElemType>> m_labelLogits;           // [1 x T_all]
+    shared_ptr<Matrix<ElemType>> m_softmax;               // [V' x T_all], the logits, then the softmax, then its gradient
+    shared_ptr<Matrix<ElemType>> m_maxIndexes;            // [1 x T_all]
+    shared_ptr<Matrix<ElemType>> m_maxOfColumns;          // [1 x T_all]
+    shared_ptr<Matrix<ElemType>> m_sumOfColumns;          // [1 x T_all]
+    shared_ptr<Matrix<ElemType>> m_columnStats;           // [2 N + 1 x T_all], maxima and sums of the N shards, and the logits of the true words
+    shared_ptr<Matrix<ElemType>> m_shardMaxima;           // [N x T_all]
+    shared_ptr<Matrix<ElemType>> m_shardSums;             // [N x T_all]
+    shared_ptr<Matrix<ElemType>> m_logSumExp;             // [1 x T_all]
+    shared_ptr<Matrix<ElemType>> m_crossEntropyOfColumns; // [1 x T_all]
+
+    shared_ptr<Matrix<ElemType>> m_gatheredHiddenGradient; // [d x T_all]
+
+    bool m_recomputeLogitsGradient;
+};
+
+template class ShardedSoftmaxWithCrossEntropyNode<float>;
+template class ShardedSoftmaxWithCrossEntropyNode<double>;
+
+// -----------------------------------------------------------------------
+// ShardedEmbeddingNode (weights, input)
+// Embedding of the words of a large vocabulary, Times (weights, input), whose weights can be sharded across ranks by words
+// (vocabulary parallelism, see VocabularyShard):
+//  - Input(0) [d x V] embeddings, resp. [d x V'] the columns of the words of the shard of this rank
+//  - Input(1) [V x T] words, one-hot (preferably sparse)
+// Each rank looks up the words of its shard for the samples of all ranks, and the ranks sum the embeddings in an all-reduce.
+// For the gradient of the weights the ranks gather the gradients of all samples, so that it is complete for the shard;
+// it must not be aggregated across the ranks.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class ShardedEmbeddingNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<2>, public VocabularyShard<ElemType>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    typedef VocabularyShard<ElemType> Shard;
+    static const std::wstring TypeName() { return L"ShardedEmbedding"; }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(ShardedEmbeddingNode);
+    ShardedEmbeddingNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+
+    virtual size_t VocabSize() const override { return Input(1)->GetSampleMatrixNumRows(); }
+    virtual size_t WeightsInputIndex() const override { return 0; }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        // the words are constants
+        if (inputIndex == 1)
+            return;
+
+        // weights: the gradients of the samples of all ranks times the labels of the words of the shard
+        FrameRange fr(InputRef(1).GetMBLayout());
+        Shard::GatherColumns(GradientFor(fr), *m_gatheredGradient);
+        if (Shard::NumShardLabels() > 0)
+            Matrix<ElemType>::MultiplyAndAdd(*m_gatheredGradient, false, Shard::ShardLabels(), true, InputRef(0).GradientAsMatrix());
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(InputRef(1).GetMBLayout());
+        auto input = InputRef(1).ValueFor(fr);
+        const auto& weights = InputRef(0).ValueAsMatrix();
+
+        // the words of the samples of all ranks
+        Matrix<ElemType>::Multiply(Shard::WordIds(m_deviceId), false, input, false, *m_wordIdsOfColumns);
+        Shard::ExchangeNumColumns(input.GetNumCols(), m_deviceId);
+        Shard::GatherColumns(*m_wordIdsOfColumns, *m_gatheredWordIds);
+        Shard::AssignShardLabels(*m_gatheredWordIds, nullptr);
+
+        // the embeddings of the words of this shard [d x T_all], summed over the shards
+        m_gatheredValue->Resize(weights.GetNumRows(), Shard::NumGatheredColumns());
+        if (Shard::NumShardLabels() > 0)
+            Matrix<ElemType>::Multiply(weights, false, Shard::ShardLabels(), false, *m_gatheredValue);
+        else
+            m_gatheredValue->SetValue(0);
+        Shard::SumOverShards(*m_gatheredValue);
+        if (Shard::NumOwnColumns() > 0)
+            ValueFor(fr).AssignValuesOf(m_gatheredValue->ColumnSlice(Shard::FirstOwnColumn(), Shard::NumOwnColumns()));
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = Input(1)->GetMBLayout();
+
+        size_t vocabSize = Input(1)->GetSampleMatrixNumRows();
+        size_t shardSize = Shard::ShardEnd(vocabSize) - Shard::ShardBegin(vocabSize);
+        if (isFinalValidationPass)
+        {
+            if (Input(0)->HasMBLayout() || !Input(1)->HasMBLayout())
+                InvalidArgument("%ls %ls operation requires input 0 to be a matrix, and input 1 to be a minibatch.", NodeName().c_str(), OperationName().c_str());
+            if (Input(0)->GetAsMatrixNumCols() != shardSize)
+                InvalidArgument("%ls %ls operation: The weights [%d x %d] do not match the %d words of the shard.", NodeName().c_str(), OperationName().c_str(),
+                                (int) Input(0)->GetAsMatrixNumRows(), (int) Input(0)->GetAsMatrixNumCols(), (int) shardSize);
+            // word ids are passed as ElemType
+            if (vocabSize > (size_t) 1 << std::numeric_limits<ElemType>::digits)
+                InvalidArgument("%ls %ls operation: %d words cannot be told apart in single precision.", NodeName().c_str(), OperationName().c_str(), (int) vocabSize);
+        }
+
+        SetDims(TensorShape(Input(0)->GetAsMatrixNumRows()), true);
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+            Shard::CopyShardTo(*dynamic_pointer_cast<ShardedEmbeddingNode<ElemType>>(nodeP));
+    }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_wordIdsOfColumns, matrixPool);
+        RequestMatrixFromPool(m_gatheredWordIds, matrixPool);
+        RequestMatrixFromPool(m_gatheredValue, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_wordIdsOfColumns, matrixPool);
+        ReleaseMatrixToPool(m_gatheredWordIds, matrixPool);
+        ReleaseMatrixToPool(m_gatheredValue, matrixPool);
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_gatheredGradient, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gatheredGradient, matrixPool);
+    }
+
+private:
+    shared_ptr<Matrix<ElemType>> m_wordIdsOfColumns; // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_gatheredWordIds;  // [1 x T_all]
+    shared_ptr<Matrix<ElemType>> m_gatheredValue;    // [d x T_all]
+    shared_ptr<Matrix<ElemType>> m_gatheredGradient; // [d x T_all]
+};
+
+template class ShardedEmbeddingNode<float>;
+template class ShardedEmbeddingNode<double>;
+
 // -----------------------------------------------------------------------
 // ClassBasedCrossEntropyWithSoftmaxNode (labeldata(.,t), inputdata(.,t), embeddingMatrix, clsProbBeforeSoftmaxData(.,t))
 //  - Input(0) [4 x T] label in dense matrix in
@@ -1622,16 +2130,17 @@ protected:
 template class ClassBasedCrossEntropyWithSoftmaxNode<float>;
 template class ClassBasedCrossEntropyWithSoftmaxNode<double>;
 
-#ifdef COMING_SOON
-
 // -----------------------------------------------------------------------
 // CRFNode (labels, position_dependent_scores, transition_scores)
 //  - labels: output label vector of [0:T-1]
 //  - position_dependent_scores [0:T-1]: score from position dependent node,
 //    in the R-CRF case, it is the RNN output score before softmax
-//  - transition scores: square transition matrix,  --TODO: log?
+//  - transition scores: square transition matrix, transition_scores(k, j) is the score of label k following label j,
 //    in the R-CRF case, it is the transition probability between labels
-// BUGBUG: This node cannot operate with truncated BPTT, but does not detect it. It also does not handle gaps or test boundary flags.
+// The value is the negative log likelihood of the labels, summed over the sequences of the minibatch. Each sequence
+// starts from the label of its first frame, which is usually a sentence-begin label.
+// All sequences of the minibatch are computed at once (see LinearChainCRF.h). Sequences must be whole: this node
+// does not work with truncated BPTT.
 // -----------------------------------------------------------------------
 
 /**
@@ -1662,49 +2171,31 @@ class CRFNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>,
 public:
     DeclareConstructorFromConfigWithNumInputs(CRFNode);
     CRFNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name),
-          mAlpha(deviceId),
-          mBeta(deviceId),
-          mPostProb(deviceId)
+        : Base(deviceId, name)
     {
     }
 
-    // compute posterior probability of label y at position t
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(InputRef(0).GetMBLayout());
-        size_t nrow = InputRef(0).Value().GetNumRows();
-        size_t ncol = InputRef(0).Value().GetNumCols();
-
-        mAlpha.Resize(nrow, ncol);
-        mBeta.Resize(nrow, ncol);
-        mPostProb.Resize(nrow, ncol);
-
-        Value().SetValue(0.0);
-        Matrix<ElemType> funcVal = Value(); // TODO: This just creates a 1x1 matrix set to 0.
-
-        size_t nS = InputRef(0).GetNumParallelSequences();
-        if (nS != 1)
-            LogicError("CRFNode: >1 parallel sequences are curently not implemented correctly.");
-        for (size_t i = 0; i < nS; i++) // process parallel sequences one by one  --BUGBUG: We should loop over individual sequences.
-        {
-            FrameRange sequenceRange = fr.Sequence(i); // FrameRange to select one sequence
-            // BUGBUG: This ^^ is neither supported nor correct, since this code does not handle gaps or start/end flags.
-            ForwardPropS(
-                DataWithMBLayoutFor(mPostProb, sequenceRange, InputRef(0).GetMBLayout()),
-                DataWithMBLayoutFor(mAlpha, sequenceRange, InputRef(0).GetMBLayout()),
-                DataWithMBLayoutFor(mBeta, sequenceRange, InputRef(0).GetMBLayout()),
-                funcVal,
-                InputRef(0).ValueFor(sequenceRange),
-                InputRef(1).ValueFor(sequenceRange),
-                InputRef(2).ValueAsMatrix(), mStartLbl,
-                mEndLbl);
-
-            Value() += funcVal; // aggregate over sequences
-        }
+        size_t numParallelSequences = InputRef(0).GetNumParallelSequences();
+        const Matrix<ElemType>& scores = InputRef(1).ValueFor(fr);
+        const Matrix<ElemType>& transitions = InputRef(2).ValueAsMatrix();
+
+        InputRef(0).MaskMissingValueColumnsToZero(fr);
+        InputRef(0).ValueFor(fr).VectorMax(*m_labelIndices, *m_maxValues, /*isColWise=*/true);
+        AssignSequenceRanges(*m_sequences, InputRef(0).GetMBLayout());
+
+        m_alpha->AssignCRFForwardScores(scores, transitions, *m_labelIndices, *m_sequences, numParallelSequences);
+        m_sequenceLosses->AssignCRFNegativeLogLikelihoods(*m_alpha, scores, transitions, *m_labelIndices, *m_sequences, numParallelSequences);
+        Value().AssignSumOfElements(*m_sequenceLosses);
+
+        // the posteriors are only needed for the gradients
+        if (Environment().IsTraining())
+            m_logPosteriors->AssignCRFLogPosteriors(*m_alpha, scores, transitions, *m_sequences, numParallelSequences);
     }
 
-    virtual void BackpropToNonLooping(size_t inputIndex) override // scaled by 2*number of colmns (samples) in the Matrix<ElemType>
+    virtual void BackpropToNonLooping(size_t inputIndex) override
     {
         FrameRange fr(InputRef(0).GetMBLayout());
         // this should never be called for input[0], which is controlled through learningRateMultiplier == 0
@@ -1713,27 +2204,20 @@ public:
 
         if (inputIndex == 1)
         {
+            // posteriors - labels
+            m_posteriors->SetValue(*m_logPosteriors);
+            m_posteriors->InplaceExp();
+            MaskMissingColumnsToZero(*m_posteriors, InputRef(0).GetMBLayout(), fr);
             auto gradient = InputRef(1).GradientFor(fr);
-            Matrix<ElemType>::AddScaledDifference(Gradient(), mPostProb, InputRef(0).ValueFor(fr), gradient);
+            Matrix<ElemType>::AddScaledDifference(Gradient(), *m_posteriors, InputRef(0).ValueFor(fr), gradient);
         }
-        else if (inputIndex == 2)
+        else
         {
-            assert(InputRef(inputIndex).GradientFor(fr).GetNumElements() > 0);
-            size_t nS = InputRef(0).GetNumParallelSequences();
-            for (size_t i = 0; i < nS; i++) // process all sequences one by one
-            {
-                FrameRange sequenceRange = fr.Sequence(i); // FrameRange to select one sequence
-                auto& gradient = InputRef(2).GradientAsMatrix();
-                TransGrdCompute(InputRef(0).ValueFor(sequenceRange),
-                                DataWithMBLayoutFor(mAlpha, sequenceRange, InputRef(0).GetMBLayout()),
-                                DataWithMBLayoutFor(mBeta, sequenceRange, InputRef(0).GetMBLayout()),
-                                InputRef(2).ValueAsMatrix(),
-                                gradient,
-                                mStartLbl, 1);
-            }
+            size_t numParallelSequences = InputRef(0).GetNumParallelSequences();
+            m_transitionGradient->AssignCRFTransitionGradient(*m_logPosteriors, *m_alpha, InputRef(1).ValueFor(fr), InputRef(2).ValueAsMatrix(),
+                                                              *m_labelIndices, *m_sequences, numParallelSequences);
+            Matrix<ElemType>::Multiply1x1AndWeightedAdd(+1, Gradient(), *m_transitionGradient, 1, InputRef(2).GradientAsMatrix());
         }
-        else
-            return;
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override
@@ -1741,147 +2225,6 @@ public:
         return false;
     }
 
-    // compute forward backward algorithm
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType> postprob, Matrix<ElemType> alpha, Matrix<ElemType> beta, Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, int& firstLbl, int& lastLbl, const int iStep = 1)
-    {
-        // to-do, each slice is for one sentence
-        // to-do, number of slices correspond to number of frames
-        // this implementation only supports one sentence per minibatch
-
-        int nObs = lbls.GetNumCols();
-
-        // change to other values so can support multiple sentences in each minibatch
-        assert(iStep == 1);
-        ForwardCompute(alpha, lbls, pos_scores, pair_scores);
-        BackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, iStep);
-        PostProbCompute(postprob, alpha, beta);
-
-        firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, nObs - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
-
-        functionValues.AssignInnerProductOfMatrices(lbls, pos_scores);
-
-        Matrix<ElemType> a = alpha.ColumnSlice(nObs - 1, 1);
-        ElemType fAlpha;
-        fAlpha = a.LogSumOfElements();
-
-        // transition score
-        ElemType tscore = 0;
-        for (int t = 0; t < nObs - 1; t++)
-        {
-            int i = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t) != 0)
-                {
-                    i = ik;
-                    break;
-                }
-            int j = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t + 1) != 0)
-                {
-                    j = ik;
-                    break;
-                }
-            tscore += pair_scores(j, i);
-        }
-        tscore += functionValues.Get00Element(); // correct path score
-        tscore -= fAlpha;                        // reduced by the scores from all paths
-        functionValues.SetValue(tscore);
-
-        functionValues *= (-1);
-    }
-
-    // compute forward backward algorithm
-    static void ForwardCompute(Matrix<ElemType>& alpha,
-                               const Matrix<ElemType>& lbls,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores)
-    {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = lbls.GetNumCols();
-        int iNumLab = lbls.GetNumRows();
-
-        int firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                for (int j = 0; j < iNumLab; j++)
-                {
-                    ElemType fAlpha = (j == firstLbl) ? (ElemType) 0.0 : (ElemType) LZERO;
-                    if (t > 0)
-                        fAlpha = alpha(j, t - 1);
-                    fTmp = alpha.LogAdd(fTmp, fAlpha + pair_scores(k, j));
-                }
-                fTmp += pos_scores(k, t); // include position dependent score
-                alpha(k, t) = fTmp;
-            }
-        }
-    }
-
-    // compute backward algorithm
-    static void BackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
-                                Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
-                                const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const int shift = 1)
-    {
-        assert(shift == 1);
-
-        alpha.RCRFBackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, shift);
-    }
-
-    static void TransGrdCompute(const Matrix<ElemType>& lbls,
-                                const Matrix<ElemType>& alpha,
-                                const Matrix<ElemType>& beta,
-                                const Matrix<ElemType>& pair_scores,
-                                Matrix<ElemType>& grd,
-                                const int startLbl,
-                                const int shift = 1)
-    {
-        assert(shift == 1);
-
-        alpha.RCRFTransGrdCompute(lbls,
-                                  alpha,
-                                  beta,
-                                  pair_scores,
-                                  grd,
-                                  startLbl, shift);
-    }
-
-    // compute forward backward algorithm
-    static void PostProbCompute(Matrix<ElemType>& postprob, const Matrix<ElemType>& alpha, const Matrix<ElemType>& beta)
-    {
-        int iNumPos = alpha.GetNumCols();
-        int iNumLab = alpha.GetNumRows();
-
-        postprob.Resize(iNumLab, iNumPos);
-        postprob.SetValue(beta);
-        postprob.InplaceExp();
-    }
-
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -1891,7 +2234,6 @@ public:
             if (!(InputRef(1).GetSampleMatrixNumRows() == InputRef(2).GetAsMatrixNumRows() && // position dependent and pair scores have same number of labels
                   InputRef(0).GetSampleMatrixNumRows() == InputRef(1).GetSampleMatrixNumRows() &&
                   InputRef(0).HasMBLayout() && InputRef(0).GetMBLayout() == InputRef(1).GetMBLayout() &&
-                  // InputRef(0).GetNumCols() == InputRef(1).GetNumCols() && // position dependent and pair scores have the same observation numbers
                   InputRef(2).GetAsMatrixNumCols() == InputRef(2).GetAsMatrixNumRows()))
             {
                 LogicError("The Matrix dimension in the CRFNode operation does not match.");
@@ -1906,24 +2248,62 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CRFNode<ElemType>>(nodeP);
-            node->mAlpha = mAlpha;
-            node->mBeta = mBeta;
-            node->mPostProb = mPostProb;
-
-            node->mStartLbl = mStartLbl;
-            node->mEndLbl = mEndLbl;
+            node->m_labelIndices->SetValue(*m_labelIndices);
+            node->m_sequences->SetValue(*m_sequences);
+            node->m_alpha->SetValue(*m_alpha);
+            node->m_logPosteriors->SetValue(*m_logPosteriors);
         }
     }
 
+    // request matrices needed to do node function value evaluation
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_labelIndices, matrixPool);
+        RequestMatrixFromPool(m_maxValues, matrixPool);
+        RequestMatrixFromPool(m_sequences, matrixPool);
+        RequestMatrixFromPool(m_alpha, matrixPool);
+        RequestMatrixFromPool(m_logPosteriors, matrixPool);
+        RequestMatrixFromPool(m_sequenceLosses, matrixPool);
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_posteriors, matrixPool);
+        RequestMatrixFromPool(m_transitionGradient, matrixPool);
+    }
+
+    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_labelIndices, matrixPool);
+        ReleaseMatrixToPool(m_maxValues, matrixPool);
+        ReleaseMatrixToPool(m_sequences, matrixPool);
+        ReleaseMatrixToPool(m_alpha, matrixPool);
+        ReleaseMatrixToPool(m_logPosteriors, matrixPool);
+        ReleaseMatrixToPool(m_sequenceLosses, matrixPool);
+        ReleaseMatrixToPool(m_posteriors, matrixPool);
+        ReleaseMatrixToPool(m_transitionGradient, matrixPool);
+    }
+
 private:
-    Matrix<ElemType> mAlpha; // TODO: m_Alpha etc.
-    Matrix<ElemType> mBeta;
-    Matrix<ElemType> mPostProb;
-    int mStartLbl;
-    int mEndLbl;
+    // label of each frame, and (first column, number of frames) of each sequence
+    shared_ptr<Matrix<ElemType>> m_labelIndices;
+    shared_ptr<Matrix<ElemType>> m_maxValues;
+    shared_ptr<Matrix<ElemType>> m_sequences;
+    // forward scores and log posteriors of the labels of each frame
+    shared_ptr<Matrix<ElemType>> m_alpha;
+    shared_ptr<Matrix<ElemType>> m_logPosteriors;
+    // temporaries
+    shared_ptr<Matrix<ElemType>> m_sequenceLosses;
+    shared_ptr<Matrix<ElemType>> m_posteriors;
+    shared_ptr<Matrix<ElemType>> m_transitionGradient;
 };
 
-#endif
+template class CRFNode<float>;
+template class CRFNode<double>;
 
 // -----------------------------------------------------------------------
 // Logistic (labels, prediction, weight)
@@ -2103,6 +2483,8 @@ template class LogisticNode<double>;
 // -----------------------------------------------------------------------
 // DropoutNode (input) -- perform drop-out
 // Output is scaled such that no post-scaling is necessary.
+// With Globals::ShouldFuseDropout(), no mask is kept: Matrix::Dropout() draws it from the node's seed and a counter in
+// one pass with the scaling, and BackpropTo() draws it again from the same seed and counter.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -2119,7 +2501,9 @@ public:
     DeclareConstructorFromConfigWithNumInputs(DropoutNode);
     DropoutNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-        m_dropoutRate(0)
+        m_dropoutRate(0),
+        m_fuseDropout(false),
+        m_maskBaseOffset(0)
     {
         SetRngState(CreateUniqId());
     }
@@ -2132,7 +2516,9 @@ public:
         Matrix<ElemType> sliceInput0Grad = InputRef(0).GradientFor(fr);
         Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
 
-        if (m_dropoutRate > 0)
+        if (m_dropoutRate > 0 && m_fuseDropout)
+            Matrix<ElemType>::Dropout(1, sliceOutputGrad, (ElemType) m_dropoutRate, GetRngSeed(), MaskOffsetFor(fr), sliceInput0Grad);
+        else if (m_dropoutRate > 0)
             sliceInput0Grad.AddElementProductOf(sliceOutputGrad, DataFor(*m_maskOfDropout, fr));
         else
             sliceInput0Grad += sliceOutputGrad;
@@ -2141,14 +2527,31 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
+    // the mask is applied element by element, or the value is a copy of the input
+    virtual bool /*ComputationNodeBase::*/ CanComputeInPlace() const override { return true; }
+
     virtual void UpdateFunctionMBSize() override
     {
         Base::UpdateFunctionMBSize();
         // resize temporaries to their proper size
-        if (m_dropoutRate > 0)
+        if (m_dropoutRate > 0 && !m_fuseDropout)
             m_maskOfDropout->Resize(Input(0)->Value());
     }
 
+    virtual void /*ComputationNode::*/ BeginForwardProp() override
+    {
+        Base::BeginForwardProp();
+        // all iterations of a loop draw their masks from consecutive counters starting here
+        m_maskBaseOffset = GetRngOffset();
+    }
+
+    virtual void /*ComputationNode::*/ EndForwardProp() override
+    {
+        Base::EndForwardProp();
+        if (m_fuseDropout && m_dropoutRate > 0 && !Environment().IsInferring())
+            UpdateRngOffset(m_maskBaseOffset + Value().GetNumElements());
+    }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
@@ -2156,7 +2559,12 @@ public:
 
         if (Environment().IsInferring() || m_dropoutRate <= 0)
         {
-            sliceOutputValue.SetValue(sliceInput0Value);
+            if (ValuePtr() != Input(0)->ValuePtr()) // (copy-to-self check: the value may be computed in place)
+                sliceOutputValue.SetValue(sliceInput0Value);
+        }
+        else if (m_fuseDropout)
+        {
+            Matrix<ElemType>::Dropout(0, sliceInput0Value, (ElemType) m_dropoutRate, GetRngSeed(), MaskOffsetFor(fr), sliceOutputValue);
         }
         else
         {
@@ -2196,27 +2604,42 @@ public:
             node->m_dropoutRate = m_dropoutRate;
             node->SetRngState(GetRngSeed(), GetRngOffset());
             node->m_maskOfDropout = m_maskOfDropout;
+            node->m_fuseDropout = m_fuseDropout;
         }
     }
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_maskOfDropout, matrixPool);
+        m_fuseDropout = Globals::ShouldFuseDropout();
+        if (!m_fuseDropout)
+            RequestMatrixFromPool(m_maskOfDropout, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
+        if (!m_fuseDropout)
+            ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
     }
 
     double GetDropoutRate() const { return m_dropoutRate; }
 
 private:
+    // counter of the first mask element of the frame range, so that BackpropTo() finds the counters ForwardProp() used
+    uint64_t MaskOffsetFor(const FrameRange& fr) const
+    {
+        if (fr.IsAllFrames())
+            return m_maskBaseOffset;
+        size_t firstColumn = ColumnRangeWithMBLayoutFor(Value().GetNumCols(), fr, GetMBLayout()).first;
+        return m_maskBaseOffset + firstColumn * Value().GetNumRows();
+    }
+
     double m_dropoutRate;
     shared_ptr<Matrix<ElemType>> m_maskOfDropout;
+    bool m_fuseDropout;       // Globals::ShouldFuseDropout() when the matrices were requested
+    uint64_t m_maskBaseOffset; // RNG offset at the start of the current forward prop (fused dropout only)
 };
 
 // -----------------------------------------------------------------------
@@ -2259,6 +2682,8 @@ private:
 // * epsilon is a conditioner constant used in computing inverse standard deviation
 // * useCntkEngine is a Boolean flag that specifies which batch normalization implementation to use: CNTK or cuDNN-based.
 // * imageLayout is the image layout. Only cudnn is supported at present.
+// A following ReLU can be merged into the node (FuseRelu()), which then recomputes the normalization in backprop
+// instead of keeping an activation between the two.
 // -----------------------------------------------------------------------
 template <class ElemType>
 class BatchNormalizationNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<5>, public IFreezable,
@@ -2270,14 +2695,14 @@ class BatchNormalizationNode : public ComputationNodeNonLooping<ElemType>, publi
 public:
     BatchNormalizationNode(DEVICEID_TYPE deviceId, const wstring& name) :
         Base(deviceId, name), m_spatial(false), m_normTimeConst(0), m_blendTimeConst(0), m_epsilon(0), m_useCntkEngine(true),
-        m_samplesSeen(0), m_imageLayoutKind(ImageLayoutKind::CHW),
+        m_samplesSeen(0), m_imageLayoutKind(ImageLayoutKind::CHW), m_fuseRelu(false),
         m_convertRunningVariancePending(false)
     {
     }
     BatchNormalizationNode(DEVICEID_TYPE deviceId, const wstring& name, bool spatial, double normalizationTimeConstant, double blendTimeConstant,
                            double epsilon, bool useCntkEngine, ImageLayoutKind imageLayoutKind, size_t samplesSeen = 0) :
         Base(deviceId, name), m_spatial(spatial), m_normTimeConst(normalizationTimeConstant), m_blendTimeConst(blendTimeConstant),
-        m_epsilon(epsilon), m_useCntkEngine(useCntkEngine), m_imageLayoutKind(imageLayoutKind), m_samplesSeen(samplesSeen),
+        m_epsilon(epsilon), m_useCntkEngine(useCntkEngine), m_imageLayoutKind(imageLayoutKind), m_samplesSeen(samplesSeen), m_fuseRelu(false),
         m_convertRunningVariancePending(false)
     {
     }
@@ -2301,6 +2726,7 @@ public:
         fstream << m_samplesSeen;
         fstream << m_epsilon;
         fstream << m_useCntkEngine;
+        fstream << m_fuseRelu;
     }
 
     void Load(File& fstream, size_t modelVersion) override
@@ -2320,6 +2746,8 @@ public:
                 fstream >> mbCount; // converted below
             fstream >> m_epsilon;
             fstream >> m_useCntkEngine;
+            if (modelVersion >= CNTK_MODEL_VERSION_20)
+                fstream >> m_fuseRelu;
         }
         else
         {
@@ -2394,6 +2822,7 @@ public:
             node->m_samplesSeen = m_samplesSeen;
             node->m_epsilon = m_epsilon;
             node->m_useCntkEngine = m_useCntkEngine;
+            node->m_fuseRelu = m_fuseRelu;
         }
     }
 
@@ -2518,6 +2947,11 @@ public:
 
             double blendFactor = ComputeBlendFactor();  // interpolation weight for the running statistics (the current MB statistics are weighted with 1-this)
 
+            // With a fused ReLU, the gradient from above is that of the ReLU output. Turn it into that of the normalized
+            // output, which is recomputed from the input since it is not kept. (Our gradient is not needed afterwards.)
+            if (m_fuseRelu)
+                m_bnEng->BackwardRelu(sliceInputValue, sliceOutputGrad, scale, bias, *m_savedMean, *m_savedInvStdDev);
+
             // Compute all derivatives in one step. Save derivatives with respect to scale and bias in temp matrices.
             m_bnEng->Backward(sliceInputValue, sliceOutputGrad, // (in)  input from below, gradient from above
                               sliceInputGrad,                   // (out) gradient for data input goes here
@@ -2556,6 +2990,9 @@ public:
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
 
+    // (ForwardProp() updates the running statistics in training)
+    virtual bool ForwardPropIsRepeatable() const override { return false; }
+
     void Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -2575,7 +3012,9 @@ public:
             auto paramLayout = Input(i)->GetSampleLayout();
             if (paramLayout.GetRank() == 2 && paramLayout[0] == 0 && paramLayout[1] == 1 && inputLayout.GetNumElements() > 0) // [0 x 1]
             {
-                size_t total = m_spatial ? inputLayout.GetDims().back() : inputLayout.GetNumElements();
+                // spatial: one per channel, which NHWC has first
+                size_t total = !m_spatial ? inputLayout.GetNumElements() :
+                               m_imageLayoutKind == ImageLayoutKind::NHWC ? inputLayout[0] : inputLayout.GetDims().back();
                 Input(i)->ValidateInferInputDimsFrom(TensorShape(total, 1));
             }
         }
@@ -2619,10 +3058,10 @@ public:
                         InvalidArgument("%ls: Data input cannot broadcast.", NodeDescription().c_str());
 #endif
             }
-            if (m_spatial && m_imageLayoutKind != CHW)
+            if (m_spatial && m_imageLayoutKind != CHW && m_imageLayoutKind != NHWC)
             {
                 InvalidArgument(
-                    "%ls %ls currently supports only cuDNN (CHW) data layout. " 
+                    "%ls %ls currently supports only cuDNN (CHW) or NHWC data layout. " 
                     "Please specify imageLayout=\"cudnn\" in BatchNormalization node in your NDL/BrainScript "
                     "and make sure your input data layout is CHW", NodeName().c_str(), OperationName().c_str());
             }
@@ -2636,8 +3075,11 @@ public:
             if (m_bnEng == nullptr)
             {
                 auto shape = GetSampleLayout();
-                m_bnEng = BatchNormEngine<ElemType>::Create(m_deviceId, shape, m_spatial, m_imageLayoutKind,
-                                                            m_useCntkEngine ? BatchNormEngineKind::Cntk : BatchNormEngineKind::CuDnn);
+                auto engineKind = m_useCntkEngine ? BatchNormEngineKind::Cntk : BatchNormEngineKind::CuDnn;
+                if (m_fuseRelu)
+                    engineKind = (BatchNormEngineKind) ((int) engineKind | (int) BatchNormEngineKind::FusedRelu);
+                m_bnEng = BatchNormEngine<ElemType>::Create(m_deviceId, shape, m_spatial, m_imageLayoutKind, engineKind);
+                m_bnEng->SetCommunicator(m_statisticsComm);
             }
         }
     }
@@ -2707,6 +3149,23 @@ public:
     double Epsilon() const { return m_epsilon; }
     bool UseCNTKEngine() const { return m_useCntkEngine; }
 
+    // Makes the node compute ReLU(BatchNormalization(x)), see ComputationNetwork::FuseBatchNormalizationAndRelu().
+    void FuseRelu()
+    {
+        m_fuseRelu = true;
+        m_bnEng.reset(); // (created again with the fused ReLU in the next validation)
+    }
+    bool FusedRelu() const { return m_fuseRelu; }
+
+    // Computes the minibatch statistics over the minibatches of all ranks of 'comm' (synchronized batch normalization),
+    // see ComputationNetwork::SetBatchNormalizationCommunicator(). nullptr for per-rank statistics.
+    void SetStatisticsCommunicator(const std::shared_ptr<NcclComm>& comm)
+    {
+        m_statisticsComm = comm;
+        if (m_bnEng)
+            m_bnEng->SetCommunicator(comm);
+    }
+
 private:
     // Old versioning - do not use. Do not remove until we're sure there are no old models around.
     struct VersionInfo
@@ -2754,6 +3213,8 @@ private:
     bool m_useCntkEngine;
     // Layout (e.g. CHW).
     ImageLayoutKind m_imageLayoutKind;
+    // Whether a ReLU is applied to the output, see FuseRelu().
+    bool m_fuseRelu;
 
     // --- working variables
 
@@ -2769,6 +3230,8 @@ private:
     shared_ptr<Matrix<ElemType>> m_dBias;
 
     std::unique_ptr<BatchNormEngine<ElemType>> m_bnEng;
+    // Reduces the statistics across the ranks, see SetStatisticsCommunicator(). Not serialized.
+    std::shared_ptr<NcclComm> m_statisticsComm;
 
     bool m_convertRunningVariancePending;
 };
@@ -142,4 +142,123 @@ private:
 template class UserDefinedV2FunctionNode<float>;
 template class UserDefinedV2FunctionNode<double>;
 
+// -----------------------------------------------------------------------
+// NativeUserFunctionNode
+// ComputationNode type for a V2 user-defined Function implemented by a
+// native kernel (::CNTK::NativeUserFunctionKernel). The kernel works on
+// NDArrayViews that alias the matrices of this node and its inputs; they
+// are only re-created when a matrix got reallocated or resized, and the
+// kernel gets to Specialize() itself whenever the input shapes change.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class NativeUserFunctionNode final : public ComputationNodeNonLooping<ElemType>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"NativeUserFunction"; }
+
+public:
+    NativeUserFunctionNode(DEVICEID_TYPE deviceId, const wstring& name, const ::CNTK::NativeUserFunctionKernelPtr& kernel = nullptr, const ::CNTK::NDShape& outputShape = ::CNTK::NDShape())
+        : Base(deviceId, name), m_kernel(kernel), m_outputShape(outputShape)
+    {
+        if (!m_kernel)
+            LogicError("NativeUserFunctionNode ctor should never be called with kernel == nullptr");
+    }
+
+    virtual void ForwardPropNonLooping() override
+    {
+        UpdateValueViews();
+
+        bool shapesChanged = m_specializedInputShapes.size() != m_inputViews.size();
+        for (size_t i = 0; i < m_inputViews.size() && !shapesChanged; i++)
+            shapesChanged = m_specializedInputShapes[i] != m_inputViews[i].view->Shape();
+        if (shapesChanged)
+        {
+            m_specializedInputShapes.clear();
+            for (const auto& inputView : m_inputViews)
+                m_specializedInputShapes.push_back(inputView.view->Shape());
+            m_kernel->Specialize(m_specializedInputShapes, m_outputView.view->Shape(), ::CNTK::AsDeviceDescriptor(m_deviceId));
+        }
+
+        m_kernel->Forward(m_inputViewPtrs, m_outputView.view, ::CNTK::Utils::GetComputeStream(::CNTK::AsDeviceDescriptor(m_deviceId)));
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        UpdateValueViews();
+        UpdateView(m_outputGradientView, Gradient(), GetSampleLayout(), HasMBLayout(), /*readOnly=*/true);
+        m_inputGradientViews.resize(GetNumInputs());
+        UpdateView(m_inputGradientViews[inputIndex], InputRef(inputIndex).Gradient(), InputRef(inputIndex).GetSampleLayout(), InputRef(inputIndex).HasMBLayout(), /*readOnly=*/false);
+
+        m_kernel->Backward(inputIndex, m_inputViewPtrs, m_outputView.view, m_outputGradientView.view, m_inputGradientViews[inputIndex].view,
+                           ::CNTK::Utils::GetComputeStream(::CNTK::AsDeviceDescriptor(m_deviceId)));
+    }
+
+    virtual void Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+        if (isFinalValidationPass)
+        {
+            for (size_t i = 0; i < GetNumInputs(); i++)
+                if (InputRef(i).HasMBLayout() && InputRef(i).GetMBLayout() != GetMBLayout())
+                    InvalidArgument("%ls %ls operation: All inputs with dynamic axes must have the same MBLayout.", NodeName().c_str(), OperationName().c_str());
+        }
+
+        SetDims(::CNTK::AsTensorShape(m_outputShape), HasMBLayout());
+    }
+
+private:
+    struct AliasingView
+    {
+        ::CNTK::NDArrayViewPtr view;
+        const ElemType* data = nullptr;
+    };
+
+    // (re-)create 'view' unless it still aliases the current buffer of 'matrix' with the current shape
+    // (sample shape, followed by one axis over all columns of the minibatch if there is an MBLayout)
+    static void UpdateView(AliasingView& view, const Matrix<ElemType>& matrix, const TensorShape& sampleLayout, bool hasMBLayout, bool readOnly)
+    {
+        if (matrix.GetMatrixType() != DENSE)
+            InvalidArgument("NativeUserFunction: Only dense inputs and outputs are supported.");
+
+        auto shape = ::CNTK::AsNDShape(sampleLayout);
+        if (hasMBLayout)
+            shape = shape.AppendShape({ matrix.GetNumCols() });
+        if (view.view && view.data == matrix.Data() && view.view->Shape() == shape)
+            return;
+
+        view.view = ::CNTK::Utils::GetNDArrayViewAliasingCNTKImplMatrix(shape, matrix, readOnly);
+        view.data = matrix.Data();
+    }
+
+    void UpdateValueViews()
+    {
+        auto numInputs = GetNumInputs();
+        m_inputViews.resize(numInputs);
+        m_inputViewPtrs.resize(numInputs);
+        for (size_t i = 0; i < numInputs; i++)
+        {
+            UpdateView(m_inputViews[i], InputRef(i).Value(), InputRef(i).GetSampleLayout(), InputRef(i).HasMBLayout(), /*readOnly=*/true);
+            m_inputViewPtrs[i] = m_inputViews[i].view;
+        }
+        UpdateView(m_outputView, Value(), GetSampleLayout(), HasMBLayout(), /*readOnly=*/false);
+    }
+
+    ::CNTK::NativeUserFunctionKernelPtr m_kernel;
+    ::CNTK::NDShape m_outputShape;
+
+    // views over the current matrices, reused across minibatches
+    std::vector<AliasingView> m_inputViews;
+    std::vector<::CNTK::NDArrayViewPtr> m_inputViewPtrs; // (the views of m_inputViews, as passed to the kernel)
+    AliasingView m_outputView;
+    AliasingView m_outputGradientView;
+    std::vector<AliasingView> m_inputGradientViews;
+    std::vector<::CNTK::NDShape> m_specializedInputShapes; // input shapes of the last Specialize() call
+};
+
+template class NativeUserFunctionNode<float>;
+template class NativeUserFunctionNode<double>;
+
 }}}
@@ -29,6 +29,7 @@
 #include "InputAndParamNodes.h"
 #include "latticearchive.h"
 #include <limits>
+#include <set>
 #include "RecurrentNodes.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -44,6 +45,8 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
         Globals::EnableShareNodeValueMatrices();
     if (m_config(L"hyperCompressMemory", false))
         Globals::EnableHyperCompressMemory();
+    int numConcurrentStreams = m_config(L"numConcurrentStreams", "1");
+    Globals::SetNumConcurrentStreams(numConcurrentStreams);
 }
 
 
@@ -261,11 +264,21 @@ void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstrin
 {
     m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(this->m_net, NetworkOperationMode::inferring);
     m_outputNodes  = this->m_net->OutputNodesByName(outputNodeNames);
+    if (this->m_config(L"optimizeForEvaluation", false))
+    {
+        // strip everything not needed for these outputs; the nodes may get replaced, so look them up again
+        this->m_net->template OptimizeForEvaluation<ElemType>(m_outputNodes);
+        m_outputNodes = this->m_net->OutputNodesByName(outputNodeNames);
+    }
     m_inputNodes = this->m_net->InputNodesForOutputs(outputNodeNames);
-    // allocate memory for forward computation
-    this->m_net->AllocateAllMatrices({}, m_outputNodes, nullptr);
+    m_useCudaGraphs = this->m_config(L"cudaGraphs", false);
+    m_outputTopK = this->m_config(L"outputTopK", (size_t)0);
+    // allocate memory for forward computation; activations that are not outputs share buffers once they have been consumed
+    this->m_net->AllocateAllMatrices({}, m_outputNodes, nullptr, /*forwardPropOnly=*/true);
     this->m_net->StartEvaluateMinibatchLoop(m_outputNodes);
     m_inputMatrices = DataReaderHelpers::RetrieveInputMatrices(m_inputNodes);
+    m_boundInputs.assign(m_inputNodes.size(), BoundBuffer{ nullptr, CPUDEVICE, 0, nullptr });
+    m_boundOutputs.assign(m_outputNodes.size(), BoundBuffer{ nullptr, CPUDEVICE, 0, nullptr });
 
     for (const auto& node : m_outputNodes)
     {
@@ -285,10 +298,44 @@ VariableSchema CNTKEvalExtended<ElemType>::GetOutputSchema() const
     for (const auto& n : nodes)
     {
         schema.push_back(ToVariableLayout(n));
+        if (m_started)
+            schema.back().m_numElements = GetOutputDim(n);
     }
     return schema;
 }
 
+template<typename ElemType>
+size_t CNTKEvalExtended<ElemType>::GetOutputDim(const ComputationNodeBasePtr& node) const
+{
+    size_t sampleDim = node->GetSampleLayout().GetNumElements();
+    if (m_outputTopK == 0)
+        return sampleDim;
+    return 2 * std::min(m_outputTopK, sampleDim);
+}
+
+template<typename ElemType>
+shared_ptr<Matrix<ElemType>> CNTKEvalExtended<ElemType>::GetOutputValue(const ComputationNodeBasePtr& node)
+{
+    auto value = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+    if (m_outputTopK == 0)
+        return value;
+
+    size_t k = GetOutputDim(node) / 2;
+    if (!m_topKOutput || m_topKOutput->GetDeviceId() != value->GetDeviceId())
+    {
+        m_topKIndexes = make_shared<Matrix<ElemType>>(value->GetDeviceId());
+        m_topKValues  = make_shared<Matrix<ElemType>>(value->GetDeviceId());
+        m_topKOutput  = make_shared<Matrix<ElemType>>(value->GetDeviceId());
+    }
+    m_topKOutput->Resize(2 * k, value->GetNumCols());
+    if (value->IsEmpty())
+        return m_topKOutput;
+    value->VectorMax(*m_topKIndexes, *m_topKValues, /*isColWise=*/true, (int)k);
+    m_topKOutput->AssignToRowSliceValuesOf(*m_topKIndexes, 0, k);
+    m_topKOutput->AssignToRowSliceValuesOf(*m_topKValues, k, k);
+    return m_topKOutput;
+}
+
 template<typename ElemType>
 VariableSchema CNTKEvalExtended<ElemType>::GetInputSchema() const
 {
@@ -378,11 +425,20 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
 
     ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
 
+    if (m_useCudaGraphs)
+    {
+        // the graph of a forward pass depends on the number of samples of each input
+        std::vector<size_t> shapeKey;
+        for (auto& inputNode : m_inputNodes)
+            shapeKey.push_back(inputNode->GetMBLayout()->GetNumCols());
+        this->m_net->ForwardPropCaptured(m_outputNodes, shapeKey);
+    }
+
     for (size_t i2 = 0; i2 < m_outputNodes.size(); ++i2)
     {
         auto node = m_outputNodes[i2];
-        this->m_net->ForwardProp(node);
-        shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+        this->m_net->ForwardProp(node); // (nothing to do if already done above)
+        shared_ptr<Matrix<ElemType>> outputMatrix = GetOutputValue(node);
         auto pMBLayout = node->GetMBLayout();
         if (!pMBLayout)
         {
@@ -434,6 +490,345 @@ void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs,
     ForwardPassT(inputs, outputs, resetRNN);
 }
 
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs)
+{
+    if (!m_started)
+        RuntimeError("ForwardPassBatch() called before StartForwardEvaluation()");
+
+    ForwardPassSequences(inputs, outputs, {}, {}, nullptr);
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassSequences(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs,
+                                                      const std::vector<ptrdiff_t>& sequenceBegins, const std::vector<size_t>& maxNumOutputSamples,
+                                                      const std::function<void()>& beforeForwardProp)
+{
+    size_t numSequences = inputs.size();
+    if (outputs.size() != numSequences)
+        RuntimeError("Expected outputs for %d requests, but got %d.", (int)numSequences, (int)outputs.size());
+    if (numSequences == 0)
+        return;
+
+    // determine the number of samples of each request
+    std::vector<size_t> numSamples(numSequences);
+    for (size_t r = 0; r < numSequences; r++)
+    {
+        if (inputs[r].size() != m_inputNodes.size())
+            RuntimeError("Request %d: Expected %d inputs, but got %d.", (int)r, (int)m_inputNodes.size(), (int)inputs[r].size());
+        if (outputs[r].size() != m_outputNodes.size())
+            RuntimeError("Request %d: Expected %d outputs, but got %d.", (int)r, (int)m_outputNodes.size(), (int)outputs[r].size());
+
+        for (size_t i = 0; i < m_inputNodes.size(); i++)
+        {
+            const auto& buffer = inputs[r][i].m_buffer;
+            size_t numRows = m_inputNodes[i]->GetSampleLayout().GetNumElements();
+            if (dynamic_pointer_cast<Matrix<ElemType>>(m_inputNodes[i]->ValuePtr())->GetMatrixType() != MatrixType::DENSE)
+                RuntimeError("Input %ls: Sparse inputs are not supported for evaluating several sequences at once.", m_inputNodes[i]->GetName().c_str());
+            if (buffer.size() == 0 || buffer.size() % numRows != 0)
+                RuntimeError("Request %d, input %ls: Expected input data to be a non-zero multiple of %" PRIu64 ", but it is %" PRIu64 ".",
+                             (int)r, m_inputNodes[i]->GetName().c_str(), numRows, buffer.size());
+            if (i == 0)
+                numSamples[r] = buffer.size() / numRows;
+            else if (buffer.size() / numRows != numSamples[r])
+                RuntimeError("Request %d: All inputs must have the same number of samples.", (int)r);
+        }
+    }
+    size_t numTimeSteps = *std::max_element(numSamples.begin(), numSamples.end());
+
+    // one sequence per request, in a parallel sequence of its own
+    std::set<MBLayoutPtr> layoutsDone; // (inputs may share their layout)
+    for (auto& inputNode : m_inputNodes)
+    {
+        auto pMBLayout = inputNode->GetMBLayout();
+        if (!layoutsDone.insert(pMBLayout).second)
+            continue;
+        pMBLayout->Init(numSequences, numTimeSteps);
+        for (size_t r = 0; r < numSequences; r++)
+        {
+            pMBLayout->AddSequence(r, r, sequenceBegins.empty() ? 0 : sequenceBegins[r], numSamples[r]);
+            pMBLayout->AddGap(r, numSamples[r], numTimeSteps);
+        }
+    }
+
+    // interleave the samples: sample t of request r goes into column t * numSequences + r
+    for (size_t i = 0; i < m_inputNodes.size(); i++)
+    {
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(m_inputNodes[i]->ValuePtr());
+        size_t numRows = m_inputNodes[i]->GetSampleLayout().GetNumElements();
+        m_batchBuffer.assign(numRows * numTimeSteps * numSequences, 0);
+        for (size_t r = 0; r < numSequences; r++)
+        {
+            const ElemType* data = inputs[r][i].m_buffer.data();
+            for (size_t t = 0; t < numSamples[r]; t++)
+                std::copy(data + t * numRows, data + (t + 1) * numRows, m_batchBuffer.begin() + (t * numSequences + r) * numRows);
+        }
+        matrix->SetValue(numRows, numTimeSteps * numSequences, matrix->GetDeviceId(), m_batchBuffer.data(), matrixFlagNormal);
+    }
+
+    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+    if (beforeForwardProp)
+        beforeForwardProp();
+
+    for (size_t o = 0; o < m_outputNodes.size(); ++o)
+    {
+        auto node = m_outputNodes[o];
+        this->m_net->ForwardProp(node);
+        shared_ptr<Matrix<ElemType>> outputMatrix = GetOutputValue(node);
+        size_t numRows = outputMatrix->GetNumRows();
+        m_batchBuffer.resize(outputMatrix->GetNumElements());
+        ElemType* data = m_batchBuffer.data();
+        size_t dataSize = m_batchBuffer.size(); // (large enough, so CopyToArray() does not reallocate)
+        outputMatrix->CopyToArray(data, dataSize);
+
+        auto pMBLayout = node->GetMBLayout();
+        if (pMBLayout && pMBLayout->GetNumParallelSequences() != numSequences)
+            RuntimeError("Output %ls: Expected one sequence per request.", node->GetName().c_str());
+        for (size_t r = 0; r < numSequences; r++)
+        {
+            auto& vec = outputs[r][o].m_buffer;
+            if (!pMBLayout) // (not depending on the input: the same for all requests)
+            {
+                if (vec.capacity() < m_batchBuffer.size())
+                    RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+                vec.assign(m_batchBuffer.begin(), m_batchBuffer.end());
+                continue;
+            }
+
+            vec.clear();
+            for (const auto& seq : pMBLayout->GetAllSequences())
+            {
+                if (seq.seqId == GAP_SEQUENCE_ID || seq.s != r)
+                    continue;
+                size_t tBegin = (size_t)std::max<ptrdiff_t>(seq.tBegin, 0);
+                size_t tEnd = std::min(seq.tEnd, pMBLayout->GetNumTimeSteps());
+                if (!maxNumOutputSamples.empty())
+                    tEnd = std::max(tBegin, std::min(tEnd, tBegin + maxNumOutputSamples[r]));
+                if (vec.capacity() < vec.size() + (tEnd - tBegin) * numRows)
+                    RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+                for (size_t t = tBegin; t < tEnd; t++)
+                {
+                    auto column = m_batchBuffer.begin() + (t * numSequences + r) * numRows;
+                    vec.insert(vec.end(), column, column + numRows);
+                }
+            }
+        }
+    }
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::Bind(std::vector<BoundBuffer>& boundBuffers, const std::vector<ComputationNodeBasePtr>& nodes, size_t index,
+                                      ElemType* buffer, int deviceId, size_t maxNumSamples)
+{
+    if (index >= nodes.size())
+        RuntimeError("Bind: Index %d out of range, there are %d.", (int)index, (int)nodes.size());
+    auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(nodes[index]->ValuePtr());
+    if (matrix->GetMatrixType() != MatrixType::DENSE)
+        RuntimeError("Bind: %ls is sparse, only dense inputs and outputs can be bound.", nodes[index]->GetName().c_str());
+
+    auto& bound = boundBuffers[index];
+    bound.m_data = buffer;
+    bound.m_deviceId = deviceId;
+    bound.m_maxNumSamples = maxNumSamples;
+    bound.m_view = nullptr;
+    if (buffer && deviceId == matrix->GetDeviceId())
+    {
+        // the network computes on this matrix while the memory is bound; it never owns the memory
+        bound.m_view = make_shared<Matrix<ElemType>>(nodes[index]->GetSampleLayout().GetNumElements(), maxNumSamples, buffer, deviceId, matrixFlagDontOwnBuffer);
+    }
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::BindInput(size_t index, ElemType* buffer, int deviceId, size_t maxNumSamples)
+{
+    if (!m_started)
+        RuntimeError("BindInput() called before StartForwardEvaluation()");
+    Bind(m_boundInputs, m_inputNodes, index, buffer, deviceId, maxNumSamples);
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::BindOutput(size_t index, ElemType* buffer, int deviceId, size_t maxNumSamples)
+{
+    if (!m_started)
+        RuntimeError("BindOutput() called before StartForwardEvaluation()");
+    Bind(m_boundOutputs, m_outputNodes, index, buffer, deviceId, maxNumSamples);
+}
+
+// Bound memory on the device of the model is swapped in as the value of the nodes for the duration of the forward pass;
+// outputs are computed into it directly if they have the minibatch layout of an input (whose size is known beforehand),
+// else they are copied over.
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassBound(size_t numSamples, std::vector<size_t>& numOutputSamples, bool resetRNN)
+{
+    if (!m_started)
+        RuntimeError("ForwardPassBound() called before StartForwardEvaluation()");
+    if (numSamples == 0)
+        RuntimeError("ForwardPassBound: Expected at least one sample.");
+    if (numOutputSamples.size() != m_outputNodes.size())
+        RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)numOutputSamples.size());
+    for (size_t i = 0; i < m_inputNodes.size(); i++)
+    {
+        if (!m_boundInputs[i].m_data || m_boundInputs[i].m_maxNumSamples < numSamples)
+            RuntimeError("Input %ls: No memory bound for %d samples.", m_inputNodes[i]->GetName().c_str(), (int)numSamples);
+    }
+    for (size_t o = 0; o < m_outputNodes.size(); o++)
+    {
+        if (!m_boundOutputs[o].m_data)
+            RuntimeError("Output %ls: No memory bound.", m_outputNodes[o]->GetName().c_str());
+    }
+
+    // the values of the nodes that are swapped out, [inputs, outputs]
+    m_swappedOutValues.resize(m_inputNodes.size() + m_outputNodes.size());
+    auto nodeForSwapped = [&](size_t k) { return k < m_inputNodes.size() ? m_inputNodes[k] : m_outputNodes[k - m_inputNodes.size()]; };
+    auto swapIn = [&](size_t k, BoundBuffer& bound, size_t numCols)
+    {
+        auto node = nodeForSwapped(k);
+        bound.m_view->SetValue(node->GetSampleLayout().GetNumElements(), numCols, bound.m_deviceId, bound.m_data, matrixFlagDontOwnBuffer);
+        auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->ValuePtrRef();
+        m_swappedOutValues[k] = value;
+        value = bound.m_view;
+    };
+    auto swapBack = [&]()
+    {
+        for (size_t k = 0; k < m_swappedOutValues.size(); k++)
+        {
+            if (m_swappedOutValues[k])
+                dynamic_pointer_cast<ComputationNode<ElemType>>(nodeForSwapped(k))->ValuePtrRef() = std::move(m_swappedOutValues[k]);
+            m_swappedOutValues[k] = nullptr;
+        }
+    };
+    auto hasInputLayout = [&](const MBLayoutPtr& pMBLayout)
+    {
+        return pMBLayout && std::any_of(m_inputNodes.begin(), m_inputNodes.end(), [&](const ComputationNodeBasePtr& inputNode) { return inputNode->GetMBLayout() == pMBLayout; });
+    };
+
+    try
+    {
+        for (size_t i = 0; i < m_inputNodes.size(); i++)
+        {
+            auto& inputNode = m_inputNodes[i];
+            auto& bound = m_boundInputs[i];
+            inputNode->GetMBLayout()->Init(1, numSamples);
+            inputNode->GetMBLayout()->AddSequence(0, 0, resetRNN ? 0 : SentinelValueIndicatingUnspecifedSequenceBeginIdx, numSamples);
+
+            if (bound.m_view)
+                swapIn(i, bound, numSamples);
+            else
+            {
+                auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+                matrix->SetValue(inputNode->GetSampleLayout().GetNumElements(), numSamples, matrix->GetDeviceId(), bound.m_data, matrixFlagNormal);
+            }
+        }
+
+        for (size_t o = 0; o < m_outputNodes.size(); o++)
+        {
+            auto& bound = m_boundOutputs[o];
+            if (bound.m_view && m_outputTopK == 0 && hasInputLayout(m_outputNodes[o]->GetMBLayout()) && numSamples <= bound.m_maxNumSamples)
+                swapIn(m_inputNodes.size() + o, bound, numSamples);
+        }
+
+        ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+
+        for (size_t o = 0; o < m_outputNodes.size(); o++)
+        {
+            auto& node = m_outputNodes[o];
+            auto& bound = m_boundOutputs[o];
+            this->m_net->ForwardProp(node);
+
+            auto outputMatrix = GetOutputValue(node);
+            size_t numRows = GetOutputDim(node);
+            numOutputSamples[o] = outputMatrix->GetNumElements() / numRows;
+            if (outputMatrix == bound.m_view)
+                continue; // computed in place
+
+            if (numOutputSamples[o] > bound.m_maxNumSamples)
+                RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+            if (bound.m_view)
+            {
+                bound.m_view->SetValue(numRows, numOutputSamples[o], bound.m_deviceId, bound.m_data, matrixFlagDontOwnBuffer);
+                bound.m_view->SetValue(*outputMatrix);
+            }
+            else
+            {
+                ElemType* data = bound.m_data;
+                size_t dataSize = bound.m_maxNumSamples * numRows;
+                outputMatrix->CopyToArray(data, dataSize);
+            }
+        }
+    }
+    catch (...)
+    {
+        swapBack();
+        throw;
+    }
+    swapBack();
+}
+
+// Creates a copy of the network whose LearnableParameter nodes share the values with those of 'net'.
+// The other nodes get their own matrices (requested from the copy's matrix pool when its evaluation is started),
+// and the copy is compiled, which gives it its own minibatch layout.
+template <typename ElemType>
+ComputationNetworkPtr CNTKEvalExtended<ElemType>::CloneNetworkSharingParameters(const ComputationNetworkPtr& net)
+{
+    auto clone = make_shared<ComputationNetwork>(net->GetDeviceId());
+    for (const auto& fromNode : net->GetAllNodes())
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(fromNode->Duplicate(fromNode->NodeName(), CopyNodeFlags::copyNodeValue));
+        if (!node)
+            RuntimeError("CreateSession: Node %ls is not of the precision of the model.", fromNode->NodeName().c_str());
+
+        // (Duplicate() has copied all values; for the parameters, this copy is released right away)
+        node->GradientPtrRef() = nullptr;
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+            node->ValuePtrRef() = dynamic_pointer_cast<ComputationNode<ElemType>>(fromNode)->ValuePtrRef();
+        else if (node->IsValueSharable())
+            node->ValuePtrRef() = nullptr;
+        clone->AddNodeToNet(node);
+    }
+
+    for (const auto& fromNode : net->GetAllNodes())
+    {
+        auto node = clone->GetNodeFromName(fromNode->NodeName());
+        for (size_t i = 0; i < fromNode->GetNumInputs(); i++)
+            node->SetInput(i, clone->GetNodeFromName(fromNode->GetInputs()[i]->NodeName()));
+    }
+
+    auto addToNodeGroup = [&](const std::wstring& groupTag, const std::vector<ComputationNodeBasePtr>& fromNodes)
+    {
+        for (const auto& fromNode : fromNodes)
+            clone->AddToNodeGroup(groupTag, clone->GetNodeFromName(fromNode->NodeName()));
+    };
+    addToNodeGroup(L"feature",    net->FeatureNodes());
+    addToNodeGroup(L"label",      net->LabelNodes());
+    addToNodeGroup(L"criterion",  net->FinalCriterionNodes());
+    addToNodeGroup(L"evaluation", net->EvaluationNodes());
+    addToNodeGroup(L"output",     net->OutputNodes());
+
+    clone->ShareFrozenParameterStorage(net->FrozenParameterStorage());
+    clone->CompileNetwork();
+    return clone;
+}
+
+template <typename ElemType>
+IEvaluateModelExtended<ElemType>* CNTKEvalExtended<ElemType>::CreateSession()
+{
+    if (this->m_net == nullptr)
+        RuntimeError("CreateSession() called before CreateNetwork()");
+
+    auto session = new CNTKEvalExtended<ElemType>();
+    session->m_config = this->m_config;
+    try
+    {
+        session->m_net = CloneNetworkSharingParameters(this->m_net);
+    }
+    catch (...)
+    {
+        delete session;
+        throw;
+    }
+    return session;
+}
+
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
@@ -460,4 +855,797 @@ extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval
 
 template class CNTKEvalExtended<double>;
 template class CNTKEvalExtended<float>;
+
+// ----------------------------------------------------------------------------
+// Batching front-end
+// ----------------------------------------------------------------------------
+
+template <typename ElemType>
+CNTKEvalBatching<ElemType>::CNTKEvalBatching(IEvaluateModelExtended<ElemType>* eval, size_t maxBatchSize, size_t maxLatencyInMicroseconds)
+    : m_eval(eval), m_maxBatchSize(maxBatchSize), m_maxLatency(maxLatencyInMicroseconds), m_stop(false)
+{
+    if (m_eval == nullptr)
+        InvalidArgument("GetEvalBatching: No evaluator given.");
+    if (m_maxBatchSize == 0)
+        InvalidArgument("GetEvalBatching: The maximum batch size must be positive.");
+
+    m_outputSchema = m_eval->GetOutputSchema();
+    auto inputSchema = m_eval->GetInputSchema();
+    m_numInputElements = inputSchema.empty() ? 0 : inputSchema[0].m_numElements;
+    m_statistics.m_batchSizeHistogram.resize(m_maxBatchSize + 1, 0);
+    m_thread = std::thread([this]() { EvaluateRequests(); });
+}
+
+template <typename ElemType>
+std::future<Values<ElemType>> CNTKEvalBatching<ElemType>::Evaluate(Values<ElemType>&& inputs)
+{
+    Request request;
+    request.m_inputs = std::move(inputs);
+    request.m_queueTime = Clock::now();
+    auto result = request.m_outputs.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop)
+            LogicError("Evaluate() called after Destroy()");
+        m_queue.push_back(std::move(request));
+    }
+    m_requestQueued.notify_one();
+    return result;
+}
+
+template <typename ElemType>
+BatchingStatistics CNTKEvalBatching<ElemType>::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+// The worker thread: waits for a full batch or the deadline of the oldest request, whichever comes first.
+template <typename ElemType>
+void CNTKEvalBatching<ElemType>::EvaluateRequests()
+{
+    for (;;)
+    {
+        std::vector<Request> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_requestQueued.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty())
+                return; // stopped, and nothing left to do
+
+            auto deadline = m_queue.front().m_queueTime + m_maxLatency;
+            m_requestQueued.wait_until(lock, deadline, [this]() { return m_stop || m_queue.size() >= m_maxBatchSize; });
+
+            auto now = Clock::now();
+            while (!m_queue.empty() && batch.size() < m_maxBatchSize)
+            {
+                auto queueTime = std::chrono::duration_cast<std::chrono::microseconds>(now - m_queue.front().m_queueTime).count();
+                size_t bucket = 0;
+                while (bucket < 63 && (1ll << bucket) <= queueTime)
+                    bucket++;
+                if (m_statistics.m_queueTimeHistogram.size() <= bucket)
+                    m_statistics.m_queueTimeHistogram.resize(bucket + 1, 0);
+                m_statistics.m_queueTimeHistogram[bucket]++;
+
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+            m_statistics.m_batchSizeHistogram[batch.size()]++;
+        }
+        EvaluateBatch(batch);
+    }
+}
+
+template <typename ElemType>
+void CNTKEvalBatching<ElemType>::EvaluateBatch(std::vector<Request>& batch)
+{
+    try
+    {
+        std::vector<Values<ElemType>> inputs(batch.size());
+        std::vector<Values<ElemType>> outputs(batch.size());
+        for (size_t r = 0; r < batch.size(); r++)
+        {
+            inputs[r] = std::move(batch[r].m_inputs);
+            size_t numSamples = (m_numInputElements == 0 || inputs[r].empty()) ? 1 : inputs[r][0].m_buffer.size() / m_numInputElements;
+            outputs[r] = m_outputSchema.CreateBuffers<ElemType>(std::vector<size_t>(m_outputSchema.size(), std::max<size_t>(numSamples, 1)));
+        }
+
+        m_eval->ForwardPassBatch(inputs, outputs);
+
+        for (size_t r = 0; r < batch.size(); r++)
+            batch[r].m_outputs.set_value(std::move(outputs[r]));
+    }
+    catch (...)
+    {
+        for (auto& request : batch)
+            request.m_outputs.set_exception(std::current_exception());
+    }
+}
+
+template <typename ElemType>
+void CNTKEvalBatching<ElemType>::Destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_requestQueued.notify_one();
+    m_thread.join();
+    delete this;
+}
+
+template <typename ElemType>
+void EVAL_API GetEvalBatching(IEvaluateModelExtended<ElemType>* eval, size_t maxBatchSize, size_t maxLatencyInMicroseconds, IEvaluateModelBatching<ElemType>** pbatching)
+{
+    *pbatching = new CNTKEvalBatching<ElemType>(eval, maxBatchSize, maxLatencyInMicroseconds);
+}
+
+extern "C" EVAL_API void GetEvalBatchingF(IEvaluateModelExtended<float>* eval, size_t maxBatchSize, size_t maxLatencyInMicroseconds, IEvaluateModelBatching<float>** pbatching)
+{
+    GetEvalBatching(eval, maxBatchSize, maxLatencyInMicroseconds, pbatching);
+}
+extern "C" EVAL_API void GetEvalBatchingD(IEvaluateModelExtended<double>* eval, size_t maxBatchSize, size_t maxLatencyInMicroseconds, IEvaluateModelBatching<double>** pbatching)
+{
+    GetEvalBatching(eval, maxBatchSize, maxLatencyInMicroseconds, pbatching);
+}
+
+template class CNTKEvalBatching<double>;
+template class CNTKEvalBatching<float>;
+
+// ----------------------------------------------------------------------------
+// Streaming front-end
+// ----------------------------------------------------------------------------
+
+template <typename ElemType>
+CNTKEvalStreaming<ElemType>::CNTKEvalStreaming(CNTKEvalExtended<ElemType>* eval, size_t maxNumStreams, size_t lookahead)
+    : m_eval(eval), m_lookahead(lookahead), m_streams(maxNumStreams, Stream{ false, false, {} })
+{
+    if (!m_eval->m_started)
+        LogicError("GetEvalStreaming: StartForwardEvaluation() must be called first.");
+    if (maxNumStreams == 0)
+        InvalidArgument("GetEvalStreaming: The maximum number of streams must be positive.");
+
+    std::set<ComputationNodeBasePtr> visited;
+    for (const auto& outputNode : m_eval->m_outputNodes)
+    {
+        for (const auto& node : m_eval->m_net->GetAllNodesForRoot(outputNode))
+        {
+            if (!visited.insert(node).second)
+                continue;
+            if (node->OperationName() == OperationNameOf(FutureValueNode) && m_lookahead == 0)
+                InvalidArgument("GetEvalStreaming: The model looks into the future (%ls), which requires a lookahead.", node->NodeName().c_str());
+            if (node->OperationName() != OperationNameOf(PastValueNode))
+                continue;
+
+            auto pastValueNode = dynamic_pointer_cast<PastValueNodeBase>(node);
+            if (pastValueNode->TimeStep() != 1)
+                InvalidArgument("GetEvalStreaming: %ls has timeStep=%d, only 1 is supported.", node->NodeName().c_str(), pastValueNode->TimeStep());
+            size_t dim = node->GetSampleLayout().GetNumElements();
+            m_pastValueNodes.push_back(pastValueNode);
+            m_states.push_back(make_shared<Matrix<ElemType>>(dim, maxNumStreams, node->GetDeviceId()));
+            m_states.back()->SetValue(0);
+            m_carriedOverFrames.push_back(make_shared<Matrix<ElemType>>(node->GetDeviceId()));
+        }
+    }
+}
+
+template <typename ElemType>
+size_t CNTKEvalStreaming<ElemType>::OpenStream()
+{
+    for (size_t stream = 0; stream < m_streams.size(); stream++)
+    {
+        if (!m_streams[stream].m_open)
+        {
+            m_streams[stream] = Stream{ true, false, Values<ElemType>(m_eval->m_inputNodes.size()) };
+            return stream;
+        }
+    }
+    RuntimeError("OpenStream: All %d streams are open.", (int)m_streams.size());
+}
+
+template <typename ElemType>
+typename CNTKEvalStreaming<ElemType>::Stream& CNTKEvalStreaming<ElemType>::GetOpenStream(size_t stream)
+{
+    if (stream >= m_streams.size() || !m_streams[stream].m_open)
+        RuntimeError("Stream %d is not open.", (int)stream);
+    return m_streams[stream];
+}
+
+template <typename ElemType>
+void CNTKEvalStreaming<ElemType>::CloseStream(size_t stream)
+{
+    GetOpenStream(stream) = Stream{ false, false, {} };
+}
+
+// Each stream is a parallel sequence of the minibatch, with the frames held back from its previous chunk followed by
+// its new chunk. It continues from its carried-over frames (tBegin = -1), and the carried-over frames are taken after
+// its last frame that is complete; the frames held back are evaluated again from there with the next chunk.
+template <typename ElemType>
+void CNTKEvalStreaming<ElemType>::ForwardPass(const std::vector<size_t>& streams, const std::vector<Values<ElemType>>& inputs,
+                                              std::vector<Values<ElemType>>& outputs, const std::vector<bool>& endOfStream)
+{
+    if (inputs.size() != streams.size() || outputs.size() != streams.size() || endOfStream.size() != streams.size())
+        RuntimeError("ForwardPass: Expected inputs, outputs, and end-of-stream flags for %d streams.", (int)streams.size());
+
+    const auto& inputNodes = m_eval->m_inputNodes;
+    std::vector<size_t> requests; // [sequence] index into 'streams' of the streams with frames
+    std::vector<Values<ElemType>> sequenceInputs;
+    std::vector<Values<ElemType>> sequenceOutputs;
+    std::vector<ptrdiff_t> sequenceBegins;
+    std::vector<size_t> numCompleteFrames;
+    for (size_t r = 0; r < streams.size(); r++)
+    {
+        auto& stream = GetOpenStream(streams[r]);
+        if (std::find(streams.begin(), streams.begin() + r, streams[r]) != streams.begin() + r)
+            RuntimeError("ForwardPass: Stream %d is given more than once.", (int)streams[r]);
+        if (inputs[r].size() != inputNodes.size())
+            RuntimeError("Stream %d: Expected %d inputs, but got %d.", (int)streams[r], (int)inputNodes.size(), (int)inputs[r].size());
+
+        Values<ElemType> frames(inputNodes.size());
+        for (size_t i = 0; i < inputNodes.size(); i++)
+        {
+            frames[i].m_buffer = stream.m_heldBack[i].m_buffer;
+            frames[i].m_buffer.insert(frames[i].m_buffer.end(), inputs[r][i].m_buffer.begin(), inputs[r][i].m_buffer.end());
+        }
+        size_t numFrames = inputNodes.empty() ? 0 : frames[0].m_buffer.size() / inputNodes[0]->GetSampleLayout().GetNumElements();
+        if (numFrames == 0)
+        {
+            for (auto& output : outputs[r])
+                output.m_buffer.clear();
+            continue;
+        }
+
+        requests.push_back(r);
+        sequenceInputs.push_back(std::move(frames));
+        sequenceOutputs.push_back(std::move(outputs[r]));
+        sequenceBegins.push_back(stream.m_hasState ? -1 : 0);
+        numCompleteFrames.push_back(endOfStream[r] ? numFrames : numFrames - std::min(numFrames, m_lookahead));
+    }
+
+    auto setCarriedOverFrames = [&]()
+    {
+        for (size_t k = 0; k < m_pastValueNodes.size(); k++)
+        {
+            auto& frames = *m_carriedOverFrames[k];
+            frames.Resize(m_states[k]->GetNumRows(), requests.size());
+            frames.SetValue(0);
+            for (size_t j = 0; j < requests.size(); j++)
+            {
+                if (m_streams[streams[requests[j]]].m_hasState)
+                    frames.SetColumnSlice(m_states[k]->ColumnSlice(streams[requests[j]], 1), j, 1);
+            }
+            m_pastValueNodes[k]->SetCarriedOverFrames(frames);
+        }
+    };
+
+    if (!requests.empty())
+    {
+        try
+        {
+            m_eval->ForwardPassSequences(sequenceInputs, sequenceOutputs, sequenceBegins, numCompleteFrames, setCarriedOverFrames);
+        }
+        catch (...)
+        {
+            for (size_t j = 0; j < requests.size(); j++)
+                outputs[requests[j]] = std::move(sequenceOutputs[j]);
+            throw;
+        }
+    }
+
+    for (size_t j = 0; j < requests.size(); j++)
+    {
+        size_t r = requests[j];
+        auto& stream = m_streams[streams[r]];
+        outputs[r] = std::move(sequenceOutputs[j]);
+        if (numCompleteFrames[j] > 0)
+        {
+            for (size_t k = 0; k < m_pastValueNodes.size(); k++)
+                m_states[k]->SetColumnSlice(m_pastValueNodes[k]->CarriedOverFrame(numCompleteFrames[j] - 1, j), streams[r], 1);
+            stream.m_hasState = true;
+        }
+
+        // hold back the frames that are not complete
+        for (size_t i = 0; i < inputNodes.size(); i++)
+        {
+            const auto& frames = sequenceInputs[j][i].m_buffer;
+            size_t numRows = inputNodes[i]->GetSampleLayout().GetNumElements();
+            stream.m_heldBack[i].m_buffer.assign(frames.begin() + numCompleteFrames[j] * numRows, frames.end());
+        }
+    }
+
+    for (size_t r = 0; r < streams.size(); r++)
+    {
+        if (endOfStream[r])
+            CloseStream(streams[r]);
+    }
+}
+
+template <typename ElemType>
+void CNTKEvalStreaming<ElemType>::Destroy()
+{
+    delete this;
+}
+
+template <typename ElemType>
+void EVAL_API GetEvalStreaming(IEvaluateModelExtended<ElemType>* eval, size_t maxNumStreams, size_t lookahead, IEvaluateModelStreaming<ElemType>** pstreaming)
+{
+    auto extended = dynamic_cast<CNTKEvalExtended<ElemType>*>(eval);
+    if (!extended)
+        InvalidArgument("GetEvalStreaming: The evaluator must be one of GetEvalExtended().");
+    *pstreaming = new CNTKEvalStreaming<ElemType>(extended, maxNumStreams, lookahead);
+}
+
+extern "C" EVAL_API void GetEvalStreamingF(IEvaluateModelExtended<float>* eval, size_t maxNumStreams, size_t lookahead, IEvaluateModelStreaming<float>** pstreaming)
+{
+    GetEvalStreaming(eval, maxNumStreams, lookahead, pstreaming);
+}
+extern "C" EVAL_API void GetEvalStreamingD(IEvaluateModelExtended<double>* eval, size_t maxNumStreams, size_t lookahead, IEvaluateModelStreaming<double>** pstreaming)
+{
+    GetEvalStreaming(eval, maxNumStreams, lookahead, pstreaming);
+}
+
+template class CNTKEvalStreaming<double>;
+template class CNTKEvalStreaming<float>;
+
+// ----------------------------------------------------------------------------
+// Beam search front-end
+// ----------------------------------------------------------------------------
+
+// score of the beams that are not in use, e.g. all but one of each sequence at the first step, when they would all be alike
+static const double s_unusedBeamScore = -1e30;
+
+template <typename ElemType>
+CNTKEvalBeamSearch<ElemType>::CNTKEvalBeamSearch(CNTKEvalExtended<ElemType>* eval, const std::wstring& tokenInputName, size_t beamWidth,
+                                                 size_t startToken, size_t endToken, size_t maxLength)
+    : m_eval(eval), m_beamWidth(beamWidth), m_startToken(startToken), m_endToken(endToken), m_maxLength(maxLength)
+{
+    if (!m_eval->m_started)
+        LogicError("GetEvalBeamSearch: StartForwardEvaluation() must be called first.");
+    if (beamWidth == 0)
+        InvalidArgument("GetEvalBeamSearch: The beam width must be positive.");
+    if (m_eval->m_outputNodes.size() != 1)
+        InvalidArgument("GetEvalBeamSearch: The model must have one output, the scores of the next token, but it has %d.", (int)m_eval->m_outputNodes.size());
+
+    const auto& inputNodes = m_eval->m_inputNodes;
+    auto tokenInput = std::find_if(inputNodes.begin(), inputNodes.end(), [&](const ComputationNodeBasePtr& node) { return node->NodeName() == tokenInputName; });
+    if (tokenInput == inputNodes.end())
+        InvalidArgument("GetEvalBeamSearch: The model has no input %ls.", tokenInputName.c_str());
+    m_tokenInput = tokenInput - inputNodes.begin();
+    m_vocabularySize = (*tokenInput)->GetSampleLayout().GetNumElements();
+    const auto& outputNode = m_eval->m_outputNodes[0];
+    if (outputNode->GetSampleLayout().GetNumElements() != m_vocabularySize)
+        InvalidArgument("GetEvalBeamSearch: The output %ls has dimension %d, but the token input has %d.",
+                        outputNode->NodeName().c_str(), (int)outputNode->GetSampleLayout().GetNumElements(), (int)m_vocabularySize);
+    if (!outputNode->HasMBLayout())
+        InvalidArgument("GetEvalBeamSearch: The output %ls does not depend on the tokens.", outputNode->NodeName().c_str());
+    if (startToken >= m_vocabularySize || endToken >= m_vocabularySize)
+        InvalidArgument("GetEvalBeamSearch: The start and end tokens must be less than the dimension %d of the token input.", (int)m_vocabularySize);
+
+    for (const auto& node : m_eval->m_net->GetAllNodesForRoot(outputNode))
+    {
+        if (node->OperationName() == OperationNameOf(FutureValueNode))
+            InvalidArgument("GetEvalBeamSearch: The model looks into the future (%ls), which is not known while decoding.", node->NodeName().c_str());
+        if (node->OperationName() != OperationNameOf(PastValueNode))
+            continue;
+        auto pastValueNode = dynamic_pointer_cast<PastValueNodeBase>(node);
+        if (pastValueNode->TimeStep() != 1)
+            InvalidArgument("GetEvalBeamSearch: %ls has timeStep=%d, only 1 is supported.", node->NodeName().c_str(), pastValueNode->TimeStep());
+        m_pastValueNodes.push_back(pastValueNode);
+    }
+
+    DEVICEID_TYPE deviceId = outputNode->GetDeviceId();
+    m_contexts.resize(inputNodes.size());
+    for (size_t i = 0; i < inputNodes.size(); i++)
+    {
+        if (i != m_tokenInput)
+            m_contexts[i] = make_shared<Matrix<ElemType>>(deviceId);
+    }
+    m_beamScores = make_shared<Matrix<ElemType>>(deviceId);
+    m_totalScores = make_shared<Matrix<ElemType>>(deviceId);
+    m_topIndices = make_shared<Matrix<ElemType>>(deviceId);
+    m_topScores = make_shared<Matrix<ElemType>>(deviceId);
+    m_backpointers = make_shared<Matrix<ElemType>>(deviceId);
+}
+
+// sets the token input to the one-hot vectors of 'tokens', built on the CPU only as a sparse matrix if the input is sparse
+template <typename ElemType>
+void CNTKEvalBeamSearch<ElemType>::SetTokens(const std::vector<size_t>& tokens)
+{
+    auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(m_eval->m_inputNodes[m_tokenInput]->ValuePtr());
+    if (matrix->GetMatrixType() == MatrixType::SPARSE)
+    {
+        std::vector<CPUSPARSE_INDEX_TYPE> colStarts(tokens.size() + 1);
+        std::vector<CPUSPARSE_INDEX_TYPE> rows(tokens.size());
+        std::vector<ElemType> values(tokens.size(), 1);
+        for (size_t n = 0; n < tokens.size(); n++)
+        {
+            colStarts[n] = (CPUSPARSE_INDEX_TYPE)n;
+            rows[n] = (CPUSPARSE_INDEX_TYPE)tokens[n];
+        }
+        colStarts[tokens.size()] = (CPUSPARSE_INDEX_TYPE)tokens.size();
+        matrix->SetMatrixFromCSCFormat(colStarts.data(), rows.data(), values.data(), tokens.size(), m_vocabularySize, tokens.size());
+    }
+    else
+    {
+        m_hostBuffer.assign(m_vocabularySize * tokens.size(), 0);
+        for (size_t n = 0; n < tokens.size(); n++)
+            m_hostBuffer[n * m_vocabularySize + tokens[n]] = 1;
+        matrix->SetValue(m_vocabularySize, tokens.size(), matrix->GetDeviceId(), m_hostBuffer.data(), matrixFlagNormal);
+    }
+}
+
+// Each beam is a parallel sequence of the minibatch, which gets one frame per step: the beams of sequence b are the
+// parallel sequences b*K .. b*K+K-1. The step starts the beams at the first step (tBegin = 0), and continues them from
+// their carried-over frames after that (tBegin = -1). Of the V*K expansions of the beams of a sequence, the top 2K are
+// selected on the device, so that there are K that do not end the hypothesis, unless they score below the complete ones.
+template <typename ElemType>
+void CNTKEvalBeamSearch<ElemType>::Decode(const std::vector<Values<ElemType>>& contexts, std::vector<std::vector<BeamSearchHypothesis>>& results)
+{
+    const auto& inputNodes = m_eval->m_inputNodes;
+    const auto& outputNode = m_eval->m_outputNodes[0];
+    size_t numSequences = contexts.size();
+    results.assign(numSequences, {});
+    if (numSequences == 0)
+        return;
+
+    const size_t K = m_beamWidth;
+    const size_t V = m_vocabularySize;
+    const size_t N = numSequences * K;
+
+    // the context frames, each repeated for the beams of its sequence
+    for (size_t r = 0; r < numSequences; r++)
+    {
+        if (contexts[r].size() + 1 != inputNodes.size())
+            RuntimeError("Decode: Sequence %d: Expected %d context inputs, but got %d.", (int)r, (int)inputNodes.size() - 1, (int)contexts[r].size());
+    }
+    for (size_t i = 0; i < inputNodes.size(); i++)
+    {
+        if (i == m_tokenInput)
+            continue;
+        size_t numRows = inputNodes[i]->GetSampleLayout().GetNumElements();
+        m_hostBuffer.resize(numRows * N);
+        for (size_t r = 0; r < numSequences; r++)
+        {
+            const auto& frame = contexts[r][i < m_tokenInput ? i : i - 1].m_buffer;
+            if (frame.size() != numRows)
+                RuntimeError("Decode: Sequence %d, input %ls: Expected one frame of %d elements, but got %d.", (int)r, inputNodes[i]->NodeName().c_str(), (int)numRows, (int)frame.size());
+            for (size_t k = 0; k < K; k++)
+                std::copy(frame.begin(), frame.end(), m_hostBuffer.begin() + (r * K + k) * numRows);
+        }
+        m_contexts[i]->SetValue(numRows, N, m_contexts[i]->GetDeviceId(), m_hostBuffer.data(), matrixFlagNormal);
+    }
+
+    // the beams, on the CPU only their tokens and scores
+    std::vector<std::vector<size_t>> tokens(N);
+    std::vector<size_t> lastTokens(N, m_startToken);
+    std::vector<ElemType> beamScores(N, (ElemType)s_unusedBeamScore);
+    for (size_t r = 0; r < numSequences; r++)
+        beamScores[r * K] = 0;
+    std::vector<bool> done(numSequences, false);
+    size_t numDone = 0;
+
+    const size_t numCandidates = std::min(2 * K, V * K);
+    std::vector<ElemType> topIndices(numCandidates * numSequences);
+    std::vector<ElemType> topScores(numCandidates * numSequences);
+    std::vector<size_t> order(numCandidates);
+    std::vector<ElemType> backpointers(N);
+    std::vector<std::vector<size_t>> nextTokens(N);
+    std::vector<ElemType> nextScores(N);
+
+    for (size_t step = 0; step < m_maxLength && numDone < numSequences; step++)
+    {
+        std::set<MBLayoutPtr> layoutsDone; // (inputs may share their layout)
+        for (auto& inputNode : inputNodes)
+        {
+            auto pMBLayout = inputNode->GetMBLayout();
+            if (!layoutsDone.insert(pMBLayout).second)
+                continue;
+            pMBLayout->Init(N, 1);
+            for (size_t n = 0; n < N; n++)
+                pMBLayout->AddSequence(n, n, step == 0 ? 0 : -1, 1);
+        }
+        SetTokens(lastTokens);
+        for (size_t i = 0; i < inputNodes.size(); i++)
+        {
+            if (i != m_tokenInput)
+                dynamic_pointer_cast<Matrix<ElemType>>(inputNodes[i]->ValuePtr())->SetValue(*m_contexts[i]);
+        }
+        ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+        m_eval->m_net->ForwardProp(outputNode);
+
+        // the total score of each expansion, and the top ones of each sequence
+        const auto& scores = dynamic_pointer_cast<ComputationNode<ElemType>>(outputNode)->Value();
+        if (scores.GetNumCols() != N)
+            RuntimeError("Decode: The output %ls has %d columns, expected one per beam (%d).", outputNode->NodeName().c_str(), (int)scores.GetNumCols(), (int)N);
+        m_beamScores->SetValue(1, N, m_beamScores->GetDeviceId(), beamScores.data(), matrixFlagNormal);
+        m_totalScores->SetValue(scores);
+        Matrix<ElemType>::ScaleAndAdd(1, *m_beamScores, *m_totalScores);
+        m_totalScores->Reshape(V * K, numSequences);
+        m_totalScores->VectorMax(*m_topIndices, *m_topScores, /*isColWise=*/true, (int)numCandidates);
+        ElemType* data = topIndices.data();
+        size_t dataSize = topIndices.size(); // (large enough, so CopyToArray() does not reallocate)
+        m_topIndices->CopyToArray(data, dataSize);
+        data = topScores.data();
+        dataSize = topScores.size();
+        m_topScores->CopyToArray(data, dataSize);
+
+        // select the beams of the next step
+        bool lastStep = step + 1 == m_maxLength;
+        for (size_t r = 0; r < numSequences; r++)
+        {
+            if (done[r]) // (its beams still run along, but are ignored)
+            {
+                for (size_t n = r * K; n < (r + 1) * K; n++)
+                    backpointers[n] = (ElemType)n;
+                continue;
+            }
+
+            // best first; ties go to the expansion of the lower beam and token, independent of the top-k of the device
+            const ElemType* candidateIndices = topIndices.data() + r * numCandidates;
+            const ElemType* candidateScores = topScores.data() + r * numCandidates;
+            for (size_t c = 0; c < numCandidates; c++)
+                order[c] = c;
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+            {
+                return candidateScores[a] > candidateScores[b] || (candidateScores[a] == candidateScores[b] && candidateIndices[a] < candidateIndices[b]);
+            });
+
+            size_t numContinuing = 0;
+            for (size_t c : order)
+            {
+                if (numContinuing == K || candidateScores[c] < s_unusedBeamScore / 2) // (the rest are expansions of unused beams)
+                    break;
+                size_t index = (size_t)candidateIndices[c];
+                size_t parent = r * K + index / V;
+                size_t token = index % V;
+                if (token == m_endToken)
+                    results[r].push_back(BeamSearchHypothesis{ tokens[parent], (double)candidateScores[c], true });
+                else
+                {
+                    size_t n = r * K + numContinuing++;
+                    backpointers[n] = (ElemType)parent;
+                    nextTokens[n] = tokens[parent];
+                    nextTokens[n].push_back(token);
+                    nextScores[n] = candidateScores[c];
+                }
+            }
+            for (size_t n = r * K + numContinuing; n < (r + 1) * K; n++)
+            {
+                backpointers[n] = (ElemType)(r * K);
+                nextTokens[n].clear();
+                nextScores[n] = (ElemType)s_unusedBeamScore;
+            }
+
+            // The scores only decrease along a hypothesis, so the sequence is done once it has K complete ones that score
+            // at least as well as the best one still being expanded.
+            auto& hypotheses = results[r];
+            std::stable_sort(hypotheses.begin(), hypotheses.end(), [](const BeamSearchHypothesis& a, const BeamSearchHypothesis& b) { return a.m_score > b.m_score; });
+            if (numContinuing == 0 || (hypotheses.size() >= K && hypotheses[K - 1].m_score >= nextScores[r * K]))
+                done[r] = true;
+            else if (lastStep)
+            {
+                for (size_t n = r * K; n < r * K + numContinuing; n++)
+                    hypotheses.push_back(BeamSearchHypothesis{ nextTokens[n], (double)nextScores[n], false });
+                done[r] = true;
+            }
+            if (done[r])
+            {
+                numDone++;
+                std::stable_sort(hypotheses.begin(), hypotheses.end(), [](const BeamSearchHypothesis& a, const BeamSearchHypothesis& b) { return a.m_score > b.m_score; });
+                if (hypotheses.size() > K)
+                    hypotheses.resize(K);
+            }
+        }
+
+        for (size_t r = 0; r < numSequences; r++)
+        {
+            for (size_t n = r * K; n < (r + 1) * K && !done[r]; n++)
+            {
+                std::swap(tokens[n], nextTokens[n]);
+                lastTokens[n] = tokens[n].empty() ? m_startToken : tokens[n].back();
+                beamScores[n] = nextScores[n];
+            }
+        }
+
+        // the recurrent state follows the beams, on the device
+        if (!lastStep && numDone < numSequences && !m_pastValueNodes.empty())
+        {
+            m_backpointers->SetValue(1, N, m_backpointers->GetDeviceId(), backpointers.data(), matrixFlagNormal);
+            for (auto& pastValueNode : m_pastValueNodes)
+                pastValueNode->ReorderCarriedOverFrames(*m_backpointers);
+        }
+    }
+}
+
+template <typename ElemType>
+void CNTKEvalBeamSearch<ElemType>::Destroy()
+{
+    delete this;
+}
+
+template <typename ElemType>
+void EVAL_API GetEvalBeamSearch(IEvaluateModelExtended<ElemType>* eval, const std::wstring& tokenInputName, size_t beamWidth,
+                                size_t startToken, size_t endToken, size_t maxLength, IEvaluateModelBeamSearch<ElemType>** pbeamSearch)
+{
+    auto extended = dynamic_cast<CNTKEvalExtended<ElemType>*>(eval);
+    if (!extended)
+        InvalidArgument("GetEvalBeamSearch: The evaluator must be one of GetEvalExtended().");
+    *pbeamSearch = new CNTKEvalBeamSearch<ElemType>(extended, tokenInputName, beamWidth, startToken, endToken, maxLength);
+}
+
+extern "C" EVAL_API void GetEvalBeamSearchF(IEvaluateModelExtended<float>* eval, const std::wstring& tokenInputName, size_t beamWidth,
+                                            size_t startToken, size_t endToken, size_t maxLength, IEvaluateModelBeamSearch<float>** pbeamSearch)
+{
+    GetEvalBeamSearch(eval, tokenInputName, beamWidth, startToken, endToken, maxLength, pbeamSearch);
+}
+extern "C" EVAL_API void GetEvalBeamSearchD(IEvaluateModelExtended<double>* eval, const std::wstring& tokenInputName, size_t beamWidth,
+                                            size_t startToken, size_t endToken, size_t maxLength, IEvaluateModelBeamSearch<double>** pbeamSearch)
+{
+    GetEvalBeamSearch(eval, tokenInputName, beamWidth, startToken, endToken, maxLength, pbeamSearch);
+}
+
+template class CNTKEvalBeamSearch<double>;
+template class CNTKEvalBeamSearch<float>;
+
+// ----------------------------------------------------------------------------
+// Model registry
+// ----------------------------------------------------------------------------
+
+template <typename ElemType>
+CNTKEvalRegistry<ElemType>::CNTKEvalRegistry(int deviceId, size_t maxResidentParameterBytes)
+    : m_deviceId(deviceId), m_maxResidentParameterBytes(maxResidentParameterBytes), m_residentParameterBytes(0), m_useCount(0)
+{
+    // The CUDA context is per device and process anyway; the allocations of all models go through the caching allocator of the device.
+    if (m_deviceId >= 0)
+        Matrix<ElemType>::UseCachedResizeOrNot(true);
+}
+
+template <typename ElemType>
+void CNTKEvalRegistry<ElemType>::AddModel(const std::wstring& name, const std::string& config, const std::vector<std::wstring>& outputs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_models.find(name) != m_models.end())
+        InvalidArgument("AddModel: There is already a model %ls.", name.c_str());
+
+    // (the later deviceId takes precedence over one in the configuration)
+    const std::string modelConfig = config + "\ndeviceId = " + std::to_string(m_deviceId) + "\n";
+    auto eval = new CNTKEvalExtended<ElemType>();
+    Model model{ eval, {}, 0, 0, ModelUsage{ name, 0, true, 0, 0 } };
+    try
+    {
+        eval->Init(modelConfig);
+        eval->CreateNetwork(modelConfig);
+        eval->StartForwardEvaluation(outputs);
+        for (const auto& node : eval->m_net->GetNodesWithType(OperationNameOf(LearnableParameter)))
+        {
+            auto value = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+            model.m_parameters.push_back(value);
+            model.m_usage.m_parameterBytes += value->GetNumElements() * sizeof(ElemType);
+        }
+        m_residentParameterBytes += model.m_usage.m_parameterBytes;
+        PageOut(model);
+    }
+    catch (...)
+    {
+        eval->Destroy();
+        throw;
+    }
+    m_models.insert(std::make_pair(name, model));
+}
+
+template <typename ElemType>
+typename CNTKEvalRegistry<ElemType>::Model& CNTKEvalRegistry<ElemType>::GetModel(const std::wstring& name)
+{
+    auto iter = m_models.find(name);
+    if (iter == m_models.end())
+        InvalidArgument("There is no model %ls.", name.c_str());
+    return iter->second;
+}
+
+template <typename ElemType>
+void CNTKEvalRegistry<ElemType>::RemoveModel(const std::wstring& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& model = GetModel(name);
+    if (model.m_numAcquired > 0)
+        LogicError("RemoveModel: The model %ls is acquired.", name.c_str());
+    if (model.m_usage.m_resident)
+        m_residentParameterBytes -= model.m_usage.m_parameterBytes;
+    model.m_eval->Destroy();
+    m_models.erase(name);
+}
+
+template <typename ElemType>
+void CNTKEvalRegistry<ElemType>::PageIn(Model& model)
+{
+    for (const auto& parameter : model.m_parameters)
+        parameter->TransferToDeviceIfNotThere(m_deviceId, /*isBeingMoved=*/true);
+    model.m_usage.m_resident = true;
+    model.m_usage.m_numPageIns++;
+    m_residentParameterBytes += model.m_usage.m_parameterBytes;
+}
+
+template <typename ElemType>
+void CNTKEvalRegistry<ElemType>::PageOut(Model& model)
+{
+    for (const auto& parameter : model.m_parameters)
+        parameter->TransferToDeviceIfNotThere(CPUDEVICE, /*isBeingMoved=*/true);
+    model.m_usage.m_resident = false;
+    m_residentParameterBytes -= model.m_usage.m_parameterBytes;
+}
+
+template <typename ElemType>
+IEvaluateModelExtended<ElemType>* CNTKEvalRegistry<ElemType>::Acquire(const std::wstring& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& model = GetModel(name);
+    if (!model.m_usage.m_resident)
+    {
+        // evict the least recently used models that are not acquired, until this one fits into the budget (or nothing is left to evict)
+        while (m_residentParameterBytes + model.m_usage.m_parameterBytes > m_maxResidentParameterBytes)
+        {
+            Model* leastRecentlyUsed = nullptr;
+            for (auto& iter : m_models)
+            {
+                auto& other = iter.second;
+                if (other.m_usage.m_resident && other.m_numAcquired == 0 && (!leastRecentlyUsed || other.m_lastUse < leastRecentlyUsed->m_lastUse))
+                    leastRecentlyUsed = &other;
+            }
+            if (!leastRecentlyUsed)
+                break;
+            PageOut(*leastRecentlyUsed);
+        }
+        PageIn(model);
+    }
+    model.m_numAcquired++;
+    model.m_lastUse = ++m_useCount;
+    model.m_usage.m_numAcquisitions++;
+    return model.m_eval;
+}
+
+template <typename ElemType>
+void CNTKEvalRegistry<ElemType>::Release(const std::wstring& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& model = GetModel(name);
+    if (model.m_numAcquired == 0)
+        LogicError("Release: The model %ls is not acquired.", name.c_str());
+    model.m_numAcquired--;
+}
+
+template <typename ElemType>
+std::vector<ModelUsage> CNTKEvalRegistry<ElemType>::GetUsage() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<ModelUsage> usage;
+    for (const auto& iter : m_models)
+        usage.push_back(iter.second.m_usage);
+    return usage;
+}
+
+template <typename ElemType>
+void CNTKEvalRegistry<ElemType>::Destroy()
+{
+    for (auto& iter : m_models)
+        iter.second.m_eval->Destroy();
+    delete this;
+}
+
+template <typename ElemType>
+void EVAL_API GetEvalRegistry(int deviceId, size_t maxResidentParameterBytes, IEvaluateModelRegistry<ElemType>** pregistry)
+{
+    *pregistry = new CNTKEvalRegistry<ElemType>(deviceId, maxResidentParameterBytes);
+}
+
+extern "C" EVAL_API void GetEvalRegistryF(int deviceId, size_t maxResidentParameterBytes, IEvaluateModelRegistry<float>** pregistry)
+{
+    GetEvalRegistry(deviceId, maxResidentParameterBytes, pregistry);
+}
+extern "C" EVAL_API void GetEvalRegistryD(int deviceId, size_t maxResidentParameterBytes, IEvaluateModelRegistry<double>** pregistry)
+{
+    GetEvalRegistry(deviceId, maxResidentParameterBytes, pregistry);
+}
+
+template class CNTKEvalRegistry<double>;
+template class CNTKEvalRegistry<float>;
 } } }
@@ -13,12 +13,19 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
 
 #include "Eval.h"
 #include "EvalReader.h"
 #include "EvalWriter.h"
 
 #include "ComputationNetwork.h"
+#include "RecurrentNodes.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -91,7 +98,7 @@ class CNTKEvalExtended : public CNTKEvalBase<ElemType>, public IEvaluateModelExt
 {
 public:
     CNTKEvalExtended() : CNTKEvalBase<ElemType>(), 
-        m_started(false){}
+        m_started(false), m_useCudaGraphs(false), m_outputTopK(0){}
 
     virtual VariableSchema GetOutputSchema() const override;
 
@@ -107,6 +114,16 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) override;
 
+    virtual IEvaluateModelExtended<ElemType>* CreateSession() override;
+
+    virtual void ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) override;
+
+    virtual void BindInput(size_t index, ElemType* buffer, int deviceId, size_t maxNumSamples) override;
+
+    virtual void BindOutput(size_t index, ElemType* buffer, int deviceId, size_t maxNumSamples) override;
+
+    virtual void ForwardPassBound(size_t numSamples, std::vector<size_t>& numOutputSamples, bool resetRNN) override;
+
     virtual void Destroy() override;
 
     virtual void CreateNetwork(const std::string& networkDescription) override
@@ -121,15 +138,209 @@ public:
 
 private:
     static VariableLayout ToVariableLayout(const ComputationNodeBasePtr n);
+    static ComputationNetworkPtr CloneNetworkSharingParameters(const ComputationNetworkPtr& net);
     std::vector<ComputationNodeBasePtr> m_outputNodes;
     std::shared_ptr<ScopedNetworkOperationMode> m_scopedNetworkOperationMode;
     std::vector<ComputationNodeBasePtr> m_inputNodes;
     StreamMinibatchInputs m_inputMatrices;
     bool m_started;
+    bool m_useCudaGraphs; // config cudaGraphs, see ComputationNetwork::ForwardPropCaptured()
+    size_t m_outputTopK;  // config outputTopK: if > 0, the outputs are the top-k indices and scores of each sample, see GetOutputValue()
+    shared_ptr<Matrix<ElemType>> m_topKIndexes, m_topKValues, m_topKOutput;
+    std::vector<ElemType> m_batchBuffer; // for interleaving the sequences of ForwardPassBatch()
+
+    // caller-owned memory of BindInput() and BindOutput()
+    struct BoundBuffer
+    {
+        ElemType* m_data;
+        int m_deviceId;
+        size_t m_maxNumSamples;
+        shared_ptr<Matrix<ElemType>> m_view; // a matrix on m_data, if it is on the device of the model
+    };
+    std::vector<BoundBuffer> m_boundInputs;
+    std::vector<BoundBuffer> m_boundOutputs;
+    std::vector<shared_ptr<Matrix<ElemType>>> m_swappedOutValues; // (by ForwardPassBound())
+    // The number of values per sample of an output: its sample dimension, or 2k with outputTopK.
+    size_t GetOutputDim(const ComputationNodeBasePtr& node) const;
+    // The value of an output as it is returned. With outputTopK, the top k of each column are selected on the device,
+    // and the result has the k indices in rows [0, k) and their scores in rows [k, 2k), so that only these are transferred.
+    shared_ptr<Matrix<ElemType>> GetOutputValue(const ComputationNodeBasePtr& node);
+    static void Bind(std::vector<BoundBuffer>& boundBuffers, const std::vector<ComputationNodeBasePtr>& nodes, size_t index,
+                     ElemType* buffer, int deviceId, size_t maxNumSamples);
+
+    // Evaluates the requests as parallel sequences of one minibatch (ForwardPassBatch(), CNTKEvalStreaming).
+    // sequenceBegins - the tBegin of each sequence (< 0 if it continues from the previous minibatch); empty for all 0
+    // maxNumOutputSamples - the number of samples to return of each sequence, from its first in the minibatch; empty for all
+    // beforeForwardProp - called once the inputs and the layout are set up
+    void ForwardPassSequences(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs,
+                              const std::vector<ptrdiff_t>& sequenceBegins, const std::vector<size_t>& maxNumOutputSamples,
+                              const std::function<void()>& beforeForwardProp);
+    template <typename> friend class CNTKEvalStreaming;
+    template <typename> friend class CNTKEvalBeamSearch;
+    template <typename> friend class CNTKEvalRegistry;
 
     template<template<typename> class ValueContainer> 
     void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN);
 
 };
+
+// ------------------------------------------------------------------------
+// Batching front-end
+// ------------------------------------------------------------------------
+template <typename ElemType>
+class CNTKEvalBatching : public IEvaluateModelBatching<ElemType>
+{
+public:
+    CNTKEvalBatching(IEvaluateModelExtended<ElemType>* eval, size_t maxBatchSize, size_t maxLatencyInMicroseconds);
+
+    virtual std::future<Values<ElemType>> Evaluate(Values<ElemType>&& inputs) override;
+
+    virtual BatchingStatistics GetStatistics() const override;
+
+    virtual void Destroy() override;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request
+    {
+        Values<ElemType> m_inputs;
+        std::promise<Values<ElemType>> m_outputs;
+        Clock::time_point m_queueTime;
+    };
+
+    void EvaluateRequests();
+    void EvaluateBatch(std::vector<Request>& batch);
+
+    IEvaluateModelExtended<ElemType>* m_eval;
+    VariableSchema m_outputSchema;
+    size_t m_numInputElements; // of the first input, which gives the number of samples of a request
+    size_t m_maxBatchSize;
+    std::chrono::microseconds m_maxLatency;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_requestQueued;
+    std::deque<Request> m_queue;
+    bool m_stop;
+    BatchingStatistics m_statistics;
+    std::thread m_thread;
+};
+// ------------------------------------------------------------------------
+// Streaming front-end
+// ------------------------------------------------------------------------
+template <typename ElemType>
+class CNTKEvalStreaming : public IEvaluateModelStreaming<ElemType>
+{
+public:
+    CNTKEvalStreaming(CNTKEvalExtended<ElemType>* eval, size_t maxNumStreams, size_t lookahead);
+
+    virtual size_t OpenStream() override;
+
+    virtual void CloseStream(size_t stream) override;
+
+    virtual void ForwardPass(const std::vector<size_t>& streams, const std::vector<Values<ElemType>>& inputs,
+                             std::vector<Values<ElemType>>& outputs, const std::vector<bool>& endOfStream) override;
+
+    virtual void Destroy() override;
+
+private:
+    typedef DelayedValueNodeBase<ElemType, -1> PastValueNodeBase;
+
+    struct Stream
+    {
+        bool m_open;
+        bool m_hasState;                // whether the carried-over frames of the stream are valid
+        Values<ElemType> m_heldBack;    // the frames held back for the lookahead, [input]
+    };
+
+    Stream& GetOpenStream(size_t stream);
+
+    CNTKEvalExtended<ElemType>* m_eval;
+    size_t m_lookahead;
+    std::vector<Stream> m_streams;                               // [handle]
+    std::vector<shared_ptr<PastValueNodeBase>> m_pastValueNodes;
+    std::vector<shared_ptr<Matrix<ElemType>>> m_states;            // [past value node] carried-over frame of each stream, [dim x maxNumStreams]
+    std::vector<shared_ptr<Matrix<ElemType>>> m_carriedOverFrames; // [past value node] those of the streams in the minibatch, [dim x S]
+};
+
+// ------------------------------------------------------------------------
+// Beam search front-end
+// ------------------------------------------------------------------------
+template <typename ElemType>
+class CNTKEvalBeamSearch : public IEvaluateModelBeamSearch<ElemType>
+{
+public:
+    CNTKEvalBeamSearch(CNTKEvalExtended<ElemType>* eval, const std::wstring& tokenInputName, size_t beamWidth,
+                       size_t startToken, size_t endToken, size_t maxLength);
+
+    virtual void Decode(const std::vector<Values<ElemType>>& contexts, std::vector<std::vector<BeamSearchHypothesis>>& results) override;
+
+    virtual void Destroy() override;
+
+private:
+    typedef DelayedValueNodeBase<ElemType, -1> PastValueNodeBase;
+
+    void SetTokens(const std::vector<size_t>& tokens);
+
+    CNTKEvalExtended<ElemType>* m_eval;
+    size_t m_tokenInput;     // index of the token input in the inputs of the model
+    size_t m_vocabularySize; // dimension of the token input and of the output
+    size_t m_beamWidth;
+    size_t m_startToken;
+    size_t m_endToken;
+    size_t m_maxLength;
+    std::vector<shared_ptr<PastValueNodeBase>> m_pastValueNodes;
+    std::vector<shared_ptr<Matrix<ElemType>>> m_contexts; // [input] the context frames, each repeated for the beams of its sequence, [dim x B*K]; null for the token input
+    shared_ptr<Matrix<ElemType>> m_beamScores;            // [1 x B*K]
+    shared_ptr<Matrix<ElemType>> m_totalScores;           // [V x B*K], the scores of all expansions of all beams, viewed as [V*K x B] for the top-k
+    shared_ptr<Matrix<ElemType>> m_topIndices;            // [2K x B] into the rows of the [V*K x B] view
+    shared_ptr<Matrix<ElemType>> m_topScores;             // [2K x B]
+    shared_ptr<Matrix<ElemType>> m_backpointers;          // [1 x B*K] the beam each beam of the next step continues
+    std::vector<ElemType> m_hostBuffer;
+};
+
+// ------------------------------------------------------------------------
+// Model registry
+// ------------------------------------------------------------------------
+template <typename ElemType>
+class CNTKEvalRegistry : public IEvaluateModelRegistry<ElemType>
+{
+public:
+    CNTKEvalRegistry(int deviceId, size_t maxResidentParameterBytes);
+
+    virtual void AddModel(const std::wstring& name, const std::string& config, const std::vector<std::wstring>& outputs) override;
+
+    virtual void RemoveModel(const std::wstring& name) override;
+
+    virtual IEvaluateModelExtended<ElemType>* Acquire(const std::wstring& name) override;
+
+    virtual void Release(const std::wstring& name) override;
+
+    virtual std::vector<ModelUsage> GetUsage() const override;
+
+    virtual void Destroy() override;
+
+private:
+    struct Model
+    {
+        CNTKEvalExtended<ElemType>* m_eval;
+        std::vector<shared_ptr<Matrix<ElemType>>> m_parameters; // (shared with the sessions of m_eval)
+        size_t m_numAcquired;                                   // Acquire() calls not yet released
+        size_t m_lastUse;                                       // m_useCount at its latest Acquire()
+        ModelUsage m_usage;
+    };
+
+    Model& GetModel(const std::wstring& name);
+    void PageIn(Model& model);
+    void PageOut(Model& model);
+
+    int m_deviceId;
+    size_t m_maxResidentParameterBytes;
+    size_t m_residentParameterBytes;
+    size_t m_useCount;
+    mutable std::mutex m_mutex;
+    std::map<std::wstring, Model> m_models;
+};
+
 } } }
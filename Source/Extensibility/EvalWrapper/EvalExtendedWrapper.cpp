@@ -31,6 +31,7 @@ using namespace std;
 using namespace System;
 using namespace System::Collections::Generic;
 using namespace System::Collections;
+using namespace System::Runtime::InteropServices;
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Extensibility { namespace Managed {
 
@@ -165,6 +166,90 @@ public:
         }
 };
 
+//
+// Keeps the arrays of a ValueBuffer pinned for as long as the buffer is bound to an evaluator,
+// see ModelEvaluationExtended::BindBuffers().
+//
+template<typename ElemType>
+private ref class PinnedValueBuffer
+{
+public:
+    PinnedValueBuffer(ValueBuffer<ElemType>^ buffer) : m_buffer(buffer)
+    {
+    }
+
+    ~PinnedValueBuffer()
+    {
+        this->!PinnedValueBuffer();
+    }
+
+    !PinnedValueBuffer()
+    {
+        Unpin(m_bufferHandle);
+        Unpin(m_indicesHandle);
+        Unpin(m_colIndicesHandle);
+    }
+
+    //
+    // Points the native buffer to the managed arrays, with the current size of the buffer.
+    // Arrays that the caller replaced since the last call are pinned anew, otherwise nothing is allocated.
+    //
+    void Refresh(Native::ValueBuffer<ElemType, Native::VectorRef>& vb, StorageType storageType)
+    {
+        // Buffer is required
+        if (m_buffer->Buffer == nullptr)
+        {
+            throw gcnew CNTKRuntimeException("Invalid buffer (empty) for argument into ForwardPass", String::Empty);
+        }
+
+        int numElements = m_buffer->Size;
+        int bufferSize = m_buffer->ColIndices != nullptr ? m_buffer->ColIndices[m_buffer->Size - 1] : m_buffer->Size;
+        int usedSize = storageType == StorageType::Sparse ? bufferSize : 0;
+
+        vb.m_buffer.InitFrom(static_cast<ElemType*>(Pin(m_buffer->Buffer, m_bufferHandle)), bufferSize, usedSize);
+        if (m_buffer->Indices != nullptr)
+        {
+            vb.m_indices.InitFrom(static_cast<int*>(Pin(m_buffer->Indices, m_indicesHandle)), bufferSize, usedSize);
+        }
+
+        if (m_buffer->ColIndices != nullptr)
+        {
+            vb.m_colIndices.InitFrom(static_cast<int*>(Pin(m_buffer->ColIndices, m_colIndicesHandle)), numElements, storageType == StorageType::Sparse ? numElements : 0);
+        }
+    }
+
+    property ValueBuffer<ElemType>^ Buffer
+    {
+        ValueBuffer<ElemType>^ get() { return m_buffer; }
+    }
+
+private:
+    // Returns the address of the array, pinning it unless it is already.
+    static void* Pin(Array^ array, GCHandle% handle)
+    {
+        if (!handle.IsAllocated || handle.Target != array)
+        {
+            Unpin(handle);
+            handle = GCHandle::Alloc(array, GCHandleType::Pinned);
+        }
+
+        return handle.AddrOfPinnedObject().ToPointer();
+    }
+
+    static void Unpin(GCHandle% handle)
+    {
+        if (handle.IsAllocated)
+        {
+            handle.Free();
+        }
+    }
+
+    ValueBuffer<ElemType>^ m_buffer;
+    GCHandle m_bufferHandle;
+    GCHandle m_indicesHandle;
+    GCHandle m_colIndicesHandle;
+};
+
 /// Managed wrapper for the native evaluation model
 template<typename ElemType>
 public ref class ModelEvaluationExtended : IDisposable
@@ -176,6 +261,7 @@ public:
     /// <summary>Initializes a new instance of the <see cref="ModelEvaluationExtended"> class.</summary>
     /// <param name="funcName">Factory function name for retrieving the native model from the dll.</param>
     ModelEvaluationExtended(String^ funcName)
+        : m_boundInputRefs(nullptr), m_boundOutputRefs(nullptr)
     {
         try
         {
@@ -326,6 +412,107 @@ public:
         }
     }
 
+    //
+    // BindBuffers - pins the given input and output buffers and binds them to the native evaluator, so that
+    // ForwardPassBound() evaluates them without allocating or copying anything: the inputs are read from, and the
+    // outputs written to, the managed arrays in place. Callers fill the same buffers for every call and adjust their
+    // Size; a buffer whose arrays have been replaced (e.g. grown) is pinned anew on the next call.
+    // The arrays stay pinned until the buffers are unbound or bound again, or the object is disposed, so bind
+    // buffers that are reused for the whole session rather than per call.
+    //
+    void BindBuffers(cli::array<ValueBuffer<ElemType>^>^ inputs, cli::array<ValueBuffer<ElemType>^>^ outputs)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        UnbindBuffers();
+        m_boundInputs = gcnew cli::array<PinnedValueBuffer<ElemType>^>(inputs->Length);
+        for (int i = 0; i < inputs->Length; ++i)
+        {
+            m_boundInputs[i] = gcnew PinnedValueBuffer<ElemType>(inputs[i]);
+        }
+
+        m_boundOutputs = gcnew cli::array<PinnedValueBuffer<ElemType>^>(outputs->Length);
+        for (int i = 0; i < outputs->Length; ++i)
+        {
+            m_boundOutputs[i] = gcnew PinnedValueBuffer<ElemType>(outputs[i]);
+        }
+
+        m_boundInputRefs = new Native::ValueRefs<ElemType>(inputs->Length);
+        m_boundOutputRefs = new Native::ValueRefs<ElemType>(outputs->Length);
+    }
+
+    //
+    // UnbindBuffers - releases the buffers bound by BindBuffers().
+    //
+    void UnbindBuffers()
+    {
+        if (m_boundInputs != nullptr)
+        {
+            for each (auto b in m_boundInputs)
+            {
+                delete b;
+            }
+
+            for each (auto b in m_boundOutputs)
+            {
+                delete b;
+            }
+
+            m_boundInputs = nullptr;
+            m_boundOutputs = nullptr;
+        }
+
+        delete m_boundInputRefs;
+        delete m_boundOutputRefs;
+        m_boundInputRefs = nullptr;
+        m_boundOutputRefs = nullptr;
+    }
+
+    //
+    // ForwardPassBound - same as ForwardPass(), for the buffers bound by BindBuffers().
+    // Updates the Size of the bound output buffers.
+    //
+    void ForwardPassBound(bool resetRNN)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        if (m_boundInputs == nullptr)
+        {
+            throw gcnew CNTKLogicErrorException("ForwardPassBound() requires buffers bound by BindBuffers().", String::Empty);
+        }
+
+        for (int i = 0; i < m_boundInputs->Length; ++i)
+        {
+            m_boundInputs[i]->Refresh((*m_boundInputRefs)[i], StorageType::Sparse);
+        }
+
+        for (int i = 0; i < m_boundOutputs->Length; ++i)
+        {
+            m_boundOutputs[i]->Refresh((*m_boundOutputRefs)[i], StorageType::Dense);
+        }
+
+        try
+        {
+            m_eval->ForwardPass(*m_boundInputRefs, *m_boundOutputRefs, resetRNN);
+        }
+        catch (const exception& ex)
+        {
+            throw GetCustomException(ex);
+        }
+
+        // Update actual output size.
+        for (int i = 0; i < m_boundOutputs->Length; ++i)
+        {
+            m_boundOutputs[i]->Buffer->Size = (int)(*m_boundOutputRefs)[i].m_buffer.m_size;
+        }
+    }
+
     ~ModelEvaluationExtended()
     {
         if (m_eval == nullptr)
@@ -339,6 +526,7 @@ public:
 protected:
     !ModelEvaluationExtended()
     {
+        UnbindBuffers();
         if (m_eval != nullptr)
         {
             m_eval->Destroy();
@@ -350,6 +538,12 @@ private:
     // Native model evaluation instance
     IEvaluateModelExtended<ElemType> *m_eval;
 
+    // Buffers bound by BindBuffers(), and the native views of them that ForwardPassBound() passes to the model.
+    cli::array<PinnedValueBuffer<ElemType>^>^ m_boundInputs;
+    cli::array<PinnedValueBuffer<ElemType>^>^ m_boundOutputs;
+    Native::ValueRefs<ElemType>* m_boundInputRefs;
+    Native::ValueRefs<ElemType>* m_boundOutputRefs;
+
     /// <summary> Throws a CLR exception based on a native exception</summary>
     /// <param name="ex">The native exception to throw as a CLR exception</param>
     /// <returns>A CLR exception</returns>
@@ -551,6 +745,9 @@ void EmitExtended()
     f.GetOutputSchema();
     f.StartForwardEvaluation(nullptr);
     f.ForwardPass(nullptr, nullptr);
+    f.BindBuffers(nullptr, nullptr);
+    f.ForwardPassBound(true);
+    f.UnbindBuffers();
 
     ModelEvaluationExtendedD d;
     d.CreateNetwork("");
@@ -558,6 +755,9 @@ void EmitExtended()
     d.GetOutputSchema();
     d.StartForwardEvaluation(nullptr);
     d.ForwardPass(nullptr, nullptr);
+    d.BindBuffers(nullptr, nullptr);
+    d.ForwardPassBound(true);
+    d.UnbindBuffers();
 
     VariableSchema sc;
     sc.CreateBuffers<float>();
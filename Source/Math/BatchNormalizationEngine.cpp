@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #include "BatchNormalizationEngine.h"
 #include "CuDnnFactories.h"
+#include "NcclComm.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -13,6 +14,11 @@ template <class ElemType>
 void BatchNormEngine<ElemType>::Forward(const Mat& in, const Mat& scale, const Mat& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, Mat& runMean, Mat& runVariance,
                                         Mat& out, double epsilon, Mat& savedMean, Mat& savedInvStdDev)
 {
+    if (in.GetNumRows() != m_inOutT.GetNumElements()) // spatial NHWC, see Create()
+    {
+        auto outColumns = AsInOutColumns(out);
+        return Forward(AsInOutColumns(in), scale, bias, inferenceOnly, expAvgFactor, blendFactor, runMean, runVariance, outColumns, epsilon, savedMean, savedInvStdDev);
+    }
     assert(in.GetNumRows() == m_inOutT.GetNumElements());
     assert(out.GetNumRows() == m_inOutT.GetNumElements());
     assert(in.GetNumCols() == out.GetNumCols());
@@ -68,10 +74,28 @@ void BatchNormEngine<ElemType>::Backward(const Mat& in, const Mat& srcGrad, Mat&
 {
     assert(!savedMean.IsEmpty());
     assert(!savedInvStdDev.IsEmpty());
+    if (in.GetNumRows() != m_inOutT.GetNumElements()) // spatial NHWC, see Create()
+    {
+        auto gradColumns = AsInOutColumns(grad);
+        return Backward(AsInOutColumns(in), AsInOutColumns(srcGrad), gradColumns, scale, blendFactor, savedMean, savedInvStdDev, scaleGrad, biasGrad);
+    }
     EnsureCompatible();
     BackwardCore(in, srcGrad, grad, scale, blendFactor, savedMean, savedInvStdDev, scaleGrad, biasGrad);
 }
 
+template <class ElemType>
+void BatchNormEngine<ElemType>::BackwardRelu(const Mat& in, Mat& srcGrad, const Mat& scale, const Mat& bias, const Mat& savedMean, const Mat& savedInvStdDev)
+{
+    if (!m_fuseRelu)
+        LogicError("BackwardRelu: The batch normalization engine was not created with a fused ReLU.");
+    if (in.GetNumRows() != m_inOutT.GetNumElements()) // spatial NHWC, see Create()
+    {
+        auto srcGradColumns = AsInOutColumns(srcGrad);
+        return BackwardRelu(AsInOutColumns(in), srcGradColumns, scale, bias, savedMean, savedInvStdDev);
+    }
+    srcGrad.BatchNormalizationReluBackward(in, scale, bias, savedMean, savedInvStdDev);
+}
+
 template <class ElemType>
 class CntkBatchNormEngine : public BatchNormEngine<ElemType>
 {
@@ -82,7 +106,8 @@ public:
 public:
     CntkBatchNormEngine(DEVICEID_TYPE deviceId, const TensorShape& inOutT,
                         bool spatial, ImageLayoutKind imageLayout)
-                        : Base(deviceId, inOutT, spatial, imageLayout)
+                        : Base(deviceId, inOutT, spatial, imageLayout),
+                        m_stats(deviceId), m_mean(deviceId), m_variance(deviceId), m_unused(deviceId), m_countShare(1)
     {
     }
 
@@ -91,24 +116,132 @@ protected:
     using Base::m_imageLayout;
     using Base::m_inOutT;
     using Base::m_spatial;
+    using Base::m_fuseRelu;
+    using Base::m_comm;
 
     void EnsureCompatible() override
     {
         if (m_spatial && m_imageLayout == ImageLayoutKind::HWC)
-            InvalidArgument("CNTK batch normalization supports only cudnn(CHW) layout.");
+            InvalidArgument("CNTK batch normalization supports only cudnn(CHW) and NHWC layouts.");
     }
 
     void ForwardCore(const Mat& in, const Mat& scale, const Mat& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, Mat& runMean, Mat& runVariance,
                      Mat& out, double epsilon, Mat& savedMean, Mat& savedInvStdDev) override
     {
-        in.BatchNormalizationForward(scale, bias, inferenceOnly, expAvgFactor, blendFactor, runMean, runVariance, out, epsilon, savedMean, savedInvStdDev);
+        // with blendFactor 1 and no running average the minibatch statistics are not used (e.g. a locked node)
+        if (m_comm && !inferenceOnly && !(expAvgFactor == 0 && blendFactor == 1))
+            ForwardSynchronized(in, scale, bias, expAvgFactor, blendFactor, runMean, runVariance, out, epsilon, savedMean, savedInvStdDev);
+        else
+            in.BatchNormalizationForward(scale, bias, inferenceOnly, expAvgFactor, blendFactor, runMean, runVariance, out, epsilon, savedMean, savedInvStdDev, m_fuseRelu);
     }
 
     void BackwardCore(const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, double blendFactor, const Mat& savedMean, const Mat& savedInvStdDev,
                       Mat& scaleGrad, Mat& biasGrad) override
     {
-        srcGrad.BatchNormalizationBackward(in, grad, scale, blendFactor, savedMean, savedInvStdDev, scaleGrad, biasGrad);
+        if (m_comm && blendFactor != 1)
+            BackwardSynchronized(in, srcGrad, grad, scale, blendFactor, savedMean, savedInvStdDev, scaleGrad, biasGrad);
+        else
+            srcGrad.BatchNormalizationBackward(in, grad, scale, blendFactor, savedMean, savedInvStdDev, scaleGrad, biasGrad);
+    }
+
+private:
+    // the rows [first, first + num) of the column vector v, as a reference
+    static Mat Rows(const Mat& v, size_t first, size_t num)
+    {
+        return v.Reshaped(1, v.GetNumRows()).ColumnSlice(first, num).Reshaped(num, 1);
     }
+
+    void AllReduce(Mat& v)
+    {
+        m_comm->WaitForComputeStream();
+        m_comm->AllReduce(v.Data(), v.GetNumElements());
+        m_comm->Sync();
+    }
+
+    // Computes the statistics of this minibatch, all-reduces them as [sum; sum of squares; count] (2C+1 values for C channels)
+    // and normalizes with the global ones. Running and saved statistics are as in BatchNormalizationForward(), for the global minibatch.
+    void ForwardSynchronized(const Mat& in, const Mat& scale, const Mat& bias, double expAvgFactor, double blendFactor, Mat& runMean, Mat& runVariance,
+                             Mat& out, double epsilon, Mat& savedMean, Mat& savedInvStdDev)
+    {
+        size_t numChannels = scale.GetNumRows();
+        size_t count = in.GetNumCols() * (in.GetNumRows() / numChannels);
+
+        // mean and unbiased variance of this minibatch: the running statistics of a full update from zero
+        m_mean.Resize(numChannels, 1);
+        m_variance.Resize(numChannels, 1);
+        m_mean.SetValue(0);
+        m_variance.SetValue(0);
+        in.BatchNormalizationForward(scale, bias, /*inferenceOnly=*/false, /*expAvgFactor=*/1, /*blendFactor=*/0, m_mean, m_variance, out, epsilon, savedMean, savedInvStdDev);
+
+        m_stats.Resize(2 * numChannels + 1, 1);
+        Mat sum = Rows(m_stats, 0, numChannels);
+        Mat sumOfSquares = Rows(m_stats, numChannels, numChannels);
+        Mat::Scale((ElemType)count, m_mean, sum);
+        sumOfSquares.AssignElementProductOf(m_mean, m_mean);
+        Mat::ScaleAndAdd((ElemType)(count > 1 ? count - 1 : 0), m_variance, (ElemType)count, sumOfSquares);
+        Rows(m_stats, 2 * numChannels, 1).SetValue((ElemType)count);
+
+        AllReduce(m_stats);
+
+        double globalCount = Rows(m_stats, 2 * numChannels, 1).Get00Element();
+        m_countShare = count / globalCount;
+        Mat::Scale((ElemType)(1 / globalCount), sum, m_mean);
+        // biased variance E[x^2] - E[x]^2 for the normalization
+        m_variance.AssignElementProductOf(m_mean, m_mean);
+        Mat::ScaleAndAdd((ElemType)(1 / globalCount), sumOfSquares, (ElemType)-1, m_variance);
+        m_variance.InplaceTruncateBottom(0);
+
+        // running statistics, with the unbiased variance
+        Mat::ScaleAndAdd((ElemType)expAvgFactor, m_mean, (ElemType)(1 - expAvgFactor), runMean);
+        Mat::ScaleAndAdd((ElemType)(globalCount > 1 ? expAvgFactor * globalCount / (globalCount - 1) : 0), m_variance, (ElemType)(1 - expAvgFactor), runVariance);
+
+        savedMean.SetValue(m_mean);
+        Mat::ScaleAndAdd((ElemType)blendFactor, runMean, (ElemType)(1 - blendFactor), savedMean);
+        savedInvStdDev.SetValue(m_variance);
+        savedInvStdDev += (ElemType)epsilon;
+        savedInvStdDev.InplaceSqrt();
+        savedInvStdDev.ElementInverse();
+        if (blendFactor != 0)
+        {
+            m_variance.SetValue(runVariance);
+            m_variance += (ElemType)epsilon;
+            m_variance.InplaceSqrt();
+            m_variance.ElementInverse();
+            Mat::ScaleAndAdd((ElemType)blendFactor, m_variance, (ElemType)(1 - blendFactor), savedInvStdDev);
+        }
+
+        // normalize as in inference, with the variance that corresponds to the saved inverse standard deviation
+        m_variance.AssignElementProductOf(savedInvStdDev, savedInvStdDev);
+        m_variance.ElementInverse();
+        m_variance -= (ElemType)epsilon;
+        in.BatchNormalizationForward(scale, bias, /*inferenceOnly=*/true, 0, 1, savedMean, m_variance, out, epsilon, m_unused, m_unused, m_fuseRelu);
+    }
+
+    // The input gradient depends on the gradients of scale and bias summed over the global minibatch; the parameter gradients
+    // themselves stay per rank, as they are aggregated with all others.
+    void BackwardSynchronized(const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, double blendFactor, const Mat& savedMean, const Mat& savedInvStdDev,
+                              Mat& scaleGrad, Mat& biasGrad)
+    {
+        size_t numChannels = scale.GetNumRows();
+        srcGrad.BatchNormalizationScaleAndBiasGradients(in, savedMean, savedInvStdDev, scaleGrad, biasGrad);
+
+        m_stats.Resize(2 * numChannels, 1);
+        Mat globalScaleGrad = Rows(m_stats, 0, numChannels);
+        Mat globalBiasGrad = Rows(m_stats, numChannels, numChannels);
+        globalScaleGrad.SetValue(scaleGrad);
+        globalBiasGrad.SetValue(biasGrad);
+
+        AllReduce(m_stats);
+
+        srcGrad.BatchNormalizationInputGradient(in, grad, scale, (1 - blendFactor) * m_countShare, savedMean, savedInvStdDev, globalScaleGrad, globalBiasGrad);
+    }
+
+    Mat m_stats;
+    Mat m_mean;
+    Mat m_variance;
+    Mat m_unused;
+    // samples of this rank / samples of all ranks in the last forward pass
+    double m_countShare;
 };
 
 template class CntkBatchNormEngine<float>;
@@ -124,21 +257,33 @@ std::unique_ptr<BatchNormEngine<ElemType>> BatchNormEngine<ElemType>::Create(DEV
                                                                              bool spatial, ImageLayoutKind imageLayout,
                                                                              BatchNormEngineKind enabledEngines)
 {
+    std::unique_ptr<BatchNormEngine<ElemType>> engine;
+
+    // The channels of NHWC are the first dimension, so spatial normalization of [C x W x H] samples is per-activation
+    // normalization of [C] samples, W x H times as many (see AsInOutColumns()), which needs no strided access.
+    if (spatial && imageLayout == ImageLayoutKind::NHWC)
+        return Create(deviceId, TensorShape(inOutT[0]), /*spatial=*/false, imageLayout, enabledEngines);
+
     // Use CNTK as default batch norm engine.
     if (HasFlag(enabledEngines, BatchNormEngineKind::Cntk))
     {
         if (GetMathLibTraceLevel() > 0)
             fprintf(stderr, "Using CNTK batch normalization engine.\n");
 
-        return std::make_unique<CntkBatchNormEngine<ElemType>>(deviceId, inOutT, spatial, imageLayout);
+        engine = std::make_unique<CntkBatchNormEngine<ElemType>>(deviceId, inOutT, spatial, imageLayout);
     }
-
-    if (HasFlag(enabledEngines, BatchNormEngineKind::CuDnn))
+    else if (HasFlag(enabledEngines, BatchNormEngineKind::CuDnn))
     {
         if (GetMathLibTraceLevel() > 0)
             fprintf(stderr, "Using cuDNN batch normalization engine.\n");
 
-        return CuDnnBatchNormEngineFactory<ElemType>::Create(deviceId, inOutT, spatial, imageLayout);
+        engine = CuDnnBatchNormEngineFactory<ElemType>::Create(deviceId, inOutT, spatial, imageLayout);
+    }
+
+    if (engine)
+    {
+        engine->m_fuseRelu = HasFlag(enabledEngines, BatchNormEngineKind::FusedRelu);
+        return engine;
     }
 
     RuntimeError("Could not find appropriate batch normalization engine.");
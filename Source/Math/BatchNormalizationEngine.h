@@ -10,6 +10,8 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class NcclComm;
+
 //-------------------------------------------------------------
 // Batch normalization engine interface.
 //-------------------------------------------------------------
@@ -19,7 +21,11 @@ enum class BatchNormEngineKind
     Cntk  = 1,
     CuDnn = 1 << 1,
 
-    All  = Cntk  | CuDnn
+    All  = Cntk  | CuDnn,
+
+    // Not an engine, but a modifier of the above: the engine applies a ReLU to the normalized output in the same pass,
+    // and BackwardRelu() backpropagates through it from the input and the saved statistics, without the output.
+    FusedRelu = 1 << 2
 };
 
 #pragma warning(push)
@@ -40,6 +46,18 @@ public:
     void Backward(const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, double blendFactor, const Mat& saveMean, const Mat& saveInvStdDev,
                   Mat& scaleGrad, Mat& biasGrad);
 
+    // For an engine with a fused ReLU, turns the gradient of the ReLU output into that of the normalized output, in place.
+    // Call before Backward(), which then takes srcGrad as the gradient of the normalized output.
+    void BackwardRelu(const Mat& in, Mat& srcGrad, const Mat& scale, const Mat& bias, const Mat& saveMean, const Mat& saveInvStdDev);
+
+    bool FusesRelu() const { return m_fuseRelu; }
+
+    // Synchronized batch normalization under data-parallel training: the minibatch statistics are those of the
+    // minibatches of all ranks of 'comm' together, by an all-reduce of the per-channel sums and sums of squares in
+    // Forward(), and of the scale and bias gradients in Backward(). These are collectives: all ranks must call them
+    // for each minibatch, in the same order. Pass nullptr for per-rank statistics (the default). CNTK engine only.
+    void SetCommunicator(const std::shared_ptr<NcclComm>& comm) { m_comm = comm; }
+
     static std::unique_ptr<BatchNormEngine<ElemType>> Create(DEVICEID_TYPE deviceId, const TensorShape& inOutT,
                                                              bool spatial, ImageLayoutKind imageLayout,
                                                              BatchNormEngineKind enabledEngines = BatchNormEngineKind::All);
@@ -49,12 +67,20 @@ public:
 protected:
     BatchNormEngine(DEVICEID_TYPE deviceId, const TensorShape& inOutT,
                     bool spatial, ImageLayoutKind imageLayout)
-                    : m_deviceId(deviceId), m_inOutT(inOutT), m_spatial(spatial), m_imageLayout(imageLayout)
+                    : m_deviceId(deviceId), m_inOutT(inOutT), m_spatial(spatial), m_imageLayout(imageLayout), m_fuseRelu(false)
     {
     }
 
     virtual void EnsureCompatible() = 0;
 
+    // The matrix as columns of m_inOutT, for spatial NHWC whose [C x W x H] samples are normalized as [C x WHN],
+    // per activation, see Create().
+    Mat AsInOutColumns(const Mat& m) const
+    {
+        size_t rows = m_inOutT.GetNumElements();
+        return m.Reshaped(rows, m.GetNumElements() / rows);
+    }
+
     // saveMean/saveInvStdDev return the actual mean/stddev used for normalization, except for blendFactor=1, these are unused and untouched
     virtual void ForwardCore(const Mat& in, const Mat& scale, const Mat& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, Mat& runMean, Mat& runVariance,
                  Mat& out, double epsilon, Mat& saveMean, Mat& saveInvStdDev) = 0;
@@ -67,6 +93,10 @@ protected:
     TensorShape m_inOutT;
     bool m_spatial;
     ImageLayoutKind m_imageLayout;
+    // ForwardCore() applies a ReLU to the output (BatchNormEngineKind::FusedRelu)
+    bool m_fuseRelu;
+    // reduces the statistics across the ranks, see SetCommunicator()
+    std::shared_ptr<NcclComm> m_comm;
 };
 
 #pragma warning(pop)
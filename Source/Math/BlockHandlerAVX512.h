@@ -0,0 +1,292 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+// BlockHandlerAVX512.h -- BlockHandlers using AVX-512 (Skylake-SP and better), for int16 and, with the VNNI
+// dot product instructions of Cascade Lake, for int8.
+// This header must only be included in files that are compiled with the AVX-512 options (see QuantizedBlockMultiplierAVX512*.cpp).
+//
+#pragma once
+#include "BlockMultiplierPlatform.h"
+#include "BlockMultiplierMatrixUtil.h"
+#include <immintrin.h>
+#include <assert.h>
+#include <cstdint>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// The dot product of one register of A with one register of B, added to 16 32-bit accumulators.
+template <class ScalarT, bool UseVNNI> struct AVX512DotProduct;
+
+// int16 with AVX-512 BW: multiply pairs of elements and add them up in 32 bits.
+template <> struct AVX512DotProduct<int16_t, false>
+{
+    FORCEINLINE static __m512i InitAccumulator(__m512i init, __m512i /*a*/) { return init; }
+    FORCEINLINE static __m512i PrepareB(__m512i b) { return b; }
+    FORCEINLINE static __m512i Add(__m512i accum, __m512i a, __m512i b) { return _mm512_add_epi32(accum, _mm512_madd_epi16(a, b)); }
+};
+
+// int16 with VNNI: vpdpwssd does the same as vpmaddwd and vpaddd in one instruction.
+template <> struct AVX512DotProduct<int16_t, true>
+{
+    FORCEINLINE static __m512i InitAccumulator(__m512i init, __m512i /*a*/) { return init; }
+    FORCEINLINE static __m512i PrepareB(__m512i b) { return b; }
+    FORCEINLINE static __m512i Add(__m512i accum, __m512i a, __m512i b) { return _mm512_dpwssd_epi32(accum, a, b); }
+};
+
+// int8 with VNNI: vpdpbusd multiplies unsigned with signed bytes and adds up groups of four in 32 bits.
+// B is made unsigned by adding 128 (i.e. flipping the sign bit), which adds 128 * sum(a) to each dot product,
+// so the accumulators of a row of A start at -128 * sum(a). That is computed once per block of A, while B is streamed
+// through for all columns.
+template <> struct AVX512DotProduct<int8_t, true>
+{
+    FORCEINLINE static __m512i InitAccumulator(__m512i init, __m512i a)
+    {
+        return _mm512_sub_epi32(init, _mm512_dpbusd_epi32(_mm512_setzero_si512(), _mm512_set1_epi8((char) 0x80), a));
+    }
+    FORCEINLINE static __m512i PrepareB(__m512i b) { return _mm512_xor_si512(b, _mm512_set1_epi8((char) 0x80)); }
+    FORCEINLINE static __m512i Add(__m512i accum, __m512i a, __m512i b) { return _mm512_dpbusd_epi32(accum, b, a); }
+};
+
+// BlockHandler for BlockMultiplier, with the same interface as BlockHandlerSSE and BlockHandlerAVX and the same layout
+// of the rewritten A and B (see BlockMultiplier::RewriteAInBlockOrder and BlockMultiplier::PrepareB).
+// A block of 128 int16 takes four registers, one of 64 int8 a single register. Blocks smaller than a register
+// are loaded zero-extended, and blocks of 8 use SSE like the other handlers.
+// All loads are unaligned, since blocks of int8 are not aligned to the register size.
+template <class ScalarT, bool UseVNNI>
+class BlockHandlerAVX512T
+{
+    private:
+        typedef AVX512DotProduct<ScalarT, UseVNNI> DotProduct;
+        static const int ElementsPerVector = 64 / sizeof(ScalarT);
+
+        static int RowToColOffsetRewrittenB(int col, int kOffset, int blockSize, int origCols)
+        {
+            return (origCols * blockSize * kOffset) + (col * blockSize);
+        }
+
+        static int RowToColOffsetRewrittenA(int row, int kOffset, int blockSize, int rowsPerBlock, int origCols)
+        {
+            int rowIdx = row / rowsPerBlock;
+            int offsetFromBlockBeginning = row % rowsPerBlock;
+            int colIdx = kOffset * rowsPerBlock * blockSize + (offsetFromBlockBeginning * blockSize);
+            return (rowIdx * (origCols / blockSize) * rowsPerBlock * blockSize) + colIdx;
+        }
+
+        // Loads one register of a block, or the whole block zero-extended if it is smaller than a register (16 or 32 bytes).
+        template <int BlockSize> FORCEINLINE static __m512i Load(const ScalarT* p)
+        {
+            const int bytes = BlockSize * sizeof(ScalarT);
+            if (bytes >= 64)
+                return _mm512_loadu_si512(p);
+            else
+                return _mm512_maskz_loadu_epi32((__mmask16) (0xFFFFu >> (bytes >= 64 ? 0 : 16 - (bytes / 4))), p);
+        }
+
+        // Loads a block of 8 as 8 int16 for the SSE path.
+        FORCEINLINE static __m128i Load8(const int16_t* p) { return _mm_loadu_si128((const __m128i*) p); }
+        FORCEINLINE static __m128i Load8(const int8_t* p) { return _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*) p)); }
+
+        // Multiplies the Rows rows of A starting at startRow with all columns of B in one block of the common dimension,
+        // and adds the results (one register per row and column, to be added horizontally) to resultStorage.
+        template <int BlockSize, int Rows> FORCEINLINE static void HandleBlock(int currBlock, int startRow, int k, int n,
+                ScalarT* newA, ScalarT* B, __m512i* resultStorage)
+        {
+            const int vectorsPerBlock = (BlockSize + ElementsPerVector - 1) / ElementsPerVector;
+            const ScalarT* currA = &newA[RowToColOffsetRewrittenA(startRow, currBlock, BlockSize, Rows, k)];
+
+            // The rows of A stay in registers while we go through the columns of B.
+            __m512i rowsA[Rows][vectorsPerBlock];
+            __m512i init[Rows];
+            for (int r = 0; r < Rows; ++r)
+            {
+                init[r] = _mm512_setzero_si512();
+                for (int v = 0; v < vectorsPerBlock; ++v)
+                {
+                    rowsA[r][v] = Load<BlockSize>(currA + (r * BlockSize) + (v * ElementsPerVector));
+                    init[r] = DotProduct::InitAccumulator(init[r], rowsA[r][v]);
+                }
+            }
+
+            for (int c = 0; c < n; ++c)
+            {
+                const ScalarT* currB = &B[RowToColOffsetRewrittenB(c, currBlock, BlockSize, n)];
+                __m512i colB[vectorsPerBlock];
+                for (int v = 0; v < vectorsPerBlock; ++v)
+                {
+                    colB[v] = DotProduct::PrepareB(Load<BlockSize>(currB + (v * ElementsPerVector)));
+                }
+
+                for (int r = 0; r < Rows; ++r)
+                {
+                    __m512i accum = init[r];
+                    for (int v = 0; v < vectorsPerBlock; ++v)
+                    {
+                        accum = DotProduct::Add(accum, rowsA[r][v], colB[v]);
+                    }
+                    resultStorage[RowColToOffset(r, c, n)] = _mm512_add_epi32(resultStorage[RowColToOffset(r, c, n)], accum);
+                }
+            }
+        }
+
+        // The same for blockCnt consecutive blocks of 128, which are all added up before the result of a column is
+        // stored, so that resultStorage is only read and written once per column. The rows of A are reloaded from
+        // the rewritten A, which stays in the L1 cache. This is faster for int16, where a row of a block of 128 takes
+        // four registers; a block of int8 takes two, and keeping all rows in registers wins (see HandleBlock128).
+        template <int Rows> FORCEINLINE static void HandleBlocks128(int currBlock, int blockCnt, int startRow, int k, int n,
+                ScalarT* newA, ScalarT* B, __m512i* resultStorage)
+        {
+            const int vectorsPerBlock = 128 / ElementsPerVector;
+            const ScalarT* firstA = &newA[RowToColOffsetRewrittenA(startRow, currBlock, 128, Rows, k)];
+            const int blockStrideA = Rows * 128;
+            const int blockStrideB = n * 128;
+
+            __m512i init[Rows];
+            for (int r = 0; r < Rows; ++r)
+            {
+                init[r] = _mm512_setzero_si512();
+                for (int i = 0; i < blockCnt; ++i)
+                {
+                    for (int v = 0; v < vectorsPerBlock; ++v)
+                    {
+                        init[r] = DotProduct::InitAccumulator(init[r], Load<128>(firstA + (i * blockStrideA) + (r * 128) + (v * ElementsPerVector)));
+                    }
+                }
+            }
+
+            for (int c = 0; c < n; ++c)
+            {
+                const ScalarT* currB = &B[RowToColOffsetRewrittenB(c, currBlock, 128, n)];
+                const ScalarT* currA = firstA;
+                __m512i accum[Rows];
+                for (int r = 0; r < Rows; ++r)
+                {
+                    accum[r] = init[r];
+                }
+
+                for (int i = 0; i < blockCnt; ++i, currA += blockStrideA, currB += blockStrideB)
+                {
+                    for (int v = 0; v < vectorsPerBlock; ++v)
+                    {
+                        __m512i colB = DotProduct::PrepareB(Load<128>(currB + (v * ElementsPerVector)));
+                        for (int r = 0; r < Rows; ++r)
+                        {
+                            accum[r] = DotProduct::Add(accum[r], Load<128>(currA + (r * 128) + (v * ElementsPerVector)), colB);
+                        }
+                    }
+                }
+
+                for (int r = 0; r < Rows; ++r)
+                {
+                    resultStorage[RowColToOffset(r, c, n)] = _mm512_add_epi32(resultStorage[RowColToOffset(r, c, n)], accum[r]);
+                }
+            }
+        }
+
+        template <int Rows> FORCEINLINE static void HandleBlock128(int currBlock, int blockCnt, int startRow, int k, int n,
+                ScalarT* newA, ScalarT* B, __m512i* resultStorage)
+        {
+            if (sizeof(ScalarT) == 1)
+            {
+                for (int i = 0; i < blockCnt; ++i)
+                {
+                    HandleBlock<128, Rows>(currBlock + i, startRow, k, n, newA, B, resultStorage);
+                }
+            }
+            else
+            {
+                HandleBlocks128<Rows>(currBlock, blockCnt, startRow, k, n, newA, B, resultStorage);
+            }
+        }
+
+        template <int Rows> FORCEINLINE static void HandleBlock8(int currBlock, int startRow, int k, int n,
+                ScalarT* newA, ScalarT* B, __m128i* resultStorage)
+        {
+            const ScalarT* currA = &newA[RowToColOffsetRewrittenA(startRow, currBlock, 8, Rows, k)];
+            __m128i rowsA[Rows];
+            for (int r = 0; r < Rows; ++r)
+            {
+                rowsA[r] = Load8(currA + (r * 8));
+            }
+
+            for (int c = 0; c < n; ++c)
+            {
+                __m128i colB = Load8(&B[RowToColOffsetRewrittenB(c, currBlock, 8, n)]);
+                for (int r = 0; r < Rows; ++r)
+                {
+                    resultStorage[RowColToOffset(r, c, n)] = _mm_add_epi32(resultStorage[RowColToOffset(r, c, n)], _mm_madd_epi16(rowsA[r], colB));
+                }
+            }
+        }
+
+    public:
+        typedef __m512i VectorT;
+        typedef ScalarT ScalarAT;
+        typedef ScalarT ScalarBT;
+        typedef int32_t ScalarCT;
+
+        FORCEINLINE static void HandleBlock8x4(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int /*blockCnt*/, __m128i* resultStorage)
+        {
+            HandleBlock8<4>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        FORCEINLINE static void HandleBlock16x4(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int /*blockCnt*/, VectorT* resultStorage)
+        {
+            HandleBlock<16, 4>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        FORCEINLINE static void HandleBlock32x4(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int /*blockCnt*/, VectorT* resultStorage)
+        {
+            HandleBlock<32, 4>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        FORCEINLINE static void HandleBlock64x4(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int /*blockCnt*/, VectorT* resultStorage)
+        {
+            HandleBlock<64, 4>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        // BlockMultiplier hands us up to two blocks of 128 at a time.
+        FORCEINLINE static void HandleBlock128x4(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int blockCnt, VectorT* resultStorage, VectorT* /*subtractMe*/)
+        {
+            HandleBlock128<4>(currBlock, blockCnt, startRow, k, n, newA, B, resultStorage);
+        }
+
+        FORCEINLINE static void HandleBlock8x1(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int /*blockCnt*/, __m128i* resultStorage)
+        {
+            HandleBlock8<1>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        FORCEINLINE static void HandleBlock16x1(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int /*blockCnt*/, VectorT* resultStorage)
+        {
+            HandleBlock<16, 1>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        FORCEINLINE static void HandleBlock32x1(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int /*blockCnt*/, VectorT* resultStorage)
+        {
+            HandleBlock<32, 1>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        FORCEINLINE static void HandleBlock64x1(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int /*blockCnt*/, VectorT* resultStorage)
+        {
+            HandleBlock<64, 1>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        FORCEINLINE static void HandleBlock128x1(int currBlock, int startRow, int k, int n, ScalarAT* newA, ScalarBT* B,
+                int blockCnt, VectorT* resultStorage, VectorT* /*subtractMe*/)
+        {
+            HandleBlock128<1>(currBlock, blockCnt, startRow, k, n, newA, B, resultStorage);
+        }
+
+        static VectorT* PrepareExtraB(const ScalarBT* /*prepareMe*/, int /*k*/, int /*n*/)
+        {
+            return nullptr;
+        }
+        static void FreePreparedB(VectorT* freeMe) { freeMe; assert(nullptr == freeMe); }
+};
+
+typedef BlockHandlerAVX512T<int16_t, false> BlockHandlerAVX512;
+typedef BlockHandlerAVX512T<int16_t, true>  BlockHandlerAVX512VNNI;
+typedef BlockHandlerAVX512T<int8_t, true>   BlockHandlerAVX512VNNI8;
+
+}}}
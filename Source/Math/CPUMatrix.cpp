@@ -11,6 +11,14 @@
 
 #include "CPUMatrix.h"
 #include "TensorOps.h"
+#include "ImageAugmentation.h"
+#include "LearningToRank.h"
+#include "LinearChainCRF.h"
+#include "GaussianMixture.h"
+#include "CosineWithNegativeSamples.h"
+#include "NarrowElementTypes.h"
+#include "CPUVectorKernels.h"
+#include "RNNCommon.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -78,6 +86,18 @@ bool TracingGPUMemoryAllocator::IsTraceEnabled()
     return (m_traceLevel > 0);
 }
 
+bool MATH_API TracingGPUMemoryAllocator::m_cachingEnabled = false;
+
+void TracingGPUMemoryAllocator::SetCachingEnabled(bool enabled)
+{
+    m_cachingEnabled = enabled;
+}
+
+bool TracingGPUMemoryAllocator::IsCachingEnabled()
+{
+    return m_cachingEnabled;
+}
+
 #pragma region Helpful Enum Definitions
 enum class MatrixOrder
 {
@@ -882,8 +902,9 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     // if it's externally managed, then populate the structure
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
-        // free previous array allocation if any before overwriting
-        delete[] Buffer();
+        // free previous array allocation if any before overwriting (not if it is an external buffer itself, e.g. when rebinding)
+        if (OwnBuffer())
+            delete[] Buffer();
 
         m_numRows = numRows;
         m_numCols = numCols;
@@ -1128,6 +1149,97 @@ void CPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
     }
 }
 
+// Unlike SetUniformRandomMask(), the mask elements are independent of each other, so this runs in parallel.
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::Dropout(const ElemType beta, const CPUMatrix<ElemType>& a, const ElemType dropoutRate, const uint64_t seed, const uint64_t offset, CPUMatrix<ElemType>& c)
+{
+    assert(a.GetNumElements() == c.GetNumElements());
+    const ElemType scale = 1 / (1 - dropoutRate);
+    const ElemType* pa = a.Data();
+    ElemType* pc = c.Data();
+    long n = (long) a.GetNumElements();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+    {
+        ElemType value = pa[i] * DropoutMaskElement(dropoutRate, scale, seed, offset + i);
+        pc[i] = beta == 0 ? value : beta * pc[i] + value;
+    }
+}
+
+// Element i only depends on (seed, i), so this runs in parallel and gives the bits of GPUMatrix::SetCounterBasedUniformRandomValue().
+template <class ElemType>
+void CPUMatrix<ElemType>::SetCounterBasedUniformRandomValue(const ElemType low, const ElemType high, const uint64_t seed)
+{
+    ElemType* data = Data();
+    long n = (long) GetNumElements();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+        data[i] = CounterBasedUniformElement(low, high, seed, (uint64_t) i);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::SetCounterBasedGaussianRandomValue(const ElemType mean, const ElemType sigma, const uint64_t seed)
+{
+    ElemType* data = Data();
+    long n = (long) GetNumElements();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+        data[i] = CounterBasedGaussianElement(mean, sigma, seed, (uint64_t) i);
+}
+
+// The prefix sums are accumulated in double precision and rounded once each, as on the GPU.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignWeightedRandomSamplesWithReplacement(const CPUMatrix<ElemType>& weights, size_t numSamples, const uint64_t seed, const uint64_t offset, CPUMatrix<ElemType>& prefixSums)
+{
+    size_t numClasses = weights.GetNumElements();
+    prefixSums.RequireSize(numClasses, 1);
+    double sum = 0;
+    for (size_t i = 0; i < numClasses; i++)
+    {
+        sum += weights.Data()[i];
+        prefixSums.Data()[i] = (ElemType) sum;
+    }
+
+    RequireSize(numSamples, 1);
+#pragma omp parallel for
+    for (long i = 0; i < (long) numSamples; i++)
+        Data()[i] = (ElemType) WeightedSampleClass(prefixSums.Data(), numClasses, WeightedSampleUnitValue(seed, offset + i));
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignWeightedSampleKeys(const CPUMatrix<ElemType>& weights, const uint64_t seed, const uint64_t offset)
+{
+    long numClasses = (long) weights.GetNumElements();
+    RequireSize(numClasses, 1);
+#pragma omp parallel for
+    for (long i = 0; i < numClasses; i++)
+        Data()[i] = WeightedSampleKey(weights.Data()[i], seed, offset + i);
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignWeightedSampleInclusionFrequencies(const CPUMatrix<ElemType>& weights, size_t numSamples, bool allowDuplicates, const CPUMatrix<ElemType>& samples)
+{
+    long numClasses = (long) weights.GetNumElements();
+    double total = 0;
+    for (long i = 0; i < numClasses; i++)
+        total += weights.Data()[i];
+    double numTries = 0;
+    if (!allowDuplicates)
+    {
+        for (size_t j = 0; j < samples.GetNumCols(); j++)
+            numTries += WeightedSampleNumTries(weights.Data(), total, samples.Data() + j * numSamples, numSamples);
+        numTries /= samples.GetNumCols();
+    }
+
+    RequireSize(numClasses, 1);
+#pragma omp parallel for
+    for (long i = 0; i < numClasses; i++)
+        Data()[i] = WeightedSampleInclusionFrequency(weights.Data()[i], total, numSamples, allowDuplicates, numTries);
+    return *this;
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1243,6 +1355,37 @@ void CPUMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients,
     }
 }
 
+// Adam, with the second and first moments stored side by side as in FSAdagrad(), see Matrix::AdamUpdate()
+template <class ElemType>
+void CPUMatrix<ElemType>::Adam(CPUMatrix<ElemType>& gradients,
+                               CPUMatrix<ElemType>& functionValues,
+                               ElemType learnRatePerSample,
+                               ElemType momentum,
+                               ElemType adaWeight,
+                               ElemType biasCorrection,
+                               ElemType epsilon,
+                               ElemType decay)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        RequireSize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+
+    size_t n = gradients.GetNumElements();
+    ElemType* grad = gradients.Data();
+    ElemType* smoothAda = Data();
+    ElemType* smoothMom = Data() + n;
+    ElemType* val = functionValues.Data();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+        AdamUpdateElement(val[i], smoothAda[i], smoothMom[i], grad[i], learnRatePerSample, momentum, adaWeight, biasCorrection, epsilon, decay);
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
                                       ElemType RMS_GAMMA,
@@ -1339,6 +1482,69 @@ ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
         return 1;
 }
 
+// elements per chunk of a multi-tensor operation, the unit of work of one OpenMP iteration
+static const size_t c_multiTensorChunkSize = 16384;
+
+// Fused update of many parameter tensors: one parallel loop over chunks of all tensors, instead of
+// several parallel loops per tensor as in NormalGrad(), Adagrad(), FSAdagrad(), and RmsProp().
+// AdaGrad and RmsProp need the average multiplier of each tensor before they can update its value,
+// and Lamb the norm of its step, so they take a second loop. The state of each item must have been allocated (see MultiTensorUpdateStateSize()).
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::MultiTensorUpdate(std::vector<MultiTensorUpdateItem<ElemType>>& items, const MultiTensorUpdateParams<ElemType>& params)
+{
+    std::vector<size_t> sizes;
+    for (const auto& item : items)
+        sizes.push_back(item.n);
+    auto chunks = GetMultiTensorChunks(sizes, c_multiTensorChunkSize);
+
+    std::vector<double> chunkSums(chunks.size(), 0);
+#pragma omp parallel for
+    for (long c = 0; c < (long) chunks.size(); c++)
+    {
+        const auto& chunk = chunks[c];
+        const auto& item = items[chunk.item];
+        double multiplierSum = 0;
+        for (size_t i = chunk.begin; i < chunk.end; i++)
+            multiplierSum += MultiTensorUpdateElement(params, item, i);
+        chunkSums[c] = multiplierSum;
+    }
+
+    if (!MultiTensorUpdateHasSecondPass(params.rule))
+        return;
+
+    auto learnRates = GetMultiTensorLearnRates(items, params, chunks, chunkSums);
+#pragma omp parallel for
+    for (long c = 0; c < (long) chunks.size(); c++)
+    {
+        const auto& chunk = chunks[c];
+        for (size_t i = chunk.begin; i < chunk.end; i++)
+            MultiTensorApplyElement(items[chunk.item], learnRates[chunk.item], i);
+    }
+}
+
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::MultiTensorSumOfSquares(const std::vector<const ElemType*>& data, const std::vector<size_t>& sizes, std::vector<double>& sumsOfSquares)
+{
+    assert(data.size() == sizes.size());
+    auto chunks = GetMultiTensorChunks(sizes, c_multiTensorChunkSize);
+
+    std::vector<double> chunkSums(chunks.size(), 0);
+#pragma omp parallel for
+    for (long c = 0; c < (long) chunks.size(); c++)
+    {
+        const auto& chunk = chunks[c];
+        const ElemType* p = data[chunk.item];
+        double sum = 0;
+        for (size_t i = chunk.begin; i < chunk.end; i++)
+            sum += (double) p[i] * p[i];
+        chunkSums[c] = sum;
+    }
+
+    sumsOfSquares.assign(data.size(), 0);
+    for (size_t c = 0; c < chunks.size(); c++)
+        sumsOfSquares[chunks[c].item] += chunkSums[c];
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1369,11 +1575,12 @@ void CPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, boo
     if (GetNumRows() == numRows && GetNumCols() == numCols)
         return;
 
-    VerifyResizable(__func__);
-
     size_t numElements = numRows * numCols;
-    if (numElements > GetSizeAllocated() ||                 // grow allocation
-        (!growOnly && (numElements != GetSizeAllocated()))) // shrink allocation (not if 'growOnly')
+    VerifyResizable(__func__, numElements);
+
+    if (OwnBuffer() &&
+        (numElements > GetSizeAllocated() ||                  // grow allocation
+         (!growOnly && (numElements != GetSizeAllocated())))) // shrink allocation (not if 'growOnly')
     {
         // reallocate buffer
         ElemType* pArray = nullptr;
@@ -2280,6 +2487,63 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSoftmaxOf(const CPUMatrix<Ele
     return *this;
 }
 
+// number of rows of which the maximum is taken at once in AssignSoftmaxCrossEntropyOf(); a chunk stays in cache for the second read
+static const long softmaxCrossEntropyChunkRows = 4096;
+
+// The log-sum-exp of a column is accumulated chunk by chunk: the sum so far is rescaled whenever a chunk raises the running maximum.
+// That way each column is swept once no matter how large the vocabulary, and no softmax matrix is needed.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSoftmaxCrossEntropyOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp)
+{
+    if (logits.IsEmpty())
+        LogicError("AssignSoftmaxCrossEntropyOf: Matrix logits is empty.");
+    if (labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols())
+        InvalidArgument("AssignSoftmaxCrossEntropyOf: labels and logits must have the same dimensions.");
+
+    const long m = (long) logits.GetNumRows();
+    const long n = (long) logits.GetNumCols();
+    RequireSize(1, n);
+    logSumExp.RequireSize(1, n);
+
+    const ElemType* z0 = logits.Data();
+    const ElemType* y0 = labels.Data();
+    ElemType* loss = Data();
+    ElemType* lse = logSumExp.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* z = z0 + j * m;
+        const ElemType* y = y0 + j * m;
+        ElemType maxV = z[0];
+        ElemType sum = 0;
+        ElemType sumY = 0;
+        ElemType sumYZ = 0;
+        for (long begin = 0; begin < m; begin += softmaxCrossEntropyChunkRows)
+        {
+            const long end = std::min(begin + softmaxCrossEntropyChunkRows, m);
+            ElemType chunkMax = z[begin];
+            for (long i = begin + 1; i < end; i++)
+                chunkMax = std::max(chunkMax, z[i]);
+            if (chunkMax > maxV)
+            {
+                sum *= exp(maxV - chunkMax);
+                maxV = chunkMax;
+            }
+            for (long i = begin; i < end; i++)
+            {
+                sum += exp(z[i] - maxV);
+                sumY += y[i];
+                sumYZ += y[i] * z[i];
+            }
+        }
+        lse[j] = maxV + log(sum);
+        loss[j] = lse[j] * sumY - sumYZ;
+    }
+
+    return *this;
+}
+
 //[this]=hardmax([this])
 //the max element is 1 else is 0
 template <class ElemType>
@@ -2829,6 +3093,20 @@ ElemType CPUMatrix<ElemType>::SumOfAbsElements() const
     }
 }
 
+// x - x is 0 unless x is NaN or Inf
+template <class ElemType>
+void CPUMatrix<ElemType>::FlagNonFiniteValues(CPUMatrix<ElemType>& flag) const
+{
+    const ElemType* data = Data();
+    long n = (long) GetNumElements();
+    bool hasNonFiniteValues = false;
+#pragma omp parallel for reduction(|| : hasNonFiniteValues)
+    for (long i = 0; i < n; i++)
+        hasNonFiniteValues = hasNonFiniteValues || !(data[i] - data[i] == 0);
+    if (hasNonFiniteValues)
+        flag.Data()[0] = 1;
+}
+
 //sum of all elements
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::SumOfElements() const
@@ -2889,6 +3167,9 @@ void CPUMatrix<ElemType>::VectorSum(const CPUMatrix<ElemType>& a, CPUMatrix<Elem
     {
         c.RequireSize(1, n);
 
+        if (CPUVectorKernels<ElemType>::ReduceContiguous(ElementWiseOperator::opSum, ElementWiseOperator::opCopy, 0, a.Data(), 1, c.Data(), m, n, m, 1))
+            return;
+
 #pragma omp parallel for
         foreach_column (j, a)
         {
@@ -2905,6 +3186,9 @@ void CPUMatrix<ElemType>::VectorSum(const CPUMatrix<ElemType>& a, CPUMatrix<Elem
     {
         c.RequireSize(m, 1);
 
+        if (CPUVectorKernels<ElemType>::ReduceStrided(ElementWiseOperator::opSum, ElementWiseOperator::opCopy, 0, a.Data(), 1, c.Data(), m, n, m))
+            return;
+
 #pragma omp parallel for
         foreach_row (i, a)
         {
@@ -2936,6 +3220,9 @@ void CPUMatrix<ElemType>::VectorNorm1(CPUMatrix<ElemType>& c, const bool isColWi
     {
         c.RequireSize(1, n);
 
+        if (CPUVectorKernels<ElemType>::ReduceContiguous(ElementWiseOperator::opSum, ElementWiseOperator::opAbs, 0, us.Data(), 1, c.Data(), m, n, m, 1))
+            return;
+
 #pragma omp parallel for
         foreach_column (j, us)
         {
@@ -2952,6 +3239,9 @@ void CPUMatrix<ElemType>::VectorNorm1(CPUMatrix<ElemType>& c, const bool isColWi
     {
         c.RequireSize(m, 1);
 
+        if (CPUVectorKernels<ElemType>::ReduceStrided(ElementWiseOperator::opSum, ElementWiseOperator::opAbs, 0, us.Data(), 1, c.Data(), m, n, m))
+            return;
+
 #pragma omp parallel for
         foreach_row (i, us)
         {
@@ -3422,12 +3712,12 @@ void CPUMatrix<ElemType>::VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<E
             ElemType* curMax       =  maxValues.Data();
             for (int icol = 0; icol < n; icol++, curVal += m, curIdx += topK, curMax += topK)
             {
-                // Partial sort, descending order.
-                std::nth_element(indices.begin(), indices.begin() + topK, indices.end(),
-                                 [curVal](const int& a, const int& b)
-                                 {
-                                     return curVal[a] > curVal[b];
-                                 });
+                // Partial sort, descending order, ties by row (as the GPU implementation).
+                std::partial_sort(indices.begin(), indices.begin() + topK, indices.end(),
+                                  [curVal](const int& a, const int& b)
+                                  {
+                                      return curVal[a] > curVal[b] || (curVal[a] == curVal[b] && a < b);
+                                  });
                 // REVIEW alexeyk: the following produces warning (see SCL_SECURE_NO_WARNINGS) so use loop instead.
                 // std::transform(indices.begin(), indices.begin() + topK, curIdx, [](const int& a) { return static_cast<ElemType>(a); });
                 for (int i2 = 0; i2 < topK; i2++)
@@ -4347,7 +4637,8 @@ void CPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
                     {
                         // [W x H x C x R x N]; R = ROIs per image
                         size_t outputIdx = roiIdx * roiOutputSize + outw + outh * pooledWidth + c * pooledHeight * pooledWidth;
-                        size_t maxidx = 0;
+                        // an empty window is zero and has no argmax
+                        int maxidx = -1;
                         ElemType maxval = isempty ? (ElemType)0 : -FLT_MAX;
                         size_t baseIdx = c * height * width;
 
@@ -4356,7 +4647,7 @@ void CPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
                             for (size_t w = wstart; w < wend; w++)
                             {
                                 // stored argmax indices are relative to the current channel.
-                                size_t dataIdx = w + h * width;
+                                int dataIdx = (int)(w + h * width);
                                 if (img(baseIdx + dataIdx, 0) > maxval)
                                 {
                                     maxval = img(baseIdx + dataIdx, 0);
@@ -4365,7 +4656,7 @@ void CPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
                             }
                         }
                         output(outputIdx, imgIdx) = maxval;
-                        argmax(outputIdx, imgIdx) = maxidx;
+                        argmax(outputIdx, imgIdx) = (ElemType)maxidx;
                     }
                 }
             }
@@ -4373,83 +4664,161 @@ void CPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
     }
 }
 
-// This function loops over locations in the input to the ROIPoolingNode (image locations).
-// It loops over the ROIs corresponding to that image, seeing which ones could contain the current location
-// in their output. For each ROI, it checks the argmax data to see if that ROI indeed chose
-// this pixel location as the maximum. If so, it increments the gradient term for the input location.
+// This function scatters the gradient of each pooled location to the input location that was chosen as its
+// maximum, adding it to the gradient of the images. One image location could be in multiple ROIs; each
+// of them contributes its gradient term. The images are processed channel by channel in parallel, such that
+// no two threads update the same location and the sums do not depend on the scheduling.
 template <class ElemType>
 void CPUMatrix<ElemType>::ROIPoolingBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
-                                             const size_t pooledWidth, const size_t pooledHeight, const CPUMatrix<ElemType>& roiData, CPUMatrix<ElemType>& grad, 
+                                             const size_t pooledWidth, const size_t pooledHeight, const CPUMatrix<ElemType>& /*roiData*/, CPUMatrix<ElemType>& grad,
                                              CPUMatrix<ElemType>& argmax) const
 {
-    // loop over images in the batch.
+    const size_t pooledSize = pooledWidth * pooledHeight;
+
 #pragma omp parallel for
-    for (int imgIdx = 0; imgIdx < numImg; imgIdx++) 
+    for (int64_t plane = 0; plane < (int64_t)(numImg * channels); plane++)
     {
-        // ROIs for this image. length 4*numRois;
-        auto rois = roiData.ColumnSlice(imgIdx, 1).Data();
+        size_t imgIdx = plane / channels;
+        size_t c = plane % channels;
         // gradient values for all ROIs from this image. length numRois*pooledHeight*pooledWidth*channels;
-        auto pooledGrad = ColumnSlice(imgIdx, 1).Data();
-        auto argmaxCol = argmax.ColumnSlice(imgIdx, 1).Data();
+        const ElemType* pooledGrad = Data() + imgIdx * GetNumRows();
+        const ElemType* argmaxCol = argmax.Data() + imgIdx * argmax.GetNumRows();
+        // [W x H x C x N]
+        ElemType* gradPlane = grad.Data() + imgIdx * grad.GetNumRows() + c * width * height;
 
-        // loop over spatial locations in the image.
-#pragma omp parallel for
-        for (int w = 0; w < width; w++) 
+        for (size_t roiN = 0; roiN < numRois; roiN++)
+        {
+            // go right up to channel c of the current ROI.
+            size_t offset = (roiN * channels + c) * pooledSize;
+            for (size_t i = offset; i < offset + pooledSize; i++)
+            {
+                int maxidx = (int)argmaxCol[i];
+                if (maxidx >= 0)
+                    gradPlane[maxidx] += pooledGrad[i];
+            }
+        }
+    }
+}
+
+// ROIAlign pools the same ROIs as ROIPooling, without rounding them to the pixel grid: each of the
+// pooledWidth x pooledHeight bins of an ROI averages the input, bilinearly interpolated at a regular grid of
+// samplingRatio x samplingRatio points in the bin (or, if samplingRatio is 0, of as many points as the bin
+// spans pixels). Pixel (w, h) covers [w, w+1) x [h, h+1) of the ROI coordinates scaled to the image size.
+// This function returns the input locations and weights that make up one bin of an ROI.
+template <class ElemType>
+static void ROIAlignBinTaps(const ElemType* roi, const size_t width, const size_t height, const size_t pooledWidth, const size_t pooledHeight,
+                            const size_t samplingRatio, const size_t pw, const size_t ph, vector<pair<size_t, ElemType>>& taps)
+{
+    // roi data is relative to original image size
+    ElemType roiStartW = roi[0] * width;
+    ElemType roiStartH = roi[1] * height;
+    ElemType binW = max(roi[2] * width,  (ElemType)1) / (ElemType)pooledWidth;
+    ElemType binH = max(roi[3] * height, (ElemType)1) / (ElemType)pooledHeight;
+    size_t gridW = samplingRatio > 0 ? samplingRatio : max((size_t)ceil(binW), (size_t)1);
+    size_t gridH = samplingRatio > 0 ? samplingRatio : max((size_t)ceil(binH), (size_t)1);
+    ElemType scale = (ElemType)1 / (ElemType)(gridW * gridH);
+
+    taps.clear();
+    for (size_t iy = 0; iy < gridH; iy++)
+    {
+        // sample positions relative to the pixel centers
+        ElemType y = roiStartH + ph * binH + (iy + (ElemType)0.5) * binH / gridH - (ElemType)0.5;
+        for (size_t ix = 0; ix < gridW; ix++)
         {
+            ElemType x = roiStartW + pw * binW + (ix + (ElemType)0.5) * binW / gridW - (ElemType)0.5;
+
+            // samples more than a pixel outside of the image are zero
+            if (y < -1 || y > (ElemType)height || x < -1 || x > (ElemType)width)
+                continue;
+
+            ElemType yy = max(y, (ElemType)0);
+            ElemType xx = max(x, (ElemType)0);
+            size_t yLow = min((size_t)yy, height - 1);
+            size_t xLow = min((size_t)xx, width - 1);
+            size_t yHigh = min(yLow + 1, height - 1);
+            size_t xHigh = min(xLow + 1, width - 1);
+            ElemType ly = yLow < height - 1 ? yy - yLow : 0;
+            ElemType lx = xLow < width - 1 ? xx - xLow : 0;
+
+            taps.push_back(make_pair(xLow  + yLow  * width, (1 - ly) * (1 - lx) * scale));
+            taps.push_back(make_pair(xHigh + yLow  * width, (1 - ly) * lx * scale));
+            taps.push_back(make_pair(xLow  + yHigh * width, ly * (1 - lx) * scale));
+            taps.push_back(make_pair(xHigh + yHigh * width, ly * lx * scale));
+        }
+    }
+}
+
+// src: Images              [W x H x C x N]
+// roiData: ROIs            [4 x numROIs x N],
+// dst: Pooled ROIs         [PW x PH x C x numROIs x N]
+template <class ElemType>
+void CPUMatrix<ElemType>::ROIAlignForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                                          const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const CPUMatrix<ElemType>& roiData,
+                                          CPUMatrix<ElemType>& output) const
+{
+    const size_t pooledSize = pooledWidth * pooledHeight;
+
 #pragma omp parallel for
-            for (int h = 0; h < width; h++) 
+    for (int64_t roiN = 0; roiN < (int64_t)(numImg * numRois); roiN++)
+    {
+        size_t imgIdx = roiN / numRois;
+        const ElemType* img = Data() + imgIdx * GetNumRows();
+        // each ROI is 4 elements: (x, y, w, h).
+        const ElemType* roi = roiData.Data() + imgIdx * roiData.GetNumRows() + (roiN % numRois) * 4;
+        ElemType* dst = output.Data() + imgIdx * output.GetNumRows() + (roiN % numRois) * pooledSize * channels;
+
+        // the taps of a bin are the same for all channels
+        vector<pair<size_t, ElemType>> taps;
+        for (size_t ph = 0; ph < pooledHeight; ph++)
+        {
+            for (size_t pw = 0; pw < pooledWidth; pw++)
             {
-                // loop over the ROIs seeing which ones contain this location.
-                for (int roiN = 0; roiN < numRois; roiN++) 
+                ROIAlignBinTaps(roi, width, height, pooledWidth, pooledHeight, samplingRatio, pw, ph, taps);
+                for (size_t c = 0; c < channels; c++)
                 {
-                    // each ROI is 4 elements: (x, y, w, h).
-                    int roiOffset = roiN * 4;
-
-                    // ROI data is relative to original image size
-                    size_t roiStartW =     (size_t)round(rois[roiOffset + 0] * width);
-                    size_t roiStartH =     (size_t)round(rois[roiOffset + 1] * height);
-                    size_t roiWidth  = max((size_t)round(rois[roiOffset + 2] * width),  (size_t)1);
-                    size_t roiHeight = max((size_t)round(rois[roiOffset + 3] * height), (size_t)1);
-
-                    // skip this ROI if it doesn't contain the current input location.
-                    const bool inROI = (w >= roiStartW && w < roiStartW + roiWidth &&
-                                        h >= roiStartH && h < roiStartH + roiHeight);
-                    if (!inROI)
-                        continue;
-
-                    ElemType winH = (ElemType)roiHeight / (ElemType)pooledHeight;
-                    ElemType winW = (ElemType)roiWidth  / (ElemType)pooledWidth;
+                    const ElemType* srcPlane = img + c * width * height;
+                    ElemType value = 0;
+                    for (const auto& tap : taps)
+                        value += tap.second * srcPlane[tap.first];
+                    dst[c * pooledSize + ph * pooledWidth + pw] = value;
+                }
+            }
+        }
+    }
+}
 
-                    // what pooled nodes in the output for this ROI could have pooled this input location?
-                    size_t phstart = (size_t)((h - roiStartH) / winH);
-                    size_t pwstart = (size_t)((w - roiStartW) / winW);
-                    size_t phend   = (size_t)(ceil((h - roiStartH + 1) / winH));
-                    size_t pwend   = (size_t)(ceil((w - roiStartW + 1) / winW));
+// This function adds the gradient of each bin to the input locations it was interpolated from, with their weights.
+// As in ROIPoolingBackward, the images are processed channel by channel in parallel.
+template <class ElemType>
+void CPUMatrix<ElemType>::ROIAlignBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                                           const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const CPUMatrix<ElemType>& roiData,
+                                           CPUMatrix<ElemType>& grad) const
+{
+    const size_t pooledSize = pooledWidth * pooledHeight;
 
-                    phstart = min(max(phstart, (size_t)0), pooledHeight);
-                    phend   = min(max(phend,   (size_t)0), pooledHeight);
-                    pwstart = min(max(pwstart, (size_t)0), pooledWidth);
-                    pwend   = min(max(pwend,   (size_t)0), pooledWidth);
+#pragma omp parallel for
+    for (int64_t plane = 0; plane < (int64_t)(numImg * channels); plane++)
+    {
+        size_t imgIdx = plane / channels;
+        size_t c = plane % channels;
+        const ElemType* rois = roiData.Data() + imgIdx * roiData.GetNumRows();
+        const ElemType* pooledGrad = Data() + imgIdx * GetNumRows();
+        ElemType* gradPlane = grad.Data() + imgIdx * grad.GetNumRows() + c * width * height;
 
-                    for (size_t c = 0; c < channels; c++) 
-                    {
-                        ElemType gradient = 0;
-                        // [W x H x C x N]
-                        size_t index = w + h*width + c*height*width;
-                        // go right up to channel c of the current ROI.
-                        size_t offset = (roiN * channels + c) * pooledWidth * pooledHeight;
-                        const ElemType* offsetPoolGrad = pooledGrad + offset;
-                        const ElemType* offsetArgmax = argmaxCol + offset;
-                        for (size_t ph = phstart; ph < phend; ph++)
-                        {
-                            for (size_t pw = pwstart; pw < pwend; pw++)
-                            {
-                                if ((size_t)offsetArgmax[ph * pooledWidth + pw] == (w + h * width))
-                                    gradient += offsetPoolGrad[ph * pooledWidth + pw];
-                            }
-                        }
-                        grad(index, imgIdx) = gradient;
-                    }
+        vector<pair<size_t, ElemType>> taps;
+        for (size_t roiN = 0; roiN < numRois; roiN++)
+        {
+            const ElemType* binGrad = pooledGrad + (roiN * channels + c) * pooledSize;
+            for (size_t ph = 0; ph < pooledHeight; ph++)
+            {
+                for (size_t pw = 0; pw < pooledWidth; pw++)
+                {
+                    ElemType g = binGrad[ph * pooledWidth + pw];
+                    if (g == 0)
+                        continue;
+                    ROIAlignBinTaps(rois + roiN * 4, width, height, pooledWidth, pooledHeight, samplingRatio, pw, ph, taps);
+                    for (const auto& tap : taps)
+                        gradPlane[tap.first] += tap.second * g;
                 }
             }
         }
@@ -4558,7 +4927,7 @@ void CPUMatrix<ElemType>::AveragePoolingBackward(const CPUMatrix<int>& mpRowCol,
 template <class ElemType>
 void CPUMatrix<ElemType>::BatchNormalizationForward(const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& bias, bool inferenceOnly, double expAvgFactor, double blendFactor,
                                                     CPUMatrix<ElemType>& runMean, CPUMatrix<ElemType>& runVariance, CPUMatrix<ElemType>& out, double epsilon,
-                                                    CPUMatrix<ElemType>& saveMean, CPUMatrix<ElemType>& saveInvStdDev) const
+                                                    CPUMatrix<ElemType>& saveMean, CPUMatrix<ElemType>& saveInvStdDev, bool reluOutput) const
 {
     assert((GetNumRows() % scale.GetNumRows()) == 0);
 
@@ -4580,6 +4949,8 @@ void CPUMatrix<ElemType>::BatchNormalizationForward(const CPUMatrix<ElemType>& s
                 size_t imap = irow / spatialSize;
                 ElemType stdDev = sqrt(runVariance(imap, 0) + epsilon);
                 out(irow, icol) = scale(imap, 0) * ((*this)(irow, icol) - runMean(imap, 0)) / stdDev + bias(imap, 0);
+                if (reluOutput && out(irow, icol) < 0)
+                    out(irow, icol) = 0;
             }
         }
     }
@@ -4592,6 +4963,8 @@ void CPUMatrix<ElemType>::BatchNormalizationForward(const CPUMatrix<ElemType>& s
             {
                 ElemType stdDev = sqrt(runVariance(irow, 0) + epsilon);
                 out(irow, icol) = scale(irow, 0) * ((*this)(irow, icol) - runMean(irow, 0)) / stdDev + bias(irow, 0);
+                if (reluOutput && out(irow, icol) < 0)
+                    out(irow, icol) = 0;
             }
         }
     }
@@ -4606,6 +4979,180 @@ void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>&
     RuntimeError("Batch normalization training on CPU is not yet implemented.");
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchNormalizationScaleAndBiasGradients(const CPUMatrix<ElemType>& in, const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
+                                                                  CPUMatrix<ElemType>& scaleGrad, CPUMatrix<ElemType>& biasGrad) const
+{
+    UNUSED(in); UNUSED(saveMean); UNUSED(saveInvStdDev); UNUSED(scaleGrad); UNUSED(biasGrad);
+    RuntimeError("Batch normalization training on CPU is not yet implemented.");
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchNormalizationInputGradient(const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& grad, const CPUMatrix<ElemType>& scale, double mbStatsWeight,
+                                                          const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
+                                                          const CPUMatrix<ElemType>& scaleGrad, const CPUMatrix<ElemType>& biasGrad) const
+{
+    UNUSED(in); UNUSED(grad); UNUSED(scale); UNUSED(mbStatsWeight); UNUSED(saveMean); UNUSED(saveInvStdDev); UNUSED(scaleGrad); UNUSED(biasGrad);
+    RuntimeError("Batch normalization training on CPU is not yet implemented.");
+}
+
+// zeroes the gradient where the normalized input, as computed with the saved statistics, is not positive
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchNormalizationReluBackward(const CPUMatrix<ElemType>& in, const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& bias,
+                                                         const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev)
+{
+    assert((GetNumRows() % scale.GetNumRows()) == 0);
+    size_t spatialSize = GetNumRows() / scale.GetNumRows();
+#pragma omp parallel for
+    for (long icol = 0; icol < GetNumCols(); icol++)
+    {
+        for (long irow = 0; irow < GetNumRows(); irow++)
+        {
+            size_t imap = irow / spatialSize;
+            ElemType normalized = scale(imap, 0) * (in(irow, icol) - saveMean(imap, 0)) * saveInvStdDev(imap, 0) + bias(imap, 0);
+            if (normalized <= 0)
+                (*this)(irow, icol) = 0;
+        }
+    }
+}
+
+// The parameters of OptimizedRNNStack are laid out as cuDNN's canonical filter (CuDnnFilter): for each layer and, within
+// that, each direction, first the input weights W of all gates, then the recurrent weights R of all gates, then the biases
+// of W, then those of R. Each weight matrix is stored row-major [hiddenSize x inputDim], so that the weights of one
+// layer and direction form a column-major [inputDim x numGates * hiddenSize] matrix whose transpose maps the input to
+// the pre-activations of all gates at once. The gates are ordered as in cuDNN: LSTM i, f, c~, o; GRU r, z, h~.
+// The sequences are in cuDNN packing: frame t holds numSequencesForFrame[t] columns, sorted by decreasing sequence
+// length, so that the sequences active at any time step are a prefix of the columns.
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim,
+                                     const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes)
+{
+    const size_t hiddenSize = rnnAttributes.m_hiddenSize;
+    const size_t numDirections = rnnAttributes.m_bidirectional ? 2 : 1;
+    const bool isLSTM = rnnAttributes.m_recurrentOp == L"lstm";
+    const bool isGRU = rnnAttributes.m_recurrentOp == L"gru";
+    const bool isReLU = rnnAttributes.m_recurrentOp == L"rnnReLU";
+    const size_t numGates = isLSTM ? 4 : isGRU ? 3 : 1;
+    const size_t gateRows = numGates * hiddenSize;
+
+    if (yDim != numDirections * hiddenSize)
+        InvalidArgument("RNNForward: Output dimension %d does not match the hidden size %d of %d direction(s).", (int) yDim, (int) hiddenSize, (int) numDirections);
+    if (inputX.GetNumRows() != xDim)
+        InvalidArgument("RNNForward: Input has %d rows, expected %d.", (int) inputX.GetNumRows(), (int) xDim);
+    auto numParameters = rnnAttributes.GetNumParameters(xDim);
+    if (paramW.GetNumElements() != numParameters.first * numParameters.second)
+        InvalidArgument("RNNForward: Expected %d parameters, but got %d.", (int) (numParameters.first * numParameters.second), (int) paramW.GetNumElements());
+
+    // column offsets of the frames
+    vector<size_t> frameStart(numSequencesForFrame.size() + 1, 0);
+    for (size_t t = 0; t < numSequencesForFrame.size(); t++)
+    {
+        if (t > 0 && numSequencesForFrame[t] > numSequencesForFrame[t - 1])
+            LogicError("RNNForward: Sequences must be sorted by decreasing length.");
+        frameStart[t + 1] = frameStart[t] + numSequencesForFrame[t];
+    }
+    const size_t numFrames = numSequencesForFrame.size();
+    const size_t numCols = frameStart.back();
+    const size_t maxSequences = numFrames > 0 ? numSequencesForFrame[0] : 0;
+    if (inputX.GetNumCols() != numCols)
+        InvalidArgument("RNNForward: Input has %d columns, but the sequences have %d frames.", (int) inputX.GetNumCols(), (int) numCols);
+
+    RequireSize(yDim, numCols);
+    if (numCols == 0)
+        return;
+
+    CPUMatrix<ElemType> inputProjection(gateRows, numCols); // W x for all frames of the sequences, one GEMM per layer and direction
+    CPUMatrix<ElemType> recurrentProjection(gateRows, maxSequences);
+    CPUMatrix<ElemType> h(hiddenSize, maxSequences);
+    CPUMatrix<ElemType> c(isLSTM ? hiddenSize : 0, isLSTM ? maxSequences : 0);
+    vector<ElemType> bias(gateRows);
+    CPUMatrix<ElemType> layerOutputs[2]; // intermediate layers alternate between these
+
+    ElemType* params = paramW.Data();
+    const CPUMatrix<ElemType>* layerInput = &inputX;
+    size_t inputDim = xDim;
+    for (size_t layer = 0; layer < rnnAttributes.m_numLayers; layer++)
+    {
+        CPUMatrix<ElemType>& layerOutput = layer + 1 == rnnAttributes.m_numLayers ? *this : layerOutputs[layer % 2];
+        layerOutput.RequireSize(yDim, numCols);
+        for (size_t direction = 0; direction < numDirections; direction++)
+        {
+            CPUMatrix<ElemType> w(inputDim, gateRows, params, matrixFlagDontOwnBuffer);
+            params += inputDim * gateRows;
+            CPUMatrix<ElemType> r(hiddenSize, gateRows, params, matrixFlagDontOwnBuffer);
+            params += hiddenSize * gateRows;
+            const ElemType* biasW = params;
+            params += gateRows;
+            const ElemType* biasR = params;
+            params += gateRows;
+            // the two biases are summed, except for the recurrent bias of the GRU candidate, which is scaled by the reset gate
+            for (size_t i = 0; i < gateRows; i++)
+                bias[i] = biasW[i] + (isGRU && i >= 2 * hiddenSize ? 0 : biasR[i]);
+            const ElemType* biasCandidateR = biasR + 2 * hiddenSize;
+
+            Multiply(w, true, *layerInput, false, inputProjection);
+
+            h.SetValue(0);
+            if (isLSTM)
+                c.SetValue(0);
+            for (size_t step = 0; step < numFrames; step++)
+            {
+                // Backwards, sequences join as the step reaches their end, with the zero state that their columns still hold.
+                const size_t t = direction == 0 ? step : numFrames - 1 - step;
+                const size_t numSequences = numSequencesForFrame[t];
+                CPUMatrix<ElemType> hActive = h.ColumnSlice(0, numSequences);
+                CPUMatrix<ElemType> rh = recurrentProjection.ColumnSlice(0, numSequences);
+                if (step > 0)
+                    Multiply(r, true, hActive, false, rh); // all gates in one GEMM
+                else
+                    rh.SetValue(0);
+
+#pragma omp parallel for if (numSequences * gateRows >= 4096)
+                for (long s = 0; s < (long) numSequences; s++)
+                {
+                    const ElemType* x = inputProjection.Data() + (frameStart[t] + s) * gateRows;
+                    const ElemType* rhs = rh.Data() + s * gateRows;
+                    ElemType* hs = h.Data() + s * hiddenSize;
+                    if (isLSTM)
+                    {
+                        ElemType* cs = c.Data() + s * hiddenSize;
+                        for (size_t k = 0; k < hiddenSize; k++)
+                        {
+                            ElemType inputGate = Sigmoid(x[k] + rhs[k] + bias[k]);
+                            ElemType forgetGate = Sigmoid(x[hiddenSize + k] + rhs[hiddenSize + k] + bias[hiddenSize + k]);
+                            ElemType candidate = tanh_(x[2 * hiddenSize + k] + rhs[2 * hiddenSize + k] + bias[2 * hiddenSize + k]);
+                            ElemType outputGate = Sigmoid(x[3 * hiddenSize + k] + rhs[3 * hiddenSize + k] + bias[3 * hiddenSize + k]);
+                            cs[k] = forgetGate * cs[k] + inputGate * candidate;
+                            hs[k] = outputGate * tanh_(cs[k]);
+                        }
+                    }
+                    else if (isGRU)
+                    {
+                        for (size_t k = 0; k < hiddenSize; k++)
+                        {
+                            ElemType resetGate = Sigmoid(x[k] + rhs[k] + bias[k]);
+                            ElemType updateGate = Sigmoid(x[hiddenSize + k] + rhs[hiddenSize + k] + bias[hiddenSize + k]);
+                            ElemType candidate = tanh_(x[2 * hiddenSize + k] + bias[2 * hiddenSize + k] + resetGate * (rhs[2 * hiddenSize + k] + biasCandidateR[k]));
+                            hs[k] = (1 - updateGate) * candidate + updateGate * hs[k];
+                        }
+                    }
+                    else
+                    {
+                        for (size_t k = 0; k < hiddenSize; k++)
+                        {
+                            ElemType z = x[k] + rhs[k] + bias[k];
+                            hs[k] = isReLU ? (z > 0 ? z : 0) : tanh_(z);
+                        }
+                    }
+                    memcpy(layerOutput.Data() + (frameStart[t] + s) * yDim + direction * hiddenSize, hs, hiddenSize * sizeof(ElemType));
+                }
+            }
+        }
+        layerInput = &layerOutput;
+        inputDim = yDim;
+    }
+}
+
 
 #pragma region Static BLAS Functions
 
@@ -4710,6 +5257,57 @@ void CPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMat
             c(i, j) = b(i, j) * f + c(i, j) * beta;
 }
 
+/// <summary>Batch of small matrix multiplies with col-major matrices: c_i = alpha * op(a_i) * op(b_i) + beta * c_i, for i = 0..batchCount-1</summary>
+/// The i-th matrices are stored densely (leading dimension is their number of rows) at offset i * stride of the respective
+/// matrix object, e.g. one per column. A stride of 0 shares the same matrix across the batch, which is allowed for a and b only.
+/// <param name="alpha">Scalar</param>
+/// <param name="a">Input matrices, each [m x k], or [k x m] if transposeA</param>
+/// <param name="transposeA">Whether the matrices a_i are transposed</param>
+/// <param name="strideA">Number of elements between consecutive a_i</param>
+/// <param name="b">Input matrices, each [k x n], or [n x k] if transposeB</param>
+/// <param name="transposeB">Whether the matrices b_i are transposed</param>
+/// <param name="strideB">Number of elements between consecutive b_i</param>
+/// <param name="beta">Scalar</param>
+/// <param name="c">Resulting matrices, each [m x n], user is responsible for allocating this</param>
+/// <param name="strideC">Number of elements between consecutive c_i</param>
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const size_t strideA, const CPUMatrix<ElemType>& b, const bool transposeB, const size_t strideB,
+                                                        ElemType beta, CPUMatrix<ElemType>& c, const size_t strideC, const size_t m, const size_t n, const size_t k, const size_t batchCount)
+{
+    if (batchCount == 0 || m == 0 || n == 0)
+        return;
+    if (strideC < m * n && batchCount > 1)
+        InvalidArgument("CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd : The output matrices must not overlap.");
+    if ((batchCount - 1) * strideA + m * k > a.GetNumElements() || (batchCount - 1) * strideB + k * n > b.GetNumElements() || (batchCount - 1) * strideC + m * n > c.GetNumElements())
+        InvalidArgument("CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd : The batch of matrices exceeds the matrix objects.");
+
+    CBLAS_TRANSPOSE mklTransA = transposeA ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans;
+    CBLAS_TRANSPOSE mklTransB = transposeB ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans;
+    int lda = (int) max<size_t>(1, transposeA ? k : m); // (BLAS requires leading dimensions >= 1 even if k is 0)
+    int ldb = (int) max<size_t>(1, transposeB ? n : k);
+    int ldc = (int) m;
+
+    // The products are usually too small for a multi-threaded GEMM, so with MKL the batch is distributed over the threads
+    // instead. OpenBLAS is not known to be safe to call concurrently, hence the products are computed one after the other.
+#ifdef USE_MKL
+#pragma omp parallel for
+#endif
+    for (long i = 0; i < (long) batchCount; i++)
+    {
+        if (sizeof(ElemType) == sizeof(double))
+        {
+            cblas_dgemm((CBLAS_ORDER) (int)MatrixOrder::ColMajor, mklTransA, mklTransB, (int) m, (int) n, (int) k, alpha, reinterpret_cast<double*>(a.Data() + i * strideA), lda,
+                        reinterpret_cast<double*>(b.Data() + i * strideB), ldb, beta, reinterpret_cast<double*>(c.Data() + i * strideC), ldc);
+        }
+        else
+        {
+#pragma warning(suppress : 4244)
+            cblas_sgemm((CBLAS_ORDER) (int)MatrixOrder::ColMajor, mklTransA, mklTransB, (int) m, (int) n, (int) k, alpha, reinterpret_cast<float*>(a.Data() + i * strideA), lda,
+                        reinterpret_cast<float*>(b.Data() + i * strideB), ldb, beta, reinterpret_cast<float*>(c.Data() + i * strideC), ldc);
+        }
+    }
+}
+
 /* compute singular value decomposition as
     A = U*SIGMA*VT
     W is used as temp working memory
@@ -4795,14 +5393,362 @@ void CPUMatrix<ElemType>::AssignSoftmaxSum(const CPUMatrix<ElemType>& softmax, C
     c(0, 0) = -log_likelihood;
 }
 
+// Each column of this matrix receives one augmented image (or view of an input image), see ImageAugmentation.h.
 template <class ElemType>
-void CPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const CPUMatrix<ElemType>& a,
-                                                    const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& bias, CPUMatrix<ElemType>& c)
-//this: samples+probs
-// a:   hidden
-// b:   embedding
-// tmp:  softmax
-//  c: loglikelihood
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignAugmentedImages(const CPUMatrix<ElemType>& workspace, size_t numImages, const ImageAugmentationParameters& parameters, uint64_t seed)
+{
+    const ImageAugmentationWorkspaceLayout layout = GetImageAugmentationWorkspaceLayout(parameters, numImages);
+    const char* base = reinterpret_cast<const char*>(workspace.Data());
+    const uint8_t* images = reinterpret_cast<const uint8_t*>(base + layout.m_imagesOffset);
+    const float* mean = parameters.m_subtractMean ? reinterpret_cast<const float*>(base + layout.m_meanOffset) : nullptr;
+
+    const size_t imageSize = parameters.GetImageSize();
+    const size_t sourceImageSize = parameters.GetSourceImageSize();
+    const uint32_t numViews = parameters.GetNumViews();
+    const size_t numPixels = (size_t)parameters.m_width * parameters.m_height;
+    RequireSize(imageSize, numImages);
+
+#pragma omp parallel for
+    for (long i = 0; i < (long)numImages; i++)
+    {
+        const uint8_t* image = images + (i / numViews) * sourceImageSize;
+        uint32_t view = (uint32_t)(i % numViews);
+        uint64_t sum = 0;
+        for (size_t j = 0; j < imageSize; j++)
+            sum += GetImageAugmentationSourceValue(parameters, image, view, j);
+
+        ImageAugmentationSample sample = ComputeImageAugmentationSample(parameters, seed, i, (float)sum / imageSize);
+        ElemType* output = Data() + i * imageSize;
+        for (size_t pixel = 0; pixel < numPixels; pixel++)
+            AugmentImagePixel(parameters, sample, image, view, mean, pixel, output);
+    }
+
+    return *this;
+}
+
+template <class ElemType, class TNarrow>
+static void WidenValues(const TNarrow* source, ElemType* destination, size_t count, ElemType scale, ElemType shift)
+{
+#pragma omp parallel for
+    for (long i = 0; i < (long)count; i++)
+        destination[i] = scale * (ElemType)NarrowToFloat(source[i]) + shift;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignWidenedValuesOf(const CPUMatrix<ElemType>& packed, NarrowElementType type, size_t numRows, size_t numCols, ElemType scale, ElemType shift)
+{
+    RequireSize(numRows, numCols);
+    if (type == NarrowElementType::uint8)
+        WidenValues(reinterpret_cast<const uint8_t*>(packed.Data()), Data(), GetNumElements(), scale, shift);
+    else
+        WidenValues(reinterpret_cast<const float16*>(packed.Data()), Data(), GetNumElements(), scale, shift);
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignRanksWithinQueries(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& queryIds)
+{
+    int numUrls = (int)gains.GetNumElements();
+    RequireSize(1, numUrls);
+#pragma omp parallel for
+    for (int i = 0; i < numUrls; i++)
+    {
+        int begin, end;
+        GetQueryOfUrl(queryIds.Data(), numUrls, i, begin, end);
+        Data()[i] = (ElemType)GetRankWithinQuery(scores.Data(), gains.Data(), begin, end, i);
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNDCGContributions(const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& ranks, const CPUMatrix<ElemType>& queryIds, bool atOne, CPUMatrix<ElemType>& queryStarts)
+{
+    int numUrls = (int)gains.GetNumElements();
+    RequireSize(1, numUrls);
+    queryStarts.RequireSize(1, numUrls);
+#pragma omp parallel for
+    for (int i = 0; i < numUrls; i++)
+    {
+        int begin, end;
+        GetQueryOfUrl(queryIds.Data(), numUrls, i, begin, end);
+        Data()[i] = GetNDCGContribution(gains.Data(), ranks.Data(), begin, end, i, atOne);
+        queryStarts.Data()[i] = (ElemType)(i == begin ? 1 : 0);
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddLambdaRankGradient(const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& ranks, const CPUMatrix<ElemType>& queryIds, ElemType sigma)
+{
+    int numUrls = (int)gains.GetNumElements();
+    if (GetNumElements() != numUrls)
+        LogicError("AddLambdaRankGradient: the gradient has %d elements, but there are %d urls.", (int)GetNumElements(), numUrls);
+#pragma omp parallel for
+    for (int i = 0; i < numUrls; i++)
+    {
+        int begin, end;
+        GetQueryOfUrl(queryIds.Data(), numUrls, i, begin, end);
+        Data()[i] += GetLambdaRankGradient(gains.Data(), scores.Data(), ranks.Data(), begin, end, i, sigma);
+    }
+    return *this;
+}
+
+// The CRF recursions go over the time steps; each step computes all sequences and labels in parallel (see LinearChainCRF.h).
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCRFForwardScores(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions, const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& sequences, size_t stride)
+{
+    int numLabels = (int)scores.GetNumRows();
+    int numSequences = (int)sequences.GetNumCols();
+    int numSteps = (int)(scores.GetNumCols() / stride);
+    RequireSize(numLabels, scores.GetNumCols());
+    for (int t = 0; t < numSteps; t++)
+    {
+#pragma omp parallel for
+        for (int id = 0; id < numSequences * numLabels; id++)
+            CRFForwardStep(Data(), scores.Data(), transitions.Data(), labelIndices.Data(), sequences.Data(), numLabels, (int)stride, id / numLabels, id % numLabels, t);
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCRFLogPosteriors(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions, const CPUMatrix<ElemType>& sequences, size_t stride)
+{
+    int numLabels = (int)scores.GetNumRows();
+    int numSequences = (int)sequences.GetNumCols();
+    int numSteps = (int)(scores.GetNumCols() / stride);
+    RequireSize(numLabels, scores.GetNumCols());
+    for (int t = numSteps - 1; t >= 0; t--)
+    {
+#pragma omp parallel for
+        for (int id = 0; id < numSequences * numLabels; id++)
+            CRFBackwardStep(Data(), alpha.Data(), scores.Data(), transitions.Data(), sequences.Data(), numLabels, (int)stride, id / numLabels, id % numLabels, t);
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCRFNegativeLogLikelihoods(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions, const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& sequences, size_t stride)
+{
+    int numSequences = (int)sequences.GetNumCols();
+    RequireSize(1, numSequences);
+#pragma omp parallel for
+    for (int s = 0; s < numSequences; s++)
+        Data()[s] = GetCRFNegativeLogLikelihood(alpha.Data(), scores.Data(), transitions.Data(), labelIndices.Data(), sequences.Data(), (int)scores.GetNumRows(), (int)stride, s);
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCRFTransitionGradient(const CPUMatrix<ElemType>& logPosteriors, const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions,
+                                                                      const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& sequences, size_t stride)
+{
+    int numLabels = (int)scores.GetNumRows();
+    RequireSize(numLabels, numLabels);
+#pragma omp parallel for
+    for (int id = 0; id < numLabels * numLabels; id++)
+        Data()[id] = GetCRFTransitionGradient(logPosteriors.Data(), alpha.Data(), scores.Data(), transitions.Data(), labelIndices.Data(), sequences.Data(), (int)sequences.GetNumCols(), numLabels, (int)stride, id % numLabels, id / numLabels);
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCRFViterbiPath(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions, const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& sequences, size_t stride,
+                                                               CPUMatrix<ElemType>& viterbiScores, CPUMatrix<ElemType>& backPointers)
+{
+    int numLabels = (int)scores.GetNumRows();
+    int numSequences = (int)sequences.GetNumCols();
+    int numSteps = (int)(scores.GetNumCols() / stride);
+    viterbiScores.RequireSize(numLabels, scores.GetNumCols());
+    backPointers.RequireSize(numLabels, scores.GetNumCols());
+    for (int t = 0; t < numSteps; t++)
+    {
+#pragma omp parallel for
+        for (int id = 0; id < numSequences * numLabels; id++)
+            CRFViterbiStep(viterbiScores.Data(), backPointers.Data(), scores.Data(), transitions.Data(), labelIndices.Data(), sequences.Data(), numLabels, (int)stride, id / numLabels, id % numLabels, t);
+    }
+
+    RequireSize(numLabels, scores.GetNumCols());
+    SetValue(0);
+#pragma omp parallel for
+    for (int s = 0; s < numSequences; s++)
+        CRFViterbiBacktrace(Data(), viterbiScores.Data(), backPointers.Data(), sequences.Data(), numLabels, (int)stride, s);
+    return *this;
+}
+
+// The sequences are 2 x numSequences of (first column, number of frames), see Matrix::AssignNonZeroCountsOfSequences().
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNonZeroCountsOfSequences(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& sequences, size_t stride)
+{
+    long numSequences = (long)sequences.GetNumCols();
+    RequireSize(1, numSequences);
+#pragma omp parallel for
+    for (long i = 0; i < numSequences; i++)
+    {
+        size_t first = (size_t)sequences(0, i);
+        size_t numFrames = (size_t)sequences(1, i);
+        size_t count = 0;
+        for (size_t t = 0; t < numFrames; t++)
+            count += a.Data()[first + t * stride] != 0;
+        Data()[i] = (ElemType)count;
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNonZeroPositionsOfSequences(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& sequences, size_t stride, const CPUMatrix<ElemType>& outputSequences, size_t outputStride)
+{
+    long numSequences = (long)sequences.GetNumCols();
+#pragma omp parallel for
+    for (long i = 0; i < numSequences; i++)
+    {
+        size_t first = (size_t)sequences(0, i);
+        size_t numFrames = (size_t)sequences(1, i);
+        size_t outputFirst = (size_t)outputSequences(0, i);
+        size_t numOutputFrames = (size_t)outputSequences(1, i);
+        size_t position = 0;
+        for (size_t t = 0; t < numFrames && position < numOutputFrames; t++)
+        {
+            if (a.Data()[first + t * stride] != 0)
+                Data()[outputFirst + position++ * outputStride] = (ElemType)t;
+        }
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignColumnsOfSequencePositions(const CPUMatrix<ElemType>& positions, const CPUMatrix<ElemType>& sequences, size_t stride, const CPUMatrix<ElemType>& targetSequences, size_t targetStride)
+{
+    long numSequences = (long)sequences.GetNumCols();
+#pragma omp parallel for
+    for (long i = 0; i < numSequences; i++)
+    {
+        size_t first = (size_t)sequences(0, i);
+        size_t numFrames = (size_t)sequences(1, i);
+        for (size_t t = 0; t < numFrames; t++)
+        {
+            size_t column = first + t * stride;
+            ElemType position = positions.Data()[column];
+            Data()[column] = position >= 0 && position < targetSequences(1, i) ? (ElemType)((size_t)targetSequences(0, i) + (size_t)position * targetStride) : (ElemType)-1;
+        }
+    }
+    return *this;
+}
+
+// The GMM is computed with a thread per output element; the gradient of a shared parameter sums over the samples
+// in its own thread (see GaussianMixture.h).
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignGMMLogLikelihoods(const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, CPUMatrix<ElemType>& posteriors)
+{
+    int numComponents = (int)unnormedPrior.GetNumRows();
+    int featureDim = (int)features.GetNumRows();
+    long numSamples = (long)features.GetNumCols();
+    posteriors.RequireSize(numComponents, numSamples);
+    RequireSize(1, numSamples);
+#pragma omp parallel for
+    for (long n = 0; n < numSamples; n++)
+    {
+        ElemType* posterior = posteriors.Data() + (size_t)n * numComponents;
+        for (int c = 0; c < numComponents; c++)
+            posterior[c] = GetGMMComponentLogLikelihood(unnormedPrior.Data(), unnormedPrior.GetNumCols(), means.Data(), means.GetNumCols(), logStddevs.Data(), logStddevs.GetNumCols(),
+                                                        features.Data(), numComponents, featureDim, c, (size_t)n);
+        Data()[n] = NormalizeGMMPosteriors(posterior, numComponents);
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddGMMUnnormedPriorGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& posteriors)
+{
+    int numComponents = (int)unnormedPrior.GetNumRows();
+    long N = (long)GetNumElements();
+#pragma omp parallel for
+    for (long id = 0; id < N; id++)
+        Data()[id] += GetGMMUnnormedPriorGradient(gradient.Data(), unnormedPrior.Data(), unnormedPrior.GetNumCols(), posteriors.Data(), numComponents, posteriors.GetNumCols(), (int)(id % numComponents), (size_t)(id / numComponents));
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddGMMMeanGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& posteriors)
+{
+    int numComponents = (int)posteriors.GetNumRows();
+    int featureDim = (int)features.GetNumRows();
+    long numRows = (long)GetNumRows();
+    long N = (long)GetNumElements();
+#pragma omp parallel for
+    for (long id = 0; id < N; id++)
+        Data()[id] += GetGMMMeanGradient(gradient.Data(), means.Data(), means.GetNumCols(), logStddevs.Data(), logStddevs.GetNumCols(), features.Data(), posteriors.Data(),
+                                         numComponents, featureDim, posteriors.GetNumCols(), (int)(id % numRows), (size_t)(id / numRows));
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddGMMLogStddevGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& posteriors)
+{
+    int numComponents = (int)posteriors.GetNumRows();
+    int featureDim = (int)features.GetNumRows();
+    long N = (long)GetNumElements();
+#pragma omp parallel for
+    for (long id = 0; id < N; id++)
+        Data()[id] += GetGMMLogStddevGradient(gradient.Data(), means.Data(), means.GetNumCols(), logStddevs.Data(), logStddevs.GetNumCols(), features.Data(), posteriors.Data(),
+                                              numComponents, featureDim, posteriors.GetNumCols(), (int)(id % numComponents), (size_t)(id / numComponents));
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddGMMFeatureGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& posteriors)
+{
+    int numComponents = (int)posteriors.GetNumRows();
+    int featureDim = (int)features.GetNumRows();
+    long N = (long)GetNumElements();
+#pragma omp parallel for
+    for (long id = 0; id < N; id++)
+        Data()[id] += GetGMMFeatureGradient(gradient.Data(), means.Data(), means.GetNumCols(), logStddevs.Data(), logStddevs.GetNumCols(), features.Data(), posteriors.Data(),
+                                            numComponents, featureDim, (int)(id % featureDim), (size_t)(id / featureDim));
+    return *this;
+}
+
+// Cosine similarity with negative samples: a thread per query, or per column of the normalized inputs (see CosineWithNegativeSamples.h).
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSimilaritiesWithNegativeSamples(const CPUMatrix<ElemType>& similarities, size_t shift, size_t numNegatives, bool inBatchNegatives, CPUMatrix<ElemType>& documents)
+{
+    long numCols = (long)similarities.GetNumCols();
+    size_t numRows = numNegatives + 1;
+    RequireSize(numRows, numCols);
+    documents.RequireSize(numRows, numCols);
+#pragma omp parallel for
+    for (long j = 0; j < numCols; j++)
+        AssignSimilaritiesWithNegativeSamplesOfQuery(Data() + j * numRows, documents.Data() + j * numRows, similarities.Data(), (int)numCols, (int)shift, (int)numNegatives, inBatchNegatives, (int)j);
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNegativeSamplesGradientMatrix(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& documents)
+{
+    long numCols = (long)documents.GetNumCols();
+    RequireSize(numCols, numCols);
+    SetValue(0);
+#pragma omp parallel for
+    for (long j = 0; j < numCols; j++)
+        AddNegativeSamplesGradientOfQuery(Data(), gradient.Data(), documents.Data(), (int)numCols, (int)documents.GetNumRows(), (int)j);
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddColumnNormalizationGradient(const CPUMatrix<ElemType>& gradientOfNormalized, const CPUMatrix<ElemType>& normalized, const CPUMatrix<ElemType>& invNorms)
+{
+    long numCols = (long)GetNumCols();
+#pragma omp parallel for
+    for (long j = 0; j < numCols; j++)
+        AddColumnNormalizationGradientOfColumn(Data(), gradientOfNormalized.Data(), normalized.Data(), invNorms.Data(), (int)GetNumRows(), (int)j);
+    return *this;
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const CPUMatrix<ElemType>& a,
+                                                    const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& bias, CPUMatrix<ElemType>& c)
+//this: samples+probs
+// a:   hidden
+// b:   embedding
+// tmp:  softmax
+//  c: loglikelihood
 {
     ElemType log_likelihood = 0.0;
     size_t batch_size = GetNumCols();
@@ -5193,6 +6139,39 @@ void CPUMatrix<ElemType>::AssignScaledDifference(const CPUMatrix<ElemType>& alph
 
     AssignScaledDifference(alpha(0, 0), a, b, c);
 }
+
+/// <summary>c += alpha * (softmax(logits) - labels)</summary>
+/// <param name="alpha">1X1 matrix</param>
+/// <param name="logits">Input matrix</param>
+/// <param name="logSumExp">Column-wise log-sum-exp of logits</param>
+/// <param name="labels">Input matrix</param>
+/// <param name="c">Resulting matrix, user is responsible for allocating this</param>
+template <class ElemType>
+void CPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp, const CPUMatrix<ElemType>& labels, CPUMatrix<ElemType>& c)
+{
+    if (alpha.GetNumElements() != 1)
+        InvalidArgument("AddSoftmaxCrossEntropyGradient:  alpha must be a 1X1 matrix.");
+    if (logits.IsEmpty())
+        LogicError("AddSoftmaxCrossEntropyGradient:  Input matrix logits is empty.");
+    if (!(logits.GetNumRows() == labels.GetNumRows() && logits.GetNumRows() == c.GetNumRows() &&
+          logits.GetNumCols() == labels.GetNumCols() && logits.GetNumCols() == c.GetNumCols() && logSumExp.GetNumElements() == logits.GetNumCols()))
+        InvalidArgument("AddSoftmaxCrossEntropyGradient:  logits, labels, and c must have the same dimension, and logSumExp one element per column.");
+
+    const long m = (long) logits.GetNumRows();
+    const long n = (long) logits.GetNumCols();
+    const ElemType a = alpha(0, 0);
+    const ElemType* lse = logSumExp.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* z = logits.Data() + j * m;
+        const ElemType* y = labels.Data() + j * m;
+        ElemType* us = c.Data() + j * m;
+        for (long i = 0; i < m; i++)
+            us[i] += a * (exp(z[i] - lse[j]) - y[i]);
+    }
+}
 /// <summary>Matrix-scalar multiply with col-major matrices: c = alpha * a</summary>
 /// <param name="alpha">Scalar</param>
 /// <param name="a">Input matrix</param>
@@ -5804,206 +6783,6 @@ ElemType CPUMatrix<ElemType>::LogSumOfElements() const
     return fAlpha;
 }
 
-template <class ElemType>
-void CPUMatrix<ElemType>::RCRFBackwardCompute(const CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta,
-                                              const CPUMatrix<ElemType>& lbls,
-                                              const CPUMatrix<ElemType>& pair_scores)
-{
-    int iNumPos = (int) lbls.GetNumCols();
-    int iNumLab = (int) lbls.GetNumRows();
-
-    int lastLbl = -1;
-    for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-        if (lbls(ik, iNumPos - 1) != 0)
-        {
-            lastLbl = ik;
-            break;
-        }
-
-    beta.RequireSize(iNumLab, iNumPos);
-
-    for (int t = iNumPos - 1; t >= 0; t--)
-    {
-#pragma omp parallel for
-        for (int k = 0; k < iNumLab; k++)
-        {
-            _rcrfBackwardCompute(t, k, alpha, beta, pair_scores);
-        }
-    }
-};
-
-/// the kernel function for RCRF backward computation
-template <class ElemType>
-void CPUMatrix<ElemType>::_rcrfBackwardCompute(size_t t, size_t k, const CPUMatrix<ElemType>& alpha,
-                                               CPUMatrix<ElemType>& beta,
-                                               const CPUMatrix<ElemType>& pair_scores)
-{
-    size_t iNumLab = alpha.GetNumRows();
-    size_t iNumPos = alpha.GetNumCols();
-
-    ElemType fSum;
-    ElemType fTmp = (ElemType) LZERO;
-    if (t == iNumPos - 1)
-    {
-        fSum = (ElemType) LZERO;
-        for (int j = 0; j < iNumLab; j++)
-        {
-            fSum = (ElemType) LogAddD(fSum, alpha(j, t));
-        }
-
-        fTmp = alpha(k, t) - fSum;
-        beta(k, t) = fTmp;
-    }
-    else
-    {
-        for (int j = 0; j < iNumLab; j++)
-        {
-            fSum = (ElemType) LZERO;
-            for (int m = 0; m < iNumLab; m++)
-            {
-                fSum = (ElemType) LogAddD(fSum, alpha(m, t) + pair_scores(j, m));
-            }
-
-            fTmp = (ElemType) LogAddD(fTmp, beta(j, t + 1) + alpha(k, t) + pair_scores(j, k) - fSum);
-        }
-        beta(k, t) = fTmp;
-    }
-}
-
-template <class ElemType>
-void CPUMatrix<ElemType>::RCRFTransGrdCompute(const CPUMatrix<ElemType>& lbls,
-                                              const CPUMatrix<ElemType>& alpha,
-                                              const CPUMatrix<ElemType>& beta,
-                                              const CPUMatrix<ElemType>& pair_scores,
-                                              CPUMatrix<ElemType>& grd)
-{
-    int iNumPos = (int) alpha.GetNumCols();
-    int iNumLab = (int) alpha.GetNumRows();
-
-    int firstLbl = -1;
-    for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-        if (lbls(ik, 0) != 0)
-        {
-            firstLbl = ik;
-            break;
-        }
-
-    for (size_t tPos = 0; tPos < iNumPos; tPos++)
-    {
-        CPUMatrix<ElemType> b = beta.ColumnSlice(tPos, 1);
-        CPUMatrix<ElemType> a;
-        if (tPos > 0)
-            a = alpha.ColumnSlice(tPos - 1, 1);
-
-#pragma omp parallel for
-        for (int i = 0; i < iNumLab; i++)
-        {
-            _rcrfTransGrdCompute(i, lbls, alpha, beta, pair_scores, grd, tPos);
-        }
-
-        // transition score
-        int i = -1;
-        if (tPos == 0)
-            i = firstLbl;
-        else
-        {
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, tPos - 1) != 0)
-                {
-                    i = ik;
-                    break;
-                }
-        }
-
-        int j = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-        {
-            if (lbls(ik, tPos) != 0)
-            {
-                j = ik;
-                break;
-            }
-        }
-
-        grd(j, i) -= 1.0;
-    }
-};
-
-template <class ElemType>
-void CPUMatrix<ElemType>::_rcrfTransGrdCompute(size_t i,
-                                               const CPUMatrix<ElemType>& lbls,
-                                               const CPUMatrix<ElemType>& alpha,
-                                               const CPUMatrix<ElemType>& beta,
-                                               const CPUMatrix<ElemType>& pair_scores,
-                                               CPUMatrix<ElemType>& grd,
-                                               const size_t tPos // position
-                                               )
-{
-    int iNumLab = (int) alpha.GetNumRows();
-
-    int firstLbl = -1;
-    for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-        if (lbls(ik, 0) != 0)
-        {
-            firstLbl = ik;
-            break;
-        }
-
-    CPUMatrix<ElemType> b = beta.ColumnSlice(tPos, 1);
-    CPUMatrix<ElemType> a;
-    if (tPos > 0)
-        a = alpha.ColumnSlice(tPos - 1, 1);
-
-    {
-        ElemType fTmp = (ElemType) LZERO;
-        for (int j = 0; j < iNumLab; j++)
-        {
-            if (tPos == 0)
-            {
-                if (i == firstLbl)
-                {
-                    fTmp = 0;
-                }
-                else
-                {
-                    fTmp = (ElemType) LZERO;
-                }
-            }
-            else
-            {
-                fTmp = a(i, 0);
-            }
-            fTmp += pair_scores(j, i);
-
-            ElemType fSum = (ElemType) LZERO;
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp2;
-                if (tPos == 0)
-                {
-                    if (k == firstLbl)
-                    {
-                        fTmp2 = 0;
-                    }
-                    else
-                    {
-                        fTmp2 = (ElemType) LZERO;
-                    }
-                }
-                else
-                {
-                    fTmp2 = a(k, 0);
-                }
-                fSum = (ElemType) LogAddD(fSum, fTmp2 + pair_scores(j, k));
-            }
-
-            fTmp -= fSum;
-            fTmp += b(j, 0);
-
-            grd(j, i) += exp(fTmp);
-        }
-    }
-};
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::DropFrame(const CPUMatrix<ElemType>& label, const CPUMatrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -6072,6 +6851,24 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
     return numThreads;
 }
 
+// note: this function does not depend on the <ElemType> parameter
+template <class ElemType>
+void CPUMatrix<ElemType>::SetThreadAffinity(ThreadAffinity affinity)
+{
+    if (affinity == ThreadAffinity::Device)
+        InvalidArgument("SetThreadAffinity: 'device' affinity is only supported for reader threads, use 'numa' or 'compact'.");
+
+#ifdef _OPENMP
+    // OpenMP keeps its team of threads across parallel regions, so pinning each of them once is enough.
+    // Note that the calling thread is thread 0 of the team.
+    const int numThreads = omp_get_max_threads();
+#pragma omp parallel num_threads(numThreads)
+    SetCurrentThreadAffinity(GetThreadCpus(affinity, omp_get_thread_num(), numThreads));
+#else
+    SetCurrentThreadAffinity(GetThreadCpus(affinity, 0, 1));
+#endif
+}
+
 template <class ElemType>
 int CPUMatrix<ElemType>::GetMaxNumThreads()
 {
@@ -6343,6 +7140,100 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
     }
 }
 
+// -----------------------------------------------------------------------
+// vector kernels for the common cases (see CPUVectorKernels.h)
+// -----------------------------------------------------------------------
+
+// Elementwise operations of up to 3 regular dimensions whose leading dimension is contiguous in all operands
+// are handed to the vector kernels as rows, looping over the third dimension here. The kernel support does not
+// depend on the pointers, so if the first call fails, nothing has been done.
+template <class FN>
+static bool ForAllVectorKernelRows(const SmallVector<size_t>& regularOpDims, const FN& fn)
+{
+    size_t outerDim = regularOpDims.size() > 2 ? regularOpDims[2] : 1;
+    for (size_t k = 0; k < outerDim; k++)
+    {
+        if (!fn(k))
+            return false;
+    }
+    return true;
+}
+
+static size_t GetVectorKernelRows(const SmallVector<size_t>& regularOpDims)
+{
+    return regularOpDims.size() > 1 ? regularOpDims[1] : 1;
+}
+
+static ptrdiff_t GetVectorKernelStride(const SmallVector<ptrdiff_t>& strides, size_t dim)
+{
+    return strides.size() > dim ? strides[dim] : 0;
+}
+
+template <class ElemType>
+static bool TensorOpWithVectorKernel(ElemType beta, const array<ElemType*, 2>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+{
+    const ElemType* a = pointers[0];
+    ElemType* c = pointers[1];
+    size_t rank = regularOpDims.size();
+
+    if (reducingOpDims.size() == 0)
+    {
+        if (rank == 0 || rank > 3 || regularStrides[0][0] != 1 || regularStrides[1][0] != 1)
+            return false;
+
+        return ForAllVectorKernelRows(regularOpDims, [&](size_t k)
+        {
+            return CPUVectorKernels<ElemType>::UnaryOp(op, beta,
+                                                       a + k * GetVectorKernelStride(regularStrides[0], 2), alpha, c + k * GetVectorKernelStride(regularStrides[1], 2),
+                                                       regularOpDims[0], GetVectorKernelRows(regularOpDims), GetVectorKernelStride(regularStrides[0], 1), GetVectorKernelStride(regularStrides[1], 1));
+        });
+    }
+
+    // reduction of one dimension into a scalar or a vector
+    if (reducingOpDims.size() == 1 && rank <= 1)
+    {
+        size_t m = rank == 1 ? regularOpDims[0] : 1;
+        ptrdiff_t strideA = GetVectorKernelStride(regularStrides[0], 0);
+        ptrdiff_t strideC = GetVectorKernelStride(regularStrides[1], 0);
+        if (reducingStrides[0][0] == 1)
+            return CPUVectorKernels<ElemType>::ReduceContiguous(reductionOp, op, beta, a, alpha, c, reducingOpDims[0], m, strideA, strideC);
+        if (rank == 1 && strideA == 1 && strideC == 1)
+            return CPUVectorKernels<ElemType>::ReduceStrided(reductionOp, op, beta, a, alpha, c, m, reducingOpDims[0], reducingStrides[0][0]);
+    }
+    return false;
+}
+
+// Binary elementwise operations; an input with leading stride 0 is broadcast along the rows.
+template <class ElemType>
+static bool TensorOpWithVectorKernel(ElemType beta, const array<ElemType*, 3>& pointers, ElemType alpha, ElementWiseOperator op,
+                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
+                                     const SmallVector<size_t>& reducingOpDims)
+{
+    size_t rank = regularOpDims.size();
+    if (reducingOpDims.size() != 0 || rank == 0 || rank > 3 || regularStrides[2][0] != 1)
+        return false;
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (regularStrides[i][0] != 0 && regularStrides[i][0] != 1)
+            return false;
+    }
+    bool aIsScalar = regularStrides[0][0] == 0;
+    bool bIsScalar = regularStrides[1][0] == 0;
+
+    return ForAllVectorKernelRows(regularOpDims, [&](size_t k)
+    {
+        return CPUVectorKernels<ElemType>::BinaryOp(op, beta,
+                                                    pointers[0] + k * GetVectorKernelStride(regularStrides[0], 2), aIsScalar,
+                                                    pointers[1] + k * GetVectorKernelStride(regularStrides[1], 2), bIsScalar,
+                                                    alpha, pointers[2] + k * GetVectorKernelStride(regularStrides[2], 2),
+                                                    regularOpDims[0], GetVectorKernelRows(regularOpDims),
+                                                    GetVectorKernelStride(regularStrides[0], 1), GetVectorKernelStride(regularStrides[1], 1), GetVectorKernelStride(regularStrides[2], 1));
+    });
+}
+
 // -----------------------------------------------------------------------
 // entry points from Matrix.cpp; also map op to a lambda
 // -----------------------------------------------------------------------
@@ -6371,6 +7262,9 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 2> pointers = {a.Data(), Data()};
+    if (TensorOpWithVectorKernel(beta, array<ElemType*, 2>{pointers[0] + offsets[0], pointers[1] + offsets[1]}, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
+
     switch (op)
     {
         ForAllUnaryOps(CaseUnaryTensorOp);
@@ -6399,6 +7293,9 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
+    if (TensorOpWithVectorKernel(beta, array<ElemType*, 3>{pointers[0] + offsets[0], pointers[1] + offsets[1], pointers[2] + offsets[2]}, alpha, op, regularOpDims, regularStrides, reducingOpDims))
+        return;
+
     switch (op)
     {
         ForAllBinaryOps(CaseBinaryTensorOp);
@@ -6435,6 +7332,23 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     }
 }
 
+// perform a fused chain of element-wise operations on a, b, and c giving 'this'
+// The program is interpreted per element, so this saves the memory passes for the intermediate results.
+template <class ElemType>
+void CPUMatrix<ElemType>::FusedTensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& c, ElemType alpha, const FusedElementwiseOp& program,
+                                        const array<size_t, 4>& offsets,
+                                        const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides)
+{
+    const SmallVector<size_t> reducingOpDims;
+    const array<SmallVector<ptrdiff_t>, 4> reducingStrides;
+    array<ElemType*, 4> pointers = {a.Data(), b.Data(), c.Data(), Data()};
+    TensorOpWithFn(beta, pointers, alpha, [&program](const array<ElemType*, 4>& pp)
+                   {
+                       return EvaluateFusedOp(program, *(pp[0]), *(pp[1]), *(pp[2]));
+                   },
+                   ElementWiseOperator::opSum, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+
 // =======================================================================
 // explicit instantiations
 // =======================================================================
@@ -14,6 +14,7 @@
 #include <ctime>
 #include <limits.h>
 #include "QuantizedOperations.h"
+#include "ThreadAffinity.h"
 
 //#include "GPUMatrix.h"
 //#include "CPUSparseMatrix.h"
@@ -93,6 +94,7 @@ public:
 
     ElemType Adagrad(CPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+    void Adam(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType biasCorrection, ElemType epsilon, ElemType decay);
     ElemType RmsProp(CPUMatrix<ElemType>& gradients,
                      ElemType RMS_GAMMA,
                      ElemType RMS_WGT_INC,
@@ -100,6 +102,10 @@ public:
                      ElemType RMS_WGT_DEC,
                      ElemType RMS_WGT_MIN,
                      const bool needAveMultiplier);
+    // fused update of many dense parameter tensors, see MultiTensorUpdateItem (CommonMatrix.h)
+    static void MultiTensorUpdate(std::vector<MultiTensorUpdateItem<ElemType>>& items, const MultiTensorUpdateParams<ElemType>& params);
+    // sums of squares of many dense tensors in one pass, e.g. for norm clipping
+    static void MultiTensorSumOfSquares(const std::vector<const ElemType*>& data, const std::vector<size_t>& sizes, std::vector<double>& sumsOfSquares);
 
 
     void Reshape(const size_t numRows, const size_t numCols);
@@ -150,6 +156,12 @@ public:
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
+    static void Dropout(const ElemType beta, const CPUMatrix<ElemType>& a, const ElemType dropoutRate, const uint64_t seed, const uint64_t offset, CPUMatrix<ElemType>& c);
+    void SetCounterBasedUniformRandomValue(const ElemType low, const ElemType high, const uint64_t seed);
+    void SetCounterBasedGaussianRandomValue(const ElemType mean, const ElemType sigma, const uint64_t seed);
+    CPUMatrix<ElemType>& AssignWeightedRandomSamplesWithReplacement(const CPUMatrix<ElemType>& weights, size_t numSamples, const uint64_t seed, const uint64_t offset, CPUMatrix<ElemType>& prefixSums);
+    CPUMatrix<ElemType>& AssignWeightedSampleKeys(const CPUMatrix<ElemType>& weights, const uint64_t seed, const uint64_t offset);
+    CPUMatrix<ElemType>& AssignWeightedSampleInclusionFrequencies(const CPUMatrix<ElemType>& weights, size_t numSamples, bool allowDuplicates, const CPUMatrix<ElemType>& samples);
 
     CPUMatrix<ElemType> Transpose();
     CPUMatrix<ElemType>& AssignTransposeOf(const CPUMatrix<ElemType>& a);
@@ -218,6 +230,7 @@ public:
 
     CPUMatrix<ElemType>& InplaceLogSoftmax(const bool isColWise);
     CPUMatrix<ElemType>& AssignLogSoftmaxOf(const CPUMatrix<ElemType>& a, const bool isColWise);
+    CPUMatrix<ElemType>& AssignSoftmaxCrossEntropyOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp);
 
     CPUMatrix<ElemType>& InplaceHardmax(const bool isColWise);
     CPUMatrix<ElemType>& AssignHardmaxOf(const CPUMatrix<ElemType>& a, const bool isColWise);
@@ -258,6 +271,7 @@ public:
     ElemType SumOfAbsElements() const; // sum of all abs(elements)
     ElemType SumOfElements() const;    // sum of all elements
     CPUMatrix<ElemType>& AssignSumOfElements(const CPUMatrix<ElemType>& a);
+    void FlagNonFiniteValues(CPUMatrix<ElemType>& flag) const;
 
     bool IsEqualTo(const CPUMatrix<ElemType>& a, const ElemType threshold = 1e-8) const;
 
@@ -274,6 +288,29 @@ public:
 
     void AssignSoftmaxSum(const CPUMatrix<ElemType>& a, CPUMatrix<ElemType>& softmax);
 
+    CPUMatrix<ElemType>& AssignAugmentedImages(const CPUMatrix<ElemType>& workspace, size_t numImages, const ImageAugmentationParameters& parameters, uint64_t seed);
+    CPUMatrix<ElemType>& AssignWidenedValuesOf(const CPUMatrix<ElemType>& packed, NarrowElementType type, size_t numRows, size_t numCols, ElemType scale, ElemType shift);
+
+    CPUMatrix<ElemType>& AssignRanksWithinQueries(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& queryIds);
+    CPUMatrix<ElemType>& AssignNDCGContributions(const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& ranks, const CPUMatrix<ElemType>& queryIds, bool atOne, CPUMatrix<ElemType>& queryStarts);
+    CPUMatrix<ElemType>& AddLambdaRankGradient(const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& ranks, const CPUMatrix<ElemType>& queryIds, ElemType sigma);
+    CPUMatrix<ElemType>& AssignCRFForwardScores(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions, const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& sequences, size_t stride);
+    CPUMatrix<ElemType>& AssignCRFLogPosteriors(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions, const CPUMatrix<ElemType>& sequences, size_t stride);
+    CPUMatrix<ElemType>& AssignCRFNegativeLogLikelihoods(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions, const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& sequences, size_t stride);
+    CPUMatrix<ElemType>& AssignCRFTransitionGradient(const CPUMatrix<ElemType>& logPosteriors, const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions, const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& sequences, size_t stride);
+    CPUMatrix<ElemType>& AssignCRFViterbiPath(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& transitions, const CPUMatrix<ElemType>& labelIndices, const CPUMatrix<ElemType>& sequences, size_t stride, CPUMatrix<ElemType>& viterbiScores, CPUMatrix<ElemType>& backPointers);
+    CPUMatrix<ElemType>& AssignNonZeroCountsOfSequences(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& sequences, size_t stride);
+    CPUMatrix<ElemType>& AssignNonZeroPositionsOfSequences(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& sequences, size_t stride, const CPUMatrix<ElemType>& outputSequences, size_t outputStride);
+    CPUMatrix<ElemType>& AssignColumnsOfSequencePositions(const CPUMatrix<ElemType>& positions, const CPUMatrix<ElemType>& sequences, size_t stride, const CPUMatrix<ElemType>& targetSequences, size_t targetStride);
+    CPUMatrix<ElemType>& AssignGMMLogLikelihoods(const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, CPUMatrix<ElemType>& posteriors);
+    CPUMatrix<ElemType>& AddGMMUnnormedPriorGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& posteriors);
+    CPUMatrix<ElemType>& AddGMMMeanGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& posteriors);
+    CPUMatrix<ElemType>& AddGMMLogStddevGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& posteriors);
+    CPUMatrix<ElemType>& AddGMMFeatureGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& posteriors);
+    CPUMatrix<ElemType>& AssignSimilaritiesWithNegativeSamples(const CPUMatrix<ElemType>& similarities, size_t shift, size_t numNegatives, bool inBatchNegatives, CPUMatrix<ElemType>& documents);
+    CPUMatrix<ElemType>& AssignNegativeSamplesGradientMatrix(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& documents);
+    CPUMatrix<ElemType>& AddColumnNormalizationGradient(const CPUMatrix<ElemType>& gradientOfNormalized, const CPUMatrix<ElemType>& normalized, const CPUMatrix<ElemType>& invNorms);
+
     void AssignNCEUnnormalizedEval(const CPUMatrix<ElemType>& a,
                                    const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& bias, CPUMatrix<ElemType>& c);
 
@@ -375,6 +412,12 @@ public:
     void ROIPoolingBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
                             const size_t pooledWidth, const size_t pooledHeight, const CPUMatrix<ElemType>& roiData, CPUMatrix<ElemType>& grad, CPUMatrix<ElemType>& argmax) const;
 
+    void ROIAlignForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                         const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const CPUMatrix<ElemType>& roiData, CPUMatrix<ElemType>& output) const;
+
+    void ROIAlignBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                          const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const CPUMatrix<ElemType>& roiData, CPUMatrix<ElemType>& grad) const;
+
     void MaxUnpooling(const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIndices, const CPUMatrix<int>& indices, const CPUMatrix<ElemType>& poolInput, CPUMatrix<ElemType>& input) const;
 
     void AveragePoolingForward(const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIndices, const CPUMatrix<int>& indices, CPUMatrix<ElemType>& output) const;
@@ -382,14 +425,26 @@ public:
                                 CPUMatrix<ElemType>& grad) const;
 
     void BatchNormalizationForward(const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, CPUMatrix<ElemType>& runMean, CPUMatrix<ElemType>& runVariance,
-                                   CPUMatrix<ElemType>& out, double epsilon, CPUMatrix<ElemType>& saveMean, CPUMatrix<ElemType>& saveInvStdDev) const;
+                                   CPUMatrix<ElemType>& out, double epsilon, CPUMatrix<ElemType>& saveMean, CPUMatrix<ElemType>& saveInvStdDev, bool reluOutput) const;
     void BatchNormalizationBackward(const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& grad, const CPUMatrix<ElemType>& scale, double blendFactor, const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
                                     CPUMatrix<ElemType>& scaleGrad, CPUMatrix<ElemType>& biasGrad) const;
+    void BatchNormalizationScaleAndBiasGradients(const CPUMatrix<ElemType>& in, const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
+                                                 CPUMatrix<ElemType>& scaleGrad, CPUMatrix<ElemType>& biasGrad) const;
+    void BatchNormalizationInputGradient(const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& grad, const CPUMatrix<ElemType>& scale, double mbStatsWeight,
+                                         const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
+                                         const CPUMatrix<ElemType>& scaleGrad, const CPUMatrix<ElemType>& biasGrad) const;
+    void BatchNormalizationReluBackward(const CPUMatrix<ElemType>& in, const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& bias,
+                                        const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev);
+
+    // Inference of OptimizedRNNStack on sequences in cuDNN packing (see CuDnnRNN.h), with parameters in the cuDNN layout.
+    void RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const struct RnnAttributes& rnnAttributes);
 
 public:
     // This functions do not depend on <ElemType>, i.e. you can call them on any <ElemType>
     static int SetNumThreads(int numThreads);
     static int GetMaxNumThreads();
+    // Pins the OpenMP threads (call after SetNumThreads); ThreadAffinity::None unpins them.
+    static void SetThreadAffinity(ThreadAffinity affinity);
 
     static void SetCompatibleMode();
 
@@ -401,12 +456,15 @@ public:
     static void Multiply(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType beta, CPUMatrix<ElemType>& c);
+    static void BatchedMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const size_t strideA, const CPUMatrix<ElemType>& b, const bool transposeB, const size_t strideB,
+                                              ElemType beta, CPUMatrix<ElemType>& c, const size_t strideC, const size_t m, const size_t n, const size_t k, const size_t batchCount);
 
     static void ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>& a, CPUMatrix<ElemType>& c);
     static void AddScaledDifference(const ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
     static void AssignScaledDifference(const ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
     static void AddScaledDifference(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);    // alpha must be 1X1
     static void AssignScaledDifference(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c); // alpha must be 1X1
+    static void AddSoftmaxCrossEntropyGradient(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp, const CPUMatrix<ElemType>& labels, CPUMatrix<ElemType>& c); // alpha must be 1X1
 
     static void AddElementToElement(ElemType beta, const CPUMatrix<ElemType>& a, const size_t ai, const size_t aj, CPUMatrix<ElemType>& c, const size_t ci, const size_t cj);
 
@@ -435,6 +493,9 @@ public:
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    void FusedTensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& c, ElemType alpha, const FusedElementwiseOp& program,
+                       const std::array<size_t, 4>& offsets,
+                       const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides);
 
     static CPUMatrix<ElemType> Ones(const size_t rows, const size_t cols);
     static CPUMatrix<ElemType> Zeros(const size_t rows, const size_t cols);
@@ -465,13 +526,16 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
-        ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        if (stream.IsTextBased())
+        {
+            ElemType* d_array = new ElemType[numRows * numCols];
+            stream.ReadArray(d_array, numRows * numCols);
+            us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
+            delete[] d_array;
+        }
+        else // take the values straight from the file buffer (or the mapped file) without per-element reads
+            us.SetValue(numRows, numCols, (ElemType*) stream.ReadBuffer(numRows * numCols * sizeof(ElemType)), matrixFlagNormal);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
-        us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
-
-        delete[] d_array;
         return stream;
     }
     friend File& operator<<(File& stream, const CPUMatrix<ElemType>& us)
@@ -493,30 +557,6 @@ public:
 public:
     ElemType LogSumOfElements() const;
 
-public:
-    // for RCRF
-    static void RCRFBackwardCompute(const CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta,
-                                    const CPUMatrix<ElemType>& lbls,
-                                    const CPUMatrix<ElemType>& pair_scores);
-    static void _rcrfBackwardCompute(size_t t, size_t k, const CPUMatrix<ElemType>& alpha,
-                                     CPUMatrix<ElemType>& beta,
-                                     const CPUMatrix<ElemType>& pair_scores);
-
-    static void RCRFTransGrdCompute(const CPUMatrix<ElemType>& lbls,
-                                    const CPUMatrix<ElemType>& alpha,
-                                    const CPUMatrix<ElemType>& beta,
-                                    const CPUMatrix<ElemType>& pair_scores,
-                                    CPUMatrix<ElemType>& grd);
-
-    static void _rcrfTransGrdCompute(size_t i,
-                                     const CPUMatrix<ElemType>& lbls,
-                                     const CPUMatrix<ElemType>& alpha,
-                                     const CPUMatrix<ElemType>& beta,
-                                     const CPUMatrix<ElemType>& pair_scores,
-                                     CPUMatrix<ElemType>& grd,
-                                     const size_t tPos // position
-                                     );
-
 protected:
     size_t LocateElement(const size_t i, const size_t j) const;
     size_t LocateColumn(const size_t j) const;
@@ -14,6 +14,7 @@
 #include <math.h>
 #include "CPUMatrix.h"
 #include "CPUSparseMatrix.h"
+#include "CPUVectorKernels.h"
 #include <random>
 #include <chrono>
 #include <iostream>
@@ -327,6 +328,30 @@ void CPUSparseMatrix<ElemType>::MaskColumnsValue(const CPUMatrix<char>& columnsM
 #endif
 }
 
+// CSC matrix with column j the indicator of row rowIndices[j], see Matrix::AssignOneHotColumns()
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::AssignOneHotColumns(const CPUMatrix<ElemType>& rowIndices, size_t numRows)
+{
+    VerifyWritable(__func__);
+
+    long n = (long) rowIndices.GetNumElements();
+    SetFormat(matrixFormatSparseCSC);
+    RequireSizeAndAllocate(numRows, n, n, true, false);
+
+    // (the column starts first, see SetMatrixFromCSCFormat())
+    CPUSPARSE_INDEX_TYPE* colLocation = ColLocation();
+    for (long j = 0; j <= n; j++)
+        colLocation[j] = (CPUSPARSE_INDEX_TYPE) j;
+    CPUSPARSE_INDEX_TYPE* rowLocation = RowLocation();
+    ElemType* values = NzValues();
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        rowLocation[j] = (CPUSPARSE_INDEX_TYPE) rowIndices.Data()[j];
+        values[j] = 1;
+    }
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUSparseMatrix<ElemType>& a, ElemType alpha)
 {
@@ -645,21 +670,34 @@ void CPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
     memcpy(NzValues(), h_Val, sizeof(ElemType)*nz);
 }
 
-#if 0 // add it back with test
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols)
 {
-    if (!OwnBuffer())
-        LogicError("Cannot modify since the buffer is managed externally.");
+    VerifyWritable(__FUNCTION__);
+
+    if (numBlocks > 0 && (blockIds == nullptr || val == nullptr))
+        LogicError("SetMatrixFromSBCFormat: nullptr passed in.");
 
     SetFormat(matrixFormatSparseBlockCol);
-    Resize(numRows, numCols, numBlocks * numRows);
+    RequireSizeAndAllocate(numRows, numCols, numBlocks * numRows, true, false);
     SetBlockSize(numBlocks);
+    SetBlockIdShift(0);
 
-    memcpy(GetBlockIds(), blockIds, sizeof(size_t)*(numBlocks));
-    memcpy(Data(), val, sizeof(ElemType)*numBlocks*numRows);
+    memcpy(GetBlockIds(), blockIds, sizeof(size_t) * numBlocks);
+    memcpy(Data(), val, sizeof(ElemType) * numBlocks * numRows);
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const
+{
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        LogicError("GetMatrixFromSBCFormat: The matrix is not in SparseBlockCol format.");
+
+    blockIds.resize(GetBlockSize());
+    for (size_t j = 0; j < GetBlockSize(); j++)
+        blockIds[j] = GetBlockIds()[j] - GetBlockIdShift();
+    val.assign(Data(), Data() + GetBlockSize() * GetNumRows());
 }
-#endif
 
 template <class ElemType>
 ElemType* CPUSparseMatrix<ElemType>::Data()  const
@@ -810,6 +848,119 @@ void CPUSparseMatrix<ElemType>::Reset()
     SetBlockIdShift(0);
 }
 
+// Below this number of multiply-adds a sparse product is not worth splitting across threads.
+static const size_t s_minParallelSparseMultiplyAdds = 64 * 1024;
+
+// Calls fn(groupBegin, groupEnd) for consecutive ranges of the groups of nonzeros [0, numGroups), where group g holds the
+// nonzeros groupStarts[g] <= p < groupStarts[g + 1] and contributes to a row or column of the result that no other group
+// writes to. The ranges are processed in parallel, with about the same number of nonzeros each, a few per thread so that
+// the dynamic schedule can balance ranges whose nonzeros differ in cost.
+template <class FN>
+static void ForAllNonzeroGroups(const CPUSPARSE_INDEX_TYPE* groupStarts, size_t numGroups, size_t numMultiplyAdds, const FN& fn)
+{
+    size_t numParts = std::min(numGroups, (size_t) (4 * omp_get_max_threads()));
+    if (numMultiplyAdds < s_minParallelSparseMultiplyAdds || numParts <= 1)
+    {
+        fn(0, numGroups);
+        return;
+    }
+
+    size_t numNonzeros = groupStarts[numGroups] - groupStarts[0];
+    std::vector<size_t> bounds(numParts + 1, numGroups);
+    bounds[0] = 0;
+    for (size_t part = 1; part < numParts; part++)
+    {
+        CPUSPARSE_INDEX_TYPE firstNonzeroOfPart = groupStarts[0] + (CPUSPARSE_INDEX_TYPE) (numNonzeros * part / numParts);
+        bounds[part] = std::lower_bound(groupStarts + bounds[part - 1], groupStarts + numGroups, firstNonzeroOfPart) - groupStarts;
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (long part = 0; part < (long) numParts; part++)
+        fn(bounds[part], bounds[part + 1]);
+}
+
+// Regroups the nonzeros of the CSC matrix a by groupOfRow(row), the CSR layout of a if that is the row itself.
+// Group g holds the nonzeros groupStarts[g] <= q < groupStarts[g + 1], with their column in colIndices[q] and their value in values[q],
+// in the order of increasing column.
+template <class ElemType, class GroupOfRow>
+static void GroupNonzerosByRow(const CPUSparseMatrix<ElemType>& a, size_t numGroups, const GroupOfRow& groupOfRow,
+                               std::vector<CPUSPARSE_INDEX_TYPE>& groupStarts, std::vector<CPUSPARSE_INDEX_TYPE>& colIndices, std::vector<ElemType>& values)
+{
+    const CPUSPARSE_INDEX_TYPE* colStarts = a.SecondaryIndexLocation();
+    const CPUSPARSE_INDEX_TYPE* rowIndices = a.MajorIndexLocation(); // relative to the first nonzero of the view
+    const ElemType* colValues = a.Buffer() + colStarts[0];
+    size_t numCols = a.GetNumCols();
+    size_t numNonzeros = colStarts[numCols] - colStarts[0];
+
+    std::vector<size_t> groupOfNonzero(numNonzeros);
+    groupStarts.assign(numGroups + 1, 0);
+    for (size_t q = 0; q < numNonzeros; q++)
+    {
+        groupOfNonzero[q] = groupOfRow((size_t) rowIndices[q]);
+        groupStarts[groupOfNonzero[q] + 1]++;
+    }
+    for (size_t g = 0; g < numGroups; g++)
+        groupStarts[g + 1] += groupStarts[g];
+
+    colIndices.resize(numNonzeros);
+    values.resize(numNonzeros);
+    std::vector<CPUSPARSE_INDEX_TYPE> next(groupStarts.begin(), groupStarts.end() - 1);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        for (size_t q = colStarts[j] - colStarts[0]; q < colStarts[j + 1] - colStarts[0]; q++)
+        {
+            CPUSPARSE_INDEX_TYPE target = next[groupOfNonzero[q]]++;
+            colIndices[target] = (CPUSPARSE_INDEX_TYPE) j;
+            values[target] = colValues[q];
+        }
+    }
+}
+
+// c[i] += alpha * sum(values[p] * a[i + indices[p] * lda], p < count) for i < n: the product of the column-major a and
+// a sparse column, added to a column of c. Uses the vector kernels if the CPU has them.
+template <class ElemType>
+static void AddSparseColumnProduct(const ElemType* a, size_t lda, const CPUSPARSE_INDEX_TYPE* indices, const ElemType* values, size_t count,
+                                   ElemType alpha, ElemType* c, size_t n)
+{
+    if (CPUVectorKernels<ElemType>::SparseColumnProduct(a, lda, indices, values, count, alpha, c, n))
+        return;
+
+    for (size_t p = 0; p < count; p++)
+    {
+        const ElemType* aColumn = a + indices[p] * lda;
+        ElemType weight = alpha * values[p];
+        for (size_t i = 0; i < n; i++)
+            c[i] += weight * aColumn[i];
+    }
+}
+
+#ifdef USE_MKL
+// c += alpha * a * b for the column-major a and c and the CSC matrix b, with the sparse BLAS of MKL.
+// With zero-based indices MKL takes the dense operands as row-major, i.e. as the transposed column-major matrices,
+// so this is computed as c^T += alpha * b^T * a^T.
+template <class ElemType>
+static void MKLDenseTimesSparse(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUSparseMatrix<ElemType>& b, CPUMatrix<ElemType>& c)
+{
+    MKL_INT m = (MKL_INT) b.GetNumRows(); // rows of the sparse matrix
+    MKL_INT n = (MKL_INT) c.GetNumRows(); // columns of c^T
+    MKL_INT k = (MKL_INT) b.GetNumCols(); // columns of the sparse matrix
+    MKL_INT lda = (MKL_INT) a.GetNumRows();
+    MKL_INT ldc = (MKL_INT) c.GetNumRows();
+    char transa = 'T';
+    char matdescra[6] = { 'G', 'L', 'N', 'C', 0, 0 }; // general matrix, zero-based indices
+    ElemType one = 1;
+    CPUSPARSE_INDEX_TYPE* colStarts = b.SecondaryIndexLocation();
+    ElemType* values = b.Buffer() + colStarts[0];
+
+    if (sizeof(ElemType) == sizeof(double))
+        mkl_dcscmm(&transa, &m, &n, &k, reinterpret_cast<double*>(&alpha), matdescra, reinterpret_cast<double*>(values), b.MajorIndexLocation(), colStarts, colStarts + 1,
+                   reinterpret_cast<double*>(a.Data()), &lda, reinterpret_cast<double*>(&one), reinterpret_cast<double*>(c.Data()), &ldc);
+    else
+        mkl_scscmm(&transa, &m, &n, &k, reinterpret_cast<float*>(&alpha), matdescra, reinterpret_cast<float*>(values), b.MajorIndexLocation(), colStarts, colStarts + 1,
+                   reinterpret_cast<float*>(a.Data()), &lda, reinterpret_cast<float*>(&one), reinterpret_cast<float*>(c.Data()), &ldc);
+}
+#endif
+
 // Implements product of one sparse and one dense matrix updating a third dense matrix. Input matrices are optionally transposed.
 // NOTE: The only for using a class template instead of a function template was that I couldn't make the function template compile.
 template <class ElemType, bool denseTimesSparse /* false means SparseTimesDense */, bool transposeA, bool transposeB>
@@ -869,50 +1020,98 @@ public:
         // * Initialized the output matrix c
 
         // Now do the actual multiplication.
-        ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation(); // Points to the value buffer of the current view (i.e. buffer containing values of non-zero elements).
-        int* rowIndexBuffer = sparse.MajorIndexLocation();                          // Points to the index buffer of the current view (i.e. buffer containing indices of non-zero elements).
-        size_t iNonzero = 0;                                                           // Number of nonzero elements handled so far for curent slice view.
-        int numPreviosNonzero = sparse.SecondaryIndexLocation()[0];                 // Total number of nonzero values handled in previous slices.
+#ifdef USE_MKL
+        if (denseTimesSparse && !transposeA && !transposeB)
+        {
+            MKLDenseTimesSparse(alpha, dense, sparse, c);
+            return;
+        }
+#endif
 
-        // Loop over columns of the sparse matrix
-        for (size_t colSparse = 0; colSparse < sparse.GetNumCols(); colSparse++)
+        // The nonzeros are processed in groups that share the 'outer' index of the sparse matrix, i.e. that contribute to the same
+        // row or column of c, so that groups can be processed in parallel. If the outer index is the column the groups are the
+        // columns of the CSC matrix, otherwise the nonzeros are regrouped by row first.
+        // Below if-statements are evaluated at compile time.
+        const bool outerIndexSparseIsColumn = (denseTimesSparse && !transposeB) || (!denseTimesSparse && transposeA);
+        std::vector<CPUSPARSE_INDEX_TYPE> rowStarts, colIndices;
+        std::vector<ElemType> rowValues;
+        const CPUSPARSE_INDEX_TYPE* groupStarts;  // start of the nonzeros of each group, relative to firstNonzero
+        const CPUSPARSE_INDEX_TYPE* innerIndices; // inner index of each nonzero
+        const ElemType* values;
+        CPUSPARSE_INDEX_TYPE firstNonzero;
+        size_t numGroups;
+        if (outerIndexSparseIsColumn)
         {
-            size_t numNonzeroInSparseCol = sparse.SecondaryIndexLocation()[colSparse + 1] - numPreviosNonzero;
-            // Loop over the nonzero rows of the current column of the sparse matrix
-            for (; iNonzero < numNonzeroInSparseCol; iNonzero++)
+            numGroups = sparse.GetNumCols();
+            groupStarts = sparse.SecondaryIndexLocation();
+            firstNonzero = groupStarts[0]; // Total number of nonzero values in previous slices.
+            innerIndices = sparse.MajorIndexLocation();
+            values = sparse.Buffer() + firstNonzero;
+        }
+        else
+        {
+            numGroups = sparse.GetNumRows();
+            GroupNonzerosByRow(sparse, numGroups, [](size_t row) { return row; }, rowStarts, colIndices, rowValues);
+            groupStarts = rowStarts.data();
+            firstNonzero = 0;
+            innerIndices = colIndices.data();
+            values = rowValues.data();
+        }
+
+        // The dense matrix is either accessed as dense(outerIndexDense, innerIndex), then the nonzeros of a group scale columns
+        // of dense that are added to c, or as dense(innerIndex, outerIndexDense), then each element of c is a sparse dot product
+        // with a column of dense.
+        const bool denseIsOuterIndexMajor = (denseTimesSparse && !transposeA) || (!denseTimesSparse && transposeB);
+        const ElemType* denseData = dense.Data();
+        size_t ldDense = dense.GetNumRows();
+        ElemType* cData = c.Data();
+        size_t ldc = c.GetNumRows();
+        size_t numNonzeros = groupStarts[numGroups] - firstNonzero;
+
+        ForAllNonzeroGroups(groupStarts, numGroups, numNonzeros * outerDimensionDense, [&](size_t groupBegin, size_t groupEnd)
+        {
+            if (denseIsOuterIndexMajor)
+            {
+                for (size_t outerIndexSparse = groupBegin; outerIndexSparse < groupEnd; outerIndexSparse++)
+                {
+                    size_t begin = groupStarts[outerIndexSparse] - firstNonzero;
+                    size_t end = groupStarts[outerIndexSparse + 1] - firstNonzero;
+                    if (denseTimesSparse) // c(outerIndexDense, outerIndexSparse), a contiguous column of c
+                    {
+                        AddSparseColumnProduct(denseData, ldDense, innerIndices + begin, values + begin, end - begin, alpha, cData + outerIndexSparse * ldc, outerDimensionDense);
+                    }
+                    else /* c(outerIndexSparse, outerIndexDense), a row of c */
+                    {
+                        for (size_t p = begin; p < end; p++)
+                        {
+                            const ElemType* denseColumn = denseData + innerIndices[p] * ldDense;
+                            ElemType weight = alpha * values[p];
+                            for (size_t outerIndexDense = 0; outerIndexDense < outerDimensionDense; outerIndexDense++)
+                                cData[outerIndexDense * ldc + outerIndexSparse] += weight * denseColumn[outerIndexDense];
+                        }
+                    }
+                }
+            }
+            else
             {
-                size_t rowSparse = rowIndexBuffer[iNonzero]; // RowLocation
-                ElemType sparseVal = valueBuffer[iNonzero];
-
-                // Determine the index of the 'outer' dimension of the sparse matrix and the common inner index.
-                size_t outerIndexSparse;
-                size_t innerIndex;
-                // Below if-statements are evaluated at compile time.
-                if      ( denseTimesSparse && !transposeB) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-                else if ( denseTimesSparse &&  transposeB) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse && !transposeA) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse &&  transposeA) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-
-                // Loop over the outer index of the dense matrix
+                // Loop over the outer index of the dense matrix outside, so that its column stays in the cache for all groups.
                 for (size_t outerIndexDense = 0; outerIndexDense < outerDimensionDense; outerIndexDense++)
                 {
-                    // Determine the row index of the dense input matrix.
-                    // Below if-statements are evaluated at compile time.
-                    ElemType denseVal;
-                    if      ( denseTimesSparse && !transposeA) denseVal = dense(outerIndexDense,      innerIndex);
-                    else if ( denseTimesSparse &&  transposeA) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse && !transposeB) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse &&  transposeB) denseVal = dense(outerIndexDense,      innerIndex);
-                    
-
-                    // Update matrix c.
-                    if (denseTimesSparse)
-                        c(outerIndexDense, outerIndexSparse) += alpha * denseVal * sparseVal;
-                    else /*Sparse times dense */
-                        c(outerIndexSparse, outerIndexDense) += alpha * denseVal * sparseVal;
+                    const ElemType* denseColumn = denseData + outerIndexDense * ldDense;
+                    for (size_t outerIndexSparse = groupBegin; outerIndexSparse < groupEnd; outerIndexSparse++)
+                    {
+                        ElemType sum = 0;
+                        for (size_t p = groupStarts[outerIndexSparse] - firstNonzero; p < groupStarts[outerIndexSparse + 1] - firstNonzero; p++)
+                            sum += values[p] * denseColumn[innerIndices[p]];
+
+                        if (denseTimesSparse)
+                            cData[outerIndexSparse * ldc + outerIndexDense] += alpha * sum;
+                        else /*Sparse times dense */
+                            cData[outerIndexDense * ldc + outerIndexSparse] += alpha * sum;
+                    }
                 }
             }
-        }
+        });
     }
 };
 
@@ -1019,24 +1218,24 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
             memset(c.Data() + m * blockSizePrev, 0, sizeof(ElemType) * m * (blockSizeCurr - blockSizePrev));
         }
 
-        for (size_t rhsCol = 0; rhsCol < rhs.GetNumCols(); rhsCol++)
-        {
-            size_t start = rhs.SecondaryIndexLocation()[rhsCol];
-            size_t end = rhs.SecondaryIndexLocation()[rhsCol + 1];
+        // Group the nonzeros of rhs by the block of c they are added to, then each block is the product of lhs and a sparse column.
+        // The blocks are filled in parallel, balanced by their number of nonzeros.
+        std::vector<CPUSPARSE_INDEX_TYPE> blockStarts, colIndices;
+        std::vector<ElemType> values;
+        GroupNonzerosByRow(rhs, blockSizeCurr, [&](size_t rhsRow) { return col2BlockId[rhsRow]; }, blockStarts, colIndices, values);
 
-            for (size_t p = start; p < end; p++)
+        const ElemType* lhsData = lhs.Data();
+        size_t ldLhs = lhs.GetNumRows();
+        ElemType* results = c.Buffer();
+        ForAllNonzeroGroups(blockStarts.data(), blockSizeCurr, values.size() * m, [&](size_t blockBegin, size_t blockEnd)
+        {
+            for (size_t blockId = blockBegin; blockId < blockEnd; blockId++)
             {
-                size_t rhsRow = rhs.MajorIndexLocation()[p];
-                ElemType val = rhs.Buffer()[p];
-
-                ElemType* results = c.Buffer() + col2BlockId[rhsRow] * m;
-                #pragma omp parallel for
-                for (int lhsRow = 0; lhsRow < (int)m; lhsRow++)
-                {
-                    results[lhsRow] += alpha * lhs((size_t)lhsRow, rhsCol) * val;
-                }
+                size_t begin = blockStarts[blockId];
+                size_t end = blockStarts[blockId + 1];
+                AddSparseColumnProduct(lhsData, ldLhs, colIndices.data() + begin, values.data() + begin, end - begin, alpha, results + blockId * m, m);
             }
-        }
+        });
     }
     else if (transposeA && !transposeB)
     {
@@ -1230,6 +1429,113 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// lazy momentum SGD update of the columns of this block-column gradient: smoothed gradient c, model functionValues
+// Before the current gradient is applied, each column catches up on the updates it skipped, see GetLazyMomentumCatchUp().
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::LazyNormalGrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                                               const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::LazyNormalGrad() only supports the block-column sparse format.");
+    if (c.IsEmpty())
+    {
+        c.RequireSize(GetNumRows(), GetNumCols());
+        c.SetValue(0.0);
+    }
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != GetNumCols() || functionValues.GetNumRows() != GetNumRows() || functionValues.GetNumCols() != GetNumCols())
+        LogicError("CPUSparseMatrix::LazyNormalGrad(): Dimensions of smoothed gradient and model must match the gradient.");
+
+    // the catch-up factors are computed upfront since lastUpdates is shared by all blocks
+    size_t numRows = GetNumRows();
+    long numBlocks = (long) GetBlockSize();
+    std::vector<ElemType> decays(numBlocks), moveFactors(numBlocks);
+    for (long j = 0; j < numBlocks; j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        GetLazyMomentumCatchUp(momentum, GetLazyUpdateSkippedSteps(lastUpdates, GetNumCols(), col, updateCount), decays[j], moveFactors[j]);
+        if (useNesterovMomentum) // (Nesterov moves the weights by the momentum term once more)
+            moveFactors[j] *= momentum;
+    }
+
+#pragma omp parallel for
+    for (long j = 0; j < numBlocks; j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        const ElemType* grad = Buffer() + j * numRows;
+        ElemType* smoothed = c.Data() + col * numRows;
+        ElemType* val = functionValues.Data() + col * numRows;
+        for (size_t i = 0; i < numRows; i++)
+        {
+            val[i] -= moveFactors[j] * smoothed[i];
+            ElemType g = (1 - momentum) * learnRatePerSample * grad[i];
+            smoothed[i] = momentum * decays[j] * smoothed[i] + g;
+            val[i] -= useNesterovMomentum ? momentum * smoothed[i] + g : smoothed[i];
+        }
+    }
+}
+
+// lazy FSAdaGrad update of the columns of this block-column gradient, see CPUMatrix::FSAdagrad() for the update itself
+// The skipped updates decay both accumulators; the momentum one keeps moving the weights meanwhile.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::LazyFSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                                              ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::LazyFSAdagrad() only supports the block-column sparse format.");
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || c.GetNumCols() < numColsNeeded)
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded || functionValues.GetNumRows() != GetNumRows() || functionValues.GetNumCols() != GetNumCols())
+        LogicError("CPUSparseMatrix::LazyFSAdagrad(): Dimensions of smoothed gradient and model must match the gradient.");
+
+    size_t numRows = GetNumRows();
+    long numBlocks = (long) GetBlockSize();
+    std::vector<ElemType> adaDecays(numBlocks), momDecays(numBlocks), moveFactors(numBlocks);
+    for (long j = 0; j < numBlocks; j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        size_t skipped = GetLazyUpdateSkippedSteps(lastUpdates, GetNumCols(), col, updateCount);
+        ElemType unused;
+        GetLazyMomentumCatchUp(adaWeight, skipped, adaDecays[j], unused);
+        GetLazyMomentumCatchUp(momentum > 0 ? momentum : 0, skipped, momDecays[j], moveFactors[j]);
+        moveFactors[j] *= learnRatePerSample;
+    }
+
+    size_t n = GetNumRows() * GetNumCols();
+#pragma omp parallel for
+    for (long j = 0; j < numBlocks; j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        const ElemType* grad = Buffer() + j * numRows;
+        ElemType* smoothAda = c.Data() + col * numRows;
+        ElemType* smoothMom = c.Data() + n + col * numRows;
+        ElemType* val = functionValues.Data() + col * numRows;
+        for (size_t i = 0; i < numRows; i++)
+        {
+            ElemType g = grad[i];
+            ElemType adaSqr = adaWeight * adaDecays[j] * smoothAda[i] + (1.0f - adaWeight) * g * g;
+            smoothAda[i] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType w = adaMul * ((ElemType) 1.0 / sqrt(adaSqr));
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+            if (momentum > 0.0f)
+            {
+                val[i] -= moveFactors[j] * smoothMom[i];
+                g = momentum * momDecays[j] * smoothMom[i] + (1.0f - momentum) * g;
+                smoothMom[i] = g;
+            }
+            val[i] -= learnRatePerSample * g;
+        }
+    }
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -1503,18 +1809,9 @@ MATH_API File& operator>>(File& stream, CPUSparseMatrix<ElemType>& us)
         CPUSPARSE_INDEX_TYPE* compressedIndex = us.SecondaryIndexLocation();
 
         // read in the sparse matrix info
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream >> dataBuffer[i];
-        }
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream >> unCompressedIndex[i];
-        }
-        for (size_t i = 0; i < compressedSize; ++i)
-        {
-            stream >> compressedIndex[i];
-        }
+        stream.ReadArray(dataBuffer, nz);
+        stream.ReadArray(unCompressedIndex, nz);
+        stream.ReadArray(compressedIndex, compressedSize);
     }
     stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
 
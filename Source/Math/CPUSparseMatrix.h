@@ -90,6 +90,7 @@ public:
     //void SetValue(const GPUSparseMatrix<ElemType>& /*val*/);
 
     void MaskColumnsValue(const CPUMatrix<char>& columnsMask, ElemType val);
+    void AssignOneHotColumns(const CPUMatrix<ElemType>& rowIndices, size_t numRows);
 
     CPUSparseMatrix<ElemType>& DoGatherColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUSparseMatrix<ElemType>& a, ElemType alpha);
     CPUSparseMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUSparseMatrix<ElemType>& a, ElemType alpha);
@@ -118,6 +119,10 @@ public:
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols);
 
+    // SparseBlockCol format: the ids of the non-zero columns and their values, one column per block
+    void SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols);
+    void GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const;
+
     // Dense * Sparse -> Dense
     static void MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                        const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c);
@@ -219,6 +224,11 @@ public:
 public:
     void NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    // lazy updates that touch only the columns of a block-column gradient, see Matrix::LazyNormalGrad()
+    void LazyNormalGrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                        const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum);
+    void LazyFSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                       ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
 
 public:
     CPUSparseMatrix<ElemType>& InplaceTruncateTop(const ElemType threshold);
@@ -0,0 +1,86 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernelTable.h -- interface between the dispatcher (CPUVectorKernels.cpp) and the kernels that are
+// compiled for one instruction set each (CPUVectorKernelsAVX2.cpp, CPUVectorKernelsAVX512.cpp).
+// This header must not pull in anything with inline code, as those files are compiled with different target options.
+//
+
+#pragma once
+
+#include <stddef.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Operations that have a vector kernel; the subset of ElementWiseOperator that maps to plain vector instructions.
+enum class VectorKernelOp
+{
+    // unary
+    Copy,
+    Negate,
+    Abs,
+    LinearRectifier,
+    Sqr,
+    // binary, and Sum, Max and Min as reductions
+    Sum,
+    Difference,
+    ElementwiseProduct,
+    Max,
+    Min,
+};
+
+// Number of rows of a panel of a packed matrix (PackedMatrixMultiplier): the matrix is stored as consecutive panels of
+// this many rows, each as k columns of contiguous rows, padded with zeros at the end of the last panel.
+static const size_t PackedPanelRows = 16;
+
+// The word that quantized values are packed into (ValueQuantizer::QWord), one per vector lane.
+template <class ElemType> struct QuantizedWordOf;
+template <> struct QuantizedWordOf<float>  { typedef unsigned int Type; };
+template <> struct QuantizedWordOf<double> { typedef unsigned long long Type; };
+
+// Number of subsets of the range statistics of a quantized column (ColumnQuantizer::RangeStatSubsets).
+static const size_t QuantizerRangeStatSubsets = 128;
+
+// Kernels over n contiguous elements, without threading. c = alpha * op(...) + beta * c, c is not read if beta == 0.
+template <class ElemType>
+struct CPUVectorKernelTable
+{
+    size_t width; // elements per vector
+    void (*unaryOp)(VectorKernelOp op, ElemType beta, const ElemType* a, ElemType alpha, ElemType* c, size_t n);
+    // a scalar input is broadcast to all n elements
+    void (*binaryOp)(VectorKernelOp op, ElemType beta, const ElemType* a, bool aIsScalar, const ElemType* b, bool bIsScalar, ElemType alpha, ElemType* c, size_t n);
+    // reduction(op(a[i]), i < n), sums are accumulated in double; n > 0
+    double (*reduce)(VectorKernelOp reductionOp, VectorKernelOp op, const ElemType* a, size_t n);
+    // c[i] = alpha * reduction(op(a[i + j * stride]), j < m) + beta * c[i] for i < n; m > 0
+    void (*reduceStrided)(VectorKernelOp reductionOp, VectorKernelOp op, ElemType beta, const ElemType* a, ptrdiff_t stride, size_t m, ElemType alpha, ElemType* c, size_t n);
+    // c[i + j * ldc] = alpha * sum(panel[d * PackedPanelRows + i] * b[d + j * ldb], d < k) + beta * c[i + j * ldc] for i < rows, j < n,
+    // the product of one panel of a packed matrix with column-major b; rows <= PackedPanelRows
+    void (*packedPanelProduct)(const ElemType* panel, size_t k, const ElemType* b, ptrdiff_t ldb, size_t n, ElemType beta, ElemType alpha, ElemType* c, ptrdiff_t ldc, size_t rows);
+    // c[i] += (alpha * values[p]) * a[i + indices[p] * lda] summed over p < count, for i < n,
+    // the product of a column-major a and a sparse column added to a column of c
+    void (*sparseColumnProduct)(const ElemType* a, ptrdiff_t lda, const int* indices, const ElemType* values, size_t count, ElemType alpha, ElemType* c, size_t n);
+
+    // Quantization of one column of n rows (ColumnQuantizer), with v[i] = a[i] + residual[i].
+    // The range statistics are summed in QuantizerRangeStatSubsets strided subsets, subset s over i = s, s + QuantizerRangeStatSubsets, ...
+    // in increasing order, like the CUDA threads of the GPU kernel: sums[s] = sum(v[i]), resp. sum((v[i] - mean)^2) if squares,
+    void (*quantizerSubsetSums)(const ElemType* a, const ElemType* residual, size_t n, bool squares, ElemType mean, ElemType* sums);
+    // and for 1 bit, sums0[s] = sum(v[i] where v[i] < mean), sums1[s] = sum(v[i] where v[i] >= mean), counts1[s] = #(v[i] >= mean).
+    void (*quantizerSubsetSums1Bit)(const ElemType* a, const ElemType* residual, size_t n, ElemType mean, ElemType* sums0, ElemType* sums1, unsigned int* counts1);
+    // 1-bit quantization of the words [0, numWords) of the column, with numWords a multiple of the vector width and
+    // wordsPerCol the number of words of the column; word w holds the bits of v[w], v[w + wordsPerCol], ...
+    // residualOut[i] = v[i] - (v[i] >= threshold ? val1 : val0); residualOut == residual is allowed.
+    void (*quantize1Bit)(const ElemType* a, const ElemType* residual, size_t n, size_t wordsPerCol, size_t numWords,
+                         ElemType threshold, ElemType val0, ElemType val1, typename QuantizedWordOf<ElemType>::Type* words, ElemType* residualOut);
+    // and the reverse: c[i] = (bit ? val1 : val0) (+ c[i] if add)
+    void (*unquantize1Bit)(const typename QuantizedWordOf<ElemType>::Type* words, size_t n, size_t wordsPerCol, size_t numWords,
+                           ElemType val0, ElemType val1, bool add, ElemType* c);
+};
+
+template <class ElemType>
+const CPUVectorKernelTable<ElemType>& GetCPUVectorKernelsAVX2();
+
+template <class ElemType>
+const CPUVectorKernelTable<ElemType>& GetCPUVectorKernelsAVX512();
+
+}}}
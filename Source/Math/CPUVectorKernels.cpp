@@ -0,0 +1,402 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernels.cpp -- runtime detection of the instruction set and dispatch to the vector kernels, including the threading.
+//
+
+#include "stdafx.h"
+#include "CPUVectorKernels.h"
+#include "CPUVectorKernelTable.h"
+#include <atomic>
+#include <omp.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// instruction set detection
+// -----------------------------------------------------------------------
+
+static void CpuId(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+{
+#ifdef _MSC_VER
+    __cpuidex(reinterpret_cast<int*>(registers), (int) leaf, (int) subleaf);
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// state components enabled by the OS (XCR0)
+static unsigned long long GetEnabledStateComponents()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+
+static CPUVectorInstructionSet DetectInstructionSet()
+{
+    unsigned int registers[4]; // eax, ebx, ecx, edx
+    CpuId(0, 0, registers);
+    unsigned int maxLeaf = registers[0];
+    if (maxLeaf < 7)
+        return CPUVectorInstructionSet::None;
+
+    CpuId(1, 0, registers);
+    bool osxsave = (registers[2] & (1u << 27)) != 0;
+    bool avx     = (registers[2] & (1u << 28)) != 0;
+    if (!osxsave || !avx)
+        return CPUVectorInstructionSet::None;
+
+    // the OS must save the YMM (and for AVX-512 the opmask and ZMM) registers
+    unsigned long long xcr0 = GetEnabledStateComponents();
+    bool ymmEnabled = (xcr0 & 0x06) == 0x06;
+    bool zmmEnabled = (xcr0 & 0xE6) == 0xE6;
+
+    CpuId(7, 0, registers);
+    bool avx2    = (registers[1] & (1u << 5)) != 0;
+    bool avx512f    = (registers[1] & (1u << 16)) != 0;
+    bool avx512bw   = (registers[1] & (1u << 30)) != 0;
+    bool avx512vnni = (registers[2] & (1u << 11)) != 0;
+
+    if (avx512f && avx512bw && zmmEnabled)
+        return avx512vnni ? CPUVectorInstructionSet::AVX512VNNI : CPUVectorInstructionSet::AVX512;
+    if (avx2 && ymmEnabled)
+        return CPUVectorInstructionSet::AVX2;
+    return CPUVectorInstructionSet::None;
+}
+
+static std::atomic<int> s_maxInstructionSet((int) CPUVectorInstructionSet::AVX512VNNI);
+
+CPUVectorInstructionSet GetCPUVectorInstructionSet()
+{
+    static const CPUVectorInstructionSet detected = DetectInstructionSet();
+    return (CPUVectorInstructionSet) std::min((int) detected, s_maxInstructionSet.load());
+}
+
+void SetMaxCPUVectorInstructionSet(CPUVectorInstructionSet maxInstructionSet)
+{
+    s_maxInstructionSet = (int) maxInstructionSet;
+}
+
+const char* ToString(CPUVectorInstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case CPUVectorInstructionSet::AVX2:       return "AVX2";
+    case CPUVectorInstructionSet::AVX512:     return "AVX-512";
+    case CPUVectorInstructionSet::AVX512VNNI: return "AVX-512 VNNI";
+    default:                                  return "none";
+    }
+}
+
+template <class ElemType>
+static const CPUVectorKernelTable<ElemType>* GetKernels()
+{
+    switch (GetCPUVectorInstructionSet())
+    {
+    case CPUVectorInstructionSet::AVX512VNNI:
+    case CPUVectorInstructionSet::AVX512:     return &GetCPUVectorKernelsAVX512<ElemType>();
+    case CPUVectorInstructionSet::AVX2:       return &GetCPUVectorKernelsAVX2<ElemType>();
+    default:                                  return nullptr;
+    }
+}
+
+// -----------------------------------------------------------------------
+// mapping of the operations
+// -----------------------------------------------------------------------
+
+static bool TryGetUnaryKernelOp(ElementWiseOperator op, VectorKernelOp& kernelOp)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opCopy:            kernelOp = VectorKernelOp::Copy;            return true;
+    case ElementWiseOperator::opNegate:          kernelOp = VectorKernelOp::Negate;          return true;
+    case ElementWiseOperator::opAbs:             kernelOp = VectorKernelOp::Abs;             return true;
+    case ElementWiseOperator::opLinearRectifier: kernelOp = VectorKernelOp::LinearRectifier; return true;
+    case ElementWiseOperator::opSqr:             kernelOp = VectorKernelOp::Sqr;             return true;
+    default:                                     return false;
+    }
+}
+
+static bool TryGetBinaryKernelOp(ElementWiseOperator op, VectorKernelOp& kernelOp)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opSum:                kernelOp = VectorKernelOp::Sum;                return true;
+    case ElementWiseOperator::opDifference:         kernelOp = VectorKernelOp::Difference;         return true;
+    case ElementWiseOperator::opElementwiseProduct: kernelOp = VectorKernelOp::ElementwiseProduct; return true;
+    case ElementWiseOperator::opMax:                kernelOp = VectorKernelOp::Max;                return true;
+    case ElementWiseOperator::opMin:                kernelOp = VectorKernelOp::Min;                return true;
+    default:                                        return false;
+    }
+}
+
+// LogSum has no kernel, it needs exp and log
+static bool TryGetReductionKernelOp(ElementWiseOperator op, VectorKernelOp& kernelOp)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opSum: kernelOp = VectorKernelOp::Sum; return true;
+    case ElementWiseOperator::opMax: kernelOp = VectorKernelOp::Max; return true;
+    case ElementWiseOperator::opMin: kernelOp = VectorKernelOp::Min; return true;
+    default:                         return false;
+    }
+}
+
+// -----------------------------------------------------------------------
+// threading
+// -----------------------------------------------------------------------
+
+// Below this number of elements the OpenMP overhead outweighs the gain.
+static const size_t s_minParallelElements = 32 * 1024;
+// Long rows are split into chunks of this size, so that a single row is processed in parallel as well.
+static const size_t s_chunkSize = 16 * 1024;
+
+// Calls fn(row, begin, end) for all chunks of all rows.
+template <class FN>
+static void ForAllChunks(size_t n, size_t m, const FN& fn)
+{
+    size_t chunksPerRow = (n + s_chunkSize - 1) / s_chunkSize;
+    long numChunks = (long) (chunksPerRow * m); // note: OpenMP requires loop indices to be signed
+    if (n * m < s_minParallelElements)
+    {
+        for (long chunk = 0; chunk < numChunks; chunk++)
+            fn(chunk / chunksPerRow, (chunk % chunksPerRow) * s_chunkSize, std::min(n, (chunk % chunksPerRow + 1) * s_chunkSize));
+    }
+    else
+    {
+#pragma omp parallel for
+        for (long chunk = 0; chunk < numChunks; chunk++)
+            fn(chunk / chunksPerRow, (chunk % chunksPerRow) * s_chunkSize, std::min(n, (chunk % chunksPerRow + 1) * s_chunkSize));
+    }
+}
+
+// -----------------------------------------------------------------------
+// entry points
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+bool CPUVectorKernels<ElemType>::UnaryOp(ElementWiseOperator op, ElemType beta, const ElemType* a, ElemType alpha, ElemType* c,
+                                         size_t n, size_t m, ptrdiff_t strideA, ptrdiff_t strideC)
+{
+    VectorKernelOp kernelOp;
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels || !TryGetUnaryKernelOp(op, kernelOp))
+        return false;
+
+    ForAllChunks(n, m, [&](size_t j, size_t begin, size_t end)
+    {
+        kernels->unaryOp(kernelOp, beta, a + j * strideA + begin, alpha, c + j * strideC + begin, end - begin);
+    });
+    return true;
+}
+
+template <class ElemType>
+bool CPUVectorKernels<ElemType>::BinaryOp(ElementWiseOperator op, ElemType beta, const ElemType* a, bool aIsScalar, const ElemType* b, bool bIsScalar, ElemType alpha, ElemType* c,
+                                          size_t n, size_t m, ptrdiff_t strideA, ptrdiff_t strideB, ptrdiff_t strideC)
+{
+    VectorKernelOp kernelOp;
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels || !TryGetBinaryKernelOp(op, kernelOp) || (aIsScalar && bIsScalar))
+        return false;
+
+    ForAllChunks(n, m, [&](size_t j, size_t begin, size_t end)
+    {
+        kernels->binaryOp(kernelOp, beta,
+                          a + j * strideA + (aIsScalar ? 0 : begin), aIsScalar,
+                          b + j * strideB + (bIsScalar ? 0 : begin), bIsScalar,
+                          alpha, c + j * strideC + begin, end - begin);
+    });
+    return true;
+}
+
+template <class ElemType>
+bool CPUVectorKernels<ElemType>::ReduceContiguous(ElementWiseOperator reductionOp, ElementWiseOperator op, ElemType beta, const ElemType* a, ElemType alpha, ElemType* c,
+                                                  size_t n, size_t m, ptrdiff_t strideA, ptrdiff_t strideC)
+{
+    VectorKernelOp kernelOp, kernelReductionOp;
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels || n == 0 || !TryGetUnaryKernelOp(op, kernelOp) || !TryGetReductionKernelOp(reductionOp, kernelReductionOp))
+        return false;
+
+    auto finish = [&](double aggregate, ElemType* out)
+    {
+        ElemType val = (ElemType) aggregate;
+        val *= alpha;
+        if (beta != 0)
+            val += beta * *out;
+        *out = val;
+    };
+
+    if (m == 1 && n >= s_minParallelElements)
+    {
+        // a single long row: reduce the chunks in parallel, then combine them in order, so that the result is deterministic
+        size_t numChunks = (n + s_chunkSize - 1) / s_chunkSize;
+        std::vector<double> partial(numChunks);
+#pragma omp parallel for
+        for (long chunk = 0; chunk < (long) numChunks; chunk++)
+        {
+            size_t begin = chunk * s_chunkSize;
+            partial[chunk] = kernels->reduce(kernelReductionOp, kernelOp, a + begin, std::min(n, begin + s_chunkSize) - begin);
+        }
+
+        double aggregate = partial[0];
+        for (size_t chunk = 1; chunk < numChunks; chunk++)
+        {
+            if (kernelReductionOp == VectorKernelOp::Sum)
+                aggregate += partial[chunk];
+            else if (kernelReductionOp == VectorKernelOp::Max)
+                aggregate = partial[chunk] > aggregate ? partial[chunk] : aggregate;
+            else
+                aggregate = partial[chunk] < aggregate ? partial[chunk] : aggregate;
+        }
+        finish(aggregate, c);
+    }
+    else if (n * m < s_minParallelElements)
+    {
+        for (size_t j = 0; j < m; j++)
+            finish(kernels->reduce(kernelReductionOp, kernelOp, a + j * strideA, n), c + j * strideC);
+    }
+    else
+    {
+#pragma omp parallel for
+        for (long j = 0; j < (long) m; j++)
+            finish(kernels->reduce(kernelReductionOp, kernelOp, a + j * strideA, n), c + j * strideC);
+    }
+    return true;
+}
+
+// The outputs are split into blocks that are reduced in parallel; a block is narrow enough that
+// the cache lines of all its rows stay in the cache while walking down the reduced dimension.
+static const size_t s_stridedBlockSize = 256;
+
+template <class ElemType>
+bool CPUVectorKernels<ElemType>::ReduceStrided(ElementWiseOperator reductionOp, ElementWiseOperator op, ElemType beta, const ElemType* a, ElemType alpha, ElemType* c,
+                                               size_t n, size_t m, ptrdiff_t strideA)
+{
+    VectorKernelOp kernelOp, kernelReductionOp;
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels || m == 0 || !TryGetUnaryKernelOp(op, kernelOp) || !TryGetReductionKernelOp(reductionOp, kernelReductionOp))
+        return false;
+
+    long numBlocks = (long) ((n + s_stridedBlockSize - 1) / s_stridedBlockSize);
+    if (n * m < s_minParallelElements || numBlocks == 1)
+    {
+        kernels->reduceStrided(kernelReductionOp, kernelOp, beta, a, strideA, m, alpha, c, n);
+    }
+    else
+    {
+#pragma omp parallel for
+        for (long block = 0; block < numBlocks; block++)
+        {
+            size_t begin = block * s_stridedBlockSize;
+            kernels->reduceStrided(kernelReductionOp, kernelOp, beta, a + begin, strideA, m, alpha, c + begin, std::min(n, begin + s_stridedBlockSize) - begin);
+        }
+    }
+    return true;
+}
+
+template <class ElemType>
+bool CPUVectorKernels<ElemType>::PackedProduct(const ElemType* packed, size_t m, size_t k, ElemType beta, const ElemType* b, ElemType alpha, ElemType* c, size_t n)
+{
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels)
+        return false;
+
+    long numPanels = (long) ((m + PackedPanelRows - 1) / PackedPanelRows);
+    auto panelProduct = [&](long panel)
+    {
+        size_t begin = panel * PackedPanelRows;
+        kernels->packedPanelProduct(packed + begin * k, k, b, k, n, beta, alpha, c + begin, m, std::min(m, begin + PackedPanelRows) - begin);
+    };
+    if (m * k * n < s_minParallelElements || numPanels == 1)
+    {
+        for (long panel = 0; panel < numPanels; panel++)
+            panelProduct(panel);
+    }
+    else
+    {
+#pragma omp parallel for
+        for (long panel = 0; panel < numPanels; panel++)
+            panelProduct(panel);
+    }
+    return true;
+}
+
+template <class ElemType>
+bool CPUVectorKernels<ElemType>::SparseColumnProduct(const ElemType* a, size_t lda, const CPUSPARSE_INDEX_TYPE* indices, const ElemType* values, size_t count,
+                                                     ElemType alpha, ElemType* c, size_t n)
+{
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels)
+        return false;
+
+    if (count > 0 && n > 0)
+        kernels->sparseColumnProduct(a, (ptrdiff_t) lda, indices, values, count, alpha, c, n);
+    return true;
+}
+
+template <class ElemType>
+bool CPUVectorKernels<ElemType>::QuantizerSubsetSums(const ElemType* a, const ElemType* residual, size_t n, bool squares, ElemType mean, ElemType* sums)
+{
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels)
+        return false;
+
+    kernels->quantizerSubsetSums(a, residual, n, squares, mean, sums);
+    return true;
+}
+
+template <class ElemType>
+bool CPUVectorKernels<ElemType>::QuantizerSubsetSums1Bit(const ElemType* a, const ElemType* residual, size_t n, ElemType mean, ElemType* sums0, ElemType* sums1, unsigned int* counts1)
+{
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels)
+        return false;
+
+    kernels->quantizerSubsetSums1Bit(a, residual, n, mean, sums0, sums1, counts1);
+    return true;
+}
+
+template <class ElemType>
+size_t CPUVectorKernels<ElemType>::Quantize1Bit(const ElemType* a, const ElemType* residual, size_t n, size_t wordsPerCol,
+                                                ElemType threshold, ElemType val0, ElemType val1, QWord* words, ElemType* residualOut)
+{
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels)
+        return 0;
+
+    size_t numWords = wordsPerCol - wordsPerCol % kernels->width;
+    if (numWords > 0)
+        kernels->quantize1Bit(a, residual, n, wordsPerCol, numWords, threshold, val0, val1, words, residualOut);
+    return numWords;
+}
+
+template <class ElemType>
+size_t CPUVectorKernels<ElemType>::Unquantize1Bit(const QWord* words, size_t n, size_t wordsPerCol, ElemType val0, ElemType val1, bool add, ElemType* c)
+{
+    const CPUVectorKernelTable<ElemType>* kernels = GetKernels<ElemType>();
+    if (!kernels)
+        return 0;
+
+    size_t numWords = wordsPerCol - wordsPerCol % kernels->width;
+    if (numWords > 0)
+        kernels->unquantize1Bit(words, n, wordsPerCol, numWords, val0, val1, add, c);
+    return numWords;
+}
+
+template struct CPUVectorKernels<float>;
+template struct CPUVectorKernels<double>;
+
+}}}
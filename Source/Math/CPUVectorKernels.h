@@ -0,0 +1,83 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernels.h -- explicitly vectorized (AVX2, AVX-512) versions of the most common tensor operations of CPUMatrix,
+// selected at runtime by the instruction set of the CPU.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include "CPUVectorKernelTable.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Instruction sets with vector kernels, in increasing order.
+enum class CPUVectorInstructionSet
+{
+    None, // generic loops only
+    AVX2,
+    AVX512,     // AVX-512 F and BW (Skylake-SP)
+    AVX512VNNI, // AVX-512 with the dot product instructions (Cascade Lake); the vector kernels are those of AVX512
+};
+
+// Highest instruction set supported by the CPU and the OS, limited by SetMaxCPUVectorInstructionSet().
+MATH_API CPUVectorInstructionSet GetCPUVectorInstructionSet();
+
+// Limits the instruction set of the kernels, e.g. None to compare against the generic loops.
+MATH_API void SetMaxCPUVectorInstructionSet(CPUVectorInstructionSet maxInstructionSet);
+
+MATH_API const char* ToString(CPUVectorInstructionSet instructionSet);
+
+// The operations run over m rows of n contiguous elements each, consecutive rows of an operand are strideX elements apart.
+// They compute c = alpha * op(a, b) + beta * c with the same arithmetic as the generic loops of CPUMatrix::TensorOp,
+// and do not read c if beta == 0. Rows are processed in parallel with OpenMP if there is enough work.
+// Each function returns false without doing anything if there is no kernel for the operation or for the CPU,
+// the caller then falls back to the generic loops.
+template <class ElemType>
+struct MATH_API CPUVectorKernels
+{
+    // Copy, Negate, Abs, LinearRectifier, Sqr
+    static bool UnaryOp(ElementWiseOperator op, ElemType beta, const ElemType* a, ElemType alpha, ElemType* c,
+                        size_t n, size_t m, ptrdiff_t strideA, ptrdiff_t strideC);
+
+    // Sum, Difference, ElementwiseProduct, Max, Min
+    // An input that is a scalar (aIsScalar, bIsScalar) is broadcast to all n elements of the row.
+    static bool BinaryOp(ElementWiseOperator op, ElemType beta, const ElemType* a, bool aIsScalar, const ElemType* b, bool bIsScalar, ElemType alpha, ElemType* c,
+                         size_t n, size_t m, ptrdiff_t strideA, ptrdiff_t strideB, ptrdiff_t strideC);
+
+    // Reduction (Sum, Max, Min) of each row to one value:
+    // c[j * strideC] = alpha * reduction(op(a[j * strideA + i]), i < n) + beta * c[j * strideC] for j < m.
+    // Sums are accumulated in double.
+    static bool ReduceContiguous(ElementWiseOperator reductionOp, ElementWiseOperator op, ElemType beta, const ElemType* a, ElemType alpha, ElemType* c,
+                                 size_t n, size_t m, ptrdiff_t strideA, ptrdiff_t strideC);
+
+    // Reduction across the rows, i.e. along a strided dimension, into n contiguous values:
+    // c[i] = alpha * reduction(op(a[j * strideA + i]), j < m) + beta * c[i] for i < n.
+    static bool ReduceStrided(ElementWiseOperator reductionOp, ElementWiseOperator op, ElemType beta, const ElemType* a, ElemType alpha, ElemType* c,
+                              size_t n, size_t m, ptrdiff_t strideA);
+
+    // Product of a packed matrix (see PackedMatrixMultiplier) with k rows and the column-major b [k x n]:
+    // c = alpha * A * b + beta * c for the column-major c [m x n]. The panels are processed in parallel.
+    static bool PackedProduct(const ElemType* packed, size_t m, size_t k, ElemType beta, const ElemType* b, ElemType alpha, ElemType* c, size_t n);
+
+    // Product of the column-major a [n x *] (leading dimension lda) and a sparse column with count nonzeros, added to the column c [n]:
+    // c[i] += alpha * sum(values[p] * a[i + indices[p] * lda], p < count). This one is not threaded, CPUSparseMatrix calls it
+    // from its own parallel loops over the columns of the result.
+    static bool SparseColumnProduct(const ElemType* a, size_t lda, const CPUSPARSE_INDEX_TYPE* indices, const ElemType* values, size_t count,
+                                    ElemType alpha, ElemType* c, size_t n);
+
+    // Quantization of one column of n rows, see the kernels of the same name in CPUVectorKernelTable. Not threaded either,
+    // MatrixQuantizerCPU calls them from its parallel loop over the columns.
+    typedef typename QuantizedWordOf<ElemType>::Type QWord;
+    static bool QuantizerSubsetSums(const ElemType* a, const ElemType* residual, size_t n, bool squares, ElemType mean, ElemType* sums);
+    static bool QuantizerSubsetSums1Bit(const ElemType* a, const ElemType* residual, size_t n, ElemType mean, ElemType* sums0, ElemType* sums1, unsigned int* counts1);
+    // These two process the first words of the column, as many as fill whole vectors, and return their number
+    // (0 without kernels); the caller does the remaining ones.
+    static size_t Quantize1Bit(const ElemType* a, const ElemType* residual, size_t n, size_t wordsPerCol,
+                               ElemType threshold, ElemType val0, ElemType val1, QWord* words, ElemType* residualOut);
+    static size_t Unquantize1Bit(const QWord* words, size_t n, size_t wordsPerCol, ElemType val0, ElemType val1, bool add, ElemType* c);
+};
+
+}}}
@@ -0,0 +1,118 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernelsAVX2.cpp -- vector kernels for AVX2. This file is compiled with AVX2 code generation (see Makefile and
+// Math.vcxproj) and must only be called after the runtime check in CPUVectorKernels.cpp, so it includes nothing but intrinsics.
+//
+
+#include <immintrin.h>
+#include "CPUVectorKernelsImpl.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace VectorKernels {
+
+struct AVX2Float
+{
+    typedef float Elem;
+    typedef __m256 Vec;
+    typedef __m256d Acc;
+    enum { width = 8, accPerVec = 2 };
+
+    static inline Vec Load(const float* p)  { return _mm256_loadu_ps(p); }
+    static inline void Store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+    static inline Vec Set1(float v)         { return _mm256_set1_ps(v); }
+    static inline Vec Zero()                { return _mm256_setzero_ps(); }
+    static inline Vec Add(Vec a, Vec b)     { return _mm256_add_ps(a, b); }
+    static inline Vec Sub(Vec a, Vec b)     { return _mm256_sub_ps(a, b); }
+    static inline Vec Mul(Vec a, Vec b)     { return _mm256_mul_ps(a, b); }
+    static inline Vec Max(Vec a, Vec b)     { return _mm256_max_ps(a, b); }
+    static inline Vec Min(Vec a, Vec b)     { return _mm256_min_ps(a, b); }
+    static inline Vec Abs(Vec a)            { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static inline Vec Negate(Vec a)         { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+
+    // sums are accumulated in double, like the scalar reductions
+    static inline Acc AccZero() { return _mm256_setzero_pd(); }
+    static inline void Accumulate(Acc* acc, Vec v)
+    {
+        acc[0] = _mm256_add_pd(acc[0], _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+        acc[1] = _mm256_add_pd(acc[1], _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+    }
+    static inline void StoreAcc(double* p, const Acc* acc)
+    {
+        _mm256_storeu_pd(p, acc[0]);
+        _mm256_storeu_pd(p + 4, acc[1]);
+    }
+
+    // comparisons, and the packed words of quantization
+    typedef __m256 Mask;
+    typedef unsigned int Word;
+    static inline Mask CmpGE(Vec a, Vec b)                    { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static inline Mask CmpNotLT(Vec a, Vec b)                 { return _mm256_cmp_ps(a, b, _CMP_NLT_UQ); }
+    static inline Vec Select(Mask m, Vec ifTrue, Vec ifFalse) { return _mm256_blendv_ps(ifFalse, ifTrue, m); }
+    static inline Vec LoadWords(const Word* p)                { return _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*) p)); }
+    static inline void StoreWords(Word* p, Vec v)             { _mm256_storeu_si256((__m256i*) p, _mm256_castps_si256(v)); }
+    static inline Vec SetBit(Vec bits, Mask m, size_t k)      { return _mm256_or_ps(bits, _mm256_and_ps(m, _mm256_castsi256_ps(_mm256_set1_epi32((int) (1u << k))))); }
+    static inline Mask TestBit(Vec bits, size_t k)
+    {
+        __m256i bit = _mm256_set1_epi32((int) (1u << k));
+        return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_castps_si256(bits), bit), bit));
+    }
+};
+
+struct AVX2Double
+{
+    typedef double Elem;
+    typedef __m256d Vec;
+    typedef __m256d Acc;
+    enum { width = 4, accPerVec = 1 };
+
+    static inline Vec Load(const double* p)  { return _mm256_loadu_pd(p); }
+    static inline void Store(double* p, Vec v) { _mm256_storeu_pd(p, v); }
+    static inline Vec Set1(double v)         { return _mm256_set1_pd(v); }
+    static inline Vec Zero()                 { return _mm256_setzero_pd(); }
+    static inline Vec Add(Vec a, Vec b)      { return _mm256_add_pd(a, b); }
+    static inline Vec Sub(Vec a, Vec b)      { return _mm256_sub_pd(a, b); }
+    static inline Vec Mul(Vec a, Vec b)      { return _mm256_mul_pd(a, b); }
+    static inline Vec Max(Vec a, Vec b)      { return _mm256_max_pd(a, b); }
+    static inline Vec Min(Vec a, Vec b)      { return _mm256_min_pd(a, b); }
+    static inline Vec Abs(Vec a)             { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static inline Vec Negate(Vec a)          { return _mm256_xor_pd(_mm256_set1_pd(-0.0), a); }
+
+    static inline Acc AccZero() { return _mm256_setzero_pd(); }
+    static inline void Accumulate(Acc* acc, Vec v) { acc[0] = _mm256_add_pd(acc[0], v); }
+    static inline void StoreAcc(double* p, const Acc* acc) { _mm256_storeu_pd(p, acc[0]); }
+
+    typedef __m256d Mask;
+    typedef unsigned long long Word;
+    static inline Mask CmpGE(Vec a, Vec b)                    { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static inline Mask CmpNotLT(Vec a, Vec b)                 { return _mm256_cmp_pd(a, b, _CMP_NLT_UQ); }
+    static inline Vec Select(Mask m, Vec ifTrue, Vec ifFalse) { return _mm256_blendv_pd(ifFalse, ifTrue, m); }
+    static inline Vec LoadWords(const Word* p)                { return _mm256_castsi256_pd(_mm256_loadu_si256((const __m256i*) p)); }
+    static inline void StoreWords(Word* p, Vec v)             { _mm256_storeu_si256((__m256i*) p, _mm256_castpd_si256(v)); }
+    static inline Vec SetBit(Vec bits, Mask m, size_t k)      { return _mm256_or_pd(bits, _mm256_and_pd(m, _mm256_castsi256_pd(_mm256_set1_epi64x((long long) (1ull << k))))); }
+    static inline Mask TestBit(Vec bits, size_t k)
+    {
+        __m256i bit = _mm256_set1_epi64x((long long) (1ull << k));
+        return _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_castpd_si256(bits), bit), bit));
+    }
+};
+
+}
+
+template <>
+const CPUVectorKernelTable<float>& GetCPUVectorKernelsAVX2<float>()
+{
+    static const CPUVectorKernelTable<float> table = VectorKernels::MakeKernelTable<VectorKernels::AVX2Float>();
+    return table;
+}
+
+template <>
+const CPUVectorKernelTable<double>& GetCPUVectorKernelsAVX2<double>()
+{
+    static const CPUVectorKernelTable<double> table = VectorKernels::MakeKernelTable<VectorKernels::AVX2Double>();
+    return table;
+}
+
+}}}
@@ -0,0 +1,118 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernelsAVX512.cpp -- vector kernels for AVX-512 (AVX512F only). This file is compiled with AVX-512 code generation
+// (see Makefile) and must only be called after the runtime check in CPUVectorKernels.cpp, so it includes nothing but intrinsics.
+//
+
+#include <immintrin.h>
+#include "CPUVectorKernelsImpl.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace VectorKernels {
+
+// Abs and Negate are done on the integer representation, since the floating point logic instructions need AVX512DQ.
+struct AVX512Float
+{
+    typedef float Elem;
+    typedef __m512 Vec;
+    typedef __m512d Acc;
+    enum { width = 16, accPerVec = 2 };
+
+    static inline Vec Load(const float* p)  { return _mm512_loadu_ps(p); }
+    static inline void Store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+    static inline Vec Set1(float v)         { return _mm512_set1_ps(v); }
+    static inline Vec Zero()                { return _mm512_setzero_ps(); }
+    static inline Vec Add(Vec a, Vec b)     { return _mm512_add_ps(a, b); }
+    static inline Vec Sub(Vec a, Vec b)     { return _mm512_sub_ps(a, b); }
+    static inline Vec Mul(Vec a, Vec b)     { return _mm512_mul_ps(a, b); }
+    static inline Vec Max(Vec a, Vec b)     { return _mm512_max_ps(a, b); }
+    static inline Vec Min(Vec a, Vec b)     { return _mm512_min_ps(a, b); }
+    static inline Vec Abs(Vec a)            { return _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(a), _mm512_set1_epi32(0x7FFFFFFF))); }
+    static inline Vec Negate(Vec a)         { return _mm512_castsi512_ps(_mm512_xor_epi32(_mm512_castps_si512(a), _mm512_set1_epi32((int) 0x80000000))); }
+
+    static inline Acc AccZero() { return _mm512_setzero_pd(); }
+    static inline void Accumulate(Acc* acc, Vec v)
+    {
+        acc[0] = _mm512_add_pd(acc[0], _mm512_cvtps_pd(_mm512_castps512_ps256(v)));
+        acc[1] = _mm512_add_pd(acc[1], _mm512_cvtps_pd(_mm256_castsi256_ps(_mm512_extracti64x4_epi64(_mm512_castps_si512(v), 1))));
+    }
+    static inline void StoreAcc(double* p, const Acc* acc)
+    {
+        _mm512_storeu_pd(p, acc[0]);
+        _mm512_storeu_pd(p + 8, acc[1]);
+    }
+
+    // comparisons, and the packed words of quantization
+    typedef __mmask16 Mask;
+    typedef unsigned int Word;
+    static inline Mask CmpGE(Vec a, Vec b)                    { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static inline Mask CmpNotLT(Vec a, Vec b)                 { return _mm512_cmp_ps_mask(a, b, _CMP_NLT_UQ); }
+    static inline Vec Select(Mask m, Vec ifTrue, Vec ifFalse) { return _mm512_mask_blend_ps(m, ifFalse, ifTrue); }
+    static inline Vec LoadWords(const Word* p)                { return _mm512_castsi512_ps(_mm512_loadu_si512(p)); }
+    static inline void StoreWords(Word* p, Vec v)             { _mm512_storeu_si512(p, _mm512_castps_si512(v)); }
+    static inline Vec SetBit(Vec bits, Mask m, size_t k)
+    {
+        __m512i b = _mm512_castps_si512(bits);
+        return _mm512_castsi512_ps(_mm512_mask_or_epi32(b, m, b, _mm512_set1_epi32((int) (1u << k))));
+    }
+    static inline Mask TestBit(Vec bits, size_t k)            { return _mm512_test_epi32_mask(_mm512_castps_si512(bits), _mm512_set1_epi32((int) (1u << k))); }
+};
+
+struct AVX512Double
+{
+    typedef double Elem;
+    typedef __m512d Vec;
+    typedef __m512d Acc;
+    enum { width = 8, accPerVec = 1 };
+
+    static inline Vec Load(const double* p)  { return _mm512_loadu_pd(p); }
+    static inline void Store(double* p, Vec v) { _mm512_storeu_pd(p, v); }
+    static inline Vec Set1(double v)         { return _mm512_set1_pd(v); }
+    static inline Vec Zero()                 { return _mm512_setzero_pd(); }
+    static inline Vec Add(Vec a, Vec b)      { return _mm512_add_pd(a, b); }
+    static inline Vec Sub(Vec a, Vec b)      { return _mm512_sub_pd(a, b); }
+    static inline Vec Mul(Vec a, Vec b)      { return _mm512_mul_pd(a, b); }
+    static inline Vec Max(Vec a, Vec b)      { return _mm512_max_pd(a, b); }
+    static inline Vec Min(Vec a, Vec b)      { return _mm512_min_pd(a, b); }
+    static inline Vec Abs(Vec a)             { return _mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(a), _mm512_set1_epi64(0x7FFFFFFFFFFFFFFFLL))); }
+    static inline Vec Negate(Vec a)          { return _mm512_castsi512_pd(_mm512_xor_epi64(_mm512_castpd_si512(a), _mm512_set1_epi64((long long) 0x8000000000000000ULL))); }
+
+    static inline Acc AccZero() { return _mm512_setzero_pd(); }
+    static inline void Accumulate(Acc* acc, Vec v) { acc[0] = _mm512_add_pd(acc[0], v); }
+    static inline void StoreAcc(double* p, const Acc* acc) { _mm512_storeu_pd(p, acc[0]); }
+
+    typedef __mmask8 Mask;
+    typedef unsigned long long Word;
+    static inline Mask CmpGE(Vec a, Vec b)                    { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+    static inline Mask CmpNotLT(Vec a, Vec b)                 { return _mm512_cmp_pd_mask(a, b, _CMP_NLT_UQ); }
+    static inline Vec Select(Mask m, Vec ifTrue, Vec ifFalse) { return _mm512_mask_blend_pd(m, ifFalse, ifTrue); }
+    static inline Vec LoadWords(const Word* p)                { return _mm512_castsi512_pd(_mm512_loadu_si512(p)); }
+    static inline void StoreWords(Word* p, Vec v)             { _mm512_storeu_si512(p, _mm512_castpd_si512(v)); }
+    static inline Vec SetBit(Vec bits, Mask m, size_t k)
+    {
+        __m512i b = _mm512_castpd_si512(bits);
+        return _mm512_castsi512_pd(_mm512_mask_or_epi64(b, m, b, _mm512_set1_epi64((long long) (1ull << k))));
+    }
+    static inline Mask TestBit(Vec bits, size_t k)            { return _mm512_test_epi64_mask(_mm512_castpd_si512(bits), _mm512_set1_epi64((long long) (1ull << k))); }
+};
+
+}
+
+template <>
+const CPUVectorKernelTable<float>& GetCPUVectorKernelsAVX512<float>()
+{
+    static const CPUVectorKernelTable<float> table = VectorKernels::MakeKernelTable<VectorKernels::AVX512Float>();
+    return table;
+}
+
+template <>
+const CPUVectorKernelTable<double>& GetCPUVectorKernelsAVX512<double>()
+{
+    static const CPUVectorKernelTable<double> table = VectorKernels::MakeKernelTable<VectorKernels::AVX512Double>();
+    return table;
+}
+
+}}}
@@ -0,0 +1,640 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernelsImpl.h -- the vector kernels of CPUVectorKernelTable, written once against a traits class of the
+// instruction set (vector type, width, loads, stores and arithmetic). Only included by the files that instantiate them.
+//
+// The arithmetic is the same as in the scalar loops of CPUMatrix::TensorOp (TensorOps.h), multiply and add are not fused,
+// so elementwise results are identical. Partial vectors at the end are processed through a padded buffer rather than
+// with scalar code, so that all elements use the same instructions.
+//
+
+#pragma once
+
+#include "CPUVectorKernelTable.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace VectorKernels {
+
+// -----------------------------------------------------------------------
+// partial loads and stores
+// -----------------------------------------------------------------------
+
+template <class T>
+static inline typename T::Vec LoadPartial(const typename T::Elem* p, size_t k, typename T::Elem padding = 0)
+{
+    typename T::Elem buffer[T::width];
+    for (size_t i = 0; i < T::width; i++)
+        buffer[i] = i < k ? p[i] : padding;
+    return T::Load(buffer);
+}
+
+template <class T>
+static inline void StorePartial(typename T::Elem* p, size_t k, typename T::Vec v)
+{
+    typename T::Elem buffer[T::width];
+    T::Store(buffer, v);
+    for (size_t i = 0; i < k; i++)
+        p[i] = buffer[i];
+}
+
+// -----------------------------------------------------------------------
+// operations
+// -----------------------------------------------------------------------
+
+template <class T> struct VecCopy               { static inline typename T::Vec Apply(typename T::Vec a) { return a; } };
+template <class T> struct VecNegate             { static inline typename T::Vec Apply(typename T::Vec a) { return T::Negate(a); } };
+template <class T> struct VecAbs                { static inline typename T::Vec Apply(typename T::Vec a) { return T::Abs(a); } };
+template <class T> struct VecLinearRectifier    { static inline typename T::Vec Apply(typename T::Vec a) { return T::Max(a, T::Zero()); } }; // a > 0 ? a : 0
+template <class T> struct VecSqr                { static inline typename T::Vec Apply(typename T::Vec a) { return T::Mul(a, a); } };
+
+template <class T> struct VecSum                { static inline typename T::Vec Apply(typename T::Vec a, typename T::Vec b) { return T::Add(a, b); } };
+template <class T> struct VecDifference         { static inline typename T::Vec Apply(typename T::Vec a, typename T::Vec b) { return T::Sub(a, b); } };
+template <class T> struct VecElementwiseProduct { static inline typename T::Vec Apply(typename T::Vec a, typename T::Vec b) { return T::Mul(a, b); } };
+template <class T> struct VecMax                { static inline typename T::Vec Apply(typename T::Vec a, typename T::Vec b) { return T::Max(a, b); } }; // a > b ? a : b
+template <class T> struct VecMin                { static inline typename T::Vec Apply(typename T::Vec a, typename T::Vec b) { return T::Min(a, b); } }; // a < b ? a : b
+
+// -----------------------------------------------------------------------
+// elementwise
+// -----------------------------------------------------------------------
+
+template <class T, class Op>
+struct UnaryArgs
+{
+    const typename T::Elem* m_a;
+
+    UnaryArgs(const typename T::Elem* a) : m_a(a) { }
+    typename T::Vec Get(size_t i) const                { return Op::Apply(T::Load(m_a + i)); }
+    typename T::Vec GetPartial(size_t i, size_t k) const { return Op::Apply(LoadPartial<T>(m_a + i, k)); }
+};
+
+template <class T, class Op, bool aIsScalar, bool bIsScalar>
+struct BinaryArgs
+{
+    const typename T::Elem* m_a;
+    const typename T::Elem* m_b;
+    typename T::Vec m_scalarA;
+    typename T::Vec m_scalarB;
+
+    BinaryArgs(const typename T::Elem* a, const typename T::Elem* b)
+        : m_a(a), m_b(b), m_scalarA(T::Set1(*a)), m_scalarB(T::Set1(*b))
+    {
+    }
+    typename T::Vec Get(size_t i) const
+    {
+        return Op::Apply(aIsScalar ? m_scalarA : T::Load(m_a + i), bIsScalar ? m_scalarB : T::Load(m_b + i));
+    }
+    typename T::Vec GetPartial(size_t i, size_t k) const
+    {
+        return Op::Apply(aIsScalar ? m_scalarA : LoadPartial<T>(m_a + i, k), bIsScalar ? m_scalarB : LoadPartial<T>(m_b + i, k));
+    }
+};
+
+// c = alpha * args + beta * c, as in TensorOpIteration
+template <class T, class Args>
+static void ElementwiseLoop(const Args& args, typename T::Elem beta, typename T::Elem alpha, typename T::Elem* c, size_t n)
+{
+    const size_t W = T::width;
+    typename T::Vec valpha = T::Set1(alpha);
+    typename T::Vec vbeta = T::Set1(beta);
+    size_t i = 0;
+    if (beta != 0)
+    {
+        for (; i + W <= n; i += W)
+            T::Store(c + i, T::Add(T::Mul(args.Get(i), valpha), T::Mul(vbeta, T::Load(c + i))));
+    }
+    else
+    {
+        for (; i + W <= n; i += W)
+            T::Store(c + i, T::Mul(args.Get(i), valpha));
+    }
+    if (i < n)
+    {
+        size_t k = n - i;
+        typename T::Vec v = T::Mul(args.GetPartial(i, k), valpha);
+        if (beta != 0)
+            v = T::Add(v, T::Mul(vbeta, LoadPartial<T>(c + i, k)));
+        StorePartial<T>(c + i, k, v);
+    }
+}
+
+#define CaseUnaryVectorOp(oper) \
+    case VectorKernelOp::oper:  \
+        return ElementwiseLoop<T>(UnaryArgs<T, Vec##oper<T>>(a), beta, alpha, c, n)
+
+template <class T>
+static void UnaryOp(VectorKernelOp op, typename T::Elem beta, const typename T::Elem* a, typename T::Elem alpha, typename T::Elem* c, size_t n)
+{
+    switch (op)
+    {
+        CaseUnaryVectorOp(Copy);
+        CaseUnaryVectorOp(Negate);
+        CaseUnaryVectorOp(Abs);
+        CaseUnaryVectorOp(LinearRectifier);
+        CaseUnaryVectorOp(Sqr);
+    default:
+        break; // the dispatcher only passes supported ops
+    }
+}
+
+#undef CaseUnaryVectorOp
+
+template <class T, class Op>
+static void BinaryLoop(typename T::Elem beta, const typename T::Elem* a, bool aIsScalar, const typename T::Elem* b, bool bIsScalar, typename T::Elem alpha, typename T::Elem* c, size_t n)
+{
+    if (aIsScalar)
+        ElementwiseLoop<T>(BinaryArgs<T, Op, true, false>(a, b), beta, alpha, c, n);
+    else if (bIsScalar)
+        ElementwiseLoop<T>(BinaryArgs<T, Op, false, true>(a, b), beta, alpha, c, n);
+    else
+        ElementwiseLoop<T>(BinaryArgs<T, Op, false, false>(a, b), beta, alpha, c, n);
+}
+
+#define CaseBinaryVectorOp(oper) \
+    case VectorKernelOp::oper:   \
+        return BinaryLoop<T, Vec##oper<T>>(beta, a, aIsScalar, b, bIsScalar, alpha, c, n)
+
+template <class T>
+static void BinaryOp(VectorKernelOp op, typename T::Elem beta, const typename T::Elem* a, bool aIsScalar, const typename T::Elem* b, bool bIsScalar, typename T::Elem alpha, typename T::Elem* c, size_t n)
+{
+    switch (op)
+    {
+        CaseBinaryVectorOp(Sum);
+        CaseBinaryVectorOp(Difference);
+        CaseBinaryVectorOp(ElementwiseProduct);
+        CaseBinaryVectorOp(Max);
+        CaseBinaryVectorOp(Min);
+    default:
+        break;
+    }
+}
+
+#undef CaseBinaryVectorOp
+
+// -----------------------------------------------------------------------
+// reductions
+// -----------------------------------------------------------------------
+
+// sum over contiguous elements, in double; padding with 0 does not change the sum of any of the unary ops
+template <class T, class Op>
+static double SumLoop(const typename T::Elem* a, size_t n)
+{
+    const size_t W = T::width;
+    typename T::Acc acc[T::accPerVec];
+    for (size_t q = 0; q < T::accPerVec; q++)
+        acc[q] = T::AccZero();
+
+    size_t i = 0;
+    for (; i + W <= n; i += W)
+        T::Accumulate(acc, Op::Apply(T::Load(a + i)));
+    if (i < n)
+        T::Accumulate(acc, Op::Apply(LoadPartial<T>(a + i, n - i)));
+
+    double lanes[W];
+    T::StoreAcc(lanes, acc);
+    double sum = 0;
+    for (size_t q = 0; q < W; q++)
+        sum += lanes[q];
+    return sum;
+}
+
+// max or min over contiguous elements; padding with an element of the input does not change the result
+template <class T, class Op, class ReductionOp>
+static double MinMaxLoop(const typename T::Elem* a, size_t n)
+{
+    const size_t W = T::width;
+    typename T::Vec aggregate = Op::Apply(T::Set1(a[0]));
+
+    size_t i = 0;
+    for (; i + W <= n; i += W)
+        aggregate = ReductionOp::Apply(aggregate, Op::Apply(T::Load(a + i)));
+    if (i < n)
+        aggregate = ReductionOp::Apply(aggregate, Op::Apply(LoadPartial<T>(a + i, n - i, a[i])));
+
+    typename T::Elem lanes[W];
+    T::Store(lanes, aggregate);
+    typename T::Vec result = T::Set1(lanes[0]);
+    for (size_t q = 1; q < W; q++)
+        result = ReductionOp::Apply(result, T::Set1(lanes[q]));
+    T::Store(lanes, result);
+    return (double) lanes[0];
+}
+
+// The strided reductions process a vector of outputs at a time and walk down the reduced dimension,
+// adding in the same order as the scalar loops.
+template <class T>
+static inline void StoreReductionResult(const double* lanes, typename T::Elem beta, typename T::Elem alpha, typename T::Elem* c, size_t k)
+{
+    for (size_t q = 0; q < k; q++)
+    {
+        typename T::Elem val = (typename T::Elem) lanes[q];
+        val *= alpha;
+        if (beta != 0)
+            val += beta * c[q];
+        c[q] = val;
+    }
+}
+
+template <class T, class Op>
+static void SumStridedLoop(typename T::Elem beta, const typename T::Elem* a, ptrdiff_t stride, size_t m, typename T::Elem alpha, typename T::Elem* c, size_t n)
+{
+    const size_t W = T::width;
+    for (size_t i = 0; i < n; i += W)
+    {
+        size_t k = n - i < W ? n - i : W;
+        typename T::Acc acc[T::accPerVec];
+        for (size_t q = 0; q < T::accPerVec; q++)
+            acc[q] = T::AccZero();
+
+        const typename T::Elem* p = a + i;
+        for (size_t j = 0; j < m; j++, p += stride)
+            T::Accumulate(acc, Op::Apply(k == W ? T::Load(p) : LoadPartial<T>(p, k)));
+
+        double lanes[W];
+        T::StoreAcc(lanes, acc);
+        StoreReductionResult<T>(lanes, beta, alpha, c + i, k);
+    }
+}
+
+template <class T, class Op, class ReductionOp>
+static void MinMaxStridedLoop(typename T::Elem beta, const typename T::Elem* a, ptrdiff_t stride, size_t m, typename T::Elem alpha, typename T::Elem* c, size_t n)
+{
+    const size_t W = T::width;
+    for (size_t i = 0; i < n; i += W)
+    {
+        size_t k = n - i < W ? n - i : W;
+        const typename T::Elem* p = a + i;
+        typename T::Vec aggregate = Op::Apply(k == W ? T::Load(p) : LoadPartial<T>(p, k));
+        p += stride;
+        for (size_t j = 1; j < m; j++, p += stride)
+            aggregate = ReductionOp::Apply(aggregate, Op::Apply(k == W ? T::Load(p) : LoadPartial<T>(p, k)));
+
+        typename T::Elem values[W];
+        T::Store(values, aggregate);
+        double lanes[W];
+        for (size_t q = 0; q < W; q++)
+            lanes[q] = values[q];
+        StoreReductionResult<T>(lanes, beta, alpha, c + i, k);
+    }
+}
+
+#define CaseReductionVectorOp(oper)                                                                           \
+    case VectorKernelOp::oper:                                                                                \
+        switch (reductionOp)                                                                                  \
+        {                                                                                                     \
+        case VectorKernelOp::Sum: return SumLoop<T, Vec##oper<T>>(a, n);                                      \
+        case VectorKernelOp::Max: return MinMaxLoop<T, Vec##oper<T>, VecMax<T>>(a, n);                        \
+        case VectorKernelOp::Min: return MinMaxLoop<T, Vec##oper<T>, VecMin<T>>(a, n);                        \
+        default: return 0;                                                                                    \
+        }
+
+template <class T>
+static double Reduce(VectorKernelOp reductionOp, VectorKernelOp op, const typename T::Elem* a, size_t n)
+{
+    switch (op)
+    {
+        CaseReductionVectorOp(Copy);
+        CaseReductionVectorOp(Negate);
+        CaseReductionVectorOp(Abs);
+        CaseReductionVectorOp(LinearRectifier);
+        CaseReductionVectorOp(Sqr);
+    default:
+        return 0;
+    }
+}
+
+#undef CaseReductionVectorOp
+
+#define CaseStridedReductionVectorOp(oper)                                                                                        \
+    case VectorKernelOp::oper:                                                                                                    \
+        switch (reductionOp)                                                                                                      \
+        {                                                                                                                         \
+        case VectorKernelOp::Sum: return SumStridedLoop<T, Vec##oper<T>>(beta, a, stride, m, alpha, c, n);                        \
+        case VectorKernelOp::Max: return MinMaxStridedLoop<T, Vec##oper<T>, VecMax<T>>(beta, a, stride, m, alpha, c, n);          \
+        case VectorKernelOp::Min: return MinMaxStridedLoop<T, Vec##oper<T>, VecMin<T>>(beta, a, stride, m, alpha, c, n);          \
+        default: return;                                                                                                          \
+        }
+
+template <class T>
+static void ReduceStrided(VectorKernelOp reductionOp, VectorKernelOp op, typename T::Elem beta, const typename T::Elem* a, ptrdiff_t stride, size_t m, typename T::Elem alpha, typename T::Elem* c, size_t n)
+{
+    switch (op)
+    {
+        CaseStridedReductionVectorOp(Copy);
+        CaseStridedReductionVectorOp(Negate);
+        CaseStridedReductionVectorOp(Abs);
+        CaseStridedReductionVectorOp(LinearRectifier);
+        CaseStridedReductionVectorOp(Sqr);
+    default:
+        return;
+    }
+}
+
+#undef CaseStridedReductionVectorOp
+
+// -----------------------------------------------------------------------
+// product of a packed panel
+// -----------------------------------------------------------------------
+
+// One panel times cols columns of b, with all accumulators in registers. With few columns, the sum over the inner
+// dimension is split into several chains, so that the additions do not wait for each other. Unlike the elementwise kernels,
+// the order of the additions differs from that of a GEMM, so the results are only close to those of the BLAS.
+template <class T, size_t cols, size_t chains>
+static inline void PackedPanelColumns(const typename T::Elem* panel, size_t k, const typename T::Elem* b, ptrdiff_t ldb,
+                                      typename T::Elem beta, typename T::Elem alpha, typename T::Elem* c, ptrdiff_t ldc, size_t rows)
+{
+    const size_t W = T::width;
+    enum { vecs = PackedPanelRows / T::width };
+    static_assert(PackedPanelRows % T::width == 0, "The panel must consist of whole vectors.");
+
+    typename T::Vec acc[chains][cols][vecs];
+    for (size_t s = 0; s < chains; s++)
+        for (size_t j = 0; j < cols; j++)
+            for (size_t v = 0; v < vecs; v++)
+                acc[s][j][v] = T::Zero();
+
+    size_t d = 0;
+    for (; d + chains <= k; d += chains)
+    {
+        for (size_t s = 0; s < chains; s++)
+        {
+            const typename T::Elem* p = panel + (d + s) * PackedPanelRows;
+            for (size_t j = 0; j < cols; j++)
+            {
+                typename T::Vec bv = T::Set1(b[d + s + j * ldb]);
+                for (size_t v = 0; v < vecs; v++)
+                    acc[s][j][v] = T::Add(acc[s][j][v], T::Mul(T::Load(p + v * W), bv));
+            }
+        }
+    }
+    for (; d < k; d++)
+    {
+        const typename T::Elem* p = panel + d * PackedPanelRows;
+        for (size_t j = 0; j < cols; j++)
+        {
+            typename T::Vec bv = T::Set1(b[d + j * ldb]);
+            for (size_t v = 0; v < vecs; v++)
+                acc[0][j][v] = T::Add(acc[0][j][v], T::Mul(T::Load(p + v * W), bv));
+        }
+    }
+    for (size_t s = 1; s < chains; s++)
+        for (size_t j = 0; j < cols; j++)
+            for (size_t v = 0; v < vecs; v++)
+                acc[0][j][v] = T::Add(acc[0][j][v], acc[s][j][v]);
+
+    typename T::Vec valpha = T::Set1(alpha);
+    typename T::Vec vbeta = T::Set1(beta);
+    for (size_t j = 0; j < cols; j++)
+    {
+        typename T::Elem* cj = c + j * ldc;
+        for (size_t v = 0; v < vecs && v * W < rows; v++)
+        {
+            typename T::Vec r = T::Mul(acc[0][j][v], valpha);
+            if (rows >= (v + 1) * W)
+            {
+                if (beta != 0)
+                    r = T::Add(r, T::Mul(vbeta, T::Load(cj + v * W)));
+                T::Store(cj + v * W, r);
+            }
+            else
+            {
+                if (beta != 0)
+                    r = T::Add(r, T::Mul(vbeta, LoadPartial<T>(cj + v * W, rows - v * W)));
+                StorePartial<T>(cj + v * W, rows - v * W, r);
+            }
+        }
+    }
+}
+
+template <class T>
+static void PackedPanelProduct(const typename T::Elem* panel, size_t k, const typename T::Elem* b, ptrdiff_t ldb, size_t n,
+                               typename T::Elem beta, typename T::Elem alpha, typename T::Elem* c, ptrdiff_t ldc, size_t rows)
+{
+    // blocks of columns with 8 accumulators, then a half block, and the remaining columns one by one,
+    // with more chains for fewer columns
+    enum { blockCols = PackedPanelRows / T::width >= 8 ? 1 : 8 / (PackedPanelRows / T::width) };
+    enum { halfBlockCols = blockCols > 1 ? blockCols / 2 : 1 };
+    size_t j = 0;
+    for (; j + blockCols <= n; j += blockCols)
+        PackedPanelColumns<T, blockCols, 1>(panel, k, b + j * ldb, ldb, beta, alpha, c + j * ldc, ldc, rows);
+    if (halfBlockCols > 1 && j + halfBlockCols <= n)
+    {
+        PackedPanelColumns<T, halfBlockCols, blockCols / halfBlockCols>(panel, k, b + j * ldb, ldb, beta, alpha, c + j * ldc, ldc, rows);
+        j += halfBlockCols;
+    }
+    for (; j < n; j++)
+        PackedPanelColumns<T, 1, blockCols>(panel, k, b + j * ldb, ldb, beta, alpha, c + j * ldc, ldc, rows);
+}
+
+// -----------------------------------------------------------------------
+// sparse products
+// -----------------------------------------------------------------------
+
+// A block of c stays in registers while the columns of a selected by all nonzeros are added to it.
+template <class T>
+static void SparseColumnProduct(const typename T::Elem* a, ptrdiff_t lda, const int* indices, const typename T::Elem* values, size_t count,
+                                typename T::Elem alpha, typename T::Elem* c, size_t n)
+{
+    enum { W = T::width, blockVecs = 4 };
+    size_t i = 0;
+    for (; i + blockVecs * W <= n; i += blockVecs * W)
+    {
+        typename T::Vec acc[blockVecs];
+        for (size_t v = 0; v < blockVecs; v++)
+            acc[v] = T::Load(c + i + v * W);
+        for (size_t p = 0; p < count; p++)
+        {
+            typename T::Vec w = T::Set1(alpha * values[p]);
+            const typename T::Elem* ap = a + indices[p] * lda + i;
+            for (size_t v = 0; v < blockVecs; v++)
+                acc[v] = T::Add(acc[v], T::Mul(w, T::Load(ap + v * W)));
+        }
+        for (size_t v = 0; v < blockVecs; v++)
+            T::Store(c + i + v * W, acc[v]);
+    }
+    for (; i < n; i += W)
+    {
+        size_t k = n - i < W ? n - i : W;
+        typename T::Vec acc = LoadPartial<T>(c + i, k);
+        for (size_t p = 0; p < count; p++)
+            acc = T::Add(acc, T::Mul(T::Set1(alpha * values[p]), LoadPartial<T>(a + indices[p] * lda + i, k)));
+        StorePartial<T>(c + i, k, acc);
+    }
+}
+
+// -----------------------------------------------------------------------
+// quantization (ColumnQuantizer)
+// -----------------------------------------------------------------------
+
+// The subsets of the range statistics are spread over the lanes of QuantizerRangeStatSubsets / width accumulators,
+// each one walking down its subset in order; the partial round at the end is added by scalar code, one element per subset.
+template <class T>
+static void QuantizerSubsetSums(const typename T::Elem* a, const typename T::Elem* residual, size_t n, bool squares, typename T::Elem mean, typename T::Elem* sums)
+{
+    enum { W = T::width, S = QuantizerRangeStatSubsets, numVecs = S / W };
+    static_assert(S % W == 0, "The subsets must fill whole vectors.");
+    typename T::Vec acc[numVecs];
+    for (size_t v = 0; v < numVecs; v++)
+        acc[v] = T::Zero();
+
+    typename T::Vec vmean = T::Set1(mean);
+    size_t i = 0;
+    for (; i + S <= n; i += S)
+    {
+        for (size_t v = 0; v < numVecs; v++)
+        {
+            typename T::Vec x = T::Add(T::Load(a + i + v * W), T::Load(residual + i + v * W));
+            if (squares)
+            {
+                x = T::Sub(x, vmean);
+                x = T::Mul(x, x);
+            }
+            acc[v] = T::Add(acc[v], x);
+        }
+    }
+    for (size_t v = 0; v < numVecs; v++)
+        T::Store(sums + v * W, acc[v]);
+
+    for (size_t s = 0; i + s < n; s++)
+    {
+        typename T::Elem x = a[i + s] + residual[i + s];
+        if (squares)
+            x = (x - mean) * (x - mean);
+        sums[s] = sums[s] + x;
+    }
+}
+
+// Elements that do not go into a sum add -0, which leaves any value unchanged. Counts are accumulated as floating point numbers,
+// which is exact up to 2^24 elements per subset for float.
+template <class T>
+static void QuantizerSubsetSums1Bit(const typename T::Elem* a, const typename T::Elem* residual, size_t n, typename T::Elem mean,
+                                    typename T::Elem* sums0, typename T::Elem* sums1, unsigned int* counts1)
+{
+    enum { W = T::width, S = QuantizerRangeStatSubsets, numVecs = S / W };
+    typename T::Vec acc0[numVecs], acc1[numVecs], count1[numVecs];
+    for (size_t v = 0; v < numVecs; v++)
+        acc0[v] = acc1[v] = count1[v] = T::Zero();
+
+    typename T::Vec vmean = T::Set1(mean);
+    typename T::Vec negativeZero = T::Set1((typename T::Elem) -0.0);
+    typename T::Vec one = T::Set1(1);
+    size_t i = 0;
+    for (; i + S <= n; i += S)
+    {
+        for (size_t v = 0; v < numVecs; v++)
+        {
+            typename T::Vec x = T::Add(T::Load(a + i + v * W), T::Load(residual + i + v * W));
+            typename T::Mask isUpper = T::CmpNotLT(x, vmean); // like !(x < mean), so NaN goes to the upper level
+            acc0[v] = T::Add(acc0[v], T::Select(isUpper, negativeZero, x));
+            acc1[v] = T::Add(acc1[v], T::Select(isUpper, x, negativeZero));
+            count1[v] = T::Add(count1[v], T::Select(isUpper, one, T::Zero()));
+        }
+    }
+    typename T::Elem counts[S];
+    for (size_t v = 0; v < numVecs; v++)
+    {
+        T::Store(sums0 + v * W, acc0[v]);
+        T::Store(sums1 + v * W, acc1[v]);
+        T::Store(counts + v * W, count1[v]);
+    }
+    for (size_t s = 0; s < S; s++)
+        counts1[s] = (unsigned int) counts[s];
+
+    for (size_t s = 0; i + s < n; s++)
+    {
+        typename T::Elem x = a[i + s] + residual[i + s];
+        if (x < mean)
+            sums0[s] = sums0[s] + x;
+        else
+        {
+            sums1[s] = sums1[s] + x;
+            counts1[s]++;
+        }
+    }
+}
+
+// A vector holds consecutive words, so bit k of all of them comes from consecutive elements. Bits beyond the end of the
+// column exist only for some of the words; those are done by scalar code.
+template <class T>
+static void Quantize1Bit(const typename T::Elem* a, const typename T::Elem* residual, size_t n, size_t wordsPerCol, size_t numWords,
+                         typename T::Elem threshold, typename T::Elem val0, typename T::Elem val1, typename T::Word* words, typename T::Elem* residualOut)
+{
+    const size_t W = T::width, numBits = 8 * sizeof(typename T::Word);
+    typename T::Vec vthreshold = T::Set1(threshold), vval0 = T::Set1(val0), vval1 = T::Set1(val1);
+    for (size_t w = 0; w < numWords; w += W)
+    {
+        typename T::Vec bits = T::Zero();
+        size_t k = 0, i = w; // i = element of bit k of word w
+        for (; k < numBits && i + W <= n; k++, i += wordsPerCol)
+        {
+            typename T::Vec x = T::Add(T::Load(a + i), T::Load(residual + i));
+            typename T::Mask isOne = T::CmpGE(x, vthreshold);
+            T::Store(residualOut + i, T::Sub(x, T::Select(isOne, vval1, vval0)));
+            bits = T::SetBit(bits, isOne, k);
+        }
+        T::StoreWords(words + w, bits);
+
+        for (; k < numBits && i < n; k++, i += wordsPerCol)
+        {
+            for (size_t lane = 0; lane < W && i + lane < n; lane++)
+            {
+                typename T::Elem x = a[i + lane] + residual[i + lane];
+                bool isOne = x >= threshold;
+                residualOut[i + lane] = x - (isOne ? val1 : val0);
+                if (isOne)
+                    words[w + lane] |= (typename T::Word) 1 << k;
+            }
+        }
+    }
+}
+
+template <class T>
+static void Unquantize1Bit(const typename T::Word* words, size_t n, size_t wordsPerCol, size_t numWords,
+                           typename T::Elem val0, typename T::Elem val1, bool add, typename T::Elem* c)
+{
+    const size_t W = T::width, numBits = 8 * sizeof(typename T::Word);
+    typename T::Vec vval0 = T::Set1(val0), vval1 = T::Set1(val1);
+    for (size_t w = 0; w < numWords; w += W)
+    {
+        typename T::Vec bits = T::LoadWords(words + w);
+        size_t k = 0, i = w;
+        for (; k < numBits && i + W <= n; k++, i += wordsPerCol)
+        {
+            typename T::Vec val = T::Select(T::TestBit(bits, k), vval1, vval0);
+            if (add)
+                val = T::Add(val, T::Load(c + i));
+            T::Store(c + i, val);
+        }
+
+        for (; k < numBits && i < n; k++, i += wordsPerCol)
+        {
+            for (size_t lane = 0; lane < W && i + lane < n; lane++)
+            {
+                typename T::Elem val = ((words[w + lane] >> k) & 1) ? val1 : val0;
+                if (add)
+                    val += c[i + lane];
+                c[i + lane] = val;
+            }
+        }
+    }
+}
+
+template <class T>
+static CPUVectorKernelTable<typename T::Elem> MakeKernelTable()
+{
+    CPUVectorKernelTable<typename T::Elem> table;
+    table.width = T::width;
+    table.unaryOp = &UnaryOp<T>;
+    table.binaryOp = &BinaryOp<T>;
+    table.reduce = &Reduce<T>;
+    table.reduceStrided = &ReduceStrided<T>;
+    table.packedPanelProduct = &PackedPanelProduct<T>;
+    table.sparseColumnProduct = &SparseColumnProduct<T>;
+    table.quantizerSubsetSums = &QuantizerSubsetSums<T>;
+    table.quantizerSubsetSums1Bit = &QuantizerSubsetSums1Bit<T>;
+    table.quantize1Bit = &Quantize1Bit<T>;
+    table.unquantize1Bit = &Unquantize1Bit<T>;
+    return table;
+}
+
+}}}}
@@ -604,7 +604,7 @@ struct ComputeSpatialBatchMeanAndInvStdDev
 
 template <int BlockDimX, int BlockDimY, bool Spatial, bool NormalizeRunningStats, int U, typename ElemType>
 __global__ void kNormalizeBatchTraining(int vectorSize, int spatialSize, int batchSize,
-    double epsilon,
+    double epsilon, bool reluOutput,
     const ElemType* x, ElemType* y,
     const ElemType* bnScale, const ElemType* bnBias,
     const ElemType* runningMean, const ElemType* runningVariance,
@@ -686,6 +686,8 @@ __global__ void kNormalizeBatchTraining(int vectorSize, int spatialSize, int bat
         for (int k = 0; k < U; k++)
         {
             val[k] = scale[k] * (val[k] - mean[k]) * invStdDev[k] + bias[k];
+            if (reluOutput && val[k] < 0) // (a ReLU fused into the normalization, see BatchNormEngineKind::FusedRelu)
+                val[k] = 0;
         }
         StoreValues<U>(val, pdst);
     }
@@ -696,7 +698,7 @@ struct NormalizeBatchTraining
 {
     template <typename ElemType>
     static void Call(size_t vectorSize, size_t spatialSize, size_t batchSize, bool spatial,
-                     bool normalizeRunningStats, double epsilon,
+                     bool normalizeRunningStats, double epsilon, bool reluOutput,
                      const ElemType* x, ElemType* y,                               // (in, out) data to normalize -> normalized data
                      const ElemType* bnScale, const ElemType* bnBias,              // (in) scale/bias to denormalize with
                      const ElemType* runningMean, const ElemType* runningVariance, // (in) running mean/variance
@@ -716,14 +718,14 @@ struct NormalizeBatchTraining
             if (normalizeRunningStats)
                 kNormalizeBatchTraining<BlockDimX, BlockDimY, true, true, U><<<gdim, bdim, 0, stream>>>(
                     (int)vectorSize, (int)spatialSize, (int)batchSize,
-                    epsilon,
+                    epsilon, reluOutput,
                     x, y, bnScale, bnBias,
                     runningMean, runningVariance,
                     batchMean, batchInvStdDev);
             else
                 kNormalizeBatchTraining<BlockDimX, BlockDimY, true, false, U><<<gdim, bdim, 0, stream>>>(
                     (int)vectorSize, (int)spatialSize, (int)batchSize,
-                    epsilon,
+                    epsilon, reluOutput,
                     x, y, bnScale, bnBias,
                     runningMean, runningVariance,
                     batchMean, batchInvStdDev);
@@ -733,14 +735,14 @@ struct NormalizeBatchTraining
             if (normalizeRunningStats)
                 kNormalizeBatchTraining<BlockDimX, BlockDimY, false, true, U><<<gdim, bdim, 0, stream>>>(
                     (int)vectorSize, (int)spatialSize, (int)batchSize,
-                    epsilon,
+                    epsilon, reluOutput,
                     x, y, bnScale, bnBias,
                     runningMean, runningVariance,
                     batchMean, batchInvStdDev);
             else
                 kNormalizeBatchTraining<BlockDimX, BlockDimY, false, false, U><<<gdim, bdim, 0, stream>>>(
                     (int)vectorSize, (int)spatialSize, (int)batchSize,
-                    epsilon,
+                    epsilon, reluOutput,
                     x, y, bnScale, bnBias,
                     runningMean, runningVariance,
                     batchMean, batchInvStdDev);
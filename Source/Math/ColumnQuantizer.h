@@ -27,6 +27,10 @@ class ColumnQuantizer
     static const size_t QWordNumBits = ValueQuantizer<ElemType>::QWordNumBits;
 
 public:
+    // number of strided subsets the range statistics of a column are summed over in parallel (one CUDA thread each,
+    // REDUCTION_BLOCK_SIZE in MatrixQuantizer_kernel.cu); the CPU sums in the same order to get the same ranges
+    static const size_t RangeStatSubsets = 128;
+
     cudacode ColumnQuantizer(size_t logNbits, ElemType lower, ElemType upper)
         : valQ(logNbits, lower, upper)
     {
@@ -84,6 +88,24 @@ public:
         ComputeRangeStatColjSubset<ZeroThresholdFor1Bit>(inMat, inResidual, M, j, bits, lower, upper, 0, 1, [](ElemType&){}, [](unsigned int&){});
     }
 
+    // the parameters of 1-bit quantization: values >= threshold map to 1, and 0 and 1 unquantize to val0 and val1
+    template <bool ZeroThresholdFor1Bit>
+    void Get1BitParameters(ElemType& threshold, ElemType& val0, ElemType& val1) const
+    {
+        threshold = valQ.template Threshold1<ZeroThresholdFor1Bit>();
+        val0 = valQ.Unquantize(0);
+        val1 = valQ.Unquantize(1);
+    }
+
+    // combine the partial sums of the RangeStatSubsets subsets to their total in sums[0], pairwise like allreduce() of MatrixQuantizer_kernel.cu
+    template <typename T>
+    static void AllReduceSubsets(T* sums)
+    {
+        for (size_t stride = RangeStatSubsets / 2; stride > 0; stride /= 2)
+            for (size_t subset = 0; subset < stride; subset++)
+                sums[subset] = sums[subset] + sums[subset + stride];
+    }
+
 public:
     // quantize the value in  inMat[rowStart,colIdx],  inMat[rowStart + rowStride,colIdx],inMat[rowStart + rowStride*,colIdx]  ... and pack them into a QWord
     // Question: note that it is somewhat un-intuitional, but this memory access pattern is efficient for GPU?
@@ -132,7 +154,7 @@ public:
                 // quantize
                 size_t ij = ColMIDX(i, colIdx, M);
                 ElemType val = inMat[ij] + inResidual[ij];
-                QWordVal qval = valQ.Quantize<ZeroThresholdFor1Bit>(val);
+                QWordVal qval = valQ.template Quantize<ZeroThresholdFor1Bit>(val);
 
                 // compute residual
                 ElemType uval = valQ.Unquantize(qval);
@@ -274,48 +296,11 @@ public:
             allReduceUint(num0);
             allReduceUint(num1);
 
-            ElemType radius;
-            ElemType newmean;
-            if (!ZeroThresholdFor1Bit)
-            {
-                // we minimize the error jointly across positive and negative numbers to make things
-                // symmetrical around the mean (which may be non-zero) tying the two sides
-                ElemType devacc0 = (num0 * mean) - meanacc0;
-                ElemType devacc1 = meanacc1 - (num1 * mean);
-
-                // both deviations tied, to ensure consistent mean
-                ElemType dev = (devacc0 + devacc1) / rows;
-                radius = 2.0f * dev;
-                newmean = mean;
-            }
-            else
-            {
-                // we keep two separate reconstruction values to allow for asymmetries--but we
-                // instead hard-code that the threshold is 0
-
-                // happens for all-zero columns which do exist (mean0 is 0 in that case)
-                if (num0 == 0)
-                    num0 = 1;
-                if (num1 == 0)
-                    num1 = 1;
-                ElemType mean0 = meanacc0 / num0;
-                ElemType mean1 = meanacc1 / num1;
-
-                // approximate by using their average as the threshold between 0 and 1
-                // with these values, bits (0,1) which mean values (0.5,1.5) will reconstruct to mean0/1
-                newmean = 0.5f * (mean0 + mean1);
-                radius = 2.0f * (mean1 - newmean);
-            }
-
             if (subset == 0)
-            {
-                lower = newmean - radius;
-                upper = newmean + radius;
-            }
+                RangeFrom1BitStats<ZeroThresholdFor1Bit>(mean, meanacc0, meanacc1, num0, num1, rows, lower, upper);
         }
         else
         {
-            ElemType stddevs = 4.0f; // TODO: make this a parameter
             // >1 bit:
             // We linearly quantize between 'stddevs' standard deviations.
             ElemType varacc = 0.0f;
@@ -328,14 +313,61 @@ public:
             }
             // multi-subset (CUDA): reduce to one thread
             allReduceElem(varacc);
-            ElemType stddev = sqrt(varacc / rows);
             if (subset == 0)
-            {
-                // stddevs = how many stddevs from the mean until outside of quantization range
-                lower = mean - (stddevs * stddev);
-                upper = mean + (stddevs * stddev);
-            }
+                RangeFromVariance(mean, varacc, rows, lower, upper);
+        }
+    }
+
+    // the final step of ComputeRangeStatColjSubset() for 1 bit, from the sums over the whole column
+    template <bool ZeroThresholdFor1Bit>
+    static cudacode void RangeFrom1BitStats(ElemType mean, ElemType meanacc0, ElemType meanacc1, unsigned int num0, unsigned int num1, size_t rows,
+                                            ElemType& lower, ElemType& upper)
+    {
+        ElemType radius;
+        ElemType newmean;
+        if (!ZeroThresholdFor1Bit)
+        {
+            // we minimize the error jointly across positive and negative numbers to make things
+            // symmetrical around the mean (which may be non-zero) tying the two sides
+            ElemType devacc0 = (num0 * mean) - meanacc0;
+            ElemType devacc1 = meanacc1 - (num1 * mean);
+
+            // both deviations tied, to ensure consistent mean
+            ElemType dev = (devacc0 + devacc1) / rows;
+            radius = 2.0f * dev;
+            newmean = mean;
         }
+        else
+        {
+            // we keep two separate reconstruction values to allow for asymmetries--but we
+            // instead hard-code that the threshold is 0
+
+            // happens for all-zero columns which do exist (mean0 is 0 in that case)
+            if (num0 == 0)
+                num0 = 1;
+            if (num1 == 0)
+                num1 = 1;
+            ElemType mean0 = meanacc0 / num0;
+            ElemType mean1 = meanacc1 / num1;
+
+            // approximate by using their average as the threshold between 0 and 1
+            // with these values, bits (0,1) which mean values (0.5,1.5) will reconstruct to mean0/1
+            newmean = 0.5f * (mean0 + mean1);
+            radius = 2.0f * (mean1 - newmean);
+        }
+
+        lower = newmean - radius;
+        upper = newmean + radius;
+    }
+
+    // the final step of ComputeRangeStatColjSubset() for >1 bit, from the sum of squared deviations over the whole column
+    static cudacode void RangeFromVariance(ElemType mean, ElemType varacc, size_t rows, ElemType& lower, ElemType& upper)
+    {
+        ElemType stddevs = 4.0f; // TODO: make this a parameter
+        ElemType stddev = sqrt(varacc / rows);
+        // stddevs = how many stddevs from the mean until outside of quantization range
+        lower = mean - (stddevs * stddev);
+        upper = mean + (stddevs * stddev);
     }
 
 private:
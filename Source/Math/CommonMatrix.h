@@ -70,7 +70,37 @@ public:
     // release all the cached memory.
     static std::pair<size_t, size_t> GetFreeAndTotalMemoryInMBs(int deviceId);
 
+    // Opt-in caching of device buffers. When enabled, Free() returns buffers into a per-device, per-stream cache
+    // binned by size, and Allocate() serves requests from that cache instead of calling cudaMalloc()/cudaFree(),
+    // both of which synchronize the device. Cached buffers are released when an allocation runs out of memory.
+    static void SetCachingEnabled(bool enabled);
+    static bool IsCachingEnabled();
+
+    // physically release all cached buffers that are not in use; deviceId == DEVICEID_AUTO releases them on all devices
+    static void TrimCache(int deviceId = DEVICEID_AUTO);
+
+    struct CacheStatistics
+    {
+        size_t numHits;        // allocations served from the cache
+        size_t numMisses;      // allocations that had to call cudaMalloc()
+        size_t numTrims;       // number of times the cache was emptied, e.g. on out-of-memory
+        size_t inUseBytes;     // bytes of device memory handed out through the cache
+        size_t requestedBytes; // bytes actually requested for the buffers in use (<= inUseBytes due to binning)
+        size_t cachedBytes;    // bytes held in the cache, not in use
+        size_t peakInUseBytes;
+
+        // fraction of the memory held by the cache that is not used by any request
+        double Fragmentation() const
+        {
+            size_t heldBytes = inUseBytes + cachedBytes;
+            return heldBytes == 0 ? 0.0 : 1.0 - (double) requestedBytes / heldBytes;
+        }
+    };
+    static CacheStatistics GetCacheStatistics(int deviceId);
+
 private:
+    static bool m_cachingEnabled;
+
     template <typename AllocatedElemType>
     static AllocatedElemType* AllocateNoTrace(int deviceId, size_t numElements);
 };
@@ -171,6 +201,183 @@ enum ElementWiseOperator
     Macro(ElementwiseProductWithLogSumDerivative);      \
     Macro(ElementwiseProductWithExpOfDiff);
 
+// -----------------------------------------------------------------------
+// FusedElementwiseOp -- a short program of element-wise operations that is
+// evaluated per element in a single pass, without intermediate tensors.
+// Operand indices below MaxInputs refer to the (up to three) input tensors,
+// MaxInputs + j refers to the result of step j. The last step is the result.
+// This is a POD so that it can be passed by value to CUDA kernels.
+// -----------------------------------------------------------------------
+
+struct FusedElementwiseOp
+{
+    enum { MaxInputs = 3, MaxSteps = 8 };
+    struct Step
+    {
+        ElementWiseOperator op;
+        unsigned char arity;   // 1, 2, or 3
+        unsigned char args[3]; // operand indices, see above
+    };
+    Step steps[MaxSteps];
+    unsigned char numSteps;
+};
+
+// -----------------------------------------------------------------------
+// MultiTensorUpdateParams, MultiTensorUpdateItem -- arguments of the fused
+// parameter update of many dense tensors of one device in one or two
+// launches (see CPUMatrix::MultiTensorUpdate()). The items hold raw CPU or
+// GPU pointers. These are PODs so that they can be copied to the device.
+// -----------------------------------------------------------------------
+
+enum class MultiTensorUpdateRule : int
+{
+    Momentum,         // (momentum) SGD, see Matrix::NormalGrad()
+    NesterovMomentum, // SGD with Nesterov momentum, see Matrix::NormalGrad()
+    AdaGrad,          // see Matrix::Adagrad()
+    FSAdaGrad,        // see Matrix::FSAdagradUpdate()
+    RmsProp,          // see Matrix::RmsProp()
+    Adam,             // see Matrix::AdamUpdate()
+    Lars,             // momentum SGD with a layer-wise trust ratio of the learning rate, see GetLarsTrustRatio()
+    Lamb              // Adam with a layer-wise trust ratio, see Matrix::LambUpdate()
+};
+
+// number of gradient-sized state vectors that a rule keeps in the smoothed gradient
+static inline size_t MultiTensorUpdateStateSize(MultiTensorUpdateRule rule)
+{
+    return rule == MultiTensorUpdateRule::RmsProp ? 3 : (rule == MultiTensorUpdateRule::FSAdaGrad || rule == MultiTensorUpdateRule::Adam || rule == MultiTensorUpdateRule::Lamb) ? 2 : 1;
+}
+
+// whether a rule updates the values in a second pass, with learning rates that depend on sums over the first one (see GetMultiTensorLearnRates())
+static inline bool MultiTensorUpdateHasSecondPass(MultiTensorUpdateRule rule)
+{
+    return rule == MultiTensorUpdateRule::AdaGrad || rule == MultiTensorUpdateRule::RmsProp || rule == MultiTensorUpdateRule::Lamb;
+}
+
+// hyper-parameters shared by all tensors of one update
+template <class ElemType>
+struct MultiTensorUpdateParams
+{
+    MultiTensorUpdateRule rule;
+    ElemType momentum;          // Momentum, NesterovMomentum, FSAdaGrad, Adam, Lars, Lamb
+    ElemType varMomentum;       // FSAdaGrad, Adam, Lamb
+    ElemType adamEpsilon;       // Adam, Lamb
+    ElemType larsCoefficient;   // Lars: trust coefficient, see GetLarsTrustRatio()
+    ElemType gradientClipValue; // elements of the gradients are truncated to [-gradientClipValue, gradientClipValue]; 0 for none
+    bool needAveMultiplier;     // AdaGrad, RmsProp
+    ElemType rmsGamma, rmsWgtInc, rmsWgtMax, rmsWgtDec, rmsWgtMin; // RmsProp
+};
+
+// one tensor of the update, with per-tensor scalars
+template <class ElemType>
+struct MultiTensorUpdateItem
+{
+    ElemType* value;
+    ElemType* gradient;
+    ElemType* state; // smoothed gradient, MultiTensorUpdateStateSize() vectors of n elements
+    size_t n;
+    ElemType learnRatePerSample;
+    ElemType gradientScale;  // gradients are multiplied by this first, e.g. for norm clipping
+    ElemType l2RegWeight;    // already multiplied by the minibatch size; 0 for none
+    ElemType l1Threshold;    // learning rate * L1 weight * minibatch size; 0 for none
+    ElemType adaMul;         // FSAdaGrad: targetAdagradAvDenom * sqrt(smoothedCount); Adam, Lamb: bias correction, see Matrix::AdamUpdate()
+    ElemType decoupledDecay; // Adam: learning rate * decoupled weight decay; Lamb: decoupled weight decay; 0 for none
+    ElemType trustRatio;     // Lars: factor of the learning rate, set by Matrix::MultiTensorUpdate()
+    ElemType weightNorm;     // Lamb: norm of the value before the update, set by Matrix::MultiTensorUpdate()
+    ElemType* ema;           // exponential moving average of the value, which follows the updated value; nullptr for none
+    ElemType emaDecay;       // ema = emaDecay * ema + (1 - emaDecay) * value
+    bool initializeState;    // RmsProp: the state was just allocated and gets initialized from the gradient
+};
+
+// Adam bias correction sqrt(1 - varMomentum^t) / (1 - momentum^t) of update t >= 1, which makes up for the zero-initialized moments
+static inline double GetAdamBiasCorrection(double momentum, double varMomentum, double t)
+{
+    double meanCorrection = 1 - pow(momentum, t);
+    return sqrt(1 - pow(varMomentum, t)) / (meanCorrection > 0 ? meanCorrection : 1);
+}
+
+// LARS (You et al., 2017): layer-wise factor coefficient * |w| / (|g| + l2RegWeight * |w|) of the learning rate, from the norms of
+// the (aggregated) gradient and the weights of one parameter; 1 if either norm is 0, e.g. for zero-initialized biases
+static inline double GetLarsTrustRatio(double weightNorm, double gradientNorm, double l2RegWeight, double coefficient)
+{
+    if (weightNorm <= 0 || gradientNorm <= 0)
+        return 1;
+    return coefficient * weightNorm / (gradientNorm + l2RegWeight * weightNorm);
+}
+
+// LAMB (You et al., 2019): layer-wise factor |w| / |r| of the learning rate, where r is the Adam step plus the weight decay
+static inline double GetLambTrustRatio(double weightNorm, double updateNorm)
+{
+    return weightNorm > 0 && updateNorm > 0 ? weightNorm / updateNorm : 1;
+}
+
+// chunk of a tensor of a multi-tensor operation; chunks are the unit of parallel work
+struct MultiTensorChunk
+{
+    size_t item;
+    size_t begin;
+    size_t end;
+};
+
+// splits tensors of the given sizes into chunks of at most chunkSize elements
+static inline std::vector<MultiTensorChunk> GetMultiTensorChunks(const std::vector<size_t>& sizes, size_t chunkSize)
+{
+    std::vector<MultiTensorChunk> chunks;
+    for (size_t item = 0; item < sizes.size(); item++)
+        for (size_t begin = 0; begin < sizes[item]; begin += chunkSize)
+            chunks.push_back(MultiTensorChunk{ item, begin, std::min(begin + chunkSize, sizes[item]) });
+    return chunks;
+}
+
+// learning rates of the second pass, given the sums of its chunks: for AdaGrad and RmsProp divided by the average multiplier
+// of each tensor, for Lamb multiplied by its trust ratio (the sums are those of the squared steps)
+template <class ElemType>
+static inline std::vector<ElemType> GetMultiTensorLearnRates(const std::vector<MultiTensorUpdateItem<ElemType>>& items, const MultiTensorUpdateParams<ElemType>& params,
+                                                             const std::vector<MultiTensorChunk>& chunks, const std::vector<double>& chunkSums)
+{
+    std::vector<double> multiplierSums(items.size(), 0);
+    for (size_t c = 0; c < chunks.size(); c++)
+        multiplierSums[chunks[c].item] += chunkSums[c];
+    std::vector<ElemType> learnRates(items.size());
+    for (size_t k = 0; k < items.size(); k++)
+    {
+        if (params.rule == MultiTensorUpdateRule::Lamb)
+        {
+            learnRates[k] = (ElemType) (items[k].learnRatePerSample * GetLambTrustRatio(items[k].weightNorm, sqrt(multiplierSums[k])));
+            continue;
+        }
+        double aveMultiplier = params.needAveMultiplier && items[k].n > 0 ? multiplierSums[k] / items[k].n : 1;
+        learnRates[k] = (ElemType) (items[k].learnRatePerSample / aveMultiplier);
+    }
+    return learnRates;
+}
+
+// -----------------------------------------------------------------------
+// lazy updates of block-sparse gradients (see Matrix::LazyNormalGrad())
+// Each column of the parameter remembers the update count at which it was
+// last updated. The updates it skipped since then had a zero gradient in
+// that column; their effect is caught up in closed form on the next touch.
+// -----------------------------------------------------------------------
+
+// Over 'skipped' updates without gradient, an accumulator with the given momentum decays by momentum^skipped
+// and moves the weights by (momentum + momentum^2 + ... + momentum^skipped) times its value.
+template <class ElemType>
+static inline void GetLazyMomentumCatchUp(ElemType momentum, size_t skipped, ElemType& decay, ElemType& moveFactor)
+{
+    decay = (ElemType) pow((double) momentum, (double) skipped);
+    moveFactor = momentum == 1 ? (ElemType) skipped : momentum * (1 - decay) / (1 - momentum);
+}
+
+// number of updates that the column skipped before the current update 'updateCount'; records the current update as its last one
+// Columns not seen yet are considered up to date as of the previous update.
+static inline size_t GetLazyUpdateSkippedSteps(std::vector<size_t>& lastUpdates, size_t numCols, size_t col, size_t updateCount)
+{
+    if (lastUpdates.size() != numCols)
+        lastUpdates.assign(numCols, updateCount - 1);
+    size_t skipped = updateCount - lastUpdates[col] - 1;
+    lastUpdates[col] = updateCount;
+    return skipped;
+}
+
 // -----------------------------------------------------------------------
 // various enums to describe
 // -----------------------------------------------------------------------
@@ -368,6 +575,9 @@ private:
 // BaseMatrixStorage -- base class for all matrix types (CPU, GPU) x (dense, sparse)
 // -----------------------------------------------------------------------
 
+template <class ElemType>
+class BaseMatrix;
+
 template <class ElemType>
 class BaseMatrixStorage : public enable_shared_from_this<BaseMatrixStorage<ElemType>>
 {
@@ -397,6 +607,7 @@ public:
 
     void ReleaseMemory()
     {
+        m_otherFormat = nullptr;
         if (!m_externalBuffer)
         {
             if (m_computeDevice < 0)
@@ -479,6 +690,20 @@ protected:
     void* GetTempHostBuffer() const { return m_tempHostBuffer; }
     void SetTempHostBuffer(void* buffer) const { m_tempHostBuffer = buffer; }
 
+    // The content of this storage in the other compressed format (CSR for CSC and vice versa), of the given dimensions,
+    // which sparse products derive on first use instead of converting on every call. Any write drops it.
+    shared_ptr<BaseMatrix<ElemType>> GetOtherFormat(size_t numRows, size_t numCols) const
+    {
+        return (m_otherFormatRows == numRows && m_otherFormatCols == numCols) ? m_otherFormat : nullptr;
+    }
+    void SetOtherFormat(size_t numRows, size_t numCols, const shared_ptr<BaseMatrix<ElemType>>& otherFormat) const
+    {
+        m_otherFormat = otherFormat;
+        m_otherFormatRows = numRows;
+        m_otherFormatCols = numCols;
+    }
+    void InvalidateOtherFormat() const { m_otherFormat = nullptr; }
+
     size_t GetTempHostBufferSize() const { return m_tempHostBufferSize; }
     void SetTempHostBufferSize(size_t bufferSize) const { m_tempHostBufferSize = bufferSize; }
 
@@ -525,6 +750,9 @@ protected:
         m_compIndex                = nullptr; // begin ids of col/row in CSC/CSR format
         m_blockIds                 = nullptr; // block ids
         m_blockIdShift             = 0; // used to get efficient slice, actual col = blockIds[j] - m_blockIdShift
+        m_otherFormat              = nullptr;
+        m_otherFormatRows          = 0;
+        m_otherFormatCols          = 0;
     }
 
 protected:
@@ -555,6 +783,11 @@ protected:
     mutable void* m_tempHostBuffer; // used to copy values.
     mutable size_t m_tempHostBufferSize;
 
+    // cached copy in the other compressed format, see GetOtherFormat()
+    mutable shared_ptr<BaseMatrix<ElemType>> m_otherFormat;
+    mutable size_t m_otherFormatRows;
+    mutable size_t m_otherFormatCols;
+
     // **************************
     // CPUSparseMatrix variables
     // **************************
@@ -600,6 +833,16 @@ public:
             LogicError("%s: Cannot resize the matrix because it is externally owned.", function);
     }
 
+    // An externally owned buffer cannot be reallocated, but the matrix can still be reshaped or shrunk within it,
+    // e.g. a node value that is a view into the memory arena of a static memory plan (see MatrixPool).
+    void VerifyResizable(const char* function, size_t numElements) const
+    {
+        if (!m_sob.unique())
+            LogicError("%s: Cannot resize the matrix because it is a view.", function);
+        else if (m_sob->HasExternalBuffer() && numElements > GetSizeAllocated())
+            LogicError("%s: Cannot grow the matrix to %d elements because it is externally owned and has room for %d.", function, (int) numElements, (int) GetSizeAllocated());
+    }
+
     // same as VerifyResizable() except for the error message. Could be folded into one.
     void VerifyMigratable(const char* function) const
     {
@@ -610,12 +853,14 @@ public:
     }
 
     // This is needed for Sparse Matrices to ensure they can write to the matrix. Note: writing to slices is not currently supported
+    // Since all writers call it, this also drops the cached copy in the other compressed format (see GetOtherFormat()).
     void VerifyWritable(const char* function) const 
     {
         if (!(m_sob->GetNumStorageRows() == m_numRows && m_sob->GetNumStorageCols() == m_numCols))
         {
             LogicError("%s: Cannot write to the matrix because it is a slice.", function);
         }
+        m_sob->InvalidateOtherFormat();
     }
 
     bool IsView() const { return (GetNumRows() != m_sob->GetNumStorageRows() || GetNumCols() != m_sob->GetNumStorageCols() || m_sliceViewOffset != 0); }
@@ -668,6 +913,10 @@ protected:
     GPUSPARSE_INDEX_TYPE* GetTempDeviceBuffer() const { return m_sob->GetTempDeviceBuffer(); }
     void ReserveTempDeviceBuffer(const size_t minSize) const { m_sob->ReserveTempDeviceBuffer(minSize); }
 
+    shared_ptr<BaseMatrix<ElemType>> GetOtherFormat() const { return m_sob->GetOtherFormat(m_numRows, m_numCols); }
+    void SetOtherFormat(const shared_ptr<BaseMatrix<ElemType>>& otherFormat) const { m_sob->SetOtherFormat(m_numRows, m_numCols, otherFormat); }
+    void InvalidateOtherFormat() const { m_sob->InvalidateOtherFormat(); }
+
     void* GetTempHostBuffer() const { return m_sob->GetTempHostBuffer(); }
     void SetTempHostBuffer(void* buffer) const { m_sob->SetTempHostBuffer(buffer); };
 
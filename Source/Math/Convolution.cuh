@@ -228,157 +228,270 @@ __device__ double round_(double a)
 
 // For each image, for each ROI, this function treats that ROI as an image
 // and does max pooling so that it has output size pooledHeight x pooledWidth.
-// The kernel operates on one location in the output tensor, computes which ROI
-// and image should populate that location, computes the subset of the image
-// corresponding to the ROI and which pixels in that subset should go into the
-// output location, then takes the max value over that window.
+// Each block row (blockIdx.y) operates on one ROI at a time, and each thread on
+// one location of that ROI in the output tensor. The threads of a block first stage
+// the windows of the pooled rows and columns of their ROI in shared memory, then
+// each takes the max value over the window of its output location.
 // src: Images              [W x H x C x N]
 // roiData: ROIs            [4 x numROIs x N], 
 // dst: Pooled ROIs         [PW x PH x C x numROIs x N]
 // argmax: max positions    [PW x PH x C x numROIs x N]
 // where PW = Pooled Width, PH = Pooled Height, C = Channels, N = Batch Size
+// Shared memory: 2 * (PH + PW) ints.
 template <typename ElemType>
-__global__ void kROIPoolingForward(const int totalIterations,
-    const int numROIs, const int numImg,
+__global__ void kROIPoolingForward(const int totalRois, const int numROIs,
     const int channels, const int width, const int height,
     const int pooledWidth, const int pooledHeight, const ElemType* src,
     const ElemType* roiData, ElemType* dst, ElemType* argmax)
 {
-    // index loops over all totalRois*c*pooledHeight*pooledWidth output locations.
-    for (int index = blockIdx.x * blockDim.x + threadIdx.x;
-         index < (totalIterations); index += blockDim.x * gridDim.x) 
-    {
-        
-        // output is [W x H x C x N]
-        // n is the global ROI index (the new batch index)
-        int pw =  index % pooledWidth;
-        int ph = (index / pooledWidth) % pooledHeight;
-        int c  = (index / pooledWidth  / pooledHeight) % channels;
-        int n  =  index / pooledWidth  / pooledHeight  / channels;
+    // [hstart, hend) of each pooled row, then [wstart, wend) of each pooled column
+    extern __shared__ int windows[];
+    int* hstarts = windows;
+    int* hends   = hstarts + pooledHeight;
+    int* wstarts = hends + pooledHeight;
+    int* wends   = wstarts + pooledWidth;
+
+    const int roiOutputSize = channels * pooledHeight * pooledWidth;
 
+    // n is the global ROI index (the new batch index)
+    for (int n = blockIdx.y; n < totalRois; n += gridDim.y)
+    {
         // each ROI is 4 elements: (x, y, w, h)
-        roiData += n * 4;
+        const ElemType* roi = roiData + n * 4;
 
-        // roi data is relative to original image size
-        int roiStartW = (int)(    round_(roiData[0] * width));
-        int roiStartH = (int)(    round_(roiData[1] * height));
-        int roiWidth  = (int)(max(round_(roiData[2] * width),  (ElemType)1));
-        int roiHeight = (int)(max(round_(roiData[3] * height), (ElemType)1));
-        
-        ElemType winH = (ElemType)roiHeight / (ElemType)pooledHeight;
-        ElemType winW = (ElemType)roiWidth / (ElemType)pooledWidth;
-        
-        // compute window for this output location.
-        int hstart = (int)(       ph * winH);
-        int wstart = (int)(       pw * winW);
-        int hend   = (int)(ceilf((ph + 1) * winH));
-        int wend   = (int)(ceilf((pw + 1) * winW));
-        
-        // Add ROI offsets and clip to input boundaries
-        hstart = min(max(hstart + roiStartH, 0), height);
-        hend   = min(max(hend   + roiStartH, 0), height);
-        wstart = min(max(wstart + roiStartW, 0), width);
-        wend   = min(max(wend   + roiStartW, 0), width);
-        
-        bool isempty = (hend <= hstart) || (wend <= wstart);
-        // Define an empty pooling region to be zero
-        ElemType maxval = isempty ? (ElemType)0 : -CUDART_INF_F;
-        int maxidx = -1;
-
-        int imgIdx = n / numROIs;
-        src += (imgIdx * channels + c) * height * width;
-        for (int h = hstart; h < hend; h++)
+        __syncthreads(); // all threads are done with the windows of the previous ROI
+        for (int i = threadIdx.x; i < pooledHeight + pooledWidth; i += blockDim.x)
         {
-            for (int w = wstart; w < wend; w++)
+            bool isRow = i < pooledHeight;
+            int p          = isRow ? i : i - pooledHeight;
+            int size       = isRow ? height : width;
+            int pooledSize = isRow ? pooledHeight : pooledWidth;
+
+            // roi data is relative to original image size
+            int roiStart = (int)(    round_(roi[isRow ? 1 : 0] * size));
+            int roiSize  = (int)(max(round_(roi[isRow ? 3 : 2] * size), (ElemType)1));
+            ElemType win = (ElemType)roiSize / (ElemType)pooledSize;
+
+            // compute the window of this pooled row or column, add the ROI offset and clip to the input boundaries
+            int start = (int)(     p      * win);
+            int end   = (int)(ceil((p + 1) * win));
+            (isRow ? hstarts : wstarts)[p] = min(max(start + roiStart, 0), size);
+            (isRow ? hends   : wends)  [p] = min(max(end   + roiStart, 0), size);
+        }
+        __syncthreads();
+
+        // index loops over the c*pooledHeight*pooledWidth output locations of this ROI.
+        for (int index = blockIdx.x * blockDim.x + threadIdx.x;
+             index < roiOutputSize; index += blockDim.x * gridDim.x)
+        {
+            // output is [W x H x C x N]
+            int pw =  index % pooledWidth;
+            int ph = (index / pooledWidth) % pooledHeight;
+            int c  =  index / pooledWidth  / pooledHeight;
+
+            int hstart = hstarts[ph], hend = hends[ph];
+            int wstart = wstarts[pw], wend = wends[pw];
+            bool isempty = (hend <= hstart) || (wend <= wstart);
+            // Define an empty pooling region to be zero
+            ElemType maxval = isempty ? (ElemType)0 : -CUDART_INF_F;
+            int maxidx = -1;
+
+            int imgIdx = n / numROIs;
+            const ElemType* plane = src + (imgIdx * channels + c) * height * width;
+            for (int h = hstart; h < hend; h++)
             {
-                int srcIndex = w + h * width;
-                if (src[srcIndex] > maxval)
+                for (int w = wstart; w < wend; w++)
                 {
-                    maxval = src[srcIndex];
-                    maxidx = srcIndex;
+                    int srcIndex = w + h * width;
+                    if (plane[srcIndex] > maxval)
+                    {
+                        maxval = plane[srcIndex];
+                        maxidx = srcIndex;
+                    }
                 }
             }
+            dst   [n * roiOutputSize + index] = maxval;
+            argmax[n * roiOutputSize + index] = maxidx;
         }
-        dst[index] = maxval;
-        argmax[index] = maxidx;
     }
 }
 
-// The kernel operates on one location in the input to the ROIPoolingNode (one image location).
-// It loops over the ROIs corresponding to that image, seeing which ones could contain the location
-// in their output. For each ROI, it checks the argmax data to see if that ROI indeed chose
-// this pixel location as the maximum. If so, it increments the gradient term for the input location.
+// The kernel operates on one location in the output of the ROIPoolingNode. It adds the gradient
+// of that location to the input location that was chosen as its maximum. One input location could
+// be in multiple ROIs--in that case each ROI contributes its gradient term atomically.
 template <typename ElemType>
 __global__ void kROIPoolingBackward(const int totalIterations,
-    const int numROIs, const int numImg,
-    const int channels, const int width, const int height,
+    const int numROIs, const int channels, const int width, const int height,
     const int pooledWidth, const int pooledHeight, const ElemType* pooledGrad,
-    const ElemType* roiData, ElemType* grad, const ElemType* argmax)
+    ElemType* grad, const ElemType* argmax)
 {
-    // index loops over all input locations (locations in the original input tensor).
+    // index loops over all totalRois*c*pooledHeight*pooledWidth output locations.
     for (int index = blockIdx.x * blockDim.x + threadIdx.x;
         index < (totalIterations); index += blockDim.x * gridDim.x)
     {
+        // an empty window has no argmax
+        int maxidx = (int)argmax[index];
+        if (maxidx < 0)
+            continue;
+
+        int c = (index / pooledWidth / pooledHeight) % channels;
+        int n =  index / pooledWidth / pooledHeight  / channels;
+
         // images are laid out [W x H x C x N]
-        // (n, c, h, w) is an element in the input image
-        int w =  index % width;
-        int h = (index / width) % height;
-        int c = (index / width  / height) % channels;
-        int n =  index / width  / height  / channels;
+        atomicAdd(&grad[((n / numROIs) * channels + c) * height * width + maxidx], pooledGrad[index]);
+    }
+}
+
+// Computes the input locations and weights of the bilinear interpolation of a [width x height]
+// plane at (x, y), relative to the pixel centers. Samples more than a pixel outside of the plane
+// have zero weights.
+template <typename ElemType>
+__device__ void ROIAlignBilinear(ElemType x, ElemType y, const int width, const int height, int* indices, ElemType* weights)
+{
+    if (y < -1 || y > (ElemType)height || x < -1 || x > (ElemType)width)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            indices[k] = 0;
+            weights[k] = 0;
+        }
+        return;
+    }
+
+    y = max(y, (ElemType)0);
+    x = max(x, (ElemType)0);
+    int yLow  = min((int)y, height - 1);
+    int xLow  = min((int)x, width - 1);
+    int yHigh = min(yLow + 1, height - 1);
+    int xHigh = min(xLow + 1, width - 1);
+    ElemType ly = yLow < height - 1 ? y - yLow : (ElemType)0;
+    ElemType lx = xLow < width  - 1 ? x - xLow : (ElemType)0;
+
+    indices[0] = xLow  + yLow  * width; weights[0] = (1 - ly) * (1 - lx);
+    indices[1] = xHigh + yLow  * width; weights[1] = (1 - ly) * lx;
+    indices[2] = xLow  + yHigh * width; weights[2] = ly * (1 - lx);
+    indices[3] = xHigh + yHigh * width; weights[3] = ly * lx;
+}
+
+// Stages the sampling grid of the ROI in shared memory: its start and bin size in each dimension,
+// and the number of samples per bin in each dimension. See CPUMatrix::ROIAlignForward for the
+// definition of the samples.
+template <typename ElemType>
+__device__ void ROIAlignStageROI(const ElemType* roi, const int width, const int height,
+    const int pooledWidth, const int pooledHeight, const int samplingRatio, ElemType* window, int* grid)
+{
+    __syncthreads(); // all threads are done with the previous ROI
+    if (threadIdx.x == 0)
+    {
+        // roi data is relative to original image size
+        window[0] = roi[0] * width;
+        window[1] = roi[1] * height;
+        window[2] = max(roi[2] * width,  (ElemType)1) / (ElemType)pooledWidth;
+        window[3] = max(roi[3] * height, (ElemType)1) / (ElemType)pooledHeight;
+        grid[0] = samplingRatio > 0 ? samplingRatio : max((int)ceil(window[2]), 1);
+        grid[1] = samplingRatio > 0 ? samplingRatio : max((int)ceil(window[3]), 1);
+    }
+    __syncthreads();
+}
 
-        // compute range of ROIs corresponding to this image:
-        int roiMin = n * numROIs;
-        int roiMax = (n + 1) * numROIs;
+// ROIAlign variant of kROIPoolingForward: each output location is the average of the input,
+// bilinearly interpolated at a regular grid of samples in its bin.
+template <typename ElemType>
+__global__ void kROIAlignForward(const int totalRois, const int numROIs,
+    const int channels, const int width, const int height,
+    const int pooledWidth, const int pooledHeight, const int samplingRatio,
+    const ElemType* src, const ElemType* roiData, ElemType* dst)
+{
+    // (start w, start h, bin width, bin height), and (samples per bin width, samples per bin height)
+    __shared__ ElemType window[4];
+    __shared__ int grid[2];
+
+    const int roiOutputSize = channels * pooledHeight * pooledWidth;
 
-        ElemType gradient = 0;
+    for (int n = blockIdx.y; n < totalRois; n += gridDim.y)
+    {
+        ROIAlignStageROI(roiData + n * 4, width, height, pooledWidth, pooledHeight, samplingRatio, window, grid);
+        const ElemType binW = window[2], binH = window[3];
+        const int gridW = grid[0], gridH = grid[1];
 
-        for (int roiN = roiMin; roiN < roiMax; roiN++)
+        for (int index = blockIdx.x * blockDim.x + threadIdx.x;
+             index < roiOutputSize; index += blockDim.x * gridDim.x)
         {
-            // each ROI is 4 elements: (x, y, w, h)
-            const ElemType* roiOffset = roiData + roiN * 4;
-
-            // ROI data is relative to original image size
-            int roiStartW = (int)(    round_(roiOffset[0] * width));
-            int roiStartH = (int)(    round_(roiOffset[1] * height));
-            int roiWidth  = (int)(max(round_(roiOffset[2] * width), 1.0));
-            int roiHeight = (int)(max(round_(roiOffset[3] * height), 1.0));
-
-            // skip this ROI if it doesn't contain our input location.
-            const bool inROI = (w >= roiStartW && w < roiStartW + roiWidth &&
-                                h >= roiStartH && h < roiStartH + roiHeight);
-            if (!inROI)
-                continue;
+            int pw =  index % pooledWidth;
+            int ph = (index / pooledWidth) % pooledHeight;
+            int c  =  index / pooledWidth  / pooledHeight;
+
+            int imgIdx = n / numROIs;
+            const ElemType* plane = src + (imgIdx * channels + c) * height * width;
+            ElemType sum = 0;
+            for (int iy = 0; iy < gridH; iy++)
+            {
+                ElemType y = window[1] + ph * binH + (iy + (ElemType)0.5) * binH / gridH - (ElemType)0.5;
+                for (int ix = 0; ix < gridW; ix++)
+                {
+                    ElemType x = window[0] + pw * binW + (ix + (ElemType)0.5) * binW / gridW - (ElemType)0.5;
+                    int indices[4];
+                    ElemType weights[4];
+                    ROIAlignBilinear(x, y, width, height, indices, weights);
+                    for (int k = 0; k < 4; k++)
+                        sum += weights[k] * plane[indices[k]];
+                }
+            }
+            dst[n * roiOutputSize + index] = sum / (gridW * gridH);
+        }
+    }
+}
 
-            ElemType winH = (ElemType)roiHeight / (ElemType)pooledHeight;
-            ElemType winW = (ElemType)roiWidth  / (ElemType)pooledWidth;
+// Backward pass of kROIAlignForward: each output location adds its gradient to the input
+// locations it was interpolated from, with their weights. Overlapping ROIs, and neighboring
+// bins, update the same input locations, hence the updates are atomic.
+template <typename ElemType>
+__global__ void kROIAlignBackward(const int totalRois, const int numROIs,
+    const int channels, const int width, const int height,
+    const int pooledWidth, const int pooledHeight, const int samplingRatio,
+    const ElemType* pooledGrad, const ElemType* roiData, ElemType* grad)
+{
+    __shared__ ElemType window[4];
+    __shared__ int grid[2];
+
+    const int roiOutputSize = channels * pooledHeight * pooledWidth;
 
-            // what pooled nodes in the output for this ROI could have pooled this input location?
-            // we use int here since the computation can yield a negative result
-            int phstart = (int)(      (float)(h - roiStartH)     / winH);
-            int pwstart = (int)(      (float)(w - roiStartW)     / winW);
-            int phend   = (int)(ceilf((float)(h - roiStartH + 1) / winH));
-            int pwend   = (int)(ceilf((float)(w - roiStartW + 1) / winW));
+    for (int n = blockIdx.y; n < totalRois; n += gridDim.y)
+    {
+        ROIAlignStageROI(roiData + n * 4, width, height, pooledWidth, pooledHeight, samplingRatio, window, grid);
+        const ElemType binW = window[2], binH = window[3];
+        const int gridW = grid[0], gridH = grid[1];
 
-            phstart = min(max(phstart, 0), pooledHeight);
-            pwstart = min(max(pwstart, 0), pooledWidth);
-            phend   = min(max(phend, 0), pooledHeight);
-            pwend   = min(max(pwend, 0), pooledWidth);
+        for (int index = blockIdx.x * blockDim.x + threadIdx.x;
+             index < roiOutputSize; index += blockDim.x * gridDim.x)
+        {
+            ElemType g = pooledGrad[n * roiOutputSize + index] / (gridW * gridH);
+            if (g == 0)
+                continue;
 
-            // go right up to this channel of this ROI.
-            int offset = (roiN * channels + c) * pooledWidth * pooledHeight;
-            const ElemType* offsetPoolGrad = pooledGrad + offset;
-            const ElemType* offsetArgmax = argmax + offset;
+            int pw =  index % pooledWidth;
+            int ph = (index / pooledWidth) % pooledHeight;
+            int c  =  index / pooledWidth  / pooledHeight;
 
-            for (int ph = phstart; ph < phend; ph++)
+            int imgIdx = n / numROIs;
+            ElemType* plane = grad + (imgIdx * channels + c) * height * width;
+            for (int iy = 0; iy < gridH; iy++)
             {
-                for (int pw = pwstart; pw < pwend; pw++)
+                ElemType y = window[1] + ph * binH + (iy + (ElemType)0.5) * binH / gridH - (ElemType)0.5;
+                for (int ix = 0; ix < gridW; ix++)
                 {
-                    if ((int)offsetArgmax[ph * pooledWidth + pw] == (h * width + w))
-                        gradient += offsetPoolGrad[ph * pooledWidth + pw];
+                    ElemType x = window[0] + pw * binW + (ix + (ElemType)0.5) * binW / gridW - (ElemType)0.5;
+                    int indices[4];
+                    ElemType weights[4];
+                    ROIAlignBilinear(x, y, width, height, indices, weights);
+                    for (int k = 0; k < 4; k++)
+                    {
+                        if (weights[k] != 0)
+                            atomicAdd(&plane[indices[k]], weights[k] * g);
+                    }
                 }
             }
         }
-        grad[index] = gradient;
     }
 }
 
@@ -156,8 +156,8 @@ protected:
 
     void EnsureCompatible() override
     {
-        if (m_imageLayout != ImageLayoutKind::CHW)
-            RuntimeError("Reference convolution engine supports only CHW/cudnn layout.");
+        if (m_imageLayout != ImageLayoutKind::CHW && m_imageLayout != ImageLayoutKind::NHWC)
+            RuntimeError("Reference convolution engine supports only CHW/cudnn and NHWC layouts.");
     }
 
     void EnsureConvolutionInitialized() override
@@ -284,6 +284,8 @@ protected:
     {
         if (m_imageLayout != ImageLayoutKind::HWC)
             RuntimeError("Legacy convolution engine supports only HWC/legacy layout.");
+        if (m_geometry->Groups() > 1)
+            RuntimeError("Legacy convolution engine does not support grouped convolutions.");
     }
 
     void EnsureConvolutionInitialized() override
@@ -565,6 +567,8 @@ public:
     {
     }
 
+    bool SupportsInt8Forward() const override { return true; }
+
 protected:
     using typename Base::IntMatPtr;
 
@@ -574,6 +578,7 @@ protected:
     using Base::m_deviceId;
     using Base::m_imageLayout;
     using Base::m_maxTempMemSizeInSamples;
+    using Base::m_int8InputRange;
 
     using Base::m_mpRowCol;
     using Base::m_mpRowIwht;
@@ -607,8 +612,14 @@ protected:
     //    [XYC x NW'H']^T * [XYC x K] -> [NW'H' x K]
     // 3. Reshape and transpose result: [NW'H' x K] -> [N x W'H'K]^T -> [W'H'K x N]
     //    In case minibatch size == 1 this step is not required and step 2 writes results directly to output (out).
+    // With int8 inference, step 2 is done by Int8ChannelwiseMultiplier, which computes [K x NW'H'], and step 3
+    // is done while de-quantizing it.
     void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
     {
+        // the kernel may have changed since int8 was on
+        if (m_int8InputRange <= 0)
+            m_int8Multiplier.reset();
+
         size_t batchSize = in.GetNumCols();
         size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
 
@@ -642,6 +653,12 @@ protected:
             auto kern = kernel.ColumnSlice(0, kernel.GetNumCols());
             kern.Reshape(unrollCols, kernel.GetNumElements()/unrollCols);
 
+            if (m_int8InputRange > 0)
+            {
+                ForwardInt8(unrolledInput, kern, mapOutSize, mapCount, curBatchSize, out.Data() + start * out.GetNumRows());
+                continue;
+            }
+
             // Perform matrix multiplication of unrolled inputs with weights.
             // If there is just one sample in the sub-batch then compute result directly to the output matrix.
             if (curBatchSize == 1)
@@ -667,6 +684,27 @@ protected:
         }
     }
     
+    // [XYC x K]^T * [XYC x NW'H'] -> [K x NW'H'] in int8, then reshape and transpose like step 3 above.
+    void ForwardInt8(const Mat& unrolledInput, const Mat& kern, size_t mapOutSize, size_t mapCount, size_t batchSize, ElemType* out)
+    {
+        if (!m_int8Multiplier || m_int8Multiplier->InputRange() != m_int8InputRange)
+            m_int8Multiplier = std::make_unique<Int8ChannelwiseMultiplier<ElemType>>(m_int8InputRange, /*weightsTransposed=*/true);
+
+        size_t unrollCols = kern.GetNumRows();
+        size_t resultSize = mapCount * mapOutSize * batchSize;
+        m_int8Result.resize(resultSize);
+        m_int8Multiplier->Multiply((int)mapCount, (int)(mapOutSize * batchSize), (int)unrollCols, kern.Data(), unrolledInput.Data(), m_int8Result.data());
+
+        // Column j of the result is sample j % batchSize at position j / batchSize (see the unrolling above).
+        for (size_t j = 0; j < mapOutSize * batchSize; j++)
+        {
+            const ElemType* col = &m_int8Result[j * mapCount];
+            ElemType* sampleOut = out + (j % batchSize) * mapOutSize * mapCount + j / batchSize;
+            for (size_t map = 0; map < mapCount; map++)
+                sampleOut[map * mapOutSize] = col[map];
+        }
+    }
+
     // The backward data method works by representing this operation as a "reverse" convolution
     // in case kernel's last dimension is equal to input dimension. Gradients matrix (grad) becomes
     // an output of such reverse convolution.
@@ -843,9 +881,928 @@ protected:
 public:
     static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
     {
-        return deviceId < 0 &&
+        return deviceId < 0 && geometry->Groups() == 1 &&
                find(begin(geometry->Sharing()), end(geometry->Sharing()), false) == end(geometry->Sharing());
     }
+
+private:
+    std::unique_ptr<Int8ChannelwiseMultiplier<ElemType>> m_int8Multiplier;
+    std::vector<ElemType> m_int8Result;
+};
+
+// True for a 2D convolution on the CPU with full sharing and stride 1, where the kernel covers all input channels,
+// i.e. input [W x H x C], kernel [X x Y x C] and output [W' x H' x K]: the convolutions of the Winograd and FFT engines.
+static bool IsPlain2DConvolution(DEVICEID_TYPE deviceId, const ConvolveGeometry& geometry)
+{
+    const auto& inT = geometry.InputShape();
+    const auto& kernT = geometry.KernelShape();
+    const auto& outT = geometry.OutputShape();
+    const auto& mapCount = geometry.MapCount();
+    return deviceId < 0 &&
+           inT.GetRank() == 3 && kernT[2] == inT[2] &&
+           find(begin(geometry.Sharing()), end(geometry.Sharing()), false) == end(geometry.Sharing()) &&
+           mapCount.GetNumElements() == mapCount[mapCount.GetRank() - 1] && outT[2] == mapCount.GetNumElements() &&
+           geometry.GetStride(0) == 1 && geometry.GetStride(1) == 1;
+}
+
+// The matrices of Winograd's minimal filtering algorithm F(m x m, 3 x 3) with tiles of a = m + 2 (Lavin, Gray):
+// the input transform B^T [a x a], the kernel transform G [a x 3] and the output transform A^T [m x a], row-major.
+template <size_t M>
+struct WinogradMatrices;
+
+template <>
+struct WinogradMatrices<2>
+{
+    static const double* BT() { static const double m[] = { 1, 0, -1, 0,   0, 1, 1, 0,   0, -1, 1, 0,   0, 1, 0, -1 }; return m; }
+    static const double* G()  { static const double m[] = { 1, 0, 0,   0.5, 0.5, 0.5,   0.5, -0.5, 0.5,   0, 0, 1 }; return m; }
+    static const double* AT() { static const double m[] = { 1, 1, 1, 0,   0, 1, -1, -1 }; return m; }
+};
+
+template <>
+struct WinogradMatrices<4>
+{
+    static const double* BT()
+    {
+        static const double m[] = { 4,  0, -5,  0, 1, 0,
+                                    0, -4, -4,  1, 1, 0,
+                                    0,  4, -4, -1, 1, 0,
+                                    0, -2, -1,  2, 1, 0,
+                                    0,  2, -1, -2, 1, 0,
+                                    0,  4,  0, -5, 0, 1 };
+        return m;
+    }
+    static const double* G()
+    {
+        static const double m[] = {  1.0 / 4,        0,       0,
+                                    -1.0 / 6, -1.0 / 6, -1.0 / 6,
+                                    -1.0 / 6,  1.0 / 6, -1.0 / 6,
+                                    1.0 / 24, 1.0 / 12,  1.0 / 6,
+                                    1.0 / 24, -1.0 / 12, 1.0 / 6,
+                                           0,        0,       1 };
+        return m;
+    }
+    static const double* AT()
+    {
+        static const double m[] = { 1, 1,  1, 1,  1, 0,
+                                    0, 1, -1, 2, -2, 0,
+                                    0, 1,  1, 4,  4, 0,
+                                    0, 1, -1, 8, -8, 1 };
+        return m;
+    }
+};
+
+// Y = L X L^T for row-major L [R x S], X [S x S] and Y [R x R].
+template <class ElemType, size_t R, size_t S>
+static inline void SandwichProduct(const ElemType* L, const ElemType* X, ElemType* Y)
+{
+    ElemType LX[R * S];
+    for (size_t i = 0; i < R; i++)
+    {
+        for (size_t q = 0; q < S; q++)
+        {
+            ElemType sum = 0;
+            for (size_t p = 0; p < S; p++)
+                sum += L[i * S + p] * X[p * S + q];
+            LX[i * S + q] = sum;
+        }
+    }
+    for (size_t i = 0; i < R; i++)
+    {
+        for (size_t j = 0; j < R; j++)
+        {
+            ElemType sum = 0;
+            for (size_t q = 0; q < S; q++)
+                sum += LX[i * S + q] * L[j * S + q];
+            Y[i * R + j] = sum;
+        }
+    }
+}
+
+//------------------------------------------------------------------
+// Winograd convolution engine, for 2D convolutions with 3x3 kernels and stride 1 on the CPU
+// (Fast Algorithms for Convolutional Neural Networks; Lavin, Gray).
+// The output is computed in tiles of m x m from tiles of a x a of the input, a = m + 2, as
+// Y = A^T [(G g G^T) .* (B^T d B)] A, where the sum over the input channels of the elementwise product
+// becomes a GEMM for each of the a x a positions: [K x C] * [C x T] -> [K x T] for T tiles.
+// F(4x4, 3x3) needs 2.25 multiplications per output and input channel, instead of 9 for unroll + GEMM,
+// and a transformed input of 2.25 instead of 9 times the size of the input; F(2x2, 3x3) (4 multiplications)
+// is used for outputs smaller than 4 x 4. The transforms add a relative error of about 1e-6 (F(2x2)) and 1e-5 (F(4x4)) in float.
+// Uses the GEMM engine for backpropagation, int8 inference and pooling.
+//------------------------------------------------------------------
+template <class ElemType>
+class WinogradConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    WinogradConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind), m_transformedKernel(deviceId)
+    {
+    }
+
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        return IsPlain2DConvolution(deviceId, *geometry) && geometry->KernelShape()[0] == 3 && geometry->KernelShape()[1] == 3;
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_maxTempMemSizeInSamples;
+    using Base::m_int8InputRange;
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        const auto& outT = m_geometry->OutputShape();
+        if (m_int8InputRange > 0)
+            Base::ForwardCore(in, kernel, out, workspace);
+        else if (outT[0] >= 4 && outT[1] >= 4)
+            ForwardTiles<4>(in, kernel, out, workspace);
+        else
+            ForwardTiles<2>(in, kernel, out, workspace);
+    }
+
+private:
+    template <size_t M>
+    void ForwardTiles(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        const size_t A = M + 2;
+        const size_t A2 = A * A;
+        ElemType BT[A * A], G[A * 3], AT[M * A];
+        std::copy(WinogradMatrices<M>::BT(), WinogradMatrices<M>::BT() + A * A, BT);
+        std::copy(WinogradMatrices<M>::G(), WinogradMatrices<M>::G() + A * 3, G);
+        std::copy(WinogradMatrices<M>::AT(), WinogradMatrices<M>::AT() + M * A, AT);
+
+        const auto& inT = m_geometry->InputShape();
+        const auto& outT = m_geometry->OutputShape();
+        const size_t inW = inT[0], inH = inT[1], C = inT[2];
+        const size_t outW = outT[0], outH = outT[1], K = outT[2];
+        const int padW = m_geometry->GetLowerPad(0), padH = m_geometry->GetLowerPad(1);
+        const size_t tilesW = (outW + M - 1) / M, tilesH = (outH + M - 1) / M, tilesPerSample = tilesW * tilesH;
+
+        size_t batchSize = in.GetNumCols();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+        size_t maxTiles = tilesPerSample * subBatchSize;
+
+        // The transformed kernel U, the transformed input V and their product, each as a x a matrices:
+        // U [K x C], V [C x T] and UV [K x T] at each position of the tile. U is kept until the kernel changes.
+        if (m_transformedKernel.IsEmpty() || memcmp(m_kernel.data(), kernel.Data(), m_kernel.size() * sizeof(ElemType)) != 0)
+        {
+            // cudnn layout uses row-major kernel weight matrix: kernel k is [3 x 3 x C] at k * 9C.
+            m_kernel.assign(kernel.Data(), kernel.Data() + K * 9 * C);
+            m_transformedKernel.Resize(K, A2 * C);
+            ElemType* U = m_transformedKernel.Data();
+#pragma omp parallel for
+            for (long kc = 0; kc < (long)(K * C); kc++)
+            {
+                size_t k = kc % K, c = kc / K;
+                ElemType u[A * A];
+                SandwichProduct<ElemType, A, 3>(G, m_kernel.data() + k * 9 * C + c * 9, u);
+                for (size_t xi = 0; xi < A2; xi++)
+                    U[(xi * C + c) * K + k] = u[xi];
+            }
+        }
+
+        size_t maxSizeV = A2 * C * maxTiles, maxSizeUV = A2 * K * maxTiles;
+        workspace.Resize(1, maxSizeV + maxSizeUV);
+        ElemType* V = workspace.Data();
+        ElemType* UV = V + maxSizeV;
+
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+            size_t T = tilesPerSample * curBatchSize;
+
+            // Transform the input tiles, zero outside of the input.
+            const ElemType* inData = in.Data() + start * in.GetNumRows();
+#pragma omp parallel for
+            for (long tc = 0; tc < (long)(T * C); tc++)
+            {
+                size_t t = tc / C, c = tc % C;
+                size_t sample = t / tilesPerSample, tile = t % tilesPerSample;
+                int x0 = (int)((tile % tilesW) * M) - padW, y0 = (int)((tile / tilesW) * M) - padH;
+                const ElemType* src = inData + sample * in.GetNumRows() + c * inW * inH;
+                ElemType d[A * A], v[A * A];
+                for (size_t p = 0; p < A; p++)
+                {
+                    int y = y0 + (int)p;
+                    for (size_t q = 0; q < A; q++)
+                    {
+                        int x = x0 + (int)q;
+                        d[p * A + q] = (x >= 0 && x < (int)inW && y >= 0 && y < (int)inH) ? src[x + inW * y] : 0;
+                    }
+                }
+                SandwichProduct<ElemType, A, A>(BT, d, v);
+                for (size_t xi = 0; xi < A2; xi++)
+                    V[(xi * T + t) * C + c] = v[xi];
+            }
+
+            // The products for all positions of the tile.
+            for (size_t xi = 0; xi < A2; xi++)
+            {
+                auto matU = m_transformedKernel.ColumnSlice(xi * C, C);
+                auto matV = workspace.ColumnSlice(xi * C * T, C * T);
+                matV.Reshape(C, T);
+                auto matUV = workspace.ColumnSlice(maxSizeV + xi * K * T, K * T);
+                matUV.Reshape(K, T);
+                Mat::Multiply(matU, false, matV, false, matUV);
+            }
+
+            // Transform the output tiles and write the parts that are inside of the output.
+            ElemType* outData = out.Data() + start * out.GetNumRows();
+#pragma omp parallel for
+            for (long tk = 0; tk < (long)(T * K); tk++)
+            {
+                size_t t = tk / K, k = tk % K;
+                size_t sample = t / tilesPerSample, tile = t % tilesPerSample;
+                size_t x0 = (tile % tilesW) * M, y0 = (tile / tilesW) * M;
+                ElemType m[A * A], y[M * M];
+                for (size_t xi = 0; xi < A2; xi++)
+                    m[xi] = UV[(xi * T + t) * K + k];
+                SandwichProduct<ElemType, M, A>(AT, m, y);
+                ElemType* dst = outData + sample * out.GetNumRows() + k * outW * outH;
+                for (size_t p = 0; p < M && y0 + p < outH; p++)
+                    for (size_t q = 0; q < M && x0 + q < outW; q++)
+                        dst[(x0 + q) + outW * (y0 + p)] = y[p * M + q];
+            }
+        }
+    }
+
+    std::vector<ElemType> m_kernel;
+    Mat m_transformedKernel;
+};
+
+// Radix-2 fast Fourier transform of a fixed size n (a power of 2), in place on separate real and imaginary parts.
+template <class ElemType>
+class RadixTwoFFT
+{
+public:
+    RadixTwoFFT(size_t n)
+        : m_n(n), m_bitReverse(n), m_cos(n / 2), m_sin(n / 2)
+    {
+        size_t bits = 0;
+        while (((size_t)1 << bits) < n)
+            bits++;
+        if (((size_t)1 << bits) != n)
+            LogicError("RadixTwoFFT: size %d is not a power of 2.", (int)n);
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t r = 0;
+            for (size_t b = 0; b < bits; b++)
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            m_bitReverse[i] = r;
+        }
+        const double pi = 3.14159265358979323846;
+        for (size_t i = 0; i < n / 2; i++)
+        {
+            m_cos[i] = (ElemType)cos(2 * pi * i / n);
+            m_sin[i] = (ElemType)sin(2 * pi * i / n);
+        }
+    }
+
+    size_t Size() const { return m_n; }
+
+    // Transforms the n elements re[i * stride], im[i * stride]; the inverse is not scaled by 1/n.
+    void Transform(ElemType* re, ElemType* im, ptrdiff_t stride, bool inverse) const
+    {
+        for (size_t i = 0; i < m_n; i++)
+        {
+            size_t r = m_bitReverse[i];
+            if (r > i)
+            {
+                std::swap(re[i * stride], re[r * stride]);
+                std::swap(im[i * stride], im[r * stride]);
+            }
+        }
+        ElemType sign = inverse ? 1 : -1;
+        for (size_t len = 2; len <= m_n; len *= 2)
+        {
+            size_t half = len / 2, step = m_n / len;
+            for (size_t i = 0; i < m_n; i += len)
+            {
+                for (size_t j = 0; j < half; j++)
+                {
+                    ElemType wr = m_cos[j * step], wi = sign * m_sin[j * step];
+                    ElemType* ar = re + (i + j) * stride;
+                    ElemType* ai = im + (i + j) * stride;
+                    ElemType* br = re + (i + j + half) * stride;
+                    ElemType* bi = im + (i + j + half) * stride;
+                    ElemType tr = *br * wr - *bi * wi;
+                    ElemType ti = *br * wi + *bi * wr;
+                    *br = *ar - tr;
+                    *bi = *ai - ti;
+                    *ar += tr;
+                    *ai += ti;
+                }
+            }
+        }
+    }
+
+private:
+    size_t m_n;
+    std::vector<size_t> m_bitReverse;
+    std::vector<ElemType> m_cos;
+    std::vector<ElemType> m_sin;
+};
+
+//------------------------------------------------------------------
+// FFT convolution engine, for 2D convolutions with large kernels and stride 1 on the CPU
+// (Fast Training of Convolutional Networks through FFTs; Mathieu, Henaff, LeCun).
+// Each input channel and each kernel is zero-padded to P x Q (powers of 2 that hold an output plus a kernel)
+// and transformed, the convolution becomes the sum over the input channels of the products of the spectra
+// (with the conjugate kernel spectrum, as this is a cross-correlation), which is transformed back.
+// As the inputs are real, only the P/2 + 1 non-redundant columns of the spectra are stored and multiplied.
+// This costs about P Q / 2 complex multiply-adds per pair of input and output channels (plus the transforms), instead of
+// W' H' X Y multiply-adds for unroll + GEMM, so it pays off for large kernels on many channels where W' + X - 1 and
+// H' + Y - 1 are not much smaller than a power of 2. The kernel spectra are kept until the kernel changes.
+// Uses the GEMM engine for backpropagation, int8 inference and pooling.
+//------------------------------------------------------------------
+template <class ElemType>
+class FFTConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    FFTConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind),
+        m_fftW(FFTSize(geometry->OutputShape()[0] + geometry->KernelShape()[0] - 1)),
+        m_fftH(FFTSize(geometry->OutputShape()[1] + geometry->KernelShape()[1] - 1))
+    {
+    }
+
+    // Supported where it is estimated to be faster than the GEMM engine.
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        if (!IsPlain2DConvolution(deviceId, *geometry))
+            return false;
+        const auto& kernT = geometry->KernelShape();
+        const auto& outT = geometry->OutputShape();
+        double C = (double)kernT[2], K = (double)outT[2];
+        double P = (double)FFTSize(outT[0] + kernT[0] - 1), Q = (double)FFTSize(outT[1] + kernT[1] - 1);
+        // Per sample, in multiply-adds of the GEMM: the GEMM does W' H' X Y C K of them. Measured on AVX2/AVX-512 CPUs,
+        // a complex multiply-add of the spectra costs about 24 of them and a 2D FFT about 30 P Q log2(P Q).
+        double gemmCost = (double)outT[0] * outT[1] * kernT[0] * kernT[1] * C * K;
+        double fftCost = 24 * C * K * (P / 2 + 1) * Q + 30 * (C + K) * P * Q * log2(P * Q);
+        return fftCost < gemmCost;
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_maxTempMemSizeInSamples;
+    using Base::m_int8InputRange;
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        if (m_int8InputRange > 0)
+            return Base::ForwardCore(in, kernel, out, workspace);
+
+        const auto& inT = m_geometry->InputShape();
+        const auto& kernT = m_geometry->KernelShape();
+        const auto& outT = m_geometry->OutputShape();
+        const size_t inW = inT[0], inH = inT[1], C = inT[2];
+        const size_t kW = kernT[0], kH = kernT[1];
+        const size_t outW = outT[0], outH = outT[1], K = outT[2];
+        const int padW = m_geometry->GetLowerPad(0), padH = m_geometry->GetLowerPad(1);
+        const size_t P = m_fftW.Size(), Q = m_fftH.Size();
+        // a spectrum is [P/2+1 x Q], the real parts followed by the imaginary parts
+        const size_t specW = P / 2 + 1, specSize = specW * Q;
+
+        // cudnn layout uses row-major kernel weight matrix: kernel k is [X x Y x C] at k * XYC.
+        size_t kernelSize = kW * kH * C;
+        if (m_kernelSpectra.empty() || memcmp(m_kernel.data(), kernel.Data(), m_kernel.size() * sizeof(ElemType)) != 0)
+        {
+            m_kernel.assign(kernel.Data(), kernel.Data() + K * kernelSize);
+            m_kernelSpectra.resize(K * C * 2 * specSize);
+#pragma omp parallel for
+            for (long kc = 0; kc < (long)(K * C); kc++)
+            {
+                size_t k = kc / C, c = kc % C;
+                const ElemType* src = m_kernel.data() + k * kernelSize + c * kW * kH;
+                Transform(m_fftW, m_fftH, [&](size_t x, size_t y) { return x < kW && y < kH ? src[x + kW * y] : 0; },
+                          m_kernelSpectra.data() + kc * 2 * specSize);
+            }
+        }
+
+        size_t batchSize = in.GetNumCols();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+        workspace.Resize(1, subBatchSize * C * 2 * specSize);
+        ElemType* inSpectra = workspace.Data();
+
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+
+            // Spectra of the input channels, each padded part of the input that the outputs need in the corner.
+            const ElemType* inData = in.Data() + start * in.GetNumRows();
+#pragma omp parallel for
+            for (long nc = 0; nc < (long)(curBatchSize * C); nc++)
+            {
+                size_t sample = nc / C, c = nc % C;
+                const ElemType* src = inData + sample * in.GetNumRows() + c * inW * inH;
+                Transform(m_fftW, m_fftH, [&](size_t x, size_t y)
+                          {
+                              int ix = (int)x - padW, iy = (int)y - padH;
+                              return x < outW + kW - 1 && y < outH + kH - 1 && ix >= 0 && ix < (int)inW && iy >= 0 && iy < (int)inH ? src[ix + inW * iy] : 0;
+                          },
+                          inSpectra + nc * 2 * specSize);
+            }
+
+            // Sum of the products of the spectra over the input channels, and back to the output.
+            // Each kernel spectrum is applied to all samples of the sub-batch at once, so that it is read once.
+            ElemType* outData = out.Data() + start * out.GetNumRows();
+#pragma omp parallel for
+            for (long k = 0; k < (long)K; k++)
+            {
+                std::vector<ElemType> acc(curBatchSize * 2 * specSize, 0);
+                for (size_t c = 0; c < C; c++)
+                {
+                    const ElemType* kRe = m_kernelSpectra.data() + (k * C + c) * 2 * specSize;
+                    const ElemType* kIm = kRe + specSize;
+                    for (size_t sample = 0; sample < curBatchSize; sample++)
+                    {
+                        const ElemType* xRe = inSpectra + (sample * C + c) * 2 * specSize;
+                        const ElemType* xIm = xRe + specSize;
+                        ElemType* accRe = acc.data() + sample * 2 * specSize;
+                        ElemType* accIm = accRe + specSize;
+                        for (size_t f = 0; f < specSize; f++)
+                        {
+                            accRe[f] += xRe[f] * kRe[f] + xIm[f] * kIm[f];
+                            accIm[f] += xIm[f] * kRe[f] - xRe[f] * kIm[f];
+                        }
+                    }
+                }
+                for (size_t sample = 0; sample < curBatchSize; sample++)
+                    InverseTransform(m_fftW, m_fftH, acc.data() + sample * 2 * specSize, outData + sample * out.GetNumRows() + k * outW * outH, outW, outH);
+            }
+        }
+    }
+
+private:
+    static size_t FFTSize(size_t n)
+    {
+        size_t size = 1;
+        while (size < n)
+            size *= 2;
+        return size;
+    }
+
+    // The non-redundant half [P/2+1 x Q] of the spectrum of the real P x Q image value(x, y).
+    template <class ValueFn>
+    static void Transform(const RadixTwoFFT<ElemType>& fftW, const RadixTwoFFT<ElemType>& fftH, const ValueFn& value, ElemType* spectrum)
+    {
+        const size_t P = fftW.Size(), Q = fftH.Size(), specW = P / 2 + 1, specSize = specW * Q;
+        std::vector<ElemType> re(P * Q), im(P * Q, 0);
+        for (size_t y = 0; y < Q; y++)
+        {
+            for (size_t x = 0; x < P; x++)
+                re[x + P * y] = value(x, y);
+            fftW.Transform(&re[P * y], &im[P * y], 1, /*inverse=*/false);
+        }
+        // only the columns that are stored are needed
+        for (size_t x = 0; x < specW; x++)
+        {
+            fftH.Transform(&re[x], &im[x], P, /*inverse=*/false);
+            for (size_t y = 0; y < Q; y++)
+            {
+                spectrum[x + specW * y] = re[x + P * y];
+                spectrum[specSize + x + specW * y] = im[x + P * y];
+            }
+        }
+    }
+
+    // The top-left outW x outH of the real image of the given half spectrum, divided by P Q.
+    static void InverseTransform(const RadixTwoFFT<ElemType>& fftW, const RadixTwoFFT<ElemType>& fftH, const ElemType* spectrum, ElemType* out, size_t outW, size_t outH)
+    {
+        const size_t P = fftW.Size(), Q = fftH.Size(), specW = P / 2 + 1, specSize = specW * Q;
+        std::vector<ElemType> re(P * Q), im(P * Q);
+        for (size_t x = 0; x < specW; x++)
+        {
+            for (size_t y = 0; y < Q; y++)
+            {
+                re[x + P * y] = spectrum[x + specW * y];
+                im[x + P * y] = spectrum[specSize + x + specW * y];
+            }
+            fftH.Transform(&re[x], &im[x], P, /*inverse=*/true);
+        }
+        // the other columns are the conjugates of the stored ones, mirrored: S(P - x, -y) = conj(S(x, y)),
+        // which still holds after the inverse transform along y
+        for (size_t x = specW; x < P; x++)
+        {
+            for (size_t y = 0; y < Q; y++)
+            {
+                re[x + P * y] = re[(P - x) + P * y];
+                im[x + P * y] = -im[(P - x) + P * y];
+            }
+        }
+        ElemType scale = (ElemType)1 / (P * Q);
+        for (size_t y = 0; y < outH; y++)
+        {
+            fftW.Transform(&re[P * y], &im[P * y], 1, /*inverse=*/true);
+            for (size_t x = 0; x < outW; x++)
+                out[x + outW * y] = re[x + P * y] * scale;
+        }
+    }
+
+    RadixTwoFFT<ElemType> m_fftW;
+    RadixTwoFFT<ElemType> m_fftH;
+    std::vector<ElemType> m_kernel;
+    std::vector<ElemType> m_kernelSpectra;
+};
+
+//------------------------------------------------------------------
+// Direct convolution engine, CPU only, for grouped 2D convolutions with full sharing: input [W x H x C],
+// kernel [X x Y x C/G] and output [W' x H' x K], where the K/G maps of each of the G groups convolve the
+// C/G channels of their group. Unrolling would be mostly zeros (or, for depthwise convolutions with G == C,
+// a GEMM with a single row per map), so this loops over the kernel directly, one output or input plane
+// per thread. Pooling is done by the reference engine.
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectConvolutionEngine : public ReferenceConvolutionEngine<ElemType>
+{
+public:
+    using Base = ReferenceConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+    {
+    }
+
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& outT = geometry->OutputShape();
+        const auto& mapCount = geometry->MapCount();
+        return deviceId < 0 && geometry->Groups() > 1 && inT.GetRank() == 3 &&
+               find(begin(geometry->Sharing()), end(geometry->Sharing()), false) == end(geometry->Sharing()) &&
+               mapCount.GetNumElements() == mapCount[mapCount.GetRank() - 1] && outT[2] == mapCount.GetNumElements();
+    }
+
+protected:
+    using Base::IsGpu;
+
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Direct convolution engine supports only CHW/cudnn layout.");
+        if (IsGpu(m_deviceId))
+            LogicError("Direct convolution engine currently supports only CPU device.");
+    }
+
+    // The geometry in 2D: the input plane [inW x inH], the output plane [outW x outH], the kernel [kW x kH x kC],
+    // and the input cell of the first kernel cell of the first output cell (x0, y0), which is negative with padding.
+    struct Plane2D
+    {
+        int inW, inH, outW, outH, kW, kH, kC, strideW, strideH, x0, y0;
+        size_t C, K, mapsPerGroup;
+    };
+
+    Plane2D Geometry2D() const
+    {
+        const auto& inT = m_geometry->InputShape();
+        const auto& kernT = m_geometry->KernelShape();
+        const auto& outT = m_geometry->OutputShape();
+        Plane2D p;
+        p.inW = (int)inT[0], p.inH = (int)inT[1], p.C = inT[2];
+        p.outW = (int)outT[0], p.outH = (int)outT[1], p.K = outT[2];
+        p.kW = (int)kernT[0], p.kH = (int)kernT[1], p.kC = (int)kernT[2];
+        p.strideW = (int)m_geometry->GetStride(0), p.strideH = (int)m_geometry->GetStride(1);
+        p.x0 = m_geometry->Start()[0] - (p.kW - 1) / 2, p.y0 = m_geometry->Start()[1] - (p.kH - 1) / 2;
+        p.mapsPerGroup = p.K / m_geometry->Groups();
+        return p;
+    }
+
+    // The range [begin, end) of output cells o for which o * stride + offset is inside of an input of size inDim.
+    static void OutputRange(int offset, int stride, int inDim, int outDim, int& begin, int& end)
+    {
+        begin = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+        end = offset >= inDim ? 0 : min(outDim, (inDim - 1 - offset) / stride + 1);
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& /*workspace*/) override
+    {
+        const auto p = Geometry2D();
+        const size_t inPlane = p.inW * p.inH, outPlane = p.outW * p.outH, kernelSize = p.kW * p.kH * p.kC;
+        const long planes = (long)(in.GetNumCols() * p.K);
+#pragma omp parallel for
+        for (long nk = 0; nk < planes; nk++)
+        {
+            size_t n = nk / p.K, k = nk % p.K;
+            const ElemType* src = in.Data() + n * in.GetNumRows() + (k / p.mapsPerGroup) * p.kC * inPlane;
+            const ElemType* w = kernel.Data() + k * kernelSize;
+            ElemType* dst = out.Data() + n * out.GetNumRows() + k * outPlane;
+            std::fill(dst, dst + outPlane, (ElemType)0);
+            for (int c = 0; c < p.kC; c++)
+            {
+                for (int j = 0; j < p.kH; j++)
+                {
+                    int yBegin, yEnd;
+                    OutputRange(p.y0 + j, p.strideH, p.inH, p.outH, yBegin, yEnd);
+                    for (int i = 0; i < p.kW; i++)
+                    {
+                        int xBegin, xEnd;
+                        OutputRange(p.x0 + i, p.strideW, p.inW, p.outW, xBegin, xEnd);
+                        ElemType wv = w[i + p.kW * (j + p.kH * c)];
+                        for (int y = yBegin; y < yEnd; y++)
+                        {
+                            const ElemType* srcRow = src + c * inPlane + (y * p.strideH + p.y0 + j) * p.inW + p.x0 + i;
+                            ElemType* dstRow = dst + y * p.outW;
+                            for (int x = xBegin; x < xEnd; x++)
+                                dstRow[x] += wv * srcRow[x * p.strideW];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& /*workspace*/) override
+    {
+        const auto p = Geometry2D();
+        const size_t inPlane = p.inW * p.inH, outPlane = p.outW * p.outH, kernelSize = p.kW * p.kH * p.kC;
+        const long planes = (long)(srcGrad.GetNumCols() * p.C);
+        // One input channel per thread: it receives the gradients of the maps of its group only.
+#pragma omp parallel for
+        for (long nc = 0; nc < planes; nc++)
+        {
+            size_t n = nc / p.C, cIn = nc % p.C;
+            size_t group = cIn / p.kC;
+            int c = (int)(cIn % p.kC);
+            ElemType* dst = grad.Data() + n * grad.GetNumRows() + cIn * inPlane;
+            if (!accumulateGradient)
+                std::fill(dst, dst + inPlane, (ElemType)0);
+            for (size_t k = group * p.mapsPerGroup; k < (group + 1) * p.mapsPerGroup; k++)
+            {
+                const ElemType* src = srcGrad.Data() + n * srcGrad.GetNumRows() + k * outPlane;
+                const ElemType* w = kernel.Data() + k * kernelSize;
+                for (int j = 0; j < p.kH; j++)
+                {
+                    int yBegin, yEnd;
+                    OutputRange(p.y0 + j, p.strideH, p.inH, p.outH, yBegin, yEnd);
+                    for (int i = 0; i < p.kW; i++)
+                    {
+                        int xBegin, xEnd;
+                        OutputRange(p.x0 + i, p.strideW, p.inW, p.outW, xBegin, xEnd);
+                        ElemType wv = w[i + p.kW * (j + p.kH * c)];
+                        for (int y = yBegin; y < yEnd; y++)
+                        {
+                            ElemType* dstRow = dst + (y * p.strideH + p.y0 + j) * p.inW + p.x0 + i;
+                            const ElemType* srcRow = src + y * p.outW;
+                            for (int x = xBegin; x < xEnd; x++)
+                                dstRow[x * p.strideW] += wv * srcRow[x];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool /*allowReuse*/, Mat& /*workspace*/) override
+    {
+        const auto p = Geometry2D();
+        const size_t inPlane = p.inW * p.inH, outPlane = p.outW * p.outH, kernelSize = p.kW * p.kH * p.kC;
+        const size_t batchSize = in.GetNumCols();
+        // One kernel plane [X x Y] per thread, summed over the samples.
+#pragma omp parallel for
+        for (long kc = 0; kc < (long)(p.K * p.kC); kc++)
+        {
+            size_t k = kc / p.kC;
+            int c = (int)(kc % p.kC);
+            size_t cIn = (k / p.mapsPerGroup) * p.kC + c;
+            ElemType* w = kernelGrad.Data() + k * kernelSize + c * p.kW * p.kH;
+            for (int j = 0; j < p.kH; j++)
+            {
+                int yBegin, yEnd;
+                OutputRange(p.y0 + j, p.strideH, p.inH, p.outH, yBegin, yEnd);
+                for (int i = 0; i < p.kW; i++)
+                {
+                    int xBegin, xEnd;
+                    OutputRange(p.x0 + i, p.strideW, p.inW, p.outW, xBegin, xEnd);
+                    ElemType sum = 0;
+                    for (size_t n = 0; n < batchSize; n++)
+                    {
+                        const ElemType* src = in.Data() + n * in.GetNumRows() + cIn * inPlane;
+                        const ElemType* grad = srcGrad.Data() + n * srcGrad.GetNumRows() + k * outPlane;
+                        for (int y = yBegin; y < yEnd; y++)
+                        {
+                            const ElemType* srcRow = src + (y * p.strideH + p.y0 + j) * p.inW + p.x0 + i;
+                            const ElemType* gradRow = grad + y * p.outW;
+                            for (int x = xBegin; x < xEnd; x++)
+                                sum += gradRow[x] * srcRow[x * p.strideW];
+                        }
+                    }
+                    w[i + p.kW * j] = accumulateGradient ? w[i + p.kW * j] + sum : sum;
+                }
+            }
+        }
+    }
+};
+
+//------------------------------------------------------------------
+// Channels-last convolution engine, CPU only, for the 2D convolutions of the NHWC layout with full sharing:
+// input [C x W x H], kernel [C x X x Y] and output [K x W' x H']. The channels of an input cell are contiguous,
+// so unrolling copies runs of C values into [CXY x W'H'N], and the GEMM with the kernels [CXY x K] gives
+// the output [K x W'H'N] as it is, without the transposes of the GEMM engine. Pooling is done by the reference engine.
+//------------------------------------------------------------------
+template <class ElemType>
+class ChannelsLastConvolutionEngine : public ReferenceConvolutionEngine<ElemType>
+{
+public:
+    using Base = ReferenceConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    ChannelsLastConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+    {
+    }
+
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        const auto& outT = geometry->OutputShape();
+        const auto& mapCount = geometry->MapCount();
+        return deviceId < 0 && geometry->Groups() == 1 && inT.GetRank() == 3 &&
+               find(begin(geometry->Sharing()), end(geometry->Sharing()), false) == end(geometry->Sharing()) &&
+               kernT[0] == inT[0] && geometry->Start()[0] == ((int)kernT[0] - 1) / 2 &&
+               mapCount.GetNumElements() == mapCount[0] && outT[0] == mapCount.GetNumElements();
+    }
+
+protected:
+    using Base::IsGpu;
+
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+    using Base::m_maxTempMemSizeInSamples;
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::NHWC)
+            LogicError("Channels-last convolution engine supports only NHWC layout.");
+        if (IsGpu(m_deviceId))
+            LogicError("Channels-last convolution engine currently supports only CPU device.");
+    }
+
+    // The geometry in 2D: the input [C x inW x inH], the output [K x outW x outH], the kernel [C x kW x kH],
+    // and the input cell of the first kernel cell of the first output cell (x0, y0), which is negative with padding.
+    struct Plane2D
+    {
+        int C, inW, inH, outW, outH, kW, kH, strideW, strideH, x0, y0;
+        size_t K;
+    };
+
+    Plane2D Geometry2D() const
+    {
+        const auto& inT = m_geometry->InputShape();
+        const auto& kernT = m_geometry->KernelShape();
+        const auto& outT = m_geometry->OutputShape();
+        Plane2D p;
+        p.C = (int)inT[0], p.inW = (int)inT[1], p.inH = (int)inT[2];
+        p.K = outT[0], p.outW = (int)outT[1], p.outH = (int)outT[2];
+        p.kW = (int)kernT[1], p.kH = (int)kernT[2];
+        p.strideW = (int)m_geometry->GetStride(1), p.strideH = (int)m_geometry->GetStride(2);
+        p.x0 = m_geometry->Start()[1] - (p.kW - 1) / 2, p.y0 = m_geometry->Start()[2] - (p.kH - 1) / 2;
+        return p;
+    }
+
+    // Unrolls 'batchSize' samples of 'in' into [CXY x W'H'N]: column (x, y, n) holds, for each kernel cell (i, j), the C channels
+    // of the input cell (x * strideW + x0 + i, y * strideH + y0 + j), or zeros outside of the input.
+    static void Unroll(const Plane2D& p, const ElemType* in, size_t inRows, size_t batchSize, ElemType* unrolled)
+    {
+        const size_t unrollRows = p.C * p.kW * p.kH;
+        const long cols = (long)(p.outW * p.outH * batchSize);
+#pragma omp parallel for
+        for (long col = 0; col < cols; col++)
+        {
+            int x = (int)(col % p.outW), y = (int)((col / p.outW) % p.outH);
+            const ElemType* src = in + (col / (p.outW * p.outH)) * inRows;
+            ElemType* dst = unrolled + col * unrollRows;
+            for (int j = 0; j < p.kH; j++)
+            {
+                int iy = y * p.strideH + p.y0 + j;
+                for (int i = 0; i < p.kW; i++, dst += p.C)
+                {
+                    int ix = x * p.strideW + p.x0 + i;
+                    if (0 <= ix && ix < p.inW && 0 <= iy && iy < p.inH)
+                        std::copy(src + (ix + iy * p.inW) * p.C, src + (ix + iy * p.inW + 1) * p.C, dst);
+                    else
+                        std::fill(dst, dst + p.C, (ElemType)0);
+                }
+            }
+        }
+    }
+
+    // The reverse of Unroll(): adds the columns of 'unrolled' to the input cells they were copied from.
+    // One sample per thread, as the kernel applications overlap within a sample.
+    static void Fold(const Plane2D& p, const ElemType* unrolled, size_t batchSize, ElemType* grad, size_t gradRows)
+    {
+        const size_t unrollRows = p.C * p.kW * p.kH;
+#pragma omp parallel for
+        for (long n = 0; n < (long)batchSize; n++)
+        {
+            const ElemType* src = unrolled + n * p.outW * p.outH * unrollRows;
+            for (int y = 0; y < p.outH; y++)
+            {
+                for (int x = 0; x < p.outW; x++)
+                {
+                    for (int j = 0; j < p.kH; j++)
+                    {
+                        int iy = y * p.strideH + p.y0 + j;
+                        for (int i = 0; i < p.kW; i++, src += p.C)
+                        {
+                            int ix = x * p.strideW + p.x0 + i;
+                            if (ix < 0 || ix >= p.inW || iy < 0 || iy >= p.inH)
+                                continue;
+                            ElemType* dst = grad + n * gradRows + (ix + iy * p.inW) * p.C;
+                            for (int c = 0; c < p.C; c++)
+                                dst[c] += src[c];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // [CXY x K]^T * [CXY x W'H'N] -> [K x W'H'N], which is the output [K x W'H' x N].
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        const auto p = Geometry2D();
+        size_t batchSize = in.GetNumCols();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+        size_t unrollRows = p.C * p.kW * p.kH;
+        size_t mapOutSize = p.outW * p.outH;
+        workspace.Resize(unrollRows, mapOutSize * subBatchSize);
+
+        auto kern = kernel.ColumnSlice(0, kernel.GetNumCols());
+        kern.Reshape(unrollRows, p.K);
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+            auto unrolledInput = workspace.ColumnSlice(0, mapOutSize * curBatchSize);
+            Unroll(p, in.Data() + start * in.GetNumRows(), in.GetNumRows(), curBatchSize, unrolledInput.Data());
+            auto outSlice = out.ColumnSlice(start, curBatchSize);
+            outSlice.Reshape(p.K, mapOutSize * curBatchSize);
+            Mat::Multiply(kern, true, unrolledInput, false, outSlice);
+        }
+    }
+
+    // [CXY x K] * [K x W'H'N] -> [CXY x W'H'N], folded into the input gradient.
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace) override
+    {
+        const auto p = Geometry2D();
+        size_t batchSize = srcGrad.GetNumCols();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+        size_t unrollRows = p.C * p.kW * p.kH;
+        size_t mapOutSize = p.outW * p.outH;
+        workspace.Resize(unrollRows, mapOutSize * subBatchSize);
+
+        if (!accumulateGradient)
+            grad.SetValue(0);
+        auto kern = kernel.ColumnSlice(0, kernel.GetNumCols());
+        kern.Reshape(unrollRows, p.K);
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+            auto srcGradSlice = srcGrad.ColumnSlice(start, curBatchSize);
+            srcGradSlice.Reshape(p.K, mapOutSize * curBatchSize);
+            auto unrolledGrad = workspace.ColumnSlice(0, mapOutSize * curBatchSize);
+            Mat::Multiply(kern, false, srcGradSlice, false, unrolledGrad);
+            Fold(p, unrolledGrad.Data(), curBatchSize, grad.Data() + start * grad.GetNumRows(), grad.GetNumRows());
+        }
+    }
+
+    // [CXY x W'H'N] * [K x W'H'N]^T -> [CXY x K], the kernel gradients.
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool /*allowReuse*/, Mat& workspace) override
+    {
+        const auto p = Geometry2D();
+        size_t batchSize = in.GetNumCols();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+        size_t unrollRows = p.C * p.kW * p.kH;
+        size_t mapOutSize = p.outW * p.outH;
+        workspace.Resize(unrollRows, mapOutSize * subBatchSize);
+
+        auto kernGrad = kernelGrad.ColumnSlice(0, kernelGrad.GetNumCols());
+        kernGrad.Reshape(unrollRows, p.K);
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+            auto unrolledInput = workspace.ColumnSlice(0, mapOutSize * curBatchSize);
+            Unroll(p, in.Data() + start * in.GetNumRows(), in.GetNumRows(), curBatchSize, unrolledInput.Data());
+            auto srcGradSlice = srcGrad.ColumnSlice(start, curBatchSize);
+            srcGradSlice.Reshape(p.K, mapOutSize * curBatchSize);
+            Mat::MultiplyAndWeightedAdd(1, unrolledInput, false, srcGradSlice, true, accumulateGradient || start > 0 ? 1 : 0, kernGrad);
+        }
+    }
 };
 
 template <class ElemType>
@@ -875,7 +1832,7 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
 
     // Check if we can use cuDNN engine. Do not need to validate tensors as ConvolveGeometry has already done that.
     if (isEnabled(ConvolutionEngineKind::CuDnn) &&
-        CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId, geometry, poolKind))
+        CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId, geometry, poolKind, imageLayout))
     {
         if (GetMathLibTraceLevel() > 0)
             fprintf(stderr, "%lsusing cuDNN convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
@@ -883,7 +1840,43 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms);
     }
 
-    if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    // NHWC geometries have the channels, and the maps, on the first dimension, which on the CPU only the channels-last
+    // engine (enabled with the GEMM engines) and the reference engine handle. The other engines expect them on the last one.
+    bool channelsLast = imageLayout == ImageLayoutKind::NHWC;
+    if (channelsLast && isEnabled(ConvolutionEngineKind::Gemm) && ChannelsLastConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing channels-last convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<ChannelsLastConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    }
+
+    // Winograd and FFT engines only speed up particular convolutions on the CPU, before the GEMM engine which does the rest.
+    if (!channelsLast && isEnabled(ConvolutionEngineKind::Winograd) && WinogradConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing Winograd convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<WinogradConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    }
+
+    if (!channelsLast && isEnabled(ConvolutionEngineKind::FFT) && FFTConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing FFT convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<FFTConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    }
+
+    if (!channelsLast && isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing direct convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    }
+
+    if (!channelsLast && isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         if (GetMathLibTraceLevel() > 0)
             fprintf(stderr, "%lsusing GEMM convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
@@ -903,4 +1896,80 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
 template class ConvolutionEngine<float>;
 template class ConvolutionEngine<double>;
 
+ConvolutionAlgorithmCache& ConvolutionAlgorithmCache::Instance()
+{
+    static ConvolutionAlgorithmCache cache;
+    return cache;
+}
+
+bool ConvolutionAlgorithmCache::Find(const std::string& key, Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_entries.find(key);
+    if (found == m_entries.end())
+        return false;
+    entry = found->second;
+    return true;
+}
+
+void ConvolutionAlgorithmCache::Add(const std::string& key, const Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries[key] = entry;
+    if (!m_path.empty())
+        Save();
+}
+
+void ConvolutionAlgorithmCache::SetFile(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_path = path;
+    if (!m_path.empty())
+    {
+        Load(m_path, m_entries);
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "Convolution algorithm cache '%ls': %d entries.\n", m_path.c_str(), (int)m_entries.size());
+    }
+}
+
+// One entry per line: the key, the algorithm, the workspace size and the no-workspace algorithm, separated by tabs.
+void ConvolutionAlgorithmCache::Load(const std::wstring& path, std::map<std::string, Entry>& entries)
+{
+    if (!fexists(path))
+        return;
+    FILE* f = fopenOrDie(path, L"rb");
+    while (!feof(f))
+    {
+        std::string line = fgetline(f);
+        size_t keyEnd = line.find('\t');
+        if (line.empty() || keyEnd == std::string::npos)
+            continue;
+        Entry entry;
+        unsigned long long workspaceSize;
+        if (sscanf(line.c_str() + keyEnd + 1, "%d\t%llu\t%d", &entry.Algo, &workspaceSize, &entry.NoWorkspaceAlgo) != 3)
+        {
+            fprintf(stderr, "WARNING: ignoring malformed line in convolution algorithm cache '%ls': %s\n", path.c_str(), line.c_str());
+            continue;
+        }
+        entry.WorkspaceSize = (size_t)workspaceSize;
+        // entries that are already known take precedence over the file
+        entries.insert(std::make_pair(line.substr(0, keyEnd), entry));
+    }
+    fcloseOrDie(f);
+}
+
+void ConvolutionAlgorithmCache::Save()
+{
+    // Merge with the entries that other processes (e.g. other workers of the same job) have saved in the meantime,
+    // and replace the file at once, so that these never see a partial file.
+    std::map<std::string, Entry> entries = m_entries;
+    Load(m_path, entries);
+    std::wstring tmpPath = m_path + msra::strfun::wstrprintf(L".%d.tmp", (int)GetCurrentProcessId());
+    FILE* f = fopenOrDie(tmpPath, L"wb");
+    for (const auto& entry : entries)
+        fprintfOrDie(f, "%s\t%d\t%llu\t%d\n", entry.first.c_str(), entry.second.Algo, (unsigned long long)entry.second.WorkspaceSize, entry.second.NoWorkspaceAlgo);
+    fcloseOrDie(f);
+    renameOrDie(tmpPath, m_path);
+}
+
 }}}
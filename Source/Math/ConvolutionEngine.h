@@ -9,6 +9,8 @@
 #include "TensorShape.h" // for ImageLayoutKind
 #include "ConvolveGeometry.h"
 #include "StringUtil.h"
+#include <map>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -22,8 +24,11 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    Winograd  = 1 << 4, // Winograd F(4x4,3x3)/F(2x2,3x3), CPU only. Works only for 2D convos with 3x3 kernels, stride 1 and full sharing; backprop uses GEMM.
+    FFT       = 1 << 5, // FFT-based, CPU only. Works only for 2D convos with stride 1 and full sharing, used where faster than GEMM (large kernels); backprop uses GEMM.
+    Direct    = 1 << 6, // Direct loops over the kernel, CPU only. Works only for grouped (incl. depthwise) 2D convos with full sharing.
 
-    All       = Reference | CuDnn | Legacy | Gemm
+    All       = Reference | CuDnn | Legacy | Gemm | Winograd | FFT | Direct
 };
 
 enum class PoolKind
@@ -74,9 +79,15 @@ public:
 
     virtual bool ImplementsGradientOverwriteOptimization() const { return false; }
 
+    // Int8 inference: Forward() quantizes its input with the given range and the kernel per output channel
+    // (see Int8ChannelwiseMultiplier). The kernel must not change afterwards. 0 turns it off.
+    // Only engines for which SupportsInt8Forward() is true honor it, the others compute in ElemType.
+    virtual bool SupportsInt8Forward() const { return false; }
+    void SetInt8InputRange(ElemType inputRange) { m_int8InputRange = inputRange; }
+
 protected:
     ConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
-        : m_geometry(geometry), m_deviceId(deviceId), m_imageLayout(imageLayout), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_poolKind(poolKind)
+        : m_geometry(geometry), m_deviceId(deviceId), m_imageLayout(imageLayout), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_poolKind(poolKind), m_int8InputRange(0)
     {
         assert(m_geometry != nullptr);
     }
@@ -105,6 +116,40 @@ protected:
     ImageLayoutKind m_imageLayout;
     size_t m_maxTempMemSizeInSamples;
     PoolKind m_poolKind;
+    ElemType m_int8InputRange;
+};
+
+//-------------------------------------------------------------
+// Process-wide cache of the convolution algorithms that engines select by benchmarking (cuDNN's auto-tuner),
+// so that engines with the same configuration, e.g. the same layer of a recreated network, do not benchmark again.
+// The key must describe everything the selection depends on. With SetFile(), the cache is loaded from the file
+// and the file is rewritten (merged with its current content) when an algorithm is added, so that the selection holds across runs.
+//-------------------------------------------------------------
+class MATH_API ConvolutionAlgorithmCache
+{
+public:
+    struct Entry
+    {
+        int Algo;
+        size_t WorkspaceSize;
+        int NoWorkspaceAlgo; // used when the workspace cannot be allocated
+    };
+
+    static ConvolutionAlgorithmCache& Instance();
+
+    bool Find(const std::string& key, Entry& entry);
+    void Add(const std::string& key, const Entry& entry);
+
+    // Loads the file, if it exists, and saves to it from now on. An empty path only keeps the cache in memory.
+    void SetFile(const std::wstring& path);
+
+private:
+    static void Load(const std::wstring& path, std::map<std::string, Entry>& entries);
+    void Save();
+
+    std::mutex m_mutex;
+    std::map<std::string, Entry> m_entries;
+    std::wstring m_path;
 };
 
 #pragma warning(pop)
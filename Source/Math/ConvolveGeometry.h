@@ -37,6 +37,10 @@ public:
     const BoolVec& AutoPad() const { return m_autoPad; }
     const TensorShape& LowerPad() const { return m_lowerPad; }
     const TensorShape& UpperPad() const { return m_upperPad; }
+    // Number of groups the channels (rightmost dimension) are split into. The kernels of group g, i.e. the maps
+    // [g * M / G, (g + 1) * M / G), convolve only the input channels [g * C / G, (g + 1) * C / G), so the kernel
+    // covers C / G channels. G == C is a depthwise convolution.
+    size_t Groups() const { return m_groups; }
 
     // Maps from a "row" (index of output cell) to its base "col" (index of input cell). For a given row,
     // the cols that contribute to it are { MpRowCol[row] + Indices[i0 + 1 + i] | 0 <= i < Indices[i0] },
@@ -76,10 +80,13 @@ public:
     // Number of kernels (equal to MapCount if sharing is all true values).
     size_t KernelCount() const { return m_kernelCount; }
 
+    // The indices of the "kernel-center" cell of the first output cell in the source, per dimension.
+    const IntVec& Start() const { return m_start; }
+
     ConvolveGeometry(const TensorShape& inputShape, const TensorShape& kernelShape, const TensorShape& mapCount, const TensorShape& stride,
-                     const BoolVec& sharing, const BoolVec& autoPad, const TensorShape& lowerPad, const TensorShape& upperPad)
+                     const BoolVec& sharing, const BoolVec& autoPad, const TensorShape& lowerPad, const TensorShape& upperPad, size_t groups = 1)
                      : m_inputShape(inputShape), m_kernelShape(kernelShape), m_mapCount(mapCount), m_stride(stride), m_sharing(sharing),
-                     m_autoPad(autoPad), m_lowerPad(lowerPad), m_upperPad(upperPad)
+                     m_autoPad(autoPad), m_lowerPad(lowerPad), m_upperPad(upperPad), m_groups(groups)
     {
         // Note: this ctor is a bit long so sit back and relax.
 
@@ -92,7 +99,9 @@ public:
         assert(m_upperPad.GetRank() == 1 || m_upperPad.GetRank() == m_inputShape.GetRank());
         
         m_outputShape = ComputeOutputShape(m_inputShape, m_kernelShape, m_mapCount, m_stride,
-                                           m_sharing, m_autoPad, m_lowerPad, m_upperPad);
+                                           m_sharing, m_autoPad, m_lowerPad, m_upperPad, m_groups);
+        if (m_groups > 1 && !GetSharing(m_inputShape.GetRank() - 1))
+            InvalidArgument("Grouped convolution requires sharing along the channel dimension.");
         assert(m_inputShape.GetRank() == m_outputShape.GetRank());
 
         size_t dimCount = inputShape.GetRank();
@@ -223,16 +232,21 @@ public:
                 }
 
                 int maps = (int)GetMapCount(i);
+                int groupStart = 0;
                 if (maps > 1)
                 {
-                    kern += factorKern * (cur % maps);
+                    int map = cur % maps;
+                    kern += factorKern * map;
                     cur /= maps;
                     factorKern *= maps;
+                    // The kernels of a group read only the channels of that group.
+                    if (m_groups > 1 && i == dimCount - 1)
+                        groupStart = map / (maps / (int)m_groups) * (int)m_kernelShape[i];
                 }
 
                 // Transform coord to input index space.
                 coord *= (int)GetStride(i);
-                coord += m_start[i];
+                coord += m_start[i] + groupStart;
 
                 col += factorCol * coord;
                 factorCol *= (int)m_inputShape[i];
@@ -388,7 +402,8 @@ public:
 
     // Computes output shape given input shape and other convolution parameters.
     static TensorShape ComputeOutputShape(const TensorShape& inputShape, const TensorShape& kernelShape, const TensorShape& mapCount, const TensorShape& stride,
-                                          const BoolVec& sharing, const BoolVec& autoPad, const TensorShape& lowerPad, const TensorShape& upperPad)
+                                          const BoolVec& sharing, const BoolVec& autoPad, const TensorShape& lowerPad, const TensorShape& upperPad,
+                                          size_t groups = 1)
     {
         if (inputShape.GetRank() != kernelShape.GetRank())
             InvalidArgument("Convolution input and kernel tensors must have the same rank.");
@@ -404,6 +419,7 @@ public:
             InvalidArgument("Convolution lower pad tensor must have rank 1 or the same as the input tensor.");
         if (upperPad.GetRank() != 1 && inputShape.GetRank() != upperPad.GetRank())
             InvalidArgument("Convolution upper pad tensor must have rank 1 or the same as the input tensor.");
+        ValidateGroups(inputShape, kernelShape, mapCount, autoPad, lowerPad, upperPad, groups);
 
         SmallVector<size_t> dimsOutput(inputShape.GetRank());
         for (size_t i = 0; i < inputShape.GetRank(); i++)
@@ -426,6 +442,9 @@ public:
                 dim += lo + hi;
             }
             size_t dimOut = (dim - kernelShape[i]) / delta + 1;
+            // Each group of kernels is applied once, to the channels of its group.
+            if (groups > 1 && i == inputShape.GetRank() - 1)
+                dimOut = 1;
             // When LowerPad and/or UpperPad are specified (i.e. > 0), we insist that the kernel applications
             // fill the entire space.
             if (!autoPadCur && (lo > 0 || hi > 0))
@@ -456,7 +475,8 @@ public:
     // Computes input shape given output shape and other convolution parameters.
     // Used in deconvolution operation.
     static TensorShape ComputeInputShape(const TensorShape& outputShape, const TensorShape& kernelShape, const TensorShape& mapCount, const TensorShape& stride,
-                                         const BoolVec& sharing, const BoolVec& autoPad, const TensorShape& lowerPad, const TensorShape& upperPad)
+                                         const BoolVec& sharing, const BoolVec& autoPad, const TensorShape& lowerPad, const TensorShape& upperPad,
+                                         size_t groups = 1)
     {
         if (outputShape.GetRank() != kernelShape.GetRank())
             InvalidArgument("Convolution output and kernel tensors must have the same rank.");
@@ -493,6 +513,13 @@ public:
             size_t lo = lowerPad[lowerPad.size() == 1 ? 0 : i];
             size_t hi = upperPad[upperPad.size() == 1 ? 0 : i];
             size_t dimIn = (dim - 1) * delta;
+            if (groups > 1 && i == outputShape.GetRank() - 1)
+            {
+                if (dim != 1)
+                    InvalidArgument("Grouped convolution requires a single kernel position along the channel dimension.");
+                dimsInput[i] = kernelShape[i] * groups;
+                continue;
+            }
             // We need to be able to restore any input size from the output, not just the one
             // that does not require padding. For example, if output is 14, stride 2 and 
             // desired input is 28 then padded input will be 31. In this case if autopadding is enabled,
@@ -516,6 +543,28 @@ public:
         return TensorShape(dimsInput);
     }
 
+    // Checks that the channels (rightmost dimension) and the maps split into 'groups' and that the kernel covers the
+    // channels of one group, unpadded.
+    static void ValidateGroups(const TensorShape& inputShape, const TensorShape& kernelShape, const TensorShape& mapCount,
+                               const BoolVec& autoPad, const TensorShape& lowerPad, const TensorShape& upperPad, size_t groups)
+    {
+        if (groups == 0)
+            InvalidArgument("Convolution groups must be positive.");
+        if (groups == 1)
+            return;
+        size_t last = inputShape.GetRank() - 1;
+        size_t channels = inputShape[last];
+        size_t maps = mapCount[mapCount.size() == 1 ? 0 : last];
+        if (channels % groups != 0 || maps % groups != 0)
+            InvalidArgument("Grouped convolution requires that the input channels (%d) and output maps (%d) are divisible by the groups (%d).",
+                            (int)channels, (int)maps, (int)groups);
+        if (kernelShape[last] * groups != channels)
+            InvalidArgument("Grouped convolution requires that the kernel covers the input channels of one group (%d), but it covers %d.",
+                            (int)(channels / groups), (int)kernelShape[last]);
+        if (autoPad[autoPad.size() == 1 ? 0 : last] || lowerPad[lowerPad.size() == 1 ? 0 : last] != 0 || upperPad[upperPad.size() == 1 ? 0 : last] != 0)
+            InvalidArgument("Grouped convolution does not support padding along the channel dimension.");
+    }
+
     // Used in unit tests and during debugging.
     operator std::string() const
     {
@@ -533,6 +582,8 @@ public:
         res << AutoPad().back() << ")";
         res << ", LowerPad: " << (string)LowerPad();
         res << ", UpperPad: " << (string)UpperPad();
+        if (m_groups > 1)
+            res << ", Groups: " << m_groups;
         return res.str();
     }
 
@@ -548,6 +599,7 @@ private:
     BoolVec m_autoPad;
     TensorShape m_lowerPad;
     TensorShape m_upperPad;
+    size_t m_groups;
 
     // There are several reasons why int type is used here rather than size_t:
     // 1. Many of these vectors contain offsets which can be negative.
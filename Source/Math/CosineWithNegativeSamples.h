@@ -0,0 +1,99 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CosineWithNegativeSamples.h : per-column steps of the cosine similarity of query/document pairs with negative
+// samples, shared by the CPU and the GPU implementation of Matrix::AssignSimilaritiesWithNegativeSamples,
+// AssignNegativeSamplesGradientMatrix and AddColumnNormalizationGradient.
+//
+// The similarities of all N queries (left columns) with all N documents (right columns) are one GEMM of the
+// normalized columns, S(j, k) = cos(query j, document k). Row 0 of the result pairs query j with document j,
+// rows 1..numNegatives with its negative documents: either shifted ones, (j + shift + m - 1) mod N as in DSSM,
+// or the documents of the minibatch that are most similar to the query (in-batch negatives).
+// The gradient flows back through S as the N x N matrix W(j, k) = the summed gradients of the pairs (j, k),
+// so that both input gradients are a GEMM as well, followed by the gradient of the column normalization.
+//
+
+#pragma once
+
+#include <math.h>
+
+#pragma push_macro("COSINE_WITH_NEGATIVE_SAMPLES_DECL")
+#ifdef __CUDACC__
+#define COSINE_WITH_NEGATIVE_SAMPLES_DECL __host__ __device__
+#else
+#define COSINE_WITH_NEGATIVE_SAMPLES_DECL
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Whether document a is more similar to the query than document b: by descending similarity, ties by column.
+template <class ElemType>
+COSINE_WITH_NEGATIVE_SAMPLES_DECL inline bool IsMoreSimilar(ElemType similarityA, int a, ElemType similarityB, int b)
+{
+    return similarityA > similarityB || (similarityA == similarityB && a < b);
+}
+
+// The documents of query j, a column of 1 + numNegatives: j itself, then its negatives. In-batch negatives are the
+// other documents in descending order of similarity; with fewer than numNegatives of them, they repeat.
+// Writes the similarities of the pairs to 'values' and the document columns to 'documents'. Each in-batch negative
+// is the most similar document after the previous one, which takes a single scan over the documents.
+template <class ElemType>
+COSINE_WITH_NEGATIVE_SAMPLES_DECL inline void AssignSimilaritiesWithNegativeSamplesOfQuery(ElemType* values, ElemType* documents, const ElemType* similarities, int numCols,
+                                                                                            int shift, int numNegatives, bool inBatchNegatives, int j)
+{
+    values[0] = similarities[j + (size_t)j * numCols];
+    documents[0] = (ElemType)j;
+    int previous = j;
+    for (int m = 1; m <= numNegatives; m++)
+    {
+        int k;
+        if (!inBatchNegatives)
+            k = (j + shift + m - 1) % numCols;
+        else if (m >= numCols) // every other document is taken already
+            k = numCols > 1 ? (int)documents[1 + (m - 1) % (numCols - 1)] : j;
+        else
+        {
+            k = -1;
+            for (int i = 0; i < numCols; i++)
+            {
+                ElemType similarity = similarities[j + (size_t)i * numCols];
+                if (i == j || (m > 1 && !IsMoreSimilar(similarities[j + (size_t)previous * numCols], previous, similarity, i)))
+                    continue;
+                if (k < 0 || IsMoreSimilar(similarity, i, similarities[j + (size_t)k * numCols], k))
+                    k = i;
+            }
+            previous = k;
+        }
+        values[m] = similarities[j + (size_t)k * numCols];
+        documents[m] = (ElemType)k;
+    }
+}
+
+// Adds the gradients of the pairs of query j to row j of the N x N matrix W; row j is written by query j only.
+template <class ElemType>
+COSINE_WITH_NEGATIVE_SAMPLES_DECL inline void AddNegativeSamplesGradientOfQuery(ElemType* gradientMatrix, const ElemType* gradient, const ElemType* documents, int numCols, int numRows, int j)
+{
+    for (int m = 0; m < numRows; m++)
+    {
+        int k = (int)documents[m + (size_t)j * numRows];
+        gradientMatrix[j + (size_t)k * numCols] += gradient[m + (size_t)j * numRows];
+    }
+}
+
+// Gradient of column j of x, with y = x / |x|, from the gradient g of y: (g - y (y . g)) / |x|, added to 'result'.
+template <class ElemType>
+COSINE_WITH_NEGATIVE_SAMPLES_DECL inline void AddColumnNormalizationGradientOfColumn(ElemType* result, const ElemType* gradientOfNormalized, const ElemType* normalized, const ElemType* invNorms, int numRows, int j)
+{
+    const ElemType* g = gradientOfNormalized + (size_t)j * numRows;
+    const ElemType* y = normalized + (size_t)j * numRows;
+    ElemType dot = 0;
+    for (int i = 0; i < numRows; i++)
+        dot += y[i] * g[i];
+    for (int i = 0; i < numRows; i++)
+        result[i + (size_t)j * numRows] += (g[i] - y[i] * dot) * invNorms[j];
+}
+
+}}}
+
+#pragma pop_macro("COSINE_WITH_NEGATIVE_SAMPLES_DECL")
@@ -33,13 +33,17 @@ protected:
     using Base::m_imageLayout;
     using Base::m_inOutT;
     using Base::m_spatial;
+    using Base::m_fuseRelu;
+    using Base::m_comm;
 
     void EnsureCompatible() override
     {
         if (m_spatial && m_imageLayout == ImageLayoutKind::HWC)
-            InvalidArgument("cuDNN batch normalization supports only cudnn(CHW) layout.");
+            InvalidArgument("cuDNN batch normalization supports only cudnn(CHW) and NHWC layouts.");
         if (m_inOutT.GetRank() > 4)
             InvalidArgument("cuDNN batch normalization supports tensors of max 4 dimensions.");
+        if (m_comm)
+            InvalidArgument("cuDNN batch normalization does not support statistics synchronized across ranks, use the CNTK engine.");
     }
 
     void ForwardCore(const Mat& in, const Mat& scale, const Mat& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, Mat& runMean, Mat& runVariance,
@@ -71,6 +75,8 @@ protected:
                                                               m_inOutCuDnnT, ptr(out), m_scaleBiasCuDnnT, ptr(scale), ptr(bias), expAvgFactor, ptr(runMean), ptr(runVariance),
                                                               epsilon, ptr(savedMean), ptr(savedInvStdDev)));
         }
+        if (m_fuseRelu) // (cuDNN's batch normalization has no activation, so this takes a separate pass)
+            out.InplaceTruncateBottom(0);
     }
 
     void BackwardCore(const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, double blendFactor, const Mat& savedMean, const Mat& savedInvStdDev,
@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #include "GPUMatrix.h"
 #include "CuDnnCommon.h"
+#include <map>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -33,9 +35,12 @@ CuDnnTensor::CuDnnTensor(const TensorShape& src, cudnnDataType_t dataType)
         dims[dims.size() - 1 - i] = (int)src[i];
         strides[dims.size() - 1 - i] = (int)stridesSrc[i];
     }
-    // Set "minibatch"(aka N) dimension.
+    // Set "minibatch"(aka N) dimension. Its stride is the extent of a sample, which need not be along the
+    // slowest dimension if the dimensions are permuted (e.g. NHWC described as NCHW with strides).
     dims[0] = 1;
-    strides[0] = strides[1] * dims[1];
+    strides[0] = 0;
+    for (size_t i = 1; i < dims.size(); i++)
+        strides[0] = std::max(strides[0], strides[i] * dims[i]);
     CUDNN_CALL(cudnnSetTensorNdDescriptor(m_tensor, dataType, (int)dims.size(), dims.data(), strides.data()));
 }
 
@@ -77,12 +82,18 @@ cudnnDataType_t CuDnnTensor::GetDataType()
 template cudnnDataType_t CuDnnTensor::GetDataType<float>();
 template cudnnDataType_t CuDnnTensor::GetDataType<double>();
 
+cudnnHandle_t CuDnn::ptr_t::operator*() const
+{
+    CUDNN_CALL(cudnnSetStream(*m_handle, GetStream()));
+    return *m_handle;
+}
+
+// One handle per device, as a handle works on the device that was current when it was created, e.g. for the
+// network replica that runs the cross validation on another GPU than the one trained on (asyncCrossValidation).
 CuDnn::ptr_t CuDnn::Instance()
 {
-    auto createNew = []()
+    auto createNew = [](int deviceId)
     {
-        int deviceId;
-        CUDA_CALL(cudaGetDevice(&deviceId));
         cudaDeviceProp props = {0};
         if (cudaGetDeviceProperties(&props, deviceId) != cudaSuccess || props.major < 3)
             RuntimeError("cuDNN requires device with compute capability 3.0 or higher.");
@@ -92,17 +103,26 @@ CuDnn::ptr_t CuDnn::Instance()
         return cudnn;
     };
 
-    static std::shared_ptr<cudnnHandle_t> m_instance = std::shared_ptr<cudnnHandle_t>(createNew(), [](cudnnHandle_t* src)
+    int deviceId;
+    CUDA_CALL(cudaGetDevice(&deviceId));
+    static std::mutex s_mutex;
+    static std::map<int, std::shared_ptr<cudnnHandle_t>> s_instances;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto& instance = s_instances[deviceId];
+    if (!instance)
     {
-        assert(*src != nullptr);
-        auto err = cudnnDestroy(*src);
-        assert(err == CUDNN_STATUS_SUCCESS);
+        instance = std::shared_ptr<cudnnHandle_t>(createNew(deviceId), [](cudnnHandle_t* src)
+        {
+            assert(*src != nullptr);
+            auto err = cudnnDestroy(*src);
+            assert(err == CUDNN_STATUS_SUCCESS);
 #ifdef NDEBUG
-        UNUSED(err);
+            UNUSED(err);
 #endif
-        delete src;
-    });
-    return m_instance;
+            delete src;
+        });
+    }
+    return instance;
 }
 
 } } }
@@ -36,7 +36,17 @@ private:
 
 struct CuDnn final
 {
-    using ptr_t = std::shared_ptr<cudnnHandle_t>;
+    // The process-wide handle. Dereferencing it binds it to the stream of the calling thread (see SetStream()),
+    // so that cuDNN work is ordered with the other GPU work issued by that thread.
+    class ptr_t
+    {
+    public:
+        ptr_t(std::shared_ptr<cudnnHandle_t> handle) : m_handle(std::move(handle)) {}
+        cudnnHandle_t operator*() const;
+
+    private:
+        std::shared_ptr<cudnnHandle_t> m_handle;
+    };
     static ptr_t Instance();
 
     DISABLE_COPY_AND_MOVE(CuDnn);
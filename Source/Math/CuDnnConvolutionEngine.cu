@@ -19,6 +19,7 @@ const char* CudaErrString<cudnnStatus_t>(cudnnStatus_t x)
 // A note on the formats: CNTK originally used NHWC for input/output tensors and CHWN for kernels.
 // Such formats have very limited support in cuDNN and not used in other frameworks.
 // CNTK with cuDNN by default uses NCHW formats for both inputs/outputs and kernels.
+// With ImageLayoutKind::NHWC, inputs/outputs are NHWC (described by strides) and kernels KHWC (CUDNN_TENSOR_NHWC).
 #define TENSOR_FORMAT CUDNN_TENSOR_NCHW
 #define FILTER_FORMAT CUDNN_TENSOR_NCHW
 
@@ -29,17 +30,26 @@ static bool IsGpu(DEVICEID_TYPE deviceId)
     return deviceId >= 0;
 }
 
+// NHWC geometries are [C x W x H], channels first. cuDNN gets them as [W x H x C] with the strides of [C x W x H].
+static TensorShape CuDnnShape(const TensorShape& shape, bool nhwc)
+{
+    TensorShape res = shape;
+    for (size_t i = 0; nhwc && i + 1 < res.GetRank(); i++)
+        res.SwapDimsInPlace(i, i + 1);
+    return res;
+}
+
 class CuDnnKernel
 {
 public:
-    CuDnnKernel(const ConvolveGeometry& geometry, cudnnDataType_t dataType)
+    CuDnnKernel(const ConvolveGeometry& geometry, cudnnDataType_t dataType, bool nhwc)
         : m_kernel(nullptr)
     {
         CUDNN_CALL(cudnnCreateFilterDescriptor(&m_kernel));
         // Set cuDNN kernel dimensions. cuDNN uses row-major format while TensorShape - column-major
-        // so conversion is required.
-        const auto& filt = geometry.KernelShape();
-        size_t mapCount = geometry.GetMapCount(geometry.InputShape().GetRank() - 1);
+        // so conversion is required. The dimensions are KCHW in either format.
+        const auto filt = CuDnnShape(geometry.KernelShape(), nhwc);
+        size_t mapCount = geometry.GetMapCount(nhwc ? 0 : geometry.InputShape().GetRank() - 1);
         if (mapCount != geometry.MapCount().GetNumElements())
             InvalidArgument("cuDNN does not support map tensor of this configuration.");
         SmallVector<int> dims(filt.GetRank() + 1);
@@ -47,7 +57,7 @@ public:
             dims[dims.size() - 1 - i] = (int)filt[i];
         // Set map count(aka K) dimension.
         dims[0] = (int)mapCount;
-        CUDNN_CALL(cudnnSetFilterNdDescriptor_v4(m_kernel, dataType, FILTER_FORMAT, (int)dims.size(), dims.data()));
+        CUDNN_CALL(cudnnSetFilterNdDescriptor_v4(m_kernel, dataType, nhwc ? CUDNN_TENSOR_NHWC : FILTER_FORMAT, (int)dims.size(), dims.data()));
     }
 
     ~CuDnnKernel()
@@ -73,25 +83,31 @@ private:
 class CuDnnConv
 {
 public:
-    CuDnnConv(const ConvolveGeometry& geometry, cudnnDataType_t dataType)
+    CuDnnConv(const ConvolveGeometry& geometry, cudnnDataType_t dataType, bool nhwc)
         : m_conv(nullptr)
     {
         CUDNN_CALL(cudnnCreateConvolutionDescriptor(&m_conv));
         // Set cuDNN convolution parameters. cuDNN uses row-major format while TensorShape - column-major
         // so conversion is required. Also, for 2D convolutions (which have 3D tensor shapes)
         // cuDNN uses 2D descriptors while for 3D convolutions - 3D so we need to ignore
-        // rightmost dimension in ConvolveGeometry tensors.
+        // rightmost dimension in ConvolveGeometry tensors (the leftmost one for NHWC).
         SmallVector<int> stride(geometry.InputShape().GetRank() - 1);
         SmallVector<int> pad(stride.size());
+        int first = nhwc ? 1 : 0;
         for (int i = 0; i < stride.size(); i++)
         {
-            stride[stride.size() - 1 - i] = (int)geometry.GetStride(i);
-            pad[stride.size() - 1 - i] = geometry.GetLowerPad(i);
+            stride[stride.size() - 1 - i] = (int)geometry.GetStride(i + first);
+            pad[stride.size() - 1 - i] = geometry.GetLowerPad(i + first);
         }
         SmallVector<int> upscale(stride.size(), 1);
         CUDNN_CALL(cudnnSetConvolutionNdDescriptor(m_conv, (int)stride.size(), pad.data(),
                                                    stride.data(), upscale.data(),
                                                    CUDNN_CROSS_CORRELATION, dataType));
+#if CUDNN_MAJOR >= 7
+        // The filter descriptor already has the C/G channels of one group.
+        if (geometry.Groups() > 1)
+            CUDNN_CALL(cudnnSetConvolutionGroupCount(m_conv, (int)geometry.Groups()));
+#endif
     }
 
     ~CuDnnConv()
@@ -117,7 +133,7 @@ private:
 class CuDnnPool
 {
 public:
-    CuDnnPool(const ConvolveGeometry& geometry, PoolKind kind, bool forceDeterministicAlgorithms)
+    CuDnnPool(const ConvolveGeometry& geometry, PoolKind kind, bool forceDeterministicAlgorithms, bool deterministicReductions, bool nhwc)
         : m_pool(nullptr)
     {
         assert(kind == PoolKind::Max || kind == PoolKind::Average);
@@ -125,21 +141,30 @@ public:
         CUDNN_CALL(cudnnCreatePoolingDescriptor(&m_pool));
         // Set cuDNN pooling parameters. cuDNN uses row-major format while TensorShape - column-major
         // so conversion is required. Same as in convolution descriptor, cuDNN uses 2D descriptors
-        // for 3D inputs.
+        // for 3D inputs, which are the spatial dimensions after the channels for NHWC.
         SmallVector<int> dims(geometry.InputShape().GetRank() - 1);
         SmallVector<int> stride(dims.size());
         SmallVector<int> pad(stride.size());
         int j = (int)dims.size() - 1;
+        int first = nhwc ? 1 : 0;
         for (int i = 0; i < stride.size(); i++, j--)
         {
-            dims[j] = (int)geometry.KernelShape()[i];
-            stride[j] = (int)geometry.GetStride(i);
-            pad[j] = geometry.GetLowerPad(i);
+            dims[j] = (int)geometry.KernelShape()[i + first];
+            stride[j] = (int)geometry.GetStride(i + first);
+            pad[j] = geometry.GetLowerPad(i + first);
         }
 
         // Must use CUDNN_POOLING_AVERAGE_COUNT_EXCLUDE_PADDING to get the same results as in reference engine.
+        // The backward pass of CUDNN_POOLING_MAX may add overlapping windows in any order.
+        cudnnPoolingMode_t maxMode = CUDNN_POOLING_MAX;
+#if CUDNN_MAJOR >= 6
+        if (deterministicReductions)
+            maxMode = CUDNN_POOLING_MAX_DETERMINISTIC;
+#else
+        UNUSED(deterministicReductions);
+#endif
         CUDNN_CALL(cudnnSetPoolingNdDescriptor(m_pool,
-                                               kind == PoolKind::Max && !forceDeterministicAlgorithms ? CUDNN_POOLING_MAX : CUDNN_POOLING_AVERAGE_COUNT_EXCLUDE_PADDING,
+                                               kind == PoolKind::Max && !forceDeterministicAlgorithms ? maxMode : CUDNN_POOLING_AVERAGE_COUNT_EXCLUDE_PADDING,
                                                CUDNN_PROPAGATE_NAN,
                                                (int)dims.size(), dims.data(), pad.data(), stride.data()));
     }
@@ -177,9 +202,10 @@ public:
                            : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind),
                            m_cudnn(CuDnn::Instance()),
                            m_dataType(CuDnnTensor::GetDataType<ElemType>()),
-                           m_inT(geometry->InputShape(), m_dataType),
-                           m_outT(geometry->OutputShape(), m_dataType),
-                           m_forceDeterministicAlgorithms(forceDeterministicAlgorithms)
+                           m_inT(CuDnnShape(geometry->InputShape(), imageLayout == ImageLayoutKind::NHWC), m_dataType),
+                           m_outT(CuDnnShape(geometry->OutputShape(), imageLayout == ImageLayoutKind::NHWC), m_dataType),
+                           m_forceDeterministicAlgorithms(forceDeterministicAlgorithms),
+                           m_deterministicReductions(DeterministicReductions::IsEnabled())
     {
     }
 
@@ -194,8 +220,8 @@ protected:
 
     void EnsureCompatible() override
     {
-        if (m_imageLayout != ImageLayoutKind::CHW)
-            RuntimeError("cuDNN convolution engine supports only CHW/cudnn layout.");
+        if (m_imageLayout != ImageLayoutKind::CHW && m_imageLayout != ImageLayoutKind::NHWC)
+            RuntimeError("cuDNN convolution engine supports only CHW/cudnn and NHWC layouts.");
         if (!IsGpu(m_deviceId))
             RuntimeError("cuDNN convolution engine supports GPU devices only.");
     }
@@ -204,8 +230,8 @@ protected:
     {
         if (m_kernelT == nullptr)
         {
-            m_kernelT = std::make_unique<CuDnnKernel>(*m_geometry, m_dataType), 
-            m_conv = std::make_unique<CuDnnConv>(*m_geometry, m_dataType);
+            m_kernelT = std::make_unique<CuDnnKernel>(*m_geometry, m_dataType, m_imageLayout == ImageLayoutKind::NHWC),
+            m_conv = std::make_unique<CuDnnConv>(*m_geometry, m_dataType, m_imageLayout == ImageLayoutKind::NHWC);
         }
     }
 
@@ -231,7 +257,7 @@ protected:
         {
             return cudnnGetConvolutionForwardAlgorithm(*m_cudnn, m_inT, *m_kernelT, *m_conv, m_outT, CUDNN_CONVOLUTION_FWD_NO_WORKSPACE, 0, &algo);
         };
-        FindBestAlgo(batchSize, m_fwdAlgo, finder, staticFinder);
+        FindBestAlgo("forward", batchSize, m_fwdAlgo, finder, staticFinder);
         if (m_fwdAlgo.Algo.memory > 0)
             workspace.Resize((m_fwdAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
         // Perform forward convolution operation.
@@ -279,7 +305,7 @@ protected:
         {
             return cudnnGetConvolutionBackwardDataAlgorithm(*m_cudnn, *m_kernelT, m_outT, *m_conv, m_inT, CUDNN_CONVOLUTION_BWD_DATA_NO_WORKSPACE, 0, &algo);
         };
-        FindBestAlgo(batchSize, m_backDataAlgo, finder, staticFinder);
+        FindBestAlgo("backward data", batchSize, m_backDataAlgo, finder, staticFinder);
         if (m_backDataAlgo.Algo.memory > 0)
             workspace.Resize((m_backDataAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
         // Compute gradients with respect to the output tensor (data).
@@ -310,7 +336,7 @@ protected:
         {
             return cudnnGetConvolutionBackwardFilterAlgorithm(*m_cudnn, m_inT, m_outT, *m_conv, *m_kernelT, CUDNN_CONVOLUTION_BWD_FILTER_NO_WORKSPACE, 0, &algo);
         };
-        FindBestAlgo(batchSize, m_backFiltAlgo, finder, staticFinder);
+        FindBestAlgo("backward filter", batchSize, m_backFiltAlgo, finder, staticFinder);
         if (m_backFiltAlgo.Algo.memory > 0)
             workspace.Resize((m_backFiltAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
         // Compute gradients with respect to the output tensor (data).
@@ -322,7 +348,7 @@ protected:
     void EnsurePoolingInitialized() override
     {
         if (m_pool == nullptr)
-            m_pool = std::make_unique<CuDnnPool>(*m_geometry, m_poolKind, m_forceDeterministicAlgorithms);
+            m_pool = std::make_unique<CuDnnPool>(*m_geometry, m_poolKind, m_forceDeterministicAlgorithms, m_deterministicReductions, m_imageLayout == ImageLayoutKind::NHWC);
     }
 
     void ForwardPoolingCore(const Mat& in, Mat& out) override
@@ -357,7 +383,7 @@ private:
     static const int MaxAlgoCount = 10;
 
     template <typename TAlgo, typename TFinder, typename TStaticFinder>
-    void FindBestAlgo(size_t batchSize, TAlgo& algo, TFinder finder, TStaticFinder staticFinder)
+    void FindBestAlgo(const char* direction, size_t batchSize, TAlgo& algo, TFinder finder, TStaticFinder staticFinder)
     {
         m_inT.UpdateBatchSize(batchSize);
         m_outT.UpdateBatchSize(batchSize);
@@ -365,6 +391,52 @@ private:
         if (!algo.NeedAutotuning(batchSize))
             return;
 
+        // Algorithms are selected for minibatch sizes rounded up to a power of 2, and shared through the algorithm cache,
+        // so that the auto-tuner runs once per bucket of minibatch sizes and configuration, also across engines and runs.
+        size_t tunedBatchSize = 1;
+        while (tunedBatchSize < batchSize)
+            tunedBatchSize *= 2;
+        size_t inputSampleSize = m_geometry->InputShape().GetNumElements();
+        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inputSampleSize * m_maxTempMemSizeInSamples * sizeof(ElemType);
+        std::string cacheKey = AlgorithmCacheKey(direction, tunedBatchSize, maxMem);
+        using CuDnnAlgoT = decltype(TAlgo::Algo);
+        ConvolutionAlgorithmCache::Entry cached;
+        if (ConvolutionAlgorithmCache::Instance().Find(cacheKey, cached))
+        {
+            algo.MaxAllowedMBSizeForCurrentAlgo = tunedBatchSize;
+            algo.Algo = CuDnnAlgoT();
+            algo.Algo.algo = (decltype(CuDnnAlgoT::algo))cached.Algo;
+            algo.Algo.memory = cached.WorkspaceSize;
+            algo.Algo.status = CUDNN_STATUS_SUCCESS;
+            algo.NoWorkspaceAlgo = (decltype(CuDnnAlgoT::algo))cached.NoWorkspaceAlgo;
+            return;
+        }
+
+        m_inT.UpdateBatchSize(tunedBatchSize);
+        m_outT.UpdateBatchSize(tunedBatchSize);
+        bool tuned = RunAutotuner(tunedBatchSize, maxMem, algo, finder, staticFinder);
+        m_inT.UpdateBatchSize(batchSize);
+        m_outT.UpdateBatchSize(batchSize);
+        if (tuned)
+            ConvolutionAlgorithmCache::Instance().Add(cacheKey, { (int)algo.Algo.algo, algo.Algo.memory, (int)algo.NoWorkspaceAlgo });
+    }
+
+    // Everything that the selection of the auto-tuner depends on.
+    std::string AlgorithmCacheKey(const char* direction, size_t batchSize, size_t maxMem) const
+    {
+        cudaDeviceProp props = {0};
+        CUDA_CALL(cudaGetDeviceProperties(&props, m_deviceId));
+        std::string workspace = maxMem == (std::numeric_limits<size_t>::max)() ? "unlimited" : std::to_string(maxMem);
+        return msra::strfun::strprintf("%s %s, %s, MB: %d, Workspace: %s%s, GPU: %s (%d.%d), cuDNN: %d",
+                                       direction, sizeof(ElemType) == sizeof(float) ? "float" : "double", ((std::string)*m_geometry).c_str(),
+                                       (int)batchSize, workspace.c_str(), m_forceDeterministicAlgorithms || m_deterministicReductions ? ", deterministic" : "",
+                                       props.name, props.major, props.minor, (int)cudnnGetVersion());
+    }
+
+    // Runs the auto-tuner for the current tensor descriptors, returns false if it fell back to the static selection.
+    template <typename TAlgo, typename TFinder, typename TStaticFinder>
+    bool RunAutotuner(size_t batchSize, size_t maxMem, TAlgo& algo, TFinder finder, TStaticFinder staticFinder)
+    {
         using CuDnnAlgoT = decltype(TAlgo::Algo);
         CuDnnAlgoT algoPerf[MaxAlgoCount];
         int calgo = 0;
@@ -375,7 +447,10 @@ private:
         if (err == CUDNN_STATUS_ALLOC_FAILED)
         {
             decltype(CuDnnAlgoT::algo) noMemAlgo;
-            CUDNN_CALL(staticFinder(noMemAlgo));
+            if (m_deterministicReductions)
+                GetDeterministicNoWorkspaceAlgo(noMemAlgo);
+            else
+                CUDNN_CALL(staticFinder(noMemAlgo));
             if (m_forceDeterministicAlgorithms)
                 RuntimeError("cuDNN could not find a deterministic algorithm. Set 'forceDeterministicAlgorithms=false' in your configuration.");
 
@@ -385,12 +460,13 @@ private:
             algo.Algo.memory = 0;
             algo.Algo.status = CUDNN_STATUS_SUCCESS;
             algo.NoWorkspaceAlgo = noMemAlgo;
-            return;
+            return false;
         }
         CUDNN_CALL(err);
         assert(calgo > 0);
-        size_t inputSampleSize = m_geometry->InputShape().GetNumElements();
-        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inputSampleSize * m_maxTempMemSizeInSamples * sizeof(ElemType);
+        // With deterministic reductions, choose among the deterministic algorithms only, which keeps them ordered by time.
+        if (m_deterministicReductions)
+            calgo = (int)(std::remove_if(algoPerf, algoPerf + calgo, [](const CuDnnAlgoT& cur) { return !IsDeterministic(cur); }) - algoPerf);
         // Find best (fastest) algorithm which satisfies workspace requirements.
         auto res = std::find_if(algoPerf, algoPerf + calgo,
             [=](const CuDnnAlgoT& cur) { return cur.status == CUDNN_STATUS_SUCCESS && cur.memory <= maxMem; });
@@ -401,7 +477,7 @@ private:
         algo.Algo = *res;
 
         if (m_forceDeterministicAlgorithms) // does not allow fallback.
-            return;
+            return true;
 
         // Find fastest algorithm that does NOT require workspace. It is used as a fallback algo in Forward function.
         // Currently all Forward algorithms are deterministic, so no need for checking.
@@ -414,6 +490,44 @@ private:
         }
         else
             algo.NoWorkspaceAlgo = (*res).algo;
+        return true;
+    }
+
+    // Whether an algorithm adds up partial results in a fixed order. All forward algorithms do.
+    static bool IsDeterministic(const cudnnConvolutionFwdAlgoPerf_t&)
+    {
+        return true;
+    }
+    static bool IsDeterministic(const cudnnConvolutionBwdDataAlgoPerf_t& cur)
+    {
+#if CUDNN_MAJOR >= 7
+        return cur.determinism == CUDNN_DETERMINISTIC;
+#else
+        return cur.algo != CUDNN_CONVOLUTION_BWD_DATA_ALGO_0;
+#endif
+    }
+    static bool IsDeterministic(const cudnnConvolutionBwdFilterAlgoPerf_t& cur)
+    {
+#if CUDNN_MAJOR >= 7
+        return cur.determinism == CUDNN_DETERMINISTIC;
+#else
+        return cur.algo != CUDNN_CONVOLUTION_BWD_FILTER_ALGO_0 && cur.algo != CUDNN_CONVOLUTION_BWD_FILTER_ALGO_3;
+#endif
+    }
+
+    // Fallbacks of the deterministic mode when the auto-tuner cannot allocate its workspace, the algorithms of
+    // 'forceDeterministicAlgorithms'.
+    static void GetDeterministicNoWorkspaceAlgo(cudnnConvolutionFwdAlgo_t& algo)
+    {
+        algo = CUDNN_CONVOLUTION_FWD_ALGO_IMPLICIT_GEMM;
+    }
+    static void GetDeterministicNoWorkspaceAlgo(cudnnConvolutionBwdDataAlgo_t& algo)
+    {
+        algo = CUDNN_CONVOLUTION_BWD_DATA_ALGO_1;
+    }
+    static void GetDeterministicNoWorkspaceAlgo(cudnnConvolutionBwdFilterAlgo_t& algo)
+    {
+        algo = CUDNN_CONVOLUTION_BWD_FILTER_ALGO_1;
     }
 
     static ElemType* ptr(Mat& src)
@@ -472,6 +586,8 @@ private:
 
     // Flag indicating whether only deterministic algorithms should be used.
     bool m_forceDeterministicAlgorithms;
+    // Flag indicating whether the fastest deterministic algorithms should be used (see DeterministicReductions).
+    bool m_deterministicReductions;
 };
 
 template <class ElemType>
@@ -484,7 +600,8 @@ std::unique_ptr<ConvolutionEngine<ElemType>> CuDnnConvolutionEngineFactory<ElemT
 }
 
 template <class ElemType>
-bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind)
+bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind,
+                                                          ImageLayoutKind imageLayout)
 {
     // REVIEW alexeyk: IsSupported check should be performed by cuDNN itself. Is there a good way to do that?
 
@@ -497,9 +614,22 @@ bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId
     const auto& kernel = geometry->KernelShape();
     const auto& sharing = geometry->Sharing();
     const auto& mapCount = geometry->MapCount();
+#if CUDNN_MAJOR < 7
+    // Grouped convolutions need cuDNN 7, the reference engine computes them with older versions.
+    if (geometry->Groups() > 1)
+        return false;
+#endif
     // cuDNN supports 2D and 3D convolutions at the moment with full sharing.
     // In case map count size > 1, then it should have all ones except last dimension.
     // If pooling is requested, then cuDNN supports only 2D/3D inputs and 2D pooling kernels.
+    // NHWC (channels first in the geometry, so maps and pooled channels on the first dimension) is supported for 2D only.
+    if (imageLayout == ImageLayoutKind::NHWC)
+    {
+        return (input.GetRank() == 3 &&
+                std::find(begin(sharing), end(sharing), false) == sharing.end() &&
+                mapCount.GetNumElements() == mapCount[0] &&
+                (poolKind == PoolKind::None || kernel[0] == 1));
+    }
     return (input.GetRank() <= 4 &&
             std::find(begin(sharing), end(sharing), false) == sharing.end() &&
             mapCount.GetNumElements() == mapCount[mapCount.GetRank() - 1] &&
@@ -10,6 +10,7 @@
 #include "TensorView.h"
 #include <typeinfo>
 #include <typeindex>
+#include <type_traits>
 #include "CuDnnCommon.h"
 #include "CuDnnRNN.h"
 
@@ -60,12 +61,46 @@ void CuDnnRNNExecutor<ElemType>::SetDescriptors(size_t dim, const vector<size_t>
     }
 }
 
+// small batches, where the standard algorithm leaves most of the GPU idle (e.g. streaming inference), use the persistent one
+static const size_t c_maxPersistentBatchSize = 8;
+static const size_t c_maxPersistentHiddenSize = 1024; // (beyond that, the weights of a layer do not fit on chip anyway)
+
+template <class ElemType>
+/*static*/ bool CuDnnRNNExecutor<ElemType>::IsPersistentAlgorithmSupported()
+{
+#if CUDNN_MAJOR >= 6
+    int deviceId;
+    cudaDeviceProp props = { 0 };
+    return std::is_same<ElemType, float>::value &&
+           cudaGetDevice(&deviceId) == cudaSuccess && cudaGetDeviceProperties(&props, deviceId) == cudaSuccess && props.major >= 6;
+#else
+    return false;
+#endif
+}
+
+template <class ElemType>
+bool CuDnnRNNExecutor<ElemType>::UsePersistentAlgorithm(const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes)
+{
+    if (rnnAttributes.m_algorithm == L"standard")
+        return false;
+    else if (rnnAttributes.m_algorithm == L"persistent")
+    {
+        if (!m_persistentAlgorithmSupported)
+            InvalidArgument("OptimizedRNNStack: The persistent algorithm requires cuDNN 6 or higher, a GPU with compute capability 6.0 or higher, and single precision.");
+        return true;
+    }
+    // auto: only for batches of sequences of equal length
+    return !m_persistentAlgorithmFailed && !numSequencesForFrame.empty() &&
+           numSequencesForFrame.front() <= c_maxPersistentBatchSize && numSequencesForFrame.front() == numSequencesForFrame.back() &&
+           rnnAttributes.m_hiddenSize <= c_maxPersistentHiddenSize && m_persistentAlgorithmSupported;
+}
+
 template <class ElemType>
 void CuDnnRNNExecutor<ElemType>::ForwardCore(
     const GPUMatrix<ElemType>& weightsW,
     const GPUMatrix<ElemType>& inputX, GPUMatrix<ElemType>& outputY,
     const vector<size_t>& numSequencesForFrame,
-    const RnnAttributes& rnnAttributes,
+    const RnnAttributes& rnnAttributes, bool inferenceOnly,
     GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace
     )
 {
@@ -76,19 +111,94 @@ void CuDnnRNNExecutor<ElemType>::ForwardCore(
     if (m_yDim != (m_rnnT->isBidirectional() ? 2 : 1) * m_rnnT->GetNumHidden())
         InvalidArgument("CuDnn ForwardCore: Output leading dimension must be twice hidden size for bidirectional networks");
 
-    // set up the input and output descriptors
-    SetDescriptors(m_xDim, numSequencesForFrame, xDesc);
-    SetDescriptors(m_yDim, numSequencesForFrame, yDesc);
+    // set up the input and output descriptors, unless the layout is that of the last call
+    if (numSequencesForFrame != m_numSequencesForFrame)
+    {
+        SetDescriptors(m_xDim, numSequencesForFrame, xDesc);
+        SetDescriptors(m_yDim, numSequencesForFrame, yDesc);
+        m_numSequencesForFrame = numSequencesForFrame;
+    }
+    m_seqLength = numSequencesForFrame.size();
+
+    if (UsePersistentAlgorithm(numSequencesForFrame, rnnAttributes))
+    {
+        try
+        {
+            if (!m_persistentRnnT)
+                m_persistentRnnT = std::make_unique<CuDnnRNN<ElemType>>(rnnAttributes, /*persistent=*/true);
+            m_activeRnnT = m_persistentRnnT.get();
+            ForwardCore(*m_activeRnnT, weightsW, inputX, outputY, inferenceOnly, reserve, workspace);
+            return;
+        }
+        catch (const std::exception&)
+        {
+            if (rnnAttributes.m_algorithm != L"auto")
+                throw;
+            // e.g. the hidden size does not fit on this GPU; don't try again
+            m_persistentAlgorithmFailed = true;
+        }
+    }
+    m_activeRnnT = m_rnnT.get();
+    ForwardCore(*m_activeRnnT, weightsW, inputX, outputY, inferenceOnly, reserve, workspace);
+}
+
+// workspace of the bucket of the current layout: sequences are sorted by decreasing length, so the layout with the
+// batch of the first frame in all frames is the largest of the bucket
+template <class ElemType>
+size_t CuDnnRNNExecutor<ElemType>::GetInferenceWorkspaceSize(CuDnnRNN<ElemType>& rnn, size_t maxNumSequences)
+{
+    auto key = std::make_tuple((const CuDnnRNN<ElemType>*)&rnn, maxNumSequences, m_seqLength);
+    auto iter = m_inferenceWorkspaceSizes.find(key);
+    if (iter != m_inferenceWorkspaceSizes.end())
+        return iter->second;
+
+    SetDescriptors(m_xDim, vector<size_t>(m_seqLength, maxNumSequences), m_bucketXDesc);
+    size_t workSize;
+    CUDNN_CALL(cudnnGetRNNWorkspaceSize(*m_cudnn, rnn, (int)m_seqLength, m_bucketXDesc.data(), &workSize));
+    workSize = (workSize + sizeof(ElemType) - 1) / sizeof(ElemType);
+    m_inferenceWorkspaceSizes[key] = workSize;
+    return workSize;
+}
+
+template <class ElemType>
+void CuDnnRNNExecutor<ElemType>::ForwardCore(CuDnnRNN<ElemType>& rnn, const GPUMatrix<ElemType>& weightsW, const GPUMatrix<ElemType>& inputX, GPUMatrix<ElemType>& outputY,
+                                             bool inferenceOnly, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace)
+{
+    // the parameter layout does not depend on the minibatch
+    if (!wDesc)
+    {
+        wDesc = make_unique<CuDnnFilter<ElemType>>(rnn, xDesc[0]);
+        if (wDesc->GetSize() != weightsW.GetNumElements())
+            InvalidArgument("RNN needs %ld parameters, but %ld were allocated", wDesc->GetSize(), weightsW.GetNumElements());
+    }
+
+    m_inferenceOnly = inferenceOnly;
+    if (inferenceOnly)
+    {
+        // no reserve, since there is no backprop
+        workspace.Resize(GetInferenceWorkspaceSize(rnn, m_numSequencesForFrame.front()), 1);
+        CUDNN_CALL(cudnnRNNForwardInference(
+            *m_cudnn, rnn,
+            (int)m_seqLength,
+            xDesc.data(), inputX.Data(),
+            0, 0,
+            0, 0,
+            *wDesc, weightsW.Data(),
+            yDesc.data(), outputY.Data(),
+            0, 0,
+            0, 0,
+            workspace.Data(), workspace.GetNumElements()*sizeof(ElemType)));
+        return;
+    }
 
     // ensure workspace and reserve are large enough
-    m_seqLength = numSequencesForFrame.size();
     size_t workSize;
     size_t reserveSize;
 
     // Need for every pass
-    CUDNN_CALL(cudnnGetRNNWorkspaceSize(*m_cudnn, *m_rnnT, (int)m_seqLength, xDesc.data(), &workSize));
+    CUDNN_CALL(cudnnGetRNNWorkspaceSize(*m_cudnn, rnn, (int)m_seqLength, xDesc.data(), &workSize));
     // Only needed in training, can't be touched between passes.
-    CUDNN_CALL(cudnnGetRNNTrainingReserveSize(*m_cudnn, *m_rnnT, (int)m_seqLength, xDesc.data(), &reserveSize));
+    CUDNN_CALL(cudnnGetRNNTrainingReserveSize(*m_cudnn, rnn, (int)m_seqLength, xDesc.data(), &reserveSize));
 
     // convert from bytes to ElemType
     workSize = (workSize + sizeof(ElemType) - 1) / (sizeof(ElemType));
@@ -97,12 +207,8 @@ void CuDnnRNNExecutor<ElemType>::ForwardCore(
     reserve.Resize(reserveSize, 1);
     workspace.Resize(workSize, 1);
 
-    wDesc = make_unique<CuDnnFilter<ElemType>>(*m_rnnT, xDesc[0]);
-    if (wDesc->GetSize() != weightsW.GetNumElements())
-        InvalidArgument("RNN needs %ld parameters, but %ld were allocated", wDesc->GetSize(), weightsW.GetNumElements());
-
     CUDNN_CALL(cudnnRNNForwardTraining(
-        *m_cudnn, *m_rnnT,
+        *m_cudnn, rnn,
         (int)m_seqLength,
         xDesc.data(), inputX.Data(),
         0, 0,
@@ -126,11 +232,13 @@ void CuDnnRNNExecutor<ElemType>::BackwardDataCore(
     // test that the RNN shape is correct
     if (!m_rnnT->IsCompatible(rnnAttributes))
         LogicError("RNN Layout has changed during processing");
+    if (m_inferenceOnly)
+        LogicError("RNNBackwardData called after a forward pass without reserve (inference only)");
 
     if (!m_BackwardDataCalledYet)
     {
         CUDNN_CALL(cudnnRNNBackwardData(
-            *m_cudnn, *m_rnnT,
+            *m_cudnn, *m_activeRnnT,
             (int)m_seqLength,
             yDesc.data(), outputY.Data(),
             yDesc.data(), outputDY.Data(),
@@ -160,7 +268,7 @@ void CuDnnRNNExecutor<ElemType>::BackwardWeightsCore(const GPUMatrix<ElemType>&
     if (!m_BackwardDataCalledYet)
         LogicError("out of order calling you have been very bad");
     CUDNN_CALL(cudnnRNNBackwardWeights(
-        *m_cudnn, *m_rnnT,
+        *m_cudnn, *m_activeRnnT,
         (int)m_seqLength,
         xDesc.data(), inputX.Data(),
         0, 0,
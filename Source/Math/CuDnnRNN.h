@@ -5,6 +5,8 @@
 #include "TensorShape.h"
 #include <typeinfo>
 #include <typeindex>
+#include <map>
+#include <tuple>
 #include "CuDnnCommon.h"
 #include "RNNCommon.h"
 
@@ -59,6 +61,7 @@ template <class ElemType>
 class CuDnnRNN
 {
 private:
+    CuDnn::ptr_t m_cudnn;
     cudnnDataType_t m_dataType;
     cudnnRNNDescriptor_t m_rnnDesc;
     CuDnnDropout m_dropout;
@@ -74,11 +77,26 @@ private:
     }
 
 public:
-    CuDnnRNN(const RnnAttributes& rnnAttributes)
+    // With 'persistent', cuDNN keeps the recurrent weights in registers and shared memory across time steps
+    // (CUDNN_RNN_ALGO_PERSIST_STATIC, cuDNN 6 or higher).
+    CuDnnRNN(const RnnAttributes& rnnAttributes, bool persistent = false)
         : m_rnnDesc(nullptr), m_dropout(0.0f), m_rnnAttributes(rnnAttributes),
-        m_dataType(CuDnnTensor::GetDataType<ElemType>())
+        m_cudnn(CuDnn::Instance()), m_dataType(CuDnnTensor::GetDataType<ElemType>())
     {
         CUDNN_CALL(cudnnCreateRNNDescriptor(&m_rnnDesc));
+#if CUDNN_MAJOR >= 6
+        CUDNN_CALL(cudnnSetRNNDescriptor(*m_cudnn, m_rnnDesc,
+            (int)m_rnnAttributes.m_hiddenSize,
+            (int)m_rnnAttributes.m_numLayers,
+            m_dropout,
+            CUDNN_LINEAR_INPUT, // We can also skip the input matrix transformation
+            m_rnnAttributes.m_bidirectional ? CUDNN_BIDIRECTIONAL : CUDNN_UNIDIRECTIONAL,
+            GetMode(),
+            persistent ? CUDNN_RNN_ALGO_PERSIST_STATIC : CUDNN_RNN_ALGO_STANDARD,
+            m_dataType));
+#else
+        if (persistent)
+            LogicError("CuDnnRNN: Persistent RNN algorithms require cuDNN 6 or higher.");
         CUDNN_CALL(cudnnSetRNNDescriptor(m_rnnDesc,
             (int)m_rnnAttributes.m_hiddenSize,
             (int)m_rnnAttributes.m_numLayers,
@@ -87,6 +105,7 @@ public:
             m_rnnAttributes.m_bidirectional ? CUDNN_BIDIRECTIONAL : CUDNN_UNIDIRECTIONAL,
             GetMode(),
             m_dataType));
+#endif
     }
 
     ~CuDnnRNN()
@@ -175,6 +194,10 @@ private:
 // CuDnnRNNExecutor holds the configuration and state for an instance of an RNN for CUDNN.
 // It is generally attached to a GpuMatrix() object, and all calls to the RNN need to go through
 // that object.
+// The frame descriptors are only set up again when the sequence layout changes, and the filter descriptor once.
+// With 'inferenceOnly' (evaluation), the forward pass needs no reserve space, and the workspace is sized once per
+// (max batch, length) bucket for the largest layout of that bucket, so that repeated calls, e.g. of a streaming
+// recognizer, neither query cuDNN nor reallocate.
 
 template <class ElemType>
 class CuDnnRNNExecutor
@@ -188,12 +211,23 @@ public:
         m_xDim(xDim), m_yDim(yDim),
         m_seqLength(0),
         m_dataType(CuDnnTensor::GetDataType<ElemType>()),
-        m_BackwardDataCalledYet(false)
+        m_BackwardDataCalledYet(false),
+        m_activeRnnT(nullptr),
+        m_persistentAlgorithmSupported(IsPersistentAlgorithmSupported()),
+        m_persistentAlgorithmFailed(false),
+        m_inferenceOnly(false)
     {
         m_rnnT = std::make_unique<CuDnnRNN<ElemType>>(rnnAttributes);
     }
 
-    void ForwardCore(const GPUMatrix<ElemType>& weightsW, const GPUMatrix<ElemType>& inputX, GPUMatrix<ElemType>& outputY, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace);
+    ~CuDnnRNNExecutor()
+    {
+        for (auto descriptors : { &xDesc, &yDesc, &m_bucketXDesc })
+            for (auto descriptor : *descriptors)
+                cudnnDestroyTensorDescriptor(descriptor);
+    }
+
+    void ForwardCore(const GPUMatrix<ElemType>& weightsW, const GPUMatrix<ElemType>& inputX, GPUMatrix<ElemType>& outputY, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, bool inferenceOnly, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace);
     void BackwardWeightsCore(const GPUMatrix<ElemType>& inputX, const GPUMatrix<ElemType>& outputY, GPUMatrix<ElemType>& dw, const RnnAttributes& rnnAttributes, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace);
     void BackwardDataCore(const GPUMatrix<ElemType>& outputY, const GPUMatrix<ElemType>& outputDY, const GPUMatrix<ElemType>& w, GPUMatrix<ElemType>& dx, const RnnAttributes& rnnAttributes, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace);
 
@@ -214,10 +248,23 @@ private:
 
     void SetDescriptors(size_t dim, const vector<size_t>& numSequencesForFrame, vector<cudnnTensorDescriptor_t>& descriptors);
 
+    void ForwardCore(CuDnnRNN<ElemType>& rnn, const GPUMatrix<ElemType>& weightsW, const GPUMatrix<ElemType>& inputX, GPUMatrix<ElemType>& outputY, bool inferenceOnly, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace);
+    size_t GetInferenceWorkspaceSize(CuDnnRNN<ElemType>& rnn, size_t maxNumSequences);
+    bool UsePersistentAlgorithm(const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes);
+    static bool IsPersistentAlgorithmSupported();
+
 private:
     std::unique_ptr<CuDnnRNN<ElemType>> m_rnnT;
+    std::unique_ptr<CuDnnRNN<ElemType>> m_persistentRnnT; // persistent algorithm, created on first use
+    CuDnnRNN<ElemType>* m_activeRnnT;                     // the one of the last ForwardCore(), for backprop
+    bool m_persistentAlgorithmSupported;                  // by cuDNN, the GPU, and ElemType
+    bool m_persistentAlgorithmFailed;                     // with 'auto': cuDNN rejected it for this configuration
     bool m_BackwardDataCalledYet;
+    bool m_inferenceOnly;                                 // the last ForwardCore() kept no reserve for backprop
     size_t m_seqLength;
+    vector<size_t> m_numSequencesForFrame;                // layout of xDesc and yDesc
+    vector<cudnnTensorDescriptor_t> m_bucketXDesc;        // full layout of a bucket, for sizing its workspace
+    std::map<std::tuple<const CuDnnRNN<ElemType>*, size_t, size_t>, size_t> m_inferenceWorkspaceSizes; // [rnn, max batch, length] -> elements
 };
 
 } } }
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "stdafx.h"
+#include "CudaGraph.h"
+#include "BestGpu.h" // for CPUONLY
+#ifndef CPUONLY
+#include "GPUMatrix.h" // for SetStream(), GetStream()
+#include <cuda_runtime_api.h>
+#endif
+
+#if !defined(CPUONLY) && CUDART_VERSION >= 10010 // (thread-local capture mode)
+#define CUDA_GRAPHS_SUPPORTED
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef CUDA_GRAPHS_SUPPORTED
+
+inline static void CheckCudaReturnCode(cudaError_t rc, const char* msg)
+{
+    if (rc != cudaSuccess)
+        RuntimeError("%s: %s (cuda error %d)", msg, cudaGetErrorString(rc), (int)rc);
+}
+
+struct CudaGraph::Impl
+{
+    int m_deviceId;
+    cudaStream_t m_stream = nullptr;         // the stream captured into and launched on
+    cudaStream_t m_previousStream = nullptr; // GetStream() before BeginCapture()
+    cudaGraph_t m_graph = nullptr;
+    cudaGraphExec_t m_graphExec = nullptr;
+};
+
+CudaGraph::CudaGraph(int deviceId)
+    : m_impl(new Impl())
+{
+    m_impl->m_deviceId = deviceId;
+    CheckCudaReturnCode(cudaSetDevice(deviceId), "Cannot set cuda device");
+    CheckCudaReturnCode(cudaStreamCreateWithFlags(&m_impl->m_stream, cudaStreamNonBlocking), "CudaGraph: cannot create stream");
+}
+
+CudaGraph::~CudaGraph()
+{
+    // no error checking: we may be unwinding
+    cudaSetDevice(m_impl->m_deviceId);
+    if (m_impl->m_graphExec)
+        cudaGraphExecDestroy(m_impl->m_graphExec);
+    if (m_impl->m_graph)
+        cudaGraphDestroy(m_impl->m_graph);
+    cudaStreamDestroy(m_impl->m_stream);
+}
+
+/*static*/ bool CudaGraph::IsSupported(int deviceId)
+{
+    return deviceId >= 0;
+}
+
+void CudaGraph::BeginCapture()
+{
+    if (m_impl->m_graph)
+        LogicError("CudaGraph::BeginCapture: The graph has already been captured.");
+    CheckCudaReturnCode(cudaSetDevice(m_impl->m_deviceId), "Cannot set cuda device");
+    // kernels issued before the capture must have completed, since the capture stream does not wait for them
+    CheckCudaReturnCode(cudaDeviceSynchronize(), "CudaGraph::BeginCapture: cannot synchronize");
+    m_impl->m_previousStream = GetStream();
+    SetStream(m_impl->m_stream);
+    auto rc = cudaStreamBeginCapture(m_impl->m_stream, cudaStreamCaptureModeThreadLocal);
+    if (rc != cudaSuccess)
+    {
+        SetStream(m_impl->m_previousStream);
+        CheckCudaReturnCode(rc, "CudaGraph::BeginCapture: cannot begin capture");
+    }
+}
+
+bool CudaGraph::EndCapture()
+{
+    SetStream(m_impl->m_previousStream);
+    cudaGraph_t graph = nullptr;
+    auto rc = cudaStreamEndCapture(m_impl->m_stream, &graph);
+    if (rc == cudaSuccess && graph)
+#if CUDART_VERSION >= 12000
+        rc = cudaGraphInstantiate(&m_impl->m_graphExec, graph, 0);
+#else
+        rc = cudaGraphInstantiate(&m_impl->m_graphExec, graph, nullptr, nullptr, 0);
+#endif
+    if (rc != cudaSuccess)
+    {
+        // an operation that cannot be captured invalidated the capture; clear the sticky error so that the caller can run the work normally
+        if (graph)
+            cudaGraphDestroy(graph);
+        m_impl->m_graphExec = nullptr;
+        cudaGetLastError();
+        return false;
+    }
+    m_impl->m_graph = graph;
+    return true;
+}
+
+void CudaGraph::Launch()
+{
+    if (!m_impl->m_graphExec)
+        LogicError("CudaGraph::Launch: The graph has not been captured.");
+    CheckCudaReturnCode(cudaSetDevice(m_impl->m_deviceId), "Cannot set cuda device");
+    CheckCudaReturnCode(cudaGraphLaunch(m_impl->m_graphExec, m_impl->m_stream), "CudaGraph::Launch: launch failed");
+    CheckCudaReturnCode(cudaStreamSynchronize(m_impl->m_stream), "CudaGraph::Launch: execution failed");
+}
+
+bool CudaGraph::IsCaptured() const
+{
+    return m_impl->m_graphExec != nullptr;
+}
+
+#else
+// Dummy definitions when compiling for CPUONLY or against a CUDA version without graphs
+struct CudaGraph::Impl
+{
+};
+
+CudaGraph::CudaGraph(int)
+{
+    RuntimeError("CudaGraph: CUDA graphs are not supported by this build.");
+}
+
+CudaGraph::~CudaGraph()
+{
+}
+
+/*static*/ bool CudaGraph::IsSupported(int)
+{
+    return false;
+}
+
+void CudaGraph::BeginCapture()
+{
+}
+
+bool CudaGraph::EndCapture()
+{
+    return false;
+}
+
+void CudaGraph::Launch()
+{
+}
+
+bool CudaGraph::IsCaptured() const
+{
+    return false;
+}
+#endif
+} } }
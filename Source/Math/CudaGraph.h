@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+// -----------------------------------------------------------------------
+// CudaGraph -- the GPU work issued by this thread between BeginCapture() and
+// EndCapture(), recorded once and replayed by Launch() without the host-side
+// cost of launching each kernel again.
+// Replay reuses the device pointers and launch parameters of the capture, so
+// the caller must make sure that all buffers involved are still the same.
+// Requires CUDA 10.1 or later; IsSupported() is false otherwise, and on CPU.
+// -----------------------------------------------------------------------
+
+class MATH_API CudaGraph
+{
+public:
+    CudaGraph(int deviceId);
+    ~CudaGraph();
+
+    static bool IsSupported(int deviceId);
+
+    // route all GPU work of this thread into a capture stream and record it instead of running it
+    void BeginCapture();
+    // stop recording and restore the previous stream; returns false if something not capturable
+    // (e.g. a synchronous copy or allocation) was issued, in which case the graph cannot be launched
+    bool EndCapture();
+    // run the recorded work and wait for it to complete
+    void Launch();
+
+    bool IsCaptured() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+} } }
@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "GPUCopyStream.h"
+#include "BestGpu.h" // for CPUONLY
+#ifndef CPUONLY
+#include "GPUMatrix.h" // for GetStream()
+#include <cuda_runtime_api.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifndef CPUONLY
+
+inline static void CheckCudaReturnCode(cudaError_t rc, const char* msg)
+{
+    if (rc != cudaSuccess)
+        RuntimeError("%s: %s (cuda error %d)", msg, cudaGetErrorString(rc), (int)rc);
+}
+
+struct GPUCopyStream::Impl
+{
+    int m_deviceId;
+    cudaStream_t m_stream = nullptr;
+    std::vector<cudaEvent_t> m_events;
+    std::vector<size_t> m_freeEvents; // events that may be recorded again
+
+    size_t GetEvent()
+    {
+        if (m_freeEvents.empty())
+        {
+            cudaEvent_t event;
+            CheckCudaReturnCode(cudaEventCreateWithFlags(&event, cudaEventDisableTiming), "GPUCopyStream: cannot create event");
+            m_events.push_back(event);
+            return m_events.size() - 1;
+        }
+        size_t event = m_freeEvents.back();
+        m_freeEvents.pop_back();
+        return event;
+    }
+};
+
+GPUCopyStream::GPUCopyStream(int deviceId)
+    : m_impl(new Impl())
+{
+    m_impl->m_deviceId = deviceId;
+    CheckCudaReturnCode(cudaSetDevice(deviceId), "Cannot set cuda device");
+    CheckCudaReturnCode(cudaStreamCreateWithFlags(&m_impl->m_stream, cudaStreamNonBlocking), "GPUCopyStream: cannot create stream");
+}
+
+GPUCopyStream::~GPUCopyStream()
+{
+    // no error checking: we may be unwinding
+    cudaSetDevice(m_impl->m_deviceId);
+    cudaStreamSynchronize(m_impl->m_stream);
+    for (auto event : m_impl->m_events)
+        cudaEventDestroy(event);
+    cudaStreamDestroy(m_impl->m_stream);
+}
+
+/*static*/ bool GPUCopyStream::IsSupported(int deviceId)
+{
+    return deviceId >= 0;
+}
+
+size_t GPUCopyStream::CopyAsync(void* dst, const void* src, size_t numBytes)
+{
+    // start after the work issued so far on the thread's stream
+    size_t start = m_impl->GetEvent();
+    CheckCudaReturnCode(cudaEventRecord(m_impl->m_events[start], GetStream()), "GPUCopyStream::CopyAsync: cannot record event");
+    CheckCudaReturnCode(cudaStreamWaitEvent(m_impl->m_stream, m_impl->m_events[start], 0), "GPUCopyStream::CopyAsync: cannot wait for event");
+    m_impl->m_freeEvents.push_back(start); // (the wait above has taken its state)
+
+    CheckCudaReturnCode(cudaMemcpyAsync(dst, src, numBytes, cudaMemcpyDefault, m_impl->m_stream), "GPUCopyStream::CopyAsync: cannot copy");
+    size_t done = m_impl->GetEvent();
+    CheckCudaReturnCode(cudaEventRecord(m_impl->m_events[done], m_impl->m_stream), "GPUCopyStream::CopyAsync: cannot record event");
+    return done;
+}
+
+void GPUCopyStream::Wait(size_t copy)
+{
+    CheckCudaReturnCode(cudaStreamWaitEvent(GetStream(), m_impl->m_events[copy], 0), "GPUCopyStream::Wait: cannot wait for event");
+    m_impl->m_freeEvents.push_back(copy);
+}
+
+#else
+// Dummy definitions when compiling for CPUONLY
+struct GPUCopyStream::Impl
+{
+};
+
+GPUCopyStream::GPUCopyStream(int)
+{
+}
+
+GPUCopyStream::~GPUCopyStream()
+{
+}
+
+/*static*/ bool GPUCopyStream::IsSupported(int)
+{
+    return false;
+}
+
+size_t GPUCopyStream::CopyAsync(void*, const void*, size_t)
+{
+    return 0;
+}
+
+void GPUCopyStream::Wait(size_t)
+{
+}
+#endif
+} } }
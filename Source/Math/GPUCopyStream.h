@@ -0,0 +1,47 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+// -----------------------------------------------------------------------
+// GPUCopyStream -- copies between GPU memory and pinned host memory (see CUDAPageLockedMemAllocator) that
+// overlap with the computation on the calling thread's stream (see SetStream()).
+// A copy starts once all GPU work issued so far on the thread's stream is done, and Wait() makes the thread's
+// stream wait for it. Each copy must be waited for exactly once. The copies are ordered by events only; the
+// stream does not synchronize with the legacy default stream.
+// On CPU builds, there is no stream and all functions do nothing.
+// -----------------------------------------------------------------------
+
+class MATH_API GPUCopyStream
+{
+public:
+    GPUCopyStream(int deviceId);
+    ~GPUCopyStream();
+
+    static bool IsSupported(int deviceId);
+
+    // returns an id for Wait()
+    size_t CopyAsync(void* dst, const void* src, size_t numBytes);
+    void Wait(size_t copy);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+} } }
@@ -102,6 +102,7 @@ public:
     }
 
     void WaitForCopyGPUToCPUAsync();
+    bool IsCopyGPUToCPUAsyncComplete(); // does not wait
 
     // CPU to GPU
     void CopyCPUToGPUAsync(void* cpuBuffer, size_t totalSize, void* gpuBuffer);
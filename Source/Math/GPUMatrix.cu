@@ -22,8 +22,13 @@
 #include <curand.h>
 #include <curand_kernel.h>
 #include "cublas_v2.h"
+#if CUDA_VERSION >= 9000
+#include <cuda_fp16.h>
+#endif
 #include <assert.h>
+#include <algorithm>
 #include <memory>
+#include <mutex>
 #include "CntkBatchNormalization.cuh"
 #include "Convolution.cuh"
 #include "CuDnnRNN.h"
@@ -127,6 +132,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     s_isSyncEnabled = true;
 }
 
+/*static*/ bool DeterministicReductions::s_isEnabled = false;
+
+/*static*/ void DeterministicReductions::Enable(bool enable)
+{
+    s_isEnabled = enable;
+}
+
+/*static*/ bool DeterministicReductions::IsEnabled()
+{
+    return s_isEnabled;
+}
+
 SyncGuard::SyncGuard(bool forceSync /*= false*/)
     : m_forceSync(forceSync)
 {
@@ -158,6 +175,195 @@ SyncGuard::~SyncGuard()
     }
 }
 
+// -----------------------------------------------------------------------
+// GPUMemoryCache -- caching layer behind TracingGPUMemoryAllocator
+// Freed buffers are kept in free lists per (device, stream), keyed by their (rounded-up) size.
+// A buffer is only reused on the stream it was allocated on, so reuse is ordered with respect
+// to all pending kernels that touch it, and no device synchronization is needed.
+// -----------------------------------------------------------------------
+
+class GPUMemoryCache
+{
+    struct Block
+    {
+        size_t numBytes;       // actual (rounded-up) size of the buffer
+        size_t requestedBytes; // size of the current request
+        cudaStream_t stream;
+    };
+
+    typedef std::pair<int, cudaStream_t> FreeListKey;
+
+    std::mutex m_mutex;
+    std::map<FreeListKey, std::multimap<size_t, void*>> m_freeLists;
+    std::unordered_map<void*, Block> m_liveBlocks;
+    std::map<int, TracingGPUMemoryAllocator::CacheStatistics> m_statistics;
+
+    // small buffers are rounded to 512 bytes, large ones to 1 MB, so that buffers of varying
+    // minibatch sizes fall into the same bins
+    static size_t RoundUp(size_t numBytes)
+    {
+        const size_t smallGranularity = 512;
+        const size_t largeGranularity = 1 << 20;
+        size_t granularity = numBytes < largeGranularity ? smallGranularity : largeGranularity;
+        return (numBytes + granularity - 1) / granularity * granularity;
+    }
+
+    static void* DeviceMalloc(size_t numBytes)
+    {
+        void* bufferPtr = nullptr;
+        cudaError_t result = cudaMalloc(&bufferPtr, numBytes);
+        if (result == cudaErrorMemoryAllocation)
+        {
+            cudaGetLastError(); // clear the error state so that the caller can retry
+            return nullptr;
+        }
+        CUDA_CALL(result);
+        return bufferPtr;
+    }
+
+    // Large requests re-check the free device memory first: the device may have filled up since it was selected, e.g. by
+    // other processes sharing it, and a failing cudaMalloc of a large block gives a less helpful error than this check.
+    // caller must hold m_mutex
+    void CheckFreeMemoryNoLock(int deviceId, size_t numBytes)
+    {
+        const size_t largeAllocation = (size_t)256 << 20;
+        if (numBytes < largeAllocation)
+            return;
+
+        size_t free, total;
+        PrepareDevice(deviceId);
+        CUDA_CALL(cudaMemGetInfo(&free, &total));
+        if (free >= numBytes)
+            return;
+
+        TrimNoLock(deviceId); // our cached buffers count as used
+        PrepareDevice(deviceId);
+        CUDA_CALL(cudaMemGetInfo(&free, &total));
+        if (free < numBytes)
+            RuntimeError("GPUMemoryCache: Cannot allocate %.1f MB on GPU %d, only %.1f MB of %.1f MB are free. The device may be used by other processes (see gpuPlacement and maxProcessesPerGpu).",
+                         numBytes / 1048576.0, deviceId, free / 1048576.0, total / 1048576.0);
+    }
+
+    // caller must hold m_mutex
+    void TrimNoLock(int deviceId)
+    {
+        for (auto& freeList : m_freeLists)
+        {
+            if (deviceId != DEVICEID_AUTO && freeList.first.first != deviceId)
+                continue;
+            PrepareDevice(freeList.first.first);
+            auto& statistics = m_statistics[freeList.first.first];
+            for (auto& block : freeList.second)
+            {
+                CUDA_CALL(cudaFree(block.second));
+                statistics.cachedBytes -= block.first;
+            }
+            freeList.second.clear();
+        }
+        for (auto& statistics : m_statistics)
+        {
+            if (deviceId == DEVICEID_AUTO || statistics.first == deviceId)
+                statistics.second.numTrims++;
+        }
+    }
+
+public:
+    static GPUMemoryCache& GetInstance()
+    {
+        // intentionally never destroyed: freeing device memory during static destruction may happen after the CUDA runtime is gone
+        static GPUMemoryCache* s_instance = new GPUMemoryCache();
+        return *s_instance;
+    }
+
+    void* Allocate(int deviceId, size_t numBytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& statistics = m_statistics[deviceId];
+        cudaStream_t stream = GetStream();
+        size_t roundedBytes = RoundUp(numBytes);
+
+        void* bufferPtr = nullptr;
+        size_t blockBytes = roundedBytes;
+        auto& freeList = m_freeLists[std::make_pair(deviceId, stream)];
+        auto bestFit = freeList.lower_bound(roundedBytes);
+        if (bestFit != freeList.end() && bestFit->first < roundedBytes * MEM_MAX_LIMIT_TIMES)
+        {
+            bufferPtr = bestFit->second;
+            blockBytes = bestFit->first;
+            freeList.erase(bestFit);
+            statistics.cachedBytes -= blockBytes;
+            statistics.numHits++;
+        }
+        else
+        {
+            CheckFreeMemoryNoLock(deviceId, roundedBytes);
+            PrepareDevice(deviceId);
+            bufferPtr = DeviceMalloc(roundedBytes);
+            if (!bufferPtr) // out of memory: give all cached buffers back to the device and retry
+            {
+                TrimNoLock(deviceId);
+                PrepareDevice(deviceId);
+                CUDA_CALL(cudaMalloc(&bufferPtr, roundedBytes));
+            }
+            statistics.numMisses++;
+        }
+
+        m_liveBlocks[bufferPtr] = Block{blockBytes, numBytes, stream};
+        statistics.inUseBytes += blockBytes;
+        statistics.requestedBytes += numBytes;
+        statistics.peakInUseBytes = std::max(statistics.peakInUseBytes, statistics.inUseBytes);
+        return bufferPtr;
+    }
+
+    // returns false if the buffer was not allocated through the cache
+    bool Free(int deviceId, void* bufferPtr, bool returnToCache)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto iter = m_liveBlocks.find(bufferPtr);
+        if (iter == m_liveBlocks.end())
+            return false;
+
+        Block block = iter->second;
+        m_liveBlocks.erase(iter);
+        auto& statistics = m_statistics[deviceId];
+        statistics.inUseBytes -= block.numBytes;
+        statistics.requestedBytes -= block.requestedBytes;
+        if (returnToCache)
+        {
+            m_freeLists[std::make_pair(deviceId, block.stream)].insert(std::make_pair(block.numBytes, bufferPtr));
+            statistics.cachedBytes += block.numBytes;
+        }
+        else
+        {
+            PrepareDevice(deviceId);
+            CUDA_CALL(cudaFree(bufferPtr));
+        }
+        return true;
+    }
+
+    void Trim(int deviceId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        TrimNoLock(deviceId);
+    }
+
+    TracingGPUMemoryAllocator::CacheStatistics GetStatistics(int deviceId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics[deviceId];
+    }
+};
+
+void TracingGPUMemoryAllocator::TrimCache(int deviceId)
+{
+    GPUMemoryCache::GetInstance().Trim(deviceId);
+}
+
+TracingGPUMemoryAllocator::CacheStatistics TracingGPUMemoryAllocator::GetCacheStatistics(int deviceId)
+{
+    return GPUMemoryCache::GetInstance().GetStatistics(deviceId);
+}
+
 template <typename AllocatedElemType>
 AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numRows, size_t numCols)
 {
@@ -201,11 +407,15 @@ AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numE
 template <typename AllocatedElemType>
 void TracingGPUMemoryAllocator::Free(int deviceId, AllocatedElemType* bufferPtr, bool ignoreCUDARetCode /*= false*/)
 {
-    PrepareDevice(deviceId);
-    if (ignoreCUDARetCode)
-        cudaFree((void*) bufferPtr);
-    else
-        CUDA_CALL(cudaFree((void*) bufferPtr));
+    // buffers that came from the cache go back to it (or are freed for real if caching was turned off meanwhile)
+    if (bufferPtr == nullptr || !GPUMemoryCache::GetInstance().Free(deviceId, (void*) bufferPtr, IsCachingEnabled()))
+    {
+        PrepareDevice(deviceId);
+        if (ignoreCUDARetCode)
+            cudaFree((void*) bufferPtr);
+        else
+            CUDA_CALL(cudaFree((void*) bufferPtr));
+    }
 
     if (IsTraceEnabled())
     {
@@ -220,6 +430,9 @@ AllocatedElemType* TracingGPUMemoryAllocator::AllocateNoTrace(int deviceId, size
 {
     AllocatedElemType* deviceBufferPtr;
 
+    if (IsCachingEnabled() && numElements > 0)
+        return (AllocatedElemType*) GPUMemoryCache::GetInstance().Allocate(deviceId, sizeof(AllocatedElemType) * numElements);
+
     PrepareDevice(deviceId);
     CUDA_CALL(cudaMalloc((void**) &deviceBufferPtr, sizeof(AllocatedElemType) * numElements));
 
@@ -983,6 +1196,44 @@ static void Peek(const GPUMatrix<ElemType>& m, const char* which)
     //CUDA_CALL(cudaMemcpy(const_cast<ElemType*>(m.Data()), buf, sizeof(ElemType) * n, cudaMemcpyHostToDevice));
 }
 
+// a single device allocation for the small host arrays that describe a kernel launch, e.g. of a multi-tensor operation
+class MultiTensorDeviceBuffer
+{
+public:
+    MultiTensorDeviceBuffer(DEVICEID_TYPE deviceId, const std::vector<size_t>& sizesInBytes)
+        : m_deviceId(deviceId)
+    {
+        size_t totalBytes = 0;
+        for (auto size : sizesInBytes)
+        {
+            m_offsets.push_back(totalBytes);
+            totalBytes += (size + 255) & ~(size_t) 255;
+        }
+        m_data = TracingGPUMemoryAllocator::Allocate<char>(deviceId, totalBytes);
+    }
+    ~MultiTensorDeviceBuffer()
+    {
+        TracingGPUMemoryAllocator::Free<char>(m_deviceId, m_data);
+    }
+
+    template <class T>
+    T* Get(size_t i) const
+    {
+        return reinterpret_cast<T*>(m_data + m_offsets[i]);
+    }
+    template <class T>
+    T* Upload(size_t i, const std::vector<T>& values) const
+    {
+        CUDA_CALL(cudaMemcpy(Get<T>(i), values.data(), sizeof(T) * values.size(), cudaMemcpyHostToDevice));
+        return Get<T>(i);
+    }
+
+private:
+    DEVICEID_TYPE m_deviceId;
+    char* m_data;
+    std::vector<size_t> m_offsets;
+};
+
 #define ALLOW_ATOMIC_SCATTER // allow to disable this, until we know atomicAdd() works properly here
 
 template <class ElemType>
@@ -1017,6 +1268,24 @@ __global__ void _doScatterColumnsOf(ElemType* us, size_t usStride, size_t usCols
     // Note: atomicAdd() is supposed to be fast in case of no conflict (the simple case of Scatter())
 }
 
+// deterministic version of _doScatterColumnsOf(): each thread adds up all source elements of one target element, in the
+// order of the source columns (sources[sourceBegins[t]..sourceBegins[t+1]) go to column targets[t])
+template <class ElemType>
+__global__ void _doScatterColumnsOfInOrder(ElemType* us, size_t usStride, const int* targets, const int* sourceBegins, const int* sources, const ElemType* a, size_t aStride, const ElemType alpha, CUDA_LONG numElements)
+{
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numElements)
+        return;
+
+    CUDA_LONG i = id % aStride; // row index into 'a' and 'us'
+    CUDA_LONG t = id / aStride; // index into 'targets'
+
+    ElemType sum = 0;
+    for (int k = sourceBegins[t]; k < sourceBegins[t + 1]; k++)
+        sum += a[i + sources[k] * aStride];
+    us[i + targets[t] * usStride] += sum * alpha;
+}
+
 // *this[:,idx[j]] = a[:,j] * alpha + *this[:,idx[j]] * beta
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
@@ -1059,6 +1328,48 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     // Scatter may add more than one source column to the same target, so we must pre-scale with beta, and then just keep adding.
     Scale(beta, us); // if beta is 0, then this will be a memset()
 
+    // With deterministic reductions, source columns that go to the same target column are added up in a fixed order.
+    // Without such collisions, the atomicAdd() below is deterministic as well.
+    if (DeterministicReductions::IsEnabled())
+    {
+        vector<ElemType> buf(idx.GetNumElements());
+        CUDA_CALL(cudaMemcpy(buf.data(), idx.Data(), sizeof(ElemType) * buf.size(), cudaMemcpyDeviceToHost));
+        vector<pair<int, int>> targetSources; // (target column, source column), sorted by target, then source
+        for (size_t j = 0; j < buf.size(); j++)
+        {
+            auto colF = buf[j];
+            if (std::isnan(colF) || colF < 0)
+                continue;
+            if ((size_t)colF >= GetNumCols())
+                LogicError("DoScatterColumnsOf: Index value out of bounds.");
+            targetSources.push_back(make_pair((int)colF, (int)j));
+        }
+        sort(targetSources.begin(), targetSources.end());
+        auto collision = adjacent_find(targetSources.begin(), targetSources.end(), [](const pair<int, int>& x, const pair<int, int>& y) { return x.first == y.first; });
+        if (collision != targetSources.end())
+        {
+            vector<int> targets, sourceBegins, sources;
+            for (const auto& targetSource : targetSources)
+            {
+                if (targets.empty() || targets.back() != targetSource.first)
+                {
+                    targets.push_back(targetSource.first);
+                    sourceBegins.push_back((int)sources.size());
+                }
+                sources.push_back(targetSource.second);
+            }
+            sourceBegins.push_back((int)sources.size());
+
+            MultiTensorDeviceBuffer deviceBuffer(GetComputeDeviceId(), { sizeof(int) * targets.size(), sizeof(int) * sourceBegins.size(), sizeof(int) * sources.size() });
+            CUDA_LONG NN = (CUDA_LONG)(a.GetNumRows() * targets.size());
+            SyncGuard syncGuard;
+            GridDim grid(NN);
+            _doScatterColumnsOfInOrder<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), GetNumRows(),
+                deviceBuffer.Upload(0, targets), deviceBuffer.Upload(1, sourceBegins), deviceBuffer.Upload(2, sources), a.Data(), a.GetNumRows(), alpha, NN);
+            return *this;
+        }
+    }
+
     // launch the kernel
     CUDA_LONG NN = (CUDA_LONG)(a.GetNumElements()); // linear space identifying each individual input element
     SyncGuard syncGuard;
@@ -1162,6 +1473,50 @@ void GPUMatrix<ElemType>::SetValue(const GPUMatrix<ElemType>& deepCopyFrom)
     SetValue(deepCopyFrom.GetNumRows(), deepCopyFrom.GetNumCols(), deepCopyFrom.GetComputeDeviceId(), deepCopyFrom.Data(), matrixFlagSetValueOnDevice);
 }
 
+// copy the values of a matrix on another GPU into this one, which stays on its own device
+// The copy goes directly over NVLink/PCIe if the devices have peer access, and is ordered after the pending work on both devices.
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignPeerCopyOf(const GPUMatrix<ElemType>& a)
+{
+    if (this == &a)
+        return;
+    if (a.GetComputeDeviceId() == GetComputeDeviceId())
+        LogicError("AssignPeerCopyOf: Both matrices are on device %d, use SetValue() instead.", (int) GetComputeDeviceId());
+
+    RequireSize(a.GetNumRows(), a.GetNumCols());
+    if (IsEmpty())
+        return;
+
+    // let the copy wait for the work on the source device that computes 'a'
+    cudaEvent_t sourceReady;
+    a.PrepareDevice();
+    CUDA_CALL(cudaEventCreateWithFlags(&sourceReady, cudaEventDisableTiming));
+    CUDA_CALL(cudaEventRecord(sourceReady, t_stream));
+
+    PrepareDevice();
+    int canAccessPeer = false;
+    CUDA_CALL(cudaDeviceCanAccessPeer(&canAccessPeer, GetComputeDeviceId(), a.GetComputeDeviceId()));
+    if (canAccessPeer)
+    {
+        cudaError_t cudaStatus = cudaDeviceEnablePeerAccess(a.GetComputeDeviceId(), 0);
+        if (cudaStatus == cudaErrorPeerAccessAlreadyEnabled)
+            cudaGetLastError(); // (clear the error)
+        else
+            CUDA_CALL(cudaStatus);
+    }
+    CUDA_CALL(cudaStreamWaitEvent(t_stream, sourceReady, 0 /*flags 'must be 0'*/));
+    CUDA_CALL(cudaMemcpyPeerAsync(Data(), GetComputeDeviceId(), a.Data(), a.GetComputeDeviceId(), sizeof(ElemType) * GetNumElements(), t_stream));
+    CUDA_CALL(cudaEventDestroy(sourceReady)); // (released once the event has completed)
+
+    // and the work on the source device that comes next (which may overwrite 'a', e.g. the next micro-batch of a pipeline) for the copy
+    cudaEvent_t copyDone;
+    CUDA_CALL(cudaEventCreateWithFlags(&copyDone, cudaEventDisableTiming));
+    CUDA_CALL(cudaEventRecord(copyDone, t_stream));
+    a.PrepareDevice();
+    CUDA_CALL(cudaStreamWaitEvent(t_stream, copyDone, 0 /*flags 'must be 0'*/));
+    CUDA_CALL(cudaEventDestroy(copyDone));
+}
+
 #if 0
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const CPUMatrix<ElemType>& /*deepCopyFrom*/)
@@ -1191,7 +1546,7 @@ void GPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, i
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
         // free the existing array if it used to be an owned array
-        if ( Buffer() != NULL)
+        if (Buffer() != NULL && OwnBuffer())
         {
             TracingGPUMemoryAllocator::Free<ElemType>(GetComputeDeviceId(), Buffer());
         }
@@ -1346,6 +1701,90 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
     _setMaskAndScale<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), N, maskRate, scaleValue);
 }
 
+// one kernel that generates the mask and applies it, instead of SetUniformRandomMask() and an element-wise product
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::Dropout(const ElemType beta, const GPUMatrix<ElemType>& a, const ElemType dropoutRate, const uint64_t seed, const uint64_t offset, GPUMatrix<ElemType>& c)
+{
+    assert(a.GetNumElements() == c.GetNumElements());
+    c.PrepareDevice();
+    CUDA_LONG N = (CUDA_LONG) a.GetNumElements();
+    int blocksPerGrid = (int) ceil(N / (double) GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _dropout<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(beta, a.Data(), c.Data(), N, dropoutRate, 1 / (1 - dropoutRate), seed, offset);
+}
+
+// Unlike SetUniformRandomValue(), no cuRAND state: element i only depends on (seed, i), and has the bits of CPUMatrix::SetCounterBasedUniformRandomValue().
+// The index is 64 bits, so that tables of more than 2^31 elements are initialized in place.
+template <class ElemType>
+void GPUMatrix<ElemType>::SetCounterBasedUniformRandomValue(const ElemType low, const ElemType high, const uint64_t seed)
+{
+    PrepareDevice();
+    size_t N = GetNumElements();
+    GridDim grid((CUDA_LONG) min(N, (size_t) INT_MAX)); // the kernel strides over larger matrices
+    SyncGuard syncGuard;
+    _setCounterBasedUniformRandomValue<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), N, low, high, seed);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::SetCounterBasedGaussianRandomValue(const ElemType mean, const ElemType sigma, const uint64_t seed)
+{
+    PrepareDevice();
+    size_t N = GetNumElements();
+    GridDim grid((CUDA_LONG) min(N, (size_t) INT_MAX)); // the kernel strides over larger matrices
+    SyncGuard syncGuard;
+    _setCounterBasedGaussianRandomValue<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), N, mean, sigma, seed);
+}
+
+// Weighted sampling on the device, see Matrix::AssignWeightedRandomSamples(). The prefix sums take a single block, which
+// scans a chunk of 1024 classes at a time; each sample is then a binary search of its own.
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignWeightedRandomSamplesWithReplacement(const GPUMatrix<ElemType>& weights, size_t numSamples, const uint64_t seed, const uint64_t offset, GPUMatrix<ElemType>& prefixSums)
+{
+    size_t numClasses = weights.GetNumElements();
+    prefixSums.RequireSize(numClasses, 1);
+    RequireSize(numSamples, 1);
+    if (numSamples == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignWeightedSamplePrefixSums<1024><<<1, 1024, 0, t_stream>>>(weights.Data(), prefixSums.Data(), numClasses);
+    GridDim grid((CUDA_LONG) numSamples);
+    _assignWeightedRandomSamplesWithReplacement<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), prefixSums.Data(), numClasses, (CUDA_LONG) numSamples, seed, offset);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignWeightedSampleKeys(const GPUMatrix<ElemType>& weights, const uint64_t seed, const uint64_t offset)
+{
+    CUDA_LONG numClasses = (CUDA_LONG) weights.GetNumElements();
+    RequireSize(numClasses, 1);
+    if (numClasses == 0)
+        return *this;
+
+    PrepareDevice();
+    GridDim grid(numClasses);
+    SyncGuard syncGuard;
+    _assignWeightedSampleKeys<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), weights.Data(), numClasses, seed, offset);
+    return *this;
+}
+
+// The frequencies only change with the weights, so a single block does it all, rather than reducing the total and the
+// number of tries with kernels of their own.
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignWeightedSampleInclusionFrequencies(const GPUMatrix<ElemType>& weights, size_t numSamples, bool allowDuplicates, const GPUMatrix<ElemType>& samples)
+{
+    size_t numClasses = weights.GetNumElements();
+    RequireSize(numClasses, 1);
+    if (numClasses == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignWeightedSampleInclusionFrequencies<1024><<<1, 1024, 0, t_stream>>>(Data(), weights.Data(), numClasses, numSamples, allowDuplicates, samples.Data(), samples.GetNumCols());
+    return *this;
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1412,6 +1851,32 @@ void GPUMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& gradients,
                                                                          learnRatePerSample, momentum, adaWeight, adaMul);
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients,
+                               GPUMatrix<ElemType>& functionValues,
+                               ElemType learnRatePerSample,
+                               ElemType momentum,
+                               ElemType adaWeight,
+                               ElemType biasCorrection,
+                               ElemType epsilon,
+                               ElemType decay)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        RequireSize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+
+    size_t n = gradients.GetNumElements();
+    int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    _adam<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(n, gradients.Data(), Data(), Data() + n, functionValues.Data(),
+                                                                    learnRatePerSample, momentum, adaWeight, biasCorrection, epsilon, decay);
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients,
                                       ElemType RMS_GAMMA,
@@ -1493,6 +1958,60 @@ ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients,
     }
 }
 
+// elements per chunk of a multi-tensor operation, processed by one thread block
+static const size_t c_multiTensorChunkSize = 16384;
+
+// see CPUMatrix::MultiTensorUpdate(); one kernel launch for all tensors, and one more for AdaGrad, RmsProp, and Lamb
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiTensorUpdate(DEVICEID_TYPE deviceId, std::vector<MultiTensorUpdateItem<ElemType>>& items, const MultiTensorUpdateParams<ElemType>& params)
+{
+    std::vector<size_t> sizes;
+    for (const auto& item : items)
+        sizes.push_back(item.n);
+    auto chunks = GetMultiTensorChunks(sizes, c_multiTensorChunkSize);
+    if (chunks.empty())
+        return;
+
+    Microsoft::MSR::CNTK::PrepareDevice(deviceId);
+    MultiTensorDeviceBuffer buffer(deviceId, { sizeof(items[0]) * items.size(), sizeof(chunks[0]) * chunks.size(), sizeof(double) * chunks.size(), sizeof(ElemType) * items.size() });
+    auto* d_items = buffer.Upload(0, items);
+    auto* d_chunks = buffer.Upload(1, chunks);
+    auto* d_chunkSums = buffer.Get<double>(2);
+
+    SyncGuard syncGuard;
+    _multiTensorUpdate<ElemType><<<(unsigned int) chunks.size(), MULTI_TENSOR_THREADS_PER_BLOCK>>>(params, d_items, d_chunks, d_chunkSums);
+    if (!MultiTensorUpdateHasSecondPass(params.rule))
+        return;
+
+    std::vector<double> chunkSums(chunks.size());
+    CUDA_CALL(cudaMemcpy(chunkSums.data(), d_chunkSums, sizeof(double) * chunks.size(), cudaMemcpyDeviceToHost));
+    auto* d_learnRates = buffer.Upload(3, GetMultiTensorLearnRates(items, params, chunks, chunkSums));
+    _multiTensorApply<ElemType><<<(unsigned int) chunks.size(), MULTI_TENSOR_THREADS_PER_BLOCK>>>(d_items, d_learnRates, d_chunks);
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiTensorSumOfSquares(DEVICEID_TYPE deviceId, const std::vector<const ElemType*>& data, const std::vector<size_t>& sizes, std::vector<double>& sumsOfSquares)
+{
+    sumsOfSquares.assign(data.size(), 0);
+    auto chunks = GetMultiTensorChunks(sizes, c_multiTensorChunkSize);
+    if (chunks.empty())
+        return;
+
+    Microsoft::MSR::CNTK::PrepareDevice(deviceId);
+    MultiTensorDeviceBuffer buffer(deviceId, { sizeof(data[0]) * data.size(), sizeof(chunks[0]) * chunks.size(), sizeof(double) * chunks.size() });
+    auto* d_data = buffer.Upload(0, data);
+    auto* d_chunks = buffer.Upload(1, chunks);
+    auto* d_chunkSums = buffer.Get<double>(2);
+
+    SyncGuard syncGuard;
+    _multiTensorSumOfSquares<ElemType><<<(unsigned int) chunks.size(), MULTI_TENSOR_THREADS_PER_BLOCK>>>(d_data, d_chunks, d_chunkSums);
+
+    std::vector<double> chunkSums(chunks.size());
+    CUDA_CALL(cudaMemcpy(chunkSums.data(), d_chunkSums, sizeof(double) * chunks.size(), cudaMemcpyDeviceToHost));
+    for (size_t c = 0; c < chunks.size(); c++)
+        sumsOfSquares[chunks[c].item] += chunkSums[c];
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1517,12 +2036,13 @@ void GPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, boo
     if (GetNumRows() == numRows && GetNumCols() == numCols)
         return;
 
-    VerifyResizable(__FUNCTION__);
+    size_t numElements = numRows * numCols;
+    VerifyResizable(__FUNCTION__, numElements);
     bool isForceResize = (!growOnly) || cachedResize;
 
-    size_t numElements = numRows * numCols;
-    if (numElements > GetSizeAllocated() ||                     // grow allocation
-        (isForceResize && numElements != GetSizeAllocated()))   // shrink allocation if not growOnly
+    if (OwnBuffer() &&                                              // (an external buffer is only reshaped, see VerifyResizable())
+        (numElements > GetSizeAllocated() ||                        // grow allocation
+         (isForceResize && numElements != GetSizeAllocated())))     // shrink allocation if not growOnly
     {
         // reallocate buffer if numElements > 0
         ElemType* pArray = nullptr;
@@ -1950,97 +2470,453 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSigmoidOf(const GPUMatrix<ElemTy
     return *this;
 }
 
-DEF_ELEMWISE_INPLACE_FUNC(SigmoidDerivative)
-DEF_ELEMWISE_ASSIGN_FUNC(SigmoidDerivative)
-
+DEF_ELEMWISE_INPLACE_FUNC(SigmoidDerivative)
+DEF_ELEMWISE_ASSIGN_FUNC(SigmoidDerivative)
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const GPUMatrix<ElemType>& a,
+                                                           const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& bias, size_t sampleCount, GPUMatrix<ElemType>& tmp, GPUMatrix<ElemType>& c)
+//this:   samples+probs
+// a  :   hidden
+// b  :   embedding
+// tmp:   softmax
+// c  :   loglikelihood
+{
+    UNCONST(ElemType, a, my_a);
+    UNCONST(ElemType, b, my_b);
+    UNCONST(ElemType, bias, my_bias);
+    SyncGuard syncGuard;
+    // a: dim * minibatch
+    // b: dim * |vocab|
+    int p = 512;
+    int width = a.GetNumRows(); // dimension of hidden vector
+
+    while (p / 2 > width)
+        p = p / 2;
+
+    // note: kernel has hard-coded dimension of 512
+    _computeNceOutputMax512Threads<ElemType> << <GetNumElements() / 2, p >> >(
+        Data(),
+        sampleCount,
+        m_numRows / 2,
+        my_a.Data(), // a
+        a.GetNumRows(),
+        my_b.Data(), // b
+        my_bias.Data(),
+        tmp.Data()); // tmp
+
+    p = 512;
+    while (p / 2 > GetNumElements() / 2)
+        p = p / 2;
+    // summing up objective must be done in one block
+    // note: kernel has hard-coded dimension of 512
+    _assignNoiseContrastiveEstimationMax512Threads<ElemType> << <1, p >> >(
+        Data(),
+        sampleCount,
+        m_numRows / 2,
+        my_a.Data(),
+        a.GetNumCols(),
+        my_b.Data(),
+        tmp.Data(),
+        c.Data());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignNCEDerivative(GPUMatrix<ElemType>& tmp, const GPUMatrix<ElemType>& a,
+                                              const GPUMatrix<ElemType>& b, size_t inputIndex, GPUMatrix<ElemType>& c)
+{
+    UNCONST(ElemType, a, my_a);
+    UNCONST(ElemType, b, my_b);
+    SyncGuard syncGuard;
+    int p = 512;
+    int width = a.GetNumRows();
+    while (p / 2 > width)
+        p = p / 2;
+
+    _assignNceDerivativeNew<ElemType><<<(tmp.GetNumElements() + p - 1) / p, p>>>(
+        Data(),
+        tmp.GetNumCols(),
+        m_numRows / 2,
+        my_a.Data(),
+        a.GetNumRows(),
+        my_b.Data(),
+        tmp.Data(),
+        c.Data(),
+        inputIndex);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& c)
+{
+    UNCONST(ElemType, a, my_a);
+    SyncGuard syncGuard;
+    int p = 512;
+    int width = a.GetNumRows();
+    while (p / 2 > width)
+        p = p / 2;
+
+    // note: kernel has hard-coded dimension of 512
+    _assignSoftmaxSumMax512Threads<ElemType> << <1, p >> >(
+        my_a.Data(),
+        width,
+        Data(),
+        c.Data());
+}
+
+// The workspace is usually filled by an asynchronous copy of the reader, both kernels run on the
+// compute stream, so the caller has to make sure the copy has finished (or is ordered before t_stream).
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignAugmentedImages(GPUMatrix<ElemType>& workspace, size_t numImages, const ImageAugmentationParameters& parameters, uint64_t seed)
+{
+    const ImageAugmentationWorkspaceLayout layout = GetImageAugmentationWorkspaceLayout(parameters, numImages);
+    const size_t imageSize = parameters.GetImageSize();
+    const size_t numPixels = (size_t)parameters.m_width * parameters.m_height;
+    RequireSize(imageSize, numImages);
+    if (numImages == 0)
+        return *this;
+
+    char* base = reinterpret_cast<char*>(workspace.Data());
+    auto samples = reinterpret_cast<ImageAugmentationSample*>(base + layout.m_samplesOffset);
+    auto images = reinterpret_cast<const uint8_t*>(base + layout.m_imagesOffset);
+    auto mean = parameters.m_subtractMean ? reinterpret_cast<const float*>(base + layout.m_meanOffset) : nullptr;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _computeImageAugmentationSamples<<<(unsigned int)numImages, GridDim::maxThreadsPerBlock, 0, t_stream>>>(images, samples, parameters, seed, (CUDA_LONG)imageSize);
+
+    dim3 grid((unsigned int)((numPixels + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock), (unsigned int)numImages);
+    _augmentImages<ElemType><<<grid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(images, samples, mean, parameters, (CUDA_LONG)numPixels, Data());
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignWidenedValuesOf(const GPUMatrix<ElemType>& packed, NarrowElementType type, size_t numRows, size_t numCols, ElemType scale, ElemType shift)
+{
+    RequireSize(numRows, numCols);
+    CUDA_LONG N = (CUDA_LONG)GetNumElements();
+    if (N == 0)
+        return *this;
+
+    int blocksPerGrid = (int)ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    SyncGuard syncGuard;
+    if (type == NarrowElementType::uint8)
+        _assignWidenedValues<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(reinterpret_cast<const uint8_t*>(packed.Data()), Data(), N, scale, shift);
+    else
+        _assignWidenedValues<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(reinterpret_cast<const float16*>(packed.Data()), Data(), N, scale, shift);
+    return *this;
+}
+
+// One thread per url, each scanning its query (see LearningToRank.h); nothing is copied to the host.
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignRanksWithinQueries(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& queryIds)
+{
+    CUDA_LONG N = (CUDA_LONG)gains.GetNumElements();
+    RequireSize(1, N);
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _assignRanksWithinQueries<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), scores.Data(), gains.Data(), queryIds.Data(), N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNDCGContributions(const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& ranks, const GPUMatrix<ElemType>& queryIds, bool atOne, GPUMatrix<ElemType>& queryStarts)
+{
+    CUDA_LONG N = (CUDA_LONG)gains.GetNumElements();
+    RequireSize(1, N);
+    queryStarts.RequireSize(1, N);
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _assignNDCGContributions<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), queryStarts.Data(), gains.Data(), ranks.Data(), queryIds.Data(), atOne, N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddLambdaRankGradient(const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& ranks, const GPUMatrix<ElemType>& queryIds, ElemType sigma)
+{
+    CUDA_LONG N = (CUDA_LONG)gains.GetNumElements();
+    if (GetNumElements() != N)
+        LogicError("AddLambdaRankGradient: the gradient has %d elements, but there are %d urls.", (int)GetNumElements(), (int)N);
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _addLambdaRankGradient<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), gains.Data(), scores.Data(), ranks.Data(), queryIds.Data(), sigma, N);
+    return *this;
+}
+
+// The CRF recursions launch a kernel per time step, with a thread per sequence and label (see LinearChainCRF.h).
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFForwardScores(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    int numLabels = (int)scores.GetNumRows();
+    int numSteps = (int)(scores.GetNumCols() / stride);
+    CUDA_LONG N = (CUDA_LONG)(sequences.GetNumCols() * numLabels);
+    RequireSize(numLabels, scores.GetNumCols());
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    for (int t = 0; t < numSteps; t++)
+        _crfForwardStep<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), scores.Data(), transitions.Data(), labelIndices.Data(), sequences.Data(), numLabels, (int)stride, t, N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFLogPosteriors(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    int numLabels = (int)scores.GetNumRows();
+    int numSteps = (int)(scores.GetNumCols() / stride);
+    CUDA_LONG N = (CUDA_LONG)(sequences.GetNumCols() * numLabels);
+    RequireSize(numLabels, scores.GetNumCols());
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    for (int t = numSteps - 1; t >= 0; t--)
+        _crfBackwardStep<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), alpha.Data(), scores.Data(), transitions.Data(), sequences.Data(), numLabels, (int)stride, t, N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFNegativeLogLikelihoods(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    CUDA_LONG N = (CUDA_LONG)sequences.GetNumCols();
+    RequireSize(1, N);
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _assignCRFNegativeLogLikelihoods<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), alpha.Data(), scores.Data(), transitions.Data(), labelIndices.Data(), sequences.Data(), (int)scores.GetNumRows(), (int)stride, N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFTransitionGradient(const GPUMatrix<ElemType>& logPosteriors, const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions,
+                                                                      const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    int numLabels = (int)scores.GetNumRows();
+    CUDA_LONG N = (CUDA_LONG)numLabels * numLabels;
+    RequireSize(numLabels, numLabels);
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _assignCRFTransitionGradient<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), logPosteriors.Data(), alpha.Data(), scores.Data(), transitions.Data(), labelIndices.Data(), sequences.Data(),
+                                                                                                        (int)sequences.GetNumCols(), numLabels, (int)stride, N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFViterbiPath(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride,
+                                                               GPUMatrix<ElemType>& viterbiScores, GPUMatrix<ElemType>& backPointers)
+{
+    int numLabels = (int)scores.GetNumRows();
+    int numSteps = (int)(scores.GetNumCols() / stride);
+    CUDA_LONG numSequences = (CUDA_LONG)sequences.GetNumCols();
+    CUDA_LONG N = numSequences * numLabels;
+    viterbiScores.RequireSize(numLabels, scores.GetNumCols());
+    backPointers.RequireSize(numLabels, scores.GetNumCols());
+    RequireSize(numLabels, scores.GetNumCols());
+    SetValue(0);
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    for (int t = 0; t < numSteps; t++)
+        _crfViterbiStep<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(viterbiScores.Data(), backPointers.Data(), scores.Data(), transitions.Data(), labelIndices.Data(), sequences.Data(), numLabels, (int)stride, t, N);
+    GridDim sequenceGrid(numSequences);
+    _crfViterbiBacktrace<ElemType><<<sequenceGrid.m_blocksPerGrid, sequenceGrid.m_threadsPerBlock, 0, t_stream>>>(Data(), viterbiScores.Data(), backPointers.Data(), sequences.Data(), numLabels, (int)stride, numSequences);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNonZeroCountsOfSequences(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    CUDA_LONG numSequences = (CUDA_LONG)sequences.GetNumCols();
+    RequireSize(1, numSequences);
+    if (numSequences == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignNonZeroCountsOfSequences<256, ElemType><<<numSequences, 256, 0, t_stream>>>(Data(), a.Data(), sequences.Data(), (int)stride);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNonZeroPositionsOfSequences(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sequences, size_t stride, const GPUMatrix<ElemType>& outputSequences, size_t outputStride)
+{
+    CUDA_LONG numSequences = (CUDA_LONG)sequences.GetNumCols();
+    if (numSequences == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignNonZeroPositionsOfSequences<256, ElemType><<<numSequences, 256, 0, t_stream>>>(Data(), a.Data(), sequences.Data(), (int)stride, outputSequences.Data(), (int)outputStride);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignColumnsOfSequencePositions(const GPUMatrix<ElemType>& positions, const GPUMatrix<ElemType>& sequences, size_t stride, const GPUMatrix<ElemType>& targetSequences, size_t targetStride)
+{
+    int maxNumFrames = (int)(positions.GetNumCols() / stride);
+    CUDA_LONG N = (CUDA_LONG)sequences.GetNumCols() * maxNumFrames;
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _assignColumnsOfSequencePositions<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), positions.Data(), sequences.Data(), (int)stride, targetSequences.Data(), (int)targetStride, maxNumFrames, N);
+    return *this;
+}
+
+// The GMM launches a thread per output element; the gradient of a shared parameter sums over the samples
+// in its own thread, which needs no atomics (see GaussianMixture.h).
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignGMMLogLikelihoods(const GPUMatrix<ElemType>& unnormedPrior, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, GPUMatrix<ElemType>& posteriors)
+{
+    int numComponents = (int)unnormedPrior.GetNumRows();
+    CUDA_LONG N = (CUDA_LONG)features.GetNumCols();
+    posteriors.RequireSize(numComponents, N);
+    RequireSize(1, N);
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _assignGMMLogLikelihoods<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), posteriors.Data(), unnormedPrior.Data(), unnormedPrior.GetNumCols(), means.Data(), means.GetNumCols(),
+                                                                                                    logStddevs.Data(), logStddevs.GetNumCols(), features.Data(), numComponents, (int)features.GetNumRows(), N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMUnnormedPriorGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& unnormedPrior, const GPUMatrix<ElemType>& posteriors)
+{
+    CUDA_LONG N = (CUDA_LONG)GetNumElements();
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _addGMMUnnormedPriorGradient<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), gradient.Data(), unnormedPrior.Data(), unnormedPrior.GetNumCols(), posteriors.Data(),
+                                                                                                        (int)unnormedPrior.GetNumRows(), posteriors.GetNumCols(), N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMMeanGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors)
+{
+    CUDA_LONG N = (CUDA_LONG)GetNumElements();
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _addGMMMeanGradient<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), gradient.Data(), means.Data(), means.GetNumCols(), logStddevs.Data(), logStddevs.GetNumCols(), features.Data(),
+                                                                                               posteriors.Data(), (int)posteriors.GetNumRows(), (int)features.GetNumRows(), posteriors.GetNumCols(), N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMLogStddevGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors)
+{
+    CUDA_LONG N = (CUDA_LONG)GetNumElements();
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _addGMMLogStddevGradient<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), gradient.Data(), means.Data(), means.GetNumCols(), logStddevs.Data(), logStddevs.GetNumCols(), features.Data(),
+                                                                                                    posteriors.Data(), (int)posteriors.GetNumRows(), (int)features.GetNumRows(), posteriors.GetNumCols(), N);
+    return *this;
+}
+
 template <class ElemType>
-void GPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const GPUMatrix<ElemType>& a,
-                                                           const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& bias, size_t sampleCount, GPUMatrix<ElemType>& tmp, GPUMatrix<ElemType>& c)
-//this:   samples+probs
-// a  :   hidden
-// b  :   embedding
-// tmp:   softmax
-// c  :   loglikelihood
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMFeatureGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors)
 {
-    UNCONST(ElemType, a, my_a);
-    UNCONST(ElemType, b, my_b);
-    UNCONST(ElemType, bias, my_bias);
-    SyncGuard syncGuard;
-    // a: dim * minibatch
-    // b: dim * |vocab|
-    int p = 512;
-    int width = a.GetNumRows(); // dimension of hidden vector
+    CUDA_LONG N = (CUDA_LONG)GetNumElements();
+    if (N == 0)
+        return *this;
 
-    while (p / 2 > width)
-        p = p / 2;
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _addGMMFeatureGradient<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), gradient.Data(), means.Data(), means.GetNumCols(), logStddevs.Data(), logStddevs.GetNumCols(), features.Data(),
+                                                                                                  posteriors.Data(), (int)posteriors.GetNumRows(), (int)features.GetNumRows(), N);
+    return *this;
+}
 
-    // note: kernel has hard-coded dimension of 512
-    _computeNceOutputMax512Threads<ElemType> << <GetNumElements() / 2, p >> >(
-        Data(),
-        sampleCount,
-        m_numRows / 2,
-        my_a.Data(), // a
-        a.GetNumRows(),
-        my_b.Data(), // b
-        my_bias.Data(),
-        tmp.Data()); // tmp
+// Cosine similarity with negative samples: a thread per query, or per column of the normalized inputs (see CosineWithNegativeSamples.h).
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSimilaritiesWithNegativeSamples(const GPUMatrix<ElemType>& similarities, size_t shift, size_t numNegatives, bool inBatchNegatives, GPUMatrix<ElemType>& documents)
+{
+    CUDA_LONG N = (CUDA_LONG)similarities.GetNumCols();
+    RequireSize(numNegatives + 1, N);
+    documents.RequireSize(numNegatives + 1, N);
+    if (N == 0)
+        return *this;
 
-    p = 512;
-    while (p / 2 > GetNumElements() / 2)
-        p = p / 2;
-    // summing up objective must be done in one block
-    // note: kernel has hard-coded dimension of 512
-    _assignNoiseContrastiveEstimationMax512Threads<ElemType> << <1, p >> >(
-        Data(),
-        sampleCount,
-        m_numRows / 2,
-        my_a.Data(),
-        a.GetNumCols(),
-        my_b.Data(),
-        tmp.Data(),
-        c.Data());
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _assignSimilaritiesWithNegativeSamples<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), documents.Data(), similarities.Data(), (int)shift, (int)numNegatives, inBatchNegatives, N);
+    return *this;
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::AssignNCEDerivative(GPUMatrix<ElemType>& tmp, const GPUMatrix<ElemType>& a,
-                                              const GPUMatrix<ElemType>& b, size_t inputIndex, GPUMatrix<ElemType>& c)
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNegativeSamplesGradientMatrix(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& documents)
 {
-    UNCONST(ElemType, a, my_a);
-    UNCONST(ElemType, b, my_b);
-    SyncGuard syncGuard;
-    int p = 512;
-    int width = a.GetNumRows();
-    while (p / 2 > width)
-        p = p / 2;
+    CUDA_LONG N = (CUDA_LONG)documents.GetNumCols();
+    RequireSize(N, N);
+    SetValue(0);
+    if (N == 0)
+        return *this;
 
-    _assignNceDerivativeNew<ElemType><<<(tmp.GetNumElements() + p - 1) / p, p>>>(
-        Data(),
-        tmp.GetNumCols(),
-        m_numRows / 2,
-        my_a.Data(),
-        a.GetNumRows(),
-        my_b.Data(),
-        tmp.Data(),
-        c.Data(),
-        inputIndex);
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _addNegativeSamplesGradientMatrix<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), gradient.Data(), documents.Data(), (int)documents.GetNumRows(), N);
+    return *this;
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& c)
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddColumnNormalizationGradient(const GPUMatrix<ElemType>& gradientOfNormalized, const GPUMatrix<ElemType>& normalized, const GPUMatrix<ElemType>& invNorms)
 {
-    UNCONST(ElemType, a, my_a);
-    SyncGuard syncGuard;
-    int p = 512;
-    int width = a.GetNumRows();
-    while (p / 2 > width)
-        p = p / 2;
+    CUDA_LONG N = (CUDA_LONG)GetNumCols();
+    if (N == 0)
+        return *this;
 
-    // note: kernel has hard-coded dimension of 512
-    _assignSoftmaxSumMax512Threads<ElemType> << <1, p >> >(
-        my_a.Data(),
-        width,
-        Data(),
-        c.Data());
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _addColumnNormalizationGradient<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), gradientOfNormalized.Data(), normalized.Data(), invNorms.Data(), (int)GetNumRows(), N);
+    return *this;
 }
 
 template <class ElemType>
@@ -2123,6 +2999,42 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLogSoftmaxOf(const GPUMatrix<Ele
     return *this;
 }
 
+// Columns of more than this many rows are split across several blocks, so that large vocabularies keep the GPU
+// busy also for few columns; the partials of the chunks are then merged by a second kernel.
+static const CUDA_LONG softmaxCrossEntropyChunkRows = 16 * 1024;
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSoftmaxCrossEntropyOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp)
+{
+    if (logits.IsEmpty())
+        LogicError("AssignSoftmaxCrossEntropyOf: Matrix logits is empty.");
+    if (labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols())
+        InvalidArgument("AssignSoftmaxCrossEntropyOf: labels and logits must have the same dimensions.");
+
+    const CUDA_LONG M = (CUDA_LONG) logits.GetNumRows();
+    const CUDA_LONG N = (CUDA_LONG) logits.GetNumCols();
+    RequireSize(1, N);
+    logSumExp.RequireSize(1, N);
+
+    PrepareDevice();
+    const CUDA_LONG numChunks = (M + softmaxCrossEntropyChunkRows - 1) / softmaxCrossEntropyChunkRows;
+    SyncGuard syncGuard;
+    // note: kernel uses hard-coded thread dimension
+    if (numChunks == 1)
+    {
+        _softmaxCrossEntropyOf512Threads<ElemType><<<dim3(N, 1), 512, 0, t_stream>>>(labels.Data(), logits.Data(), nullptr, logSumExp.Data(), Data(), M, N, M);
+    }
+    else
+    {
+        GPUMatrix<ElemType> partials(4 * numChunks, N, GetComputeDeviceId());
+        _softmaxCrossEntropyOf512Threads<ElemType><<<dim3(N, numChunks), 512, 0, t_stream>>>(labels.Data(), logits.Data(), partials.Data(), logSumExp.Data(), Data(), M, N, softmaxCrossEntropyChunkRows);
+        int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+        _combineSoftmaxCrossEntropyPartials<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(partials.Data(), logSumExp.Data(), Data(), N, numChunks);
+    }
+
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceHardmax(const bool isColWise)
 {
@@ -2261,6 +3173,17 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::SetToZeroIfAbsLessThan(const ElemType
     return *this;
 }
 
+// The flag is only ever written with 1, so the threads need neither atomics nor a reduction, and nothing is synchronized.
+template <class ElemType>
+void GPUMatrix<ElemType>::FlagNonFiniteValues(GPUMatrix<ElemType>& flag) const
+{
+    PrepareDevice();
+    size_t N = GetNumElements();
+    GridDim grid((CUDA_LONG) min(N, (size_t) INT_MAX));
+    SyncGuard syncGuard;
+    _flagNonFiniteValues<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), N, flag.Data());
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::SumOfAbsElements() const
 {
@@ -2767,6 +3690,9 @@ __global__ void _initIndicesForSort(uint64_t* indexes, CUDA_LONG crow, CUDA_LONG
     indexes[id] = (static_cast<uint64_t>(irow) << 32) | icol;
 }
 
+// up to this topK, VectorMax() selects the top-k of each column in topK passes instead of sorting the matrix
+static const int c_maxTopKWithoutSort = 64;
+
 template <class ElemType>
 void GPUMatrix<ElemType>::VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<ElemType>& maxValues, const bool isColWise, int topK) const
 {
@@ -2793,6 +3719,13 @@ void GPUMatrix<ElemType>::VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<E
     maxValues.RequireSize(topK, n);
     maxIndexes.RequireSize(topK, n);
 
+    // A small topK, as for the top-k outputs of evaluation, is selected per column, which is cheaper than sorting the whole matrix.
+    if (topK <= c_maxTopKWithoutSort)
+    {
+        _vectorMaxTopKOfColumns<256><<<n, 256, 0, t_stream>>>(us.Data(), maxIndexes.Data(), maxValues.Data(), m, topK);
+        return;
+    }
+
     // To sort matrix columns we use 2-pass _stable_ sort algorithm:
     // 1. Sort by values (descending) with corresponding row/col indexes.
     // 2. Sort by col indices (ascending) with corresponding values/row indices.
@@ -3152,6 +4085,13 @@ void GPUMatrix<ElemType>::MaxPoolingBackward(const GPUMatrix<ElemType>& out, con
                                                             Data(), (int)GetNumRows(), grad.Data(), (int)grad.GetNumRows());
 }
 
+// The ROI kernels run a row of blocks per ROI (strided over the grid rows), each with a
+// block-wide view of the ROI staged in shared memory, and a thread per output location of the ROI.
+static dim3 ROIGridDim(size_t totalRois, size_t roiOutputSize, int blockSize)
+{
+    return dim3((int)((roiOutputSize + blockSize - 1) / blockSize), (int)std::min(totalRois, (size_t)65535));
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
                                             const size_t pooledWidth, const size_t pooledHeight, const GPUMatrix<ElemType>& roiData, GPUMatrix<ElemType>& output, 
@@ -3160,26 +4100,56 @@ void GPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
     PrepareDevice();
     SyncGuard syncGuard;
 
-    int count = numRois * numImg * channels * pooledHeight * pooledWidth;
     const int blockSize = GridDim::maxThreadsPerBlock;
-    auto numThreads = dim3((int)floor((double)(count + blockSize - 1) / blockSize));
-    kROIPoolingForward<<<numThreads, blockSize, 0, t_stream>>>(count, numRois, numImg, channels, width, height, 
-                                                               pooledWidth, pooledHeight, Data(), roiData.Data(), output.Data(), argmax.Data());
+    auto grid = ROIGridDim(numRois * numImg, channels * pooledHeight * pooledWidth, blockSize);
+    size_t sharedMemSize = 2 * (pooledHeight + pooledWidth) * sizeof(int);
+    kROIPoolingForward<<<grid, blockSize, sharedMemSize, t_stream>>>(numRois * numImg, numRois, channels, width, height,
+                                                                     pooledWidth, pooledHeight, Data(), roiData.Data(), output.Data(), argmax.Data());
 }
 
+// Adds the gradient of the pooled ROIs to 'grad'.
 template <class ElemType>
 void GPUMatrix<ElemType>::ROIPoolingBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
-                                             const size_t pooledWidth, const size_t pooledHeight, const GPUMatrix<ElemType>& roiData, GPUMatrix<ElemType>& grad, 
+                                             const size_t pooledWidth, const size_t pooledHeight, const GPUMatrix<ElemType>& /*roiData*/, GPUMatrix<ElemType>& grad, 
                                              GPUMatrix<ElemType>& argmax) const
 {
     PrepareDevice();
     SyncGuard syncGuard;
 
-    int count = numImg * channels * height * width;
+    int count = numRois * numImg * channels * pooledHeight * pooledWidth;
     const int blockSize = GridDim::maxThreadsPerBlock;
     auto numThreads = dim3((int)floor((double)(count + blockSize - 1) / blockSize));
-    kROIPoolingBackward<<<numThreads, blockSize, 0, t_stream>>>(count, numRois, numImg, channels, width, height, 
-                                                                pooledWidth, pooledHeight, Data(), roiData.Data(), grad.Data(), argmax.Data());
+    kROIPoolingBackward<<<numThreads, blockSize, 0, t_stream>>>(count, numRois, channels, width, height,
+                                                                pooledWidth, pooledHeight, Data(), grad.Data(), argmax.Data());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ROIAlignForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                                          const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const GPUMatrix<ElemType>& roiData,
+                                          GPUMatrix<ElemType>& output) const
+{
+    PrepareDevice();
+    SyncGuard syncGuard;
+
+    const int blockSize = GridDim::maxThreadsPerBlock;
+    auto grid = ROIGridDim(numRois * numImg, channels * pooledHeight * pooledWidth, blockSize);
+    kROIAlignForward<<<grid, blockSize, 0, t_stream>>>(numRois * numImg, numRois, channels, width, height,
+                                                       pooledWidth, pooledHeight, samplingRatio, Data(), roiData.Data(), output.Data());
+}
+
+// Adds the gradient of the pooled ROIs to 'grad'.
+template <class ElemType>
+void GPUMatrix<ElemType>::ROIAlignBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                                           const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const GPUMatrix<ElemType>& roiData,
+                                           GPUMatrix<ElemType>& grad) const
+{
+    PrepareDevice();
+    SyncGuard syncGuard;
+
+    const int blockSize = GridDim::maxThreadsPerBlock;
+    auto grid = ROIGridDim(numRois * numImg, channels * pooledHeight * pooledWidth, blockSize);
+    kROIAlignBackward<<<grid, blockSize, 0, t_stream>>>(numRois * numImg, numRois, channels, width, height,
+                                                        pooledWidth, pooledHeight, samplingRatio, Data(), roiData.Data(), grad.Data());
 }
 
 template <class ElemType>
@@ -3219,7 +4189,7 @@ void GPUMatrix<ElemType>::AveragePoolingBackward(const GPUMatrix<int>& mpRowCol,
 template <class ElemType>
 void GPUMatrix<ElemType>::BatchNormalizationForward(const GPUMatrix<ElemType>& scale, const GPUMatrix<ElemType>& bias, bool inferenceOnly, double expAvgFactor, double blendFactor,
                                                     GPUMatrix<ElemType>& runMean, GPUMatrix<ElemType>& runVariance, GPUMatrix<ElemType>& out, double epsilon,
-                                                    GPUMatrix<ElemType>& savedMean, GPUMatrix<ElemType>& savedInvStdDev) const
+                                                    GPUMatrix<ElemType>& savedMean, GPUMatrix<ElemType>& savedInvStdDev, bool reluOutput) const
 {
     assert((GetNumRows() % scale.GetNumRows()) == 0);
 
@@ -3267,7 +4237,7 @@ void GPUMatrix<ElemType>::BatchNormalizationForward(const GPUMatrix<ElemType>& s
     }
 
     Call<NormalizeBatchTraining, ElemType>(spatial ? spatialSize : vectorSize, vectorSize, spatialSize, batchSize, spatial,
-                                           normalizeRunningStats, epsilon,
+                                           normalizeRunningStats, epsilon, reluOutput,
                                            Data(), out.Data(),
                                            scale.Data(), bias.Data(),
                                            runMean.Data(), runVariance.Data(),
@@ -3282,11 +4252,20 @@ void GPUMatrix<ElemType>::BatchNormalizationBackward(const GPUMatrix<ElemType>&
                                                      const GPUMatrix<ElemType>& savedMean, const GPUMatrix<ElemType>& savedInvStdDev,
                                                      GPUMatrix<ElemType>& scaleGrad, GPUMatrix<ElemType>& biasGrad) const
 {
-    assert((GetNumRows() % scale.GetNumRows()) == 0);
+    BatchNormalizationScaleAndBiasGradients(in, savedMean, savedInvStdDev, scaleGrad, biasGrad);
+    // weight for contribution from actual MB stats (0 if none, e.g. locked BN node)
+    BatchNormalizationInputGradient(in, grad, scale, 1 - blendFactor, savedMean, savedInvStdDev, scaleGrad, biasGrad);
+}
 
-    bool spatial = GetNumRows() != scale.GetNumRows();
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchNormalizationScaleAndBiasGradients(const GPUMatrix<ElemType>& in, const GPUMatrix<ElemType>& savedMean, const GPUMatrix<ElemType>& savedInvStdDev,
+                                                                  GPUMatrix<ElemType>& scaleGrad, GPUMatrix<ElemType>& biasGrad) const
+{
+    assert((GetNumRows() % scaleGrad.GetNumRows()) == 0);
+
+    bool spatial = GetNumRows() != scaleGrad.GetNumRows();
     size_t vectorSize = GetNumRows();
-    size_t spatialSize = spatial ? (GetNumRows() / scale.GetNumRows()) : 1;
+    size_t spatialSize = spatial ? (GetNumRows() / scaleGrad.GetNumRows()) : 1;
     size_t batchSize = GetNumCols();
 
     assert(0 < vectorSize && vectorSize <= std::numeric_limits<int>::max());
@@ -3303,20 +4282,52 @@ void GPUMatrix<ElemType>::BatchNormalizationBackward(const GPUMatrix<ElemType>&
         Call<ComputeScaleAndBiasGradients, ElemType>(vectorSize, vectorSize, batchSize, in.Data(), Data(), scaleGrad.Data(), biasGrad.Data(),
                                                      savedMean.Data(), savedInvStdDev.Data(), GetStream());
     }
-    ElemType mbStatsWeight = (ElemType)(1 - blendFactor); // weight for contribution from actual MB stats (0 if none, e.g. locked BN node)
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchNormalizationInputGradient(const GPUMatrix<ElemType>& in, GPUMatrix<ElemType>& grad, const GPUMatrix<ElemType>& scale, double mbStatsWeight,
+                                                          const GPUMatrix<ElemType>& savedMean, const GPUMatrix<ElemType>& savedInvStdDev,
+                                                          const GPUMatrix<ElemType>& scaleGrad, const GPUMatrix<ElemType>& biasGrad) const
+{
+    assert((GetNumRows() % scale.GetNumRows()) == 0);
+
+    bool spatial = GetNumRows() != scale.GetNumRows();
+    size_t vectorSize = GetNumRows();
+    size_t spatialSize = spatial ? (GetNumRows() / scale.GetNumRows()) : 1;
+    size_t batchSize = GetNumCols();
+
+    assert(0 < vectorSize && vectorSize <= std::numeric_limits<int>::max());
+    assert(0 < batchSize  && batchSize  <= std::numeric_limits<int>::max());
+
+    SyncGuard syncGuard;
     Call<BackpropagateBatchNormGradients, ElemType>(spatial ? spatialSize : vectorSize, vectorSize, spatialSize, batchSize, spatial,
-                                                    in.Data(), Data(), grad.Data(), scale.Data(), mbStatsWeight, scaleGrad.Data(), biasGrad.Data(), savedMean.Data(), savedInvStdDev.Data(), GetStream());
+                                                    in.Data(), Data(), grad.Data(), scale.Data(), (ElemType)mbStatsWeight, scaleGrad.Data(), biasGrad.Data(), savedMean.Data(), savedInvStdDev.Data(), GetStream());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchNormalizationReluBackward(const GPUMatrix<ElemType>& in, const GPUMatrix<ElemType>& scale, const GPUMatrix<ElemType>& bias,
+                                                         const GPUMatrix<ElemType>& savedMean, const GPUMatrix<ElemType>& savedInvStdDev)
+{
+    assert((GetNumRows() % scale.GetNumRows()) == 0);
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    if (N == 0)
+        return;
+    int blocksPerGrid = (int) ceil(N / (double) GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _batchNormalizationReluBackward<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), in.Data(), scale.Data(), bias.Data(), savedMean.Data(), savedInvStdDev.Data(),
+                                                                                                           N, (CUDA_LONG) GetNumRows(), (CUDA_LONG) (GetNumRows() / scale.GetNumRows()));
 }
 
 #pragma region RNN Functions
 
 template <class ElemType>
-void GPUMatrix<ElemType>::RNNForward(const GPUMatrix<ElemType> &inputX, const GPUMatrix<ElemType> &paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace)
+void GPUMatrix<ElemType>::RNNForward(const GPUMatrix<ElemType> &inputX, const GPUMatrix<ElemType> &paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, bool inferenceOnly, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace)
 {
     // numLayers, hiddenSize are input parameters
     if (!m_rnnExecutor)
         m_rnnExecutor = std::make_unique<CuDnnRNNExecutor<ElemType>>(xDim, yDim, rnnAttributes);
-    m_rnnExecutor->ForwardCore(paramW, inputX, *this, numSequencesForFrame, rnnAttributes, reserve, workspace);
+    m_rnnExecutor->ForwardCore(paramW, inputX, *this, numSequencesForFrame, rnnAttributes, inferenceOnly, reserve, workspace);
 }
 
 template <class ElemType>
@@ -3345,6 +4356,19 @@ static cublasStatus_t cublas_gemm(cublasHandle_t handle, cublasOperation_t trans
 {
     return cublasDgemm(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
 }
+#if CUDA_VERSION >= 8000
+// float/double overloads of cublasSgemmStridedBatched()/cublasDgemmStridedBatched()
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha, const float* A, int lda, long long strideA,
+                                                const float* B, int ldb, long long strideB, const float* beta, float* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasSgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha, const double* A, int lda, long long strideA,
+                                                const double* B, int ldb, long long strideB, const double* beta, double* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasDgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+#endif
 static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const float* alpha, const float* x, int incx, float* y, int incy)
 {
     return cublasSaxpy(handle, n, alpha, x, incx, y, incy);
@@ -3354,6 +4378,73 @@ static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const double* al
     return cublasDaxpy(handle, n, alpha, x, incx, y, incy);
 }
 
+#if CUDA_VERSION >= 9000
+__global__ void _convertToHalf(const float* source, __half* destination, CUDA_LONG count)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= count)
+        return;
+
+    destination[id] = __float2half(source[id]);
+}
+
+// Half precision copies of the two inputs of the mixed precision GEMM. The buffers only grow and are kept
+// for the lifetime of the process; like the cuBLAS handles they are used from the compute thread of the device.
+static __half* s_halfGemmBuffers[MAX_GPUS][2];
+static size_t s_halfGemmBufferSizes[MAX_GPUS][2];
+
+static __half* ConvertToHalfForGemm(int deviceId, int input, const float* data, size_t numElements)
+{
+    if (s_halfGemmBufferSizes[deviceId][input] < numElements)
+    {
+        if (s_halfGemmBuffers[deviceId][input] != nullptr)
+            TracingGPUMemoryAllocator::Free<short>(deviceId, reinterpret_cast<short*>(s_halfGemmBuffers[deviceId][input]));
+        s_halfGemmBuffers[deviceId][input] = reinterpret_cast<__half*>(TracingGPUMemoryAllocator::Allocate<short>(deviceId, numElements));
+        s_halfGemmBufferSizes[deviceId][input] = numElements;
+    }
+
+    __half* buffer = s_halfGemmBuffers[deviceId][input];
+    CUDA_LONG N = (CUDA_LONG) numElements;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _convertToHalf<<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(data, buffer, N);
+    return buffer;
+}
+#endif
+
+// Single precision GEMM with half precision inputs and single precision accumulation on the Tensor Cores.
+// Returns false if it is not available, in which case the regular GEMM is used.
+#if CUDA_VERSION >= 9000
+static bool TryMixedPrecisionGemm(cublasHandle_t handle, int deviceId, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k,
+                                  const float* alpha, const float* A, int lda, size_t numElementsA, const float* B, int ldb, size_t numElementsB,
+                                  const float* beta, float* C, int ldc)
+{
+    const __half* halfA = ConvertToHalfForGemm(deviceId, 0, A, numElementsA);
+    const __half* halfB = ConvertToHalfForGemm(deviceId, 1, B, numElementsB);
+
+    CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_TENSOR_OP_MATH));
+    cublasStatus_t status = cublasGemmEx(handle, transa, transb, m, n, k, alpha, halfA, CUDA_R_16F, lda, halfB, CUDA_R_16F, ldb,
+                                         beta, C, CUDA_R_32F, ldc, CUDA_R_32F, CUBLAS_GEMM_DEFAULT_TENSOR_OP);
+    CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_DEFAULT_MATH));
+    CUBLAS_CALL(status);
+    return true;
+}
+#else
+static bool TryMixedPrecisionGemm(cublasHandle_t, int, cublasOperation_t, cublasOperation_t, int, int, int,
+                                  const float*, const float*, int, size_t, const float*, int, size_t,
+                                  const float*, float*, int)
+{
+    return false;
+}
+#endif
+
+static bool TryMixedPrecisionGemm(cublasHandle_t, int, cublasOperation_t, cublasOperation_t, int, int, int,
+                                  const double*, const double*, int, size_t, const double*, int, size_t,
+                                  const double*, double*, int)
+{
+    return false;
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB,
                                                  ElemType beta, GPUMatrix<ElemType>& c)
@@ -3376,11 +4467,46 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
         RuntimeError("!(m>0 && k>0 && l>0 && n>0)"); // converting from size_t to int may cause overflow
     if (k != l)
         RuntimeError("matrix dim mismatch in MultiplyAndWeightedAdd");
-    CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, b.Data(), (int) b.m_numRows, &beta, c.Data(), (int) c.m_numRows));
+    if (!s_useMixedPrecisionGemm ||
+        !TryMixedPrecisionGemm(cuHandle, b.GetComputeDeviceId(), transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, a.GetNumElements(),
+                               b.Data(), (int) b.m_numRows, b.GetNumElements(), &beta, c.Data(), (int) c.m_numRows))
+    {
+        CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, b.Data(), (int) b.m_numRows, &beta, c.Data(), (int) c.m_numRows));
+    }
     c.m_numRows = m;
     c.m_numCols = n;
 }
 
+// see CPUMatrix::BatchedMultiplyAndWeightedAdd()
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const size_t strideA, const GPUMatrix<ElemType>& b, const bool transposeB, const size_t strideB,
+                                                        ElemType beta, GPUMatrix<ElemType>& c, const size_t strideC, const size_t m, const size_t n, const size_t k, const size_t batchCount)
+{
+    if (batchCount == 0 || m == 0 || n == 0)
+        return;
+    a.PrepareDevice();
+    if ((a.GetComputeDeviceId() != b.GetComputeDeviceId()) || (b.GetComputeDeviceId() != c.GetComputeDeviceId())) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+    if (strideC < m * n && batchCount > 1)
+        InvalidArgument("BatchedMultiplyAndWeightedAdd: The output matrices must not overlap.");
+    if ((batchCount - 1) * strideA + m * k > a.GetNumElements() || (batchCount - 1) * strideB + k * n > b.GetNumElements() || (batchCount - 1) * strideC + m * n > c.GetNumElements())
+        InvalidArgument("BatchedMultiplyAndWeightedAdd: The batch of matrices exceeds the matrix objects.");
+
+    cublasHandle_t cuHandle = GetCublasHandle(b.GetComputeDeviceId());
+    cublasOperation_t transA = transposeA ? CUBLAS_OP_T : CUBLAS_OP_N;
+    cublasOperation_t transB = transposeB ? CUBLAS_OP_T : CUBLAS_OP_N;
+    int lda = (int) max<size_t>(1, transposeA ? k : m);
+    int ldb = (int) max<size_t>(1, transposeB ? n : k);
+    int ldc = (int) m;
+#if CUDA_VERSION >= 8000
+    CUBLAS_CALL(cublas_gemmStridedBatched(cuHandle, transA, transB, (int) m, (int) n, (int) k, &alpha, a.Data(), lda, (long long) strideA,
+                                          b.Data(), ldb, (long long) strideB, &beta, c.Data(), ldc, (long long) strideC, (int) batchCount));
+#else
+    for (size_t i = 0; i < batchCount; i++)
+        CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, (int) m, (int) n, (int) k, &alpha, a.Data() + i * strideA, lda, b.Data() + i * strideB, ldb, &beta, c.Data() + i * strideC, ldc));
+#endif
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c)
 {
@@ -3710,6 +4836,32 @@ void GPUMatrix<ElemType>::AddScaledDifference(const GPUMatrix<ElemType>& alpha,
     }
 }
 
+/// <summary>c += alpha * (softmax(logits) - labels)</summary>
+/// <param name="alpha">1X1 matrix</param>
+/// <param name="logits">Input matrix</param>
+/// <param name="logSumExp">Column-wise log-sum-exp of logits</param>
+/// <param name="labels">Input matrix</param>
+/// <param name="c">Resulting matrix, user is responsible for allocating this</param>
+template <class ElemType>
+void GPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp, const GPUMatrix<ElemType>& labels, GPUMatrix<ElemType>& c)
+{
+    if (alpha.GetNumElements() != 1)
+        InvalidArgument("AddSoftmaxCrossEntropyGradient: alpha must be a 1X1 matrix.");
+    if (logits.GetComputeDeviceId() != c.GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+    if (logits.IsEmpty())
+        LogicError("AddSoftmaxCrossEntropyGradient: Input matrix logits is empty.");
+    if (!(logits.GetNumRows() == labels.GetNumRows() && logits.GetNumRows() == c.GetNumRows() &&
+          logits.GetNumCols() == labels.GetNumCols() && logits.GetNumCols() == c.GetNumCols() && logSumExp.GetNumElements() == logits.GetNumCols()))
+        InvalidArgument("AddSoftmaxCrossEntropyGradient: logits, labels, and c must have the same dimension, and logSumExp one element per column.");
+
+    logits.PrepareDevice();
+    CUDA_LONG n = (CUDA_LONG) logits.GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * n / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _addSoftmaxCrossEntropyGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(alpha.Data(), logits.Data(), logSumExp.Data(), labels.Data(), c.Data(), (CUDA_LONG) logits.GetNumRows(), n);
+}
+
 /// <summary> c = alpha * (a-b)</summary>
 /// if a, b, c  must have same dim
 /// <param name="alpha">Scalar</param>
@@ -4336,93 +5488,6 @@ ElemType GPUMatrix<ElemType>::LogSumOfElements() const
     return h_sum;
 }
 
-template <class ElemType>
-void GPUMatrix<ElemType>::RCRFBackwardCompute(
-    const GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta,
-    const GPUMatrix<ElemType>& /*lbls*/,
-    const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores, const int shift)
-{
-    if (alpha.IsEmpty() || pos_scores.IsEmpty() || pair_scores.IsEmpty())
-        LogicError("RCRFBackwardCompute: one of the input matrices is empty.");
-
-    if (alpha.GetNumRows() != pos_scores.GetNumRows() || alpha.GetNumCols() != pos_scores.GetNumCols())
-        LogicError("RCRFBackwardCompute: matrix dimensions mismatched.");
-
-    size_t iNumLab = alpha.GetNumRows();
-    size_t iNumPos = alpha.GetNumCols();
-
-    alpha.PrepareDevice();
-    beta.RequireSize(iNumLab, iNumPos);
-
-    ElemType* d_zeta = TracingGPUMemoryAllocator::Allocate<ElemType>(alpha.GetComputeDeviceId(), iNumLab);
-
-    CUDA_LONG N = iNumLab;
-    // TODO: change all three '512' to 'GridDim::maxThreadsPerBlock' (not doing this now since I cannot test it)
-    int blocksPerGrid = (int) ceil(1.0 * N / 512);
-    size_t szMemSize;
-    for (int t = iNumPos - 1; t >= 0; t--)
-    {
-        szMemSize = sizeof(ElemType) * iNumLab;
-        // This function assumes iNumLab <= 1024 and that shared memory == total (!) number of threads == iNumLab.
-        assert(iNumLab <= 1024);
-        _rcrfBackwardComputeZetaMax1024Labels<ElemType> << <blocksPerGrid, 512, szMemSize >> >(t, iNumPos, alpha.Data(), d_zeta, pair_scores.Data(), iNumLab, shift);
-        szMemSize = iNumLab * 3;
-        szMemSize *= sizeof(ElemType);
-        // This function assumes iNumLab <= 1024 and that shared memory == total (!) number of threads == 3 * iNumLab.
-        assert(iNumLab <= 1024);
-        _rcrfBackwardComputeMax1024Labels<ElemType> << <blocksPerGrid, 512, szMemSize >> >(t, iNumPos, alpha.Data(), beta.Data(),
-                                                                                           d_zeta, pair_scores.Data(), iNumLab, shift);
-    }
-    /*
-        error = cudaGetErrorString(cudaPeekAtLastError());
-        printf("%s\n", error);
-        error = cudaGetErrorString(cudaThreadSynchronize());
-        printf("%s\n", error);
-        */
-
-    TracingGPUMemoryAllocator::Free<ElemType>(alpha.GetComputeDeviceId(), d_zeta);
-}
-
-/**
-    Compute the gradient for the first order Markov transition probabilities
-    It uses equations derived in R. Collobert's paper "Natural language processing (almost) from scratch"
-    */
-template <class ElemType>
-void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
-                                              const GPUMatrix<ElemType>& alpha,
-                                              const GPUMatrix<ElemType>& beta,
-                                              const GPUMatrix<ElemType>& pair_scores,
-                                              GPUMatrix<ElemType>& grd,
-                                              const int startLbl,
-                                              const int shift)
-{
-    assert(shift == 1);
-    int iNumPos = alpha.GetNumCols();
-    int iNumLab = alpha.GetNumRows();
-
-    ElemType* d_zeta = TracingGPUMemoryAllocator::Allocate<ElemType>(alpha.GetComputeDeviceId(), iNumLab);
-
-    CUDA_LONG N = iNumLab;
-    // TODO: change all three '512' to 'GridDim::maxThreadsPerBlock' (not doing this now since I cannot test it)
-    int blocksPerGrid = (int)ceil(1.0 * N / 512);
-    size_t szMemSize;
-    for (int t = 0; t < iNumPos; t++)
-    {
-        szMemSize = sizeof(ElemType) * iNumLab;
-        // This function assumes iNumLab <= 1024 and that shared memory == total (!) number of threads == iNumLab.
-        assert(iNumLab <= 1024);
-        // BUGBUG: This is launched with 512 threads per block, but allocates shared mem as if there is only one block. Likewise for all 4 of these functions.
-        _rcrfTransGrdComputeZetaMax1024Labels<ElemType> << <blocksPerGrid, 512, szMemSize >> >(t - 1, iNumPos, alpha.Data(), d_zeta, pair_scores.Data(), iNumLab, startLbl, shift);
-        szMemSize = iNumLab * 3;
-        szMemSize *= sizeof(ElemType);
-        // This function assumes iNumLab <= 1024 and that shared memory == total (!) number of threads == iNumLab.
-        assert(iNumLab <= 1024);
-        _rcrfTransGrdComputeMax1024Labels<ElemType> << <blocksPerGrid, 512, szMemSize >> >(t, startLbl, alpha.Data(), beta.Data(),
-                                                                                           d_zeta, pair_scores.Data(), lbls.Data(), grd.Data(), iNumPos, iNumLab, shift);
-    }
-    TracingGPUMemoryAllocator::Free<ElemType>(alpha.GetComputeDeviceId(), d_zeta);
-};
-
 // -----------------------------------------------------------------------
 // TensorView entry points from Matrix.cpp
 // -----------------------------------------------------------------------
@@ -4547,6 +5612,18 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
     return TensorOpN<ElemType, 4>(beta, array<ElemType*, 4>{a.Data(), b.Data(), c.Data(), Data()}, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
+// perform a fused chain of element-wise operations on a, b, and c giving 'this', in a single kernel launch
+template <class ElemType>
+void GPUMatrix<ElemType>::FusedTensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, ElemType alpha, const FusedElementwiseOp& program,
+                                        const array<size_t, 4>& offsets,
+                                        const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides)
+{
+    a.PrepareDevice();
+    if (a.GetComputeDeviceId() != GetComputeDeviceId() || b.GetComputeDeviceId() != GetComputeDeviceId() || c.GetComputeDeviceId() != GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+    return FusedTensorOpN<ElemType>(beta, array<ElemType*, 4>{a.Data(), b.Data(), c.Data(), Data()}, alpha, program, offsets, regularOpDims, regularStrides);
+}
+
 // =======================================================================
 // explicit instantiations business
 // =======================================================================
@@ -4562,6 +5639,9 @@ cublasHandle_t GPUMatrix<ElemType>::s_cuHandle[GPUMatrix<ElemType>::MaxGpus] = {
 template <class ElemType>
 void* GPUMatrix<ElemType>::s_curandGenerator = NULL;
 
+template <class ElemType>
+bool GPUMatrix<ElemType>::s_useMixedPrecisionGemm = false;
+
 // We use Matrix<char> as the backing store for QuantizedMatrix
 // Let's explicitly instantiate the methods we need for that purpose
 template GPUMatrix<char>::GPUMatrix(const size_t numRows, const size_t numCols, int deviceId);
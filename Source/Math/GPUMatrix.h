@@ -62,6 +62,8 @@ cudaStream_t MATH_API GetStream();
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 class DataTransferer;
+struct ImageAugmentationParameters;
+enum class NarrowElementType;
 
 // -----------------------------------------------------------------------
 // SyncGuard -- synchronize around CUDA calls
@@ -84,6 +86,24 @@ public:
     ~SyncGuard();
 };
 
+// -----------------------------------------------------------------------
+// DeterministicReductions -- bitwise reproducible accumulation on the GPU
+// -----------------------------------------------------------------------
+
+// When enabled, the cuDNN convolution engine takes the fastest deterministic algorithms of the auto-tuner (and deterministic
+// max pooling), and scatter and sparse gradient products add up their terms in a fixed order instead of with atomicAdd().
+// Unlike 'forceDeterministicAlgorithms', it keeps max pooling, all CPU threads, and algorithms with workspace.
+// Tensor reductions are deterministic either way.
+class DeterministicReductions
+{
+private:
+    static bool s_isEnabled;
+
+public:
+    static MATH_API void Enable(bool enable);
+    static MATH_API bool IsEnabled();
+};
+
 // -----------------------------------------------------------------------
 // DeviceBoundNumber -- This class represents a number which resides on a particular device. Use it to avoid unnecessary transfers between CPU and GPU
 // -----------------------------------------------------------------------
@@ -164,6 +184,7 @@ public:
 private:
     static cublasHandle_t s_cuHandle[MaxGpus];
     static void* s_curandGenerator;
+    static bool s_useMixedPrecisionGemm;
 
 // Have to use disable the warning to avoid issues with __declspec(dllexport) on Windows (C4251).
 // Also, NVCC FE corresponding warning has to be disabled, see MathCUDA.vcxproj.
@@ -199,6 +220,13 @@ public:
     DEVICEID_TYPE PrepareDevice(DEVICEID_TYPE deviceId = -1) const;
 
     static cublasHandle_t GetCublasHandle(int computeDevice = -1);
+
+    // Single precision GEMMs convert their inputs to half precision and accumulate in single precision
+    // on the Tensor Cores (CUDA 9 and later, ignored otherwise and for double). The results stay in single precision.
+    static void UseMixedPrecisionGemm(bool useMixedPrecisionGemm)
+    {
+        s_useMixedPrecisionGemm = useMixedPrecisionGemm;
+    }
     ElemType* CopyToArray() const;                                              // allocated by the callee but need to be deleted by the caller
     size_t CopyToArray(ElemType*& arrayCopyTo, size_t& currentArraySize) const; // allocated by the callee but need to be deleted by the caller
     void CopySection(size_t numRows, size_t numCols, ElemType* dst, size_t colStride) const;
@@ -225,7 +253,11 @@ public:
 
     ElemType Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+    void Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType biasCorrection, ElemType epsilon, ElemType decay);
     ElemType RmsProp(GPUMatrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
+    // see CPUMatrix::MultiTensorUpdate() and MultiTensorSumOfSquares(); the pointers are device pointers of deviceId
+    static void MultiTensorUpdate(DEVICEID_TYPE deviceId, std::vector<MultiTensorUpdateItem<ElemType>>& items, const MultiTensorUpdateParams<ElemType>& params);
+    static void MultiTensorSumOfSquares(DEVICEID_TYPE deviceId, const std::vector<const ElemType*>& data, const std::vector<size_t>& sizes, std::vector<double>& sumsOfSquares);
 
     void Reshape(const size_t numRows, const size_t numCols);
 
@@ -252,6 +284,7 @@ public:
 
     //void SetValue(const CPUMatrix<ElemType>& deepCopyFrom);
     void SetValue(const GPUMatrix<ElemType>& deepCopyFrom);
+    void AssignPeerCopyOf(const GPUMatrix<ElemType>& a); // 'a' lives on another GPU
     //void SetValue(const CPUSparseMatrix<ElemType>& deepCopyFrom);
     //void SetValue(const GPUSparseMatrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, size_t matrixFlags = matrixFlagNormal, DataTransferer* transferer = nullptr);
@@ -261,6 +294,12 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    static void Dropout(const ElemType beta, const GPUMatrix<ElemType>& a, const ElemType dropoutRate, const uint64_t seed, const uint64_t offset, GPUMatrix<ElemType>& c);
+    void SetCounterBasedUniformRandomValue(const ElemType low, const ElemType high, const uint64_t seed);
+    void SetCounterBasedGaussianRandomValue(const ElemType mean, const ElemType sigma, const uint64_t seed);
+    GPUMatrix<ElemType>& AssignWeightedRandomSamplesWithReplacement(const GPUMatrix<ElemType>& weights, size_t numSamples, const uint64_t seed, const uint64_t offset, GPUMatrix<ElemType>& prefixSums);
+    GPUMatrix<ElemType>& AssignWeightedSampleKeys(const GPUMatrix<ElemType>& weights, const uint64_t seed, const uint64_t offset);
+    GPUMatrix<ElemType>& AssignWeightedSampleInclusionFrequencies(const GPUMatrix<ElemType>& weights, size_t numSamples, bool allowDuplicates, const GPUMatrix<ElemType>& samples);
 
     GPUMatrix<ElemType> Transpose() const;
     GPUMatrix<ElemType>& AssignTransposeOf(const GPUMatrix<ElemType>& a);
@@ -329,6 +368,7 @@ public:
 
     GPUMatrix<ElemType>& InplaceLogSoftmax(const bool isColWise);
     GPUMatrix<ElemType>& AssignLogSoftmaxOf(const GPUMatrix<ElemType>& a, const bool isColWise);
+    GPUMatrix<ElemType>& AssignSoftmaxCrossEntropyOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp);
 
     GPUMatrix<ElemType>& InplaceHardmax(const bool isColWise);
     GPUMatrix<ElemType>& AssignHardmaxOf(const GPUMatrix<ElemType>& a, const bool isColWise);
@@ -368,6 +408,7 @@ public:
     ElemType SumOfAbsElements() const; // sum of all abs(elements)
     ElemType SumOfElements() const;    // sum of all elements
     GPUMatrix<ElemType>& AssignSumOfElements(const GPUMatrix<ElemType>& a);
+    void FlagNonFiniteValues(GPUMatrix<ElemType>& flag) const;
 
     ElemType Max() const;
     bool IsEqualTo(const GPUMatrix<ElemType>& a, const ElemType threshold = 1e-8) const;
@@ -424,6 +465,29 @@ public:
     void AssignNCEUnnormalizedEval(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     void AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& softmax);
 
+    GPUMatrix<ElemType>& AssignAugmentedImages(GPUMatrix<ElemType>& workspace, size_t numImages, const ImageAugmentationParameters& parameters, uint64_t seed);
+    GPUMatrix<ElemType>& AssignWidenedValuesOf(const GPUMatrix<ElemType>& packed, NarrowElementType type, size_t numRows, size_t numCols, ElemType scale, ElemType shift);
+
+    GPUMatrix<ElemType>& AssignRanksWithinQueries(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& queryIds);
+    GPUMatrix<ElemType>& AssignNDCGContributions(const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& ranks, const GPUMatrix<ElemType>& queryIds, bool atOne, GPUMatrix<ElemType>& queryStarts);
+    GPUMatrix<ElemType>& AddLambdaRankGradient(const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& ranks, const GPUMatrix<ElemType>& queryIds, ElemType sigma);
+    GPUMatrix<ElemType>& AssignCRFForwardScores(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride);
+    GPUMatrix<ElemType>& AssignCRFLogPosteriors(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& sequences, size_t stride);
+    GPUMatrix<ElemType>& AssignCRFNegativeLogLikelihoods(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride);
+    GPUMatrix<ElemType>& AssignCRFTransitionGradient(const GPUMatrix<ElemType>& logPosteriors, const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride);
+    GPUMatrix<ElemType>& AssignCRFViterbiPath(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride, GPUMatrix<ElemType>& viterbiScores, GPUMatrix<ElemType>& backPointers);
+    GPUMatrix<ElemType>& AssignNonZeroCountsOfSequences(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sequences, size_t stride);
+    GPUMatrix<ElemType>& AssignNonZeroPositionsOfSequences(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sequences, size_t stride, const GPUMatrix<ElemType>& outputSequences, size_t outputStride);
+    GPUMatrix<ElemType>& AssignColumnsOfSequencePositions(const GPUMatrix<ElemType>& positions, const GPUMatrix<ElemType>& sequences, size_t stride, const GPUMatrix<ElemType>& targetSequences, size_t targetStride);
+    GPUMatrix<ElemType>& AssignGMMLogLikelihoods(const GPUMatrix<ElemType>& unnormedPrior, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, GPUMatrix<ElemType>& posteriors);
+    GPUMatrix<ElemType>& AddGMMUnnormedPriorGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& unnormedPrior, const GPUMatrix<ElemType>& posteriors);
+    GPUMatrix<ElemType>& AddGMMMeanGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors);
+    GPUMatrix<ElemType>& AddGMMLogStddevGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors);
+    GPUMatrix<ElemType>& AddGMMFeatureGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors);
+    GPUMatrix<ElemType>& AssignSimilaritiesWithNegativeSamples(const GPUMatrix<ElemType>& similarities, size_t shift, size_t numNegatives, bool inBatchNegatives, GPUMatrix<ElemType>& documents);
+    GPUMatrix<ElemType>& AssignNegativeSamplesGradientMatrix(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& documents);
+    GPUMatrix<ElemType>& AddColumnNormalizationGradient(const GPUMatrix<ElemType>& gradientOfNormalized, const GPUMatrix<ElemType>& normalized, const GPUMatrix<ElemType>& invNorms);
+
     void Print(const char* matrixName, size_t rowStart, size_t rowEnd, size_t colStart, size_t colEnd) const;
     void Print(const char* matrixName = NULL) const; // print whole matrix. can be expensive
 
@@ -477,18 +541,31 @@ public:
                             const size_t pooledWidth, const size_t pooledHeight, const GPUMatrix<ElemType>& roiData, GPUMatrix<ElemType>& grad, 
                             GPUMatrix<ElemType>& argmax) const;
 
+    void ROIAlignForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                         const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const GPUMatrix<ElemType>& roiData, GPUMatrix<ElemType>& output) const;
+
+    void ROIAlignBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                          const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const GPUMatrix<ElemType>& roiData, GPUMatrix<ElemType>& grad) const;
+
     void AveragePoolingForward(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& output) const;
     void AveragePoolingBackward(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& grad) const;
 
     void BatchNormalizationForward(const GPUMatrix<ElemType>& scale, const GPUMatrix<ElemType>& bias, bool inferenceOnly, double expAvgFactor, double blendFactor,
                                    GPUMatrix<ElemType>& runMean, GPUMatrix<ElemType>& runVariance, GPUMatrix<ElemType>& out, double epsilon,
-                                   GPUMatrix<ElemType>& saveMean, GPUMatrix<ElemType>& saveInvStdDev) const;
+                                   GPUMatrix<ElemType>& saveMean, GPUMatrix<ElemType>& saveInvStdDev, bool reluOutput) const;
     void BatchNormalizationBackward(const GPUMatrix<ElemType>& in, GPUMatrix<ElemType>& grad, const GPUMatrix<ElemType>& scale, double blendFactor,
                                     const GPUMatrix<ElemType>& saveMean, const GPUMatrix<ElemType>& saveInvStdDev,
                                     GPUMatrix<ElemType>& scaleGrad, GPUMatrix<ElemType>& biasGrad) const;
+    void BatchNormalizationScaleAndBiasGradients(const GPUMatrix<ElemType>& in, const GPUMatrix<ElemType>& saveMean, const GPUMatrix<ElemType>& saveInvStdDev,
+                                                 GPUMatrix<ElemType>& scaleGrad, GPUMatrix<ElemType>& biasGrad) const;
+    void BatchNormalizationInputGradient(const GPUMatrix<ElemType>& in, GPUMatrix<ElemType>& grad, const GPUMatrix<ElemType>& scale, double mbStatsWeight,
+                                         const GPUMatrix<ElemType>& saveMean, const GPUMatrix<ElemType>& saveInvStdDev,
+                                         const GPUMatrix<ElemType>& scaleGrad, const GPUMatrix<ElemType>& biasGrad) const;
+    void BatchNormalizationReluBackward(const GPUMatrix<ElemType>& in, const GPUMatrix<ElemType>& scale, const GPUMatrix<ElemType>& bias,
+                                        const GPUMatrix<ElemType>& saveMean, const GPUMatrix<ElemType>& saveInvStdDev);
 
     // RNN support functions
-    void RNNForward(const GPUMatrix<ElemType>& inputX, const GPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const struct RnnAttributes& rnnAttributes, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace);
+    void RNNForward(const GPUMatrix<ElemType>& inputX, const GPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const struct RnnAttributes& rnnAttributes, bool inferenceOnly, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace);
     void RNNBackwardData(const GPUMatrix<ElemType>& outputDY, const GPUMatrix<ElemType>& paramW, GPUMatrix<ElemType>& outputDX, const struct RnnAttributes& rnnAttributes, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace);
     void RNNBackwardWeights(const GPUMatrix<ElemType>& inputX, const GPUMatrix<ElemType>& outputY, GPUMatrix<ElemType>& dw, const struct RnnAttributes& rnnAttributes, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace);
 
@@ -499,6 +576,8 @@ public:
     static void Multiply(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c);
+    static void BatchedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const size_t strideA, const GPUMatrix<ElemType>& b, const bool transposeB, const size_t strideB,
+                                              ElemType beta, GPUMatrix<ElemType>& c, const size_t strideC, const size_t m, const size_t n, const size_t k, const size_t batchCount);
 
     static void ScaleAndAdd(ElemType alpha, const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& c);
     static void ScaleAndAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
@@ -506,6 +585,7 @@ public:
     static void AssignScaledDifference(const ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     static void AddScaledDifference(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     static void AssignScaledDifference(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
+    static void AddSoftmaxCrossEntropyGradient(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp, const GPUMatrix<ElemType>& labels, GPUMatrix<ElemType>& c);
 
     static void AddElementToElement(ElemType beta, const GPUMatrix<ElemType>& a, const size_t ai, const size_t aj, GPUMatrix<ElemType>& c, const size_t ci, const size_t cj);
 
@@ -535,6 +615,9 @@ public:
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    void FusedTensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, ElemType alpha, const FusedElementwiseOp& program,
+                       const std::array<size_t, 4>& offsets,
+                       const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides);
 
     static void CreateCurandObject(unsigned long seed, const char* caller);
     static void ResetCurandObject(unsigned long seed, const char* caller);
@@ -558,19 +641,6 @@ public:
 
     GPUMatrix<ElemType>& AssignElementProductOfWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const size_t shift);
 
-public:
-    static void RCRFBackwardCompute(
-        const GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta,
-        const GPUMatrix<ElemType>& lbls,
-        const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores, const int shift = 1);
-    static void RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
-                                    const GPUMatrix<ElemType>& alpha,
-                                    const GPUMatrix<ElemType>& beta,
-                                    const GPUMatrix<ElemType>& pair_scores,
-                                    GPUMatrix<ElemType>& grd,
-                                    const int startLbl, // the time 0 start symbol in the output layer
-                                    const int shift);
-
 public:
     friend File& operator>>(File& stream, GPUMatrix<ElemType>& us)
     {
@@ -583,12 +653,16 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixNameDummy >> format >> numRows >> numCols;
-        ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        if (stream.IsTextBased())
+        {
+            ElemType* d_array = new ElemType[numRows * numCols];
+            stream.ReadArray(d_array, numRows * numCols);
+            us.SetValue(numRows, numCols, us.GetComputeDeviceId(), d_array, matrixFlagNormal | format);
+            delete[] d_array;
+        }
+        else // take the values straight from the file buffer (or the mapped file) without per-element reads
+            us.SetValue(numRows, numCols, us.GetComputeDeviceId(), (ElemType*) stream.ReadBuffer(numRows * numCols * sizeof(ElemType)), matrixFlagNormal | format);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
-        us.SetValue(numRows, numCols, us.GetComputeDeviceId(), d_array, matrixFlagNormal | format);
-        delete[] d_array;
         return stream;
     }
     friend File& operator<<(File& stream, const GPUMatrix<ElemType>& us)
@@ -14,6 +14,12 @@
 #include "CommonMatrix.h"
 #include "GPUMatrix.h"
 #include "TensorOps.h" // for exp_() etc.
+#include "ImageAugmentation.h"
+#include "LearningToRank.h"
+#include "LinearChainCRF.h"
+#include "GaussianMixture.h"
+#include "CosineWithNegativeSamples.h"
+#include "NarrowElementTypes.h"
 #include "device_functions.h"
 #include <cuda_runtime.h>
 #include <assert.h>
@@ -984,6 +990,137 @@ __global__ void _assignColumnwiseLogSoftmaxOf512Threads(
     }
 }
 
+// merges the log-sum-exp partial (m2, s2), i.e. s2 = sum(exp(x - m2)), into (m, s)
+template <class ElemType>
+__device__ __forceinline__ void _mergeLogSumExp(ElemType& m, ElemType& s, const ElemType m2, const ElemType s2)
+{
+    if (m2 > m)
+    {
+        s = s * exp_(m - m2) + s2;
+        m = m2;
+    }
+    else
+        s += s2 * exp_(m2 - m);
+}
+
+// Column-wise softmax cross entropy without a softmax matrix. Block (j, k) reduces the rows [k * chunkRows, (k + 1) * chunkRows)
+// of column j to max(z), sum(exp(z - max(z))), sum(y) and sum(y * z), keeping the log-sum-exp online so that z is read once.
+// With a single chunk per column the block writes the column's log-sum-exp and loss, otherwise its partials
+// [4 x numChunks x numCols], which _combineSoftmaxCrossEntropyPartials merges. There must be 512 threads in a block.
+template <class ElemType>
+__global__ void _softmaxCrossEntropyOf512Threads(
+    const ElemType* labels,
+    const ElemType* logits,
+    ElemType* partials,
+    ElemType* logSumExp,
+    ElemType* loss,
+    const CUDA_LONG numRows,
+    const CUDA_LONG numCols,
+    const CUDA_LONG chunkRows)
+{
+    __shared__ ElemType maxs[512];
+    __shared__ ElemType sums[512];
+    __shared__ ElemType sumsY[512];
+    __shared__ ElemType sumsYZ[512];
+
+    const CUDA_LONG col = blockIdx.x;
+    const CUDA_LONG begin = blockIdx.y * chunkRows;
+    const CUDA_LONG end = min(begin + chunkRows, numRows);
+
+    ElemType m = -FLT_MAX;
+    ElemType s = 0;
+    ElemType sumY = 0;
+    ElemType sumYZ = 0;
+    for (CUDA_LONG i = begin + threadIdx.x; i < end; i += 512)
+    {
+        const ElemType z = logits[IDX2C(i, col, numRows)];
+        const ElemType y = labels[IDX2C(i, col, numRows)];
+        _mergeLogSumExp(m, s, z, (ElemType) 1);
+        sumY += y;
+        sumYZ += y * z;
+    }
+    maxs[threadIdx.x] = m;
+    sums[threadIdx.x] = s;
+    sumsY[threadIdx.x] = sumY;
+    sumsYZ[threadIdx.x] = sumYZ;
+    __syncthreads();
+
+    for (int stride = 256; stride > 0; stride >>= 1)
+    {
+        if (threadIdx.x < stride)
+        {
+            _mergeLogSumExp(maxs[threadIdx.x], sums[threadIdx.x], maxs[threadIdx.x + stride], sums[threadIdx.x + stride]);
+            sumsY[threadIdx.x] += sumsY[threadIdx.x + stride];
+            sumsYZ[threadIdx.x] += sumsYZ[threadIdx.x + stride];
+        }
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+    {
+        if (gridDim.y == 1)
+        {
+            const ElemType lse = maxs[0] + log_(sums[0]);
+            logSumExp[col] = lse;
+            loss[col] = lse * sumsY[0] - sumsYZ[0];
+        }
+        else
+        {
+            ElemType* p = partials + 4 * (blockIdx.y * numCols + col);
+            p[0] = maxs[0];
+            p[1] = sums[0];
+            p[2] = sumsY[0];
+            p[3] = sumsYZ[0];
+        }
+    }
+}
+
+// one thread per column, merges the chunk partials of _softmaxCrossEntropyOf512Threads
+template <class ElemType>
+__global__ void _combineSoftmaxCrossEntropyPartials(
+    const ElemType* partials,
+    ElemType* logSumExp,
+    ElemType* loss,
+    const CUDA_LONG numCols,
+    const CUDA_LONG numChunks)
+{
+    const CUDA_LONG col = blockDim.x * blockIdx.x + threadIdx.x;
+    if (col >= numCols)
+        return;
+
+    ElemType m = -FLT_MAX;
+    ElemType s = 0;
+    ElemType sumY = 0;
+    ElemType sumYZ = 0;
+    for (CUDA_LONG k = 0; k < numChunks; k++)
+    {
+        const ElemType* p = partials + 4 * (k * numCols + col);
+        _mergeLogSumExp(m, s, p[0], p[1]);
+        sumY += p[2];
+        sumYZ += p[3];
+    }
+    const ElemType lse = m + log_(s);
+    logSumExp[col] = lse;
+    loss[col] = lse * sumY - sumYZ;
+}
+
+// c += alpha * (softmax(z) - y), with the softmax recomputed from z and its column-wise log-sum-exp
+template <class ElemType>
+__global__ void _addSoftmaxCrossEntropyGradient(
+    const ElemType* alpha,
+    const ElemType* logits,
+    const ElemType* logSumExp,
+    const ElemType* labels,
+    ElemType* c,
+    const CUDA_LONG numRows,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    c[id] += alpha[0] * (exp_(logits[id] - logSumExp[id / numRows]) - labels[id]);
+}
+
 template <class ElemType>
 __global__ void _logSoftMaxRowWise(
     ElemType* a,
@@ -1453,6 +1590,17 @@ __global__ void _fsadagrad(CUDA_LONG size, ElemType* grad, ElemType* smoothAda,
     }
 }
 
+// one fused pass of Adam over moments and values, see CPUMatrix::Adam()
+template <class ElemType>
+__global__ void _adam(CUDA_LONG size, ElemType* grad, ElemType* smoothAda, ElemType* smoothMom, ElemType* val,
+                      ElemType lr, ElemType mom, ElemType adaWeight, ElemType biasCorrection, ElemType epsilon, ElemType decay)
+{
+    CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG stride = blockDim.x * gridDim.x;
+    for (; idx < size; idx += stride)
+        AdamUpdateElement(val[idx], smoothAda[idx], smoothMom[idx], grad[idx], lr, mom, adaWeight, biasCorrection, epsilon, decay);
+}
+
 template <class ElemType>
 __global__ void _rmsprop_init(
     ElemType* avars, ElemType* signs, ElemType* steps,
@@ -1522,6 +1670,63 @@ __global__ void _rmsprop(
         multipliers[i] = temp;
 }
 
+// threads per block of the multi-tensor kernels; each block processes one MultiTensorChunk
+#define MULTI_TENSOR_THREADS_PER_BLOCK 256
+
+// sums the per-thread values of a block into partialSums[0]
+static __device__ __forceinline__ void _multiTensorBlockSum(double* partialSums)
+{
+    __syncthreads();
+    for (int s = MULTI_TENSOR_THREADS_PER_BLOCK / 2; s > 0; s >>= 1)
+    {
+        if (threadIdx.x < s)
+            partialSums[threadIdx.x] += partialSums[threadIdx.x + s];
+        __syncthreads();
+    }
+}
+
+// first pass of GPUMatrix::MultiTensorUpdate(); chunkSums receives the sum of the multipliers of each chunk (AdaGrad, RmsProp)
+template <class ElemType>
+__global__ void _multiTensorUpdate(const MultiTensorUpdateParams<ElemType> params, const MultiTensorUpdateItem<ElemType>* items, const MultiTensorChunk* chunks, double* chunkSums)
+{
+    __shared__ double partialSums[MULTI_TENSOR_THREADS_PER_BLOCK];
+    const MultiTensorChunk chunk = chunks[blockIdx.x];
+    const MultiTensorUpdateItem<ElemType> item = items[chunk.item];
+    double sum = 0;
+    for (size_t i = chunk.begin + threadIdx.x; i < chunk.end; i += MULTI_TENSOR_THREADS_PER_BLOCK)
+        sum += MultiTensorUpdateElement(params, item, i);
+    partialSums[threadIdx.x] = sum;
+    _multiTensorBlockSum(partialSums);
+    if (threadIdx.x == 0)
+        chunkSums[blockIdx.x] = partialSums[0];
+}
+
+// second pass of GPUMatrix::MultiTensorUpdate() for AdaGrad and RmsProp
+template <class ElemType>
+__global__ void _multiTensorApply(const MultiTensorUpdateItem<ElemType>* items, const ElemType* learnRates, const MultiTensorChunk* chunks)
+{
+    const MultiTensorChunk chunk = chunks[blockIdx.x];
+    const MultiTensorUpdateItem<ElemType> item = items[chunk.item];
+    const ElemType learnRate = learnRates[chunk.item];
+    for (size_t i = chunk.begin + threadIdx.x; i < chunk.end; i += MULTI_TENSOR_THREADS_PER_BLOCK)
+        MultiTensorApplyElement(item, learnRate, i);
+}
+
+template <class ElemType>
+__global__ void _multiTensorSumOfSquares(const ElemType* const* data, const MultiTensorChunk* chunks, double* chunkSums)
+{
+    __shared__ double partialSums[MULTI_TENSOR_THREADS_PER_BLOCK];
+    const MultiTensorChunk chunk = chunks[blockIdx.x];
+    const ElemType* p = data[chunk.item];
+    double sum = 0;
+    for (size_t i = chunk.begin + threadIdx.x; i < chunk.end; i += MULTI_TENSOR_THREADS_PER_BLOCK)
+        sum += (double) p[i] * p[i];
+    partialSums[threadIdx.x] = sum;
+    _multiTensorBlockSum(partialSums);
+    if (threadIdx.x == 0)
+        chunkSums[blockIdx.x] = partialSums[0];
+}
+
 template <class ElemType>
 __global__ void _rescaleToRange(
     ElemType* a,
@@ -1548,6 +1753,181 @@ __global__ void _setMaskAndScale(
     a[id] = a[id] <= maskRate ? 0 : scaleValue;
 }
 
+// see Matrix::BatchNormalizationReluBackward()
+template <class ElemType>
+__global__ void _batchNormalizationReluBackward(
+    ElemType* grad,
+    const ElemType* in,
+    const ElemType* scale,
+    const ElemType* bias,
+    const ElemType* savedMean,
+    const ElemType* savedInvStdDev,
+    const CUDA_LONG N,
+    const CUDA_LONG vectorSize,
+    const CUDA_LONG spatialSize)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    CUDA_LONG imap = (id % vectorSize) / spatialSize;
+    ElemType normalized = scale[imap] * (in[id] - savedMean[imap]) * savedInvStdDev[imap] + bias[imap];
+    if (normalized <= 0)
+        grad[id] = 0;
+}
+
+// see GPUMatrix::Dropout()
+template <class ElemType>
+__global__ void _dropout(
+    const ElemType beta,
+    const ElemType* a,
+    ElemType* c,
+    const CUDA_LONG N,
+    const ElemType dropoutRate,
+    const ElemType scale,
+    const uint64_t seed,
+    const uint64_t offset)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    ElemType value = a[id] * DropoutMaskElement(dropoutRate, scale, seed, offset + id);
+    c[id] = beta == 0 ? value : beta * c[id] + value;
+}
+
+// see GPUMatrix::FlagNonFiniteValues(); x - x is 0 unless x is NaN or Inf
+template <class ElemType>
+__global__ void _flagNonFiniteValues(
+    const ElemType* a,
+    const size_t N,
+    ElemType* flag)
+{
+    for (size_t id = (size_t) blockDim.x * blockIdx.x + threadIdx.x; id < N; id += (size_t) blockDim.x * gridDim.x)
+    {
+        if (!(a[id] - a[id] == 0))
+        {
+            *flag = 1;
+            return;
+        }
+    }
+}
+
+// see GPUMatrix::SetCounterBasedUniformRandomValue()
+template <class ElemType>
+__global__ void _setCounterBasedUniformRandomValue(
+    ElemType* a,
+    const size_t N,
+    const ElemType low,
+    const ElemType high,
+    const uint64_t seed)
+{
+    for (size_t id = (size_t) blockDim.x * blockIdx.x + threadIdx.x; id < N; id += (size_t) blockDim.x * gridDim.x)
+        a[id] = CounterBasedUniformElement(low, high, seed, (uint64_t) id);
+}
+
+// see GPUMatrix::SetCounterBasedGaussianRandomValue()
+template <class ElemType>
+__global__ void _setCounterBasedGaussianRandomValue(
+    ElemType* a,
+    const size_t N,
+    const ElemType mean,
+    const ElemType sigma,
+    const uint64_t seed)
+{
+    for (size_t id = (size_t) blockDim.x * blockIdx.x + threadIdx.x; id < N; id += (size_t) blockDim.x * gridDim.x)
+        a[id] = CounterBasedGaussianElement(mean, sigma, seed, (uint64_t) id);
+}
+
+// Prefix sums of the weights in a single block, see GPUMatrix::AssignWeightedRandomSamplesWithReplacement(): the block scans
+// a chunk at a time, and carries the sum of the previous chunks in double precision, so that each sum is rounded only once.
+template <int BlockSize, class ElemType>
+__global__ void _assignWeightedSamplePrefixSums(
+    const ElemType* weights,
+    ElemType* prefixSums,
+    const size_t numClasses)
+{
+    using BlockScanT = cub::BlockScan<double, BlockSize>;
+    __shared__ typename BlockScanT::TempStorage scanStorage;
+    double carry = 0;
+    for (size_t begin = 0; begin < numClasses; begin += BlockSize)
+    {
+        size_t i = begin + threadIdx.x;
+        double sum, chunkSum;
+        BlockScanT(scanStorage).InclusiveSum(i < numClasses ? (double) weights[i] : 0.0, sum, chunkSum);
+        if (i < numClasses)
+            prefixSums[i] = (ElemType) (carry + sum);
+        carry += chunkSum;
+        __syncthreads(); // (the temp storage is reused by the next chunk)
+    }
+}
+
+// see GPUMatrix::AssignWeightedRandomSamplesWithReplacement()
+template <class ElemType>
+__global__ void _assignWeightedRandomSamplesWithReplacement(
+    ElemType* samples,
+    const ElemType* prefixSums,
+    const size_t numClasses,
+    const CUDA_LONG numSamples,
+    const uint64_t seed,
+    const uint64_t offset)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numSamples)
+        return;
+    samples[id] = (ElemType) WeightedSampleClass(prefixSums, numClasses, WeightedSampleUnitValue(seed, offset + id));
+}
+
+// see GPUMatrix::AssignWeightedSampleKeys()
+template <class ElemType>
+__global__ void _assignWeightedSampleKeys(
+    ElemType* keys,
+    const ElemType* weights,
+    const CUDA_LONG numClasses,
+    const uint64_t seed,
+    const uint64_t offset)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numClasses)
+        return;
+    keys[id] = WeightedSampleKey(weights[id], seed, offset + id);
+}
+
+// see GPUMatrix::AssignWeightedSampleInclusionFrequencies(); a single block reduces the total weight and the number of tries
+// of the samples, a column each, and then writes the frequencies of all classes
+template <int BlockSize, class ElemType>
+__global__ void _assignWeightedSampleInclusionFrequencies(
+    ElemType* frequencies,
+    const ElemType* weights,
+    const size_t numClasses,
+    const size_t numSamples,
+    const bool allowDuplicates,
+    const ElemType* samples,
+    const size_t numExperiments)
+{
+    using BlockReduceT = cub::BlockReduce<double, BlockSize>;
+    __shared__ typename BlockReduceT::TempStorage reduceStorage;
+    __shared__ double total, numTries;
+
+    double partial = 0;
+    for (size_t i = threadIdx.x; i < numClasses; i += BlockSize)
+        partial += weights[i];
+    double sum = BlockReduceT(reduceStorage).Sum(partial);
+    if (threadIdx.x == 0)
+        total = sum;
+    __syncthreads();
+
+    partial = 0;
+    if (!allowDuplicates)
+        for (size_t j = threadIdx.x; j < numExperiments; j += BlockSize)
+            partial += WeightedSampleNumTries(weights, total, samples + j * numSamples, numSamples);
+    sum = BlockReduceT(reduceStorage).Sum(partial);
+    if (threadIdx.x == 0)
+        numTries = numExperiments > 0 ? sum / numExperiments : 0;
+    __syncthreads();
+
+    for (size_t i = threadIdx.x; i < numClasses; i += BlockSize)
+        frequencies[i] = WeightedSampleInclusionFrequency(weights[i], total, numSamples, allowDuplicates, numTries);
+}
+
 template <class ElemType>
 __global__ void _vectorSum(
     ElemType* c,       // output
@@ -2813,6 +3193,26 @@ __global__ void _isValid(
     }
 }
 
+// see GPUSparseMatrix::AssignOneHotColumns(); thread n writes the end of the last column
+template <class ElemType>
+__global__ void _assignOneHotColumnsCSC(
+    const ElemType* rowIndices,
+    ElemType* values,
+    GPUSPARSE_INDEX_TYPE* rowIndex,
+    GPUSPARSE_INDEX_TYPE* colIndex,
+    const CUDA_LONG n)
+{
+    CUDA_LONG j = blockDim.x * blockIdx.x + threadIdx.x;
+    if (j > n)
+        return;
+    colIndex[j] = j;
+    if (j < n)
+    {
+        rowIndex[j] = (GPUSPARSE_INDEX_TYPE) rowIndices[j];
+        values[j] = 1;
+    }
+}
+
 template <class ElemType>
 __global__ void _shiftColCSCIndexFromSliceViewToAbsolute(
     GPUSPARSE_INDEX_TYPE* colCSCIndex,
@@ -2829,6 +3229,55 @@ __global__ void _shiftColCSCIndexFromSliceViewToAbsolute(
         colCSCIndex[cols] = nz;
 }
 
+#define SPARSE_GATHER_THREADS_PER_BLOCK 256
+
+// c = alpha * a * b + beta * c for the dense a [m x k] and the CSC b [k x n], as a gather with segment sum: column j of c is
+// the sum of the columns of a selected by the nonzeros of column j of b, weighted by their values. For one-hot or multi-hot b
+// this is an embedding lookup. blockIdx.x is the column of c, the threads of blockIdx.y cover SPARSE_GATHER_THREADS_PER_BLOCK
+// of its rows; the row indices and values of the column are staged in shared memory, so that they are read once per block.
+template <class ElemType>
+__global__ void _denseGatherSparseCSCAndWeightedAddToDense(
+    const int m, // rowDense
+    const ElemType alpha,
+    const ElemType* a, // dense
+    const ElemType* bnzValues, // sparse nz values, indexed by the absolute positions of colCSCIndex
+    const GPUSPARSE_INDEX_TYPE* rowIndex,
+    const GPUSPARSE_INDEX_TYPE* colCSCIndex,
+    const ElemType beta,
+    ElemType* c // dense target
+    )
+{
+    __shared__ GPUSPARSE_INDEX_TYPE rows[SPARSE_GATHER_THREADS_PER_BLOCK];
+    __shared__ ElemType values[SPARSE_GATHER_THREADS_PER_BLOCK];
+
+    const int colInC = blockIdx.x;
+    const int rowInC = blockIdx.y * SPARSE_GATHER_THREADS_PER_BLOCK + threadIdx.x;
+    const int start = colCSCIndex[colInC];
+    const int end = colCSCIndex[colInC + 1];
+
+    ElemType s = 0;
+    for (int pieceStart = start; pieceStart < end; pieceStart += SPARSE_GATHER_THREADS_PER_BLOCK)
+    {
+        const int pieceSize = min(end - pieceStart, SPARSE_GATHER_THREADS_PER_BLOCK);
+        __syncthreads(); // the previous piece has been consumed by all threads
+        if (threadIdx.x < pieceSize)
+        {
+            rows[threadIdx.x] = rowIndex[pieceStart + threadIdx.x];
+            values[threadIdx.x] = bnzValues[pieceStart + threadIdx.x];
+        }
+        __syncthreads();
+
+        if (rowInC < m)
+        {
+            for (int q = 0; q < pieceSize; q++)
+                s += a[IDX2C(rowInC, rows[q], m)] * values[q];
+        }
+    }
+
+    if (rowInC < m)
+        c[IDX2C(rowInC, colInC, m)] = alpha * s + (beta == 0 ? 0 : beta * c[IDX2C(rowInC, colInC, m)]); // If beta is zero then don't lookup c
+}
+
 //c = alpha * op(a) * op(b) + beta*c
 // TODO: This function can be further improved by loading the kernel in shared memory
 template <class ElemType>
@@ -3052,6 +3501,49 @@ __global__ void _determineBlockIds(
     }
 }
 
+// deterministic version of _determineBlockIds: the new blocks are in the order of their columns
+// Launched as a single block; each thread numbers the pending columns of a contiguous range, after those of the ranges before.
+template <class ElemType>
+__global__ void _determineBlockIdsInOrder(
+    GPUSPARSE_INDEX_TYPE* blockId2Col, GPUSPARSE_INDEX_TYPE* col2BlockId, size_t numCols, size_t* blockSize)
+{
+    __shared__ size_t rangeBlockIndex[GridDim::maxThreadsPerBlock];
+    const size_t rangeSize = (numCols + blockDim.x - 1) / blockDim.x;
+    const size_t begin = min(threadIdx.x * rangeSize, numCols);
+    const size_t end = min(begin + rangeSize, numCols);
+
+    size_t numPending = 0;
+    for (size_t col = begin; col < end; col++)
+        if (col2BlockId[col] == Id_Pending)
+            numPending++;
+    rangeBlockIndex[threadIdx.x] = numPending;
+    __syncthreads();
+
+    if (threadIdx.x == 0)
+    {
+        size_t blockIndex = *blockSize;
+        for (size_t i = 0; i < blockDim.x; i++)
+        {
+            size_t numPendingInRange = rangeBlockIndex[i];
+            rangeBlockIndex[i] = blockIndex;
+            blockIndex += numPendingInRange;
+        }
+        *blockSize = blockIndex;
+    }
+    __syncthreads();
+
+    GPUSPARSE_INDEX_TYPE blockIndex = (GPUSPARSE_INDEX_TYPE)rangeBlockIndex[threadIdx.x];
+    for (size_t col = begin; col < end; col++)
+    {
+        if (col2BlockId[col] == Id_Pending)
+        {
+            col2BlockId[col] = blockIndex;
+            blockId2Col[blockIndex] = col;
+            blockIndex++;
+        }
+    }
+}
+
 // backward pass from hidden layer to feature weight
 //result (sparse BlockCol)= alpha * (lhs (dense) X rhs^T (sparse CSC)
 //assume resultValues are 0-initialized
@@ -3090,6 +3582,39 @@ __global__ void _denseMulSparseCSCTransposeToSparseBlockCol2(
     }
 }
 
+// deterministic version of _denseMulSparseCSCTransposeToSparseBlockCol2, from rhs in CSR format
+// Each thread computes one value of the result, [lhsRow, block], adding up the products over the row of rhs of that block in
+// the order of its columns.
+template <class ElemType>
+__global__ void _denseMulSparseCSRTransposeToSparseBlockCol(
+    const ElemType alpha,
+    const ElemType* lhsValues,
+    const size_t numRowsLhs,
+    const size_t numBlocks,
+    const ElemType* rhsNZValues,
+    const GPUSPARSE_INDEX_TYPE* rhsRowStarts, // CSR: start of each row
+    const GPUSPARSE_INDEX_TYPE* rhsCols,      // CSR: column of each non-zero value
+    const GPUSPARSE_INDEX_TYPE* blockId2Col,
+    ElemType* resultValues)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG blockId = index / numRowsLhs;
+    if (blockId >= numBlocks)
+        return;
+    const CUDA_LONG lhsRow = index - numRowsLhs * blockId;
+
+    const CUDA_LONG rhsRow = blockId2Col[blockId]; // the result column of the block is the row of rhs
+    CUDA_LONG start = rhsRowStarts[rhsRow];
+    CUDA_LONG end = rhsRowStarts[rhsRow + 1];
+    if (start == end) // a block from an earlier product
+        return;
+
+    ElemType sum = 0;
+    for (CUDA_LONG p = start; p < end; p++)
+        sum += lhsValues[IDX2C(lhsRow, rhsCols[p], numRowsLhs)] * rhsNZValues[p];
+    resultValues[IDX2C(lhsRow, blockId, numRowsLhs)] += alpha * sum;
+}
+
 // backward pass from hidden layer to feature weight
 //result (sparse BlockCol)= alpha * (lhs (dense) X rhs^T (sparse CSC)
 //assume resultValues are 0-initialized
@@ -3869,6 +4394,82 @@ __global__ void _normalGradForSparseBlock(
     lhsValues[index] = rhs[IDX2C(row, col, numRows)];
 }
 
+// lazy momentum SGD update of the columns of a block-column gradient, see CPUSparseMatrix::LazyNormalGrad()
+// catchUp holds [decay, moveFactor] per block.
+template <class ElemType>
+__global__ void _lazyNormalGradForSparseBlock(
+    const ElemType learnRatePerSample,
+    const ElemType momentum,
+    const bool useNesterovMomentum,
+    const size_t numRows,
+    const CUDA_LONG N, // numRows * number of blocks
+    const ElemType* gradValues,
+    const GPUSPARSE_INDEX_TYPE* blockIds,
+    const ElemType* catchUp,
+    ElemType* smoothed,
+    ElemType* val)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= N)
+        return;
+    const CUDA_LONG blockId = index / numRows;
+    const CUDA_LONG row = index - numRows * blockId;
+    const size_t i = IDX2C(row, blockIds[blockId], numRows);
+
+    val[i] -= catchUp[2 * blockId + 1] * smoothed[i];
+    const ElemType g = (1 - momentum) * learnRatePerSample * gradValues[index];
+    const ElemType s = momentum * catchUp[2 * blockId] * smoothed[i] + g;
+    smoothed[i] = s;
+    val[i] -= useNesterovMomentum ? momentum * s + g : s;
+}
+
+// lazy FSAdaGrad update of the columns of a block-column gradient, see CPUSparseMatrix::LazyFSAdagrad()
+// catchUp holds [adaDecay, momDecay, moveFactor] per block.
+template <class ElemType>
+__global__ void _lazyFSAdagradForSparseBlock(
+    const ElemType learnRatePerSample,
+    const ElemType momentum,
+    const ElemType adaWeight,
+    const ElemType adaMul,
+    const size_t numRows,
+    const CUDA_LONG N, // numRows * number of blocks
+    const ElemType* gradValues,
+    const GPUSPARSE_INDEX_TYPE* blockIds,
+    const ElemType* catchUp,
+    ElemType* smoothAda,
+    ElemType* smoothMom,
+    ElemType* val)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= N)
+        return;
+    const CUDA_LONG blockId = index / numRows;
+    const CUDA_LONG row = index - numRows * blockId;
+    const size_t i = IDX2C(row, blockIds[blockId], numRows);
+
+    ElemType g = gradValues[index];
+    ElemType adaSqr = adaWeight * catchUp[3 * blockId] * smoothAda[i] + (1.0f - adaWeight) * g * g;
+    smoothAda[i] = adaSqr;
+    if (adaSqr != 0.0f)
+    {
+        ElemType w;
+        if (sizeof(ElemType) == sizeof(double))
+            w = adaMul * rsqrt(adaSqr);
+        else
+            w = adaMul * rsqrtf(adaSqr);
+        if (w > 10.0f)
+            w = 10.0f;
+        g *= w;
+    }
+    if (momentum > 0.0f)
+    {
+        val[i] -= catchUp[3 * blockId + 2] * smoothMom[i];
+        g = momentum * catchUp[3 * blockId + 1] * smoothMom[i] + (1.0f - momentum) * g;
+        smoothMom[i] = g;
+    }
+    val[i] -= learnRatePerSample * g;
+}
+
 //This function should be called with 1024 threads per block and 1 block
 //THIS IS NOT THE MOST EFFICIENT IMPLEMENTATION!!!
 template <class ElemType>
@@ -4581,242 +5182,23 @@ __global__ void _minusOneAt(
         c[id] = c[id] - 1.0;
 }
 
-// the kernel function for CRFLSTMNetwork  backward computation
-// assume a column slice of input and output
-// This function assumes iNumLab <= 1024 and that shared memory == total (!) number of threads == 3 * iNumLab.
 template <class ElemType>
-__global__ void _rcrfBackwardComputeMax1024Labels(
-    const size_t t, // time position
-    const size_t iNumPos,
-    const ElemType* galpha,       // column slice at current time t
-    ElemType* gbeta,              // column slices with [row, 2] at current time t for [
-    const ElemType* gzeta,        // column slices with [row, 2] at current time t for [
-    const ElemType* gpair_scores, // column slice at current time t
-    const size_t iNumLab, const int shift)
+__global__ void _reductionLogAddSum(
+    const ElemType* data,
+    ElemType* sum,
+    const size_t sum_size,
+    CUDA_LONG N)
 {
-    int id = blockDim.x * blockIdx.x + threadIdx.x;
-
-    extern __shared__ double sh_alpha_and_beta[]; // [id] or [id + iNumLab] or [id + 2 * iNumLab)]
-    // need byte size = (iNumPos * iNumLab * 2 + iNumLab * iNumLab) * sizeof(ElemType)
 
-    ElemType* alpha = (ElemType*) (sh_alpha_and_beta);
-    ElemType* beta_t1 = (ElemType*) (alpha + iNumLab);
-    ElemType* zeta = (ElemType*) (beta_t1 + iNumLab);
-    ElemType pair_scores[1024];  // [j=0..iNumLab-1]
+    __shared__ ElemType partialLogAddSum[GridDim::maxThreadsPerBlock];
 
-    if (id < 0 || id >= iNumLab)
-        return;
+    int id = blockDim.x * blockIdx.x + threadIdx.x;
+    int tid = threadIdx.x;
 
-    // copy global memory to shared memory to save time
-    alpha[id] = galpha[IDX2C(id, t, iNumLab)];
-    if (t < iNumPos - 1)
-        beta_t1[id] = gbeta[IDX2C(id, t + 1, iNumLab)];
-    zeta[id] = gzeta[id];
-
-    __syncthreads();
-
-    for (int j = 0; j < iNumLab; j++)
-        pair_scores[j] = gpair_scores[IDX2C(j, id, iNumLab)];
-
-    ElemType fTmp = LZERO;
-    if (t == iNumPos - 1)
-    {
-        fTmp = alpha[id] - zeta[id];
-    }
-    else
-    {
-        for (int j = 0; j < iNumLab; j++)
-        {
-            fTmp = logaddk(fTmp, beta_t1[j] + alpha[id] + pair_scores[j] - zeta[j]);
-        }
-    }
-
-    gbeta[IDX2C(id, t, iNumLab)] = fTmp;
-}
-
-// $\zeta_t(j) = {\sum_k exp(\delta_{t-1}(k) + a_{kj}(t))}$.
-// This function assumes iNumLab <= 1024 and that shared memory == total (!) number of threads == iNumLab.
-template <class ElemType>
-__global__ void _rcrfBackwardComputeZetaMax1024Labels(
-    const size_t t, // time position
-    const size_t iNumPos,
-    const ElemType* galpha, // column slice at current time t
-    ElemType* gzeta,        // column slices with [row, 2] at current time t for [
-    const ElemType* gpair_scores,
-    const size_t iNumLab, const int shift)
-{
-    int id = blockDim.x * blockIdx.x + threadIdx.x;
-
-    extern __shared__ double sh_alpha_and_beta[]; // [id]
-    // need byte size = (iNumPos * iNumLab * 2 + iNumLab * iNumLab) * sizeof(ElemType)
-
-    ElemType* alpha = (ElemType*) (sh_alpha_and_beta);
-    ElemType pair_scores[1024]; // [j=0..iNumLab-1]
-
-    if (id < 0 || id >= iNumLab)
-        return;
-
-    // copy global memory to shared memory to save time
-    alpha[id] = galpha[IDX2C(id, t, iNumLab)];
-
-    __syncthreads();
-
-    for (int j = 0; j < iNumLab; j++)
-        pair_scores[j] = gpair_scores[IDX2C(id, j, iNumLab)];
-
-    ElemType fSum = LZERO;
-    for (int m = 0; m < iNumLab; m++)
-    {
-        if (t == iNumPos - 1)
-            fSum = logaddk(fSum, alpha[IDX2C(m, 0, iNumLab)]);
-        else
-            fSum = logaddk(fSum, alpha[IDX2C(m, 0, iNumLab)] + pair_scores[m]);
-    }
-
-    gzeta[id] = fSum;
-}
-
-/// $\zeta_t(j) = {\sum_k exp(\delta_{t-1}(k) + a_{kj}(t))}$.
-// This function assumes iNumLab <= 1024 and that shared memory == total (!) number of threads == iNumLab.
-template <class ElemType>
-__global__ void _rcrfTransGrdComputeZetaMax1024Labels(
-    const int t, // time position
-    const size_t iNumPos,
-    const ElemType* galpha, // column slice at current time t
-    ElemType* gzeta,        // column slices with [row, 2] at current time t for [
-    const ElemType* gpair_scores,
-    const size_t iNumLab,
-    const size_t start_lbl,
-    const int shift)
-{
-    int id = blockDim.x * blockIdx.x + threadIdx.x;
-
-    extern __shared__ double sh_alpha_and_beta[]; // [id]
-    // need byte size = (iNumPos * iNumLab * 2 + iNumLab * iNumLab) * sizeof(ElemType)
-
-    ElemType* alpha = (ElemType*) (sh_alpha_and_beta);
-    ElemType pair_scores[1024]; // [j=0..iNumLab-1]
-
-    if (id < 0 || id >= iNumLab)
-        return;
-
-    // copy global memory to shared memory to save time
-    if (t >= 0)
-        alpha[id] = galpha[IDX2C(id, t, iNumLab)];
-
-    __syncthreads();
-
-    for (int j = 0; j < iNumLab; j++)
-        pair_scores[j] = gpair_scores[IDX2C(id, j, iNumLab)];
-
-    ElemType fSum = LZERO;
-    ElemType fTmp;
-    for (int m = 0; m < iNumLab; m++)
-    {
-        if (t < 0)
-        {
-            if (m == start_lbl)
-                fTmp = 0;
-            else
-                fTmp = LZERO;
-        }
-        else
-            fTmp = alpha[m];
-
-        fSum = logaddk(fSum, pair_scores[m] + fTmp);
-    }
-
-    gzeta[id] = fSum;
-}
-
-// This function assumes iNumLab <= 1024 and that shared memory == total (!) number of threads == iNumLab.
-template <class ElemType>
-__global__ void _rcrfTransGrdComputeMax1024Labels(
-    int t,
-    const size_t start_lbl,
-    const ElemType* galpha,
-    const ElemType* gbeta,
-    const ElemType* gzeta,
-    const ElemType* gpair_scores,
-    const ElemType* lbls,
-    ElemType* grd,
-    const size_t iNumPos,
-    const size_t iNumLab,
-    const int shift)
-{
-    int id = blockDim.x * blockIdx.x + threadIdx.x;
-
-    extern __shared__ double sh_alpha_and_beta[]; // [id]
-    // need byte size = (iNumPos * iNumLab * 2 + iNumLab * iNumLab) * sizeof(ElemType)
-
-    ElemType* alpha = (ElemType*) (sh_alpha_and_beta);
-    ElemType* beta = (ElemType*) (alpha + iNumLab);
-    ElemType* zeta = (ElemType*) (beta + iNumLab);
-    ElemType pair_scores[1024]; // [j=0..iNumLab-1]
-
-    if (id < 0 || id >= iNumLab)
-        return;
-
-    // copy global memory to shared memory to save time
-    if (t > 0)
-        alpha[id] = galpha[IDX2C(id, t - 1, iNumLab)];
-    beta[id] = gbeta[IDX2C(id, t, iNumLab)];
-    zeta[id] = gzeta[id];
-
-    __syncthreads();
-
-    for (int j = 0; j < iNumLab; j++)
-        pair_scores[j] = gpair_scores[IDX2C(j, id, iNumLab)];
-
-    ElemType fTmp;
-    ElemType fTmp2;
-    for (int j = 0; j < iNumLab; j++)
-    {
-        if (t == 0)
-        {
-            if (id == start_lbl)
-                fTmp = 0;
-            else
-                fTmp = LZERO;
-        }
-        else
-            fTmp = alpha[id];
-
-        fTmp2 = fTmp + pair_scores[j] - zeta[j];
-        assert(fTmp2 <= 0.0);
-        fTmp2 += beta[j];
-
-        fTmp = exp(fTmp2);
-        grd[IDX2C(j, id, iNumLab)] += fTmp;
-    }
-
-    if ((t == 0 && id == start_lbl) || (t > 0 && t < iNumPos && lbls[IDX2C(id, t - 1, iNumLab)] != 0))
-    {
-        for (int ik = 0; ik < iNumLab; ik++)
-        {
-            if (lbls[IDX2C(ik, t, iNumLab)] != 0)
-                grd[IDX2C(ik, id, iNumLab)] -= 1.0;
-        }
-    }
-};
-
-template <class ElemType>
-__global__ void _reductionLogAddSum(
-    const ElemType* data,
-    ElemType* sum,
-    const size_t sum_size,
-    CUDA_LONG N)
-{
-
-    __shared__ ElemType partialLogAddSum[GridDim::maxThreadsPerBlock];
-
-    int id = blockDim.x * blockIdx.x + threadIdx.x;
-    int tid = threadIdx.x;
-
-    if (id < N)
-        partialLogAddSum[tid] = data[id];
-    else
-        partialLogAddSum[tid] = LZERO;
+    if (id < N)
+        partialLogAddSum[tid] = data[id];
+    else
+        partialLogAddSum[tid] = LZERO;
 
     __syncthreads();
 
@@ -4903,6 +5285,69 @@ __global__ void _copyTopKResults(const uint64_t* indexes, const ElemType* values
     maxValues[id] = values[icol * crow + irow];
 }
 
+// Whether element (valueA, rowA) of a column comes before (valueB, rowB) in the top-k order: by descending value, ties by row.
+template <class ElemType>
+__device__ __forceinline__ bool _isBeforeInTopK(ElemType valueA, int rowA, ElemType valueB, int rowB)
+{
+    return valueA > valueB || (valueA == valueB && rowA < rowB);
+}
+
+// Top-k of each column without sorting the matrix: one block per column, which makes topK passes over the column.
+// Each pass reduces to the first element after the one found by the previous pass, so the results are in descending order.
+// This is meant for a small topK, where it reads the column topK times but needs no workspace and a single launch.
+template <int BlockSize, class ElemType>
+__global__ void _vectorMaxTopKOfColumns(const ElemType* us, ElemType* maxIndexes, ElemType* maxValues, CUDA_LONG numRows, int topK)
+{
+    __shared__ ElemType partials[BlockSize];
+    __shared__ int partialsInd[BlockSize];
+    __shared__ ElemType previous;
+    __shared__ int previousInd;
+
+    const ElemType* column = us + (size_t)blockIdx.x * numRows;
+    for (int k = 0; k < topK; k++)
+    {
+        ElemType best = 0;
+        int bestInd = -1;
+        for (int i = threadIdx.x; i < numRows; i += BlockSize)
+        {
+            ElemType v = column[i];
+            if (k > 0 && !_isBeforeInTopK(previous, previousInd, v, i))
+                continue;
+            if (bestInd < 0 || _isBeforeInTopK(v, i, best, bestInd))
+            {
+                best = v;
+                bestInd = i;
+            }
+        }
+        partials[threadIdx.x] = best;
+        partialsInd[threadIdx.x] = bestInd;
+        __syncthreads();
+
+        for (int stride = BlockSize / 2; stride > 0; stride /= 2)
+        {
+            if (threadIdx.x < stride)
+            {
+                int other = partialsInd[threadIdx.x + stride];
+                if (other >= 0 && (partialsInd[threadIdx.x] < 0 || _isBeforeInTopK(partials[threadIdx.x + stride], other, partials[threadIdx.x], partialsInd[threadIdx.x])))
+                {
+                    partials[threadIdx.x] = partials[threadIdx.x + stride];
+                    partialsInd[threadIdx.x] = other;
+                }
+            }
+            __syncthreads();
+        }
+
+        if (threadIdx.x == 0)
+        {
+            previous = partials[0];
+            previousInd = partialsInd[0];
+            maxIndexes[k + (size_t)blockIdx.x * topK] = (ElemType)previousInd;
+            maxValues[k + (size_t)blockIdx.x * topK] = previous;
+        }
+        __syncthreads();
+    }
+}
+
 template <int BlockSize, class ElemType>
 __global__ void _assignNumOfDiffCol(const ElemType* a, const ElemType* b, ElemType* c, CUDA_LONG crowB, CUDA_LONG ccol)
 {
@@ -4948,6 +5393,310 @@ __global__ void _maskColumnsValue(ElemType* a, const char* columnsMask, CUDA_LON
         a[IDX2C(rowIdx, colIdx, numRows)] = val;
     }
 }
+
+// Computes the random values of the image augmentation, one block per output image.
+// The brightness depends on the mean of the image, which is reduced by the threads of the block.
+__global__ void _computeImageAugmentationSamples(const uint8_t* images, ImageAugmentationSample* samples,
+                                                 const ImageAugmentationParameters parameters, uint64_t seed, CUDA_LONG imageSize)
+{
+    __shared__ unsigned long long partials[GridDim::maxThreadsPerBlock];
+
+    uint32_t numViews = parameters.GetNumViews();
+    const uint8_t* image = images + (size_t)(blockIdx.x / numViews) * parameters.GetSourceImageSize();
+    uint32_t view = blockIdx.x % numViews;
+    unsigned long long sum = 0;
+    for (CUDA_LONG i = threadIdx.x; i < imageSize; i += blockDim.x)
+        sum += GetImageAugmentationSourceValue(parameters, image, view, i);
+    partials[threadIdx.x] = sum;
+    __syncthreads();
+
+    for (unsigned int halfPoint = blockDim.x / 2; halfPoint > 0; halfPoint /= 2)
+    {
+        if (threadIdx.x < halfPoint)
+            partials[threadIdx.x] += partials[threadIdx.x + halfPoint];
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+        samples[blockIdx.x] = ComputeImageAugmentationSample(parameters, seed, blockIdx.x, (float)partials[0] / imageSize);
+}
+
+// Augments a single pixel (all of its channels) per thread, blockIdx.y is the output image. With several views,
+// the pixels of all views are gathered from the same input image, which is transferred only once.
+template <class ElemType>
+__global__ void _augmentImages(const uint8_t* images, const ImageAugmentationSample* samples, const float* mean,
+                               const ImageAugmentationParameters parameters, CUDA_LONG numPixels, ElemType* output)
+{
+    CUDA_LONG pixel = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pixel >= numPixels)
+        return;
+
+    size_t imageSize = (size_t)numPixels * parameters.m_channels;
+    uint32_t numViews = parameters.GetNumViews();
+    const uint8_t* image = images + (size_t)(blockIdx.y / numViews) * parameters.GetSourceImageSize();
+    AugmentImagePixel(parameters, samples[blockIdx.y], image, blockIdx.y % numViews, mean, pixel, output + blockIdx.y * imageSize);
+}
+
+template <class ElemType, class TNarrow>
+__global__ void _assignWidenedValues(const TNarrow* source, ElemType* destination, CUDA_LONG count, ElemType scale, ElemType shift)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= count)
+        return;
+
+    destination[id] = scale * (ElemType)NarrowToFloat(source[id]) + shift;
+}
+
+template <class ElemType>
+__global__ void _assignRanksWithinQueries(ElemType* ranks, const ElemType* scores, const ElemType* gains, const ElemType* queryIds, CUDA_LONG numUrls)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numUrls)
+        return;
+
+    int begin, end;
+    GetQueryOfUrl(queryIds, numUrls, id, begin, end);
+    ranks[id] = (ElemType)GetRankWithinQuery(scores, gains, begin, end, id);
+}
+
+template <class ElemType>
+__global__ void _assignNDCGContributions(ElemType* contributions, ElemType* queryStarts, const ElemType* gains, const ElemType* ranks, const ElemType* queryIds, bool atOne, CUDA_LONG numUrls)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numUrls)
+        return;
+
+    int begin, end;
+    GetQueryOfUrl(queryIds, numUrls, id, begin, end);
+    contributions[id] = GetNDCGContribution(gains, ranks, begin, end, id, atOne);
+    queryStarts[id] = (ElemType)(id == begin ? 1 : 0);
+}
+
+template <class ElemType>
+__global__ void _addLambdaRankGradient(ElemType* gradient, const ElemType* gains, const ElemType* scores, const ElemType* ranks, const ElemType* queryIds, ElemType sigma, CUDA_LONG numUrls)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numUrls)
+        return;
+
+    int begin, end;
+    GetQueryOfUrl(queryIds, numUrls, id, begin, end);
+    gradient[id] += GetLambdaRankGradient(gains, scores, ranks, begin, end, id, sigma);
+}
+
+// The CRF steps have a thread per (sequence, label), id = s * numLabels + k.
+template <class ElemType>
+__global__ void _crfForwardStep(ElemType* alpha, const ElemType* scores, const ElemType* transitions, const ElemType* labelIndices, const ElemType* sequences, int numLabels, int stride, int t, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    CRFForwardStep(alpha, scores, transitions, labelIndices, sequences, numLabels, stride, id / numLabels, id % numLabels, t);
+}
+
+template <class ElemType>
+__global__ void _crfBackwardStep(ElemType* logPosteriors, const ElemType* alpha, const ElemType* scores, const ElemType* transitions, const ElemType* sequences, int numLabels, int stride, int t, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    CRFBackwardStep(logPosteriors, alpha, scores, transitions, sequences, numLabels, stride, id / numLabels, id % numLabels, t);
+}
+
+template <class ElemType>
+__global__ void _assignCRFNegativeLogLikelihoods(ElemType* losses, const ElemType* alpha, const ElemType* scores, const ElemType* transitions, const ElemType* labelIndices, const ElemType* sequences,
+                                                 int numLabels, int stride, CUDA_LONG numSequences)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numSequences)
+        return;
+
+    losses[id] = GetCRFNegativeLogLikelihood(alpha, scores, transitions, labelIndices, sequences, numLabels, stride, id);
+}
+
+// A thread per transition, id = k + j * numLabels, which sums over all frames; no atomics.
+template <class ElemType>
+__global__ void _assignCRFTransitionGradient(ElemType* gradient, const ElemType* logPosteriors, const ElemType* alpha, const ElemType* scores, const ElemType* transitions, const ElemType* labelIndices, const ElemType* sequences,
+                                             int numSequences, int numLabels, int stride, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    gradient[id] = GetCRFTransitionGradient(logPosteriors, alpha, scores, transitions, labelIndices, sequences, numSequences, numLabels, stride, id % numLabels, id / numLabels);
+}
+
+template <class ElemType>
+__global__ void _crfViterbiStep(ElemType* viterbiScores, ElemType* backPointers, const ElemType* scores, const ElemType* transitions, const ElemType* labelIndices, const ElemType* sequences, int numLabels, int stride, int t, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    CRFViterbiStep(viterbiScores, backPointers, scores, transitions, labelIndices, sequences, numLabels, stride, id / numLabels, id % numLabels, t);
+}
+
+template <class ElemType>
+__global__ void _crfViterbiBacktrace(ElemType* path, const ElemType* viterbiScores, const ElemType* backPointers, const ElemType* sequences, int numLabels, int stride, CUDA_LONG numSequences)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numSequences)
+        return;
+
+    CRFViterbiBacktrace(path, viterbiScores, backPointers, sequences, numLabels, stride, id);
+}
+
+// The sequence compaction kernels have a block per sequence; sequences is 2 x numSequences of (first column, number of frames).
+template <int BlockSize, class ElemType>
+__global__ void _assignNonZeroCountsOfSequences(ElemType* counts, const ElemType* a, const ElemType* sequences, int stride)
+{
+    using BlockReduceT = cub::BlockReduce<int, BlockSize>;
+    __shared__ typename BlockReduceT::TempStorage tmp;
+
+    size_t first = (size_t)sequences[2 * blockIdx.x];
+    int numFrames = (int)sequences[2 * blockIdx.x + 1];
+    int count = 0;
+    for (int t = threadIdx.x; t < numFrames; t += BlockSize)
+        count += a[first + (size_t)t * stride] != 0;
+    count = BlockReduceT(tmp).Sum(count);
+    if (threadIdx.x == 0)
+        counts[blockIdx.x] = (ElemType)count;
+}
+
+// Stream compaction of a sequence, BlockSize frames at a time: the exclusive prefix sum of the non-zero flags is the frame of the output sequence.
+template <int BlockSize, class ElemType>
+__global__ void _assignNonZeroPositionsOfSequences(ElemType* us, const ElemType* a, const ElemType* sequences, int stride, const ElemType* outputSequences, int outputStride)
+{
+    using BlockScanT = cub::BlockScan<int, BlockSize>;
+    __shared__ typename BlockScanT::TempStorage tmp;
+
+    size_t first = (size_t)sequences[2 * blockIdx.x];
+    int numFrames = (int)sequences[2 * blockIdx.x + 1];
+    size_t outputFirst = (size_t)outputSequences[2 * blockIdx.x];
+    int numOutputFrames = (int)outputSequences[2 * blockIdx.x + 1];
+    int numWritten = 0;
+    for (int t0 = 0; t0 < numFrames; t0 += BlockSize)
+    {
+        int t = t0 + threadIdx.x;
+        int isNonZero = t < numFrames && a[first + (size_t)t * stride] != 0;
+        int position, numNonZeros;
+        BlockScanT(tmp).ExclusiveSum(isNonZero, position, numNonZeros);
+        position += numWritten;
+        if (isNonZero && position < numOutputFrames)
+            us[outputFirst + (size_t)position * outputStride] = (ElemType)t;
+        numWritten += numNonZeros;
+        __syncthreads(); // (tmp is reused)
+    }
+}
+
+// a thread per frame of the index sequences, id = t + i * maxNumFrames
+template <class ElemType>
+__global__ void _assignColumnsOfSequencePositions(ElemType* us, const ElemType* positions, const ElemType* sequences, int stride, const ElemType* targetSequences, int targetStride, int maxNumFrames, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    int i = id / maxNumFrames;
+    int t = id % maxNumFrames;
+    if (t >= (int)sequences[2 * i + 1])
+        return;
+    size_t column = (size_t)sequences[2 * i] + (size_t)t * stride;
+    ElemType position = positions[column];
+    us[column] = position >= 0 && position < targetSequences[2 * i + 1] ? (ElemType)((size_t)targetSequences[2 * i] + (size_t)position * targetStride) : (ElemType)-1;
+}
+
+// a thread per sample, computing all of its components
+template <class ElemType>
+__global__ void _assignGMMLogLikelihoods(ElemType* logLikelihoods, ElemType* posteriors, const ElemType* unnormedPrior, size_t priorColumns, const ElemType* means, size_t meanColumns,
+                                         const ElemType* logStddevs, size_t stddevColumns, const ElemType* features, int numComponents, int featureDim, CUDA_LONG numSamples)
+{
+    CUDA_LONG n = blockDim.x * blockIdx.x + threadIdx.x;
+    if (n >= numSamples)
+        return;
+
+    ElemType* posterior = posteriors + (size_t)n * numComponents;
+    for (int c = 0; c < numComponents; c++)
+        posterior[c] = GetGMMComponentLogLikelihood(unnormedPrior, priorColumns, means, meanColumns, logStddevs, stddevColumns, features, numComponents, featureDim, c, (size_t)n);
+    logLikelihoods[n] = NormalizeGMMPosteriors(posterior, numComponents);
+}
+
+template <class ElemType>
+__global__ void _addGMMUnnormedPriorGradient(ElemType* us, const ElemType* gradient, const ElemType* unnormedPrior, size_t priorColumns, const ElemType* posteriors,
+                                             int numComponents, size_t numSamples, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    us[id] += GetGMMUnnormedPriorGradient(gradient, unnormedPrior, priorColumns, posteriors, numComponents, numSamples, id % numComponents, (size_t)(id / numComponents));
+}
+
+template <class ElemType>
+__global__ void _addGMMMeanGradient(ElemType* us, const ElemType* gradient, const ElemType* means, size_t meanColumns, const ElemType* logStddevs, size_t stddevColumns, const ElemType* features,
+                                    const ElemType* posteriors, int numComponents, int featureDim, size_t numSamples, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    int numRows = numComponents * featureDim;
+    us[id] += GetGMMMeanGradient(gradient, means, meanColumns, logStddevs, stddevColumns, features, posteriors, numComponents, featureDim, numSamples, id % numRows, (size_t)(id / numRows));
+}
+
+template <class ElemType>
+__global__ void _addGMMLogStddevGradient(ElemType* us, const ElemType* gradient, const ElemType* means, size_t meanColumns, const ElemType* logStddevs, size_t stddevColumns, const ElemType* features,
+                                         const ElemType* posteriors, int numComponents, int featureDim, size_t numSamples, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    us[id] += GetGMMLogStddevGradient(gradient, means, meanColumns, logStddevs, stddevColumns, features, posteriors, numComponents, featureDim, numSamples, id % numComponents, (size_t)(id / numComponents));
+}
+
+template <class ElemType>
+__global__ void _addGMMFeatureGradient(ElemType* us, const ElemType* gradient, const ElemType* means, size_t meanColumns, const ElemType* logStddevs, size_t stddevColumns, const ElemType* features,
+                                       const ElemType* posteriors, int numComponents, int featureDim, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    us[id] += GetGMMFeatureGradient(gradient, means, meanColumns, logStddevs, stddevColumns, features, posteriors, numComponents, featureDim, id % featureDim, (size_t)(id / featureDim));
+}
+
+template <class ElemType>
+__global__ void _assignSimilaritiesWithNegativeSamples(ElemType* us, ElemType* documents, const ElemType* similarities, int shift, int numNegatives, bool inBatchNegatives, CUDA_LONG numCols)
+{
+    CUDA_LONG j = blockDim.x * blockIdx.x + threadIdx.x;
+    if (j >= numCols)
+        return;
+
+    size_t numRows = numNegatives + 1;
+    AssignSimilaritiesWithNegativeSamplesOfQuery(us + j * numRows, documents + j * numRows, similarities, numCols, shift, numNegatives, inBatchNegatives, j);
+}
+
+template <class ElemType>
+__global__ void _addNegativeSamplesGradientMatrix(ElemType* us, const ElemType* gradient, const ElemType* documents, int numRows, CUDA_LONG numCols)
+{
+    CUDA_LONG j = blockDim.x * blockIdx.x + threadIdx.x;
+    if (j >= numCols)
+        return;
+
+    AddNegativeSamplesGradientOfQuery(us, gradient, documents, numCols, numRows, j);
+}
+
+template <class ElemType>
+__global__ void _addColumnNormalizationGradient(ElemType* us, const ElemType* gradientOfNormalized, const ElemType* normalized, const ElemType* invNorms, int numRows, CUDA_LONG numCols)
+{
+    CUDA_LONG j = blockDim.x * blockIdx.x + threadIdx.x;
+    if (j >= numCols)
+        return;
+
+    AddColumnNormalizationGradientOfColumn(us, gradientOfNormalized, normalized, invNorms, numRows, j);
+}
 }
 }
 }
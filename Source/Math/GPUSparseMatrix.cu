@@ -165,6 +165,13 @@ void GPUSparseMatrix<ElemType>::SetValue(const CPUSparseMatrix<ElemType>& deepCo
     {
         SetMatrixFromCSCFormat(deepCopy.ColLocation(), deepCopy.RowLocation(), deepCopy.Data(), deepCopy.GetNumElemAllocated(), deepCopy.GetNumRows(), deepCopy.GetNumCols());
     }
+    else if (deepCopy.GetFormat() == matrixFormatSparseBlockCol)
+    {
+        std::vector<size_t> blockIds;
+        std::vector<ElemType> val;
+        deepCopy.GetMatrixFromSBCFormat(blockIds, val);
+        SetMatrixFromSBCFormat(blockIds.data(), val.data(), blockIds.size(), deepCopy.GetNumRows(), deepCopy.GetNumCols());
+    }
     else
         NOT_IMPLEMENTED;
 }
@@ -317,6 +324,14 @@ void GPUSparseMatrix<ElemType>::ConvertToSparseFormat(MatrixFormat newFormat, GP
         return;
     }
 
+    // the compressed index of a column slice counts from the start of the full matrix
+    if (m_sliceViewOffset > 0)
+    {
+        GPUSparseMatrix<ElemType> rebased(*this);
+        rebased.ConvertToSparseFormat(newFormat, outMatrix);
+        return;
+    }
+
     PrepareDevice();
     cusparseHandle_t cusparseHandle = 0;
     CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
@@ -324,22 +339,28 @@ void GPUSparseMatrix<ElemType>::ConvertToSparseFormat(MatrixFormat newFormat, GP
     SyncGuard syncGuard;
     CUSPARSE_CALL(cusparseSetStream(cusparseHandle, t_stream));
 
+    int nz = (int) NzCount();
     outMatrix.ChangeDeviceTo(GetComputeDeviceId());
-    outMatrix.RequireSizeAndAllocate(GetNumRows(), GetNumCols(), NzCount(), newFormat, true, false);
+    outMatrix.RequireSizeAndAllocate(GetNumRows(), GetNumCols(), nz, newFormat, true, false);
 
+    // The CSR arrays of a matrix are the CSC arrays of its transpose, hence csr2csc converts either way, with the dimensions
+    // and the index arrays swapped for CSC -> CSR.
     if ((oldFormat == matrixFormatSparseCSR && newFormat == matrixFormatSparseCSC) || (oldFormat == matrixFormatSparseCSC && newFormat == matrixFormatSparseCSR))
     {
+        const bool fromCSR = oldFormat == matrixFormatSparseCSR;
+        int numOuter = (int) (fromCSR ? GetNumRows() : GetNumCols());
+        int numInner = (int) (fromCSR ? GetNumCols() : GetNumRows());
         if (sizeof(ElemType) == sizeof(float))
         {
-            CUSPARSE_CALL(cusparseScsr2csc(cusparseHandle, int(GetNumRows()), int(GetNumCols()), int(GetSizeAllocated()),
-                                           (float*) Data(), RowLocation(), ColLocation(), (float*) outMatrix.Data(),
-                                           outMatrix.RowLocation(), outMatrix.ColLocation(), CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO));
+            CUSPARSE_CALL(cusparseScsr2csc(cusparseHandle, numOuter, numInner, nz,
+                                           (float*) Data(), SecondaryIndexLocation(), MajorIndexLocation(), (float*) outMatrix.Data(),
+                                           outMatrix.MajorIndexLocation(), outMatrix.SecondaryIndexLocation(), CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO));
         }
         else
         {
-            CUSPARSE_CALL(cusparseDcsr2csc(cusparseHandle, int(GetNumRows()), int(GetNumCols()), int(GetSizeAllocated()),
-                                           (double*) Data(), RowLocation(), ColLocation(), (double*) outMatrix.Data(),
-                                           outMatrix.RowLocation(), outMatrix.ColLocation(), CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO));
+            CUSPARSE_CALL(cusparseDcsr2csc(cusparseHandle, numOuter, numInner, nz,
+                                           (double*) Data(), SecondaryIndexLocation(), MajorIndexLocation(), (double*) outMatrix.Data(),
+                                           outMatrix.MajorIndexLocation(), outMatrix.SecondaryIndexLocation(), CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO));
         }
     }
     else
@@ -369,6 +390,30 @@ void GPUSparseMatrix<ElemType>::ConvertToSparseFormat(MatrixFormat newFormat)
     *this = std::move(tempMatrix);
 }
 
+// OtherCompressedFormat - the matrix in the other compressed format, CSR for CSC and vice versa, for the products that are
+// only fast in that format. It is derived on first use and kept with the storage until the next write, such that e.g. all
+// products with the same minibatch of sparse input convert it once. Column slices that do not start at 0 convert every time.
+template <class ElemType>
+shared_ptr<GPUSparseMatrix<ElemType>> GPUSparseMatrix<ElemType>::OtherCompressedFormat() const
+{
+    if (GetFormat() != matrixFormatSparseCSC && GetFormat() != matrixFormatSparseCSR)
+        LogicError("OtherCompressedFormat: Only the CSC and CSR formats have a counterpart.");
+
+    MatrixFormat otherFormat = GetFormat() == matrixFormatSparseCSC ? matrixFormatSparseCSR : matrixFormatSparseCSC;
+    if (m_sliceViewOffset == 0)
+    {
+        auto cached = static_pointer_cast<GPUSparseMatrix<ElemType>>(GetOtherFormat());
+        if (cached && cached->GetFormat() == otherFormat && cached->GetComputeDeviceId() == GetComputeDeviceId())
+            return cached;
+    }
+
+    auto other = make_shared<GPUSparseMatrix<ElemType>>(GetComputeDeviceId(), otherFormat);
+    ConvertToSparseFormat(otherFormat, *other);
+    if (m_sliceViewOffset == 0)
+        SetOtherFormat(other);
+    return other;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType> GPUSparseMatrix<ElemType>::CopyToDenseMatrix() const
 {
@@ -529,6 +574,20 @@ GPUSPARSE_INDEX_TYPE* GPUSparseMatrix<ElemType>::GetCondensedVector() const
     }
 }
 
+// CSC matrix with column j the indicator of row rowIndices[j], built on the device, see Matrix::AssignOneHotColumns()
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::AssignOneHotColumns(const GPUMatrix<ElemType>& rowIndices, size_t numRows)
+{
+    VerifyWritable(__FUNCTION__);
+
+    size_t n = rowIndices.GetNumElements();
+    PrepareDevice();
+    RequireCompactCSCLayout(numRows, n, n);
+    CUDA_LONG blocksPerGrid = (CUDA_LONG) ceil((n + 1) * 1.0 / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _assignOneHotColumnsCSC<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(rowIndices.Data(), Data(), RowLocation(), ColLocation(), (CUDA_LONG) n);
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MaskColumnsValue(const GPUMatrix<char>& columnsMask, ElemType val)
 {
@@ -719,6 +778,7 @@ void GPUSparseMatrix<ElemType>::RequireSizeAndAllocate(const size_t numRows, con
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::RequireSizeAndAllocate(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve, const MatrixFormat matrixFormat, const bool growOnly /*= true*/, bool keepExistingValues /*= true*/)
 {
+    InvalidateOtherFormat();
     RequireSize(numRows, numCols, matrixFormat, growOnly);
     
     size_t bufferSizeNeeded = BufferSizeNeeded(numRows, numCols, numNZElemToReserve, matrixFormat);
@@ -729,6 +789,33 @@ void GPUSparseMatrix<ElemType>::RequireSizeAndAllocate(const size_t numRows, con
 
 }
 
+// RequireCompactCSCLayout - lays the matrix out in CSC format for exactly nz elements, i.e. the values, row indices and column
+// starts back to back. The buffer is reallocated only to grow, with headroom such that a slowly growing nz (as from minibatch
+// to minibatch) rarely reallocates, and it is not cleared, as the caller writes all of the layout.
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::RequireCompactCSCLayout(const size_t numRows, const size_t numCols, const size_t nz)
+{
+    VerifyResizable(__FUNCTION__);
+    InvalidateOtherFormat();
+
+    size_t bufferSizeNeeded = BufferSizeNeeded(numRows, numCols, nz, matrixFormatSparseCSC);
+    if (BufferSizeAllocated() < bufferSizeNeeded)
+    {
+        size_t bufferSize = bufferSizeNeeded + bufferSizeNeeded / 4;
+        if (Buffer() != nullptr)
+            TracingGPUMemoryAllocator::Free<ElemType>(GetComputeDeviceId(), Buffer());
+        SetBuffer(reinterpret_cast<ElemType*>(TracingGPUMemoryAllocator::Allocate<char>(GetComputeDeviceId(), bufferSize)), bufferSize);
+    }
+
+    m_sliceViewOffset = 0;
+    SetFormat(matrixFormatSparseCSC);
+    SetNumRows(numRows);
+    SetNumCols(numCols);
+    SetNumStorageRows(numRows);
+    SetNumStorageCols(numCols);
+    SetSizeAllocated(nz);
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::RequireSize(const size_t numRows, const size_t numCols, const bool growOnly /*= true*/)
 {
@@ -752,6 +839,7 @@ template <class ElemType>
 void GPUSparseMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve, const MatrixFormat matrixFormat, const bool growOnly /*= true*/)
 {
     VerifyResizable(__FUNCTION__);
+    InvalidateOtherFormat();
 
     m_sliceViewOffset = 0;
     SetNumRows(numRows);
@@ -792,6 +880,7 @@ void GPUSparseMatrix<ElemType>::ClearNzCount()
     //    1. We must clear the secondary column index.
     //    2. Set the block size to 0.
     // These requirements can be deduced by the NzCount method.
+    InvalidateOtherFormat();
     CUDA_CALL(cudaMemset(Buffer(), 0, BufferSizeAllocated()));
     SetBlockSize(0);
 }
@@ -891,12 +980,31 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
         LogicError("SetMatrixFromCSCFormat: nullptr passed in.");
 
     SetComputeDeviceId(PrepareDevice(devId));
-    SetFormat(matrixFormatSparseCSC);
-    RequireSizeAndAllocate(numRows, numCols, nz, true, false);
 
     if (transferer && IsOnDevice)
         RuntimeError("Currently it is prohibited to copy data asynchronous from device to device.");
 
+    // The readers pack the values, row indices and column starts back to back (see ReaderShim::FillMatrixFromStream),
+    // which is our layout for exactly nz elements, hence they take a single transfer into a buffer that is not cleared.
+    if (!IsOnDevice && sizeof(CPUSPARSE_INDEX_TYPE) == sizeof(GPUSPARSE_INDEX_TYPE) &&
+        reinterpret_cast<const CPUSPARSE_INDEX_TYPE*>(h_Val + nz) == h_Row && h_Row + nz == h_CSCCol)
+    {
+        RequireCompactCSCLayout(numRows, numCols, nz);
+        size_t size = BufferSizeNeeded(numRows, numCols, nz, matrixFormatSparseCSC);
+        if (transferer)
+        {
+            transferer->RecordComputeStreamSyncPoint();
+            transferer->WaitForSyncPointOnAssignStreamAsync();
+            transferer->CopyCPUToGPUAsync(h_Val, 1, size, Buffer());
+        }
+        else
+            CUDA_CALL(cudaMemcpy(Buffer(), h_Val, size, cudaMemcpyHostToDevice));
+        return;
+    }
+
+    SetFormat(matrixFormatSparseCSC);
+    RequireSizeAndAllocate(numRows, numCols, nz, true, false);
+
     // m_nz doesn't exist anymore. How are we going to deal with the NzSize, RowSize, and ColSize? Do it ourselves of course.
 
     cudaMemcpyKind kind = IsOnDevice ? cudaMemcpyDeviceToDevice : cudaMemcpyHostToDevice;
@@ -947,41 +1055,37 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
     }
 }
 
-#if 0 // add it back with test
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols)
 {
     VerifyWritable(__FUNCTION__);
 
-    if (blockIds == nullptr || val == nullptr)
+    if (numBlocks > 0 && (blockIds == nullptr || val == nullptr))
         LogicError("SetMatrixFromSBCFormat: nullptr passed in.");
 
     SetFormat(matrixFormatSparseBlockCol);
     SetBlockSize(numBlocks);
 
-    if (numBlocks == 0) return; // ====>
-
     size_t nz = numBlocks * numRows;
     RequireSizeAndAllocate(numRows, numCols, nz, true, false);
 
-    static std::vector<GPUSPARSE_INDEX_TYPE> gpuBlockId2Col(numBlocks);
-    static std::vector<GPUSPARSE_INDEX_TYPE> gpuCol2BlockId(numCols);
-
-    std::fill(gpuBlockId2Col.begin(), gpuBlockId2Col.end(), Id_NotAssigned);
-    std::fill(gpuCol2BlockId.begin(), gpuCol2BlockId.end(), Id_NotAssigned);
-
-    #pragma omp parallel for
-    for (int i = 0; i < numBlocks; ++i)
+    // both maps span all columns, as the kernels that accumulate into the matrix (MultiplyAndAdd()) expect
+    std::vector<GPUSPARSE_INDEX_TYPE> gpuBlockId2Col(numCols, Id_NotAssigned);
+    std::vector<GPUSPARSE_INDEX_TYPE> gpuCol2BlockId(numCols, Id_NotAssigned);
+    for (size_t i = 0; i < numBlocks; ++i)
     {
-        gpuBlockId2Col[i] = (GPUSPARSE_INDEX_TYPE)blockIds[i];
-        gpuCol2BlockId[blockIds[i]] = i;
+        if (blockIds[i] >= numCols)
+            LogicError("SetMatrixFromSBCFormat: Block id %d out of range for a matrix of %d columns.", (int) blockIds[i], (int) numCols);
+        gpuBlockId2Col[i] = (GPUSPARSE_INDEX_TYPE) blockIds[i];
+        gpuCol2BlockId[blockIds[i]] = (GPUSPARSE_INDEX_TYPE) i;
     }
 
-    CUDA_CALL(cudaMemcpy(Data(), val, nz * sizeof(ElemType), cudaMemcpyHostToDevice));
-    CUDA_CALL(cudaMemcpy(BlockId2ColOrRow(), &gpuBlockId2Col[0], numBlocks * sizeof(GPUSPARSE_INDEX_TYPE), cudaMemcpyHostToDevice));
-    CUDA_CALL(cudaMemcpy(ColOrRow2BlockId(), &gpuCol2BlockId[0], numBlocks * sizeof(GPUSPARSE_INDEX_TYPE), cudaMemcpyHostToDevice));
+    PrepareDevice();
+    if (nz > 0)
+        CUDA_CALL(cudaMemcpy(Data(), val, nz * sizeof(ElemType), cudaMemcpyHostToDevice));
+    CUDA_CALL(cudaMemcpy(BlockId2ColOrRow(), gpuBlockId2Col.data(), numCols * sizeof(GPUSPARSE_INDEX_TYPE), cudaMemcpyHostToDevice));
+    CUDA_CALL(cudaMemcpy(ColOrRow2BlockId(), gpuCol2BlockId.data(), numCols * sizeof(GPUSPARSE_INDEX_TYPE), cudaMemcpyHostToDevice));
 }
-#endif
 
 // this function will allocate memory while the caller needs to release it
 template <class ElemType>
@@ -1060,15 +1164,29 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
         c.VerifySize(m, n); // Can't resize if beta != 0
 
     c.PrepareDevice();
-    if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC)
+    if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC && !transposeA && !transposeB)
+    {
+        // gather and sum the columns of lhs selected by each column of rhs, e.g. the embedding lookup of one-hot inputs
+        dim3 blocksPerGrid(n, (int) ceil(1.0 * m / SPARSE_GATHER_THREADS_PER_BLOCK));
+        SyncGuard syncGuard;
+        _denseGatherSparseCSCAndWeightedAddToDense<ElemType><<<blocksPerGrid, SPARSE_GATHER_THREADS_PER_BLOCK, 0, t_stream>>>(
+            m,
+            alpha,
+            reinterpret_cast<const ElemType*>(lhs.Data()),   // dense
+            reinterpret_cast<const ElemType*>(rhs.Buffer()), // sparse nz values. Note that because of the offsets we use the array
+            rhs.RowLocation(),
+            rhs.ColLocation(),
+            beta,
+            reinterpret_cast<ElemType*>(c.Data()) // dense target
+            );
+    }
+    else if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC)
     {
         ConvolveAndWeightedAdd(alpha, lhs, transposeA, rhs, transposeB, beta, c, 1, 1, false, false);
     }
     else if (rhs.GetFormat() == matrixFormatSparseCSR)
     {
-        GPUSparseMatrix<ElemType> tempMatrix(rhs.GetComputeDeviceId(), matrixFormatSparseCSC);
-        rhs.ConvertToSparseFormat(matrixFormatSparseCSC, tempMatrix);
-        MultiplyAndWeightedAdd(alpha, lhs, transposeA, tempMatrix, transposeB, beta, c);
+        MultiplyAndWeightedAdd(alpha, lhs, transposeA, *rhs.OtherCompressedFormat(), transposeB, beta, c);
     }
     else
     {
@@ -1247,7 +1365,9 @@ void GPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const GPUMatrix<E
     }
     else if (!transposeA && transposeB)
     {
-        if (rhs.GetFormat() != matrixFormatSparseCSC)
+        if (rhs.GetFormat() == matrixFormatSparseCSR)
+            return MultiplyAndAdd(alpha, lhs, transposeA, *rhs.OtherCompressedFormat(), transposeB, c);
+        else if (rhs.GetFormat() != matrixFormatSparseCSC)
             NOT_IMPLEMENTED;
 
         c.SetFormat(matrixFormatSparseBlockCol);
@@ -1275,9 +1395,20 @@ void GPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const GPUMatrix<E
         _findColsWithValues<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
             rhs.RowLocation(), c.ColOrRow2BlockId(), rhs_nz);
                 
-        blocksPerGrid = (int) ceil(((double) n) / GridDim::maxThreadsPerBlock);
-        _determineBlockIds<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
-            c.BlockId2ColOrRow(), c.ColOrRow2BlockId(), n, blockSize);
+        // With deterministic reductions, the blocks are numbered in the order of their columns, and each value of the
+        // result adds up its products in a fixed order, instead of with atomicAdd().
+        bool deterministic = DeterministicReductions::IsEnabled();
+        if (deterministic)
+        {
+            _determineBlockIdsInOrder<ElemType><<<1, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                c.BlockId2ColOrRow(), c.ColOrRow2BlockId(), n, blockSize);
+        }
+        else
+        {
+            blocksPerGrid = (int) ceil(((double) n) / GridDim::maxThreadsPerBlock);
+            _determineBlockIds<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                c.BlockId2ColOrRow(), c.ColOrRow2BlockId(), n, blockSize);
+        }
 
         size_t blockSizeCurr;
         CUDA_CALL(cudaMemcpy(&blockSizeCurr, blockSize, sizeof(size_t), cudaMemcpyDeviceToHost));
@@ -1292,6 +1423,25 @@ void GPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const GPUMatrix<E
             CUDA_CALL(cudaMemset(c.Data() + m * blockSizePrev, 0, sizeof(ElemType) * m * (blockSizeCurr - blockSizePrev)));
         }
 
+        if (deterministic)
+        {
+            // the rows of rhs are the columns of the result (the CSR format is kept with rhs, see OtherCompressedFormat())
+            auto rhsCSR = rhs.OtherCompressedFormat();
+            LONG64 N = (LONG64) m * blockSizeCurr; // here we process for each row in lhs and each block of the result
+            blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+            _denseMulSparseCSRTransposeToSparseBlockCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                alpha,
+                lhs.Data(),
+                m,
+                blockSizeCurr,
+                rhsCSR->Data(),
+                rhsCSR->RowLocation(),
+                rhsCSR->ColLocation(),
+                c.BlockId2ColOrRow(),
+                c.Data());
+            return;
+        }
+
         LONG64 N = (LONG64) lhs.GetNumElements(); // here we process for each row in lhs and each column in rhs (==columns in lhs)
         blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
         _denseMulSparseCSCTransposeToSparseBlockCol2<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
@@ -1500,14 +1650,91 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
     }
 }
 
+// lazy momentum SGD update of the columns of this block-column gradient, see CPUSparseMatrix::LazyNormalGrad()
+// The per-column catch-up factors are computed on the host, which keeps the time stamps.
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::LazyNormalGrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                                               const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum)
+{
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        RuntimeError("GPUSparseMatrix::LazyNormalGrad() only supports the block-column sparse format.");
+    if (c.IsEmpty())
+    {
+        c.RequireSize(GetNumRows(), GetNumCols());
+        c.SetValue(0.0);
+    }
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != GetNumCols() || functionValues.GetNumRows() != GetNumRows() || functionValues.GetNumCols() != GetNumCols())
+        LogicError("GPUSparseMatrix::LazyNormalGrad(): Dimensions of smoothed gradient and model must match the gradient.");
+    size_t numBlocks = GetBlockSize();
+    if (numBlocks == 0)
+        return;
+
+    vector<GPUSPARSE_INDEX_TYPE> blockIds(numBlocks);
+    CUDA_CALL(cudaMemcpy(blockIds.data(), BlockId2ColOrRow(), numBlocks * sizeof(GPUSPARSE_INDEX_TYPE), cudaMemcpyDeviceToHost));
+    vector<ElemType> catchUp(2 * numBlocks); // [decay, moveFactor] per block
+    for (size_t j = 0; j < numBlocks; j++)
+    {
+        GetLazyMomentumCatchUp(momentum, GetLazyUpdateSkippedSteps(lastUpdates, GetNumCols(), blockIds[j], updateCount), catchUp[2 * j], catchUp[2 * j + 1]);
+        if (useNesterovMomentum)
+            catchUp[2 * j + 1] *= momentum;
+    }
+    GPUMatrix<ElemType> catchUpFactors(2, numBlocks, GetComputeDeviceId());
+    catchUpFactors.SetValue(2, numBlocks, GetComputeDeviceId(), catchUp.data());
+
+    SyncGuard syncGuard;
+    CUDA_LONG N = (CUDA_LONG) (GetNumRows() * numBlocks);
+    int blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+    _lazyNormalGradForSparseBlock<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(
+        learnRatePerSample, momentum, useNesterovMomentum, GetNumRows(), N, Data(), BlockId2ColOrRow(), catchUpFactors.Data(), c.Data(), functionValues.Data());
+}
+
+// lazy FSAdaGrad update of the columns of this block-column gradient, see CPUSparseMatrix::LazyFSAdagrad()
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::LazyFSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                                              ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        RuntimeError("GPUSparseMatrix::LazyFSAdagrad() only supports the block-column sparse format.");
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || c.GetNumCols() < numColsNeeded)
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded || functionValues.GetNumRows() != GetNumRows() || functionValues.GetNumCols() != GetNumCols())
+        LogicError("GPUSparseMatrix::LazyFSAdagrad(): Dimensions of smoothed gradient and model must match the gradient.");
+    size_t numBlocks = GetBlockSize();
+    if (numBlocks == 0)
+        return;
+
+    vector<GPUSPARSE_INDEX_TYPE> blockIds(numBlocks);
+    CUDA_CALL(cudaMemcpy(blockIds.data(), BlockId2ColOrRow(), numBlocks * sizeof(GPUSPARSE_INDEX_TYPE), cudaMemcpyDeviceToHost));
+    vector<ElemType> catchUp(3 * numBlocks); // [adaDecay, momDecay, moveFactor] per block
+    for (size_t j = 0; j < numBlocks; j++)
+    {
+        size_t skipped = GetLazyUpdateSkippedSteps(lastUpdates, GetNumCols(), blockIds[j], updateCount);
+        ElemType unused;
+        GetLazyMomentumCatchUp(adaWeight, skipped, catchUp[3 * j], unused);
+        GetLazyMomentumCatchUp(momentum > 0 ? momentum : 0, skipped, catchUp[3 * j + 1], catchUp[3 * j + 2]);
+        catchUp[3 * j + 2] *= learnRatePerSample;
+    }
+    GPUMatrix<ElemType> catchUpFactors(3, numBlocks, GetComputeDeviceId());
+    catchUpFactors.SetValue(3, numBlocks, GetComputeDeviceId(), catchUp.data());
+
+    SyncGuard syncGuard;
+    size_t n = GetNumRows() * GetNumCols();
+    CUDA_LONG N = (CUDA_LONG) (GetNumRows() * numBlocks);
+    int blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+    _lazyFSAdagradForSparseBlock<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(
+        learnRatePerSample, momentum, adaWeight, adaMul, GetNumRows(), N, Data(), BlockId2ColOrRow(), catchUpFactors.Data(),
+        c.Data(), c.Data() + n, functionValues.Data());
+}
+
 // sparse X dense = dense
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const bool transposeA,
                                                        const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c)
 {
-    if (transposeB)
-        NOT_IMPLEMENTED;
-
     // Note: This function is written for 'a' being in CSR format. If 'a' is CSC, we reinterpret it as CSR by transposing it.
     if (a.GetFormat() != matrixFormatSparseCSR && a.GetFormat() != matrixFormatSparseCSC)
         NOT_IMPLEMENTED;
@@ -1516,6 +1743,20 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || (b.GetComputeDeviceId() != a.GetComputeDeviceId()))
         RuntimeError("MultiplyAndWeightedAdd: All matrices must be on the same GPU");
 
+    // cuSPARSE is fast only for a non-transposed CSR matrix, and only then takes a transposed dense matrix. Otherwise we
+    // use the cached counterpart of 'a' in the other format (unless 'a' is a column slice, which would convert every time).
+    bool transposeCSR = transposeA != reinterpretAsCSR;
+    if (transposeCSR && a.m_sliceViewOffset == 0)
+    {
+        MultiplyAndWeightedAdd(alpha, *a.OtherCompressedFormat(), transposeA, b, transposeB, beta, c);
+        return;
+    }
+    if (transposeCSR && transposeB)
+    {
+        MultiplyAndWeightedAdd(alpha, a, transposeA, b.Transpose(), false, beta, c);
+        return;
+    }
+
     a.PrepareDevice();
     cusparseHandle_t cusparseHandle = 0;
     CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
@@ -1524,9 +1765,10 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     cusparseSetMatType(descr, CUSPARSE_MATRIX_TYPE_GENERAL);
     cusparseSetMatIndexBase(descr, CUSPARSE_INDEX_BASE_ZERO);
 
-    cusparseOperation_t oper = (transposeA != reinterpretAsCSR) ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE;
+    cusparseOperation_t oper = transposeCSR ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE;
+    cusparseOperation_t operB = transposeB ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE;
 
-    int n = (int)b.GetNumCols();
+    int n = (int)(transposeB ? b.GetNumRows() : b.GetNumCols());
     int m = (int)(reinterpretAsCSR ? a.GetNumCols() : a.GetNumRows());
     int k = (int)(reinterpretAsCSR ? a.GetNumRows() : a.GetNumCols());
     assert(n == (int) c.GetNumCols());
@@ -1537,15 +1779,15 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     SyncGuard syncGuard;
     if (sizeof(ElemType) == sizeof(float))
     {
-        CUSPARSE_CALL(cusparseScsrmm(cusparseHandle, oper, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<float*>(&alpha), descr, reinterpret_cast<const float*>(a.Buffer()),
-                                     aRowLocation, aColLocation, reinterpret_cast<float*>(b.Data()),
-                                     (int) b.GetNumRows(), reinterpret_cast<float*>(&beta), reinterpret_cast<float*>(c.Data()), (int) c.GetNumRows()));
+        CUSPARSE_CALL(cusparseScsrmm2(cusparseHandle, oper, operB, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<float*>(&alpha), descr, reinterpret_cast<const float*>(a.Buffer()),
+                                      aRowLocation, aColLocation, reinterpret_cast<float*>(b.Data()),
+                                      (int) b.GetNumRows(), reinterpret_cast<float*>(&beta), reinterpret_cast<float*>(c.Data()), (int) c.GetNumRows()));
     }
     else
     {
-        CUSPARSE_CALL(cusparseDcsrmm(cusparseHandle, oper, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<double*>(&alpha), descr, reinterpret_cast<const double*>(a.Buffer()),
-                                     aRowLocation, aColLocation, reinterpret_cast<double*>(b.Data()),
-                                     (int) b.GetNumRows(), reinterpret_cast<double*>(&beta), reinterpret_cast<double*>(c.Data()), (int) c.GetNumRows()));
+        CUSPARSE_CALL(cusparseDcsrmm2(cusparseHandle, oper, operB, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<double*>(&alpha), descr, reinterpret_cast<const double*>(a.Buffer()),
+                                      aRowLocation, aColLocation, reinterpret_cast<double*>(b.Data()),
+                                      (int) b.GetNumRows(), reinterpret_cast<double*>(&beta), reinterpret_cast<double*>(c.Data()), (int) c.GetNumRows()));
     }
     CUSPARSE_CALL(cusparseDestroy(cusparseHandle));
 }
@@ -1863,45 +2105,21 @@ ElemType GPUSparseMatrix<ElemType>::InnerProductOfMatrices(const GPUSparseMatrix
     if (a.GetComputeDeviceId() != b.GetComputeDeviceId())
         RuntimeError("a and b must be on the same device");
 
+    // the dot product below works on the columns, hence a CSR matrix is taken in its (cached) CSC form
+    if (a.GetFormat() == matrixFormatSparseCSR)
+        return InnerProductOfMatrices(*a.OtherCompressedFormat(), b);
+
     int m = (int) a.GetNumRows();
     int n = (int) a.GetNumCols();
-    int nnz = (int) a.GetNumNZElements();
 
-    ElemType* cscValA = nullptr;
-    GPUSPARSE_INDEX_TYPE* cscRowIndA = nullptr;
-    GPUSPARSE_INDEX_TYPE* cscColPtrA = nullptr;
+    ElemType* cscValA = (ElemType*) a.Data();
+    GPUSPARSE_INDEX_TYPE* cscRowIndA = a.RowLocation();
+    GPUSPARSE_INDEX_TYPE* cscColPtrA = a.ColLocation();
 
-    cusparseAction_t cpVals = CUSPARSE_ACTION_NUMERIC;
     cusparseIndexBase_t idxBase = CUSPARSE_INDEX_BASE_ZERO;
     cusparseHandle_t cusparseHandle = 0;
+    CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
 
-    if (a.GetFormat() == matrixFormatSparseCSR) // need to put a in ColumnMajor format
-    {
-        cscValA = TracingGPUMemoryAllocator::Allocate<ElemType>(a.GetComputeDeviceId(), nnz);
-        cscRowIndA = TracingGPUMemoryAllocator::Allocate<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), nnz);
-        cscColPtrA = TracingGPUMemoryAllocator::Allocate<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), (n + 1));
-
-        CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
-        SyncGuard syncGuard;
-        if (sizeof(ElemType) == sizeof(float))
-        {
-            CUSPARSE_CALL(cusparseScsr2csc(cusparseHandle, m, n, nnz, reinterpret_cast<const float*>(a.Data()), a.RowLocation(), a.ColLocation(), reinterpret_cast<float*>(cscValA), cscRowIndA, cscColPtrA, cpVals, idxBase));
-        }
-        else
-        {
-            CUSPARSE_CALL(cusparseDcsr2csc(cusparseHandle, m, n, nnz, reinterpret_cast<const double*>(a.Data()), a.RowLocation(), a.ColLocation(), reinterpret_cast<double*>(cscValA), cscRowIndA, cscColPtrA, cpVals, idxBase));
-        }
-    }
-    else if (a.GetFormat() == matrixFormatSparseCSC)
-    {
-        cscValA = (ElemType*) a.Data();
-        cscRowIndA = a.RowLocation();
-        cscColPtrA = a.ColLocation();
-    }
-    else
-    {
-        NOT_IMPLEMENTED;
-    }
     let a_nz = a.NzCount();
     // Given sparse matrix in column major format, calculate indices for corresponding sparse vector
     GPUSPARSE_INDEX_TYPE* vectArray = TracingGPUMemoryAllocator::Allocate<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), a_nz);
@@ -1911,8 +2129,6 @@ ElemType GPUSparseMatrix<ElemType>::InnerProductOfMatrices(const GPUSparseMatrix
     int blocksPerGrid = (int) ceil(1.0 * M / GridDim::maxThreadsPerBlock);
     SyncGuard syncGuard;
     _getSparseVectorRepresntationForCSCMatrix<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(cscColPtrA, cscRowIndA, vectArray, M, N);
-    TracingGPUMemoryAllocator::Free<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), cscRowIndA);
-    TracingGPUMemoryAllocator::Free<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), cscColPtrA);
     // CUDA_CALL(cudaMemcpy(h_vectArray,vectArray,sizeof(GPUSPARSE_INDEX_TYPE)*a.m_nz,cudaMemcpyDeviceToHost));
 
     // Actual dot product
@@ -1930,7 +2146,6 @@ ElemType GPUSparseMatrix<ElemType>::InnerProductOfMatrices(const GPUSparseMatrix
                                     reinterpret_cast<double*>(&res), idxBase));
     }
     TracingGPUMemoryAllocator::Free<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), vectArray);
-    TracingGPUMemoryAllocator::Free<ElemType>(a.GetComputeDeviceId(), cscValA);
     CUSPARSE_CALL(cusparseDestroy(cusparseHandle));
     return res;
 }
@@ -52,6 +52,9 @@ public:
 public:
     using Base::VerifyWritable;
     using Base::ReserveTempDeviceBuffer;
+    using Base::GetOtherFormat;
+    using Base::SetOtherFormat;
+    using Base::InvalidateOtherFormat;
     using Base::GetComputeDeviceId;
     using Base::Buffer;
     using Base::GetNumRows;
@@ -290,6 +293,7 @@ public:
 
     GPUSPARSE_INDEX_TYPE* GetCondensedVector() const;
     void MaskColumnsValue(const GPUMatrix<char>& columnsMask, ElemType val);
+    void AssignOneHotColumns(const GPUMatrix<ElemType>& rowIndices, size_t numRows);
 
     void Reshape(const size_t numRows, const size_t numCols);
     void ResizeAsAndCopyIndexFrom(const GPUSparseMatrix<ElemType>& a, const bool growOnly = true);
@@ -339,6 +343,8 @@ public:
                                 const size_t nz, const size_t numRows, const size_t numCols, const bool IsOnDevice = false, const DEVICEID_TYPE devId = -1);
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
         const size_t nz, const size_t numRows, const size_t numCols, const bool IsOnDevice = false, const DEVICEID_TYPE devId = -1, DataTransferer* transferer = nullptr);
+    // Sets sparse matrix in SparseBlockCol format from host memory: the ids of the non-zero columns and their values, one column per block
+    void SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols);
 
     // Gets sparse matrix in CSR format. this acts as deep copy. All passed pointers must be NULL. the function will allocate memory itself.
     void GetMatrixFromCSRFormat(CPUSPARSE_INDEX_TYPE*& h_CSRRow, CPUSPARSE_INDEX_TYPE*& h_Col, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const;
@@ -410,6 +416,11 @@ public:
 
     void NormalGrad(GPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(GPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    // lazy updates that touch only the columns of a block-column gradient, see Matrix::LazyNormalGrad()
+    void LazyNormalGrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                        const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum);
+    void LazyFSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                       ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
 
     static void Multiply(const GPUSparseMatrix<ElemType>& S, const GPUMatrix<ElemType>& D, GPUMatrix<ElemType>& C);
     static void Multiply(const GPUMatrix<ElemType>& D, const GPUSparseMatrix<ElemType>& S, GPUMatrix<ElemType>& C);
@@ -449,6 +460,8 @@ private:
 private:
     void performElementWiseFunction(const ElementWiseOperator kind, const GPUSparseMatrix<ElemType>& src);
     void DeepCopy(const GPUSparseMatrix<ElemType>& deepCopyFrom);
+    shared_ptr<GPUSparseMatrix<ElemType>> OtherCompressedFormat() const;
+    void RequireCompactCSCLayout(const size_t numRows, const size_t numCols, const size_t nz);
     void PrepareBuffer(const size_t numRows, const size_t numCols, const bool canReuseBuffer, std::function<size_t(GPUSPARSE_INDEX_TYPE* csrRowPtrC)> func);
 
     size_t ElemCountFromBufferSize(const size_t numRows, const size_t numCols, const MatrixFormat format, const size_t totalBufferSize) const;
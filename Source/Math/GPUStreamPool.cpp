@@ -0,0 +1,166 @@
+#include "stdafx.h"
+#include "GPUStreamPool.h"
+#include "BestGpu.h" // for CPUONLY
+#ifndef CPUONLY
+#include "GPUMatrix.h" // for SetStream(), GetStream()
+#include <cuda_runtime_api.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifndef CPUONLY
+
+inline static void CheckCudaReturnCode(cudaError_t rc, const char* msg)
+{
+    if (rc != cudaSuccess)
+        RuntimeError("%s: %s (cuda error %d)", msg, cudaGetErrorString(rc), (int)rc);
+}
+
+struct GPUStreamPool::Impl
+{
+    int m_deviceId;
+    std::vector<cudaStream_t> m_streams;
+    std::vector<cudaEvent_t> m_events; // reused in every Begin()/End() cycle
+    size_t m_numEventsUsed = 0;
+    std::vector<bool> m_streamUsed;    // [stream] whether work was issued to it since Begin()
+    cudaStream_t m_originalStream = nullptr;
+    bool m_begun = false;
+};
+
+GPUStreamPool::GPUStreamPool(int deviceId, size_t numStreams)
+    : m_impl(new Impl())
+{
+    m_impl->m_deviceId = deviceId;
+    CheckCudaReturnCode(cudaSetDevice(deviceId), "Cannot set cuda device");
+    for (size_t i = 0; i < numStreams; i++)
+    {
+        cudaStream_t stream;
+        CheckCudaReturnCode(cudaStreamCreate(&stream), "GPUStreamPool: cannot create stream");
+        m_impl->m_streams.push_back(stream);
+    }
+    m_impl->m_streamUsed.resize(numStreams);
+}
+
+GPUStreamPool::~GPUStreamPool()
+{
+    // no error checking: we may be unwinding
+    cudaSetDevice(m_impl->m_deviceId);
+    for (auto event : m_impl->m_events)
+        cudaEventDestroy(event);
+    for (auto stream : m_impl->m_streams)
+        cudaStreamDestroy(stream);
+}
+
+/*static*/ bool GPUStreamPool::IsSupported(int deviceId)
+{
+    return deviceId >= 0;
+}
+
+size_t GPUStreamPool::GetNumStreams() const
+{
+    return m_impl->m_streams.size();
+}
+
+void GPUStreamPool::Begin()
+{
+    if (m_impl->m_begun)
+        LogicError("GPUStreamPool::Begin: Called twice without End().");
+    m_impl->m_begun = true;
+    m_impl->m_numEventsUsed = 0;
+    m_impl->m_originalStream = GetStream();
+    auto start = Record(); // (on the original stream)
+    for (size_t i = 0; i < m_impl->m_streams.size(); i++)
+    {
+        CheckCudaReturnCode(cudaStreamWaitEvent(m_impl->m_streams[i], m_impl->m_events[start], 0), "GPUStreamPool::Begin: cannot wait for event");
+        m_impl->m_streamUsed[i] = false;
+    }
+}
+
+void GPUStreamPool::Use(size_t stream)
+{
+    SetStream(m_impl->m_streams[stream]);
+    m_impl->m_streamUsed[stream] = true;
+}
+
+size_t GPUStreamPool::Record()
+{
+    if (m_impl->m_numEventsUsed == m_impl->m_events.size())
+    {
+        cudaEvent_t event;
+        CheckCudaReturnCode(cudaEventCreateWithFlags(&event, cudaEventDisableTiming), "GPUStreamPool: cannot create event");
+        m_impl->m_events.push_back(event);
+    }
+    CheckCudaReturnCode(cudaEventRecord(m_impl->m_events[m_impl->m_numEventsUsed], GetStream()), "GPUStreamPool::Record: cannot record event");
+    return m_impl->m_numEventsUsed++;
+}
+
+void GPUStreamPool::Wait(size_t event)
+{
+    CheckCudaReturnCode(cudaStreamWaitEvent(GetStream(), m_impl->m_events[event], 0), "GPUStreamPool::Wait: cannot wait for event");
+}
+
+void GPUStreamPool::End()
+{
+    if (!m_impl->m_begun)
+        LogicError("GPUStreamPool::End: Called without Begin().");
+    std::vector<size_t> joins;
+    for (size_t i = 0; i < m_impl->m_streams.size(); i++)
+    {
+        if (m_impl->m_streamUsed[i])
+        {
+            SetStream(m_impl->m_streams[i]);
+            joins.push_back(Record());
+        }
+    }
+    SetStream(m_impl->m_originalStream);
+    for (auto event : joins)
+        Wait(event);
+    m_impl->m_begun = false;
+}
+
+#else
+// Dummy definitions when compiling for CPUONLY
+struct GPUStreamPool::Impl
+{
+};
+
+GPUStreamPool::GPUStreamPool(int, size_t)
+{
+}
+
+GPUStreamPool::~GPUStreamPool()
+{
+}
+
+/*static*/ bool GPUStreamPool::IsSupported(int)
+{
+    return false;
+}
+
+size_t GPUStreamPool::GetNumStreams() const
+{
+    return 0;
+}
+
+void GPUStreamPool::Begin()
+{
+}
+
+void GPUStreamPool::Use(size_t)
+{
+}
+
+size_t GPUStreamPool::Record()
+{
+    return 0;
+}
+
+void GPUStreamPool::Wait(size_t)
+{
+}
+
+void GPUStreamPool::End()
+{
+}
+#endif
+} } }
@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+// -----------------------------------------------------------------------
+// GPUStreamPool -- a set of CUDA streams that independent work can be spread over.
+// Between Begin() and End(), Use() selects the stream that the calling thread's GPU work goes to
+// (see SetStream()), and Record()/Wait() order work across streams with events.
+// Begin() orders all streams after the work issued so far on the thread's stream, and End() orders
+// the thread's stream after everything issued to the pool, so that callers outside see no difference.
+// The streams synchronize with the legacy default stream, so that synchronous copies remain safe.
+// On CPU builds, the pool has no streams and all functions do nothing.
+// -----------------------------------------------------------------------
+
+class MATH_API GPUStreamPool
+{
+public:
+    GPUStreamPool(int deviceId, size_t numStreams);
+    ~GPUStreamPool();
+
+    static bool IsSupported(int deviceId);
+    size_t GetNumStreams() const;
+
+    void Begin();
+    void Use(size_t stream);
+    // mark the work issued so far to the current stream; returns an id for Wait(), valid until End()
+    size_t Record();
+    // make the current stream wait for the work marked by Record()
+    void Wait(size_t event);
+    void End();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+} } }
@@ -20,6 +20,8 @@
 #include "cublas_v2.h"
 #include <assert.h>
 #include<limits.h>
+#include <mutex>
+#include <unordered_map>
 
 #ifndef let
 #define let const auto
@@ -118,6 +120,9 @@ struct FixedArray
                 InvalidArgument("FixedArray: Dimensions out of range, too few bits.");
         }
     }
+    __device__ __host__ FixedArray()
+    {
+    }
 };
 template <typename T> // specialized version for 0 elements
 struct FixedArray<T, 0>
@@ -172,6 +177,9 @@ struct FixedMatrix
             }
         }
     }
+    __device__ __host__ FixedMatrix()
+    {
+    }
 };
 template <typename T, size_t N> // specialized version for 0 elements
 struct FixedMatrix<T, N, 0>
@@ -316,6 +324,22 @@ template<typename ReductionType, class ElemType> __device__ void UpdateAggregate
     }
 };
 
+// reduce the aggregates of the threads of a warp with shuffles; lane 0 gets the result
+// All lanes of the warp must be active.
+template<typename ReductionType> __device__ ReductionType WarpReduce(ReductionType aggregate, ElementWiseOperator reductionOp)
+{
+    for (CUDA_LONG offset = warpSize / 2; offset > 0; offset >>= 1)
+    {
+#if CUDA_VERSION >= 9000
+        ReductionType other = __shfl_down_sync(0xffffffff, aggregate, offset);
+#else
+        ReductionType other = __shfl_down(aggregate, offset);
+#endif
+        UpdateAggregate<ReductionType, ReductionType>(aggregate, other, reductionOp);
+    }
+    return aggregate;
+}
+
 
 // -----------------------------------------------------------------------
 // function to compute the value for a given output location (including reduction)
@@ -509,25 +533,26 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/true, /*k=*/-1>
             UpdateAggregate<ReduceElemType, ElemType>(aggregate, val, reductionOp);
         }
 
-        // reduce    --cf https://docs.nvidia.com/cuda/samples/6_Advanced/reduction/doc/reduction.pdf
-        __shared__ ReduceElemType volatile accumulators[GridDim::maxThreadsPerBlock /*tids*/];
-        accumulators[tid] = aggregate;
+        // reduce within each warp with shuffles, then the per-warp results in the first warp
+        // The launch rounds the block up to whole warps; threads past the reduction range hold the neutral value.
+        static_assert(GridDim::maxThreadsPerBlock <= 1024, "GridDim::maxThreadsPerBlock too large, the per-warp results must fit into one warp");
+        __shared__ ReduceElemType warpAggregates[GridDim::maxWarpsPerBlock];
+        aggregate = WarpReduce<ReduceElemType>(aggregate, reductionOp);
+        CUDA_LONG warp = tid / warpSize;
+        CUDA_LONG lane = tid % warpSize;
+        if (lane == 0)
+            warpAggregates[warp] = aggregate;
         __syncthreads();
-        static_assert(GridDim::maxThreadsPerBlock <= 1024, "GridDim::maxThreadsPerBlock too large, need to add manually unrolled steps");
-        for (CUDA_LONG i = 512; i; i >>= 1)
+        if (warp == 0)
         {
-            if (tid < i && tid + i < tids)
-                UpdateAggregate<volatile ReduceElemType, volatile ReduceElemType>(accumulators[tid], accumulators[tid + i], reductionOp);
-
-            if (0 + i < tids)
-                __syncthreads(); // sync if condition true for at least one thread
-            // TODO: use volatile* and then we can skip the __syncthreads() for the last 32 values. See Amit's allreduce() function implementation in MatrixQuantizer_kernel.cu.
+            aggregate = lane < (tids + warpSize - 1) / warpSize ? warpAggregates[lane] : NeutralValue<ReduceElemType>(reductionOp);
+            aggregate = WarpReduce<ReduceElemType>(aggregate, reductionOp);
         }
 
         // now set final value to output coordinate
         if (tid == 0)
         {
-            ElemType val = (ElemType) accumulators[0];
+            ElemType val = (ElemType) aggregate;
             // scale
             val *= alpha;
             // combine with previous value in target matrix, then write it out
@@ -569,29 +594,246 @@ __global__ void _launchTensorOp(ElemType beta, FixedArray<ElemType*, N> pointers
         TensorOpElement<ElemType, N, M, K, false, K - 1>::Compute(id, beta, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, 0, 0);
 }
 
+// kernel for tensors that are all dense and iterated in memory order: the thread index is the element index
+template <class ElemType, C_size_t N>
+__global__ void _launchContiguousTensorOp(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, CUDA_LONG numElements)
+{
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numElements)
+        return;
+    for (C_size_t i = 0; i < N; i++)
+        pointers[i] += id;
+    ElemType val = TensorOps<ElemType>::Compute(pointers, op);
+    val *= alpha;
+    if (N < 4 || val != 0 || beta != 1) // (skip memory access if not needed) (N<4: skip this test)
+    {
+        auto* pout = pointers[N - 1];
+        if (beta != 0) // (skip memory access if not needed, and allow for ignoring NaNs)
+            val += beta * *pout;
+        *pout = val;
+    }
+}
+
+// same for floats with 16-byte aligned pointers, four elements per thread through float4 loads and stores
+template <C_size_t N>
+__global__ void _launchContiguousTensorOp4(float beta, FixedArray<float*, N> pointers, float alpha, ElementWiseOperator op, CUDA_LONG numVectors)
+{
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numVectors)
+        return;
+    float4 values[N];
+    for (C_size_t i = 0; i < N - 1; i++)
+        values[i] = reinterpret_cast<const float4*>(pointers[i])[id];
+    if (beta != 0)
+        values[N - 1] = reinterpret_cast<const float4*>(pointers[N - 1])[id];
+    float* outputs = reinterpret_cast<float*>(&values[N - 1]);
+    for (C_size_t j = 0; j < 4; j++)
+    {
+        FixedArray<float*, N> elements;
+        for (C_size_t i = 0; i < N; i++)
+            elements[i] = reinterpret_cast<float*>(&values[i]) + j;
+        float val = TensorOps<float>::Compute(elements, op) * alpha;
+        outputs[j] = beta != 0 ? val + beta * outputs[j] : val;
+    }
+    reinterpret_cast<float4*>(pointers[N - 1])[id] = values[N - 1];
+}
+
+// kernel for two regular dimensions, e.g. adding a bias to every column: the grid's x covers the first dimension
+// and y loops over the second one, so that no divisions are needed to find the elements
+template <class ElemType, C_size_t N>
+__global__ void _launchTensorOp2D(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op,
+                                  FixedMatrix<C_int, N, 2> regularStrides, CUDA_LONG rows, CUDA_LONG cols)
+{
+    CUDA_LONG row = blockDim.x * blockIdx.x + threadIdx.x;
+    if (row >= rows)
+        return;
+    for (C_size_t i = 0; i < N; i++)
+        pointers[i] += row * regularStrides(i, 0);
+    for (CUDA_LONG col = blockIdx.y; col < cols; col += gridDim.y)
+    {
+        FixedArray<ElemType*, N> elements;
+        for (C_size_t i = 0; i < N; i++)
+            elements[i] = pointers[i] + col * regularStrides(i, 1);
+        ElemType val = TensorOps<ElemType>::Compute(elements, op);
+        val *= alpha;
+        if (N < 4 || val != 0 || beta != 1) // (skip memory access if not needed) (N<4: skip this test)
+        {
+            auto* pout = elements[N - 1];
+            if (beta != 0) // (skip memory access if not needed, and allow for ignoring NaNs)
+                val += beta * *pout;
+            *pout = val;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// launch plans
+// The shape dependent part of a launch without reduction (strides in kernel format, grid, choice of kernel)
+// is computed once per distinct shape and device, and kept in a cache, since the same shapes recur every minibatch.
+// -----------------------------------------------------------------------
+
+enum class TensorOpKernel
+{
+    generic,    // template-recursive index computation over K dimensions
+    contiguous, // one dense dimension with unit strides, linear indexing (float4 if the pointers allow)
+    twoDim,     // two dimensions, one per grid dimension
+};
+
+template <class ElemType, C_size_t N, C_int K>
+struct TensorOpPlan
+{
+    FixedArray<C_unsigned_int, K> m_regularOpStrides;
+    FixedMatrix<C_int, N, K> m_regularStrides;
+    CUDA_LONG m_numElements;
+    TensorOpKernel m_kernel;
+    GridDim m_grid;
+    dim3 m_blocks2D; // for twoDim
+    int m_threads2D = 0;
+
+    TensorOpPlan(const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrideVectors)
+        : m_regularStrides(regularStrideVectors), m_numElements(ComputeNumElements(regularOpDims)), m_kernel(TensorOpKernel::generic), m_grid(m_numElements)
+    {
+        SmallVector<C_size_t> regularOpStrideVector; // kernel needs the strides for converting thread index back to multi-dimensional tensor index
+        C_size_t numElements = 1;
+        for (C_size_t k = 0; k < regularOpDims.size(); k++)
+        {
+            regularOpStrideVector.push_back(numElements);
+            numElements *= (C_size_t) regularOpDims[k];
+        }
+        m_regularOpStrides = FixedArray<C_unsigned_int, K>(regularOpStrideVector);
+
+        if (K == 1 && all_of(regularStrideVectors.begin(), regularStrideVectors.end(), [](const SmallVector<ptrdiff_t>& strides) { return strides[0] == 1; }))
+        {
+            m_kernel = TensorOpKernel::contiguous;
+        }
+        else if (K == 2 && regularOpDims[0] >= (size_t) GridDim::GetDeviceProps().warpSize)
+        {
+            // rows in whole warps, columns in as many blocks as the grid allows (the kernel loops over the rest)
+            let& props = GridDim::GetDeviceProps();
+            let rows = (CUDA_LONG) regularOpDims[0];
+            let cols = (CUDA_LONG) regularOpDims[1];
+            m_kernel = TensorOpKernel::twoDim;
+            m_threads2D = min(CeilDiv(rows, props.warpSize) * props.warpSize, GridDim::maxThreadsPerBlock);
+            m_blocks2D = dim3(CeilDiv(rows, m_threads2D), min(cols, props.maxGridSize[1]));
+        }
+    }
+
+private:
+    static CUDA_LONG ComputeNumElements(const SmallVector<size_t>& regularOpDims)
+    {
+        size_t numElements = 1;
+        for (size_t k = 0; k < regularOpDims.size(); k++)
+            numElements *= regularOpDims[k];
+        return (CUDA_LONG) numElements;
+    }
+};
+
+// hash of a shape: dimensions, strides and the device
+struct TensorOpPlanKeyHash
+{
+    size_t operator()(const vector<ptrdiff_t>& key) const
+    {
+        size_t hash = 14695981039346656037ULL;
+        for (auto value : key)
+            hash = (hash ^ (size_t) value) * 1099511628211ULL;
+        return hash;
+    }
+};
+
+template <class ElemType, C_size_t N, C_int K>
+static TensorOpPlan<ElemType, N, K> GetTensorOpPlan(const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrideVectors)
+{
+    static const size_t maxPlans = 4096; // shapes of one network are far fewer; this only bounds pathological cases
+    static unordered_map<vector<ptrdiff_t>, TensorOpPlan<ElemType, N, K>, TensorOpPlanKeyHash> plans;
+    static mutex plansMutex;
+
+    vector<ptrdiff_t> key;
+    key.reserve(1 + K * (N + 1));
+    key.push_back((ptrdiff_t) GridDim::GetCurrentDeviceId());
+    for (C_size_t k = 0; k < regularOpDims.size(); k++)
+        key.push_back((ptrdiff_t) regularOpDims[k]);
+    for (C_size_t i = 0; i < N; i++)
+        key.insert(key.end(), regularStrideVectors[i].begin(), regularStrideVectors[i].end());
+
+    lock_guard<mutex> lock(plansMutex);
+    auto plan = plans.find(key);
+    if (plan == plans.end())
+    {
+        if (plans.size() >= maxPlans)
+            plans.clear();
+        plan = plans.emplace(move(key), TensorOpPlan<ElemType, N, K>(regularOpDims, regularStrideVectors)).first;
+    }
+    return plan->second;
+}
+
+// launches the float4 kernel if the element type and the pointers allow it
+template <C_size_t N>
+static bool TryLaunchContiguousTensorOp4(float beta, const FixedArray<float*, N>& pointers, float alpha, ElementWiseOperator op, CUDA_LONG numElements)
+{
+    if (numElements % 4 != 0)
+        return false;
+    for (C_size_t i = 0; i < N; i++)
+    {
+        if ((size_t) pointers[i] % sizeof(float4) != 0)
+            return false;
+    }
+    GridDim grid(numElements / 4);
+    _launchContiguousTensorOp4<N><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, grid.m_N);
+    return true;
+}
+
+template <C_size_t N>
+static bool TryLaunchContiguousTensorOp4(double, const FixedArray<double*, N>&, double, ElementWiseOperator, CUDA_LONG)
+{
+    return false;
+}
+
+// launches the two-dimensional kernel; plans only choose it for K = 2
+template <class ElemType, C_size_t N, C_int K>
+struct TensorOp2DLauncher
+{
+    static void Launch(ElemType, const FixedArray<ElemType*, N>&, ElemType, ElementWiseOperator, const FixedMatrix<C_int, N, K>&,
+                       const SmallVector<size_t>&, dim3, int)
+    {
+        LogicError("TensorOp2DLauncher: Plan for %d dimensions.", (int) K);
+    }
+};
+
+template <class ElemType, C_size_t N>
+struct TensorOp2DLauncher<ElemType, N, 2>
+{
+    static void Launch(ElemType beta, const FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, const FixedMatrix<C_int, N, 2>& regularStrides,
+                       const SmallVector<size_t>& regularOpDims, dim3 blocks, int threads)
+    {
+        _launchTensorOp2D<ElemType, N><<<blocks, threads, 0, t_stream>>>(beta, pointers, alpha, op, regularStrides, (CUDA_LONG) regularOpDims[0], (CUDA_LONG) regularOpDims[1]);
+    }
+};
+
 template <class ElemType, C_size_t N, C_int K>
 static void LaunchTensorOp(ElemType beta, array<ElemType*, N> pointerVector, ElemType alpha, ElementWiseOperator op,
                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrideVectors)
 {
     // copy all parameters to CUDA-compatible data structures
     FixedArray<ElemType*, N> pointers(pointerVector);
-    SmallVector<C_size_t> regularOpStrideVector; // kernel needs the strides for converting thread index back to multi-dimensional tensor index
-    C_size_t numElements = 1;
-    for (C_size_t k = 0; k < regularOpDims.size(); k++)
-    {
-        regularOpStrideVector.push_back(numElements);
-        numElements *= (C_size_t) regularOpDims[k];
-    }
-    FixedArray<C_unsigned_int, K> regularOpStrides(regularOpStrideVector);
-    FixedMatrix<C_int, N, K> regularStrides(regularStrideVectors);
+    let plan = GetTensorOpPlan<ElemType, N, K>(regularOpDims, regularStrideVectors);
     FixedArray<C_unsigned_int, /*M=*/0> reducingOpDims; // empty reduction dimensions
     FixedMatrix<C_int, N, /*M=*/0> reducingStrides;
 
     // launch the kernel
-    CUDA_LONG NN = (CUDA_LONG) numElements; // linear space identifying each individual input element
     SyncGuard syncGuard;
-    GridDim grid(NN);
-    _launchTensorOp<ElemType, N, /*M=*/0, K> <<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream >>>(beta, pointers, alpha, op, (ElementWiseOperator)(-1) /* dummy reductionOp */, regularOpStrides, regularStrides, grid.m_N, reducingOpDims, reducingStrides);
+    switch (plan.m_kernel)
+    {
+    case TensorOpKernel::contiguous:
+        if (!TryLaunchContiguousTensorOp4<N>(beta, pointers, alpha, op, plan.m_numElements))
+            _launchContiguousTensorOp<ElemType, N><<<plan.m_grid.m_blocksPerGrid, plan.m_grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, plan.m_grid.m_N);
+        break;
+    case TensorOpKernel::twoDim:
+        TensorOp2DLauncher<ElemType, N, K>::Launch(beta, pointers, alpha, op, plan.m_regularStrides, regularOpDims, plan.m_blocks2D, plan.m_threads2D);
+        break;
+    default:
+        _launchTensorOp<ElemType, N, /*M=*/0, K><<<plan.m_grid.m_blocksPerGrid, plan.m_grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, (ElementWiseOperator)(-1) /* dummy reductionOp */, plan.m_regularOpStrides, plan.m_regularStrides, plan.m_grid.m_N, reducingOpDims, reducingStrides);
+        break;
+    }
 }
 
 // -----------------------------------------------------------------------
@@ -741,7 +983,8 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
 
         // reduction goes into thread dim X
         let reductionChunkSize = CeilDiv(reductionDim, numReductionChunks);
-        let numThreadsX = min(reductionChunkSize, GridDim::maxThreadsPerBlock); // any that's over will be done by looping inside the kernel
+        // Whole warps, as the kernel reduces with warp shuffles.
+        let numThreadsX = min(CeilDiv(reductionChunkSize, props.warpSize) * props.warpSize, GridDim::maxThreadsPerBlock); // any that's over will be done by looping inside the kernel
 
         // --- cases (a1) and (a2)
         // This involves no reduction across blocks.
@@ -966,10 +1209,93 @@ void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, Elem
     }
 }
 
+// -----------------------------------------------------------------------
+// fused chains of element-wise operations (FusedElementwiseOp)
+// The program is passed by value and interpreted per element, so that the
+// whole chain runs as a single kernel without intermediate tensors.
+// -----------------------------------------------------------------------
+
+template <class ElemType, C_int K>
+__global__ void _launchFusedTensorOp(ElemType beta, FixedArray<ElemType*, 4> pointers, ElemType alpha, FusedElementwiseOp program,
+                                     FixedArray<C_unsigned_int, K> regularOpStrides, FixedMatrix<C_int, 4, K> regularStrides, CUDA_LONG numElements)
+{
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numElements)
+        return;
+    // map id (location on grid) to the element pointers
+    for (C_int k = K - 1; k >= 0; k--)
+    {
+        C_size_t stride = regularOpStrides[(C_size_t) k];
+        C_size_t index = id / stride;
+        id = id % stride;
+        for (C_size_t i = 0; i < 4; i++)
+            pointers[i] += index * regularStrides(i, (C_size_t) k);
+    }
+    ElemType val = EvaluateFusedOp(program, *(pointers[0]), *(pointers[1]), *(pointers[2]));
+    val *= alpha;
+    auto* pout = pointers[3];
+    if (beta != 0) // (skip memory access if not needed, and allow for ignoring NaNs)
+        val += beta * *pout;
+    *pout = val;
+}
+
+template <class ElemType, C_int K>
+static void LaunchFusedTensorOp(ElemType beta, const array<ElemType*, 4>& pointerVector, ElemType alpha, const FusedElementwiseOp& program,
+                                const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrideVectors)
+{
+    FixedArray<ElemType*, 4> pointers(pointerVector);
+    SmallVector<C_size_t> regularOpStrideVector;
+    C_size_t numElements = 1;
+    for (C_size_t k = 0; k < regularOpDims.size(); k++)
+    {
+        regularOpStrideVector.push_back(numElements);
+        numElements *= (C_size_t) regularOpDims[k];
+    }
+    FixedArray<C_unsigned_int, K> regularOpStrides(regularOpStrideVector);
+    FixedMatrix<C_int, 4, K> regularStrides(regularStrideVectors);
+
+    CUDA_LONG NN = (CUDA_LONG) numElements;
+    SyncGuard syncGuard;
+    GridDim grid(NN);
+    _launchFusedTensorOp<ElemType, K><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, program, regularOpStrides, regularStrides, grid.m_N);
+}
+
+template <class ElemType>
+void FusedTensorOpN(ElemType beta, array<ElemType*, 4> pointers, ElemType alpha, const FusedElementwiseOp& program,
+                    const array<size_t, 4>& offsets,
+                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides)
+{
+    for (C_size_t i = 0; i < 4; i++)
+        pointers[i] += offsets[i];
+    if (regularOpDims.size() == 0) // scalar: present it as a single element of rank 1, so that K > 0 always
+    {
+        array<SmallVector<ptrdiff_t>, 4> scalarStrides;
+        for (auto& strides : scalarStrides)
+            strides.push_back(0);
+        return LaunchFusedTensorOp<ElemType, 1>(beta, pointers, alpha, program, SmallVector<size_t>(1, 1), scalarStrides);
+    }
+    switch (regularOpDims.size())
+    {
+    case 4: return LaunchFusedTensorOp<ElemType, 4>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 3: return LaunchFusedTensorOp<ElemType, 3>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 2: return LaunchFusedTensorOp<ElemType, 2>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 1: return LaunchFusedTensorOp<ElemType, 1>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    default:
+        LogicError("FusedTensorOp: %d non-flattened input dimensions are not supported.", (C_int) regularOpDims.size());
+    }
+}
+
 //------------------------------------------------------------------------
 // explicit instantiations--these are being called from GPUMatrix.cu
 //------------------------------------------------------------------------
 
+template void FusedTensorOpN<float>(float beta, array<float*, 4> pointers, float alpha, const FusedElementwiseOp& program,
+                                    const array<size_t, 4>& offsets,
+                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides);
+template void FusedTensorOpN<double>(double beta, array<double*, 4> pointers, double alpha, const FusedElementwiseOp& program,
+                                     const array<size_t, 4>& offsets,
+                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides);
+
 template void TensorOpN<float, 2>(float beta, array<float*, 2> pointers, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                   const array<size_t, 2>& offsets,
                                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
@@ -0,0 +1,163 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// GaussianMixture.h : per-element log likelihood of a Gaussian mixture with a shared diagonal variance per component,
+// and its gradients, shared by the CPU and the GPU implementation of Matrix::AssignGMMLogLikelihoods and the
+// AddGMM*Gradient operations.
+//
+// The samples are the columns of the features (featureDim x numSamples). The parameters are a single column shared by
+// all samples, or a column per sample: unnormedPrior and logStddevs are numComponents x (1 or numSamples), the means
+// are numComponents * featureDim x (1 or numSamples), with the mean of component c in rows [c * featureDim, (c + 1) * featureDim).
+// The per-component deviations are recomputed where they are needed, so that nothing of size
+// numComponents x featureDim x numSamples is ever stored; only the posteriors of the components are kept.
+//
+
+#pragma once
+
+#include <math.h>
+
+#pragma push_macro("GAUSSIAN_MIXTURE_DECL")
+#ifdef __CUDACC__
+#define GAUSSIAN_MIXTURE_DECL __host__ __device__
+#else
+#define GAUSSIAN_MIXTURE_DECL
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Column of a parameter for sample n.
+GAUSSIAN_MIXTURE_DECL inline size_t GetGMMParameterColumn(size_t numParameterColumns, size_t n)
+{
+    return numParameterColumns == 1 ? 0 : n;
+}
+
+// log softmax of the unnormed prior (a column) of component c
+template <class ElemType>
+GAUSSIAN_MIXTURE_DECL inline ElemType GetGMMLogPrior(const ElemType* unnormedPrior, int numComponents, int c)
+{
+    ElemType maxValue = unnormedPrior[0];
+    for (int i = 1; i < numComponents; i++)
+        maxValue = unnormedPrior[i] > maxValue ? unnormedPrior[i] : maxValue;
+    ElemType sum = 0;
+    for (int i = 0; i < numComponents; i++)
+        sum += exp(unnormedPrior[i] - maxValue);
+    return unnormedPrior[c] - maxValue - log(sum);
+}
+
+// ||x - u_c||^2 / stddev_c^2, with the mean of component c given by its first element
+template <class ElemType>
+GAUSSIAN_MIXTURE_DECL inline ElemType GetGMMNormedDeviation(const ElemType* feature, const ElemType* mean, ElemType logStddev, int featureDim)
+{
+    ElemType sum = 0;
+    for (int d = 0; d < featureDim; d++)
+    {
+        ElemType deviation = feature[d] - mean[d];
+        sum += deviation * deviation;
+    }
+    return sum * exp(-2 * logStddev);
+}
+
+// log (prior_c * N(x; u_c, stddev_c^2 I)) of component c and sample n
+template <class ElemType>
+GAUSSIAN_MIXTURE_DECL inline ElemType GetGMMComponentLogLikelihood(const ElemType* unnormedPrior, size_t priorColumns, const ElemType* means, size_t meanColumns, const ElemType* logStddevs, size_t stddevColumns,
+                                                                   const ElemType* features, int numComponents, int featureDim, int c, size_t n)
+{
+    ElemType logStddev = logStddevs[c + GetGMMParameterColumn(stddevColumns, n) * numComponents];
+    const ElemType* mean = means + (size_t)c * featureDim + GetGMMParameterColumn(meanColumns, n) * numComponents * featureDim;
+    ElemType normedDeviation = GetGMMNormedDeviation(features + n * featureDim, mean, logStddev, featureDim);
+    return GetGMMLogPrior(unnormedPrior + GetGMMParameterColumn(priorColumns, n) * numComponents, numComponents, c)
+         - normedDeviation / 2 - featureDim * logStddev - (ElemType)(featureDim * 0.91893853320467274178); // log(2 pi) / 2
+}
+
+// Turns the column of component log likelihoods of a sample into posteriors, in place, and returns the log likelihood of the sample.
+template <class ElemType>
+GAUSSIAN_MIXTURE_DECL inline ElemType NormalizeGMMPosteriors(ElemType* posteriors, int numComponents)
+{
+    ElemType maxValue = posteriors[0];
+    for (int c = 1; c < numComponents; c++)
+        maxValue = posteriors[c] > maxValue ? posteriors[c] : maxValue;
+    ElemType sum = 0;
+    for (int c = 0; c < numComponents; c++)
+        sum += exp(posteriors[c] - maxValue);
+    ElemType logLikelihood = maxValue + log(sum);
+    for (int c = 0; c < numComponents; c++)
+        posteriors[c] = exp(posteriors[c] - logLikelihood);
+    return logLikelihood;
+}
+
+// The gradients of a parameter sum over the samples if it is shared, else they are of sample 'column' only.
+GAUSSIAN_MIXTURE_DECL inline void GetGMMSamplesOfParameterColumn(size_t numParameterColumns, size_t numSamples, size_t column, size_t& begin, size_t& end)
+{
+    begin = numParameterColumns == 1 ? 0 : column;
+    end = numParameterColumns == 1 ? numSamples : column + 1;
+}
+
+// gradient(n) * (posterior(c, n) - prior(c, n)), summed over the samples of the column
+template <class ElemType>
+GAUSSIAN_MIXTURE_DECL inline ElemType GetGMMUnnormedPriorGradient(const ElemType* gradient, const ElemType* unnormedPrior, size_t priorColumns, const ElemType* posteriors,
+                                                                  int numComponents, size_t numSamples, int c, size_t column)
+{
+    ElemType prior = exp(GetGMMLogPrior(unnormedPrior + column * numComponents, numComponents, c));
+    size_t begin, end;
+    GetGMMSamplesOfParameterColumn(priorColumns, numSamples, column, begin, end);
+    ElemType sum = 0;
+    for (size_t n = begin; n < end; n++)
+        sum += gradient[n] * (posteriors[c + n * numComponents] - prior);
+    return sum;
+}
+
+// gradient(n) * posterior(c, n) * (x(d, n) - u_c(d)) / stddev_c^2, summed over the samples of the column, for row c * featureDim + d
+template <class ElemType>
+GAUSSIAN_MIXTURE_DECL inline ElemType GetGMMMeanGradient(const ElemType* gradient, const ElemType* means, size_t meanColumns, const ElemType* logStddevs, size_t stddevColumns, const ElemType* features,
+                                                         const ElemType* posteriors, int numComponents, int featureDim, size_t numSamples, int row, size_t column)
+{
+    int c = row / featureDim;
+    int d = row % featureDim;
+    size_t begin, end;
+    GetGMMSamplesOfParameterColumn(meanColumns, numSamples, column, begin, end);
+    ElemType sum = 0;
+    for (size_t n = begin; n < end; n++)
+    {
+        ElemType mean = means[row + GetGMMParameterColumn(meanColumns, n) * numComponents * featureDim];
+        ElemType logStddev = logStddevs[c + GetGMMParameterColumn(stddevColumns, n) * numComponents];
+        sum += gradient[n] * posteriors[c + n * numComponents] * (features[d + n * featureDim] - mean) * exp(-2 * logStddev);
+    }
+    return sum;
+}
+
+// gradient(n) * posterior(c, n) * (||x - u_c||^2 / stddev_c^2 - featureDim), summed over the samples of the column
+template <class ElemType>
+GAUSSIAN_MIXTURE_DECL inline ElemType GetGMMLogStddevGradient(const ElemType* gradient, const ElemType* means, size_t meanColumns, const ElemType* logStddevs, size_t stddevColumns, const ElemType* features,
+                                                              const ElemType* posteriors, int numComponents, int featureDim, size_t numSamples, int c, size_t column)
+{
+    size_t begin, end;
+    GetGMMSamplesOfParameterColumn(stddevColumns, numSamples, column, begin, end);
+    ElemType sum = 0;
+    for (size_t n = begin; n < end; n++)
+    {
+        ElemType logStddev = logStddevs[c + GetGMMParameterColumn(stddevColumns, n) * numComponents];
+        const ElemType* mean = means + (size_t)c * featureDim + GetGMMParameterColumn(meanColumns, n) * numComponents * featureDim;
+        ElemType normedDeviation = GetGMMNormedDeviation(features + n * featureDim, mean, logStddev, featureDim);
+        sum += gradient[n] * posteriors[c + n * numComponents] * (normedDeviation - featureDim);
+    }
+    return sum;
+}
+
+// -gradient(n) * sum_c posterior(c, n) * (x(d, n) - u_c(d)) / stddev_c^2
+template <class ElemType>
+GAUSSIAN_MIXTURE_DECL inline ElemType GetGMMFeatureGradient(const ElemType* gradient, const ElemType* means, size_t meanColumns, const ElemType* logStddevs, size_t stddevColumns, const ElemType* features,
+                                                            const ElemType* posteriors, int numComponents, int featureDim, int d, size_t n)
+{
+    const ElemType* mean = means + GetGMMParameterColumn(meanColumns, n) * numComponents * featureDim;
+    const ElemType* logStddev = logStddevs + GetGMMParameterColumn(stddevColumns, n) * numComponents;
+    ElemType x = features[d + n * featureDim];
+    ElemType sum = 0;
+    for (int c = 0; c < numComponents; c++)
+        sum += posteriors[c + n * numComponents] * (x - mean[(size_t)c * featureDim + d]) * exp(-2 * logStddev[c]);
+    return -gradient[n] * sum;
+}
+
+}}}
+
+#pragma pop_macro("GAUSSIAN_MIXTURE_DECL")
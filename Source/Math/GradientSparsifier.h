@@ -0,0 +1,92 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Top-k sparsification of gradients for aggregation, the sparse counterpart of quantization (MatrixQuantizerImpl):
+// each worker sends only the k entries of largest magnitude of its gradient plus the residual, as (index, value)
+// pairs, and keeps the others as the residual, which is added to its next gradient. As k is the same on all workers,
+// the entries can be exchanged with a fixed-size all-gather.
+#pragma once
+
+#include "Matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class GradientSparsifier
+{
+public:
+    // the number of entries to send of a gradient with 'numElements' elements, if a fraction 'density' of them is sent
+    static size_t NumEntriesToSend(size_t numElements, double density)
+    {
+        if (density <= 0 || density > 1)
+            InvalidArgument("GradientSparsifier: The density must be in (0, 1].");
+        size_t k = (size_t) std::ceil(density * numElements);
+        return std::max<size_t>(1, std::min(k, numElements));
+    }
+
+    // Adds 'gradient' to 'residual' and selects the 'k' entries of largest magnitude of the sum into 'indices' and 'values',
+    // which leaves the others in 'residual'. The selection is done on the CPU.
+    template <class IndexType>
+    void Sparsify(const Matrix<ElemType>& gradient, Matrix<ElemType>& residual, size_t k, IndexType* indices, ElemType* values)
+    {
+        size_t numElements = gradient.GetNumElements();
+        if (residual.GetNumRows() != gradient.GetNumRows() || residual.GetNumCols() != gradient.GetNumCols())
+            LogicError("GradientSparsifier: The residual does not match the gradient.");
+        if (k > numElements)
+            LogicError("GradientSparsifier: Cannot select %d of %d entries.", (int) k, (int) numElements);
+
+        residual += gradient;
+        m_buffer.resize(numElements);
+        ElemType* buffer = m_buffer.data();
+        size_t bufferSize = m_buffer.size(); // (large enough, so CopyToArray() does not reallocate)
+        residual.CopyToArray(buffer, bufferSize);
+
+        m_order.resize(numElements);
+        std::iota(m_order.begin(), m_order.end(), (size_t) 0);
+        std::nth_element(m_order.begin(), m_order.begin() + k, m_order.end(), [buffer](size_t a, size_t b)
+        {
+            return std::abs(buffer[a]) > std::abs(buffer[b]);
+        });
+
+        for (size_t i = 0; i < k; i++)
+        {
+            size_t index = m_order[i];
+            indices[i] = (IndexType) index;
+            values[i] = m_buffer[index];
+            m_buffer[index] = 0;
+        }
+        residual.SetValue(residual.GetNumRows(), residual.GetNumCols(), residual.GetDeviceId(), m_buffer.data());
+    }
+
+    // Sets 'gradient' to the sum of the entries gathered from the workers: 'numBlocks' blocks of 'numEntries' entries each,
+    // 'blockStride' entries apart (one block per worker). The indices repeat across the blocks.
+    template <class IndexType>
+    void Merge(const IndexType* indices, const ElemType* values, size_t numEntries, Matrix<ElemType>& gradient,
+               size_t numBlocks = 1, size_t blockStride = 0)
+    {
+        size_t numElements = gradient.GetNumElements();
+        m_buffer.assign(numElements, 0);
+        for (size_t b = 0; b < numBlocks; b++)
+        {
+            for (size_t i = b * blockStride; i < b * blockStride + numEntries; i++)
+            {
+                size_t index = (size_t) indices[i];
+                if (index >= numElements)
+                    LogicError("GradientSparsifier: Index %d out of range for a gradient of %d elements.", (int) index, (int) numElements);
+                m_buffer[index] += values[i];
+            }
+        }
+        gradient.SetValue(gradient.GetNumRows(), gradient.GetNumCols(), gradient.GetDeviceId(), m_buffer.data());
+    }
+
+private:
+    std::vector<ElemType> m_buffer; // CPU copy of the residual, resp. the merged gradient
+    std::vector<size_t> m_order;
+};
+
+}}}
@@ -0,0 +1,230 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ImageAugmentation.h : per-pixel image augmentation (multi-view crops and flips, color jitter, PCA intensity
+// jitter, mean subtraction and HWC to CHW transpose) of uint8 images, shared by the CPU and the GPU implementation of
+// Matrix::AssignAugmentedImages so that both produce the same result for the same seed.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#pragma push_macro("IMAGE_AUGMENTATION_DECL")
+#ifdef __CUDACC__
+#define IMAGE_AUGMENTATION_DECL __host__ __device__
+#else
+#define IMAGE_AUGMENTATION_DECL
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Parameters of the augmentation, the same for all images of a minibatch.
+// The semantics are the ones of the Color, Intensity, Mean and Transpose image transforms.
+struct ImageAugmentationParameters
+{
+    uint32_t m_width;          // of the output images
+    uint32_t m_height;
+    uint32_t m_channels;       // interleaved (HWC) in the input, BGR for color images
+
+    // With 10 views, every input image of m_sourceWidth x m_sourceHeight yields 10 consecutive output images:
+    // the crops of the output size at the 4 corners and the center, then the same flipped horizontally
+    // (the views of the MultiView10 crop type). Otherwise (0 or 1) the input images have the output size.
+    uint32_t m_numViews;
+    uint32_t m_sourceWidth;
+    uint32_t m_sourceHeight;
+    bool m_transposeToCHW;     // output in CHW instead of HWC
+    bool m_subtractMean;       // the workspace contains a float mean image (HWC)
+
+    float m_brightnessRadius;
+    float m_contrastRadius;
+    float m_saturationRadius;  // only applied to 3 channel images
+
+    float m_intensityStdDev;   // 0 disables PCA intensity jitter
+    float m_eigVal[3];
+    float m_eigVec[9];         // row-major 3x3
+
+    IMAGE_AUGMENTATION_DECL size_t GetImageSize() const
+    {
+        return (size_t)m_width * m_height * m_channels;
+    }
+
+    IMAGE_AUGMENTATION_DECL uint32_t GetNumViews() const
+    {
+        return m_numViews > 1 ? m_numViews : 1;
+    }
+
+    // Size of an input image.
+    IMAGE_AUGMENTATION_DECL size_t GetSourceImageSize() const
+    {
+        return m_numViews > 1 ? (size_t)m_sourceWidth * m_sourceHeight * m_channels : GetImageSize();
+    }
+};
+
+// Random values drawn for a single image.
+struct ImageAugmentationSample
+{
+    float m_alpha;      // contrast
+    float m_beta;       // brightness
+    float m_saturation; // saturation ratio
+    float m_shift[3];   // intensity shift per channel (RGB order)
+};
+
+// Byte offsets of the parts of an augmentation workspace for numImages output images:
+// [samples of all output images][mean image, if subtracted][uint8 input images, one after another].
+// The samples are computed by the GPU implementation from the images, the rest is filled by the caller.
+struct ImageAugmentationWorkspaceLayout
+{
+    size_t m_samplesOffset;
+    size_t m_meanOffset;
+    size_t m_imagesOffset;
+    size_t m_size;
+};
+
+inline ImageAugmentationWorkspaceLayout GetImageAugmentationWorkspaceLayout(const ImageAugmentationParameters& parameters, size_t numImages)
+{
+    ImageAugmentationWorkspaceLayout layout;
+    layout.m_samplesOffset = 0;
+    layout.m_meanOffset = numImages * sizeof(ImageAugmentationSample);
+    layout.m_imagesOffset = layout.m_meanOffset + (parameters.m_subtractMean ? parameters.GetImageSize() * sizeof(float) : 0);
+    layout.m_size = layout.m_imagesOffset + numImages / parameters.GetNumViews() * parameters.GetSourceImageSize();
+    return layout;
+}
+
+// Counter-based random numbers, so that the values for an image only depend on the seed and the
+// index of the image and not on the order in which images are processed by CPU or GPU threads.
+IMAGE_AUGMENTATION_DECL inline uint64_t ImageAugmentationHash(uint64_t x)
+{
+    // splitmix64 finalizer.
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Uniform in [0, 1).
+IMAGE_AUGMENTATION_DECL inline float ImageAugmentationUniform(uint64_t seed, uint64_t image, uint32_t draw)
+{
+    uint64_t h = ImageAugmentationHash(seed ^ ImageAugmentationHash(image * 16 + draw));
+    return (float)(h >> 40) * (1.0f / 16777216.0f);
+}
+
+// Uniform in [-radius, radius).
+IMAGE_AUGMENTATION_DECL inline float ImageAugmentationUniform(uint64_t seed, uint64_t image, uint32_t draw, float radius)
+{
+    return radius * (2 * ImageAugmentationUniform(seed, image, draw) - 1);
+}
+
+// Standard normal, Box-Muller transform of two uniform draws.
+IMAGE_AUGMENTATION_DECL inline float ImageAugmentationNormal(uint64_t seed, uint64_t image, uint32_t draw)
+{
+    float u1 = 1 - ImageAugmentationUniform(seed, image, draw); // (0, 1]
+    float u2 = ImageAugmentationUniform(seed, image, draw + 1);
+    return sqrtf(-2 * logf(u1)) * cosf(6.2831853f * u2);
+}
+
+// imageMean is the mean over all values of the (uint8) image, brightness is a fraction of it.
+IMAGE_AUGMENTATION_DECL inline ImageAugmentationSample ComputeImageAugmentationSample(const ImageAugmentationParameters& parameters,
+                                                                                      uint64_t seed, uint64_t image, float imageMean)
+{
+    ImageAugmentationSample sample;
+    sample.m_beta = parameters.m_brightnessRadius > 0 ? ImageAugmentationUniform(seed, image, 0, parameters.m_brightnessRadius) * imageMean : 0;
+    sample.m_alpha = parameters.m_contrastRadius > 0 ? 1 + ImageAugmentationUniform(seed, image, 1, parameters.m_contrastRadius) : 1;
+    sample.m_saturation = parameters.m_saturationRadius > 0 ? 1 + ImageAugmentationUniform(seed, image, 2, parameters.m_saturationRadius) : 1;
+
+    float alphas[3] = { 0, 0, 0 };
+    if (parameters.m_intensityStdDev > 0)
+    {
+        for (int i = 0; i < 3; i++)
+            alphas[i] = parameters.m_intensityStdDev * ImageAugmentationNormal(seed, image, 4 + 2 * i) * parameters.m_eigVal[i];
+    }
+
+    for (int i = 0; i < 3; i++)
+        sample.m_shift[i] = parameters.m_eigVec[3 * i] * alphas[0] + parameters.m_eigVec[3 * i + 1] * alphas[1] + parameters.m_eigVec[3 * i + 2] * alphas[2];
+    return sample;
+}
+
+// Offset in the input image of the first channel of the given pixel (row-major over width and height)
+// of the output image of the given view.
+IMAGE_AUGMENTATION_DECL inline size_t GetImageAugmentationSourceOffset(const ImageAugmentationParameters& parameters, uint32_t view, size_t pixel)
+{
+    if (parameters.m_numViews <= 1)
+        return pixel * parameters.m_channels;
+
+    uint32_t x = (uint32_t)(pixel % parameters.m_width);
+    uint32_t y = (uint32_t)(pixel / parameters.m_width);
+    uint32_t marginX = parameters.m_sourceWidth - parameters.m_width;
+    uint32_t marginY = parameters.m_sourceHeight - parameters.m_height;
+
+    // 0 - 3: top-left, top-right, bottom-left, bottom-right; 4: center. 5 - 9: the same, flipped.
+    uint32_t subView = view % 5;
+    uint32_t x0 = subView == 4 ? marginX / 2 : (subView % 2) * marginX;
+    uint32_t y0 = subView == 4 ? marginY / 2 : (subView / 2) * marginY;
+    if (view >= 5)
+        x = parameters.m_width - 1 - x;
+    return ((size_t)(y0 + y) * parameters.m_sourceWidth + x0 + x) * parameters.m_channels;
+}
+
+// The index-th value (over pixels and channels) of the output image of the given view, before augmentation.
+IMAGE_AUGMENTATION_DECL inline uint8_t GetImageAugmentationSourceValue(const ImageAugmentationParameters& parameters, const uint8_t* image, uint32_t view, size_t index)
+{
+    return image[GetImageAugmentationSourceOffset(parameters, view, index / parameters.m_channels) + index % parameters.m_channels];
+}
+
+IMAGE_AUGMENTATION_DECL inline float ImageAugmentationClamp(float x)
+{
+    return x < 0 ? 0 : (x > 255 ? 255 : x);
+}
+
+// Augments all channels of the pixel with the given index (row-major over width and height)
+// of the given view of a single input image and writes them to the output image.
+template <class ElemType>
+IMAGE_AUGMENTATION_DECL inline void AugmentImagePixel(const ImageAugmentationParameters& parameters, const ImageAugmentationSample& sample,
+                                                      const uint8_t* image, uint32_t view, const float* mean, size_t pixel, ElemType* output)
+{
+    const uint32_t maxChannels = 4;
+    uint32_t channels = parameters.m_channels < maxChannels ? parameters.m_channels : maxChannels;
+    size_t numPixels = (size_t)parameters.m_width * parameters.m_height;
+    size_t source = GetImageAugmentationSourceOffset(parameters, view, pixel);
+
+    float values[maxChannels];
+    for (uint32_t c = 0; c < channels; c++)
+        values[c] = ImageAugmentationClamp(image[source + c] * sample.m_alpha + sample.m_beta);
+
+    if (channels == 3 && sample.m_saturation != 1)
+    {
+        // Scaling the saturation in HSV space keeps hue and value (the maximum), so each channel
+        // moves away from (or towards) the maximum: x' = V - (V - x) * min(ratio, 1 / S), S = (V - min) / V.
+        float v = fmaxf(values[0], fmaxf(values[1], values[2]));
+        float m = fminf(values[0], fminf(values[1], values[2]));
+        if (v > m)
+        {
+            float scale = fminf(sample.m_saturation, v / (v - m));
+            for (uint32_t c = 0; c < 3; c++)
+                values[c] = v - (v - values[c]) * scale;
+        }
+    }
+
+    if (parameters.m_intensityStdDev > 0 && channels <= 3)
+    {
+        for (uint32_t c = 0; c < channels; c++)
+            values[c] = ImageAugmentationClamp(values[c] + sample.m_shift[channels - c - 1]);
+    }
+
+    for (uint32_t c = 0; c < channels; c++)
+    {
+        float value = values[c];
+        if (mean)
+            value -= mean[pixel * parameters.m_channels + c];
+
+        size_t index = parameters.m_transposeToCHW ? c * numPixels + pixel : pixel * parameters.m_channels + c;
+        output[index] = (ElemType)value;
+    }
+}
+
+}}}
+
+#pragma pop_macro("IMAGE_AUGMENTATION_DECL")
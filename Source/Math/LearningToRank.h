@@ -0,0 +1,139 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LearningToRank.h : per-url computations of NDCG and of the LambdaRank gradient, shared by the CPU and the
+// GPU implementation of Matrix::AssignRanksWithinQueries, AssignNDCGContributions and AddLambdaRankGradient.
+//
+// The urls are the columns of row vectors of gains, scores and query ids. The urls of a query are consecutive
+// (a query is a run of equal query ids) and in descending order of gain, so that their position in the query
+// is their ideal rank. Every url is computed on its own by scanning its query, which takes no more work than
+// the pairs of the query and needs neither a sort nor atomics.
+//
+
+#pragma once
+
+#include <math.h>
+
+#pragma push_macro("LEARNING_TO_RANK_DECL")
+#ifdef __CUDACC__
+#define LEARNING_TO_RANK_DECL __host__ __device__
+#else
+#define LEARNING_TO_RANK_DECL
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// The columns [begin, end) of the query of url i.
+template <class ElemType>
+LEARNING_TO_RANK_DECL inline void GetQueryOfUrl(const ElemType* queryIds, int numUrls, int i, int& begin, int& end)
+{
+    int queryId = (int)queryIds[i];
+    begin = i;
+    while (begin > 0 && (int)queryIds[begin - 1] == queryId)
+        begin--;
+    end = i + 1;
+    while (end < numUrls && (int)queryIds[end] == queryId)
+        end++;
+}
+
+// Whether url a is ranked before url b: by descending score, ties (and NaN scores) by ascending gain.
+template <class ElemType>
+LEARNING_TO_RANK_DECL inline bool IsRankedBefore(ElemType scoreA, ElemType gainA, ElemType scoreB, ElemType gainB)
+{
+    if (scoreA == scoreB || scoreA != scoreA || scoreB != scoreB)
+        return gainA < gainB;
+    return scoreA > scoreB;
+}
+
+// Rank of url i in its query by score; urls that are ranked alike keep their order.
+template <class ElemType>
+LEARNING_TO_RANK_DECL inline int GetRankWithinQuery(const ElemType* scores, const ElemType* gains, int begin, int end, int i)
+{
+    int rank = 0;
+    for (int j = begin; j < end; j++)
+    {
+        if (j == i)
+            continue;
+        if (IsRankedBefore(scores[j], gains[j], scores[i], gains[i]) ||
+            (j < i && !IsRankedBefore(scores[i], gains[i], scores[j], gains[j])))
+            rank++;
+    }
+    return rank;
+}
+
+// log(2 + rank)
+template <class ElemType>
+LEARNING_TO_RANK_DECL inline ElemType GetPositionDiscount(ElemType rank)
+{
+    return log((ElemType)2 + rank);
+}
+
+// DCG of the query with the urls in the ideal order, which is the order of the columns.
+template <class ElemType>
+LEARNING_TO_RANK_DECL inline ElemType GetIdealDCG(const ElemType* gains, int begin, int end)
+{
+    ElemType dcg = 0;
+    for (int j = begin; j < end; j++)
+        dcg += gains[j] / GetPositionDiscount((ElemType)(j - begin));
+    return dcg;
+}
+
+// Part of the NDCG of its query that url i contributes, so that the NDCG of a query is the sum over its urls;
+// 0 for queries without gain. With atOne only the top ranked url counts (NDCG@1).
+template <class ElemType>
+LEARNING_TO_RANK_DECL inline ElemType GetNDCGContribution(const ElemType* gains, const ElemType* ranks, int begin, int end, int i, bool atOne)
+{
+    ElemType discount = GetPositionDiscount(ranks[i]);
+    if (atOne)
+    {
+        ElemType idealMetric = gains[begin] / GetPositionDiscount((ElemType)0);
+        return (ranks[i] != 0 || idealMetric == 0) ? (ElemType)0 : (gains[i] / discount) / idealMetric;
+    }
+
+    ElemType idealMetric = GetIdealDCG(gains, begin, end);
+    return idealMetric == 0 ? (ElemType)0 : (gains[i] / discount) / idealMetric;
+}
+
+// Lambda of the pair of urls i and j (i before j in the ideal order): |delta NDCG| of swapping them,
+// times -sigma / (1 + exp(sigma * (si - sj))).
+template <class ElemType>
+LEARNING_TO_RANK_DECL inline ElemType GetPairLambda(const ElemType* gains, const ElemType* scores, const ElemType* ranks, ElemType idealMetric, int i, int j, ElemType sigma)
+{
+    ElemType gainDifference = gains[i] - gains[j];
+    if (fabs(gainDifference) < (ElemType)0.0000001)
+        return 0;
+
+    ElemType discountI = GetPositionDiscount(ranks[i]);
+    ElemType discountJ = GetPositionDiscount(ranks[j]);
+    ElemType deltaNDCG = fabs(gainDifference * (discountI - discountJ) / (discountI * discountJ) / idealMetric);
+    return deltaNDCG * -sigma / (1 + exp(sigma * (scores[i] - scores[j])));
+}
+
+// Gradient of the score of url i: the lambdas of the pairs it is in. Pairs are formed by the urls that have more
+// than the least gain of the query, each with all urls after it.
+template <class ElemType>
+LEARNING_TO_RANK_DECL inline ElemType GetLambdaRankGradient(const ElemType* gains, const ElemType* scores, const ElemType* ranks, int begin, int end, int i, ElemType sigma)
+{
+    ElemType idealMetric = GetIdealDCG(gains, begin, end);
+    if (idealMetric == 0)
+        return 0;
+
+    ElemType minGain = gains[end - 1];
+    ElemType gradient = 0;
+    if (gains[i] > minGain)
+    {
+        for (int j = i + 1; j < end; j++)
+            gradient += GetPairLambda(gains, scores, ranks, idealMetric, i, j, sigma);
+    }
+    for (int j = begin; j < i; j++)
+    {
+        if (gains[j] > minGain)
+            gradient -= GetPairLambda(gains, scores, ranks, idealMetric, j, i, sigma);
+    }
+    return gradient;
+}
+
+}}}
+
+#pragma pop_macro("LEARNING_TO_RANK_DECL")
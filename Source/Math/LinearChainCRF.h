@@ -0,0 +1,244 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LinearChainCRF.h : per-label steps of the forward-backward algorithm and of Viterbi decoding of a linear-chain CRF,
+// shared by the CPU and the GPU implementation of Matrix::AssignCRFForwardScores, AssignCRFLogPosteriors,
+// AssignCRFNegativeLogLikelihoods, AssignCRFTransitionGradient and AssignCRFViterbiPath.
+//
+// The sequences of a minibatch are processed at once. The columns of the scores hold the frames of all sequences,
+// as laid out by an MBLayout: frame t of a sequence is column firstColumn + t * stride, where stride is the number of
+// parallel sequences. The sequences are given by a 2 x numSequences matrix of (firstColumn, numFrames).
+// Each time step is a step over all sequences and labels at once, each (sequence, label) computed on its own.
+//
+// transitions(k, j) is the score of label k following label j. A sequence starts from the label of its first frame,
+// so that its first frame is scored with transitions(k, startLabel), as in R-CRF training.
+//
+
+#pragma once
+
+#include <math.h>
+
+#pragma push_macro("LINEAR_CHAIN_CRF_DECL")
+#ifdef __CUDACC__
+#define LINEAR_CHAIN_CRF_DECL __host__ __device__
+#else
+#define LINEAR_CHAIN_CRF_DECL
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline int GetCRFNumFrames(const ElemType* sequences, int s)
+{
+    return (int)sequences[2 * s + 1];
+}
+
+// Column of frame t of sequence s.
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline size_t GetCRFColumn(const ElemType* sequences, int s, int t, int stride)
+{
+    return (size_t)sequences[2 * s] + (size_t)t * stride;
+}
+
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline int GetCRFStartLabel(const ElemType* labelIndices, const ElemType* sequences, int s, int stride)
+{
+    return (int)labelIndices[GetCRFColumn(sequences, s, 0, stride)];
+}
+
+// log sum_j exp(values[j * valueStride] + transitions[k + j * numLabels]), over j < numLabels
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline ElemType GetCRFLogSumOfTransitions(const ElemType* values, int valueStride, const ElemType* transitions, int numLabels, int k)
+{
+    ElemType maxValue = values[0] + transitions[k];
+    for (int j = 1; j < numLabels; j++)
+    {
+        ElemType value = values[(size_t)j * valueStride] + transitions[k + (size_t)j * numLabels];
+        if (value > maxValue)
+            maxValue = value;
+    }
+    ElemType sum = 0;
+    for (int j = 0; j < numLabels; j++)
+        sum += exp(values[(size_t)j * valueStride] + transitions[k + (size_t)j * numLabels] - maxValue);
+    return maxValue + log(sum);
+}
+
+// log sum_j exp(values[j])
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline ElemType GetCRFLogSumOfExps(const ElemType* values, int numLabels)
+{
+    ElemType maxValue = values[0];
+    for (int j = 1; j < numLabels; j++)
+        maxValue = values[j] > maxValue ? values[j] : maxValue;
+    ElemType sum = 0;
+    for (int j = 0; j < numLabels; j++)
+        sum += exp(values[j] - maxValue);
+    return maxValue + log(sum);
+}
+
+// alpha(k, t): log of the summed exp scores of all label paths of frames 0..t that end in label k.
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline void CRFForwardStep(ElemType* alpha, const ElemType* scores, const ElemType* transitions, const ElemType* labelIndices, const ElemType* sequences,
+                                                 int numLabels, int stride, int s, int k, int t)
+{
+    if (t >= GetCRFNumFrames(sequences, s))
+        return;
+
+    size_t column = GetCRFColumn(sequences, s, t, stride);
+    ElemType value;
+    if (t == 0)
+        value = transitions[k + (size_t)GetCRFStartLabel(labelIndices, sequences, s, stride) * numLabels];
+    else
+        value = GetCRFLogSumOfTransitions(alpha + (column - stride) * numLabels, 1, transitions, numLabels, k);
+    alpha[k + column * numLabels] = value + scores[k + column * numLabels];
+}
+
+// Log posterior of label k at frame t, from the last frame backwards. Since alpha(j, t + 1) - scores(j, t + 1)
+// is the log sum over the labels at t of the scores of reaching j, every step takes O(numLabels) per label.
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline void CRFBackwardStep(ElemType* logPosteriors, const ElemType* alpha, const ElemType* scores, const ElemType* transitions, const ElemType* sequences,
+                                                  int numLabels, int stride, int s, int k, int t)
+{
+    int numFrames = GetCRFNumFrames(sequences, s);
+    if (t >= numFrames)
+        return;
+
+    size_t column = GetCRFColumn(sequences, s, t, stride);
+    const ElemType* a = alpha + column * numLabels;
+    if (t == numFrames - 1)
+    {
+        logPosteriors[k + column * numLabels] = a[k] - GetCRFLogSumOfExps(a, numLabels);
+        return;
+    }
+
+    // log sum_j exp(logPosteriors(j, t + 1) + transitions(j, k) - alpha(j, t + 1) + scores(j, t + 1))
+    size_t next = (column + stride) * numLabels;
+    ElemType maxValue = 0;
+    for (int j = 0; j < numLabels; j++)
+    {
+        ElemType value = logPosteriors[next + j] + transitions[j + (size_t)k * numLabels] - alpha[next + j] + scores[next + j];
+        if (j == 0 || value > maxValue)
+            maxValue = value;
+    }
+    ElemType sum = 0;
+    for (int j = 0; j < numLabels; j++)
+        sum += exp(logPosteriors[next + j] + transitions[j + (size_t)k * numLabels] - alpha[next + j] + scores[next + j] - maxValue);
+    logPosteriors[k + column * numLabels] = a[k] + maxValue + log(sum);
+}
+
+// log Z - the score of the labeled path, of sequence s.
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline ElemType GetCRFNegativeLogLikelihood(const ElemType* alpha, const ElemType* scores, const ElemType* transitions, const ElemType* labelIndices, const ElemType* sequences,
+                                                                  int numLabels, int stride, int s)
+{
+    int numFrames = GetCRFNumFrames(sequences, s);
+    if (numFrames == 0)
+        return 0;
+
+    int previousLabel = GetCRFStartLabel(labelIndices, sequences, s, stride);
+    ElemType pathScore = 0;
+    for (int t = 0; t < numFrames; t++)
+    {
+        size_t column = GetCRFColumn(sequences, s, t, stride);
+        int label = (int)labelIndices[column];
+        pathScore += transitions[label + (size_t)previousLabel * numLabels] + scores[label + column * numLabels];
+        previousLabel = label;
+    }
+    size_t lastColumn = GetCRFColumn(sequences, s, numFrames - 1, stride);
+    return GetCRFLogSumOfExps(alpha + lastColumn * numLabels, numLabels) - pathScore;
+}
+
+// Gradient of the summed negative log likelihoods with respect to transitions(k, j): over all frames of all sequences,
+// the posterior of the pair (j, k) at (t - 1, t) minus the count of the pair in the labels.
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline ElemType GetCRFTransitionGradient(const ElemType* logPosteriors, const ElemType* alpha, const ElemType* scores, const ElemType* transitions,
+                                                              const ElemType* labelIndices, const ElemType* sequences, int numSequences, int numLabels, int stride, int k, int j)
+{
+    ElemType transition = transitions[k + (size_t)j * numLabels];
+    ElemType gradient = 0;
+    for (int s = 0; s < numSequences; s++)
+    {
+        int numFrames = GetCRFNumFrames(sequences, s);
+        if (numFrames == 0)
+            continue;
+
+        int previousLabel = GetCRFStartLabel(labelIndices, sequences, s, stride);
+        for (int t = 0; t < numFrames; t++)
+        {
+            size_t column = GetCRFColumn(sequences, s, t, stride);
+            size_t index = k + column * numLabels;
+            if (t == 0)
+            {
+                if (j == previousLabel)
+                    gradient += exp(logPosteriors[index]);
+            }
+            else
+            {
+                // the pair posterior, with log sum_j' exp(alpha(j', t - 1) + transitions(k, j')) = alpha(k, t) - scores(k, t)
+                gradient += exp(alpha[j + (column - stride) * numLabels] + transition - alpha[index] + scores[index] + logPosteriors[index]);
+            }
+
+            int label = (int)labelIndices[column];
+            if (label == k && previousLabel == j)
+                gradient -= 1;
+            previousLabel = label;
+        }
+    }
+    return gradient;
+}
+
+// Viterbi scores: the best score of the label paths of frames 0..t that end in label k, and the label at t - 1 of that path.
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline void CRFViterbiStep(ElemType* viterbiScores, ElemType* backPointers, const ElemType* scores, const ElemType* transitions, const ElemType* labelIndices, const ElemType* sequences,
+                                                 int numLabels, int stride, int s, int k, int t)
+{
+    if (t >= GetCRFNumFrames(sequences, s))
+        return;
+
+    size_t column = GetCRFColumn(sequences, s, t, stride);
+    int bestLabel = GetCRFStartLabel(labelIndices, sequences, s, stride);
+    ElemType bestScore = transitions[k + (size_t)bestLabel * numLabels];
+    if (t > 0)
+    {
+        const ElemType* previous = viterbiScores + (column - stride) * numLabels;
+        for (int j = 0; j < numLabels; j++)
+        {
+            ElemType value = previous[j] + transitions[k + (size_t)j * numLabels];
+            if (j == 0 || value > bestScore)
+            {
+                bestScore = value;
+                bestLabel = j;
+            }
+        }
+    }
+    viterbiScores[k + column * numLabels] = bestScore + scores[k + column * numLabels];
+    backPointers[k + column * numLabels] = (ElemType)bestLabel;
+}
+
+// Sets the labels of the best path of sequence s to 1 in the zeroed one-hot matrix 'path'.
+template <class ElemType>
+LINEAR_CHAIN_CRF_DECL inline void CRFViterbiBacktrace(ElemType* path, const ElemType* viterbiScores, const ElemType* backPointers, const ElemType* sequences, int numLabels, int stride, int s)
+{
+    int numFrames = GetCRFNumFrames(sequences, s);
+    if (numFrames == 0)
+        return;
+
+    size_t column = GetCRFColumn(sequences, s, numFrames - 1, stride);
+    int label = 0;
+    for (int k = 1; k < numLabels; k++)
+    {
+        if (viterbiScores[k + column * numLabels] > viterbiScores[label + column * numLabels])
+            label = k;
+    }
+    for (int t = numFrames - 1; t >= 0; t--)
+    {
+        column = GetCRFColumn(sequences, s, t, stride);
+        path[label + column * numLabels] = 1;
+        label = (int)backPointers[label + column * numLabels];
+    }
+}
+
+}}}
+
+#pragma pop_macro("LINEAR_CHAIN_CRF_DECL")
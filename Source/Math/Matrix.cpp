@@ -18,6 +18,8 @@
 #include <memory>
 #include <atomic>
 #include "Quantizers.h"
+#include "ImageAugmentation.h"
+#include "NarrowElementTypes.h"
 #ifndef CPUONLY
 #pragma comment(lib, "MathCUDA.lib") // built by CNTKMathCUDA project
 #endif
@@ -69,6 +71,24 @@
         }                                                                                                               \
     }
 
+// Fast path of DISPATCH_MATRIX_ON_FLAG for ops of dense matrices that are current on the same single device, see IsResolvedDenseWith().
+// In recurrent loops with tiny per-step tensors, the host work of the general dispatch (type and location checks, device
+// decisions, and SetDataLocation() with its dynamic_casts) is comparable to the kernel. A resolved op moves nothing and leaves
+// the location of the target as it is, so it calls the typed matrix directly and returns from the enclosing (void) function.
+#define DISPATCH_RESOLVED_DENSE(IsResolved, CPUDense, GPUDense)           \
+    if (IsResolved)                                                       \
+    {                                                                     \
+        if (m_currentDataLocation == CurrentDataLocation::CPU)            \
+        {                                                                 \
+            CPUDense;                                                     \
+        }                                                                 \
+        else                                                              \
+        {                                                                 \
+            GPUDense;                                                     \
+        }                                                                 \
+        return;                                                           \
+    }
+
 // version of dispatch macro that prefers the CPU if the 'MatrixPointerToCheck' location is BOTH
 #define DISPATCH_MATRIX_ON_FLAG_USECPU_4BOTH(MatrixPointerToCheck, MatrixPointerToSetFlag, CPUDense, GPUDense, CPUSparse, GPUSparse) \
     {                                                                                                                                \
@@ -304,6 +324,9 @@ void Matrix<ElemType>::SetDataLocation(CurrentDataLocation location, MatrixType
 template <class ElemType>
 void Matrix<ElemType>::UseCachedResizeOrNot(bool useCachedResize) { m_useCachedResize = useCachedResize; }
 
+template <class ElemType>
+void Matrix<ElemType>::UseMixedPrecisionGemm(bool useMixedPrecisionGemm) { GPUMatrix<ElemType>::UseMixedPrecisionGemm(useMixedPrecisionGemm); }
+
 //this is a private constructor only used internally to initialize a blank matrix
 template <class ElemType>
 Matrix<ElemType>::Matrix(const MatrixFlags matrixFlags, const MatrixType matrixType, const MatrixFormat matrixFormat, DEVICEID_TYPE deviceID)
@@ -660,6 +683,62 @@ void Matrix<ElemType>::Read(File& stream)
         LogicError("Read: Input file corrupt (invalid matrix type field 0x%02d, should be 'f' or 'd').", type);
 }
 
+template <class ElemType>
+bool Matrix<ElemType>::TryReadWithoutElements(File& stream, uint64_t& elementsPosition)
+{
+    uint64_t startPosition = stream.GetPosition();
+    char type;
+    stream >> type;
+    if (type != 'd')
+    {
+        stream.SetPosition(startPosition);
+        return false;
+    }
+
+    // the header written by the CPUMatrix and GPUMatrix operator<<
+    stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+    size_t elsize;
+    stream >> elsize;
+    if (sizeof(ElemType) != elsize)
+        RuntimeError("Template argument size doesn't match those in file");
+    std::wstring matrixNameDummy;
+    int format;
+    size_t numRows, numCols;
+    stream >> matrixNameDummy >> format >> numRows >> numCols;
+
+    elementsPosition = stream.GetPosition();
+    stream.SetPosition(elementsPosition + numRows * numCols * sizeof(ElemType));
+    stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+
+    if (GetMatrixType() != MatrixType::DENSE)
+        LogicError("TryReadWithoutElements: A dense matrix in the file can only be read into a dense matrix this way.");
+    Resize(numRows, numCols);
+    return true;
+}
+
+template <class ElemType>
+void Matrix<ElemType>::ReadElements(File& stream, uint64_t elementsPosition, ElemType* hostBuffer)
+{
+    if (GetMatrixType() != MatrixType::DENSE)
+        LogicError("ReadElements: Only dense matrices can be read this way.");
+
+    stream.SetPosition(elementsPosition);
+    if (GetDeviceId() == CPUDEVICE)
+    {
+        freadOrDie(Data(), sizeof(ElemType), GetNumElements(), (FILE*) stream);
+        return;
+    }
+
+    std::unique_ptr<ElemType[]> temporaryBuffer;
+    if (!hostBuffer)
+    {
+        temporaryBuffer.reset(new ElemType[GetNumElements()]);
+        hostBuffer = temporaryBuffer.get();
+    }
+    freadOrDie(hostBuffer, sizeof(ElemType), GetNumElements(), (FILE*) stream);
+    SetValue(GetNumRows(), GetNumCols(), GetDeviceId(), hostBuffer, matrixFlagNormal);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Write(File& stream) const
 {
@@ -697,6 +776,17 @@ size_t Matrix<ElemType>::BufferSize() const
                             return m_GPUSparseMatrix->BufferSizeAllocated());
 }
 
+template <class ElemType>
+size_t Matrix<ElemType>::NzCount() const
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            return GetNumElements(),
+                            return GetNumElements(),
+                            return m_CPUSparseMatrix->NzCount(),
+                            return m_GPUSparseMatrix->NzCount());
+}
+
 // BUGBUG: This is ugly code. The outside world should not have access to the raw data pointers.
 // if this is to be used, then at least it should also return a number of bytes as well.
 template <class ElemType>
@@ -1262,6 +1352,16 @@ void Matrix<ElemType>::SetValue(const Matrix<ElemType>& deepCopyFrom)
         { m_GPUSparseMatrix->SetValue(*deepCopyFrom.m_GPUSparseMatrix); });
 }
 
+template <class ElemType>
+void Matrix<ElemType>::AssignPeerCopyOf(const Matrix<ElemType>& deepCopyFrom)
+{
+    if (GetMatrixType() == MatrixType::DENSE && deepCopyFrom.GetMatrixType() == MatrixType::DENSE &&
+        GetDeviceId() != CPUDEVICE && deepCopyFrom.GetDeviceId() != CPUDEVICE && GetDeviceId() != deepCopyFrom.GetDeviceId())
+        m_GPUMatrix->AssignPeerCopyOf(*deepCopyFrom.m_GPUMatrix);
+    else // (same device, or one side on the CPU, or sparse)
+        AssignValuesOf(deepCopyFrom);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::AssignValuesOf(const Matrix<ElemType>& deepCopyFrom)
 {
@@ -1360,6 +1460,36 @@ void Matrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCC
         { m_GPUSparseMatrix->SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols, false, -1, transferer); });
 }
 
+template <class ElemType>
+void Matrix<ElemType>::GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const
+{
+    if (GetMatrixType() != MatrixType::SPARSE || GetFormat() != matrixFormatSparseBlockCol)
+        LogicError("GetMatrixFromSBCFormat: The matrix is not in SparseBlockCol format.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, nullptr,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { m_CPUSparseMatrix->GetMatrixFromSBCFormat(blockIds, val); },
+        {
+            CPUSparseMatrix<ElemType> cpuSparseMatrix(matrixFormatSparseBlockCol);
+            m_GPUSparseMatrix->CopyToCPUSparseMatrix(cpuSparseMatrix);
+            cpuSparseMatrix.GetMatrixFromSBCFormat(blockIds, val);
+        });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols)
+{
+    if (GetMatrixType() != MatrixType::SPARSE)
+        LogicError("SetMatrixFromSBCFormat: The matrix is not sparse.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { m_CPUSparseMatrix->SetMatrixFromSBCFormat(blockIds, val, numBlocks, numRows, numCols); },
+        { m_GPUSparseMatrix->SetMatrixFromSBCFormat(blockIds, val, numBlocks, numRows, numCols); });
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
@@ -1484,6 +1614,137 @@ void Matrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const ElemT
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::Dropout(const ElemType beta, const Matrix<ElemType>& a, const ElemType dropoutRate, const uint64_t seed, const uint64_t offset, Matrix<ElemType>& c)
+{
+    if (dropoutRate < 0 || dropoutRate >= 1)
+        InvalidArgument("Dropout: The dropout rate must be >= 0 and < 1.");
+    DecideAndMoveToRightDevice(a, c);
+    if (beta == 0)
+        c.Resize(a);
+    else if (c.GetNumRows() != a.GetNumRows() || c.GetNumCols() != a.GetNumCols())
+        LogicError("Dropout: The output must have the dimensions of the input.");
+
+    DISPATCH_MATRIX_ON_FLAG(&c,
+                            &c,
+                            CPUMatrix<ElemType>::Dropout(beta, *a.m_CPUMatrix, dropoutRate, seed, offset, *c.m_CPUMatrix),
+                            GPUMatrix<ElemType>::Dropout(beta, *a.m_GPUMatrix, dropoutRate, seed, offset, *c.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::SetCounterBasedUniformRandomValue(const ElemType low, const ElemType high, const uint64_t seed)
+{
+    if (IsEmpty())
+        return;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->SetCounterBasedUniformRandomValue(low, high, seed),
+                            m_GPUMatrix->SetCounterBasedUniformRandomValue(low, high, seed),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::SetCounterBasedGaussianRandomValue(const ElemType mean, const ElemType sigma, const uint64_t seed)
+{
+    if (sigma <= 0)
+        InvalidArgument("SetCounterBasedGaussianRandomValue: sigma must be a positive value.");
+
+    if (IsEmpty())
+        return;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->SetCounterBasedGaussianRandomValue(mean, sigma, seed),
+                            m_GPUMatrix->SetCounterBasedGaussianRandomValue(mean, sigma, seed),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+static void VerifyWeightedSamplingArguments(const char* function, const Matrix<ElemType>& result, const Matrix<ElemType>& weights)
+{
+    if (weights.GetDeviceId() != result.GetDeviceId())
+        NOT_IMPLEMENTED;
+    if (weights.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+    if (weights.GetNumCols() != 1 || weights.IsEmpty())
+        InvalidArgument("%s: The weights must be a column vector.", function);
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignWeightedRandomSamples(const Matrix<ElemType>& weights, size_t numSamples, bool allowDuplicates, const uint64_t seed, const uint64_t offset, Matrix<ElemType>& workspace)
+{
+    VerifyWeightedSamplingArguments("AssignWeightedRandomSamples", *this, weights);
+    if (!allowDuplicates && numSamples > weights.GetNumRows())
+        InvalidArgument("AssignWeightedRandomSamples: %d samples without duplicates cannot be drawn from %d classes.", (int) numSamples, (int) weights.GetNumRows());
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    workspace.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    if (allowDuplicates)
+    {
+        DISPATCH_MATRIX_ON_FLAG(this, this,
+            { m_CPUMatrix->AssignWeightedRandomSamplesWithReplacement(*weights.m_CPUMatrix, numSamples, seed, offset, *workspace.m_CPUMatrix); },
+            { m_GPUMatrix->AssignWeightedRandomSamplesWithReplacement(*weights.m_GPUMatrix, numSamples, seed, offset, *workspace.m_GPUMatrix); },
+            { NOT_IMPLEMENTED; },
+            { NOT_IMPLEMENTED; });
+    }
+    else
+    {
+        DISPATCH_MATRIX_ON_FLAG(&workspace, &workspace,
+            { workspace.m_CPUMatrix->AssignWeightedSampleKeys(*weights.m_CPUMatrix, seed, offset); },
+            { workspace.m_GPUMatrix->AssignWeightedSampleKeys(*weights.m_GPUMatrix, seed, offset); },
+            { NOT_IMPLEMENTED; },
+            { NOT_IMPLEMENTED; });
+        // the largest keys in descending order, ties by class
+        Matrix<ElemType> sampledKeys(GetDeviceId());
+        workspace.VectorMax(*this, sampledKeys, /*isColWise=*/true, (int) numSamples);
+    }
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignWeightedSampleInclusionFrequencies(const Matrix<ElemType>& weights, size_t numSamples, bool allowDuplicates, const Matrix<ElemType>& samples)
+{
+    VerifyWeightedSamplingArguments("AssignWeightedSampleInclusionFrequencies", *this, weights);
+    if (!allowDuplicates && (samples.GetDeviceId() != GetDeviceId() || samples.GetMatrixType() != MatrixType::DENSE || samples.GetNumRows() != numSamples || samples.GetNumCols() == 0))
+        LogicError("AssignWeightedSampleInclusionFrequencies: The samples must be dense columns of %d samples on the device of the weights.", (int) numSamples);
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignWeightedSampleInclusionFrequencies(*weights.m_CPUMatrix, numSamples, allowDuplicates, *samples.m_CPUMatrix); },
+        { m_GPUMatrix->AssignWeightedSampleInclusionFrequencies(*weights.m_GPUMatrix, numSamples, allowDuplicates, *samples.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignOneHotColumns(const Matrix<ElemType>& rowIndices, size_t numRows)
+{
+    if (rowIndices.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+    if (rowIndices.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { m_CPUSparseMatrix->AssignOneHotColumns(*rowIndices.m_CPUMatrix, numRows); },
+        { m_GPUSparseMatrix->AssignOneHotColumns(*rowIndices.m_GPUMatrix, numRows); });
+
+    return *this;
+}
+
 template <class ElemType>
 void Matrix<ElemType>::NormalGrad(Matrix<ElemType>& gradients,
                                   Matrix<ElemType>& functionValues,
@@ -1593,6 +1854,48 @@ void Matrix<ElemType>::FSAdagradUpdate(size_t mbSize,
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+// Adam update in a single fused pass over the parameter
+// updates
+//  - the var momentum accumulator v = varMomentum * v + (1 - varMomentum) * g^2 (first half of 'this')
+//  - the momentum accumulator m = meanMomentum * m + (1 - meanMomentum) * g (second half of 'this')
+// then
+//  - the model itself, by learnRatePerSample * m / (sqrt(v) + epsilon), with the bias correction of the zero-initialized accumulators
+// The smoothed gradient has the same layout as in FSAdagradUpdate(). With weightDecay > 0, the model is first shrunk by
+// learnRatePerSample * weightDecay, decoupled from the gradient (AdamW).
+template <class ElemType>
+void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
+                                  const double learnRatePerSample, const double meanMomentum, const double varMomentum,
+                                  const double epsilon, const double weightDecay)
+{
+    smoothedCount++;
+    let biasCorrection = (ElemType) GetAdamBiasCorrection(meanMomentum, varMomentum, smoothedCount);
+    let decay = (ElemType) (learnRatePerSample * weightDecay);
+    DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
+        { m_CPUMatrix->Adam(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, biasCorrection, (ElemType)epsilon, decay); SetDataLocation(CPU); },
+        { m_GPUMatrix->Adam(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, biasCorrection, (ElemType)epsilon, decay); SetDataLocation(GPU); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::LambUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
+                                  const double learnRatePerSample, const double meanMomentum, const double varMomentum,
+                                  const double epsilon, const double weightDecay)
+{
+    smoothedCount++;
+    MultiTensorUpdateParams<ElemType> params = {};
+    params.rule = MultiTensorUpdateRule::Lamb;
+    params.momentum = (ElemType) meanMomentum;
+    params.varMomentum = (ElemType) varMomentum;
+    params.adamEpsilon = (ElemType) epsilon;
+    std::vector<MultiTensorUpdateItem<ElemType>> items(1, MultiTensorUpdateItem<ElemType>());
+    items[0].learnRatePerSample = (ElemType) learnRatePerSample;
+    items[0].gradientScale = 1;
+    items[0].adaMul = (ElemType) GetAdamBiasCorrection(meanMomentum, varMomentum, smoothedCount);
+    items[0].decoupledDecay = (ElemType) weightDecay;
+    MultiTensorUpdate({ &functionValues }, { &gradients }, { this }, items, params);
+}
+
 template <class ElemType>
 ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
                                    ElemType RMS_GAMMA,
@@ -1612,6 +1915,245 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+// Lazy momentum SGD update for block-column sparse gradients, e.g. of an embedding whose input is sparse.
+// Unlike NormalGrad(), which lets the smoothed gradient of the columns not present in the gradient stand still,
+// this gives the result of the dense update while still touching only the present columns: the updates that a column
+// skipped since lastUpdates[column] had a zero gradient there, and their effect (the smoothed gradient decays and keeps
+// moving the weights) is caught up in closed form before the current gradient is applied. This is exact as long as the
+// momentum did not change in between. Dense gradients are updated densely, bringing all columns up to date.
+template <class ElemType>
+void Matrix<ElemType>::LazyNormalGrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                                      const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum)
+{
+    if (gradients.GetMatrixType() != MatrixType::SPARSE)
+    {
+        NormalGrad(gradients, functionValues, learnRatePerSample, momentum, useNesterovMomentum);
+        lastUpdates.assign(functionValues.GetNumCols(), updateCount);
+        return;
+    }
+
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients, nullptr,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { gradients.m_CPUSparseMatrix->LazyNormalGrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, lastUpdates, updateCount, learnRatePerSample, momentum, useNesterovMomentum); SetDataLocation(CPU); functionValues.SetDataLocation(CPU); },
+        { gradients.m_GPUSparseMatrix->LazyNormalGrad(*m_GPUMatrix, *functionValues.m_GPUMatrix, lastUpdates, updateCount, learnRatePerSample, momentum, useNesterovMomentum); SetDataLocation(GPU); functionValues.SetDataLocation(GPU); });
+}
+
+// lazy FSAdaGrad update for block-column sparse gradients, see LazyNormalGrad()
+// Besides the momentum accumulator, the skipped updates decay the variance accumulator by varMomentum per update.
+template <class ElemType>
+void Matrix<ElemType>::LazyFSAdagradUpdate(size_t mbSize,
+                                           Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
+                                           std::vector<size_t>& lastUpdates, size_t updateCount,
+                                           const double learnRatePerSample, const double targetAdagradAvDenom,
+                                           const double meanMomentum, const double varMomentum)
+{
+    if (gradients.GetMatrixType() != MatrixType::SPARSE)
+    {
+        FSAdagradUpdate(mbSize, gradients, functionValues, smoothedCount, learnRatePerSample, targetAdagradAvDenom, meanMomentum, varMomentum);
+        lastUpdates.assign(functionValues.GetNumCols(), updateCount);
+        return;
+    }
+
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    // same as in FSAdagradUpdate()
+    smoothedCount = varMomentum * smoothedCount + (1.0 - varMomentum) * mbSize;
+    let targetAdagradAvDenom_x_sqrtAdagradSqrFrames = (ElemType)(targetAdagradAvDenom * sqrt(smoothedCount));
+    DISPATCH_MATRIX_ON_FLAG(&gradients, nullptr,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { gradients.m_CPUSparseMatrix->LazyFSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, lastUpdates, updateCount, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames); SetDataLocation(CPU); functionValues.SetDataLocation(CPU); },
+        { gradients.m_GPUSparseMatrix->LazyFSAdagrad(*m_GPUMatrix, *functionValues.m_GPUMatrix, lastUpdates, updateCount, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames); SetDataLocation(GPU); functionValues.SetDataLocation(GPU); });
+}
+
+// Catch up the lazy momentum updates of all columns that are behind update updateCount, so that the model equals that
+// of the dense update. This is a dense operation, meant for when the model is saved or evaluated.
+// The catch-up factors are row vectors that scale the columns of the smoothed gradient.
+template <class ElemType>
+void Matrix<ElemType>::CatchUpLazyNormalGrad(Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                                             const ElemType momentum, const bool useNesterovMomentum)
+{
+    size_t numCols = functionValues.GetNumCols();
+    if (IsEmpty() || lastUpdates.size() != numCols)
+        return;
+
+    std::vector<ElemType> decays(numCols), moveFactors(numCols);
+    bool isBehind = false;
+    for (size_t j = 0; j < numCols; j++)
+    {
+        size_t skipped = updateCount - lastUpdates[j];
+        isBehind |= skipped > 0;
+        GetLazyMomentumCatchUp(momentum, skipped, decays[j], moveFactors[j]);
+        if (useNesterovMomentum)
+            moveFactors[j] *= momentum;
+        lastUpdates[j] = updateCount;
+    }
+    if (!isBehind)
+        return;
+
+    Matrix<ElemType> decayRow(1, numCols, decays.data(), GetDeviceId());
+    Matrix<ElemType> moveFactorRow(1, numCols, moveFactors.data(), GetDeviceId());
+    Matrix<ElemType> movement = DeepClone();
+    movement.RowElementMultiplyWith(moveFactorRow);
+    functionValues -= movement;
+    RowElementMultiplyWith(decayRow);
+}
+
+// catch up the lazy FSAdaGrad updates of all columns, see CatchUpLazyNormalGrad()
+template <class ElemType>
+void Matrix<ElemType>::CatchUpLazyFSAdagrad(Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                                            const double learnRatePerSample, const double meanMomentum, const double varMomentum)
+{
+    size_t numCols = functionValues.GetNumCols();
+    if (IsEmpty() || lastUpdates.size() != numCols)
+        return;
+
+    std::vector<ElemType> adaDecays(numCols), momDecays(numCols), moveFactors(numCols);
+    bool isBehind = false;
+    for (size_t j = 0; j < numCols; j++)
+    {
+        size_t skipped = updateCount - lastUpdates[j];
+        isBehind |= skipped > 0;
+        ElemType unused;
+        GetLazyMomentumCatchUp((ElemType) varMomentum, skipped, adaDecays[j], unused);
+        GetLazyMomentumCatchUp((ElemType) (meanMomentum > 0 ? meanMomentum : 0), skipped, momDecays[j], moveFactors[j]);
+        moveFactors[j] *= (ElemType) learnRatePerSample;
+        lastUpdates[j] = updateCount;
+    }
+    if (!isBehind)
+        return;
+
+    // the smoothed gradient holds the variance accumulator in its first, the momentum accumulator in its second half
+    Matrix<ElemType> smoothAda = ColumnSlice(0, numCols);
+    Matrix<ElemType> smoothMom = ColumnSlice(numCols, numCols);
+    Matrix<ElemType> adaDecayRow(1, numCols, adaDecays.data(), GetDeviceId());
+    Matrix<ElemType> momDecayRow(1, numCols, momDecays.data(), GetDeviceId());
+    Matrix<ElemType> moveFactorRow(1, numCols, moveFactors.data(), GetDeviceId());
+    Matrix<ElemType> movement = smoothMom.DeepClone();
+    movement.RowElementMultiplyWith(moveFactorRow);
+    functionValues -= movement;
+    smoothMom.RowElementMultiplyWith(momDecayRow);
+    smoothAda.RowElementMultiplyWith(adaDecayRow);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiTensorUpdate(const std::vector<Matrix<ElemType>*>& values, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& smoothedGradients,
+                                                  std::vector<MultiTensorUpdateItem<ElemType>>& items, const MultiTensorUpdateParams<ElemType>& params,
+                                                  const std::vector<Matrix<ElemType>*>& emaValues)
+{
+    if (values.size() != items.size() || gradients.size() != items.size() || smoothedGradients.size() != items.size())
+        LogicError("MultiTensorUpdate: There must be as many values, gradients, and smoothed gradients as items.");
+    if (!emaValues.empty() && emaValues.size() != items.size())
+        LogicError("MultiTensorUpdate: There must be as many moving averages as items.");
+    if (items.empty())
+        return;
+
+    const size_t stateSize = MultiTensorUpdateStateSize(params.rule);
+    DEVICEID_TYPE deviceId = values[0]->GetDeviceId();
+    for (size_t k = 0; k < items.size(); k++)
+    {
+        auto& value = *values[k];
+        auto& gradient = *gradients[k];
+        auto& smoothedGradient = *smoothedGradients[k];
+        if (value.GetMatrixType() != DENSE || gradient.GetMatrixType() != DENSE || smoothedGradient.GetMatrixType() != DENSE)
+            RuntimeError("MultiTensorUpdate: Sparse matrices are not supported.");
+        DecideAndMoveToRightDevice(value, gradient, smoothedGradient);
+        if (value.GetDeviceId() != deviceId)
+            RuntimeError("MultiTensorUpdate: All matrices must be on the same device.");
+        if (gradient.GetNumRows() != value.GetNumRows() || gradient.GetNumCols() != value.GetNumCols())
+            LogicError("MultiTensorUpdate: The gradient must have the dimensions of the value.");
+
+        // allocate the state on first use, like the single-tensor updates do
+        bool initializeState = smoothedGradient.GetNumRows() != gradient.GetNumRows() || smoothedGradient.GetNumCols() < stateSize * gradient.GetNumCols();
+        if (initializeState)
+        {
+            smoothedGradient.Resize(gradient.GetNumRows(), stateSize * gradient.GetNumCols());
+            smoothedGradient.SetValue(0);
+        }
+
+        auto& item = items[k];
+        item.value = value.Data();
+        item.gradient = gradient.Data();
+        item.state = smoothedGradient.Data();
+        item.n = gradient.GetNumElements();
+        item.initializeState = initializeState;
+
+        Matrix<ElemType>* ema = emaValues.empty() ? nullptr : emaValues[k];
+        item.ema = nullptr;
+        if (ema)
+        {
+            if (ema->GetMatrixType() != DENSE || ema->GetDeviceId() != deviceId)
+                RuntimeError("MultiTensorUpdate: Moving averages must be dense and on the device of the values.");
+            if (ema->GetNumElements() == 0)
+                ema->SetValue(value);
+            else if (ema->GetNumRows() != value.GetNumRows() || ema->GetNumCols() != value.GetNumCols())
+                LogicError("MultiTensorUpdate: The moving average must have the dimensions of the value.");
+            item.ema = ema->Data();
+        }
+    }
+
+    // the layer-wise trust ratios need the norms of the weights, and for Lars also of the gradients, all from one pass
+    if (params.rule == MultiTensorUpdateRule::Lars || params.rule == MultiTensorUpdateRule::Lamb)
+    {
+        std::vector<const Matrix<ElemType>*> matrices(values.begin(), values.end());
+        if (params.rule == MultiTensorUpdateRule::Lars)
+            matrices.insert(matrices.end(), gradients.begin(), gradients.end());
+        auto sumsOfSquares = MultiTensorSumOfSquares(matrices);
+        for (size_t k = 0; k < items.size(); k++)
+        {
+            auto& item = items[k];
+            item.weightNorm = (ElemType) sqrt(sumsOfSquares[k]);
+            if (params.rule == MultiTensorUpdateRule::Lars)
+                item.trustRatio = (ElemType) GetLarsTrustRatio(item.weightNorm, sqrt(sumsOfSquares[items.size() + k]) * item.gradientScale, item.l2RegWeight, params.larsCoefficient);
+        }
+    }
+
+    if (deviceId == CPUDEVICE)
+        CPUMatrix<ElemType>::MultiTensorUpdate(items, params);
+    else
+        GPUMatrix<ElemType>::MultiTensorUpdate(deviceId, items, params);
+
+    // Note: Values, gradients, smoothed gradients, and moving averages may all have changed.
+    for (size_t k = 0; k < items.size(); k++)
+    {
+        for (auto* matrix : { values[k], gradients[k], smoothedGradients[k], emaValues.empty() ? nullptr : emaValues[k] })
+        {
+            if (matrix)
+                matrix->SetDataLocation(deviceId == CPUDEVICE ? CPU : GPU, DENSE);
+        }
+    }
+}
+
+template <class ElemType>
+/*static*/ std::vector<double> Matrix<ElemType>::MultiTensorSumOfSquares(const std::vector<const Matrix<ElemType>*>& matrices)
+{
+    std::vector<double> sumsOfSquares;
+    if (matrices.empty())
+        return sumsOfSquares;
+
+    DEVICEID_TYPE deviceId = matrices[0]->GetDeviceId();
+    std::vector<const ElemType*> data;
+    std::vector<size_t> sizes;
+    for (const auto* matrix : matrices)
+    {
+        if (matrix->GetMatrixType() != DENSE)
+            RuntimeError("MultiTensorSumOfSquares: Sparse matrices are not supported.");
+        if (matrix->GetDeviceId() != deviceId)
+            RuntimeError("MultiTensorSumOfSquares: All matrices must be on the same device.");
+        data.push_back(matrix->Data());
+        sizes.push_back(matrix->GetNumElements());
+    }
+
+    if (deviceId == CPUDEVICE)
+        CPUMatrix<ElemType>::MultiTensorSumOfSquares(data, sizes, sumsOfSquares);
+    else
+        GPUMatrix<ElemType>::MultiTensorSumOfSquares(deviceId, data, sizes, sumsOfSquares);
+    return sumsOfSquares;
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -2620,6 +3162,32 @@ Matrix<ElemType>& Matrix<ElemType>::AssignLogSoftmaxOf(const Matrix<ElemType>& a
     return *this;
 }
 
+// column-wise softmax cross entropy, per column, without forming the softmax; see the declaration
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignSoftmaxCrossEntropyOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp)
+{
+    if (logits.IsEmpty())
+        LogicError("AssignSoftmaxCrossEntropyOf: Matrix logits is empty.");
+    DecideAndMoveToRightDevice(logits, labels, *this);
+    logSumExp._transferToDevice(logits.GetDeviceId());
+
+    if (logits.GetMatrixType() != MatrixType::DENSE || labels.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    logSumExp.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&logits,
+                            this,
+                            m_CPUMatrix->AssignSoftmaxCrossEntropyOf(*labels.m_CPUMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix),
+                            m_GPUMatrix->AssignSoftmaxCrossEntropyOf(*labels.m_GPUMatrix, *logits.m_GPUMatrix, *logSumExp.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    logSumExp.SetDataLocation(GetCurrentMatrixLocation(), MatrixType::DENSE);
+
+    return *this;
+}
+
 //[this]=softmax([this]) element wise
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::InplaceHardmax(const bool isColWise)
@@ -3542,6 +4110,17 @@ int Matrix<ElemType>::GetDeviceId() const
         { return m_GPUSparseMatrix->GetComputeDeviceId(); });
 }
 
+// Only reads the state of the matrices; BOTH is not resolved since a write must collapse it.
+template <class ElemType>
+bool Matrix<ElemType>::IsResolvedDenseWith(const Matrix<ElemType>& a) const
+{
+    if (m_matrixType != MatrixType::DENSE || a.m_matrixType != MatrixType::DENSE || a.m_currentDataLocation != m_currentDataLocation)
+        return false;
+    if (m_currentDataLocation == CurrentDataLocation::CPU)
+        return true;
+    return m_currentDataLocation == CurrentDataLocation::GPU && a.m_GPUMatrix->GetComputeDeviceId() == m_GPUMatrix->GetComputeDeviceId();
+}
+
 template <class ElemType>
 MatrixType Matrix<ElemType>::GetMatrixType() const
 {
@@ -4027,16 +4606,489 @@ Matrix<ElemType>& Matrix<ElemType>::AssignSoftmaxSum(const Matrix<ElemType>& a,
 }
 
 template <class ElemType>
-Matrix<ElemType>& Matrix<ElemType>::AssignNceUnnormalizedEval(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias)
+Matrix<ElemType>& Matrix<ElemType>::AssignAugmentedImages(Matrix<ElemType>& workspace, size_t numImages, const ImageAugmentationParameters& parameters, uint64_t seed)
 {
-    // if (a.GetMatrixType() != MatrixType::SPARSE)
-    //    NOT_IMPLEMENTED;
+    if (workspace.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    if (parameters.m_channels == 0 || parameters.m_channels > 4)
+        InvalidArgument("AssignAugmentedImages: images must have 1 to 4 channels, %d given.", (int)parameters.m_channels);
+
+    if (numImages % parameters.GetNumViews() != 0 ||
+        (parameters.GetNumViews() > 1 && (parameters.m_numViews != 10 || parameters.m_sourceWidth < parameters.m_width || parameters.m_sourceHeight < parameters.m_height)))
+        InvalidArgument("AssignAugmentedImages: %d views of %dx%d images are not supported for %d output images of %dx%d.",
+                        (int)parameters.m_numViews, (int)parameters.m_sourceWidth, (int)parameters.m_sourceHeight, (int)numImages, (int)parameters.m_width, (int)parameters.m_height);
+
+    if (workspace.GetNumElements() * sizeof(ElemType) < GetImageAugmentationWorkspaceLayout(parameters, numImages).m_size)
+        LogicError("AssignAugmentedImages: the workspace is too small for %d images.", (int)numImages);
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignAugmentedImages(*workspace.m_CPUMatrix, numImages, parameters, seed); },
+        { m_GPUMatrix->AssignAugmentedImages(*workspace.m_GPUMatrix, numImages, parameters, seed); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignWidenedValuesOf(const Matrix<ElemType>& packed, NarrowElementType type, size_t numRows, size_t numCols, ElemType scale, ElemType shift)
+{
+    if (packed.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    if (packed.GetNumElements() * sizeof(ElemType) < numRows * numCols * GetNarrowElementSize(type))
+        LogicError("AssignWidenedValuesOf: the packed matrix is too small for %d x %d values.", (int)numRows, (int)numCols);
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignWidenedValuesOf(*packed.m_CPUMatrix, type, numRows, numCols, scale, shift); },
+        { m_GPUMatrix->AssignWidenedValuesOf(*packed.m_GPUMatrix, type, numRows, numCols, scale, shift); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignRanksWithinQueries(const Matrix<ElemType>& scores, const Matrix<ElemType>& gains, const Matrix<ElemType>& queryIds)
+{
+    if (scores.GetDeviceId() != GetDeviceId() || gains.GetDeviceId() != GetDeviceId() || queryIds.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    if (scores.GetNumElements() != gains.GetNumElements() || queryIds.GetNumElements() != gains.GetNumElements())
+        LogicError("AssignRanksWithinQueries: the scores, gains and query ids must have the same number of elements.");
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignRanksWithinQueries(*scores.m_CPUMatrix, *gains.m_CPUMatrix, *queryIds.m_CPUMatrix); },
+        { m_GPUMatrix->AssignRanksWithinQueries(*scores.m_GPUMatrix, *gains.m_GPUMatrix, *queryIds.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignNDCGContributions(const Matrix<ElemType>& gains, const Matrix<ElemType>& ranks, const Matrix<ElemType>& queryIds, bool atOne, Matrix<ElemType>& queryStarts)
+{
+    if (gains.GetDeviceId() != GetDeviceId() || ranks.GetDeviceId() != GetDeviceId() || queryIds.GetDeviceId() != GetDeviceId() || queryStarts.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    if (ranks.GetNumElements() != gains.GetNumElements() || queryIds.GetNumElements() != gains.GetNumElements())
+        LogicError("AssignNDCGContributions: the gains, ranks and query ids must have the same number of elements.");
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    queryStarts.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignNDCGContributions(*gains.m_CPUMatrix, *ranks.m_CPUMatrix, *queryIds.m_CPUMatrix, atOne, *queryStarts.m_CPUMatrix); },
+        { m_GPUMatrix->AssignNDCGContributions(*gains.m_GPUMatrix, *ranks.m_GPUMatrix, *queryIds.m_GPUMatrix, atOne, *queryStarts.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddLambdaRankGradient(const Matrix<ElemType>& gains, const Matrix<ElemType>& scores, const Matrix<ElemType>& ranks, const Matrix<ElemType>& queryIds, ElemType sigma)
+{
+    if (gains.GetDeviceId() != GetDeviceId() || scores.GetDeviceId() != GetDeviceId() || ranks.GetDeviceId() != GetDeviceId() || queryIds.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    if (scores.GetNumElements() != gains.GetNumElements() || ranks.GetNumElements() != gains.GetNumElements() || queryIds.GetNumElements() != gains.GetNumElements())
+        LogicError("AddLambdaRankGradient: the gains, scores, ranks and query ids must have the same number of elements.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AddLambdaRankGradient(*gains.m_CPUMatrix, *scores.m_CPUMatrix, *ranks.m_CPUMatrix, *queryIds.m_CPUMatrix, sigma); },
+        { m_GPUMatrix->AddLambdaRankGradient(*gains.m_GPUMatrix, *scores.m_GPUMatrix, *ranks.m_GPUMatrix, *queryIds.m_GPUMatrix, sigma); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+static void VerifyCRFArguments(const char* function, const Matrix<ElemType>& result, const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& sequences, size_t stride)
+{
+    for (const Matrix<ElemType>* argument : { &scores, &transitions, &sequences })
+    {
+        if (argument->GetDeviceId() != result.GetDeviceId())
+            NOT_IMPLEMENTED;
+        if (argument->GetMatrixType() != MatrixType::DENSE)
+            NOT_IMPLEMENTED;
+    }
+
+    if (transitions.GetNumRows() != scores.GetNumRows() || transitions.GetNumCols() != scores.GetNumRows())
+        LogicError("%s: the transitions must be %d x %d, as there are %d labels.", function, (int)scores.GetNumRows(), (int)scores.GetNumRows(), (int)scores.GetNumRows());
+    if (stride == 0 || scores.GetNumCols() % stride != 0)
+        LogicError("%s: the %d columns of the scores are not a multiple of the %d parallel sequences.", function, (int)scores.GetNumCols(), (int)stride);
+    if (sequences.GetNumRows() != 2 && !sequences.IsEmpty())
+        LogicError("%s: the sequences must be given as 2 x numSequences (first column, number of frames).", function);
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCRFForwardScores(const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& sequences, size_t stride)
+{
+    VerifyCRFArguments("AssignCRFForwardScores", *this, scores, transitions, sequences, stride);
+    if (labelIndices.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignCRFForwardScores(*scores.m_CPUMatrix, *transitions.m_CPUMatrix, *labelIndices.m_CPUMatrix, *sequences.m_CPUMatrix, stride); },
+        { m_GPUMatrix->AssignCRFForwardScores(*scores.m_GPUMatrix, *transitions.m_GPUMatrix, *labelIndices.m_GPUMatrix, *sequences.m_GPUMatrix, stride); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCRFLogPosteriors(const Matrix<ElemType>& alpha, const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& sequences, size_t stride)
+{
+    VerifyCRFArguments("AssignCRFLogPosteriors", *this, scores, transitions, sequences, stride);
+    if (alpha.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignCRFLogPosteriors(*alpha.m_CPUMatrix, *scores.m_CPUMatrix, *transitions.m_CPUMatrix, *sequences.m_CPUMatrix, stride); },
+        { m_GPUMatrix->AssignCRFLogPosteriors(*alpha.m_GPUMatrix, *scores.m_GPUMatrix, *transitions.m_GPUMatrix, *sequences.m_GPUMatrix, stride); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCRFNegativeLogLikelihoods(const Matrix<ElemType>& alpha, const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& sequences, size_t stride)
+{
+    VerifyCRFArguments("AssignCRFNegativeLogLikelihoods", *this, scores, transitions, sequences, stride);
+    if (alpha.GetDeviceId() != GetDeviceId() || labelIndices.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignCRFNegativeLogLikelihoods(*alpha.m_CPUMatrix, *scores.m_CPUMatrix, *transitions.m_CPUMatrix, *labelIndices.m_CPUMatrix, *sequences.m_CPUMatrix, stride); },
+        { m_GPUMatrix->AssignCRFNegativeLogLikelihoods(*alpha.m_GPUMatrix, *scores.m_GPUMatrix, *transitions.m_GPUMatrix, *labelIndices.m_GPUMatrix, *sequences.m_GPUMatrix, stride); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCRFTransitionGradient(const Matrix<ElemType>& logPosteriors, const Matrix<ElemType>& alpha, const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions,
+                                                                const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& sequences, size_t stride)
+{
+    VerifyCRFArguments("AssignCRFTransitionGradient", *this, scores, transitions, sequences, stride);
+    if (logPosteriors.GetDeviceId() != GetDeviceId() || alpha.GetDeviceId() != GetDeviceId() || labelIndices.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignCRFTransitionGradient(*logPosteriors.m_CPUMatrix, *alpha.m_CPUMatrix, *scores.m_CPUMatrix, *transitions.m_CPUMatrix, *labelIndices.m_CPUMatrix, *sequences.m_CPUMatrix, stride); },
+        { m_GPUMatrix->AssignCRFTransitionGradient(*logPosteriors.m_GPUMatrix, *alpha.m_GPUMatrix, *scores.m_GPUMatrix, *transitions.m_GPUMatrix, *labelIndices.m_GPUMatrix, *sequences.m_GPUMatrix, stride); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCRFViterbiPath(const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& sequences, size_t stride,
+                                                         Matrix<ElemType>& viterbiScores, Matrix<ElemType>& backPointers)
+{
+    VerifyCRFArguments("AssignCRFViterbiPath", *this, scores, transitions, sequences, stride);
+    if (labelIndices.GetDeviceId() != GetDeviceId() || viterbiScores.GetDeviceId() != GetDeviceId() || backPointers.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    viterbiScores.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    backPointers.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignCRFViterbiPath(*scores.m_CPUMatrix, *transitions.m_CPUMatrix, *labelIndices.m_CPUMatrix, *sequences.m_CPUMatrix, stride, *viterbiScores.m_CPUMatrix, *backPointers.m_CPUMatrix); },
+        { m_GPUMatrix->AssignCRFViterbiPath(*scores.m_GPUMatrix, *transitions.m_GPUMatrix, *labelIndices.m_GPUMatrix, *sequences.m_GPUMatrix, stride, *viterbiScores.m_GPUMatrix, *backPointers.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
 
-    Resize(1, 1);
-    if (GetDeviceId() < 0)
-        a.m_CPUMatrix->AssignNCEUnnormalizedEval(*b.m_CPUMatrix, *c.m_CPUMatrix, *bias.m_CPUMatrix, *m_CPUMatrix);
-    else
-        a.m_GPUMatrix->AssignNCEUnnormalizedEval(*b.m_GPUMatrix, *c.m_GPUMatrix, *m_GPUMatrix);
+    return *this;
+}
+
+template <class ElemType>
+static void VerifySequenceCompactionArguments(const char* function, const Matrix<ElemType>& result, const Matrix<ElemType>& a, const Matrix<ElemType>& sequences, const Matrix<ElemType>* outputSequences)
+{
+    for (const Matrix<ElemType>* argument : { &a, &sequences, outputSequences })
+    {
+        if (!argument)
+            continue;
+        if (argument->GetDeviceId() != result.GetDeviceId())
+            NOT_IMPLEMENTED;
+        if (argument->GetMatrixType() != MatrixType::DENSE)
+            NOT_IMPLEMENTED;
+    }
+    if (a.GetNumRows() != 1)
+        LogicError("%s: the data must be a row vector.", function);
+    if (sequences.GetNumRows() != 2 || (outputSequences && (outputSequences->GetNumRows() != 2 || outputSequences->GetNumCols() != sequences.GetNumCols())))
+        LogicError("%s: the sequences must be a 2 x numSequences matrix of (first column, number of frames), and the same number for input and output.", function);
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignNonZeroCountsOfSequences(const Matrix<ElemType>& a, const Matrix<ElemType>& sequences, size_t stride)
+{
+    VerifySequenceCompactionArguments("AssignNonZeroCountsOfSequences", *this, a, sequences, (const Matrix<ElemType>*) nullptr);
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignNonZeroCountsOfSequences(*a.m_CPUMatrix, *sequences.m_CPUMatrix, stride); },
+        { m_GPUMatrix->AssignNonZeroCountsOfSequences(*a.m_GPUMatrix, *sequences.m_GPUMatrix, stride); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignNonZeroPositionsOfSequences(const Matrix<ElemType>& a, const Matrix<ElemType>& sequences, size_t stride, const Matrix<ElemType>& outputSequences, size_t outputStride)
+{
+    VerifySequenceCompactionArguments("AssignNonZeroPositionsOfSequences", *this, a, sequences, &outputSequences);
+    if (GetMatrixType() != MatrixType::DENSE || GetNumRows() != 1)
+        LogicError("AssignNonZeroPositionsOfSequences: the result must be a dense row vector of the size of the output layout.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignNonZeroPositionsOfSequences(*a.m_CPUMatrix, *sequences.m_CPUMatrix, stride, *outputSequences.m_CPUMatrix, outputStride); },
+        { m_GPUMatrix->AssignNonZeroPositionsOfSequences(*a.m_GPUMatrix, *sequences.m_GPUMatrix, stride, *outputSequences.m_GPUMatrix, outputStride); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignColumnsOfSequencePositions(const Matrix<ElemType>& positions, const Matrix<ElemType>& sequences, size_t stride, const Matrix<ElemType>& targetSequences, size_t targetStride)
+{
+    VerifySequenceCompactionArguments("AssignColumnsOfSequencePositions", *this, positions, sequences, &targetSequences);
+    if (this != &positions)
+    {
+        SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+        Resize(1, positions.GetNumCols());
+    }
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignColumnsOfSequencePositions(*positions.m_CPUMatrix, *sequences.m_CPUMatrix, stride, *targetSequences.m_CPUMatrix, targetStride); },
+        { m_GPUMatrix->AssignColumnsOfSequencePositions(*positions.m_GPUMatrix, *sequences.m_GPUMatrix, stride, *targetSequences.m_GPUMatrix, targetStride); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+static void VerifyGMMArguments(const char* function, const Matrix<ElemType>& result, const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features)
+{
+    for (const Matrix<ElemType>* argument : { &unnormedPrior, &means, &logStddevs, &features })
+    {
+        if (argument->GetDeviceId() != result.GetDeviceId())
+            NOT_IMPLEMENTED;
+        if (argument->GetMatrixType() != MatrixType::DENSE)
+            NOT_IMPLEMENTED;
+    }
+
+    size_t numComponents = unnormedPrior.GetNumRows();
+    size_t numSamples = features.GetNumCols();
+    if (numComponents == 0 || logStddevs.GetNumRows() != numComponents || means.GetNumRows() != numComponents * features.GetNumRows())
+        LogicError("%s: the unnormed prior and the log stddevs must have a row per component, the means a row per component and feature dimension.", function);
+    for (const Matrix<ElemType>* parameter : { &unnormedPrior, &means, &logStddevs })
+    {
+        if (parameter->GetNumCols() != 1 && parameter->GetNumCols() != numSamples)
+            LogicError("%s: the parameters must have a single column or a column per sample.", function);
+    }
+}
+
+template <class ElemType>
+static void VerifyGMMGradientArguments(const char* function, const Matrix<ElemType>& gradient, const Matrix<ElemType>& posteriors)
+{
+    if (gradient.GetDeviceId() != posteriors.GetDeviceId())
+        NOT_IMPLEMENTED;
+    if (gradient.GetNumRows() != 1 || gradient.GetNumCols() != posteriors.GetNumCols())
+        LogicError("%s: the gradient must be a row vector with a column per sample.", function);
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignGMMLogLikelihoods(const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, Matrix<ElemType>& posteriors)
+{
+    VerifyGMMArguments("AssignGMMLogLikelihoods", *this, unnormedPrior, means, logStddevs, features);
+    if (posteriors.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    posteriors.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignGMMLogLikelihoods(*unnormedPrior.m_CPUMatrix, *means.m_CPUMatrix, *logStddevs.m_CPUMatrix, *features.m_CPUMatrix, *posteriors.m_CPUMatrix); },
+        { m_GPUMatrix->AssignGMMLogLikelihoods(*unnormedPrior.m_GPUMatrix, *means.m_GPUMatrix, *logStddevs.m_GPUMatrix, *features.m_GPUMatrix, *posteriors.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddGMMUnnormedPriorGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& posteriors)
+{
+    VerifyGMMGradientArguments("AddGMMUnnormedPriorGradient", gradient, posteriors);
+    if (unnormedPrior.GetDeviceId() != GetDeviceId() || posteriors.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+    if (GetNumRows() != unnormedPrior.GetNumRows() || GetNumCols() != unnormedPrior.GetNumCols() || posteriors.GetNumRows() != unnormedPrior.GetNumRows())
+        LogicError("AddGMMUnnormedPriorGradient: the gradient of the unnormed prior must have its dimensions.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AddGMMUnnormedPriorGradient(*gradient.m_CPUMatrix, *unnormedPrior.m_CPUMatrix, *posteriors.m_CPUMatrix); },
+        { m_GPUMatrix->AddGMMUnnormedPriorGradient(*gradient.m_GPUMatrix, *unnormedPrior.m_GPUMatrix, *posteriors.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddGMMMeanGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, const Matrix<ElemType>& posteriors)
+{
+    VerifyGMMGradientArguments("AddGMMMeanGradient", gradient, posteriors);
+    if (means.GetDeviceId() != GetDeviceId() || logStddevs.GetDeviceId() != GetDeviceId() || features.GetDeviceId() != GetDeviceId() || posteriors.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+    if (GetNumRows() != means.GetNumRows() || GetNumCols() != means.GetNumCols())
+        LogicError("AddGMMMeanGradient: the gradient of the means must have their dimensions.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AddGMMMeanGradient(*gradient.m_CPUMatrix, *means.m_CPUMatrix, *logStddevs.m_CPUMatrix, *features.m_CPUMatrix, *posteriors.m_CPUMatrix); },
+        { m_GPUMatrix->AddGMMMeanGradient(*gradient.m_GPUMatrix, *means.m_GPUMatrix, *logStddevs.m_GPUMatrix, *features.m_GPUMatrix, *posteriors.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddGMMLogStddevGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, const Matrix<ElemType>& posteriors)
+{
+    VerifyGMMGradientArguments("AddGMMLogStddevGradient", gradient, posteriors);
+    if (means.GetDeviceId() != GetDeviceId() || logStddevs.GetDeviceId() != GetDeviceId() || features.GetDeviceId() != GetDeviceId() || posteriors.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+    if (GetNumRows() != logStddevs.GetNumRows() || GetNumCols() != logStddevs.GetNumCols())
+        LogicError("AddGMMLogStddevGradient: the gradient of the log stddevs must have their dimensions.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AddGMMLogStddevGradient(*gradient.m_CPUMatrix, *means.m_CPUMatrix, *logStddevs.m_CPUMatrix, *features.m_CPUMatrix, *posteriors.m_CPUMatrix); },
+        { m_GPUMatrix->AddGMMLogStddevGradient(*gradient.m_GPUMatrix, *means.m_GPUMatrix, *logStddevs.m_GPUMatrix, *features.m_GPUMatrix, *posteriors.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddGMMFeatureGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, const Matrix<ElemType>& posteriors)
+{
+    VerifyGMMGradientArguments("AddGMMFeatureGradient", gradient, posteriors);
+    if (means.GetDeviceId() != GetDeviceId() || logStddevs.GetDeviceId() != GetDeviceId() || features.GetDeviceId() != GetDeviceId() || posteriors.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+    if (GetNumRows() != features.GetNumRows() || GetNumCols() != features.GetNumCols())
+        LogicError("AddGMMFeatureGradient: the gradient of the features must have their dimensions.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AddGMMFeatureGradient(*gradient.m_CPUMatrix, *means.m_CPUMatrix, *logStddevs.m_CPUMatrix, *features.m_CPUMatrix, *posteriors.m_CPUMatrix); },
+        { m_GPUMatrix->AddGMMFeatureGradient(*gradient.m_GPUMatrix, *means.m_GPUMatrix, *logStddevs.m_GPUMatrix, *features.m_GPUMatrix, *posteriors.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignSimilaritiesWithNegativeSamples(const Matrix<ElemType>& similarities, size_t shift, size_t numNegatives, bool inBatchNegatives, Matrix<ElemType>& documents)
+{
+    if (similarities.GetDeviceId() != GetDeviceId() || documents.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+    if (similarities.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    if (similarities.GetNumRows() != similarities.GetNumCols())
+        LogicError("AssignSimilaritiesWithNegativeSamples: the similarities of the queries with the documents must be a square matrix.");
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    documents.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignSimilaritiesWithNegativeSamples(*similarities.m_CPUMatrix, shift, numNegatives, inBatchNegatives, *documents.m_CPUMatrix); },
+        { m_GPUMatrix->AssignSimilaritiesWithNegativeSamples(*similarities.m_GPUMatrix, shift, numNegatives, inBatchNegatives, *documents.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignNegativeSamplesGradientMatrix(const Matrix<ElemType>& gradient, const Matrix<ElemType>& documents)
+{
+    if (gradient.GetDeviceId() != GetDeviceId() || documents.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    if (gradient.GetNumRows() != documents.GetNumRows() || gradient.GetNumCols() != documents.GetNumCols())
+        LogicError("AssignNegativeSamplesGradientMatrix: the gradient must have a value per pair of documents.");
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignNegativeSamplesGradientMatrix(*gradient.m_CPUMatrix, *documents.m_CPUMatrix); },
+        { m_GPUMatrix->AssignNegativeSamplesGradientMatrix(*gradient.m_GPUMatrix, *documents.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddColumnNormalizationGradient(const Matrix<ElemType>& gradientOfNormalized, const Matrix<ElemType>& normalized, const Matrix<ElemType>& invNorms)
+{
+    if (gradientOfNormalized.GetDeviceId() != GetDeviceId() || normalized.GetDeviceId() != GetDeviceId() || invNorms.GetDeviceId() != GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    if (gradientOfNormalized.GetNumRows() != GetNumRows() || gradientOfNormalized.GetNumCols() != GetNumCols() ||
+        normalized.GetNumRows() != GetNumRows() || normalized.GetNumCols() != GetNumCols() || invNorms.GetNumElements() != GetNumCols())
+        LogicError("AddColumnNormalizationGradient: the gradient and the normalized columns must have the dimensions of the target, with an inverse norm per column.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AddColumnNormalizationGradient(*gradientOfNormalized.m_CPUMatrix, *normalized.m_CPUMatrix, *invNorms.m_CPUMatrix); },
+        { m_GPUMatrix->AddColumnNormalizationGradient(*gradientOfNormalized.m_GPUMatrix, *normalized.m_GPUMatrix, *invNorms.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignNceUnnormalizedEval(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias)
+{
+    // if (a.GetMatrixType() != MatrixType::SPARSE)
+    //    NOT_IMPLEMENTED;
+
+    Resize(1, 1);
+    if (GetDeviceId() < 0)
+        a.m_CPUMatrix->AssignNCEUnnormalizedEval(*b.m_CPUMatrix, *c.m_CPUMatrix, *bias.m_CPUMatrix, *m_CPUMatrix);
+    else
+        a.m_GPUMatrix->AssignNCEUnnormalizedEval(*b.m_GPUMatrix, *c.m_GPUMatrix, *m_GPUMatrix);
     return *this;
 }
 
@@ -4314,6 +5366,34 @@ void Matrix<ElemType>::ROIPoolingBackward(const size_t numRois, const size_t num
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::ROIAlignForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                                       const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const Matrix<ElemType>& roiData, Matrix<ElemType>& output) const
+{
+    DecideAndMoveToRightDevice(*this, output);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->ROIAlignForward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, samplingRatio, *(roiData.m_CPUMatrix), *(output.m_CPUMatrix)),
+                            m_GPUMatrix->ROIAlignForward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, samplingRatio, *(roiData.m_GPUMatrix), *(output.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::ROIAlignBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                                        const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const Matrix<ElemType>& roiData, Matrix<ElemType>& grad) const
+{
+    DecideAndMoveToRightDevice(*this, grad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->ROIAlignBackward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, samplingRatio, *(roiData.m_CPUMatrix), *(grad.m_CPUMatrix)),
+                            m_GPUMatrix->ROIAlignBackward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, samplingRatio, *(roiData.m_GPUMatrix), *(grad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::MaxUnpooling(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices, const Matrix<ElemType>& poolInput, Matrix<ElemType>& input) const
 {
@@ -4378,7 +5458,7 @@ void Matrix<ElemType>::AveragePoolingBackward(const Matrix<int>& mpRowCol, const
 template <class ElemType>
 void Matrix<ElemType>::BatchNormalizationForward(const Matrix<ElemType>& scale, const Matrix<ElemType>& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, 
                                                  Matrix<ElemType>& runMean, Matrix<ElemType>& runVariance, Matrix<ElemType>& out, double epsilon,
-                                                 Matrix<ElemType>& saveMean, Matrix<ElemType>& saveInvStdDev) const
+                                                 Matrix<ElemType>& saveMean, Matrix<ElemType>& saveInvStdDev, bool reluOutput) const
 {
     DecideAndMoveToRightDevice(*this, out);
 
@@ -4387,10 +5467,10 @@ void Matrix<ElemType>::BatchNormalizationForward(const Matrix<ElemType>& scale,
                             this,
                             m_CPUMatrix->BatchNormalizationForward(*(scale.m_CPUMatrix), *(bias.m_CPUMatrix), inferenceOnly, expAvgFactor, blendFactor,
                                                                    *(runMean.m_CPUMatrix), *(runVariance.m_CPUMatrix),
-                                                                   *(out.m_CPUMatrix), epsilon, *(saveMean.m_CPUMatrix), *(saveInvStdDev.m_CPUMatrix)),
+                                                                   *(out.m_CPUMatrix), epsilon, *(saveMean.m_CPUMatrix), *(saveInvStdDev.m_CPUMatrix), reluOutput),
                             m_GPUMatrix->BatchNormalizationForward(*(scale.m_GPUMatrix), *(bias.m_GPUMatrix), inferenceOnly, expAvgFactor, blendFactor,
                                                                    *(runMean.m_GPUMatrix), *(runVariance.m_GPUMatrix),
-                                                                   *(out.m_GPUMatrix), epsilon, *(saveMean.m_GPUMatrix), *(saveInvStdDev.m_GPUMatrix)),
+                                                                   *(out.m_GPUMatrix), epsilon, *(saveMean.m_GPUMatrix), *(saveInvStdDev.m_GPUMatrix), reluOutput),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
 }
@@ -4416,7 +5496,62 @@ void Matrix<ElemType>::BatchNormalizationBackward(const Matrix<ElemType>& in, Ma
 }
 
 template <class ElemType>
-void Matrix<ElemType>::RNNForward(const Matrix<ElemType> &inputX, const Matrix<ElemType> &paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, Matrix<ElemType>& reserve, Matrix<ElemType>& workspace)
+void Matrix<ElemType>::BatchNormalizationScaleAndBiasGradients(const Matrix<ElemType>& in, const Matrix<ElemType>& saveMean, const Matrix<ElemType>& saveInvStdDev,
+                                                               Matrix<ElemType>& scaleGrad, Matrix<ElemType>& biasGrad) const
+{
+    DecideAndMoveToRightDevice(*this, in);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->BatchNormalizationScaleAndBiasGradients(*(in.m_CPUMatrix), *(saveMean.m_CPUMatrix), *(saveInvStdDev.m_CPUMatrix),
+                                                                                 *(scaleGrad.m_CPUMatrix), *(biasGrad.m_CPUMatrix)),
+                            m_GPUMatrix->BatchNormalizationScaleAndBiasGradients(*(in.m_GPUMatrix), *(saveMean.m_GPUMatrix), *(saveInvStdDev.m_GPUMatrix),
+                                                                                 *(scaleGrad.m_GPUMatrix), *(biasGrad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::BatchNormalizationInputGradient(const Matrix<ElemType>& in, Matrix<ElemType>& grad, const Matrix<ElemType>& scale, double mbStatsWeight,
+                                                       const Matrix<ElemType>& saveMean, const Matrix<ElemType>& saveInvStdDev,
+                                                       const Matrix<ElemType>& scaleGrad, const Matrix<ElemType>& biasGrad) const
+{
+    DecideAndMoveToRightDevice(*this, grad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->BatchNormalizationInputGradient(*(in.m_CPUMatrix), *(grad.m_CPUMatrix), *(scale.m_CPUMatrix), mbStatsWeight,
+                                                                         *(saveMean.m_CPUMatrix), *(saveInvStdDev.m_CPUMatrix),
+                                                                         *(scaleGrad.m_CPUMatrix), *(biasGrad.m_CPUMatrix)),
+                            m_GPUMatrix->BatchNormalizationInputGradient(*(in.m_GPUMatrix), *(grad.m_GPUMatrix), *(scale.m_GPUMatrix), mbStatsWeight,
+                                                                         *(saveMean.m_GPUMatrix), *(saveInvStdDev.m_GPUMatrix),
+                                                                         *(scaleGrad.m_GPUMatrix), *(biasGrad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::BatchNormalizationReluBackward(const Matrix<ElemType>& in, const Matrix<ElemType>& scale, const Matrix<ElemType>& bias,
+                                                      const Matrix<ElemType>& saveMean, const Matrix<ElemType>& saveInvStdDev)
+{
+    if (in.GetNumRows() != GetNumRows() || in.GetNumCols() != GetNumCols())
+        LogicError("BatchNormalizationReluBackward: The gradient must have the dimensions of the input.");
+    if (saveMean.IsEmpty() || saveInvStdDev.IsEmpty())
+        LogicError("BatchNormalizationReluBackward: The statistics of a training forward pass are required.");
+    DecideAndMoveToRightDevice(*this, in);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->BatchNormalizationReluBackward(*(in.m_CPUMatrix), *(scale.m_CPUMatrix), *(bias.m_CPUMatrix),
+                                                                        *(saveMean.m_CPUMatrix), *(saveInvStdDev.m_CPUMatrix)),
+                            m_GPUMatrix->BatchNormalizationReluBackward(*(in.m_GPUMatrix), *(scale.m_GPUMatrix), *(bias.m_GPUMatrix),
+                                                                        *(saveMean.m_GPUMatrix), *(saveInvStdDev.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::RNNForward(const Matrix<ElemType> &inputX, const Matrix<ElemType> &paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, bool inferenceOnly, Matrix<ElemType>& reserve, Matrix<ElemType>& workspace)
 {
     DecideAndMoveToRightDevice(*this, inputX, paramW);
     // move reserve/workspace to the consensus device
@@ -4425,8 +5560,8 @@ void Matrix<ElemType>::RNNForward(const Matrix<ElemType> &inputX, const Matrix<E
 
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
-                            m_GPUMatrix->RNNForward(*(inputX.m_GPUMatrix), *(paramW.m_GPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
+                            m_CPUMatrix->RNNForward(*(inputX.m_CPUMatrix), *(paramW.m_CPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes),
+                            m_GPUMatrix->RNNForward(*(inputX.m_GPUMatrix), *(paramW.m_GPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, inferenceOnly, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
 }
@@ -4440,7 +5575,7 @@ void Matrix<ElemType>::RNNBackwardData(const Matrix<ElemType>& outputDY, const M
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            RuntimeError("OptimizedRNNStack training on CPU is not yet implemented."),
                             m_GPUMatrix->RNNBackwardData(*(outputDY.m_GPUMatrix), *(paramW.m_GPUMatrix), *(outputDX.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4455,7 +5590,7 @@ void Matrix<ElemType>::RNNBackwardWeights(const Matrix<ElemType>& inputX, const
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            RuntimeError("OptimizedRNNStack training on CPU is not yet implemented."),
                             m_GPUMatrix->RNNBackwardWeights(*(inputX.m_GPUMatrix), *(outputY.m_GPUMatrix), *(dw.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4505,6 +5640,16 @@ template <class ElemType>
 void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB,
                                               ElemType beta, Matrix<ElemType>& c, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier)
 {
+    // fast path: DENSE * DENSE -> DENSE on one device, see DISPATCH_RESOLVED_DENSE
+    if (c.IsResolvedDenseWith(a, b))
+    {
+        if (c.m_currentDataLocation == CurrentDataLocation::CPU)
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_CPUMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix, pQuantizedMultiplier);
+        else
+            GPUMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix);
+        return;
+    }
+
     DecideAndMoveToRightDevice(a, b, c);
 
     if (c.GetDeviceId() < 0) // CPU
@@ -4578,8 +5723,7 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
         }
         else if (a.m_matrixType == MatrixType::SPARSE && b.m_matrixType == MatrixType::DENSE && c.m_matrixType == MatrixType::DENSE) // GPU, SPARSE * DENSE -> DENSE
         {
-            GPUMatrix<ElemType> second = transposeB ? b.m_GPUMatrix->Transpose() : *b.m_GPUMatrix;
-            GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUSparseMatrix, transposeA, second, false, beta, *c.m_GPUMatrix);
+            GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUSparseMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix);
             c.SetDataLocation(GPU, DENSE);
         }
         else if (a.m_matrixType == MatrixType::DENSE && b.m_matrixType == MatrixType::SPARSE && c.m_matrixType == MatrixType::DENSE) // GPU, DENSE * SPARSE -> DENSE
@@ -4660,6 +5804,26 @@ template <class ElemType>
                             NOT_IMPLEMENTED);
 }
 
+/// <summary>Batch of matrix-matrix multiplies with col-major matrices: c_i = alpha * op(a_i) * op(b_i) + beta * c_i</summary>
+/// The i-th matrices are dense [m x k], [k x n] (before transposition) and [m x n] matrices at offset i * stride of a, b and c; a stride of 0 shares a matrix across the batch.
+/// <param name="c">Resulting matrices, user is responsible for allocating this</param>
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const size_t strideA, const Matrix<ElemType>& b, const bool transposeB, const size_t strideB,
+                                                              ElemType beta, Matrix<ElemType>& c, const size_t strideC, const size_t m, const size_t n, const size_t k, const size_t batchCount)
+{
+    if (a.GetMatrixType() != DENSE || b.GetMatrixType() != DENSE || c.GetMatrixType() != DENSE)
+        RuntimeError("BatchedMultiplyAndWeightedAdd: Sparse matrices are not supported.");
+
+    DecideAndMoveToRightDevice(a, b, c);
+
+    DISPATCH_MATRIX_ON_FLAG(&c,
+                            nullptr,
+                            CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, *a.m_CPUMatrix, transposeA, strideA, *b.m_CPUMatrix, transposeB, strideB, beta, *c.m_CPUMatrix, strideC, m, n, k, batchCount),
+                            GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, transposeA, strideA, *b.m_GPUMatrix, transposeB, strideB, beta, *c.m_GPUMatrix, strideC, m, n, k, batchCount),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 /// <summary>Matrix-matrix multiply with col-major matrices (a and b may be transposed): c =  op(a) * op(b) + c</summary>
 /// <param name="a">Input matrix</param>
 /// <param name="transposeA">Whether matrix a is transposed</param>
@@ -4920,6 +6084,30 @@ void Matrix<ElemType>::AssignScaledDifference(const Matrix<ElemType>& alpha, con
                             NOT_IMPLEMENTED);
 }
 
+/// <summary>c += alpha * (softmax(logits) - labels)</summary>
+/// <param name="alpha">1x1 matrix</param>
+/// <param name="logits">Input matrix</param>
+/// <param name="logSumExp">Column-wise log-sum-exp of logits, as computed by AssignSoftmaxCrossEntropyOf()</param>
+/// <param name="labels">Input matrix</param>
+/// <param name="c">Resulting matrix, user is responsible for allocating this</param>
+template <class ElemType>
+void Matrix<ElemType>::AddSoftmaxCrossEntropyGradient(const Matrix<ElemType>& alpha, const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp, const Matrix<ElemType>& labels, Matrix<ElemType>& c)
+{
+    DecideAndMoveToRightDevice(c, logits, labels, logSumExp);
+    alpha._transferToDevice(c.GetDeviceId());
+
+    if (!(logits.GetMatrixType() == MatrixType::DENSE && labels.GetMatrixType() == MatrixType::DENSE && logSumExp.GetMatrixType() == MatrixType::DENSE &&
+          c.GetMatrixType() == MatrixType::DENSE && alpha.GetMatrixType() == MatrixType::DENSE))
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&c,
+                            &c,
+                            CPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(*alpha.m_CPUMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix, *labels.m_CPUMatrix, *c.m_CPUMatrix),
+                            GPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(*alpha.m_GPUMatrix, *logits.m_GPUMatrix, *logSumExp.m_GPUMatrix, *labels.m_GPUMatrix, *c.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 //c[ci,cj] += a[ai,aj]
 template <class ElemType>
 void Matrix<ElemType>::AddElementToElement(const Matrix<ElemType>& a, const size_t ai, const size_t aj, Matrix<ElemType>& c, const size_t ci, const size_t cj)
@@ -5213,6 +6401,34 @@ bool Matrix<ElemType>::HasNan(const char* name) const
 // another diagnostics helper to check if matrix has a NaN
 // This is used at load and save time. This test is slow.
 
+// Not implemented for sparse matrices, which are not flagged, as in HasNan().
+template <class ElemType>
+void Matrix<ElemType>::FlagNonFiniteValues(Matrix<ElemType>& flag) const
+{
+    if (GetDeviceId() != flag.GetDeviceId())
+        NOT_IMPLEMENTED;
+    if (flag.GetNumElements() != 1 || flag.GetMatrixType() != MatrixType::DENSE)
+        LogicError("FlagNonFiniteValues: The flag must be a dense 1 x 1 matrix.");
+
+    if (IsEmpty() || m_matrixType == MatrixType::SPARSE)
+        return;
+
+    DISPATCH_MATRIX_ON_FLAG(&flag, &flag,
+                            { m_CPUMatrix->FlagNonFiniteValues(*flag.m_CPUMatrix); },
+                            { m_GPUMatrix->FlagNonFiniteValues(*flag.m_GPUMatrix); },
+                            { NOT_IMPLEMENTED; },
+                            { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+bool Matrix<ElemType>::HasNonFiniteValues() const
+{
+    Matrix<ElemType> flag(1, 1, GetDeviceId());
+    flag.SetValue(0);
+    FlagNonFiniteValues(flag);
+    return flag.Get00Element() != 0;
+}
+
 template <class ElemType>
 size_t Matrix<ElemType>::CountNanInf() const
 {
@@ -5424,64 +6640,6 @@ Matrix<ElemType>& Matrix<ElemType>::AssignElementProductOfWithShift(const Matrix
     return *this;
 }
 
-template <class ElemType>
-void Matrix<ElemType>::RCRFBackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
-                                           Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
-                                           const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const int shift)
-{
-    DecideAndMoveToRightDevice(alpha, beta);
-    functionValues._transferToDevice(alpha.GetDeviceId());
-    beta._transferToDevice(alpha.GetDeviceId());
-
-    DISPATCH_MATRIX_ON_FLAG(&alpha,
-                            &beta,
-                            CPUMatrix<ElemType>::RCRFBackwardCompute(
-                                *alpha.m_CPUMatrix,
-                                *beta.m_CPUMatrix,
-                                *lbls.m_CPUMatrix,
-                                *pair_scores.m_CPUMatrix),
-                            GPUMatrix<ElemType>::RCRFBackwardCompute(
-                                *alpha.m_GPUMatrix,
-                                *beta.m_GPUMatrix,
-                                *lbls.m_GPUMatrix,
-                                *pos_scores.m_GPUMatrix,
-                                *pair_scores.m_GPUMatrix, shift),
-                            NOT_IMPLEMENTED,
-                            NOT_IMPLEMENTED);
-}
-
-template <class ElemType>
-void Matrix<ElemType>::RCRFTransGrdCompute(const Matrix<ElemType>& lbls,
-                                           const Matrix<ElemType>& alpha,
-                                           const Matrix<ElemType>& beta,
-                                           const Matrix<ElemType>& pair_scores,
-                                           Matrix<ElemType>& grd,
-                                           const int startLbl,
-                                           const int shift)
-{
-    DecideAndMoveToRightDevice(alpha, grd);
-    grd._transferToDevice(alpha.GetDeviceId());
-
-    DISPATCH_MATRIX_ON_FLAG(&alpha,
-                            &grd,
-                            CPUMatrix<ElemType>::RCRFTransGrdCompute(
-                                *lbls.m_CPUMatrix,
-                                *alpha.m_CPUMatrix,
-                                *beta.m_CPUMatrix,
-                                *pair_scores.m_CPUMatrix,
-                                *grd.m_CPUMatrix),
-                            GPUMatrix<ElemType>::RCRFTransGrdCompute(
-                                *lbls.m_GPUMatrix,
-                                *alpha.m_GPUMatrix,
-                                *beta.m_GPUMatrix,
-                                *pair_scores.m_GPUMatrix,
-                                *grd.m_GPUMatrix,
-                                startLbl,
-                                shift),
-                            NOT_IMPLEMENTED,
-                            NOT_IMPLEMENTED);
-}
-
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::DropFrame(const Matrix<ElemType>& label, const Matrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -5543,6 +6701,10 @@ void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, ElemTy
                                 const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
 {
+    DISPATCH_RESOLVED_DENSE(IsResolvedDenseWith(a),
+                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides));
+
     VerifyIsDense(*this) && VerifyIsDense(a);
 
     DecideAndMoveToRightDevice(*this, a);
@@ -5561,6 +6723,10 @@ void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const
                                 const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
 {
+    DISPATCH_RESOLVED_DENSE(IsResolvedDenseWith(a, b),
+                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, *b.m_CPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, *b.m_GPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides));
+
     VerifyIsDense(*this) && VerifyIsDense(a) && VerifyIsDense(b);
 
     DecideAndMoveToRightDevice(*this, a, b);
@@ -5579,6 +6745,10 @@ void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const
                                 const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
 {
+    DISPATCH_RESOLVED_DENSE(IsResolvedDenseWith(a, b, c),
+                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, *b.m_CPUMatrix, *c.m_CPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, *b.m_GPUMatrix, *c.m_GPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides));
+
     VerifyIsDense(*this) && VerifyIsDense(a) && VerifyIsDense(b) && VerifyIsDense(c);
 
     DecideAndMoveToRightDevice(*this, a, b, c);
@@ -5591,6 +6761,27 @@ void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::FusedTensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, ElemType alpha, const FusedElementwiseOp& program,
+                                     const array<size_t, 4>& offsets,
+                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides)
+{
+    DISPATCH_RESOLVED_DENSE(IsResolvedDenseWith(a, b, c),
+                            m_CPUMatrix->FusedTensorOp(beta, *a.m_CPUMatrix, *b.m_CPUMatrix, *c.m_CPUMatrix, alpha, program, offsets, regularOpDims, regularStrides),
+                            m_GPUMatrix->FusedTensorOp(beta, *a.m_GPUMatrix, *b.m_GPUMatrix, *c.m_GPUMatrix, alpha, program, offsets, regularOpDims, regularStrides));
+
+    VerifyIsDense(*this) && VerifyIsDense(a) && VerifyIsDense(b) && VerifyIsDense(c);
+
+    DecideAndMoveToRightDevice(*this, a, b, c);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->FusedTensorOp(beta, *a.m_CPUMatrix, *b.m_CPUMatrix, *c.m_CPUMatrix, alpha, program, offsets, regularOpDims, regularStrides),
+                            m_GPUMatrix->FusedTensorOp(beta, *a.m_GPUMatrix, *b.m_GPUMatrix, *c.m_GPUMatrix, alpha, program, offsets, regularOpDims, regularStrides),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 //template class Matrix<short>;
 template class Matrix<float>;
 template class Matrix<double>;
@@ -30,6 +30,9 @@ namespace CNTK
 // This class is exported from the Math.dll
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+struct ImageAugmentationParameters;
+enum class NarrowElementType;
+
 enum CurrentDataLocation
 {
     NONE,
@@ -97,6 +100,11 @@ private:
     static void DecideAndMoveToRightDevice(const Matrix<ElemType>& a, const Matrix<ElemType2>& b);
     static void DecideAndMoveToRightDevice(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c);
     static void DecideAndMoveToRightDevice(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& d);
+    // Fast path of the dispatch for small ops: whether this matrix and the operands are dense and current on the same
+    // single device, i.e. already resolved to one CPUMatrix or GPUMatrix each, see DISPATCH_RESOLVED_DENSE in Matrix.cpp.
+    bool IsResolvedDenseWith(const Matrix<ElemType>& a) const;
+    bool IsResolvedDenseWith(const Matrix<ElemType>& a, const Matrix<ElemType>& b) const { return IsResolvedDenseWith(a) && IsResolvedDenseWith(b); }
+    bool IsResolvedDenseWith(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c) const { return IsResolvedDenseWith(a, b) && IsResolvedDenseWith(c); }
     static void CopyElementsFromDenseToSparse(CPUMatrix<ElemType>& from, CPUSparseMatrix<ElemType>& dest);
 
 public:
@@ -144,6 +152,9 @@ public:
 
     static void UseCachedResizeOrNot(bool useCachedResize);
 
+    // See GPUMatrix::UseMixedPrecisionGemm(); only affects single precision GEMMs on the GPU.
+    static void UseMixedPrecisionGemm(bool useMixedPrecisionGemm);
+
 private:
     Matrix(const MatrixFlags matrixFlags, const MatrixType matrixType, const MatrixFormat matrixFormat, DEVICEID_TYPE deviceID); // only used internally to initialize a blank matrix
     Matrix(const MatrixFlags matrixFlags, const MatrixType matrixType, DEVICEID_TYPE deviceID);                                  // only used internally to initialize a blank matrix
@@ -182,6 +193,7 @@ public:
     bool HasNoElements() const { return GetNumElements() == 0; }
     bool IsEmpty() const;
     size_t BufferSize() const;
+    size_t NzCount() const; // number of elements in use: all of a dense matrix, the non-zeros of a sparse one
     ElemType* Data() const;
 
     ElemType* CopyToArray() const;                                              // allocated by the callee but need to be deleted by the caller
@@ -213,7 +225,39 @@ public:
                          Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
                          const double learnRatePerSample, const double targetAdagradAvDenom,
                          const double meanMomentum, const double varMomentum);
+    // Adam, and AdamW if weightDecay > 0; smoothedCount counts the updates for the bias correction
+    void AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
+                    const double learnRatePerSample, const double meanMomentum, const double varMomentum,
+                    const double epsilon, const double weightDecay);
+    // LAMB: Adam with decoupled weight decay, and the step of the parameter scaled to the trust ratio |w| / |step|
+    // (dense only; done as a multi-tensor update of one tensor, which overwrites the gradient with the step)
+    void LambUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
+                    const double learnRatePerSample, const double meanMomentum, const double varMomentum,
+                    const double epsilon, const double weightDecay);
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
+    // lazy variants of NormalGrad() and FSAdagradUpdate() for block-sparse gradients, e.g. of embeddings of sparse input,
+    // which touch only the columns present in the gradient; lastUpdates records per column the update count of its last update
+    void LazyNormalGrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                        const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum);
+    void LazyFSAdagradUpdate(size_t mbSize,
+                             Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
+                             std::vector<size_t>& lastUpdates, size_t updateCount,
+                             const double learnRatePerSample, const double targetAdagradAvDenom,
+                             const double meanMomentum, const double varMomentum);
+    // bring all columns up to date as of update updateCount, e.g. before the model is saved
+    void CatchUpLazyNormalGrad(Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                               const ElemType momentum, const bool useNesterovMomentum);
+    void CatchUpLazyFSAdagrad(Matrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                              const double learnRatePerSample, const double meanMomentum, const double varMomentum);
+    // fused update of many dense parameters of one device, see CPUMatrix::MultiTensorUpdate()
+    // The per-tensor scalars are taken from items, the pointers and sizes are filled in here. Smoothed gradients are allocated on first use.
+    // emaValues, if given, holds a moving average of each value (or nullptr), which is updated by the same pass with items[k].emaDecay
+    // and initialized to the value on first use.
+    static void MultiTensorUpdate(const std::vector<Matrix<ElemType>*>& values, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& smoothedGradients,
+                                  std::vector<MultiTensorUpdateItem<ElemType>>& items, const MultiTensorUpdateParams<ElemType>& params,
+                                  const std::vector<Matrix<ElemType>*>& emaValues = std::vector<Matrix<ElemType>*>());
+    // sums of squares of many dense matrices of one device in one pass, e.g. for (global) norm clipping
+    static std::vector<double> MultiTensorSumOfSquares(const std::vector<const Matrix<ElemType>*>& matrices);
 
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true); // by default we only reallocate if need to grow
     void Resize(const Matrix<ElemType>& other) // TODO: Should this carry over numNZElemToReserve for sparse matrices?
@@ -262,6 +306,8 @@ public:
     void SetValue      (const Matrix<ElemType>& deepCopyFrom);
     // AssignValuesOf respects the target matrix's information. It copies the values from the target into the memory of the source.
     void AssignValuesOf(const Matrix<ElemType>& deepCopyFrom);
+    // AssignPeerCopyOf is AssignValuesOf for a source on another device: this matrix stays where it is, GPU to GPU copies go over peer access.
+    void AssignPeerCopyOf(const Matrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, const size_t matrixFlags = matrixFlagNormal, DataTransferer* transferer = nullptr);
     void SetValue(const size_t rIdx, const size_t cIdx, ElemType val); // set matrix sparsely
     void SetValue(const size_t numRows, const size_t numCols, std::initializer_list<ElemType> l) // SetValue(2,3, {1,2,3,  4,5,6});
@@ -278,6 +324,11 @@ public:
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
         const size_t nz, const size_t numRows, const size_t numCols, DataTransferer* transferer = nullptr);
 
+    // Content of a sparse matrix in SparseBlockCol format, e.g. a gradient of a parameter multiplied with sparse input,
+    // as the ids of its non-zero columns and their values, one column per block, in CPU memory. The device is kept.
+    void GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const;
+    void SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols);
+
     void MaskColumnsValue(const Matrix<char>& columnsMask, ElemType val);
 
     void SetColumn(const ElemType* colPointer, size_t colInd);
@@ -290,10 +341,93 @@ public:
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
+    // fused dropout: c = beta * c + a .* mask / (1 - dropoutRate), where mask[i] is 0 with probability dropoutRate, drawn
+    // from (seed, offset + i) by a counter-based generator. No mask is stored: the same arguments give the same mask again.
+    static void Dropout(const ElemType beta, const Matrix<ElemType>& a, const ElemType dropoutRate, const uint64_t seed, const uint64_t offset, Matrix<ElemType>& c);
+    // Counter-based random values: element i (column-major) is drawn from (seed, i) by Philox, on the device of the
+    // matrix and in parallel, with the same bits on the CPU and the GPU. Used for reproducible parameter initialization.
+    void SetCounterBasedUniformRandomValue(const ElemType low, const ElemType high, const uint64_t seed);
+    void SetCounterBasedGaussianRandomValue(const ElemType mean, const ElemType sigma, const uint64_t seed);
+    // Weighted random sampling of numSamples classes, the rows of the column of weights >= 0, on the device of the weights.
+    // Draw i is made from (seed, offset + i) by Philox. With duplicates, each of the numSamples draws inverts the CDF of the
+    // weights. Without, there is a draw per class, and the sample is the classes with the largest keys log(1 - u) / weight
+    // (see TensorOps.h), which are distributed as successive draws that skip the classes drawn already, and in their order.
+    // The result is a column of the sampled classes; the workspace keeps the prefix sums or the keys.
+    Matrix<ElemType>& AssignWeightedRandomSamples(const Matrix<ElemType>& weights, size_t numSamples, bool allowDuplicates, const uint64_t seed, const uint64_t offset, Matrix<ElemType>& workspace);
+    // The expected number of occurrences of each class in such a sample, a column. Without duplicates, it is the probability
+    // to be among as many draws with replacement as were expected to collect the samples, the columns of 'samples', on average.
+    Matrix<ElemType>& AssignWeightedSampleInclusionFrequencies(const Matrix<ElemType>& weights, size_t numSamples, bool allowDuplicates, const Matrix<ElemType>& samples);
+    // Sets this to a sparse CSC matrix of numRows rows with a column per element of rowIndices, which is 1 in that row.
+    Matrix<ElemType>& AssignOneHotColumns(const Matrix<ElemType>& rowIndices, size_t numRows);
     Matrix<ElemType>& AssignNoiseContrastiveEstimation(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias, Matrix<ElemType>& tmp);
 
     Matrix<ElemType>& AssignNCEDerivative(const Matrix<ElemType>& tmp, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, size_t inputIndex);
     Matrix<ElemType>& AssignSoftmaxSum(const Matrix<ElemType>& a, const Matrix<ElemType>& softmax);
+
+    // Augments numImages uint8 images stored in the workspace (see ImageAugmentation.h) into the columns of this matrix.
+    // The random values of the augmentation only depend on the seed and the index of the image.
+    Matrix<ElemType>& AssignAugmentedImages(Matrix<ElemType>& workspace, size_t numImages, const ImageAugmentationParameters& parameters, uint64_t seed);
+
+    // Widens numRows x numCols values of a narrow type (see NarrowElementTypes.h), stored from the start of
+    // the buffer of the packed matrix, into this matrix: this = scale * packed + shift.
+    Matrix<ElemType>& AssignWidenedValuesOf(const Matrix<ElemType>& packed, NarrowElementType type, size_t numRows, size_t numCols, ElemType scale, ElemType shift);
+
+    // Learning to rank (see LearningToRank.h). All arguments are row vectors with a column per url; the urls of a query
+    // are consecutive, with the same query id, and in descending order of gain.
+    // this = the rank of each url within its query by descending score
+    Matrix<ElemType>& AssignRanksWithinQueries(const Matrix<ElemType>& scores, const Matrix<ElemType>& gains, const Matrix<ElemType>& queryIds);
+    // this = the part of the NDCG (or NDCG@1) of its query that each url contributes; queryStarts = 1 for the first url of each query, else 0
+    Matrix<ElemType>& AssignNDCGContributions(const Matrix<ElemType>& gains, const Matrix<ElemType>& ranks, const Matrix<ElemType>& queryIds, bool atOne, Matrix<ElemType>& queryStarts);
+    // this += the LambdaRank gradient of the scores
+    Matrix<ElemType>& AddLambdaRankGradient(const Matrix<ElemType>& gains, const Matrix<ElemType>& scores, const Matrix<ElemType>& ranks, const Matrix<ElemType>& queryIds, ElemType sigma);
+
+    // Linear-chain CRF over all sequences of a minibatch at once (see LinearChainCRF.h). scores has a column per frame,
+    // numLabels x numLabels transitions(k, j) score label k after label j, labelIndices is a row vector with the label of
+    // each frame, and sequences is 2 x numSequences of (first column, number of frames); frames of a sequence are stride
+    // (the number of parallel sequences) columns apart. Columns that belong to no sequence are not computed.
+    // this = alpha, the forward scores
+    Matrix<ElemType>& AssignCRFForwardScores(const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& sequences, size_t stride);
+    // this = the log posteriors of the labels of each frame
+    Matrix<ElemType>& AssignCRFLogPosteriors(const Matrix<ElemType>& alpha, const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& sequences, size_t stride);
+    // this = a row vector with the negative log likelihood of the labels of each sequence
+    Matrix<ElemType>& AssignCRFNegativeLogLikelihoods(const Matrix<ElemType>& alpha, const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& sequences, size_t stride);
+    // this = the gradient of the summed negative log likelihoods with respect to the transitions
+    Matrix<ElemType>& AssignCRFTransitionGradient(const Matrix<ElemType>& logPosteriors, const Matrix<ElemType>& alpha, const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& sequences, size_t stride);
+    // this = the best label path of each sequence, one-hot; the label indices are used for the start labels only
+    Matrix<ElemType>& AssignCRFViterbiPath(const Matrix<ElemType>& scores, const Matrix<ElemType>& transitions, const Matrix<ElemType>& labelIndices, const Matrix<ElemType>& sequences, size_t stride, Matrix<ElemType>& viterbiScores, Matrix<ElemType>& backPointers);
+
+    // Stream compaction of sequences of a row vector, with the sequences as for the CRF operations, on the device of the data;
+    // e.g. the Where and PackedIndex nodes, which only need the counts on the CPU, to build their minibatch layout.
+    // this = a row vector with the number of non-zero values of each sequence of a
+    Matrix<ElemType>& AssignNonZeroCountsOfSequences(const Matrix<ElemType>& a, const Matrix<ElemType>& sequences, size_t stride);
+    // frame k of output sequence i of this = the frame of the k-th non-zero value of sequence i of a; the other columns are not changed
+    Matrix<ElemType>& AssignNonZeroPositionsOfSequences(const Matrix<ElemType>& a, const Matrix<ElemType>& sequences, size_t stride, const Matrix<ElemType>& outputSequences, size_t outputStride);
+    // frame t of sequence i of this = the column of frame positions(frame t of sequence i) of target sequence i, or -1 (no column)
+    // if the target sequence has no such frame; the other columns are not changed
+    Matrix<ElemType>& AssignColumnsOfSequencePositions(const Matrix<ElemType>& positions, const Matrix<ElemType>& sequences, size_t stride, const Matrix<ElemType>& targetSequences, size_t targetStride);
+
+    // Gaussian mixture with a shared diagonal variance per component (see GaussianMixture.h). features is featureDim x numSamples;
+    // unnormedPrior and logStddevs are numComponents x (1 or numSamples), means numComponents * featureDim x (1 or numSamples).
+    // this = a row vector with the log likelihood of each sample; posteriors = the posteriors of the components of each sample
+    Matrix<ElemType>& AssignGMMLogLikelihoods(const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, Matrix<ElemType>& posteriors);
+    // this += the gradient of the unnormed prior, given the gradient (a row vector) of the log likelihoods
+    Matrix<ElemType>& AddGMMUnnormedPriorGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& posteriors);
+    // this += the gradient of the means
+    Matrix<ElemType>& AddGMMMeanGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, const Matrix<ElemType>& posteriors);
+    // this += the gradient of the log stddevs
+    Matrix<ElemType>& AddGMMLogStddevGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, const Matrix<ElemType>& posteriors);
+    // this += the gradient of the features
+    Matrix<ElemType>& AddGMMFeatureGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, const Matrix<ElemType>& posteriors);
+
+    // Cosine similarity with negative samples (see CosineWithNegativeSamples.h). similarities is the N x N matrix of the cosines of
+    // all queries (rows) with all documents (columns).
+    // this = (1 + numNegatives) x N, the similarity of each query with its document (row 0) and with its negative documents;
+    // documents = the document column of each of these pairs
+    Matrix<ElemType>& AssignSimilaritiesWithNegativeSamples(const Matrix<ElemType>& similarities, size_t shift, size_t numNegatives, bool inBatchNegatives, Matrix<ElemType>& documents);
+    // this = N x N, the gradient of the similarities, given the gradient of the pairs that AssignSimilaritiesWithNegativeSamples() formed
+    Matrix<ElemType>& AssignNegativeSamplesGradientMatrix(const Matrix<ElemType>& gradient, const Matrix<ElemType>& documents);
+    // this += the gradient of the columns x of which normalized = x / |x| is computed, with invNorms = 1 / |x| a row vector
+    Matrix<ElemType>& AddColumnNormalizationGradient(const Matrix<ElemType>& gradientOfNormalized, const Matrix<ElemType>& normalized, const Matrix<ElemType>& invNorms);
     Matrix<ElemType>& AssignNceUnnormalizedEval(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias);
 
     Matrix<ElemType> Transpose(); // This method doesn't change state of Matrix. It should be a const function
@@ -368,6 +502,10 @@ public:
     Matrix<ElemType>& InplaceLogSoftmax(const bool isColWise);
     Matrix<ElemType>& AssignLogSoftmaxOf(const Matrix<ElemType>& a, const bool isColWise);
 
+    // column-wise softmax cross entropy without a softmax matrix: logSumExp[j] = log(sum_i exp(logits(i,j))) and
+    // this[j] = -sum_i labels(i,j) * (logits(i,j) - logSumExp[j]), both [1 x numCols]. Large vocabularies are reduced in chunks of rows.
+    Matrix<ElemType>& AssignSoftmaxCrossEntropyOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp);
+
     Matrix<ElemType>& InplaceHardmax(const bool isColWise);
     Matrix<ElemType>& AssignHardmaxOf(const Matrix<ElemType>& a, const bool isColWise);
 
@@ -464,6 +602,10 @@ public:
 
     bool HasNan(const char* name) const;
     size_t CountNanInf() const;
+    // Sets the 1 x 1 'flag' (on the device of this matrix) to 1 if any element is NaN or Inf, else leaves it as it is.
+    // No host synchronization: the flag of many checks can be read once, e.g. once per minibatch.
+    void FlagNonFiniteValues(Matrix<ElemType>& flag) const;
+    bool HasNonFiniteValues() const; // FlagNonFiniteValues() with a flag of its own, which it reads
 
     void Print(const char* matrixName, ptrdiff_t rowFirst, ptrdiff_t rowLast, ptrdiff_t colFirst, ptrdiff_t colLast) const;
     void Print(const char* matrixName = nullptr) const; // print whole matrix. can be expensive
@@ -522,6 +664,12 @@ public:
     void ROIPoolingBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
                             const size_t pooledWidth, const size_t pooledHeight, const Matrix<ElemType>& roiData, Matrix<ElemType>& grad, Matrix<ElemType>& argmax) const;
 
+    void ROIAlignForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                         const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const Matrix<ElemType>& roiData, Matrix<ElemType>& output) const;
+
+    void ROIAlignBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+                          const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const Matrix<ElemType>& roiData, Matrix<ElemType>& grad) const;
+
     void MaxUnpooling(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices, const Matrix<ElemType>& poolInput, Matrix<ElemType>& input) const;
 
     void AveragePoolingForward(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices, Matrix<ElemType>& output) const;
@@ -529,11 +677,23 @@ public:
 
     void BatchNormalizationForward(const Matrix<ElemType>& scale, const Matrix<ElemType>& bias, bool inferenceOnly, double expAvgFactor, double blendFactor,
                                    Matrix<ElemType>& runMean, Matrix<ElemType>& runVariance, Matrix<ElemType>& out, double epsilon,
-                                   Matrix<ElemType>& saveMean, Matrix<ElemType>& saveInvStdDev) const;
+                                   Matrix<ElemType>& saveMean, Matrix<ElemType>& saveInvStdDev, bool reluOutput = false) const;
     void BatchNormalizationBackward(const Matrix<ElemType>& in, Matrix<ElemType>& grad, const Matrix<ElemType>& scale, double blendFactor, const Matrix<ElemType>& saveMean, const Matrix<ElemType>& saveInvStdDev,
                                     Matrix<ElemType>& scaleGrad, Matrix<ElemType>& biasGrad) const;
-
-    void RNNForward(const Matrix<ElemType>& inputX, const Matrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const struct RnnAttributes& rnnAttributes, Matrix<ElemType>& reserve, Matrix<ElemType>& workspace);
+    // The two steps of BatchNormalizationBackward(), for statistics that are reduced in between (synchronized batch normalization):
+    // the scale and bias gradients, and from them the input gradient, where mbStatsWeight = 1 - blendFactor weights the dependency
+    // of the statistics on the input (scaled down by the share of the samples of this minibatch when the statistics are global).
+    void BatchNormalizationScaleAndBiasGradients(const Matrix<ElemType>& in, const Matrix<ElemType>& saveMean, const Matrix<ElemType>& saveInvStdDev,
+                                                 Matrix<ElemType>& scaleGrad, Matrix<ElemType>& biasGrad) const;
+    void BatchNormalizationInputGradient(const Matrix<ElemType>& in, Matrix<ElemType>& grad, const Matrix<ElemType>& scale, double mbStatsWeight,
+                                         const Matrix<ElemType>& saveMean, const Matrix<ElemType>& saveInvStdDev,
+                                         const Matrix<ElemType>& scaleGrad, const Matrix<ElemType>& biasGrad) const;
+    // this = gradient of ReLU(BatchNormalizationForward(in)) --> gradient of BatchNormalizationForward(in), in place.
+    // The normalization is recomputed from the statistics saved by the forward pass, so its output need not be kept.
+    void BatchNormalizationReluBackward(const Matrix<ElemType>& in, const Matrix<ElemType>& scale, const Matrix<ElemType>& bias,
+                                        const Matrix<ElemType>& saveMean, const Matrix<ElemType>& saveInvStdDev);
+
+    void RNNForward(const Matrix<ElemType>& inputX, const Matrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const struct RnnAttributes& rnnAttributes, bool inferenceOnly, Matrix<ElemType>& reserve, Matrix<ElemType>& workspace);
     void RNNBackwardData(const Matrix<ElemType>& outputDY, const Matrix<ElemType>& paramW, Matrix<ElemType>& outputDX, const struct RnnAttributes& rnnAttributes, Matrix<ElemType>& reserve, Matrix<ElemType>& workspace);
     void RNNBackwardWeights(const Matrix<ElemType>& inputX, const Matrix<ElemType>& outputY, Matrix<ElemType>& dw, const struct RnnAttributes& rnnAttributes, Matrix<ElemType>& reserve, Matrix<ElemType>& workspace);
 
@@ -554,6 +714,9 @@ public:
     static void Multiply(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType beta, Matrix<ElemType>& c);
+    // batch of GEMMs over dense matrices stored at a fixed stride, see CPUMatrix::BatchedMultiplyAndWeightedAdd()
+    static void BatchedMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const size_t strideA, const Matrix<ElemType>& b, const bool transposeB, const size_t strideB,
+                                              ElemType beta, Matrix<ElemType>& c, const size_t strideC, const size_t m, const size_t n, const size_t k, const size_t batchCount);
     static void ConvolveAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c, size_t numChannels, size_t horizontalSubsample, bool padding, bool channelwise);
 
     static void ScaleAndAdd(ElemType alpha, const Matrix<ElemType>& a, Matrix<ElemType>& c);
@@ -562,6 +725,8 @@ public:
     static void AssignScaledDifference(const ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
     static void AddScaledDifference(const Matrix<ElemType>& alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c); // c += alpha * (a - b)
     static void AssignScaledDifference(const Matrix<ElemType>& alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
+    // c += alpha * (softmax(logits) - labels), with the softmax recomputed from logits and the logSumExp of AssignSoftmaxCrossEntropyOf()
+    static void AddSoftmaxCrossEntropyGradient(const Matrix<ElemType>& alpha, const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp, const Matrix<ElemType>& labels, Matrix<ElemType>& c);
 
     static void AddElementToElement(const Matrix<ElemType>& a, const size_t ai, const size_t aj, Matrix<ElemType>& c, const size_t ci, const size_t cj);
     // static void AddLogElementToElement(const Matrix<ElemType>& a, const size_t ai, const size_t aj, Matrix<ElemType>& c, const size_t ci, const size_t cj);
@@ -592,10 +757,21 @@ public:
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    // like the ternary TensorOp() but computing a FusedElementwiseOp program, without reduction
+    void FusedTensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, ElemType alpha, const FusedElementwiseOp& program,
+                       const std::array<size_t, 4>& offsets,
+                       const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides);
 
 public:
     void Read(File& stream);
     void Write(File& stream) const;
+    // Like Read() for a dense matrix, but skips the elements, returning their file position instead, from which
+    // ReadElements() reads them later, e.g. through another File on the same file. The matrix gets its dimensions.
+    // Returns false, having read nothing, if the matrix in the file is not dense. Needs a seekable binary file.
+    bool TryReadWithoutElements(File& stream, uint64_t& elementsPosition);
+    // On a GPU, the elements are read into 'hostBuffer' (e.g. pinned memory of GetNumElements() elements) on the way,
+    // a temporary one if null. On the CPU, they are read right into the matrix.
+    void ReadElements(File& stream, uint64_t elementsPosition, ElemType* hostBuffer = nullptr);
 
     Matrix<ElemType>& Shift(const Matrix<ElemType>& a, int shift);
 
@@ -606,19 +782,6 @@ public:
     static void ConductRowElementMultiplyWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c, size_t shift, bool bFirstmatrixfixed);
     Matrix<ElemType>& AssignElementProductOfWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift);
 
-public:
-    static void RCRFBackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
-                                    Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
-                                    const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const int shift);
-
-    static void RCRFTransGrdCompute(const Matrix<ElemType>& lbls,
-                                    const Matrix<ElemType>& alpha,
-                                    const Matrix<ElemType>& beta,
-                                    const Matrix<ElemType>& pair_scores,
-                                    Matrix<ElemType>& grd,
-                                    const int startLbl, // the time 0 start symbol in the output layer
-                                    const int shift);
-
     template <typename T>
     friend class MatrixQuantizer;
 
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "MatrixQuantizerCPU.h"
+#include "CPUVectorKernels.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -9,6 +10,136 @@ MatrixQuantizerCPU<ElemType>::MatrixQuantizerCPU()
 {
 }
 
+// -----------------------------------------------------------------------
+// one column, with the vector kernels where there are any
+// -----------------------------------------------------------------------
+
+// Below this number of elements the OpenMP overhead outweighs the gain of quantizing columns in parallel.
+static const size_t s_minParallelElements = 32 * 1024;
+
+// sums[s] = sum of v[i] (resp. (v[i] - mean)^2), v = a + residual, over the subset s of the rows (see ColumnQuantizer::RangeStatSubsets)
+template <class ElemType>
+static void SubsetSums(const ElemType* a, const ElemType* residual, size_t rows, bool squares, ElemType mean, ElemType* sums)
+{
+    if (CPUVectorKernels<ElemType>::QuantizerSubsetSums(a, residual, rows, squares, mean, sums))
+        return;
+    const size_t subsets = ColumnQuantizer<ElemType>::RangeStatSubsets;
+    for (size_t s = 0; s < subsets; s++)
+        sums[s] = 0;
+    for (size_t i = 0; i < rows; i++)
+    {
+        ElemType val = a[i] + residual[i];
+        sums[i % subsets] += squares ? (val - mean) * (val - mean) : val;
+    }
+}
+
+template <class ElemType>
+static void SubsetSums1Bit(const ElemType* a, const ElemType* residual, size_t rows, ElemType mean, ElemType* sums0, ElemType* sums1, unsigned int* counts1)
+{
+    if (CPUVectorKernels<ElemType>::QuantizerSubsetSums1Bit(a, residual, rows, mean, sums0, sums1, counts1))
+        return;
+    const size_t subsets = ColumnQuantizer<ElemType>::RangeStatSubsets;
+    for (size_t s = 0; s < subsets; s++)
+    {
+        sums0[s] = sums1[s] = 0;
+        counts1[s] = 0;
+    }
+    for (size_t i = 0; i < rows; i++)
+    {
+        ElemType val = a[i] + residual[i];
+        if (val < mean)
+            sums0[i % subsets] += val;
+        else
+        {
+            sums1[i % subsets] += val;
+            counts1[i % subsets]++;
+        }
+    }
+}
+
+// The quantization range of column j, as ColumnQuantizer::ComputeRangeStatColjSubset() computes it on the GPU:
+// the statistics are summed in the same subsets and then combined in the same order.
+template <class ElemType, bool ZeroThresholdFor1Bit>
+static void ComputeRangeStatColj(const ElemType* inMat, const ElemType* inResidual, size_t rows, size_t j, size_t bits, ElemType& lower, ElemType& upper)
+{
+    typedef ColumnQuantizer<ElemType> Quantizer;
+    const size_t subsets = Quantizer::RangeStatSubsets;
+    const ElemType* a = inMat + j * rows;
+    const ElemType* residual = inResidual + j * rows;
+
+    ElemType mean = 0.0f;
+    if (!ZeroThresholdFor1Bit && (bits == 1))
+    {
+        ElemType meanacc[subsets];
+        SubsetSums(a, residual, rows, false, (ElemType) 0, meanacc);
+        Quantizer::AllReduceSubsets(meanacc);
+        mean = meanacc[0] / rows;
+    }
+
+    if (bits == 1)
+    {
+        ElemType meanacc0[subsets], meanacc1[subsets];
+        unsigned int num0[subsets], num1[subsets];
+        SubsetSums1Bit(a, residual, rows, mean, meanacc0, meanacc1, num1);
+        for (size_t s = 0; s < subsets; s++)
+            num0[s] = (unsigned int) ((rows + subsets - 1 - s) / subsets) - num1[s]; // (the subset has that many rows)
+        Quantizer::AllReduceSubsets(meanacc0);
+        Quantizer::AllReduceSubsets(meanacc1);
+        Quantizer::AllReduceSubsets(num0);
+        Quantizer::AllReduceSubsets(num1);
+        Quantizer::template RangeFrom1BitStats<ZeroThresholdFor1Bit>(mean, meanacc0[0], meanacc1[0], num0[0], num1[0], rows, lower, upper);
+    }
+    else
+    {
+        ElemType varacc[subsets];
+        SubsetSums(a, residual, rows, true, mean, varacc);
+        Quantizer::AllReduceSubsets(varacc);
+        Quantizer::RangeFromVariance(mean, varacc[0], rows, lower, upper);
+    }
+}
+
+template <class ElemType, bool ZeroThresholdFor1Bit>
+static void QuantizeColumn(const ElemType* inMat, const ElemType* inResidual, size_t rows, size_t j, size_t nBits, QuantizedColumn<ElemType>& qcol, ElemType* outResidual)
+{
+    ComputeRangeStatColj<ElemType, ZeroThresholdFor1Bit>(inMat, inResidual, rows, j, nBits, qcol.lower, qcol.upper);
+
+    ColumnQuantizer<ElemType> q(ValueQuantizer<ElemType>::ld(nBits), qcol.lower, qcol.upper);
+    const size_t numQWordsPerCol = q.QWordsPerCol(rows);
+    size_t numQWordsDone = 0;
+    if (nBits == 1)
+    {
+        ElemType threshold, val0, val1;
+        q.template Get1BitParameters<ZeroThresholdFor1Bit>(threshold, val0, val1);
+        numQWordsDone = CPUVectorKernels<ElemType>::Quantize1Bit(inMat + j * rows, inResidual + j * rows, rows, numQWordsPerCol,
+                                                                 threshold, val0, val1, qcol.bits, outResidual + j * rows);
+    }
+    // Explicit use of 'template' keyword is needed to compile with GCC
+    for (size_t iQWord = numQWordsDone; iQWord < numQWordsPerCol; iQWord++)
+        qcol.bits[iQWord] = q.template QuantizeOneQWord<ZeroThresholdFor1Bit>(inMat, inResidual, (long) rows, iQWord, rows, numQWordsPerCol, j, outResidual);
+}
+
+template <class ElemType>
+static void UnquantizeColumn(const QuantizedColumn<ElemType>& qcol, size_t rows, size_t j, size_t nBits, ElemType* outMat, bool add)
+{
+    ColumnQuantizer<ElemType> q(ValueQuantizer<ElemType>::ld(nBits), qcol.lower, qcol.upper);
+    const size_t numQWordsPerCol = q.QWordsPerCol(rows);
+    size_t numQWordsDone = 0;
+    if (nBits == 1)
+    {
+        ElemType threshold, val0, val1;
+        q.template Get1BitParameters<true>(threshold, val0, val1);
+        numQWordsDone = CPUVectorKernels<ElemType>::Unquantize1Bit(qcol.bits, rows, numQWordsPerCol, val0, val1, add, outMat + j * rows);
+    }
+    for (size_t iQWord = numQWordsDone; iQWord < numQWordsPerCol; iQWord++)
+        q.UnquantizeOneQWord(outMat, (long) rows, iQWord, rows, numQWordsPerCol, j, qcol.bits[iQWord], add);
+}
+
+// -----------------------------------------------------------------------
+// MatrixQuantizerCPU
+// -----------------------------------------------------------------------
+
+// The columns are quantized in parallel. The results do not depend on the vector instruction set, and the
+// quantization ranges are summed in the order of the GPU kernels.
 template <class ElemType>
 void MatrixQuantizerCPU<ElemType>::QuantizeAsync(const Matrix<ElemType>& inMatrix, const Matrix<ElemType>& inResidual, QuantizedMatrix<ElemType>& outQMatrix, Matrix<ElemType>& outResidual, bool zeroThresholdFor1Bit)
 {
@@ -26,40 +157,18 @@ void MatrixQuantizerCPU<ElemType>::QuantizeAsync(const Matrix<ElemType>& inMatri
     assert((inResidual.GetNumRows() == nRow) && (inResidual.GetNumCols() == nCol));
     assert((outResidual.GetNumRows() == nRow) && (outResidual.GetNumCols() == nCol));
 
-    const size_t ldNbits = ValueQuantizer<ElemType>::ld(nBits);
-#ifdef QUANTUSEPPL
-    Concurrency::parallel_for((size_t) 0, us.cols(), [&](size_t j)
-#else
-    for (size_t j = 0; j < nCol; j++)
-#endif
+    const ElemType* inData = inMatrix.Data();
+    const ElemType* inResidualData = inResidual.Data();
+    ElemType* outResidualData = outResidual.Data();
+#pragma omp parallel for if (nRow * nCol >= s_minParallelElements)
+    for (long j = 0; j < (long) nCol; j++)
     {
         auto& qcol = *(outQMatrix.GetQuantizedColumn(j));
         if (zeroThresholdFor1Bit)
-        {
-            // Explicit use of 'template' keyword is needed to compile with GCC
-            ColumnQuantizer<ElemType>::template ComputeRangeStatColj<true>(inMatrix.Data(), inResidual.Data(), (long) nRow, j, nBits, qcol.lower, qcol.upper);
-        }
-        else
-        {
-            // Explicit use of 'template' keyword is needed to compile with GCC
-            ColumnQuantizer<ElemType>::template ComputeRangeStatColj<false>(inMatrix.Data(), inResidual.Data(), (long) nRow, j, nBits, qcol.lower, qcol.upper);
-        }
-
-        ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
-        if (zeroThresholdFor1Bit)
-        {
-            // Explicit use of 'template' keyword is needed to compile with GCC
-            q.template Quantize<true>(inMatrix.Data(), inResidual.Data(), (long) nRow, j, qcol.bits, outResidual.Data());
-        }
+            QuantizeColumn<ElemType, true>(inData, inResidualData, nRow, j, nBits, qcol, outResidualData);
         else
-        {
-            // Explicit use of 'template' keyword is needed to compile with GCC
-            q.template Quantize<false>(inMatrix.Data(), inResidual.Data(), (long) nRow, j, qcol.bits, outResidual.Data());
-        }
+            QuantizeColumn<ElemType, false>(inData, inResidualData, nRow, j, nBits, qcol, outResidualData);
     }
-#ifdef QUANTUSEPPL
-    );
-#endif
 }
 
 template <class ElemType>
@@ -83,20 +192,10 @@ void MatrixQuantizerCPU<ElemType>::UnquantizeAsync(QuantizedMatrix<ElemType>& in
     // Verify that the different matrix parameters have matching dimensions
     assert((outMatrix.GetNumRows() == nRow) && (outMatrix.GetNumCols() == nCol));
 
-    const size_t ldNbits = ValueQuantizer<ElemType>::ld(nBits);
-#ifdef QUANTUSEPPL
-    Concurrency::parallel_for((size_t) 0, us.cols(), [&](size_t j)
-#else
-    for (size_t j = 0; j < nCol; j++)
-#endif
-    {
-        const auto& qcol = *(inQMatrix.GetQuantizedColumn(j));
-        ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
-        q.Unquantize(outMatrix.Data(), (long) nRow, j, qcol.bits, add);
-    }
-#ifdef QUANTUSEPPL
-    );
-#endif
+    ElemType* outData = outMatrix.Data();
+#pragma omp parallel for if (nRow * nCol >= s_minParallelElements)
+    for (long j = 0; j < (long) nCol; j++)
+        UnquantizeColumn(*(inQMatrix.GetQuantizedColumn(j)), nRow, j, nBits, outData, add);
 }
 
 template <class ElemType>
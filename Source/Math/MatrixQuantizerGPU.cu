@@ -347,6 +347,9 @@ template class MatrixQuantizerGPU<double>;
 GPUMatrixComputeStreamEvent::GPUMatrixComputeStreamEvent(int deviceId)
     : MatrixComputeStreamEvent(deviceId)
 {
+    // the event belongs to the given device, which need not be the current one (e.g. after a copy from another GPU)
+    PrepareDevice(deviceId);
+
     // Note: Do NOT use cudaEventBlockingSync (which supposedly yields the process)--it will totally break cudaEventSynchronize(), causing it to take 50 or 100 ms randomly.
     cudaEventCreateWithFlags(&m_mainGPUComputeStreamCUDAEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
 
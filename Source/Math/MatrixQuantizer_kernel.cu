@@ -126,7 +126,7 @@ __device__ void allreduce(T& var)
     var = buf[0];
 }
 
-#define REDUCTION_BLOCK_SIZE 128 // 256 is much worse; 64 is somewhat worse
+#define REDUCTION_BLOCK_SIZE 128 // 256 is much worse; 64 is somewhat worse; the CPU follows this through ColumnQuantizer::RangeStatSubsets
 
 // version optimized for collated memory access
 template <class ElemType, bool ZeroThresholdFor1Bit>
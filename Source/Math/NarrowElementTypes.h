@@ -0,0 +1,136 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// NarrowElementTypes.h : compact element types used to transfer data from the readers to the device,
+// where they are widened to the element type of the network (see Matrix::AssignWidenedValuesOf).
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#pragma push_macro("NARROW_TYPES_DECL")
+#ifdef __CUDACC__
+#define NARROW_TYPES_DECL __host__ __device__
+#else
+#define NARROW_TYPES_DECL
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class NarrowElementType
+{
+    uint8,   // unsigned char
+    float16, // IEEE 754 half precision
+};
+
+inline size_t GetNarrowElementSize(NarrowElementType type)
+{
+    return type == NarrowElementType::uint8 ? sizeof(uint8_t) : sizeof(uint16_t);
+}
+
+// Bits of a half precision value. There is no arithmetic on the host, values are only converted.
+struct float16
+{
+    uint16_t m_bits;
+};
+
+NARROW_TYPES_DECL inline float NarrowToFloat(uint8_t value)
+{
+    return (float)value;
+}
+
+NARROW_TYPES_DECL inline float NarrowToFloat(float16 value)
+{
+    uint32_t sign = (uint32_t)(value.m_bits & 0x8000) << 16;
+    uint32_t exponent = (value.m_bits >> 10) & 0x1F;
+    uint32_t mantissa = value.m_bits & 0x3FF;
+
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        // Zero or subnormal: mantissa * 2^-24.
+        float result = mantissa * 5.9604644775390625e-8f;
+        return sign ? -result : result;
+    }
+    else if (exponent == 0x1F)
+        bits = sign | 0x7F800000 | (mantissa << 13); // infinity or NaN
+    else
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+#ifdef __CUDA_ARCH__
+    return __int_as_float((int)bits);
+#else
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+#endif
+}
+
+// Rounds to the nearest half precision value (ties to even), overflows to infinity.
+inline float16 FloatToFloat16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t absBits = bits & 0x7FFFFFFF;
+
+    uint32_t result;
+    if (absBits >= 0x7F800000)
+        result = 0x7C00 | (absBits > 0x7F800000 ? 0x200 : 0); // infinity or NaN
+    else if (absBits >= 0x477FF000)
+        result = 0x7C00; // 65520 and larger round to infinity
+    else if (absBits >= 0x38800000)
+    {
+        // Normal, rebias the exponent and round the mantissa; a carry correctly increments the exponent.
+        result = (absBits - 0x38000000) >> 13;
+        uint32_t remainder = absBits & 0x1FFF;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+            result++;
+    }
+    else if (absBits >= 0x33000000)
+    {
+        // Subnormal in half precision.
+        uint32_t exponent = absBits >> 23;
+        uint32_t mantissa = (absBits & 0x7FFFFF) | 0x800000;
+        uint32_t shift = 126 - exponent;
+        result = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (result & 1)))
+            result++;
+    }
+    else
+        result = 0;
+
+    float16 half;
+    half.m_bits = (uint16_t)(sign | result);
+    return half;
+}
+
+// Conversions of the reader to the transport type, a plain cast for the others.
+template <class TFrom, class TTo>
+inline void CastElement(TFrom from, TTo& to)
+{
+    to = static_cast<TTo>(from);
+}
+
+template <class TFrom>
+inline void CastElement(TFrom from, uint8_t& to)
+{
+    double value = (double)from + 0.5;
+    to = value <= 0 ? 0 : (value >= 255 ? 255 : (uint8_t)value);
+}
+
+template <class TFrom>
+inline void CastElement(TFrom from, float16& to)
+{
+    to = FloatToFloat16((float)from);
+}
+
+}}}
+
+#pragma pop_macro("NARROW_TYPES_DECL")
@@ -10,6 +10,11 @@
 #include <nccl.h>
 #include <cuda_runtime.h>
 
+// two-level reductions need the collectives and the multi-host support of NCCL 2, whose signatures also differ from NCCL 1
+#if defined(NCCL_MAJOR) && NCCL_MAJOR >= 2
+#define NCCL2
+#endif
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // allows to write cudaFunction() || "error"   (CUDA runtime)
@@ -19,51 +24,98 @@ static void operator||(cudaError_t rc, const char *msg)
         RuntimeError("%s: %s (cuda error %d)", msg, cudaGetErrorString(rc), (int) rc);
 }
 
+// allows to write ncclFunction() || "error"
+static void operator||(ncclResult_t rc, const char *msg)
+{
+    if (rc != ncclSuccess)
+        RuntimeError("NcclComm %s failed: %s", msg, ncclGetErrorString(rc));
+}
+
+// creates the NCCL communicator of the ranks of an MPI communicator (collective over it)
+static ncclComm_t CreateNcclComm(MPI_Comm mpiComm)
+{
+    int numRanks, rank;
+    MPI_Comm_size(mpiComm, &numRanks) || MpiFail("NcclComm: MPI_Comm_size");
+    MPI_Comm_rank(mpiComm, &rank) || MpiFail("NcclComm: MPI_Comm_rank");
+
+    ncclUniqueId ncclId;
+    ncclResult_t res;
+
+    res = ncclGetUniqueId(&ncclId);
+    if (res != ncclSuccess)
+        RuntimeError("NcclComm failed to obtain ncclUniqueId: %s", ncclGetErrorString(res));
+
+    MPI_Bcast(&ncclId, NCCL_UNIQUE_ID_BYTES, MPI_CHAR, 0, mpiComm)
+        || MpiFail("NcclComm: MPI_Bcase");
+
+    ncclComm_t ncclComm;
+    res = ncclCommInitRank(&ncclComm, numRanks, ncclId, rank);
+    if (res != ncclSuccess)
+      RuntimeError("NcclComm failed to initialize ncclComm_t: %s", ncclGetErrorString(res));
+    return ncclComm;
+}
+
 NcclComm::NcclComm(int deviceId, const MPIWrapperPtr& mpi)
-    : m_ncclComm(nullptr), m_stream(nullptr)
+    : m_ncclComm(nullptr), m_interHostComm(nullptr), m_stream(nullptr), m_localRank(0), m_numLocalRanks(0), m_numRanks(mpi->NumNodesInUse())
 {
-    if (mpi->IsMultiHost())
+    // on multiple hosts, NCCL runs across the ranks of each host, see NcclComm.h
+    bool hierarchical = mpi->IsMultiHost();
+#ifdef NCCL2
+    if (hierarchical && !mpi->HasHostCommunicators())
+        return;
+#else
+    if (hierarchical)
         return;
+#endif
 
-    size_t numRanks = mpi->NumNodesInUse();
-    MPI_Comm mpiComm = mpi->Communicator();
+    size_t numRanks = hierarchical ? mpi->NumRanksPerHost() : mpi->NumNodesInUse();
+    MPI_Comm mpiComm = hierarchical ? mpi->IntraHostCommunicator() : mpi->Communicator();
     std::vector<int> allDevs(numRanks);
     MPI_Allgather(&deviceId, 1, MPI_INT, allDevs.data(), 1, MPI_INT, mpiComm)
         || MpiFail("NcclComm: MPI_Allgather");
 
-    for (size_t r = 0; r<numRanks; r++)
+    const char* disabledReason = nullptr;
+    for (size_t r = 0; r<numRanks && !disabledReason; r++)
     {
         if (allDevs[r] == CPUDEVICE)
-        {
-            fprintf(stderr, "NcclComm: disabled, at least one rank using CPU device\n");
-            return;
-        }
-        for (size_t s = 0; s<r; s++)
+            disabledReason = "at least one rank using CPU device";
+        for (size_t s = 0; s<r && !disabledReason; s++)
             if (allDevs[r] == allDevs[s])
-            {
-                fprintf(stderr, "NcclComm: disabled, same device used by more than one rank\n");
-                return;
-            }
+                disabledReason = "same device used by more than one rank";
     }
 
-    ncclUniqueId ncclId;
-    ncclResult_t res;
-
-    res = ncclGetUniqueId(&ncclId);
-    if (res != ncclSuccess)
-        RuntimeError("NcclComm failed to obtain ncclUniqueId: %s", ncclGetErrorString(res));
+    // all hosts have to take the same decision
+    if (hierarchical)
+    {
+        int enabled = disabledReason == nullptr;
+        MPI_Allreduce(MPI_IN_PLACE, &enabled, 1, MPI_INT, MPI_MIN, mpi->Communicator())
+            || MpiFail("NcclComm: MPI_Allreduce");
+        if (!enabled && !disabledReason)
+            disabledReason = "disabled on another host";
+    }
 
-    MPI_Bcast(&ncclId, NCCL_UNIQUE_ID_BYTES, MPI_CHAR, 0, mpiComm)
-        || MpiFail("NcclComm: MPI_Bcase");
+    if (disabledReason)
+    {
+        fprintf(stderr, "NcclComm: disabled, %s\n", disabledReason);
+        return;
+    }
 
     PrepareDevice(deviceId);
-    res = ncclCommInitRank(&m_ncclComm, numRanks, ncclId, mpi->CurrentNodeRank());
-    if (res != ncclSuccess)
-      RuntimeError("NcclComm failed to initialize ncclComm_t: %s", ncclGetErrorString(res));
+    m_ncclComm = CreateNcclComm(mpiComm);
+    if (hierarchical)
+    {
+        m_interHostComm = CreateNcclComm(mpi->InterHostCommunicator());
+        m_localRank = mpi->LocalRank();
+        m_numLocalRanks = numRanks;
+    }
 
     cudaStreamCreateWithFlags(&m_stream, cudaStreamNonBlocking)
         || "cudaStreamCreateWithFlags failed";
-    fprintf(stderr, "NcclComm: initialized\n");
+    if (hierarchical)
+        fprintf(stderr, "NcclComm: initialized, reducing across %d ranks per host and %d hosts\n",
+                (int) numRanks, (int) (mpi->NumNodesInUse() / numRanks));
+    else
+        fprintf(stderr, "NcclComm: initialized\n");
 }
 
 NcclComm::~NcclComm()
@@ -72,6 +124,8 @@ NcclComm::~NcclComm()
         cudaStreamDestroy(m_stream);
     if (m_ncclComm != nullptr)
         ncclCommDestroy(m_ncclComm);
+    if (m_interHostComm != nullptr)
+        ncclCommDestroy(m_interHostComm);
 }
 
 bool NcclComm::IsSupported()
@@ -79,6 +133,11 @@ bool NcclComm::IsSupported()
     return m_ncclComm != nullptr;
 }
 
+bool NcclComm::IsHierarchical()
+{
+    return m_interHostComm != nullptr;
+}
+
 void NcclComm::AllReduceImpl(void* buffer, size_t count, DataType dtype)
 {
     ncclResult_t res;
@@ -96,11 +155,70 @@ void NcclComm::AllReduceImpl(void* buffer, size_t count, DataType dtype)
         RuntimeError("NcclComm ncclAllReduce failed: %s", ncclGetErrorString(res));
 }
 
+// Each rank of the host gets the sum over the host of its 1/m_numLocalRanks shard of the buffer (in place),
+// sums it with the ranks of the other hosts that hold the same shard, and gets the other summed shards back
+// from the ranks of the host. The elements left over by the shards are reduced in the two levels as a whole.
+void NcclComm::HierarchicalAllReduceImpl(void* buffer, size_t count, DataType dtype)
+{
+#ifdef NCCL2
+    ncclDataType_t ncclType = (dtype == DataType::FLOAT) ? ncclFloat : ncclDouble;
+    size_t elemSize = (dtype == DataType::FLOAT) ? sizeof(float) : sizeof(double);
+
+    char* data = static_cast<char*>(buffer);
+    size_t shardCount = count / m_numLocalRanks;
+    if (shardCount > 0)
+    {
+        char* shard = data + m_localRank * shardCount * elemSize;
+        ncclReduceScatter(data, shard, shardCount, ncclType, ncclSum, m_ncclComm, m_stream) || "ncclReduceScatter";
+        ncclAllReduce(shard, shard, shardCount, ncclType, ncclSum, m_interHostComm, m_stream) || "ncclAllReduce";
+        ncclAllGather(shard, data, shardCount, ncclType, m_ncclComm, m_stream) || "ncclAllGather";
+    }
+
+    size_t tailCount = count - shardCount * m_numLocalRanks;
+    if (tailCount > 0)
+    {
+        char* tail = data + shardCount * m_numLocalRanks * elemSize;
+        ncclAllReduce(tail, tail, tailCount, ncclType, ncclSum, m_ncclComm, m_stream) || "ncclAllReduce";
+        ncclAllReduce(tail, tail, tailCount, ncclType, ncclSum, m_interHostComm, m_stream) || "ncclAllReduce";
+    }
+#else
+    UNUSED(buffer); UNUSED(count); UNUSED(dtype);
+    LogicError("NcclComm: two-level reductions require NCCL 2.");
+#endif
+}
+
+// On multiple hosts, the buffers are gathered across the hosts into the block of the local rank, and the blocks across the host.
+void NcclComm::AllGatherImpl(const void* sendBuffer, void* recvBuffer, size_t numBytes)
+{
+#ifdef NCCL2
+    if (IsHierarchical())
+    {
+        size_t blockBytes = numBytes * (m_numRanks / m_numLocalRanks);
+        char* block = static_cast<char*>(recvBuffer) + m_localRank * blockBytes;
+        ncclAllGather(sendBuffer, block, numBytes, ncclChar, m_interHostComm, m_stream) || "ncclAllGather";
+        ncclAllGather(block, recvBuffer, blockBytes, ncclChar, m_ncclComm, m_stream) || "ncclAllGather";
+    }
+    else
+        ncclAllGather(sendBuffer, recvBuffer, numBytes, ncclChar, m_ncclComm, m_stream) || "ncclAllGather";
+#else
+    ncclAllGather(sendBuffer, (int) numBytes, ncclChar, recvBuffer, m_ncclComm, m_stream) || "ncclAllGather";
+#endif
+}
+
 void NcclComm::Sync()
 {
     cudaStreamSynchronize(m_stream) || "NcclComm: cudaStreamSynchronize failed";
 }
 
+void NcclComm::WaitForComputeStream()
+{
+    cudaEvent_t event;
+    cudaEventCreateWithFlags(&event, cudaEventDisableTiming) || "NcclComm: cudaEventCreateWithFlags failed";
+    cudaEventRecord(event, GetStream()) || "NcclComm: cudaEventRecord failed";
+    cudaStreamWaitEvent(m_stream, event, 0 /*flags 'must be 0'*/) || "NcclComm: cudaStreamWaitEvent failed";
+    cudaEventDestroy(event); // (released once the stream has waited for it)
+}
+
 }}} // end namespaces
 
 #else // !USE_NCCL
@@ -115,7 +233,13 @@ bool NcclComm::IsSupported()
     return false;
 }
 
+bool NcclComm::IsHierarchical()
+{
+    return false;
+}
+
 void NcclComm::Sync() { }
+void NcclComm::WaitForComputeStream() { }
 
 }}} // end namespaces
 #endif
@@ -3,9 +3,16 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 // Encapsulates NCCLs dependencies
+//
+// On a single host, reductions are NCCL all-reduces across all ranks. On multiple hosts that run the same number
+// of ranks each (MPIWrapper::HasHostCommunicators()), they are done in two levels, so that only a 1/(ranks per host)
+// shard of each buffer crosses the (slower) links between the hosts: a reduce-scatter across the ranks of the host,
+// an all-reduce of each shard across the ranks with the same local rank on the other hosts, and an all-gather
+// across the ranks of the host. This requires NCCL 2, which also runs the inter-host all-reduce.
 #pragma once
 
 #include "Matrix.h"
+#include "MatrixQuantizerImpl.h"
 #include "MPIWrapper.h"
 
 #include <vector>
@@ -23,18 +30,36 @@ class NcclComm
 private:
     enum class DataType : int {FLOAT, DOUBLE};
     void AllReduceImpl(void* buffer, size_t count, DataType dtype);
+    void HierarchicalAllReduceImpl(void* buffer, size_t count, DataType dtype);
+    void AllGatherImpl(const void* sendBuffer, void* recvBuffer, size_t numBytes);
     cudaStream_t m_stream;
-    ncclComm_t m_ncclComm;
+    ncclComm_t m_ncclComm;      // all ranks, resp. with IsHierarchical() the ranks of this host
+    ncclComm_t m_interHostComm; // with IsHierarchical(): the ranks with the same local rank on all hosts
+    size_t m_localRank;
+    size_t m_numLocalRanks;
+    size_t m_numRanks;
 #endif
 
 public:
     NcclComm(int deviceId, const MPIWrapperPtr& mpiComm);
     ~NcclComm();
     bool IsSupported();
+    bool IsHierarchical(); // reduces in two levels, see above
     void Sync(); // waits for outstanding reductions to complete
+    void WaitForComputeStream(); // makes reductions issued from now on wait for the work issued so far on the compute stream
 
     template <typename ElemType>
     void AllReduce(const std::vector<Matrix<ElemType>*>& grads)
+    {
+        for (size_t i=0; i<grads.size(); ++i)
+        {
+            AllReduce(grads[i]->Data(), grads[i]->GetNumElements());
+        }
+    }
+
+    // in place, on the device of this rank
+    template <typename ElemType>
+    void AllReduce(ElemType* buffer, size_t count)
     {
 #ifdef USE_NCCL
         DataType dtype = DataType::FLOAT;
@@ -43,14 +68,56 @@ public:
         else if (!std::is_same<ElemType, float>::value)
             RuntimeError("NcclComm Unsupported reduction type");
 
-        for (size_t i=0; i<grads.size(); ++i)
-        {
-            AllReduceImpl(grads[i]->Data(), grads[i]->GetNumElements(), dtype);
-        }
+        if (IsHierarchical())
+            HierarchicalAllReduceImpl(buffer, count, dtype);
+        else
+            AllReduceImpl(buffer, count, dtype);
+#else
+        UNUSED(buffer); UNUSED(count);
+        RuntimeError("NcclComm: CNTK was built without NCCL support.");
+#endif
+    }
+
+    // Gathers the quantized matrices of all ranks into 'all', which has the rows of 'mine' and numRanks times its columns;
+    // both on the device of this rank. The order of the ranks in 'all' is unspecified.
+    template <typename ElemType>
+    void AllGather(const QuantizedMatrix<ElemType>& mine, QuantizedMatrix<ElemType>& all)
+    {
+#ifdef USE_NCCL
+        if (mine.GetDeviceId() == CPUDEVICE || all.GetDeviceId() != mine.GetDeviceId() ||
+            all.GetNumRows() != mine.GetNumRows() || all.GetNumBits() != mine.GetNumBits() ||
+            all.GetNumCols() != mine.GetNumCols() * m_numRanks)
+            LogicError("NcclComm: AllGather requires quantized matrices on the device, with numRanks times the columns to gather into.");
+
+        AllGatherImpl(mine.Buffer(), all.Buffer(), mine.GetSize());
 #else
+        UNUSED(mine); UNUSED(all);
         RuntimeError("NcclComm: CNTK was built without NCCL support.");
 #endif
     }
+
+    // Aggregation with N-bit quantization and error feedback that stays on the device: quantizes 'gradient' plus 'residual'
+    // into 'quantizedGradient' and 'residual' with the new quantization error, gathers the quantized gradients of all ranks
+    // into 'allQuantizedGradients' (see AllGather()) and sets 'gradient' to the sum of them, unquantized.
+    // The quantizer must be for this device, and its compute stream synchronized with the computation of the gradient.
+    template <typename ElemType>
+    void QuantizedAllReduce(MatrixQuantizerImpl<ElemType>& quantizer, Matrix<ElemType>& gradient, Matrix<ElemType>& residual,
+                            QuantizedMatrix<ElemType>& quantizedGradient, QuantizedMatrix<ElemType>& allQuantizedGradients, bool zeroThresholdFor1Bit)
+    {
+        quantizer.QuantizeAsync(gradient, residual, quantizedGradient, residual, zeroThresholdFor1Bit);
+        quantizer.WaitQuantizeAsyncDone();
+
+        AllGather(quantizedGradient, allQuantizedGradients);
+        Sync();
+
+        size_t numCols = quantizedGradient.GetNumCols();
+        for (size_t r = 0; r * numCols < allQuantizedGradients.GetNumCols(); r++)
+        {
+            auto quantizedGradientOfRank = allQuantizedGradients.ColumnSlice(r * numCols, numCols);
+            quantizer.UnquantizeAsync(quantizedGradientOfRank, gradient, /*add=*/r > 0);
+        }
+        quantizer.WaitUnquantizeAsyncDone();
+    }
 };
 
 }}}
@@ -110,6 +110,11 @@ void GPUSparseMatrix<ElemType>::MaskColumnsValue(const GPUMatrix<char>& columnsM
 {
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::AssignOneHotColumns(const GPUMatrix<ElemType>& rowIndices, size_t numRows)
+{
+}
+
 template <class ElemType>
 GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::operator=(const GPUSparseMatrix<ElemType>& deepCopy)
 {
@@ -212,12 +217,10 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
 {
 }
 
-#if 0
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::SetMatrixFromSBCFormat(const size_t*, const ElemType*, const size_t, const size_t, const size_t)
 {
 }
-#endif
 
 // forward pass from feature to hidden layer
 template <class ElemType>
@@ -255,6 +258,16 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
 {
     return 1;
 }
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::LazyNormalGrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                                               const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum)
+{
+}
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::LazyFSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, std::vector<size_t>& lastUpdates, size_t updateCount,
+                                              ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+}
 //template<class ElemType>
 //void GPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>&, ElemType, ElemType, ElemType, ElemType) { }
 
@@ -738,6 +751,15 @@ MATH_API File& operator<<(File& stream, const GPUSparseMatrix<ElemType>& us)
 template MATH_API File& operator<<(File& stream, const GPUSparseMatrix<float>& us);
 template MATH_API File& operator<<(File& stream, const GPUSparseMatrix<double>& us);
 
+void TracingGPUMemoryAllocator::TrimCache(int deviceId)
+{
+}
+
+TracingGPUMemoryAllocator::CacheStatistics TracingGPUMemoryAllocator::GetCacheStatistics(int deviceId)
+{
+    return CacheStatistics();
+}
+
 #pragma region DeviceBoundNumber class
 
 template <class ElemType>
@@ -803,6 +825,11 @@ void GPUMatrix<ElemType>::ChangeDeviceTo(int to_id)
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignPeerCopyOf(const GPUMatrix<ElemType>& a)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::performElementWiseFunction(const ElementWiseOperator kind, const ElemType* src)
 {
@@ -1052,6 +1079,39 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
 {
 }
 
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::Dropout(const ElemType beta, const GPUMatrix<ElemType>& a, const ElemType dropoutRate, const uint64_t seed, const uint64_t offset, GPUMatrix<ElemType>& c)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::SetCounterBasedUniformRandomValue(const ElemType low, const ElemType high, const uint64_t seed)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::SetCounterBasedGaussianRandomValue(const ElemType mean, const ElemType sigma, const uint64_t seed)
+{
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignWeightedRandomSamplesWithReplacement(const GPUMatrix<ElemType>& weights, size_t numSamples, const uint64_t seed, const uint64_t offset, GPUMatrix<ElemType>& prefixSums)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignWeightedSampleKeys(const GPUMatrix<ElemType>& weights, const uint64_t seed, const uint64_t offset)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignWeightedSampleInclusionFrequencies(const GPUMatrix<ElemType>& weights, size_t numSamples, bool allowDuplicates, const GPUMatrix<ElemType>& samples)
+{
+    return *this;
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1062,12 +1122,27 @@ void GPUMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<El
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType biasCorrection, ElemType epsilon, ElemType decay)
+{
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier)
 {
     return 0;
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiTensorUpdate(DEVICEID_TYPE, std::vector<MultiTensorUpdateItem<ElemType>>&, const MultiTensorUpdateParams<ElemType>&)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiTensorSumOfSquares(DEVICEID_TYPE, const std::vector<const ElemType*>&, const std::vector<size_t>&, std::vector<double>&)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1342,6 +1417,12 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLogSoftmaxOf(const GPUMatrix<Ele
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSoftmaxCrossEntropyOf(const GPUMatrix<ElemType>& /*labels*/, const GPUMatrix<ElemType>& /*logits*/, GPUMatrix<ElemType>& /*logSumExp*/)
+{
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceHardmax(const bool isColWise)
 {
@@ -1484,6 +1565,11 @@ ElemType GPUMatrix<ElemType>::SumOfAbsElements() const
     return ElemType(0);
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::FlagNonFiniteValues(GPUMatrix<ElemType>& flag) const
+{
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::SumOfElements() const
 {
@@ -1817,6 +1903,18 @@ void GPUMatrix<ElemType>::ROIPoolingBackward(const size_t numRois, const size_t
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::ROIAlignForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+    const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const GPUMatrix<ElemType>& roiData, GPUMatrix<ElemType>& output) const
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ROIAlignBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
+    const size_t pooledWidth, const size_t pooledHeight, const size_t samplingRatio, const GPUMatrix<ElemType>& roiData, GPUMatrix<ElemType>& grad) const
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::MaxPoolingForward(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& output) const
 {
@@ -1847,7 +1945,7 @@ void GPUMatrix<ElemType>::AveragePoolingBackward(const GPUMatrix<int>& mpRowCol,
 template <class ElemType>
 void GPUMatrix<ElemType>::BatchNormalizationForward(const GPUMatrix<ElemType>& scale, const GPUMatrix<ElemType>& bias, bool inferenceOnly, double expAvgFactor, double blendFactor,
                                                     GPUMatrix<ElemType>& runMean, GPUMatrix<ElemType>& runVariance, GPUMatrix<ElemType>& out, double epsilon,
-                                                    GPUMatrix<ElemType>& saveMean, GPUMatrix<ElemType>& saveInvStdDev) const
+                                                    GPUMatrix<ElemType>& saveMean, GPUMatrix<ElemType>& saveInvStdDev, bool reluOutput) const
 {
 }
 
@@ -1859,7 +1957,26 @@ void GPUMatrix<ElemType>::BatchNormalizationBackward(const GPUMatrix<ElemType>&
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::RNNForward(const GPUMatrix<ElemType> &inputX, const GPUMatrix<ElemType> &paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace)
+void GPUMatrix<ElemType>::BatchNormalizationScaleAndBiasGradients(const GPUMatrix<ElemType>& in, const GPUMatrix<ElemType>& saveMean, const GPUMatrix<ElemType>& saveInvStdDev,
+                                                                  GPUMatrix<ElemType>& scaleGrad, GPUMatrix<ElemType>& biasGrad) const
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchNormalizationInputGradient(const GPUMatrix<ElemType>& in, GPUMatrix<ElemType>& grad, const GPUMatrix<ElemType>& scale, double mbStatsWeight,
+                                                          const GPUMatrix<ElemType>& saveMean, const GPUMatrix<ElemType>& saveInvStdDev,
+                                                          const GPUMatrix<ElemType>& scaleGrad, const GPUMatrix<ElemType>& biasGrad) const
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchNormalizationReluBackward(const GPUMatrix<ElemType>& in, const GPUMatrix<ElemType>& scale, const GPUMatrix<ElemType>& bias,
+                                                         const GPUMatrix<ElemType>& saveMean, const GPUMatrix<ElemType>& saveInvStdDev)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::RNNForward(const GPUMatrix<ElemType> &inputX, const GPUMatrix<ElemType> &paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, bool inferenceOnly, GPUMatrix<ElemType>& reserve, GPUMatrix<ElemType>& workspace)
 {
 }
 
@@ -1896,6 +2013,12 @@ void GPUMatrix<ElemType>::Multiply(const GPUMatrix<ElemType>& /*a*/, const bool
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& /*a*/, const bool transposeA, const size_t strideA, const GPUMatrix<ElemType>& /*b*/, const bool transposeB, const size_t strideB,
+                                                        ElemType beta, GPUMatrix<ElemType>& c, const size_t strideC, const size_t m, const size_t n, const size_t k, const size_t batchCount)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Multiply(const GPUMatrix<ElemType>& /*a*/, const GPUMatrix<ElemType>& /*b*/, GPUMatrix<ElemType>& c)
 {
@@ -1959,6 +2082,11 @@ void GPUMatrix<ElemType>::AddScaledDifference(const GPUMatrix<ElemType>& /*alpha
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(const GPUMatrix<ElemType>& /*alpha*/, const GPUMatrix<ElemType>& /*logits*/, const GPUMatrix<ElemType>& /*logSumExp*/, const GPUMatrix<ElemType>& /*labels*/, GPUMatrix<ElemType>& /*c*/)
+{
+}
+
 /// <summary> c = alpha * (a-b)</summary>
 /// if a, b, c  must have same dim
 /// <param name="alpha">Scalar</param>
@@ -2051,6 +2179,12 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
 {
 }
+template <class ElemType>
+void GPUMatrix<ElemType>::FusedTensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, ElemType alpha, const FusedElementwiseOp& program,
+                                        const array<size_t, 4>& offsets,
+                                        const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides)
+{
+}
 
 template <class ElemType>
 void GPUMatrix<ElemType>::CreateCurandObject(unsigned long seed, const char* caller)
@@ -2110,39 +2244,148 @@ ElemType GPUMatrix<ElemType>::LogSumOfElements() const
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::RCRFBackwardCompute(
-    const GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta,
-    const GPUMatrix<ElemType>& lbls,
-    const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores, const int shift)
+void GPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const GPUMatrix<ElemType>& a,
+                                                           const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& bias, size_t sampleCount, GPUMatrix<ElemType>& tmp, GPUMatrix<ElemType>& c)
 {
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
-                                              const GPUMatrix<ElemType>& alpha,
-                                              const GPUMatrix<ElemType>& beta,
-                                              const GPUMatrix<ElemType>& pair_scores,
-                                              GPUMatrix<ElemType>& grd,
-                                              const int startLbl,
-                                              const int shift)
+void GPUMatrix<ElemType>::AssignNCEDerivative(GPUMatrix<ElemType>& tmp, const GPUMatrix<ElemType>& a,
+                                              const GPUMatrix<ElemType>& b, size_t inputIndex, GPUMatrix<ElemType>& c)
 {
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const GPUMatrix<ElemType>& a,
-                                                           const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& bias, size_t sampleCount, GPUMatrix<ElemType>& tmp, GPUMatrix<ElemType>& c)
+void GPUMatrix<ElemType>::AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& c)
 {
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::AssignNCEDerivative(GPUMatrix<ElemType>& tmp, const GPUMatrix<ElemType>& a,
-                                              const GPUMatrix<ElemType>& b, size_t inputIndex, GPUMatrix<ElemType>& c)
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignAugmentedImages(GPUMatrix<ElemType>& workspace, size_t numImages, const ImageAugmentationParameters& parameters, uint64_t seed)
 {
+    return *this;
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& c)
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignWidenedValuesOf(const GPUMatrix<ElemType>& packed, NarrowElementType type, size_t numRows, size_t numCols, ElemType scale, ElemType shift)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignRanksWithinQueries(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& queryIds)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNDCGContributions(const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& ranks, const GPUMatrix<ElemType>& queryIds, bool atOne, GPUMatrix<ElemType>& queryStarts)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddLambdaRankGradient(const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& ranks, const GPUMatrix<ElemType>& queryIds, ElemType sigma)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFForwardScores(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFLogPosteriors(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFNegativeLogLikelihoods(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFTransitionGradient(const GPUMatrix<ElemType>& logPosteriors, const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions,
+                                                                      const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCRFViterbiPath(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& transitions, const GPUMatrix<ElemType>& labelIndices, const GPUMatrix<ElemType>& sequences, size_t stride,
+                                                               GPUMatrix<ElemType>& viterbiScores, GPUMatrix<ElemType>& backPointers)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNonZeroCountsOfSequences(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sequences, size_t stride)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNonZeroPositionsOfSequences(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sequences, size_t stride, const GPUMatrix<ElemType>& outputSequences, size_t outputStride)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignColumnsOfSequencePositions(const GPUMatrix<ElemType>& positions, const GPUMatrix<ElemType>& sequences, size_t stride, const GPUMatrix<ElemType>& targetSequences, size_t targetStride)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignGMMLogLikelihoods(const GPUMatrix<ElemType>& unnormedPrior, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, GPUMatrix<ElemType>& posteriors)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMUnnormedPriorGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& unnormedPrior, const GPUMatrix<ElemType>& posteriors)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMMeanGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMLogStddevGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMFeatureGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSimilaritiesWithNegativeSamples(const GPUMatrix<ElemType>& similarities, size_t shift, size_t numNegatives, bool inBatchNegatives, GPUMatrix<ElemType>& documents)
 {
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNegativeSamplesGradientMatrix(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& documents)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddColumnNormalizationGradient(const GPUMatrix<ElemType>& gradientOfNormalized, const GPUMatrix<ElemType>& normalized, const GPUMatrix<ElemType>& invNorms)
+{
+    return *this;
 }
 
 template <class ElemType>
@@ -2234,6 +2477,7 @@ GPUDataTransferer::GPUDataTransferer(int, bool){}
 GPUDataTransferer::~GPUDataTransferer(){}
 void GPUDataTransferer::CopyGPUToCPUAsync(void*, size_t, void*){}
 void GPUDataTransferer::WaitForCopyGPUToCPUAsync(){}
+bool GPUDataTransferer::IsCopyGPUToCPUAsyncComplete(){ return true; }
 void GPUDataTransferer::CopyCPUToGPUAsync(void*, size_t, void*){}
 void GPUDataTransferer::WaitForCopyCPUToGPUAsync(){}
 
@@ -2270,6 +2514,9 @@ cublasHandle_t GPUMatrix<ElemType>::s_cuHandle[GPUMatrix<ElemType>::MaxGpus] = {
 template <class ElemType>
 void* GPUMatrix<ElemType>::s_curandGenerator = NULL;
 
+template <class ElemType>
+bool GPUMatrix<ElemType>::s_useMixedPrecisionGemm = false;
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> CuDnnConvolutionEngineFactory<ElemType>::Create(ConvolveGeometryPtr, DEVICEID_TYPE,
                                                                                              ImageLayoutKind, size_t, PoolKind, bool)
@@ -2278,7 +2525,7 @@ std::unique_ptr<ConvolutionEngine<ElemType>> CuDnnConvolutionEngineFactory<ElemT
 }
 
 template <class ElemType>
-bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE, ConvolveGeometryPtr, PoolKind)
+bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE, ConvolveGeometryPtr, PoolKind, ImageLayoutKind)
 {
     return false;
 }
@@ -2313,6 +2560,15 @@ float CudaTimer::Elapsed()
 /*static*/ void SyncGuard::EnableSync()
 {
 }
+
+/*static*/ void DeterministicReductions::Enable(bool)
+{
+}
+
+/*static*/ bool DeterministicReductions::IsEnabled()
+{
+    return false;
+}
 } } }
 
 // define a dummy GPUWatcher class too
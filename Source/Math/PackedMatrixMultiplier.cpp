@@ -0,0 +1,88 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// PackedMatrixMultiplier.cpp -- packing, and the product with the generic loops if there is no vector kernel for the CPU.
+//
+
+#include "stdafx.h"
+#include "PackedMatrixMultiplier.h"
+#include "CPUVectorKernels.h"
+#include "CPUVectorKernelTable.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// below this size the BLAS is as fast for a single column (measured with OpenBLAS on Skylake-SP)
+static const size_t s_minPackedElements = 256 * 1024;
+
+template <class ElemType>
+bool PackedMatrixMultiplier<ElemType>::IsWorthPacking(size_t m, size_t k)
+{
+    return m * k >= s_minPackedElements && GetCPUVectorInstructionSet() >= CPUVectorInstructionSet::AVX2;
+}
+
+template <class ElemType>
+PackedMatrixMultiplier<ElemType>::PackedMatrixMultiplier()
+    : m_m(0), m_k(0)
+{
+}
+
+template <class ElemType>
+void PackedMatrixMultiplier<ElemType>::Pack(const ElemType* a, size_t m, size_t k, bool transposeA)
+{
+    if (m == 0 || k == 0)
+        InvalidArgument("PackedMatrixMultiplier: invalid dimensions of A [%d x %d].", (int) m, (int) k);
+
+    size_t numPanels = (m + PackedPanelRows - 1) / PackedPanelRows;
+    m_packed.assign(numPanels * PackedPanelRows * k, 0);
+    for (size_t i = 0; i < m; i++)
+    {
+        ElemType* panel = m_packed.data() + (i / PackedPanelRows) * PackedPanelRows * k + i % PackedPanelRows;
+        for (size_t d = 0; d < k; d++)
+            panel[d * PackedPanelRows] = transposeA ? a[d + k * i] : a[i + m * d];
+    }
+    m_m = m;
+    m_k = k;
+}
+
+template <class ElemType>
+void PackedMatrixMultiplier<ElemType>::Multiply(ElemType alpha, const ElemType* b, size_t n, ElemType beta, ElemType* c) const
+{
+    if (!IsPacked())
+        LogicError("PackedMatrixMultiplier: Multiply() called before Pack().");
+    if (n == 0)
+        return;
+
+    if (CPUVectorKernels<ElemType>::PackedProduct(m_packed.data(), m_m, m_k, beta, b, alpha, c, n))
+        return;
+
+    // generic loops, one panel at a time
+    const ElemType* packed = m_packed.data();
+    const size_t m = m_m, k = m_k;
+    long numPanels = (long) ((m + PackedPanelRows - 1) / PackedPanelRows);
+#pragma omp parallel for if (m * k * n >= 32 * 1024)
+    for (long panel = 0; panel < numPanels; panel++)
+    {
+        size_t begin = panel * PackedPanelRows;
+        size_t rows = std::min(m, begin + PackedPanelRows) - begin;
+        const ElemType* p = packed + begin * k;
+        for (size_t j = 0; j < n; j++)
+        {
+            const ElemType* bj = b + j * k;
+            ElemType acc[PackedPanelRows] = { 0 };
+            for (size_t d = 0; d < k; d++)
+            {
+                for (size_t r = 0; r < PackedPanelRows; r++)
+                    acc[r] += p[d * PackedPanelRows + r] * bj[d];
+            }
+            ElemType* cj = c + begin + j * m;
+            for (size_t r = 0; r < rows; r++)
+                cj[r] = beta != 0 ? alpha * acc[r] + beta * cj[r] : alpha * acc[r];
+        }
+    }
+}
+
+template class PackedMatrixMultiplier<float>;
+template class PackedMatrixMultiplier<double>;
+
+}}}
@@ -0,0 +1,51 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// PackedMatrixMultiplier.h -- float/double matrix product with a constant left argument that is packed once,
+// for evaluating small minibatches on the CPU without having the BLAS repack the weights on every call.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// C[m,n] = alpha * A[m,k] * B[k,n] + beta * C[m,n] for column-major matrices, where A is a constant (e.g. the weights of
+// TimesNode in evaluation) that Pack() rewrites in panels of rows once, and B has few columns. For a GEMM the BLAS packs A
+// in every call, which for a few columns of a large A costs more than the product itself. With many columns this cost is
+// amortized and the BLAS, which also blocks for the cache along n, is faster; for a small A that stays in the cache,
+// packing is cheap anyway (see IsWorthPacking() and MaxColumns).
+template <class ElemType>
+class MATH_API PackedMatrixMultiplier
+{
+public:
+    // Up to this many columns of B, Multiply() beats the GEMM on the unpacked A.
+    static const size_t MaxColumns = 16;
+
+    // Whether Multiply() beats the GEMM for A [m x k], which needs the vector kernels (see CPUVectorKernels) and an A
+    // that is too large for the L2 cache. Without the kernels Multiply() runs generic loops, which are correct but slow.
+    static bool IsWorthPacking(size_t m, size_t k);
+
+    PackedMatrixMultiplier();
+
+    // Packs the column-major A [m x k], or [k x m] if transposeA, which is then used as A[m,k].
+    void Pack(const ElemType* a, size_t m, size_t k, bool transposeA);
+
+    bool IsPacked() const { return m_m > 0; }
+    size_t GetNumRows() const { return m_m; }
+    size_t GetNumCols() const { return m_k; }
+
+    // C = alpha * A * B + beta * C with the packed A, for the column-major B [k x n] and C [m x n].
+    // C is not read if beta == 0.
+    void Multiply(ElemType alpha, const ElemType* b, size_t n, ElemType beta, ElemType* c) const;
+
+private:
+    std::vector<ElemType> m_packed;
+    size_t m_m;
+    size_t m_k;
+};
+
+}}}
@@ -0,0 +1,168 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedBlockMultiplier.cpp -- selection of the BlockMultiplier by the instruction set of the CPU.
+//
+
+#include "stdafx.h"
+#include "QuantizedBlockMultiplier.h"
+#include "QuantizedBlockMultiplierImpl.h"
+#include "CPUVectorKernels.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#if defined(__aarch64__)
+
+// There is no BlockHandler for ARM64 (see BlockHandlerSSE.cpp), so fall back to plain loops.
+template <class ScalarT>
+class ReferenceBlockMultiplier : public IntegerBlockMultiplier<ScalarT>
+{
+public:
+    virtual void PrepareB(const ScalarT* B, int k, int n) override
+    {
+        m_B.assign(B, B + k * n);
+        m_k = k;
+        m_n = n;
+    }
+
+    virtual void Multiply(const ScalarT* A, int m, int32_t* C) override
+    {
+        for (int r = 0; r < m; ++r)
+        {
+            for (int c = 0; c < m_n; ++c)
+            {
+                int32_t accum = 0;
+                for (int d = 0; d < m_k; ++d)
+                    accum += (int32_t) A[r * m_k + d] * (int32_t) m_B[d * m_n + c];
+                C[r * m_n + c] = accum;
+            }
+        }
+    }
+
+    virtual const char* GetName() const override
+    {
+        return "none";
+    }
+
+private:
+    std::vector<ScalarT> m_B;
+    int m_k;
+    int m_n;
+};
+
+#endif
+
+// int8 on a CPU without VNNI: the values are widened to int16, which gives the same results.
+class WideningBlockMultiplier : public IntegerBlockMultiplier<int8_t>
+{
+public:
+    WideningBlockMultiplier(IntegerBlockMultiplier<short>* impl)
+        : m_impl(impl), m_k(0)
+    {
+    }
+
+    virtual void PrepareB(const int8_t* B, int k, int n) override
+    {
+        std::vector<short> wideB(B, B + k * n);
+        m_impl->PrepareB(wideB.data(), k, n);
+        m_k = k;
+    }
+
+    virtual void Multiply(const int8_t* A, int m, int32_t* C) override
+    {
+        m_wideA.assign(A, A + m * m_k);
+        m_impl->Multiply(m_wideA.data(), m, C);
+    }
+
+    virtual const char* GetName() const override
+    {
+        return m_impl->GetName();
+    }
+
+private:
+    std::unique_ptr<IntegerBlockMultiplier<short>> m_impl;
+    std::vector<short> m_wideA;
+    int m_k;
+};
+
+static IntegerBlockMultiplier<short>* CreateBlockMultiplierInt16()
+{
+#if defined(__aarch64__)
+    return new ReferenceBlockMultiplier<short>();
+#else
+    CPUVectorInstructionSet instructionSet = GetCPUVectorInstructionSet();
+    if (instructionSet >= CPUVectorInstructionSet::AVX512VNNI)
+        return CreateBlockMultiplierAVX512VNNI();
+    if (instructionSet >= CPUVectorInstructionSet::AVX512)
+        return CreateBlockMultiplierAVX512();
+#ifdef SUPPORT_AVX2
+    // BlockHandlerAVX needs the whole library to be compiled for AVX2
+    if (instructionSet >= CPUVectorInstructionSet::AVX2)
+        return new BlockMultiplierAdapter<BlockHandlerAVX>("AVX2");
+#endif
+    return new BlockMultiplierAdapter<BlockHandlerSSE>("SSE");
+#endif
+}
+
+template <class ScalarT>
+static IntegerBlockMultiplier<ScalarT>* CreateBlockMultiplier();
+
+template <>
+IntegerBlockMultiplier<short>* CreateBlockMultiplier<short>()
+{
+    return CreateBlockMultiplierInt16();
+}
+
+template <>
+IntegerBlockMultiplier<int8_t>* CreateBlockMultiplier<int8_t>()
+{
+#if !defined(__aarch64__)
+    if (GetCPUVectorInstructionSet() >= CPUVectorInstructionSet::AVX512VNNI)
+        return CreateBlockMultiplierAVX512VNNI8();
+#endif
+    return new WideningBlockMultiplier(CreateBlockMultiplierInt16());
+}
+
+template <class ScalarT>
+QuantizedBlockMultiplier<ScalarT>::QuantizedBlockMultiplier()
+    : m_impl(CreateBlockMultiplier<ScalarT>()), m_k(0), m_n(0)
+{
+}
+
+template <class ScalarT>
+QuantizedBlockMultiplier<ScalarT>::~QuantizedBlockMultiplier()
+{
+}
+
+template <class ScalarT>
+void QuantizedBlockMultiplier<ScalarT>::PrepareB(const ScalarT* B, int k, int n)
+{
+    if (k <= 0 || n <= 0)
+        InvalidArgument("QuantizedBlockMultiplier: invalid dimensions of B [%d x %d].", k, n);
+
+    m_impl->PrepareB(B, k, n);
+    m_k = k;
+    m_n = n;
+}
+
+template <class ScalarT>
+void QuantizedBlockMultiplier<ScalarT>::Multiply(const ScalarT* A, int m, int32_t* C)
+{
+    if (m_k == 0)
+        LogicError("QuantizedBlockMultiplier: Multiply() called before PrepareB().");
+
+    m_impl->Multiply(A, m, C);
+}
+
+template <class ScalarT>
+const char* QuantizedBlockMultiplier<ScalarT>::GetHandlerName() const
+{
+    return m_impl->GetName();
+}
+
+template class QuantizedBlockMultiplier<short>;
+template class QuantizedBlockMultiplier<int8_t>;
+
+}}}
@@ -0,0 +1,46 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedBlockMultiplier.h -- integer matrix product of the quantized operations, on the BlockMultiplier with the
+// block handler that is selected at runtime by the instruction set of the CPU.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <cstdint>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ScalarT>
+class IntegerBlockMultiplier;
+
+// C[m,n] = A[m,k] * B[k,n] for integer matrices in row-major order, with 32-bit results that saturate.
+// B is rewritten in block order once by PrepareB() and can then be multiplied with any number of A's.
+// ScalarT is short or int8_t. The block handler is the best of AVX-512 VNNI, AVX-512, AVX2 (if compiled with
+// SUPPORT_AVX2) and SSE, limited by SetMaxCPUVectorInstructionSet() at the time of construction.
+// int8_t needs VNNI and is widened to short on CPUs without it.
+template <class ScalarT>
+class MATH_API QuantizedBlockMultiplier
+{
+public:
+    QuantizedBlockMultiplier();
+    ~QuantizedBlockMultiplier();
+
+    void PrepareB(const ScalarT* B, int k, int n);
+
+    // C[m,n] = A[m,k] * B[k,n] with the last prepared B.
+    void Multiply(const ScalarT* A, int m, int32_t* C);
+
+    // The block handler in use, e.g. "AVX-512 VNNI".
+    const char* GetHandlerName() const;
+
+private:
+    std::unique_ptr<IntegerBlockMultiplier<ScalarT>> m_impl;
+    int m_k;
+    int m_n;
+};
+
+}}}
@@ -0,0 +1,23 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedBlockMultiplierAVX512.cpp -- BlockMultiplier with the AVX-512 block handler for int16. This file is compiled
+// with AVX-512 F and BW code generation (see Makefile) and must only be called after the runtime check in QuantizedBlockMultiplier.cpp.
+//
+
+#if !defined(__aarch64__)
+
+#include "QuantizedBlockMultiplierImpl.h"
+#include "BlockHandlerAVX512.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+IntegerBlockMultiplier<short>* CreateBlockMultiplierAVX512()
+{
+    return new BlockMultiplierAdapter<BlockHandlerAVX512>("AVX-512");
+}
+
+}}}
+
+#endif
@@ -0,0 +1,29 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedBlockMultiplierAVX512VNNI.cpp -- BlockMultipliers with the AVX-512 VNNI block handlers for int16 and int8. This file
+// is compiled with AVX-512 F, BW and VNNI code generation (see Makefile) and must only be called after the runtime check in
+// QuantizedBlockMultiplier.cpp.
+//
+
+#if !defined(__aarch64__)
+
+#include "QuantizedBlockMultiplierImpl.h"
+#include "BlockHandlerAVX512.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+IntegerBlockMultiplier<short>* CreateBlockMultiplierAVX512VNNI()
+{
+    return new BlockMultiplierAdapter<BlockHandlerAVX512VNNI>("AVX-512 VNNI");
+}
+
+IntegerBlockMultiplier<int8_t>* CreateBlockMultiplierAVX512VNNI8()
+{
+    return new BlockMultiplierAdapter<BlockHandlerAVX512VNNI8>("AVX-512 VNNI");
+}
+
+}}}
+
+#endif
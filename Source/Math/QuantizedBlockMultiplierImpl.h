@@ -0,0 +1,85 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedBlockMultiplierImpl.h -- interface between QuantizedBlockMultiplier and the BlockMultipliers, some of which
+// are compiled for one instruction set each (QuantizedBlockMultiplierAVX512.cpp, QuantizedBlockMultiplierAVX512VNNI.cpp).
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#if !defined(__aarch64__)
+#include "BlockMultiplier.h"
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ScalarT>
+class IntegerBlockMultiplier
+{
+public:
+    virtual ~IntegerBlockMultiplier() {}
+    virtual void PrepareB(const ScalarT* B, int k, int n) = 0;
+    virtual void Multiply(const ScalarT* A, int m, int32_t* C) = 0;
+    virtual const char* GetName() const = 0;
+};
+
+#if !defined(__aarch64__)
+
+// A BlockMultiplier with the given block handler, which keeps its prepared B.
+template <class BlockHandlerT>
+class BlockMultiplierAdapter : public IntegerBlockMultiplier<typename BlockHandlerT::ScalarAT>
+{
+    typedef typename BlockHandlerT::ScalarAT ScalarT;
+
+public:
+    BlockMultiplierAdapter(const char* name)
+        : m_multiplier(omp_get_max_threads()), m_name(name), m_preparedB(nullptr), m_k(0), m_n(0)
+    {
+    }
+
+    ~BlockMultiplierAdapter()
+    {
+        if (m_preparedB)
+            m_multiplier.FreeMatrix(m_preparedB);
+    }
+
+    virtual void PrepareB(const ScalarT* B, int k, int n) override
+    {
+        if (m_preparedB)
+            m_multiplier.FreeMatrix(m_preparedB);
+        m_preparedB = m_multiplier.PrepareB(const_cast<ScalarT*>(B), k, n);
+        m_k = k;
+        m_n = n;
+    }
+
+    virtual void Multiply(const ScalarT* A, int m, int32_t* C) override
+    {
+        // not all block sizes assign their results to C, some add them up
+        memset(C, 0, sizeof(int32_t) * m * m_n);
+        m_multiplier.MultiplyMatrices(const_cast<ScalarT*>(A), m, m_k, m_preparedB, m_n, C);
+    }
+
+    virtual const char* GetName() const override
+    {
+        return m_name;
+    }
+
+private:
+    BlockMultiplier<BlockHandlerT> m_multiplier;
+    const char* m_name;
+    ScalarT* m_preparedB;
+    int m_k;
+    int m_n;
+};
+
+#endif
+
+// Defined in the files that are compiled with the AVX-512 options; only to be called if the CPU supports them.
+IntegerBlockMultiplier<short>* CreateBlockMultiplierAVX512();
+IntegerBlockMultiplier<short>* CreateBlockMultiplierAVX512VNNI();
+IntegerBlockMultiplier<int8_t>* CreateBlockMultiplierAVX512VNNI8();
+
+}}}
@@ -4,6 +4,7 @@
 //
 #pragma once
 #include "Quantizers.h"
+#include "QuantizedBlockMultiplier.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -11,15 +12,23 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // Quantized product of two dense matrices A and B, where each matrix has its own quantizer.
 // This class handles quantization of both matrices, product and de-quantization of the result.
 // Other implementations should inherit from this class or extract common methods to the base class and inherit from the base.
-template <class ElemType>
+// QuantizedType is short or int8_t; the integer product runs on the BlockMultiplier that is best for the CPU
+// (see QuantizedBlockMultiplier), int8_t is fastest on CPUs with AVX-512 VNNI.
+template <class ElemType, class QuantizedType = short>
 class QuantizedMultiplier
 {
     // Quantizers for matrices A and B
-    shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerA;
-    shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerB;
+    shared_ptr<QuantizerBase<ElemType, QuantizedType>> m_pQuantizerA;
+    shared_ptr<QuantizerBase<ElemType, QuantizedType>> m_pQuantizerB;
+
+    // Placeholders for quantized matrices A and B, and the integer product
+    vector<QuantizedType> m_pMatA, m_pMatB;
+    vector<int32_t> m_matC;
 
-    // Placeholders for quantized matrices A and B
-    vector<short> m_pMatA, m_pMatB;
+    // CNTK is using column-major storage, which is row-major storage of the transposed matrices, so the block multiplier
+    // computes C^T[n,m] = B^T[n,k] * A^T[k,m]. A^T is the matrix that is rewritten in block order, which for a constant A
+    // (i.e. weights) is only done once.
+    QuantizedBlockMultiplier<QuantizedType> m_blockMultiplier;
 
     // Whether matrices A and B are constant (i.e. weights)
     // If the matrix is constant, the size of the underlying container for quatized values will be preserved for
@@ -30,13 +39,13 @@ class QuantizedMultiplier
     bool m_firstPass;
 
 public: 
-    QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, bool isAConstant, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB, bool isBConstant) :
+    QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, QuantizedType>> pQuantizerA, bool isAConstant, shared_ptr<QuantizerBase<ElemType, QuantizedType>> pQuantizerB, bool isBConstant) :
         m_pQuantizerA(pQuantizerA), m_pQuantizerB(pQuantizerB), m_isAConstant(isAConstant), m_isBConstant(isBConstant), m_firstPass(true)
     {
         if (isAConstant && isBConstant)
             LogicError("Quantized multiplication is applied to two constant matrices -- it is highly inefficient. Better approach is to replace the operation with the resulting matrix.");
     };
-    QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB) :
+    QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, QuantizedType>> pQuantizerA, shared_ptr<QuantizerBase<ElemType, QuantizedType>> pQuantizerB) :
         QuantizedMultiplier(pQuantizerA, false, pQuantizerB, false)
     {
     };
@@ -48,36 +57,28 @@ public:
         if (!m_isAConstant || m_firstPass)
         {
             m_pMatA.resize(m*k);
-            ArrayRef<short> refMatA(m_pMatA.data(), m_pMatA.size());
+            ArrayRef<QuantizedType> refMatA(m_pMatA.data(), m_pMatA.size());
             m_pQuantizerA->Quantize(ArrayRef<ElemType>(A, m_pMatA.size()), refMatA);
+            m_blockMultiplier.PrepareB(m_pMatA.data(), k, m);
         }
-        
+
         if (!m_isBConstant || m_firstPass)
         {
             m_pMatB.resize(n*k);
-            ArrayRef<short> refMatB(m_pMatB.data(), m_pMatB.size());
+            ArrayRef<QuantizedType> refMatB(m_pMatB.data(), m_pMatB.size());
             m_pQuantizerB->Quantize(ArrayRef<ElemType>(B, m_pMatB.size()), refMatB);
         }
 
         m_firstPass = false;
 
         // Do multiply
-        // Naive inefficient product, just for demonstation
-        // TODO: replace with an efficient version, e.g. IPG, block multiplier, Eigen, gemmlowp, etc.
-        for (size_t i = 0; i < m; i++)
-            for (size_t j = 0; j < n; j++)
-            {
-                int dotProduct=0;
-                for (size_t l = 0; l < k; l++)
-                {
-                    // CNTK is using column-major storage
-                    dotProduct += m_pMatA[i + l*m] * m_pMatB[l + k*j];
-                }
-                C[i + j*m] = (ElemType)dotProduct;
-            }
+        int mn = m*n;
+        m_matC.resize(mn);
+        m_blockMultiplier.Multiply(m_pMatB.data(), n, m_matC.data());
+        for (int i = 0; i < mn; i++)
+            C[i] = (ElemType)m_matC[i];
 
         // De-quantize
-        int mn = m*n;
         m_pQuantizerB->Dequantize(C, C, mn);
         m_pQuantizerA->Dequantize(C, C, mn);
     }
@@ -86,4 +87,88 @@ public:
     void SetIsBConstant(bool v) { m_isBConstant = v; }
 };
 
+// Int8 product of constant weights W and data X for inference on the CPU: C[m,n] = W[m,k] * X[k,n], column-major.
+// W is quantized once, with one scale per output channel (row of W) from its absolute maximum, so it must not change
+// between the calls. X is quantized with a fixed range, usually recorded by calibration; values outside of it saturate.
+// If weightsTransposed, W is given as W^T[k,m], i.e. the weights of each channel are contiguous (convolution kernels).
+template <class ElemType>
+class Int8ChannelwiseMultiplier
+{
+    static const int QuantizedMax = 127;
+
+    ElemType m_inputRange;
+    bool m_weightsTransposed;
+
+    // quantized W^T[k,m] as rewritten by the block multiplier, and the scale of each channel
+    QuantizedBlockMultiplier<int8_t> m_blockMultiplier;
+    vector<ElemType> m_weightScales;
+    int m_m, m_k;
+
+    vector<int8_t> m_matX;
+    vector<int32_t> m_matC;
+
+public:
+    Int8ChannelwiseMultiplier(ElemType inputRange, bool weightsTransposed) :
+        m_inputRange(inputRange), m_weightsTransposed(weightsTransposed), m_m(0), m_k(0)
+    {
+        if (inputRange <= 0)
+            InvalidArgument("Int8ChannelwiseMultiplier: the input range must be positive.");
+    }
+
+    ElemType InputRange() const { return m_inputRange; }
+
+    void Multiply(int m, int n, int k, const ElemType* W, const ElemType* X, ElemType* C)
+    {
+        if (m != m_m || k != m_k)
+            PrepareWeights(m, k, W);
+
+        // Quantize X[k,n], which is X^T[n,k] in row-major order
+        const ElemType inputFactor = QuantizedMax / m_inputRange;
+        const size_t kn = (size_t)k * n;
+        m_matX.resize(kn);
+        for (size_t i = 0; i < kn; i++)
+            m_matX[i] = (int8_t)std::max<ElemType>(-QuantizedMax, std::min<ElemType>(QuantizedMax, round(X[i] * inputFactor)));
+
+        // C^T[n,m] = X^T[n,k] * W^T[k,m]
+        m_matC.resize((size_t)m * n);
+        m_blockMultiplier.Multiply(m_matX.data(), n, m_matC.data());
+
+        // De-quantize
+        const ElemType inputScale = m_inputRange / QuantizedMax;
+        for (int j = 0; j < n; j++)
+        {
+            const int32_t* colC = &m_matC[(size_t)j * m];
+            ElemType* outC = C + (size_t)j * m;
+            for (int i = 0; i < m; i++)
+                outC[i] = colC[i] * m_weightScales[i] * inputScale;
+        }
+    }
+
+private:
+    void PrepareWeights(int m, int k, const ElemType* W)
+    {
+        // W(i,d) is at i + m*d, or at i*k + d if transposed
+        const size_t rowStride = m_weightsTransposed ? k : 1;
+        const size_t colStride = m_weightsTransposed ? 1 : m;
+
+        vector<int8_t> quantizedW((size_t)k * m);
+        m_weightScales.resize(m);
+        for (int i = 0; i < m; i++)
+        {
+            ElemType absMax = 0;
+            for (int d = 0; d < k; d++)
+                absMax = std::max(absMax, std::abs(W[i * rowStride + d * colStride]));
+
+            const ElemType factor = absMax > 0 ? QuantizedMax / absMax : 0;
+            m_weightScales[i] = absMax / QuantizedMax;
+            for (int d = 0; d < k; d++)
+                quantizedW[(size_t)d * m + i] = (int8_t)round(W[i * rowStride + d * colStride] * factor);
+        }
+
+        m_blockMultiplier.PrepareB(quantizedW.data(), k, m);
+        m_m = m;
+        m_k = k;
+    }
+};
+
 }}}
\ No newline at end of file
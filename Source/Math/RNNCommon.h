@@ -18,10 +18,13 @@ struct RnnAttributes
     size_t m_hiddenSize;
     wstring m_recurrentOp;
     int m_axis;
+    // cuDNN algorithm: 'standard', 'persistent' (recurrent weights kept on chip; for small batches), or 'auto' (persistent
+    // where it fits). This is an execution choice and is not saved with the model.
+    wstring m_algorithm;
     bool IsSpatialRecurrence() const { return m_axis >= 0; }
 
-    RnnAttributes(bool bidirectional, size_t numLayers, size_t hiddenSize, const wstring& recurrentOp, int axis) :
-        m_bidirectional(bidirectional), m_numLayers(numLayers), m_hiddenSize(hiddenSize), m_recurrentOp(recurrentOp), m_axis(axis)
+    RnnAttributes(bool bidirectional, size_t numLayers, size_t hiddenSize, const wstring& recurrentOp, int axis, const wstring& algorithm = L"auto") :
+        m_bidirectional(bidirectional), m_numLayers(numLayers), m_hiddenSize(hiddenSize), m_recurrentOp(recurrentOp), m_axis(axis), m_algorithm(algorithm)
     {
         if (m_recurrentOp != wstring(L"lstm")    && m_recurrentOp != wstring(L"gru") &&
             m_recurrentOp != wstring(L"rnnReLU") && m_recurrentOp != wstring(L"rnnTanh"))
@@ -31,6 +34,9 @@ struct RnnAttributes
 
         if (m_axis != -1 && m_axis != 2)
             InvalidArgument("OptimizedRNNStack: invalid 'axis' parameter %d, currently supported values are -1 and 2.", m_axis);
+
+        if (m_algorithm != L"auto" && m_algorithm != L"standard" && m_algorithm != L"persistent")
+            InvalidArgument("OptimizedRNNStack: invalid 'algorithm' parameter '%ls', supported values are 'auto', 'standard', and 'persistent'.", m_algorithm.c_str());
     }
 
     // compute the total number of parameters, for inference of weight matrix size
@@ -62,7 +68,8 @@ struct RnnAttributes
             m_numLayers    == other.m_numLayers      &&
             m_hiddenSize   == other.m_hiddenSize     &&
             m_recurrentOp  == other.m_recurrentOp    &&
-            m_axis         == other.m_axis;
+            m_axis         == other.m_axis           &&
+            m_algorithm    == other.m_algorithm;
     }
 
     void Read(File& stream, bool readAxis)
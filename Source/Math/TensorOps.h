@@ -265,6 +265,352 @@ DefTernaryOp(ElementwiseProductWithExpOfDiff, a * exp_(b - c));
 
 
 #pragma pop_macro("DefTernaryOp")
+
+// evaluate a FusedElementwiseOp program for one element, given the values of its inputs
+template <class ElemType>
+DECL ElemType EvaluateFusedOp(const FusedElementwiseOp& program, ElemType a, ElemType b, ElemType c)
+{
+    ElemType values[FusedElementwiseOp::MaxInputs + FusedElementwiseOp::MaxSteps] = { a, b, c };
+#define CaseFusedUnaryOp(oper)   case ElementWiseOperator::op##oper: val = Op##oper(x); break
+#define CaseFusedBinaryOp(oper)  case ElementWiseOperator::op##oper: val = Op##oper(x, y); break
+#define CaseFusedTernaryOp(oper) case ElementWiseOperator::op##oper: val = Op##oper(x, y, z); break
+    for (int j = 0; j < program.numSteps; j++)
+    {
+        const auto& step = program.steps[j];
+        ElemType x = values[step.args[0]];
+        ElemType y = step.arity > 1 ? values[step.args[1]] : 0;
+        ElemType z = step.arity > 2 ? values[step.args[2]] : 0;
+        ElemType val = 0;
+        switch (step.op)
+        {
+            ForAllUnaryOps(CaseFusedUnaryOp);
+            ForAllBinaryOps(CaseFusedBinaryOp);
+            ForAllTernaryOps(CaseFusedTernaryOp);
+        default: break; // (failure--programs are only built from the op codes above)
+        }
+        values[FusedElementwiseOp::MaxInputs + j] = val;
+    }
+#undef CaseFusedUnaryOp
+#undef CaseFusedBinaryOp
+#undef CaseFusedTernaryOp
+    return values[FusedElementwiseOp::MaxInputs + program.numSteps - 1];
+}
+
+// -----------------------------------------------------------------------
+// per-element steps of the fused multi-tensor parameter update, see CPUMatrix::MultiTensorUpdate()
+// They replicate Matrix::NormalGrad(), Adagrad(), FSAdagradUpdate(), RmsProp(), and AdamUpdate() element by element,
+// and implement LARS and LAMB, which scale the learning rate of each tensor by a trust ratio.
+// -----------------------------------------------------------------------
+
+// proximal step of the L1 regularizer, see Matrix::InplaceSoftThreshold()
+template <class ElemType>
+DECL ElemType SoftThreshold(ElemType v, ElemType threshold)
+{
+    return v > threshold ? v - threshold : v < -threshold ? v + threshold : 0;
+}
+
+// Adam for one element, see Matrix::AdamUpdate(): smoothAda and smoothMom are the second and first moments,
+// biasCorrection is sqrt(1 - varMomentum^t) / (1 - momentum^t) at update t, decay is learning rate * decoupled weight decay (AdamW)
+template <class ElemType>
+DECL void AdamUpdateElement(ElemType& val, ElemType& smoothAda, ElemType& smoothMom, ElemType g, ElemType learnRate,
+                            ElemType momentum, ElemType varMomentum, ElemType biasCorrection, ElemType epsilon, ElemType decay)
+{
+    if (decay > 0)
+        val -= decay * val;
+    smoothAda = varMomentum * smoothAda + (1 - varMomentum) * g * g;
+    smoothMom = momentum * smoothMom + (1 - momentum) * g;
+    val -= learnRate * biasCorrection * smoothMom / (sqrt_(smoothAda) + epsilon);
+}
+
+// Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011), a counter-based generator:
+// the n-th number of the sequence of a key is a function of (key, n) only, so any element can be (re)generated on its own.
+// Writes the output block of the counter (n, draw, 0) to block[0..3].
+DECL void Philox4x32Block(uint64_t key, uint64_t n, uint32_t draw, uint32_t* block)
+{
+    uint32_t c0 = (uint32_t) n, c1 = (uint32_t) (n >> 32), c2 = draw, c3 = 0;
+    uint32_t k0 = (uint32_t) key, k1 = (uint32_t) (key >> 32);
+    for (int round = 0; round < 10; round++)
+    {
+        if (round > 0)
+        {
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+        uint64_t p0 = (uint64_t) 0xD2511F53 * c0;
+        uint64_t p1 = (uint64_t) 0xCD9E8D57 * c2;
+        uint32_t hi0 = (uint32_t) (p0 >> 32), lo0 = (uint32_t) p0;
+        uint32_t hi1 = (uint32_t) (p1 >> 32), lo1 = (uint32_t) p1;
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+    }
+    block[0] = c0;
+    block[1] = c1;
+    block[2] = c2;
+    block[3] = c3;
+}
+
+// the first 32-bit word of the output block of counter n
+DECL uint32_t Philox4x32(uint64_t key, uint64_t n)
+{
+    uint32_t block[4];
+    Philox4x32Block(key, n, 0, block);
+    return block[0];
+}
+
+// element of the dropout mask of a fused dropout, see Matrix::Dropout(): 0 with probability dropoutRate, else scale
+template <class ElemType>
+DECL ElemType DropoutMaskElement(ElemType dropoutRate, ElemType scale, uint64_t seed, uint64_t index)
+{
+    float u = (Philox4x32(seed, index) >> 8) * (1.0f / 16777216); // 24 bits, uniform in [0, 1)
+    return u < (float) dropoutRate ? 0 : scale;
+}
+
+// Counter-based parameter initialization, see Matrix::SetCounterBasedUniformRandomValue(): element i is a function
+// of (seed, i) only, and has the same bits on the CPU and the GPU. The transformation of the Philox output is done in
+// double precision with basic operations, which are correctly rounded on both, with products that must not fuse into
+// a multiply-add, and a logarithm of its own rather than the one of either math library.
+
+// a * b, rounded on its own
+DECL double CounterBasedMultiply(double a, double b)
+{
+#ifdef __CUDA_ARCH__
+    return __dmul_rn(a, b);
+#else
+    return a * b;
+#endif
+}
+
+// uniform in [0, 1) from the 53 high bits of two words; exact
+DECL double CounterBasedUnitValue(uint32_t high, uint32_t low)
+{
+    return (double) (((uint64_t) high << 21) | (low >> 11)) * (1.0 / 9007199254740992.0);
+}
+
+// log(x) for x > 0: x = m 2^e with m in [sqrt(1/2), sqrt(2)) by exact scaling, and log(m) = 2 atanh((m - 1) / (m + 1)),
+// whose series in t^2 < 0.03 converges to double precision within 12 terms
+DECL double CounterBasedLog(double x)
+{
+    int exponent = 0;
+    for (; x >= 1.4142135623730951; exponent++)
+        x *= 0.5;
+    for (; x < 0.70710678118654757; exponent--)
+        x *= 2;
+    double t = (x - 1) / (x + 1);
+    double t2 = CounterBasedMultiply(t, t);
+    double sum = 0;
+    for (int k = 23; k >= 1; k -= 2)
+        sum = CounterBasedMultiply(sum, t2) + 1.0 / k;
+    return CounterBasedMultiply(2 * t, sum) + CounterBasedMultiply(exponent, 0.69314718055994531);
+}
+
+// element i, uniform in [low, high)
+template <class ElemType>
+DECL ElemType CounterBasedUniformElement(ElemType low, ElemType high, uint64_t seed, uint64_t i)
+{
+    uint32_t block[4];
+    Philox4x32Block(seed, i, 0, block);
+    return (ElemType) ((double) low + CounterBasedMultiply((double) high - (double) low, CounterBasedUnitValue(block[0], block[1])));
+}
+
+// element i, Gaussian by Marsaglia's polar method; a rejected pair moves on to the next draw of the element
+template <class ElemType>
+DECL ElemType CounterBasedGaussianElement(ElemType mean, ElemType sigma, uint64_t seed, uint64_t i)
+{
+    for (uint32_t draw = 0;; draw++)
+    {
+        uint32_t block[4];
+        Philox4x32Block(seed, i, draw, block);
+        double v1 = 2 * CounterBasedUnitValue(block[0], block[1]) - 1;
+        double v2 = 2 * CounterBasedUnitValue(block[2], block[3]) - 1;
+        double s = CounterBasedMultiply(v1, v1) + CounterBasedMultiply(v2, v2);
+        if (s < 1 && s > 0)
+            return (ElemType) ((double) mean + CounterBasedMultiply((double) sigma, CounterBasedMultiply(v1, sqrt(-2 * CounterBasedLog(s) / s))));
+    }
+}
+
+// Weighted random sampling, see Matrix::AssignWeightedRandomSamples(). Draw i is uniform in [0, 1), from the counter (seed, i).
+DECL double WeightedSampleUnitValue(uint64_t seed, uint64_t i)
+{
+    uint32_t block[4];
+    Philox4x32Block(seed, i, 0, block);
+    return CounterBasedUnitValue(block[0], block[1]);
+}
+
+// the class of a draw with replacement: the first one whose prefix sum of the weights exceeds u * total, which is never
+// a class of weight 0 (unless all are)
+template <class ElemType>
+DECL size_t WeightedSampleClass(const ElemType* prefixSums, size_t numClasses, double u)
+{
+    double target = u * (double) prefixSums[numClasses - 1];
+    size_t begin = 0, end = numClasses - 1;
+    while (begin < end)
+    {
+        size_t mid = (begin + end) / 2;
+        if ((double) prefixSums[mid] > target)
+            end = mid;
+        else
+            begin = mid + 1;
+    }
+    return begin;
+}
+
+// the key of class i for a sample without replacement: the classes with the largest keys log(1 - u) / weight are distributed as
+// successive draws that skip the classes drawn already (Efraimidis and Spirakis, 2006), and come in the order of these draws;
+// a class of weight 0 gets -inf
+template <class ElemType>
+DECL ElemType WeightedSampleKey(ElemType weight, uint64_t seed, uint64_t i)
+{
+    if (weight <= 0)
+        return (ElemType) -INFINITY;
+    return (ElemType) (CounterBasedLog(1 - WeightedSampleUnitValue(seed, i)) / (double) weight);
+}
+
+// the expected number of draws with replacement that collect a sample without duplicates in the order of its draws:
+// with j classes of a total probability P_j collected, the next new one takes 1 / (1 - P_j) draws on average
+template <class ElemType>
+DECL double WeightedSampleNumTries(const ElemType* weights, double total, const ElemType* samples, size_t numSamples)
+{
+    double collected = 0, numTries = 0;
+    for (size_t j = 0; j < numSamples; j++)
+    {
+        numTries += 1 / (1 - collected);
+        collected += weights[(size_t) samples[j]] / total;
+    }
+    return numTries;
+}
+
+// the expected number of occurrences of a class in a sample: exact with duplicates, else the probability to be among
+// numTries draws with replacement
+template <class ElemType>
+DECL ElemType WeightedSampleInclusionFrequency(ElemType weight, double total, size_t numSamples, bool allowDuplicates, double numTries)
+{
+    double p = weight / total;
+    if (allowDuplicates)
+        return (ElemType) (p * numSamples);
+    return (ElemType) -expm1(numTries * log1p(-p));
+}
+
+// moves element i of the moving average of the value towards the updated value (Polyak averaging)
+template <class ElemType>
+DECL void MultiTensorAverageElement(const MultiTensorUpdateItem<ElemType>& t, size_t i)
+{
+    if (t.ema)
+        t.ema[i] += (1 - t.emaDecay) * (t.value[i] - t.ema[i]);
+}
+
+// First pass for element i of a tensor: clips the gradient, adds the L2 term, advances the state, and updates the value.
+// AdaGrad and RmsProp only normalize the gradient in place and return the multiplier, since the learning rate is
+// divided by the average multiplier of the tensor. Lamb likewise stores its step and returns its square, for the trust
+// ratio. They update the value in MultiTensorApplyElement().
+template <class ElemType>
+DECL ElemType MultiTensorUpdateElement(const MultiTensorUpdateParams<ElemType>& p, const MultiTensorUpdateItem<ElemType>& t, size_t i)
+{
+    ElemType g = t.gradient[i] * t.gradientScale;
+    if (p.gradientClipValue > 0)
+        g = g > p.gradientClipValue ? p.gradientClipValue : g < -p.gradientClipValue ? -p.gradientClipValue : g;
+    if (t.l2RegWeight > 0)
+        g += t.l2RegWeight * t.value[i];
+
+    switch (p.rule)
+    {
+    case MultiTensorUpdateRule::Momentum:
+    case MultiTensorUpdateRule::NesterovMomentum:
+    case MultiTensorUpdateRule::Lars:
+    {
+        ElemType learnRate = p.rule == MultiTensorUpdateRule::Lars ? t.learnRatePerSample * t.trustRatio : t.learnRatePerSample;
+        ElemType step = (1 - p.momentum) * learnRate * g;
+        ElemType smoothed = step + p.momentum * t.state[i];
+        t.state[i] = smoothed;
+        if (p.rule != MultiTensorUpdateRule::NesterovMomentum)
+            t.value[i] -= smoothed;
+        else // w_t = w_{t-1} - momentum * v_t - (1 - momentum) * learnRatePerSample * gradient
+            t.value[i] -= p.momentum * smoothed + step;
+        break;
+    }
+    case MultiTensorUpdateRule::AdaGrad:
+    {
+        ElemType* sqrSum = t.state;
+        sqrSum[i] += g * g;
+        ElemType denom = sqrt_(sqrSum[i] + (ElemType) 1e-16);
+        t.gradient[i] = g / denom;
+        return 1 / denom;
+    }
+    case MultiTensorUpdateRule::FSAdaGrad:
+    {
+        ElemType* smoothAda = t.state;
+        ElemType* smoothMom = t.state + t.n;
+        ElemType adaSqr = p.varMomentum * smoothAda[i] + (1 - p.varMomentum) * g * g;
+        smoothAda[i] = adaSqr;
+        if (adaSqr != 0)
+        {
+            ElemType w = t.adaMul / sqrt_(adaSqr);
+            g *= w > 10 ? 10 : w;
+        }
+        if (p.momentum > 0)
+        {
+            g = p.momentum * smoothMom[i] + (1 - p.momentum) * g;
+            smoothMom[i] = g;
+        }
+        t.value[i] -= t.learnRatePerSample * g;
+        break;
+    }
+    case MultiTensorUpdateRule::Adam:
+    {
+        AdamUpdateElement(t.value[i], t.state[i], t.state[t.n + i], g, t.learnRatePerSample, p.momentum, p.varMomentum, t.adaMul, p.adamEpsilon, t.decoupledDecay);
+        break;
+    }
+    case MultiTensorUpdateRule::Lamb:
+    {
+        // the Adam step plus the decoupled weight decay, applied with the trust ratio in the second pass
+        ElemType* smoothAda = t.state;
+        ElemType* smoothMom = t.state + t.n;
+        smoothAda[i] = p.varMomentum * smoothAda[i] + (1 - p.varMomentum) * g * g;
+        smoothMom[i] = p.momentum * smoothMom[i] + (1 - p.momentum) * g;
+        ElemType step = t.adaMul * smoothMom[i] / (sqrt_(smoothAda[i]) + p.adamEpsilon) + t.decoupledDecay * t.value[i];
+        t.gradient[i] = step;
+        return step * step;
+    }
+    case MultiTensorUpdateRule::RmsProp:
+    {
+        ElemType* avars = t.state;           // accumulated variances for RMS scaling
+        ElemType* signs = t.state + t.n;     // sign of previous gradient
+        ElemType* steps = t.state + 2 * t.n; // current step size
+        if (t.initializeState)
+        {
+            avars[i] = g * g;
+            signs[i] = 0;
+            steps[i] = (ElemType) 0.02;
+        }
+        avars[i] = p.rmsGamma * avars[i] + (1 - p.rmsGamma) * (g * g);
+        const int gradSign = (ElemType(0) < g) - (g < ElemType(0));
+        if (signs[i] * gradSign > 0)
+            steps[i] = steps[i] * p.rmsWgtInc < p.rmsWgtMax ? steps[i] * p.rmsWgtInc : p.rmsWgtMax;
+        else
+            steps[i] = steps[i] * p.rmsWgtDec > p.rmsWgtMin ? steps[i] * p.rmsWgtDec : p.rmsWgtMin;
+        ElemType multiplier = steps[i] / sqrt_(avars[i] + (ElemType) 1e-6);
+        t.gradient[i] = g * multiplier;
+        signs[i] = (ElemType) gradSign;
+        return multiplier;
+    }
+    }
+
+    if (t.l1Threshold > 0)
+        t.value[i] = SoftThreshold(t.value[i], t.l1Threshold);
+    MultiTensorAverageElement(t, i);
+    return 1;
+}
+
+// second pass of AdaGrad, RmsProp, and Lamb for element i: applies the normalized gradient with the learning rate divided by the average multiplier
+template <class ElemType>
+DECL void MultiTensorApplyElement(const MultiTensorUpdateItem<ElemType>& t, ElemType learnRate, size_t i)
+{
+    t.value[i] -= learnRate * t.gradient[i];
+    if (t.l1Threshold > 0)
+        t.value[i] = SoftThreshold(t.value[i], t.l1Threshold);
+    MultiTensorAverageElement(t, i);
+}
 }}}
 #pragma pop_macro("DECL")
 #pragma pop_macro("TENSOR_OPS_DECL")
@@ -285,6 +285,20 @@ void TensorView<ElemType>::DoTernaryOpOf(ElemType beta, const TensorView& a, con
     GetSOB().TensorOp(beta, a.GetSOB(), b.GetSOB(), c.GetSOB(), alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
+template <class ElemType>
+void TensorView<ElemType>::DoFusedOpOf(ElemType beta, const TensorView& a, const TensorView& b, const TensorView& c, ElemType alpha, const FusedElementwiseOp& program)
+{
+    array<size_t, 4> offsets;
+    array<SmallVector<ptrdiff_t>, 4> regularStrides, reducingStrides;
+    SmallVector<size_t> regularOpDims, reducingOpDims;
+    PrepareTensorOperands<ElemType, 4>(array<TensorShape, 4>{a.GetShape(), b.GetShape(), c.GetShape(), GetShape()}, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    if (reducingOpDims.size() > 0)
+        LogicError("DoFusedOpOf: Fused element-wise operations cannot reduce, but the output [%s] is smaller than an input.", string(GetShape()).c_str());
+
+    GetSOB().FusedTensorOp(beta, a.GetSOB(), b.GetSOB(), c.GetSOB(), alpha, program, offsets, regularOpDims, regularStrides);
+}
+
 // -------------------------------------------------------------------
 // matrix product -- GEMM for flattened tensors
 // -------------------------------------------------------------------
@@ -388,6 +402,64 @@ void TensorView<ElemType>::DoMatrixProductOf(ElemType beta, bool transC, const T
         Matrix<ElemType>::MultiplyAndWeightedAdd(alpha, *B, !transB, *A, !transA, beta, *C, pQuantizedMultiplier);
 }
 
+// split off the trailing batch axis of a tensor for DoBatchedMatrixProductOf()
+// Returns the shape of one item and the tensor as a matrix with one item per column.
+template <class ElemType>
+static shared_ptr<Matrix<ElemType>> AsBatchOfColumns(const TensorView<ElemType>& tensor, TensorShape& itemShape)
+{
+    auto shape = tensor.GetShape();
+    let rank = shape.GetRank();
+    if (rank < 2)
+        InvalidArgument("DoBatchedMatrixProductOf: Tensor [%s] has no batch axis.", string(shape).c_str());
+    SmallVector<bool> batchAxis(rank, false);
+    batchAxis[rank - 1] = true;
+    itemShape = shape.DropDims(batchAxis);
+    shape.FlattenTo2DInPlace(rank - 1, "DoBatchedMatrixProductOf");
+    return tensor.Reshaped(shape).AsMatrix();
+}
+
+template <class ElemType>
+void TensorView<ElemType>::DoBatchedMatrixProductOf(ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha)
+{
+    TensorShape shapeA, shapeB, shapeC;
+    let A = AsBatchOfColumns(a, shapeA);
+    let B = AsBatchOfColumns(b, shapeB);
+    auto C = AsBatchOfColumns(*this, shapeC);
+    let batchCount = C->GetNumCols();
+    if ((A->GetNumCols() != batchCount && A->GetNumCols() != 1) || (B->GetNumCols() != batchCount && B->GetNumCols() != 1))
+        InvalidArgument("DoBatchedMatrixProductOf: Batch dimensions of [%s], [%s] and [%s] mismatch.", string(a.GetShape()).c_str(), string(b.GetShape()).c_str(), string(m_shape).c_str());
+
+    // determine integration dimension offset and flatten each item, like DoMatrixProductOf()
+    if (shapeA.GetRank() + shapeB.GetRank() < shapeC.GetRank())
+        InvalidArgument("DoBatchedMatrixProductOf: Ranks %s don't match, output must have a non-reduced output dimension.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, transC).c_str());
+    let removedDims = shapeA.GetRank() + shapeB.GetRank() - shapeC.GetRank();
+    let numReducedDims = removedDims / 2;
+    if (numReducedDims * 2 != removedDims)
+        InvalidArgument("DoBatchedMatrixProductOf: Ranks %s mismatch.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, transC).c_str());
+    let firstReducedDim = shapeA.GetRank() - numReducedDims;
+    FlattenToMatrix(shapeA, transA, firstReducedDim);
+    FlattenToMatrix(shapeB, transB, numReducedDims);
+    FlattenToMatrix(shapeC, transC, firstReducedDim);
+    if (shapeA[transA]   != shapeC[transC]   || // output dim
+        shapeB[1-transB] != shapeC[1-transC] || // input dim
+        shapeA[1-transA] != shapeB[transB])     // reduction dim
+    {
+        InvalidArgument("DoBatchedMatrixProductOf: Flattened tensor dimensions %s mismatch.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, transC).c_str());
+    }
+
+    // items with a batch dimension of 1 are shared by the whole batch
+    let strideA = A->GetNumCols() == 1 ? 0 : A->GetNumRows();
+    let strideB = B->GetNumCols() == 1 ? 0 : B->GetNumRows();
+    let strideC = C->GetNumRows();
+    let m = shapeA[transA];
+    let k = shapeA[1-transA];
+    let n = shapeB[1-transB];
+    if (!transC)
+        Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, *A, transA, strideA, *B, transB, strideB, beta, *C, strideC, m, n, k, batchCount);
+    else // C' = A * B  <==>  C = (A * B)' = B' * A'
+        Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, *B, !transB, strideB, *A, !transA, strideA, beta, *C, strideC, n, m, k, batchCount);
+}
+
 template class TensorView<float>;
 template class TensorView<double>;
 
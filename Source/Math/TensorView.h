@@ -134,6 +134,11 @@ public:
     void DoBinaryOpOf (ElemType beta, const TensorView& a, const TensorView& b,                      ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp);
     void DoTernaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, const TensorView& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp);
 
+    // fused chain of element-wise operations, see FusedElementwiseOp
+    // Inputs that the program does not use may be passed as any of the others. Reductions are not supported.
+    void DoFusedOpOf    (ElemType beta, const TensorView& a, const TensorView& b, const TensorView& c, ElemType alpha, const FusedElementwiseOp& program);
+    void AssignFusedOpOf(               const TensorView& a, const TensorView& b, const TensorView& c, const FusedElementwiseOp& program) { DoFusedOpOf(0, a, b, c, 1.0f, program); }
+
     // -------------------------------------------------------------------
     // matrix product -- GEMM for flattened tensors
     // Result goes into 'this', and can optionally be added to the existing value.
@@ -148,6 +153,15 @@ public:
     void AssignMatrixProductOf(           bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier = nullptr) { DoMatrixProductOf(0, transC, a, transA, b, transB, alpha, pQuantizedMultiplier); }
     void AddMatrixProductOf   (           bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f) { DoMatrixProductOf(1.0f, transC, a, transA, b, transB, alpha); }
 
+    // batch of matrix products, one GEMM call for all of them
+    // The last dimension of each tensor is the batch axis; the others are treated like the whole tensors in DoMatrixProductOf().
+    // a and b may have a batch dimension of 1, in which case they are used for all items of the batch.
+    // E.g. [I x K x N] * [K x J x N] -> [I x J x N], or [I x K x N] * [K x J x 1] -> [I x J x N].
+    // Each tensor must be dense, including the batch axis.
+    void DoBatchedMatrixProductOf(ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha);
+    void AssignBatchedMatrixProductOf(           bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f) { DoBatchedMatrixProductOf(0,    transC, a, transA, b, transB, alpha); }
+    void AddBatchedMatrixProductOf   (           bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f) { DoBatchedMatrixProductOf(1.0f, transC, a, transA, b, transB, alpha); }
+
     shared_ptr<Matrix<ElemType>> AsMatrix() const;
     const TensorShape& GetShape() const { return m_shape; }
 
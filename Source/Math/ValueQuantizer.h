@@ -155,6 +155,13 @@ public:
         }
     }
 
+    // the value from which on Quantize1() returns true
+    template <bool ZeroThresholdFor1Bit>
+    cudasharedcode ElemType Threshold1() const
+    {
+        return ZeroThresholdFor1Bit ? (ElemType) 0.0 : quantimid;
+    }
+
     // unquantize one value  --special case for 1 bit
     static cudasharedcode ElemType Unquantize1(bool u, ElemType val0, ElemType val1)
     {
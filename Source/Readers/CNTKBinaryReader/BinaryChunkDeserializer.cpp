@@ -16,38 +16,69 @@ enum class DeserializerType : int32_t
     DenseBinaryDataDeserializer = 0,
     SparseBinaryDataDeserializer = 1
 };
-void BinaryChunkDeserializer::ReadOffsetsTable(FILE* infile)
+
+// A remote file is parsed from a local copy of its beginning, which holds the header unless there are very many inputs.
+static const size_t s_remoteHeaderSize = 1024 * 1024;
+
+void BinaryChunkDeserializer::ReadOffsetsTable()
 {
-    ReadOffsetsTable(infile, 0, m_numChunks);
+    ReadOffsetsTable(0, m_numChunks);
 }
 
-void BinaryChunkDeserializer::ReadOffsetsTable(FILE* infile, size_t startOffset, size_t numChunks)
+size_t BinaryChunkDeserializer::GetOffsetsTableEntrySize() const
 {
-    assert((int64_t)(startOffset + numChunks) <= m_numChunks);
-    size_t startPos = startOffset * sizeof(DiskOffsetsTable) + m_offsetStart;
+    return (m_versionNumber == 1) ? sizeof(DiskOffsetsTable) : sizeof(DiskOffsetsTableV2);
+}
 
-    // Seek to the offsets table start
-    CNTKBinaryFileHelper::seekOrDie(infile, startPos, SEEK_SET);
+void BinaryChunkDeserializer::ReadOffsetsTable(size_t startOffset, size_t numChunks)
+{
+    assert((int64_t)(startOffset + numChunks) <= m_numChunks);
+    size_t startPos = startOffset * GetOffsetsTableEntrySize() + m_offsetStart;
 
     // Note we create numChunks + 1 since we want to be consistent with determining the size of each chunk.
-    DiskOffsetsTable* offsetsTable = new DiskOffsetsTable[numChunks + 1];
+    std::vector<DiskOffsetsTableV2> offsetsTable(numChunks + 1);
+
+    // Now read the final entry as well if it exists (i.e., we're reading a subset of the table).
+    bool isLast = (int64_t)(startOffset + numChunks) == m_numChunks;
+    size_t numEntries = isLast ? numChunks : numChunks + 1;
+    shared_ptr<char> entries = m_source->Read(startPos, numEntries * GetOffsetsTableEntrySize());
 
     // Read in all of the offsets for the chunks of interest
-    CNTKBinaryFileHelper::readOrDie(offsetsTable, sizeof(DiskOffsetsTable), numChunks, infile);
+    if (m_versionNumber == 1)
+    {
+        // Version 1 chunks are not compressed.
+        std::vector<DiskOffsetsTable> diskOffsetsTable(numEntries);
+        memcpy(diskOffsetsTable.data(), entries.get(), numEntries * sizeof(DiskOffsetsTable));
+        for (size_t c = 0; c < numEntries; c++)
+        {
+            offsetsTable[c].offset = diskOffsetsTable[c].offset;
+            offsetsTable[c].numSequences = diskOffsetsTable[c].numSequences;
+            offsetsTable[c].numSamples = diskOffsetsTable[c].numSamples;
+            offsetsTable[c].codec = ChunkCodec::None;
+        }
+    }
+    else
+        memcpy(offsetsTable.data(), entries.get(), numEntries * sizeof(DiskOffsetsTableV2));
 
-    // Now read the final entry. It is either the next offset entry (if we're reading a subset and the
-    // entry exists), or we just fill it with the correct information based on file size if it doesn't
-    if ((int64_t)(startOffset + numChunks) == m_numChunks)
+    // If the final entry doesn't exist, we just fill it with the correct information based on file size.
+    if (isLast)
     {
-        CNTKBinaryFileHelper::seekOrDie(infile, 0, SEEK_END);
-        offsetsTable[numChunks].offset = CNTKBinaryFileHelper::tellOrDie(infile) - m_dataStart;
+        offsetsTable[numChunks].offset = (int64_t)m_source->GetSize() - m_dataStart;
         offsetsTable[numChunks].numSamples = 0;
         offsetsTable[numChunks].numSequences = 0;
+        offsetsTable[numChunks].codec = ChunkCodec::None;
+        offsetsTable[numChunks].uncompressedSize = 0;
     }
-    else
-        CNTKBinaryFileHelper::readOrDie(offsetsTable + numChunks, sizeof(DiskOffsetsTable), 1, infile);
 
-    m_offsetsTable = make_unique<OffsetsTable>(numChunks, offsetsTable);
+    for (size_t c = 0; c < numChunks; c++)
+    {
+        if (m_versionNumber == 1)
+            offsetsTable[c].uncompressedSize = offsetsTable[c + 1].offset - offsetsTable[c].offset;
+        else if (!IsChunkCodecSupported(offsetsTable[c].codec))
+            RuntimeError("Chunk %d of '%ls' uses codec %d, which is not supported by this build.", (int)(startOffset + c), m_filename.c_str(), (int)offsetsTable[c].codec);
+    }
+
+    m_offsetsTable = make_unique<OffsetsTable>(numChunks, std::move(offsetsTable));
 
 }
 
@@ -55,6 +86,7 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const BinaryConfigHelper& helpe
     BinaryChunkDeserializer(helper.GetFilePath())
 {
     SetTraceLevel(helper.GetTraceLevel());
+    m_dataSourceOptions = helper.GetDataSourceOptions();
 
     Initialize(helper.GetRename());
 }
@@ -80,7 +112,9 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     if (m_file)
         CNTKBinaryFileHelper::closeOrDie(m_file);
 
-    m_file = CNTKBinaryFileHelper::openOrDie(m_filename, L"rb");
+    // The offsets table and the chunks are read through the async I/O service, or with range requests for a remote file.
+    m_source = CreateDataSource(m_filename, m_dataSourceOptions);
+    m_file = OpenHeader();
 
     // We are now parsing the header. Seek to the head of the header to start.
     CNTKBinaryFileHelper::seekOrDie(m_file, 0, SEEK_SET);
@@ -88,8 +122,9 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     // First read the version number of the data file, and make sure the reader version is the same.
     int64_t versionNumber;
     CNTKBinaryFileHelper::readOrDie(&versionNumber, sizeof(versionNumber), 1, m_file);
-    if (versionNumber != m_versionNumber)
-        LogicError("The reader version is %d, but the data file was created for version %d.", (int)m_versionNumber, (int)versionNumber);
+    if (versionNumber < 1 || versionNumber > s_maxVersionNumber)
+        LogicError("The reader supports versions up to %d, but the data file was created for version %d.", (int)s_maxVersionNumber, (int)versionNumber);
+    m_versionNumber = versionNumber;
 
     // Next is the number of chunks in the input file.
     CNTKBinaryFileHelper::readOrDie(&m_numChunks, sizeof(m_numChunks), 1, m_file);
@@ -144,12 +179,31 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     m_offsetStart = CNTKBinaryFileHelper::tellOrDie(m_file);
 
     // After the header is the data start. Compute that now.
-    m_dataStart = m_offsetStart + m_numChunks * sizeof(DiskOffsetsTable);
+    m_dataStart = m_offsetStart + m_numChunks * GetOffsetsTableEntrySize();
 
     // We only have to read in the offsets table once, so do that now.
     // Note it's possible in distributed reading mode to only want to read
     // a subset of the offsets table.
-    ReadOffsetsTable(m_file);
+    ReadOffsetsTable();
+}
+
+FILE* BinaryChunkDeserializer::OpenHeader()
+{
+    if (!m_source->IsRemote())
+        return CNTKBinaryFileHelper::openOrDie(m_filename, L"rb");
+
+    size_t size = (size_t)std::min<uint64_t>(m_source->GetSize(), s_remoteHeaderSize);
+    shared_ptr<char> header = m_source->Read(0, size);
+
+    FILE* file = tmpfile();
+    if (!file)
+        RuntimeError("Cannot create a temporary file for the header of '%ls'.", m_filename.c_str());
+    if (fwrite(header.get(), 1, size, file) != size)
+    {
+        fclose(file);
+        RuntimeError("Cannot write the header of '%ls' to a temporary file.", m_filename.c_str());
+    }
+    return file;
 }
 
 ChunkDescriptions BinaryChunkDeserializer::GetChunkDescriptions()
@@ -210,28 +264,41 @@ void BinaryChunkDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vec
     }
 }
 
-unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
+shared_ptr<byte> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 {
-    // Seek to the start of the chunk
-    CNTKBinaryFileHelper::seekOrDie(m_file, m_dataStart + m_offsetsTable->GetOffset(chunkId), SEEK_SET);
-
     // Determine how big the chunk is.
     size_t chunkSize = m_offsetsTable->GetChunkSize(chunkId);
-    
-    // Create buffer
-    unique_ptr<byte[]> buffer(new byte[chunkSize]);
 
-    // Read the chunk from disk
-    CNTKBinaryFileHelper::readOrDie(buffer.get(), sizeof(byte), chunkSize, m_file);
+    // Read the chunk from disk, the blocks of it all at once.
+    shared_ptr<char> data = m_source->Read(m_dataStart + m_offsetsTable->GetOffset(chunkId), chunkSize);
+    shared_ptr<byte> buffer(data, reinterpret_cast<byte*>(data.get()));
 
-    return buffer;
+    ChunkCodec codec = m_offsetsTable->GetCodec(chunkId);
+    if (codec == ChunkCodec::None)
+        return buffer;
+
+    size_t uncompressedSize = m_offsetsTable->GetUncompressedChunkSize(chunkId);
+    shared_ptr<byte> uncompressed(new byte[uncompressedSize], default_delete<byte[]>());
+    DecompressChunk(codec, reinterpret_cast<const char*>(buffer.get()), chunkSize, reinterpret_cast<char*>(uncompressed.get()), uncompressedSize);
+    return uncompressed;
 }
 
+void BinaryChunkDeserializer::FetchAhead(const std::vector<ChunkIdType>& chunkIds)
+{
+    if (!m_source->IsRemote())
+        return;
+
+    std::vector<std::pair<uint64_t, size_t>> ranges;
+    ranges.reserve(chunkIds.size());
+    for (ChunkIdType chunkId : chunkIds)
+        ranges.push_back(std::make_pair((uint64_t)(m_dataStart + m_offsetsTable->GetOffset(chunkId)), m_offsetsTable->GetChunkSize(chunkId)));
+    m_source->FetchAhead(ranges);
+}
 
 ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
 {
     // Read the chunk into memory
-    unique_ptr<byte[]> chunkBuffer = ReadChunk(chunkId);
+    shared_ptr<byte> chunkBuffer = ReadChunk(chunkId);
 
     return make_shared<BinaryDataChunk>(chunkId, m_offsetsTable->GetStartIndex(chunkId), m_offsetsTable->GetNumSequences(chunkId), std::move(chunkBuffer), m_deserializers);
 }
@@ -10,6 +10,8 @@
 #include "CorpusDescriptor.h"
 #include "BinaryDataChunk.h"
 #include "BinaryDataDeserializer.h"
+#include "ChunkCodec.h"
+#include "DataSource.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,23 +23,35 @@ struct DiskOffsetsTable
     int32_t numSequences;
     int32_t numSamples;
 };
+
+// Offsets table entry of version 2 of the format, which also records how the chunk payload is encoded.
+struct DiskOffsetsTableV2
+{
+    int64_t offset;
+    int32_t numSequences;
+    int32_t numSamples;
+    ChunkCodec codec;
+    int64_t uncompressedSize;
+};
 #pragma pack(pop)
 
     // Offsets table used to find the chunks in the binary file. Added some helper methods around the core data.
+    // Entries of all format versions are kept as DiskOffsetsTableV2.
 class OffsetsTable {
 public:
 
-    OffsetsTable(size_t numChunks, DiskOffsetsTable* offsetsTable) : m_numChunks(numChunks)
+    OffsetsTable(size_t numChunks, std::vector<DiskOffsetsTableV2>&& offsetsTable) : m_numChunks(numChunks), m_diskOffsetsTable(std::move(offsetsTable))
     {
-        m_diskOffsetsTable = make_unique<DiskOffsetsTable*>(offsetsTable);
         Initialize();
     }
 
-    int64_t GetOffset(size_t index) { return (*m_diskOffsetsTable)[index].offset; }
-    int32_t GetNumSequences(size_t index) { return (*m_diskOffsetsTable)[index].numSequences; }
-    int32_t GetNumSamples(size_t index) { return (*m_diskOffsetsTable)[index].numSamples; }
+    int64_t GetOffset(size_t index) { return m_diskOffsetsTable[index].offset; }
+    int32_t GetNumSequences(size_t index) { return m_diskOffsetsTable[index].numSequences; }
+    int32_t GetNumSamples(size_t index) { return m_diskOffsetsTable[index].numSamples; }
     int64_t GetStartIndex(size_t index) { return m_startIndex[index]; }
-    size_t GetChunkSize(size_t index) { return (*m_diskOffsetsTable)[index + 1].offset - (*m_diskOffsetsTable)[index].offset; }
+    size_t GetChunkSize(size_t index) { return m_diskOffsetsTable[index + 1].offset - m_diskOffsetsTable[index].offset; }
+    ChunkCodec GetCodec(size_t index) { return m_diskOffsetsTable[index].codec; }
+    size_t GetUncompressedChunkSize(size_t index) { return m_diskOffsetsTable[index].uncompressedSize; }
 
 private:
     void Initialize()
@@ -45,12 +59,12 @@ private:
         m_startIndex.resize(m_numChunks);
         m_startIndex[0] = 0;
         for (int64_t c = 1; c < m_numChunks; c++)
-            m_startIndex[c] = m_startIndex[c-1] + (*m_diskOffsetsTable)[c].numSequences;
+            m_startIndex[c] = m_startIndex[c-1] + m_diskOffsetsTable[c].numSequences;
     }
 
 private:
     int64_t m_numChunks;
-    unique_ptr<DiskOffsetsTable*> m_diskOffsetsTable;
+    std::vector<DiskOffsetsTableV2> m_diskOffsetsTable;
     vector<size_t> m_startIndex;
 };
 
@@ -74,19 +88,34 @@ public:
     // Get information about particular chunk.
     void GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result) override;
 
+    // Reads of different chunks are outstanding at once, chunks are decompressed on the loading threads.
+    bool SupportsConcurrentChunkLoads() const override
+    {
+        return true;
+    }
+
+    // Starts fetching the given chunks if the file is remote.
+    void FetchAhead(const std::vector<ChunkIdType>& chunkIds) override;
+
     // Parses buffer into a BinaryChunkPtr
-    void ParseChunk(ChunkIdType chunkId, unique_ptr<byte[]> const& buffer, std::vector<std::vector<SequenceDataPtr>>& data);
+    void ParseChunk(ChunkIdType chunkId, shared_ptr<byte> const& buffer, std::vector<std::vector<SequenceDataPtr>>& data);
 
 private:
     // Builds an index of the input data.
     void Initialize(const std::map<std::wstring, std::wstring>& rename);
 
     // Reads the offsets table from disk into memory
-    void ReadOffsetsTable(FILE* infile, size_t startOffset, size_t numChunks);
-    void ReadOffsetsTable(FILE* infile);
+    void ReadOffsetsTable(size_t startOffset, size_t numChunks);
+    void ReadOffsetsTable();
+
+    // Opens the file for parsing the header; for a remote file, a local copy of its beginning.
+    FILE* OpenHeader();
+
+    // Reads a chunk from disk into buffer, decompressing it if necessary.
+    shared_ptr<byte> ReadChunk(ChunkIdType chunkId);
 
-    // Reads a chunk from disk into buffer
-    unique_ptr<byte[]> ReadChunk(ChunkIdType chunkId);
+    // Size of an offsets table entry of the file version.
+    size_t GetOffsetsTableEntrySize() const;
 
     BinaryChunkDeserializer(const wstring& filename);
 
@@ -94,7 +123,9 @@ private:
 
 private:
     const wstring m_filename;
-    FILE* m_file;
+    FILE* m_file; // for the header
+    DataSourceOptions m_dataSourceOptions;
+    DataSourcePtr m_source; // the offsets table and the chunks are read through it
 
     int64_t m_offsetStart;
     int64_t m_dataStart;
@@ -104,6 +135,8 @@ private:
     OffsetsTablePtr m_offsetsTable;
     void* m_chunkBuffer;
 
+    // Version 1: uncompressed chunks; version 2: the offsets table records a codec per chunk.
+    static const int64_t s_maxVersionNumber = 2;
     int64_t m_versionNumber = 1;
     int64_t m_numChunks;
     int32_t m_numInputs;
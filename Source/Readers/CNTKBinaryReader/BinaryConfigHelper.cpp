@@ -68,6 +68,19 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             m_randomizationWindow = randomizeNone;
 
         m_traceLevel = config(L"traceLevel", 1);
+
+        // Number of chunks loaded (and decompressed) in parallel by the randomizer.
+        m_chunkLoadParallelism = config(L"chunkLoadParallelism", (size_t)1);
+
+        // Chunks are read through the async I/O service of the ReaderLib, in blocks of which this many are outstanding at once.
+        m_dataSourceOptions.m_directIO = config(L"directIO", false);
+        m_dataSourceOptions.m_queueDepth = config(L"ioQueueDepth", (size_t)0);
+
+        // The file may also be an http(s):// or s3:// URL, read with parallel range requests; fetched blocks are kept
+        // in the cache directory, if any, for the following epochs and for other jobs on the machine.
+        m_dataSourceOptions.m_cacheDirectory = static_cast<const wstring&>(config(L"dataCacheDirectory", L""));
+        m_dataSourceOptions.m_fetchCommand = msra::strfun::utf8(static_cast<const wstring&>(config(L"remoteFetchCommand", L"")));
+        m_dataSourceOptions.m_sizeCommand = msra::strfun::utf8(static_cast<const wstring&>(config(L"remoteSizeCommand", L"")));
     }
 
 }}}
@@ -10,6 +10,7 @@
 #include <map>
 #include "Config.h"
 #include "Reader.h"
+#include "DataSource.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -34,6 +35,11 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    size_t GetChunkLoadParallelism() const { return m_chunkLoadParallelism; }
+
+    // How the input file is read: direct I/O and queue depth, and for remote files the cache and the fetch commands.
+    const DataSourceOptions& GetDataSourceOptions() const { return m_dataSourceOptions; }
+
     DISABLE_COPY_AND_MOVE(BinaryConfigHelper);
 
 private:
@@ -43,6 +49,8 @@ private:
     bool m_randomize;
     unsigned int m_traceLevel;
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    size_t m_chunkLoadParallelism;
+    DataSourceOptions m_dataSourceOptions;
 };
 
 } } }
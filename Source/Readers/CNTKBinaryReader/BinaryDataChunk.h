@@ -15,7 +15,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 class BinaryDataChunk : public Chunk, public std::enable_shared_from_this<Chunk>
 {
 public:
-    explicit BinaryDataChunk(ChunkIdType chunkId, size_t startSequence, size_t numSequences, unique_ptr<byte[]> buffer, std::vector<BinaryDataDeserializerPtr> deserializer)
+    explicit BinaryDataChunk(ChunkIdType chunkId, size_t startSequence, size_t numSequences, shared_ptr<byte> buffer, std::vector<BinaryDataDeserializerPtr> deserializer)
         : m_chunkId(chunkId), m_startSequence(startSequence), m_numSequences(numSequences), m_buffer(std::move(buffer)), m_deserializers(deserializer)
     {
     }
@@ -64,7 +64,7 @@ protected:
     size_t m_numSequences;
 
     // This is the actual chunk read from disk. We will call back to the deserializer for it to be deserialized
-    unique_ptr<byte[]> m_buffer;
+    shared_ptr<byte> m_buffer;
 
     // This is the deserializer who knows how to interpret the m_data chunk that we read in
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
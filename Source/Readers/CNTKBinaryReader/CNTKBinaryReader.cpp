@@ -47,7 +47,8 @@ CNTKBinaryReader::CNTKBinaryReader(const ConfigParameters& config)
                 m_deserializer, /* deserializer */
                 true, /* shouldPrefetch */
                 false, /* useLegacyRandomization */
-                false /* multithreadedGetNextSequences */
+                false, /* multithreadedGetNextSequences */
+                configHelper.GetChunkLoadParallelism() /* maxParallelChunkLoads */
                 );
         }
         else
@@ -10,6 +10,7 @@
 #include "DataReader.h"
 #include "ReaderShim.h"
 #include "CNTKTextFormatReader.h"
+#include "TextToBinaryConverter.h"
 #include "HeapMemoryProvider.h"
 #include "StringUtil.h"
 
@@ -57,5 +58,20 @@ extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializ
     return true;
 }
 
+// TODO: Not safe from the ABI perspective.
+// Converts the CTF input described by the reader config into the CNTKBinaryReader format.
+// compression is either "none" or "deflate".
+extern "C" DATAREADER_API void ConvertToBinary(const ConfigParameters& readerConfig, const std::wstring& outputFile, size_t numThreads, const std::wstring& compression)
+{
+    ChunkCodec codec = ChunkCodecFromName(compression);
+    string precision = readerConfig.Find("precision", "float");
+    if (AreEqualIgnoreCase(precision, "float"))
+        TextToBinaryConverter<float>(readerConfig, outputFile, numThreads, codec).Convert();
+    else if (AreEqualIgnoreCase(precision, "double"))
+        TextToBinaryConverter<double>(readerConfig, outputFile, numThreads, codec).Convert();
+    else
+        InvalidArgument("Unsupported precision '%s'", precision.c_str());
+}
+
 
 }}}
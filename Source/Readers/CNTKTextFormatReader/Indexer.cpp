@@ -8,6 +8,8 @@
 #include <inttypes.h>
 #include "Indexer.h"
 #include "TextReaderConstants.h"
+#include <sys/stat.h>
+#include <sys/types.h>
 
 using std::string;
 
@@ -15,6 +17,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 Indexer::Indexer(FILE* file, bool isPrimary, bool skipSequenceIds, size_t chunkSize) :
     m_file(file),
+    m_data(nullptr),
+    m_dataSize(0),
     m_fileOffsetStart(0),
     m_fileOffsetEnd(0),
     m_buffer(new char[BUFFER_SIZE + 1]),
@@ -31,9 +35,40 @@ Indexer::Indexer(FILE* file, bool isPrimary, bool skipSequenceIds, size_t chunkS
     }
 }
 
+Indexer::Indexer(const char* data, size_t size, bool isPrimary, bool skipSequenceIds, size_t chunkSize) :
+    m_file(nullptr),
+    m_data(data),
+    m_dataSize(size),
+    m_fileOffsetStart(0),
+    m_fileOffsetEnd(0),
+    m_bufferStart(nullptr),
+    m_bufferEnd(nullptr),
+    m_pos(nullptr),
+    m_done(false),
+    m_hasSequenceIds(!skipSequenceIds),
+    m_index(chunkSize, isPrimary)
+{
+}
+
 void Indexer::RefillBuffer()
 {
-    if (!m_done)
+    if (!m_done && m_file == nullptr)
+    {
+        // The whole mapped region is the buffer, the second refill means EOF.
+        if (m_fileOffsetEnd == (int64_t)m_dataSize)
+        {
+            m_done = true;
+        }
+        else
+        {
+            m_fileOffsetStart = 0;
+            m_fileOffsetEnd = m_dataSize;
+            m_bufferStart = m_data;
+            m_pos = m_bufferStart;
+            m_bufferEnd = m_bufferStart + m_dataSize;
+        }
+    }
+    else if (!m_done)
     {
         size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
         if (bytesRead == (size_t)-1)
@@ -98,7 +133,7 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
         return;
     }
 
-    m_index.Reserve(filesize(m_file));
+    m_index.Reserve(m_file ? filesize(m_file) : m_dataSize);
 
     RefillBuffer(); // read the first block of data
     if (m_done)
@@ -215,4 +250,154 @@ bool Indexer::TryGetSequenceId(size_t& id)
     return false;
 }
 
+// Layout of the index cache file:
+//   header, followed by header.m_numSequences records (one per sequence in the file order).
+namespace
+{
+    const char c_indexCacheMagic[8] = { 'C', 'T', 'F', 'I', 'N', 'D', 'E', 'X' };
+    const uint32_t c_indexCacheVersion = 1;
+
+#pragma pack(push, 1)
+    struct IndexCacheHeader
+    {
+        char m_magic[8];
+        uint32_t m_version;
+        uint64_t m_fileSize;
+        int64_t m_modificationTime;
+        uint8_t m_skipSequenceIds;
+        uint8_t m_hasSequenceIds;
+        uint64_t m_numSequences;
+    };
+
+    struct IndexCacheRecord
+    {
+        uint64_t m_key;
+        uint32_t m_numberOfSamples;
+        int64_t m_fileOffsetBytes;
+        uint64_t m_byteSize;
+    };
+#pragma pack(pop)
+
+    FILE* OpenCacheFile(const std::wstring& path, bool write)
+    {
+#ifdef _WIN32
+        return _wfopen(path.c_str(), write ? L"wb" : L"rb");
+#else
+        return fopen(msra::strfun::utf8(path).c_str(), write ? "wb" : "rb");
+#endif
+    }
+}
+
+/*static*/ bool Indexer::TryGetCacheKey(const std::wstring& filename, bool skipSequenceIds, CacheKey& key)
+{
+#ifdef _WIN32
+    struct _stat64 buf;
+    if (_wstat64(filename.c_str(), &buf) != 0)
+        return false;
+#else
+    struct stat buf;
+    if (stat(msra::strfun::utf8(filename).c_str(), &buf) != 0)
+        return false;
+#endif
+    key.m_fileSize = (uint64_t)buf.st_size;
+    key.m_modificationTime = (int64_t)buf.st_mtime;
+    key.m_skipSequenceIds = skipSequenceIds;
+    return true;
+}
+
+bool Indexer::TryLoadFromCache(const std::wstring& cacheFile, const CacheKey& key, CorpusDescriptorPtr corpus)
+{
+    if (!m_index.IsEmpty())
+    {
+        return true;
+    }
+
+    FILE* f = OpenCacheFile(cacheFile, false);
+    if (f == nullptr)
+    {
+        return false;
+    }
+
+    IndexCacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.m_magic, c_indexCacheMagic, sizeof(c_indexCacheMagic)) == 0 &&
+        header.m_version == c_indexCacheVersion &&
+        header.m_fileSize == key.m_fileSize &&
+        header.m_modificationTime == key.m_modificationTime &&
+        (header.m_skipSequenceIds != 0) == key.m_skipSequenceIds &&
+        header.m_numSequences > 0;
+
+    std::vector<IndexCacheRecord> records;
+    if (valid)
+    {
+        records.resize(header.m_numSequences);
+        valid = fread(records.data(), sizeof(IndexCacheRecord), records.size(), f) == records.size();
+    }
+    fclose(f);
+
+    if (!valid)
+    {
+        return false;
+    }
+
+    // Replaying the sequences, so that chunking and filtering follow the current configuration.
+    m_index.Reserve(key.m_fileSize);
+    for (const auto& record : records)
+    {
+        SequenceDescriptor sd = {};
+        sd.m_numberOfSamples = record.m_numberOfSamples;
+        sd.m_fileOffsetBytes = record.m_fileOffsetBytes;
+        sd.m_byteSize = record.m_byteSize;
+        AddSequenceIfIncluded(corpus, record.m_key, sd);
+    }
+
+    m_hasSequenceIds = header.m_hasSequenceIds != 0;
+    m_done = true;
+    return true;
+}
+
+void Indexer::SaveToCache(const std::wstring& cacheFile, const CacheKey& key) const
+{
+    std::vector<IndexCacheRecord> records;
+    for (const auto& chunk : m_index.m_chunks)
+    {
+        for (const auto& sequence : chunk.m_sequences)
+        {
+            records.push_back(IndexCacheRecord{
+                sequence.m_key.m_sequence,
+                sequence.m_numberOfSamples,
+                sequence.m_fileOffsetBytes,
+                sequence.m_byteSize });
+        }
+    }
+
+    IndexCacheHeader header;
+    memcpy(header.m_magic, c_indexCacheMagic, sizeof(c_indexCacheMagic));
+    header.m_version = c_indexCacheVersion;
+    header.m_fileSize = key.m_fileSize;
+    header.m_modificationTime = key.m_modificationTime;
+    header.m_skipSequenceIds = key.m_skipSequenceIds ? 1 : 0;
+    header.m_hasSequenceIds = m_hasSequenceIds ? 1 : 0;
+    header.m_numSequences = records.size();
+
+    // Writing to a temporary file first, so that readers never see a partially written cache.
+    std::wstring tmpFile = cacheFile + L".tmp";
+    FILE* f = OpenCacheFile(tmpFile, true);
+    if (f == nullptr)
+    {
+        RuntimeError("Cannot create the index cache file (%ls).", tmpFile.c_str());
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1 &&
+        fwrite(records.data(), sizeof(IndexCacheRecord), records.size(), f) == records.size();
+    written = (fclose(f) == 0) && written;
+    if (!written)
+    {
+        _wunlink(tmpFile.c_str());
+        RuntimeError("Cannot write the index cache file (%ls).", tmpFile.c_str());
+    }
+
+    renameOrDie(tmpFile, cacheFile);
+}
+
 }}}
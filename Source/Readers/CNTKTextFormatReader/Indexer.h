@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <vector>
+#include <string>
 #include "Descriptors.h"
 #include "CorpusDescriptor.h"
 
@@ -22,6 +23,9 @@ class Indexer
 public:
     Indexer(FILE* file, bool isPrimary, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024);
 
+    // Builds the index directly from a memory mapped input of the given size (in bytes).
+    Indexer(const char* data, size_t size, bool isPrimary, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024);
+
     // Reads the input file, building and index of chunks and corresponding
     // sequences.
     void Build(CorpusDescriptorPtr corpus);
@@ -29,6 +33,26 @@ public:
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
 
+    // Identifies the version of the input file an index was built for.
+    struct CacheKey
+    {
+        uint64_t m_fileSize;
+        int64_t m_modificationTime;
+        bool m_skipSequenceIds;
+    };
+
+    // Retrieves the size and modification time of the input file, returns false if they are not available.
+    static bool TryGetCacheKey(const std::wstring& filename, bool skipSequenceIds, CacheKey& key);
+
+    // Loads the index from a cache file written by SaveToCache() for the same key,
+    // filtering sequences through the corpus descriptor.
+    // Returns false if the cache file does not exist, is corrupt or was written for a different key.
+    bool TryLoadFromCache(const std::wstring& cacheFile, const CacheKey& key, CorpusDescriptorPtr corpus);
+
+    // Saves the sequences of the index, so that it does not have to be rebuilt next time.
+    // Notice that the index must have been built with a corpus that includes all sequences.
+    void SaveToCache(const std::wstring& cacheFile, const CacheKey& key) const;
+
     // True, when input does not have the sequence id column
     // or when sequence id column was ignored during indexing
     // (by passing skipSequenceIds = true to the constructor).
@@ -37,6 +61,10 @@ public:
 private:
     FILE* m_file;
 
+    // memory mapped input, used instead of m_file if not null.
+    const char* m_data;
+    size_t m_dataSize;
+
     int64_t m_fileOffsetStart;
     int64_t m_fileOffsetEnd;
 
@@ -57,7 +85,7 @@ private:
     void AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceId, SequenceDescriptor& sd);
 
     // fills up the buffer with data from file, all previously buffered data
-    // will be overwritten.
+    // will be overwritten. For memory mapped input the buffer is the whole mapped region.
     void RefillBuffer();
 
     // Moves the buffer position to the beginning of the next line.
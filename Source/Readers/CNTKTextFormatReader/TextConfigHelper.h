@@ -39,6 +39,12 @@ public:
 
     bool IsInFrameMode() const { return m_frameMode; }
 
+    bool ShouldUseMemoryMappedFile() const { return m_memoryMapped; }
+
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
+    const wstring& GetIndexCacheFile() const { return m_indexCacheFile; }
+
     ElementType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(TextConfigHelper);
@@ -54,6 +60,9 @@ private:
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
+    bool m_memoryMapped; // if true, the input file is memory mapped instead of being read through a buffer.
+    bool m_cacheIndex; // if true, the index is persisted next to the input file (or in m_indexCacheFile) and reused.
+    std::wstring m_indexCacheFile;
 };
 
 } } }
@@ -7,6 +7,14 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <cfloat>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CNTK_TEXT_PARSER_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "FileLock.h"
 #include "Indexer.h"
 #include "TextParser.h"
 #include "TextReaderConstants.h"
@@ -21,6 +29,178 @@ inline bool IsDigit(char c)
     return '0' <= c && c <= '9';
 }
 
+// Returns a pointer to the first input marker or row delimiter (and, if stopAtValueDelimiters
+// is set, the first space or tab) in [begin, end), or end if there is none.
+// Scans 16 bytes at a time where SSE2 is available.
+inline const char* FindDelimiter(const char* begin, const char* end, bool stopAtValueDelimiters)
+{
+#ifdef CNTK_TEXT_PARSER_SSE2
+    const __m128i namePrefix = _mm_set1_epi8(NAME_PREFIX);
+    const __m128i rowDelimiter = _mm_set1_epi8(ROW_DELIMITER);
+    const __m128i space = _mm_set1_epi8(SPACE_CHAR);
+    const __m128i tab = _mm_set1_epi8(TAB_CHAR);
+    while (end - begin >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        __m128i match = _mm_or_si128(_mm_cmpeq_epi8(chunk, namePrefix), _mm_cmpeq_epi8(chunk, rowDelimiter));
+        if (stopAtValueDelimiters)
+        {
+            match = _mm_or_si128(match, _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)));
+        }
+
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(match));
+        if (mask)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return begin + index;
+#else
+            return begin + __builtin_ctz(mask);
+#endif
+        }
+        begin += 16;
+    }
+#endif
+
+    for (; begin != end; ++begin)
+    {
+        char c = *begin;
+        if (c == NAME_PREFIX || c == ROW_DELIMITER || (stopAtValueDelimiters && isValueDelimiter(c)))
+        {
+            return begin;
+        }
+    }
+    return end;
+}
+
+// Fast path for unsigned integers of up to 19 digits that are followed by a non-digit within [pos, end).
+// Returns false without moving pos if the input does not match, the caller then falls back to the
+// regular parser, which handles the remaining cases (and produces the warnings).
+inline bool TryParseUint64Fast(const char*& pos, const char* end, size_t& value)
+{
+    const ptrdiff_t maxDigits = 19; // cannot overflow a 64-bit value
+    const char* p = pos;
+    const char* last = (end - p > maxDigits) ? p + maxDigits : end;
+    uint64_t result = 0;
+    for (; p != last && IsDigit(*p); ++p)
+    {
+        result = result * 10 + (*p - '0');
+    }
+
+    if (p == pos || p == end || IsDigit(*p))
+    {
+        return false;
+    }
+
+    value = static_cast<size_t>(result);
+    pos = p;
+    return true;
+}
+
+// Fast path for the common decimal format ([+-]digits[.digits][(e|E)[+-]digits]) with at most
+// 19 significant digits, followed by a non-numeric character within [pos, end).
+// The digits are accumulated into an integer and scaled once by an exact power of ten,
+// which is as precise as IEEE multiplication/division allows.
+// Returns false without moving pos for everything else (the caller then falls back to the regular parser).
+inline bool TryParseRealNumberFast(const char*& pos, const char* end, double& value)
+{
+    static const double powersOfTen[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const int maxExactPower = 22;
+    const int maxDigits = 19;
+
+    const char* p = pos;
+    bool negative = false;
+    if (p != end && isSign(*p))
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int numDigits = 0;
+    const char* digitsStart = p;
+    for (; p != end && IsDigit(*p); ++p, ++numDigits)
+    {
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+
+    if (p == digitsStart)
+    {
+        return false;
+    }
+
+    int power = 0;
+    if (p != end && *p == '.')
+    {
+        ++p;
+        const char* fractionStart = p;
+        for (; p != end && IsDigit(*p); ++p, ++numDigits)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+
+        power = -static_cast<int>(p - fractionStart);
+        if (p == fractionStart)
+        {
+            // a trailing period, leave it to the regular parser
+            return false;
+        }
+    }
+
+    if (numDigits > maxDigits)
+    {
+        return false;
+    }
+
+    if (p != end && isE(*p))
+    {
+        ++p;
+        bool negativeExponent = false;
+        if (p != end && isSign(*p))
+        {
+            negativeExponent = (*p == '-');
+            ++p;
+        }
+
+        int exponent = 0;
+        const char* exponentStart = p;
+        for (; p != end && IsDigit(*p) && p - exponentStart < 3; ++p)
+        {
+            exponent = exponent * 10 + (*p - '0');
+        }
+
+        if (p == exponentStart)
+        {
+            return false;
+        }
+
+        power += negativeExponent ? -exponent : exponent;
+    }
+
+    // the number must be terminated within the range
+    if (p == end || IsDigit(*p) || *p == '.' || isE(*p))
+    {
+        return false;
+    }
+
+    // doubles represent integers up to 2^53 exactly
+    if (mantissa > (1ull << 53) || power < -maxExactPower || power > maxExactPower)
+    {
+        return false;
+    }
+
+    double result = static_cast<double>(mantissa);
+    result = (power < 0) ? result / powersOfTen[-power] : result * powersOfTen[power];
+    value = negative ? -result : result;
+    pos = p;
+    return true;
+}
+
 enum State
 {
     Init = 0,
@@ -68,6 +248,8 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams(), isPrimary)
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetUseMemoryMappedFile(helper.ShouldUseMemoryMappedFile());
+    SetIndexCache(helper.ShouldCacheIndex(), helper.GetIndexCacheFile());
 
     Initialize();
 }
@@ -77,6 +259,8 @@ template <class ElemType>
 TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring& filename, const vector<StreamDescriptor>& streams, bool isPrimary) :
     m_filename(filename),
     m_file(nullptr),
+    m_useMemoryMappedFile(false),
+    m_cacheIndex(false),
     m_streamInfos(streams.size()),
     m_indexer(nullptr),
     m_fileOffsetStart(0),
@@ -148,6 +332,12 @@ void TextParser<ElemType>::Initialize()
         return;
     }
 
+    if (m_useMemoryMappedFile)
+    {
+        InitializeFromMemoryMappedFile();
+        return;
+    }
+
     attempt(m_numRetries, [this]()
     {
         if (m_file == nullptr)
@@ -170,7 +360,7 @@ void TextParser<ElemType>::Initialize()
 
         m_indexer = make_unique<Indexer>(m_file, m_isPrimary, m_skipSequenceIds, m_chunkSizeBytes);
 
-        m_indexer->Build(m_corpus);
+        BuildIndex();
     });
 
     assert(m_indexer != nullptr);
@@ -185,6 +375,80 @@ void TextParser<ElemType>::Initialize()
     m_fileOffsetEnd = position;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::InitializeFromMemoryMappedFile()
+{
+    attempt(m_numRetries, [this]()
+    {
+        m_mappedFile = make_unique<MemoryMappedFile>(m_filename);
+
+        const char* data = m_mappedFile->GetData();
+        if (m_mappedFile->GetSize() >= 2 && (unsigned char)data[0] == 0xFF && (unsigned char)data[1] == 0xFE)
+        {
+            // Retrying won't help here, the file is UTF-16 encoded.
+            m_numRetries = 0;
+            RuntimeError("Found a UTF-16 BOM at the beginning of the input file (%ls). "
+                "UTF-16 encoding is currently not supported.", m_filename.c_str());
+        }
+
+        m_indexer = make_unique<Indexer>(data, m_mappedFile->GetSize(), m_isPrimary, m_skipSequenceIds, m_chunkSizeBytes);
+
+        BuildIndex();
+    });
+
+    assert(m_indexer != nullptr);
+
+    // Chunks are requested in a random order, each of them is paged in explicitly in GetChunk.
+    m_mappedFile->AdviseRandomAccess();
+
+    // The buffer is the whole file, no refills or seeks are needed afterwards.
+    m_fileOffsetStart = 0;
+    m_fileOffsetEnd = m_mappedFile->GetSize();
+    m_bufferStart = m_mappedFile->GetData();
+    m_bufferEnd = m_bufferStart + m_mappedFile->GetSize();
+    m_pos = m_bufferStart;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::BuildIndex()
+{
+    Indexer::CacheKey key;
+    if (!m_cacheIndex || !Indexer::TryGetCacheKey(m_filename, m_skipSequenceIds, key))
+    {
+        m_indexer->Build(m_corpus);
+        return;
+    }
+
+    const std::wstring cacheFile = m_indexCacheFile.empty() ? m_filename + L".index" : m_indexCacheFile;
+    if (m_indexer->TryLoadFromCache(cacheFile, key, m_corpus))
+    {
+        if (m_traceLevel >= Info)
+            fprintf(stderr, "INFO: Loaded the index of the input file (%ls) from the cache (%ls).\n", m_filename.c_str(), cacheFile.c_str());
+        return;
+    }
+
+    // Only the complete index can be cached.
+    if (!m_corpus->IncludesAllSequences())
+    {
+        m_indexer->Build(m_corpus);
+        return;
+    }
+
+    // Several workers of a distributed job are likely to start at the same time:
+    // the one that gets the lock of the cache builds and saves the index, others wait for it.
+    bool loaded = BuildOrWaitForCache(cacheFile, INDEX_CACHE_WAIT_SECONDS, m_traceLevel >= Info,
+        [&] { return m_indexer->TryLoadFromCache(cacheFile, key, m_corpus); },
+        [&] { m_indexer->Build(m_corpus); },
+        [&]
+        {
+            m_indexer->SaveToCache(cacheFile, key);
+            if (m_traceLevel >= Info)
+                fprintf(stderr, "INFO: Saved the index of the input file (%ls) to the cache (%ls).\n", m_filename.c_str(), cacheFile.c_str());
+        });
+    if (loaded && m_traceLevel >= Info)
+        fprintf(stderr, "INFO: Loaded the index of the input file (%ls) from the cache (%ls).\n", m_filename.c_str(), cacheFile.c_str());
+}
+
 template <class ElemType>
 ChunkDescriptions TextParser<ElemType>::GetChunkDescriptions()
 {
@@ -249,6 +513,25 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
     const auto& chunkDescriptor = m_indexer->GetIndex().m_chunks[chunkId];
     auto textChunk = make_shared<TextDataChunk>(chunkDescriptor, this);
 
+    if (m_mappedFile)
+    {
+        // Let the OS page in the whole chunk while the parser starts on its beginning,
+        // the pages are not needed anymore once the chunk is parsed.
+        size_t chunkOffset = 0, chunkSize = 0;
+        if (!chunkDescriptor.m_sequences.empty())
+        {
+            const auto& first = chunkDescriptor.m_sequences.front();
+            const auto& last = chunkDescriptor.m_sequences.back();
+            chunkOffset = first.m_fileOffsetBytes;
+            chunkSize = last.m_fileOffsetBytes + last.m_byteSize - first.m_fileOffsetBytes;
+        }
+
+        m_mappedFile->WillNeed(chunkOffset, chunkSize);
+        LoadChunk(textChunk, chunkDescriptor);
+        m_mappedFile->DontNeed(chunkOffset, chunkSize);
+        return textChunk;
+    }
+
     attempt(m_numRetries, [this, &textChunk, &chunkDescriptor]()
     {
         if (ferror(m_file) != 0)
@@ -288,6 +571,12 @@ void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 template <class ElemType>
 bool TextParser<ElemType>::TryRefillBuffer()
 {
+    if (m_mappedFile)
+    {
+        // The buffer already spans the whole mapped file.
+        return false;
+    }
+
     size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
 
     if (bytesRead == (size_t)-1)
@@ -312,6 +601,12 @@ bool TextParser<ElemType>::TryRefillBuffer()
 template <class ElemType>
 void TextParser<ElemType>::SetFileOffset(int64_t offset)
 {
+    if (m_mappedFile)
+    {
+        LogicError("Seeking to position %" PRId64 " outside of the memory mapped input file (%ls).",
+            offset, m_filename.c_str());
+    }
+
     int rc = _fseeki64(m_file, offset, SEEK_SET);
     if (rc)
     {
@@ -881,38 +1176,47 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
 template <class ElemType>
 void TextParser<ElemType>::SkipToNextValue(size_t& bytesToRead)
 {
-    while (bytesToRead && CanRead())
-    {
-        char c = *m_pos;
-        // skip everything until we hit either a value delimiter, an input marker or the end of row.
-        if (isValueDelimiter(c) || c == NAME_PREFIX || c == ROW_DELIMITER)
-        {
-            return;
-        }
-        ++m_pos;
-        --bytesToRead;
-    }
+    // skip everything until we hit either a value delimiter, an input marker or the end of row.
+    SkipToDelimiter(bytesToRead, true);
 }
 
 template <class ElemType>
 void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
+{
+    // skip everything until we hit either an input marker or the end of row.
+    SkipToDelimiter(bytesToRead, false);
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SkipToDelimiter(size_t& bytesToRead, bool stopAtValueDelimiters)
 {
     while (bytesToRead && CanRead())
     {
-        char c = *m_pos;
-        // skip everything until we hit either an input marker or the end of row.
-        if (c == NAME_PREFIX || c == ROW_DELIMITER)
+        size_t available = std::min(bytesToRead, static_cast<size_t>(m_bufferEnd - m_pos));
+        const char* next = FindDelimiter(m_pos, m_pos + available, stopAtValueDelimiters);
+        size_t skipped = next - m_pos;
+        m_pos = next;
+        bytesToRead -= skipped;
+        if (skipped < available)
         {
             return;
         }
-        ++m_pos;
-        --bytesToRead;
     }
 }
 
 template <class ElemType>
 bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 {
+    if (bytesToRead && CanRead())
+    {
+        const char* start = m_pos;
+        if (TryParseUint64Fast(m_pos, m_pos + std::min(bytesToRead, static_cast<size_t>(m_bufferEnd - m_pos)), value))
+        {
+            bytesToRead -= m_pos - start;
+            return true;
+        }
+    }
+
     value = 0;
     bool found = false;
     while (bytesToRead && CanRead())
@@ -965,6 +1269,18 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 template <class ElemType>
 bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
 {
+    if (bytesToRead && CanRead())
+    {
+        const char* start = m_pos;
+        double result;
+        if (TryParseRealNumberFast(m_pos, m_pos + std::min(bytesToRead, static_cast<size_t>(m_bufferEnd - m_pos)), result))
+        {
+            bytesToRead -= m_pos - start;
+            value = static_cast<ElemType>(result);
+            return true;
+        }
+    }
+
     State state = State::Init;
     double coefficient = .0, number = .0, divider = .0;
     bool negative = false;
@@ -1189,6 +1505,19 @@ void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
     m_numRetries = numRetries;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetIndexCache(bool cacheIndex, const std::wstring& indexCacheFile)
+{
+    m_cacheIndex = cacheIndex;
+    m_indexCacheFile = indexCacheFile;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetUseMemoryMappedFile(bool useMemoryMappedFile)
+{
+    m_useMemoryMappedFile = useMemoryMappedFile;
+}
+
 template <class ElemType>
 std::wstring TextParser<ElemType>::GetFileInfo()
 {
@@ -9,6 +9,7 @@
 #include "Descriptors.h"
 #include "TextConfigHelper.h"
 #include "Indexer.h"
+#include "MemoryMappedFile.h"
 #include "CorpusDescriptor.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -41,6 +42,12 @@ private:
     // Builds an index of the input data.
     void Initialize();
 
+    // Maps the input file into memory and builds the index directly from the mapped region.
+    void InitializeFromMemoryMappedFile();
+
+    // Builds the index using m_indexer, or loads it from the index cache if enabled.
+    void BuildIndex();
+
     struct DenseInputStreamBuffer : DenseSequenceData
     {
         // capacity = expected number of samples * sample size
@@ -94,6 +101,11 @@ private:
     const std::wstring m_filename;
     FILE* m_file;
 
+    // If set, the input is indexed and parsed directly from the mapped file,
+    // in that case m_file is not used and the buffer spans the whole file.
+    std::unique_ptr<MemoryMappedFile> m_mappedFile;
+    bool m_useMemoryMappedFile;
+
     // An internal structure to assist with copying from input stream buffers into
     // into sequence data in a proper format.
     struct StreamInfo;
@@ -104,6 +116,11 @@ private:
 
     std::unique_ptr<Indexer> m_indexer;
 
+    // If set, the index is loaded from (or saved to) m_indexCacheFile
+    // (by default the input file name with the '.index' suffix) instead of being rebuilt on every start.
+    bool m_cacheIndex;
+    std::wstring m_indexCacheFile;
+
     int64_t m_fileOffsetStart;
     int64_t m_fileOffsetEnd;
 
@@ -142,6 +159,9 @@ private:
     void SkipToNextValue(size_t& bytesToRead);
     void SkipToNextInput(size_t& bytesToRead);
 
+    // Skips to the next input marker or end of row (or value delimiter, if stopAtValueDelimiters is set).
+    void SkipToDelimiter(size_t& bytesToRead, bool stopAtValueDelimiters);
+
     bool TryRefillBuffer();
 
     int64_t GetFileOffset() const { return m_fileOffsetStart + (m_pos - m_bufferStart); }
@@ -195,6 +215,10 @@ private:
 
     void SetNumRetries(unsigned int numRetries);
 
+    void SetUseMemoryMappedFile(bool useMemoryMappedFile);
+
+    void SetIndexCache(bool cacheIndex, const std::wstring& indexCacheFile);
+
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
 
     DISABLE_COPY_AND_MOVE(TextParser);
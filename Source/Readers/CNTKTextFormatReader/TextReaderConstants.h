@@ -20,6 +20,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     const auto BUFFER_SIZE = 2 * 1024 * 1024;
 
+    // How long to wait for another process building the index cache.
+    const auto INDEX_CACHE_WAIT_SECONDS = 60 * 60;
+
     inline bool isPrintable(char c)
     {
         return c >= SPACE_CHAR;
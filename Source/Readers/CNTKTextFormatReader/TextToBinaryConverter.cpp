@@ -0,0 +1,292 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <deque>
+#include <future>
+#include <limits>
+#include "TextToBinaryConverter.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Must match BinaryChunkDeserializer: version 2 records a codec for each chunk.
+const int64_t BINARY_FORMAT_VERSION = 1;
+const int64_t COMPRESSED_BINARY_FORMAT_VERSION = 2;
+
+enum class BinaryDeserializerType : int32_t
+{
+    Dense = 0,
+    Sparse = 1
+};
+
+#pragma pack(push, 1)
+struct BinaryOffsetsTableEntry
+{
+    int64_t offset;
+    int32_t numSequences;
+    int32_t numSamples;
+};
+
+struct BinaryOffsetsTableEntryV2
+{
+    int64_t offset;
+    int32_t numSequences;
+    int32_t numSamples;
+    ChunkCodec codec;
+    int64_t uncompressedSize;
+};
+#pragma pack(pop)
+
+static void WriteOffsetsTable(const std::vector<BinaryOffsetsTableEntryV2>& offsetsTable, int64_t version, FILE* file)
+{
+    if (version == COMPRESSED_BINARY_FORMAT_VERSION)
+    {
+        fwriteOrDie(offsetsTable, file);
+        return;
+    }
+
+    std::vector<BinaryOffsetsTableEntry> entries(offsetsTable.size());
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        entries[i].offset = offsetsTable[i].offset;
+        entries[i].numSequences = offsetsTable[i].numSequences;
+        entries[i].numSamples = offsetsTable[i].numSamples;
+    }
+    fwriteOrDie(entries, file);
+}
+
+template <class T>
+static void Append(std::vector<char>& buffer, const T* data, size_t count)
+{
+    const char* bytes = reinterpret_cast<const char*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + count * sizeof(T));
+}
+
+template <class T>
+static void Write(const T& value, FILE* file)
+{
+    fwriteOrDie(&value, sizeof(value), 1, file);
+}
+
+static int32_t CheckedInt32(size_t value, const char* what)
+{
+    if (value > (size_t)std::numeric_limits<int32_t>::max())
+        RuntimeError("TextToBinaryConverter: %s (%" PRIu64 ") does not fit into the binary format.", what, (uint64_t)value);
+    return static_cast<int32_t>(value);
+}
+
+template <class ElemType>
+TextToBinaryConverter<ElemType>::TextToBinaryConverter(const ConfigParameters& readerConfig, const std::wstring& outputFile, size_t numThreads, ChunkCodec codec)
+    : m_readerConfig(readerConfig), m_outputFile(outputFile), m_numThreads(std::max<size_t>(numThreads, 1)), m_codec(codec)
+{
+    if (m_outputFile.empty())
+        InvalidArgument("TextToBinaryConverter: the output file is not specified.");
+
+    if (!IsChunkCodecSupported(m_codec))
+        InvalidArgument("TextToBinaryConverter: chunk codec %d is not supported by this build.", (int)m_codec);
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::Convert()
+{
+    // All workers need the same index. Unless the reader config already asks for an index cache,
+    // the first parser saves its index next to the output, and the other ones load it from there.
+    ConfigParameters config(m_readerConfig);
+    bool ownIndexCache = false;
+    if (m_numThreads > 1 && !TextConfigHelper(m_readerConfig).ShouldCacheIndex())
+    {
+        config.Insert("cacheIndex", "true");
+        config.Insert("indexCacheFile", msra::strfun::utf8(m_outputFile + L".index"));
+        ownIndexCache = true;
+    }
+
+    TextConfigHelper helper(config);
+    auto corpus = std::make_shared<CorpusDescriptor>(true);
+    std::vector<std::unique_ptr<TextParser<ElemType>>> parsers;
+    parsers.push_back(std::make_unique<TextParser<ElemType>>(corpus, helper, true));
+
+    m_streams = parsers.front()->GetStreamDescriptions();
+    ChunkDescriptions chunks = parsers.front()->GetChunkDescriptions();
+
+    size_t numWorkers = std::max<size_t>(std::min(m_numThreads, chunks.size()), 1);
+    for (size_t i = 1; i < numWorkers; ++i)
+    {
+        parsers.push_back(std::make_unique<TextParser<ElemType>>(corpus, helper, true));
+        if (parsers.back()->GetChunkDescriptions().size() != chunks.size())
+            LogicError("TextToBinaryConverter: parsers of the same input disagree on the number of chunks.");
+    }
+
+    if (ownIndexCache)
+        unlinkOrDie(m_outputFile + L".index");
+
+    fprintf(stderr, "Converting '%ls' into '%ls' (%" PRIu64 " chunks, %" PRIu64 " workers).\n",
+        helper.GetFilePath().c_str(), m_outputFile.c_str(), (uint64_t)chunks.size(), (uint64_t)numWorkers);
+
+    const std::wstring tempFile = m_outputFile + L".tmp";
+    FILE* file = fopenOrDie(tempFile, L"wb");
+
+    // Uncompressed output stays readable by readers that only know the first version.
+    int64_t version = (m_codec == ChunkCodec::None) ? BINARY_FORMAT_VERSION : COMPRESSED_BINARY_FORMAT_VERSION;
+    WriteHeader(file, version, chunks.size());
+
+    // Reserve the offsets table, it is filled in once all chunks are written.
+    uint64_t offsetsTableStart = fgetpos(file);
+    std::vector<BinaryOffsetsTableEntryV2> offsetsTable(chunks.size());
+    WriteOffsetsTable(offsetsTable, version, file);
+
+    // encoded (and possibly compressed) chunk, and its uncompressed size
+    typedef std::pair<std::vector<char>, size_t> EncodedChunk;
+    std::deque<std::future<EncodedChunk>> pending;
+    int64_t offset = 0;
+    size_t uncompressedSize = 0;
+    size_t numWritten = 0;
+    auto writeNext = [&]()
+    {
+        EncodedChunk encoded = pending.front().get();
+        pending.pop_front();
+        fwriteOrDie(encoded.first, file);
+
+        const ChunkDescription& chunk = *chunks[numWritten];
+        offsetsTable[numWritten].offset = offset;
+        offsetsTable[numWritten].numSequences = CheckedInt32(chunk.m_numberOfSequences, "number of sequences in a chunk");
+        offsetsTable[numWritten].numSamples = CheckedInt32(chunk.m_numberOfSamples, "number of samples in a chunk");
+        offsetsTable[numWritten].codec = m_codec;
+        offsetsTable[numWritten].uncompressedSize = encoded.second;
+        offset += encoded.first.size();
+        uncompressedSize += encoded.second;
+        numWritten++;
+    };
+
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        if (pending.size() == numWorkers)
+            writeNext();
+
+        // The chunk that used this parser before has just been written out, so the parser is idle.
+        TextParser<ElemType>* parser = parsers[c % numWorkers].get();
+        const ChunkDescription* chunk = chunks[c].get();
+        pending.push_back(std::async(std::launch::async, [this, parser, chunk]()
+        {
+            std::vector<char> buffer;
+            EncodeChunk(*parser, *chunk, buffer);
+            size_t size = buffer.size();
+            if (m_codec == ChunkCodec::None)
+                return EncodedChunk(std::move(buffer), size);
+
+            std::vector<char> compressed;
+            CompressChunk(m_codec, buffer.data(), size, compressed);
+            return EncodedChunk(std::move(compressed), size);
+        }));
+    }
+
+    while (!pending.empty())
+        writeNext();
+
+    fsetpos(file, offsetsTableStart);
+    WriteOffsetsTable(offsetsTable, version, file);
+    fcloseOrDie(file);
+
+    renameOrDie(tempFile, m_outputFile);
+    fprintf(stderr, "Finished converting '%ls' (%" PRIu64 " bytes of chunk data, %" PRIu64 " bytes uncompressed).\n",
+        m_outputFile.c_str(), (uint64_t)offset, (uint64_t)uncompressedSize);
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::WriteHeader(FILE* file, int64_t version, size_t numChunks)
+{
+    Write(version, file);
+    Write((int64_t)numChunks, file);
+    Write(CheckedInt32(m_streams.size(), "number of inputs"), file);
+    for (const auto& stream : m_streams)
+    {
+        std::string name = msra::strfun::utf8(stream->m_name);
+        Write(CheckedInt32(name.size(), "input name length"), file);
+        fwriteOrDie(name.data(), sizeof(char), name.size(), file);
+
+        int32_t elemType = (stream->m_elementType == ElementType::tfloat) ? 0 : 1;
+        int32_t numCols = CheckedInt32(stream->m_sampleLayout->GetNumElements(), "sample dimension");
+        if (stream->m_storageType == StorageType::dense)
+        {
+            Write(BinaryDeserializerType::Dense, file);
+            Write(elemType, file);
+            Write(numCols, file);
+        }
+        else
+        {
+            Write(BinaryDeserializerType::Sparse, file);
+            Write((int32_t)0, file); // sparse_csc
+            Write(elemType, file);
+            Write((int32_t)1, file); // sequences can have more than one sample
+            Write(numCols, file);
+        }
+    }
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::EncodeChunk(TextParser<ElemType>& parser, const ChunkDescription& chunk, std::vector<char>& buffer)
+{
+    std::vector<SequenceDescription> sequences;
+    parser.GetSequencesForChunk(chunk.m_id, sequences);
+    ChunkPtr data = parser.GetChunk(chunk.m_id);
+
+    std::vector<std::vector<SequenceDataPtr>> sequenceData(sequences.size());
+    for (size_t i = 0; i < sequences.size(); ++i)
+        data->GetSequence(sequences[i].m_id, sequenceData[i]);
+
+    std::vector<int32_t> rowIndices;
+    std::vector<int32_t> columnOffsets;
+    for (size_t s = 0; s < m_streams.size(); ++s)
+    {
+        const StreamDescription& stream = *m_streams[s];
+        size_t dimension = stream.m_sampleLayout->GetNumElements();
+        if (stream.m_storageType == StorageType::dense)
+        {
+            for (size_t i = 0; i < sequences.size(); ++i)
+            {
+                const auto& sequence = sequenceData[i][s];
+                if (sequence->m_numberOfSamples != 1)
+                    RuntimeError("TextToBinaryConverter: sequence %" PRIu64 " has %u samples for the dense input '%ls', "
+                        "the binary format supports exactly one sample per sequence for dense inputs.",
+                        (uint64_t)sequences[i].m_key.m_sequence, (unsigned int)sequence->m_numberOfSamples, stream.m_name.c_str());
+                Append(buffer, static_cast<const ElemType*>(sequence->GetDataBuffer()), dimension);
+            }
+            continue;
+        }
+
+        // int32 nnz, ElemType values[nnz], int32 rows[nnz] (sample * dimension + index), int32 columns[numSequences + 1]
+        size_t totalNnz = 0;
+        for (size_t i = 0; i < sequences.size(); ++i)
+            totalNnz += static_cast<SparseSequenceData*>(sequenceData[i][s].get())->m_totalNnzCount;
+
+        int32_t nnz = CheckedInt32(totalNnz, "number of non-zero values in a chunk");
+        Append(buffer, &nnz, 1);
+
+        rowIndices.clear();
+        columnOffsets.assign(1, 0);
+        for (size_t i = 0; i < sequences.size(); ++i)
+        {
+            auto sequence = static_cast<SparseSequenceData*>(sequenceData[i][s].get());
+            Append(buffer, static_cast<const ElemType*>(sequence->GetDataBuffer()), sequence->m_totalNnzCount);
+
+            const IndexType* indices = sequence->m_indices;
+            for (size_t sample = 0; sample < sequence->m_nnzCounts.size(); ++sample)
+            {
+                for (IndexType j = 0; j < sequence->m_nnzCounts[sample]; ++j)
+                    rowIndices.push_back(CheckedInt32(sample * dimension + *indices++, "sparse row index"));
+            }
+            columnOffsets.push_back(columnOffsets.back() + sequence->m_totalNnzCount);
+        }
+
+        Append(buffer, rowIndices.data(), rowIndices.size());
+        Append(buffer, columnOffsets.data(), columnOffsets.size());
+    }
+}
+
+template class TextToBinaryConverter<float>;
+template class TextToBinaryConverter<double>;
+}}}
@@ -0,0 +1,51 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Config.h"
+#include "TextParser.h"
+#include "ChunkCodec.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Converts a CTF input file into the chunked binary format read by the CNTKBinaryReader
+// (see BinaryChunkDeserializer), so that text parsing is done once instead of on every epoch.
+// The output consists of
+//  - a header: version, number of chunks, number of inputs and, per input, its name and layout;
+//  - the offsets table: per chunk, its offset relative to the end of the table, number of sequences and samples;
+//  - the chunks: per input, the data of all sequences in the chunk.
+// Every CTF chunk (see chunkSizeInBytes) becomes one binary chunk. Chunks are parsed and encoded by
+// numThreads workers, each with its own TextParser; at most numThreads chunks are held in memory
+// at any time, and they are written out in order. With a codec other than ChunkCodec::None, every chunk
+// is compressed by its worker, and the file is written in version 2 of the format, which records the codec per chunk.
+// Limitations of the binary format: dense inputs must have exactly one sample per sequence,
+// and index * dimension of sparse sequences must fit into an int32.
+template <class ElemType>
+class TextToBinaryConverter
+{
+public:
+    TextToBinaryConverter(const ConfigParameters& readerConfig, const std::wstring& outputFile, size_t numThreads, ChunkCodec codec = ChunkCodec::None);
+
+    void Convert();
+
+    DISABLE_COPY_AND_MOVE(TextToBinaryConverter);
+
+private:
+    // Parses the chunk and encodes it in the binary chunk layout.
+    void EncodeChunk(TextParser<ElemType>& parser, const ChunkDescription& chunk, std::vector<char>& buffer);
+
+    void WriteHeader(FILE* file, int64_t version, size_t numChunks);
+
+    ConfigParameters m_readerConfig;
+    std::wstring m_outputFile;
+    size_t m_numThreads;
+    ChunkCodec m_codec;
+    std::vector<StreamDescriptionPtr> m_streams;
+};
+
+}}}
@@ -19,6 +19,7 @@
 #include "SequencePacker.h"
 #include "TruncatedBpttPacker.h"
 #include "CorpusDescriptor.h"
+#include "ChunkCache.h"
 #include "ConfigUtil.h"
 #include "StringUtil.h"
 
@@ -29,17 +30,21 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // For more information please see its header file.
 // This method composes together packers + randomizer + a set of transformers and deserializers.
 CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
-    m_truncationLength(0)
+    CompositeDataReader(config, nullptr)
 {
-    wstring action = config(L"action", L"");
-    bool isActionWrite = AreEqualIgnoreCase(action, L"write");
+}
 
-    // We currently by default using numeric keys for ctf and image deserializers.
-    bool useNumericSequenceKeys = ContainsDeserializer(config, L"CNTKTextFormatDeserializer") ||
-        ContainsDeserializer(config, L"ImageDeserializer");
+CompositeDataReader::CompositeDataReader(const ConfigParameters& config, CompositeDataReader& shared) :
+    CompositeDataReader(config, &shared)
+{
+}
 
-    useNumericSequenceKeys = config(L"useNumericSequenceKeys", useNumericSequenceKeys);
-    m_corpus = std::make_shared<CorpusDescriptor>(useNumericSequenceKeys);
+CompositeDataReader::CompositeDataReader(const ConfigParameters& config, CompositeDataReader* shared) :
+    m_truncationLength(0),
+    m_balanceParallelSequences(false)
+{
+    wstring action = config(L"action", L"");
+    bool isActionWrite = AreEqualIgnoreCase(action, L"write");
 
     // Identifying packing mode.
     bool frameMode = config(L"frameMode", false);
@@ -65,6 +70,7 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
         {
             InvalidArgument("Truncation length cannot be 0.");
         }
+        m_balanceParallelSequences = config(L"balanceParallelSequences", false);
     }
     else
     {
@@ -73,22 +79,56 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
 
     m_precision = config("precision", "float");
 
-    // Creating deserializers.
-    // TODO: Currently the primary deserializer defines the corpus. The logic will be moved to CorpusDescriptor class.
-    CreateDeserializers(config);
-
-    if (m_deserializers.empty())
+    IDataDeserializerPtr deserializer;
+    if (shared)
     {
-        InvalidArgument("Could not find deserializers in the reader config.");
+        // Only the transforms are per reader.
+        m_corpus = shared->m_corpus;
+        m_deserializers = shared->m_deserializers;
+        for (const auto& deserializerConfig : GetDeserializerConfigs(config))
+            CreateTransforms(deserializerConfig);
+        deserializer = shared->GetSharedDeserializer();
     }
-
-    IDataDeserializerPtr deserializer = m_deserializers.front();
-    if (m_deserializers.size() > 1)
+    else
     {
-        // Bundling deserializers together.
-        // Option whether we need to check data between different deserializers.
-        bool cleanse = config(L"checkData", true);
-        deserializer = std::make_shared<Bundler>(config, deserializer, m_deserializers, cleanse);
+        // We currently by default using numeric keys for ctf and image deserializers.
+        bool useNumericSequenceKeys = ContainsDeserializer(config, L"CNTKTextFormatDeserializer") ||
+            ContainsDeserializer(config, L"ImageDeserializer");
+
+        useNumericSequenceKeys = config(L"useNumericSequenceKeys", useNumericSequenceKeys);
+        m_corpus = std::make_shared<CorpusDescriptor>(useNumericSequenceKeys);
+
+        // For string sequence keys, the registry that maps the keys to ids can be kept in a file (sequenceKeyRegistry):
+        // if the file exists it is memory mapped and shared by all deserializers, otherwise it is written once the
+        // deserializers have registered their keys, so that following jobs on the same corpus do not rebuild it.
+        wstring keyRegistry = config(L"sequenceKeyRegistry", L"");
+        bool keyRegistryLoaded = !keyRegistry.empty() && m_corpus->TryLoadKeyRegistry(keyRegistry);
+
+        // Creating deserializers.
+        // TODO: Currently the primary deserializer defines the corpus. The logic will be moved to CorpusDescriptor class.
+        CreateDeserializers(config);
+
+        if (m_deserializers.empty())
+        {
+            InvalidArgument("Could not find deserializers in the reader config.");
+        }
+
+        if (!keyRegistry.empty() && m_corpus->IsKeyRegistryModified())
+        {
+            if (keyRegistryLoaded)
+                fprintf(stderr, "CompositeDataReader: new sequence keys were added to the registry '%ls', saving it.\n", keyRegistry.c_str());
+            m_corpus->SaveKeyRegistry(keyRegistry);
+        }
+
+        deserializer = m_deserializers.front();
+        if (m_deserializers.size() > 1)
+        {
+            // Bundling deserializers together.
+            // Option whether we need to check data between different deserializers.
+            bool cleanse = config(L"checkData", true);
+            deserializer = std::make_shared<Bundler>(config, deserializer, m_deserializers, cleanse);
+        }
+        m_bundledDeserializer = deserializer;
     }
 
     int verbosity = config(L"verbosity", 0);
@@ -104,6 +144,24 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
     // It makes sense to put it to true for cases when deserialization is CPU intensive,
     // i.e. decompression of images.
     bool multiThreadedDeserialization = config(L"multiThreadedDeserialization", ContainsDeserializer(config, L"ImageDeserializer"));
+
+    // Multi-threaded deserialization and transformation of sequences runs on threads owned by the reader
+    // (numCPUThreads, by default one per hardware thread), independent of OpenMP used for computations.
+    // With parallelPacking the same threads copy the sequences of large minibatches into the packer buffers
+    // (i.e. for minibatches of many short sequences).
+    // Readers that share deserializers also share the threads, which balances the work between them.
+    bool parallelPacking = config(L"parallelPacking", false);
+    if (shared)
+    {
+        m_threadPool = shared->m_threadPool;
+    }
+    if (!m_threadPool && (multiThreadedDeserialization || parallelPacking))
+    {
+        size_t numThreads = config(L"numCPUThreads", (size_t)0);
+        std::wstring threadAffinity = config(L"threadAffinity", L"none");
+        m_threadPool = std::make_shared<ReaderThreadPool>(numThreads, ParseThreadAffinity(threadAffinity));
+    }
+    ReaderThreadPoolPtr threadPool = m_threadPool;
     if (randomize)
     {
         // By default randomizing the whole data set.
@@ -120,11 +178,39 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
 
         // By default using STL random number generator.
         bool useLegacyRandomization = config(L"useLegacyRandomization", false);
-        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, true /* should Prefetch */, useLegacyRandomization, multiThreadedDeserialization);
+
+        // Number of chunks loaded in parallel (I/O), independent of the number of threads
+        // used for deserialization of sequences (CPU, see multiThreadedDeserialization above).
+        // Only used if all deserializers support concurrent chunk loads.
+        size_t chunkLoadParallelism = config(L"chunkLoadParallelism", (size_t)1);
+
+        // For sequences of very different lengths, groups sequences of similar length into buckets of
+        // about lengthBucketSize samples (i.e. a few minibatches) inside of the randomization window,
+        // which reduces the padding of the minibatches. The buckets themselves are randomized. 0 disables bucketing.
+        size_t lengthBucketSize = config(L"lengthBucketSize", (size_t)0);
+        auto randomizer = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, true /* should Prefetch */, useLegacyRandomization, multiThreadedDeserialization, chunkLoadParallelism, multiThreadedDeserialization ? threadPool : nullptr, lengthBucketSize);
+
+        // How the chunks are distributed between workers: 'roundRobin' (default) or 'locality', which keeps
+        // each chunk on the worker that holds it locally (chunkLocalityMap, lines '<chunk id> <worker rank>')
+        // or has read it in the previous sweep, reducing the reads from shared storage.
+        wstring chunkAssignment = config(L"chunkAssignment", L"roundRobin");
+        if (AreEqualIgnoreCase(chunkAssignment, L"locality"))
+        {
+            wstring chunkLocalityMap = config(L"chunkLocalityMap", L"");
+            if (!chunkLocalityMap.empty())
+                m_corpus->LoadChunkLocality(chunkLocalityMap);
+            randomizer->SetLocalityAwareChunkAssignment(m_corpus);
+        }
+        else if (!AreEqualIgnoreCase(chunkAssignment, L"roundRobin"))
+        {
+            InvalidArgument("Unknown chunkAssignment '%ls', expected 'roundRobin' or 'locality'.", chunkAssignment.c_str());
+        }
+
+        m_sequenceEnumerator = randomizer;
     }
     else
     {
-        m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization);
+        m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization, multiThreadedDeserialization ? threadPool : nullptr);
     }
 
     // In case when there are transforms, applying them to the data.
@@ -152,18 +238,24 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
         m_packer = std::make_shared<FramePacker>(
             m_sequenceEnumerator,
             m_streams,
-            localTimeline);
+            localTimeline,
+            2,
+            parallelPacking ? threadPool : nullptr);
         break;
     case PackingMode::sequence:
         m_packer = std::make_shared<SequencePacker>(
             m_sequenceEnumerator,
-            m_streams);
+            m_streams,
+            2,
+            parallelPacking ? threadPool : nullptr);
         break;
     case PackingMode::truncated:
     {
         m_packer = std::make_shared<TruncatedBPTTPacker>(
             m_sequenceEnumerator,
-            m_streams);
+            m_streams,
+            2,
+            m_balanceParallelSequences);
         break;
     }
     default:
@@ -182,22 +274,41 @@ std::vector<StreamDescriptionPtr> CompositeDataReader::GetStreamDescriptions()
 //        [ type = "CNTKTextFormatDeserializer" module = "CNTKTextFormatReader" ...]
 void CompositeDataReader::CreateDeserializers(const ConfigParameters& readerConfig)
 {
-    argvector<ConfigValue> deserializerConfigs =
-        readerConfig(L"deserializers", ConfigParameters::Array(argvector<ConfigValue>(vector<ConfigValue> {})));
+    // For corpora that fit in memory: chunks are read and parsed in the first sweep only, later sweeps just reshuffle them.
+    // Can be set for the whole reader or per deserializer.
+    bool keepDataInMemory = readerConfig(L"keepDataInMemory", false);
 
     assert(m_deserializers.empty());
     bool primary = true;  // Currently, the first deserializer becomes primary - it drives chunking.
+    for (const auto& p : GetDeserializerConfigs(readerConfig))
+    {
+        IDataDeserializerPtr d = CreateDeserializer(p, primary);
+        if (p(L"keepDataInMemory", keepDataInMemory))
+            d = std::make_shared<ChunkCache>(d);
+        primary = false;
+        m_deserializers.push_back(d);
+
+        // Create transformers if necessary.
+        CreateTransforms(p);
+    }
+}
+
+// Gets the configs of the deserializers, with the settings of the reader they depend on.
+std::vector<ConfigParameters> CompositeDataReader::GetDeserializerConfigs(const ConfigParameters& readerConfig)
+{
+    argvector<ConfigValue> deserializerConfigs =
+        readerConfig(L"deserializers", ConfigParameters::Array(argvector<ConfigValue>(vector<ConfigValue> {})));
+
+    std::vector<ConfigParameters> result;
     for (size_t i = 0; i < deserializerConfigs.size(); ++i)
     {
         // TODO: Should go away in the future. Framing can be done on top of deserializers.
         ConfigParameters p = deserializerConfigs[i];
         p.Insert("frameMode", m_packingMode == PackingMode::sample ? "true" : "false");
         p.Insert("precision", m_precision);
-
-        IDataDeserializerPtr d = CreateDeserializer(p, primary);
-        primary = false;
-        m_deserializers.push_back(d);
+        result.push_back(p);
     }
+    return result;
 }
 
 // Creates a particular deserializer based on the config: its loads the external module and calls CreateDeserializer
@@ -216,9 +327,6 @@ IDataDeserializerPtr CompositeDataReader::CreateDeserializer(const ConfigParamet
         RuntimeError("Cannot create deserializer. Please check module and type in the configuration.");
     }
 
-    // Create transformers if necessary.
-    CreateTransforms(deserializerConfig);
-
     assert(d != nullptr);
     return IDataDeserializerPtr(d);
 }
@@ -305,6 +413,79 @@ void CompositeDataReader::StartEpoch(const EpochConfiguration& cfg, const std::m
     ReaderBase::StartEpoch(config, inputDescriptions);
 }
 
+// Serializes the calls of several readers to a deserializer. Chunks are loaded concurrently
+// only if the deserializer supports it.
+class SynchronizedDeserializer : public IDataDeserializer
+{
+public:
+    SynchronizedDeserializer(IDataDeserializerPtr deserializer) : m_deserializer(deserializer) { }
+
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_deserializer->GetStreamDescriptions();
+    }
+
+    ChunkDescriptions GetChunkDescriptions() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_deserializer->GetChunkDescriptions();
+    }
+
+    void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_deserializer->GetSequencesForChunk(chunkId, descriptions);
+    }
+
+    bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& description) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_deserializer->GetSequenceDescription(primary, description);
+    }
+
+    ChunkPtr GetChunk(ChunkIdType chunkId) override
+    {
+        if (m_deserializer->SupportsConcurrentChunkLoads())
+            return m_deserializer->GetChunk(chunkId);
+
+        std::lock_guard<std::mutex> lock(m_chunkMutex);
+        return m_deserializer->GetChunk(chunkId);
+    }
+
+    bool SupportsConcurrentChunkLoads() const override
+    {
+        return m_deserializer->SupportsConcurrentChunkLoads();
+    }
+
+    void ReadAhead(const std::vector<ChunkIdType>& chunkIds) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_deserializer->ReadAhead(chunkIds);
+    }
+
+    void FetchAhead(const std::vector<ChunkIdType>& chunkIds) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_deserializer->FetchAhead(chunkIds);
+    }
+
+private:
+    IDataDeserializerPtr m_deserializer;
+    std::mutex m_mutex;      // for the descriptions
+    std::mutex m_chunkMutex; // for the chunk loads
+
+    DISABLE_COPY_AND_MOVE(SynchronizedDeserializer);
+};
+
+IDataDeserializerPtr CompositeDataReader::GetSharedDeserializer()
+{
+    if (!m_bundledDeserializer)
+        LogicError("CompositeDataReader: Only readers that created their deserializers can share them.");
+    if (!m_sharedDeserializer)
+        m_sharedDeserializer = std::make_shared<SynchronizedDeserializer>(m_bundledDeserializer);
+    return m_sharedDeserializer;
+}
+
 bool CompositeDataReader::ContainsDeserializer(const ConfigParameters& readerConfig, const wstring& type)
 {
     argvector<ConfigValue> deserializerConfigs =
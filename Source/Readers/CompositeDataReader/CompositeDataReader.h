@@ -12,6 +12,7 @@
 #include "ReaderBase.h"
 #include "Transformer.h"
 #include "TransformController.h"
+#include "ReaderThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -57,6 +58,10 @@ class CompositeDataReader : public ReaderBase, protected Plugin
 public:
     CompositeDataReader(const ConfigParameters& parameters);
 
+    // Creates a reader with its own transforms, randomizer and packer that reads from the deserializers of 'shared'
+    // (i.e. their indices are built only once) and uses its reader threads. Used by the shared reader service.
+    CompositeDataReader(const ConfigParameters& parameters, CompositeDataReader& shared);
+
     // Describes the streams this reader produces.
     std::vector<StreamDescriptionPtr> GetStreamDescriptions() override;
 
@@ -64,9 +69,15 @@ public:
     void StartEpoch(const EpochConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
 
 private:
+    CompositeDataReader(const ConfigParameters& parameters, CompositeDataReader* shared);
+
+    std::vector<ConfigParameters> GetDeserializerConfigs(const ConfigParameters& readerConfig);
     void CreateDeserializers(const ConfigParameters& readerConfig);
     void CreateTransforms(const ConfigParameters& deserializerConfig);
 
+    // The deserializer for readers that share the deserializers of this one, serializing the calls of the readers.
+    IDataDeserializerPtr GetSharedDeserializer();
+
     IDataDeserializerPtr CreateDeserializer(const ConfigParameters& readerConfig, bool primary);
     TransformerPtr CreateTransformer(const ConfigParameters& config, const std::string& defaultModule, const std::wstring& transformerType);
 
@@ -94,11 +105,23 @@ private:
     // Corpus descriptor that is shared between deserializers.
     CorpusDescriptorPtr m_corpus;
 
+    // Deserializers bundled together, if there are several.
+    IDataDeserializerPtr m_bundledDeserializer;
+
+    // Same, for readers that share the deserializers of this one.
+    IDataDeserializerPtr m_sharedDeserializer;
+
+    // Threads for deserialization and packing, if enabled.
+    ReaderThreadPoolPtr m_threadPool;
+
     // Precision - "float" or "double".
     std::string m_precision;
 
     // Truncation length for BPTT mode.
     size_t m_truncationLength;
+
+    // Whether the BPTT packer balances the parallel sequences at the end of the epoch.
+    bool m_balanceParallelSequences;
 };
 
 }}}
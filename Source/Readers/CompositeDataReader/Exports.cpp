@@ -11,6 +11,7 @@
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
 #include "CompositeDataReader.h"
+#include "SharedReader.h"
 #include "ReaderShim.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -29,9 +30,17 @@ public:
     }
 };
 
+// With sharedReaderService, the minibatches come from the reader service of the host (see SharedReader.h).
+static Reader* CreateReader(const ConfigParameters& parameters)
+{
+    if (parameters.ExistsCurrent(L"sharedReaderService"))
+        return new SharedReaderClient(parameters);
+    return new CompositeDataReader(parameters);
+}
+
 auto factory = [](const ConfigParameters& parameters) -> ReaderPtr
 {
-    return std::make_shared<CompositeDataReader>(parameters);
+    return ReaderPtr(CreateReader(parameters));
 };
 
 extern "C" DATAREADER_API void GetReaderF(IDataReader** preader)
@@ -46,7 +55,14 @@ extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
 
 extern "C" DATAREADER_API Reader* CreateCompositeDataReader(const ConfigParameters* parameters)
 {
-    return new CompositeDataReader(*parameters);
+    return CreateReader(*parameters);
+}
+
+// Runs the reader service of a host, for the "readerService" action.
+extern "C" DATAREADER_API void RunSharedReaderService(const ConfigParameters* config)
+{
+    SharedReaderService service(*config);
+    service.Run();
 }
 
 }}}
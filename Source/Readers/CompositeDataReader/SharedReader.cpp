@@ -0,0 +1,375 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SharedReader.cpp : A reader service shared by the training processes of a host, and its clients.
+//
+
+#include "stdafx.h"
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+#endif
+
+#include "SharedReader.h"
+#include <chrono>
+#include <cstring>
+#include "CompositeDataReader.h"
+#include "HeapMemoryProvider.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+typedef SharedMinibatchChannel::CommandType CommandType;
+
+SharedReaderService::SharedReaderService(const ConfigParameters& config) :
+    m_stop(false)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    if (!readerConfig.ExistsCurrent(L"precision"))
+        readerConfig.Insert("precision", config(L"precision", "float"));
+
+    wstring name = readerConfig(L"sharedReaderService", L"");
+    if (name.empty())
+        InvalidArgument("readerService: Please name the service with sharedReaderService in the reader section.");
+
+    size_t numConsumers = config(L"numConsumers", (size_t)0);
+    if (numConsumers == 0)
+        InvalidArgument("readerService: Please specify the number of training processes of the host with numConsumers.");
+    size_t ringSizeMB = config(L"ringSizeMB", (size_t)256);
+    m_timeoutSeconds = config(L"timeout", 300.0);
+
+    // The deserializers and their indices are created once, each consumer gets its own pipeline on top of them.
+    auto start = chrono::steady_clock::now();
+    m_reader = make_shared<CompositeDataReader>(readerConfig);
+    for (size_t i = 0; i < numConsumers; ++i)
+        m_pipelines.push_back(make_shared<CompositeDataReader>(readerConfig, *m_reader));
+
+    auto streams = m_pipelines.front()->GetStreamDescriptions();
+    for (const auto& stream : streams)
+        m_inputDescriptions[stream->m_name] = -1; // CPU
+
+    m_channel = make_unique<SharedMinibatchChannel>(name, numConsumers, ringSizeMB << 20, streams);
+    fprintf(stderr, "SharedReaderService: '%ls' is ready for %d consumers after %.1f seconds.\n",
+            name.c_str(), (int)numConsumers, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+}
+
+SharedReaderService::~SharedReaderService()
+{
+}
+
+void SharedReaderService::Run()
+{
+    vector<thread> threads;
+    for (size_t slot = 0; slot < m_pipelines.size(); ++slot)
+    {
+        threads.push_back(thread([this, slot]
+        {
+            try
+            {
+                ServeSlot(slot);
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(m_errorMutex);
+                if (!m_error)
+                    m_error = current_exception();
+                m_stop = true;
+            }
+        }));
+    }
+
+    auto lastActive = chrono::steady_clock::now();
+    while (!m_stop)
+    {
+        m_channel->ServiceBeat();
+
+        auto now = chrono::steady_clock::now();
+        bool active = false;
+        for (size_t slot = 0; slot < m_pipelines.size(); ++slot)
+            active = active || m_channel->IsAttached(slot) || m_channel->IsDetached(slot);
+        if (active)
+            lastActive = now;
+        else if (chrono::duration<double>(now - lastActive).count() > m_timeoutSeconds)
+        {
+            fprintf(stderr, "SharedReaderService: no consumer for %.0f seconds, exiting.\n", m_timeoutSeconds);
+            break;
+        }
+
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+
+    m_stop = true;
+    m_channel->Shutdown();
+    for (auto& t : threads)
+        t.join();
+
+    if (m_error)
+        rethrow_exception(m_error);
+}
+
+void SharedReaderService::ServeSlot(size_t slot)
+{
+    auto& pipeline = *m_pipelines[slot];
+    HeartbeatMonitor consumerMonitor;
+    bool attached = false;
+    bool epochStarted = false;
+    bool reading = false;
+    auto isConsumerAlive = [&]
+    {
+        return !m_stop && m_channel->IsAttached(slot) && consumerMonitor.IsAlive(m_channel->GetSlotHeartbeat(slot), m_timeoutSeconds);
+    };
+
+    while (!m_stop)
+    {
+        if (!m_channel->IsAttached(slot))
+        {
+            if (m_channel->IsDetached(slot))
+                m_channel->ReleaseSlot(slot);
+            attached = false;
+            this_thread::sleep_for(chrono::milliseconds(10));
+            continue;
+        }
+
+        if (!attached)
+        {
+            // A new consumer, it starts with an epoch.
+            attached = true;
+            epochStarted = reading = false;
+            consumerMonitor.Reset(m_channel->GetSlotHeartbeat(slot));
+        }
+
+        if (!isConsumerAlive())
+        {
+            if (!m_stop && m_channel->IsAttached(slot))
+            {
+                fprintf(stderr, "SharedReaderService: the consumer of slot %d did not respond for %.0f seconds, releasing the slot.\n", (int)slot, m_timeoutSeconds);
+                m_channel->ReleaseSlot(slot);
+            }
+            continue;
+        }
+
+        SharedMinibatchChannel::Command command;
+        if (m_channel->TryTakeCommand(slot, command))
+        {
+            size_t samplePosition = ExecuteCommand(slot, command, epochStarted);
+            m_channel->CompleteCommand(slot, samplePosition);
+            reading = epochStarted;
+            continue;
+        }
+
+        if (!reading)
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
+        }
+
+        // A minibatch that is abandoned for a command is read again if the consumer continues from its position.
+        Minibatch minibatch = pipeline.ReadMinibatch();
+        if (m_channel->WriteMinibatch(slot, minibatch, pipeline.GetCurrentSamplePosition(), isConsumerAlive) && minibatch.m_endOfEpoch)
+            reading = false;
+    }
+}
+
+size_t SharedReaderService::ExecuteCommand(size_t slot, const SharedMinibatchChannel::Command& command, bool& epochStarted)
+{
+    auto& pipeline = *m_pipelines[slot];
+    if (command.m_type != CommandType::startEpoch)
+    {
+        if (!epochStarted)
+            LogicError("SharedReaderService: The consumer of slot %d has to start an epoch first.", (int)slot);
+
+        // The minibatches the consumer has not read are dropped, the pipeline continues from where the consumer is.
+        if (pipeline.GetCurrentSamplePosition() != command.m_consumerPosition)
+            pipeline.SetCurrentSamplePosition(command.m_consumerPosition);
+    }
+
+    switch (command.m_type)
+    {
+    case CommandType::startEpoch:
+        pipeline.StartEpoch(command.m_config, m_inputDescriptions);
+        epochStarted = true;
+        break;
+    case CommandType::setConfiguration:
+        pipeline.SetConfiguration(command.m_config, m_inputDescriptions);
+        break;
+    case CommandType::setCurrentSamplePosition:
+        pipeline.SetCurrentSamplePosition(command.m_samplePosition);
+        break;
+    default:
+        LogicError("SharedReaderService: Unknown command %d.", (int)command.m_type);
+    }
+    return pipeline.GetCurrentSamplePosition();
+}
+
+SharedReaderClient::SharedReaderClient(const ConfigParameters& config) :
+    m_slot(0),
+    m_currentSamplePosition(0),
+    m_endOfEpoch(false),
+    m_stopHeartbeat(false),
+    m_currentBufferIndex(0)
+{
+    m_serviceName = (wstring)config(L"sharedReaderService");
+    m_timeoutSeconds = config(L"sharedReaderTimeout", 300.0);
+    m_channel = SharedMinibatchChannel::Open(m_serviceName, m_timeoutSeconds);
+
+    // The slots of consumers that are gone are released by the service, so that a slot can become free while waiting.
+    auto start = chrono::steady_clock::now();
+    while (!m_channel->TryAttach(m_slot))
+    {
+        if (m_channel->IsShutdown() || chrono::duration<double>(chrono::steady_clock::now() - start).count() > m_timeoutSeconds)
+            RuntimeError("All %d slots of the shared reader service '%ls' are taken, please check its numConsumers.",
+                         (int)m_channel->GetNumSlots(), m_serviceName.c_str());
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+
+    m_serviceMonitor.Reset(m_channel->GetServiceHeartbeat());
+    m_heartbeatThread = thread([this]
+    {
+        while (!m_stopHeartbeat)
+        {
+            m_channel->SlotBeat(m_slot);
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
+    });
+
+    fprintf(stderr, "SharedReaderClient: reading from the shared reader service '%ls' (slot %d).\n", m_serviceName.c_str(), (int)m_slot);
+}
+
+SharedReaderClient::~SharedReaderClient()
+{
+    m_stopHeartbeat = true;
+    m_heartbeatThread.join();
+    m_channel->Detach(m_slot);
+}
+
+std::vector<StreamDescriptionPtr> SharedReaderClient::GetStreamDescriptions()
+{
+    return m_channel->GetStreamDescriptions();
+}
+
+void SharedReaderClient::CheckService()
+{
+    if (m_channel->IsShutdown())
+        RuntimeError("The shared reader service '%ls' has stopped, please check its log.", m_serviceName.c_str());
+    if (!m_channel->IsAttached(m_slot))
+        RuntimeError("The shared reader service '%ls' has released the slot of this process.", m_serviceName.c_str());
+    if (!m_serviceMonitor.IsAlive(m_channel->GetServiceHeartbeat(), m_timeoutSeconds))
+        RuntimeError("The shared reader service '%ls' did not respond for %.0f seconds.", m_serviceName.c_str(), m_timeoutSeconds);
+}
+
+size_t SharedReaderClient::SendCommand(SharedMinibatchChannel::Command& command)
+{
+    command.m_consumerPosition = m_currentSamplePosition;
+    size_t samplePosition = m_channel->SendCommand(m_slot, command, [this] { CheckService(); return true; });
+    m_endOfEpoch = false;
+    return samplePosition;
+}
+
+// Same as ReaderBase: page-locked buffers for the streams that go to a GPU, one pool per device.
+void SharedReaderClient::UpdateMemoryProviders(const std::map<std::wstring, int>& inputDescriptions)
+{
+    auto streams = GetStreamDescriptions();
+    if (inputDescriptions.size() == m_requiredInputs.size() &&
+        std::equal(inputDescriptions.begin(), inputDescriptions.end(), m_requiredInputs.begin()) &&
+        !m_memoryProviders.empty())
+        return;
+
+    m_requiredInputs = inputDescriptions;
+    m_memoryProviders.resize(streams.size());
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+        auto input = m_requiredInputs.find(streams[i]->m_name);
+        if (input == m_requiredInputs.end() || input->second < 0)
+        {
+            m_memoryProviders[i] = make_shared<HeapMemoryProvider>();
+            continue;
+        }
+
+        auto& pinnedMemoryProvider = m_pinnedMemoryProviders[input->second];
+        if (!pinnedMemoryProvider)
+            pinnedMemoryProvider = make_shared<CudaMemoryProvider>(input->second);
+        m_memoryProviders[i] = pinnedMemoryProvider;
+    }
+
+    for (auto& pinnedMemoryProvider : m_pinnedMemoryProviders)
+        pinnedMemoryProvider.second->SetMaxCachedBuffers(std::max<size_t>(8, 2 * streams.size()));
+
+    m_streamBuffers.assign(2, vector<StreamBuffer>(streams.size(), StreamBuffer{ nullptr, 0 }));
+    m_currentBufferIndex = 0;
+}
+
+void SharedReaderClient::StartEpoch(const EpochConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
+{
+    if (config.m_totalEpochSizeInSamples == 0)
+        RuntimeError("Epoch size cannot be 0.");
+
+    UpdateMemoryProviders(inputDescriptions);
+
+    SharedMinibatchChannel::Command command{};
+    command.m_type = CommandType::startEpoch;
+    command.m_config = config;
+    m_currentSamplePosition = SendCommand(command);
+}
+
+void SharedReaderClient::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
+{
+    UpdateMemoryProviders(inputDescriptions);
+
+    SharedMinibatchChannel::Command command{};
+    command.m_type = CommandType::setConfiguration;
+    static_cast<ReaderConfiguration&>(command.m_config) = config;
+    m_currentSamplePosition = SendCommand(command);
+}
+
+size_t SharedReaderClient::GetCurrentSamplePosition()
+{
+    return m_currentSamplePosition;
+}
+
+void SharedReaderClient::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    SharedMinibatchChannel::Command command{};
+    command.m_type = CommandType::setCurrentSamplePosition;
+    command.m_samplePosition = currentSamplePosition;
+    m_currentSamplePosition = SendCommand(command);
+}
+
+Minibatch SharedReaderClient::ReadMinibatch()
+{
+    // The service does not produce beyond the end of the epoch.
+    if (m_endOfEpoch)
+        return Minibatch(true);
+
+    SharedMinibatchChannel::MinibatchMessage message;
+    m_channel->ReadMinibatch(m_slot, message, [this] { CheckService(); return true; });
+
+    Minibatch minibatch(message.m_endOfEpoch);
+    auto& buffers = m_streamBuffers[m_currentBufferIndex];
+    for (size_t i = 0; i < message.m_streams.size(); ++i)
+    {
+        const auto& stream = message.m_streams[i];
+        auto& buffer = buffers[i];
+        if (buffer.m_size < stream.m_size)
+        {
+            auto provider = m_memoryProviders[i];
+            buffer.m_data.reset();
+            buffer.m_data.reset(reinterpret_cast<char*>(provider->Alloc(1, stream.m_size)), [provider](char* p) { provider->Free(p); });
+            buffer.m_size = stream.m_size;
+        }
+        memcpy(buffer.m_data.get(), stream.m_data, stream.m_size);
+
+        auto streamMinibatch = make_shared<StreamMinibatch>();
+        streamMinibatch->m_data = buffer.m_data.get();
+        streamMinibatch->m_layout = stream.m_layout;
+        minibatch.m_data.push_back(streamMinibatch);
+    }
+    m_channel->ReleaseMinibatch(m_slot);
+
+    m_currentSamplePosition = message.m_samplePosition;
+    m_endOfEpoch = message.m_endOfEpoch;
+    m_currentBufferIndex = (m_currentBufferIndex + 1) % m_streamBuffers.size();
+    return minibatch;
+}
+
+}}}
@@ -0,0 +1,123 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Config.h"
+#include "Reader.h"
+#include "CudaMemoryProvider.h"
+#include "SharedMinibatchChannel.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class CompositeDataReader;
+
+// A reader service shared by the training processes of a host (e.g. one per GPU), so that the indices of the
+// deserializers are built once per host instead of once per process, and the decoding and transforms of all
+// processes run on one pool of threads. It runs as the "readerService" action of a separate CNTK process per host:
+//     readerService = [
+//         action = "readerService"
+//         reader = [ ... ]          # the reader section of the training processes, including sharedReaderService
+//         numConsumers = 8          # the number of training processes of the host
+//         ringSizeMB = 256          # per consumer, a minibatch can take up to half of it
+//         timeout = 300             # seconds until an unresponsive consumer is dropped, or an idle service exits
+//     ]
+// The training processes use the same reader section, in which sharedReaderService = "<name>" names the service;
+// all consumers of a service have to use the same reader section. The service has one reading pipeline
+// (transforms, randomizer and packer) per consumer, which reads the decimated minibatches of that consumer
+// from the shared deserializers, and hands them over through the shared memory channel (see SharedMinibatchChannel).
+class SharedReaderService
+{
+public:
+    SharedReaderService(const ConfigParameters& config);
+    ~SharedReaderService();
+
+    // Serves the consumers until none has been attached for the timeout.
+    void Run();
+
+private:
+    // Runs the pipeline of a slot for the consumers that attach to it.
+    void ServeSlot(size_t slot);
+
+    size_t ExecuteCommand(size_t slot, const SharedMinibatchChannel::Command& command, bool& epochStarted);
+
+    std::shared_ptr<CompositeDataReader> m_reader;
+    std::vector<std::shared_ptr<CompositeDataReader>> m_pipelines;
+    std::unique_ptr<SharedMinibatchChannel> m_channel;
+
+    // The pipelines pack into heap memory, the consumers copy into their page-locked buffers.
+    std::map<std::wstring, int> m_inputDescriptions;
+
+    double m_timeoutSeconds;
+    std::atomic<bool> m_stop;
+    std::exception_ptr m_error;
+    std::mutex m_errorMutex;
+};
+
+// The reader of a training process that gets its minibatches from a shared reader service of the host,
+// created instead of the composite reader if the reader section contains sharedReaderService = "<name>".
+// The minibatches are copied out of the shared memory into page-locked buffers of the process.
+// The exact reader state is not supported, checkpoints restore the sample position only.
+class SharedReaderClient : public Reader
+{
+public:
+    SharedReaderClient(const ConfigParameters& config);
+    ~SharedReaderClient();
+
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() override;
+
+    void StartEpoch(const EpochConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
+
+    void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
+
+    size_t GetCurrentSamplePosition() override;
+
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
+    Minibatch ReadMinibatch() override;
+
+private:
+    struct StreamBuffer
+    {
+        std::shared_ptr<char> m_data;
+        size_t m_size;
+    };
+
+    void UpdateMemoryProviders(const std::map<std::wstring, int>& inputDescriptions);
+
+    size_t SendCommand(SharedMinibatchChannel::Command& command);
+
+    // Fails if the service has stopped or does not respond.
+    void CheckService();
+
+    std::wstring m_serviceName;
+    std::unique_ptr<SharedMinibatchChannel> m_channel;
+    size_t m_slot;
+    size_t m_currentSamplePosition;
+    bool m_endOfEpoch;
+    double m_timeoutSeconds;
+    HeartbeatMonitor m_serviceMonitor;
+
+    std::thread m_heartbeatThread;
+    std::atomic<bool> m_stopHeartbeat;
+
+    std::map<std::wstring, int> m_requiredInputs;
+    std::vector<MemoryProviderPtr> m_memoryProviders;
+    std::map<int, std::shared_ptr<CudaMemoryProvider>> m_pinnedMemoryProviders;
+
+    // Two sets of buffers, as the minibatch returned last stays valid while the next one is read.
+    std::vector<std::vector<StreamBuffer>> m_streamBuffers;
+    size_t m_currentBufferIndex;
+};
+
+}}}
@@ -133,6 +133,41 @@ size_t ConfigHelper::GetFeatureDimension()
     InvalidArgument("Features must specify dimension: 'dim' property is missing.");
 }
 
+FrameProcessing ConfigHelper::GetFrameProcessing()
+{
+    FrameProcessing result;
+    wstring cmvn = m_config(L"cmvn", L"none");
+    if (AreEqualIgnoreCase(cmvn, L"mean"))
+    {
+        result.m_meanNormalization = true;
+    }
+    else if (AreEqualIgnoreCase(cmvn, L"meanVariance"))
+    {
+        result.m_meanNormalization = result.m_varianceNormalization = true;
+    }
+    else if (!AreEqualIgnoreCase(cmvn, L"none"))
+    {
+        InvalidArgument("Unsupported cmvn '%ls', expected 'none', 'mean' or 'meanVariance'.", cmvn.c_str());
+    }
+
+    if (m_config.Exists(L"specAugment"))
+    {
+        ConfigParameters specAugment = m_config(L"specAugment");
+        result.m_numberOfTimeMasks = specAugment(L"timeMasks", (size_t)0);
+        result.m_maxTimeMaskWidth = specAugment(L"maxTimeMaskWidth", (size_t)0);
+        result.m_numberOfFrequencyMasks = specAugment(L"frequencyMasks", (size_t)0);
+        result.m_maxFrequencyMaskWidth = specAugment(L"maxFrequencyMaskWidth", (size_t)0);
+        result.m_seed = specAugment(L"seed", 0u);
+        if ((result.m_numberOfTimeMasks > 0 && result.m_maxTimeMaskWidth == 0) ||
+            (result.m_numberOfFrequencyMasks > 0 && result.m_maxFrequencyMaskWidth == 0))
+        {
+            InvalidArgument("specAugment masks require a positive maximum width.");
+        }
+    }
+
+    return result;
+}
+
 size_t ConfigHelper::GetLabelDimension()
 {
     if (m_config.Exists(L"labelDim"))
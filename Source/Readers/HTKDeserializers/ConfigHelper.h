@@ -12,6 +12,25 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Per-utterance normalization and SpecAugment-style masking of HTK features, applied to the frames of
+// every utterance when its chunk is paged in. Masked values are set to zero, the mean after normalization.
+struct FrameProcessing
+{
+    bool m_meanNormalization = false;     // subtracts the mean of every dimension over the utterance
+    bool m_varianceNormalization = false; // divides by the standard deviation of every dimension over the utterance
+
+    size_t m_numberOfTimeMasks = 0;       // masks of up to m_maxTimeMaskWidth consecutive frames
+    size_t m_maxTimeMaskWidth = 0;
+    size_t m_numberOfFrequencyMasks = 0;  // masks of up to m_maxFrequencyMaskWidth consecutive dimensions
+    size_t m_maxFrequencyMaskWidth = 0;
+    unsigned int m_seed = 0;              // masks differ every time a chunk is paged in, but are reproducible
+
+    bool IsEnabled() const
+    {
+        return m_meanNormalization || m_numberOfTimeMasks > 0 || m_numberOfFrequencyMasks > 0;
+    }
+};
+
 // A helper class for HTKMLF configuration.
 // Provides typed accessor to config parameters.
 class ConfigHelper
@@ -26,6 +45,11 @@ public:
     // Gets feature dimension.
     size_t GetFeatureDimension();
 
+    // Gets normalization and masking of the features:
+    //     cmvn = "none" | "mean" | "meanVariance"
+    //     specAugment = [ timeMasks = 2 ; maxTimeMaskWidth = 40 ; frequencyMasks = 2 ; maxFrequencyMaskWidth = 8 ; seed = 0 ]
+    FrameProcessing GetFrameProcessing();
+
     // Gets label dimension.
     size_t GetLabelDimension();
 
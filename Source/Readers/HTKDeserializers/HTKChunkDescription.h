@@ -7,7 +7,10 @@
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <cmath>
+#include <random>
 #include "DataDeserializer.h"
+#include "ConfigHelper.h"
 #include "../HTKMLFReader/htkfeatio.h"
 #include "UtteranceDescription.h"
 #include "ssematrix.h"
@@ -26,6 +29,14 @@ class HTKChunkDescription
     // Stores all frames of the chunk consecutively (mutable since this is a cache).
     mutable msra::dbn::matrix m_frames;
 
+    // Alternatively, if the chunk is kept compressed in memory, all frames as 16-bit values,
+    // featureDimension values per frame, and for each utterance and dimension the scale and bias
+    // used to decompress them as in HTK: value = (compressed + bias) / scale.
+    mutable std::vector<short> m_compressedFrames;
+    mutable std::vector<float> m_scales;
+    mutable std::vector<float> m_biases;
+    mutable size_t m_compressedDimension = 0;
+
     // First frames of all utterances. m_firstFrames[utteranceIndex] == index of the first frame of the utterance.
     // Size of m_firstFrames should be equal to the number of utterances.
     std::vector<size_t> m_firstFrames;
@@ -36,6 +47,9 @@ class HTKChunkDescription
     // Chunk id.
     ChunkIdType m_chunkId;
 
+    // Number of times the chunk has been paged in, so that masks differ every time.
+    mutable size_t m_numberOfLoads = 0;
+
 public:
 
     HTKChunkDescription() : m_chunkId(CHUNKID_MAX) { };
@@ -102,10 +116,16 @@ public:
         return result - 1 - m_firstFrames.begin();
     }
 
+    // Returns true if the frames are kept compressed, then they can only be accessed with ExpandUtteranceFrames.
+    bool IsCompressed() const
+    {
+        return !m_compressedFrames.empty();
+    }
+
     // Returns all frames of a given utterance.
     msra::dbn::matrixstripe GetUtteranceFrames(size_t index) const
     {
-        if (!IsInRam())
+        if (!IsInRam() || IsCompressed())
         {
             LogicError("GetUtteranceFrames was called when data have not yet been paged in.");
         }
@@ -115,10 +135,43 @@ public:
         return msra::dbn::matrixstripe(m_frames, ts, n);
     }
 
+    // Expands frames [firstFrame, firstFrame + numFrames) of a given utterance into the frames matrix.
+    void ExpandUtteranceFrames(size_t index, size_t firstFrame, size_t numFrames, msra::dbn::matrix& frames) const
+    {
+        if (!IsInRam())
+        {
+            LogicError("ExpandUtteranceFrames was called when data have not yet been paged in.");
+        }
+
+        assert(firstFrame + numFrames <= m_utterances[index].GetNumberOfFrames());
+        if (!IsCompressed())
+        {
+            frames.resize(m_frames.rows(), numFrames);
+            for (size_t j = 0; j < numFrames; ++j)
+                memcpy(&frames(0, j), &m_frames(0, m_firstFrames[index] + firstFrame + j), m_frames.rows() * sizeof(float));
+            return;
+        }
+
+        const size_t dimension = m_compressedDimension;
+        const float* scales = &m_scales[index * dimension];
+        const float* biases = &m_biases[index * dimension];
+        const short* source = &m_compressedFrames[(m_firstFrames[index] + firstFrame) * dimension];
+        frames.resize(dimension, numFrames);
+        for (size_t j = 0; j < numFrames; ++j, source += dimension)
+        {
+            float* destination = &frames(0, j);
+            for (size_t i = 0; i < dimension; ++i)
+                destination[i] = (source[i] + biases[i]) / scales[i];
+        }
+    }
+
     // Pages-in the data for this chunk.
     // this function supports retrying since we read from the unreliable network, i.e. do not return in a broken state
     // We pass in the feature info variables to check that that data being read has expected properties.
-    void RequireData(const string& featureKind, size_t featureDimension, unsigned int samplePeriod, int verbosity = 0) const
+    // If compress is set, frames are kept as 16-bit values in memory, which halves the memory of the chunk.
+    // The frames of every utterance are normalized and masked as given by processing, before they are compressed.
+    void RequireData(const string& featureKind, size_t featureDimension, unsigned int samplePeriod, int verbosity = 0, bool compress = false,
+                     const FrameProcessing& processing = FrameProcessing()) const
     {
         if (GetNumberOfUtterances() == 0)
         {
@@ -135,14 +188,36 @@ public:
             // feature reader (we reinstantiate it for each block, i.e. we reopen the file actually)
             // if this is the first feature read ever, we explicitly open the first file to get the information such as feature dimension
             msra::asr::htkfeatreader reader;
+            std::seed_seq seed{ processing.m_seed, (unsigned int)m_chunkId, (unsigned int)m_numberOfLoads++ };
+            std::mt19937 maskGenerator(seed);
 
             // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
-            m_frames.resize(featureDimension, m_totalFrames);
-            foreach_index(i, m_utterances)
+            if (compress)
             {
-                // read features for this file
-                auto framesWrapper = GetUtteranceFrames(i);
-                reader.read(m_utterances[i].GetPath(), featureKind, samplePeriod, framesWrapper);
+                // Only a single utterance exists as float at a time.
+                m_compressedDimension = featureDimension;
+                m_compressedFrames.resize(featureDimension * m_totalFrames);
+                m_scales.resize(featureDimension * m_utterances.size());
+                m_biases.resize(featureDimension * m_utterances.size());
+                msra::dbn::matrix utteranceFrames;
+                foreach_index(i, m_utterances)
+                {
+                    utteranceFrames.resize(featureDimension, m_utterances[i].GetNumberOfFrames());
+                    reader.read(m_utterances[i].GetPath(), featureKind, samplePeriod, utteranceFrames);
+                    ProcessUtterance(utteranceFrames, processing, maskGenerator);
+                    CompressUtterance(i, utteranceFrames);
+                }
+            }
+            else
+            {
+                m_frames.resize(featureDimension, m_totalFrames);
+                foreach_index(i, m_utterances)
+                {
+                    // read features for this file
+                    auto framesWrapper = GetUtteranceFrames(i);
+                    reader.read(m_utterances[i].GetPath(), featureKind, samplePeriod, framesWrapper);
+                    ProcessUtterance(framesWrapper, processing, maskGenerator);
+                }
             }
 
             if (verbosity)
@@ -151,13 +226,13 @@ public:
                         m_chunkId,
                         m_utterances.size(),
                         m_totalFrames,
-                        sizeof(float) * m_frames.rows() * m_frames.cols());
+                        GetSizeInBytes());
             }
         }
         catch (...)
         {
             // Releasing all data
-            m_frames.resize(0, 0);
+            ClearData();
             throw;
         }
     }
@@ -181,18 +256,114 @@ public:
                     m_chunkId,
                     m_utterances.size(),
                     m_totalFrames,
-                    sizeof(float) * m_frames.rows() * m_frames.cols());
+                    GetSizeInBytes());
         }
 
         // release frames
-        m_frames.resize(0, 0);
+        ClearData();
     }
 
     private:
         // test if data is in memory at the moment
         bool IsInRam() const
         {
-            return !m_frames.empty();
+            return !m_frames.empty() || !m_compressedFrames.empty();
+        }
+
+        size_t GetSizeInBytes() const
+        {
+            return sizeof(float) * m_frames.rows() * m_frames.cols() +
+                sizeof(short) * m_compressedFrames.size() + sizeof(float) * (m_scales.size() + m_biases.size());
+        }
+
+        void ClearData() const
+        {
+            m_frames.resize(0, 0);
+            // swap to actually free the memory
+            std::vector<short>().swap(m_compressedFrames);
+            std::vector<float>().swap(m_scales);
+            std::vector<float>().swap(m_biases);
+        }
+
+        // Normalizes the frames of an utterance and applies the time and frequency masks.
+        template <class MATRIX>
+        static void ProcessUtterance(MATRIX& frames, const FrameProcessing& processing, std::mt19937& maskGenerator)
+        {
+            if (!processing.IsEnabled())
+                return;
+
+            const size_t dimension = frames.rows();
+            const size_t numFrames = frames.cols();
+            if (processing.m_meanNormalization)
+            {
+                for (size_t i = 0; i < dimension; ++i)
+                {
+                    double sum = 0, sumOfSquares = 0;
+                    for (size_t j = 0; j < numFrames; ++j)
+                    {
+                        sum += frames(i, j);
+                        sumOfSquares += frames(i, j) * (double)frames(i, j);
+                    }
+
+                    const double mean = sum / numFrames;
+                    const double variance = sumOfSquares / numFrames - mean * mean;
+                    const float scale = processing.m_varianceNormalization && variance > 1e-10 ? (float)(1 / std::sqrt(variance)) : 1.0f;
+                    for (size_t j = 0; j < numFrames; ++j)
+                        frames(i, j) = (float)((frames(i, j) - mean) * scale);
+                }
+            }
+
+            // Mask widths are uniform in [0, maximum width], positions uniform over the utterance.
+            for (size_t m = 0; m < processing.m_numberOfTimeMasks; ++m)
+            {
+                size_t width = std::min<size_t>(std::uniform_int_distribution<size_t>(0, processing.m_maxTimeMaskWidth)(maskGenerator), numFrames);
+                size_t first = std::uniform_int_distribution<size_t>(0, numFrames - width)(maskGenerator);
+                for (size_t j = first; j < first + width; ++j)
+                    for (size_t i = 0; i < dimension; ++i)
+                        frames(i, j) = 0;
+            }
+
+            for (size_t m = 0; m < processing.m_numberOfFrequencyMasks; ++m)
+            {
+                size_t width = std::min<size_t>(std::uniform_int_distribution<size_t>(0, processing.m_maxFrequencyMaskWidth)(maskGenerator), dimension);
+                size_t first = std::uniform_int_distribution<size_t>(0, dimension - width)(maskGenerator);
+                for (size_t j = 0; j < numFrames; ++j)
+                    for (size_t i = first; i < first + width; ++i)
+                        frames(i, j) = 0;
+            }
+        }
+
+        // Compresses the frames of an utterance like HTK does (_C feature kind): each dimension
+        // is linearly mapped from [min, max] of the utterance to [-32767, 32767].
+        void CompressUtterance(size_t index, const msra::dbn::matrix& frames) const
+        {
+            const size_t dimension = m_compressedDimension;
+            const size_t numFrames = frames.cols();
+            float* scales = &m_scales[index * dimension];
+            float* biases = &m_biases[index * dimension];
+            for (size_t i = 0; i < dimension; ++i)
+            {
+                float minValue = numFrames > 0 ? frames(i, 0) : 0;
+                float maxValue = minValue;
+                for (size_t j = 1; j < numFrames; ++j)
+                {
+                    minValue = std::min(minValue, frames(i, j));
+                    maxValue = std::max(maxValue, frames(i, j));
+                }
+
+                scales[i] = maxValue > minValue ? 2 * 32767.0f / (maxValue - minValue) : 1.0f;
+                biases[i] = maxValue > minValue ? (maxValue + minValue) / 2 * scales[i] : minValue;
+            }
+
+            short* destination = &m_compressedFrames[m_firstFrames[index] * dimension];
+            for (size_t j = 0; j < numFrames; ++j, destination += dimension)
+            {
+                for (size_t i = 0; i < dimension; ++i)
+                {
+                    float value = std::floor(frames(i, j) * scales[i] - biases[i] + 0.5f);
+                    destination[i] = (short)std::max(-32767.0f, std::min(32767.0f, value));
+                }
+            }
         }
 };
 
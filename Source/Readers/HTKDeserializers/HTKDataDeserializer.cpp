@@ -10,6 +10,7 @@
 #include "ConfigHelper.h"
 #include "Basics.h"
 #include "StringUtil.h"
+#include "ElementTypeUtils.h"
 
 // TODO: This will be removed when dependency on old code is eliminated.
 // Currently this fixes the linking.
@@ -53,9 +54,12 @@ HTKDataDeserializer::HTKDataDeserializer(
         InvalidArgument("Cannot expand utterances of the primary stream %ls, please change your configuration.", inputName.c_str());
     }
 
+    m_compressChunks = cfg(L"compressChunks", false);
+
     ConfigParameters streamConfig = input(inputName);
 
     ConfigHelper config(streamConfig);
+    m_frameProcessing = config.GetFrameProcessing();
     auto context = config.GetContextWindow();
 
     m_elementType = AreEqualIgnoreCase(precision,  L"float") ? ElementType::tfloat : ElementType::tdouble;
@@ -82,6 +86,7 @@ HTKDataDeserializer::HTKDataDeserializer(
     m_frameMode = feature.Find("frameMode", "true");
 
     ConfigHelper config(feature);
+    m_frameProcessing = config.GetFrameProcessing();
     config.CheckFeatureType();
 
     m_verbosity = feature(L"verbosity", 0);
@@ -98,6 +103,8 @@ HTKDataDeserializer::HTKDataDeserializer(
         InvalidArgument("Cannot expand utterances of the primary stream %ls, please change your configuration.", featureName.c_str());
     }
 
+    m_compressChunks = feature(L"compressChunks", false);
+
     InitializeChunkDescriptions(config.GetSequencePaths());
     InitializeStreams(featureName);
     InitializeFeatureInformation();
@@ -326,7 +333,7 @@ private:
 
 // Represents a chunk data in memory. Given up to the randomizer.
 // It is up to the randomizer to decide when to release a particular chunk.
-class HTKDataDeserializer::HTKChunk : public Chunk
+class HTKDataDeserializer::HTKChunk : public Chunk, public std::enable_shared_from_this<HTKDataDeserializer::HTKChunk>
 {
 public:
     HTKChunk(HTKDataDeserializer* parent, ChunkIdType chunkId) : m_parent(parent), m_chunkId(chunkId)
@@ -337,7 +344,7 @@ public:
         // making several attempts
         msra::util::attempt(5, [&]()
         {
-            chunkDescription.RequireData(m_parent->m_featureKind, m_parent->m_ioFeatureDimension, m_parent->m_samplePeriod, m_parent->m_verbosity);
+            chunkDescription.RequireData(m_parent->m_featureKind, m_parent->m_ioFeatureDimension, m_parent->m_samplePeriod, m_parent->m_verbosity, m_parent->m_compressChunks, m_parent->m_frameProcessing);
         });
     }
 
@@ -345,6 +352,9 @@ public:
     virtual void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
     {
         m_parent->GetSequenceById(m_chunkId, sequenceId, result);
+
+        // Uncompressed sequences are views into the chunk frames, they keep the chunk alive.
+        result.back()->m_chunk = shared_from_this();
     }
 
     // Unloads the data from memory.
@@ -452,6 +462,91 @@ private:
     std::vector<double> m_buffer;
 };
 
+// Sequence data for uncompressed chunks: a view into the utterance frames of the chunk.
+// The neighbor frames are stacked when the packer copies the samples into the minibatch,
+// so no per sequence copy of the (augmented) features is made.
+struct HTKStackedFramesSequenceData : DenseSequenceData
+{
+    // Sample i of the sequence is centered at the frame firstFrame + i * frameStep of the utterance.
+    HTKStackedFramesSequenceData(const msra::dbn::matrixstripe& utteranceFrames,
+                                 size_t firstFrame,
+                                 size_t frameStep,
+                                 size_t numberOfSamples,
+                                 const std::pair<size_t, size_t>& augmentationWindow,
+                                 ElementType elementType)
+        : m_frames(&utteranceFrames(0, 0)),
+          m_columnStride(utteranceFrames.getcolstride()),
+          m_numberOfFrames(utteranceFrames.cols()),
+          m_frameDimension(utteranceFrames.rows()),
+          m_firstFrame(firstFrame),
+          m_frameStep(frameStep),
+          m_augmentationWindow(augmentationWindow),
+          m_elementSize(GetSizeByType(elementType))
+    {
+        m_numberOfSamples = (uint32_t)numberOfSamples;
+        if (m_numberOfSamples != numberOfSamples)
+        {
+            RuntimeError("Maximum number of samples per sequence exceeded.");
+        }
+    }
+
+    // Stacks the neighbors of every sample directly into the destination.
+    virtual void CopySamples(size_t firstSample, size_t numberOfSamples, size_t sampleSize, char* destination, size_t destinationStride) override
+    {
+        assert(sampleSize == m_frameDimension * m_elementSize * (m_augmentationWindow.first + m_augmentationWindow.second + 1));
+        UNUSED(sampleSize);
+        for (size_t i = 0; i < numberOfSamples; ++i)
+        {
+            const size_t center = m_firstFrame + (firstSample + i) * m_frameStep;
+            char* sample = destination + i * destinationStride;
+            for (size_t n = 0; n <= m_augmentationWindow.first + m_augmentationWindow.second; ++n)
+            {
+                // Frame indices do not move beyond the boundaries of the utterance, as in AugmentNeighbors.
+                size_t frame = center + n;
+                frame = frame < m_augmentationWindow.first ? 0 : min(frame - m_augmentationWindow.first, m_numberOfFrames - 1);
+                CopyFrame(m_frames + frame * m_columnStride, sample + n * m_frameDimension * m_elementSize);
+            }
+        }
+    }
+
+    // Only used by packers that need the whole sequence in memory, so the samples are materialized on demand.
+    const void* GetDataBuffer() override
+    {
+        if (m_buffer.empty())
+        {
+            size_t sampleSize = m_frameDimension * m_elementSize * (m_augmentationWindow.first + m_augmentationWindow.second + 1);
+            m_buffer.resize(sampleSize * m_numberOfSamples);
+            CopySamples(0, m_numberOfSamples, sampleSize, m_buffer.data(), sampleSize);
+        }
+
+        return m_buffer.data();
+    }
+
+private:
+    void CopyFrame(const float* frame, char* destination) const
+    {
+        if (m_elementSize == sizeof(float))
+        {
+            memcpy(destination, frame, m_frameDimension * sizeof(float));
+            return;
+        }
+
+        double* target = reinterpret_cast<double*>(destination);
+        for (size_t k = 0; k < m_frameDimension; ++k)
+            target[k] = frame[k];
+    }
+
+    const float* m_frames;
+    size_t m_columnStride;
+    size_t m_numberOfFrames;
+    size_t m_frameDimension;
+    size_t m_firstFrame;
+    size_t m_frameStep;
+    std::pair<size_t, size_t> m_augmentationWindow;
+    size_t m_elementSize;
+    std::vector<char> m_buffer;
+};
+
 // Copies a source into a destination with the specified destination offset.
 static void CopyToOffset(const const_array_ref<float>& source, array_ref<float>& destination, size_t offset)
 {
@@ -492,7 +587,52 @@ void HTKDataDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector
     const auto& chunkDescription = m_chunks[chunkId];
     size_t utteranceIndex = m_frameMode ? chunkDescription.GetUtteranceForChunkFrameIndex(id) : id;
     const UtteranceDescription* utterance = chunkDescription.GetUtterance(utteranceIndex);
-    auto utteranceFrames = chunkDescription.GetUtteranceFrames(utteranceIndex);
+
+    if (!chunkDescription.IsCompressed())
+    {
+        if (m_elementType != ElementType::tdouble && m_elementType != ElementType::tfloat)
+        {
+            LogicError("Currently, HTK Deserializer supports only double and float types.");
+        }
+
+        auto utteranceFrames = chunkDescription.GetUtteranceFrames(utteranceIndex);
+        if (m_frameMode)
+        {
+            size_t frameIndex = id - chunkDescription.GetStartFrameIndexInsideChunk(utteranceIndex);
+            r.push_back(make_shared<HTKStackedFramesSequenceData>(utteranceFrames, frameIndex, 0, 1, m_augmentationWindow, m_elementType));
+        }
+        else if (m_expandToPrimary) // Broadcast a single frame to the complete utterance.
+        {
+            r.push_back(make_shared<HTKStackedFramesSequenceData>(utteranceFrames, 0, 0, utterance->GetExpansionLength(), m_augmentationWindow, m_elementType));
+        }
+        else
+        {
+            r.push_back(make_shared<HTKStackedFramesSequenceData>(utteranceFrames, 0, 1, utterance->GetNumberOfFrames(), m_augmentationWindow, m_elementType));
+        }
+        return;
+    }
+
+    // For compressed chunks only the frames that are needed are expanded: in frame mode these are the frame
+    // and its neighbors, the expanded range includes all neighbors that are inside of the utterance.
+    size_t frameIndex = m_frameMode ? id - chunkDescription.GetStartFrameIndexInsideChunk(utteranceIndex) : 0;
+    msra::dbn::matrix expandedFrames;
+    if (chunkDescription.IsCompressed())
+    {
+        size_t firstFrame = 0;
+        size_t endFrame = utterance->GetNumberOfFrames();
+        if (m_frameMode)
+        {
+            firstFrame = frameIndex - min(frameIndex, m_augmentationWindow.first);
+            endFrame = min(endFrame, frameIndex + m_augmentationWindow.second + 1);
+            frameIndex -= firstFrame;
+        }
+
+        chunkDescription.ExpandUtteranceFrames(utteranceIndex, firstFrame, endFrame - firstFrame, expandedFrames);
+    }
+
+    auto utteranceFrames = chunkDescription.IsCompressed() ?
+        msra::dbn::matrixstripe(expandedFrames, 0, expandedFrames.cols()) :
+        chunkDescription.GetUtteranceFrames(utteranceIndex);
 
     // wrapper that allows m[j].size() and m[j][i] as required by augmentneighbors()
     MatrixAsVectorOfVectors utteranceFramesWrapper(utteranceFrames);
@@ -502,7 +642,6 @@ void HTKDataDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector
     if (m_frameMode)
     {
         // For frame mode augment a single frame.
-        size_t frameIndex = id - chunkDescription.GetStartFrameIndexInsideChunk(utteranceIndex);
         auto fillIn = features.col(0);
         AugmentNeighbors(utteranceFramesWrapper, frameIndex, m_augmentationWindow.first, m_augmentationWindow.second, fillIn);
     }
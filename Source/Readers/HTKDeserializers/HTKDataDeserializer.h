@@ -34,6 +34,12 @@ public:
     // Retrieves data for a chunk.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
 
+    // Each chunk is read with its own feature reader, so different chunks can be loaded in parallel.
+    virtual bool SupportsConcurrentChunkLoads() const override
+    {
+        return true;
+    }
+
     // Gets sequence description by the primary one.
     virtual bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription&) override;
 
@@ -85,6 +91,13 @@ private:
     size_t m_ioFeatureDimension = 0;
     std::string m_featureKind;
 
+    // Indicates whether chunks are kept compressed to 16-bit values in memory. Frames are decompressed
+    // when their sequences are requested, so a larger randomization window fits into memory.
+    bool m_compressChunks;
+
+    // Normalization and masking applied to the frames of every utterance when a chunk is paged in.
+    FrameProcessing m_frameProcessing;
+
     // A flag that indicates whether the utterance should be extended to match the lenght of the utterance from the primary deserializer.
     // TODO: This should be moved to the packers when deserializers work in sequence mode only.
     bool m_expandToPrimary;
@@ -63,7 +63,7 @@ std::vector<IDataDeserializerPtr> CreateDeserializers(const ConfigParameters& re
 }
 
 HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
-    : m_seed(0)
+    : m_seed(0), m_balanceParallelSequences(false)
 {
     // TODO: deserializers and transformers will be dynamically loaded
     // from external libraries based on the configuration/brain script.
@@ -82,6 +82,7 @@ HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
     else if (truncated)
     {
         m_packingMode = PackingMode::truncated;
+        m_balanceParallelSequences = readerConfig(L"balanceParallelSequences", false);
     }
     else
     {
@@ -113,7 +114,10 @@ HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
     // TODO: this should be bool. Change when config per deserializer is allowed.
     if (AreEqualIgnoreCase(readMethod, std::wstring(L"blockRandomize")))
     {
-        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, window, bundler, true  /* should Prefetch */, true /* useLegacyRandomization */);
+        // Number of chunks that are loaded in parallel, useful when features reside on network storage.
+        size_t chunkLoadParallelism = readerConfig(L"chunkLoadParallelism", (size_t)1);
+        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, window, bundler, true  /* should Prefetch */, true /* useLegacyRandomization */,
+            false /* multithreadedGetNextSequences */, chunkLoadParallelism);
     }
     else if (AreEqualIgnoreCase(readMethod, std::wstring(L"none")))
     {
@@ -158,7 +162,7 @@ HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
         m_packer = std::make_shared<SequencePacker>(m_sequenceEnumerator, m_streams);
         break;
     case PackingMode::truncated:
-        m_packer = std::make_shared<TruncatedBPTTPacker>(m_sequenceEnumerator, m_streams);
+        m_packer = std::make_shared<TruncatedBPTTPacker>(m_sequenceEnumerator, m_streams, 2, m_balanceParallelSequences);
         break;
     default:
         LogicError("Unsupported type of packer '%d'.", (int)m_packingMode);
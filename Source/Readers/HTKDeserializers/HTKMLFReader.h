@@ -44,6 +44,9 @@ private:
     // Truncation length for BPTT mode.
     size_t m_truncationLength;
 
+    // Whether the BPTT packer balances the parallel sequences at the end of the epoch.
+    bool m_balanceParallelSequences;
+
     // Parallel sequences, used for legacy configs.
     intargvector m_numParallelSequencesForAllEpochs;
 };
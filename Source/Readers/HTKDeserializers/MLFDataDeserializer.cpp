@@ -7,6 +7,7 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <limits>
+#include <sys/stat.h>
 #include "MLFDataDeserializer.h"
 #include "ConfigHelper.h"
 #include "SequenceData.h"
@@ -40,12 +41,6 @@ public:
     }
 };
 
-// Inner class for an utterance.
-struct MLFUtterance : SequenceDescription
-{
-    size_t m_sequenceStart;
-};
-
 MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& cfg, bool primary)
 {
     // TODO: This should be read in one place, potentially given by SGD.
@@ -75,7 +70,8 @@ MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const Confi
     size_t dimension = config.GetLabelDimension();
 
     wstring labelMappingFile = streamConfig(L"labelMappingFile", L"");
-    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension);
+    wstring labelCacheFile = streamConfig(L"labelCacheFile", L"");
+    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension, labelCacheFile);
     InitializeStream(inputName, dimension);
 }
 
@@ -101,20 +97,134 @@ MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const Confi
     m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
 
     wstring labelMappingFile = labelConfig(L"labelMappingFile", L"");
-    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension);
+    wstring labelCacheFile = labelConfig(L"labelCacheFile", L"");
+    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension, labelCacheFile);
     InitializeStream(name, dimension);
 }
 
+// Signature of the label source, so that a cache file built from different MLFs or a different state list is not used.
+// Files are identified by their path, size and modification time, so that an edit that keeps the size is noticed.
+static uint64_t GetLabelSourceSignature(const vector<wstring>& mlfPaths, const wstring& stateListPath)
+{
+    // FNV-1a over the paths and sizes.
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const void* data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= ((const unsigned char*)data)[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    vector<wstring> paths(mlfPaths);
+    if (!stateListPath.empty())
+        paths.push_back(stateListPath);
+
+    for (const auto& path : paths)
+    {
+        add(path.c_str(), path.size() * sizeof(wchar_t));
+        int64_t status[2] = { -1, -1 };
+#ifdef _WIN32
+        struct _stat64 buf;
+        if (_wstat64(path.c_str(), &buf) == 0)
+#else
+        struct stat buf;
+        if (stat(msra::strfun::utf8(path).c_str(), &buf) == 0)
+#endif
+        {
+            status[0] = (int64_t)buf.st_size;
+            status[1] = (int64_t)buf.st_mtime;
+        }
+        add(status, sizeof(status));
+    }
+    return hash;
+}
+
 // Currently we create a single chunk only.
-void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const wstring& stateListPath, size_t dimension)
+void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const wstring& stateListPath, size_t dimension,
+                                                      const wstring& cacheFile)
 {
     // TODO: Similarly to the old reader, currently we assume all Mlfs will have same root name (key)
     // restrict MLF reader to these files--will make stuff much faster without having to use shortened input files
+    vector<wstring> mlfPaths = config.GetMlfPaths();
+
+    uint64_t signature = GetLabelSourceSignature(mlfPaths, stateListPath);
+    if (!cacheFile.empty() && m_labels.TryLoad(cacheFile, signature))
+    {
+        fprintf(stderr, "MLFDataDeserializer::MLFDataDeserializer: loaded labels from the cache file %ls\n", cacheFile.c_str());
+    }
+    else
+    {
+        ParseMlf(mlfPaths, stateListPath, dimension);
+        if (!cacheFile.empty())
+            m_labels.Save(cacheFile, signature);
+    }
+
+    if (m_labels.GetNumberOfClasses() > dimension)
+    {
+        RuntimeError("Class id %d exceeds the model output dimension %d.", (int)m_labels.GetNumberOfClasses() - 1, (int)dimension);
+    }
+
+    // TODO resize m_keyToSequence with number of IDs from string registry
+    size_t totalFrames = 0;
+    for (size_t utterance = 0; utterance < m_labels.GetNumberOfUtterances(); ++utterance)
+    {
+        const auto& key = m_labels.GetKey(utterance);
+        if (!corpus->IsIncluded(key))
+            continue;
+
+        size_t id = corpus->KeyToId(key);
+        if (m_keyToSequence.size() <= id)
+        {
+            m_keyToSequence.resize(id + 1, SIZE_MAX);
+        }
+        assert(m_keyToSequence[id] == SIZE_MAX);
+        m_keyToSequence[id] = utterance;
+        m_numberOfSequences++;
+        totalFrames += m_labels.GetNumberOfFrames(utterance);
+    }
+
+    m_totalNumberOfFrames = totalFrames;
+
+    fprintf(stderr, "MLFDataDeserializer::MLFDataDeserializer: %" PRIu64 " utterances with %" PRIu64 " frames in %" PRIu64 " classes "
+            "(%" PRIu64 " label runs)\n",
+            m_numberOfSequences,
+            m_totalNumberOfFrames,
+            m_labels.GetNumberOfClasses(),
+            m_labels.GetNumberOfRuns());
+
+    // Initializing array of labels.
+    m_categories.reserve(dimension);
+    m_categoryIndices.reserve(dimension);
+    for (size_t i = 0; i < dimension; ++i)
+    {
+        auto category = make_shared<CategorySequenceData>();
+        m_categoryIndices.push_back(static_cast<IndexType>(i));
+        category->m_indices = &(m_categoryIndices[i]);
+        category->m_nnzCounts.resize(1);
+        category->m_nnzCounts[0] = 1;
+        category->m_totalNnzCount = 1;
+        category->m_numberOfSamples = 1;
+        if (m_elementType == ElementType::tfloat)
+        {
+            category->m_data = &s_oneFloat;
+        }
+        else
+        {
+            assert(m_elementType == ElementType::tdouble);
+            category->m_data = &s_oneDouble;
+        }
+        m_categories.push_back(category);
+    }
+}
 
+// Parses the MLF files into the label store.
+void MLFDataDeserializer::ParseMlf(const vector<wstring>& mlfPaths, const wstring& stateListPath, size_t dimension)
+{
     // TODO: currently we do not use symbol and word tables.
     const msra::lm::CSymbolSet* wordTable = nullptr;
     unordered_map<const char*, int>* symbolTable = nullptr;
-    vector<wstring> mlfPaths = config.GetMlfPaths();
 
     // TODO: Currently we still use the old IO module. This will be refactored later.
     const double htkTimeToFrame = 100000.0; // default is 10ms
@@ -127,24 +237,9 @@ void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus
         msra::lattices::lattice::htkmlfwordsequence >> ::value,
         "Type 'msra::asr::htkmlfreader' should be move constructible!");
 
-    MLFUtterance description;
-    size_t numClasses = 0;
-    size_t totalFrames = 0;
-
-    // TODO resize m_keyToSequence with number of IDs from string registry
     for (const auto& l : labels)
     {
-        auto key = msra::strfun::utf8(l.first);
-        if (!corpus->IsIncluded(key))
-            continue;
-
-        size_t id = corpus->KeyToId(key);
-        description.m_key.m_sequence = id;
-
         const auto& utterance = l.second;
-        description.m_sequenceStart = m_classIds.size();
-        uint32_t numberOfFrames = 0;
-
         foreach_index(i, utterance)
         {
             const auto& timespan = utterance[i];
@@ -169,58 +264,10 @@ void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus
                 RuntimeError("Maximum number of sample per sequence exceeded.");
             }
 
-            numClasses = max(numClasses, (size_t)(1u + timespan.classid));
-
-            for (size_t t = timespan.firstframe; t < timespan.firstframe + timespan.numframes; t++)
-            {
-                m_classIds.push_back(timespan.classid);
-                numberOfFrames++;
-            }
-        }
-
-        description.m_numberOfSamples = numberOfFrames;
-        m_utteranceIndex.push_back(totalFrames);
-        totalFrames += numberOfFrames;
-
-        if (m_keyToSequence.size() <= description.m_key.m_sequence)
-        {
-            m_keyToSequence.resize(description.m_key.m_sequence + 1, SIZE_MAX);
+            m_labels.AddFrames(timespan.classid, timespan.numframes);
         }
-        assert(m_keyToSequence[description.m_key.m_sequence] == SIZE_MAX);
-        m_keyToSequence[description.m_key.m_sequence] = m_utteranceIndex.size() - 1;
-        m_numberOfSequences++;
-    }
-    m_utteranceIndex.push_back(totalFrames);
 
-    m_totalNumberOfFrames = totalFrames;
-
-    fprintf(stderr, "MLFDataDeserializer::MLFDataDeserializer: %" PRIu64 " utterances with %" PRIu64 " frames in %" PRIu64 " classes\n",
-            m_numberOfSequences,
-            m_totalNumberOfFrames,
-            numClasses);
-
-    // Initializing array of labels.
-    m_categories.reserve(dimension);
-    m_categoryIndices.reserve(dimension);
-    for (size_t i = 0; i < dimension; ++i)
-    {
-        auto category = make_shared<CategorySequenceData>();
-        m_categoryIndices.push_back(static_cast<IndexType>(i));
-        category->m_indices = &(m_categoryIndices[i]);
-        category->m_nnzCounts.resize(1);
-        category->m_nnzCounts[0] = 1;
-        category->m_totalNnzCount = 1;
-        category->m_numberOfSamples = 1;
-        if (m_elementType == ElementType::tfloat)
-        {
-            category->m_data = &s_oneFloat;
-        }
-        else
-        {
-            assert(m_elementType == ElementType::tdouble);
-            category->m_data = &s_oneDouble;
-        }
-        m_categories.push_back(category);
+        m_labels.FinishUtterance(msra::strfun::utf8(l.first));
     }
 }
 
@@ -295,15 +342,14 @@ void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceData
 {
     if (m_frameMode)
     {
-        size_t label = m_classIds[sequenceId];
+        size_t label = m_labels.GetClassId(sequenceId);
         assert(label < m_categories.size());
         result.push_back(m_categories[label]);
     }
     else
     {
         // Packing labels for the utterance into sparse sequence.
-        size_t startFrameIndex = m_utteranceIndex[sequenceId];
-        size_t numberOfSamples = m_utteranceIndex[sequenceId + 1] - startFrameIndex;
+        size_t numberOfSamples = m_labels.GetNumberOfFrames(sequenceId);
         SparseSequenceDataPtr s;
         if (m_elementType == ElementType::tfloat)
         {
@@ -315,12 +361,7 @@ void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceData
             s = make_shared<MLFSequenceData<double>>(numberOfSamples);
         }
 
-        for (size_t i = 0; i < numberOfSamples; i++)
-        {
-            size_t frameIndex = startFrameIndex + i;
-            size_t label = m_classIds[frameIndex];
-            s->m_indices[i] = static_cast<IndexType>(label);
-        }
+        m_labels.GetClassIds(sequenceId, s->m_indices);
         result.push_back(s);
     }
 }
@@ -340,7 +381,7 @@ bool MLFDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, Sequen
 
     if (m_frameMode)
     {
-        size_t index = m_utteranceIndex[sequenceId] + key.m_sample;
+        size_t index = m_labels.GetFirstFrame(sequenceId) + key.m_sample;
         result.m_id = index;
         result.m_numberOfSamples = 1;
     }
@@ -348,7 +389,7 @@ bool MLFDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, Sequen
     {
         assert(result.m_key.m_sample == 0);
         result.m_id = sequenceId;
-        result.m_numberOfSamples = (uint32_t) (m_utteranceIndex[sequenceId + 1] - m_utteranceIndex[sequenceId]);
+        result.m_numberOfSamples = (uint32_t) m_labels.GetNumberOfFrames(sequenceId);
     }
     return true;
 }
@@ -7,8 +7,8 @@
 
 #include "DataDeserializer.h"
 #include "HTKDataDeserializer.h"
-#include "../HTKMLFReader/biggrowablevectors.h"
 #include "CorpusDescriptor.h"
+#include "MLFLabelStore.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -37,11 +37,19 @@ public:
     // TODO: After we switch the timeline to work in chunks, we will also introduce chunking of labels.
     virtual ChunkPtr GetChunk(ChunkIdType) override;
 
+    // All labels are already in memory, creating the chunk does not touch any shared state.
+    virtual bool SupportsConcurrentChunkLoads() const override
+    {
+        return true;
+    }
+
 private:
     class MLFChunk;
     DISABLE_COPY_AND_MOVE(MLFDataDeserializer);
 
-    void InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const std::wstring& stateListPath, size_t dimension);
+    void InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const std::wstring& stateListPath, size_t dimension,
+                                     const std::wstring& cacheFile);
+    void ParseMlf(const std::vector<std::wstring>& mlfPaths, const std::wstring& stateListPath, size_t dimension);
     void InitializeStream(const std::wstring& name, size_t dimension);
 
     void GetSequenceById(size_t sequenceId, std::vector<SequenceDataPtr>& result);
@@ -54,11 +62,9 @@ private:
     // Number of sequences
     size_t m_numberOfSequences = 0;
 
-    // Array of all labels.
-    msra::dbn::biggrowablevector<msra::dbn::CLASSIDTYPE> m_classIds;
-
-    // Index of utterances in the m_classIds.
-    msra::dbn::biggrowablevector<size_t> m_utteranceIndex;
+    // Labels of all utterances of the MLF, including the ones not in the corpus.
+    // Sequence ids are utterance indices in the store in sequence mode and frame indices in frame mode.
+    MLFLabelStore m_labels;
 
     // Type of the data this serializer provides.
     ElementType m_elementType;
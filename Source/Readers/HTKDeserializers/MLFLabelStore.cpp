@@ -0,0 +1,308 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "MLFLabelStore.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include "fileutil.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Layout of the cache file: the header, followed by
+// frame offsets (uint64_t[N + 1]), run offsets (uint64_t[N + 1]), runs (LabelRun[numberOfRuns])
+// and the keys of all utterances as 0-terminated strings (keysSize bytes).
+// All sections are 8 byte aligned, the file is in the byte order of the machine that wrote it.
+struct MLFLabelStoreHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_reserved;
+    uint64_t m_signature;
+    uint64_t m_numberOfUtterances;
+    uint64_t m_numberOfRuns;
+    uint64_t m_numberOfClasses;
+    uint64_t m_keysSize;
+};
+
+static const char s_magic[8] = { 'C', 'N', 'T', 'K', 'M', 'L', 'F', '\0' };
+static const uint32_t s_version = 1;
+
+static_assert(sizeof(MLFLabelStoreHeader) % 8 == 0, "Header size must keep the sections aligned.");
+static_assert(sizeof(MLFLabelStore::LabelRun) == 8, "Unexpected size of a label run.");
+
+MLFLabelStore::MLFLabelStore()
+    : m_mappedData(nullptr),
+      m_mappedSize(0)
+#ifdef _WIN32
+      , m_fileHandle(INVALID_HANDLE_VALUE),
+      m_mappingHandle(NULL)
+#endif
+{
+    Clear();
+}
+
+MLFLabelStore::~MLFLabelStore()
+{
+    UnmapFile();
+}
+
+void MLFLabelStore::Clear()
+{
+    m_runBuffer.clear();
+    m_runOffsetBuffer.assign(1, 0);
+    m_frameOffsetBuffer.assign(1, 0);
+    m_runs = m_runBuffer.data();
+    m_runOffsets = m_runOffsetBuffer.data();
+    m_frameOffsets = m_frameOffsetBuffer.data();
+    m_numberOfUtterances = 0;
+    m_numberOfClasses = 0;
+    m_currentFrames = 0;
+}
+
+void MLFLabelStore::AddFrames(size_t classId, size_t numberOfFrames)
+{
+    if (m_mappedData != nullptr)
+        LogicError("Cannot add frames to a label store loaded from a cache file.");
+
+    if (numberOfFrames == 0)
+        return;
+
+    if (classId > numeric_limits<uint32_t>::max() || m_currentFrames + numberOfFrames > numeric_limits<uint32_t>::max())
+        RuntimeError("Class id or number of frames of an utterance exceeds the capacity of the label store.");
+
+    bool continuesRun = m_runBuffer.size() > m_runOffsetBuffer.back() && m_runBuffer.back().m_classId == classId;
+    if (!continuesRun)
+    {
+        LabelRun run;
+        run.m_classId = (uint32_t)classId;
+        run.m_firstFrame = m_currentFrames;
+        m_runBuffer.push_back(run);
+    }
+
+    m_currentFrames += (uint32_t)numberOfFrames;
+    m_numberOfClasses = max(m_numberOfClasses, classId + 1);
+}
+
+void MLFLabelStore::FinishUtterance(const string& key)
+{
+    if (m_keys.Contains(key))
+        RuntimeError("Duplicate utterance key '%s' in the labels.", key.c_str());
+
+    m_keys.AddValue(key);
+    m_runOffsetBuffer.push_back(m_runBuffer.size());
+    m_frameOffsetBuffer.push_back(m_frameOffsetBuffer.back() + m_currentFrames);
+    m_currentFrames = 0;
+    m_numberOfUtterances++;
+
+    m_runs = m_runBuffer.data();
+    m_runOffsets = m_runOffsetBuffer.data();
+    m_frameOffsets = m_frameOffsetBuffer.data();
+}
+
+size_t MLFLabelStore::GetClassId(size_t frame) const
+{
+    // Utterance that contains the frame, then the run within the utterance.
+    const uint64_t* frameOffsetsEnd = m_frameOffsets + m_numberOfUtterances + 1;
+    size_t utterance = upper_bound(m_frameOffsets, frameOffsetsEnd, (uint64_t)frame) - m_frameOffsets - 1;
+    assert(utterance < m_numberOfUtterances);
+
+    uint32_t localFrame = (uint32_t)(frame - m_frameOffsets[utterance]);
+    const LabelRun* begin = m_runs + m_runOffsets[utterance];
+    const LabelRun* end = m_runs + m_runOffsets[utterance + 1];
+    const LabelRun* run = upper_bound(begin, end, localFrame, [](uint32_t f, const LabelRun& r) { return f < r.m_firstFrame; }) - 1;
+    return run->m_classId;
+}
+
+void MLFLabelStore::Save(const wstring& fileName, uint64_t signature) const
+{
+    vector<char> keys;
+    for (size_t i = 0; i < m_numberOfUtterances; ++i)
+    {
+        const string& key = m_keys[i];
+        keys.insert(keys.end(), key.c_str(), key.c_str() + key.size() + 1);
+    }
+    keys.resize((keys.size() + 7) / 8 * 8, '\0');
+
+    MLFLabelStoreHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_magic, s_magic, sizeof(s_magic));
+    header.m_version = s_version;
+    header.m_signature = signature;
+    header.m_numberOfUtterances = m_numberOfUtterances;
+    header.m_numberOfRuns = GetNumberOfRuns();
+    header.m_numberOfClasses = m_numberOfClasses;
+    header.m_keysSize = keys.size();
+
+    // Written under a temporary name first, so that concurrent jobs never see a partial file.
+    // The name is unique to the process, as all workers of a distributed job may save the same cache at once.
+    wstring tempFileName = fileName + L".tmp" + to_wstring(GetCurrentProcessId());
+    FILE* f = fopenOrDie(tempFileName, L"wb");
+    fwriteOrDie(&header, sizeof(header), 1, f);
+    fwriteOrDie(m_frameOffsets, sizeof(uint64_t), m_numberOfUtterances + 1, f);
+    fwriteOrDie(m_runOffsets, sizeof(uint64_t), m_numberOfUtterances + 1, f);
+    if (header.m_numberOfRuns > 0)
+        fwriteOrDie(m_runs, sizeof(LabelRun), (size_t)header.m_numberOfRuns, f);
+    fwriteOrDie(keys, f);
+    fcloseOrDie(f);
+
+    try
+    {
+        renameOrDie(tempFileName, fileName);
+    }
+    catch (const exception&)
+    {
+        // Another process has saved the same cache meanwhile (and may use it already).
+        _wunlink(tempFileName.c_str());
+        if (!fexists(fileName))
+            throw;
+    }
+}
+
+bool MLFLabelStore::TryLoad(const wstring& fileName, uint64_t signature)
+{
+    if (m_numberOfUtterances > 0 || m_mappedData != nullptr)
+        LogicError("A label store can only be loaded when it is empty.");
+
+    if (!fexists(fileName))
+        return false;
+
+#ifdef _WIN32
+    m_fileHandle = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(MLFLabelStoreHeader))
+    {
+        UnmapFile();
+        return false;
+    }
+
+    m_mappingHandle = CreateFileMappingW(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mappingHandle != NULL)
+        m_mappedData = (const char*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (m_mappedData == nullptr)
+    {
+        UnmapFile();
+        return false;
+    }
+    m_mappedSize = (size_t)fileSize.QuadPart;
+#else
+    int fileDescriptor = open(msra::strfun::utf8(fileName).c_str(), O_RDONLY);
+    if (fileDescriptor == -1)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) == -1 || fileStat.st_size < (off_t)sizeof(MLFLabelStoreHeader))
+    {
+        close(fileDescriptor);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (data == MAP_FAILED)
+        return false;
+
+    m_mappedData = (const char*)data;
+    m_mappedSize = (size_t)fileStat.st_size;
+#endif
+
+    MLFLabelStoreHeader header;
+    memcpy(&header, m_mappedData, sizeof(header));
+    uint64_t offsetsSize = (header.m_numberOfUtterances + 1) * sizeof(uint64_t);
+    uint64_t expectedSize = sizeof(header) + 2 * offsetsSize + header.m_numberOfRuns * sizeof(LabelRun) + header.m_keysSize;
+    if (memcmp(header.m_magic, s_magic, sizeof(s_magic)) != 0 ||
+        header.m_version != s_version ||
+        header.m_signature != signature ||
+        expectedSize != m_mappedSize)
+    {
+        UnmapFile();
+        return false;
+    }
+
+    const char* position = m_mappedData + sizeof(header);
+    m_frameOffsets = reinterpret_cast<const uint64_t*>(position);
+    position += offsetsSize;
+    m_runOffsets = reinterpret_cast<const uint64_t*>(position);
+    position += offsetsSize;
+    m_runs = reinterpret_cast<const LabelRun*>(position);
+    position += header.m_numberOfRuns * sizeof(LabelRun);
+    m_numberOfUtterances = (size_t)header.m_numberOfUtterances;
+    m_numberOfClasses = (size_t)header.m_numberOfClasses;
+
+    if (m_runOffsets[m_numberOfUtterances] != header.m_numberOfRuns)
+    {
+        UnmapFile();
+        Clear();
+        return false;
+    }
+
+    // Only the keys are copied out of the file.
+    vector<string> keys;
+    keys.reserve(m_numberOfUtterances);
+    const char* keysEnd = position + header.m_keysSize;
+    for (size_t i = 0; i < m_numberOfUtterances; ++i)
+    {
+        const char* keyEnd = find(position, keysEnd, '\0');
+        if (keyEnd == keysEnd)
+        {
+            UnmapFile();
+            Clear();
+            return false;
+        }
+
+        keys.push_back(string(position, keyEnd));
+        position = keyEnd + 1;
+    }
+
+    for (const auto& key : keys)
+        m_keys.AddValue(key);
+    return true;
+}
+
+#ifdef _WIN32
+
+void MLFLabelStore::UnmapFile()
+{
+    if (m_mappedData != nullptr)
+        UnmapViewOfFile(m_mappedData);
+    if (m_mappingHandle != NULL)
+        CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+
+    m_mappedData = nullptr;
+    m_mappingHandle = NULL;
+    m_fileHandle = INVALID_HANDLE_VALUE;
+    m_mappedSize = 0;
+}
+
+#else
+
+void MLFLabelStore::UnmapFile()
+{
+    if (m_mappedData != nullptr)
+        munmap(const_cast<char*>(m_mappedData), m_mappedSize);
+
+    m_mappedData = nullptr;
+    m_mappedSize = 0;
+}
+
+#endif
+
+}}}
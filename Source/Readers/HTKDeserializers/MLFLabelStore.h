@@ -0,0 +1,135 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Basics.h"
+#include "StringToIdMap.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Compact columnar store of the labels of all utterances of a set of MLF files:
+// - the state ids of all utterances are run-length encoded in one contiguous array of runs,
+// - per utterance there is an offset into the runs and an offset into the frames (both of size N + 1),
+// - the utterance keys are interned in a StringToIdMap, the id of a key is the index of its utterance.
+// The store can be saved to a binary cache file; the runs and offsets of a loaded cache are used
+// in place from a read-only memory mapping of the file, so that later jobs neither parse the MLF
+// nor allocate memory proportional to the number of frames.
+class MLFLabelStore
+{
+public:
+    // A run of frames with the same state id, the first frame is relative to the start of the utterance.
+    struct LabelRun
+    {
+        uint32_t m_classId;
+        uint32_t m_firstFrame;
+    };
+
+    MLFLabelStore();
+    ~MLFLabelStore();
+
+    // Appends numberOfFrames frames of the class to the current utterance, merging them with the previous run if possible.
+    void AddFrames(size_t classId, size_t numberOfFrames);
+
+    // Finishes the current utterance under the given key. The key must be unique.
+    void FinishUtterance(const std::string& key);
+
+    // Saves the store to the file; the signature identifies the source it was built from.
+    void Save(const std::wstring& fileName, uint64_t signature) const;
+
+    // Loads the store from the file (which must stay unchanged while the store exists).
+    // Returns false if the file is not a valid cache or was built from a source with a different signature.
+    bool TryLoad(const std::wstring& fileName, uint64_t signature);
+
+    size_t GetNumberOfUtterances() const
+    {
+        return m_numberOfUtterances;
+    }
+
+    size_t GetTotalNumberOfFrames() const
+    {
+        return m_numberOfUtterances == 0 ? 0 : (size_t)m_frameOffsets[m_numberOfUtterances];
+    }
+
+    size_t GetNumberOfRuns() const
+    {
+        return m_numberOfUtterances == 0 ? 0 : (size_t)m_runOffsets[m_numberOfUtterances];
+    }
+
+    // Number of classes, i.e. the maximum class id + 1.
+    size_t GetNumberOfClasses() const
+    {
+        return m_numberOfClasses;
+    }
+
+    const std::string& GetKey(size_t utterance) const
+    {
+        return m_keys[utterance];
+    }
+
+    // Index of the first frame of the utterance in the frames of all utterances.
+    size_t GetFirstFrame(size_t utterance) const
+    {
+        return (size_t)m_frameOffsets[utterance];
+    }
+
+    size_t GetNumberOfFrames(size_t utterance) const
+    {
+        return (size_t)(m_frameOffsets[utterance + 1] - m_frameOffsets[utterance]);
+    }
+
+    // Class id of a frame given by its index in the frames of all utterances.
+    size_t GetClassId(size_t frame) const;
+
+    // Writes the class ids of all frames of the utterance to the output.
+    template <class TIndex>
+    void GetClassIds(size_t utterance, TIndex* output) const
+    {
+        const LabelRun* runs = m_runs + m_runOffsets[utterance];
+        size_t numberOfRuns = (size_t)(m_runOffsets[utterance + 1] - m_runOffsets[utterance]);
+        size_t numberOfFrames = GetNumberOfFrames(utterance);
+        for (size_t i = 0; i < numberOfRuns; ++i)
+        {
+            size_t end = i + 1 < numberOfRuns ? runs[i + 1].m_firstFrame : numberOfFrames;
+            for (size_t t = runs[i].m_firstFrame; t < end; ++t)
+                output[t] = static_cast<TIndex>(runs[i].m_classId);
+        }
+    }
+
+private:
+    void Clear();
+    void UnmapFile();
+
+    // Runs and offsets, either pointing to the buffers below or into the mapped cache file.
+    const LabelRun* m_runs;
+    const uint64_t* m_runOffsets;
+    const uint64_t* m_frameOffsets;
+    size_t m_numberOfUtterances;
+    size_t m_numberOfClasses;
+
+    std::vector<LabelRun> m_runBuffer;
+    std::vector<uint64_t> m_runOffsetBuffer;
+    std::vector<uint64_t> m_frameOffsetBuffer;
+
+    // Frames of the utterance being added.
+    uint32_t m_currentFrames;
+
+    StringToIdMap m_keys;
+
+    // Mapping of the cache file.
+    const char* m_mappedData;
+    size_t m_mappedSize;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#endif
+
+    DISABLE_COPY_AND_MOVE(MLFLabelStore);
+};
+
+}}}
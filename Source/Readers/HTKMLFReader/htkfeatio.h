@@ -342,6 +342,7 @@ class htkfeatreader : protected htkfeatio
     vector<float> a, b;                  // for decompression
     vector<short> tmp;                   // for decompression
     vector<unsigned char> tmpByteVector; // for decompression of idx files
+    vector<float> tmpBlock;              // for reading blocks of frames
     size_t curframe;                     // current # samples read so far
     size_t numframes;                    // number of samples for current logical file
     size_t energyElements;               // how many energy elements to add if addEnergy is true
@@ -678,7 +679,7 @@ public:
         {
             freadOrDie(v, featdim, f);
             if (needbyteswapping)
-                msra::util::byteswap(v);
+                msra::util::byteswap32(&v[0], v.size());
         }
         else if (isidxformat)
         {
@@ -693,7 +694,7 @@ public:
             // read into temp vector
             freadOrDie(tmp, featdim, f);
             if (needbyteswapping)
-                msra::util::byteswap(tmp);
+                msra::util::byteswap16(&tmp[0], tmp.size());
             // 'decompress' it
             v.resize(tmp.size());
             foreach_index (k, v)
@@ -701,10 +702,60 @@ public:
         }
         curframe++;
     }
+    // read a block of vectors [ts,te) from the open file with a single fread
+    // Byte swapping and decompression then run over the whole block rather than per frame.
+    template <class MATRIX>
+    void readblock(MATRIX& feat, size_t ts, size_t te)
+    {
+        const size_t n = te - ts;
+        if (curframe + n > numframes)
+            RuntimeError("htkfeatreader:attempted to read beyond end");
+        const size_t count = n * featdim;
+        tmpBlock.resize(count);
+        if (isidxformat)
+        {
+            tmpByteVector.resize(count);
+            freadOrDie(&tmpByteVector[0], sizeof(tmpByteVector[0]), count, f);
+            for (size_t i = 0; i < count; i++)
+                tmpBlock[i] = (float) tmpByteVector[i];
+        }
+        else if (compressed)
+        {
+            tmp.resize(count);
+            freadOrDie(&tmp[0], sizeof(tmp[0]), count, f);
+            if (needbyteswapping)
+                msra::util::byteswap16(&tmp[0], count);
+            for (size_t t = 0; t < n; t++)
+            {
+                const short* source = &tmp[t * featdim];
+                float* target = &tmpBlock[t * featdim];
+                for (size_t k = 0; k < featdim; k++)
+                    target[k] = (source[k] + b[k]) / a[k];
+            }
+        }
+        else
+        {
+            freadOrDie(&tmpBlock[0], sizeof(tmpBlock[0]), count, f);
+            if (needbyteswapping)
+                msra::util::byteswap32(&tmpBlock[0], count);
+        }
+        for (size_t t = 0; t < n; t++)
+        {
+            const float* source = &tmpBlock[t * featdim];
+            for (size_t k = 0; k < featdim; k++)
+                feat(k, ts + t) = source[k];
+        }
+        curframe += n;
+    }
     // read a sequence of vectors from the open file into a range of frames [ts,te)
     template <class MATRIX>
     void read(MATRIX& feat, size_t ts, size_t te)
     {
+        if (!addEnergy && te > ts)
+        {
+            readblock(feat, ts, te);
+            return;
+        }
         // read vectors from file and push to our target structure
         vector<float> v(featdim + energyElements);
         for (size_t t = ts; t < te; t++)
@@ -173,7 +173,15 @@ class minibatchutterancesourcemulti : public minibatchsource
                 // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
                 frames.resize(featdim, totalframes);
                 if (!latticesource.empty())
+                {
+                    // let the lattices of this chunk be paged in while we read its features
+                    std::vector<std::wstring> keys;
+                    keys.reserve(utteranceset.size());
+                    foreach_index (i, utteranceset)
+                        keys.push_back(utteranceset[i].key());
+                    latticesource.prefetchlattices(keys);
                     lattices.resize(utteranceset.size());
+                }
                 foreach_index (i, utteranceset)
                 {
                     // fprintf (stderr, ".");
@@ -6,11 +6,12 @@
 #pragma once
 #include <opencv2/core/mat.hpp>
 #include "Config.h"
+#include "ConcStack.h"
+#include <vector>
 #ifdef USE_ZIP
 #include <zip.h>
 #include <unordered_map>
 #include <memory>
-#include "ConcStack.h"
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -24,7 +25,26 @@ public:
     virtual void Register(const std::map<std::string, size_t>& sequences) = 0;
     virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) = 0;
 
+    // Hints that the given sequences are about to be read; may start fetching their data in the background.
+    virtual void ReadAhead(const std::vector<size_t>&)
+    {
+    }
+
+    // Allows JPEG images to be decoded at 1/2, 1/4 or 1/8 of their resolution (DCT-domain scaling),
+    // as long as the shorter side of the decoded image stays at least minDecodedSide pixels.
+    // 0 (default) always decodes at full resolution.
+    void SetMinDecodedSide(int minDecodedSide)
+    {
+        m_minDecodedSide = minDecodedSide;
+    }
+
     DISABLE_COPY_AND_MOVE(ByteReader);
+
+protected:
+    // Decodes an encoded image, at reduced resolution if allowed by m_minDecodedSide.
+    cv::Mat Decode(const unsigned char* data, size_t size, bool grayscale) const;
+
+    int m_minDecodedSide = 0;
 };
 
 class FileByteReader : public ByteReader
@@ -37,25 +57,70 @@ public:
     cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
 
     std::string m_expandDirectory;
+
+private:
+    // Buffers for file contents, only used when decoding at reduced resolution.
+    conc_stack<std::vector<unsigned char>> m_workspace;
 };
 
 #ifdef USE_ZIP
+// Reads images from a zip container.
+// Entries are located with the central directory of the archive and read with positional reads
+// of the whole entry, inflated if needed, so concurrent reads do not share any state.
+// Entries that cannot be read this way (i.e. encrypted or compressed with another method) are read with libzip.
 class ZipByteReader : public ByteReader
 {
 public:
-    ZipByteReader(const std::string& zipPath);
+    // If memoryMap is set, the archive is memory mapped and stored (not compressed) entries are decoded in place.
+    ZipByteReader(const std::string& zipPath, bool memoryMap = false);
+    ~ZipByteReader();
 
     void Register(const std::map<std::string, size_t>& sequences) override;
     cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
 
+    // Asks the operating system to fetch the entries in the order they are stored in the archive.
+    void ReadAhead(const std::vector<size_t>& seqIds) override;
+
 private:
     using ZipPtr = std::unique_ptr<zip_t, void(*)(zip_t*)>;
     ZipPtr OpenZip();
 
+    // Location of an entry in the archive.
+    struct Entry
+    {
+        zip_uint64_t m_index;          // index of the entry in libzip
+        zip_uint64_t m_size;           // uncompressed size
+        zip_uint64_t m_compressedSize;
+        zip_uint16_t m_method;
+        uint64_t m_headerOffset;       // offset of the local file header
+        uint64_t m_spanSize;           // bytes up to the next entry (header, data and data descriptor), 0 to read with libzip
+    };
+
+    // Fills m_headerOffsets and m_spanSizes from the central directory, leaves them empty if it cannot be parsed.
+    void ReadCentralDirectory();
+    void ReadAt(uint64_t offset, size_t size, unsigned char* buffer) const;
+    cv::Mat ReadWithLibzip(const Entry& entry, size_t seqId, const std::string& path, bool grayscale);
+
     std::string m_zipPath;
     conc_stack<ZipPtr> m_zips;
-    std::unordered_map<size_t, std::pair<zip_uint64_t, zip_uint64_t>> m_seqIdToIndex;
+    std::unordered_map<size_t, Entry> m_seqIdToEntry;
+    // Buffers for whole entries and for inflated data.
     conc_stack<std::vector<unsigned char>> m_workspace;
+    conc_stack<std::vector<unsigned char>> m_inflated;
+
+    // Local header offsets and span sizes of all entries, by libzip index.
+    std::vector<uint64_t> m_headerOffsets;
+    std::vector<uint64_t> m_spanSizes;
+
+    // The archive for positional reads and its mapping, if any.
+    uint64_t m_fileSize;
+    const unsigned char* m_mapping;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#else
+    int m_fileDescriptor;
+#endif
 };
 #endif
 
@@ -63,6 +63,10 @@ extern "C" DATAREADER_API bool CreateTransformer(Transformer** transformer, cons
         *transformer = new IntensityTransformer(config);
     else if (type == L"Mean")
         *transformer = new MeanTransformer(config);
+    else if (type == L"CropScaleMean")
+        *transformer = new CropScaleMeanTransformer(config);
+    else if (type == L"DeviceAugmentation")
+        *transformer = new DeviceAugmentationTransformer(config);
     else if (type == L"Transpose")
         *transformer = new TransposeTransformer(config);
     else if (type == L"Cast")
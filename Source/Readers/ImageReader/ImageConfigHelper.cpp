@@ -93,8 +93,11 @@ ImageConfigHelper::ImageConfigHelper(const ConfigParameters& config)
     }
 
     m_cpuThreadCount = config(L"numCPUThreads", 0);
+    std::wstring threadAffinity = config(L"threadAffinity", L"none");
+    m_threadAffinity = ParseThreadAffinity(threadAffinity);
 
     m_cropType = ParseCropType(featureSection(L"cropType", ""));
+    m_deviceAugmentation = featureSection(L"deviceAugmentation", false);
 }
 
 std::vector<StreamDescriptionPtr> ImageConfigHelper::GetStreams() const
@@ -9,6 +9,7 @@
 #include <vector>
 #include "Config.h"
 #include "Reader.h"
+#include "ReaderThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -48,6 +49,11 @@ public:
         return m_cpuThreadCount;
     }
 
+    ThreadAffinity GetThreadAffinity() const
+    {
+        return m_threadAffinity;
+    }
+
     bool ShouldRandomize() const
     {
         return m_randomize;
@@ -68,6 +74,20 @@ public:
         return m_cropType == CropType::MultiView10;
     }
 
+    // Whether the color, intensity and mean transforms (and the views of a multi-view crop) are done
+    // on the device of the network, see DeviceAugmentationTransformer.
+    bool UseDeviceAugmentation() const
+    {
+        return m_deviceAugmentation;
+    }
+
+    // Whether the views of a multi-view crop are separate sequences of the deserializer,
+    // instead of being cropped on the device from a single image.
+    bool ExpandMultiViewCrop() const
+    {
+        return IsMultiViewCrop() && !m_deviceAugmentation;
+    }
+
     static CropType ParseCropType(const std::string &src);
 
 private:
@@ -78,9 +98,11 @@ private:
     std::vector<StreamDescriptionPtr> m_streams;
     ImageLayoutKind m_dataFormat;
     int m_cpuThreadCount;
+    ThreadAffinity m_threadAffinity;
     bool m_randomize;
     bool m_grayscale;
     CropType m_cropType;
+    bool m_deviceAugmentation;
 };
 
 typedef std::shared_ptr<ImageConfigHelper> ImageConfigHelperPtr;
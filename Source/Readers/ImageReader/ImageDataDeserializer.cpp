@@ -7,6 +7,9 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <numeric>
 #include <limits>
 #include "ImageDataDeserializer.h"
@@ -120,6 +123,55 @@ private:
     }
 };
 
+// Fraction of the shorter image side that is guaranteed to be covered by both sides of the crop.
+static double GetMinCropFraction(const ConfigParameters& crop)
+{
+    floatargvector cropRatio = crop(L"cropRatio", "1.0");
+    doubleargvector aspectRatioRadius = crop(L"aspectRatioRadius", ConfigParameters::Array(doubleargvector(vector<double>{0.0})));
+    double maxRadius = *std::max_element(aspectRatioRadius.begin(), aspectRatioRadius.end());
+    if (!(0 <= maxRadius && maxRadius < 1))
+        return 0;
+
+    // Aspect ratio jitter shrinks one side of the crop by up to sqrt(1 - radius).
+    return cropRatio[0] * std::sqrt(1 - maxRadius);
+}
+
+// Smallest shorter side of the decoded image that keeps the cropped area at least as large as
+// the target of the scale transform, so that decoding at reduced resolution never leads to upsampling.
+static int GetMinDecodedSide(double minCropFraction, const ConfigParameters& scale)
+{
+    size_t width = scale(L"width");
+    size_t height = scale(L"height");
+    if (minCropFraction <= 0)
+        return 0;
+    return (int)std::ceil(std::max(width, height) / minCropFraction);
+}
+
+// Same as above for a compositional transform pipeline [type = "Crop"]:[type = "Scale"]:...
+// Returns 0 (decode at full resolution) unless the image is scaled before being touched by any other transform.
+static int GetMinDecodedSide(const ConfigParameters& featureSection)
+{
+    if (!featureSection.ExistsCurrent(L"transforms"))
+        return 0;
+
+    double minCropFraction = 1;
+    argvector<ConfigParameters> transforms = featureSection("transforms");
+    for (size_t i = 0; i < transforms.size(); ++i)
+    {
+        ConfigParameters transform = transforms[i];
+        wstring type = transform(L"type", L"");
+        if (type == L"Crop")
+            minCropFraction *= GetMinCropFraction(transform);
+        else if (type == L"Scale")
+            return GetMinDecodedSide(minCropFraction, transform);
+        else if (type == L"CropScaleMean")
+            return GetMinDecodedSide(minCropFraction * GetMinCropFraction(transform), transform);
+        else
+            return 0;
+    }
+    return 0;
+}
+
 // A new constructor to support new compositional configuration,
 // that allows composition of deserializers and transforms on inputs.
 ImageDataDeserializer::ImageDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config)
@@ -170,10 +222,17 @@ ImageDataDeserializer::ImageDataDeserializer(CorpusDescriptorPtr corpus, const C
 
     m_grayscale = config(L"grayscale", false);
 
+    // JPEG images are decoded at reduced resolution if the crop and scale transforms allow it (off by default,
+    // since the decoded pixels differ slightly from a full resolution decode followed by the scale).
+    bool decodeAtReducedResolution = config(L"decodeAtReducedResolution", false);
+    m_minDecodedSide = decodeAtReducedResolution ? GetMinDecodedSide(featureSection) : 0;
+    m_memoryMapZip = config(L"memoryMapZip", false);
+
     // TODO: multiview should be done on the level of randomizer/transformers - it is responsiblity of the
     // TODO: randomizer to collect how many copies each transform needs and request same sequence several times.
     bool multiViewCrop = config(L"multiViewCrop", false);
     CreateSequenceDescriptions(corpus, config(L"file"), labelDimension, multiViewCrop);
+    CreateDecodedImageCache(config);
 }
 
 // TODO: Should be removed at some point.
@@ -187,6 +246,12 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     const auto& label = m_streams[configHelper.GetLabelStreamId()];
     const auto& feature = m_streams[configHelper.GetFeatureStreamId()];
 
+    // The legacy reader always crops and scales first, configured in the feature section.
+    ConfigParameters featureSection = config(feature->m_name);
+    bool decodeAtReducedResolution = config(L"decodeAtReducedResolution", false);
+    m_minDecodedSide = decodeAtReducedResolution ? GetMinDecodedSide(GetMinCropFraction(featureSection), featureSection) : 0;
+    m_memoryMapZip = config(L"memoryMapZip", false);
+
     m_verbosity = config(L"verbosity", 0);
 
     string precision = (ConfigValue)config("precision", "float");
@@ -217,7 +282,25 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
         RuntimeError("Unsupported label element type '%d'.", (int)label->m_elementType);
     }
 
-    CreateSequenceDescriptions(std::make_shared<CorpusDescriptor>(false), configHelper.GetMapPath(), labelDimension, configHelper.IsMultiViewCrop());
+    CreateSequenceDescriptions(std::make_shared<CorpusDescriptor>(false), configHelper.GetMapPath(), labelDimension, configHelper.ExpandMultiViewCrop());
+    CreateDecodedImageCache(config);
+}
+
+// The cache is filled during the first epoch and serves decoded images from then on. Only the decode
+// is cached, the (random) transforms are still applied to every sequence in every epoch.
+void ImageDataDeserializer::CreateDecodedImageCache(const ConfigParameters& config)
+{
+    size_t cacheSizeInMB = config(L"decodedImageCacheSizeInMB", (size_t)0);
+    if (cacheSizeInMB == 0)
+        return;
+
+    // Empty keeps the cache in memory, otherwise the file is used as memory-mapped scratch space (i.e. on a local SSD).
+    std::wstring cacheFile = config(L"decodedImageCacheFile", L"");
+    m_decodedImageCache = make_unique<DecodedDataCache>(cacheSizeInMB * 1024 * 1024, cacheFile);
+
+    if (m_verbosity > 0)
+        fprintf(stderr, "ImageDeserializer: Caching up to %d MB of decoded images %s%ls\n",
+                (int)cacheSizeInMB, cacheFile.empty() ? "in memory" : "in file ", cacheFile.c_str());
 }
 
 // Descriptions of chunks exposed by the image reader.
@@ -254,6 +337,7 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
     // Creating the default reader with expanded directory to the map file.
     auto mapFileDirectory = ExtractDirectory(mapPath);
     m_defaultReader = make_unique<FileByteReader>(mapFileDirectory);
+    m_defaultReader->SetMinDecodedSide(m_minDecodedSide);
 
     size_t itemsPerLine = isMultiCrop ? 10 : 1;
     size_t curId = 0;
@@ -325,12 +409,15 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
     for (auto& reader : knownReaders)
     {
         reader.second->Register(readerSequences[reader.first]);
+        reader.second->SetMinDecodedSide(m_minDecodedSide);
     }
 
     timer.Stop();
     if (m_verbosity > 1)
     {
         fprintf(stderr, "ImageDeserializer: Read information about %d images in %.6g seconds\n", (int)m_imageSequences.size(), timer.ElapsedSeconds());
+        if (m_minDecodedSide > 0)
+            fprintf(stderr, "ImageDeserializer: Decoding JPEG images at reduced resolution down to a shorter side of %d pixels\n", m_minDecodedSide);
     }
 }
 
@@ -340,6 +427,27 @@ ChunkPtr ImageDataDeserializer::GetChunk(ChunkIdType chunkId)
     return std::make_shared<ImageChunk>(sequenceDescription, *this);
 }
 
+void ImageDataDeserializer::ReadAhead(const std::vector<ChunkIdType>& chunkIds)
+{
+    if (m_readers.empty())
+        return;
+
+    std::unordered_map<ByteReader*, std::vector<size_t>> sequencesPerReader;
+    for (auto chunkId : chunkIds)
+    {
+        size_t seqId = m_imageSequences[chunkId].m_id;
+        if (m_decodedImageCache && m_decodedImageCache->Contains(seqId))
+            continue;
+
+        auto r = m_readers.find(seqId);
+        if (r != m_readers.end())
+            sequencesPerReader[r->second.get()].push_back(seqId);
+    }
+
+    for (const auto& reader : sequencesPerReader)
+        reader.first->ReadAhead(reader.second);
+}
+
 void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string& seqPath, PathReaderMap& knownReaders, ReaderSequenceMap& readerSequences, const std::string& expandDirectory)
 {
     assert(!seqPath.empty());
@@ -363,7 +471,7 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
     auto r = knownReaders.find(containerPath);
     if (r == knownReaders.end())
     {
-        reader = std::make_shared<ZipByteReader>(containerPath);
+        reader = std::make_shared<ZipByteReader>(containerPath, m_memoryMapZip);
         knownReaders[containerPath] = reader;
         readerSequences[containerPath] = std::map<std::string, size_t>();
     }
@@ -382,7 +490,53 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
 #endif
 }
 
+// Header of a decoded image in the cache.
+struct CachedImageHeader
+{
+    int m_rows;
+    int m_cols;
+    int m_type;
+};
+
 cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path, bool grayscale)
+{
+    if (!m_decodedImageCache)
+        return DecodeImage(seqId, path, grayscale);
+
+    cv::Mat image;
+    bool found = m_decodedImageCache->TryGet(seqId, [&image](const std::string& header, size_t)
+    {
+        const CachedImageHeader* h = reinterpret_cast<const CachedImageHeader*>(header.data());
+        image.create(h->m_rows, h->m_cols, h->m_type);
+        return reinterpret_cast<char*>(image.data);
+    });
+    if (found)
+        return image;
+
+    image = DecodeImage(seqId, path, grayscale);
+    if (!image.data)
+        return image;
+
+    // With reduced resolution decoding the image is only needed at the size the transforms allow,
+    // so it is shrunk before caching and more images fit into the cache.
+    int shorterSide = std::min(image.rows, image.cols);
+    if (m_minDecodedSide > 0 && shorterSide > m_minDecodedSide)
+    {
+        double factor = (double)m_minDecodedSide / shorterSide;
+        cv::Size size(std::max((int)std::round(image.cols * factor), 1), std::max((int)std::round(image.rows * factor), 1));
+        cv::resize(image, image, size, 0, 0, cv::INTER_AREA);
+    }
+
+    if (!image.isContinuous())
+        image = image.clone();
+
+    CachedImageHeader h = { image.rows, image.cols, image.type() };
+    m_decodedImageCache->Put(seqId, std::string(reinterpret_cast<const char*>(&h), sizeof(h)),
+                             reinterpret_cast<const char*>(image.data), image.total() * image.elemSize());
+    return image;
+}
+
+cv::Mat ImageDataDeserializer::DecodeImage(size_t seqId, const std::string& path, bool grayscale)
 {
     assert(!path.empty());
 
@@ -397,7 +551,54 @@ cv::Mat FileByteReader::Read(size_t, const std::string& seqPath, bool grayscale)
     assert(!seqPath.empty());
     auto path = Expand3Dots(seqPath, m_expandDirectory);
 
-    return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    if (m_minDecodedSide == 0)
+        return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+
+    // The image header is needed to decide on the reduction, so the file is read and decoded from memory.
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return cv::Mat();
+
+    size_t size = (size_t)file.tellg();
+    auto contents = m_workspace.pop_or_create([size]() { return std::vector<unsigned char>(size); });
+    if (contents.size() < size)
+        contents.resize(size);
+
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(contents.data()), size))
+        RuntimeError("Cannot read file '%s'", path.c_str());
+
+    cv::Mat image = Decode(contents.data(), size, grayscale);
+    m_workspace.push(std::move(contents));
+    return image;
+}
+
+// OpenCV decodes JPEG images at reduced resolution (using the scaling of libjpeg) starting with version 3.2.
+#if CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 2)
+#define CNTK_HAS_REDUCED_IMREAD 1
+#endif
+
+cv::Mat ByteReader::Decode(const unsigned char* data, size_t size, bool grayscale) const
+{
+    int flags = grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+#ifdef CNTK_HAS_REDUCED_IMREAD
+    int width, height;
+    if (m_minDecodedSide > 0 && TryGetJpegDimensions(data, size, width, height))
+    {
+        // The decoder rounds the reduced dimensions up.
+        int shorterSide = std::min(width, height);
+        if (shorterSide >= 8 * m_minDecodedSide)
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+        else if (shorterSide >= 4 * m_minDecodedSide)
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+        else if (shorterSide >= 2 * m_minDecodedSide)
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+    }
+#endif
+
+    // Wrapping the data does not copy it.
+    cv::Mat encoded(1, (int)size, CV_8U, const_cast<unsigned char*>(data));
+    return cv::imdecode(encoded, flags);
 }
 
 bool ImageDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
@@ -10,6 +10,7 @@
 #include "ByteReader.h"
 #include <unordered_map>
 #include "CorpusDescriptor.h"
+#include "DecodedDataCache.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -31,6 +32,12 @@ public:
     // Gets sequences by specified ids. Order of returned sequences corresponds to the order of provided ids.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
 
+    // Images are read lazily per sequence, creating a chunk does not touch any shared state.
+    virtual bool SupportsConcurrentChunkLoads() const override
+    {
+        return true;
+    }
+
     // Gets chunk descriptions.
     virtual ChunkDescriptions GetChunkDescriptions() override;
 
@@ -40,6 +47,9 @@ public:
     // Gets sequence description by key.
     bool GetSequenceDescriptionByKey(const KeyType&, SequenceDescription&) override;
 
+    // Lets the container readers fetch the images of the given chunks in the order they are stored.
+    virtual void ReadAhead(const std::vector<ChunkIdType>& chunkIds) override;
+
     // A helper class for generation of type specific labels (currently float/double only).
     class LabelGenerator;
     typedef std::shared_ptr<LabelGenerator> LabelGeneratorPtr;
@@ -71,11 +81,24 @@ private:
     // whether images shall be loaded in grayscale 
     bool m_grayscale;
 
+    // Smallest shorter side of an image decoded at reduced resolution, 0 to always decode at full resolution.
+    int m_minDecodedSide;
+
+    // Whether zip containers are memory mapped.
+    bool m_memoryMapZip;
+
     // Not using nocase_compare here as it's not correct on Linux.
     using PathReaderMap = std::unordered_map<std::string, std::shared_ptr<ByteReader>>;
     using ReaderSequenceMap = std::map<std::string, std::map<std::string, size_t>>;
     void RegisterByteReader(size_t seqId, const std::string& path, PathReaderMap& knownReaders, ReaderSequenceMap& readerSequences, const std::string& expandDirectory);
     cv::Mat ReadImage(size_t seqId, const std::string& path, bool grayscale);
+    cv::Mat DecodeImage(size_t seqId, const std::string& path, bool grayscale);
+
+    // Creates the cache of decoded images if configured.
+    void CreateDecodedImageCache(const ConfigParameters& config);
+
+    // Decoded images kept across epochs, so that each image is only decoded once; null if not configured.
+    std::unique_ptr<DecodedDataCache> m_decodedImageCache;
 
     // REVIEW alexeyk: can potentially use vector instead of map. Need to handle default reader and resizing though.
     using SeqReaderMap = std::unordered_map<size_t, std::shared_ptr<ByteReader>>;
@@ -12,8 +12,11 @@
 #include "NoRandomizer.h"
 #include "ImageDataDeserializer.h"
 #include "FramePacker.h"
-#include <omp.h>
+#include "ReaderThreadPool.h"
 #include "TransformController.h"
+#include "ElementTypeUtils.h"
+#include "DataReader.h"
+#include <algorithm>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,7 +24,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // TODO: The composition of packer + randomizer + different deserializers in a generic manner is done in the CompositeDataReader.
 // TODO: Currently preserving this for backward compatibility with current configs.
 ImageReader::ImageReader(const ConfigParameters& config)
-    : m_seed(0)
+    : m_seed(0), m_numViews(1), m_currentRepeatedLabels(0)
 {
     // In the future, deserializers and transformers will be dynamically loaded
     // from external libraries based on the configuration/brain script.
@@ -32,11 +35,10 @@ ImageReader::ImageReader(const ConfigParameters& config)
     m_streams = configHelper.GetStreams();
     assert(m_streams.size() == 2);
 
+    // Images are decoded and transformed by threads owned by the reader (numCPUThreads, by default one per
+    // hardware thread), independent of the OpenMP threads used for computations in the same process.
     int threadCount = configHelper.GetCpuThreadCount();
-    if (threadCount > 0)
-    {
-        omp_set_num_threads(threadCount);
-    }
+    auto threadPool = std::make_shared<ReaderThreadPool>(threadCount > 0 ? (size_t)threadCount : 0, configHelper.GetThreadAffinity());
 
     auto deserializer = std::make_shared<ImageDataDeserializer>(config);
 
@@ -49,38 +51,78 @@ ImageReader::ImageReader(const ConfigParameters& config)
         bool useLegacyRandomization = false;
         // We do not do io prefetching, because chunks are single images currently.
         bool ioPrefetch = false;
-        randomizer = std::make_shared<BlockRandomizer>(0, 1, deserializer, ioPrefetch, useLegacyRandomization, multithreadedGetNextSequences);
+        randomizer = std::make_shared<BlockRandomizer>(0, 1, deserializer, ioPrefetch, useLegacyRandomization, multithreadedGetNextSequences, 1, threadPool);
     }
     else
     {
-        randomizer = std::make_shared<NoRandomizer>(deserializer, multithreadedGetNextSequences);
+        randomizer = std::make_shared<NoRandomizer>(deserializer, multithreadedGetNextSequences, threadPool);
     }
 
     // Create transformations for a single feature stream.
     std::wstring featureName = m_streams[configHelper.GetFeatureStreamId()]->m_name;
     ConfigParameters featureStream = config(featureName);
 
+    // With deviceAugmentation, uint8 images are transferred and the rest is done on the device of the network.
+    // The views of a multi-view crop are then cropped there as well, from a single scaled image.
+    bool deviceAugmentation = configHelper.UseDeviceAugmentation();
     std::vector<Transformation> transformations;
-    transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
+    if (!deviceAugmentation || !configHelper.IsMultiViewCrop())
+    {
+        transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
+    }
 
-    if (configHelper.GetDataFormat() == CHW)
+    if (deviceAugmentation)
     {
-        transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<DeviceAugmentationTransformer>(featureStream), featureName });
     }
+    else
+    {
+        transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
+
+        if (configHelper.GetDataFormat() == CHW)
+        {
+            transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        }
 
-    // We should always have cast at the end. 
-    // It is noop if the matrix element type is already expected by the packer.
-    transformations.push_back(Transformation{ std::make_shared<CastTransformer>(featureStream), featureName });
+        // We should always have cast at the end. 
+        // It is noop if the matrix element type is already expected by the packer.
+        transformations.push_back(Transformation{ std::make_shared<CastTransformer>(featureStream), featureName });
+    }
 
     m_sequenceEnumerator = std::make_shared<TransformController>(transformations, randomizer);
+
+    // Images that are augmented or widened on the device (deviceAugmentation or transportType of the cast)
+    // are packed in the narrow type, together with what has to be done on the device.
+    size_t featureId = configHelper.GetFeatureStreamId();
+    m_featureStreamId = featureId;
+    auto transformed = m_sequenceEnumerator->GetStreamDescriptions()[featureId];
+    if (transformed->m_deviceAugmentation || transformed->m_deviceWidening)
+    {
+        auto features = std::make_shared<StreamDescription>(*m_streams[featureId]);
+        features->m_elementType = transformed->m_elementType;
+        features->m_deviceAugmentation = transformed->m_deviceAugmentation;
+        features->m_deviceWidening = transformed->m_deviceWidening;
+        m_streams[featureId] = features;
+    }
+
+    // Images with views cropped on the device are packed in the size the views are cropped from.
+    std::vector<StreamDescriptionPtr> packedStreams = m_streams;
+    if (transformed->m_deviceAugmentation && transformed->m_deviceAugmentation->m_parameters.GetNumViews() > 1)
+    {
+        m_numViews = transformed->m_deviceAugmentation->m_parameters.GetNumViews();
+        auto features = std::make_shared<StreamDescription>(*m_streams[featureId]);
+        features->m_sampleLayout = transformed->m_sampleLayout;
+        packedStreams[featureId] = features;
+        m_repeatedLabels.resize(2); // As many as the packer has buffers.
+    }
+
     bool useLocalTimeline = true;
     m_packer = std::make_shared<FramePacker>(
         m_sequenceEnumerator,
-        m_streams,
+        packedStreams,
         useLocalTimeline);
 }
 
@@ -90,4 +132,75 @@ std::vector<StreamDescriptionPtr> ImageReader::GetStreamDescriptions()
     return m_streams;
 }
 
+size_t ImageReader::ViewsToImages(size_t views) const
+{
+    if (views == requestDataSize)
+        return views;
+    return std::max<size_t>(1, views / m_numViews);
+}
+
+void ImageReader::StartEpoch(const EpochConfiguration& config, const std::map<std::wstring, int>& requiredStreams)
+{
+    EpochConfiguration images = config;
+    images.m_minibatchSizeInSamples = ViewsToImages(config.m_minibatchSizeInSamples);
+    images.m_totalEpochSizeInSamples = ViewsToImages(config.m_totalEpochSizeInSamples);
+    ReaderBase::StartEpoch(images, requiredStreams);
+}
+
+void ImageReader::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
+{
+    ReaderConfiguration images = config;
+    images.m_minibatchSizeInSamples = ViewsToImages(config.m_minibatchSizeInSamples);
+    ReaderBase::SetConfiguration(images, inputDescriptions);
+}
+
+size_t ImageReader::GetCurrentSamplePosition()
+{
+    return ReaderBase::GetCurrentSamplePosition() * m_numViews;
+}
+
+void ImageReader::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    ReaderBase::SetCurrentSamplePosition(currentSamplePosition / m_numViews);
+}
+
+// With views cropped on the device, every packed image becomes m_numViews columns of the minibatch:
+// the features are expanded by the device augmentation, the (dense) label columns are repeated here.
+Minibatch ImageReader::ReadMinibatch()
+{
+    Minibatch minibatch = ReaderBase::ReadMinibatch();
+    if (m_numViews == 1 || minibatch.m_data.empty())
+        return minibatch;
+
+    auto& buffers = m_repeatedLabels[m_currentRepeatedLabels];
+    m_currentRepeatedLabels = (m_currentRepeatedLabels + 1) % m_repeatedLabels.size();
+    buffers.resize(minibatch.m_data.size());
+
+    size_t numImages = minibatch.m_data[m_featureStreamId]->m_layout->GetNumCols();
+    for (size_t i = 0; i < minibatch.m_data.size(); ++i)
+    {
+        auto stream = std::make_shared<StreamMinibatch>(*minibatch.m_data[i]);
+        stream->m_layout = std::make_shared<MBLayout>();
+        stream->m_layout->InitAsFrameMode(numImages * m_numViews);
+        if (i != m_featureStreamId)
+        {
+            if (m_streams[i]->m_storageType != StorageType::dense)
+                LogicError("Views cropped on the device require dense labels.");
+
+            auto& labels = buffers[i];
+            size_t columnSize = m_streams[i]->m_sampleLayout->GetNumElements() * GetSizeByType(m_streams[i]->m_elementType);
+            labels.resize(columnSize * numImages * m_numViews);
+            const char* source = reinterpret_cast<const char*>(stream->m_data);
+            for (size_t j = 0; j < numImages; ++j)
+                for (size_t v = 0; v < m_numViews; ++v)
+                    memcpy(labels.data() + (j * m_numViews + v) * columnSize, source + j * columnSize, columnSize);
+            stream->m_data = labels.data();
+        }
+
+        minibatch.m_data[i] = stream;
+    }
+
+    return minibatch;
+}
+
 } } }
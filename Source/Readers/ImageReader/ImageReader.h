@@ -21,10 +21,29 @@ public:
     // Description of streams that this reader provides.
     std::vector<StreamDescriptionPtr> GetStreamDescriptions() override;
 
+    // With views cropped on the device, the sizes and positions are in views, like the ones of
+    // a multi-view crop on the CPU, and the reader reads and packs images.
+    void StartEpoch(const EpochConfiguration& config, const std::map<std::wstring, int>& requiredStreams) override;
+    void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
+    size_t GetCurrentSamplePosition() override;
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+    Minibatch ReadMinibatch() override;
+
 private:
+    // Converts a size in views to a size in images.
+    size_t ViewsToImages(size_t views) const;
+
     // All streams this reader provides.
     std::vector<StreamDescriptionPtr> m_streams;
 
+    // Number of views per image that are cropped on the device, 1 if none.
+    size_t m_numViews;
+    size_t m_featureStreamId;
+
+    // The packed label columns repeated once per view, per packer buffer and stream.
+    std::vector<std::vector<std::vector<char>>> m_repeatedLabels;
+    size_t m_currentRepeatedLabels;
+
     // Seed for the random generator.
     unsigned int m_seed;
 };
@@ -26,15 +26,28 @@ SequenceDataPtr ImageTransformerBase::Transform(SequenceDataPtr sequence)
     if (inputSequence == nullptr)
         RuntimeError("Unexpected sequence provided");
 
-    auto result = std::make_shared<ImageSequenceData>();
     Apply(sequence->m_id, inputSequence->m_image);
 
-    result->m_image = inputSequence->m_image;
-    result->m_numberOfSamples = inputSequence->m_numberOfSamples;
-    result->m_elementType = GetElementTypeFromOpenCVType(inputSequence->m_image.depth());
+    // The image is transformed in place. If nobody else refers to the input sequence (the transform controller
+    // hands its reference over), it becomes the result, otherwise the image is wrapped into a new sequence.
+    std::shared_ptr<ImageSequenceData> result;
+    if (sequence.use_count() == 1)
+    {
+        result = std::static_pointer_cast<ImageSequenceData>(sequence);
+    }
+    else
+    {
+        result = std::make_shared<ImageSequenceData>();
+        result->m_image = inputSequence->m_image;
+        result->m_numberOfSamples = inputSequence->m_numberOfSamples;
+    }
+
+    result->m_elementType = GetElementTypeFromOpenCVType(result->m_image.depth());
 
-    ImageDimensions outputDimensions(inputSequence->m_image.cols, inputSequence->m_image.rows, inputSequence->m_image.channels());
-    result->m_sampleLayout = std::make_shared<TensorShape>(outputDimensions.AsTensorShape(HWC));
+    ImageDimensions outputDimensions(result->m_image.cols, result->m_image.rows, result->m_image.channels());
+    TensorShape outputShape = outputDimensions.AsTensorShape(HWC);
+    if (!result->m_sampleLayout || *result->m_sampleLayout != outputShape)
+        result->m_sampleLayout = std::make_shared<TensorShape>(outputShape);
     return result;
 }
 
@@ -84,6 +97,16 @@ void CropTransformer::StartEpoch(const EpochConfiguration &config)
 }
 
 void CropTransformer::Apply(size_t id, cv::Mat &mat)
+{
+    bool flip;
+    mat = mat(SelectCrop(id, mat, flip));
+    if (flip)
+    {
+        cv::flip(mat, mat, 1);
+    }
+}
+
+cv::Rect CropTransformer::SelectCrop(size_t id, const cv::Mat& mat, bool& flip)
 {
     auto seed = GetSeed();
     auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); });
@@ -111,15 +134,13 @@ void CropTransformer::Apply(size_t id, cv::Mat &mat)
 
     int viewIndex = m_cropType == CropType::MultiView10 ? (int)(id % 10) : 0;
 
-    mat = mat(GetCropRect(m_cropType, viewIndex, mat.rows, mat.cols, ratio, *rng));
+    cv::Rect rect = GetCropRect(m_cropType, viewIndex, mat.rows, mat.cols, ratio, *rng);
     // for MultiView10 m_hFlip is false, hence the first 5 will be unflipped, the later 5 will be flipped
-    if ((m_hFlip && boost::random::bernoulli_distribution<>()(*rng)) ||
-        viewIndex >= 5)
-    {
-        cv::flip(mat, mat, 1);
-    }
+    flip = (m_hFlip && boost::random::bernoulli_distribution<>()(*rng)) ||
+        viewIndex >= 5;
 
     m_rngs.push(std::move(rng));
+    return rect;
 }
 
 CropTransformer::RatioJitterType
@@ -374,10 +395,46 @@ void MeanTransformer::Apply(size_t id, cv::Mat &mat)
 
     if (m_meanImg.size() == mat.size())
     {
-        // If matrix has not been converted to the right type, do it now as maen requires floating point type.
-        ConvertToFloatingPointIfRequired(mat);
-        mat = mat - m_meanImg;
+        // Mean requires floating point type, the conversion is done as part of the subtraction.
+        cv::Mat result;
+        cv::subtract(mat, m_meanImg, result, cv::noArray(), ExpectedOpenCVPrecision());
+        mat = result;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CropScaleMeanTransformer::CropScaleMeanTransformer(const ConfigParameters& config) : ImageTransformerBase(config),
+    m_crop(config), m_scale(config), m_mean(config)
+{}
+
+void CropScaleMeanTransformer::StartEpoch(const EpochConfiguration &config)
+{
+    m_crop.StartEpoch(config);
+    ImageTransformerBase::StartEpoch(config);
+}
+
+// The output stream has the dimensions requested by the scale and the required precision.
+StreamDescription CropScaleMeanTransformer::Transform(const StreamDescription& inputStream)
+{
+    TransformBase::Transform(inputStream);
+    m_outputStream = m_scale.Transform(inputStream);
+    m_outputStream.m_elementType = m_precision;
+    return m_outputStream;
+}
+
+void CropScaleMeanTransformer::Apply(size_t id, cv::Mat &mat)
+{
+    bool flip;
+    mat = mat(m_crop.SelectCrop(id, mat, flip));
+    m_scale.Apply(id, mat);
+    if (flip)
+    {
+        cv::flip(mat, mat, 1);
     }
+
+    m_mean.Apply(id, mat);
+    ConvertToFloatingPointIfRequired(mat);
 }
 
 TransposeTransformer::TransposeTransformer(const ConfigParameters& config) : TransformBase(config),
@@ -403,6 +460,11 @@ StreamDescription TransposeTransformer::Transform(const StreamDescription& input
 
 // Transformation of the sequence.
 SequenceDataPtr TransposeTransformer::Transform(SequenceDataPtr sequence)
+{
+    return Transform(sequence, nullptr);
+}
+
+SequenceDataPtr TransposeTransformer::Transform(SequenceDataPtr sequence, const SequenceArenaPtr& arena)
 {
     auto inputSequence = dynamic_cast<ImageSequenceData*>(sequence.get());
     if (inputSequence == nullptr)
@@ -416,19 +478,19 @@ SequenceDataPtr TransposeTransformer::Transform(SequenceDataPtr sequence)
     {
     case ElementType::tdouble:
         if (m_precision == ElementType::tfloat)
-            return m_floatTransform.Apply<double>(inputSequence);
+            return m_floatTransform.Apply<double>(inputSequence, arena);
         if (m_precision == ElementType::tdouble)
-            return m_doubleTransform.Apply<double>(inputSequence);
+            return m_doubleTransform.Apply<double>(inputSequence, arena);
     case ElementType::tfloat:
         if (m_precision == ElementType::tdouble)
-            return m_doubleTransform.Apply<float>(inputSequence);
+            return m_doubleTransform.Apply<float>(inputSequence, arena);
         if (m_precision == ElementType::tfloat)
-            return m_floatTransform.Apply<float>(inputSequence);
+            return m_floatTransform.Apply<float>(inputSequence, arena);
     case ElementType::tuchar:
         if (m_precision == ElementType::tdouble)
-            return m_doubleTransform.Apply<unsigned char>(inputSequence);
+            return m_doubleTransform.Apply<unsigned char>(inputSequence, arena);
         if (m_precision == ElementType::tfloat)
-            return m_floatTransform.Apply<unsigned char>(inputSequence);
+            return m_floatTransform.Apply<unsigned char>(inputSequence, arena);
     default:
         RuntimeError("Unsupported type. Please apply a cast transform with 'double' or 'float' precision.");
     }
@@ -437,7 +499,7 @@ SequenceDataPtr TransposeTransformer::Transform(SequenceDataPtr sequence)
 
 template <class TElementTo>
 template<class TElementFrom>
-SequenceDataPtr TransposeTransformer::TypedTranspose<TElementTo>::Apply(ImageSequenceData* inputSequence)
+SequenceDataPtr TransposeTransformer::TypedTranspose<TElementTo>::Apply(ImageSequenceData* inputSequence, const SequenceArenaPtr& arena)
 {
     TensorShapePtr shape = m_parent->m_inputStream.m_sampleLayout;
     if (shape == nullptr) // Taking the shape from the sequence.
@@ -449,14 +511,13 @@ SequenceDataPtr TransposeTransformer::TypedTranspose<TElementTo>::Apply(ImageSeq
     assert(inputSequence->m_numberOfSamples == 1);
 
     size_t count = shape->GetNumElements();
-    auto result = std::make_shared<DenseSequenceWithBuffer<TElementTo>>(m_memBuffers, count);
+    TElementTo* dst;
+    auto result = CreateDenseSequence(arena, m_memBuffers, count, dst);
 
     ImageDimensions dimensions(*shape, ImageLayoutKind::HWC);
     size_t rowCount = dimensions.m_height * dimensions.m_width;
     size_t channelCount = dimensions.m_numChannels;
 
-    auto dst = result->GetBuffer();
-
     if (channelCount == 3) // Unrolling for BGR, the most common case.
     {
         size_t nRows = inputSequence->m_image.rows;
@@ -692,20 +753,143 @@ void ColorTransformer::Apply(cv::Mat &mat)
     m_rngs.push(std::move(rng));
 }
 
-CastTransformer::CastTransformer(const ConfigParameters& config) : TransformBase(config), m_floatTransform(this), m_doubleTransform(this)
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DeviceAugmentationTransformer::DeviceAugmentationTransformer(const ConfigParameters& config) : ImageTransformerBase(config),
+    m_color(config), m_intensity(config), m_mean(config), m_scale(config), m_augmentation(std::make_shared<DeviceImageAugmentation>())
 {
+    string mbFormat = config(L"mbFormat", "nchw");
+    m_transposeToCHW = !AreEqualIgnoreCase(mbFormat, "nhwc") && !AreEqualIgnoreCase(mbFormat, "legacy");
+
+    m_viewWidth = m_scale.m_imgWidth;
+    m_viewHeight = m_scale.m_imgHeight;
+    m_numViews = ImageConfigHelper::ParseCropType(config(L"cropType", "")) == CropType::MultiView10 ? 10 : 1;
+    if (m_numViews > 1)
+    {
+        // The views are crops of cropRatio of the scaled image, at its corners and center.
+        floatargvector cropRatio = config(L"cropRatio", "1.0");
+        if (!(0 < cropRatio[0] && cropRatio[0] <= 1.0))
+            RuntimeError("Invalid cropRatio value, must be > 0 and <= 1.");
+
+        m_scale.m_imgWidth = std::max(m_viewWidth, (size_t)round(m_viewWidth / cropRatio[0]));
+        m_scale.m_imgHeight = std::max(m_viewHeight, (size_t)round(m_viewHeight / cropRatio[0]));
+    }
+}
+
+// The output stream has uint8 images of the scaled size and carries the augmentation.
+StreamDescription DeviceAugmentationTransformer::Transform(const StreamDescription& inputStream)
+{
+    TransformBase::Transform(inputStream);
+    if (m_numViews > 1)
+    {
+        // The images are scaled here, to the size the views are cropped from.
+        m_outputStream.m_sampleLayout = m_scale.Transform(inputStream).m_sampleLayout;
+    }
+    else if (!inputStream.m_sampleLayout)
+        RuntimeError("Device augmentation of stream '%ls' requires images of the same size, please use the Scale transform before it.", inputStream.m_name.c_str());
+
+    ImageDimensions dimensions(*m_outputStream.m_sampleLayout, HWC);
+    auto& parameters = m_augmentation->m_parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.m_width = (uint32_t)(m_numViews > 1 ? m_viewWidth : dimensions.m_width);
+    parameters.m_height = (uint32_t)(m_numViews > 1 ? m_viewHeight : dimensions.m_height);
+    parameters.m_channels = (uint32_t)dimensions.m_numChannels;
+    parameters.m_numViews = m_numViews;
+    parameters.m_sourceWidth = (uint32_t)dimensions.m_width;
+    parameters.m_sourceHeight = (uint32_t)dimensions.m_height;
+    parameters.m_transposeToCHW = m_transposeToCHW;
+    m_augmentation->m_seed = GetSeed();
+
+    const cv::Mat& meanImg = m_mean.m_meanImg;
+    if (!meanImg.empty())
+    {
+        if (meanImg.cols != (int)parameters.m_width || meanImg.rows != (int)parameters.m_height || meanImg.channels() != (int)parameters.m_channels)
+            RuntimeError("The mean image does not match the size of the images of stream '%ls'.", inputStream.m_name.c_str());
+
+        cv::Mat mean;
+        meanImg.convertTo(mean, CV_32F);
+        m_augmentation->m_mean.assign(mean.ptr<float>(), mean.ptr<float>() + mean.total() * mean.channels());
+        parameters.m_subtractMean = true;
+    }
+
+    m_outputStream.m_elementType = ElementType::tuchar;
+    m_outputStream.m_deviceAugmentation = m_augmentation;
+    return m_outputStream;
+}
+
+void DeviceAugmentationTransformer::StartEpoch(const EpochConfiguration &config)
+{
+    m_color.StartEpoch(config);
+    m_intensity.StartEpoch(config);
+
+    // The shim only reads the parameters on the main thread, which is also the one starting the epoch.
+    auto& parameters = m_augmentation->m_parameters;
+    parameters.m_brightnessRadius = (float)m_color.m_curBrightnessRadius;
+    parameters.m_contrastRadius = (float)m_color.m_curContrastRadius;
+    parameters.m_saturationRadius = (float)m_color.m_curSaturationRadius;
+
+    bool hasEigen = !m_intensity.m_eigVal.empty() && !m_intensity.m_eigVec.empty();
+    parameters.m_intensityStdDev = hasEigen ? (float)m_intensity.m_curStdDev : 0;
+    if (hasEigen)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            parameters.m_eigVal[i] = m_intensity.m_eigVal.at<float>(i);
+            for (int j = 0; j < 3; j++)
+                parameters.m_eigVec[3 * i + j] = m_intensity.m_eigVec.at<float>(i, j);
+        }
+    }
+
+    ImageTransformerBase::StartEpoch(config);
+}
+
+void DeviceAugmentationTransformer::Apply(size_t id, cv::Mat &mat)
+{
+    if (m_numViews > 1)
+        m_scale.Apply(id, mat);
+
+    if (mat.depth() != CV_8U)
+        mat.convertTo(mat, CV_8U);
+}
+
+// With transportType 'uint8' or 'float16' the stream is cast to the narrow type instead of the precision,
+// and widened to the precision of the network on the device as transportScale * value + transportShift.
+CastTransformer::CastTransformer(const ConfigParameters& config) : TransformBase(config),
+    m_floatTransform(this), m_doubleTransform(this), m_ucharTransform(this), m_float16Transform(this)
+{
+    m_outputType = m_precision;
+    std::wstring transportType = config(L"transportType", L"");
+    if (!transportType.empty())
+    {
+        if (AreEqualIgnoreCase(transportType, L"uint8"))
+            m_outputType = ElementType::tuchar;
+        else if (AreEqualIgnoreCase(transportType, L"float16"))
+            m_outputType = ElementType::tfloat16;
+        else
+            InvalidArgument("Unsupported transportType '%ls', must be 'uint8' or 'float16'.", transportType.c_str());
+
+        m_widening = std::make_shared<DeviceStreamWidening>();
+        m_widening->m_scale = config(L"transportScale", 1.0f);
+        m_widening->m_shift = config(L"transportShift", 0.0f);
+    }
 }
 
 StreamDescription CastTransformer::Transform(const StreamDescription& inputStream)
 {
     m_outputStream = TransformBase::Transform(inputStream);
-    m_outputStream.m_elementType = m_precision;
+    m_outputStream.m_elementType = m_outputType;
+    m_outputStream.m_deviceWidening = m_widening;
     return m_outputStream;
 }
 
 SequenceDataPtr CastTransformer::Transform(SequenceDataPtr sequence)
 {
-    if (m_inputStream.m_elementType == m_precision || sequence->m_elementType == m_precision)
+    return Transform(sequence, nullptr);
+}
+
+SequenceDataPtr CastTransformer::Transform(SequenceDataPtr sequence, const SequenceArenaPtr& arena)
+{
+    if (m_inputStream.m_elementType == m_outputType || sequence->m_elementType == m_outputType)
     {
         // No need to do anything, exit.
         return sequence;
@@ -716,34 +900,46 @@ SequenceDataPtr CastTransformer::Transform(SequenceDataPtr sequence)
         ? m_inputStream.m_elementType 
         : sequence->m_elementType;
 
-    switch (m_precision)
+    switch (m_outputType)
     {
     case ElementType::tdouble:
-        if (inputType == ElementType::tfloat)
-            result = m_doubleTransform.Apply<float>(sequence);
-        else if (inputType == ElementType::tuchar)
-            result = m_doubleTransform.Apply<unsigned char>(sequence);
-        else
-            RuntimeError("Unsupported type. Please apply a cast transform with 'double' or 'float' precision.");
+        result = Apply(m_doubleTransform, inputType, sequence, arena);
         break;
     case ElementType::tfloat:
-        if (inputType == ElementType::tdouble)
-            result = m_floatTransform.Apply<double>(sequence);
-        if (inputType == ElementType::tuchar)
-            result = m_floatTransform.Apply<unsigned char>(sequence);
-        else
-            RuntimeError("Unsupported type. Please apply a cast transform with 'double' or 'float' precision.");
+        result = Apply(m_floatTransform, inputType, sequence, arena);
+        break;
+    case ElementType::tuchar:
+        result = Apply(m_ucharTransform, inputType, sequence, arena);
+        break;
+    case ElementType::tfloat16:
+        result = Apply(m_float16Transform, inputType, sequence, arena);
         break;
     default:
         RuntimeError("Unsupported type. Please apply a cast transform with 'double' or 'float' precision.");
     }
-    result->m_elementType = m_precision;
+    result->m_elementType = m_outputType;
     return result;
 }
 
+template <class TElementTo>
+SequenceDataPtr CastTransformer::Apply(TypedCast<TElementTo>& transform, ElementType inputType, SequenceDataPtr sequence, const SequenceArenaPtr& arena)
+{
+    switch (inputType)
+    {
+    case ElementType::tfloat:
+        return transform.template Apply<float>(sequence, arena);
+    case ElementType::tdouble:
+        return transform.template Apply<double>(sequence, arena);
+    case ElementType::tuchar:
+        return transform.template Apply<unsigned char>(sequence, arena);
+    default:
+        RuntimeError("Unsupported type. Please apply a cast transform with 'double' or 'float' precision.");
+    }
+}
+
 template <class TElementTo>
 template<class TElementFrom>
-SequenceDataPtr CastTransformer::TypedCast<TElementTo>::Apply(SequenceDataPtr sequence)
+SequenceDataPtr CastTransformer::TypedCast<TElementTo>::Apply(SequenceDataPtr sequence, const SequenceArenaPtr& arena)
 {
     TensorShapePtr shape = m_parent->m_inputStream.m_sampleLayout;
     if (!shape) // Taking the shape from the sequence.
@@ -754,14 +950,14 @@ SequenceDataPtr CastTransformer::TypedCast<TElementTo>::Apply(SequenceDataPtr se
 
     auto& inputSequence = static_cast<DenseSequenceData&>(*sequence);
     size_t count = shape->GetNumElements() * sequence->m_numberOfSamples;
-    auto result = std::make_shared<DenseSequenceWithBuffer<TElementTo>>(m_memBuffers, count);
+    TElementTo* dst;
+    auto result = CreateDenseSequence(arena, m_memBuffers, count, dst);
 
     auto src = reinterpret_cast<const TElementFrom*>(inputSequence.GetDataBuffer());
-    auto dst = result->GetBuffer();
 
     for (size_t i = 0; i < count; i++)
     {
-        dst[i] = static_cast<TElementTo>(src[i]);
+        CastElement(src[i], dst[i]);
     }
 
     result->m_sampleLayout = shape;
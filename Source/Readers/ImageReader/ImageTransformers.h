@@ -51,6 +51,12 @@ public:
     // Transformation of the sequence.
     SequenceDataPtr Transform(SequenceDataPtr sequence) override;
 
+    // The image of the input sequence is transformed in place.
+    bool IsInPlace() const override
+    {
+        return true;
+    }
+
 protected:
     using Base = Transformer;
     using UniRealT = boost::random::uniform_real_distribution<double>;
@@ -75,6 +81,9 @@ protected:
     conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
 };
 
+class CropScaleMeanTransformer;
+class DeviceAugmentationTransformer;
+
 // Crop transformation of the image.
 // Can work on images of any size.
 class CropTransformer : public ImageTransformerBase
@@ -83,8 +92,13 @@ public:
     explicit CropTransformer(const ConfigParameters& config);
 
 private:
+    friend class CropScaleMeanTransformer;
+
     void Apply(size_t id, cv::Mat &mat) override;
 
+    // Picks the crop rectangle of the image and whether the crop is flipped horizontally.
+    cv::Rect SelectCrop(size_t id, const cv::Mat& mat, bool& flip);
+
 private:
     enum class RatioJitterType
     {
@@ -119,6 +133,9 @@ public:
     StreamDescription Transform(const StreamDescription& inputStream) override;
 
 private:
+    friend class CropScaleMeanTransformer;
+    friend class DeviceAugmentationTransformer;
+
     enum class ScaleMode
     {
         Fill = 0,
@@ -144,11 +161,35 @@ public:
     explicit MeanTransformer(const ConfigParameters& config);
 
 private:
+    friend class CropScaleMeanTransformer;
+    friend class DeviceAugmentationTransformer;
+
     void Apply(size_t id, cv::Mat &mat) override;
 
     cv::Mat m_meanImg;
 };
 
+// Crop, scale and mean transformations fused into a single transform, configured with the
+// parameters of all three. The crop stays a view on the decoded image and is scaled directly,
+// the horizontal flip is applied to the (smaller) scaled image, and the mean is subtracted while
+// converting to the required precision, so that the final cast is a no-op.
+class CropScaleMeanTransformer : public ImageTransformerBase
+{
+public:
+    explicit CropScaleMeanTransformer(const ConfigParameters& config);
+
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+private:
+    void StartEpoch(const EpochConfiguration &config) override;
+
+    void Apply(size_t id, cv::Mat &mat) override;
+
+    CropTransformer m_crop;
+    ScaleTransformer m_scale;
+    MeanTransformer m_mean;
+};
+
 // Transpose transformation from HWC to CHW (note: row-major notation).
 class TransposeTransformer : public TransformBase
 {
@@ -160,9 +201,10 @@ public:
 
     // Transformation of the sequence.
     SequenceDataPtr Transform(SequenceDataPtr sequence) override;
+    SequenceDataPtr Transform(SequenceDataPtr sequence, const SequenceArenaPtr& arena) override;
 
 private:
-    // A helper class transposes images using a set of typed memory buffers.
+    // A helper class transposes images using a set of typed memory buffers, or the arena of the minibatch if there is one.
     template <class TElementTo>
     struct TypedTranspose
     {
@@ -171,7 +213,7 @@ private:
         TypedTranspose(TransposeTransformer* parent) : m_parent(parent) {}
 
         template <class TElementFrom>
-        SequenceDataPtr Apply(ImageSequenceData* inputSequence);
+        SequenceDataPtr Apply(ImageSequenceData* inputSequence, const SequenceArenaPtr& arena);
         conc_stack<std::vector<TElementTo>> m_memBuffers;
     };
 
@@ -193,6 +235,8 @@ public:
     explicit IntensityTransformer(const ConfigParameters& config);
 
 private:
+    friend class DeviceAugmentationTransformer;
+
     void StartEpoch(const EpochConfiguration &config) override;
 
     void Apply(size_t id, cv::Mat &mat) override;
@@ -216,6 +260,8 @@ public:
     explicit ColorTransformer(const ConfigParameters& config);
 
 private:
+    friend class DeviceAugmentationTransformer;
+
     void StartEpoch(const EpochConfiguration &config) override;
 
     void Apply(size_t id, cv::Mat &mat) override;
@@ -233,6 +279,41 @@ private:
     conc_stack<std::unique_ptr<cv::Mat>> m_hsvTemp;
 };
 
+// Color, intensity and mean transformations (and the transpose to CHW unless mbFormat is 'nhwc')
+// done on the device of the network after the transfer, configured with the parameters of the
+// Color, Intensity and Mean transforms. On the CPU the image is only converted to uint8,
+// which also makes the host to device copy 4 (or 8) times smaller; the output stream is tagged
+// with the augmentation (see DeviceImageAugmentation), so that the reader shim runs it
+// when the minibatch is handed to the network.
+// Replaces the Color, Intensity, Mean, Transpose and Cast transforms.
+// With cropType=multiview10 it also replaces the Crop and Scale transforms: the image is scaled as a whole
+// to the configured size divided by cropRatio, decoded and transferred once, and its 10 views are cropped
+// (and flipped) on the device.
+class DeviceAugmentationTransformer : public ImageTransformerBase
+{
+public:
+    explicit DeviceAugmentationTransformer(const ConfigParameters& config);
+
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+private:
+    void StartEpoch(const EpochConfiguration &config) override;
+
+    void Apply(size_t id, cv::Mat &mat) override;
+
+    ColorTransformer m_color;
+    IntensityTransformer m_intensity;
+    MeanTransformer m_mean;
+    ScaleTransformer m_scale;
+    bool m_transposeToCHW;
+    DeviceImageAugmentationPtr m_augmentation;
+
+    // Number of views per image (10 for multiview10, else 1) and their size.
+    uint32_t m_numViews;
+    size_t m_viewWidth;
+    size_t m_viewHeight;
+};
+
 // Cast the input to a particular type.
 // Images coming from the deserializer/transformers could come in different types,
 // i.e. as a uchar due to performance reasons. On the other hand, the packer/network
@@ -248,10 +329,11 @@ public:
 
     // Transformation of the sequence.
     SequenceDataPtr Transform(SequenceDataPtr sequence) override;
+    SequenceDataPtr Transform(SequenceDataPtr sequence, const SequenceArenaPtr& arena) override;
 
 private:
 
-    // A helper class casts images using a set of typed memory buffers.
+    // A helper class casts images using a set of typed memory buffers, or the arena of the minibatch if there is one.
     template <class TElementTo>
     struct TypedCast
     {
@@ -260,12 +342,21 @@ private:
         TypedCast(CastTransformer* parent) : m_parent(parent) {}
 
         template <class TElementFrom>
-        SequenceDataPtr Apply(SequenceDataPtr inputSequence);
+        SequenceDataPtr Apply(SequenceDataPtr inputSequence, const SequenceArenaPtr& arena);
         conc_stack<std::vector<TElementTo>> m_memBuffers;
     };
 
+    template <class TElementTo>
+    SequenceDataPtr Apply(TypedCast<TElementTo>& transform, ElementType inputType, SequenceDataPtr sequence, const SequenceArenaPtr& arena);
+
     TypedCast<float> m_floatTransform;
     TypedCast<double> m_doubleTransform;
+    TypedCast<uint8_t> m_ucharTransform;
+    TypedCast<float16> m_float16Transform;
+
+    // Type of the output, the precision or a narrow type given by transportType.
+    ElementType m_outputType;
+    DeviceStreamWideningPtr m_widening;
 };
 
 
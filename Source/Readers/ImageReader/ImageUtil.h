@@ -37,4 +37,49 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         return result;
     }
 
+    // Gets the dimensions of a JPEG image from its frame header without decoding it.
+    // Returns false if the data is not a JPEG image or the header could not be found.
+    inline bool TryGetJpegDimensions(const unsigned char* data, size_t size, int& width, int& height)
+    {
+        if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+            return false;
+
+        size_t pos = 2;
+        while (pos + 4 <= size)
+        {
+            if (data[pos] != 0xFF)
+                return false;
+
+            unsigned char marker = data[pos + 1];
+            if (marker == 0xFF) // fill byte
+            {
+                pos++;
+                continue;
+            }
+
+            pos += 2;
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) // markers without a payload
+                continue;
+            if (marker == 0xD9 || marker == 0xDA) // end of image or start of scan before any frame header
+                return false;
+
+            size_t length = ((size_t)data[pos] << 8) | data[pos + 1];
+            if (length < 2)
+                return false;
+
+            // SOF0..SOF15, except DHT, JPG and DAC that share the range.
+            if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            {
+                if (length < 7 || pos + 7 > size)
+                    return false;
+                height = (data[pos + 3] << 8) | data[pos + 4];
+                width = (data[pos + 5] << 8) | data[pos + 6];
+                return width > 0 && height > 0;
+            }
+
+            pos += length;
+        }
+        return false;
+    }
+
 }}}
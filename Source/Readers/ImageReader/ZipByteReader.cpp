@@ -4,11 +4,22 @@
 //
 
 #include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
 #include <opencv2/opencv.hpp>
 #include "ByteReader.h"
 
 #ifdef USE_ZIP
+#include <algorithm>
+#include <cerrno>
 #include <File.h>
+#include <zlib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,10 +32,109 @@ std::string GetZipError(int err)
     return errS;
 }
 
-ZipByteReader::ZipByteReader(const std::string& zipPath)
-    : m_zipPath(zipPath)
+// Little endian fields of the zip format.
+static uint16_t GetUInt16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t GetUInt32(const unsigned char* p)
+{
+    return (uint32_t)GetUInt16(p) | ((uint32_t)GetUInt16(p + 2) << 16);
+}
+
+static uint64_t GetUInt64(const unsigned char* p)
+{
+    return (uint64_t)GetUInt32(p) | ((uint64_t)GetUInt32(p + 4) << 32);
+}
+
+static const uint32_t s_localHeaderSignature = 0x04034b50;
+static const uint32_t s_centralHeaderSignature = 0x02014b50;
+static const uint32_t s_endOfCentralDirectorySignature = 0x06054b50;
+static const uint32_t s_zip64EndOfCentralDirectorySignature = 0x06064b50;
+static const uint32_t s_zip64LocatorSignature = 0x07064b50;
+static const size_t s_localHeaderSize = 30;
+static const size_t s_centralHeaderSize = 46;
+static const size_t s_endOfCentralDirectorySize = 22;
+
+ZipByteReader::ZipByteReader(const std::string& zipPath, bool memoryMap)
+    : m_zipPath(zipPath),
+      m_fileSize(0),
+      m_mapping(nullptr)
 {
     assert(!m_zipPath.empty());
+
+#ifdef _WIN32
+    m_mappingHandle = NULL;
+    m_fileHandle = CreateFileW(msra::strfun::utf16(m_zipPath).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+        RuntimeError("Failed to open %s, error %x.", m_zipPath.c_str(), GetLastError());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_fileHandle, &size))
+    {
+        DWORD error = GetLastError();
+        CloseHandle(m_fileHandle);
+        RuntimeError("Cannot retrieve the size of %s, error %x.", m_zipPath.c_str(), error);
+    }
+    m_fileSize = (uint64_t)size.QuadPart;
+
+    if (memoryMap && m_fileSize > 0)
+    {
+        m_mappingHandle = CreateFileMapping(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mappingHandle != NULL)
+            m_mapping = (const unsigned char*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if (m_mapping == nullptr)
+        {
+            DWORD error = GetLastError();
+            if (m_mappingHandle != NULL)
+                CloseHandle(m_mappingHandle);
+            CloseHandle(m_fileHandle);
+            RuntimeError("Cannot memory map %s, error %x.", m_zipPath.c_str(), error);
+        }
+    }
+#else
+    m_fileDescriptor = open(m_zipPath.c_str(), O_RDONLY);
+    if (m_fileDescriptor == -1)
+        RuntimeError("Failed to open %s.", m_zipPath.c_str());
+
+    struct stat sb;
+    if (fstat(m_fileDescriptor, &sb) == -1)
+    {
+        close(m_fileDescriptor);
+        RuntimeError("Cannot retrieve the size of %s.", m_zipPath.c_str());
+    }
+    m_fileSize = (uint64_t)sb.st_size;
+
+    if (memoryMap && m_fileSize > 0)
+    {
+        void* data = mmap(nullptr, m_fileSize, PROT_READ, MAP_SHARED, m_fileDescriptor, 0);
+        if (data == MAP_FAILED)
+        {
+            close(m_fileDescriptor);
+            RuntimeError("Cannot memory map %s.", m_zipPath.c_str());
+        }
+        m_mapping = (const unsigned char*)data;
+        madvise(data, m_fileSize, MADV_RANDOM);
+    }
+#endif
+}
+
+ZipByteReader::~ZipByteReader()
+{
+#ifdef _WIN32
+    if (m_mapping != nullptr)
+        UnmapViewOfFile(m_mapping);
+    if (m_mappingHandle != NULL)
+        CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+#else
+    if (m_mapping != nullptr)
+        munmap((void*)m_mapping, m_fileSize);
+    if (m_fileDescriptor != -1)
+        close(m_fileDescriptor);
+#endif
 }
 
 ZipByteReader::ZipPtr ZipByteReader::OpenZip()
@@ -45,6 +155,158 @@ ZipByteReader::ZipPtr ZipByteReader::OpenZip()
     });
 }
 
+void ZipByteReader::ReadAt(uint64_t offset, size_t size, unsigned char* buffer) const
+{
+    if (offset + size > m_fileSize)
+        RuntimeError("Read of %" PRIu64 " bytes at offset %" PRIu64 " is beyond the end of %s.", (uint64_t)size, offset, m_zipPath.c_str());
+
+    if (m_mapping != nullptr)
+    {
+        memcpy(buffer, m_mapping + offset, size);
+        return;
+    }
+
+    // Positional reads do not move a shared file pointer, so they can be issued from several threads.
+    while (size > 0)
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD bytesRead = 0;
+        DWORD toRead = (DWORD)std::min<size_t>(size, 1 << 30);
+        if (!ReadFile(m_fileHandle, buffer, toRead, &bytesRead, &overlapped) || bytesRead == 0)
+            RuntimeError("Failed to read %s at offset %" PRIu64 ", error %x.", m_zipPath.c_str(), offset, GetLastError());
+#else
+        ssize_t bytesRead = pread(m_fileDescriptor, buffer, size, (off_t)offset);
+        if (bytesRead <= 0)
+        {
+            if (bytesRead == -1 && errno == EINTR)
+                continue;
+            RuntimeError("Failed to read %s at offset %" PRIu64 ".", m_zipPath.c_str(), offset);
+        }
+#endif
+        buffer += bytesRead;
+        offset += bytesRead;
+        size -= bytesRead;
+    }
+}
+
+void ZipByteReader::ReadCentralDirectory()
+{
+    // The end of central directory record is at the end of the file, followed by a comment of at most 64K.
+    size_t tailSize = (size_t)std::min<uint64_t>(m_fileSize, s_endOfCentralDirectorySize + 0xFFFF);
+    if (tailSize < s_endOfCentralDirectorySize)
+        return;
+
+    std::vector<unsigned char> tail(tailSize);
+    uint64_t tailOffset = m_fileSize - tailSize;
+    ReadAt(tailOffset, tailSize, tail.data());
+
+    size_t end = tailSize - s_endOfCentralDirectorySize + 1;
+    while (end > 0 && GetUInt32(&tail[end - 1]) != s_endOfCentralDirectorySignature)
+        end--;
+    if (end == 0)
+        return;
+
+    const unsigned char* eocd = &tail[end - 1];
+    uint64_t numEntries = GetUInt16(eocd + 10);
+    uint64_t directorySize = GetUInt32(eocd + 12);
+    uint64_t directoryOffset = GetUInt32(eocd + 16);
+    if (numEntries == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF)
+    {
+        // Zip64: the actual values are in the zip64 end of central directory record, found through the locator.
+        uint64_t eocdOffset = tailOffset + (end - 1);
+        if (eocdOffset < 20)
+            return;
+
+        unsigned char locator[20];
+        ReadAt(eocdOffset - 20, sizeof(locator), locator);
+        if (GetUInt32(locator) != s_zip64LocatorSignature)
+            return;
+
+        unsigned char record[56];
+        uint64_t recordOffset = GetUInt64(locator + 8);
+        if (recordOffset + sizeof(record) > m_fileSize)
+            return;
+        ReadAt(recordOffset, sizeof(record), record);
+        if (GetUInt32(record) != s_zip64EndOfCentralDirectorySignature)
+            return;
+
+        numEntries = GetUInt64(record + 32);
+        directorySize = GetUInt64(record + 40);
+        directoryOffset = GetUInt64(record + 48);
+    }
+
+    if (directoryOffset + directorySize > m_fileSize)
+        return;
+
+    std::vector<unsigned char> directory((size_t)directorySize);
+    ReadAt(directoryOffset, directory.size(), directory.data());
+
+    std::vector<uint64_t> headerOffsets;
+    headerOffsets.reserve((size_t)numEntries);
+    size_t position = 0;
+    for (uint64_t i = 0; i < numEntries; ++i)
+    {
+        if (position + s_centralHeaderSize > directory.size())
+            return;
+
+        const unsigned char* header = &directory[position];
+        if (GetUInt32(header) != s_centralHeaderSignature)
+            return;
+
+        uint16_t nameLength = GetUInt16(header + 28);
+        uint16_t extraLength = GetUInt16(header + 30);
+        uint16_t commentLength = GetUInt16(header + 32);
+        size_t nextPosition = position + s_centralHeaderSize + nameLength + extraLength + commentLength;
+        if (nextPosition > directory.size())
+            return;
+
+        uint64_t headerOffset = GetUInt32(header + 42);
+        if (headerOffset == 0xFFFFFFFF)
+        {
+            // The offset is in the zip64 extra field, after the sizes that do not fit into 32 bits.
+            headerOffset = UINT64_MAX;
+            const unsigned char* extra = header + s_centralHeaderSize + nameLength;
+            const unsigned char* extraEnd = extra + extraLength;
+            while (extra + 4 <= extraEnd)
+            {
+                uint16_t id = GetUInt16(extra);
+                uint16_t size = GetUInt16(extra + 2);
+                if (extra + 4 + size > extraEnd)
+                    break;
+                if (id == 1)
+                {
+                    size_t skip = (GetUInt32(header + 24) == 0xFFFFFFFF ? 8 : 0) + (GetUInt32(header + 20) == 0xFFFFFFFF ? 8 : 0);
+                    if (skip + 8 <= size)
+                        headerOffset = GetUInt64(extra + 4 + skip);
+                    break;
+                }
+                extra += 4 + size;
+            }
+            if (headerOffset == UINT64_MAX)
+                return;
+        }
+
+        headerOffsets.push_back(headerOffset);
+        position = nextPosition;
+    }
+
+    // Entries are stored one after another, an entry spans up to the next one or the central directory.
+    std::vector<uint64_t> sorted(headerOffsets);
+    sorted.push_back(directoryOffset);
+    std::sort(sorted.begin(), sorted.end());
+
+    m_spanSizes.resize(headerOffsets.size());
+    for (size_t i = 0; i < headerOffsets.size(); ++i)
+    {
+        auto next = std::upper_bound(sorted.begin(), sorted.end(), headerOffsets[i]);
+        m_spanSizes[i] = next == sorted.end() ? 0 : *next - headerOffsets[i];
+    }
+    m_headerOffsets.swap(headerOffsets);
+}
+
 void ZipByteReader::Register(const std::map<std::string, size_t>& sequences)
 {
     auto zipFile = m_zips.pop_or_create([this]() { return OpenZip(); });
@@ -53,6 +315,11 @@ void ZipByteReader::Register(const std::map<std::string, size_t>& sequences)
 
     size_t numberOfEntries = 0;
     size_t numEntries = zip_get_num_entries(zipFile.get(), 0);
+
+    // libzip indexes entries in the order of the central directory, so our own parse can only be used if it agrees.
+    ReadCentralDirectory();
+    bool directReads = m_headerOffsets.size() == numEntries;
+
     for (size_t i = 0; i < numEntries; ++i) {
         int err = zip_stat_index(zipFile.get(), i, 0, &stat);
         if (ZIP_ER_OK != err)
@@ -65,7 +332,21 @@ void ZipByteReader::Register(const std::map<std::string, size_t>& sequences)
         }
         else
         {
-            m_seqIdToIndex[sequenceId->second] = std::make_pair(stat.index, stat.size);
+            Entry entry;
+            entry.m_index = stat.index;
+            entry.m_size = stat.size;
+            entry.m_compressedSize = stat.comp_size;
+            entry.m_method = stat.comp_method;
+            entry.m_headerOffset = directReads ? m_headerOffsets[i] : 0;
+            entry.m_spanSize = directReads ? m_spanSizes[i] : 0;
+
+            bool supported = (stat.comp_method == ZIP_CM_STORE || stat.comp_method == ZIP_CM_DEFLATE) &&
+                             stat.encryption_method == ZIP_EM_NONE &&
+                             entry.m_spanSize >= s_localHeaderSize + entry.m_compressedSize;
+            if (!supported)
+                entry.m_spanSize = 0;
+
+            m_seqIdToEntry[sequenceId->second] = entry;
             numberOfEntries++;
         }
     }
@@ -76,8 +357,8 @@ void ZipByteReader::Register(const std::map<std::string, size_t>& sequences)
         // Not all sequences have been found. Let's print them out and throw.
         for (const auto& s : sequences)
         {
-            auto index = m_seqIdToIndex.find(s.second);
-            if (index == m_seqIdToIndex.end())
+            auto index = m_seqIdToEntry.find(s.second);
+            if (index == m_seqIdToEntry.end())
             {
                 fprintf(stderr, "Sequence %s is not found in container %s.\n", s.first.c_str(), m_zipPath.c_str());
             }
@@ -87,15 +368,109 @@ void ZipByteReader::Register(const std::map<std::string, size_t>& sequences)
     }
 }
 
+void ZipByteReader::ReadAhead(const std::vector<size_t>& seqIds)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    ranges.reserve(seqIds.size());
+    for (auto seqId : seqIds)
+    {
+        auto r = m_seqIdToEntry.find(seqId);
+        if (r != m_seqIdToEntry.end() && r->second.m_spanSize != 0)
+            ranges.push_back(std::make_pair(r->second.m_headerOffset, r->second.m_spanSize));
+    }
+
+    // Hints are issued in archive order, so that the storage sees a forward scan instead of random reads.
+    std::sort(ranges.begin(), ranges.end());
+    for (const auto& range : ranges)
+    {
+#ifdef _WIN32
+        if (m_mapping != nullptr)
+        {
+            WIN32_MEMORY_RANGE_ENTRY entry;
+            entry.VirtualAddress = (PVOID)(m_mapping + range.first);
+            entry.NumberOfBytes = (SIZE_T)range.second;
+            PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0); // only a hint, errors are ignored
+        }
+#else
+        posix_fadvise(m_fileDescriptor, (off_t)range.first, (off_t)range.second, POSIX_FADV_WILLNEED); // only a hint, errors are ignored
+#endif
+    }
+}
+
+// Inflates a raw deflate stream (as stored in zip entries) of known uncompressed size.
+static void Inflate(const unsigned char* input, size_t inputSize, unsigned char* output, size_t outputSize, const std::string& path)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        RuntimeError("Failed to initialize zlib for %s.", path.c_str());
+
+    stream.next_in = const_cast<Bytef*>(input);
+    stream.avail_in = (uInt)inputSize;
+    stream.next_out = output;
+    stream.avail_out = (uInt)outputSize;
+    int result = inflate(&stream, Z_FINISH);
+    size_t inflated = stream.total_out;
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END || inflated != outputSize)
+        RuntimeError("Failed to inflate file %s in the zip file, zlib error %d.", path.c_str(), result);
+}
+
 cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscale)
 {
-    // Find index of the file in .zip file.
-    auto r = m_seqIdToIndex.find(seqId);
-    if (r == m_seqIdToIndex.end())
+    // Find the entry of the file in .zip file.
+    auto r = m_seqIdToEntry.find(seqId);
+    if (r == m_seqIdToEntry.end())
         RuntimeError("Could not find file %s in the zip file, sequence id = %lu", path.c_str(), (long)seqId);
 
-    zip_uint64_t index = std::get<0>((*r).second);
-    zip_uint64_t size = std::get<1>((*r).second);
+    const Entry& entry = r->second;
+    if (entry.m_spanSize == 0)
+        return ReadWithLibzip(entry, seqId, path, grayscale);
+
+    // The whole entry including its local header is fetched at once.
+    std::vector<unsigned char> contents;
+    const unsigned char* header;
+    if (m_mapping != nullptr)
+        header = m_mapping + entry.m_headerOffset;
+    else
+    {
+        contents = m_workspace.pop_or_create([&entry]() { return vector<unsigned char>((size_t)entry.m_spanSize); });
+        if (contents.size() < entry.m_spanSize)
+            contents.resize((size_t)entry.m_spanSize);
+        ReadAt(entry.m_headerOffset, (size_t)entry.m_spanSize, contents.data());
+        header = contents.data();
+    }
+
+    // Name and extra field of the local header may differ in length from those in the central directory.
+    size_t dataOffset = s_localHeaderSize + GetUInt16(header + 26) + GetUInt16(header + 28);
+    if (GetUInt32(header) != s_localHeaderSignature || dataOffset + entry.m_compressedSize > entry.m_spanSize)
+        RuntimeError("Invalid local header of file %s in the zip file %s.", path.c_str(), m_zipPath.c_str());
+
+    cv::Mat img;
+    if (entry.m_method == ZIP_CM_STORE)
+    {
+        img = Decode(header + dataOffset, (size_t)entry.m_size, grayscale);
+    }
+    else
+    {
+        auto inflated = m_inflated.pop_or_create([&entry]() { return vector<unsigned char>((size_t)entry.m_size); });
+        if (inflated.size() < entry.m_size)
+            inflated.resize((size_t)entry.m_size);
+        Inflate(header + dataOffset, (size_t)entry.m_compressedSize, inflated.data(), (size_t)entry.m_size, path);
+        img = Decode(inflated.data(), (size_t)entry.m_size, grayscale);
+        m_inflated.push(std::move(inflated));
+    }
+    assert(nullptr != img.data);
+
+    if (m_mapping == nullptr)
+        m_workspace.push(std::move(contents));
+    return img;
+}
+
+cv::Mat ZipByteReader::ReadWithLibzip(const Entry& entry, size_t seqId, const std::string& path, bool grayscale)
+{
+    zip_uint64_t index = entry.m_index;
+    zip_uint64_t size = entry.m_size;
 
     auto contents = m_workspace.pop_or_create([size]() { return vector<unsigned char>(size); });
     if (contents.size() < size)
@@ -131,7 +506,8 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscal
     });
     m_zips.push(std::move(zipFile));
 
-    cv::Mat img = cv::imdecode(contents, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    // The workspace buffer may be larger than this image.
+    cv::Mat img = Decode(contents.data(), size, grayscale);
     assert(nullptr != img.data);
     m_workspace.push(std::move(contents));
     return img;
@@ -146,6 +146,7 @@ void HTKMLFReader<ElemType>::PrepareForSequenceTraining(const ConfigRecordType&
     ElemType acousticScale;
     ElemType lmScale;
     bool oneSilenceClass;
+    size_t numDerivativeThreads;
 
     // Makes sure that "denlats" and "alignments" sections exist.
     if (!readerConfig.Exists(L"denlats"))
@@ -174,6 +175,9 @@ void HTKMLFReader<ElemType>::PrepareForSequenceTraining(const ConfigRecordType&
     acousticScale = denlatConfig(L"acousticScale", 0.2);
     lmScale = denlatConfig(L"lmScale", 1.0);
     oneSilenceClass = denlatConfig(L"oneSilenceClass", true);
+    // Number of threads that compute the derivatives while the network runs
+    // forward on the next minibatches, 0 to compute them synchronously.
+    numDerivativeThreads = denlatConfig(L"derivativeThreads", 0);
 
     // Processes "alignments" section.
     const ConfigRecordType& aliConfig = readerConfig(L"alignments");
@@ -227,7 +231,7 @@ void HTKMLFReader<ElemType>::PrepareForSequenceTraining(const ConfigRecordType&
                    "buffering?\n");
     }
     m_uttDerivBuffer = new UtteranceDerivativeBuffer<ElemType>(
-        m_numberOfuttsPerMinibatch, m_seqTrainDeriv);
+        m_numberOfuttsPerMinibatch, m_seqTrainDeriv, numDerivativeThreads);
 }
 
 // Loads input and output data for training and testing. Below we list the
@@ -676,8 +680,8 @@ HTKMLFReader<ElemType>::~HTKMLFReader()
     delete m_mbiter;
     delete m_frameSource;
     delete m_lattices;
+    delete m_uttDerivBuffer; // first, its derivative threads use m_seqTrainDeriv
     delete m_seqTrainDeriv;
-    delete m_uttDerivBuffer;
 
     foreach_index(i, m_featuresBufferMultiIO)
         delete[] m_featuresBufferMultiIO[i];
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include "kaldi.h"
 #include "Matrix.h"
 #include "basetypes.h"
@@ -23,6 +24,11 @@ private:
     kaldi::RandomAccessCompactLatticeReader* m_denlatReader;
     kaldi::RandomAccessInt32VectorReader* m_aliReader;
 
+    // The Kaldi readers are not thread-safe, while the derivatives of several
+    // utterances may be computed concurrently. The lattice computation itself
+    // only reads the members above and runs without the lock.
+    mutable std::mutex m_readerLock;
+
     // Rescores the lattice with the lastest posteriors from the neural network.
     void LatticeAcousticRescore(const wstring& uttID,
                                 const Matrix<ElemType>& outputs,
@@ -8,7 +8,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 template <class ElemType>
 UtteranceDerivativeBuffer<ElemType>::UtteranceDerivativeBuffer(
     size_t numberOfuttsPerMinibatch,
-    UtteranceDerivativeComputationInterface<ElemType>* derivativeInterface)
+    UtteranceDerivativeComputationInterface<ElemType>* derivativeInterface,
+    size_t numDerivativeThreads)
 {
     assert(derivativeInterface != NULL);
     m_derivativeInterface = derivativeInterface;
@@ -18,6 +19,97 @@ UtteranceDerivativeBuffer<ElemType>::UtteranceDerivativeBuffer(
     m_uttReady.assign(m_numUttsPerMinibatch, false);
     m_epochEnd = false;
     m_dimension = 0;
+    m_stopWorkers = false;
+    for (size_t i = 0; i < numDerivativeThreads; ++i)
+    {
+        m_workers.push_back(std::thread([this]() { WorkerLoop(); }));
+    }
+}
+
+// Destructor.
+template <class ElemType>
+UtteranceDerivativeBuffer<ElemType>::~UtteranceDerivativeBuffer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queueLock);
+        m_stopWorkers = true;
+    }
+    m_queueChanged.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::WorkerLoop()
+{
+    for (;;)
+    {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_queueLock);
+            m_queueChanged.wait(lock, [this]() { return m_stopWorkers || !m_derivativeQueue.empty(); });
+            if (m_stopWorkers)
+            {
+                return;
+            }
+            task = std::move(m_derivativeQueue.front());
+            m_derivativeQueue.pop_front();
+        }
+        // Errors are kept in the future of the task.
+        task();
+    }
+}
+
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::ComputeDerivative(
+    const wstring& uttID, UtteranceDerivativeUnit& uttUnit)
+{
+    if (m_workers.empty())
+    {
+        m_derivativeInterface->ComputeDerivative(
+            uttID, uttUnit.logLikelihood, &uttUnit.derivative, &uttUnit.objective);
+        return;
+    }
+
+    // The unit stays in <m_uttPool> (whose elements do not move) until its
+    // derivative has been waited for, and nobody else touches it meanwhile.
+    UtteranceDerivativeUnit* unit = &uttUnit;
+    UtteranceDerivativeComputationInterface<ElemType>* derivativeInterface = m_derivativeInterface;
+    std::packaged_task<void()> task([uttID, unit, derivativeInterface]()
+    {
+        derivativeInterface->ComputeDerivative(
+            uttID, unit->logLikelihood, &unit->derivative, &unit->objective);
+    });
+    uttUnit.pendingDerivative = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_queueLock);
+        m_derivativeQueue.push_back(std::move(task));
+    }
+    m_queueChanged.notify_one();
+}
+
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::WaitForDerivative(
+    UtteranceDerivativeUnit& uttUnit)
+{
+    if (uttUnit.pendingDerivative.valid())
+    {
+        uttUnit.pendingDerivative.get();
+    }
+}
+
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::WaitForAllDerivatives()
+{
+    for (auto& utt : m_uttPool)
+    {
+        if (utt.second.pendingDerivative.valid())
+        {
+            utt.second.pendingDerivative.wait();
+        }
+    }
 }
 
 template <class ElemType>
@@ -138,11 +230,9 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
                 m_uttPool[uttID].progress += numFrames;
                 if (m_uttPool[uttID].progress == m_uttPool[uttID].uttLength)
                 {
-                    m_derivativeInterface->ComputeDerivative(
-                        uttID,
-                        m_uttPool[uttID].logLikelihood,
-                        &m_uttPool[uttID].derivative,
-                        &m_uttPool[uttID].objective);
+                    // With derivative threads, <hasDerivative> means the
+                    // derivative is computed or being computed.
+                    ComputeDerivative(uttID, m_uttPool[uttID]);
                     m_uttPool[uttID].hasDerivative = true;
                     m_uttPool[uttID].progress = 0;
                     m_uttReady[m_uttPool[uttID].streamID] = true;
@@ -197,6 +287,7 @@ bool UtteranceDerivativeBuffer<ElemType>::GetDerivative(
                              " %S\n",
                              uttID.c_str());
             }
+            WaitForDerivative(m_uttPool[uttID]);
 
             // Assign the derivatives.
             assert(uttID == uttInfoInMinibatch[i][j].first);
@@ -309,6 +400,9 @@ bool UtteranceDerivativeBuffer<ElemType>::CompareUttInfo(
 template <class ElemType>
 void UtteranceDerivativeBuffer<ElemType>::ResetEpoch()
 {
+    // The workers must not write to the utterances that are cleared; errors
+    // of derivatives that are discarded do not matter.
+    WaitForAllDerivatives();
     m_needLikelihood = true;
     m_currentObj = 0;
     m_epochEnd = false;
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
 #include "Matrix.h"
 #include "basetypes.h"
 #include "Sequences.h"
@@ -10,6 +16,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // This class "gules" together the log-likelihood from different minibatches,
 // and then calls <UtteranceDerivativeComputationInterface> class to compute
 // the derivative for given utterance.
+//
+// With derivative threads, the derivative of an utterance whose log-likelihood
+// is complete is computed by a pool of worker threads, while the network runs
+// forward on the following minibatches; GetDerivative() waits for the
+// derivatives of the utterances in the minibatch it returns, so they are fed
+// back in the order of the minibatches. Without threads, the derivative is
+// computed synchronously in SetLikelihood().
 template <class ElemType>
 class UtteranceDerivativeBuffer
 {
@@ -23,6 +36,7 @@ private:
         Matrix<ElemType> logLikelihood;
         Matrix<ElemType> derivative;
         ElemType objective;
+        std::future<void> pendingDerivative; // valid while computed by a worker
 
         UtteranceDerivativeUnit()
             : logLikelihood(CPUDEVICE), derivative(CPUDEVICE)
@@ -45,6 +59,24 @@ private:
     unordered_map<wstring, UtteranceDerivativeUnit> m_uttPool;
     UtteranceDerivativeComputationInterface<ElemType>* m_derivativeInterface;
 
+    // Derivative worker threads and their queue of computations.
+    std::vector<std::thread> m_workers;
+    std::deque<std::packaged_task<void()>> m_derivativeQueue;
+    std::mutex m_queueLock;
+    std::condition_variable m_queueChanged;
+    bool m_stopWorkers;
+
+    void WorkerLoop();
+
+    // Computes the derivative of the utterance, or has it computed by a worker.
+    void ComputeDerivative(const wstring& uttID, UtteranceDerivativeUnit& uttUnit);
+
+    // Waits for the derivative of the utterance, rethrowing an error of its computation.
+    void WaitForDerivative(UtteranceDerivativeUnit& uttUnit);
+
+    // Waits for all derivatives in the computation.
+    void WaitForAllDerivatives();
+
     // <uttInfoInMinibatch> is a vector of vector of the following:
     //     uttID startFrameIndexInMinibatch numFrames
     void ProcessUttInfo(
@@ -59,15 +91,15 @@ private:
 
 public:
     // Constructor.
-    // Does not take ownership of <derivativeInterface>.
+    // Does not take ownership of <derivativeInterface>, which must support
+    // concurrent ComputeDerivative() calls if <numDerivativeThreads> > 0.
     UtteranceDerivativeBuffer(
         size_t numberOfuttsPerMinibatch,
-        UtteranceDerivativeComputationInterface<ElemType>* derivativeInterface);
+        UtteranceDerivativeComputationInterface<ElemType>* derivativeInterface,
+        size_t numDerivativeThreads = 0);
 
     // Destructor.
-    ~UtteranceDerivativeBuffer()
-    {
-    }
+    ~UtteranceDerivativeBuffer();
 
     bool NeedLikelihoodToComputeDerivative() const
     {
@@ -10,6 +10,7 @@
 #define DATAWRITER_EXPORTS
 #include "SequenceReader.h"
 #include "SequenceWriter.h"
+#include "TextDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -31,4 +32,15 @@ extern "C" DATAWRITER_API void GetWriterD(IDataWriter** pwriter)
     *pwriter = new LMSequenceWriter<double>();
 }
 
+// TODO: Not safe from the ABI perspective. Will be uglified to make the interface ABI.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool primary)
+{
+    if (type == L"TextDeserializer")
+        *deserializer = new TextDeserializer(corpus, deserializerConfig, primary);
+    else
+        return false; // unknown type
+
+    return true;
+}
+
 }}}
@@ -0,0 +1,416 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <limits>
+#include "TextDeserializer.h"
+#include "SequenceData.h"
+#include "StringUtil.h"
+#include "fileutil.h"
+
+#undef max // max is defined in minwindef.h
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Word ids of the sentences of a chunk, parsed when the chunk is loaded.
+// Sequences point into the ids of the chunk and keep the chunk alive.
+class TextDeserializer::TextChunk : public Chunk, public std::enable_shared_from_this<TextChunk>
+{
+public:
+    TextChunk(const TextDeserializer& parent, const TextChunkDescriptor& descriptor)
+        : m_parent(parent), m_firstSentence(descriptor.m_firstSentence)
+    {
+        m_offsets.reserve(descriptor.m_numberOfSentences + 1);
+        m_offsets.push_back(0);
+        vector<string> words;
+        const char* data = m_parent.m_file->GetData();
+        for (size_t i = 0; i < descriptor.m_numberOfSentences; ++i)
+        {
+            const auto& sentence = m_parent.m_sentences[m_firstSentence + i];
+            m_parent.ParseSentence(data + sentence.m_fileOffset, data + sentence.m_fileOffset + sentence.m_byteSize, words);
+            assert(words.size() == sentence.m_numberOfWords);
+            for (const auto& word : words)
+                m_ids.push_back(m_parent.GetWordId(word));
+            m_offsets.push_back(m_ids.size());
+        }
+    }
+
+    virtual void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
+    {
+        assert(sequenceId >= m_firstSentence && sequenceId - m_firstSentence + 1 < m_offsets.size());
+        size_t begin = m_offsets[sequenceId - m_firstSentence];
+        size_t numberOfWords = m_offsets[sequenceId - m_firstSentence + 1] - begin;
+        uint32_t numberOfSamples = (uint32_t)(numberOfWords - (m_parent.m_predictNextWord ? 1 : 0));
+
+        for (size_t i = 0; i < m_parent.m_streamKinds.size(); ++i)
+        {
+            SequenceDataPtr s;
+            switch (m_parent.m_streamKinds[i])
+            {
+            case StreamKind::words:
+                s = CreateOneHotSequence(&m_ids[begin], numberOfSamples);
+                break;
+            case StreamKind::nextWords:
+                s = CreateOneHotSequence(&m_ids[begin + 1], numberOfSamples);
+                break;
+            case StreamKind::nextWordClasses:
+                if (m_parent.m_elementType == ElementType::tfloat)
+                    s = CreateClassSequence<float>(&m_ids[begin + 1], numberOfSamples);
+                else
+                    s = CreateClassSequence<double>(&m_ids[begin + 1], numberOfSamples);
+                break;
+            default:
+                LogicError("TextDeserializer: Unexpected stream kind.");
+            }
+            s->m_id = sequenceId;
+            s->m_chunk = shared_from_this();
+            result.push_back(s);
+        }
+    }
+
+private:
+    SequenceDataPtr CreateOneHotSequence(IndexType* ids, uint32_t numberOfSamples)
+    {
+        auto s = make_shared<CategorySequenceData>();
+        s->m_indices = ids;
+        s->m_nnzCounts.assign(numberOfSamples, 1);
+        s->m_totalNnzCount = numberOfSamples;
+        s->m_numberOfSamples = numberOfSamples;
+        if (m_parent.m_elementType == ElementType::tfloat)
+            s->m_data = const_cast<float*>(m_parent.m_onesFloat.data());
+        else
+            s->m_data = const_cast<double*>(m_parent.m_onesDouble.data());
+        return s;
+    }
+
+    template <class ElemType>
+    struct ClassSequenceData : DenseSequenceData
+    {
+        vector<ElemType> m_values;
+
+        const void* GetDataBuffer() override
+        {
+            return m_values.data();
+        }
+    };
+
+    // Columns [word id, class id, class begin, class end), see BatchSequenceReader::GetLabelOutput().
+    template <class ElemType>
+    SequenceDataPtr CreateClassSequence(const IndexType* ids, uint32_t numberOfSamples)
+    {
+        auto s = make_shared<ClassSequenceData<ElemType>>();
+        s->m_values.resize(4 * numberOfSamples);
+        for (size_t t = 0; t < numberOfSamples; ++t)
+        {
+            size_t c = m_parent.m_wordClass[ids[t]];
+            s->m_values[4 * t + 0] = (ElemType)ids[t];
+            s->m_values[4 * t + 1] = (ElemType)c;
+            s->m_values[4 * t + 2] = (ElemType)m_parent.m_classBegin[c];
+            s->m_values[4 * t + 3] = (ElemType)m_parent.m_classEnd[c];
+        }
+        s->m_numberOfSamples = numberOfSamples;
+        return s;
+    }
+
+    const TextDeserializer& m_parent;
+    size_t m_firstSentence;
+    vector<IndexType> m_ids;
+    vector<size_t> m_offsets; // of the sentences in m_ids, and the end
+};
+
+TextDeserializer::TextDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary)
+{
+    UNUSED(primary); // sentences can also be looked up by their line number
+
+    wstring precision = config(L"precision", L"float");
+    m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
+
+    m_fileName = (wstring)config(L"file");
+    m_unk = msra::strfun::utf8(config(L"unk", L"<unk>"));
+    m_beginSequence = msra::strfun::utf8(config(L"beginSequence", L""));
+    m_endSequence = msra::strfun::utf8(config(L"endSequence", L""));
+
+    InitializeVocabulary(config);
+    InitializeStreams(config);
+
+    m_file.reset(new MemoryMappedFile(m_fileName));
+    m_file->AdviseRandomAccess();
+    IndexFile(corpus, config(L"chunkSizeInBytes", (size_t)32 * 1024 * 1024));
+
+    if (m_vocabulary.Size() > numeric_limits<IndexType>::max())
+        RuntimeError("TextDeserializer: The vocabulary size (%" PRIu64 ") exceeds the maximum allowed value (%" PRIu64 ").",
+                     m_vocabulary.Size(), (size_t)numeric_limits<IndexType>::max());
+
+    for (size_t i = 0; i < m_streams.size(); ++i)
+    {
+        size_t dimension = m_streamKinds[i] == StreamKind::nextWordClasses ? 4 : max(m_streamDimensions[i], m_vocabulary.Size());
+        m_streams[i]->m_sampleLayout = make_shared<TensorShape>(dimension);
+    }
+}
+
+// Reads the vocabulary from the 'wordclass' or 'labelMappingFile' file, see SequenceReader::ReadClassInfo().
+void TextDeserializer::InitializeVocabulary(const ConfigParameters& config)
+{
+    wstring wordClassFile = config(L"wordclass", L"");
+    wstring labelMappingFile = config(L"labelMappingFile", L"");
+    vector<string> words;
+    if (!wordClassFile.empty())
+    {
+        for (msra::files::textreader reader(wordClassFile); reader;)
+        {
+            string line = reader.getline();
+            auto tokens = msra::strfun::split(line, "\t ");
+            if (tokens.empty())
+                continue;
+            if (tokens.size() != 4)
+                RuntimeError("TextDeserializer: Invalid line '%s' in the word class file '%ls', expected '<id> <count> <word> <class>'.", line.c_str(), wordClassFile.c_str());
+
+            size_t id = stoul(tokens[0]);
+            size_t c = stoul(tokens[3]);
+            if (words.size() <= id)
+            {
+                words.resize(id + 1);
+                m_wordClass.resize(id + 1, SIZE_MAX);
+            }
+            if (m_wordClass[id] != SIZE_MAX)
+                RuntimeError("TextDeserializer: Word id %d appears twice in the word class file '%ls'.", (int)id, wordClassFile.c_str());
+            words[id] = tokens[2];
+            m_wordClass[id] = c;
+        }
+
+        // Words of a class have to be consecutive for the class-based softmax.
+        for (size_t id = 0; id < words.size(); ++id)
+        {
+            size_t c = m_wordClass[id];
+            if (c == SIZE_MAX)
+                RuntimeError("TextDeserializer: Word id %d is missing in the word class file '%ls'.", (int)id, wordClassFile.c_str());
+            if (m_classBegin.size() <= c)
+            {
+                m_classBegin.resize(c + 1, SIZE_MAX);
+                m_classEnd.resize(c + 1, SIZE_MAX);
+            }
+            if (m_classBegin[c] == SIZE_MAX)
+                m_classBegin[c] = id;
+            else if (m_classEnd[c] != id)
+                RuntimeError("TextDeserializer: The words of class %d are not consecutive in the word class file '%ls'.", (int)c, wordClassFile.c_str());
+            m_classEnd[c] = id + 1;
+        }
+    }
+    else if (!labelMappingFile.empty())
+    {
+        File::LoadLabelFile(labelMappingFile, words);
+    }
+
+    for (const auto& word : words)
+    {
+        if (m_vocabulary.Contains(word))
+            RuntimeError("TextDeserializer: Word '%s' appears twice in the vocabulary.", word.c_str());
+        m_vocabulary.AddValue(word);
+    }
+
+    m_fixedVocabulary = !words.empty();
+    if (m_fixedVocabulary && !m_vocabulary.Contains(m_unk))
+        fprintf(stderr, "TextDeserializer: 'unknown' symbol unk='%s' is not in the vocabulary. Unknown words will error out if encountered.\n", m_unk.c_str());
+}
+
+void TextDeserializer::InitializeStreams(const ConfigParameters& config)
+{
+    const ConfigParameters& input = config(L"input");
+    m_predictNextWord = false;
+    for (const pair<string, ConfigParameters>& section : input)
+    {
+        const ConfigParameters& streamConfig = section.second;
+        string labelType = streamConfig(L"labelType", "input");
+        StreamKind kind;
+        if (AreEqualIgnoreCase(labelType, "input"))
+        {
+            kind = StreamKind::words;
+        }
+        else if (AreEqualIgnoreCase(labelType, "nextWord"))
+        {
+            string mode = streamConfig(L"mode", "softmax");
+            if (AreEqualIgnoreCase(mode, "softmax"))
+                kind = StreamKind::nextWords;
+            else if (AreEqualIgnoreCase(mode, "class"))
+            {
+                if (m_classBegin.empty())
+                    InvalidArgument("TextDeserializer: Stream '%s' with mode 'class' requires a 'wordclass' file.", section.first.c_str());
+                kind = StreamKind::nextWordClasses;
+            }
+            else
+                InvalidArgument("TextDeserializer: Unsupported mode '%s' of stream '%s', expected 'softmax' or 'class'.", mode.c_str(), section.first.c_str());
+            m_predictNextWord = true;
+        }
+        else
+            InvalidArgument("TextDeserializer: Unsupported labelType '%s' of stream '%s', expected 'input' or 'nextWord'.", labelType.c_str(), section.first.c_str());
+
+        auto stream = make_shared<StreamDescription>();
+        stream->m_id = m_streams.size();
+        stream->m_name = msra::strfun::utf16(section.first);
+        stream->m_storageType = kind == StreamKind::nextWordClasses ? StorageType::dense : StorageType::sparse_csc;
+        stream->m_elementType = m_elementType;
+        m_streams.push_back(stream);
+        m_streamKinds.push_back(kind);
+        m_streamDimensions.push_back(streamConfig(L"dim", (size_t)0)); // 0: the vocabulary size
+    }
+
+    if (m_streams.empty())
+        InvalidArgument("TextDeserializer: The configuration contains an empty 'input' section.");
+}
+
+// Splits the file into sentences and groups them into chunks. Without a vocabulary file, collects the words.
+void TextDeserializer::IndexFile(CorpusDescriptorPtr corpus, size_t chunkSizeInBytes)
+{
+    const char* data = m_file->GetData();
+    size_t size = m_file->GetSize();
+    size_t minimumNumberOfWords = m_predictNextWord ? 2 : 1;
+    size_t maxNumberOfSamples = 0;
+    size_t totalNumberOfSamples = 0;
+    vector<string> words;
+
+    size_t line = 0;
+    for (size_t pos = 0; pos < size; ++line)
+    {
+        const char* end = (const char*)memchr(data + pos, '\n', size - pos);
+        size_t lineEnd = end ? end - data : size;
+        size_t lineBegin = pos;
+        pos = lineEnd + 1;
+
+        ParseSentence(data + lineBegin, data + lineEnd, words);
+        if (words.size() < minimumNumberOfWords || !corpus->IsIncluded(std::to_string(line)))
+            continue;
+        if (lineEnd - lineBegin > numeric_limits<uint32_t>::max() || words.size() > SEQUENCELEN_MAX)
+            RuntimeError("TextDeserializer: Line %" PRIu64 " of '%ls' is too long.", line, m_fileName.c_str());
+
+        if (!m_fixedVocabulary)
+        {
+            for (const auto& word : words)
+                m_vocabulary[word];
+        }
+
+        if (m_chunks.empty() || m_chunks.back().m_byteSize >= chunkSizeInBytes)
+        {
+            if (m_chunks.size() >= CHUNKID_MAX)
+                RuntimeError("TextDeserializer: Too many chunks in '%ls', increase 'chunkSizeInBytes'.", m_fileName.c_str());
+            m_chunks.push_back(TextChunkDescriptor{ m_sentences.size(), 0, 0, lineBegin, 0 });
+        }
+
+        size_t numberOfSamples = words.size() - (m_predictNextWord ? 1 : 0);
+        auto& chunk = m_chunks.back();
+        chunk.m_numberOfSentences++;
+        chunk.m_numberOfSamples += numberOfSamples;
+        chunk.m_byteSize = lineEnd - chunk.m_fileOffset;
+
+        if (m_lineToSentence.size() <= line)
+            m_lineToSentence.resize(line + 1, SIZE_MAX);
+        m_lineToSentence[line] = m_sentences.size();
+        m_sentences.push_back(SentenceDescriptor{ lineBegin, (uint32_t)(lineEnd - lineBegin), (uint32_t)words.size(), line, (ChunkIdType)(m_chunks.size() - 1) });
+
+        maxNumberOfSamples = max(maxNumberOfSamples, numberOfSamples);
+        totalNumberOfSamples += numberOfSamples;
+    }
+
+    m_onesFloat.assign(maxNumberOfSamples, 1.0f);
+    m_onesDouble.assign(maxNumberOfSamples, 1.0);
+
+    fprintf(stderr, "TextDeserializer: %" PRIu64 " sentences with %" PRIu64 " samples in %" PRIu64 " chunks, vocabulary of %" PRIu64 " words from '%ls'.\n",
+            m_sentences.size(), totalNumberOfSamples, m_chunks.size(), m_vocabulary.Size(), m_fileName.c_str());
+}
+
+void TextDeserializer::ParseSentence(const char* begin, const char* end, vector<string>& words) const
+{
+    words.clear();
+    const char* p = begin;
+    while (p < end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            ++p;
+        const char* wordBegin = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+            ++p;
+        if (p > wordBegin)
+            words.emplace_back(wordBegin, p);
+    }
+
+    // Sentence boundaries, compared case-insensitively as by the LMSequenceReader; those in the text are
+    // replaced by the configured ones, which are the ones in the vocabulary.
+    if (words.empty())
+        return;
+    if (!m_beginSequence.empty() && EqualCI(words.front(), m_beginSequence))
+        words.front() = m_beginSequence;
+    else if (!m_beginSequence.empty())
+        words.insert(words.begin(), m_beginSequence);
+    if (!m_endSequence.empty() && words.size() > 1 && EqualCI(words.back(), m_endSequence))
+        words.back() = m_endSequence;
+    else if (!m_endSequence.empty())
+        words.push_back(m_endSequence);
+}
+
+IndexType TextDeserializer::GetWordId(const string& word) const
+{
+    size_t id;
+    if (!m_vocabulary.TryGet(word, id) && !m_vocabulary.TryGet(m_unk, id))
+        RuntimeError("TextDeserializer: Word '%s' is not in the vocabulary and the 'unknown' symbol unk='%s' is not either.", word.c_str(), m_unk.c_str());
+    return (IndexType)id;
+}
+
+ChunkDescriptions TextDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    result.reserve(m_chunks.size());
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = (ChunkIdType)i;
+        cd->m_numberOfSamples = m_chunks[i].m_numberOfSamples;
+        cd->m_numberOfSequences = m_chunks[i].m_numberOfSentences;
+        result.push_back(cd);
+    }
+    return result;
+}
+
+void TextDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    const auto& chunk = m_chunks[chunkId];
+    result.reserve(result.size() + chunk.m_numberOfSentences);
+    for (size_t i = chunk.m_firstSentence; i < chunk.m_firstSentence + chunk.m_numberOfSentences; ++i)
+    {
+        SequenceDescription s;
+        GetSequenceDescriptionByKey(KeyType{ m_sentences[i].m_line, 0 }, s);
+        result.push_back(s);
+    }
+}
+
+bool TextDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    size_t sentenceId = key.m_sequence < m_lineToSentence.size() ? m_lineToSentence[key.m_sequence] : SIZE_MAX;
+    if (sentenceId == SIZE_MAX)
+        return false;
+
+    const auto& sentence = m_sentences[sentenceId];
+    result.m_id = sentenceId;
+    result.m_numberOfSamples = sentence.m_numberOfWords - (m_predictNextWord ? 1 : 0);
+    result.m_chunkId = sentence.m_chunkId;
+    result.m_key.m_sequence = sentence.m_line;
+    result.m_key.m_sample = 0;
+    return true;
+}
+
+ChunkPtr TextDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    return make_shared<TextChunk>(*this, m_chunks[chunkId]);
+}
+
+void TextDeserializer::ReadAhead(const vector<ChunkIdType>& chunkIds)
+{
+    for (auto chunkId : chunkIds)
+        m_file->WillNeed(m_chunks[chunkId].m_fileOffset, m_chunks[chunkId].m_byteSize);
+}
+
+}}}
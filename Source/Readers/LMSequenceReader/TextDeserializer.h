@@ -0,0 +1,136 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+#include "StringToIdMap.h"
+#include "MemoryMappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer for the word-per-token, sentence-per-line text files of the LMSequenceReader.
+// Replaces the monolithic reader for language model training: the file is memory mapped and
+// indexed once, sentences are grouped into chunks of 'chunkSizeInBytes' that the randomizer
+// can load concurrently and ahead of time.
+//
+// Configuration:
+//     file = "train.txt"
+//     wordclass = "vocab.txt"           # lines "<id> <count> <word> <class>", as for the LMSequenceReader
+//     labelMappingFile = "words.txt"    # alternatively, one word per line; without either the vocabulary is built from the file
+//     unk = "<unk>"                     # words not in the vocabulary are mapped to this one
+//     beginSequence = "</s>"            # added to sentences that do not start with it (empty: none)
+//     endSequence = "</s>"              # added to sentences that do not end with it (empty: none)
+//     input = [
+//         features = [ labelType = "input" ]                     # sparse one-hot words w[0..n-2]
+//         labels   = [ labelType = "nextWord" ; mode = "class" ] # next words w[1..n-1]
+//     ]
+// With mode = "softmax" the next words are sparse one-hot vectors; with mode = "class" (which requires
+// a 'wordclass' file) every sample is the dense column [word id, class id, class begin, class end)
+// expected by ClassBasedCrossEntropyWithSoftmax, as written by the LMSequenceReader in class mode.
+class TextDeserializer : public DataDeserializerBase
+{
+public:
+    TextDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+
+    // Parses the sentences of a chunk into word ids.
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    // Chunks are parsed from the read-only mapping and the fixed vocabulary.
+    virtual bool SupportsConcurrentChunkLoads() const override
+    {
+        return true;
+    }
+
+    // Pages in the text of the chunks that are going to be loaded next.
+    virtual void ReadAhead(const std::vector<ChunkIdType>& chunkIds) override;
+
+protected:
+    // Sentences are keyed by their line number in the file.
+    virtual bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class TextChunk;
+    DISABLE_COPY_AND_MOVE(TextDeserializer);
+
+    enum class StreamKind
+    {
+        words,           // sparse one-hot input words
+        nextWords,       // sparse one-hot next words
+        nextWordClasses, // dense [word id, class id, class begin, class end) of the next words
+    };
+
+    void InitializeVocabulary(const ConfigParameters& config);
+    void InitializeStreams(const ConfigParameters& config);
+    void IndexFile(CorpusDescriptorPtr corpus, size_t chunkSizeInBytes);
+
+    // Splits a line into words and adds the missing sentence boundaries.
+    void ParseSentence(const char* begin, const char* end, std::vector<std::string>& words) const;
+
+    // Maps a word to its id, using the 'unk' word for words not in the vocabulary.
+    IndexType GetWordId(const std::string& word) const;
+
+    // A sentence (line) of the file.
+    struct SentenceDescriptor
+    {
+        size_t m_fileOffset;
+        uint32_t m_byteSize;
+        uint32_t m_numberOfWords;  // including the added sentence boundaries
+        size_t m_line;             // sequence key
+        ChunkIdType m_chunkId;
+    };
+
+    // Consecutive sentences read together.
+    struct TextChunkDescriptor
+    {
+        size_t m_firstSentence;
+        size_t m_numberOfSentences;
+        size_t m_numberOfSamples;
+        size_t m_fileOffset;
+        size_t m_byteSize;
+    };
+
+    std::wstring m_fileName;
+    std::unique_ptr<MemoryMappedFile> m_file;
+
+    std::vector<SentenceDescriptor> m_sentences;
+    std::vector<TextChunkDescriptor> m_chunks;
+
+    // Maps line numbers to sentences (SIZE_MAX for empty or excluded lines).
+    std::vector<size_t> m_lineToSentence;
+
+    StringToIdMap m_vocabulary;
+    bool m_fixedVocabulary; // false if the vocabulary is collected while indexing the file
+    std::string m_unk;
+    std::string m_beginSequence;
+    std::string m_endSequence;
+
+    // Word classes, only with a 'wordclass' file. Words of a class have consecutive ids [m_classBegin[c], m_classEnd[c]).
+    std::vector<size_t> m_wordClass;
+    std::vector<size_t> m_classBegin;
+    std::vector<size_t> m_classEnd;
+
+    std::vector<StreamKind> m_streamKinds;
+    std::vector<size_t> m_streamDimensions;
+
+    // With a next word stream, a sentence of n words has n - 1 samples.
+    bool m_predictNextWord;
+
+    ElementType m_elementType;
+
+    // Values of the one-hot vectors, as long as the longest sentence.
+    std::vector<float> m_onesFloat;
+    std::vector<double> m_onesDouble;
+};
+
+}}}
@@ -8,17 +8,35 @@
 #include "stdafx.h"
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
-#include "LibSVMBinaryReader.h"
+#include "ReaderShim.h"
+#include "CorpusDescriptor.h"
+#include "SparseBinaryDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+auto factory = [](const ConfigParameters& parameters) -> ReaderPtr
+{
+    return std::make_shared<SparseBinaryReader>(SparseBinaryFormat::libSvmBinary, parameters);
+};
+
 extern "C" DATAREADER_API void GetReaderF(IDataReader** preader)
 {
-    *preader = new LibSVMBinaryReader<float>();
+    *preader = new ReaderShim<float>(factory);
 }
 extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
 {
-    *preader = new LibSVMBinaryReader<double>();
+    *preader = new ReaderShim<double>(factory);
+}
+
+// TODO: Not safe from the ABI perspective. Will be uglified to make the interface ABI.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr /*corpus*/, bool primary)
+{
+    if (type == L"LibSVMBinaryDeserializer")
+        *deserializer = new SparseBinaryDeserializer(SparseBinaryFormat::libSvmBinary, deserializerConfig, primary);
+    else
+        return false; // unknown type
+
+    return true;
 }
 
 }}}
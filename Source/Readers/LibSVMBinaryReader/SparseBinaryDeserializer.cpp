@@ -0,0 +1,572 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SparseBinaryDeserializer.cpp : Deserializer for the binary formats of the LibSVMBinaryReader and the SparsePCReader.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <limits>
+#include "SparseBinaryDeserializer.h"
+#include "BlockRandomizer.h"
+#include "NoRandomizer.h"
+#include "SequencePacker.h"
+#include "FramePacker.h"
+#include "DataReader.h"
+#include "StringUtil.h"
+
+#undef max // max is defined in minwindef.h
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+static_assert(sizeof(IndexType) == sizeof(int32_t), "The row indices of the files are used as sparse indices without conversion.");
+
+// Sparse sequence that either points into the mapping (single sample) or owns a copy of the values and indices of its samples.
+struct SparseBinarySequenceData : SparseSequenceData
+{
+    const void* m_data;
+    vector<char> m_valueBuffer;
+    vector<IndexType> m_indexBuffer;
+
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+};
+
+// Same for dense sequences.
+struct DenseBinarySequenceData : DenseSequenceData
+{
+    const void* m_data;
+    vector<char> m_valueBuffer;
+
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+};
+
+// Locations of the values of all samples of a chunk in the mapping, indexed by [sample * numberOfStreams + stream].
+// Sequences keep the chunk (and so the deserializer's mapping) alive.
+class SparseBinaryDeserializer::SparseBinaryChunk : public Chunk, public std::enable_shared_from_this<SparseBinaryChunk>
+{
+public:
+    SparseBinaryChunk(const SparseBinaryDeserializer& parent, const ChunkDescriptor& descriptor)
+        : m_parent(parent), m_firstSample(descriptor.m_firstSample), m_numberOfParsedSamples(0)
+    {
+        m_sparseValues.resize(descriptor.m_numberOfSamples * m_parent.m_numberOfSparseStreams);
+        m_sparseIndices.resize(descriptor.m_numberOfSamples * m_parent.m_numberOfSparseStreams);
+        m_nnzCounts.resize(descriptor.m_numberOfSamples * m_parent.m_numberOfSparseStreams);
+        m_denseValues.resize(descriptor.m_numberOfSamples * m_parent.m_numberOfDenseStreams);
+
+        for (size_t block = descriptor.m_firstBlock; block < descriptor.m_firstBlock + descriptor.m_numberOfBlocks; ++block)
+        {
+            if (m_parent.m_format == SparseBinaryFormat::libSvmBinary)
+                m_parent.ParseLibSvmBinaryBlock(block, *this);
+            else
+                m_parent.ParseSparsePCBlock(block, *this);
+        }
+
+        if (m_numberOfParsedSamples != descriptor.m_numberOfSamples)
+            RuntimeError("SparseBinaryDeserializer: The number of samples of a chunk has changed since '%ls' was indexed.", m_parent.m_fileName.c_str());
+    }
+
+    virtual void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
+    {
+        size_t numberOfSamples = m_parent.m_samplesPerSequence;
+        size_t firstSample = sequenceId * numberOfSamples - m_firstSample;
+        assert(firstSample + numberOfSamples <= m_numberOfParsedSamples);
+
+        size_t numberOfSparseStreams = m_parent.m_numberOfSparseStreams;
+        for (size_t s = 0; s < numberOfSparseStreams; ++s)
+        {
+            auto sequence = make_shared<SparseBinarySequenceData>();
+            sequence->m_nnzCounts.resize(numberOfSamples);
+            size_t totalNnzCount = 0;
+            for (size_t t = 0; t < numberOfSamples; ++t)
+            {
+                sequence->m_nnzCounts[t] = m_nnzCounts[(firstSample + t) * numberOfSparseStreams + s];
+                totalNnzCount += sequence->m_nnzCounts[t];
+            }
+
+            if (numberOfSamples == 1)
+            {
+                sequence->m_data = m_sparseValues[firstSample * numberOfSparseStreams + s];
+                sequence->m_indices = const_cast<IndexType*>(m_sparseIndices[firstSample * numberOfSparseStreams + s]);
+            }
+            else
+            {
+                sequence->m_valueBuffer.resize(totalNnzCount * m_parent.m_elementSize);
+                sequence->m_indexBuffer.resize(totalNnzCount);
+                size_t offset = 0;
+                for (size_t t = 0; t < numberOfSamples; ++t)
+                {
+                    size_t i = (firstSample + t) * numberOfSparseStreams + s;
+                    memcpy(sequence->m_valueBuffer.data() + offset * m_parent.m_elementSize, m_sparseValues[i], m_nnzCounts[i] * m_parent.m_elementSize);
+                    memcpy(sequence->m_indexBuffer.data() + offset, m_sparseIndices[i], m_nnzCounts[i] * sizeof(IndexType));
+                    offset += m_nnzCounts[i];
+                }
+                sequence->m_data = sequence->m_valueBuffer.data();
+                sequence->m_indices = sequence->m_indexBuffer.data();
+            }
+
+            sequence->m_totalNnzCount = (IndexType)totalNnzCount;
+            result.push_back(Finalize(sequence, sequenceId));
+        }
+
+        size_t numberOfDenseStreams = m_parent.m_numberOfDenseStreams;
+        for (size_t d = 0; d < numberOfDenseStreams; ++d)
+        {
+            auto sequence = make_shared<DenseBinarySequenceData>();
+            size_t sampleSize = m_parent.m_streams[numberOfSparseStreams + d]->m_sampleLayout->GetNumElements() * m_parent.m_elementSize;
+            if (numberOfSamples == 1)
+            {
+                sequence->m_data = m_denseValues[firstSample * numberOfDenseStreams + d];
+            }
+            else
+            {
+                sequence->m_valueBuffer.resize(numberOfSamples * sampleSize);
+                for (size_t t = 0; t < numberOfSamples; ++t)
+                    memcpy(sequence->m_valueBuffer.data() + t * sampleSize, m_denseValues[(firstSample + t) * numberOfDenseStreams + d], sampleSize);
+                sequence->m_data = sequence->m_valueBuffer.data();
+            }
+            result.push_back(Finalize(sequence, sequenceId));
+        }
+
+        if (m_parent.m_dssmLabelDimension > 0)
+        {
+            auto sequence = make_shared<DenseBinarySequenceData>();
+            sequence->m_data = m_parent.m_dssmLabelValues.data();
+            result.push_back(Finalize(sequence, sequenceId));
+        }
+    }
+
+private:
+    SequenceDataPtr Finalize(SequenceDataPtr sequence, size_t sequenceId)
+    {
+        sequence->m_id = sequenceId;
+        sequence->m_numberOfSamples = (uint32_t)m_parent.m_samplesPerSequence;
+        sequence->m_elementType = m_parent.m_elementType;
+        sequence->m_chunk = shared_from_this();
+        return sequence;
+    }
+
+public:
+    const SparseBinaryDeserializer& m_parent;
+    size_t m_firstSample;
+    size_t m_numberOfParsedSamples;
+
+    vector<const char*> m_sparseValues;
+    vector<const IndexType*> m_sparseIndices;
+    vector<IndexType> m_nnzCounts;
+    vector<const char*> m_denseValues;
+};
+
+SparseBinaryDeserializer::SparseBinaryDeserializer(SparseBinaryFormat format, const ConfigParameters& config, bool primary)
+    : m_format(format), m_numberOfSparseStreams(0), m_numberOfDenseStreams(0), m_dssmLabelDimension(0), m_samplesPerSequence(1), m_verificationCode(0)
+{
+    UNUSED(primary); // sequences can also be looked up by their index
+
+    wstring precision = config(L"precision", L"float");
+    m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
+    m_elementSize = m_elementType == ElementType::tfloat ? sizeof(float) : sizeof(double);
+
+    m_fileName = (wstring)config(L"file");
+    m_file.reset(new MemoryMappedFile(m_fileName));
+    m_file->AdviseRandomAccess();
+
+    size_t chunkSizeInBytes = config(L"chunkSizeInBytes", (size_t)32 * 1024 * 1024);
+    if (m_format == SparseBinaryFormat::libSvmBinary)
+    {
+        vector<size_t> blockOffsets;
+        ReadLibSvmBinaryHeader(config, blockOffsets);
+        IndexLibSvmBinary(blockOffsets, chunkSizeInBytes);
+    }
+    else
+    {
+        m_samplesPerSequence = config(L"microbatchSize", (size_t)1);
+        if (m_samplesPerSequence == 0)
+            InvalidArgument("SparseBinaryDeserializer: 'microbatchSize' must be positive.");
+        m_verificationCode = (int32_t)config(L"verificationCode", (size_t)0);
+        InitializeSparsePCStreams(config);
+        IndexSparsePC(chunkSizeInBytes, config(L"maxReadData", (size_t)0));
+    }
+
+    size_t numberOfSamples = m_chunks.empty() ? 0 : m_chunks.back().m_firstSample + m_chunks.back().m_numberOfSamples;
+    fprintf(stderr, "SparseBinaryDeserializer: %" PRIu64 " samples in %" PRIu64 " chunks of '%ls'.\n",
+            numberOfSamples, m_chunks.size(), m_fileName.c_str());
+}
+
+void SparseBinaryDeserializer::AddStream(const wstring& name, size_t dimension, StorageType storageType)
+{
+    auto stream = make_shared<StreamDescription>();
+    stream->m_id = m_streams.size();
+    stream->m_name = name;
+    stream->m_sampleLayout = make_shared<TensorShape>(dimension);
+    stream->m_storageType = storageType;
+    stream->m_elementType = m_elementType;
+    m_streams.push_back(stream);
+}
+
+// Reads the names and dimensions of the inputs and the block offsets, see SparseBinaryInput::Init() of the former LibSVMBinaryReader.
+// Inputs can be renamed by a config section 'name = [ rename = "newName" ]'.
+void SparseBinaryDeserializer::ReadLibSvmBinaryHeader(const ConfigParameters& config, vector<size_t>& blockOffsets)
+{
+    map<wstring, wstring> rename;
+    for (const auto& id : config.GetMemberIds())
+    {
+        if (!config.CanBeConfigRecord(id))
+            continue;
+        const ConfigParameters& section = config(id);
+        if (section.ExistsCurrent(L"rename"))
+            rename[msra::strfun::utf16(id)] = (wstring)section(L"rename");
+    }
+
+    const char* data = m_file->GetData();
+    size_t size = m_file->GetSize();
+    size_t pos = 0;
+    auto read = [&](void* value, size_t bytes)
+    {
+        if (pos + bytes > size)
+            RuntimeError("SparseBinaryDeserializer: The header of '%ls' is truncated.", m_fileName.c_str());
+        memcpy(value, data + pos, bytes);
+        pos += bytes;
+    };
+
+    int64_t numberOfRows, numberOfBlocks;
+    int32_t numberOfFeatures, numberOfLabels;
+    read(&numberOfRows, sizeof(numberOfRows));
+    read(&numberOfBlocks, sizeof(numberOfBlocks));
+    read(&numberOfFeatures, sizeof(numberOfFeatures));
+    read(&numberOfLabels, sizeof(numberOfLabels));
+    if (numberOfBlocks < 0 || numberOfFeatures < 0 || numberOfLabels < 0)
+        RuntimeError("SparseBinaryDeserializer: Invalid header of '%ls'.", m_fileName.c_str());
+
+    for (int32_t i = 0; i < numberOfFeatures + numberOfLabels; ++i)
+    {
+        int32_t length, dimension;
+        read(&length, sizeof(length));
+        if (length < 0)
+            RuntimeError("SparseBinaryDeserializer: Invalid header of '%ls'.", m_fileName.c_str());
+        string name(length, '\0');
+        read(&name[0], length);
+        read(&dimension, sizeof(dimension));
+
+        wstring streamName = msra::strfun::utf16(name);
+        if (rename.find(streamName) != rename.end())
+            streamName = rename[streamName];
+        AddStream(streamName, dimension, i < numberOfFeatures ? StorageType::sparse_csc : StorageType::dense);
+    }
+    m_numberOfSparseStreams = numberOfFeatures;
+    m_numberOfDenseStreams = numberOfLabels;
+
+    if (config.ExistsCurrent(L"DSSMLabel"))
+    {
+        const ConfigParameters& dssmConfig = config(L"DSSMLabel");
+        m_dssmLabelDimension = dssmConfig(L"dim");
+        m_dssmLabelValues.assign(m_dssmLabelDimension * m_elementSize, 0);
+        if (m_elementType == ElementType::tfloat)
+            *(float*)m_dssmLabelValues.data() = 1;
+        else
+            *(double*)m_dssmLabelValues.data() = 1;
+        AddStream(L"DSSMLabel", m_dssmLabelDimension, StorageType::dense);
+    }
+
+    // Offsets of the blocks are relative to the end of the offset table.
+    size_t dataStart = pos + numberOfBlocks * sizeof(int64_t);
+    blockOffsets.reserve(numberOfBlocks);
+    for (int64_t i = 0; i < numberOfBlocks; ++i)
+    {
+        int64_t offset;
+        read(&offset, sizeof(offset));
+        blockOffsets.push_back(dataStart + offset);
+    }
+}
+
+void SparseBinaryDeserializer::IndexLibSvmBinary(const vector<size_t>& blockOffsets, size_t chunkSizeInBytes)
+{
+    const char* data = m_file->GetData();
+    size_t size = m_file->GetSize();
+    size_t chunkBytes = 0;
+    size_t numberOfSamples = 0;
+    for (size_t i = 0; i < blockOffsets.size(); ++i)
+    {
+        size_t begin = blockOffsets[i];
+        size_t end = i + 1 < blockOffsets.size() ? blockOffsets[i + 1] : size;
+        if (end > size || begin + sizeof(int32_t) > end)
+            RuntimeError("SparseBinaryDeserializer: Invalid offset of block %d in '%ls'.", (int)i, m_fileName.c_str());
+
+        int32_t blockSamples;
+        memcpy(&blockSamples, data + begin, sizeof(blockSamples));
+        if (blockSamples <= 0)
+            continue;
+
+        if (m_chunks.empty() || chunkBytes >= chunkSizeInBytes)
+        {
+            if (m_chunks.size() >= CHUNKID_MAX)
+                RuntimeError("SparseBinaryDeserializer: Too many chunks in '%ls', increase 'chunkSizeInBytes'.", m_fileName.c_str());
+            m_chunks.push_back(ChunkDescriptor{ m_blocks.size(), 0, numberOfSamples, 0 });
+            chunkBytes = 0;
+        }
+
+        m_blocks.push_back(BlockDescriptor{ begin, end - begin, (size_t)blockSamples });
+        m_chunks.back().m_numberOfBlocks++;
+        m_chunks.back().m_numberOfSamples += blockSamples;
+        chunkBytes += end - begin;
+        numberOfSamples += blockSamples;
+    }
+}
+
+void SparseBinaryDeserializer::ParseLibSvmBinaryBlock(size_t block, SparseBinaryChunk& chunk) const
+{
+    const auto& descriptor = m_blocks[block];
+    const char* p = m_file->GetData() + descriptor.m_fileOffset;
+    const char* end = p + descriptor.m_byteSize;
+
+    size_t numberOfSamples = (size_t)*(const int32_t*)p;
+    p += sizeof(int32_t);
+
+    size_t first = chunk.m_numberOfParsedSamples;
+    for (size_t s = 0; s < m_numberOfSparseStreams; ++s)
+    {
+        size_t nnz = (size_t)*(const int32_t*)p;
+        p += sizeof(int32_t);
+        const char* values = p;
+        p += nnz * m_elementSize;
+        const IndexType* rowIndices = (const IndexType*)p;
+        p += nnz * sizeof(IndexType);
+        const int32_t* columnOffsets = (const int32_t*)p;
+        p += (numberOfSamples + 1) * sizeof(int32_t);
+        if (p > end)
+            RuntimeError("SparseBinaryDeserializer: Block %d of '%ls' is truncated.", (int)block, m_fileName.c_str());
+
+        for (size_t j = 0; j < numberOfSamples; ++j)
+        {
+            size_t i = (first + j) * m_numberOfSparseStreams + s;
+            chunk.m_sparseValues[i] = values + columnOffsets[j] * m_elementSize;
+            chunk.m_sparseIndices[i] = rowIndices + columnOffsets[j];
+            chunk.m_nnzCounts[i] = columnOffsets[j + 1] - columnOffsets[j];
+        }
+    }
+
+    for (size_t d = 0; d < m_numberOfDenseStreams; ++d)
+    {
+        size_t sampleSize = m_streams[m_numberOfSparseStreams + d]->m_sampleLayout->GetNumElements() * m_elementSize;
+        const char* values = p;
+        p += numberOfSamples * sampleSize;
+        if (p > end)
+            RuntimeError("SparseBinaryDeserializer: Block %d of '%ls' is truncated.", (int)block, m_fileName.c_str());
+
+        for (size_t j = 0; j < numberOfSamples; ++j)
+            chunk.m_denseValues[(first + j) * m_numberOfDenseStreams + d] = values + j * sampleSize;
+    }
+
+    chunk.m_numberOfParsedSamples += numberOfSamples;
+}
+
+// Feature sections are the ones with a 'dim', the label section is the one with 'labelDim' or 'labelType',
+// see GetFileConfigNames(). Features are stored in the reverse order of the configuration.
+void SparseBinaryDeserializer::InitializeSparsePCStreams(const ConfigParameters& config)
+{
+    vector<wstring> featureNames, labelNames;
+    GetFileConfigNames(config, featureNames, labelNames);
+    if (labelNames.size() != 1)
+        RuntimeError("SparseBinaryDeserializer: SparsePC requires exactly one label. Their names should match those in NDL definition");
+    if (featureNames.empty())
+        RuntimeError("SparseBinaryDeserializer: features config not found, required in configuration: i.e. 'features=[dim=506530]'");
+
+    for (size_t i = 0; i < featureNames.size(); ++i)
+    {
+        const wstring& name = featureNames[featureNames.size() - i - 1];
+        const ConfigParameters& featureConfig = config(name);
+        size_t dimension = featureConfig(L"dim");
+        if (dimension > numeric_limits<IndexType>::max())
+            RuntimeError("SparseBinaryDeserializer: Dimension (%" PRIu64 ") of '%ls' exceeds the maximum allowed value.", dimension, name.c_str());
+        AddStream(name, dimension, StorageType::sparse_csc);
+    }
+    AddStream(labelNames[0], 1, StorageType::dense);
+
+    m_numberOfSparseStreams = featureNames.size();
+    m_numberOfDenseStreams = 1;
+}
+
+// Walks all records once. Blocks (one per chunk) end after whole sequences; an incomplete last sequence is dropped.
+void SparseBinaryDeserializer::IndexSparsePC(size_t chunkSizeInBytes, size_t maxReadData)
+{
+    const char* data = m_file->GetData();
+    size_t size = m_file->GetSize();
+    size_t recordTail = m_elementSize + (m_verificationCode != 0 ? sizeof(int32_t) : 0);
+
+    size_t blockBegin = 0;
+    size_t blockSamples = 0;
+    size_t numberOfSamples = 0;
+    size_t pos = 0;
+    while (pos < size && (maxReadData == 0 || pos < maxReadData))
+    {
+        for (size_t s = 0; s < m_numberOfSparseStreams; ++s)
+        {
+            if (pos + sizeof(int32_t) > size)
+                RuntimeError("SparseBinaryDeserializer: Record %" PRIu64 " of '%ls' is truncated.", numberOfSamples + blockSamples, m_fileName.c_str());
+            int32_t nnz = *(const int32_t*)(data + pos);
+            if (nnz < 0 || (size_t)nnz > m_streams[s]->m_sampleLayout->GetNumElements())
+                RuntimeError("SparseBinaryDeserializer: Invalid number of non-zero values %d in record %" PRIu64 " of '%ls'.", (int)nnz, numberOfSamples + blockSamples, m_fileName.c_str());
+            pos += sizeof(int32_t) + nnz * (m_elementSize + sizeof(IndexType));
+        }
+
+        if (pos + recordTail > size)
+            RuntimeError("SparseBinaryDeserializer: Record %" PRIu64 " of '%ls' is truncated.", numberOfSamples + blockSamples, m_fileName.c_str());
+        if (m_verificationCode != 0 && *(const int32_t*)(data + pos + m_elementSize) != m_verificationCode)
+            RuntimeError("SparseBinaryDeserializer: Verification code did not match (expected %d) - error in reading data", (int)m_verificationCode);
+        pos += recordTail;
+
+        if (++blockSamples % m_samplesPerSequence == 0 && pos - blockBegin >= chunkSizeInBytes)
+        {
+            m_blocks.push_back(BlockDescriptor{ blockBegin, pos - blockBegin, blockSamples });
+            numberOfSamples += blockSamples;
+            blockBegin = pos;
+            blockSamples = 0;
+        }
+    }
+
+    // The last block ends after its last whole sequence; ParseSparsePCBlock() stops after m_numberOfSamples records.
+    blockSamples -= blockSamples % m_samplesPerSequence;
+    if (blockSamples > 0)
+    {
+        m_blocks.push_back(BlockDescriptor{ blockBegin, pos - blockBegin, blockSamples });
+        numberOfSamples += blockSamples;
+    }
+
+    if (m_blocks.size() > CHUNKID_MAX)
+        RuntimeError("SparseBinaryDeserializer: Too many chunks in '%ls', increase 'chunkSizeInBytes'.", m_fileName.c_str());
+
+    size_t firstSample = 0;
+    for (size_t i = 0; i < m_blocks.size(); ++i)
+    {
+        m_chunks.push_back(ChunkDescriptor{ i, 1, firstSample, m_blocks[i].m_numberOfSamples });
+        firstSample += m_blocks[i].m_numberOfSamples;
+    }
+}
+
+void SparseBinaryDeserializer::ParseSparsePCBlock(size_t block, SparseBinaryChunk& chunk) const
+{
+    const auto& descriptor = m_blocks[block];
+    const char* p = m_file->GetData() + descriptor.m_fileOffset;
+
+    for (size_t j = 0; j < descriptor.m_numberOfSamples; ++j)
+    {
+        size_t sample = chunk.m_numberOfParsedSamples + j;
+        for (size_t s = 0; s < m_numberOfSparseStreams; ++s)
+        {
+            size_t i = sample * m_numberOfSparseStreams + s;
+            size_t nnz = (size_t)*(const int32_t*)p;
+            p += sizeof(int32_t);
+            chunk.m_sparseValues[i] = p;
+            p += nnz * m_elementSize;
+            chunk.m_sparseIndices[i] = (const IndexType*)p;
+            p += nnz * sizeof(IndexType);
+            chunk.m_nnzCounts[i] = (IndexType)nnz;
+        }
+
+        chunk.m_denseValues[sample] = p;
+        p += m_elementSize + (m_verificationCode != 0 ? sizeof(int32_t) : 0);
+    }
+
+    chunk.m_numberOfParsedSamples += descriptor.m_numberOfSamples;
+}
+
+ChunkDescriptions SparseBinaryDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    result.reserve(m_chunks.size());
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = (ChunkIdType)i;
+        cd->m_numberOfSamples = m_chunks[i].m_numberOfSamples;
+        cd->m_numberOfSequences = m_chunks[i].m_numberOfSamples / m_samplesPerSequence;
+        result.push_back(cd);
+    }
+    return result;
+}
+
+void SparseBinaryDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    const auto& chunk = m_chunks[chunkId];
+    size_t firstSequence = chunk.m_firstSample / m_samplesPerSequence;
+    size_t numberOfSequences = chunk.m_numberOfSamples / m_samplesPerSequence;
+    result.reserve(result.size() + numberOfSequences);
+    for (size_t i = firstSequence; i < firstSequence + numberOfSequences; ++i)
+    {
+        SequenceDescription s;
+        s.m_id = i;
+        s.m_numberOfSamples = (uint32_t)m_samplesPerSequence;
+        s.m_chunkId = chunkId;
+        s.m_key.m_sequence = i;
+        s.m_key.m_sample = 0;
+        result.push_back(s);
+    }
+}
+
+bool SparseBinaryDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    size_t sample = key.m_sequence * m_samplesPerSequence;
+    auto chunk = upper_bound(m_chunks.begin(), m_chunks.end(), sample,
+                             [](size_t s, const ChunkDescriptor& c) { return s < c.m_firstSample; });
+    if (chunk == m_chunks.begin() || sample >= (chunk - 1)->m_firstSample + (chunk - 1)->m_numberOfSamples)
+        return false;
+
+    result.m_id = key.m_sequence;
+    result.m_numberOfSamples = (uint32_t)m_samplesPerSequence;
+    result.m_chunkId = (ChunkIdType)(chunk - 1 - m_chunks.begin());
+    result.m_key.m_sequence = key.m_sequence;
+    result.m_key.m_sample = 0;
+    return true;
+}
+
+ChunkPtr SparseBinaryDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    return make_shared<SparseBinaryChunk>(*this, m_chunks[chunkId]);
+}
+
+void SparseBinaryDeserializer::ReadAhead(const vector<ChunkIdType>& chunkIds)
+{
+    for (auto chunkId : chunkIds)
+    {
+        const auto& chunk = m_chunks[chunkId];
+        const auto& first = m_blocks[chunk.m_firstBlock];
+        const auto& last = m_blocks[chunk.m_firstBlock + chunk.m_numberOfBlocks - 1];
+        m_file->WillNeed(first.m_fileOffset, last.m_fileOffset + last.m_byteSize - first.m_fileOffset);
+    }
+}
+
+// The readers do not randomize by default, as their predecessors.
+SparseBinaryReader::SparseBinaryReader(SparseBinaryFormat format, const ConfigParameters& config)
+{
+    m_deserializer = make_shared<SparseBinaryDeserializer>(format, config, true);
+
+    wstring randomize = config(L"randomize", L"none");
+    if (AreEqualIgnoreCase(randomize, L"auto") || AreEqualIgnoreCase(randomize, L"true"))
+    {
+        int verbosity = config(L"verbosity", 0);
+        size_t window = config(L"randomizationWindow", randomizeAuto);
+        m_sequenceEnumerator = make_shared<BlockRandomizer>(verbosity, window, m_deserializer, true /* shouldPrefetch */, false /* useLegacyRandomization */,
+                                                            false /* multithreadedGetNextSequences */, config(L"chunkLoadParallelism", (size_t)1));
+    }
+    else if (AreEqualIgnoreCase(randomize, L"none") || AreEqualIgnoreCase(randomize, L"false"))
+    {
+        m_sequenceEnumerator = make_shared<NoRandomizer>(m_deserializer);
+    }
+    else
+        InvalidArgument("SparseBinaryReader: Unsupported 'randomize' value '%ls', expected 'none' or 'auto'.", randomize.c_str());
+
+    if (format == SparseBinaryFormat::libSvmBinary)
+        m_packer = make_shared<FramePacker>(m_sequenceEnumerator, ReaderBase::GetStreamDescriptions());
+    else
+        m_packer = make_shared<SequencePacker>(m_sequenceEnumerator, ReaderBase::GetStreamDescriptions());
+}
+
+}}}
@@ -0,0 +1,125 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "DataDeserializerBase.h"
+#include "ReaderBase.h"
+#include "Config.h"
+#include "MemoryMappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Binary sparse formats of the LibSVMBinaryReader and the SparsePCReader.
+enum class SparseBinaryFormat
+{
+    // Header with the names and dimensions of the inputs and a table of block offsets, followed by blocks of
+    //     int32 numberOfSamples,
+    //     per feature: int32 nnz, values[nnz], int32 rowIndices[nnz], int32 columnOffsets[numberOfSamples + 1],
+    //     per label:   values[numberOfSamples * dimension].
+    // Every sample is a sequence (frame mode).
+    libSvmBinary,
+
+    // Records of
+    //     per feature (in the reverse order of the configuration): int32 nnz, values[nnz], int32 rowIndices[nnz],
+    //     label value, and the int32 'verificationCode' if configured.
+    // 'microbatchSize' consecutive records form a sequence.
+    sparsePC,
+};
+
+// Deserializer for both formats. The file is memory mapped; chunks are ranges of blocks (libSvmBinary)
+// or of records (sparsePC) of about 'chunkSizeInBytes'. Sequences of a single sample point directly into
+// the mapping, the packer copies them into the (page-locked) minibatch buffers.
+class SparseBinaryDeserializer : public DataDeserializerBase
+{
+public:
+    SparseBinaryDeserializer(SparseBinaryFormat format, const ConfigParameters& config, bool primary);
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+
+    // Locates the samples of a chunk in the mapping.
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    // Chunks only read the mapping.
+    virtual bool SupportsConcurrentChunkLoads() const override
+    {
+        return true;
+    }
+
+    // Pages in the chunks that are going to be loaded next.
+    virtual void ReadAhead(const std::vector<ChunkIdType>& chunkIds) override;
+
+protected:
+    // Sequences are keyed by their index in the file.
+    virtual bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class SparseBinaryChunk;
+    DISABLE_COPY_AND_MOVE(SparseBinaryDeserializer);
+
+    void AddStream(const std::wstring& name, size_t dimension, StorageType storageType);
+
+    void ReadLibSvmBinaryHeader(const ConfigParameters& config, std::vector<size_t>& blockOffsets);
+    void IndexLibSvmBinary(const std::vector<size_t>& blockOffsets, size_t chunkSizeInBytes);
+
+    void InitializeSparsePCStreams(const ConfigParameters& config);
+    void IndexSparsePC(size_t chunkSizeInBytes, size_t maxReadData);
+
+    // Locates the values of all streams of the samples of a block.
+    void ParseLibSvmBinaryBlock(size_t block, SparseBinaryChunk& chunk) const;
+    void ParseSparsePCBlock(size_t block, SparseBinaryChunk& chunk) const;
+
+    // A range of the file with whole samples.
+    struct BlockDescriptor
+    {
+        size_t m_fileOffset;
+        size_t m_byteSize;
+        size_t m_numberOfSamples;
+    };
+
+    // Consecutive blocks read together.
+    struct ChunkDescriptor
+    {
+        size_t m_firstBlock;
+        size_t m_numberOfBlocks;
+        size_t m_firstSample;
+        size_t m_numberOfSamples;
+    };
+
+    SparseBinaryFormat m_format;
+    std::wstring m_fileName;
+    std::unique_ptr<MemoryMappedFile> m_file;
+
+    std::vector<BlockDescriptor> m_blocks;
+    std::vector<ChunkDescriptor> m_chunks;
+
+    ElementType m_elementType;
+    size_t m_elementSize;
+
+    // Streams stored in the file, in file order; the DSSM label stream, if any, comes last.
+    size_t m_numberOfSparseStreams;
+    size_t m_numberOfDenseStreams;
+
+    // Dimension of the 'DSSMLabel' stream of the LibSVMBinaryReader (0: none): a one-hot
+    // vector with the positive document in the first row for every sample.
+    size_t m_dssmLabelDimension;
+    std::vector<char> m_dssmLabelValues;
+
+    size_t m_samplesPerSequence;
+    int32_t m_verificationCode;
+};
+
+// Connects the deserializer with the randomizer and the packer for the legacy reader configurations.
+class SparseBinaryReader : public ReaderBase
+{
+public:
+    SparseBinaryReader(SparseBinaryFormat format, const ConfigParameters& config);
+};
+
+}}}
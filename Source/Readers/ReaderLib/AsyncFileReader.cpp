@@ -0,0 +1,294 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "AsyncFileReader.h"
+#include <algorithm>
+#include <atomic>
+#include "ExceptionCapture.h"
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+AsyncIOService& AsyncIOService::Instance()
+{
+    static AsyncIOService service;
+    return service;
+}
+
+AsyncIOService::AsyncIOService()
+    : m_stop(false)
+{
+}
+
+AsyncIOService::~AsyncIOService()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void AsyncIOService::EnsureQueueDepth(size_t queueDepth)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_workers.size() < queueDepth)
+        m_workers.push_back(std::thread([this]() { WorkerLoop(); }));
+}
+
+size_t AsyncIOService::GetQueueDepth()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_workers.size();
+}
+
+void AsyncIOService::Submit(std::function<void()>&& request)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_workers.empty())
+            LogicError("AsyncIOService: requests were submitted before setting the queue depth.");
+        m_requests.push_back(std::move(request));
+    }
+    m_wakeUp.notify_one();
+}
+
+void AsyncIOService::WorkerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [this]() { return m_stop || !m_requests.empty(); });
+            if (m_stop)
+                return;
+
+            request = std::move(m_requests.front());
+            m_requests.pop_front();
+        }
+
+        // Requests report their own errors to whoever waits for them.
+        request();
+    }
+}
+
+// An open file with positional reads; with overlapped I/O on Windows, as a file position would be shared by all reads.
+class AsyncFileReader::FileHandle
+{
+public:
+    FileHandle(const std::wstring& filename, bool& directIO, uint64_t& fileSize)
+        : m_filename(filename)
+    {
+#ifdef _WIN32
+        DWORD flags = FILE_FLAG_OVERLAPPED | (directIO ? FILE_FLAG_NO_BUFFERING : 0);
+        m_handle = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+        if (m_handle == INVALID_HANDLE_VALUE)
+            RuntimeError("AsyncFileReader: failed to open %ls, error %x.", filename.c_str(), (unsigned int)GetLastError());
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_handle, &size))
+        {
+            DWORD error = GetLastError();
+            CloseHandle(m_handle);
+            RuntimeError("AsyncFileReader: cannot retrieve the size of %ls, error %x.", filename.c_str(), (unsigned int)error);
+        }
+        fileSize = (uint64_t)size.QuadPart;
+#else
+        std::string path = msra::strfun::utf8(filename);
+        m_fileDescriptor = open(path.c_str(), O_RDONLY | (directIO ? O_DIRECT : 0));
+        if (m_fileDescriptor == -1 && directIO && errno == EINVAL)
+        {
+            // Some file systems (i.e. tmpfs) do not support direct I/O, read through the page cache there.
+            fprintf(stderr, "WARNING: AsyncFileReader: %ls does not support direct I/O, it is read through the page cache.\n", filename.c_str());
+            directIO = false;
+            m_fileDescriptor = open(path.c_str(), O_RDONLY);
+        }
+        if (m_fileDescriptor == -1)
+            RuntimeError("AsyncFileReader: failed to open %ls: %s", filename.c_str(), strerror(errno));
+
+        struct stat sb;
+        if (fstat(m_fileDescriptor, &sb) == -1)
+        {
+            close(m_fileDescriptor);
+            RuntimeError("AsyncFileReader: cannot retrieve the size of %ls.", filename.c_str());
+        }
+        fileSize = (uint64_t)sb.st_size;
+#endif
+    }
+
+    ~FileHandle()
+    {
+#ifdef _WIN32
+        CloseHandle(m_handle);
+#else
+        close(m_fileDescriptor);
+#endif
+    }
+
+    // Reads up to 'size' bytes at 'offset', returns the number of bytes read, which is less only at the end of the file.
+    size_t Read(char* buffer, uint64_t offset, size_t size)
+    {
+        size_t bytesRead = 0;
+        while (bytesRead < size)
+        {
+            size_t n = ReadSome(buffer + bytesRead, offset + bytesRead, size - bytesRead);
+            if (n == 0)
+                break;
+            bytesRead += n;
+        }
+        return bytesRead;
+    }
+
+private:
+    size_t ReadSome(char* buffer, uint64_t offset, size_t size)
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (overlapped.hEvent == NULL)
+            RuntimeError("AsyncFileReader: cannot create an event for reading %ls, error %x.", m_filename.c_str(), (unsigned int)GetLastError());
+
+        DWORD bytesRead = 0;
+        DWORD toRead = (DWORD)std::min<size_t>(size, 1u << 30);
+        BOOL ok = ReadFile(m_handle, buffer, toRead, NULL, &overlapped);
+        DWORD error = ok ? ERROR_SUCCESS : GetLastError();
+        if (ok || error == ERROR_IO_PENDING)
+        {
+            ok = GetOverlappedResult(m_handle, &overlapped, &bytesRead, TRUE);
+            error = ok ? ERROR_SUCCESS : GetLastError();
+        }
+        CloseHandle(overlapped.hEvent);
+        if (!ok && error != ERROR_HANDLE_EOF)
+            RuntimeError("AsyncFileReader: error reading %d bytes at position %llu of %ls, error %x.", (int)size, (unsigned long long)offset, m_filename.c_str(), (unsigned int)error);
+        return bytesRead;
+#else
+        for (;;)
+        {
+            ssize_t n = pread(m_fileDescriptor, buffer, size, (off_t)offset);
+            if (n >= 0)
+                return (size_t)n;
+            if (errno != EINTR)
+                RuntimeError("AsyncFileReader: error reading %d bytes at position %llu of %ls: %s", (int)size, (unsigned long long)offset, m_filename.c_str(), strerror(errno));
+        }
+#endif
+    }
+
+    std::wstring m_filename;
+#ifdef _WIN32
+    HANDLE m_handle;
+#else
+    int m_fileDescriptor;
+#endif
+};
+
+static std::shared_ptr<char> AllocateAlignedBuffer(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+    char* buffer = (char*)_aligned_malloc(size, alignment);
+    if (!buffer)
+        throw std::bad_alloc();
+    return std::shared_ptr<char>(buffer, [](char* p) { _aligned_free(p); });
+#else
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, alignment, size) != 0)
+        throw std::bad_alloc();
+    return std::shared_ptr<char>((char*)buffer, [](char* p) { free(p); });
+#endif
+}
+
+AsyncFileReader::AsyncFileReader(const std::wstring& filename, bool directIO, size_t queueDepth)
+    : m_filename(filename), m_directIO(directIO), m_fileSize(0)
+{
+    m_handle = std::make_shared<FileHandle>(filename, m_directIO, m_fileSize);
+    AsyncIOService::Instance().EnsureQueueDepth(queueDepth > 0 ? queueDepth : (size_t)s_defaultQueueDepth);
+}
+
+// The state of a read until its last block is done.
+struct PendingRead
+{
+    std::shared_ptr<char> m_storage;
+    std::shared_ptr<char> m_data; // the requested range inside of m_storage
+    std::promise<std::shared_ptr<char>> m_promise;
+    std::atomic<size_t> m_remainingBlocks;
+    ExceptionCapture m_errors;
+};
+
+std::future<std::shared_ptr<char>> AsyncFileReader::ReadAsync(uint64_t offset, size_t size)
+{
+    if (offset + size > m_fileSize)
+        RuntimeError("AsyncFileReader: attempted to read %d bytes at position %llu, past the end of %ls.", (int)size, (unsigned long long)offset, m_filename.c_str());
+
+    // With direct I/O the range is widened to the alignment, the block size is a multiple of it.
+    uint64_t begin = offset, end = offset + size;
+    if (m_directIO)
+    {
+        begin = begin / s_directIOAlignment * s_directIOAlignment;
+        end = (end + s_directIOAlignment - 1) / s_directIOAlignment * s_directIOAlignment;
+    }
+
+    auto read = std::make_shared<PendingRead>();
+    read->m_storage = AllocateAlignedBuffer(std::max<size_t>(end - begin, 1), s_directIOAlignment);
+    read->m_data = std::shared_ptr<char>(read->m_storage, read->m_storage.get() + (offset - begin));
+    auto result = read->m_promise.get_future();
+    if (size == 0)
+    {
+        read->m_promise.set_value(read->m_data);
+        return result;
+    }
+
+    size_t numBlocks = (size_t)((end - begin + s_blockSize - 1) / s_blockSize);
+    read->m_remainingBlocks = numBlocks;
+    auto handle = m_handle;
+    uint64_t requestedEnd = offset + size;
+    for (size_t i = 0; i < numBlocks; i++)
+    {
+        uint64_t blockBegin = begin + i * s_blockSize;
+        size_t blockSize = (size_t)std::min<uint64_t>((uint64_t)s_blockSize, end - blockBegin);
+        AsyncIOService::Instance().Submit([read, handle, begin, blockBegin, blockSize, requestedEnd]()
+        {
+            read->m_errors.SafeRun([&]()
+            {
+                size_t bytesRead = handle->Read(read->m_storage.get() + (blockBegin - begin), blockBegin, blockSize);
+                // Only the aligned tail past the end of the file may be missing.
+                if (blockBegin + bytesRead < std::min<uint64_t>(blockBegin + blockSize, requestedEnd))
+                    RuntimeError("AsyncFileReader: unexpected end of file at position %llu.", (unsigned long long)(blockBegin + bytesRead));
+            });
+
+            // The last block completes the read.
+            if (--read->m_remainingBlocks == 0)
+            {
+                try
+                {
+                    read->m_errors.RethrowIfHappened();
+                    read->m_promise.set_value(read->m_data);
+                }
+                catch (...)
+                {
+                    read->m_promise.set_exception(std::current_exception());
+                }
+            }
+        });
+    }
+    return result;
+}
+
+}}}
@@ -0,0 +1,99 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Process-wide service that performs the reads submitted by deserializers.
+// Each of its threads has one positional read outstanding, so the number of threads is the queue depth
+// the storage sees, independent of the number of threads that load chunks.
+class AsyncIOService
+{
+public:
+    static AsyncIOService& Instance();
+
+    // Makes sure that at least 'queueDepth' reads can be outstanding at once; the depth only grows.
+    void EnsureQueueDepth(size_t queueDepth);
+
+    size_t GetQueueDepth();
+
+    // Queues a read, to be run on one of the service threads.
+    void Submit(std::function<void()>&& request);
+
+private:
+    AsyncIOService();
+    ~AsyncIOService();
+
+    void WorkerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::deque<std::function<void()>> m_requests;
+    bool m_stop;
+
+    DISABLE_COPY_AND_MOVE(AsyncIOService);
+};
+
+// Reads ranges of a file through the AsyncIOService, each range split into blocks that are read at the same time.
+// With direct I/O the file bypasses the OS page cache (O_DIRECT, or FILE_FLAG_NO_BUFFERING on Windows),
+// the reads then go to aligned buffers with aligned offsets and sizes, of which the requested range is a part.
+// Thread-safe, reads do not share a file position.
+class AsyncFileReader
+{
+public:
+    // queueDepth - reads the service should be able to have outstanding, 0 for the default
+    AsyncFileReader(const std::wstring& filename, bool directIO = false, size_t queueDepth = 0);
+
+    // Starts reading 'size' bytes at 'offset'. The future holds the data once all blocks of the range are read.
+    std::future<std::shared_ptr<char>> ReadAsync(uint64_t offset, size_t size);
+
+    std::shared_ptr<char> Read(uint64_t offset, size_t size)
+    {
+        return ReadAsync(offset, size).get();
+    }
+
+    uint64_t GetFileSize() const
+    {
+        return m_fileSize;
+    }
+
+    bool IsDirectIO() const
+    {
+        return m_directIO;
+    }
+
+    static const size_t s_defaultQueueDepth = 8;
+    static const size_t s_blockSize = 1024 * 1024;
+    static const size_t s_directIOAlignment = 4096;
+
+private:
+    class FileHandle;
+
+    std::wstring m_filename;
+    bool m_directIO;
+    uint64_t m_fileSize;
+
+    // Shared with the outstanding reads, so that the file stays open until the last of them is done.
+    std::shared_ptr<FileHandle> m_handle;
+
+    DISABLE_COPY_AND_MOVE(AsyncFileReader);
+};
+
+typedef std::unique_ptr<AsyncFileReader> AsyncFileReaderPtr;
+
+}}}
@@ -9,8 +9,10 @@
 #include <inttypes.h>
 #include "BlockRandomizer.h"
 #include <algorithm>
+#include <chrono>
 #include <utility>
 #include <deque>
+#include <sstream>
 
 #include "DataReader.h"
 #include "ExceptionCapture.h"
@@ -23,7 +25,10 @@ BlockRandomizer::BlockRandomizer(
     IDataDeserializerPtr deserializer,
     bool shouldPrefetch,
     bool useLegacyRandomization,
-    bool multithreadedGetNextSequence)
+    bool multithreadedGetNextSequence,
+    size_t maxParallelChunkLoads,
+    ReaderThreadPoolPtr threadPool,
+    size_t bucketSizeInSamples)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_sweep(SIZE_MAX),
@@ -33,14 +38,26 @@ BlockRandomizer::BlockRandomizer(
       m_sweepTotalNumberOfSamples(0),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRangeInSamples, useLegacyRandomization)),
       m_multithreadedGetNextSequences(multithreadedGetNextSequence),
-      m_prefetchedChunk(CHUNKID_MAX)
+      m_threadPool(threadPool),
+      m_maxParallelChunkLoads(1),
+      m_fetchAheadEnd(0),
+      m_chunkWorkersNumberOfWorkers(0)
 {
     assert(deserializer != nullptr);
 
     m_launchType = shouldPrefetch ? launch::async : launch::deferred;
 
+    // Several chunks can only be loaded at the same time if the deserializer allows it.
+    if (shouldPrefetch && maxParallelChunkLoads > 1)
+    {
+        if (m_deserializer->SupportsConcurrentChunkLoads())
+            m_maxParallelChunkLoads = maxParallelChunkLoads;
+        else if (m_verbosity >= Warning)
+            fprintf(stderr, "BlockRandomizer: the deserializer does not support concurrent chunk loads, loading one chunk at a time.\n");
+    }
+
     m_streams = m_deserializer->GetStreamDescriptions();
-    m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer);
+    m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer, bucketSizeInSamples);
 
     // Calculate total number of samples.
     m_sweepTotalNumberOfSamples = 0;
@@ -55,12 +72,27 @@ size_t BlockRandomizer::GetCurrentSamplePosition()
     return m_globalSamplePosition;
 }
 
+bool BlockRandomizer::SetSequenceTransformation(const SequenceTransformation& transformation)
+{
+    if (!m_threadPool && !m_multithreadedGetNextSequences)
+    {
+        return false;
+    }
+
+    m_sequenceTransformation = transformation;
+    return true;
+}
+
 // Start a new epoch.
 void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
 {
     m_currentWindowRange = ClosedOpenChunkInterval{};
+    m_fetchAheadEnd = 0;
 
     m_config = config;
+    if (m_chunkLocalityCorpus && m_sweep != SIZE_MAX && m_chunkWorkersNumberOfWorkers != std::max<size_t>(config.m_numberOfWorkers, 1))
+        AssignChunksToWorkers();
+
     if (config.m_totalEpochSizeInSamples == requestDataSize)
     {
         m_epochSize = m_sweepTotalNumberOfSamples;
@@ -108,7 +140,58 @@ void BlockRandomizer::PrepareNewSweepIfNeeded(size_t samplePosition)
         // Resetting sequence randomizer.
         m_sequenceRandomizer->Reset(m_sweep);
         m_currentWindowRange = {};
+        m_fetchAheadEnd = 0;
+
+        AssignChunksToWorkers();
+    }
+}
+
+void BlockRandomizer::SetLocalityAwareChunkAssignment(CorpusDescriptorPtr corpus)
+{
+    assert(corpus != nullptr);
+    m_chunkLocalityCorpus = corpus;
+    if (m_sweep != SIZE_MAX)
+        AssignChunksToWorkers();
+}
+
+void BlockRandomizer::AssignChunksToWorkers()
+{
+    if (!m_chunkLocalityCorpus)
+        return;
+
+    // A worker takes chunks of others only when it would exceed its share by this fraction.
+    const double maxImbalance = 0.05;
+
+    const auto& chunks = m_chunkRandomizer->GetRandomizedChunks();
+    size_t numberOfWorkers = std::max<size_t>(m_config.m_numberOfWorkers, 1);
+    size_t capacity = (size_t)(m_sweepTotalNumberOfSamples * (1 + maxImbalance) / numberOfWorkers) + 1;
+
+    // The chunks are visited in the randomized order, so the chunks that do not fit at their preferred worker
+    // are spread over the sweep.
+    std::vector<size_t> workerSamples(numberOfWorkers, 0);
+    m_chunkWorkers.resize(chunks.size());
+    size_t numLocal = 0;
+    for (const auto& chunk : chunks)
+    {
+        size_t preferred = m_chunkLocalityCorpus->GetChunkLocality(chunk.m_original->m_id);
+        if (preferred >= numberOfWorkers)
+            preferred = chunk.m_original->m_id % numberOfWorkers;
+
+        size_t worker = preferred;
+        if (workerSamples[preferred] + chunk.m_original->m_numberOfSamples > capacity)
+            worker = std::min_element(workerSamples.begin(), workerSamples.end()) - workerSamples.begin();
+        else
+            numLocal++;
+
+        m_chunkWorkers[chunk.m_chunkId] = worker;
+        workerSamples[worker] += chunk.m_original->m_numberOfSamples;
     }
+
+    m_chunkWorkersNumberOfWorkers = numberOfWorkers;
+
+    if (m_verbosity >= Notification)
+        fprintf(stderr, "BlockRandomizer::AssignChunksToWorkers: %" PRIu64 " of %" PRIu64 " chunks assigned to their preferred worker in sweep %" PRIu64 ", %" PRIu64 " workers\n",
+                numLocal, chunks.size(), m_sweep, numberOfWorkers);
 }
 
 // Gets next sequences not exceeding sampleCount.
@@ -145,6 +228,14 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
 
     result.m_data.resize(m_streams.size(), std::vector<SequenceDataPtr>(decimated.size()));
 
+    // Sequences of the minibatch come from random places of the input,
+    // let the deserializer fetch them in its own order before they are read in parallel.
+    std::vector<ChunkIdType> chunkIds;
+    chunkIds.reserve(decimated.size());
+    for (const auto& description : decimated)
+        chunkIds.push_back(description.m_chunk->m_original->m_id);
+    m_deserializer->ReadAhead(chunkIds);
+
     auto process = [&](int i) -> void {
         const auto& description = decimated[i];
         std::vector<SequenceDataPtr> sequence;
@@ -155,13 +246,22 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
         }
 
         it->second->GetSequence(description.m_id, sequence);
+        if (m_sequenceTransformation)
+        {
+            m_sequenceTransformation(sequence);
+        }
+
         for (int j = 0; j < m_streams.size(); ++j)
         {
             result.m_data[j][i] = sequence[j];
         }
     };
 
-    if (m_multithreadedGetNextSequences)
+    if (m_threadPool)
+    {
+        m_threadPool->ParallelFor(decimated.size(), [&process](size_t i) { process((int)i); });
+    }
+    else if (m_multithreadedGetNextSequences)
     {
         ExceptionCapture capture;
 #pragma omp parallel for schedule(dynamic)
@@ -176,8 +276,7 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
     }
 
     // Now it is safe to start the new chunk prefetch.
-    ChunkIdType chunkToPrefetchNext = GetChunkToPrefetch(windowRange);
-    Prefetch(chunkToPrefetchNext);
+    Prefetch(windowRange);
 
     return result;
 }
@@ -228,7 +327,7 @@ void BlockRandomizer::Decimate(const std::vector<RandomizedSequenceDescription>&
     decimated.reserve(all.size());
     for (const auto& sequence : all)
     {
-        if (sequence.m_chunk->m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank)
+        if (IsChunkOfThisWorker(*sequence.m_chunk))
         {
             decimated.push_back(sequence);
         }
@@ -260,7 +359,7 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
     for (size_t i = windowRange.m_begin; i < windowRange.m_end; ++i)
     {
         auto const& chunk = m_chunkRandomizer->GetRandomizedChunks()[i];
-        if (chunk.m_chunkId % m_config.m_numberOfWorkers != m_config.m_workerRank)
+        if (!IsChunkOfThisWorker(chunk))
         {
             continue;
         }
@@ -280,7 +379,10 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
     // TODO diagnostics for paged out chunks?
     m_chunks.swap(chunks);
 
-    // Adding new ones.
+    // Adding new ones. All missing chunks of the window are loaded in parallel,
+    // keeping at most m_maxParallelChunkLoads loads in flight.
+    std::vector<ChunkIdType> toLoad;
+    std::vector<ChunkIdType> randomizedIds;
     for (size_t i = windowRange.m_begin; i < windowRange.m_end; ++i)
     {
         if (!needed[i - windowRange.m_begin])
@@ -289,31 +391,28 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
         }
 
         auto const& chunk = m_chunkRandomizer->GetRandomizedChunks()[i];
-        if (chunk.m_original->m_id == m_prefetchedChunk && m_prefetch.valid())
+        toLoad.push_back(chunk.m_original->m_id);
+        randomizedIds.push_back(chunk.m_chunkId);
+    }
+
+    size_t started = 0;
+    for (size_t i = 0; i < toLoad.size(); ++i)
+    {
+        for (; started < toLoad.size() && started < i + m_maxParallelChunkLoads; ++started)
         {
-            // Taking prefetched chunk.
-            m_chunks[chunk.m_original->m_id] = m_prefetch.get();
-            if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in prefetched chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
-                chunk.m_chunkId,
-                chunk.m_original->m_id,
-                ++numLoadedChunks);
+            StartChunkLoad(toLoad[started]);
         }
-        else
-        {
-            // Make sure we have no outstanding prefetches.
-            if (m_prefetch.valid())
-            {
-                m_prefetch.wait();
-            }
-
-            m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
-            if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
-                chunk.m_chunkId,
-                chunk.m_original->m_id,
+
+        auto load = m_chunkLoads.find(toLoad[i]);
+        assert(load != m_chunkLoads.end());
+        m_chunks[toLoad[i]] = load->second.get();
+        m_chunkLoads.erase(load);
+
+        if (m_verbosity >= Information)
+            fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
+                randomizedIds[i],
+                toLoad[i],
                 ++numLoadedChunks);
-        }
     }
 
     if (m_verbosity >= Notification)
@@ -323,42 +422,118 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 m_chunkRandomizer->GetRandomizedChunks()[windowRange.m_end - 1].m_chunkId);
 }
 
-// Identifies chunk id that should be prefetched.
-ChunkIdType BlockRandomizer::GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange)
+// Identifies chunk ids that should be prefetched.
+std::vector<ChunkIdType> BlockRandomizer::GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange)
 {
-    ChunkIdType toBePrefetched = CHUNKID_MAX;
+    std::vector<ChunkIdType> toBePrefetched;
     auto current = windowRange.m_end;
-    while (current < m_chunkRandomizer->GetRandomizedChunks().size())
+    while (current < m_chunkRandomizer->GetRandomizedChunks().size() && toBePrefetched.size() < m_maxParallelChunkLoads)
     {
         const auto& chunk = m_chunkRandomizer->GetRandomizedChunks()[current];
-        if (chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank &&
+        if (IsChunkOfThisWorker(chunk) &&
             m_chunks.find(chunk.m_original->m_id) == m_chunks.end())
         {
-            toBePrefetched = chunk.m_original->m_id;
-            break;
+            toBePrefetched.push_back(chunk.m_original->m_id);
         }
         ++current;
     }
     return toBePrefetched;
 }
 
-// Performs io prefetch of the specified chunk if needed.
-void BlockRandomizer::Prefetch(ChunkIdType chunkId)
+// Performs io prefetch of the chunks following the window if needed.
+void BlockRandomizer::Prefetch(const ClosedOpenChunkInterval& windowRange)
 {
-    // Start new prefetch if necessary.
-    if (m_prefetchedChunk != chunkId && chunkId != CHUNKID_MAX)
+    std::vector<ChunkIdType> toBePrefetched = GetChunksToPrefetch(windowRange);
+
+    // Drop prefetched chunks that are not going to be used next (i.e. after a new sweep is randomized),
+    // so that they do not stay in memory.
+    for (auto load = m_chunkLoads.begin(); load != m_chunkLoads.end();)
     {
-        // Wait to make sure there is no outstanding prefetches.
-        if (m_prefetch.valid())
+        if (std::find(toBePrefetched.begin(), toBePrefetched.end(), load->first) == toBePrefetched.end())
         {
-            m_prefetch.wait();
+            if (load->second.valid())
+                load->second.wait();
+            load = m_chunkLoads.erase(load);
         }
+        else
+            ++load;
+    }
+
+    for (auto chunkId : toBePrefetched)
+    {
+        StartChunkLoad(chunkId);
+    }
+
+    FetchAhead(windowRange);
+}
+
+// Hints the chunks of the window following the given one to the deserializer, each of them once per sweep,
+// so that it can fetch their data from slow storage while the current window is used.
+void BlockRandomizer::FetchAhead(const ClosedOpenChunkInterval& windowRange)
+{
+    const auto& chunks = m_chunkRandomizer->GetRandomizedChunks();
+    size_t begin = std::max<size_t>(m_fetchAheadEnd, windowRange.m_end);
+    size_t end = std::min<size_t>(chunks.size(), windowRange.m_end + (windowRange.m_end - windowRange.m_begin));
+    if (begin >= end)
+        return;
+
+    std::vector<ChunkIdType> chunkIds;
+    for (size_t i = begin; i < end; ++i)
+    {
+        if (IsChunkOfThisWorker(chunks[i]))
+            chunkIds.push_back(chunks[i].m_original->m_id);
+    }
+    m_fetchAheadEnd = end;
+
+    if (!chunkIds.empty())
+        m_deserializer->FetchAhead(chunkIds);
+}
+
+void BlockRandomizer::StartChunkLoad(ChunkIdType chunkId)
+{
+    if (m_chunkLoads.find(chunkId) != m_chunkLoads.end())
+    {
+        // Already loading.
+        return;
+    }
+
+    // Make sure there are no outstanding loads if the deserializer does not support concurrent ones.
+    if (m_maxParallelChunkLoads == 1)
+    {
+        WaitForOutstandingChunkLoads();
+    }
+
+    // chunk data is allocated and filled by the loading thread, so it lands on the reader NUMA node
+    m_chunkLoads[chunkId] = std::async(m_launchType, [this, chunkId]()
+    {
+        ReaderNumaNodeScope numaNode;
+        auto start = std::chrono::steady_clock::now();
+        auto chunk = m_deserializer->GetChunk(chunkId);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::lock_guard<std::mutex> lock(m_chunkLoadSecondsMutex);
+        m_chunkLoadSeconds.push_back(seconds);
+        return chunk;
+    });
+
+    if (m_verbosity >= Debug)
+        fprintf(stderr, "BlockRandomizer::StartChunkLoad: loading original chunk: %u\n", chunkId);
+}
 
-        m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+void BlockRandomizer::TakeChunkLoadSeconds(std::vector<double>& seconds)
+{
+    std::lock_guard<std::mutex> lock(m_chunkLoadSecondsMutex);
+    seconds.insert(seconds.end(), m_chunkLoadSeconds.begin(), m_chunkLoadSeconds.end());
+    m_chunkLoadSeconds.clear();
+}
 
-        if (m_verbosity >= Debug)
-            fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
+void BlockRandomizer::WaitForOutstandingChunkLoads()
+{
+    for (auto& load : m_chunkLoads)
+    {
+        if (load.second.valid())
+        {
+            load.second.wait();
+        }
     }
 }
 
@@ -373,9 +548,55 @@ void BlockRandomizer::SetCurrentSamplePosition(size_t currentSamplePosition)
     m_globalSamplePosition = m_sweep * m_sweepTotalNumberOfSamples + newOffset;
 }
 
+std::string BlockRandomizer::GetState()
+{
+    if (m_sweep == SIZE_MAX)
+        return std::string();
+
+    std::ostringstream stream;
+    stream << "BlockRandomizer " << m_sweepTotalNumberOfSamples << ' ' << m_sweep << ' ' << m_globalSamplePosition << ' ';
+    m_sequenceRandomizer->SaveState(stream);
+    return stream.str();
+}
+
+bool BlockRandomizer::SetState(const std::string& state)
+{
+    std::istringstream stream(state);
+    std::string tag;
+    size_t sweepTotalNumberOfSamples, sweep, globalSamplePosition;
+    stream >> tag >> sweepTotalNumberOfSamples >> sweep >> globalSamplePosition;
+    if (!stream || tag != "BlockRandomizer")
+        return false;
+
+    if (sweepTotalNumberOfSamples != m_sweepTotalNumberOfSamples)
+        RuntimeError("BlockRandomizer::SetState: the state was saved for a sweep of %" PRIu64 " samples, the input has %" PRIu64 " samples.",
+                     sweepTotalNumberOfSamples, m_sweepTotalNumberOfSamples);
+
+    // Randomizes the chunks of the sweep, the sequence randomizer is overwritten by the state.
+    PrepareNewSweepIfNeeded(sweep * m_sweepTotalNumberOfSamples);
+    m_sequenceRandomizer->RestoreState(stream);
+    m_globalSamplePosition = globalSamplePosition;
+
+    // The chunks of the restored window are loaded with the next sequences.
+    m_currentWindowRange = ClosedOpenChunkInterval{};
+    m_fetchAheadEnd = 0;
+
+    if (m_verbosity >= Notification)
+        fprintf(stderr, "BlockRandomizer::SetState: restored sweep %" PRIu64 " at sample %" PRIu64 "\n", m_sweep, m_globalSamplePosition);
+    return true;
+}
+
 void BlockRandomizer::SetConfiguration(const ReaderConfiguration& config)
 {
     *((ReaderConfiguration*)&m_config) = config;
+
+    // The assignment depends on the number of workers, i.e. when the reading becomes distributed.
+    if (m_chunkLocalityCorpus && m_sweep != SIZE_MAX && m_chunkWorkersNumberOfWorkers != std::max<size_t>(config.m_numberOfWorkers, 1))
+    {
+        AssignChunksToWorkers();
+        m_currentWindowRange = ClosedOpenChunkInterval{};
+        m_fetchAheadEnd = 0;
+    }
 }
 
 }}}
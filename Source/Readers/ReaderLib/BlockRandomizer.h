@@ -11,7 +11,10 @@
 #include "DataDeserializer.h"
 #include "ChunkRandomizer.h"
 #include "SequenceRandomizer.h"
+#include "ReaderThreadPool.h"
+#include "CorpusDescriptor.h"
 #include <future>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -41,7 +44,10 @@ public:
         IDataDeserializerPtr deserializer,
         bool shouldPrefetch,
         bool useLegacyRandomization = false,
-        bool multithreadedGetNextSequences = false);
+        bool multithreadedGetNextSequences = false,
+        size_t maxParallelChunkLoads = 1,
+        ReaderThreadPoolPtr threadPool = nullptr,
+        size_t bucketSizeInSamples = 0);
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -58,19 +64,44 @@ public:
     // Returns current position in the global timeline. The returned value is in samples.
     size_t GetCurrentSamplePosition() override;
 
+    // Sequences are transformed right after deserialization if they are deserialized in parallel.
+    bool SetSequenceTransformation(const SequenceTransformation& transformation) override;
+
     ~BlockRandomizer()
     {
-        if (m_prefetch.valid())
-        {
-            m_prefetch.wait();
-        }
+        WaitForOutstandingChunkLoads();
     }
 
     void SetCurrentSamplePosition(size_t currentSamplePosition) override;
 
+    // The state consists of the sweep, the global position and the state of the sequence randomizer,
+    // restoring it randomizes the chunks of the sweep and loads only the sequence descriptions of the window.
+    std::string GetState() override;
+    bool SetState(const std::string& state) override;
+
     void SetConfiguration(const ReaderConfiguration& config) override;
 
+    void TakeChunkLoadSeconds(std::vector<double>& seconds) override;
+
+    // Switches from round robin decimation of the randomized chunks to a locality-aware assignment:
+    // each chunk goes to the worker that holds it locally according to the locality map of the corpus,
+    // or, for chunks not in the map, to a fixed home worker, so that it is found in the page cache in the next sweep.
+    // The assignment is computed once per sweep from the sweep and the number of workers only, so all workers agree on it,
+    // and is balanced, a worker gets other chunks when it would get noticeably more samples than its share.
+    void SetLocalityAwareChunkAssignment(CorpusDescriptorPtr corpus);
+
 private:
+    // Returns true if the randomized chunk is read by this worker.
+    bool IsChunkOfThisWorker(const RandomizedChunk& chunk) const
+    {
+        if (m_chunkWorkers.empty())
+            return chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank;
+        return m_chunkWorkers[chunk.m_chunkId] == m_config.m_workerRank;
+    }
+
+    // Computes the locality-aware assignment of the randomized chunks of the current sweep, if enabled.
+    void AssignChunksToWorkers();
+
     // Load data for chunks if needed.
     void LoadDataChunks(const ClosedOpenChunkInterval& windowRange);
 
@@ -84,11 +115,20 @@ private:
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
-    // Performs io prefetch of the specified chunk if needed.
-    void Prefetch(ChunkIdType chunkId);
+    // Starts io prefetch of the chunks following the given window, and drops prefetched chunks that are not needed anymore.
+    void Prefetch(const ClosedOpenChunkInterval& windowRange);
+
+    // Hints the chunks of the next randomization window to the deserializer.
+    void FetchAhead(const ClosedOpenChunkInterval& windowRange);
 
-    // Returns next candidate for the prefetch in the given range.
-    ChunkIdType GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange);
+    // Returns next candidates for the prefetch after the given range, at most m_maxParallelChunkLoads.
+    std::vector<ChunkIdType> GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange);
+
+    // Starts loading of the specified original chunk, if it is not loaded or being loaded yet.
+    void StartChunkLoad(ChunkIdType chunkId);
+
+    // Waits till all started chunk loads have finished.
+    void WaitForOutstandingChunkLoads();
 
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
@@ -128,6 +168,12 @@ private:
     // Whether to get sequences using multiple thread.
     bool m_multithreadedGetNextSequences;
 
+    // Threads used to get sequences, if not set OpenMP is used when m_multithreadedGetNextSequences is true.
+    ReaderThreadPoolPtr m_threadPool;
+
+    // Applied to each sequence right after it has been deserialized, can be empty.
+    SequenceTransformation m_sequenceTransformation;
+
     // General configuration
     // TODO generalize those for ReaderLib / Reader / CNTK
     enum VerbosityLevel
@@ -140,15 +186,31 @@ private:
 
     int m_verbosity;
 
-    // Prefetch future.
-    std::future<ChunkPtr> m_prefetch;
+    // Started chunk loads, original chunk id -> chunk future.
+    std::map<ChunkIdType, std::future<ChunkPtr>> m_chunkLoads;
+    // Durations of the finished chunk loads, which run on their own threads if prefetching.
+    std::vector<double> m_chunkLoadSeconds;
+    std::mutex m_chunkLoadSecondsMutex;
     // Whether to have async or deferred prefetch.
     launch m_launchType;
-    // Prefetched original chunk id.
-    ChunkIdType m_prefetchedChunk;
+    // Maximum number of chunks loaded in parallel, also the number of chunks prefetched ahead of the window.
+    // Greater than one only if the deserializer supports concurrent chunk loads.
+    size_t m_maxParallelChunkLoads;
 
     // Current loaded chunks.
     ClosedOpenChunkInterval m_currentWindowRange;
+
+    // Randomized chunks up to this one (in the current sweep) were hinted to the deserializer with FetchAhead().
+    size_t m_fetchAheadEnd;
+
+    // Locality map for the locality-aware chunk assignment, null for round robin.
+    CorpusDescriptorPtr m_chunkLocalityCorpus;
+
+    // Worker rank per randomized chunk of the current sweep, empty for round robin.
+    std::vector<size_t> m_chunkWorkers;
+
+    // Number of workers m_chunkWorkers was computed for.
+    size_t m_chunkWorkersNumberOfWorkers;
 };
 
 }}}
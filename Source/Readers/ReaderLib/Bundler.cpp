@@ -7,17 +7,121 @@
 #include "Bundler.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
-#include <set>
+#include <algorithm>
+#include "fileutil.h"
+#include "FileLock.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-// Represents bundled chunk description with possible cleansed data.
+static const char c_joinIndexMagic[8] = { 'C', 'N', 'T', 'K', 'J', 'O', 'I', 'N' };
+static const uint32_t c_joinIndexVersion = 1;
+
+// How long to wait for another process that writes the same join index.
+static const int c_joinIndexWaitSeconds = 600;
+
+// Represents bundled chunk description.
 struct Bundler::BundlerChunkDescription : public ChunkDescription
 {
     ChunkDescriptionPtr m_original;
 
-    // Sequences that are invalid in at least one deserializer.
-    std::set<size_t> m_invalid;
+    // Index of the driving chunk in the join index.
+    size_t m_joinedChunk;
+};
+
+// Layout of the join index file: this header, a JoinedChunk per driving chunk, then the join records.
+// All fields up to m_numberOfRecords identify the deserializers the index is built for.
+struct Bundler::JoinIndexHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_numberOfDeserializers;
+    uint64_t m_fingerprint;
+    uint64_t m_numberOfChunks;
+    uint64_t m_numberOfRecords;
+};
+
+static inline bool KeyLess(const KeyType& a, const KeyType& b)
+{
+    return a.m_sequence < b.m_sequence || (a.m_sequence == b.m_sequence && a.m_sample < b.m_sample);
+}
+
+static inline bool KeyEqual(const KeyType& a, const KeyType& b)
+{
+    return a.m_sequence == b.m_sequence && a.m_sample == b.m_sample;
+}
+
+// Streams over the sequences of a deserializer in chunk order, keeping a single chunk of descriptions in memory.
+// Checks that the keys are strictly ascending over all chunks.
+class Bundler::SequenceCursor
+{
+public:
+    SequenceCursor(IDataDeserializerPtr deserializer)
+        : m_deserializer(deserializer), m_chunks(deserializer->GetChunkDescriptions()), m_nextChunk(0), m_position(0), m_ordered(true), m_hasLast(false)
+    {
+    }
+
+    // Loads the next non empty chunk, returns false at the end or if the keys are not ascending.
+    bool NextChunk()
+    {
+        m_sequences.clear();
+        m_position = 0;
+        while (m_sequences.empty() && m_nextChunk < m_chunks.size())
+        {
+            m_chunkId = m_chunks[m_nextChunk++]->m_id;
+            m_deserializer->GetSequencesForChunk(m_chunkId, m_sequences);
+        }
+
+        for (const auto& s : m_sequences)
+        {
+            if (m_hasLast && !KeyLess(m_last, s.m_key))
+            {
+                m_ordered = false;
+                return false;
+            }
+
+            m_last = s.m_key;
+            m_hasLast = true;
+        }
+
+        return !m_sequences.empty();
+    }
+
+    // Moves to the first sequence with a key not less than the given one, returns false if there is none.
+    bool Seek(const KeyType& key)
+    {
+        for (;;)
+        {
+            if (m_position == m_sequences.size() && !NextChunk())
+                return false;
+
+            if (!KeyLess(m_sequences[m_position].m_key, key))
+                return true;
+            m_position++;
+        }
+    }
+
+    SequenceDescription Current() const
+    {
+        SequenceDescription result = m_sequences[m_position];
+        result.m_chunkId = m_chunkId;
+        return result;
+    }
+
+    bool IsOrdered() const
+    {
+        return m_ordered;
+    }
+
+private:
+    IDataDeserializerPtr m_deserializer;
+    ChunkDescriptions m_chunks;
+    size_t m_nextChunk;
+    ChunkIdType m_chunkId;
+    std::vector<SequenceDescription> m_sequences;
+    size_t m_position;
+    bool m_ordered;
+    bool m_hasLast;
+    KeyType m_last;
 };
 
 Bundler::Bundler(
@@ -25,7 +129,7 @@ Bundler::Bundler(
     IDataDeserializerPtr driver,
     std::vector<IDataDeserializerPtr> deserializers,
     bool cleanse)
-    : m_deserializers(deserializers), m_driver(driver)
+    : m_deserializers(deserializers), m_driver(driver), m_joinedChunks(nullptr), m_joinRecords(nullptr)
 {
     m_verbosity = readerConfig(L"verbosity", 0);
 
@@ -40,6 +144,14 @@ Bundler::Bundler(
         }
     }
 
+    std::wstring joinMethod = readerConfig(L"joinMethod", L"lookup");
+    if (joinMethod != L"lookup" && joinMethod != L"merge")
+    {
+        InvalidArgument("Unsupported joinMethod '%ls', expected 'lookup' or 'merge'.", joinMethod.c_str());
+    }
+
+    m_mergeJoin = joinMethod == L"merge";
+    m_joinIndexPath = static_cast<const std::wstring&>(readerConfig(L"joinIndexFile", L""));
     m_cleanse = cleanse;
     CreateChunkDescriptions();
 }
@@ -69,7 +181,7 @@ void Bundler::CreateChunkDescriptions()
     m_chunks.reserve(chunks.size());
 
     if (m_verbosity)
-        fprintf(stderr, "Bundler::CreateChunkDescriptions(): creating descriptions for %" PRIu64 " chunks\n", m_chunks.size());
+        fprintf(stderr, "Bundler::CreateChunkDescriptions(): creating descriptions for %" PRIu64 " chunks\n", chunks.size());
 
     // If there is not cleaning required simply build chunks based on the chunk descriptions of the primary deserializer.
     if (!m_cleanse)
@@ -81,6 +193,7 @@ void Bundler::CreateChunkDescriptions()
             cd->m_numberOfSequences = c->m_numberOfSequences;
             cd->m_id = (ChunkIdType) m_chunks.size();
             cd->m_original = c;
+            cd->m_joinedChunk = m_chunks.size();
             m_chunks.push_back(cd);
         }
         return;
@@ -89,64 +202,244 @@ void Bundler::CreateChunkDescriptions()
     if (m_verbosity)
         fprintf(stderr, "Bundler::CreateChunkDescriptions(): starting to clean chunks\n");
 
-    m_takePrimarySequenceLength = true;
+    JoinIndexHeader key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.m_magic, c_joinIndexMagic, sizeof(key.m_magic));
+    key.m_version = c_joinIndexVersion;
+    key.m_numberOfDeserializers = (uint32_t)m_deserializers.size();
+    key.m_numberOfChunks = chunks.size();
+    if (!m_joinIndexPath.empty())
+        key.m_fingerprint = ComputeFingerprint();
+
+    auto join = [&]
+    {
+        if (!m_mergeJoin || !TryMergeJoin(chunks))
+            LookupJoin(chunks);
+        m_joinedChunks = m_joinedChunkBuffer.data();
+        m_joinRecords = m_joinRecordBuffer.data();
+    };
+
+    if (m_joinIndexPath.empty())
+    {
+        join();
+    }
+    else if (TryLoadJoinIndex(m_joinIndexPath, key))
+    {
+        fprintf(stderr, "Bundler: Loaded the join index '%ls'.\n", m_joinIndexPath.c_str());
+    }
+    else
+    {
+        // Several workers of a distributed job are likely to start at the same time:
+        // the one that gets the lock of the index writes it, others wait for it.
+        BuildOrWaitForCache(m_joinIndexPath, c_joinIndexWaitSeconds, true,
+            [&] { return TryLoadJoinIndex(m_joinIndexPath, key); },
+            join,
+            [&]
+            {
+                key.m_numberOfRecords = m_joinRecordBuffer.size() / RecordSize();
+                WriteJoinIndex(m_joinIndexPath, key);
+            });
+    }
+
+    // Build a chunk for valid sequences.
+    for (size_t chunkIndex = 0; chunkIndex < chunks.size(); ++chunkIndex)
+    {
+        const JoinedChunk& joined = m_joinedChunks[chunkIndex];
+        if (joined.m_numberOfSamples > 0)
+        {
+            auto cd = std::make_shared<BundlerChunkDescription>();
+            cd->m_numberOfSamples = joined.m_numberOfSamples;
+            cd->m_numberOfSequences = joined.m_numberOfSequences;
+            cd->m_id = (ChunkIdType) m_chunks.size();
+            cd->m_original = chunks[chunkIndex];
+            cd->m_joinedChunk = chunkIndex;
+            m_chunks.push_back(cd);
+        }
+    }
+
+    if (m_verbosity)
+        fprintf(stderr, "Bundler::CreateChunkDescriptions(): finished cleaning of %" PRIu64 " chunks\n", m_chunks.size());
+}
+
+size_t Bundler::AddJoinRecord(size_t sequenceIndex, const SequenceDescription& sequence, const std::vector<SequenceDescription>& joined)
+{
+    uint32_t sequenceSamples = sequence.m_numberOfSamples;
+    for (const auto& s : joined)
+        sequenceSamples = std::max(sequenceSamples, s.m_numberOfSamples);
+
+    m_joinRecordBuffer.push_back((uint32_t)sequenceIndex);
+    m_joinRecordBuffer.push_back(sequenceSamples);
+    for (const auto& s : joined)
+    {
+        if (s.m_id > UINT32_MAX)
+            RuntimeError("Bundler: Sequence id %" PRIu64 " exceeds the range of the join index.", s.m_id);
+        m_joinRecordBuffer.push_back(s.m_chunkId);
+        m_joinRecordBuffer.push_back((uint32_t)s.m_id);
+    }
+
+    return sequenceSamples;
+}
+
+// Looks up every sequence of the driving deserializer in the other deserializers.
+void Bundler::LookupJoin(const ChunkDescriptions& chunks)
+{
+    m_joinedChunkBuffer.assign(chunks.size(), JoinedChunk());
+    m_joinRecordBuffer.clear();
 
-    // Otherwise build bundling chunks using underlying deserializers.
     std::vector<SequenceDescription> sequenceDescriptions;
     sequenceDescriptions.reserve(chunks.front()->m_numberOfSequences);
-    SequenceDescription s;
+    std::vector<SequenceDescription> joined(m_deserializers.size() - 1);
     for (ChunkIdType chunkIndex = 0; chunkIndex < chunks.size(); ++chunkIndex)
     {
-        size_t numberOfSamples = 0;
-        size_t numberOfSequences = 0;
+        JoinedChunk& result = m_joinedChunkBuffer[chunkIndex];
+        result.m_firstRecord = m_joinRecordBuffer.size() / RecordSize();
         sequenceDescriptions.clear();
 
         // Iterating thru all sequences and identifying whether they are valid among all deserializers.
         m_driver->GetSequencesForChunk(chunks[chunkIndex]->m_id, sequenceDescriptions);
-        std::set<size_t> invalid;
         for (size_t sequenceIndex = 0; sequenceIndex < sequenceDescriptions.size(); ++sequenceIndex)
         {
-            auto sequence = sequenceDescriptions[sequenceIndex];
             bool isValid = true;
-            size_t sequenceSamples = sequence.m_numberOfSamples;
-            for (size_t deserializerIndex = 1; deserializerIndex < m_deserializers.size(); ++deserializerIndex)
+            for (size_t deserializerIndex = 1; deserializerIndex < m_deserializers.size() && isValid; ++deserializerIndex)
+            {
+                isValid = m_deserializers[deserializerIndex]->GetSequenceDescription(sequenceDescriptions[sequenceIndex], joined[deserializerIndex - 1]);
+            }
+
+            if (isValid)
+            {
+                result.m_numberOfSamples += AddJoinRecord(sequenceIndex, sequenceDescriptions[sequenceIndex], joined);
+                result.m_numberOfSequences++;
+            }
+        }
+    }
+}
+
+// Merges the sequences of all deserializers by key. Returns false if the keys of a deserializer are not ascending.
+bool Bundler::TryMergeJoin(const ChunkDescriptions& chunks)
+{
+    m_joinedChunkBuffer.assign(chunks.size(), JoinedChunk());
+    m_joinRecordBuffer.clear();
+
+    std::vector<std::unique_ptr<SequenceCursor>> cursors;
+    for (size_t deserializerIndex = 1; deserializerIndex < m_deserializers.size(); ++deserializerIndex)
+        cursors.push_back(std::unique_ptr<SequenceCursor>(new SequenceCursor(m_deserializers[deserializerIndex])));
+
+    std::vector<SequenceDescription> sequenceDescriptions;
+    std::vector<SequenceDescription> joined(m_deserializers.size() - 1);
+    bool hasLast = false;
+    KeyType last;
+    for (ChunkIdType chunkIndex = 0; chunkIndex < chunks.size(); ++chunkIndex)
+    {
+        JoinedChunk& result = m_joinedChunkBuffer[chunkIndex];
+        result.m_firstRecord = m_joinRecordBuffer.size() / RecordSize();
+        sequenceDescriptions.clear();
+        m_driver->GetSequencesForChunk(chunks[chunkIndex]->m_id, sequenceDescriptions);
+        for (size_t sequenceIndex = 0; sequenceIndex < sequenceDescriptions.size(); ++sequenceIndex)
+        {
+            const auto& sequence = sequenceDescriptions[sequenceIndex];
+            if (hasLast && !KeyLess(last, sequence.m_key))
+            {
+                fprintf(stderr, "Bundler: WARNING: Sequences of the driving deserializer are not ordered by key, falling back to lookups.\n");
+                return false;
+            }
+            last = sequence.m_key;
+            hasLast = true;
+
+            bool isValid = true;
+            for (size_t i = 0; i < cursors.size() && isValid; ++i)
             {
-                isValid = m_deserializers[deserializerIndex]->GetSequenceDescription(sequenceDescriptions[sequenceIndex], s);
-                if (!isValid)
+                isValid = cursors[i]->Seek(sequence.m_key) && KeyEqual(cursors[i]->Current().m_key, sequence.m_key);
+                if (!cursors[i]->IsOrdered())
                 {
-                    invalid.insert(sequenceIndex);
-                    break;
+                    fprintf(stderr, "Bundler: WARNING: Sequences of deserializer %" PRIu64 " are not ordered by key, falling back to lookups.\n", i + 1);
+                    return false;
                 }
 
-                sequenceSamples = std::max<size_t>(sequenceSamples, s.m_numberOfSamples);
+                if (isValid)
+                    joined[i] = cursors[i]->Current();
             }
 
             if (isValid)
             {
-                numberOfSamples += sequenceSamples;
-                numberOfSequences++;
-
-                // Check whether the primary stream has the longest sequence.
-                // If yes, we can optimize exposed sequence descriptions in GetSequencesByChunk.
-                m_takePrimarySequenceLength = m_takePrimarySequenceLength && (sequenceSamples == sequence.m_numberOfSamples);
+                result.m_numberOfSamples += AddJoinRecord(sequenceIndex, sequence, joined);
+                result.m_numberOfSequences++;
             }
         }
+    }
+
+    return true;
+}
 
-        // Build a chunk for valid sequences.
-        if (numberOfSamples > 0)
+// FNV-1a hash over the chunk descriptions of all deserializers.
+uint64_t Bundler::ComputeFingerprint() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto combine = [&hash](uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i, value >>= 8)
+            hash = (hash ^ (value & 0xff)) * 1099511628211ULL;
+    };
+
+    for (const auto& d : m_deserializers)
+    {
+        auto chunks = d->GetChunkDescriptions();
+        combine(chunks.size());
+        for (const auto& c : chunks)
         {
-            auto cd = std::make_shared<BundlerChunkDescription>();
-            cd->m_numberOfSamples = numberOfSamples;
-            cd->m_numberOfSequences = numberOfSequences;
-            cd->m_id = (ChunkIdType) m_chunks.size();
-            cd->m_original = chunks[chunkIndex];
-            m_chunks.push_back(cd);
-            cd->m_invalid = std::move(invalid);
+            combine(c->m_id);
+            combine(c->m_numberOfSequences);
+            combine(c->m_numberOfSamples);
         }
     }
 
-    if (m_verbosity)
-        fprintf(stderr, "Bundler::CreateChunkDescriptions(): finished cleaning of %" PRIu64 " chunks\n", m_chunks.size());
+    return hash;
+}
+
+bool Bundler::TryLoadJoinIndex(const std::wstring& path, const JoinIndexHeader& key)
+{
+    if (!fexists(path))
+        return false;
+
+    std::unique_ptr<MemoryMappedFile> file(new MemoryMappedFile(path));
+    if (file->GetSize() < sizeof(JoinIndexHeader))
+        return false;
+
+    JoinIndexHeader header;
+    memcpy(&header, file->GetData(), sizeof(header));
+    if (memcmp(&header, &key, offsetof(JoinIndexHeader, m_numberOfRecords)) != 0)
+        return false;
+
+    size_t expectedSize = sizeof(JoinIndexHeader) + header.m_numberOfChunks * sizeof(JoinedChunk) + header.m_numberOfRecords * RecordSize() * sizeof(uint32_t);
+    if (file->GetSize() != expectedSize)
+        return false;
+
+    file->AdviseRandomAccess();
+    m_joinIndexFile = std::move(file);
+    m_joinedChunks = reinterpret_cast<const JoinedChunk*>(m_joinIndexFile->GetData() + sizeof(JoinIndexHeader));
+    m_joinRecords = reinterpret_cast<const uint32_t*>(m_joinedChunks + header.m_numberOfChunks);
+    return true;
+}
+
+void Bundler::WriteJoinIndex(const std::wstring& path, const JoinIndexHeader& key) const
+{
+    // Writing to a temporary file first, so that readers never see a partially written index.
+    std::wstring tmpFile = path + L".tmp";
+    FILE* f = _wfopen(tmpFile.c_str(), L"wb");
+    if (f == nullptr)
+        RuntimeError("Cannot create the join index file (%ls).", tmpFile.c_str());
+
+    bool written = fwrite(&key, sizeof(key), 1, f) == 1 &&
+                   fwrite(m_joinedChunkBuffer.data(), sizeof(JoinedChunk), m_joinedChunkBuffer.size(), f) == m_joinedChunkBuffer.size() &&
+                   fwrite(m_joinRecordBuffer.data(), sizeof(uint32_t), m_joinRecordBuffer.size(), f) == m_joinRecordBuffer.size();
+    written = (fclose(f) == 0) && written;
+    if (!written)
+    {
+        _wunlink(tmpFile.c_str());
+        RuntimeError("Cannot write the join index file (%ls).", tmpFile.c_str());
+    }
+
+    renameOrDie(tmpFile, path);
+    fprintf(stderr, "Bundler: Saved the join index '%ls'.\n", path.c_str());
 }
 
 // Gets chunk descriptions.
@@ -162,45 +455,24 @@ void Bundler::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDesc
     ChunkDescriptionPtr original = chunk->m_original;
     m_driver->GetSequencesForChunk(original->m_id, sequences);
 
-    std::vector<SequenceDescription> result;
-    if (m_takePrimarySequenceLength) // No need to consult other deserializers.
+    if (m_joinRecords == nullptr) // No cleansing, sequences are exposed as given by the driving deserializer.
     {
-        // Do cleansing.
-        result.reserve(sequences.size());
         for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
-        {
-            if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
-            {
-                continue;
-            }
-
-            result.push_back(sequences[sequenceIndex]);
-            result.back().m_id = sequenceIndex;
-        }
+            sequences[sequenceIndex].m_id = sequenceIndex;
+        return;
     }
-    else // need to get the max sequence length from other deserializers.
-         // TODO: This will change when the sequence length will be exposed per stream.
-    {
-        result.reserve(sequences.size());
-        SequenceDescription s;
-        for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
-        {
-            if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
-            {
-                continue;
-            }
 
-            auto sequence = sequences[sequenceIndex];
-            uint32_t sequenceSamples = sequence.m_numberOfSamples;
-            for (size_t deserializerIndex = 1; deserializerIndex < m_deserializers.size(); ++deserializerIndex)
-            {
-                m_deserializers[deserializerIndex]->GetSequenceDescription(sequence, s);
-                sequenceSamples = std::max(sequenceSamples, s.m_numberOfSamples);
-            }
-            sequence.m_numberOfSamples = sequenceSamples;
-            sequence.m_id = sequenceIndex;
-            result.push_back(sequence);
-        }
+    // Valid sequences with the lengths from the join index, the id of a sequence is its record inside the chunk.
+    const JoinedChunk& joined = m_joinedChunks[chunk->m_joinedChunk];
+    std::vector<SequenceDescription> result;
+    result.reserve(joined.m_numberOfSequences);
+    const size_t recordSize = RecordSize();
+    for (size_t i = 0; i < joined.m_numberOfSequences; ++i)
+    {
+        const uint32_t* record = m_joinRecords + (joined.m_firstRecord + i) * recordSize;
+        result.push_back(sequences[record[0]]);
+        result.back().m_numberOfSamples = record[1];
+        result.back().m_id = i;
     }
 
     std::swap(sequences, result);
@@ -223,6 +495,44 @@ class Bundler::BundlingChunk : public Chunk
 
     DISABLE_COPY_AND_MOVE(BundlingChunk);
 
+    // Gets the chunk of a deserializer, sharing it with the other bundling chunks that use it.
+    ChunkPtr RequireChunk(size_t deserializerIndex, ChunkIdType chunkId)
+    {
+        std::lock_guard<std::mutex> lock(m_parent->m_weakChunkTableMutex);
+        auto& chunkTable = m_parent->m_weakChunkTable[deserializerIndex];
+        ChunkPtr chunk = chunkTable[chunkId].lock();
+        if (!chunk)
+        {
+            chunk = m_parent->m_deserializers[deserializerIndex]->GetChunk(chunkId);
+            chunkTable[chunkId] = chunk;
+        }
+
+        return chunk;
+    }
+
+    // Creates the mapping from the join records of the chunk.
+    void MapJoinedSequences(const std::vector<SequenceDescription>& sequences, const ChunkPtr& drivingChunk)
+    {
+        const size_t numberOfDeserializers = m_parent->m_deserializers.size();
+        const JoinedChunk& joined = m_parent->m_joinedChunks[m_parent->m_chunks[m_chunkId]->m_joinedChunk];
+        const size_t recordSize = m_parent->RecordSize();
+        m_sequenceToSequence.resize(numberOfDeserializers * joined.m_numberOfSequences);
+        m_innerChunks.resize(numberOfDeserializers * joined.m_numberOfSequences);
+        for (size_t i = 0; i < joined.m_numberOfSequences; ++i)
+        {
+            const uint32_t* record = m_parent->m_joinRecords + (joined.m_firstRecord + i) * recordSize;
+            size_t currentIndex = i * numberOfDeserializers;
+            m_sequenceToSequence[currentIndex] = sequences[record[0]].m_id;
+            m_innerChunks[currentIndex] = drivingChunk;
+            for (size_t deserializerIndex = 1; deserializerIndex < numberOfDeserializers; ++deserializerIndex)
+            {
+                const uint32_t* location = record + 2 * deserializerIndex;
+                m_sequenceToSequence[currentIndex + deserializerIndex] = location[1];
+                m_innerChunks[currentIndex + deserializerIndex] = RequireChunk(deserializerIndex, location[0]);
+            }
+        }
+    }
+
 public:
     BundlingChunk(size_t numberOfInputs, Bundler* parent, ChunkIdType chunkId)
         : m_numberOfInputs(numberOfInputs), m_parent(parent), m_chunkId(chunkId)
@@ -237,15 +547,16 @@ public:
         // Creating chunk mapping.
         m_parent->m_driver->GetSequencesForChunk(original->m_id, sequences);
         ChunkPtr drivingChunk = m_parent->m_driver->GetChunk(original->m_id);
+        if (m_parent->m_joinRecords != nullptr)
+        {
+            MapJoinedSequences(sequences, drivingChunk);
+            return;
+        }
+
         m_sequenceToSequence.resize(deserializers.size() * sequences.size());
         m_innerChunks.resize(deserializers.size() * sequences.size());
         for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
         {
-            if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
-            {
-                continue;
-            }
-
             size_t currentIndex = sequenceIndex * deserializers.size();
             m_sequenceToSequence[currentIndex] = sequences[sequenceIndex].m_id;
             m_innerChunks[currentIndex] = drivingChunk;
@@ -255,26 +566,12 @@ public:
         SequenceDescription s;
         for (size_t deserializerIndex = 1; deserializerIndex < deserializers.size(); ++deserializerIndex)
         {
-            auto& chunkTable = m_parent->m_weakChunkTable[deserializerIndex];
             for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
             {
-                if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
-                {
-                    continue;
-                }
-
                 size_t currentIndex = sequenceIndex * deserializers.size() + deserializerIndex;
                 deserializers[deserializerIndex]->GetSequenceDescription(sequences[sequenceIndex], s);
                 m_sequenceToSequence[currentIndex] = s.m_id;
-
-                ChunkPtr secondaryChunk = chunkTable[s.m_chunkId].lock();
-                if (!secondaryChunk)
-                {
-                    secondaryChunk = deserializers[deserializerIndex]->GetChunk(s.m_chunkId);
-                    chunkTable[s.m_chunkId] = secondaryChunk;
-                }
-
-                m_innerChunks[currentIndex] = secondaryChunk;
+                m_innerChunks[currentIndex] = RequireChunk(deserializerIndex, s.m_chunkId);
             }
         }
     }
@@ -298,4 +595,28 @@ ChunkPtr Bundler::GetChunk(ChunkIdType chunkId)
     return std::make_shared<BundlingChunk>(m_streams.size(), this, chunkId);
 }
 
+bool Bundler::SupportsConcurrentChunkLoads() const
+{
+    return std::all_of(m_deserializers.begin(), m_deserializers.end(),
+        [](const IDataDeserializerPtr& d) { return d->SupportsConcurrentChunkLoads(); });
+}
+
+void Bundler::ReadAhead(const std::vector<ChunkIdType>& chunkIds)
+{
+    std::vector<ChunkIdType> originalIds;
+    originalIds.reserve(chunkIds.size());
+    for (auto chunkId : chunkIds)
+        originalIds.push_back(m_chunks[chunkId]->m_original->m_id);
+    m_driver->ReadAhead(originalIds);
+}
+
+void Bundler::FetchAhead(const std::vector<ChunkIdType>& chunkIds)
+{
+    std::vector<ChunkIdType> originalIds;
+    originalIds.reserve(chunkIds.size());
+    for (auto chunkId : chunkIds)
+        originalIds.push_back(m_chunks[chunkId]->m_original->m_id);
+    m_driver->FetchAhead(originalIds);
+}
+
 }}}
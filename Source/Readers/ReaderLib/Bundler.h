@@ -8,12 +8,26 @@
 #include "DataDeserializer.h"
 #include "DataDeserializerBase.h"
 #include "Config.h"
+#include "MemoryMappedFile.h"
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // Class represents an bundler of several deserializers.
 // In case when only a single deserializer is used, the bundler can be omitted and 
 // no performance penalty is paid.
+//
+// When data is checked, sequences of the driving deserializer are joined with the other deserializers
+// once, into a join index that holds, for every valid sequence, its length and its location in
+// every deserializer. The index replaces all later per sequence lookups. Options of the reader:
+//     joinMethod = "lookup"          # or "merge": a sorted key merge join that streams over the chunks of all
+//                                    # deserializers, with a single chunk of sequence descriptions per deserializer
+//                                    # in memory. Requires all deserializers to expose sequences in ascending key
+//                                    # order; the lookup is used if they do not.
+//     joinIndexFile = "train.join"   # optional, the index is memory mapped from this file and written to it if it
+//                                    # does not match the chunks of the deserializers. Deserializers that adapt their
+//                                    # sequences to the driving one in GetSequenceDescription (e.g. HTK expandToUtterance)
+//                                    # cannot use a persisted index.
 class Bundler : public DataDeserializerBase
 {
 public:
@@ -28,16 +42,53 @@ public:
     // Gets a chunk with data.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
 
+    // Chunks can be loaded in parallel only if all underlying deserializers support it.
+    virtual bool SupportsConcurrentChunkLoads() const override;
+
+    // Forwards the hint to the driving deserializer.
+    virtual void ReadAhead(const std::vector<ChunkIdType>& chunkIds) override;
+    virtual void FetchAhead(const std::vector<ChunkIdType>& chunkIds) override;
+
 private:
     DISABLE_COPY_AND_MOVE(Bundler);
 
     class BundlingChunk;
     struct BundlerChunkDescription;
     typedef std::shared_ptr<BundlerChunkDescription> BundlerChunkDescriptionPtr;
+    struct JoinIndexHeader;
+
+    // Valid sequences of a driving chunk, their records are [m_firstRecord, m_firstRecord + m_numberOfSequences).
+    struct JoinedChunk
+    {
+        uint64_t m_firstRecord;
+        uint64_t m_numberOfSamples;
+        uint64_t m_numberOfSequences;
+    };
+
+    class SequenceCursor;
 
     // Creates chunk descriptions based on chunks of underlying deserializers.
     void CreateChunkDescriptions();
 
+    // Joins the sequences of the driving chunks with the other deserializers into m_joinedChunks and m_joinRecords.
+    void LookupJoin(const ChunkDescriptions& chunks);
+    bool TryMergeJoin(const ChunkDescriptions& chunks);
+
+    // Appends the join record of a valid sequence, returns its number of samples.
+    size_t AddJoinRecord(size_t sequenceIndex, const SequenceDescription& sequence, const std::vector<SequenceDescription>& joined);
+
+    // Identifies the chunks of all deserializers a persisted index was built for.
+    uint64_t ComputeFingerprint() const;
+    bool TryLoadJoinIndex(const std::wstring& path, const JoinIndexHeader& key);
+    void WriteJoinIndex(const std::wstring& path, const JoinIndexHeader& key) const;
+
+    // Number of uint32 values per join record: index of the sequence in the driving chunk, number of samples,
+    // followed by the chunk id and the sequence id for every other deserializer.
+    size_t RecordSize() const
+    {
+        return 2 + 2 * (m_deserializers.size() - 1);
+    }
+
     // Underlying deserializers.
     std::vector<IDataDeserializerPtr> m_deserializers;
 
@@ -47,6 +98,17 @@ private:
     // Chunk descriptions.
     std::vector<BundlerChunkDescriptionPtr> m_chunks;
 
+    // Join index, built in memory or mapped from the index file: a JoinedChunk per driving chunk, and the join records.
+    std::vector<JoinedChunk> m_joinedChunkBuffer;
+    std::vector<uint32_t> m_joinRecordBuffer;
+    std::unique_ptr<MemoryMappedFile> m_joinIndexFile;
+    const JoinedChunk* m_joinedChunks;
+    const uint32_t* m_joinRecords;
+
+    // Join configuration, see above.
+    bool m_mergeJoin;
+    std::wstring m_joinIndexPath;
+
     // A flag that indicates whether there is a need to clean data between different deserializers.
     // It is possible that some sequence is valid in one deserializer but invalid in another. This sequences should be removed.
     // At the same time this introduces unnecessary overhead when the data is clean, because all chunks should be checked in advance to expose
@@ -54,15 +116,13 @@ private:
     // If this flag is set to false, no cleaning will be done, so additional overhead.
     bool m_cleanse;
 
-    // If flag is set to true the sequence length is counted by the primary deserializer only.
-    // Used for optimization when sequences between different deserializers are of the same length
-    // (i.e. often in speech)
-    bool m_takePrimarySequenceLength;
-
     // A table of loaded chunks to make sure we do not load same chunk twice.
     // Inner vector is the table of chunk id into weak pointer, the outer vector has an element per deserializer.
     std::vector<std::vector<std::weak_ptr<Chunk>>> m_weakChunkTable;
 
+    // Guards m_weakChunkTable when several bundling chunks are loaded in parallel.
+    std::mutex m_weakChunkTableMutex;
+
     // General configuration
     int m_verbosity;
 };
@@ -11,16 +11,43 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 ChunkPtr ChunkCache::GetChunk(ChunkIdType chunkId)
 {
-    auto it = m_chunkMap.find(chunkId);
-    if (it != m_chunkMap.end())
     {
-        return it->second;
+        std::lock_guard<std::mutex> lock(m_chunkMapMutex);
+        auto it = m_chunkMap.find(chunkId);
+        if (it != m_chunkMap.end())
+        {
+            return it->second;
+        }
     }
- 
+
+    // The randomizer never requests the same chunk twice concurrently,
+    // so the chunk can be loaded without holding the lock.
     ChunkPtr chunk = m_deserializer->GetChunk(chunkId);
+
+    std::lock_guard<std::mutex> lock(m_chunkMapMutex);
     m_chunkMap[chunkId] = chunk;
- 
     return chunk;
 }
 
+void ChunkCache::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_chunkMapMutex);
+        auto it = m_sequenceMap.find(chunkId);
+        if (it != m_sequenceMap.end())
+        {
+            descriptions.insert(descriptions.end(), it->second.begin(), it->second.end());
+            return;
+        }
+    }
+
+    // Some deserializers (i.e. the binary one) read the chunk to describe its sequences.
+    std::vector<SequenceDescription> sequences;
+    m_deserializer->GetSequencesForChunk(chunkId, sequences);
+    descriptions.insert(descriptions.end(), sequences.begin(), sequences.end());
+
+    std::lock_guard<std::mutex> lock(m_chunkMapMutex);
+    m_sequenceMap[chunkId] = std::move(sequences);
+}
+
 } } }
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <map>
+#include <mutex>
 #include "DataDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -15,7 +16,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // of the randomization and chunking parameters. The caching should only be enabled 
 // when the whole dataset fits in memory.
 // Implemented as a wrapping proxy around a deserializer that stores pointers to
-// all chunks it sees in an internal map.
+// all chunks it sees in an internal map, together with the descriptions of their sequences,
+// so that after the first sweep the randomizer only reshuffles and nothing is read or parsed again.
 class ChunkCache : public IDataDeserializer
 {
 public:
@@ -32,10 +34,7 @@ public:
         return m_deserializer->GetChunkDescriptions();
     }
 
-    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions) override
-    {
-        return m_deserializer->GetSequencesForChunk(chunkId, descriptions);
-    }
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions) override;
 
     virtual bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& description) override
     {
@@ -43,11 +42,30 @@ public:
     }
 
     // Gets chunk data given its id.
-    virtual ChunkPtr GetChunk(ChunkIdType chunkId);
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    virtual bool SupportsConcurrentChunkLoads() const override
+    {
+        return m_deserializer->SupportsConcurrentChunkLoads();
+    }
+
+    virtual void ReadAhead(const std::vector<ChunkIdType>& chunkIds) override
+    {
+        m_deserializer->ReadAhead(chunkIds);
+    }
+
+    virtual void FetchAhead(const std::vector<ChunkIdType>& chunkIds) override
+    {
+        m_deserializer->FetchAhead(chunkIds);
+    }
 
 private:
     // A map of currently loaded chunks
     std::map<size_t, ChunkPtr> m_chunkMap;
+    // Sequence descriptions of the chunks, by chunk id.
+    std::map<ChunkIdType, std::vector<SequenceDescription>> m_sequenceMap;
+    // Guards m_chunkMap and m_sequenceMap, chunks are loaded outside of the lock.
+    std::mutex m_chunkMapMutex;
     IDataDeserializerPtr m_deserializer;
 
     DISABLE_COPY_AND_MOVE(ChunkCache);
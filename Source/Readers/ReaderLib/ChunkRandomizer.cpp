@@ -24,37 +24,31 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     }
 
     // Randomizes chunks depending on the mode (legacy or not) and calculates randomization windows.
+    // The chunks are shuffled in place in the list of the previous sweep, so no additional memory is needed per sweep.
+    // Shuffling the chunks in their original order gives the same permutation as shuffling their indices.
+    // The permutation only depends on the seed (the sweep), so all workers derive the same one.
     void ChunkRandomizer::Randomize(unsigned int seed)
     {
-        std::vector<ChunkIdType> randomizedChunkIndices;
-        randomizedChunkIndices.reserve(m_originalChunks.size());
+        m_randomizedChunks.resize(m_originalChunks.size());
         for (ChunkIdType i = 0; i < m_originalChunks.size(); i++)
         {
-            randomizedChunkIndices.push_back(i);
+            m_randomizedChunks[i].m_original = m_originalChunks[i].get();
         }
 
         m_rng.seed(seed);
-        RandomShuffleMT(randomizedChunkIndices, m_rng);
+        RandomShuffleMT(m_randomizedChunks, m_rng);
 
         // Place randomized chunks on the timeline
-        m_randomizedChunks.clear();
-        m_randomizedChunks.reserve(m_originalChunks.size());
         size_t samplePosition = 0;
         size_t sequencePosition = 0;
-        for (ChunkIdType chunkIndex = 0; chunkIndex < m_originalChunks.size(); chunkIndex++)
+        for (ChunkIdType chunkIndex = 0; chunkIndex < m_randomizedChunks.size(); chunkIndex++)
         {
-            const size_t originalChunkIndex = randomizedChunkIndices[chunkIndex];
-            const size_t numberOfSamples = m_originalChunks[originalChunkIndex]->m_numberOfSamples;
-            const size_t numberOfSequences = m_originalChunks[originalChunkIndex]->m_numberOfSequences;
-
-            RandomizedChunk randomizedChunk;
+            auto& randomizedChunk = m_randomizedChunks[chunkIndex];
             randomizedChunk.m_chunkId = chunkIndex;
-            randomizedChunk.m_original = m_originalChunks[originalChunkIndex].get();
             randomizedChunk.m_samplePositionStart = samplePosition;
             randomizedChunk.m_sequencePositionStart = sequencePosition;
-            m_randomizedChunks.push_back(randomizedChunk);
-            samplePosition += numberOfSamples;
-            sequencePosition += numberOfSequences;
+            samplePosition += randomizedChunk.m_original->m_numberOfSamples;
+            sequencePosition += randomizedChunk.m_original->m_numberOfSequences;
         }
 
         // For each chunk, compute the randomization range (w.r.t. the randomized chunk sequence)
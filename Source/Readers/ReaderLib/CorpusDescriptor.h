@@ -8,7 +8,7 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
-#include "StringToIdMap.h"
+#include "KeyRegistry.h"
 #include <set>
 #include <functional>
 #include <sstream>
@@ -58,17 +58,13 @@ public:
                 // The function has to provide a size_t unique "hash" for the input key
                 // If we see the key for the first time, we add it to the registry.
                 // Otherwise we retrieve the hash value for the key from the registry.
-                size_t id;
-                if (m_keyToIdMap.TryGet(key, id))
-                    return id;
-                m_keyToIdMap.AddValue(key);
-                return m_keyToIdMap[key];
+                return m_keyToIdMap.AddValue(key);
             };
 
             IdToKey = [this](size_t id)
             {
                 // This will throw if the id is not present.
-                return m_keyToIdMap[id];
+                return std::string(m_keyToIdMap.GetKey(id), m_keyToIdMap.GetKeyLength(id));
             };
         }
     }
@@ -92,6 +88,56 @@ public:
         return m_sequenceIds.find(id) != m_sequenceIds.end();
     }
 
+    // Returns true if all sequences participate in the reading.
+    bool IncludesAllSequences() const
+    {
+        return m_includeAll;
+    }
+
+    // Maps the registry of the string sequence keys from a file saved by SaveKeyRegistry, so that
+    // the deserializers resolve their keys to the ids of the file without building the registry.
+    // Must be called before any key is registered. Returns false if the file does not exist or is invalid.
+    bool TryLoadKeyRegistry(const std::wstring& file)
+    {
+        return !m_numericSequenceKeys && m_keyToIdMap.TryLoad(file);
+    }
+
+    // Saves the registry of the string sequence keys, i.e. after all deserializers have been created.
+    void SaveKeyRegistry(const std::wstring& file) const
+    {
+        if (!m_numericSequenceKeys)
+            m_keyToIdMap.Save(file);
+    }
+
+    // Tells whether keys have been registered since the registry was loaded from a file, or at all.
+    bool IsKeyRegistryModified() const
+    {
+        return !m_numericSequenceKeys && !m_keyToIdMap.IsMapped() && m_keyToIdMap.Size() > 0;
+    }
+
+    // Reads the locality map of the chunks of the primary deserializer.
+    // Each line "<chunk id> <worker rank>" names the worker that holds the chunk on its local storage.
+    void LoadChunkLocality(const std::wstring& file)
+    {
+        for (msra::files::textreader r(file); r;)
+        {
+            auto line = r.getline();
+            size_t chunkId = 0, workerRank = 0;
+            if (sscanf_s(line.c_str(), "%" PRIu64 " %" PRIu64, &chunkId, &workerRank) != 2)
+                RuntimeError("Invalid line '%s' in the chunk locality map '%ls', expected '<chunk id> <worker rank>'.", line.c_str(), file.c_str());
+
+            if (chunkId >= m_chunkLocality.size())
+                m_chunkLocality.resize(chunkId + 1, SIZE_MAX);
+            m_chunkLocality[chunkId] = workerRank;
+        }
+    }
+
+    // Returns the worker that holds the chunk locally, or SIZE_MAX if the chunk is not in the locality map.
+    size_t GetChunkLocality(size_t chunkId) const
+    {
+        return chunkId < m_chunkLocality.size() ? m_chunkLocality[chunkId] : SIZE_MAX;
+    }
+
     std::function<size_t(const std::string&)> KeyToId;
     std::function<std::string(size_t)> IdToKey;
 
@@ -101,7 +147,11 @@ private:
     bool m_includeAll;
     std::set<size_t> m_sequenceIds;
 
-    StringToIdMap m_keyToIdMap;
+    // Worker rank per chunk id, SIZE_MAX for chunks without locality.
+    std::vector<size_t> m_chunkLocality;
+
+    // Registry of the string sequence keys, shared by all deserializers of the corpus.
+    KeyRegistry m_keyToIdMap;
 };
 
 typedef std::shared_ptr<CorpusDescriptor> CorpusDescriptorPtr;
@@ -6,6 +6,9 @@
 #pragma once
 
 #include <memory>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include <CUDAPageLockedMemAllocator.h>
 
 #include "MemoryProvider.h"
@@ -14,20 +17,75 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 /// TODO: Memory provider should reside on the matrix. It is responsibility of the network
 /// to decide what memory to use per stream. This class will be moved in the near future.
+//
+// Provides page-locked host memory that packers write minibatches into, so that the
+// transfer to the GPU is a single asynchronous copy per stream without a pageable bounce buffer.
+// Page-locked allocations are expensive (cudaHostAlloc/cudaFreeHost synchronize the device),
+// so freed buffers are kept in a bounded pool and reused:
+//  - new buffers get some headroom on top of the requested size, so that minibatches of
+//    slightly varying size (e.g. sequences) are served from the pool after warm-up;
+//  - at most m_maxCachedBuffers free buffers are kept; the smallest ones are released first.
 class CudaMemoryProvider : public MemoryProvider
 {
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
 
+    std::mutex m_mutex;
+    std::multimap<size_t, void*> m_freeBuffers;      // size in bytes -> buffer
+    std::unordered_map<void*, size_t> m_bufferSizes; // all buffers allocated by this provider
+    size_t m_maxCachedBuffers;
+    size_t m_numHits;
+    size_t m_numMisses;
+
+    // Headroom on top of the requested size, in 1/8ths.
+    static const size_t s_headroomEighths = 1;
+
+    // Keeps the largest free buffers; caller must hold m_mutex.
+    void TrimFreeBuffers()
+    {
+        while (m_freeBuffers.size() > m_maxCachedBuffers)
+        {
+            auto smallest = m_freeBuffers.begin();
+            m_bufferSizes.erase(smallest->second);
+            m_allocator->Free(reinterpret_cast<char*>(smallest->second));
+            m_freeBuffers.erase(smallest);
+        }
+    }
+
 public:
-    CudaMemoryProvider(int deviceId)
+    // maxCachedBuffers should cover all buffers that are simultaneously in flight for one device
+    // (packer buffers times streams), so that steady state does not allocate at all.
+    CudaMemoryProvider(int deviceId, size_t maxCachedBuffers = 8)
+        : m_maxCachedBuffers(maxCachedBuffers), m_numHits(0), m_numMisses(0)
     {
         m_allocator = std::make_unique<CUDAPageLockedMemAllocator>(deviceId);
     }
 
+    ~CudaMemoryProvider()
+    {
+        for (auto& buffer : m_freeBuffers)
+            m_allocator->Free(reinterpret_cast<char*>(buffer.second));
+    }
+
     virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
     {
         size_t totalSize = elementSize * numberOfElements;
-        return m_allocator->Malloc(totalSize);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // do not hand out buffers that are more than twice as large as the request
+        auto bestFit = m_freeBuffers.lower_bound(totalSize);
+        if (bestFit != m_freeBuffers.end() && bestFit->first <= 2 * totalSize)
+        {
+            void* p = bestFit->second;
+            m_freeBuffers.erase(bestFit);
+            m_numHits++;
+            return p;
+        }
+
+        size_t allocationSize = totalSize + totalSize * s_headroomEighths / 8;
+        void* p = m_allocator->Malloc(allocationSize);
+        m_bufferSizes[p] = allocationSize;
+        m_numMisses++;
+        return p;
     }
 
     virtual void Free(void* p) override
@@ -37,7 +95,27 @@ public:
             return;
         }
 
-        m_allocator->Free(reinterpret_cast<char*>(p));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto buffer = m_bufferSizes.find(p);
+        if (buffer == m_bufferSizes.end())
+        {
+            m_allocator->Free(reinterpret_cast<char*>(p));
+            return;
+        }
+
+        m_freeBuffers.insert(std::make_pair(buffer->second, p));
+        TrimFreeBuffers();
     }
+
+    void SetMaxCachedBuffers(size_t maxCachedBuffers)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_maxCachedBuffers = maxCachedBuffers;
+        TrimFreeBuffers();
+    }
+
+    // Number of allocations served from the pool and of actual page-locked allocations.
+    size_t GetNumHits() const { return m_numHits; }
+    size_t GetNumMisses() const { return m_numMisses; }
 };
 } } }
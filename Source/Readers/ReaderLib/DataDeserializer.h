@@ -81,6 +81,22 @@ typedef std::shared_ptr<SequenceDataBase> SequenceDataPtr;
 // All samples are stored in the 'data' member as a contiguous array.
 struct DenseSequenceData : SequenceDataBase
 {
+    // Copies samples [firstSample, firstSample + numberOfSamples) of sampleSize bytes each to the destination,
+    // destinationStride bytes apart. This is how packers read dense sequences, so sequences that generate their
+    // samples from chunk data (e.g. by stacking neighbor frames) can override it and write straight into
+    // the minibatch; GetDataBuffer() then only needs to materialize the samples for other consumers.
+    virtual void CopySamples(size_t firstSample, size_t numberOfSamples, size_t sampleSize, char* destination, size_t destinationStride)
+    {
+        const char* source = reinterpret_cast<const char*>(GetDataBuffer()) + firstSample * sampleSize;
+        if (destinationStride == sampleSize)
+        {
+            memcpy(destination, source, numberOfSamples * sampleSize);
+            return;
+        }
+
+        for (size_t i = 0; i < numberOfSamples; ++i)
+            memcpy(destination + i * destinationStride, source + i * sampleSize, sampleSize);
+    }
 };
 typedef std::shared_ptr<DenseSequenceData> DenseSequenceDataPtr;
 
@@ -172,6 +188,25 @@ public:
     // Gets chunk data given its id.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId) = 0;
 
+    // Returns true if GetChunk can be called concurrently for different chunks.
+    // Only then the randomizer loads several chunks in parallel.
+    virtual bool SupportsConcurrentChunkLoads() const
+    {
+        return false;
+    }
+
+    // Hints that sequences of the given (already loaded) chunks are about to be read, so that the deserializer
+    // can fetch their data ahead of time, i.e. in the order it is stored. Only a hint, ignored by default.
+    virtual void ReadAhead(const std::vector<ChunkIdType>&)
+    {
+    }
+
+    // Hints that the given chunks are going to be loaded after the current ones (i.e. they make up the next randomization window),
+    // so that the deserializer can start fetching their data from slow storage. Only a hint, ignored by default.
+    virtual void FetchAhead(const std::vector<ChunkIdType>&)
+    {
+    }
+
     virtual ~IDataDeserializer() {};
 };
 
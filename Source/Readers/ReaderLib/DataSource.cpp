@@ -0,0 +1,294 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "DataSource.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include "File.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static const std::string c_defaultFetchCommand = "curl --silent --show-error --fail --location --range %begin%-%end% \"%url%\"";
+static const std::string c_defaultSizeCommand = "curl --silent --show-error --fail --location --head \"%url%\"";
+
+// Number of times a failed range request is tried again.
+static const int c_fetchRetries = 3;
+
+bool IsRemoteDataPath(const std::wstring& path)
+{
+    for (const wchar_t* scheme : { L"http://", L"https://", L"s3://" })
+    {
+        if (path.compare(0, wcslen(scheme), scheme) == 0)
+            return true;
+    }
+    return false;
+}
+
+DataSourcePtr CreateDataSource(const std::wstring& path, const DataSourceOptions& options)
+{
+    if (IsRemoteDataPath(path))
+        return std::make_shared<RemoteDataSource>(path, options);
+    return std::make_shared<LocalDataSource>(path, options);
+}
+
+LocalDataSource::LocalDataSource(const std::wstring& filename, const DataSourceOptions& options)
+    : m_reader(filename, options.m_directIO, options.m_queueDepth)
+{
+}
+
+// Runs a command and returns what it writes to stdout.
+static std::string RunCommand(const std::string& command)
+{
+#ifdef _WIN32
+    FILE* pipe = _popen(command.c_str(), "rb");
+#else
+    FILE* pipe = popen(command.c_str(), "r");
+#endif
+    if (!pipe)
+        RuntimeError("RemoteDataSource: cannot run '%s': %s", command.c_str(), strerror(errno));
+
+    std::string output;
+    char buffer[64 * 1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+        output.append(buffer, n);
+
+#ifdef _WIN32
+    int rc = _pclose(pipe);
+#else
+    int rc = pclose(pipe);
+#endif
+    if (rc != 0)
+        RuntimeError("RemoteDataSource: '%s' failed with exit code %d.", command.c_str(), rc);
+    return output;
+}
+
+// Takes the size of the object from the output of the size command: the last Content-Length header
+// (redirects print several), or the output itself if it is a number.
+static uint64_t ParseObjectSize(const std::string& output, const std::string& url)
+{
+    std::string lower = output;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) { return (char)tolower(c); });
+    size_t pos = lower.rfind("content-length:");
+    const char* number = (pos == std::string::npos) ? output.c_str() : output.c_str() + pos + strlen("content-length:");
+    char* end;
+    unsigned long long size = strtoull(number, &end, 10);
+    if (end == number)
+        RuntimeError("RemoteDataSource: cannot determine the size of '%s'.", url.c_str());
+    return size;
+}
+
+RemoteDataSource::RemoteDataSource(const std::wstring& url, const DataSourceOptions& options)
+    : m_url(msra::strfun::utf8(url)), m_options(options), m_size(0), m_numOutstandingFetches(0)
+{
+    // s3://bucket/key is read through the virtual-hosted endpoint of the bucket.
+    if (m_url.compare(0, 5, "s3://") == 0)
+    {
+        size_t slash = m_url.find('/', 5);
+        if (slash == std::string::npos)
+            InvalidArgument("RemoteDataSource: '%s' does not name an object in a bucket.", m_url.c_str());
+        m_url = "https://" + m_url.substr(5, slash - 5) + ".s3.amazonaws.com" + m_url.substr(slash);
+    }
+
+    if (m_options.m_fetchCommand.empty())
+        m_options.m_fetchCommand = c_defaultFetchCommand;
+    if (m_options.m_sizeCommand.empty())
+        m_options.m_sizeCommand = c_defaultSizeCommand;
+    if (!m_options.m_cacheDirectory.empty())
+        msra::files::make_intermediate_dirs(m_options.m_cacheDirectory + L"/x");
+
+    attempt(c_fetchRetries, [this]()
+    {
+        m_size = ParseObjectSize(RunCommand(ExpandCommand(m_options.m_sizeCommand, 0, 0)), m_url);
+    });
+
+    AsyncIOService::Instance().EnsureQueueDepth(m_options.m_queueDepth > 0 ? m_options.m_queueDepth : (size_t)AsyncFileReader::s_defaultQueueDepth);
+}
+
+RemoteDataSource::~RemoteDataSource()
+{
+    // The fetches refer to this source.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_fetchesDone.wait(lock, [this]() { return m_numOutstandingFetches == 0; });
+}
+
+std::string RemoteDataSource::ExpandCommand(const std::string& command, uint64_t begin, uint64_t end) const
+{
+    std::string result = msra::strfun::ReplaceAll<std::string>(command, "%url%", m_url);
+    result = msra::strfun::ReplaceAll<std::string>(result, "%begin%", std::to_string(begin));
+    return msra::strfun::ReplaceAll<std::string>(result, "%end%", std::to_string(end));
+}
+
+// Blocks are cached under a name made of the URL, the size of the object and the block index,
+// so that a replaced object does not pick up blocks of the previous one.
+std::wstring RemoteDataSource::GetCachePath(size_t index) const
+{
+    char name[100];
+    sprintf(name, "%016llx_%llu_%llu.block", (unsigned long long)std::hash<std::string>()(m_url), (unsigned long long)m_size, (unsigned long long)index);
+    return m_options.m_cacheDirectory + L"/" + msra::strfun::utf16(name);
+}
+
+bool RemoteDataSource::TryReadCachedBlock(size_t index, std::vector<char>& data)
+{
+    if (m_options.m_cacheDirectory.empty())
+        return false;
+
+    FILE* f = _wfopen(GetCachePath(index).c_str(), L"rb");
+    if (!f)
+        return false;
+    size_t n = fread(data.data(), 1, data.size(), f);
+    bool complete = n == data.size() && fgetc(f) == EOF;
+    fclose(f);
+    return complete;
+}
+
+// The block is written under a temporary name first, so that other jobs sharing the cache never see a partial block.
+void RemoteDataSource::WriteCachedBlock(size_t index, const std::vector<char>& data)
+{
+    if (m_options.m_cacheDirectory.empty())
+        return;
+
+    std::wstring path = GetCachePath(index);
+    std::wstring temporaryPath = path + L"." + std::to_wstring(std::hash<std::thread::id>()(std::this_thread::get_id())) + L".tmp";
+    FILE* f = _wfopen(temporaryPath.c_str(), L"wb");
+    if (!f)
+    {
+        fprintf(stderr, "WARNING: RemoteDataSource: cannot write to the cache directory %ls.\n", m_options.m_cacheDirectory.c_str());
+        return;
+    }
+    bool written = fwrite(data.data(), 1, data.size(), f) == data.size();
+    written = (fclose(f) == 0) && written;
+    try
+    {
+        if (written)
+            renameOrDie(temporaryPath, path);
+    }
+    catch (const std::exception&)
+    {
+        written = false;
+    }
+    if (!written)
+        _wunlink(temporaryPath.c_str());
+}
+
+RemoteDataSource::BlockPtr RemoteDataSource::FetchBlock(size_t index)
+{
+    uint64_t begin = (uint64_t)index * s_blockSize;
+    size_t size = (size_t)std::min<uint64_t>((uint64_t)s_blockSize, m_size - begin);
+    auto block = std::make_shared<std::vector<char>>(size);
+    if (TryReadCachedBlock(index, *block))
+        return block;
+
+    attempt(c_fetchRetries, [&]()
+    {
+        std::string data = RunCommand(ExpandCommand(m_options.m_fetchCommand, begin, begin + size - 1));
+        if (data.size() != size)
+            RuntimeError("RemoteDataSource: got %d bytes instead of %d for the block at %llu of '%s'.", (int)data.size(), (int)size, (unsigned long long)begin, m_url.c_str());
+        memcpy(block->data(), data.data(), size);
+    });
+    WriteCachedBlock(index, *block);
+    return block;
+}
+
+std::shared_future<RemoteDataSource::BlockPtr> RemoteDataSource::GetBlock(size_t index)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto found = m_blocks.find(index);
+    if (found != m_blocks.end())
+        return found->second;
+
+    // Without a cache, make room by dropping fetched blocks; those who read them hold on to their futures.
+    for (auto iter = m_blocks.begin(); iter != m_blocks.end() && m_blocks.size() >= s_maxBlocksInMemory;)
+    {
+        if (iter->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            iter = m_blocks.erase(iter);
+        else
+            ++iter;
+    }
+
+    auto promise = std::make_shared<std::promise<BlockPtr>>();
+    std::shared_future<BlockPtr> block = promise->get_future().share();
+    m_blocks[index] = block;
+    m_numOutstandingFetches++;
+    AsyncIOService::Instance().Submit([this, promise, index]()
+    {
+        try
+        {
+            promise->set_value(FetchBlock(index));
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // With a cache the block is read from there from now on.
+        if (!m_options.m_cacheDirectory.empty())
+            m_blocks.erase(index);
+        if (--m_numOutstandingFetches == 0)
+            m_fetchesDone.notify_all();
+    });
+    return block;
+}
+
+std::future<std::shared_ptr<char>> RemoteDataSource::ReadAsync(uint64_t offset, size_t size)
+{
+    if (offset + size > m_size)
+        RuntimeError("RemoteDataSource: attempted to read %d bytes at position %llu, past the end of '%s'.", (int)size, (unsigned long long)offset, m_url.c_str());
+
+    // Requests for all blocks of the range go out at once.
+    std::vector<std::shared_future<BlockPtr>> blocks;
+    size_t firstBlock = (size_t)(offset / s_blockSize);
+    size_t endBlock = size == 0 ? firstBlock : (size_t)((offset + size - 1) / s_blockSize + 1);
+    for (size_t index = firstBlock; index < endBlock; index++)
+        blocks.push_back(GetBlock(index));
+
+    // Blocks fetched ahead are not kept once read, except for those at the ends of the range, which neighboring ranges share.
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (size_t index = firstBlock + 1; index + 1 < endBlock; index++)
+            m_blocks.erase(index);
+    }
+
+    // Assembled by whoever waits for the result, as the I/O threads may still have the blocks queued.
+    return std::async(std::launch::deferred, [blocks, offset, size, firstBlock]()
+    {
+        std::shared_ptr<char> result(new char[std::max<size_t>(size, 1)], std::default_delete<char[]>());
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            const auto& block = *blocks[i].get();
+            uint64_t blockBegin = (uint64_t)(firstBlock + i) * s_blockSize;
+            uint64_t begin = std::max(offset, blockBegin);
+            uint64_t end = std::min<uint64_t>(offset + size, blockBegin + block.size());
+            memcpy(result.get() + (begin - offset), block.data() + (begin - blockBegin), (size_t)(end - begin));
+        }
+        return result;
+    });
+}
+
+void RemoteDataSource::FetchAhead(const std::vector<std::pair<uint64_t, size_t>>& ranges)
+{
+    for (const auto& range : ranges)
+    {
+        if (range.second == 0 || range.first + range.second > m_size)
+            continue;
+
+        for (size_t index = (size_t)(range.first / s_blockSize); index <= (size_t)((range.first + range.second - 1) / s_blockSize); index++)
+        {
+            if (m_options.m_cacheDirectory.empty())
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_blocks.size() >= s_maxBlocksInMemory)
+                    return;
+            }
+            GetBlock(index);
+        }
+    }
+}
+
+}}}
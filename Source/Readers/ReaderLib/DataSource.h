@@ -0,0 +1,152 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "AsyncFileReader.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct DataSourceOptions
+{
+    // Local files: read bypassing the OS page cache.
+    bool m_directIO = false;
+
+    // Reads outstanding at once, for remote sources the number of parallel range requests; 0 for the default.
+    size_t m_queueDepth = 0;
+
+    // Remote sources: directory (i.e. on a local SSD) that keeps the fetched blocks, shared by all jobs using it.
+    // Empty for none, then blocks fetched ahead are kept in memory until read.
+    std::wstring m_cacheDirectory;
+
+    // Remote sources: commands run by the shell, with %url%, %begin% and %end% (inclusive) replaced.
+    // The fetch command writes the bytes of the range to stdout; the size command writes the HTTP headers
+    // of the object (the size is taken from Content-Length) or just its size.
+    // By default curl is used, which covers HTTP(S) URLs including pre-signed S3 URLs and Azure Blob SAS URLs.
+    std::string m_fetchCommand;
+    std::string m_sizeCommand;
+};
+
+// The bytes of an input file, read by ranges: a local file, or an object in remote storage
+// ("http://", "https://", or "s3://bucket/key", which is read through the public endpoint of the bucket).
+// Thread-safe.
+class DataSource
+{
+public:
+    virtual ~DataSource() = default;
+
+    virtual uint64_t GetSize() = 0;
+
+    // Remote sources are read in blocks through range requests, and cached.
+    virtual bool IsRemote() const = 0;
+
+    // Starts reading 'size' bytes at 'offset'.
+    virtual std::future<std::shared_ptr<char>> ReadAsync(uint64_t offset, size_t size) = 0;
+
+    std::shared_ptr<char> Read(uint64_t offset, size_t size)
+    {
+        return ReadAsync(offset, size).get();
+    }
+
+    // Hints that the given ranges (offset, size) are going to be read, i.e. the chunks of the next randomization window,
+    // so that a remote source starts fetching them. Only a hint, ignored by local sources.
+    virtual void FetchAhead(const std::vector<std::pair<uint64_t, size_t>>&)
+    {
+    }
+};
+
+typedef std::shared_ptr<DataSource> DataSourcePtr;
+
+bool IsRemoteDataPath(const std::wstring& path);
+
+DataSourcePtr CreateDataSource(const std::wstring& path, const DataSourceOptions& options);
+
+// A local file, read through the AsyncIOService.
+class LocalDataSource : public DataSource
+{
+public:
+    LocalDataSource(const std::wstring& filename, const DataSourceOptions& options);
+
+    uint64_t GetSize() override
+    {
+        return m_reader.GetFileSize();
+    }
+
+    bool IsRemote() const override
+    {
+        return false;
+    }
+
+    std::future<std::shared_ptr<char>> ReadAsync(uint64_t offset, size_t size) override
+    {
+        return m_reader.ReadAsync(offset, size);
+    }
+
+private:
+    AsyncFileReader m_reader;
+};
+
+// An object in remote storage, read in blocks of s_blockSize bytes, each block with a range request of its own,
+// which run in parallel on the threads of the AsyncIOService. Fetched blocks go to the cache directory if any.
+class RemoteDataSource : public DataSource
+{
+public:
+    RemoteDataSource(const std::wstring& url, const DataSourceOptions& options);
+    ~RemoteDataSource();
+
+    uint64_t GetSize() override
+    {
+        return m_size;
+    }
+
+    bool IsRemote() const override
+    {
+        return true;
+    }
+
+    std::future<std::shared_ptr<char>> ReadAsync(uint64_t offset, size_t size) override;
+
+    void FetchAhead(const std::vector<std::pair<uint64_t, size_t>>& ranges) override;
+
+    static const size_t s_blockSize = 8 * 1024 * 1024;
+
+    // Without a cache directory, blocks fetched ahead stay in memory until read, at most this many.
+    static const size_t s_maxBlocksInMemory = 64;
+
+private:
+    typedef std::shared_ptr<std::vector<char>> BlockPtr;
+
+    // Gets the future of a block, starting to fetch it if needed.
+    std::shared_future<BlockPtr> GetBlock(size_t index);
+
+    BlockPtr FetchBlock(size_t index);
+    bool TryReadCachedBlock(size_t index, std::vector<char>& data);
+    void WriteCachedBlock(size_t index, const std::vector<char>& data);
+    std::wstring GetCachePath(size_t index) const;
+
+    std::string ExpandCommand(const std::string& command, uint64_t begin, uint64_t end) const;
+
+    std::string m_url;
+    DataSourceOptions m_options;
+    uint64_t m_size;
+
+    // Blocks being fetched, and blocks fetched ahead that were not read yet.
+    std::mutex m_mutex;
+    std::map<size_t, std::shared_future<BlockPtr>> m_blocks;
+    size_t m_numOutstandingFetches;
+    std::condition_variable m_fetchesDone;
+
+    DISABLE_COPY_AND_MOVE(RemoteDataSource);
+};
+
+}}}
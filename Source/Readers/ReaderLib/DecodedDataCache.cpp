@@ -0,0 +1,205 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "DecodedDataCache.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+DecodedDataCache::DecodedDataCache(size_t capacityInBytes, const std::wstring& fileName, size_t blockSize)
+    : m_blockSize(blockSize),
+      m_numBlocks(0),
+      m_storage(nullptr),
+#ifdef _WIN32
+      m_fileHandle(INVALID_HANDLE_VALUE),
+      m_mappingHandle(NULL),
+#endif
+      m_mappedSize(0),
+      m_numHits(0),
+      m_numMisses(0),
+      m_sizeInBytes(0)
+{
+    if (blockSize == 0)
+        InvalidArgument("DecodedDataCache: block size must be positive.");
+
+    m_numBlocks = capacityInBytes / blockSize;
+    if (m_numBlocks > std::numeric_limits<uint32_t>::max())
+        InvalidArgument("DecodedDataCache: too many blocks, the block size %zu is too small for the capacity of %zu bytes.", blockSize, capacityInBytes);
+    if (m_numBlocks == 0)
+        return;
+
+    size_t storageSize = m_numBlocks * blockSize;
+    if (fileName.empty())
+    {
+        // Not initialized, so pages are only committed when the cache actually fills up.
+        m_memory.reset(new char[storageSize]);
+        m_storage = m_memory.get();
+    }
+    else
+        MapFile(fileName, storageSize);
+
+    // Blocks are handed out from the back, lowest indices first.
+    m_freeBlocks.resize(m_numBlocks);
+    for (size_t i = 0; i < m_numBlocks; ++i)
+        m_freeBlocks[i] = (uint32_t)(m_numBlocks - 1 - i);
+}
+
+DecodedDataCache::~DecodedDataCache()
+{
+    UnmapFile();
+}
+
+#ifdef _WIN32
+
+void DecodedDataCache::MapFile(const std::wstring& fileName, size_t size)
+{
+    // The file is only scratch space, it is deleted on close and kept in the file cache if possible.
+    m_fileHandle = CreateFileW(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+        RuntimeError("Cannot create the cache file (%ls), error %x.", fileName.c_str(), GetLastError());
+
+    LARGE_INTEGER mappingSize;
+    mappingSize.QuadPart = (LONGLONG)size;
+    m_mappingHandle = CreateFileMappingW(m_fileHandle, NULL, PAGE_READWRITE, mappingSize.HighPart, mappingSize.LowPart, NULL);
+    if (m_mappingHandle != NULL)
+        m_storage = (char*)MapViewOfFile(m_mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+
+    if (m_storage == nullptr)
+    {
+        DWORD error = GetLastError();
+        UnmapFile();
+        RuntimeError("Cannot memory map the cache file (%ls), error %x.", fileName.c_str(), error);
+    }
+
+    m_mappedSize = size;
+}
+
+void DecodedDataCache::UnmapFile()
+{
+    if (m_storage != nullptr && m_mappedSize != 0)
+        UnmapViewOfFile(m_storage);
+    if (m_mappingHandle != NULL)
+        CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+
+    m_mappingHandle = NULL;
+    m_fileHandle = INVALID_HANDLE_VALUE;
+    m_mappedSize = 0;
+}
+
+#else
+
+void DecodedDataCache::MapFile(const std::wstring& fileName, size_t size)
+{
+    int fileDescriptor = open(msra::strfun::utf8(fileName).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fileDescriptor == -1)
+        RuntimeError("Cannot create the cache file (%ls).", fileName.c_str());
+
+    // The file is only scratch space: it is unlinked right away, the mapping keeps it alive.
+    unlink(msra::strfun::utf8(fileName).c_str());
+
+    if (ftruncate(fileDescriptor, (off_t)size) == -1)
+    {
+        close(fileDescriptor);
+        RuntimeError("Cannot resize the cache file (%ls) to %zu bytes.", fileName.c_str(), size);
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (data == MAP_FAILED)
+        RuntimeError("Cannot memory map the cache file (%ls).", fileName.c_str());
+
+    m_storage = (char*)data;
+    m_mappedSize = size;
+}
+
+void DecodedDataCache::UnmapFile()
+{
+    if (m_storage != nullptr && m_mappedSize != 0)
+        munmap(m_storage, m_mappedSize);
+    m_mappedSize = 0;
+}
+
+#endif
+
+void DecodedDataCache::Remove(std::unordered_map<size_t, Entry>::iterator entry)
+{
+    m_freeBlocks.insert(m_freeBlocks.end(), entry->second.m_blocks.begin(), entry->second.m_blocks.end());
+    m_sizeInBytes -= entry->second.m_size;
+    m_lru.erase(entry->second.m_lruPosition);
+    m_entries.erase(entry);
+}
+
+void DecodedDataCache::Put(size_t key, const std::string& header, const char* data, size_t size)
+{
+    size_t numBlocks = (size + m_blockSize - 1) / m_blockSize;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto existing = m_entries.find(key);
+    if (existing != m_entries.end())
+        Remove(existing);
+
+    if (numBlocks > m_numBlocks)
+        return;
+
+    while (m_freeBlocks.size() < numBlocks)
+        Remove(m_entries.find(m_lru.back()));
+
+    Entry entry;
+    entry.m_header = header;
+    entry.m_size = size;
+    entry.m_blocks.assign(m_freeBlocks.end() - numBlocks, m_freeBlocks.end());
+    m_freeBlocks.resize(m_freeBlocks.size() - numBlocks);
+
+    for (size_t i = 0; i < numBlocks; ++i)
+    {
+        size_t offset = i * m_blockSize;
+        memcpy(GetBlock(entry.m_blocks[i]), data + offset, std::min(m_blockSize, size - offset));
+    }
+
+    m_lru.push_front(key);
+    entry.m_lruPosition = m_lru.begin();
+    m_entries[key] = std::move(entry);
+    m_sizeInBytes += size;
+}
+
+bool DecodedDataCache::TryGet(size_t key, const std::function<char*(const std::string& header, size_t size)>& allocate)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto entry = m_entries.find(key);
+    if (entry == m_entries.end())
+    {
+        m_numMisses++;
+        return false;
+    }
+
+    m_numHits++;
+    m_lru.splice(m_lru.begin(), m_lru, entry->second.m_lruPosition);
+
+    const Entry& found = entry->second;
+    char* buffer = allocate(found.m_header, found.m_size);
+    for (size_t i = 0; i < found.m_blocks.size(); ++i)
+    {
+        size_t offset = i * m_blockSize;
+        memcpy(buffer + offset, GetBlock(found.m_blocks[i]), std::min(m_blockSize, found.m_size - offset));
+    }
+    return true;
+}
+
+}}}
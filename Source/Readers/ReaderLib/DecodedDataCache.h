@@ -0,0 +1,110 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A bounded cache of decoded sequence data keyed by sequence id, so that expensive decoding
+// (i.e. of images) is only done once and not in every epoch.
+// The data is kept in a fixed-size storage that is either allocated in memory or memory-mapped
+// from a scratch file (i.e. on a local SSD, the file is deleted when the cache is destroyed).
+// The storage is divided into blocks of equal size, an entry occupies as many (not necessarily
+// adjacent) blocks as needed, and the least recently used entries are evicted when space runs out.
+// Each entry also has a small header (i.e. the shape of the data) that is kept in memory.
+// Thread-safe.
+class DecodedDataCache
+{
+public:
+    // The capacity is rounded down to whole blocks. An empty file name keeps the storage in memory.
+    DecodedDataCache(size_t capacityInBytes, const std::wstring& fileName = std::wstring(), size_t blockSize = 64 * 1024);
+    ~DecodedDataCache();
+
+    // Stores a copy of the data under the key, replacing an existing entry.
+    // Data that does not fit into the whole cache is not stored.
+    void Put(size_t key, const std::string& header, const char* data, size_t size);
+
+    // Copies the data stored under the key into the buffer returned by allocate(header, size).
+    // Returns false if there is no data for the key.
+    bool TryGet(size_t key, const std::function<char*(const std::string& header, size_t size)>& allocate);
+
+    // Returns true if there is data for the key, without touching the LRU order.
+    bool Contains(size_t key)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.find(key) != m_entries.end();
+    }
+
+    size_t GetNumHits() const
+    {
+        return m_numHits;
+    }
+
+    size_t GetNumMisses() const
+    {
+        return m_numMisses;
+    }
+
+    // Bytes of data currently stored (excluding headers and unused space of the last block of each entry).
+    size_t GetSizeInBytes() const
+    {
+        return m_sizeInBytes;
+    }
+
+private:
+    struct Entry
+    {
+        std::string m_header;
+        size_t m_size;
+        std::vector<uint32_t> m_blocks;
+        std::list<size_t>::iterator m_lruPosition;
+    };
+
+    // Removes the entry and returns its blocks to the free list; caller must hold m_mutex.
+    void Remove(std::unordered_map<size_t, Entry>::iterator entry);
+
+    char* GetBlock(uint32_t index) const
+    {
+        return m_storage + (size_t)index * m_blockSize;
+    }
+
+    void MapFile(const std::wstring& fileName, size_t size);
+    void UnmapFile();
+
+    size_t m_blockSize;
+    size_t m_numBlocks;
+
+    // Storage of all blocks, either m_memory or a mapped view of the scratch file.
+    char* m_storage;
+    std::unique_ptr<char[]> m_memory;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#endif
+    size_t m_mappedSize;
+
+    std::mutex m_mutex;
+    std::unordered_map<size_t, Entry> m_entries;
+    // Keys of all entries, most recently used first.
+    std::list<size_t> m_lru;
+    std::vector<uint32_t> m_freeBlocks;
+
+    size_t m_numHits;
+    size_t m_numMisses;
+    size_t m_sizeInBytes;
+
+    DISABLE_COPY_AND_MOVE(DecodedDataCache);
+};
+
+}}}
@@ -18,6 +18,10 @@ inline size_t GetSizeByType(ElementType type)
         return sizeof(float);
     case ElementType::tdouble:
         return sizeof(double);
+    case ElementType::tuchar:
+        return sizeof(unsigned char);
+    case ElementType::tfloat16:
+        return sizeof(float16);
     default:
         RuntimeError("Unsupported type '%d'", static_cast<int>(type));
     }
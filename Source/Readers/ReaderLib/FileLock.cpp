@@ -0,0 +1,190 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#endif
+#include "FileLock.h"
+#include <chrono>
+#include <exception>
+#include <thread>
+#ifndef _WIN32
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+FileLock::FileLock(const wstring& path) : m_path(path), m_locked(false), m_available(true)
+{
+#ifdef _WIN32
+    m_handle = INVALID_HANDLE_VALUE;
+#else
+    m_fileDescriptor = -1;
+#endif
+}
+
+FileLock::~FileLock()
+{
+    Unlock();
+}
+
+// The previous holder removes the lock file while it holds the lock, so a lock taken on a file that has been
+// removed meanwhile is not exclusive (a new lock file may have been created and locked by another process):
+// the lock is only taken if the path still refers to the locked file.
+bool FileLock::TryLock()
+{
+    if (m_locked)
+        return true;
+
+    for (;;)
+    {
+#ifdef _WIN32
+        HANDLE handle = CreateFileW(m_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            // A lock file that is being removed cannot be opened until its last handle is closed.
+            m_available = GetLastError() == ERROR_ACCESS_DENIED && GetFileAttributesW(m_path.c_str()) != INVALID_FILE_ATTRIBUTES;
+            return false;
+        }
+        m_available = true;
+
+        OVERLAPPED overlapped = {};
+        if (!LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped))
+        {
+            CloseHandle(handle);
+            return false;
+        }
+
+        bool isCurrent = false;
+        HANDLE current = CreateFileW(m_path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                     NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (current != INVALID_HANDLE_VALUE)
+        {
+            BY_HANDLE_FILE_INFORMATION locked, found;
+            isCurrent = GetFileInformationByHandle(handle, &locked) && GetFileInformationByHandle(current, &found) &&
+                        locked.dwVolumeSerialNumber == found.dwVolumeSerialNumber &&
+                        locked.nFileIndexHigh == found.nFileIndexHigh && locked.nFileIndexLow == found.nFileIndexLow;
+            CloseHandle(current);
+        }
+        if (isCurrent)
+        {
+            m_handle = handle;
+            m_locked = true;
+            return true;
+        }
+        UnlockFileEx(handle, 0, 1, 0, &overlapped);
+        CloseHandle(handle);
+#else
+        string path = msra::strfun::utf8(m_path);
+        int fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (fileDescriptor == -1)
+        {
+            m_available = false;
+            return false;
+        }
+        m_available = true;
+
+        if (flock(fileDescriptor, LOCK_EX | LOCK_NB) != 0)
+        {
+            close(fileDescriptor);
+            return false;
+        }
+
+        struct stat locked, found;
+        if (fstat(fileDescriptor, &locked) == 0 && stat(path.c_str(), &found) == 0 &&
+            locked.st_dev == found.st_dev && locked.st_ino == found.st_ino)
+        {
+            m_fileDescriptor = fileDescriptor;
+            m_locked = true;
+            return true;
+        }
+        close(fileDescriptor);
+#endif
+    }
+}
+
+bool FileLock::Lock(double timeoutSeconds)
+{
+    auto start = chrono::steady_clock::now();
+    while (!TryLock())
+    {
+        if (chrono::duration<double>(chrono::steady_clock::now() - start).count() >= timeoutSeconds)
+            return false;
+        this_thread::sleep_for(chrono::milliseconds(500));
+    }
+    return true;
+}
+
+void FileLock::Unlock()
+{
+    if (!m_locked)
+        return;
+
+    // Removed before the lock is released, see TryLock().
+#ifdef _WIN32
+    DeleteFileW(m_path.c_str());
+    OVERLAPPED overlapped = {};
+    UnlockFileEx(m_handle, 0, 1, 0, &overlapped);
+    CloseHandle(m_handle);
+    m_handle = INVALID_HANDLE_VALUE;
+#else
+    unlink(msra::strfun::utf8(m_path).c_str());
+    close(m_fileDescriptor);
+    m_fileDescriptor = -1;
+#endif
+    m_locked = false;
+}
+
+bool BuildOrWaitForCache(const wstring& cacheFile, double waitSeconds, bool verbose,
+                         const function<bool()>& tryLoad,
+                         const function<void()>& build,
+                         const function<void()>& save)
+{
+    FileLock lock(cacheFile + L".lock");
+    if (!lock.TryLock())
+    {
+        // Without a lock file the cache cannot be written either.
+        if (!lock.IsAvailable())
+        {
+            build();
+            return false;
+        }
+
+        if (verbose)
+            fprintf(stderr, "INFO: Waiting for the cache (%ls) to be built by another process.\n", cacheFile.c_str());
+
+        // The lock is released when the other process is done, or dies.
+        lock.Lock(waitSeconds);
+        lock.Unlock();
+        if (tryLoad())
+            return true;
+
+        // The other process failed or is stuck.
+        build();
+        return false;
+    }
+
+    build();
+    try
+    {
+        save();
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "WARNING: Could not save the cache (%ls): %s\n", cacheFile.c_str(), e.what());
+    }
+    return false;
+}
+
+}}}
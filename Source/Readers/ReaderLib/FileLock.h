@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// An exclusive lock between processes, held through an advisory lock of the operating system on a lock file
+// (flock on Linux, LockFileEx on Windows). The operating system releases the lock when its holder dies,
+// so that a crashed holder never leaves a stale lock behind, unlike a lock file that is only created and removed.
+// The lock file is removed when the lock is released.
+class FileLock
+{
+public:
+    explicit FileLock(const std::wstring& path);
+    ~FileLock();
+
+    // Takes the lock without waiting, returns false if another holder has it,
+    // or if the lock file cannot be created (then IsAvailable() returns false).
+    bool TryLock();
+
+    // Waits up to timeoutSeconds for the lock, returns false on timeout.
+    bool Lock(double timeoutSeconds);
+
+    void Unlock();
+
+    bool IsLocked() const { return m_locked; }
+
+    // False if the last attempt to take the lock failed to create the lock file (e.g. in a read-only location).
+    bool IsAvailable() const { return m_available; }
+
+private:
+    std::wstring m_path;
+    bool m_locked;
+    bool m_available;
+#ifdef _WIN32
+    void* m_handle;
+#else
+    int m_fileDescriptor;
+#endif
+
+    DISABLE_COPY_AND_MOVE(FileLock);
+};
+
+// Shares a cache file among the processes of a distributed job, which are likely to start at the same time
+// and to find no cache: the process that gets the lock of the cache builds it and saves it, the others wait
+// until the lock is released and load the cache. If the cache still cannot be loaded then (the holder failed
+// to save it or died), or the holder does not finish within waitSeconds, the waiting processes build it
+// themselves without saving it. Failing to save the cache (e.g. in a read-only location) is not fatal.
+// Returns true if the cache was loaded, false if it was built.
+bool BuildOrWaitForCache(const std::wstring& cacheFile, double waitSeconds, bool verbose,
+                         const std::function<bool()>& tryLoad,
+                         const std::function<void()>& build,
+                         const std::function<void()>& save);
+
+}}}
@@ -17,8 +17,9 @@ public:
         SequenceEnumeratorPtr sequenceEnumerator,
         const std::vector<StreamDescriptionPtr>& streams,
         bool useLocalTimeline = false,
-        size_t numberOfBuffers = 2) :
-        SequencePacker(sequenceEnumerator, streams, numberOfBuffers), m_useLocalTimeline(useLocalTimeline)
+        size_t numberOfBuffers = 2,
+        ReaderThreadPoolPtr threadPool = nullptr) :
+        SequencePacker(sequenceEnumerator, streams, numberOfBuffers, threadPool), m_useLocalTimeline(useLocalTimeline)
     {}
 
 protected:
@@ -0,0 +1,248 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "KeyRegistry.h"
+#include <cstring>
+#include <limits>
+#include "fileutil.h"
+#include "MemoryMappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Layout of the registry file: the header, followed by
+// key offsets (uint64_t[N + 1]), hash table slots (uint64_t[numberOfSlots])
+// and the characters of all keys (charsSize bytes, padded to 8).
+// All sections are 8 byte aligned, the file is in the byte order of the machine that wrote it.
+struct KeyRegistryHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_reserved;
+    uint64_t m_numberOfKeys;
+    uint64_t m_numberOfSlots;
+    uint64_t m_charsSize;
+};
+
+static const char s_magic[8] = { 'C', 'N', 'T', 'K', 'K', 'E', 'Y', 'S' };
+static const uint32_t s_version = 1;
+
+static_assert(sizeof(KeyRegistryHeader) % 8 == 0, "Header size must keep the sections aligned.");
+
+static const size_t s_initialNumberOfSlots = 1024;
+static const uint64_t s_idMask = 0xFFFFFFFFull;
+
+KeyRegistry::KeyRegistry()
+    : m_numberOfKeys(0)
+{
+    m_offsetBuffer.assign(1, 0);
+    m_slotBuffer.assign(s_initialNumberOfSlots, 0);
+    m_chars = m_charBuffer.data();
+    m_offsets = m_offsetBuffer.data();
+    m_slots = m_slotBuffer.data();
+    m_numberOfSlots = m_slotBuffer.size();
+}
+
+KeyRegistry::~KeyRegistry()
+{
+}
+
+// 64 bit FNV-1a.
+uint64_t KeyRegistry::Hash(const char* key, size_t length)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+size_t KeyRegistry::FindSlot(const char* key, size_t length, uint64_t hash) const
+{
+    uint64_t tag = hash >> 32;
+    size_t mask = m_numberOfSlots - 1;
+    for (size_t position = (size_t)hash & mask;; position = (position + 1) & mask)
+    {
+        uint64_t slot = m_slots[position];
+        if (slot == 0)
+            return position;
+
+        if ((slot >> 32) != tag)
+            continue;
+
+        size_t id = (size_t)(slot & s_idMask) - 1;
+        if (GetKeyLength(id) == length && memcmp(m_chars + m_offsets[id], key, length) == 0)
+            return position;
+    }
+}
+
+bool KeyRegistry::TryGet(const char* key, size_t length, size_t& id) const
+{
+    uint64_t slot = m_slots[FindSlot(key, length, Hash(key, length))];
+    if (slot == 0)
+        return false;
+
+    id = (size_t)(slot & s_idMask) - 1;
+    return true;
+}
+
+size_t KeyRegistry::AddValue(const char* key, size_t length)
+{
+    uint64_t hash = Hash(key, length);
+    size_t position = FindSlot(key, length, hash);
+    if (m_slots[position] != 0)
+        return (size_t)(m_slots[position] & s_idMask) - 1;
+
+    if (m_numberOfKeys >= s_idMask - 1)
+        RuntimeError("The number of sequence keys exceeds the capacity of the key registry.");
+
+    if (IsMapped())
+        CopyFromMapping();
+
+    // Keeping the load factor at most 3/4.
+    if ((m_numberOfKeys + 1) * 4 > m_numberOfSlots * 3)
+    {
+        Rehash(2 * m_numberOfSlots);
+        position = FindSlot(key, length, hash);
+    }
+
+    size_t id = m_numberOfKeys;
+    m_charBuffer.insert(m_charBuffer.end(), key, key + length);
+    m_charBuffer.push_back('\0');
+    m_offsetBuffer.push_back(m_charBuffer.size());
+    m_slotBuffer[position] = ((hash >> 32) << 32) | (uint64_t)(id + 1);
+    m_numberOfKeys++;
+
+    m_chars = m_charBuffer.data();
+    m_offsets = m_offsetBuffer.data();
+    return id;
+}
+
+void KeyRegistry::Reserve(size_t numberOfKeys, size_t numberOfChars)
+{
+    if (IsMapped())
+        CopyFromMapping();
+
+    m_charBuffer.reserve(numberOfChars + numberOfKeys);
+    m_offsetBuffer.reserve(numberOfKeys + 1);
+    size_t numberOfSlots = m_numberOfSlots;
+    while (numberOfKeys * 4 > numberOfSlots * 3)
+        numberOfSlots *= 2;
+    if (numberOfSlots != m_numberOfSlots)
+        Rehash(numberOfSlots);
+
+    m_chars = m_charBuffer.data();
+    m_offsets = m_offsetBuffer.data();
+}
+
+void KeyRegistry::Rehash(size_t numberOfSlots)
+{
+    m_slotBuffer.assign(numberOfSlots, 0);
+    m_slots = m_slotBuffer.data();
+    m_numberOfSlots = numberOfSlots;
+
+    size_t mask = numberOfSlots - 1;
+    for (size_t id = 0; id < m_numberOfKeys; ++id)
+    {
+        uint64_t hash = Hash(m_chars + m_offsets[id], GetKeyLength(id));
+        size_t position = (size_t)hash & mask;
+        while (m_slotBuffer[position] != 0)
+            position = (position + 1) & mask;
+        m_slotBuffer[position] = ((hash >> 32) << 32) | (uint64_t)(id + 1);
+    }
+}
+
+void KeyRegistry::CopyFromMapping()
+{
+    m_charBuffer.assign(m_chars, m_chars + m_offsets[m_numberOfKeys]);
+    m_offsetBuffer.assign(m_offsets, m_offsets + m_numberOfKeys + 1);
+    m_slotBuffer.assign(m_slots, m_slots + m_numberOfSlots);
+    m_chars = m_charBuffer.data();
+    m_offsets = m_offsetBuffer.data();
+    m_slots = m_slotBuffer.data();
+    m_mapping.reset();
+}
+
+void KeyRegistry::Save(const wstring& fileName) const
+{
+    KeyRegistryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_magic, s_magic, sizeof(s_magic));
+    header.m_version = s_version;
+    header.m_numberOfKeys = m_numberOfKeys;
+    header.m_numberOfSlots = m_numberOfSlots;
+    header.m_charsSize = m_offsets[m_numberOfKeys];
+
+    static const char padding[8] = {};
+    size_t paddingSize = (size_t)((8 - header.m_charsSize % 8) % 8);
+
+    // Written under a temporary name first, so that concurrent jobs never see a partial file.
+    wstring tempFileName = fileName + L".tmp";
+    FILE* f = fopenOrDie(tempFileName, L"wb");
+    fwriteOrDie(&header, sizeof(header), 1, f);
+    fwriteOrDie(m_offsets, sizeof(uint64_t), m_numberOfKeys + 1, f);
+    fwriteOrDie(m_slots, sizeof(uint64_t), m_numberOfSlots, f);
+    if (header.m_charsSize > 0)
+        fwriteOrDie(m_chars, sizeof(char), (size_t)header.m_charsSize, f);
+    if (paddingSize > 0)
+        fwriteOrDie(padding, sizeof(char), paddingSize, f);
+    fcloseOrDie(f);
+
+    if (fexists(fileName))
+        unlinkOrDie(fileName);
+    renameOrDie(tempFileName, fileName);
+}
+
+bool KeyRegistry::TryLoad(const wstring& fileName)
+{
+    if (m_numberOfKeys > 0 || IsMapped())
+        LogicError("A key registry can only be loaded when it is empty.");
+
+    if (!fexists(fileName))
+        return false;
+
+    unique_ptr<MemoryMappedFile> mapping(new MemoryMappedFile(fileName));
+    if (mapping->GetSize() < sizeof(KeyRegistryHeader))
+        return false;
+
+    KeyRegistryHeader header;
+    memcpy(&header, mapping->GetData(), sizeof(header));
+    uint64_t offsetsSize = (header.m_numberOfKeys + 1) * sizeof(uint64_t);
+    uint64_t slotsSize = header.m_numberOfSlots * sizeof(uint64_t);
+    uint64_t expectedSize = sizeof(header) + offsetsSize + slotsSize + (header.m_charsSize + 7) / 8 * 8;
+    bool validNumberOfSlots = header.m_numberOfSlots > 0 && (header.m_numberOfSlots & (header.m_numberOfSlots - 1)) == 0 &&
+                              header.m_numberOfKeys < header.m_numberOfSlots;
+    if (memcmp(header.m_magic, s_magic, sizeof(s_magic)) != 0 ||
+        header.m_version != s_version ||
+        !validNumberOfSlots ||
+        expectedSize != mapping->GetSize())
+        return false;
+
+    const char* position = mapping->GetData() + sizeof(header);
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(position);
+    if (offsets[0] != 0 || offsets[header.m_numberOfKeys] != header.m_charsSize)
+        return false;
+
+    m_offsets = offsets;
+    position += offsetsSize;
+    m_slots = reinterpret_cast<const uint64_t*>(position);
+    position += slotsSize;
+    m_chars = position;
+    m_numberOfKeys = (size_t)header.m_numberOfKeys;
+    m_numberOfSlots = (size_t)header.m_numberOfSlots;
+    m_mapping = move(mapping);
+
+    m_charBuffer.clear();
+    m_offsetBuffer.clear();
+    m_slotBuffer.clear();
+    return true;
+}
+
+}}}
@@ -0,0 +1,122 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MemoryMappedFile;
+
+// Compact registry of sequence keys that assigns consecutive ids to the keys in the order they are added.
+// Unlike TStringToIdMap it does not allocate per key:
+// - the characters of all keys are stored 0-terminated in one contiguous buffer,
+// - per key there is an offset into the characters (N + 1 offsets),
+// - the ids are found through an open addressing hash table with linear probing, each slot holds
+//   the upper 32 bits of the hash of the key and its id + 1 (0 for an empty slot), so that
+//   the characters are only compared for the (rare) slots whose hash matches.
+// The registry can be saved to a binary file; the arrays of a loaded file are used in place from
+// a read-only memory mapping, so that jobs with hundreds of millions of keys neither rebuild the
+// registry nor copy it to the heap. Adding a key that is not in the loaded file copies the arrays
+// out of the mapping first.
+class KeyRegistry
+{
+public:
+    KeyRegistry();
+    ~KeyRegistry();
+
+    // Returns the id of the key, adding the key if it is not in the registry.
+    size_t AddValue(const char* key, size_t length);
+
+    size_t AddValue(const std::string& key)
+    {
+        return AddValue(key.c_str(), key.size());
+    }
+
+    // Tries to get the id of a key.
+    bool TryGet(const char* key, size_t length, size_t& id) const;
+
+    bool TryGet(const std::string& key, size_t& id) const
+    {
+        return TryGet(key.c_str(), key.size(), id);
+    }
+
+    bool Contains(const std::string& key) const
+    {
+        size_t id;
+        return TryGet(key, id);
+    }
+
+    // Returns the 0-terminated key with the given id.
+    const char* GetKey(size_t id) const
+    {
+        if (id >= m_numberOfKeys)
+            RuntimeError("Unknown id requested");
+        return m_chars + m_offsets[id];
+    }
+
+    size_t GetKeyLength(size_t id) const
+    {
+        if (id >= m_numberOfKeys)
+            RuntimeError("Unknown id requested");
+        return (size_t)(m_offsets[id + 1] - m_offsets[id] - 1);
+    }
+
+    // Number of keys in the registry.
+    size_t Size() const
+    {
+        return m_numberOfKeys;
+    }
+
+    // Reserves space for the given number of keys with the given total number of characters.
+    void Reserve(size_t numberOfKeys, size_t numberOfChars);
+
+    // Saves the registry to the file.
+    void Save(const std::wstring& fileName) const;
+
+    // Maps the registry from the file (which must stay unchanged while the registry exists).
+    // Returns false if the file does not exist or is not a valid registry.
+    bool TryLoad(const std::wstring& fileName);
+
+    // Tells whether the arrays are used from a mapped file.
+    bool IsMapped() const
+    {
+        return m_mapping != nullptr;
+    }
+
+private:
+    // Copies the arrays of a mapped registry to the buffers below and releases the mapping.
+    void CopyFromMapping();
+
+    // Rebuilds the hash table with the given number of slots (a power of two).
+    void Rehash(size_t numberOfSlots);
+
+    // Position in the hash table of the key, i.e. of its slot or of the empty slot where it would be inserted.
+    size_t FindSlot(const char* key, size_t length, uint64_t hash) const;
+
+    static uint64_t Hash(const char* key, size_t length);
+
+    // Arrays, either pointing to the buffers below or into the mapped file.
+    const char* m_chars;
+    const uint64_t* m_offsets;
+    const uint64_t* m_slots;
+    size_t m_numberOfKeys;
+    size_t m_numberOfSlots;
+
+    std::vector<char> m_charBuffer;
+    std::vector<uint64_t> m_offsetBuffer;
+    std::vector<uint64_t> m_slotBuffer;
+
+    std::unique_ptr<MemoryMappedFile> m_mapping;
+
+    DISABLE_COPY_AND_MOVE(KeyRegistry);
+};
+
+}}}
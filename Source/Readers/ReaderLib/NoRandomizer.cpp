@@ -5,6 +5,7 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <algorithm>
+#include <chrono>
 
 #include "NoRandomizer.h"
 #include "DataReader.h"
@@ -12,13 +13,14 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-NoRandomizer::NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences)
+NoRandomizer::NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences, ReaderThreadPoolPtr threadPool)
     : m_deserializer(deserializer),
       m_currentChunkPosition(CHUNKID_MAX),
       m_globalSamplePosition(0),
       m_totalNumberOfSamples(0),
       m_currentSequencePositionInChunk(0),
-      m_multithreadedGetNextSequences(multithreadedGetNextSequences)
+      m_multithreadedGetNextSequences(multithreadedGetNextSequences),
+      m_threadPool(threadPool)
 {
     assert(deserializer != nullptr);
     m_streams = m_deserializer->GetStreamDescriptions();
@@ -104,6 +106,23 @@ size_t NoRandomizer::GetCurrentSamplePosition()
     return m_globalSamplePosition;
 }
 
+bool NoRandomizer::SetSequenceTransformation(const SequenceTransformation& transformation)
+{
+    if (!m_threadPool && !m_multithreadedGetNextSequences)
+    {
+        return false;
+    }
+
+    m_sequenceTransformation = transformation;
+    return true;
+}
+
+void NoRandomizer::TakeChunkLoadSeconds(std::vector<double>& seconds)
+{
+    seconds.insert(seconds.end(), m_chunkLoadSeconds.begin(), m_chunkLoadSeconds.end());
+    m_chunkLoadSeconds.clear();
+}
+
 Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
 {
     Sequences result;
@@ -152,7 +171,9 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
             }
             else
             {
+                auto loadStart = std::chrono::steady_clock::now();
                 chunks[sequenceDescription.m_chunkId] = m_deserializer->GetChunk(sequenceDescription.m_chunkId);
+                m_chunkLoadSeconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count());
             }
         }
     }
@@ -171,6 +192,11 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
         }
 
         it->second->GetSequence(sequenceDescription.m_id, sequence);
+        if (m_sequenceTransformation)
+        {
+            m_sequenceTransformation(sequence);
+        }
+
         for (int j = 0; j < m_streams.size(); ++j)
         {
             result.m_data[j][i] = sequence[j];
@@ -178,7 +204,11 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
     };
 
     // TODO: This will be changed, when we move transformers under the (no-) randomizer, should not deal with multithreading here.
-    if (m_multithreadedGetNextSequences)
+    if (m_threadPool)
+    {
+        m_threadPool->ParallelFor(subsetSize, [&process](size_t i) { process((int)i); });
+    }
+    else if (m_multithreadedGetNextSequences)
     {
         ExceptionCapture capture;
 #pragma omp parallel for schedule(dynamic)
@@ -8,6 +8,7 @@
 #include <vector>
 #include "SequenceEnumerator.h"
 #include "DataDeserializer.h"
+#include "ReaderThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -18,7 +19,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 class NoRandomizer : public SequenceEnumerator
 {
 public:
-    NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences = false);
+    NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences = false, ReaderThreadPoolPtr threadPool = nullptr);
 
     virtual void StartEpoch(const EpochConfiguration& config) override;
     virtual Sequences GetNextSequences(size_t sampleCount) override;
@@ -32,6 +33,11 @@ public:
 
     void SetConfiguration(const ReaderConfiguration& config) override;
 
+    // Sequences are transformed right after deserialization if they are deserialized in parallel.
+    bool SetSequenceTransformation(const SequenceTransformation& transformation) override;
+
+    void TakeChunkLoadSeconds(std::vector<double>& seconds) override;
+
 private:
     // Gets next sequence descriptions with total size less than sampleCount.
     std::vector<SequenceDescription> GetNextSequenceDescriptions(size_t sampleCount);
@@ -48,6 +54,12 @@ private:
     // TODO temporary; should go away when transformers are moved closer to the deserializer
     bool m_multithreadedGetNextSequences;
 
+    // Threads used to get sequences, if not set OpenMP is used when m_multithreadedGetNextSequences is true.
+    ReaderThreadPoolPtr m_threadPool;
+
+    // Applied to each sequence right after it has been deserialized, can be empty.
+    SequenceTransformation m_sequenceTransformation;
+
     // Stream descriptions
     std::vector<StreamDescriptionPtr> m_streams;
 
@@ -67,6 +79,9 @@ private:
     // Current chunk data id.
     ChunkIdType m_currentChunkId;
 
+    // Durations of the chunk loads since the last TakeChunkLoadSeconds.
+    std::vector<double> m_chunkLoadSeconds;
+
     // Current window of sequence descriptions.
     std::vector<SequenceDescription> m_sequenceWindow;
 
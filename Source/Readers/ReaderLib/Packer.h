@@ -18,6 +18,13 @@ public:
     virtual void SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders) = 0;
 
     virtual Minibatch ReadMinibatch() = 0;
+
+    // Returns the seconds spent getting sequences from the sequence enumerator since the last call, and restarts the count.
+    virtual double TakeSequenceEnumeratorSeconds()
+    {
+        return 0;
+    }
+
     virtual ~Packer() {}
 };
 
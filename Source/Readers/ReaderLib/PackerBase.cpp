@@ -8,15 +8,19 @@
 
 #include "PackerBase.h"
 #include "ElementTypeUtils.h"
+#include <chrono>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 using namespace std;
 
 // Resizing the buffer with the current memory provider.
+// The old content is not preserved, so the old buffer is released first,
+// which allows a pooling memory provider to hand it out again if it is large enough.
 void PackerBase::StreamBuffer::Resize(size_t newSize)
 {
     m_size = newSize;
+    m_data.reset();
     auto provider = m_memoryProvider;
     m_data.reset(reinterpret_cast<char*>(provider->Alloc(1, newSize)),
         [provider](char* p)
@@ -25,6 +29,21 @@ void PackerBase::StreamBuffer::Resize(size_t newSize)
     });
 }
 
+Sequences PackerBase::ReadSequences(size_t sampleCount)
+{
+    auto start = chrono::steady_clock::now();
+    auto sequences = m_sequenceEnumerator->GetNextSequences(sampleCount);
+    m_sequenceEnumeratorSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return sequences;
+}
+
+double PackerBase::TakeSequenceEnumeratorSeconds()
+{
+    double seconds = m_sequenceEnumeratorSeconds;
+    m_sequenceEnumeratorSeconds = 0;
+    return seconds;
+}
+
 void PackerBase::SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders)
 {
     // Let's check that memory providers did not change at the start of new epoch.
@@ -58,6 +77,7 @@ PackerBase::PackerBase(SequenceEnumeratorPtr sequenceEnumerator,
     const std::vector<StreamDescriptionPtr>& streams,
     size_t numberOfBuffers) :
     m_sequenceEnumerator(sequenceEnumerator),
+    m_sequenceEnumeratorSeconds(0),
     m_outputStreamDescriptions(streams),
     m_numberOfBuffers(numberOfBuffers),
     m_currentBufferIndex(0)
@@ -75,15 +95,20 @@ PackerBase::PackerBase(SequenceEnumeratorPtr sequenceEnumerator,
         const auto& stream = m_outputStreamDescriptions[i];
         UNUSED(stream);
 
-        // Check the input.
-        if(m_inputStreamDescriptions[i]->m_elementType != ElementType::tdouble &&
-            m_inputStreamDescriptions[i]->m_elementType != ElementType::tfloat)
+        // Check the input. Streams that are widened or augmented on the device are packed in their narrow type.
+        auto inputType = m_inputStreamDescriptions[i]->m_elementType;
+        bool narrow = (stream->m_deviceAugmentation && inputType == ElementType::tuchar) ||
+            (stream->m_deviceWidening && (inputType == ElementType::tuchar || inputType == ElementType::tfloat16));
+        if(inputType != ElementType::tdouble && inputType != ElementType::tfloat && !narrow)
         {
             RuntimeError("Please specify the type of the '%ls' stream. You can use 'Cast' transform for that.", m_inputStreamDescriptions[i]->m_name.c_str());
         }
 
+        if (narrow && stream->m_storageType != StorageType::dense)
+            RuntimeError("Stream '%ls' of a narrow element type has to be dense.", stream->m_name.c_str());
+
         // Input and output should match in everything except for sparse/dense storage type.
-        assert(stream->m_elementType == ElementType::tfloat || stream->m_elementType == ElementType::tdouble);
+        assert(stream->m_elementType == ElementType::tfloat || stream->m_elementType == ElementType::tdouble || narrow);
         assert(stream->m_name == m_inputStreamDescriptions[i]->m_name);
         assert(stream->m_id == m_inputStreamDescriptions[i]->m_id);
 
@@ -57,11 +57,17 @@ protected:
 
     virtual Sequences GetNextSequences()
     {
-        return m_sequenceEnumerator->GetNextSequences(m_config.m_minibatchSizeInSamples);
+        return ReadSequences(m_config.m_minibatchSizeInSamples);
     }
 
+    // Gets the next sequences from the sequence enumerator, timing it for the reader profile.
+    Sequences ReadSequences(size_t sampleCount);
+
     SequenceEnumeratorPtr m_sequenceEnumerator;
 
+    // Seconds spent in ReadSequences since the last TakeSequenceEnumeratorSeconds.
+    double m_sequenceEnumeratorSeconds;
+
     // Input stream descriptions provided by the transformer.
     std::vector<StreamDescriptionPtr> m_outputStreamDescriptions;
 
@@ -92,6 +98,8 @@ protected:
 public:
     // Sets current epoch configuration.
     virtual void SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders) override;
+
+    virtual double TakeSequenceEnumeratorSeconds() override;
 };
 
 inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenceDataPtr sequence,
@@ -120,7 +128,7 @@ inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenc
 inline void PackerBase::PackDenseSample(char* destination, SequenceDataPtr sequence, size_t sampleOffset, size_t sampleSize)
 {
     // Because the sample is dense - simply copying it to the output.
-    memcpy(destination, (const char*)(sequence->GetDataBuffer()) + sampleOffset, sampleSize);
+    static_cast<DenseSequenceData*>(sequence.get())->CopySamples(sampleOffset / sampleSize, 1, sampleSize, destination, sampleSize);
 }
 
 }}}
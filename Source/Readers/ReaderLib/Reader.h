@@ -8,7 +8,10 @@
 #include <vector>
 #include <memory>
 #include "Sequences.h"
+#include "ReaderProfile.h"
 #include "TensorShape.h"
+#include "ImageAugmentation.h"
+#include "NarrowElementTypes.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -50,6 +53,7 @@ enum class ElementType
     tfloat,  // single precision
     tdouble, // double precision
     tuchar,  // unsigned char
+    tfloat16,// half precision, only used to transfer data to the device (see DeviceStreamWidening)
 };
 
 // Supported storage types, will be extended in the future.
@@ -61,6 +65,26 @@ enum class StorageType
 
 typedef size_t StreamId;
 
+// Augmentation of a stream of uint8 images that is done after the transfer to the device
+// of the network (see Matrix::AssignAugmentedImages), instead of by CPU transforms of the reader.
+// The parameters are updated by the reader at the start of each epoch.
+struct DeviceImageAugmentation
+{
+    ImageAugmentationParameters m_parameters;
+    std::vector<float> m_mean;      // Mean image (HWC) if m_parameters.m_subtractMean is set
+    unsigned int m_seed;
+};
+typedef std::shared_ptr<DeviceImageAugmentation> DeviceImageAugmentationPtr;
+
+// A stream of a narrow element type (tuchar or tfloat16) that is transferred to the device as is
+// and widened to the element type of the network there: value = m_scale * narrow value + m_shift.
+struct DeviceStreamWidening
+{
+    float m_scale;
+    float m_shift;
+};
+typedef std::shared_ptr<DeviceStreamWidening> DeviceStreamWideningPtr;
+
 // This class describes a particular stream: its name, element type, storage, etc.
 struct StreamDescription
 {
@@ -70,6 +94,10 @@ struct StreamDescription
     ElementType m_elementType;     // Element type of the stream
     TensorShapePtr m_sampleLayout; // Layout of the sample for the stream
                                    // If not specified - can be specified per sequence
+    DeviceImageAugmentationPtr m_deviceAugmentation; // If set, the stream contains uint8 images (tuchar)
+                                                     // that are augmented into ElemType on the device
+    DeviceStreamWideningPtr m_deviceWidening;        // If set, the stream has a narrow element type
+                                                     // that is widened into ElemType on the device
 };
 typedef std::shared_ptr<StreamDescription> StreamDescriptionPtr;
 
@@ -129,9 +157,29 @@ public:
     // Set current global position
     virtual void SetCurrentSamplePosition(size_t currentSamplePosition) = 0;
 
+    // Returns the exact state of the reader at the current position, or an empty string if not supported.
+    virtual std::string GetState()
+    {
+        return std::string();
+    }
+
+    // Restores a state returned by GetState, returns false if not supported.
+    // Positioning close to the restored position is then cheap.
+    virtual bool SetState(const std::string&)
+    {
+        return false;
+    }
+
     // Reads a minibatch that contains data across all streams.
     virtual Minibatch ReadMinibatch() = 0;
 
+    // Gets the profile of the reader since the start of the epoch, returns false if not supported.
+    // Can be called while another thread reads minibatches.
+    virtual bool GetProfile(ReaderProfile&)
+    {
+        return false;
+    }
+
     virtual ~Reader() {};
 };
 
@@ -7,6 +7,7 @@
 #include "ReaderBase.h"
 #include "CudaMemoryProvider.h"
 #include "HeapMemoryProvider.h"
+#include <chrono>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -34,6 +35,8 @@ void ReaderBase::StartEpoch(const EpochConfiguration& config, const std::map<std
         m_requiredInputs = inputDescriptions;
 
         // Reallocating memory providers.
+        // All streams on the same device share one pool of page-locked buffers,
+        // which is kept across epochs.
         m_memoryProviders.resize(streams.size());
         for (size_t i = 0; i < streams.size(); ++i)
         {
@@ -49,18 +52,51 @@ void ReaderBase::StartEpoch(const EpochConfiguration& config, const std::map<std
             if (deviceId < 0)
                 m_memoryProviders[i] = std::make_shared<HeapMemoryProvider>();
             else
-                m_memoryProviders[i] = std::make_shared<CudaMemoryProvider>(deviceId);
+            {
+                auto& pinnedMemoryProvider = m_pinnedMemoryProviders[deviceId];
+                if (!pinnedMemoryProvider)
+                    pinnedMemoryProvider = std::make_shared<CudaMemoryProvider>(deviceId);
+                m_memoryProviders[i] = pinnedMemoryProvider;
+            }
         }
+
+        // Enough free buffers to cover a full rotation of the packer buffers of all streams.
+        for (auto& pinnedMemoryProvider : m_pinnedMemoryProviders)
+            pinnedMemoryProvider.second->SetMaxCachedBuffers(std::max<size_t>(8, 2 * streams.size()));
     }
 
     m_sequenceEnumerator->StartEpoch(config);
     m_packer->SetConfiguration(config, m_memoryProviders);
+
+    std::lock_guard<std::mutex> lock(m_profileMutex);
+    m_profile = ReaderProfile();
+    std::vector<double> previousChunkLoadSeconds;
+    m_sequenceEnumerator->TakeChunkLoadSeconds(previousChunkLoadSeconds);
+    m_packer->TakeSequenceEnumeratorSeconds();
 }
 
 Minibatch ReaderBase::ReadMinibatch()
 {
     assert(m_packer != nullptr);
-    return m_packer->ReadMinibatch();
+    auto start = std::chrono::steady_clock::now();
+    auto minibatch = m_packer->ReadMinibatch();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // the packer time is what is left after getting the sequences
+    double sequenceEnumeratorSeconds = m_packer->TakeSequenceEnumeratorSeconds();
+    std::lock_guard<std::mutex> lock(m_profileMutex);
+    m_sequenceEnumerator->TakeChunkLoadSeconds(m_profile.m_chunkLoadSeconds);
+    m_profile.m_randomizerSeconds += sequenceEnumeratorSeconds;
+    m_profile.m_packerSeconds += std::max(0.0, seconds - sequenceEnumeratorSeconds);
+    m_profile.m_numMinibatches++;
+    return minibatch;
+}
+
+bool ReaderBase::GetProfile(ReaderProfile& profile)
+{
+    std::lock_guard<std::mutex> lock(m_profileMutex);
+    profile = m_profile;
+    return true;
 }
 
 size_t ReaderBase::GetCurrentSamplePosition()
@@ -73,6 +109,16 @@ void ReaderBase::SetCurrentSamplePosition(size_t currentSamplePosition)
     m_sequenceEnumerator->SetCurrentSamplePosition(currentSamplePosition);
 }
 
+std::string ReaderBase::GetState()
+{
+    return m_sequenceEnumerator->GetState();
+}
+
+bool ReaderBase::SetState(const std::string& state)
+{
+    return m_sequenceEnumerator->SetState(state);
+}
+
 void ReaderBase::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>&)
 {
     m_sequenceEnumerator->SetConfiguration(config);
@@ -8,6 +8,8 @@
 #include "Reader.h"
 #include "Packer.h"
 #include "SequenceEnumerator.h"
+#include "CudaMemoryProvider.h"
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -32,8 +34,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         void SetCurrentSamplePosition(size_t currentSamplePosition) override;
 
+        std::string GetState() override;
+
+        bool SetState(const std::string& state) override;
+
         void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
 
+        bool GetProfile(ReaderProfile& profile) override;
+
         virtual ~ReaderBase() = 0;
 
     protected:
@@ -51,5 +59,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         // Memory provider per input.
         std::vector<MemoryProviderPtr> m_memoryProviders;
+
+        // Pools of page-locked memory per device, shared by all inputs on that device.
+        std::map<int, std::shared_ptr<CudaMemoryProvider>> m_pinnedMemoryProviders;
+
+    private:
+        // Profile since the start of the epoch, updated by ReadMinibatch.
+        ReaderProfile m_profile;
+        std::mutex m_profileMutex;
     };
 }}}
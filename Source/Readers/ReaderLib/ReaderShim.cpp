@@ -18,19 +18,28 @@
 #include "DataReader.h"
 #include "ReaderShim.h"
 #include "DataTransferer.h"
+#include "BestGpu.h"
+#include "ElementTypeUtils.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
 ReaderShim<ElemType>::ReaderShim() :
     m_deviceId(CPUDEVICE),
-    m_dataTransferers(2, DataTransfererPtr()),
-    m_currentDataTransferIndex(0),
+    m_prefetch(true),
+    m_prefetchDepth(1),
+    m_traceLevel(0),
+    m_threadAffinity(ThreadAffinity::None),
+    m_stopPrefetch(false),
+    m_prefetchDone(true),
     m_endOfEpoch(false),
     m_currentSamplePosition(0),
+    m_workerRank(0),
     m_reader(nullptr),
     m_factory(nullptr)
 {
+    m_prefetchStatistics = PrefetchStatistics{ 0, 0, 0, 0.0 };
+    m_paddingStatistics = PaddingStatistics{ 0, 0, 0, 1.0 };
 }
 
 template <class ElemType>
@@ -53,10 +62,14 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     intargvector numberOfuttsPerMinibatchForAllEpochs =
         config(L"nbruttsineachrecurrentiter", ConfigParameters::Array(intargvector(vector<int> { 1 })));
 
-    bool prefetch = config(L"prefetch", true);
-    // if prefetch - launching asynchronously,
-    // otherwise deferring - synchronous execution during .get() call
-    m_launchType = prefetch ? launch::async : launch::deferred;
+    // if prefetch - reading asynchronously on a separate thread,
+    // otherwise synchronous execution during GetMinibatch call
+    m_prefetch = config(L"prefetch", true);
+    m_prefetchDepth = config(L"prefetchDepth", (size_t)1);
+    if (m_prefetchDepth == 0)
+        InvalidArgument("prefetchDepth must be at least 1.");
+    m_traceLevel = config(L"traceLevel", 0);
+    m_threadAffinity = ParseThreadAffinity(config(L"threadAffinity", L"none"));
 
     m_numParallelSequences = numberOfuttsPerMinibatchForAllEpochs[0];
 
@@ -68,6 +81,8 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     {
         m_nameToStreamId.insert(std::make_pair(i->m_name, i->m_id));
     }
+
+    m_prefetchSlots.resize(m_prefetch ? m_prefetchDepth : 1);
 }
 
 template <class ElemType>
@@ -98,71 +113,66 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
 template <class ElemType>
 void ReaderShim<ElemType>::SetCurrentSamplePosition(size_t currentSamplePosition)
 {
-    // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.wait();
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // Make sure there are no outstanding reads or copies.
+    StopPrefetch();
 
     // Set current position.
     m_reader->SetCurrentSamplePosition(currentSamplePosition);
     m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
 
-    // Start prefetch.
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-        [this, localCurrentDataTransferIndex]()
-    {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+    StartPrefetch();
 }
 
 template <class ElemType>
-void ReaderShim<ElemType>::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
+std::string ReaderShim<ElemType>::GetReaderState()
 {
-    // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.wait();
+    // The prefetch thread reads ahead of the network, so the reader is rewound to the position of the network first.
+    // The position is within the randomization window of the reader, so this is cheap.
+    bool restartPrefetch = !m_prefetch || m_prefetchTask.valid();
+    StopPrefetch();
 
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    m_reader->SetCurrentSamplePosition(m_currentSamplePosition);
+    auto state = m_reader->GetState();
+
+    if (restartPrefetch)
+        StartPrefetch();
+    return state;
+}
+
+template <class ElemType>
+bool ReaderShim<ElemType>::SetReaderState(const std::string& state)
+{
+    // Before the first epoch is started the prefetch thread must not be started.
+    bool restartPrefetch = !m_prefetch || m_prefetchTask.valid();
+    StopPrefetch();
 
+    bool restored = m_reader->SetState(state);
+    if (restored)
+        m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+
+    if (restartPrefetch)
+        StartPrefetch();
+    return restored;
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
+{
+    // Make sure there are no outstanding reads or copies.
+    StopPrefetch();
+
+    // Minibatches that were prefetched ahead are discarded, so rewind the reader to the position of the network.
     m_reader->SetConfiguration(config, inputDescriptions);
     m_reader->SetCurrentSamplePosition(m_currentSamplePosition);
 
-    // Start prefetch.
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-        [this, localCurrentDataTransferIndex]()
-    {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+    StartPrefetch();
 }
 
 template <class ElemType>
 void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const std::unordered_set<InputStreamDescription>& inputs)
 {
-    // For adaptive minibatch, make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-    {
-        m_prefetchTask.wait();
-    }
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // For adaptive minibatch, make sure there are no outstanding reads or copies.
+    StopPrefetch();
 
     // Now we can be sure, no prefetch thread is running and there are no outstanding memcopies.
     // Let's check that requested devices are ok and see whether we need to change our data transferers.
@@ -178,14 +188,20 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
         LogicError("Readers do not support running on several GPUs in the same process, at least two devices found '%d', '%d'", deviceId, secondDevice->GetDeviceId());
     }
 
-    if (m_deviceId != deviceId)
+    if (m_deviceId != deviceId || (deviceId != CPUDEVICE && !m_prefetchSlots.front().m_dataTransferer))
     {
-        // Device changed. Let's change the data transferers.
+        // Device changed. Let's change the data transferers, one per slot.
         m_deviceId = deviceId;
-        m_dataTransferers.clear();
-        // We need two in order to support two operations in flight.
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
+        for (auto& slot : m_prefetchSlots)
+            slot.m_dataTransferer = m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId);
+
+        if (m_threadAffinity == ThreadAffinity::Device)
+        {
+            int numaNode = m_deviceId == CPUDEVICE ? -1 : GetGpuNumaNode(m_deviceId);
+            SetReaderNumaNode(numaNode);
+            if (m_traceLevel > 0 && numaNode >= 0)
+                fprintf(stderr, "ReaderShim: Binding reader threads to NUMA node %d of GPU %d.\n", numaNode, (int)m_deviceId);
+        }
     }
 
     // Let's create the buffers for the prefetch thread.
@@ -194,26 +210,184 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
     {
         inputDescriptions[i.GetStreamName()] = i.GetDeviceId();
         // Creating buffers with the same properties the network expects.
-        m_prefetchBuffers[i.GetStreamName()] = StreamPrefetchBuffer
+        for (auto& slot : m_prefetchSlots)
         {
-            std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
-            std::make_shared<MBLayout>()
-        };
+            slot.m_buffers[i.GetStreamName()] = StreamPrefetchBuffer
+            {
+                std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
+                std::make_shared<MBLayout>(),
+                std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId()),
+                0,
+                0
+            };
+        }
     }
 
+    m_workerRank = config.m_workerRank;
     m_endOfEpoch = false;
+    m_prefetchStatistics = PrefetchStatistics{ 0, 0, 0, 0.0 };
+    m_paddingStatistics = PaddingStatistics{ 0, 0, 0, 1.0 };
     m_reader->StartEpoch(config, inputDescriptions);
     m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
 
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-    [this, localCurrentDataTransferIndex]()
+    StartPrefetch();
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::StopPrefetch()
+{
+    if (m_prefetchTask.valid())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_prefetchMutex);
+            m_stopPrefetch = true;
+        }
+        m_prefetchCondition.notify_all();
+        m_prefetchTask.get();
+    }
+
+    // Let's check that there is no outstanding copies.
+    // Wait on all events if there are any pending copy operations in flight.
+    for (auto& slot : m_prefetchSlots)
+    {
+        if (slot.m_dataTransferer)
+            slot.m_dataTransferer->WaitForCopyCPUToGPU();
+    }
+
+    m_readySlots.clear();
+    m_freeSlots.clear();
+    for (size_t i = 0; i < m_prefetchSlots.size(); ++i)
+        m_freeSlots.push_back(i);
+    m_prefetchException = nullptr;
+    m_prefetchDone = true;
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::StartPrefetch()
+{
+    m_stopPrefetch = false;
+    m_prefetchDone = false;
+
+    // Starting the prefetch thread. It keeps up to m_prefetchDepth minibatches in flight.
+    // When the network requests a new minibatch, we wait for the oldest one to finish, swap the buffers
+    // and give the slot back to the prefetch thread.
+    // Without prefetch, GetMinibatch reads the minibatch itself.
+    if (m_prefetch)
+        m_prefetchTask = std::async(launch::async, [this]() { PrefetchLoop(); });
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::PrefetchLoop()
+{
+    // The packer allocates and fills the minibatch buffers on this thread.
+    ReaderNumaNodeScope numaNode;
+
+    // The packer reuses its buffers every other minibatch, so the copy of a minibatch
+    // has to finish before the minibatch after next is packed.
+    DataTransfererPtr previousTransferers[2];
+    try
+    {
+        for (;;)
+        {
+            size_t slotIndex;
+            {
+                std::unique_lock<std::mutex> lock(m_prefetchMutex);
+                m_prefetchCondition.wait(lock, [this]() { return m_stopPrefetch || !m_freeSlots.empty(); });
+                if (m_stopPrefetch)
+                    break;
+                slotIndex = m_freeSlots.front();
+                m_freeSlots.pop_front();
+            }
+
+            if (previousTransferers[0])
+                previousTransferers[0]->WaitForCopyCPUToGPU();
+
+            auto& slot = m_prefetchSlots[slotIndex];
+            slot.m_result = PrefetchMinibatch(slot);
+            slot.m_samplePosition = m_reader->GetCurrentSamplePosition();
+
+            previousTransferers[0] = previousTransferers[1];
+            previousTransferers[1] = slot.m_result.m_isDataAvailable ? slot.m_dataTransferer : nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(m_prefetchMutex);
+                m_readySlots.push_back(slotIndex);
+                if (slot.m_result.m_isEndOfEpoch)
+                    m_prefetchDone = true;
+            }
+            m_prefetchCondition.notify_all();
+
+            if (slot.m_result.m_isEndOfEpoch)
+                break;
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(m_prefetchMutex);
+        m_prefetchException = std::current_exception();
+        m_prefetchDone = true;
+    }
+    m_prefetchCondition.notify_all();
+}
+
+template <class ElemType>
+bool ReaderShim<ElemType>::WaitForReadySlot(size_t& slotIndex)
+{
+    if (!m_prefetch)
+    {
+        // Synchronous read into the only slot.
+        if (m_freeSlots.empty())
+            return false;
+        slotIndex = m_freeSlots.front();
+        m_freeSlots.pop_front();
+        auto& slot = m_prefetchSlots[slotIndex];
+        slot.m_result = PrefetchMinibatch(slot);
+        slot.m_samplePosition = m_reader->GetCurrentSamplePosition();
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(m_prefetchMutex);
+    m_prefetchStatistics.m_totalQueueDepth += m_readySlots.size();
+    if (m_readySlots.empty() && !m_prefetchDone)
+    {
+        auto waitStart = std::chrono::steady_clock::now();
+        m_prefetchCondition.wait(lock, [this]() { return !m_readySlots.empty() || m_prefetchDone; });
+        m_prefetchStatistics.m_numWaits++;
+        m_prefetchStatistics.m_readerWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+    }
+
+    if (m_readySlots.empty())
     {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+        if (m_prefetchException)
+            std::rethrow_exception(m_prefetchException);
+        return false;
+    }
+
+    slotIndex = m_readySlots.front();
+    m_readySlots.pop_front();
+    return true;
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::PrintPrefetchStatistics() const
+{
+    if (m_traceLevel > 0 && m_prefetch && m_prefetchStatistics.m_numMinibatches > 0)
+    {
+        fprintf(stderr, "Reader prefetch: %d minibatches, average queue depth %.2f of %d, waited for the reader %d times for %.3fs in total.\n",
+            (int)m_prefetchStatistics.m_numMinibatches, m_prefetchStatistics.AverageQueueDepth(), (int)m_prefetchDepth,
+            (int)m_prefetchStatistics.m_numWaits, m_prefetchStatistics.m_readerWaitSeconds);
+    }
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::PrintPaddingStatistics() const
+{
+    if (m_traceLevel > 0 && m_paddingStatistics.m_numMinibatches > 0)
+    {
+        fprintf(stderr, "Reader padding: %d minibatches, %d samples in %d layout columns, padding efficiency %.1f%% (lowest %.1f%%).\n",
+            (int)m_paddingStatistics.m_numMinibatches, (int)m_paddingStatistics.m_numSamples, (int)m_paddingStatistics.m_numColumns,
+            100.0 * m_paddingStatistics.Efficiency(), 100.0 * m_paddingStatistics.m_minEfficiency);
+    }
 }
 
 string EnumerateInputs(const unordered_map<wstring, size_t>& nameToStreamId)
@@ -263,37 +437,63 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         }
     }
 
-    // Make sure the prefetch has finished.
-    assert(m_prefetchTask.valid());
-    auto result = m_prefetchTask.get();
+    // Wait for the oldest prefetched minibatch.
+    size_t slotIndex;
+    if (!WaitForReadySlot(slotIndex))
+    {
+        m_endOfEpoch = true;
+        PrintPrefetchStatistics();
+        PrintPaddingStatistics();
+        return false;
+    }
 
     // Ok, prefetch is done.
+    auto& slot = m_prefetchSlots[slotIndex];
+    auto result = slot.m_result;
+    m_prefetchStatistics.m_numMinibatches++;
 
     // Let's update our sample position.
-    m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+    m_currentSamplePosition = slot.m_samplePosition;
 
     m_endOfEpoch = result.m_isEndOfEpoch;
+    if (m_endOfEpoch)
+        PrintPrefetchStatistics();
+
     if (m_endOfEpoch && !result.m_isDataAvailable)
     {
         // No data and end of epoch, simply return.
+        PrintPaddingStatistics();
         return false;
     }
 
-    // Remember current data transfer, async memcpy for it already started on the prefetch thread.
-    auto currentDataTransferIndex = m_currentDataTransferIndex;
+    // Let's wait till the memcopy of this minibatch has finished.
+    // With a deep queue it has usually finished long ago.
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->WaitForCopyCPUToGPU();
 
-    // Let's update the current data transferer.
-    m_currentDataTransferIndex = (m_currentDataTransferIndex + 1) % 2;
-
-    // Record an event that prefetch can wait on to ensure that prior compute has finished.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->RecordComputeStreamSyncPoint();
+    // Streams that are augmented or widened on the device are expanded from the narrow workspace now,
+    // the kernels are queued on the compute stream ahead of the network.
+    for (auto i = matrices.begin(); i != matrices.end(); ++i)
+    {
+        const auto& stream = m_streams[m_nameToStreamId[i->first]];
+        auto& buffer = slot.m_buffers[i->first];
+        if (stream->m_deviceAugmentation)
+        {
+            buffer.m_matrix->AssignAugmentedImages(*buffer.m_workspace, buffer.m_numColumns, stream->m_deviceAugmentation->m_parameters, buffer.m_seed);
+        }
+        else if (stream->m_deviceWidening)
+        {
+            auto type = stream->m_elementType == ElementType::tuchar ? NarrowElementType::uint8 : NarrowElementType::float16;
+            buffer.m_matrix->AssignWidenedValuesOf(*buffer.m_workspace, type, stream->m_sampleLayout->GetNumElements(), buffer.m_numColumns,
+                                                   (ElemType)stream->m_deviceWidening->m_scale, (ElemType)stream->m_deviceWidening->m_shift);
+        }
+    }
 
     // We have some data - let's swap the matrices.
     // We cannot simply change pointers because it seems they are remembered deeper in the network.
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        std::swap(i->second.GetMatrix<ElemType>(), *m_prefetchBuffers[i->first].m_matrix);
+        std::swap(i->second.GetMatrix<ElemType>(), *slot.m_buffers[i->first].m_matrix);
 
         // Resetting layouts.
         i->second.pMBLayout->Init(1, 0);
@@ -302,16 +502,22 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // a map to generate error messages when checking layout constraints.
     map<wstring, wstring> layoutToInputMap;
 
+    // Samples and columns of the distinct layouts of this minibatch.
+    size_t numSamples = 0;
+    size_t numColumns = 0;
+
     // Let's now check the layouts and throw if the same layout is being assigned twice.
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        auto streamLayout = m_prefetchBuffers[i->first].m_mbLayout;
+        auto streamLayout = slot.m_buffers[i->first].m_mbLayout;
         auto& layout = i->second.pMBLayout;
         if (layout->GetNumCols() == 0) // just initialized, let's take the layout of the reader.
         {
             // layout is empty, copy layout info from the reader
             layout->CopyFrom(streamLayout, /*keepName*/ true);
             layoutToInputMap[layout->GetAxisName()] = i->first;
+            numSamples += layout->GetActualNumSamples();
+            numColumns += layout->GetNumCols();
         }
         else if (*layout != *streamLayout) // this does a deep value-level comparison
         {
@@ -326,30 +532,44 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // So pick up the first one.
     m_numParallelSequences = matrices.begin()->second.pMBLayout->GetNumParallelSequences();
 
-    // It is time to issue the next prefetch.
-    if (!m_endOfEpoch)
+    if (numColumns > 0)
     {
-        // Starting the prefetch task. There is always a single async read in flight.
-        // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-        // and kick off the new prefetch.
-        auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-        m_prefetchTask = std::async(m_launchType, [this, localCurrentDataTransferIndex]() { return PrefetchMinibatch(localCurrentDataTransferIndex); });
+        double efficiency = (double)numSamples / numColumns;
+        m_paddingStatistics.m_numMinibatches++;
+        m_paddingStatistics.m_numSamples += numSamples;
+        m_paddingStatistics.m_numColumns += numColumns;
+        m_paddingStatistics.m_minEfficiency = std::min(m_paddingStatistics.m_minEfficiency, efficiency);
+        if (m_traceLevel > 1)
+            fprintf(stderr, "Reader minibatch %d: %d samples in %d layout columns, padding efficiency %.1f%%.\n",
+                (int)m_paddingStatistics.m_numMinibatches, (int)numSamples, (int)numColumns, 100.0 * efficiency);
     }
 
-    // Let's wait till the previous memcopy has finished.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    if (m_endOfEpoch)
+        PrintPaddingStatistics();
+
+    // The slot now holds the matrices the network just released; they may still be used by compute in flight.
+    // Record an event that prefetch can wait on to ensure that prior compute has finished,
+    // and give the slot back to the prefetch thread.
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->RecordComputeStreamSyncPoint();
+
+    {
+        std::lock_guard<std::mutex> lock(m_prefetchMutex);
+        m_freeSlots.push_back(slotIndex);
+    }
+    m_prefetchCondition.notify_all();
 
     return result.m_isDataAvailable;
 }
 
 template <class ElemType>
-typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(size_t currentDataTransferIndex)
+typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(PrefetchSlot& slot)
 {
     // Resetting layouts.
-    for (auto& mx : m_prefetchBuffers)
+    for (auto& mx : slot.m_buffers)
         mx.second.m_mbLayout = std::make_shared<MBLayout>();
 
+    size_t samplePosition = m_reader->GetCurrentSamplePosition();
     Minibatch minibatch = m_reader->ReadMinibatch();
 
     // If there is no data we can simply return.
@@ -360,22 +580,33 @@ typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMini
     // But before we need to make sure that corresponding compute has already finished from the last iteration.
 
     // We need to make sure that the compute for the current transfer is finished before we start prefetch.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->WaitForSyncPointOnAssignStreamAsync();
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->WaitForSyncPointOnAssignStreamAsync();
 
-    for (auto& mx : m_prefetchBuffers)
+    for (auto& mx : slot.m_buffers)
     {
         size_t streamId = m_nameToStreamId[mx.first];
         const auto& stream = minibatch.m_data[streamId];
         mx.second.m_mbLayout = stream->m_layout;
 
         size_t sampleSize = m_streams[streamId]->m_sampleLayout->GetNumElements();
-        FillMatrixFromStream(m_streams[streamId]->m_storageType, mx.second.m_matrix.get(), sampleSize, stream, m_dataTransferers[currentDataTransferIndex].get());
+        const auto& augmentation = m_streams[streamId]->m_deviceAugmentation;
+        if (augmentation)
+        {
+            // The random values depend on the position of the minibatch and the worker, not on the prefetch order.
+            uint64_t seed = ((uint64_t)m_workerRank << 32) | augmentation->m_seed;
+            mx.second.m_seed = ImageAugmentationHash(seed ^ ImageAugmentationHash(samplePosition));
+            FillAugmentationWorkspaceFromStream(*augmentation, mx.second, sampleSize, stream, slot.m_dataTransferer.get());
+        }
+        else if (m_streams[streamId]->m_deviceWidening)
+            FillWideningWorkspaceFromStream(m_streams[streamId]->m_elementType, mx.second, sampleSize, stream, slot.m_dataTransferer.get());
+        else
+            FillMatrixFromStream(m_streams[streamId]->m_storageType, mx.second.m_matrix.get(), sampleSize, stream, slot.m_dataTransferer.get());
     }
 
     // Let's record that we started the copy, so that the main thread can wait afterwards.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->RecordCPUToGPUCopy();
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->RecordCPUToGPUCopy();
 
     return PrefetchResult{ minibatch.m_endOfEpoch, true };
 }
@@ -395,6 +626,8 @@ template <class ElemType>
     {
         // In the sparse case the m_data layout is identical to CUDA's CSC layout
         // (see http://docs.nvidia.com/cuda/cusparse/#compressed-sparse-column-format-csc).
+        // The values, rows and columns are back to back (in page-locked memory when reading for a GPU), which is how
+        // the GPU matrix stores them, hence they are copied in a single transfer.
         size_t* data = reinterpret_cast<size_t*>(stream->m_data);
         size_t nnzCount = *data;
         ElemType* values = reinterpret_cast<ElemType*>(data + 1);
@@ -406,6 +639,44 @@ template <class ElemType>
         RuntimeError("Storage type %d is not supported.", (int)type);
 }
 
+template <class ElemType>
+/*static*/ void ReaderShim<ElemType>::FillAugmentationWorkspaceFromStream(const DeviceImageAugmentation& augmentation, StreamPrefetchBuffer& buffer,
+                                                                          size_t numRows, const StreamMinibatchPtr& stream, DataTransferer* transferer)
+{
+    const auto& parameters = augmentation.m_parameters;
+    if (parameters.GetImageSize() != numRows)
+        LogicError("Device augmentation expects images of %d values, the stream has samples of %d values.", (int)parameters.GetImageSize(), (int)numRows);
+
+    buffer.m_numColumns = stream->m_layout->GetNumCols();
+    auto layout = GetImageAugmentationWorkspaceLayout(parameters, buffer.m_numColumns);
+    buffer.m_workspace->Resize((layout.m_size + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+
+    size_t meanSize = layout.m_imagesOffset - layout.m_meanOffset;
+    if (meanSize > 0)
+        CopyToMatrix(*buffer.m_workspace, layout.m_meanOffset, augmentation.m_mean.data(), meanSize, transferer);
+    CopyToMatrix(*buffer.m_workspace, layout.m_imagesOffset, stream->m_data, layout.m_size - layout.m_imagesOffset, transferer);
+}
+
+template <class ElemType>
+/*static*/ void ReaderShim<ElemType>::FillWideningWorkspaceFromStream(ElementType type, StreamPrefetchBuffer& buffer, size_t numRows,
+                                                                      const StreamMinibatchPtr& stream, DataTransferer* transferer)
+{
+    buffer.m_numColumns = stream->m_layout->GetNumCols();
+    size_t size = numRows * buffer.m_numColumns * GetSizeByType(type);
+    buffer.m_workspace->Resize((size + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+    CopyToMatrix(*buffer.m_workspace, 0, stream->m_data, size, transferer);
+}
+
+template <class ElemType>
+/*static*/ void ReaderShim<ElemType>::CopyToMatrix(Matrix<ElemType>& matrix, size_t offset, const void* data, size_t size, DataTransferer* transferer)
+{
+    char* destination = reinterpret_cast<char*>(matrix.Data()) + offset;
+    if (transferer)
+        transferer->CopyCPUToGPUAsync(data, size, 1, destination);
+    else
+        memcpy(destination, data, size);
+}
+
 template <class ElemType>
 bool ReaderShim<ElemType>::DataEnd() { return false; } // Note: Return value never used.
 
@@ -11,8 +11,12 @@
 #include <unordered_map>
 #include <string>
 #include <future>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 #include "DataReader.h"
 #include "Reader.h"
+#include "ReaderThreadPool.h"
 
 namespace CNTK
 {
@@ -49,7 +53,12 @@ public:
         // More info can be found here http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2013/n3679.html.
         if (m_prefetchTask.valid())
         {
-            // If there are some, give them time to finish.
+            // If there are some, ask the prefetch loop to stop and give it time to finish.
+            {
+                std::lock_guard<std::mutex> lock(m_prefetchMutex);
+                m_stopPrefetch = true;
+            }
+            m_prefetchCondition.notify_all();
             m_prefetchTask.wait_for(std::chrono::seconds(5));
         }
 
@@ -93,6 +102,17 @@ public:
 
     void SetCurrentSamplePosition(size_t currentSamplePosition);
 
+    // The state of the reader at the position of the network, minibatches prefetched ahead are not included.
+    virtual std::string GetReaderState() override;
+
+    virtual bool SetReaderState(const std::string& state) override;
+
+    // The profile includes the minibatches prefetched ahead of the network.
+    virtual bool GetProfile(ReaderProfile& profile) override
+    {
+        return m_reader->GetProfile(profile);
+    }
+
     void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions);
 
     bool IsEndOfEpoch() const
@@ -100,6 +120,55 @@ public:
         return m_endOfEpoch;
     }
 
+    // True if GetMinibatch would not have to wait for the prefetch thread.
+    bool IsMinibatchReady()
+    {
+        if (!m_prefetch || m_endOfEpoch)
+            return true;
+
+        std::lock_guard<std::mutex> lock(m_prefetchMutex);
+        return !m_readySlots.empty() || m_prefetchDone;
+    }
+
+    // Statistics of the prefetch queue since the start of the current epoch.
+    struct PrefetchStatistics
+    {
+        size_t m_numMinibatches;     // minibatches handed to the network
+        size_t m_totalQueueDepth;    // sum over minibatches of the number of minibatches ready when it was requested
+        size_t m_numWaits;           // number of times the network had to wait for the reader
+        double m_readerWaitSeconds;  // total time the network waited for the reader
+
+        double AverageQueueDepth() const
+        {
+            return m_numMinibatches == 0 ? 0.0 : (double)m_totalQueueDepth / m_numMinibatches;
+        }
+    };
+
+    const PrefetchStatistics& GetPrefetchStatistics() const
+    {
+        return m_prefetchStatistics;
+    }
+
+    // Padding of the minibatch layouts since the start of the current epoch, the efficiency
+    // is the fraction of the layout columns that contain samples and not gaps.
+    struct PaddingStatistics
+    {
+        size_t m_numMinibatches;
+        size_t m_numSamples;      // samples in all layouts
+        size_t m_numColumns;      // columns (samples and gaps) of all layouts
+        double m_minEfficiency;   // of a single minibatch
+
+        double Efficiency() const
+        {
+            return m_numColumns == 0 ? 1.0 : (double)m_numSamples / m_numColumns;
+        }
+    };
+
+    const PaddingStatistics& GetPaddingStatistics() const
+    {
+        return m_paddingStatistics;
+    }
+
 private:
     struct PrefetchResult
     {
@@ -107,9 +176,49 @@ private:
         bool m_isDataAvailable;
     };
 
-    PrefetchResult PrefetchMinibatch(size_t currentDataTransferIndex);
+    // Data structure required for prefetch.
+    struct StreamPrefetchBuffer
+    {
+        std::shared_ptr<Matrix<ElemType>> m_matrix;
+        MBLayoutPtr m_mbLayout;
+
+        // For streams augmented or widened on the device: narrow data copied by the prefetch thread,
+        // expanded into m_matrix by the main thread before the matrices are swapped.
+        std::shared_ptr<Matrix<ElemType>> m_workspace;
+        size_t m_numColumns;
+        uint64_t m_seed;
+    };
+
+    // A minibatch slot of the prefetch queue. The prefetch thread reads a minibatch into
+    // the buffers of a free slot; when the main thread enters GetMinibatch it swaps the matrices
+    // of the oldest ready slot with the network's and returns the slot to the free list.
+    // Each slot has its own data transferer, so the copies of different slots are tracked by different events.
+    struct PrefetchSlot
+    {
+        std::unordered_map<std::wstring, StreamPrefetchBuffer> m_buffers;
+        DataTransfererPtr m_dataTransferer;
+        PrefetchResult m_result;
+        size_t m_samplePosition; // position of the reader after this minibatch has been read
+    };
+
+    PrefetchResult PrefetchMinibatch(PrefetchSlot& slot);
+
+    // Body of the prefetch thread: fills free slots until the end of the epoch or until stopped.
+    void PrefetchLoop();
 
-    std::future<PrefetchResult> m_prefetchTask;
+    // Stops the prefetch thread, waits for outstanding copies and discards all prefetched minibatches.
+    void StopPrefetch();
+
+    // Starts prefetching from the current position of the reader.
+    void StartPrefetch();
+
+    // Wait for the next prefetched minibatch, returns false if there is none.
+    bool WaitForReadySlot(size_t& slotIndex);
+
+    void PrintPrefetchStatistics() const;
+    void PrintPaddingStatistics() const;
+
+    std::future<void> m_prefetchTask;
     ReaderPtr m_reader;
     ReaderFactory m_factory;
     bool m_endOfEpoch;
@@ -118,28 +227,33 @@ private:
 
     std::unordered_map<std::wstring, size_t> m_nameToStreamId;
     std::vector<StreamDescriptionPtr> m_streams;
-    launch m_launchType;
 
-    // Data structure required for prefetch.
-    struct StreamPrefetchBuffer
-    {
-        std::shared_ptr<Matrix<ElemType>> m_matrix;
-        MBLayoutPtr m_mbLayout;
-    };
+    // If false, minibatches are read synchronously in GetMinibatch.
+    bool m_prefetch;
+
+    // Number of minibatches that can be prefetched ahead of the network (config 'prefetchDepth').
+    // Slow chunk loads can be absorbed by the queue if this is larger than 1.
+    size_t m_prefetchDepth;
 
-    // Intermediate buffer where the prefetch thread puts its data to.
-    // When the main thread enters GetMinibatch it swaps the matrices from this buffer,
-    // triggers the next prefetch and waits if memCpy is still in progress.
-    std::unordered_map<std::wstring, StreamPrefetchBuffer> m_prefetchBuffers;
+    int m_traceLevel;
 
-    // Alternating data transfer operations. In the current version these are only two - 
-    // currently waiting on the main thread and the one that can be started by the prefetch thread 
-    // in the meantime.
-    std::vector<DataTransfererPtr> m_dataTransferers;
+    // With ThreadAffinity::Device (config 'threadAffinity'), the prefetch and chunk loading threads, and their buffers,
+    // are bound to the NUMA node nearest to the GPU the minibatches are copied to.
+    ThreadAffinity m_threadAffinity;
 
-    // Current data transfer. Flips 0 and 1.
-    // Can be changed only from the main thread with no ongoing prefetch.
-    size_t m_currentDataTransferIndex; 
+    // Prefetch queue, m_prefetchSlots.size() == m_prefetchDepth.
+    // Free and ready lists are protected by m_prefetchMutex.
+    std::vector<PrefetchSlot> m_prefetchSlots;
+    std::deque<size_t> m_freeSlots;
+    std::deque<size_t> m_readySlots;
+    std::mutex m_prefetchMutex;
+    std::condition_variable m_prefetchCondition;
+    bool m_stopPrefetch;
+    bool m_prefetchDone;
+    std::exception_ptr m_prefetchException;
+
+    PrefetchStatistics m_prefetchStatistics;
+    PaddingStatistics m_paddingStatistics;
 
     // Device id.
     int m_deviceId;
@@ -149,12 +263,34 @@ private:
     // The value is updated only from the main thread (in StartEpoch/GetMinibatch)
     size_t m_currentSamplePosition;
 
+    // Rank of this worker in the current epoch, part of the seed of device augmentation.
+    size_t m_workerRank;
+
     static void FillMatrixFromStream(
         StorageType type,
         Matrix<ElemType>* matrix,
         size_t numRows,
         const StreamMinibatchPtr& stream,
         DataTransferer* transferer);
+
+    // Copies the uint8 images of the stream (and the mean of the augmentation) into the workspace of the buffer.
+    static void FillAugmentationWorkspaceFromStream(
+        const DeviceImageAugmentation& augmentation,
+        StreamPrefetchBuffer& buffer,
+        size_t numRows,
+        const StreamMinibatchPtr& stream,
+        DataTransferer* transferer);
+
+    // Copies the narrow values of the stream into the workspace of the buffer.
+    static void FillWideningWorkspaceFromStream(
+        ElementType type,
+        StreamPrefetchBuffer& buffer,
+        size_t numRows,
+        const StreamMinibatchPtr& stream,
+        DataTransferer* transferer);
+
+    // Copies host memory into the (CPU or GPU) matrix, starting at the given byte offset.
+    static void CopyToMatrix(Matrix<ElemType>& matrix, size_t offset, const void* data, size_t size, DataTransferer* transferer);
 };
 
 }}}
@@ -0,0 +1,158 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "ReaderThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include "ExceptionCapture.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static std::atomic<int> s_readerNumaNode(-1);
+
+void SetReaderNumaNode(int node)
+{
+    s_readerNumaNode = node;
+}
+
+int GetReaderNumaNode()
+{
+    return s_readerNumaNode;
+}
+
+// Set while a scope has bound the thread, so that nested scopes (i.e. deferred chunk loads run by the prefetch thread)
+// neither rebind nor unbind it.
+static thread_local bool t_boundToReaderNumaNode = false;
+
+ReaderNumaNodeScope::ReaderNumaNodeScope()
+    : m_bound(false)
+{
+    if (!t_boundToReaderNumaNode)
+        m_bound = t_boundToReaderNumaNode = SetCurrentThreadAffinity(GetThreadCpus(ThreadAffinity::Device, 0, 1, GetReaderNumaNode()));
+}
+
+ReaderNumaNodeScope::~ReaderNumaNodeScope()
+{
+    if (m_bound)
+    {
+        SetCurrentThreadAffinity(GetThreadCpus(ThreadAffinity::None, 0, 1));
+        t_boundToReaderNumaNode = false;
+    }
+}
+
+ReaderThreadPool::ReaderThreadPool(size_t numThreads, ThreadAffinity affinity)
+    : m_jobGeneration(0), m_busyWorkers(0), m_stop(false)
+{
+    if (numThreads == 0)
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // The calling thread takes part in every loop as well.
+    for (size_t i = 0; i + 1 < numThreads; ++i)
+        m_workers.push_back(std::thread([this, i, affinity]() { WorkerLoop(i, affinity); }));
+}
+
+ReaderThreadPool::~ReaderThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+// Pins a worker; with ThreadAffinity::Device it follows the reader NUMA node, which is only known once an epoch starts.
+void ReaderThreadPool::ApplyAffinity(size_t workerIndex, ThreadAffinity affinity, int& boundNode)
+{
+    if (affinity == ThreadAffinity::None)
+        return;
+
+    int node = affinity == ThreadAffinity::Device ? GetReaderNumaNode() : -1;
+    if (boundNode == node)
+        return;
+
+    boundNode = node;
+    if (affinity == ThreadAffinity::Device && node < 0)
+        SetCurrentThreadAffinity(GetThreadCpus(ThreadAffinity::None, 0, 1));
+    else // the calling thread of a loop is thread 0
+        SetCurrentThreadAffinity(GetThreadCpus(affinity, workerIndex + 1, GetNumThreads(), node));
+}
+
+void ReaderThreadPool::WorkerLoop(size_t workerIndex, ThreadAffinity affinity)
+{
+    int boundNode = -2; // not bound yet
+    size_t lastGeneration = 0;
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [this, lastGeneration]() { return m_stop || m_jobGeneration != lastGeneration; });
+            if (m_stop)
+                return;
+
+            lastGeneration = m_jobGeneration;
+            job = m_job;
+        }
+
+        ApplyAffinity(workerIndex, affinity, boundNode);
+        job();
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (--m_busyWorkers == 0)
+                m_done.notify_one();
+        }
+    }
+}
+
+void ReaderThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& f)
+{
+    if (count == 0)
+        return;
+
+    ExceptionCapture capture;
+    if (count == 1 || m_workers.empty())
+    {
+        for (size_t i = 0; i < count; ++i)
+            capture.SafeRun(std::cref(f), i);
+        capture.RethrowIfHappened();
+        return;
+    }
+
+    std::unique_lock<std::mutex> call(m_callMutex);
+
+    // Indices are handed out one by one, so that faster threads pick up more of them.
+    std::atomic<size_t> next(0);
+    auto job = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+            capture.SafeRun(std::cref(f), i);
+    };
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_job = job;
+        m_busyWorkers = m_workers.size();
+        m_jobGeneration++;
+    }
+    m_wakeUp.notify_all();
+
+    job();
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_busyWorkers == 0; });
+        m_job = nullptr;
+    }
+
+    capture.RethrowIfHappened();
+}
+
+}}}
@@ -0,0 +1,84 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Basics.h"
+#include "ThreadAffinity.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// NUMA node the threads of the reader pipeline run on with threadAffinity = "device", -1 for none.
+// Set by the ReaderShim once it knows the GPU the minibatches go to; readers do not support several GPUs per process.
+void SetReaderNumaNode(int node);
+int GetReaderNumaNode();
+
+// Binds the calling thread to the reader NUMA node (if any) for the lifetime of the scope and unbinds it afterwards,
+// for the prefetch and chunk loading threads, which may come from a pool shared with other work.
+class ReaderNumaNodeScope
+{
+public:
+    ReaderNumaNodeScope();
+    ~ReaderNumaNodeScope();
+
+private:
+    bool m_bound;
+    DISABLE_COPY_AND_MOVE(ReaderNumaNodeScope);
+};
+
+// A pool of worker threads owned by a reader, used for CPU intensive deserialization
+// and transformation of sequences (i.e. decoding of images).
+// Unlike OpenMP parallel loops, the pool does not depend on the process-wide OpenMP settings,
+// so its threads do not compete for the same team with the OpenMP threads of the math library.
+class ReaderThreadPool
+{
+public:
+    // numThreads includes the calling thread, that also takes part in parallel loops.
+    // 0 means the number of hardware threads.
+    ReaderThreadPool(size_t numThreads, ThreadAffinity affinity = ThreadAffinity::None);
+    ~ReaderThreadPool();
+
+    // Calls f(0) .. f(count - 1) on the pool threads, the order is not defined.
+    // Returns when all calls have finished, rethrowing the first exception thrown by any of them.
+    // Calls from different threads are serialized.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& f);
+
+    // Number of threads taking part in a parallel loop.
+    size_t GetNumThreads() const
+    {
+        return m_workers.size() + 1;
+    }
+
+private:
+    void WorkerLoop(size_t workerIndex, ThreadAffinity affinity);
+    void ApplyAffinity(size_t workerIndex, ThreadAffinity affinity, int& boundNode);
+
+    std::vector<std::thread> m_workers;
+
+    // Serializes ParallelFor calls.
+    std::mutex m_callMutex;
+
+    // Protects the state below.
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_done;
+    std::function<void()> m_job;
+    size_t m_jobGeneration;
+    size_t m_busyWorkers;
+    bool m_stop;
+
+    DISABLE_COPY_AND_MOVE(ReaderThreadPool);
+};
+
+typedef std::shared_ptr<ReaderThreadPool> ReaderThreadPoolPtr;
+
+}}}
@@ -0,0 +1,129 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Contains the arena that holds the payloads of the sequences of a minibatch.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Basics.h"
+#include "ConcStack.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A bump allocator for the sequence payloads that transformers produce for one minibatch.
+// Allocations are never freed one by one: the whole arena is reset in one step once nothing refers to it any more,
+// i.e. after the packer has copied the minibatch and released the sequences (see SequenceArenaPool).
+// Allocate() may be called concurrently, since sequences are transformed in parallel.
+class SequenceArena
+{
+public:
+    explicit SequenceArena(size_t blockSize = 1 << 20) : m_blockSize(blockSize)
+    {
+    }
+
+    // Returns 'size' bytes aligned to 'alignment', a power of two.
+    void* Allocate(size_t size, size_t alignment = 64)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_blocks.empty())
+        {
+            auto result = m_blocks.back().Allocate(size, alignment);
+            if (result)
+                return result;
+        }
+
+        // Doubling the blocks, so that the number of blocks stays logarithmic in the size of the minibatch.
+        size_t blockSize = m_blocks.empty() ? m_blockSize : 2 * m_blocks.back().m_size;
+        m_blocks.emplace_back(std::max(blockSize, size + alignment));
+        return m_blocks.back().Allocate(size, alignment);
+    }
+
+    template <class TElemType>
+    TElemType* Allocate(size_t numberOfElements)
+    {
+        return static_cast<TElemType*>(Allocate(numberOfElements * sizeof(TElemType)));
+    }
+
+    // Frees all allocations at once. Must not be called while the memory is in use.
+    // If the minibatch needed several blocks, they are replaced by a single one that holds them all,
+    // so that the following minibatches of the same size are served from one block.
+    void Reset()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_blocks.size() > 1)
+        {
+            size_t capacity = 0;
+            for (const auto& b : m_blocks)
+                capacity += b.m_size;
+            m_blocks.clear();
+            m_blocks.emplace_back(capacity);
+        }
+        else if (!m_blocks.empty())
+        {
+            m_blocks.front().m_used = 0;
+        }
+    }
+
+private:
+    struct Block
+    {
+        explicit Block(size_t size) : m_data(new char[size]), m_size(size), m_used(0)
+        {
+        }
+
+        void* Allocate(size_t size, size_t alignment)
+        {
+            auto start = reinterpret_cast<uintptr_t>(m_data.get());
+            size_t offset = ((start + m_used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - start;
+            if (offset + size > m_size)
+                return nullptr;
+            m_used = offset + size;
+            return m_data.get() + offset;
+        }
+
+        std::unique_ptr<char[]> m_data;
+        size_t m_size;
+        size_t m_used;
+    };
+
+    size_t m_blockSize;
+    std::vector<Block> m_blocks;
+    std::mutex m_lock;
+
+    DISABLE_COPY_AND_MOVE(SequenceArena);
+};
+
+typedef std::shared_ptr<SequenceArena> SequenceArenaPtr;
+
+// A pool of arenas, one per minibatch in flight. An arena goes back to the pool, reset,
+// when the last sequence that lives in it is released.
+class SequenceArenaPool : public std::enable_shared_from_this<SequenceArenaPool>
+{
+public:
+    SequenceArenaPtr Get()
+    {
+        auto arena = m_arenas.pop_or_create([]() { return std::unique_ptr<SequenceArena>(new SequenceArena()); });
+
+        // The arenas in use keep the pool alive.
+        auto pool = shared_from_this();
+        return SequenceArenaPtr(arena.release(), [pool](SequenceArena* a)
+        {
+            a->Reset();
+            pool->m_arenas.push(std::unique_ptr<SequenceArena>(a));
+        });
+    }
+
+private:
+    conc_stack<std::unique_ptr<SequenceArena>> m_arenas;
+};
+
+typedef std::shared_ptr<SequenceArenaPool> SequenceArenaPoolPtr;
+
+}}}
@@ -9,6 +9,7 @@
 
 #include "DataDeserializer.h"
 #include "ConcStack.h"
+#include "SequenceArena.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -61,4 +62,48 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         DISABLE_COPY_AND_MOVE(DenseSequenceWithBuffer);
     };
 
+    // The class represents a sequence whose data buffer lives in the arena of the minibatch,
+    // which the sequence keeps alive. The buffer is reclaimed together with the whole arena.
+    template<class TElemType>
+    struct DenseSequenceInArena : DenseSequenceData
+    {
+        DenseSequenceInArena(const SequenceArenaPtr& arena, size_t numberOfElements)
+            : m_arena(arena), m_buffer(arena->Allocate<TElemType>(numberOfElements))
+        {
+        }
+
+        const void* GetDataBuffer() override
+        {
+            return m_buffer;
+        }
+
+        TElemType* GetBuffer()
+        {
+            return m_buffer;
+        }
+
+    private:
+        SequenceArenaPtr m_arena;
+        TElemType* m_buffer;
+        DISABLE_COPY_AND_MOVE(DenseSequenceInArena);
+    };
+
+    // Creates a dense sequence of the given number of elements, in the arena if there is one,
+    // otherwise with a buffer from the stack. 'buffer' receives the data buffer of the sequence.
+    template<class TElemType>
+    inline std::shared_ptr<DenseSequenceData> CreateDenseSequence(const SequenceArenaPtr& arena, conc_stack<std::vector<TElemType>>& memBuffers,
+                                                                  size_t numberOfElements, TElemType*& buffer)
+    {
+        if (arena)
+        {
+            auto result = std::make_shared<DenseSequenceInArena<TElemType>>(arena, numberOfElements);
+            buffer = result->GetBuffer();
+            return result;
+        }
+
+        auto result = std::make_shared<DenseSequenceWithBuffer<TElemType>>(memBuffers, numberOfElements);
+        buffer = result->GetBuffer();
+        return result;
+    }
+
 } } }
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <functional>
 #include <vector>
 #include "DataDeserializer.h"
 
@@ -27,6 +28,9 @@ struct Sequences
 class SequenceEnumerator;
 typedef std::shared_ptr<SequenceEnumerator> SequenceEnumeratorPtr;
 
+// Transformation of a single sequence, given its data for all streams.
+typedef std::function<void(std::vector<SequenceDataPtr>& sequence)> SequenceTransformation;
+
 // Sequence enumerator is internal interface used by the packer to get a set of new sequences.
 // It is implemented either by different randomizers or by TransformController that can wrap the randomizer
 // and apply different transforms on top of data.
@@ -54,6 +58,33 @@ public:
     // Returns current position in the global timeline. The returned value is in samples.
     virtual size_t GetCurrentSamplePosition() = 0;
 
+    // Asks the enumerator to apply the transformation to each sequence right after it has been deserialized,
+    // on the same thread. Returns false if this is not supported (or would not be done in parallel),
+    // then the caller applies the transformation to the returned sequences itself.
+    virtual bool SetSequenceTransformation(const SequenceTransformation&)
+    {
+        return false;
+    }
+
+    // Appends the durations in seconds of the chunk loads since the last call, for the reader profile.
+    // Enumerators that do not load chunks themselves leave it as it is.
+    virtual void TakeChunkLoadSeconds(std::vector<double>& /*seconds*/)
+    {
+    }
+
+    // Returns the exact state of the enumerator at the current position, or an empty string if not supported.
+    // Restoring it with SetState makes positioning close to that position cheap, without replaying the input up to it.
+    virtual std::string GetState()
+    {
+        return std::string();
+    }
+
+    // Restores a state returned by GetState, returns false if not supported.
+    virtual bool SetState(const std::string&)
+    {
+        return false;
+    }
+
     virtual ~SequenceEnumerator()
     {
     }
@@ -16,26 +16,37 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 MBLayoutPtr SequencePacker::CreateMBLayout(const StreamBatch& batch)
 {
-    vector<MBLayout::SequenceInfo> infos;
+    // The vectors are members so that their storage is reused between minibatches.
+    m_sequenceInfos.resize(batch.size());
     for (size_t index = 0; index < batch.size(); ++index)
     {
-        MBLayout::SequenceInfo info;
+        MBLayout::SequenceInfo& info = m_sequenceInfos[index];
 
         info.seqId = index;
         info.tBegin = 0;
         info.tEnd = batch[index]->m_numberOfSamples;
-        infos.push_back(info);
     }
 
-    vector<pair<size_t, size_t>> placement;
-    vector<size_t> rowAllocations;
-
     // Creating the minibatch layout.
     MBLayoutPtr pMBLayout = make_shared<MBLayout>();
-    pMBLayout->InitAsPackedSequences(infos, placement, rowAllocations);
+    pMBLayout->InitAsPackedSequences(m_sequenceInfos, m_placement, m_rowAllocations);
     return pMBLayout;
 }
 
+// Returns true if the sequences of both streams have the same number of samples, then they share the layout.
+static bool HaveSameSequenceLengths(const vector<SequenceDataPtr>& a, const vector<SequenceDataPtr>& b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i]->m_numberOfSamples != b[i]->m_numberOfSamples)
+            return false;
+    }
+    return true;
+}
+
 Minibatch SequencePacker::ReadMinibatch()
 {
     auto sequences = GetNextSequences();
@@ -51,6 +62,10 @@ Minibatch SequencePacker::ReadMinibatch()
 
     assert(m_outputStreamDescriptions.size() == batch.size());
 
+    // The layout is only computed once for all streams that have sequences of the same lengths
+    // (i.e. features and labels of a classification task).
+    MBLayoutPtr pMBLayout;
+    size_t layoutStreamIndex = 0;
     for (int streamIndex = 0; streamIndex < batch.size(); ++streamIndex)
     {
         const auto& streamBatch = batch[streamIndex];
@@ -60,9 +75,17 @@ Minibatch SequencePacker::ReadMinibatch()
             CheckSampleShape(streamBatch, m_outputStreamDescriptions[streamIndex]);
         }
 
+        if (!pMBLayout || !HaveSameSequenceLengths(batch[layoutStreamIndex], streamBatch))
+        {
+            pMBLayout = CreateMBLayout(streamBatch);
+            layoutStreamIndex = streamIndex;
+        }
+
         const auto& type = m_outputStreamDescriptions[streamIndex]->m_storageType;
-        auto pMBLayout = (type == StorageType::dense) ?
-            PackDenseStream(streamBatch, streamIndex) : PackSparseStream(streamBatch, streamIndex);
+        if (type == StorageType::dense)
+            PackDenseStream(streamBatch, streamIndex, pMBLayout);
+        else
+            PackSparseStream(streamBatch, streamIndex, pMBLayout);
 
         auto& buffer = currentBuffer[streamIndex];
 
@@ -105,80 +128,107 @@ void SequencePacker::CheckSampleShape(const std::vector<SequenceDataPtr>& miniba
     }
 }
 
-MBLayoutPtr SequencePacker::PackDenseStream(const StreamBatch& batch, size_t streamIndex)
+void SequencePacker::ForEachSequenceRange(const MBLayoutPtr& pMBLayout, size_t sizeInBytes, const std::function<void(size_t, size_t)>& f)
+{
+    // Below this size the synchronization with the pool threads costs more than the copy.
+    const size_t minParallelSizeInBytes = 256 * 1024;
+
+    size_t numSequences = pMBLayout->GetAllSequences().size();
+    if (!m_threadPool || m_threadPool->GetNumThreads() == 1 || numSequences < 2 || sizeInBytes < minParallelSizeInBytes)
+    {
+        f(0, numSequences);
+        return;
+    }
+
+    // A few ranges per thread, so that threads that got shorter sequences take over more of them.
+    size_t numRanges = min(numSequences, m_threadPool->GetNumThreads() * 4);
+    m_threadPool->ParallelFor(numRanges, [&](size_t range)
+    {
+        f(range * numSequences / numRanges, (range + 1) * numSequences / numRanges);
+    });
+}
+
+void SequencePacker::PackDenseStream(const StreamBatch& batch, size_t streamIndex, const MBLayoutPtr& pMBLayout)
 {
     assert(m_outputStreamDescriptions[streamIndex]->m_storageType == StorageType::dense);
     const auto& stream = m_inputStreamDescriptions[streamIndex];
     auto& buffer = m_streamBuffers[m_currentBufferIndex][streamIndex];
     size_t sampleSize = GetSampleSize(m_outputStreamDescriptions[streamIndex]);
-    auto pMBLayout = CreateMBLayout(batch);
     size_t requiredSize = pMBLayout->GetNumCols() * sampleSize;
     if (buffer.m_size < requiredSize)
     {
         buffer.Resize(requiredSize);
     }
 
+    if (stream->m_storageType != StorageType::dense && stream->m_storageType != StorageType::sparse_csc)
+    {
+        RuntimeError("Storage type %d is not supported.", (int)stream->m_storageType);
+    }
+
     auto elementSize = GetSizeByType(stream->m_elementType);
 
     const auto& sequenceInfos = pMBLayout->GetAllSequences();
+    // Samples of a sequence are in consecutive time steps, so their columns are the number
+    // of parallel sequences apart; with a single parallel sequence the whole sequence is contiguous.
+    size_t columnStride = pMBLayout->GetNumParallelSequences();
+    char* bufferPtr = buffer.m_data.get();
 
     // Iterate over sequences in the layout, copy samples from the
     // source sequences into the buffer (at appropriate offsets).
-    for (int i = 0; i < sequenceInfos.size(); ++i)
+    ForEachSequenceRange(pMBLayout, requiredSize, [&](size_t begin, size_t end)
     {
-        const auto& sequenceInfo = sequenceInfos[i];
-        // skip gaps
-        if (sequenceInfo.seqId == GAP_SEQUENCE_ID)
+        for (size_t i = begin; i < end; ++i)
         {
-            continue;
-        }
+            const auto& sequenceInfo = sequenceInfos[i];
+            // skip gaps
+            if (sequenceInfo.seqId == GAP_SEQUENCE_ID)
+            {
+                continue;
+            }
+
+            const auto& sequence = batch[sequenceInfo.seqId];
+            size_t numSamples = sequence->m_numberOfSamples;
+            assert(numSamples == sequenceInfo.GetNumTimeSteps());
+            if (numSamples == 0)
+            {
+                continue;
+            }
 
-        const auto& sequence = batch[sequenceInfo.seqId];
-        size_t numSamples = sequence->m_numberOfSamples;
-        assert(numSamples == sequenceInfo.GetNumTimeSteps());
+            // Compute the offset into the destination buffer, using the layout information
+            // to get the column index corresponding to the first sample.
+            size_t firstColumn = pMBLayout->GetColumnIndex(sequenceInfo, 0);
+            // verify that there's enough space left in the buffer to fit all samples.
+            assert((firstColumn + (numSamples - 1) * columnStride + 1) * sampleSize <= buffer.m_size);
 
-        char* bufferPtr = buffer.m_data.get();
-        // Iterate over all samples in the sequence, keep track of the sample offset (which is especially
-        // important for sparse input, where offset == number of preceding nnz elements).
-        for (size_t sampleIndex = 0, sampleOffset = 0; sampleIndex < numSamples; ++sampleIndex)
-        {
-            // Compute the offset into the destination buffer, using the layout information 
-            // to get the column index corresponding to the given sample.
-            auto destinationOffset = pMBLayout->GetColumnIndex(sequenceInfo, sampleIndex) * sampleSize;
-            // verify that there's enough space left in the buffer to fit a full sample.
-            assert(destinationOffset <= buffer.m_size - sampleSize);
-            auto* destination = bufferPtr + destinationOffset;
             if (stream->m_storageType == StorageType::dense)
             {
-                // verify that the offset (an invariant for dense).
-                assert(sampleOffset == sampleIndex * sampleSize);
-                PackDenseSample(destination, sequence, sampleOffset, sampleSize);
-                sampleOffset += sampleSize;
+                auto denseSequence = static_cast<DenseSequenceData*>(sequence.get());
+                denseSequence->CopySamples(0, numSamples, sampleSize, bufferPtr + firstColumn * sampleSize, columnStride * sampleSize);
             }
-            else if (stream->m_storageType == StorageType::sparse_csc)
+            else
             {
                 // TODO: make type casts members of the SparseSequenceData
                 SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
                 // make sure that the sequence meta-data is correct.
                 assert(numSamples == sparseSequence->m_nnzCounts.size());
-                PackSparseSampleAsDense(destination, sparseSequence, sampleIndex, sampleOffset, sampleSize, elementSize);
-                // move the offset by nnz count of the sample.
-                sampleOffset += sparseSequence->m_nnzCounts[sampleIndex];
-                // verify that the offset is within the bounds (less or equal 
-                // to the total nnz count of the sequence).
-                assert(sampleOffset <= sparseSequence->m_totalNnzCount);
-            }
-            else
-            {
-                RuntimeError("Storage type %d is not supported.", (int)stream->m_storageType);
+
+                // Keep track of the sample offset, for sparse input offset == number of preceding nnz elements.
+                for (size_t sampleIndex = 0, sampleOffset = 0; sampleIndex < numSamples; ++sampleIndex)
+                {
+                    auto* destination = bufferPtr + (firstColumn + sampleIndex * columnStride) * sampleSize;
+                    PackSparseSampleAsDense(destination, sparseSequence, sampleIndex, sampleOffset, sampleSize, elementSize);
+                    // move the offset by nnz count of the sample.
+                    sampleOffset += sparseSequence->m_nnzCounts[sampleIndex];
+                    // verify that the offset is within the bounds (less or equal
+                    // to the total nnz count of the sequence).
+                    assert(sampleOffset <= sparseSequence->m_totalNnzCount);
+                }
             }
         }
-    }
-
-    return pMBLayout;
+    });
 }
 
-MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t streamIndex)
+void SequencePacker::PackSparseStream(const StreamBatch& batch, size_t streamIndex, const MBLayoutPtr& pMBLayout)
 {
     assert(m_outputStreamDescriptions[streamIndex]->m_storageType == StorageType::sparse_csc);
 
@@ -200,7 +250,7 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     assert(stream->m_storageType == StorageType::sparse_csc);
     auto elementSize = GetSizeByType(stream->m_elementType);
     auto indexSize = sizeof(IndexType);
-    auto pMBLayout = CreateMBLayout(batch);
+    size_t numColumns = pMBLayout->GetNumCols();
 
     // Compute the required buffer size:
     // size of nnz type + nnz * (size of the element type) + nnz * (size of the row index type) + 
@@ -208,7 +258,7 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     size_t requiredSize =
         sizeof(nnzCount) +
         nnzCount * (elementSize + indexSize) +
-        indexSize * (pMBLayout->GetNumCols() + 1);
+        indexSize * (numColumns + 1);
 
     auto& buffer = m_streamBuffers[m_currentBufferIndex][streamIndex];
     if (buffer.m_size < requiredSize)
@@ -224,92 +274,75 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     // one for data portion and anther -- for indices.
     auto* dataDst = destination + sizeof(nnzCount);
     auto* indicesDst = dataDst + elementSize* nnzCount;
-    // column index for the current sample (= number of nnz value packed so far).
-    IndexType columnOffset = 0;
-    // a vector to store column index for each sample in the resulting (packed) matrix.
-    vector<IndexType> sparseColumnIndices;
-    // a vector to keep track of the offsets into each input sequence,
-    // there an offset is the number of nnz values packed so far. Current sample
-    // values/indices start of the offset position in the sequence data/index array
-    vector<IndexType>  sequenceOffsets(batch.size(), 0); 
-
-    vector<MBLayout::SequenceInfo> sequenceInfos(pMBLayout->GetAllSequences());
-
-    // sort the vector in ascending order of the parallel sequence index.
-    sort(sequenceInfos.begin(), sequenceInfos.end(),
-        [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b){ return a.s < b.s; });
-
-    // Iterate over the all time steps in the layout (total number of samples/columns 
-    // in a parallel sequence), traversing the layout in horizontal direction.
-    for (auto timeStep = 0; timeStep < pMBLayout->GetNumTimeSteps(); ++timeStep)
+
+    const auto& sequenceInfos = pMBLayout->GetAllSequences();
+    size_t columnStride = pMBLayout->GetNumParallelSequences();
+
+    // First pass: the nnz count of each column (columns of gaps stay empty), turned into
+    // the column offsets (= number of nnz values in preceding columns) by a prefix sum.
+    // Then the values and indices of each sample can be copied independently to the offset of its column.
+    m_sparseColumnIndices.assign(numColumns + 1, 0);
+    for (const auto& sequenceInfo : sequenceInfos)
     {
-        // For each time step, iterate over all sequences in the minibatch,
-        // traversing the layout in vertical direction.
-        for (const auto& sequenceInfo : sequenceInfos)
+        if (sequenceInfo.seqId == GAP_SEQUENCE_ID || sequenceInfo.GetNumTimeSteps() == 0)
         {
-            // skip the sequence if it does not intersect with the time step
-            if (timeStep < sequenceInfo.tBegin || timeStep >= sequenceInfo.tEnd)
-            {
-                continue;
-            }
+            continue;
+        }
+
+        SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(batch[sequenceInfo.seqId]);
+        size_t firstColumn = pMBLayout->GetColumnIndex(sequenceInfo, 0);
+        for (size_t sampleIndex = 0; sampleIndex < sparseSequence->m_nnzCounts.size(); ++sampleIndex)
+        {
+            m_sparseColumnIndices[firstColumn + sampleIndex * columnStride + 1] = sparseSequence->m_nnzCounts[sampleIndex];
+        }
+    }
+
+    for (size_t column = 0; column < numColumns; ++column)
+    {
+        m_sparseColumnIndices[column + 1] += m_sparseColumnIndices[column];
+    }
 
-            // store the offset of the current column )...
-            sparseColumnIndices.push_back(columnOffset);
+    // after the prefix sum the last column offset must be equal to the total nnz count.
+    assert(m_sparseColumnIndices[numColumns] == nnzCount);
 
-            auto seqId = sequenceInfo.seqId;
-            if (seqId == GAP_SEQUENCE_ID)
+    // Second pass: copy all nnz values and their indices of each sample into the buffer.
+    ForEachSequenceRange(pMBLayout, nnzCount * (elementSize + indexSize), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const auto& sequenceInfo = sequenceInfos[i];
+            if (sequenceInfo.seqId == GAP_SEQUENCE_ID || sequenceInfo.GetNumTimeSteps() == 0)
             {
                 continue;
             }
 
-            // compute the index of the sample inside the sequence.
-            size_t sampleIndex = timeStep - sequenceInfo.tBegin;
-            const auto& sequence = batch[seqId];
-            
-            // make sure the index less than the sequence length in samples.
-            assert(sampleIndex < sequence->m_numberOfSamples);
-
-            auto& sequenceOffset = sequenceOffsets[seqId];
+            const auto& sequence = batch[sequenceInfo.seqId];
             SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
-            IndexType nnz = sparseSequence->m_nnzCounts[sampleIndex];
-
-            // compute the sample offset in bytes.
-            size_t sampleOffset = sequenceOffset * elementSize;
-            // copy all nzz values from source sequence into the buffer.
-            const auto* dataSrc = reinterpret_cast<const char*>(sequence->GetDataBuffer()) + sampleOffset;
-            memcpy(dataDst, dataSrc, nnz * elementSize);
-            dataDst += nnz * elementSize; // advance the destination pointer
-
-            // copy all nzz value indices from source sequence into the buffer.
-            const auto* indicesSrc = sparseSequence->m_indices + sequenceOffset;
-            memcpy(indicesDst, indicesSrc, nnz * indexSize);
-            indicesDst += nnz * indexSize; // advance the destination pointer
-
-            sequenceOffset += nnz;
-            columnOffset += nnz;
-        }
-    }
+            const char* dataSrc = reinterpret_cast<const char*>(sequence->GetDataBuffer());
+            size_t firstColumn = pMBLayout->GetColumnIndex(sequenceInfo, 0);
+
+            // the offset into the source sequence, the number of nnz values packed so far.
+            size_t sequenceOffset = 0;
+            for (size_t sampleIndex = 0; sampleIndex < sparseSequence->m_nnzCounts.size(); ++sampleIndex)
+            {
+                IndexType nnz = sparseSequence->m_nnzCounts[sampleIndex];
+                size_t columnOffset = m_sparseColumnIndices[firstColumn + sampleIndex * columnStride];
 
-    // at this point each element in sequenceOffsets should be equal to the total
-    // nnz count of the respective sequence and the sum of all elements - to the 
-    // overall nnz count.
-    assert(accumulate(sequenceOffsets.begin(), sequenceOffsets.end(), 0) == nnzCount);
+                memcpy(dataDst + columnOffset * elementSize, dataSrc + sequenceOffset * elementSize, nnz * elementSize);
+                memcpy(indicesDst + columnOffset * indexSize, sparseSequence->m_indices + sequenceOffset, nnz * indexSize);
+                sequenceOffset += nnz;
+            }
 
-    // check the distance between data and index destination pointers.
-    assert(indicesDst == dataDst + nnzCount * indexSize);
-    // after we packed all samples, the column offset must be equal to the total nnz count.
-    assert(columnOffset == nnzCount);
-    sparseColumnIndices.push_back(columnOffset);
-    // check that the number of column indices == N + 1 (where N is the number of
-    // column in the packed matrix)
-    assert((pMBLayout->GetNumCols() + 1) == sparseColumnIndices.size());
+            // at this point the offset should be equal to the total nnz count of the sequence.
+            assert(sequenceOffset == sparseSequence->m_totalNnzCount);
+        }
+    });
 
+    auto* columnIndicesDst = indicesDst + nnzCount * indexSize;
     // verify that there's enough space in the buffer for the array of column indices.
-    assert(indicesDst + sparseColumnIndices.size()*indexSize <= destination + requiredSize);
+    assert(columnIndicesDst + m_sparseColumnIndices.size() * indexSize <= destination + requiredSize);
     // copy column indices into the buffer.
-    memcpy(indicesDst, sparseColumnIndices.data(), sparseColumnIndices.size() * indexSize);
-
-    return pMBLayout;
+    memcpy(columnIndicesDst, m_sparseColumnIndices.data(), m_sparseColumnIndices.size() * indexSize);
 }
 
 }}}
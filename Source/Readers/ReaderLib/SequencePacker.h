@@ -6,6 +6,7 @@
 #pragma once
 
 #include "PackerBase.h"
+#include "ReaderThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -17,16 +18,20 @@ public:
     SequencePacker(
         SequenceEnumeratorPtr sequenceEnumerator,
         const std::vector<StreamDescriptionPtr>& streams,
-        size_t numberOfBuffers = 2) :
-        PackerBase(sequenceEnumerator, streams, numberOfBuffers)
+        size_t numberOfBuffers = 2,
+        ReaderThreadPoolPtr threadPool = nullptr) :
+        PackerBase(sequenceEnumerator, streams, numberOfBuffers),
+        m_threadPool(threadPool)
     {}
 
     virtual Minibatch ReadMinibatch() override;
 
 protected:
-    virtual MBLayoutPtr PackDenseStream(const StreamBatch& batch, size_t streamIndex);
+    // Both functions copy the sequences of the stream into the buffer at the positions given by the layout.
+    // With a thread pool, large minibatches are copied by several threads, each taking a range of sequences.
+    virtual void PackDenseStream(const StreamBatch& batch, size_t streamIndex, const MBLayoutPtr& pMBLayout);
 
-    virtual MBLayoutPtr PackSparseStream(const StreamBatch& batch, size_t streamIndex);
+    virtual void PackSparseStream(const StreamBatch& batch, size_t streamIndex, const MBLayoutPtr& pMBLayout);
 
     // Given a number of sequences, creates an MB layout that is used to guide
     // the actual packing.
@@ -34,6 +39,20 @@ protected:
 
     // Helper function to check the sample shape of input samples.
     void CheckSampleShape(const std::vector<SequenceDataPtr>& minibatch, StreamDescriptionPtr outputStream);
+
+    // Calls f(begin, end) for ranges of the sequences of the layout, in parallel if there is a thread pool
+    // and the minibatch is large enough (sizeInBytes of data to copy) to pay off.
+    void ForEachSequenceRange(const MBLayoutPtr& pMBLayout, size_t sizeInBytes, const std::function<void(size_t, size_t)>& f);
+
+    ReaderThreadPoolPtr m_threadPool;
+
+    // Storage reused between minibatches for creating the layout.
+    std::vector<MBLayout::SequenceInfo> m_sequenceInfos;
+    std::vector<std::pair<size_t, size_t>> m_placement;
+    std::vector<size_t> m_rowAllocations;
+
+    // Column offsets of the packed sparse matrix, reused between minibatches.
+    std::vector<IndexType> m_sparseColumnIndices;
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
@@ -18,8 +18,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     SequenceRandomizer::SequenceRandomizer(
         int verbosity,
         IDataDeserializerPtr deserializer,
-        ChunkRandomizerPtr chunkRandomizer)
+        ChunkRandomizerPtr chunkRandomizer,
+        size_t bucketSizeInSamples)
         : m_verbosity(verbosity),
+        m_bucketSizeInSamples(bucketSizeInSamples),
         m_randomizedChunks(chunkRandomizer->GetRandomizedChunks()),
         m_chunkWindowBegin(0),
         m_randomizedWindowEnd(0),
@@ -241,6 +243,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // Let's recalculate number of samples in the randomized chunks for efficient indexing in seek.
         size_t sampleCount = 0;
         size_t randomizedChunk = m_randomizedWindowEnd - m_chunkWindowBegin;
+
+        // The sequences of the chunk are at their final chunk now, they can be reordered inside of it.
+        if (m_bucketSizeInSamples > 0)
+        {
+            BucketSequences(m_sequenceWindow[randomizedChunk]);
+        }
+
         for (size_t index = 0; index < m_sequenceWindow[randomizedChunk].size(); index++)
         {
             sampleCount += m_sequenceWindow[randomizedChunk][index].m_numberOfSamples;
@@ -268,6 +277,46 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 m_randomizationCursor);
     }
 
+    // Sorts the sequences by length (stable, so that sequences of the same length keep their random order),
+    // cuts them into buckets of at least m_bucketSizeInSamples samples and shuffles the buckets,
+    // so that the minibatches still see sequences of all lengths in random order.
+    // Only the random number generator of the sweep is used, so the order is the same after a seek.
+    void SequenceRandomizer::BucketSequences(std::vector<RandomizedSequenceDescription>& sequences)
+    {
+        std::stable_sort(sequences.begin(), sequences.end(),
+            [](const RandomizedSequenceDescription& a, const RandomizedSequenceDescription& b) { return a.m_numberOfSamples < b.m_numberOfSamples; });
+
+        // Buckets as [begin, end) ranges of sequences.
+        std::vector<std::pair<size_t, size_t>> buckets;
+        size_t bucketBegin = 0;
+        size_t bucketSamples = 0;
+        for (size_t i = 0; i < sequences.size(); ++i)
+        {
+            bucketSamples += sequences[i].m_numberOfSamples;
+            if (bucketSamples >= m_bucketSizeInSamples || i + 1 == sequences.size())
+            {
+                buckets.push_back(std::make_pair(bucketBegin, i + 1));
+                bucketBegin = i + 1;
+                bucketSamples = 0;
+            }
+        }
+
+        if (buckets.size() < 2)
+        {
+            return;
+        }
+
+        RandomShuffleMT(buckets, m_rng);
+
+        std::vector<RandomizedSequenceDescription> bucketed;
+        bucketed.reserve(sequences.size());
+        for (const auto& bucket : buckets)
+        {
+            bucketed.insert(bucketed.end(), sequences.begin() + bucket.first, sequences.begin() + bucket.second);
+        }
+        sequences.swap(bucketed);
+    }
+
     // Sets current cursor to the given sample offset.
     // If offset is in the middle of the sequence, the next sequence is picked up.
     // If there is no sequence, an offset outside the sweep is returned.
@@ -327,7 +376,21 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 m_currentSampleCursor,
                 sweepSampleOffset);
 
-        // TODO perhaps optimize this
+        // Whole chunks before the offset are skipped using their sample counts, the chunks after them are still
+        // randomized in order, so the result is the same as advancing sequence by sequence.
+        while (m_currentChunkCursor < m_randomizedChunks.size() &&
+               m_currentSequenceCursor == m_randomizedChunks[m_currentChunkCursor].m_sequencePositionStart)
+        {
+            const auto& info = m_randomizedChunkInfo[m_currentChunkCursor - m_chunkWindowBegin];
+            if (m_currentSampleCursor + info.numberOfSamples > sweepSampleOffset)
+                break;
+
+            m_currentSampleCursor += info.numberOfSamples;
+            m_currentSequenceCursor = m_randomizedChunks[m_currentChunkCursor].SequenceEndPosition();
+            MoveChunkCursor();
+        }
+
+        // Advance sequence by sequence inside of the chunk that contains the offset.
         ClosedOpenChunkInterval window;
         while (m_currentSampleCursor < sweepSampleOffset)
         {
@@ -337,6 +400,78 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         return m_currentSampleCursor;
     }
 
+    void SequenceRandomizer::SaveState(std::ostream& stream) const
+    {
+        stream << m_chunkWindowBegin << ' ' << m_chunkWindowEnd << ' '
+               << m_randomizedWindowEnd << ' ' << m_randomizationCursor << ' '
+               << m_currentChunkCursor << ' ' << m_currentSequenceCursor << ' ' << m_currentSampleCursor << ' ';
+
+        stream << m_randomizedChunkInfo.size() << ' ';
+        for (const auto& info : m_randomizedChunkInfo)
+            stream << info.start << ' ' << info.numberOfSamples << ' ';
+
+        // Sequences refer to their randomized chunk by index.
+        stream << m_sequenceWindow.size() << ' ';
+        for (const auto& sequences : m_sequenceWindow)
+        {
+            stream << sequences.size() << ' ';
+            for (const auto& sequence : sequences)
+                stream << sequence.m_id << ' ' << sequence.m_chunk->m_chunkId << ' ' << sequence.m_numberOfSamples << ' ';
+        }
+
+        stream << m_rng << ' ';
+    }
+
+    void SequenceRandomizer::RestoreState(std::istream& stream)
+    {
+        size_t chunkWindowEnd;
+        stream >> m_chunkWindowBegin >> chunkWindowEnd
+               >> m_randomizedWindowEnd >> m_randomizationCursor
+               >> m_currentChunkCursor >> m_currentSequenceCursor >> m_currentSampleCursor;
+        m_chunkWindowEnd = (ChunkIdType)chunkWindowEnd;
+
+        size_t numChunkInfos = 0;
+        stream >> numChunkInfos;
+        m_randomizedChunkInfo.resize(numChunkInfos);
+        for (auto& info : m_randomizedChunkInfo)
+            stream >> info.start >> info.numberOfSamples;
+
+        size_t numWindowChunks = 0;
+        stream >> numWindowChunks;
+        if (!stream || m_chunkWindowEnd > m_randomizedChunks.size() || numWindowChunks != m_chunkWindowEnd - m_chunkWindowBegin)
+            RuntimeError("SequenceRandomizer::RestoreState: the state does not match the randomized chunks.");
+
+        m_sequenceWindow.resize(numWindowChunks);
+        for (auto& sequences : m_sequenceWindow)
+        {
+            size_t numSequences = 0;
+            stream >> numSequences;
+            sequences.resize(numSequences);
+            for (auto& sequence : sequences)
+            {
+                size_t chunkIndex;
+                stream >> sequence.m_id >> chunkIndex >> sequence.m_numberOfSamples;
+                if (chunkIndex >= m_randomizedChunks.size())
+                    RuntimeError("SequenceRandomizer::RestoreState: invalid chunk index %" PRIu64 ".", chunkIndex);
+                sequence.m_chunk = &m_randomizedChunks[chunkIndex];
+            }
+        }
+
+        stream >> m_rng;
+        if (!stream)
+            RuntimeError("SequenceRandomizer::RestoreState: the state is truncated.");
+
+        if (m_verbosity)
+            fprintf(stderr,
+                "SequenceRandomizer::RestoreState(): "
+                "chunk window [%" PRIu64 "..%u), cursor %" PRIu64 ", "
+                "randomized window [%" PRIu64 "..%" PRIu64 "), randomization cursor %" PRIu64 "\n",
+                m_chunkWindowBegin, m_chunkWindowEnd,
+                m_currentChunkCursor,
+                m_chunkWindowBegin, m_randomizedWindowEnd,
+                m_randomizationCursor);
+    }
+
     // Checks if the randomized sequence is valid for a target chunk.
     bool SequenceRandomizer::IsValidForPosition(ChunkIdType chunkIndex, const RandomizedSequenceDescription& seqDesc) const
     {
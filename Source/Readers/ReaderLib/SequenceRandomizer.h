@@ -35,7 +35,8 @@ public:
     SequenceRandomizer(
         int verbosity,
         IDataDeserializerPtr deserializer,
-        ChunkRandomizerPtr chunkRandomizer);
+        ChunkRandomizerPtr chunkRandomizer,
+        size_t bucketSizeInSamples = 0);
 
     // Resets the current sweep according to the randomization seed provided.
     void Reset(size_t seed);
@@ -48,6 +49,13 @@ public:
     // Gets the next randomized sequence descriptions not exceeding the sample count.
     std::vector<RandomizedSequenceDescription> GetNextSequenceDescriptions(size_t sampleCount, ClosedOpenChunkInterval& requiredChunks);
 
+    // Writes the rolling window, the cursors and the random number generator, so that the randomizer can be restored
+    // in the same sweep without randomizing the preceding chunks again.
+    void SaveState(std::ostream& stream) const;
+
+    // Restores the state written by SaveState. The chunks have to be randomized for the same sweep.
+    void RestoreState(std::istream& stream);
+
 private:
     DISABLE_COPY_AND_MOVE(SequenceRandomizer);
 
@@ -72,6 +80,9 @@ private:
     // Release chunks from the chunk window that are not needed anymore.
     void ReleaseChunks();
 
+    // Groups the randomized sequences of a chunk into buckets of similar length and shuffles the buckets.
+    void BucketSequences(std::vector<RandomizedSequenceDescription>& sequences);
+
     IDataDeserializerPtr m_deserializer;
 
     // Used only as a buffer to get sequence descriptions without memory reallocation.
@@ -152,6 +163,11 @@ private:
     // General configuration
     int m_verbosity;
 
+    // If not 0, sequences of a randomized chunk are grouped into buckets of about this many samples
+    // each containing sequences of similar length, so that consecutive sequences (and therefore
+    // the sequences of a minibatch) need less padding.
+    size_t m_bucketSizeInSamples;
+
     std::mt19937_64 m_rng;
 };
 
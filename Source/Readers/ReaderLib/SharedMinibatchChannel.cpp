@@ -0,0 +1,659 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#endif
+#include "SharedMinibatchChannel.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <cwctype>
+#include <thread>
+#include "ElementTypeUtils.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The shared reader channel requires lock-free 64 bit atomics, which work across processes.");
+
+// A named region of shared memory, created by one process and opened by others.
+class SharedMemorySegment
+{
+public:
+    // Creates the segment, fails if it exists.
+    SharedMemorySegment(const wstring& name, size_t size) : m_name(name), m_data(nullptr), m_size(size), m_isOwner(true)
+    {
+#ifdef _WIN32
+        m_handle = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, GetSystemName().c_str());
+        if (m_handle != NULL && GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            CloseHandle(m_handle);
+            RuntimeError("A shared reader service named '%ls' is already running on this host.", name.c_str());
+        }
+        if (m_handle == NULL)
+            RuntimeError("Cannot create the shared memory of the shared reader service '%ls', error %x.", name.c_str(), GetLastError());
+        Map();
+#else
+        m_fileDescriptor = shm_open(GetSystemName().c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (m_fileDescriptor == -1)
+        {
+            if (errno == EEXIST)
+                RuntimeError("A shared reader service named '%ls' is already running on this host (or a previous one crashed, then remove /dev/shm%s).",
+                             name.c_str(), GetSystemName().c_str());
+            RuntimeError("Cannot create the shared memory of the shared reader service '%ls': %s.", name.c_str(), strerror(errno));
+        }
+        if (ftruncate(m_fileDescriptor, (off_t)size) == -1)
+        {
+            int error = errno;
+            close(m_fileDescriptor);
+            shm_unlink(GetSystemName().c_str());
+            RuntimeError("Cannot allocate %d MB of shared memory for the shared reader service '%ls': %s.", (int)(size >> 20), name.c_str(), strerror(error));
+        }
+        Map();
+#endif
+    }
+
+    // Opens the segment created by another process, returns nullptr if it does not exist (yet).
+    static unique_ptr<SharedMemorySegment> TryOpen(const wstring& name)
+    {
+        unique_ptr<SharedMemorySegment> segment(new SharedMemorySegment(name));
+#ifdef _WIN32
+        segment->m_handle = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, segment->GetSystemName().c_str());
+        if (segment->m_handle == NULL)
+            return nullptr;
+        segment->Map();
+        MEMORY_BASIC_INFORMATION info;
+        if (VirtualQuery(segment->m_data, &info, sizeof(info)) == 0)
+            RuntimeError("Cannot query the shared memory of the shared reader service '%ls', error %x.", name.c_str(), GetLastError());
+        segment->m_size = info.RegionSize;
+#else
+        segment->m_fileDescriptor = shm_open(segment->GetSystemName().c_str(), O_RDWR, 0600);
+        if (segment->m_fileDescriptor == -1)
+            return nullptr;
+        struct stat sb;
+        if (fstat(segment->m_fileDescriptor, &sb) == -1 || sb.st_size == 0)
+            return nullptr; // not sized by the creator yet
+        segment->m_size = (size_t)sb.st_size;
+        segment->Map();
+#endif
+        return segment;
+    }
+
+    ~SharedMemorySegment()
+    {
+#ifdef _WIN32
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_handle != NULL)
+            CloseHandle(m_handle);
+#else
+        if (m_data != nullptr)
+            munmap(m_data, m_size);
+        if (m_fileDescriptor != -1)
+            close(m_fileDescriptor);
+        if (m_isOwner)
+            shm_unlink(GetSystemName().c_str());
+#endif
+    }
+
+    char* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    explicit SharedMemorySegment(const wstring& name) : m_name(name), m_data(nullptr), m_size(0), m_isOwner(false)
+    {
+#ifdef _WIN32
+        m_handle = NULL;
+#else
+        m_fileDescriptor = -1;
+#endif
+    }
+
+#ifdef _WIN32
+    wstring GetSystemName() const
+    {
+        return L"Local\\cntk_reader_" + m_name;
+    }
+
+    void Map()
+    {
+        m_data = (char*)MapViewOfFile(m_handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        if (m_data == nullptr)
+            RuntimeError("Cannot map the shared memory of the shared reader service '%ls', error %x.", m_name.c_str(), GetLastError());
+    }
+#else
+    string GetSystemName() const
+    {
+        return "/cntk_reader_" + msra::strfun::utf8(m_name);
+    }
+
+    void Map()
+    {
+        void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fileDescriptor, 0);
+        if (data == MAP_FAILED)
+            RuntimeError("Cannot map the shared memory of the shared reader service '%ls': %s.", m_name.c_str(), strerror(errno));
+        m_data = (char*)data;
+    }
+#endif
+
+    wstring m_name;
+    char* m_data;
+    size_t m_size;
+    bool m_isOwner;
+
+#ifdef _WIN32
+    HANDLE m_handle;
+#else
+    int m_fileDescriptor;
+#endif
+
+    DISABLE_COPY_AND_MOVE(SharedMemorySegment);
+};
+
+// Layout of the segment: the header, the serialized stream descriptions, then the slots.
+// Each slot is the Slot structure followed by the ring. All sections are 64 byte aligned.
+static const uint64_t c_channelMagic = 0x4c4e4e4843424d53; // "SMBCHNNL"
+static const uint64_t c_channelVersion = 1;
+static const size_t c_alignment = 64;
+
+static size_t RoundUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+struct SharedMinibatchChannel::Header
+{
+    uint64_t m_magic;
+    uint64_t m_version;
+    uint64_t m_numSlots;
+    uint64_t m_ringSize;
+    uint64_t m_slotSize;
+    uint64_t m_slotsOffset;
+    uint64_t m_streamsSize;
+    std::atomic<uint64_t> m_ready;
+    std::atomic<uint64_t> m_shutdown;
+    std::atomic<uint64_t> m_serviceHeartbeat;
+};
+
+enum class SlotState : uint64_t
+{
+    free = 0,
+    attached,
+    detached, // by the consumer, until the service has cleaned up the slot
+};
+
+struct SharedMinibatchChannel::Slot
+{
+    std::atomic<uint64_t> m_state;
+    std::atomic<uint64_t> m_heartbeat;
+
+    // Command area: the consumer fills in the command and increments m_commandSequence,
+    // the service sets m_completedCommand to it once the command is done.
+    std::atomic<uint64_t> m_commandSequence;
+    std::atomic<uint64_t> m_completedCommand;
+    uint64_t m_commandType;
+    uint64_t m_consumerPosition;
+    uint64_t m_numberOfWorkers;
+    uint64_t m_workerRank;
+    uint64_t m_minibatchSizeInSamples;
+    uint64_t m_truncationSize;
+    uint64_t m_totalEpochSizeInSamples;
+    uint64_t m_epochIndex;
+    uint64_t m_samplePosition;
+    uint64_t m_result;
+
+    // Ring positions in bytes, written by the service and the consumer respectively.
+    alignas(64) std::atomic<uint64_t> m_writePosition;
+    alignas(64) std::atomic<uint64_t> m_readPosition;
+};
+
+// Stream descriptions are serialized as 64 bit values; names as wchar_t (both sides run on the same host).
+static void SerializeStreams(const vector<StreamDescriptionPtr>& streams, vector<uint64_t>& buffer)
+{
+    buffer.push_back(streams.size());
+    for (const auto& stream : streams)
+    {
+        if (stream->m_deviceAugmentation)
+            RuntimeError("The shared reader service does not support device augmentation (stream '%ls').", stream->m_name.c_str());
+        if (!stream->m_sampleLayout)
+            RuntimeError("The shared reader service requires a sample layout for stream '%ls'.", stream->m_name.c_str());
+
+        buffer.push_back(stream->m_name.size());
+        for (wchar_t c : stream->m_name)
+            buffer.push_back((uint64_t)c);
+        buffer.push_back(stream->m_id);
+        buffer.push_back((uint64_t)stream->m_storageType);
+        buffer.push_back((uint64_t)stream->m_elementType);
+        const auto& dims = stream->m_sampleLayout->GetDims();
+        buffer.push_back(dims.size());
+        for (size_t i = 0; i < dims.size(); i++)
+            buffer.push_back(dims[i]);
+        buffer.push_back(stream->m_deviceWidening ? 1 : 0);
+        if (stream->m_deviceWidening)
+        {
+            uint64_t scale = 0, shift = 0;
+            memcpy(&scale, &stream->m_deviceWidening->m_scale, sizeof(float));
+            memcpy(&shift, &stream->m_deviceWidening->m_shift, sizeof(float));
+            buffer.push_back(scale);
+            buffer.push_back(shift);
+        }
+    }
+}
+
+static vector<StreamDescriptionPtr> DeserializeStreams(const uint64_t* buffer)
+{
+    vector<StreamDescriptionPtr> streams(*buffer++);
+    for (auto& stream : streams)
+    {
+        stream = make_shared<StreamDescription>();
+        size_t nameLength = (size_t)*buffer++;
+        for (size_t i = 0; i < nameLength; i++)
+            stream->m_name.push_back((wchar_t)*buffer++);
+        stream->m_id = (StreamId)*buffer++;
+        stream->m_storageType = (StorageType)*buffer++;
+        stream->m_elementType = (ElementType)*buffer++;
+        SmallVector<size_t> dims((size_t)*buffer++);
+        for (size_t i = 0; i < dims.size(); i++)
+            dims[i] = (size_t)*buffer++;
+        stream->m_sampleLayout = make_shared<TensorShape>(dims);
+        if (*buffer++)
+        {
+            stream->m_deviceWidening = make_shared<DeviceStreamWidening>();
+            memcpy(&stream->m_deviceWidening->m_scale, buffer++, sizeof(float));
+            memcpy(&stream->m_deviceWidening->m_shift, buffer++, sizeof(float));
+        }
+    }
+    return streams;
+}
+
+// Waits a little, the channel polls while the other side is behind.
+static void Pause()
+{
+    this_thread::sleep_for(chrono::microseconds(100));
+}
+
+SharedMinibatchChannel::SharedMinibatchChannel(const wstring& name, size_t numSlots, size_t ringSize, const vector<StreamDescriptionPtr>& streams)
+    : m_streams(streams), m_readMessageSizes(numSlots, 0)
+{
+    if (numSlots == 0)
+        InvalidArgument("The shared reader service needs at least one slot.");
+    for (wchar_t c : name)
+        if (!iswalnum(c) && c != L'_' && c != L'-' && c != L'.')
+            InvalidArgument("Invalid name of the shared reader service '%ls', only letters, digits, '_', '-' and '.' are allowed.", name.c_str());
+
+    vector<uint64_t> serializedStreams;
+    SerializeStreams(streams, serializedStreams);
+    size_t streamsSize = serializedStreams.size() * sizeof(uint64_t);
+
+    ringSize = RoundUp(ringSize, c_alignment);
+    size_t slotsOffset = RoundUp(sizeof(Header), c_alignment) + RoundUp(streamsSize, c_alignment);
+    size_t slotSize = RoundUp(sizeof(Slot), c_alignment) + ringSize;
+    m_segment = make_unique<SharedMemorySegment>(name, slotsOffset + numSlots * slotSize);
+
+    // The segment is zero initialized, i.e. all slots are free and all positions are 0.
+    Header& header = GetHeader();
+    header.m_magic = c_channelMagic;
+    header.m_version = c_channelVersion;
+    header.m_numSlots = numSlots;
+    header.m_ringSize = ringSize;
+    header.m_slotSize = slotSize;
+    header.m_slotsOffset = slotsOffset;
+    header.m_streamsSize = streamsSize;
+    memcpy(m_segment->GetData() + RoundUp(sizeof(Header), c_alignment), serializedStreams.data(), streamsSize);
+    header.m_ready.store(1, memory_order_release);
+}
+
+SharedMinibatchChannel::SharedMinibatchChannel(unique_ptr<SharedMemorySegment>&& segment)
+    : m_segment(move(segment))
+{
+    const Header& header = GetHeader();
+    if (header.m_magic != c_channelMagic || header.m_version != c_channelVersion)
+        RuntimeError("The shared memory of the shared reader service has an unexpected format.");
+    m_streams = DeserializeStreams(reinterpret_cast<const uint64_t*>(m_segment->GetData() + RoundUp(sizeof(Header), c_alignment)));
+    m_readMessageSizes.resize(header.m_numSlots, 0);
+}
+
+/*static*/ unique_ptr<SharedMinibatchChannel> SharedMinibatchChannel::Open(const wstring& name, double timeoutSeconds)
+{
+    auto start = chrono::steady_clock::now();
+    for (;;)
+    {
+        auto segment = SharedMemorySegment::TryOpen(name);
+        if (segment && segment->GetSize() >= sizeof(Header))
+        {
+            const Header& header = *reinterpret_cast<const Header*>(segment->GetData());
+            if (header.m_ready.load(memory_order_acquire) && !header.m_shutdown.load())
+                return unique_ptr<SharedMinibatchChannel>(new SharedMinibatchChannel(move(segment)));
+        }
+
+        if (chrono::duration<double>(chrono::steady_clock::now() - start).count() > timeoutSeconds)
+            RuntimeError("The shared reader service '%ls' did not start within %.0f seconds.", name.c_str(), timeoutSeconds);
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+}
+
+SharedMinibatchChannel::~SharedMinibatchChannel()
+{
+}
+
+SharedMinibatchChannel::Header& SharedMinibatchChannel::GetHeader() const
+{
+    return *reinterpret_cast<Header*>(m_segment->GetData());
+}
+
+SharedMinibatchChannel::Slot& SharedMinibatchChannel::GetSlot(size_t slot) const
+{
+    const Header& header = GetHeader();
+    assert(slot < header.m_numSlots);
+    return *reinterpret_cast<Slot*>(m_segment->GetData() + header.m_slotsOffset + slot * header.m_slotSize);
+}
+
+char* SharedMinibatchChannel::GetRing(size_t slot) const
+{
+    return reinterpret_cast<char*>(&GetSlot(slot)) + RoundUp(sizeof(Slot), c_alignment);
+}
+
+size_t SharedMinibatchChannel::GetNumSlots() const
+{
+    return (size_t)GetHeader().m_numSlots;
+}
+
+void SharedMinibatchChannel::ServiceBeat()
+{
+    GetHeader().m_serviceHeartbeat++;
+}
+
+uint64_t SharedMinibatchChannel::GetServiceHeartbeat() const
+{
+    return GetHeader().m_serviceHeartbeat.load();
+}
+
+void SharedMinibatchChannel::SlotBeat(size_t slot)
+{
+    GetSlot(slot).m_heartbeat++;
+}
+
+uint64_t SharedMinibatchChannel::GetSlotHeartbeat(size_t slot) const
+{
+    return GetSlot(slot).m_heartbeat.load();
+}
+
+void SharedMinibatchChannel::Shutdown()
+{
+    GetHeader().m_shutdown.store(1);
+}
+
+bool SharedMinibatchChannel::IsShutdown() const
+{
+    return GetHeader().m_shutdown.load() != 0;
+}
+
+bool SharedMinibatchChannel::TryAttach(size_t& slot)
+{
+    for (size_t i = 0; i < GetNumSlots(); i++)
+    {
+        uint64_t expected = (uint64_t)SlotState::free;
+        if (GetSlot(i).m_state.compare_exchange_strong(expected, (uint64_t)SlotState::attached))
+        {
+            slot = i;
+            m_readMessageSizes[slot] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SharedMinibatchChannel::Detach(size_t slot)
+{
+    GetSlot(slot).m_state.store((uint64_t)SlotState::detached);
+}
+
+bool SharedMinibatchChannel::IsAttached(size_t slot) const
+{
+    return GetSlot(slot).m_state.load() == (uint64_t)SlotState::attached;
+}
+
+bool SharedMinibatchChannel::IsDetached(size_t slot) const
+{
+    return GetSlot(slot).m_state.load() == (uint64_t)SlotState::detached;
+}
+
+void SharedMinibatchChannel::ReleaseSlot(size_t slot)
+{
+    // Drops what the consumer has left behind, then the slot can be attached again.
+    Slot& s = GetSlot(slot);
+    s.m_writePosition.store(s.m_readPosition.load());
+    s.m_completedCommand.store(s.m_commandSequence.load());
+    s.m_state.store((uint64_t)SlotState::free);
+}
+
+size_t SharedMinibatchChannel::SendCommand(size_t slot, const Command& command, const function<bool()>& keepWaiting)
+{
+    Slot& s = GetSlot(slot);
+    s.m_commandType = (uint64_t)command.m_type;
+    s.m_consumerPosition = command.m_consumerPosition;
+    s.m_numberOfWorkers = command.m_config.m_numberOfWorkers;
+    s.m_workerRank = command.m_config.m_workerRank;
+    s.m_minibatchSizeInSamples = command.m_config.m_minibatchSizeInSamples;
+    s.m_truncationSize = command.m_config.m_truncationSize;
+    s.m_totalEpochSizeInSamples = command.m_config.m_totalEpochSizeInSamples;
+    s.m_epochIndex = command.m_config.m_epochIndex;
+    s.m_samplePosition = command.m_samplePosition;
+    uint64_t sequence = s.m_commandSequence.load() + 1;
+    s.m_commandSequence.store(sequence, memory_order_release);
+
+    while (s.m_completedCommand.load(memory_order_acquire) != sequence)
+    {
+        if (!keepWaiting())
+            RuntimeError("The shared reader service did not complete a command.");
+        Pause();
+    }
+
+    // The service has dropped all minibatches that were not read.
+    m_readMessageSizes[slot] = 0;
+    return (size_t)s.m_result;
+}
+
+bool SharedMinibatchChannel::TryTakeCommand(size_t slot, Command& command)
+{
+    Slot& s = GetSlot(slot);
+    uint64_t sequence = s.m_commandSequence.load(memory_order_acquire);
+    if (sequence == s.m_completedCommand.load())
+        return false;
+
+    command.m_type = (CommandType)s.m_commandType;
+    command.m_consumerPosition = (size_t)s.m_consumerPosition;
+    command.m_config.m_numberOfWorkers = (size_t)s.m_numberOfWorkers;
+    command.m_config.m_workerRank = (size_t)s.m_workerRank;
+    command.m_config.m_minibatchSizeInSamples = (size_t)s.m_minibatchSizeInSamples;
+    command.m_config.m_truncationSize = (size_t)s.m_truncationSize;
+    command.m_config.m_totalEpochSizeInSamples = (size_t)s.m_totalEpochSizeInSamples;
+    command.m_config.m_epochIndex = (size_t)s.m_epochIndex;
+    command.m_samplePosition = (size_t)s.m_samplePosition;
+
+    // The consumer waits for the command, i.e. does not read: the unread minibatches can be dropped.
+    s.m_writePosition.store(s.m_readPosition.load(memory_order_acquire), memory_order_release);
+    return true;
+}
+
+void SharedMinibatchChannel::CompleteCommand(size_t slot, size_t samplePosition)
+{
+    Slot& s = GetSlot(slot);
+    s.m_result = samplePosition;
+    s.m_completedCommand.store(s.m_commandSequence.load(memory_order_acquire), memory_order_release);
+}
+
+// Message layout (all values are 64 bit):
+//     size (0 for a wrap marker), sample position after the minibatch, end of epoch, number of streams, number of layouts,
+//     per layout: number of parallel sequences, number of time steps, number of sequences, and per sequence: id, s, begin, end,
+//     per stream: index of its layout, size of its data in bytes, the data padded to 8 bytes.
+size_t SharedMinibatchChannel::GetStreamDataSize(size_t streamIndex, const StreamMinibatch& stream) const
+{
+    const auto& description = m_streams[streamIndex];
+    size_t numCols = stream.m_layout->GetNumCols();
+    size_t elementSize = GetSizeByType(description->m_elementType);
+    if (description->m_storageType == StorageType::dense)
+        return description->m_sampleLayout->GetNumElements() * numCols * elementSize;
+
+    size_t nnzCount = *reinterpret_cast<const size_t*>(stream.m_data);
+    return sizeof(size_t) + nnzCount * (elementSize + sizeof(IndexType)) + (numCols + 1) * sizeof(IndexType);
+}
+
+bool SharedMinibatchChannel::WriteMinibatch(size_t slot, const Minibatch& minibatch, size_t samplePosition, const function<bool()>& keepWaiting)
+{
+    if (!minibatch.m_data.empty() && minibatch.m_data.size() != m_streams.size())
+        LogicError("SharedMinibatchChannel: The minibatch has %d streams, the channel %d.", (int)minibatch.m_data.size(), (int)m_streams.size());
+
+    // Streams usually share their layouts.
+    vector<const MBLayout*> layouts;
+    vector<size_t> layoutIndices, dataSizes;
+    size_t size = 5 * sizeof(uint64_t);
+    for (size_t i = 0; i < minibatch.m_data.size(); i++)
+    {
+        const MBLayout* layout = minibatch.m_data[i]->m_layout.get();
+        auto existing = find(layouts.begin(), layouts.end(), layout);
+        layoutIndices.push_back(existing - layouts.begin());
+        if (existing == layouts.end())
+        {
+            layouts.push_back(layout);
+            size += (3 + 4 * layout->GetAllSequences().size()) * sizeof(uint64_t);
+        }
+        dataSizes.push_back(GetStreamDataSize(i, *minibatch.m_data[i]));
+        size += 2 * sizeof(uint64_t) + RoundUp(dataSizes.back(), sizeof(uint64_t));
+    }
+
+    const Header& header = GetHeader();
+    size_t ringSize = (size_t)header.m_ringSize;
+    // With at most half of the ring per message, a message always fits once the consumer has caught up, wrapped or not.
+    if (size > ringSize / 2)
+        RuntimeError("A minibatch of %d bytes is too large for the ring of %d bytes of the shared reader service, please increase its ringSizeMB.",
+                     (int)size, (int)ringSize);
+
+    Slot& s = GetSlot(slot);
+    uint64_t writePosition = s.m_writePosition.load();
+    size_t offset = (size_t)(writePosition % ringSize);
+    size_t padding = offset + size > ringSize ? ringSize - offset : 0;
+    while (ringSize - (size_t)(writePosition - s.m_readPosition.load(memory_order_acquire)) < padding + size)
+    {
+        if (!keepWaiting() || s.m_commandSequence.load() != s.m_completedCommand.load() || !IsAttached(slot))
+            return false;
+        Pause();
+    }
+
+    char* ring = GetRing(slot);
+    if (padding > 0)
+    {
+        *reinterpret_cast<uint64_t*>(ring + offset) = 0;
+        writePosition += padding;
+        offset = 0;
+    }
+
+    uint64_t* values = reinterpret_cast<uint64_t*>(ring + offset);
+    *values++ = size;
+    *values++ = samplePosition;
+    *values++ = minibatch.m_endOfEpoch ? 1 : 0;
+    *values++ = minibatch.m_data.size();
+    *values++ = layouts.size();
+    for (const auto* layout : layouts)
+    {
+        const auto& sequences = layout->GetAllSequences();
+        *values++ = layout->GetNumParallelSequences();
+        *values++ = layout->GetNumTimeSteps();
+        *values++ = sequences.size();
+        for (const auto& sequence : sequences)
+        {
+            *values++ = sequence.seqId;
+            *values++ = sequence.s;
+            *values++ = (uint64_t)sequence.tBegin;
+            *values++ = sequence.tEnd;
+        }
+    }
+    for (size_t i = 0; i < minibatch.m_data.size(); i++)
+    {
+        *values++ = layoutIndices[i];
+        *values++ = dataSizes[i];
+        memcpy(values, minibatch.m_data[i]->m_data, dataSizes[i]);
+        values += RoundUp(dataSizes[i], sizeof(uint64_t)) / sizeof(uint64_t);
+    }
+
+    s.m_writePosition.store(writePosition + size, memory_order_release);
+    return true;
+}
+
+bool SharedMinibatchChannel::ReadMinibatch(size_t slot, MinibatchMessage& message, const function<bool()>& keepWaiting)
+{
+    assert(m_readMessageSizes[slot] == 0);
+
+    Slot& s = GetSlot(slot);
+    size_t ringSize = (size_t)GetHeader().m_ringSize;
+    char* ring = GetRing(slot);
+    for (;;)
+    {
+        uint64_t readPosition = s.m_readPosition.load();
+        if (readPosition == s.m_writePosition.load(memory_order_acquire))
+        {
+            if (!keepWaiting())
+                return false;
+            Pause();
+            continue;
+        }
+
+        size_t offset = (size_t)(readPosition % ringSize);
+        const uint64_t* values = reinterpret_cast<const uint64_t*>(ring + offset);
+        size_t size = (size_t)*values++;
+        if (size == 0) // wrap marker
+        {
+            s.m_readPosition.store(readPosition + ringSize - offset, memory_order_release);
+            continue;
+        }
+
+        message.m_samplePosition = (size_t)*values++;
+        message.m_endOfEpoch = *values++ != 0;
+        size_t numStreams = (size_t)*values++;
+        vector<MBLayoutPtr> layouts((size_t)*values++);
+        for (auto& layout : layouts)
+        {
+            layout = make_shared<MBLayout>();
+            size_t numParallelSequences = (size_t)*values++;
+            size_t numTimeSteps = (size_t)*values++;
+            size_t numSequences = (size_t)*values++;
+            layout->Init(numParallelSequences, numTimeSteps);
+            for (size_t i = 0; i < numSequences; i++, values += 4)
+                layout->AddSequence(MBLayout::SequenceInfo{ (UniqueSequenceId)values[0], (size_t)values[1], (ptrdiff_t)values[2], (size_t)values[3] });
+        }
+
+        message.m_streams.resize(numStreams);
+        for (auto& stream : message.m_streams)
+        {
+            stream.m_layout = layouts[(size_t)*values++];
+            stream.m_size = (size_t)*values++;
+            stream.m_data = values;
+            values += RoundUp(stream.m_size, sizeof(uint64_t)) / sizeof(uint64_t);
+        }
+
+        m_readMessageSizes[slot] = size;
+        return true;
+    }
+}
+
+void SharedMinibatchChannel::ReleaseMinibatch(size_t slot)
+{
+    Slot& s = GetSlot(slot);
+    s.m_readPosition.store(s.m_readPosition.load() + m_readMessageSizes[slot], memory_order_release);
+    m_readMessageSizes[slot] = 0;
+}
+
+}}}
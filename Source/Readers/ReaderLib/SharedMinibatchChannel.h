@@ -0,0 +1,173 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Basics.h"
+#include "Reader.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class SharedMemorySegment;
+
+// Tells whether the other side of a channel is alive, i.e. whether its heartbeat counter has changed within the timeout.
+class HeartbeatMonitor
+{
+public:
+    HeartbeatMonitor() : m_lastHeartbeat(0), m_lastChange(std::chrono::steady_clock::now())
+    {
+    }
+
+    void Reset(uint64_t heartbeat)
+    {
+        m_lastHeartbeat = heartbeat;
+        m_lastChange = std::chrono::steady_clock::now();
+    }
+
+    bool IsAlive(uint64_t heartbeat, double timeoutSeconds)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (heartbeat != m_lastHeartbeat)
+        {
+            m_lastHeartbeat = heartbeat;
+            m_lastChange = now;
+            return true;
+        }
+        return std::chrono::duration<double>(now - m_lastChange).count() <= timeoutSeconds;
+    }
+
+private:
+    uint64_t m_lastHeartbeat;
+    std::chrono::steady_clock::time_point m_lastChange;
+};
+
+// Named shared memory through which a reader service process of a host hands the minibatches of its reading
+// pipelines to the training processes (consumers) of that host, see SharedReaderService in CompositeDataReader.
+// The segment consists of a header with the stream descriptions and a fixed number of slots; a consumer
+// attaches to a free slot and owns it until it detaches. Each slot has
+//  - a command area, through which the consumer configures its pipeline (StartEpoch, SetConfiguration,
+//    SetCurrentSamplePosition) and waits for the service to complete the command,
+//  - a single producer/single consumer ring of serialized minibatches. Each message holds the layouts
+//    and the packed data of all streams, in the format of the packers (see ReaderShim::FillMatrixFromStream),
+//    so that the consumer only copies the data into its own (page-locked) buffers.
+// Positions in the ring grow monotonically; a message that does not fit before the end of the ring is preceded
+// by a wrap marker. All waits poll with short sleeps and are abandoned as soon as 'keepWaiting' returns false;
+// heartbeat counters of the service and the consumers let both sides notice when the other side is gone.
+class SharedMinibatchChannel
+{
+public:
+    enum class CommandType : uint64_t
+    {
+        none = 0,
+        startEpoch,
+        setConfiguration,
+        setCurrentSamplePosition,
+    };
+
+    // A command of a consumer, with the position up to which the consumer has read the minibatches.
+    struct Command
+    {
+        CommandType m_type;
+        size_t m_consumerPosition;
+        EpochConfiguration m_config;  // for startEpoch and setConfiguration
+        size_t m_samplePosition;      // for setCurrentSamplePosition
+    };
+
+    // A minibatch as it is read from the ring; the data points into the ring and is valid until ReleaseMinibatch.
+    struct StreamData
+    {
+        const void* m_data;
+        size_t m_size;
+        MBLayoutPtr m_layout;
+    };
+
+    struct MinibatchMessage
+    {
+        bool m_endOfEpoch;
+        size_t m_samplePosition; // position after the minibatch
+        std::vector<StreamData> m_streams;
+    };
+
+    // Creates the channel (service side). Fails if a channel with the same name exists.
+    SharedMinibatchChannel(const std::wstring& name, size_t numSlots, size_t ringSize, const std::vector<StreamDescriptionPtr>& streams);
+
+    // Opens the channel created by the service (consumer side), waiting up to timeoutSeconds for the service to create it.
+    static std::unique_ptr<SharedMinibatchChannel> Open(const std::wstring& name, double timeoutSeconds);
+
+    ~SharedMinibatchChannel();
+
+    const std::vector<StreamDescriptionPtr>& GetStreamDescriptions() const { return m_streams; }
+
+    size_t GetNumSlots() const;
+
+    // Liveness of the service, counters that change while the other side is alive.
+    void ServiceBeat();
+    uint64_t GetServiceHeartbeat() const;
+    void SlotBeat(size_t slot);
+    uint64_t GetSlotHeartbeat(size_t slot) const;
+
+    // Tells the consumers that the service has stopped.
+    void Shutdown();
+    bool IsShutdown() const;
+
+    // Consumer side.
+    // Claims a free slot, returns false if all slots are taken.
+    bool TryAttach(size_t& slot);
+    void Detach(size_t slot);
+
+    // Sends a command and waits until the service has completed it, returns the sample position of the pipeline after the command.
+    // Minibatches that were not read yet are dropped.
+    size_t SendCommand(size_t slot, const Command& command, const std::function<bool()>& keepWaiting);
+
+    // Waits for the next minibatch, returns false if waiting was abandoned.
+    bool ReadMinibatch(size_t slot, MinibatchMessage& message, const std::function<bool()>& keepWaiting);
+
+    // Frees the space of the minibatch returned by the last ReadMinibatch.
+    void ReleaseMinibatch(size_t slot);
+
+    // Service side.
+    bool IsAttached(size_t slot) const;
+    bool IsDetached(size_t slot) const;
+
+    // Frees a slot whose consumer has detached or is gone.
+    void ReleaseSlot(size_t slot);
+
+    // Takes a pending command of the consumer and drops the minibatches the consumer has not read yet.
+    bool TryTakeCommand(size_t slot, Command& command);
+    void CompleteCommand(size_t slot, size_t samplePosition);
+
+    // Writes a minibatch to the ring, waiting for space; returns false if waiting was abandoned or a command is pending.
+    bool WriteMinibatch(size_t slot, const Minibatch& minibatch, size_t samplePosition, const std::function<bool()>& keepWaiting);
+
+private:
+    struct Header;
+    struct Slot;
+
+    SharedMinibatchChannel(std::unique_ptr<SharedMemorySegment>&& segment);
+
+    Header& GetHeader() const;
+    Slot& GetSlot(size_t slot) const;
+    char* GetRing(size_t slot) const;
+
+    // Size in bytes of the packed data of a stream.
+    size_t GetStreamDataSize(size_t streamIndex, const StreamMinibatch& stream) const;
+
+    std::unique_ptr<SharedMemorySegment> m_segment;
+    std::vector<StreamDescriptionPtr> m_streams;
+
+    // Sizes of the messages returned by ReadMinibatch, per slot.
+    std::vector<size_t> m_readMessageSizes;
+
+    DISABLE_COPY_AND_MOVE(SharedMinibatchChannel);
+};
+
+}}}
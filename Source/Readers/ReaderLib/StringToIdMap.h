@@ -69,7 +69,7 @@ public:
     // Get string value by its integer id.
     const TString& operator[](size_t id) const
     {
-        if (id < m_indexedValues.size())
+        if (id >= m_indexedValues.size())
             RuntimeError("Unknown id requested");
         return *m_indexedValues[id];
     }
@@ -80,6 +80,12 @@ public:
         return m_values.find(value) != m_values.end();
     }
 
+    // Number of values in the registry.
+    size_t Size() const
+    {
+        return m_indexedValues.size();
+    }
+
 private:
     // TODO: Move NonCopyable as a separate class to Basics.h
     DISABLE_COPY_AND_MOVE(TStringToIdMap);
@@ -27,7 +27,7 @@ class TransformController : public SequenceEnumerator
 {
 public:
     TransformController(const std::vector<Transformation>& transformations, SequenceEnumeratorPtr sequenceProvider)
-        : m_sequenceProvider(sequenceProvider)
+        : m_sequenceProvider(sequenceProvider), m_arenas(std::make_shared<SequenceArenaPool>())
     {
         // Applying transformations to stream descriptions,
         // i.e. a transformation can change a stream from dense to sparse.
@@ -39,6 +39,11 @@ public:
             transformedStreams[streamId] = std::make_shared<StreamDescription>(t.m_transformer->Transform(*transformedStreams[streamId]));
         }
         m_outputStreams = transformedStreams;
+
+        // If the sequence provider deserializes sequences in parallel, each sequence is transformed by the thread
+        // that deserialized it as soon as it is ready, instead of waiting for all sequences to be deserialized.
+        m_transformedByProvider = m_sequenceProvider->SetSequenceTransformation(
+            [this](std::vector<SequenceDataPtr>& sequence) { Apply(sequence); });
     }
 
     // Returns current position in the global timeline. The returned value is in samples.
@@ -65,6 +70,16 @@ public:
         m_sequenceProvider->SetCurrentSamplePosition(currentSamplePosition);
     }
 
+    std::string GetState() override
+    {
+        return m_sequenceProvider->GetState();
+    }
+
+    bool SetState(const std::string& state) override
+    {
+        return m_sequenceProvider->SetState(state);
+    }
+
     // Description of streams that the transformer provides.
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
     {
@@ -73,12 +88,17 @@ public:
 
     // Gets next sequences up to a maximum count of samples,
     // applying transformers to particular streams.
+    // The transformers allocate their output in one arena per call, which is reset in one step
+    // when the packer has copied the sequences and released them.
     virtual Sequences GetNextSequences(size_t sampleCount) override
     {
         assert(m_sequenceProvider != nullptr);
+        m_currentArena = m_arenas->Get();
         Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
-        if (sequences.m_data.empty())
+
+        if (sequences.m_data.empty() || m_transformedByProvider)
         {
+            m_currentArena.reset();
             return sequences;
         }
 
@@ -90,11 +110,13 @@ public:
             {
                 for (auto& t : m_transformations)
                 {
-                    sequences.m_data[t.second][sequenceId] = t.first.m_transformer->Transform(sequences.m_data[t.second][sequenceId]);
+                    auto& sequence = sequences.m_data[t.second][sequenceId];
+                    sequence = t.first.m_transformer->Transform(std::move(sequence), m_currentArena);
                 }
             }, j);
         }
 
+        m_currentArena.reset();
         capture.RethrowIfHappened();
         return sequences;
     }
@@ -104,7 +126,22 @@ public:
         m_sequenceProvider->SetConfiguration(config);
     }
 
+    void TakeChunkLoadSeconds(std::vector<double>& seconds) override
+    {
+        m_sequenceProvider->TakeChunkLoadSeconds(seconds);
+    }
+
 private:
+    // Applies all transformations to a single sequence. The sequence is handed over to each transformer,
+    // so that the ones working in place can modify and return it.
+    void Apply(std::vector<SequenceDataPtr>& sequence)
+    {
+        for (auto& t : m_transformations)
+        {
+            sequence[t.second] = t.first.m_transformer->Transform(std::move(sequence[t.second]), m_currentArena);
+        }
+    }
+
     size_t GetStreamId(const std::wstring streamName, const std::vector<StreamDescriptionPtr>& streams) const
     {
         for (const auto& s : streams)
@@ -122,6 +159,13 @@ private:
     SequenceEnumeratorPtr m_sequenceProvider;
     std::vector<StreamDescriptionPtr> m_outputStreams;
     std::vector<std::pair<Transformation, size_t>> m_transformations;
+
+    // Whether the sequence provider applies the transformations.
+    bool m_transformedByProvider;
+
+    // Arenas for the outputs of the transformers, and the one of the current GetNextSequences() call.
+    SequenceArenaPoolPtr m_arenas;
+    SequenceArenaPtr m_currentArena;
 };
 
 }}}
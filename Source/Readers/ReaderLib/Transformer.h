@@ -6,6 +6,7 @@
 #pragma once
 
 #include "DataDeserializer.h"
+#include "SequenceArena.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -29,6 +30,20 @@ public:
     // This method should describe how input sequences is transformed to the output sequence.
     virtual SequenceDataPtr Transform(SequenceDataPtr inputSequence) = 0;
 
+    // Same as above, but output buffers may be allocated in the arena of the minibatch,
+    // which lives until the packer has copied the minibatch. 'arena' can be null.
+    virtual SequenceDataPtr Transform(SequenceDataPtr inputSequence, const SequenceArenaPtr& /*arena*/)
+    {
+        return Transform(std::move(inputSequence));
+    }
+
+    // Whether the transformer modifies its input sequence and returns it, instead of allocating a new one.
+    // The input of such a transformer must not be shared with anyone else, e.g. a cache of the deserializer.
+    virtual bool IsInPlace() const
+    {
+        return false;
+    }
+
     virtual ~Transformer()
     {
     }
@@ -8,6 +8,7 @@
 
 #include <cmath>
 #include <deque>
+#include <numeric>
 #include "TruncatedBpttPacker.h"
 #include "ElementTypeUtils.h"
 
@@ -60,6 +61,19 @@ public:
         m_sequences.pop_front();
     }
 
+    // Moves the sequences that have not been started yet to the end of 'sequences',
+    // i.e. all but a front sequence that is partially packed already.
+    void TakeUnstartedSequences(vector<SequenceDataPtr>& sequences)
+    {
+        size_t first = m_sampleCursor > 0 ? 1 : 0;
+        for (size_t i = first; i < m_sequences.size(); ++i)
+        {
+            sequences.push_back(m_sequences[i]);
+            m_length -= m_sequences[i]->m_numberOfSamples;
+        }
+        m_sequences.erase(m_sequences.begin() + first, m_sequences.end());
+    }
+
     // Contains the current sample cursor in the first sequence(m_sequences.front()) of the slot.
     size_t m_sampleCursor;
 
@@ -109,8 +123,13 @@ struct SequenceBuffer
 TruncatedBPTTPacker::TruncatedBPTTPacker(
     SequenceEnumeratorPtr sequenceEnumerator,
     const vector<StreamDescriptionPtr>& streams,
-    size_t numberOfBuffers)
-    : PackerBase(sequenceEnumerator, streams, numberOfBuffers)
+    size_t numberOfBuffers,
+    bool balanceParallelSequences)
+    : PackerBase(sequenceEnumerator, streams, numberOfBuffers),
+    m_balanceParallelSequences(balanceParallelSequences),
+    m_readAheadSamples(0),
+    m_endOfEpochReached(false),
+    m_slotsBalanced(false)
 {
     auto sparseOutput = find_if(m_outputStreamDescriptions.begin(), m_outputStreamDescriptions.end(), [](const StreamDescriptionPtr& s){ return s->m_storageType == StorageType::sparse_csc; });
     if (sparseOutput != m_outputStreamDescriptions.end())
@@ -166,6 +185,9 @@ void TruncatedBPTTPacker::SetConfiguration(const ReaderConfiguration& config, co
             }
     }
 
+    m_endOfEpochReached = false;
+    m_slotsBalanced = false;
+
     // Filling in the initial set of sequences
     for (size_t slotIndex = 0; slotIndex < m_numParallelSequences; ++slotIndex)
     {
@@ -177,6 +199,21 @@ Minibatch TruncatedBPTTPacker::ReadMinibatch()
 {
     Minibatch result;
 
+    // Between minibatches, all streams are at the same position, so the slots can be rearranged for all of them.
+    if (m_balanceParallelSequences && !m_slotsBalanced)
+    {
+        for (size_t slotIndex = 0; slotIndex < m_numParallelSequences; ++slotIndex)
+        {
+            ReadSequencesToSlot(slotIndex);
+        }
+
+        if (m_endOfEpochReached)
+        {
+            BalanceSlots();
+            m_slotsBalanced = true;
+        }
+    }
+
     // Currently all we expect sequences of identical length between different streams,
     // so it is sufficient to check a single stream only.
     if (m_sequenceBufferPerStream.front()->NothingToPack())
@@ -307,11 +344,29 @@ void TruncatedBPTTPacker::PackSlot(size_t streamIndex, size_t slotIndex, size_t&
 void TruncatedBPTTPacker::ReadSequencesToSlot(size_t slotIndex)
 {
     const auto& slot = m_sequenceBufferPerStream.front()->m_slots[slotIndex];
+    if (m_balanceParallelSequences)
+    {
+        // The slots are filled from the sequences read ahead, in the same order.
+        ReadAhead();
+        while (m_config.m_truncationSize >= slot.AvailableNumberOfSamples() && !m_readAhead.empty())
+        {
+            const auto& sequence = m_readAhead.front();
+            for (size_t i = 0; i < sequence.size(); ++i)
+            {
+                m_sequenceBufferPerStream[i]->m_slots[slotIndex].PushSequence(sequence[i]);
+            }
+            m_readAheadSamples -= sequence.front()->m_numberOfSamples;
+            m_readAhead.pop_front();
+            ReadAhead();
+        }
+        return;
+    }
+
     while (m_config.m_truncationSize >= slot.AvailableNumberOfSamples())
     {
         // We need a single sequence, potentially we can request (m_truncationSize - slot.AvailableNumberOfSamples())
         // to be more efficient. In reality the truncation size usually is less the sequence size.
-        auto s = m_sequenceEnumerator->GetNextSequences(1);
+        auto s = ReadSequences(1);
 
         // Adding sequence to the slot for all streams.
         for (size_t i = 0; i < s.m_data.size(); ++i)
@@ -329,9 +384,84 @@ void TruncatedBPTTPacker::ReadSequencesToSlot(size_t slotIndex)
 
         if (s.m_endOfEpoch)
         {
+            m_endOfEpochReached = true;
             break;
         }
     }
 }
 
+void TruncatedBPTTPacker::ReadAhead()
+{
+    while (!m_endOfEpochReached && m_readAheadSamples < m_numParallelSequences * m_config.m_truncationSize)
+    {
+        auto s = ReadSequences(1);
+        size_t numSequences = s.m_data.empty() ? 0 : s.m_data.front().size();
+        for (size_t j = 0; j < numSequences; ++j)
+        {
+            vector<SequenceDataPtr> sequence;
+            for (size_t i = 0; i < s.m_data.size(); ++i)
+            {
+                // Check that all sequences are of the same length.
+                if (s.m_data.front()[j]->m_numberOfSamples != s.m_data[i][j]->m_numberOfSamples)
+                {
+                    RuntimeError("For BPTT sequences between different input stream should have the same length.");
+                }
+                sequence.push_back(s.m_data[i][j]);
+            }
+            m_readAheadSamples += sequence.front()->m_numberOfSamples;
+            m_readAhead.push_back(move(sequence));
+        }
+
+        if (s.m_endOfEpoch)
+        {
+            m_endOfEpochReached = true;
+        }
+    }
+}
+
+// No more sequences arrive after the end of the epoch. Without balancing, the slots then run empty one after the other,
+// and the last minibatches mostly consist of gaps. Instead, the sequences that are not started yet, including those read
+// ahead, are assigned anew, longest first, each to the slot that has the fewest samples left, so that all slots run empty
+// at about the same time.
+// A sequence that is partially packed stays in its slot, since its recurrent state is carried over in that row.
+void TruncatedBPTTPacker::BalanceSlots()
+{
+    vector<vector<SequenceDataPtr>> sequences(m_outputStreamDescriptions.size());
+    for (size_t streamIndex = 0; streamIndex < sequences.size(); ++streamIndex)
+    {
+        for (auto& slot : m_sequenceBufferPerStream[streamIndex]->m_slots)
+        {
+            slot.TakeUnstartedSequences(sequences[streamIndex]);
+        }
+        for (const auto& sequence : m_readAhead)
+        {
+            sequences[streamIndex].push_back(sequence[streamIndex]);
+        }
+    }
+    m_readAhead.clear();
+    m_readAheadSamples = 0;
+
+    // The sequences of all streams have the same lengths, so the assignment is determined on the first stream.
+    vector<size_t> order(sequences.front().size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+        return sequences.front()[a]->m_numberOfSamples > sequences.front()[b]->m_numberOfSamples;
+    });
+
+    const auto& slots = m_sequenceBufferPerStream.front()->m_slots;
+    for (auto sequenceIndex : order)
+    {
+        auto shortest = min_element(slots.begin(), slots.end(), [](const Slot& a, const Slot& b)
+        {
+            return a.AvailableNumberOfSamples() < b.AvailableNumberOfSamples();
+        });
+        size_t slotIndex = shortest - slots.begin();
+        for (size_t streamIndex = 0; streamIndex < sequences.size(); ++streamIndex)
+        {
+            m_sequenceBufferPerStream[streamIndex]->m_slots[slotIndex].PushSequence(sequences[streamIndex][sequenceIndex]);
+        }
+    }
+}
+
 }}}
@@ -17,13 +17,17 @@ typedef std::shared_ptr<SequenceBuffer> SequenceBufferPtr;
 
 // A bptt packer that densely packs samples in parallel for GPU consumptions.
 // TODO: Currently supports only packing of streams with sequences of equal length.
+// With 'balanceParallelSequences', sequences are read a minibatch ahead, and the ones that are not started yet when the
+// end of the epoch is reached are redistributed over the parallel sequences by length, so that the last minibatches
+// have few gap frames.
 class TruncatedBPTTPacker : public PackerBase
 {
 public:
     TruncatedBPTTPacker(
         SequenceEnumeratorPtr sequenceEnumerator,
         const std::vector<StreamDescriptionPtr>& streams,
-        size_t numberOfBuffers = 2);
+        size_t numberOfBuffers = 2,
+        bool balanceParallelSequences = false);
 
     virtual Minibatch ReadMinibatch() override;
 
@@ -41,6 +45,12 @@ private:
     // inputs to have consistent sequence ids.
     void PackSlot(size_t streamIndex, size_t slotIndex, size_t& sequenceId);
 
+    // Reads sequences into m_readAhead until it holds a minibatch worth of samples or the end of the epoch is reached.
+    void ReadAhead();
+
+    // Redistributes the sequences that are not started yet over the slots, for all streams alike.
+    void BalanceSlots();
+
     virtual MBLayoutPtr CreateMBLayout(const StreamBatch& batch)
     {
         UNUSED(batch);
@@ -59,6 +69,17 @@ private:
     // Layout per stream.
     // TODO: currently assume that layout is the same between different streams, this will change.
     std::vector<MBLayoutPtr> m_currentLayouts;
+
+    // Whether to balance the slots at the end of the epoch, see BalanceSlots().
+    bool m_balanceParallelSequences;
+
+    // Sequences read ahead when balancing, each with its data of all streams, and their total number of samples.
+    std::deque<std::vector<SequenceDataPtr>> m_readAhead;
+    size_t m_readAheadSamples;
+
+    // The sequence enumerator has reached the end of the epoch, and the slots have been balanced since.
+    bool m_endOfEpochReached;
+    bool m_slotsBalanced;
 };
 
 typedef std::shared_ptr<TruncatedBPTTPacker> TruncatedBPTTPackerPtr;
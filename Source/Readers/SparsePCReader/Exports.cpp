@@ -8,17 +8,35 @@
 #include "stdafx.h"
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
-#include "SparsePCReader.h"
+#include "ReaderShim.h"
+#include "CorpusDescriptor.h"
+#include "../LibSVMBinaryReader/SparseBinaryDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+auto factory = [](const ConfigParameters& parameters) -> ReaderPtr
+{
+    return std::make_shared<SparseBinaryReader>(SparseBinaryFormat::sparsePC, parameters);
+};
+
 extern "C" DATAREADER_API void GetReaderF(IDataReader** preader)
 {
-    *preader = new SparsePCReader<float>();
+    *preader = new ReaderShim<float>(factory);
 }
 extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
 {
-    *preader = new SparsePCReader<double>();
+    *preader = new ReaderShim<double>(factory);
+}
+
+// TODO: Not safe from the ABI perspective. Will be uglified to make the interface ABI.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr /*corpus*/, bool primary)
+{
+    if (type == L"SparsePCDeserializer")
+        *deserializer = new SparseBinaryDeserializer(SparseBinaryFormat::sparsePC, deserializerConfig, primary);
+    else
+        return false; // unknown type
+
+    return true;
 }
 
 }}}
@@ -9,6 +9,7 @@
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
 #include "UCIFastReader.h"
+#include "UCIDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,4 +22,15 @@ extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
     *preader = new UCIFastReader<double>();
 }
 
+// TODO: Not safe from the ABI perspective. Will be uglified to make the interface ABI.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool primary)
+{
+    if (type == L"UCIDeserializer")
+        *deserializer = new UCIDeserializer(corpus, deserializerConfig, primary);
+    else
+        return false; // unknown type
+
+    return true;
+}
+
 }}}
@@ -0,0 +1,547 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <future>
+#include <thread>
+#include <sys/stat.h>
+#include "UCIDeserializer.h"
+#include "FileLock.h"
+#include "SequenceData.h"
+#include "StringUtil.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+static const char c_cacheMagic[8] = { 'U', 'C', 'I', 'C', 'A', 'C', 'H', 'E' };
+static const uint32_t c_cacheVersion = 1;
+
+// How long to wait for another process that builds the same cache.
+static const int c_cacheWaitSeconds = 600;
+
+// Layout of the cache: this header, the features of all samples (one column per sample),
+// then the labels (uint32 ids for category labels, columns of values for regression labels).
+// All fields up to m_numberOfSamples identify the text file and the configuration.
+struct UCIDeserializer::CacheHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_elementSize;
+    uint64_t m_fileSize;
+    int64_t m_modificationTime;
+    uint64_t m_labelMappingFileSize;
+    int64_t m_labelMappingModificationTime;
+    uint64_t m_featureStart;
+    uint64_t m_featureDimension;
+    uint64_t m_labelStart;
+    uint64_t m_labelColumns;
+    uint32_t m_labelKind;
+    char m_customDelimiter;
+    char m_customDecimalPoint;
+    uint16_t m_reserved;
+    uint64_t m_numberOfSamples;
+};
+
+static bool TryGetFileStatus(const wstring& path, uint64_t& size, int64_t& modificationTime)
+{
+#ifdef _WIN32
+    struct _stat64 buf;
+    if (_wstat64(path.c_str(), &buf) != 0)
+        return false;
+#else
+    struct stat buf;
+    if (stat(msra::strfun::utf8(path).c_str(), &buf) != 0)
+        return false;
+#endif
+    size = (uint64_t)buf.st_size;
+    modificationTime = (int64_t)buf.st_mtime;
+    return true;
+}
+
+static FILE* OpenCacheFile(const wstring& path, const char* mode)
+{
+#ifdef _WIN32
+    return _wfopen(path.c_str(), msra::strfun::utf16(mode).c_str());
+#else
+    return fopen(msra::strfun::utf8(path).c_str(), mode);
+#endif
+}
+
+// A dense sample in the cache, in the parsed data or in the one-hot vectors.
+struct UCISequenceData : DenseSequenceData
+{
+    const void* m_data;
+
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+};
+
+// All data is in memory or mapped already: samples only point into the data of the deserializer.
+class UCIDeserializer::UCIChunk : public Chunk, public std::enable_shared_from_this<UCIChunk>
+{
+public:
+    UCIChunk(const UCIDeserializer& parent) : m_parent(parent)
+    {
+    }
+
+    virtual void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
+    {
+        assert(sequenceId < m_parent.m_numberOfSamples);
+        auto features = make_shared<UCISequenceData>();
+        features->m_data = m_parent.m_featureData + sequenceId * m_parent.m_featureDimension * m_parent.m_elementSize;
+        result.push_back(Finalize(features, sequenceId));
+
+        if (m_parent.m_labelKind == LabelKind::none)
+            return;
+
+        auto labels = make_shared<UCISequenceData>();
+        if (m_parent.m_labelKind == LabelKind::category)
+        {
+            uint32_t id = ((const uint32_t*)m_parent.m_labelData)[sequenceId];
+            labels->m_data = m_parent.m_oneHotVectors.data() + id * m_parent.m_labelDimension * m_parent.m_elementSize;
+        }
+        else
+            labels->m_data = m_parent.m_labelData + sequenceId * m_parent.m_labelColumns * m_parent.m_elementSize;
+        result.push_back(Finalize(labels, sequenceId));
+    }
+
+private:
+    SequenceDataPtr Finalize(SequenceDataPtr sequence, size_t sequenceId)
+    {
+        sequence->m_id = sequenceId;
+        sequence->m_numberOfSamples = 1;
+        sequence->m_elementType = m_parent.m_elementType;
+        sequence->m_chunk = shared_from_this();
+        return sequence;
+    }
+
+    const UCIDeserializer& m_parent;
+};
+
+UCIDeserializer::UCIDeserializer(CorpusDescriptorPtr /*corpus*/, const ConfigParameters& config, bool /*primary*/)
+    : m_dataOffset(0), m_featureData(nullptr), m_labelData(nullptr), m_numberOfSamples(0)
+{
+    wstring precision = config(L"precision", L"float");
+    m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
+    m_elementSize = m_elementType == ElementType::tfloat ? sizeof(float) : sizeof(double);
+
+    string customDelimiter = config(L"customDelimiter", "");
+    string customDecimalPoint = config(L"customDecimalPoint", "");
+    m_customDelimiter = customDelimiter.empty() ? '\0' : customDelimiter[0];
+    m_customDecimalPoint = customDecimalPoint.empty() ? '\0' : customDecimalPoint[0];
+    if (m_customDelimiter != '\0' && m_customDelimiter == m_customDecimalPoint)
+        InvalidArgument("UCIDeserializer: customDelimiter and customDecimalPoint must differ.");
+
+    InitializeStreams(config);
+
+    size_t numberOfThreads = config(L"numParseThreads", (size_t)0);
+    if (numberOfThreads == 0)
+        numberOfThreads = max<size_t>(thread::hardware_concurrency(), 1);
+
+    CacheHeader key;
+    bool useCache = config(L"cache", true);
+    wstring cacheFile = config(L"cacheFile", m_fileName + L".ucicache");
+    if (!useCache || !TryGetCacheKey(key))
+    {
+        ParseFile(numberOfThreads);
+    }
+    else if (TryLoadCache(cacheFile, key))
+    {
+        fprintf(stderr, "UCIDeserializer: Loaded '%ls' from the cache '%ls'.\n", m_fileName.c_str(), cacheFile.c_str());
+    }
+    else
+    {
+        // Several workers of a distributed job are likely to start at the same time:
+        // the one that gets the lock of the cache builds it, others wait for it.
+        bool loaded = BuildOrWaitForCache(cacheFile, c_cacheWaitSeconds, true,
+            [&] { return TryLoadCache(cacheFile, key); },
+            [&] { ParseFile(numberOfThreads); },
+            [&]
+            {
+                key.m_numberOfSamples = m_numberOfSamples;
+                WriteCache(cacheFile, key);
+            });
+
+        // Serving from the mapping leaves the memory to the page cache.
+        if (!loaded && TryLoadCache(cacheFile, key))
+            vector<char>().swap(m_parsedData);
+    }
+
+    size_t bytesPerSample = (m_featureDimension + (m_labelKind == LabelKind::regression ? m_labelColumns : 0)) * m_elementSize +
+                            (m_labelKind == LabelKind::category ? sizeof(uint32_t) : 0);
+    size_t chunkSizeInBytes = config(L"chunkSizeInBytes", (size_t)32 * 1024 * 1024);
+    m_samplesPerChunk = max<size_t>(chunkSizeInBytes / bytesPerSample, 1);
+    if ((m_numberOfSamples + m_samplesPerChunk - 1) / m_samplesPerChunk > CHUNKID_MAX)
+        RuntimeError("UCIDeserializer: Too many chunks in '%ls', increase 'chunkSizeInBytes'.", m_fileName.c_str());
+
+    fprintf(stderr, "UCIDeserializer: %" PRIu64 " samples of %" PRIu64 " features in '%ls'.\n",
+            m_numberOfSamples, m_featureDimension, m_fileName.c_str());
+}
+
+// Feature and label sections as for the UCIFastReader, see UCIFastReader::InitFromConfig().
+void UCIDeserializer::InitializeStreams(const ConfigParameters& config)
+{
+    vector<wstring> featureNames, labelNames;
+    GetFileConfigNames(config, featureNames, labelNames);
+    if (featureNames.empty())
+        RuntimeError("UCIDeserializer: features section not found, required in configuration: i.e. 'features=[start=1;dim=123]'");
+
+    m_featureName = featureNames[0];
+    const ConfigParameters& featureConfig = config(m_featureName);
+    m_featureStart = featureConfig(L"start", (size_t)0);
+    m_featureDimension = featureConfig(L"dim");
+    if (m_featureDimension == 0)
+        InvalidArgument("UCIDeserializer: The feature dimension must be positive.");
+    m_fileName = config.ExistsCurrent(L"file") ? (wstring)config(L"file") : (wstring)featureConfig(L"file");
+
+    m_labelKind = LabelKind::none;
+    m_labelStart = m_labelColumns = m_labelDimension = 0;
+    if (!labelNames.empty())
+    {
+        m_labelName = labelNames[0];
+        const ConfigParameters& labelConfig = config(m_labelName);
+        wstring labelType = labelConfig(L"labelType", L"category");
+        if (labelConfig.ExistsCurrent(L"file") && (wstring)labelConfig(L"file") != m_fileName)
+            RuntimeError("UCIDeserializer: features and label files must be the same file, use separate deserializers to define single use files");
+
+        m_labelStart = labelConfig(L"start", (size_t)0);
+        m_labelColumns = labelConfig(L"dim", (size_t)1);
+        if (AreEqualIgnoreCase(labelType, L"category"))
+        {
+            m_labelKind = LabelKind::category;
+            if (m_labelColumns != 1)
+                InvalidArgument("UCIDeserializer: Category labels must be a single column.");
+
+            m_labelMappingFile = (wstring)labelConfig(L"labelMappingFile");
+            if (!fexists(m_labelMappingFile))
+                RuntimeError("UCIDeserializer: label mapping file %ls not found, can be created with a 'createLabelMap' command/action", m_labelMappingFile.c_str());
+
+            vector<string> labels;
+            File::LoadLabelFile(m_labelMappingFile, labels);
+            for (uint32_t i = 0; i < labels.size(); ++i)
+                m_labelToId[labels[i]] = i;
+            m_labelDimension = max<size_t>(labelConfig(L"labelDim", (size_t)0), labels.size());
+
+            m_oneHotVectors.assign(m_labelDimension * m_labelDimension * m_elementSize, 0);
+            for (size_t i = 0; i < m_labelDimension; ++i)
+            {
+                if (m_elementType == ElementType::tfloat)
+                    ((float*)m_oneHotVectors.data())[i * m_labelDimension + i] = 1;
+                else
+                    ((double*)m_oneHotVectors.data())[i * m_labelDimension + i] = 1;
+            }
+        }
+        else if (AreEqualIgnoreCase(labelType, L"regression"))
+        {
+            m_labelKind = LabelKind::regression;
+            m_labelDimension = m_labelColumns;
+        }
+        else if (!AreEqualIgnoreCase(labelType, L"none"))
+            InvalidArgument("UCIDeserializer: Unsupported labelType '%ls', expected 'category', 'regression' or 'none'.", labelType.c_str());
+    }
+
+    auto addStream = [this](const wstring& name, size_t dimension)
+    {
+        auto stream = make_shared<StreamDescription>();
+        stream->m_id = m_streams.size();
+        stream->m_name = name;
+        stream->m_sampleLayout = make_shared<TensorShape>(dimension);
+        stream->m_storageType = StorageType::dense;
+        stream->m_elementType = m_elementType;
+        m_streams.push_back(stream);
+    };
+    addStream(m_featureName, m_featureDimension);
+    if (m_labelKind != LabelKind::none)
+        addStream(m_labelName, m_labelDimension);
+}
+
+bool UCIDeserializer::TryGetCacheKey(CacheHeader& key) const
+{
+    memset(&key, 0, sizeof(key));
+    memcpy(key.m_magic, c_cacheMagic, sizeof(c_cacheMagic));
+    key.m_version = c_cacheVersion;
+    key.m_elementSize = (uint32_t)m_elementSize;
+    key.m_featureStart = m_featureStart;
+    key.m_featureDimension = m_featureDimension;
+    key.m_labelStart = m_labelStart;
+    key.m_labelColumns = m_labelColumns;
+    key.m_labelKind = (uint32_t)m_labelKind;
+    key.m_customDelimiter = m_customDelimiter;
+    key.m_customDecimalPoint = m_customDecimalPoint;
+    if (m_labelKind == LabelKind::category &&
+        !TryGetFileStatus(m_labelMappingFile, key.m_labelMappingFileSize, key.m_labelMappingModificationTime))
+        return false;
+    return TryGetFileStatus(m_fileName, key.m_fileSize, key.m_modificationTime);
+}
+
+bool UCIDeserializer::TryLoadCache(const wstring& cacheFile, const CacheHeader& key)
+{
+    if (!fexists(cacheFile))
+        return false;
+
+    unique_ptr<MemoryMappedFile> cache(new MemoryMappedFile(cacheFile));
+    if (cache->GetSize() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    memcpy(&header, cache->GetData(), sizeof(header));
+    if (memcmp(&header, &key, offsetof(CacheHeader, m_numberOfSamples)) != 0)
+        return false;
+
+    size_t labelSize = m_labelKind == LabelKind::category ? sizeof(uint32_t) : m_labelKind == LabelKind::regression ? m_labelColumns * m_elementSize : 0;
+    size_t expectedSize = sizeof(CacheHeader) + header.m_numberOfSamples * (m_featureDimension * m_elementSize + labelSize);
+    if (cache->GetSize() != expectedSize)
+        return false;
+
+    cache->AdviseRandomAccess();
+    m_cache = move(cache);
+    m_dataOffset = sizeof(CacheHeader);
+    SetData(m_cache->GetData() + m_dataOffset, header.m_numberOfSamples);
+    return true;
+}
+
+void UCIDeserializer::SetData(const char* data, size_t numberOfSamples)
+{
+    m_numberOfSamples = numberOfSamples;
+    m_featureData = data;
+    m_labelData = data + numberOfSamples * m_featureDimension * m_elementSize;
+
+    if (m_labelKind == LabelKind::category)
+    {
+        // Ids are validated when parsing; the check guards against a cache built with another labelDim.
+        const uint32_t* ids = (const uint32_t*)m_labelData;
+        for (size_t i = 0; i < numberOfSamples; ++i)
+        {
+            if (ids[i] >= m_labelDimension)
+                RuntimeError("UCIDeserializer: Label id %d of sample %" PRIu64 " exceeds the label dimension %" PRIu64 ".", (int)ids[i], i, m_labelDimension);
+        }
+    }
+}
+
+// Splits the file into a block of whole lines per thread; the blocks are concatenated in file order.
+void UCIDeserializer::ParseFile(size_t numberOfThreads)
+{
+    MemoryMappedFile file(m_fileName);
+    const char* data = file.GetData();
+    size_t size = file.GetSize();
+
+    vector<const char*> boundaries{ data };
+    for (size_t i = 1; i < numberOfThreads && size > 0; ++i)
+    {
+        const char* p = max(boundaries.back(), data + size * i / numberOfThreads);
+        p = (const char*)memchr(p, '\n', data + size - p);
+        if (p == nullptr)
+            break;
+        boundaries.push_back(p + 1);
+    }
+    boundaries.push_back(data + size);
+
+    size_t numberOfBlocks = boundaries.size() - 1;
+    vector<vector<char>> features(numberOfBlocks), labels(numberOfBlocks);
+    vector<future<void>> workers;
+    for (size_t i = 0; i < numberOfBlocks; ++i)
+    {
+        workers.push_back(async(launch::async, [&, i]()
+        {
+            if (m_elementType == ElementType::tfloat)
+                ParseLines<float>(boundaries[i], boundaries[i + 1], features[i], labels[i]);
+            else
+                ParseLines<double>(boundaries[i], boundaries[i + 1], features[i], labels[i]);
+        }));
+    }
+    for (auto& worker : workers)
+        worker.get();
+
+    size_t featureBytes = 0, labelBytes = 0;
+    for (size_t i = 0; i < numberOfBlocks; ++i)
+    {
+        featureBytes += features[i].size();
+        labelBytes += labels[i].size();
+    }
+
+    m_parsedData.clear();
+    m_parsedData.reserve(featureBytes + labelBytes);
+    for (auto& block : features)
+    {
+        m_parsedData.insert(m_parsedData.end(), block.begin(), block.end());
+        vector<char>().swap(block);
+    }
+    for (auto& block : labels)
+        m_parsedData.insert(m_parsedData.end(), block.begin(), block.end());
+
+    m_cache.reset();
+    SetData(m_parsedData.data(), featureBytes / (m_featureDimension * m_elementSize));
+}
+
+template <class ElemType>
+void UCIDeserializer::ParseLines(const char* begin, const char* end, vector<char>& features, vector<char>& labels) const
+{
+    auto isDelimiter = [this](char c) { return c == ' ' || c == '\t' || c == '\r' || (c == m_customDelimiter && c != '\0'); };
+
+    string token;
+    auto parseNumber = [&]() -> ElemType
+    {
+        if (m_customDecimalPoint != '\0')
+            replace(token.begin(), token.end(), m_customDecimalPoint, '.');
+        char* tokenEnd;
+        double value = strtod(token.c_str(), &tokenEnd);
+        if (tokenEnd != token.c_str() + token.size())
+            RuntimeError("UCIDeserializer: Invalid number '%s' in '%ls'.", token.c_str(), m_fileName.c_str());
+        return (ElemType)value;
+    };
+
+    vector<ElemType> featureValues(m_featureDimension);
+    vector<ElemType> labelValues(m_labelKind == LabelKind::regression ? m_labelColumns : 0);
+    uint32_t labelId = 0;
+
+    const char* p = begin;
+    while (p < end)
+    {
+        const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+        if (lineEnd == nullptr)
+            lineEnd = end;
+
+        size_t column = 0, featureCount = 0, labelCount = 0;
+        while (p < lineEnd)
+        {
+            while (p < lineEnd && isDelimiter(*p))
+                ++p;
+            if (p == lineEnd)
+                break;
+            const char* tokenBegin = p;
+            while (p < lineEnd && !isDelimiter(*p))
+                ++p;
+            token.assign(tokenBegin, p);
+
+            if (column >= m_featureStart && column < m_featureStart + m_featureDimension)
+            {
+                featureValues[column - m_featureStart] = parseNumber();
+                featureCount++;
+            }
+            else if (m_labelKind != LabelKind::none && column >= m_labelStart && column < m_labelStart + m_labelColumns)
+            {
+                if (m_labelKind == LabelKind::category)
+                {
+                    auto label = m_labelToId.find(token);
+                    if (label == m_labelToId.end())
+                        RuntimeError("UCIDeserializer: label found in data not specified in label mapping file: %s", token.c_str());
+                    labelId = label->second;
+                }
+                else
+                    labelValues[column - m_labelStart] = parseNumber();
+                labelCount++;
+            }
+            column++;
+        }
+        p = lineEnd + 1;
+
+        if (column == 0)
+            continue; // empty line
+
+        if (featureCount != m_featureDimension || (m_labelKind != LabelKind::none && labelCount != m_labelColumns))
+            RuntimeError("UCIDeserializer: A line of '%ls' has only %d columns.", m_fileName.c_str(), (int)column);
+
+        features.insert(features.end(), (const char*)featureValues.data(), (const char*)(featureValues.data() + featureValues.size()));
+        if (m_labelKind == LabelKind::category)
+            labels.insert(labels.end(), (const char*)&labelId, (const char*)(&labelId + 1));
+        else if (m_labelKind == LabelKind::regression)
+            labels.insert(labels.end(), (const char*)labelValues.data(), (const char*)(labelValues.data() + labelValues.size()));
+    }
+}
+
+void UCIDeserializer::WriteCache(const wstring& cacheFile, const CacheHeader& key) const
+{
+    // Writing to a temporary file first, so that readers never see a partially written cache.
+    wstring tmpFile = cacheFile + L".tmp";
+    FILE* f = OpenCacheFile(tmpFile, "wb");
+    if (f == nullptr)
+        RuntimeError("Cannot create the cache file (%ls).", tmpFile.c_str());
+
+    bool written = fwrite(&key, sizeof(key), 1, f) == 1 &&
+                   fwrite(m_parsedData.data(), 1, m_parsedData.size(), f) == m_parsedData.size();
+    written = (fclose(f) == 0) && written;
+    if (!written)
+    {
+        _wunlink(tmpFile.c_str());
+        RuntimeError("Cannot write the cache file (%ls).", tmpFile.c_str());
+    }
+
+    renameOrDie(tmpFile, cacheFile);
+    fprintf(stderr, "UCIDeserializer: Saved '%ls' to the cache '%ls'.\n", m_fileName.c_str(), cacheFile.c_str());
+}
+
+ChunkDescriptions UCIDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    for (size_t first = 0; first < m_numberOfSamples; first += m_samplesPerChunk)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = (ChunkIdType)result.size();
+        cd->m_numberOfSamples = min(m_samplesPerChunk, m_numberOfSamples - first);
+        cd->m_numberOfSequences = cd->m_numberOfSamples;
+        result.push_back(cd);
+    }
+    return result;
+}
+
+void UCIDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    size_t first = chunkId * m_samplesPerChunk;
+    size_t last = min(first + m_samplesPerChunk, m_numberOfSamples);
+    result.reserve(result.size() + last - first);
+    for (size_t i = first; i < last; ++i)
+    {
+        SequenceDescription s;
+        s.m_id = i;
+        s.m_numberOfSamples = 1;
+        s.m_chunkId = chunkId;
+        s.m_key.m_sequence = i;
+        s.m_key.m_sample = 0;
+        result.push_back(s);
+    }
+}
+
+bool UCIDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    if (key.m_sequence >= m_numberOfSamples)
+        return false;
+
+    result.m_id = key.m_sequence;
+    result.m_numberOfSamples = 1;
+    result.m_chunkId = (ChunkIdType)(key.m_sequence / m_samplesPerChunk);
+    result.m_key.m_sequence = key.m_sequence;
+    result.m_key.m_sample = 0;
+    return true;
+}
+
+ChunkPtr UCIDeserializer::GetChunk(ChunkIdType /*chunkId*/)
+{
+    return make_shared<UCIChunk>(*this);
+}
+
+void UCIDeserializer::ReadAhead(const vector<ChunkIdType>& chunkIds)
+{
+    if (!m_cache)
+        return;
+
+    size_t labelSize = m_labelKind == LabelKind::category ? sizeof(uint32_t) : m_labelColumns * m_elementSize;
+    for (auto chunkId : chunkIds)
+    {
+        size_t first = chunkId * m_samplesPerChunk;
+        size_t count = min(m_samplesPerChunk, m_numberOfSamples - first);
+        size_t featureSize = m_featureDimension * m_elementSize;
+        m_cache->WillNeed(m_dataOffset + first * featureSize, count * featureSize);
+        if (m_labelKind != LabelKind::none)
+            m_cache->WillNeed(m_labelData - m_cache->GetData() + first * labelSize, count * labelSize);
+    }
+}
+
+}}}
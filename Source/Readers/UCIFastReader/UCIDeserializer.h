@@ -0,0 +1,123 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+#include "MemoryMappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer for the dense text files of the UCIFastReader, for use with the composite reader.
+// The file is parsed once, in parallel blocks of lines, into a binary cache next to it that holds
+// the features of every sample as a column, followed by the labels. The cache is memory mapped and
+// reused as long as the text file, the label mapping and the column configuration do not change,
+// so that later epochs (and later runs) do not parse text at all. Every sample is a sequence.
+//
+// Configuration, as for the UCIFastReader:
+//     file = "train.txt"                   # or given in the features section
+//     features = [ start = 1 ; dim = 784 ]
+//     labels = [ start = 0 ; dim = 1 ; labelType = "category" ; labelDim = 10 ; labelMappingFile = "labels.txt" ]
+//     customDelimiter = ","                # in addition to whitespace
+//     customDecimalPoint = ","
+//     cacheFile = "train.txt.ucicache"     # the default; cache = false parses into memory instead
+//     numParseThreads = 0                  # 0: one per hardware thread
+// Category labels are dense one-hot vectors, regression labels are 'dim' dense values.
+class UCIDeserializer : public DataDeserializerBase
+{
+public:
+    UCIDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+
+    // Locates the samples of a chunk in the cache.
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    // Chunks only read the cache.
+    virtual bool SupportsConcurrentChunkLoads() const override
+    {
+        return true;
+    }
+
+    // Pages in the chunks that are going to be loaded next.
+    virtual void ReadAhead(const std::vector<ChunkIdType>& chunkIds) override;
+
+protected:
+    // Samples are keyed by their index in the file.
+    virtual bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class UCIChunk;
+    struct CacheHeader;
+    DISABLE_COPY_AND_MOVE(UCIDeserializer);
+
+    enum class LabelKind
+    {
+        none,
+        category,   // one column, mapped to an id by the label mapping file
+        regression, // 'dim' columns of values
+    };
+
+    void InitializeStreams(const ConfigParameters& config);
+
+    // Fills the header fields that identify the text file and the configuration the cache is built for.
+    // Returns false if the text file cannot be stat'ed, in which case nothing is cached.
+    bool TryGetCacheKey(CacheHeader& key) const;
+
+    // Maps the cache file if it matches the key.
+    bool TryLoadCache(const std::wstring& cacheFile, const CacheHeader& key);
+
+    // Parses the text file in parallel into m_parsedData (feature columns followed by the labels).
+    void ParseFile(size_t numberOfThreads);
+
+    // Parses the lines in [begin, end), appending the features and the labels of every sample.
+    template <class ElemType>
+    void ParseLines(const char* begin, const char* end, std::vector<char>& features, std::vector<char>& labels) const;
+
+    void WriteCache(const std::wstring& cacheFile, const CacheHeader& key) const;
+
+    // Sets m_featureData and m_labelData for the data in memory or in the cache.
+    void SetData(const char* data, size_t numberOfSamples);
+
+    std::wstring m_fileName;
+    char m_customDelimiter;
+    char m_customDecimalPoint;
+
+    size_t m_featureStart;
+    size_t m_featureDimension;
+    std::wstring m_featureName;
+
+    LabelKind m_labelKind;
+    size_t m_labelStart;
+    size_t m_labelColumns;   // columns of the text file
+    size_t m_labelDimension; // rows of the label stream
+    std::wstring m_labelName;
+    std::wstring m_labelMappingFile;
+    std::map<std::string, uint32_t> m_labelToId;
+
+    ElementType m_elementType;
+    size_t m_elementSize;
+
+    // Parsed data when there is no cache, and the mapped cache otherwise.
+    std::vector<char> m_parsedData;
+    std::unique_ptr<MemoryMappedFile> m_cache;
+    size_t m_dataOffset; // of the features in the cache
+
+    const char* m_featureData;
+    const char* m_labelData; // uint32 ids for category labels
+    size_t m_numberOfSamples;
+    size_t m_samplesPerChunk;
+
+    // Columns of the identity matrix that category labels point to.
+    std::vector<char> m_oneHotVectors;
+};
+
+}}}
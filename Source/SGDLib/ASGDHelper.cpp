@@ -2,7 +2,7 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
-// ASGDHelper.cpp : Implements ASGDHelper interface. The implementation is based on Multiverso.
+// ASGDHelper.cpp : Implements ASGDHelper interface. The implementations are based on Multiverso or on MPI one-sided communication.
 //
 
 #define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
@@ -17,6 +17,7 @@
 #include <unordered_map>
 #include <numeric>
 #include <algorithm>
+#include <climits>
 
 #ifdef ASGD_PARALLEL_SUPPORT
 
@@ -74,6 +75,26 @@ static void CudaCall(ERRTYPE retCode, const char* exprString, const char* libNam
 #define CUDA_CALL(expr)     (CudaCall((expr), #expr, "CUDA",     cudaSuccess))
 #endif // CPUONLY
 
+// factor of the learning rate at the beginning of training, see AdjustLearningRateAtBeginning
+static float LearningRateDecayCoefficient(AdjustLearningRateAtBeginning adjustType, double adjustCoefficient, size_t adjustMBNumber, size_t parameterSyncCounter)
+{
+    float f = 1.f;
+    switch (adjustType)
+    {
+    case AdjustLearningRateAtBeginning::None:
+        break;
+    case AdjustLearningRateAtBeginning::Linearly:
+        f = min(f, max(0.f, (float)(adjustCoefficient + (1 - adjustCoefficient) / adjustMBNumber * parameterSyncCounter)));
+        break;
+    case AdjustLearningRateAtBeginning::Staircase:
+        f = min(f, max(0.f, (float)(adjustCoefficient * (parameterSyncCounter / adjustMBNumber + 1))));
+        break;
+    default:
+        break;
+    }
+    return f;
+}
+
 #ifdef ASGD_PARALLEL_SUPPORT
 
 // MultiversoHelper is the implementation of ASGDHelper interface with Multiverso
@@ -484,21 +505,7 @@ private:
 
     float DecayCoefficient()
     {
-        float f = 1.f;
-        switch (m_adjustLearningRateAtBeginningType)
-        {
-        case AdjustLearningRateAtBeginning::None:
-            break;
-        case AdjustLearningRateAtBeginning::Linearly:
-            f = min(f, max(0.f, (float)(m_adjustCoefficient + (1 - m_adjustCoefficient) / m_adjustMBNumber * m_parameterSyncCounter)));
-            break;
-        case AdjustLearningRateAtBeginning::Staircase:
-            f = min(f, max(0.f, (float)(m_adjustCoefficient * (m_parameterSyncCounter / m_adjustMBNumber + 1))));
-            break;
-        default:
-            break;
-        }
-        return f;
+        return LearningRateDecayCoefficient(m_adjustLearningRateAtBeginningType, m_adjustCoefficient, m_adjustMBNumber, m_parameterSyncCounter);
     }
 
     float ModelAggregationCoefficient(size_t samplesSinceLastSync)
@@ -594,6 +601,251 @@ private:
 
 #endif 
 
+// MPIParameterServerHelper is the implementation of ASGDHelper interface without external dependencies: the model is
+// sharded across the ranks, each of which serves its shard from an MPI-3 window. A worker pushes the change of its model
+// since its last pull with MPI_Raccumulate and pulls the model with MPI_Rget_accumulate(MPI_NO_OP), with passive target
+// synchronization, so that the owners of the shards are not involved. Both are accumulate operations, so they are atomic
+// per element and ordered: a pull returns the model including the worker's own push.
+// With useAsyncBuffer, the pulls are double buffered: the worker continues training on the model pulled at the previous
+// sync point while the push and the pull of the current one are in flight.
+template<class ElemType = float>
+class MPIParameterServerHelper : public ASGDHelper<ElemType>
+{
+public:
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+    MPIParameterServerHelper(const std::list<ComputationNodeBasePtr> & learnableNodes,
+        const MPIWrapperPtr& pMPI,
+        bool useAsyncBuffer,
+        bool isSimulatedModelAveragingSGD,
+        AdjustLearningRateAtBeginning adjusttype,
+        double adjustCoef,
+        size_t adjustPerMinibatches,
+        int traceLevel,
+        int syncPerfStats) :
+        m_pMPI(pMPI), m_useAsyncBuffer(useAsyncBuffer && !isSimulatedModelAveragingSGD), m_ModelAveragingSGDSimulating(isSimulatedModelAveragingSGD),
+        m_adjustLearningRateAtBeginningType(adjusttype), m_adjustCoefficient(adjustCoef), m_adjustMBNumber(adjustPerMinibatches),
+        m_traceLevel(traceLevel), m_syncPerfStats(syncPerfStats), m_parameterSyncCounter(0), m_pullPending(false),
+        m_totalModelSize(0), m_shard(nullptr)
+    {
+        if (!m_pMPI)
+            LogicError("MPIParameterServerHelper: Requires MPI.");
+
+        for (auto& node : learnableNodes)
+        {
+            m_tableOffsets.push_back(m_totalModelSize);
+            m_tableLength.push_back(DownCast(node)->Value().GetNumElements());
+            m_totalModelSize += m_tableLength.back();
+        }
+
+        // rank r serves the elements [m_shardOffsets[r], m_shardOffsets[r + 1]) of the model
+        size_t numShards = m_pMPI->NumNodesInUse();
+        for (size_t r = 0; r <= numShards; r++)
+            m_shardOffsets.push_back(r * m_totalModelSize / numShards);
+        if (ShardLength(0) > INT_MAX)
+            RuntimeError("MPIParameterServerHelper: Shards of more than %d elements are not supported; the model has %d elements for %d ranks.",
+                         INT_MAX, (int)m_totalModelSize, (int)numShards);
+
+        m_baselineArray.resize(m_totalModelSize);
+        m_deltaArray.resize(m_totalModelSize);
+        m_pullArray.resize(m_totalModelSize);
+
+        MPI_Win_allocate((MPI_Aint)(ShardLength(m_pMPI->CurrentNodeRank()) * sizeof(ElemType)), sizeof(ElemType), MPI_INFO_NULL,
+                         m_pMPI->Communicator(), &m_shard, &m_window) || MpiFail("MPIParameterServerHelper: MPI_Win_allocate");
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, m_window) || MpiFail("MPIParameterServerHelper: MPI_Win_lock_all");
+
+        fprintf(stderr, "MPI parameter server: %d elements in %d shards%s.\n", (int)m_totalModelSize, (int)numShards, m_useAsyncBuffer ? ", pipelined" : "");
+    }
+
+    ~MPIParameterServerHelper()
+    {
+        WaitAsyncBuffer();
+        MPI_Win_unlock_all(m_window) || MpiFail("MPIParameterServerHelper: MPI_Win_unlock_all");
+        MPI_Win_free(&m_window) || MpiFail("MPIParameterServerHelper: MPI_Win_free");
+    }
+
+    // all workers start from the average of their models
+    void InitModel(const std::list<ComputationNodeBasePtr> & learnableNodes) override
+    {
+        CopyFromModel(learnableNodes, m_pullArray);
+        ElemType factor = (ElemType)1 / m_pMPI->NumNodesInUse();
+        for (auto& x : m_pullArray)
+            x *= factor;
+        m_pMPI->AllReduce(m_pullArray.data(), m_totalModelSize);
+
+        size_t myRank = m_pMPI->CurrentNodeRank();
+        std::copy(m_pullArray.begin() + m_shardOffsets[myRank], m_pullArray.begin() + m_shardOffsets[myRank + 1], m_shard);
+        MPI_Win_sync(m_window) || MpiFail("MPIParameterServerHelper: MPI_Win_sync");
+        WaitAll();
+
+        m_baselineArray = m_pullArray;
+        CopyToModel(m_baselineArray, learnableNodes);
+        m_reportTimer.Start();
+    }
+
+    bool PushAndPullModel(const std::list<ComputationNodeBasePtr> & learnableNodes, size_t /*sampleSinceLastSynced*/) override
+    {
+        m_parameterSyncCounter++;
+        Timer commTimer;
+        commTimer.Start();
+        WaitAsyncBuffer(); // (the previous push and pull)
+        commTimer.Stop();
+        double secondsOnCommunication = commTimer.ElapsedSeconds();
+
+        // delta = (model - baseline) * factor
+        float factor = m_ModelAveragingSGDSimulating ? 1.0f / m_pMPI->NumNodesInUse()
+                                                     : LearningRateDecayCoefficient(m_adjustLearningRateAtBeginningType, m_adjustCoefficient, m_adjustMBNumber, m_parameterSyncCounter);
+        CopyFromModel(learnableNodes, m_deltaArray);
+        bool firstPipelinedSync = m_useAsyncBuffer && !m_pullPending;
+        for (size_t i = 0; i < m_totalModelSize; i++)
+        {
+            ElemType model = m_deltaArray[i];
+            m_deltaArray[i] = (model - m_baselineArray[i]) * factor;
+            if (firstPipelinedSync)
+                m_baselineArray[i] = model;
+        }
+
+        // pipelined: continue on the model pulled at the previous sync point
+        if (m_pullPending)
+        {
+            m_baselineArray = m_pullArray;
+            CopyToModel(m_baselineArray, learnableNodes);
+            m_pullPending = false;
+        }
+
+        commTimer.Restart();
+        Push();
+        if (m_ModelAveragingSGDSimulating)
+        {
+            // the average is complete once all workers have pushed
+            WaitAsyncBuffer();
+            WaitAll();
+        }
+        Pull();
+        m_pullPending = true;
+
+        if (!m_useAsyncBuffer)
+        {
+            WaitAsyncBuffer();
+            m_baselineArray = m_pullArray;
+            CopyToModel(m_baselineArray, learnableNodes);
+            m_pullPending = false;
+        }
+        commTimer.Stop();
+        secondsOnCommunication += commTimer.ElapsedSeconds();
+
+        if (m_traceLevel > 2 && m_syncPerfStats > 0 && m_parameterSyncCounter % m_syncPerfStats == 0)
+        {
+            m_reportTimer.Stop();
+            fprintf(stderr, "\t\t(MPI parameter server stats) %d-th sync: %8.2f seconds since last report (%.2f seconds waiting for the parameter server)\n",
+                    (int)m_parameterSyncCounter, m_reportTimer.ElapsedSeconds(), secondsOnCommunication);
+            m_reportTimer.Restart();
+        }
+        return true;
+    }
+
+    void WaitAll() override
+    {
+        m_pMPI->WaitAll();
+    }
+
+    void WaitAsyncBuffer() override
+    {
+        if (!m_requests.empty())
+        {
+            m_pMPI->WaitAll(m_requests);
+            m_requests.clear();
+        }
+    }
+
+private:
+    size_t ShardLength(size_t rank) const
+    {
+        return m_shardOffsets[rank + 1] - m_shardOffsets[rank];
+    }
+
+    void Push()
+    {
+        MPI_Datatype dataType = MPIWrapper::GetDataType(m_deltaArray.data());
+        for (size_t r = 0; r < m_shardOffsets.size() - 1; r++)
+        {
+            int length = (int)ShardLength(r);
+            if (length == 0)
+                continue;
+            m_requests.push_back(MPI_Request());
+            MPI_Raccumulate(m_deltaArray.data() + m_shardOffsets[r], length, dataType, (int)r, 0, length, dataType, MPI_SUM, m_window, &m_requests.back())
+                || MpiFail("MPIParameterServerHelper: MPI_Raccumulate");
+        }
+    }
+
+    void Pull()
+    {
+        MPI_Datatype dataType = MPIWrapper::GetDataType(m_pullArray.data());
+        for (size_t r = 0; r < m_shardOffsets.size() - 1; r++)
+        {
+            int length = (int)ShardLength(r);
+            if (length == 0)
+                continue;
+            m_requests.push_back(MPI_Request());
+            MPI_Rget_accumulate(nullptr, 0, dataType, m_pullArray.data() + m_shardOffsets[r], length, dataType, (int)r, 0, length, dataType, MPI_NO_OP, m_window, &m_requests.back())
+                || MpiFail("MPIParameterServerHelper: MPI_Rget_accumulate");
+        }
+    }
+
+    void CopyFromModel(const std::list<ComputationNodeBasePtr> & learnableNodes, std::vector<ElemType>& array)
+    {
+        size_t i = 0; // indicate the index of learnable nodes
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        {
+            ElemType* px = array.data() + m_tableOffsets[i];
+            DownCast(*nodeIter)->Value().CopyToArray(px, m_tableLength[i]);
+        }
+    }
+
+    void CopyToModel(const std::vector<ElemType>& array, const std::list<ComputationNodeBasePtr> & learnableNodes)
+    {
+        size_t i = 0;
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        {
+            Matrix<ElemType>& mat = DownCast(*nodeIter)->Value();
+            mat.SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), const_cast<ElemType*>(array.data()) + m_tableOffsets[i]);
+        }
+    }
+
+    static ComputationNodePtr DownCast(const ComputationNodeBasePtr& node)
+    {
+        ComputationNodePtr result = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+        if (!result)
+            InvalidArgument("MPIParameterServerHelper: A learnable node of mismatching precision was passed.");
+        return result;
+    }
+
+    MPIWrapperPtr m_pMPI;
+    bool m_useAsyncBuffer;
+    bool m_ModelAveragingSGDSimulating;
+    AdjustLearningRateAtBeginning m_adjustLearningRateAtBeginningType;
+    double m_adjustCoefficient;
+    size_t m_adjustMBNumber;
+    int m_traceLevel;
+    int m_syncPerfStats;
+    Timer m_reportTimer;
+    size_t m_parameterSyncCounter;
+    bool m_pullPending; // m_pullArray receives a model that is not applied yet
+
+    vector<size_t> m_tableLength;
+    vector<size_t> m_tableOffsets;
+    size_t m_totalModelSize;
+    vector<size_t> m_shardOffsets;   // per rank, and the total at the end
+
+    std::vector<ElemType> m_baselineArray; // the model as of the last pull that was applied
+    std::vector<ElemType> m_deltaArray;    // being pushed
+    std::vector<ElemType> m_pullArray;     // being pulled
+    std::vector<MPI_Request> m_requests;   // of the pushes and pulls in flight
+
+    ElemType* m_shard;                     // the shard served by this rank, in m_window
+    MPI_Win m_window;
+};  // Class MPIParameterServerHelper
+
 // A None implementation of ASGDHelper interface which does nothing
 // This is used when CNTK_ENABLE_ASGD = false
 template<class ElemType = float>
@@ -634,8 +886,13 @@ ASGDHelper<ElemType>* NewASGDHelper(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats) 
+    int syncPerfStats,
+    const MPIWrapperPtr& pMPI,
+    bool useMPIParameterServer)
 {
+    if (useMPIParameterServer)
+        return new MPIParameterServerHelper<ElemType>(learnableNodes, pMPI, useAsyncBuffer, isSimulatedModelAveragingSGD,
+                                                      adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats);
 #ifdef ASGD_PARALLEL_SUPPORT
     return new MultiversoHelper<ElemType>(learnableNodes, nodeNumRanks, useAsyncBuffer, isSimulatedModelAveragingSGD, 
                                       adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats);
@@ -654,7 +911,9 @@ template ASGDHelper<float>* NewASGDHelper<float>(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats); 
+    int syncPerfStats,
+    const MPIWrapperPtr& pMPI,
+    bool useMPIParameterServer);
 
 template ASGDHelper<double>* NewASGDHelper<double>(
     const std::list<ComputationNodeBasePtr> & learnableNodes,
@@ -665,6 +924,8 @@ template ASGDHelper<double>* NewASGDHelper<double>(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats); 
+    int syncPerfStats,
+    const MPIWrapperPtr& pMPI,
+    bool useMPIParameterServer);
 
 }}} 
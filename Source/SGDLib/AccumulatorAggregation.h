@@ -96,6 +96,26 @@ void AggregateAccumulatorValuesAndUpdateEvaluation(
     net->ForwardProp(evalNodesWhichAccumulateResult);
 }
 
+// Sums criteria that each worker computed over its part of the data set. Criteria of nodes that accumulate results
+// are summed as well, but only become meaningful through AggregateAccumulatorValuesAndUpdateEpochEvaluation().
+inline void AggregateEpochCriteria(std::vector<EpochCriterion>& criteria, const std::shared_ptr<MPIWrapper>& mpi)
+{
+    if (criteria.empty())
+        return;
+
+    std::vector<double> values;
+    std::vector<size_t> counts;
+    for (const auto& criterion : criteria)
+    {
+        values.push_back(criterion.first);
+        counts.push_back(criterion.second);
+    }
+    mpi->AllReduce(values.data(), values.size());
+    mpi->AllReduce(counts.data(), counts.size());
+    for (size_t i = 0; i < criteria.size(); i++)
+        criteria[i] = EpochCriterion(values[i], counts[i]);
+}
+
 template <typename ElemType>
 void UpdateEpochEvaluationForAccumulatedResult(
     std::vector<EpochCriterion>& epochEvalErrors,
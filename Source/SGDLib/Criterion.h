@@ -110,6 +110,11 @@ struct CriterionAccumulator
             return EpochCriterion(m_aggregateCriterionValues->GetValue(0, i), m_aggregateSampleCounts[i]);
     }
 
+    // the accumulated values as they are, on the device, e.g. for fetching them asynchronously (see CriterionFetcher)
+    // Values whose count is 0 are invalid.
+    const Matrix<ElemType>& GetAggregateCriterionValues() const { return *m_aggregateCriterionValues; }
+    const vector<size_t>& GetAggregateSampleCounts() const { return m_aggregateSampleCounts; }
+
 private:
     // shared part of Add() and Assign()
     // This code assumes that if number of samples is 0, the criterion value is invalid and must not be fetched from the GPU or otherwise looked at.
@@ -0,0 +1,150 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CriterionFetcher.h -- fetching accumulated criteria from the GPU without stalling it
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "Criterion.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "GPUDataTransferer.h"
+#include "MatrixQuantizerImpl.h"
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Fetches the values of CriterionAccumulators to the CPU for progress tracing, without waiting for the GPU.
+// Fetch() snapshots the accumulated values on the device, in stream order so that the accumulation can go on with the
+// next minibatch, and starts the copy of the snapshot into one slot of a ring of pinned CPU buffers. The snapshots are
+// taken out in the order they were fetched: by TryTake() only once their copy has arrived, by Take() waiting for it.
+// On the CPU there is nothing to overlap, and the values are read at Fetch().
+template <class ElemType>
+class CriterionFetcher
+{
+public:
+    CriterionFetcher(DEVICEID_TYPE deviceId, size_t numSlots = 4)
+        : m_deviceId(deviceId), m_slots(numSlots), m_numFetched(0), m_numTaken(0)
+    {
+        if (numSlots == 0)
+            InvalidArgument("CriterionFetcher: At least one slot is needed.");
+        if (deviceId != CPUDEVICE)
+            m_allocator = std::make_unique<CUDAPageLockedMemAllocator>(deviceId);
+    }
+
+    size_t NumSlots() const { return m_slots.size(); }
+    // number of snapshots fetched and not taken yet; Fetch() needs one of the slots free
+    size_t NumPending() const { return m_numFetched - m_numTaken; }
+    bool CanFetch() const { return NumPending() < m_slots.size(); }
+
+    // Starts fetching the current values of the accumulators, which are returned concatenated.
+    void Fetch(const std::vector<const CriterionAccumulator<ElemType>*>& accumulators)
+    {
+        if (!CanFetch())
+            LogicError("CriterionFetcher: All slots are in flight, take a snapshot first.");
+        auto& slot = m_slots[m_numFetched % m_slots.size()];
+
+        slot.m_sampleCounts.clear();
+        for (const auto* accumulator : accumulators)
+            slot.m_sampleCounts.insert(slot.m_sampleCounts.end(), accumulator->GetAggregateSampleCounts().begin(), accumulator->GetAggregateSampleCounts().end());
+        size_t numValues = slot.m_sampleCounts.size();
+
+        if (m_deviceId == CPUDEVICE)
+        {
+            slot.m_hostValues.clear();
+            for (const auto* accumulator : accumulators)
+            {
+                const auto& values = accumulator->GetAggregateCriterionValues();
+                for (size_t i = 0; i < values.GetNumCols(); i++)
+                    slot.m_hostValues.push_back(accumulator->GetAggregateSampleCounts()[i] > 0 ? values.GetValue(0, i) : 0);
+            }
+        }
+        else if (numValues > 0)
+        {
+            if (!slot.m_deviceValues || slot.m_deviceValues->GetNumCols() != numValues)
+            {
+                slot.m_deviceValues = std::make_shared<Matrix<ElemType>>(1, numValues, m_deviceId);
+                slot.m_pinnedValues = AllocatePinnedBuffer(numValues);
+                slot.m_transferer = std::make_unique<GPUDataTransferer>(m_deviceId, /*useConcurrentStreams=*/true);
+            }
+            size_t offset = 0;
+            for (const auto* accumulator : accumulators)
+            {
+                const auto& values = accumulator->GetAggregateCriterionValues();
+                if (values.GetNumCols() > 0)
+                    slot.m_deviceValues->ColumnSlice(offset, values.GetNumCols()).SetValue(values);
+                offset += values.GetNumCols();
+            }
+            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(m_deviceId));
+            mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+            slot.m_transferer->CopyGPUToCPUAsync(slot.m_deviceValues->Data(), numValues, slot.m_pinnedValues.get());
+        }
+        m_numFetched++;
+    }
+
+    // Takes the oldest snapshot if its copy has arrived. Returns false if there is none or it is still in flight.
+    bool TryTake(std::vector<EpochCriterion>& criteria)
+    {
+        if (NumPending() == 0)
+            return false;
+        const auto& slot = OldestSlot();
+        if (m_deviceId != CPUDEVICE && slot.m_transferer && !slot.m_sampleCounts.empty() && !slot.m_transferer->IsCopyGPUToCPUAsyncComplete())
+            return false;
+        Take(criteria);
+        return true;
+    }
+
+    // Takes the oldest snapshot, waiting for its copy to arrive.
+    void Take(std::vector<EpochCriterion>& criteria)
+    {
+        if (NumPending() == 0)
+            LogicError("CriterionFetcher: There is no snapshot to take.");
+        const auto& slot = OldestSlot();
+        bool onDevice = m_deviceId != CPUDEVICE && !slot.m_sampleCounts.empty();
+        if (onDevice)
+            slot.m_transferer->WaitForCopyGPUToCPUAsync();
+
+        criteria.resize(slot.m_sampleCounts.size());
+        for (size_t i = 0; i < criteria.size(); i++)
+        {
+            // as CriterionAccumulator::GetCriterion(): a value without samples is invalid
+            if (slot.m_sampleCounts[i] == 0)
+                criteria[i] = EpochCriterion(0, 0);
+            else
+                criteria[i] = EpochCriterion(onDevice ? (double)slot.m_pinnedValues.get()[i] : slot.m_hostValues[i], slot.m_sampleCounts[i]);
+        }
+        m_numTaken++;
+    }
+
+private:
+    struct Slot
+    {
+        std::vector<size_t> m_sampleCounts;               // known on the CPU at Fetch()
+        std::shared_ptr<Matrix<ElemType>> m_deviceValues; // [1 x N] snapshot of the accumulators on the device
+        std::shared_ptr<ElemType> m_pinnedValues;         // [N] its copy in pinned memory
+        std::unique_ptr<GPUDataTransferer> m_transferer;
+        std::vector<double> m_hostValues;                 // [N] the values read right away, on the CPU
+    };
+
+    Slot& OldestSlot() { return m_slots[m_numTaken % m_slots.size()]; }
+
+    std::shared_ptr<ElemType> AllocatePinnedBuffer(size_t numElements)
+    {
+        CUDAPageLockedMemAllocator* allocator = m_allocator.get();
+        return std::shared_ptr<ElemType>((ElemType*) allocator->Malloc(sizeof(ElemType) * numElements), [allocator](ElemType* p)
+                                         {
+                                             allocator->Free(p);
+                                         });
+    }
+
+    DEVICEID_TYPE m_deviceId;
+    std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator; // declared before the slots, whose buffers it frees
+    std::vector<Slot> m_slots;
+    size_t m_numFetched;
+    size_t m_numTaken;
+};
+
+}}}
@@ -527,7 +527,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             }
         }
 
-        void GetSubMinibatchToNet(size_t iSubminibatch)
+        // With 'keepState', the state of the stateful nodes is kept, to start the sub-minibatch over from it (pipeline parallelism).
+        void GetSubMinibatchToNet(size_t iSubminibatch, bool keepState = false)
         {
             Matrices decimatedMatrices;
             MBLayoutPtr decimatedLayout;
@@ -561,11 +562,25 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 auto& pNode         = x.second;
                 if (m_netStates[name][iSubminibatch])
                     pNode->ImportState(std::move(m_netStates[name][iSubminibatch]));
+                if (keepState)
+                    m_netStates[name][iSubminibatch] = pNode->ExportState();
+            }
+        }
+
+        // accumulate the values of the evaluation nodes for the current sub-minibatch
+        void AccumulateEvaluation()
+        {
+            for (size_t i = 0; i < m_netEvaluationNodes.size(); i++)
+            {
+                Matrix<ElemType>::AddElementToElement(m_netEvaluationNodes[i]->Value(), 0, 0,
+                                                      *m_netEvaluationAccumulator, 0, i);
+                m_netEvaluationNodes[i]->Value().SetValue(0);
             }
         }
 
         // TODO: encapsulate it into a destructor? Note: Cannot throw exceptions in destructor.
-        void DoneWithCurrentSubMinibatch(size_t iSubminibatch)
+        // 'accumulateEvaluation' is false if AccumulateEvaluation() was called for it already.
+        void DoneWithCurrentSubMinibatch(size_t iSubminibatch, bool accumulateEvaluation = true)
         {
             // accumulate gradient here
             for (auto x : m_cachedGradient)
@@ -587,12 +602,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 m_netCriterionNodes[0]->Value().SetValue(0);
             }
             // accumulate evaluation value
-            for (size_t i = 0; i < m_netEvaluationNodes.size(); i++)
-            {
-                Matrix<ElemType>::AddElementToElement(m_netEvaluationNodes[i]->Value(), 0, 0,
-                                                      *m_netEvaluationAccumulator, 0, i);
-                m_netEvaluationNodes[i]->Value().SetValue(0);
-            }
+            if (accumulateEvaluation)
+                AccumulateEvaluation();
 
             // Export node state
             for (auto& x : m_netStatefulNodes)
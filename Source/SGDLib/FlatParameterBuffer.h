@@ -0,0 +1,151 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// FlatParameterBuffer.h -- the dense parameters, their gradients and smoothed gradients in one contiguous buffer each
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "ComputationNode.h"
+#include "InputAndParamNodes.h"
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Moves the values and gradients of the dense parameters that are updated into one [1 x N] matrix each, and keeps
+// their smoothed gradients in a third one, so that operations over all parameters (all-reduce, norms, moving averages,
+// checkpoint copies) can be done on one large matrix instead of hundreds of small ones.
+// The nodes are left with views into the buffers (ColumnSlice(), which share the storage of the buffer, so that the
+// memory stays valid as long as any node uses it). A node may still replace its gradient later on, e.g. TimesNode
+// by a block-sparse one at its first backprop; AreGradientsBound() tells whether the gradient buffer is still complete.
+// Must be created after the matrices of the network have been allocated, since the gradients are rebound.
+template <class ElemType>
+class FlatParameterBuffer
+{
+public:
+    // 'stateSize' is the number of smoothed gradient vectors per parameter element, see MultiTensorUpdateStateSize().
+    FlatParameterBuffer(const std::list<ComputationNodeBasePtr>& learnableNodes, size_t stateSize, DEVICEID_TYPE deviceId)
+        : m_stateSize(stateSize), m_numElements(0)
+    {
+        if (stateSize == 0)
+            InvalidArgument("FlatParameterBuffer: The smoothed gradient needs at least one vector per element.");
+
+        for (const auto& nodeBase : learnableNodes)
+        {
+            auto node = std::dynamic_pointer_cast<ComputationNode<ElemType>>(nodeBase);
+            if (!std::dynamic_pointer_cast<LearnableParameter<ElemType>>(nodeBase) || !node->IsParameterUpdateRequired() || !node->ValuePtr() || !node->GradientPtr())
+                continue;
+            if (node->Value().GetMatrixType() != DENSE || node->Gradient().GetMatrixType() != DENSE || node->Value().GetDeviceId() != deviceId)
+                continue;
+            m_indices[nodeBase] = m_nodes.size();
+            m_nodes.push_back(node);
+            m_offsets.push_back(m_numElements);
+            m_numElements += AlignedNumElements(node->Value().GetNumElements());
+        }
+
+        m_values = std::make_shared<Matrix<ElemType>>(1, m_numElements, deviceId);
+        m_gradients = std::make_shared<Matrix<ElemType>>(1, m_numElements, deviceId);
+        m_states = std::make_shared<Matrix<ElemType>>(1, m_stateSize * m_numElements, deviceId);
+        m_values->SetValue(0); // (including the padding between the parameters)
+        m_gradients->SetValue(0);
+        m_states->SetValue(0);
+
+        for (size_t k = 0; k < m_nodes.size(); k++)
+        {
+            auto& node = m_nodes[k];
+            auto value = std::make_shared<Matrix<ElemType>>(View(*m_values, m_offsets[k], node->Value().GetNumRows(), node->Value().GetNumCols()));
+            value->SetValue(node->Value());
+            node->ValuePtrRef() = value;
+            node->GradientPtrRef() = std::make_shared<Matrix<ElemType>>(View(*m_gradients, m_offsets[k], value->GetNumRows(), value->GetNumCols()));
+            m_gradientViews.push_back(node->GradientPtrRef().get());
+        }
+    }
+
+    size_t NumNodes() const { return m_nodes.size(); }
+    size_t GetNumElements() const { return m_numElements; }
+
+    bool Contains(const ComputationNodeBasePtr& node) const { return m_indices.find(node) != m_indices.end(); }
+
+    // whether every node still has its gradient in the buffer
+    bool AreGradientsBound() const
+    {
+        for (size_t k = 0; k < m_nodes.size(); k++)
+        {
+            if (m_nodes[k]->GradientPtr().get() != m_gradientViews[k])
+                return false;
+        }
+        return true;
+    }
+
+    // whether every node still has its value in the buffer (not e.g. while SGD has swapped in the moving averages)
+    bool AreValuesBound() const
+    {
+        for (size_t k = 0; k < m_nodes.size(); k++)
+        {
+            if (m_nodes[k]->Value().Data() != m_values->Data() + m_offsets[k])
+                return false;
+        }
+        return true;
+    }
+
+    Matrix<ElemType>& Values() { return *m_values; }
+    Matrix<ElemType>& Gradients() { return *m_gradients; }
+    Matrix<ElemType>& States() { return *m_states; }
+
+    // the smoothed gradient of a node in the buffer, with the rows of the value and m_stateSize times its columns
+    Matrix<ElemType> StateOf(const ComputationNodeBasePtr& node) const
+    {
+        auto iter = m_indices.find(node);
+        if (iter == m_indices.end())
+            LogicError("FlatParameterBuffer: %ls is not in the buffer.", node->NodeName().c_str());
+        size_t k = iter->second;
+        return View(*m_states, m_stateSize * m_offsets[k], m_nodes[k]->Value().GetNumRows(), m_stateSize * m_nodes[k]->Value().GetNumCols());
+    }
+
+    // Given 'buffer', one of the buffers, and a copy of it, e.g. on the CPU, returns the part of the copy that corresponds to 'view' of the buffer.
+    static Matrix<ElemType> CorrespondingView(const Matrix<ElemType>& buffer, const Matrix<ElemType>& copyOfBuffer, const Matrix<ElemType>& view)
+    {
+        if (!IsViewOf(buffer, view) || copyOfBuffer.GetNumElements() != buffer.GetNumElements())
+            LogicError("FlatParameterBuffer: The matrix is not a view of the buffer.");
+        return View(copyOfBuffer, view.Data() - buffer.Data(), view.GetNumRows(), view.GetNumCols());
+    }
+
+    static bool IsViewOf(const Matrix<ElemType>& buffer, const Matrix<ElemType>& view)
+    {
+        return view.GetMatrixType() == DENSE && view.GetDeviceId() == buffer.GetDeviceId() &&
+               view.Data() >= buffer.Data() && view.Data() + view.GetNumElements() <= buffer.Data() + buffer.GetNumElements();
+    }
+
+private:
+    // each parameter starts at a multiple of 256 bytes, like a separate allocation would
+    static size_t AlignedNumElements(size_t numElements)
+    {
+        const size_t alignment = std::max<size_t>(1, 256 / sizeof(ElemType));
+        return (numElements + alignment - 1) / alignment * alignment;
+    }
+
+    static Matrix<ElemType> View(const Matrix<ElemType>& buffer, size_t offset, size_t numRows, size_t numCols)
+    {
+        Matrix<ElemType> view = buffer.ColumnSlice(offset, numRows * numCols);
+        view.Reshape(numRows, numCols);
+        return view;
+    }
+
+    std::vector<std::shared_ptr<ComputationNode<ElemType>>> m_nodes;
+    std::map<ComputationNodeBasePtr, size_t> m_indices; // into m_nodes
+    std::vector<size_t> m_offsets;                  // of each node in the value and gradient buffers; m_stateSize times that in the state buffer
+    std::vector<const Matrix<ElemType>*> m_gradientViews;
+    size_t m_stateSize;
+    size_t m_numElements;
+    std::shared_ptr<Matrix<ElemType>> m_values;     // [1 x m_numElements]
+    std::shared_ptr<Matrix<ElemType>> m_gradients;  // [1 x m_numElements]
+    std::shared_ptr<Matrix<ElemType>> m_states;     // [1 x m_stateSize * m_numElements]
+};
+
+}}}
@@ -19,6 +19,18 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) = 0;
 
+    // Overlapping the aggregation with backprop: if BeginOverlappedAggregation() returns true, backprop is to call
+    // OnGradientComplete() for each of the gradients as soon as it is final, which may start its reduction already;
+    // the following AggregateGradients() completes the aggregation. Aggregators that do not overlap return false.
+    virtual bool BeginOverlappedAggregation(const std::vector<Matrix<ElemType>*>& /*gradients*/)
+    {
+        return false;
+    }
+
+    virtual void OnGradientComplete(const Matrix<ElemType>* /*gradient*/)
+    {
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
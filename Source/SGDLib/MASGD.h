@@ -10,6 +10,7 @@
 #include "Config.h"
 #include "SGD.h"
 #include "Matrix.h"
+#include "MatrixQuantizerImpl.h"
 #include "MPIWrapper.h"
 #include "TimerUtility.h"
 #include <vector>
@@ -324,18 +325,26 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 
     // Implementation of standard model averaging 
+    // With numModelBits below the precision of ElemType, the workers do not exchange their models but the weighted change
+    // of their models since the last sync, quantized with error feedback (see QuantizedModelAggregation()).
     template<typename ElemType>
     class BasicModelAveragingSGD : public IMASGD<ElemType>
     {
         typedef IMASGD<ElemType> Base; 
+        typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
         using Base::m_pMPI;
+        using Base::m_numWorkers;
         using Base::DownCast;
 
     public:
-        BasicModelAveragingSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID)
-            : Base(pMPI, reportFreq, devID)
+        BasicModelAveragingSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID,
+                               int numModelBits = 8 * sizeof(ElemType), bool zeroThresholdFor1Bit = true)
+            : Base(pMPI, reportFreq, devID), m_numModelBits(numModelBits), m_zeroThresholdFor1Bit(zeroThresholdFor1Bit), m_delta(CPUDEVICE)
         {
-            fprintf(stderr, "Parallel training (%d workers) using ModelAveraging\n",(int)m_pMPI->NumNodesInUse());
+            if (IsQuantized())
+                fprintf(stderr, "Parallel training (%d workers) using ModelAveraging with %d-bit quantized model updates\n", (int)m_pMPI->NumNodesInUse(), m_numModelBits);
+            else
+                fprintf(stderr, "Parallel training (%d workers) using ModelAveraging\n",(int)m_pMPI->NumNodesInUse());
         }
 
         void ModelAggregationProcessing(
@@ -375,6 +384,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             //----------------------------------------
             // 2. process for each individual node
             //----------------------------------------
+            if (IsQuantized())
+            {
+                QuantizedModelAggregation(factor, learnableNodes, secondsOnCommunication);
+                return;
+            }
             for (auto& pBaseNode : learnableNodes)
             {
                 if (!pBaseNode->IsParameterUpdateRequired())
@@ -402,6 +416,239 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 //delete[]px;
             }
         }
+
+    private:
+        bool IsQuantized() const
+        {
+            return m_numModelBits < 8 * sizeof(ElemType);
+        }
+
+        // Each worker quantizes the weighted change of its model since the last sync (plus the residual, i.e. what its
+        // quantization dropped at the previous syncs) and all-gathers it. All workers add the same unquantized changes, in
+        // the same order, to the same reference model (the result of the last sync), so the models stay identical.
+        // The quantization runs on the CPU, where the buffers are sent from anyway.
+        void QuantizedModelAggregation(float factor, const std::list<ComputationNodeBasePtr>& learnableNodes, float& secondsOnCommunication)
+        {
+            std::vector<ComputationNodePtr> nodes;
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (pBaseNode->IsParameterUpdateRequired())
+                    nodes.push_back(DownCast(pBaseNode));
+            }
+            if (!m_quantizer)
+                m_quantizer.reset(MatrixQuantizerImpl<ElemType>::Create(CPUDEVICE, /*useAsync=*/false));
+            if (m_references.size() != nodes.size()) // first sync, or the set of parameters changed
+            {
+                m_references.clear();
+                m_residuals.clear();
+                m_quantized.clear();
+            }
+
+            Timer commTimer;
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                Matrix<ElemType>& value = nodes[i]->Value();
+                size_t numRows = value.GetNumRows();
+                size_t numCols = value.GetNumCols();
+                m_delta.Resize(numRows, numCols);
+                ElemType* px = m_delta.Data();
+                size_t nx = m_delta.GetNumElements();
+                value.CopyToArray(px, nx);
+
+                if (i >= m_references.size())
+                {
+                    // no common reference yet: average the models at full precision once
+                    Matrix<ElemType>::Scale(factor, m_delta);
+                    commTimer.Restart();
+                    m_pMPI->AllReduce(px, nx);
+                    commTimer.Stop();
+                    secondsOnCommunication += (float)commTimer.ElapsedSeconds();
+                    m_references.push_back(std::make_unique<Matrix<ElemType>>(m_delta.DeepClone()));
+                    m_residuals.push_back(std::make_unique<Matrix<ElemType>>(Matrix<ElemType>::Zeros(numRows, numCols, CPUDEVICE)));
+                    m_quantized.push_back(std::make_unique<QuantizedMatrix<ElemType>>(numRows, numCols, m_numModelBits, CPUDEVICE));
+                }
+                else
+                {
+                    Matrix<ElemType>& reference = *m_references[i];
+                    Matrix<ElemType>& residual = *m_residuals[i];
+                    QuantizedMatrix<ElemType>& quantized = *m_quantized[i];
+                    m_delta -= reference;
+                    Matrix<ElemType>::Scale(factor, m_delta);
+                    m_quantizer->QuantizeAsync(m_delta, residual, quantized, residual, m_zeroThresholdFor1Bit);
+                    m_quantizer->WaitQuantizeAsyncDone();
+
+                    size_t size = quantized.GetSize();
+                    m_gathered.resize(size * m_numWorkers);
+                    commTimer.Restart();
+                    m_pMPI->AllGather(quantized.Buffer(), size, m_gathered.data(), size);
+                    commTimer.Stop();
+                    secondsOnCommunication += (float)commTimer.ElapsedSeconds();
+
+                    for (size_t worker = 0; worker < m_numWorkers; worker++)
+                    {
+                        memcpy(quantized.Buffer(), m_gathered.data() + worker * size, size);
+                        m_quantizer->UnquantizeAsync(quantized, reference, /*add=*/true);
+                        m_quantizer->WaitUnquantizeAsyncDone();
+                    }
+                }
+                value.SetValue(numRows, numCols, value.GetDeviceId(), m_references[i]->Data());
+            }
+        }
+
+        int m_numModelBits;
+        bool m_zeroThresholdFor1Bit;
+        std::unique_ptr<MatrixQuantizerImpl<ElemType>> m_quantizer;
+        std::vector<std::unique_ptr<Matrix<ElemType>>> m_references;          // the model after the last sync, per parameter (on the CPU)
+        std::vector<std::unique_ptr<Matrix<ElemType>>> m_residuals;           // quantization error carried to the next sync
+        std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>> m_quantized;
+        std::vector<char> m_gathered;                                         // the quantized changes of all workers
+        Matrix<ElemType> m_delta;                                             // (scratch)
+    };
+
+    // Model averaging with the all-reduce overlapped with training: at a sync point, the weighted local models are
+    // all-reduced in the background while the worker trains the next block. At the following sync point, the average
+    // is waited for and the worker's progress since the snapshot is kept on top of it, i.e. W += average - snapshot.
+    // The models thus lag one block behind the average; at the end of the epoch, the models are averaged synchronously
+    // so that all workers end the epoch with the same model.
+    template<typename ElemType>
+    class OverlappedModelAveragingSGD : public IMASGD<ElemType>
+    {
+        typedef IMASGD<ElemType> Base;
+        typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+        using Base::m_pMPI;
+        using Base::m_MAworkerStatus;
+        using Base::m_myRank;
+        using Base::DownCast;
+
+    public:
+        OverlappedModelAveragingSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID)
+            : Base(pMPI, reportFreq, devID), m_aggregationPending(false), m_average(devID)
+        {
+            fprintf(stderr, "Parallel training (%d workers) using ModelAveraging, overlapping the aggregation with training\n", (int)m_pMPI->NumNodesInUse());
+        }
+
+        ~OverlappedModelAveragingSGD()
+        {
+            // the buffers must outlive a pending reduction
+            if (m_aggregationPending)
+                m_pMPI->WaitAll(m_requests);
+        }
+
+        void ModelAggregationProcessing(
+            size_t samplesSinceLastSync,                                       /* in */
+            const std::list<ComputationNodeBasePtr>&  learnableNodes,          /* in/out */
+            std::list<Matrix<ElemType>>&              /*smoothedGradient*/,    /* in/out */
+            size_t&                                   totalSamplesProcessed,   /* out */
+            float&                                    secondsOnCommunication   /* out */) override
+        {
+            Timer commTimer;
+            secondsOnCommunication = 0.0f;
+
+            auto nodes = ParameterNodes(learnableNodes);
+
+            //----------------------------------------
+            // 1. apply the average of the previous block
+            //----------------------------------------
+            if (m_aggregationPending)
+            {
+                commTimer.Start();
+                m_pMPI->WaitAll(m_requests);
+                commTimer.Stop();
+                secondsOnCommunication += (float)commTimer.ElapsedSeconds();
+                m_aggregationPending = false;
+
+                if (nodes.size() != m_snapshots.size())
+                    LogicError("OverlappedModelAveragingSGD: The set of learnable parameters changed while an aggregation was pending.");
+                for (size_t i = 0; i < nodes.size(); i++)
+                {
+                    Matrix<ElemType>& value = nodes[i]->Value();
+                    m_average.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), m_buffers[i].data());
+                    value += m_average;
+                    value -= *m_snapshots[i];
+                }
+            }
+
+            //----------------------------------------
+            // 2. communicate with other nodes to negotiate contribution weights
+            //----------------------------------------
+            float factor = 0;
+            int   nTotalSamples = samplesSinceLastSync;
+            commTimer.Restart();
+            m_pMPI->AllReduce(&nTotalSamples, 1);
+            commTimer.Stop();
+            secondsOnCommunication += (float)commTimer.ElapsedSeconds();
+
+            if (nTotalSamples <= 0)
+            {
+                factor = 1.0f / m_pMPI->NumNodesInUse();
+                totalSamplesProcessed = samplesSinceLastSync * m_pMPI->NumNodesInUse();
+            }
+            else
+            {
+                factor = (samplesSinceLastSync + 0.0f) / nTotalSamples;
+                totalSamplesProcessed = nTotalSamples;
+            }
+
+            //----------------------------------------
+            // 3. all-reduce the weighted models; at the end of the epoch, wait for it
+            //----------------------------------------
+            bool lastSync = (m_MAworkerStatus[m_myRank] == MAWorkerStatus::DataEnd);
+            m_snapshots.resize(nodes.size());
+            m_buffers.resize(nodes.size());
+            m_requests.resize(nodes.size());
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                const Matrix<ElemType>& value = nodes[i]->Value();
+                if (!lastSync)
+                {
+                    if (!m_snapshots[i])
+                        m_snapshots[i] = std::make_unique<Matrix<ElemType>>(value.GetDeviceId());
+                    m_snapshots[i]->SetValue(value);
+                }
+                m_average.SetValue(value);
+                Matrix<ElemType>::Scale(factor, m_average);
+                m_buffers[i].resize(m_average.GetNumElements());
+                ElemType* px = m_buffers[i].data();
+                size_t nx = m_buffers[i].size();
+                m_average.CopyToArray(px, nx);
+                m_pMPI->AllReduceAsync(px, nx, &m_requests[i]);
+            }
+
+            if (!lastSync)
+            {
+                m_aggregationPending = !nodes.empty();
+                return;
+            }
+
+            commTimer.Restart();
+            if (!nodes.empty())
+                m_pMPI->WaitAll(m_requests);
+            commTimer.Stop();
+            secondsOnCommunication += (float)commTimer.ElapsedSeconds();
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                Matrix<ElemType>& value = nodes[i]->Value();
+                value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), m_buffers[i].data());
+            }
+        }
+
+    private:
+        std::vector<ComputationNodePtr> ParameterNodes(const std::list<ComputationNodeBasePtr>& learnableNodes)
+        {
+            std::vector<ComputationNodePtr> nodes;
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (pBaseNode->IsParameterUpdateRequired())
+                    nodes.push_back(DownCast(pBaseNode));
+            }
+            return nodes;
+        }
+
+        bool m_aggregationPending;
+        std::vector<std::unique_ptr<Matrix<ElemType>>> m_snapshots; // local models at the last sync point, per parameter
+        std::vector<std::vector<ElemType>> m_buffers;                // their weighted sum, being all-reduced
+        std::vector<MPI_Request> m_requests;
+        Matrix<ElemType> m_average;                                  // (scratch)
     };
 
 } } }
@@ -0,0 +1,416 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// OutputPipeline.h -- writing the outputs of the "write" command in stages that overlap with the forward prop
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "ComputationNode.h"
+#include "BoundedQueue.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "GPUDataTransferer.h"
+#include "MatrixQuantizerImpl.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class OutputFormat
+{
+    text,   // formatted according to the WriteFormattingOptions
+    binary  // the raw values, see OutputPipeline::AppendBinary()
+};
+
+// Writes the values of the output nodes, one minibatch at a time, in stages connected by bounded queues:
+//  - Submit(), on the main thread, snapshots the value of a node (on the GPU, in stream order, so that the next
+//    minibatch can reuse the memory of the node) and starts its copy into pinned CPU memory;
+//  - a formatting thread per node waits for the copy and formats it into text, or for the binary format just lays out
+//    the sequences, without going through the formatting at all;
+//  - one I/O thread writes the results to the files, in the order in which they were submitted for each node.
+// At most 'depth' minibatches of a node are in flight, Submit() waits for one of them to be written beyond that.
+// With the formatting option topK, the snapshot is just the top-k indices and scores of each sample, selected on the
+// device of the node, so that only 2k values per sample are copied to the CPU.
+// With depth 0 everything is done synchronously within Submit(), as SimpleOutputWriter has done before.
+// An error on any of the threads ends the pipeline; it is rethrown by the next Submit() or by Finish().
+template <class ElemType>
+class OutputPipeline
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    OutputPipeline(const std::vector<ComputationNodePtr>& nodes, const std::vector<FILE*>& files, const WriteFormattingOptions& formattingOptions,
+                   const std::vector<std::string>& labelMapping, OutputFormat format, size_t depth)
+        : m_formattingOptions(formattingOptions), m_labelMapping(labelMapping), m_format(format), m_depth(depth), m_failed(false)
+    {
+        if (nodes.size() != files.size())
+            LogicError("OutputPipeline: Expected one file per node.");
+
+        if (formattingOptions.topK > 0 && formattingOptions.isSparse)
+            InvalidArgument("write: topK cannot be combined with the sparse format.");
+        char formatChar = !formattingOptions.isCategoryLabel && formattingOptions.topK == 0 ? 'f' : !formattingOptions.labelMappingFile.empty() ? 's' : 'u';
+        m_valueFormatString = "%" + formattingOptions.precisionFormat + formatChar; // format string used in fprintf() for formatting the values
+
+        for (size_t k = 0; k < nodes.size(); k++)
+        {
+            auto stream = std::make_unique<Stream>(std::max<size_t>(depth, 1));
+            stream->m_node = nodes[k];
+            stream->m_file = files[k];
+            stream->m_sampleLayout = nodes[k]->GetSampleLayout();
+            stream->m_sampleDim = stream->m_sampleLayout.GetNumElements();
+            if (formattingOptions.topK > 0)
+                stream->m_sampleDim = 2 * std::min(formattingOptions.topK, stream->m_sampleDim);
+            for (auto& slot : stream->m_slots)
+                stream->m_freeSlots.Push(&slot);
+            if (format == OutputFormat::binary)
+                WriteBinaryHeader(stream->m_file, stream->m_sampleDim);
+            m_streams.push_back(std::move(stream));
+        }
+
+        if (depth > 0)
+        {
+            m_chunks = std::make_unique<BoundedQueue<Chunk>>(depth * std::max<size_t>(m_streams.size(), 1));
+            for (auto& stream : m_streams)
+            {
+                Stream* s = stream.get();
+                stream->m_formatter = std::thread([this, s] { RunStage([this, s] { FormatLoop(*s); }); });
+            }
+            m_writer = std::thread([this] { RunStage([this] { WriteLoop(); }); });
+        }
+    }
+
+    ~OutputPipeline()
+    {
+        // only gets here with threads running if the main thread failed; its error is the one to report
+        try
+        {
+            Stop();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    // Takes the current value of the k-th node, computed for minibatch 'numMBsRun', into the pipeline.
+    void Submit(size_t k, size_t numMBsRun)
+    {
+        auto& stream = *m_streams[k];
+        Slot* slot = nullptr;
+        if (!stream.m_freeSlots.Pop(slot))
+            RethrowError();
+        Snapshot(stream, *slot, numMBsRun);
+
+        if (m_depth == 0)
+        {
+            std::string out;
+            Format(stream, *slot, out);
+            Write(stream.m_file, out);
+            stream.m_freeSlots.Push(slot);
+        }
+        else if (!stream.m_toFormat.Push(slot))
+            RethrowError();
+    }
+
+    // Waits until everything submitted has been written, and rethrows the first error of the threads.
+    void Finish()
+    {
+        Stop();
+        RethrowError(/*onlyIfFailed=*/true);
+    }
+
+    // The header of a file in the binary format, followed by the sequences of all minibatches, each as
+    // uint64 sequence id, uint64 number of samples, and [sample dimension x number of samples] values of ElemType in column-major order.
+    // All numbers are in the byte order of the machine.
+    static void WriteBinaryHeader(FILE* f, size_t sampleDim)
+    {
+        const char tag[8] = { 'C', 'N', 'T', 'K', 'O', 'U', 'T', '1' };
+        uint32_t elemSize = sizeof(ElemType);
+        uint32_t reserved = 0;
+        uint64_t dim = sampleDim;
+        fwriteOrDie(tag, sizeof(tag), 1, f);
+        fwriteOrDie(&elemSize, sizeof(elemSize), 1, f);
+        fwriteOrDie(&reserved, sizeof(reserved), 1, f);
+        fwriteOrDie(&dim, sizeof(dim), 1, f);
+    }
+
+    // Appends the sequences of a minibatch in the binary format. Gaps are skipped, and the sequences come in the order of the text format.
+    static void AppendBinary(std::string& out, const ElemType* data, size_t numRows, size_t numCols, const MBLayoutPtr& pMBLayout)
+    {
+        auto appendNumber = [&out](uint64_t n) { out.append((const char*)&n, sizeof(n)); };
+        if (!pMBLayout) // no MBLayout: one sequence of all columns
+        {
+            appendNumber(0);
+            appendNumber(numCols);
+            out.append((const char*)data, sizeof(ElemType) * numRows * numCols);
+            return;
+        }
+        const size_t width = pMBLayout->GetNumTimeSteps();
+        for (const auto& seqInfo : pMBLayout->GetAllSequences())
+        {
+            if (seqInfo.seqId == GAP_SEQUENCE_ID)
+                continue;
+            size_t tBegin = seqInfo.tBegin >= 0 ? (size_t)seqInfo.tBegin : 0;
+            size_t tEnd = seqInfo.tEnd <= width ? (size_t)seqInfo.tEnd : width;
+            if (tEnd < tBegin)
+                tEnd = tBegin;
+            appendNumber(seqInfo.seqId);
+            appendNumber(tEnd - tBegin);
+            for (size_t t = tBegin; t < tEnd; t++)
+                out.append((const char*)(data + (t * pMBLayout->GetNumParallelSequences() + seqInfo.s) * numRows), sizeof(ElemType) * numRows);
+        }
+    }
+
+private:
+    // a minibatch of one node on its way to the file
+    struct Slot
+    {
+        size_t m_numMBsRun = 0;
+        size_t m_numRows = 0;
+        size_t m_numCols = 0;
+        MBLayoutPtr m_layout;                            // a copy of the layout of the node, null if it has none
+        bool m_onDevice = false;
+        std::shared_ptr<Matrix<ElemType>> m_deviceValue; // snapshot of the value on the GPU
+        std::shared_ptr<ElemType> m_pinnedValue;         // its copy in pinned memory
+        size_t m_pinnedCapacity = 0;
+        std::unique_ptr<GPUDataTransferer> m_transferer;
+        std::vector<ElemType> m_hostValue;               // the value copied right away, on the CPU
+        std::shared_ptr<Matrix<ElemType>> m_topKIndexes, m_topKValues, m_topK; // with topK: the selection, on the device of the node
+    };
+
+    struct Stream
+    {
+        explicit Stream(size_t numSlots)
+            : m_slots(numSlots), m_freeSlots(numSlots), m_toFormat(numSlots)
+        {
+        }
+
+        ComputationNodePtr m_node;
+        FILE* m_file;
+        TensorShape m_sampleLayout;
+        size_t m_sampleDim;                              // the values written per sample: its elements, or 2k with topK
+        std::vector<Slot> m_slots;
+        BoundedQueue<Slot*> m_freeSlots;
+        BoundedQueue<Slot*> m_toFormat;
+        std::thread m_formatter;
+    };
+
+    struct Chunk
+    {
+        FILE* m_file = nullptr;
+        std::string m_data;
+    };
+
+    // [the top-k indices; their scores] of each column of the value of the node, computed on its device
+    const Matrix<ElemType>& SelectTopK(const Stream& stream, Slot& slot) const
+    {
+        const auto& value = stream.m_node->Value();
+        if (value.GetMatrixType() != DENSE)
+            InvalidArgument("write: topK requires dense outputs, but %ls is sparse.", stream.m_node->NodeName().c_str());
+        if (!slot.m_topK)
+        {
+            slot.m_topKIndexes = std::make_shared<Matrix<ElemType>>(value.GetDeviceId());
+            slot.m_topKValues  = std::make_shared<Matrix<ElemType>>(value.GetDeviceId());
+            slot.m_topK        = std::make_shared<Matrix<ElemType>>(value.GetDeviceId());
+        }
+        size_t k = stream.m_sampleDim / 2;
+        slot.m_topK->Resize(2 * k, value.GetNumCols());
+        if (!value.IsEmpty())
+        {
+            value.VectorMax(*slot.m_topKIndexes, *slot.m_topKValues, /*isColWise=*/true, (int)k);
+            slot.m_topK->AssignToRowSliceValuesOf(*slot.m_topKIndexes, 0, k);
+            slot.m_topK->AssignToRowSliceValuesOf(*slot.m_topKValues, k, k);
+        }
+        return *slot.m_topK;
+    }
+
+    void Snapshot(Stream& stream, Slot& slot, size_t numMBsRun)
+    {
+        const auto& value = m_formattingOptions.topK > 0 ? SelectTopK(stream, slot) : stream.m_node->Value();
+        slot.m_numMBsRun = numMBsRun;
+        slot.m_numRows = value.GetNumRows();
+        slot.m_numCols = value.GetNumCols();
+        slot.m_layout = nullptr;
+        if (stream.m_node->HasMBLayout())
+        {
+            slot.m_layout = std::make_shared<MBLayout>();
+            slot.m_layout->CopyFrom(stream.m_node->GetMBLayout());
+        }
+
+        size_t numElements = slot.m_numRows * slot.m_numCols;
+        slot.m_onDevice = value.GetDeviceId() != CPUDEVICE && value.GetMatrixType() == DENSE && numElements > 0;
+        if (!slot.m_onDevice)
+        {
+            slot.m_hostValue.resize(numElements);
+            if (numElements == 0)
+                ;
+            else if (value.GetMatrixType() == DENSE)
+                value.CopySection(slot.m_numRows, slot.m_numCols, slot.m_hostValue.data(), slot.m_numRows);
+            else
+            {
+                std::unique_ptr<ElemType[]> values(value.CopyToArray());
+                std::copy(values.get(), values.get() + numElements, slot.m_hostValue.begin());
+            }
+            return;
+        }
+
+        DEVICEID_TYPE deviceId = value.GetDeviceId();
+        if (!m_allocator)
+            m_allocator = std::make_unique<CUDAPageLockedMemAllocator>(deviceId);
+        if (!slot.m_transferer)
+        {
+            slot.m_deviceValue = std::make_shared<Matrix<ElemType>>(deviceId);
+            slot.m_transferer = std::make_unique<GPUDataTransferer>(deviceId, /*useConcurrentStreams=*/true);
+        }
+        if (slot.m_pinnedCapacity < numElements)
+        {
+            CUDAPageLockedMemAllocator* allocator = m_allocator.get();
+            slot.m_pinnedValue = nullptr;
+            slot.m_pinnedValue = std::shared_ptr<ElemType>((ElemType*) allocator->Malloc(sizeof(ElemType) * numElements), [allocator](ElemType* p)
+                                                           {
+                                                               allocator->Free(p);
+                                                           });
+            slot.m_pinnedCapacity = numElements;
+        }
+        // the snapshot is taken on the compute stream, and the copy waits for it on the fetch stream
+        slot.m_deviceValue->SetValue(value);
+        std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+        mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+        slot.m_transferer->CopyGPUToCPUAsync(slot.m_deviceValue->Data(), numElements, slot.m_pinnedValue.get());
+    }
+
+    void Format(const Stream& stream, Slot& slot, std::string& out) const
+    {
+        ElemType* data = slot.m_hostValue.data();
+        if (slot.m_onDevice)
+        {
+            slot.m_transferer->WaitForCopyGPUToCPUAsync();
+            data = slot.m_pinnedValue.get();
+        }
+
+        if (m_format == OutputFormat::binary)
+        {
+            if (slot.m_numRows != stream.m_sampleDim)
+                LogicError("OutputPipeline: The value of node %ls has %d rows, but its samples have %d elements.",
+                           stream.m_node->NodeName().c_str(), (int)slot.m_numRows, (int)stream.m_sampleDim);
+            AppendBinary(out, data, slot.m_numRows, slot.m_numCols, slot.m_layout);
+            return;
+        }
+
+        const auto& nodeName = stream.m_node->NodeName();
+        const auto& options = m_formattingOptions;
+        ComputationNode<ElemType>::FormatMinibatch(out, data, slot.m_numRows, slot.m_numCols, slot.m_layout, stream.m_sampleLayout, FrameRange(),
+                                                   SIZE_MAX, SIZE_MAX, options.transpose, options.isCategoryLabel, options.isSparse, m_labelMapping,
+                                                   options.Processed(nodeName, options.sequenceSeparator, slot.m_numMBsRun),
+                                                   options.Processed(nodeName, options.sequencePrologue,  slot.m_numMBsRun),
+                                                   options.Processed(nodeName, options.sequenceEpilogue,  slot.m_numMBsRun),
+                                                   options.Processed(nodeName, options.elementSeparator,  slot.m_numMBsRun),
+                                                   options.Processed(nodeName, options.sampleSeparator,   slot.m_numMBsRun),
+                                                   m_valueFormatString, options.topK > 0 ? slot.m_numRows / 2 : 0);
+    }
+
+    static void Write(FILE* f, const std::string& data)
+    {
+        if (!data.empty())
+            fwriteOrDie(data.data(), sizeof(char), data.size(), f);
+    }
+
+    void FormatLoop(Stream& stream)
+    {
+        Slot* slot = nullptr;
+        while (!m_failed && stream.m_toFormat.Pop(slot))
+        {
+            Chunk chunk;
+            chunk.m_file = stream.m_file;
+            Format(stream, *slot, chunk.m_data);
+            stream.m_freeSlots.Push(slot);
+            if (!m_chunks->Push(std::move(chunk)))
+                break;
+        }
+    }
+
+    void WriteLoop()
+    {
+        Chunk chunk;
+        while (!m_failed && m_chunks->Pop(chunk))
+            Write(chunk.m_file, chunk.m_data);
+    }
+
+    // runs a stage on its thread; the first error is kept and ends all stages
+    template <class F>
+    void RunStage(const F& stage)
+    {
+        try
+        {
+            stage();
+        }
+        catch (...)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_errorMutex);
+                if (!m_error)
+                    m_error = std::current_exception();
+            }
+            m_failed = true;
+            for (auto& stream : m_streams)
+            {
+                stream->m_freeSlots.Close();
+                stream->m_toFormat.Close();
+            }
+            m_chunks->Close();
+        }
+    }
+
+    // ends the stages after they have processed all that has been submitted, and joins the threads
+    void Stop()
+    {
+        for (auto& stream : m_streams)
+            stream->m_toFormat.Close();
+        for (auto& stream : m_streams)
+        {
+            if (stream->m_formatter.joinable())
+                stream->m_formatter.join();
+        }
+        if (m_chunks)
+            m_chunks->Close();
+        if (m_writer.joinable())
+            m_writer.join();
+    }
+
+    void RethrowError(bool onlyIfFailed = false)
+    {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        if (m_error)
+            std::rethrow_exception(m_error);
+        if (!onlyIfFailed)
+            LogicError("OutputPipeline: The pipeline has been closed.");
+    }
+
+    const WriteFormattingOptions m_formattingOptions;
+    const std::vector<std::string> m_labelMapping;
+    std::string m_valueFormatString;
+    const OutputFormat m_format;
+    const size_t m_depth;
+
+    std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator; // declared before the streams, whose pinned buffers it frees
+    std::vector<std::unique_ptr<Stream>> m_streams;
+    std::unique_ptr<BoundedQueue<Chunk>> m_chunks;           // from the formatting threads to the I/O thread
+    std::thread m_writer;
+
+    std::atomic<bool> m_failed;
+    std::mutex m_errorMutex;
+    std::exception_ptr m_error;
+
+    DISABLE_COPY_AND_MOVE(OutputPipeline);
+};
+
+}}}
@@ -153,6 +153,80 @@ void PostComputingActions<ElemType>::BatchNormalizationStatistics(IDataReader *
     return;
 }
 
+template <class ElemType>
+void PostComputingActions<ElemType>::Int8Calibration(IDataReader* dataReader, const vector<wstring>& evalNodeNames,
+    const wstring newModelPath, const size_t mbSize, const size_t numMinibatches)
+{
+    // the ranges must be those of inference, e.g. with the running statistics of batch normalization and without dropout
+    ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
+
+    let evalNodes = m_net->GetEvalNodesWithName(evalNodeNames);
+
+    // find all the nodes that can be quantized
+    std::vector<ComputationNodeBasePtr> quantizableNodes;
+    std::set<ComputationNodeBasePtr> quantizableNodesLogged;
+    for (auto& evalNode : evalNodes)
+    {
+        for (auto& node : m_net->GetEvalOrder(evalNode))
+        {
+            let quantizable = dynamic_pointer_cast<IInt8Quantizable>(node);
+            if (quantizable && quantizable->IsInt8Quantizable() && quantizableNodesLogged.insert(node).second)
+            {
+                quantizable->StartInt8Calibration();
+                quantizableNodes.push_back(node);
+            }
+        }
+    }
+
+    if (quantizableNodes.empty())
+        RuntimeError("Int8Calibration: the network has no Times or Convolution nodes with LearnableParameter weights that could be quantized.");
+
+    m_net->AllocateAllMatrices(evalNodes, {}, nullptr);
+
+    // prepare features
+    auto& featureNodes = m_net->FeatureNodes();
+
+    StreamMinibatchInputs inputMatrices;
+    for (auto& node : featureNodes)
+        inputMatrices.AddInput(node->NodeName(), node->ValuePtr(), node->GetMBLayout(), node->GetSampleLayout());
+
+    // the ranges are recorded in each process, so all of them must see the same data
+    dataReader->StartMinibatchLoop(mbSize, 0, inputMatrices.GetStreamDescriptions(), mbSize * numMinibatches);
+    m_net->StartEvaluateMinibatchLoop(evalNodes);
+
+    size_t numMBsRun = 0;
+    size_t actualMBSize = 0;
+    while (numMBsRun < numMinibatches &&
+           DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net, nullptr, /*useDistributedMBReading=*/false, /*useParallelTrain=*/false, inputMatrices, actualMBSize, m_mpi))
+    {
+        if (actualMBSize == 0)
+            continue;
+
+        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+        m_net->ForwardProp(evalNodes);
+        numMBsRun++;
+    }
+
+    dataReader->DataEnd();
+
+    if (numMBsRun == 0)
+        LogicError("DataRead Failure in int8 calibration");
+
+    LOGPRINTF(stderr, "Int8 calibration over %d minibatches:\n", (int)numMBsRun);
+    for (auto& node : quantizableNodes)
+    {
+        double range = dynamic_pointer_cast<IInt8Quantizable>(node)->EndInt8Calibration();
+        if (range > 0)
+            LOGPRINTF(stderr, "\t%ls: input range %g\n", node->NodeName().c_str(), range);
+        else
+            LOGPRINTF(stderr, "\t%ls: input is all zeros, not quantized\n", node->NodeName().c_str());
+    }
+
+    // save model
+    if (!m_mpi || m_mpi->CurrentNodeRank() == m_mpi->MainNodeRank())
+        m_net->Save(newModelPath);
+}
+
 template class PostComputingActions<float>;
 template class PostComputingActions<double>;
 
@@ -52,6 +52,13 @@ public:
     void BatchNormalizationStatistics(IDataReader* dataReader, const vector<wstring>& evalNodeNames, const wstring newModelPath, 
         const size_t mbSize, const int iters = 30);
 
+    // Calibration for int8 inference: runs the network in inferring mode over numMinibatches minibatches and records
+    // the range of the data input of all nodes that can be quantized (see IInt8Quantizable), i.e. Times and Convolution
+    // with LearnableParameter weights. The nodes then compute in int8 when inferring on the CPU, which also
+    // applies to recurrent networks that are built from Times (e.g. the LSTMs of BrainScript).
+    void Int8Calibration(IDataReader* dataReader, const vector<wstring>& evalNodeNames, const wstring newModelPath,
+        const size_t mbSize, const size_t numMinibatches);
+
 private:
     ComputationNetworkPtr m_net;
     MPIWrapperPtr m_mpi;
@@ -4,11 +4,17 @@
 //
 #include <cassert>
 #include <stdio.h>
+#include <algorithm>
+#include <cstring>
 #include "Profiler.h"
 #include "BestGpu.h" // for CPUONLY flag only
+#include "Basics.h"
+#include "MPIWrapper.h"
+#include "fileutil.h"
 
 #ifndef CPUONLY
 #include <cuda_profiler_api.h>
+#include <cuda_runtime.h>
 #else
 // If compiling without CUDA, defining profiler control functions as no-op stubs
 void cudaProfilerStart()
@@ -60,3 +66,283 @@ void Profiler::Stop()
     fprintf(stderr, "Stopping profiling\n");
     m_isProfilingActive = false;
 }
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifndef CPUONLY
+static void TimelineCudaCall(cudaError_t retCode, const char* exprString)
+{
+    if (retCode != cudaSuccess)
+        RuntimeError("TimelineProfiler: %s failed: %s", exprString, cudaGetErrorString(retCode));
+}
+#define TIMELINE_CUDA_CALL(expr) (TimelineCudaCall((expr), #expr))
+#endif
+
+TimelineProfiler& TimelineProfiler::Instance()
+{
+    static TimelineProfiler s_instance;
+    return s_instance;
+}
+
+TimelineProfiler::TimelineProfiler()
+    : m_isRecording(false), m_numStepsToRecord(0), m_step(0), m_stepSpan(NoSpan), m_deviceId(-1), m_startEvent(nullptr)
+{
+}
+
+// (the CUDA events are released by Write(); no CUDA calls during static destruction)
+TimelineProfiler::~TimelineProfiler()
+{
+}
+
+void TimelineProfiler::Start(size_t numSteps, int deviceId, const std::shared_ptr<MPIWrapper>& mpi)
+{
+    if (numSteps == 0)
+        return;
+    if (m_isRecording)
+        LogicError("TimelineProfiler: Already recording.");
+
+    m_numStepsToRecord = numSteps;
+    m_deviceId = deviceId;
+    m_step = 0;
+    m_spans.clear();
+    m_stepTimes.clear();
+
+    if (mpi)
+        mpi->WaitAll();
+#ifndef CPUONLY
+    if (m_deviceId >= 0)
+    {
+        // the GPU spans are timed relative to this event, which is taken to happen at m_startTime
+        m_startEvent = RecordGpuEvent();
+        TIMELINE_CUDA_CALL(cudaEventSynchronize((cudaEvent_t) m_startEvent));
+    }
+#endif
+    m_startTime = std::chrono::steady_clock::now();
+    m_isRecording = true;
+    fprintf(stderr, "Recording a timeline of %d steps.\n", (int) numSteps);
+}
+
+void TimelineProfiler::BeginStep()
+{
+    if (!m_isRecording)
+        return;
+    EndStep();
+    if (m_step == m_numStepsToRecord)
+    {
+        m_isRecording = false;
+        return;
+    }
+    m_step++;
+    m_stepSpan = BeginSpan("step");
+}
+
+void TimelineProfiler::EndStep()
+{
+    if (m_stepSpan == NoSpan)
+        return;
+    EndSpan(m_stepSpan);
+    m_stepTimes.push_back(m_spans[m_stepSpan].m_begin);
+    m_stepTimes.push_back(m_spans[m_stepSpan].m_end - m_spans[m_stepSpan].m_begin);
+    m_stepSpan = NoSpan;
+}
+
+size_t TimelineProfiler::BeginSpan(const char* name, Track track)
+{
+    if (!m_isRecording)
+        return NoSpan;
+    Span span = { name, track, m_step, Now(), 0, 0, nullptr, nullptr };
+    if (track == Track::Gpu)
+        span.m_beginEvent = RecordGpuEvent();
+    m_spans.push_back(span);
+    return m_spans.size() - 1;
+}
+
+void TimelineProfiler::EndSpan(size_t span, size_t numBytes)
+{
+    if (span == NoSpan)
+        return;
+    auto& s = m_spans[span];
+    s.m_end = Now();
+    s.m_numBytes = numBytes;
+    if (s.m_beginEvent)
+        s.m_endEvent = RecordGpuEvent();
+}
+
+double TimelineProfiler::Now() const
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
+// records an event on the default stream, or returns nullptr without a GPU
+void* TimelineProfiler::RecordGpuEvent()
+{
+#ifndef CPUONLY
+    if (m_deviceId < 0)
+        return nullptr;
+    cudaEvent_t event;
+    if (!m_freeEvents.empty())
+    {
+        event = (cudaEvent_t) m_freeEvents.back();
+        m_freeEvents.pop_back();
+    }
+    else
+        TIMELINE_CUDA_CALL(cudaEventCreate(&event));
+    TIMELINE_CUDA_CALL(cudaEventRecord(event, 0));
+    return event;
+#else
+    return nullptr;
+#endif
+}
+
+// replaces the host times of the GPU spans by the times of their events
+void TimelineProfiler::ResolveGpuSpans()
+{
+#ifndef CPUONLY
+    for (auto& span : m_spans)
+    {
+        if (!span.m_beginEvent)
+            continue;
+        float beginMs = 0, endMs = 0;
+        TIMELINE_CUDA_CALL(cudaEventSynchronize((cudaEvent_t) span.m_endEvent));
+        TIMELINE_CUDA_CALL(cudaEventElapsedTime(&beginMs, (cudaEvent_t) m_startEvent, (cudaEvent_t) span.m_beginEvent));
+        TIMELINE_CUDA_CALL(cudaEventElapsedTime(&endMs, (cudaEvent_t) m_startEvent, (cudaEvent_t) span.m_endEvent));
+        span.m_begin = 1000.0 * beginMs;
+        span.m_end = 1000.0 * endMs;
+        m_freeEvents.push_back(span.m_beginEvent);
+        m_freeEvents.push_back(span.m_endEvent);
+        span.m_beginEvent = span.m_endEvent = nullptr;
+    }
+    if (m_startEvent)
+        m_freeEvents.push_back(m_startEvent);
+    m_startEvent = nullptr;
+    for (auto event : m_freeEvents)
+        cudaEventDestroy((cudaEvent_t) event);
+    m_freeEvents.clear();
+#endif
+}
+
+// the spans as Chrome trace events, comma separated; rank r is process r
+std::string TimelineProfiler::SerializeSpans(int rank) const
+{
+    static const char* trackNames[] = { "host", "GPU", "communication" };
+    std::string result;
+    char buffer[512];
+    for (int tid = 0; tid < 3; tid++)
+    {
+        sprintf(buffer, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", result.empty() ? "" : ",\n", rank, tid, trackNames[tid]);
+        result += buffer;
+    }
+    sprintf(buffer, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}", rank, rank);
+    result += buffer;
+
+    for (size_t i = 0; i < m_spans.size(); i++)
+    {
+        const auto& span = m_spans[i];
+        char args[64];
+        if (span.m_numBytes > 0)
+            sprintf(args, "{\"step\":%d,\"bytes\":%llu}", (int) span.m_step, (unsigned long long) span.m_numBytes);
+        else
+            sprintf(args, "{\"step\":%d}", (int) span.m_step);
+        int tid = (int) span.m_track;
+        if (span.m_track == Track::Communication) // (may overlap, thus as an async begin/end pair)
+        {
+            sprintf(buffer, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"b\",\"id\":%d,\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":%s}"
+                            ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"e\",\"id\":%d,\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    span.m_name, trackNames[tid], (int) i, span.m_begin, rank, tid, args,
+                    span.m_name, trackNames[tid], (int) i, span.m_end, rank, tid);
+        }
+        else
+        {
+            sprintf(buffer, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":%s}",
+                    span.m_name, trackNames[tid], span.m_begin, span.m_end - span.m_begin, rank, tid, args);
+        }
+        result += buffer;
+    }
+    return result;
+}
+
+void TimelineProfiler::Write(const std::wstring& path, const std::shared_ptr<MPIWrapper>& mpi)
+{
+    if (m_numStepsToRecord == 0)
+        return;
+    EndStep();
+    m_isRecording = false;
+    m_numStepsToRecord = 0;
+    ResolveGpuSpans();
+
+    int rank = mpi ? (int) mpi->CurrentNodeRank() : 0;
+    int numRanks = mpi ? (int) mpi->NumNodesInUse() : 1;
+    size_t mainRank = mpi ? mpi->MainNodeRank() : 0;
+    std::string spans = SerializeSpans(rank);
+
+    // gather the spans and the step times of all ranks on the main node
+    std::vector<std::string> allSpans;
+    std::vector<std::vector<double>> allStepTimes;
+    if (numRanks > 1)
+    {
+        int sizes[2] = { (int) spans.size(), (int) m_stepTimes.size() };
+        std::vector<int> allSizes(2 * numRanks);
+        mpi->Gather(sizes, 2, allSizes.data(), 2, mainRank);
+
+        std::vector<int> spanCounts(numRanks), spanOffsets(numRanks), stepCounts(numRanks), stepOffsets(numRanks);
+        for (int r = 0; r < numRanks; r++)
+        {
+            spanCounts[r] = allSizes[2 * r];
+            stepCounts[r] = allSizes[2 * r + 1];
+            spanOffsets[r] = r > 0 ? spanOffsets[r - 1] + spanCounts[r - 1] : 0;
+            stepOffsets[r] = r > 0 ? stepOffsets[r - 1] + stepCounts[r - 1] : 0;
+        }
+        std::vector<char> gatheredSpans(spanOffsets.back() + spanCounts.back() + 1);
+        std::vector<double> gatheredStepTimes(stepOffsets.back() + stepCounts.back() + 1);
+        mpi->Gatherv(spans.data(), spans.size(), gatheredSpans.data(), spanCounts.data(), spanOffsets.data(), mainRank);
+        mpi->Gatherv(m_stepTimes.data(), m_stepTimes.size(), gatheredStepTimes.data(), stepCounts.data(), stepOffsets.data(), mainRank);
+
+        for (int r = 0; r < numRanks; r++)
+        {
+            allSpans.push_back(std::string(gatheredSpans.data() + spanOffsets[r], spanCounts[r]));
+            allStepTimes.push_back(std::vector<double>(gatheredStepTimes.begin() + stepOffsets[r], gatheredStepTimes.begin() + stepOffsets[r] + stepCounts[r]));
+        }
+    }
+    else
+    {
+        allSpans.push_back(spans);
+        allStepTimes.push_back(m_stepTimes);
+    }
+    m_spans.clear();
+    m_stepTimes.clear();
+    if (rank != (int) mainRank)
+        return;
+
+    FILE* f = fopenOrDie(path, L"w");
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    for (int r = 0; r < numRanks; r++)
+    {
+        fputs(r > 0 ? ",\n" : "", f);
+        fputs(allSpans[r].c_str(), f);
+    }
+
+    // mark the slowest rank of each step that all ranks have recorded
+    size_t numSteps = SIZE_MAX;
+    for (const auto& stepTimes : allStepTimes)
+        numSteps = std::min(numSteps, stepTimes.size() / 2);
+    for (size_t k = 0; k < numSteps && numRanks > 1; k++)
+    {
+        int slowest = 0, fastest = 0;
+        for (int r = 1; r < numRanks; r++)
+        {
+            if (allStepTimes[r][2 * k + 1] > allStepTimes[slowest][2 * k + 1])
+                slowest = r;
+            if (allStepTimes[r][2 * k + 1] < allStepTimes[fastest][2 * k + 1])
+                fastest = r;
+        }
+        fprintf(f, ",\n{\"name\":\"slowest rank\",\"cat\":\"straggler\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,\"pid\":%d,\"tid\":0,"
+                   "\"args\":{\"step\":%d,\"duration_ms\":%.3f,\"fastest_rank\":%d,\"fastest_ms\":%.3f}}",
+                allStepTimes[slowest][2 * k] + allStepTimes[slowest][2 * k + 1], slowest, (int) k + 1,
+                allStepTimes[slowest][2 * k + 1] / 1000, fastest, allStepTimes[fastest][2 * k + 1] / 1000);
+    }
+    fputs("\n]}\n", f);
+    fcloseOrDie(f);
+    fprintf(stderr, "Timeline of %d ranks written to '%ls'.\n", numRanks, path.c_str());
+}
+
+}}}
@@ -4,6 +4,12 @@
 //
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 class Profiler
 {
 public:
@@ -20,3 +26,97 @@ private:
     int m_numSamples;
     bool m_isProfilingActive;
 };
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MPIWrapper;
+
+// -----------------------------------------------------------------------
+// TimelineProfiler -- records a timeline of the steps (minibatches) of training per rank: reader wait, forward,
+// backward, the all-reduce of each gradient bucket with its size, and the weight update. Spans on the GPU are timed
+// with CUDA events, the others with the host clock. Write() merges the timelines of all ranks into one Chrome trace
+// JSON file (chrome://tracing), with a process per rank, and marks the slowest rank of each step.
+// -----------------------------------------------------------------------
+class TimelineProfiler
+{
+public:
+    enum class Track
+    {
+        Host,         // spans of the training thread, properly nested
+        Gpu,          // spans of work on the GPU
+        Communication // spans that overlap others, e.g. asynchronous all-reduces
+    };
+
+    static const size_t NoSpan = SIZE_MAX;
+
+    static TimelineProfiler& Instance();
+
+    // Starts to record the given number of steps. Collective over 'mpi', if given, to align the ranks' clocks.
+    void Start(size_t numSteps, int deviceId, const std::shared_ptr<MPIWrapper>& mpi);
+    bool IsRecording() const { return m_isRecording; }
+
+    // ends the current step, if any, and begins the next one; recording stops after the requested number of steps
+    void BeginStep();
+    void EndStep();
+
+    // returns NoSpan if not recording
+    size_t BeginSpan(const char* name, Track track = Track::Host);
+    void EndSpan(size_t span, size_t numBytes = 0);
+
+    // Writes the timelines of all ranks to 'path' (on the main node). Collective over 'mpi', if given.
+    void Write(const std::wstring& path, const std::shared_ptr<MPIWrapper>& mpi);
+
+private:
+    TimelineProfiler();
+    ~TimelineProfiler();
+
+    struct Span
+    {
+        const char* m_name;
+        Track m_track;
+        size_t m_step;
+        double m_begin; // microseconds since Start()
+        double m_end;
+        size_t m_numBytes;
+        void* m_beginEvent; // CUDA events of Track::Gpu spans
+        void* m_endEvent;
+    };
+
+    double Now() const;
+    void* RecordGpuEvent();
+    void ResolveGpuSpans();
+    std::string SerializeSpans(int rank) const;
+
+    bool m_isRecording;
+    size_t m_numStepsToRecord;
+    size_t m_step;        // 1-based; 0 before the first step
+    size_t m_stepSpan;
+    int m_deviceId;
+    std::chrono::steady_clock::time_point m_startTime;
+    void* m_startEvent;
+    std::vector<Span> m_spans;
+    std::vector<double> m_stepTimes; // begin and duration per step
+    std::vector<void*> m_freeEvents;
+};
+
+// records a span of the current scope on the TimelineProfiler
+class TimelineSpan
+{
+public:
+    TimelineSpan(const char* name, TimelineProfiler::Track track = TimelineProfiler::Track::Host)
+        : m_span(TimelineProfiler::Instance().BeginSpan(name, track)), m_numBytes(0)
+    {
+    }
+    ~TimelineSpan()
+    {
+        if (m_span != TimelineProfiler::NoSpan)
+            TimelineProfiler::Instance().EndSpan(m_span, m_numBytes);
+    }
+    void SetNumBytes(size_t numBytes) { m_numBytes = numBytes; }
+
+private:
+    size_t m_span;
+    size_t m_numBytes;
+};
+
+}}}
@@ -16,6 +16,7 @@
 #include "MatrixQuantizerImpl.h"
 #include "InputAndParamNodes.h"
 #include "AccumulatorAggregation.h"
+#include "CriterionFetcher.h"
 
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
 //static inline bool operator==(const std::pair<double,size_t>& a, double b) { assert(b==0); return a.first == b; }
@@ -29,16 +30,42 @@
 #include "ASGDHelper.h"
 
 #include "SimpleDistGradAggregator.h"
+#include "SparseDistGradAggregator.h"
 #include "V2SimpleDistGradAggregator.h"
 #include "ProgressTracing.h"
+#include "GPUWatcher.h"
+#include "PerformanceCounters.h"
+#include "MemoryTimeline.h"
 
+#include <cmath>
+#include <deque>
 #include <map>
+#include <numeric>
+#include <omp.h>
+#include <random>
 #include <set>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 using namespace std;
 
+static uint64_t ElapsedMicroseconds(std::chrono::steady_clock::time_point start)
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// copies the statistics of the GPU memory cache into the PerformanceCounters
+static void UpdateDeviceMemoryCounters(DEVICEID_TYPE deviceId)
+{
+    auto statistics = TracingGPUMemoryAllocator::GetCacheStatistics(deviceId);
+    auto& counters = PerformanceCounters::Instance();
+    counters.Set(PerformanceCounters::DeviceMemoryCacheHits, statistics.numHits);
+    counters.Set(PerformanceCounters::DeviceMemoryCacheMisses, statistics.numMisses);
+    counters.Set(PerformanceCounters::DeviceMemoryInUseBytes, statistics.inUseBytes);
+    counters.Set(PerformanceCounters::DeviceMemoryCachedBytes, statistics.cachedBytes);
+    counters.Set(PerformanceCounters::DeviceMemoryPeakInUseBytes, statistics.peakInUseBytes);
+}
+
 // =======================================================================
 // class SGD
 // =======================================================================
@@ -165,6 +192,13 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         }
     }
 
+    Matrix<ElemType>::UseMixedPrecisionGemm(m_mixedPrecisionGemm);
+    m_lossScaling = LossScaling(m_lossScale, m_dynamicLossScaling, m_lossScaleWindow);
+    if (m_mixedPrecisionGemm)
+        LOGPRINTF(stderr, "Using GEMMs with half precision inputs.\n");
+    if (m_lossScaling.IsEnabled())
+        LOGPRINTF(stderr, "Loss scaling: initial scale %g%s.\n", m_lossScaling.GetScale(), m_lossScaling.IsDynamic() ? ", dynamic" : "");
+
     // This code is only relevant for the new (V2) readers. It exist because of
     // a shortcoming in DecimateMinibatchInPlace, which does not yet work when inputs 
     // in the same minibatch have different layouts, which is something only V2 readers can
@@ -205,6 +239,65 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         }
     }
 
+    if (m_fuseBatchNormRelu)
+    {
+        size_t numFused = net->FuseBatchNormalizationAndRelu<ElemType>();
+        LOGPRINTF(stderr, "Fused %d ReLU nodes into the BatchNormalization nodes they follow.\n", (int) numFused);
+    }
+
+    if (m_syncBatchNormalization && m_mpi != nullptr && m_mpi->NumNodesInUse() > 1)
+    {
+        auto comm = std::make_shared<NcclComm>(net->GetDeviceId(), m_mpi);
+        if (!comm->IsSupported())
+            InvalidArgument("syncBatchNormalization requires NCCL between the GPUs of all workers.");
+        ComputationNetwork::SetBatchNormalizationCommunicator<ElemType>(net, criterionNodes[0], comm);
+        LOGPRINTF(stderr, "Batch normalization statistics are synchronized across %d workers.\n", (int) m_mpi->NumNodesInUse());
+    }
+
+    m_vocabularyShardedParameters.clear();
+    if (m_vocabularyParallel && m_mpi != nullptr && m_mpi->NumNodesInUse() > 1)
+    {
+        if (GetParallelizationMethod() != ParallelizationMethod::dataParallelSGD)
+            InvalidArgument("vocabularyParallel requires data-parallel SGD.");
+        if (m_autoLearnRateSearchType != LearningRateSearchAlgorithm::None || m_emaDecay > 0)
+            InvalidArgument("vocabularyParallel cannot be combined with the automatic learning rate search or with moving averages of the parameters.");
+        auto comm = std::make_shared<NcclComm>(net->GetDeviceId(), m_mpi);
+        if (!comm->IsSupported())
+            InvalidArgument("vocabularyParallel requires NCCL between the GPUs of all workers.");
+        m_vocabularyShardedParameters = ComputationNetwork::ShardVocabularyParallelNodes<ElemType>(net, comm, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse());
+        LOGPRINTF(stderr, "Vocabulary parallelism: %d parameters are sharded by words across %d workers.\n", (int) m_vocabularyShardedParameters.size(), (int) m_mpi->NumNodesInUse());
+    }
+
+    if (m_parallelSearch && (m_syncBatchNormalization || m_vocabularyParallel))
+        InvalidArgument("parallelSearch cannot be combined with syncBatchNormalization or vocabularyParallel, whose workers must train together.");
+
+    if (m_elasticTraining && m_mpi != nullptr)
+    {
+        if (GetParallelizationMethod() != ParallelizationMethod::dataParallelSGD && GetParallelizationMethod() != ParallelizationMethod::modelAveragingSGD)
+            InvalidArgument("elasticTraining requires data-parallel SGD or model averaging.");
+        if (m_vocabularyParallel || Globals::UseV2Aggregator())
+            InvalidArgument("elasticTraining cannot be combined with vocabularyParallel or with the V2 aggregators.");
+        m_mpi->EnableFaultTolerance();
+        LOGPRINTF(stderr, "Elastic training: the surviving workers continue if a worker fails.\n");
+    }
+
+    if (!m_modelParallelDevices.empty())
+    {
+        vector<DEVICEID_TYPE> devices(m_modelParallelDevices.begin(), m_modelParallelDevices.end());
+        map<wstring, DEVICEID_TYPE> manualPlacement;
+        for (const auto& entry : m_nodeDevices)
+        {
+            auto pos = entry.find(L'=');
+            if (pos == wstring::npos)
+                InvalidArgument("nodeDevices: '%ls' is not of the form nodeName=deviceId.", entry.c_str());
+            manualPlacement[entry.substr(0, pos)] = (DEVICEID_TYPE) stoi(entry.substr(pos + 1));
+        }
+        vector<ComputationNodeBasePtr> nodesOnNetworkDevice(criterionNodes.begin(), criterionNodes.end());
+        nodesOnNetworkDevice.insert(nodesOnNetworkDevice.end(), evaluationNodes.begin(), evaluationNodes.end());
+        size_t numCopies = net->PlaceNodesOnDevices<ElemType>(criterionNodes[0], devices, manualPlacement, nodesOnNetworkDevice, m_mbSize[0]);
+        LOGPRINTF(stderr, "Model parallelism: nodes placed on %d devices, with %d cross-device copies.\n", (int) devices.size(), (int) numCopies);
+    }
+
     std::vector<ComputationNodeBasePtr> additionalNodesToEvaluate;
     auto& outputNodes = net->OutputNodes();
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), outputNodes.cbegin(), outputNodes.cend());
@@ -213,7 +306,19 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), preComputeNodesList.cbegin(), preComputeNodesList.cend());
 
     // allocate memory for forward and backward computation
+    if (m_recomputeActivations)
+        net->EnableActivationRecomputation(m_recomputationCheckpoints);
+    if (m_offloadActivations)
+        net->EnableActivationOffloading();
+    if (m_staticMemoryPlanMaxColumns > 0)
+        net->EnableStaticMemoryPlan(m_staticMemoryPlanMaxColumns);
+    net->EnablePackedSequenceExecution(m_packedSequenceExecution);
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]); // TODO: use criterionNodes.front() throughout
+    if (m_pipelineMicroBatches > 1)
+    {
+        size_t numStages = net->FormPipelineStages(criterionNodes[0]);
+        LOGPRINTF(stderr, "Pipeline parallelism: %d stages, %d micro-batches per minibatch.\n", (int) numStages, (int) m_pipelineMicroBatches);
+    }
 
     // get feature and label nodes into an array of matrices that will be passed to GetMinibatch()
     // TODO: instead, remember the nodes directly, to be able to handle both float and double nodes; current version will crash for mixed networks
@@ -268,9 +373,24 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     // only one criterion so far TODO: support multiple ones?
     auto& learnableNodes = net->LearnableParameterNodes(criterionNodes[0]);
     list<Matrix<ElemType>> smoothedGradients;
-    vector<double> smoothedCounts; // currently used by FSAdaGradUpdate()
+    vector<double> smoothedCounts; // currently used by FSAdaGradUpdate(), AdamUpdate(), and LambUpdate()
     size_t numParameters = 0;
 
+    // move the dense parameters into one buffer, with their gradients and smoothed gradients (the matrices are allocated by now)
+    m_flatParameters.reset();
+    m_flatEmaValues.reset();
+    if (m_flatParameterBuffer && !m_modelParallelDevices.empty())
+        LOGPRINTF(stderr, "Flat parameter buffer: Not used, as the parameters are placed on several devices.\n");
+    else if (m_flatParameterBuffer && !m_vocabularyShardedParameters.empty())
+        LOGPRINTF(stderr, "Flat parameter buffer: Not used, as parameters are sharded across the workers.\n");
+    else if (m_flatParameterBuffer)
+    {
+        net->LoadDeferredParameterValues(); // (their values are copied into the buffer)
+        m_flatParameters = make_shared<FlatParameterBuffer<ElemType>>(learnableNodes, SmoothedGradientStateSize(), net->GetDeviceId());
+        if (m_traceLevel > 0)
+            LOGPRINTF(stderr, "Flat parameter buffer: %d parameter tensors in %.0f elements.\n", (int)m_flatParameters->NumNodes(), (double)m_flatParameters->GetNumElements());
+    }
+
     vector<wstring> nodesToUpdateDescriptions; // for logging only
     for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
     {
@@ -278,9 +398,12 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // Note: We don't actually need the smoothedGradients if !IsParameterUpdateRequired().
         // However, this is hard to fix since lots of code assumes smoothedGradients to be in the same order as learnableNodes.
         // V2 API fixes this.
-        smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
-                                                     node->Value().GetNumCols(),
-                                                     net->GetDeviceId()));
+        if (m_flatParameters && m_flatParameters->Contains(node))
+            smoothedGradients.push_back(m_flatParameters->StateOf(node));
+        else
+            smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
+                                                         node->Value().GetNumCols(),
+                                                         node->GetDeviceId())); // (differs from the network's under model parallelism)
         smoothedCounts.push_back(0);
         if (node->IsParameterUpdateRequired())
         {
@@ -320,6 +443,13 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     for (size_t i = 0; i < evaluationNodes.size(); i++)
         evalNodeNames.push_back(evaluationNodes[i]->NodeName());
 
+    bool hasValidationSet = validationSetDataReader != trainSetDataReader && validationSetDataReader != nullptr;
+    vector<wstring> cvSetTrainAndEvalNodes;
+    if (criterionNodes.size() > 0)
+        cvSetTrainAndEvalNodes.push_back(criterionNodes[0]->NodeName());
+    for (let node : evaluationNodes)
+        cvSetTrainAndEvalNodes.push_back(node->NodeName());
+
     double learnRatePerSample = 0.5f / m_mbSize[startEpoch];
 
     double learningRateAdjustmentFactor = 1.0f;
@@ -356,12 +486,47 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         // In case of parallel training only the main node should we saving the model to prevent
         // the parallel training nodes from colliding to write the same file
+        if (!m_vocabularyShardedParameters.empty())
+            ComputationNetwork::SetVocabularyShardsFull<ElemType>(net, true);
         if ((m_mpi == nullptr) || m_mpi->IsMainNode())
             net->Save(GetModelNameForEpoch(int(startEpoch) - 1));
+        if (!m_vocabularyShardedParameters.empty())
+            ComputationNetwork::SetVocabularyShardsFull<ElemType>(net, false);
+    }
+
+    m_hogwildWorkers.clear();
+    if (m_hogwildThreads > 1)
+    {
+        if (net->GetDeviceId() != CPUDEVICE)
+            InvalidArgument("hogwildThreads requires training on the CPU.");
+        if (m_mpi != nullptr && m_mpi->NumNodesInUse() > 1)
+            InvalidArgument("hogwildThreads cannot be combined with parallel training.");
+        if (m_pipelineMicroBatches > 1 || m_numSubminiBatches > 1 || m_maxSamplesInRAM < SIZE_MAX)
+            InvalidArgument("hogwildThreads cannot be combined with sub-minibatches or pipelining.");
+        if ((m_needAdaptRegularization && refNode) || m_doGradientCheck || m_lossScaling.IsEnabled())
+            InvalidArgument("hogwildThreads cannot be combined with KL adaptation, gradient checks or loss scaling.");
+        if (m_lazySparseUpdate || m_flatParameters || m_emaDecay > 0)
+            InvalidArgument("hogwildThreads cannot be combined with lazy sparse updates, a flat parameter buffer or moving averages of the parameters.");
+        CreateHogwildWorkers(net, criterionNodes, evaluationNodes, learnableNodes, smoothedGradients, smoothedCounts);
+        LOGPRINTF(stderr, "Hogwild training with %d threads.\n", (int) m_hogwildThreads);
+    }
+
+    if (m_asyncCrossValidation && hasValidationSet)
+    {
+        // the cuBLAS and cuDNN handles of a GPU are shared by all threads, so the replica cannot run on the training GPU
+        if (m_asyncCrossValidationDevice != CPUDEVICE && m_asyncCrossValidationDevice == net->GetDeviceId())
+            InvalidArgument("asyncCrossValidation: asyncCrossValidationDevice must be the CPU or a GPU other than the one trained on.");
+        if (!m_vocabularyShardedParameters.empty())
+            InvalidArgument("asyncCrossValidation cannot be combined with vocabulary-parallel training.");
+        LOGPRINTF(stderr, "Cross validation concurrently with training, on %s.\n",
+                  m_asyncCrossValidationDevice == CPUDEVICE ? "the CPU" : ("GPU " + std::to_string(m_asyncCrossValidationDevice)).c_str());
     }
 
     size_t totalTrainingSamplesSeen = 0; // aggregated over all epochs, for logging purposes only
 
+    if (m_emaDecay > 0)
+        InitEmaValues(learnableNodes);
+
     bool learnRateInitialized = false;
     double prevCriterion = numeric_limits<double>::infinity();
     if (startEpoch > 0)
@@ -375,6 +540,23 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                                      /*out*/ m_prevChosenMinibatchSize);
         if (learnRateInitialized)
             prevLearnRates[startEpoch % m_numPrevLearnRates] = learnRatePerSample;
+
+        // the checkpoint holds the smoothed gradients of the shards of the main node only, those of the sharded parameters start over
+        if (!m_vocabularyShardedParameters.empty())
+        {
+            auto smoothedGradientIter = smoothedGradients.begin();
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+            {
+                if (m_vocabularyShardedParameters.find(*nodeIter) == m_vocabularyShardedParameters.end())
+                    continue;
+                smoothedGradientIter->Resize((*nodeIter)->GetAsMatrixNumRows(), (*nodeIter)->GetAsMatrixNumCols());
+                smoothedGradientIter->SetValue(0);
+            }
+        }
+
+        // With the state of the reader the first epoch starts without replaying the input from the start of the sweep.
+        if (learnRateInitialized && !m_checkPointReaderState.empty() && trainSetDataReader->SetReaderState(m_checkPointReaderState) && m_traceLevel > 0)
+            LOGPRINTF(stderr, "SGD: restored the state of the training reader from the checkpoint.\n");
     }
 
     if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch &&
@@ -403,7 +585,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     if (isSequenceTrainingCriterion)
     {
         ComputationNetwork::SetSeqParam<ElemType>(net, criterionNodes[0], m_hSmoothingWeight, m_frameDropThresh, m_doReferenceAlign,
-                                                  m_seqGammarCalcAMF, m_seqGammarCalcLMF, m_seqGammarCalcWP, m_seqGammarCalcbMMIFactor, m_seqGammarCalcUsesMBR);
+                                                  m_seqGammarCalcAMF, m_seqGammarCalcLMF, m_seqGammarCalcWP, m_seqGammarCalcbMMIFactor, m_seqGammarCalcUsesMBR,
+                                                  m_seqLatticeCacheMB);
     }
 
     // Multiverso Warpper for ASGD logic init
@@ -417,10 +600,22 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                          m_adjustCoefficient,
                                          m_adjustPerMinibatches,
                                          m_traceLevel,
-                                         m_syncStatsTrace));
+                                         m_syncStatsTrace,
+                                         m_mpi,
+                                         m_useMPIParameterServer));
         m_pASGDHelper->InitModel(learnableNodes);
     }
 
+    TimelineProfiler::Instance().Start(m_numMBsToTimelineProfile, net->GetDeviceId(), m_mpi);
+    PerformanceCounters::Instance().SetNodeTimingInterval(m_nodeTimingInterval);
+    if (!m_performanceCountersFile.empty())
+    {
+        wstring path = m_performanceCountersFile;
+        if (m_mpi && m_mpi->NumNodesInUse() > 1)
+            path += L".rank" + std::to_wstring(m_mpi->CurrentNodeRank());
+        PerformanceCounters::Instance().StartExport(path, m_performanceCountersInterval);
+    }
+
     // --- MAIN EPOCH LOOP
     for (int i = startEpoch; i < (int) m_maxEpochs; i++) // TODO: why is this an int, and not a size_t?
     {
@@ -550,23 +745,43 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         EpochCriterion epochCriterion; // criterion values are returned in this
         std::vector<EpochCriterion> epochEvalErrors(evaluationNodes.size());
-        TrainOneEpoch(net,
-                      refNet,
-                      refNode,
-                      i,
-                      m_epochSize,
-                      trainSetDataReader,
-                      learnRatePerSample,
-                      chosenMinibatchSize,
-                      featureNodes,
-                      labelNodes,
-                      criterionNodes,
-                      evaluationNodes,
-                      inputMatrices,
-                      learnableNodes, smoothedGradients, smoothedCounts,
-                      epochCriterion, epochEvalErrors);
+        try
+        {
+            if (!m_hogwildWorkers.empty())
+                TrainOneEpochHogwild(net, i, m_epochSize, trainSetDataReader, learnRatePerSample, chosenMinibatchSize,
+                                     criterionNodes, evaluationNodes, inputMatrices, learnableNodes, smoothedGradients, smoothedCounts,
+                                     epochCriterion, epochEvalErrors);
+            else
+            TrainOneEpoch(net,
+                          refNet,
+                          refNode,
+                          i,
+                          m_epochSize,
+                          trainSetDataReader,
+                          learnRatePerSample,
+                          chosenMinibatchSize,
+                          featureNodes,
+                          labelNodes,
+                          criterionNodes,
+                          evaluationNodes,
+                          inputMatrices,
+                          learnableNodes, smoothedGradients, smoothedCounts,
+                          epochCriterion, epochEvalErrors);
+        }
+        catch (const MpiWorkerFailure& e)
+        {
+            if (!m_elasticTraining)
+                throw;
+            // train this epoch again with the survivors, from where the model is now
+            RecoverFromWorkerFailure(net, criterionNodes[0], i, evaluationNodes.size(), learnableNodes, smoothedGradients, smoothedCounts, e.what());
+            i--;
+            continue;
+        }
         totalTrainingSamplesSeen += epochCriterion.second; // aggregate #training samples, for logging purposes only
 
+        // the checkpoint of the previous epoch may have been written during this one
+        WaitForCheckPointWrites();
+
         timer.Stop();
         double epochTime = timer.ElapsedSeconds();
 
@@ -582,6 +797,10 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         for (size_t j = 0; j < epochEvalErrors.size(); j++)
             epochEvalErrors[j].LogCriterion(evaluationNodes[j]->NodeName());
         fprintf(stderr, "totalSamplesSeen = %d; learningRatePerSample = %.8g; epochTime=%.6gs\n", (int)totalTrainingSamplesSeen, learnRatePerSample, epochTime);
+        if (m_traceLevel > 0)
+            LOGPRINTF(stderr, "Finished Epoch[%2d of %d]: peak shared matrix pool memory = %.1f MB\n", i + 1, (int)m_maxEpochs, net->GetMatrixPoolAllocatedBytes() / (1024.0 * 1024.0));
+        if (m_nodeTimingInterval > 0)
+            net->PrintNodeProfile();
 #if 0
         // TODO: This was only printed if >1 eval criterion. Why? Needed?
         LOGPRINTF(stderr, "Finished Epoch[%2d of %d]:     Criterion Node [%ls] Per Sample = %.8g\n",
@@ -594,30 +813,38 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         }
 #endif
 
-        if (validationSetDataReader != trainSetDataReader && validationSetDataReader != nullptr)
+        bool hasLrControlCriterion = true;
+        if (hasValidationSet)
         {
-            // TODO(dataASGD) making evaluator becoming nondistributed one when using ASGD, since Multiverso has another background thread using MPI.
-            //                Making the evaluation serial (non-distributed) will slowdown training especially when validation set is large.
-            SimpleEvaluator<ElemType> evalforvalidation(net, UsingAsyncGradientAggregation(i + 1) ?nullptr : m_mpi, m_enableDistributedMBReading);
-            vector<wstring> cvSetTrainAndEvalNodes;
-            if (criterionNodes.size() > 0)
+            vector<EpochCriterion> vScore;
+            if (m_asyncCrossValidation)
             {
-                cvSetTrainAndEvalNodes.push_back(criterionNodes[0]->NodeName());
+                // the model of the previous epoch has been evaluated while this one trained
+                int cvEpoch = FinishCrossValidation(vScore);
+                if (cvEpoch >= 0)
+                    LogValidationScores(cvEpoch, cvSetTrainAndEvalNodes, vScore);
+                StartCrossValidation(net, i, validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
+                // after the first epoch (or a rollback), the learning-rate control has nothing to go by yet
+                if (cvEpoch < 0 && m_useCVSetControlLRIfCVExists)
+                    hasLrControlCriterion = false;
             }
-            for (let node : evaluationNodes)
+            else
             {
-                cvSetTrainAndEvalNodes.push_back(node->NodeName());
+                // TODO(dataASGD) making evaluator becoming nondistributed one when using ASGD, since Multiverso has another background thread using MPI.
+                //                Making the evaluation serial (non-distributed) will slowdown training especially when validation set is large.
+                // like for training, distributed reading defaults to 'true' for V2 readers, which makes the workers evaluate disjoint subsets
+                bool enableDistributedCVReading = m_enableDistributedMBReading || (m_enableDistributedMBReadingNotSpecified && !validationSetDataReader->IsLegacyReader());
+                SimpleEvaluator<ElemType> evalforvalidation(net, UsingAsyncGradientAggregation(i + 1) ?nullptr : m_mpi, enableDistributedCVReading);
+
+                // BUGBUG: We should not use the training MB size. The training MB size is constrained by both convergence and memory. Eval is only constrained by memory.
+                // With emaDecay, the model is validated with the moving averages of the parameters.
+                SwapEmaValues();
+                vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
+                SwapEmaValues();
+                LogValidationScores(i, cvSetTrainAndEvalNodes, vScore);
             }
 
-            // BUGBUG: We should not use the training MB size. The training MB size is constrained by both convergence and memory. Eval is only constrained by memory.
-            let vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
-            LOGPRINTF(stderr, "Finished Epoch[%2d of %d]: [Validate] ", i + 1, (int)m_maxEpochs);
-            for (size_t k = 0; k < vScore.size() /*&& k < 2*/; k++)
-                vScore[k].LogCriterion(cvSetTrainAndEvalNodes[k], /*addSemicolon=*/k + 1 < vScore.size());
-                //fprintf(stderr, "%s %ls = %.8f * %d", k ? ";" : "", cvSetTrainAndEvalNodes[k].c_str(), vScore[k].Average(), (int)vScore[k].second);
-            fprintf(stderr, "\n");
-
-            if (m_useCVSetControlLRIfCVExists)
+            if (m_useCVSetControlLRIfCVExists && !vScore.empty())
             {
                 if (m_useEvalCriterionControlLR && vScore.size() > 1)
                     lrControlCriterion = vScore[1].Average(); // use the first of possibly multiple eval criteria
@@ -639,7 +866,11 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         bool loadedPrevModel = false;
         size_t epochsSinceLastLearnRateAdjust = i % m_learnRateAdjustInterval + 1;
-        if (avgCriterion == numeric_limits<double>::infinity())
+        if (!hasLrControlCriterion) // (the epoch is counted with the next one, when its cross validation has finished)
+        {
+            epochsNotCountedInAvgCriterion++;
+        }
+        else if (avgCriterion == numeric_limits<double>::infinity())
         {
             avgCriterion = lrControlCriterion;
         }
@@ -651,8 +882,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                            (epochsSinceLastLearnRateAdjust - epochsNotCountedInAvgCriterion);
         }
 
+        bool hasAvgCriterion = epochsSinceLastLearnRateAdjust > epochsNotCountedInAvgCriterion;
         if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch &&
-            m_learningRatesParam.size() <= i && epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
+            m_learningRatesParam.size() <= i && epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval && hasAvgCriterion)
         {
             if (std::isnan(avgCriterion) || (prevCriterion - avgCriterion < 0 && prevCriterion != numeric_limits<double>::infinity()))
             {
@@ -670,6 +902,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                        /*out*/ prevCriterion,
                                        /*out*/ m_prevChosenMinibatchSize);
                     loadedPrevModel = true;
+                    DiscardCrossValidation();
                 }
             }
 
@@ -728,7 +961,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // not loading previous values then set them
         if (!loadedPrevModel && epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
         {
-            prevCriterion = avgCriterion;
+            if (hasAvgCriterion)
+                prevCriterion = avgCriterion;
             epochsNotCountedInAvgCriterion = 0;
         }
 
@@ -737,6 +971,10 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // as rank 0 deleting it below
         SynchronizeWorkers();
 
+        // the model holds the weights of all words (all workers take part in gathering them)
+        if (!m_vocabularyShardedParameters.empty())
+            ComputationNetwork::SetVocabularyShardsFull<ElemType>(net, true);
+
         // Persist model and check-point info
         if ((m_mpi == nullptr) || m_mpi->IsMainNode())
         {
@@ -748,7 +986,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     int epochToDelete = i - j;
                     LOGPRINTF(stderr, "SGD: removing model and checkpoint files for epoch %d after rollback to epoch %lu\n", epochToDelete + 1, (unsigned long)(i - m_learnRateAdjustInterval) + 1);  // report 1 based epoch number
                     _wunlink(GetModelNameForEpoch(epochToDelete).c_str());
-                    _wunlink(GetCheckPointFileNameForEpoch(epochToDelete).c_str());
+                    _wunlink((GetModelNameForEpoch(epochToDelete) + L".ema").c_str());
+                    DeleteCheckPointFiles(epochToDelete);
                 }
 
                 // Set i back to the loaded model
@@ -758,11 +997,18 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             }
             else
             {
-                SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts, prevCriterion, chosenMinibatchSize);
+                SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts, prevCriterion, chosenMinibatchSize,
+                                   trainSetDataReader->GetReaderState());
                 auto modelName = GetModelNameForEpoch(i);
                 if (m_traceLevel > 0)
                     LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-                net->Save(modelName);
+                SaveModel(net, modelName);
+                if (!m_emaValues.empty())
+                {
+                    SwapEmaValues();
+                    SaveModel(net, modelName + L".ema");
+                    SwapEmaValues();
+                }
                 if (!m_keepCheckPointFiles)
                 {
                     // delete previous checkpoint file to save space
@@ -770,16 +1016,16 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     {
                         if (epochsSinceLastLearnRateAdjust != 1)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                            DeleteCheckPointFiles(i - 1);
                         }
                         if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
+                            DeleteCheckPointFiles(i - m_learnRateAdjustInterval);
                         }
                     }
                     else
                     {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                        DeleteCheckPointFiles(i - 1);
                     }
                 }
             }
@@ -791,8 +1037,14 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 // Set i back to the loaded model
                 i -= m_learnRateAdjustInterval;
             }
+
+            // with sharded checkpoints, the other workers save their share of the smoothed gradients
+            SaveCheckPointShard(i, smoothedGradients);
         }
 
+        if (!m_vocabularyShardedParameters.empty())
+            ComputationNetwork::SetVocabularyShardsFull<ElemType>(net, false);
+
         if (learnRatePerSample < 1e-12)
         {
             LOGPRINTF(stderr, "learnRate per sample is reduced to %.8g which is below 1e-12. stop training.\n",
@@ -801,6 +1053,28 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
     // --- END OF MAIN EPOCH LOOP
 
+    if (m_asyncCrossValidation && hasValidationSet)
+    {
+        vector<EpochCriterion> vScore;
+        int cvEpoch = FinishCrossValidation(vScore);
+        if (cvEpoch >= 0)
+            LogValidationScores(cvEpoch, cvSetTrainAndEvalNodes, vScore);
+        m_crossValidationReplica.reset();
+        _wunlink(GetCrossValidationSnapshotPath().c_str());
+    }
+
+    WaitForCheckPointWrites();
+    TimelineProfiler::Instance().Write(m_timelineProfileFile, m_mpi);
+
+    // leave the network with the weights of all words, as it was given
+    if (!m_vocabularyShardedParameters.empty())
+    {
+        ComputationNetwork::SetVocabularyShardsFull<ElemType>(net, true);
+        ComputationNetwork::ShardVocabularyParallelNodes<ElemType>(net, nullptr, 0, 1);
+        m_vocabularyShardedParameters.clear();
+    }
+    PerformanceCounters::Instance().StopExport(); // writes the final values
+
     // Synchronize all ranks before proceeding to ensure that
     // rank 0 has finished writing the model file
     // TODO[DataASGD]: should othet other rank waiting in async-mode
@@ -912,9 +1186,10 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     }
 
     // prepare for sub-minibatching
-    // Sub-minibatching is used if a single minibatch is too large to fit into GPU RAM.
+    // Sub-minibatching is used if a single minibatch is too large to fit into GPU RAM, and for the micro-batches of pipeline parallelism.
     DataReaderHelpers::SubminibatchDispatcher<ElemType> smbDispatcher;
-    size_t numSubminibatchesNeeded = DataReaderHelpers::GetNumSubminibatchesNeeded<ElemType>(trainSetDataReader, m_maxSamplesInRAM, m_numSubminiBatches, tunedMBSize);
+    size_t numSubminibatchesNeeded = m_pipelineMicroBatches > 1 ? m_pipelineMicroBatches :
+                                     DataReaderHelpers::GetNumSubminibatchesNeeded<ElemType>(trainSetDataReader, m_maxSamplesInRAM, m_numSubminiBatches, tunedMBSize);
 
     // this is non-trivial, we need a manager object to handle this
     if (numSubminibatchesNeeded > 1)
@@ -937,8 +1212,12 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             fprintf(stderr, ", DataParallelSGD training (myRank = %d, numNodes = %d, numGradientBits = %d)",
                     (int) m_mpi->CurrentNodeRank(), (int) m_mpi->NumNodesInUse(), (int) m_numGradientBits[epochNumber]);
 
+            if (m_gradientDensity < 1)
+                fprintf(stderr, ", gradientDensity = %g", m_gradientDensity);
             if (m_bufferedAsyncGradientAggregation)
                 fprintf(stderr, ", BufferedAsyncGradientAggregation is ENABLED");
+            else if (m_gradientBucketSizeInMB > 0)
+                fprintf(stderr, ", overlapped in gradient buckets of %d MB", (int) m_gradientBucketSizeInMB);
         }
 
         if (useAsyncGradientAggregation)
@@ -955,7 +1234,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         if (useDistributedMBReading)
             fprintf(stderr, ", distributed reading is ENABLED");
 
-        if (numSubminibatchesNeeded > 1)
+        if (m_pipelineMicroBatches > 1)
+            fprintf(stderr, ", pipelined in %d micro-batches", (int) m_pipelineMicroBatches);
+        else if (numSubminibatchesNeeded > 1)
         {
             if (m_maxSamplesInRAM < SIZE_MAX)
                 fprintf(stderr, ", with maximum %d samples in RAM", (int)m_maxSamplesInRAM);
@@ -982,6 +1263,96 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     EpochCriterion         epochCriterionLastLogged  = epochCriterion;
     vector<EpochCriterion> epochEvalErrorsLastLogged = epochEvalErrors;
 
+    // Progress tracing. Reading the criteria from the GPU would wait for it to finish all queued work, so without
+    // aggregation they are fetched asynchronously, and a trace line is printed once its values have arrived.
+    struct ProgressTrace
+    {
+        int m_firstMB;
+        int m_lastMB;
+        double m_mbProg;
+        int m_mbProgNumPrecision;
+        bool m_wasProgressPrinted;
+        double m_seconds;
+    };
+    size_t criterionSamplesLastLogged = epochCriterionLastLogged.second;
+    CriterionFetcher<ElemType> criterionFetcher(net->GetDeviceId());
+    std::deque<ProgressTrace> pendingProgressTraces;
+    auto PrintProgressTrace = [&](const ProgressTrace& trace, const EpochCriterion& criterion, const vector<EpochCriterion>& evalErrors)
+    {
+        // the criterion aggregates over entire epoch, but we only show difference to last time we logged
+        EpochCriterion epochCriterionSinceLastLogged = criterion - epochCriterionLastLogged;
+        let trainLossSinceLastLogged    =      epochCriterionSinceLastLogged.Average();
+        let trainSamplesSinceLastLogged = (int)epochCriterionSinceLastLogged.second;
+
+        // progress tracing for regular log
+        if (m_traceLevel > 0)
+        {
+            PREPENDTS(stderr);
+            fprintf(stderr, "%s Epoch[%2d of %d]-Minibatch[%4d-%4d",
+                    prefixMsg.c_str(), epochNumber + 1, (int)m_maxEpochs, trace.m_firstMB, trace.m_lastMB);
+            if (epochNumber > 0 || (int)epochSize > 0) // got anything?  --TODO: why cast epochSize to (int) for this comparison?
+                fprintf(stderr, (", %2." + to_string(trace.m_mbProgNumPrecision) + "f%%").c_str(), trace.m_mbProg * 100); // --TODO: use a * format?
+            fprintf(stderr, "]: ");
+            epochCriterionSinceLastLogged.LogCriterion(criterionNodes[0]->NodeName());
+            for (size_t i = 0; i < evalErrors.size(); i++)
+            {
+                const std::wstring& nodeName = evaluationNodes[i]->NodeName();
+                if (ContainsAccumulatedResult(evaluationNodes[i]))
+                {
+                    // For aggregation nodes, we don't report per minibatch error. These nodes calculate
+                    // aggregated error for all samples that passed through network, instead of calculating per
+                    // sample error. Aggregated error for all samples will be reported for these nodes.
+                    evalErrors[i].LogCriterion(nodeName);
+                }
+                else
+                {
+                    // Report per minibatch error.
+                    (evalErrors[i] - epochEvalErrorsLastLogged[i]).LogCriterion(nodeName);
+                }
+            }
+
+            fprintf(stderr, ("time = " + GeneratePaddedFloatOrExpFormat(0, 4, trace.m_seconds) + "s; samplesPerSecond = %.1f\n").c_str(),
+                    trace.m_seconds, trainSamplesSinceLastLogged / trace.m_seconds);
+        }
+
+        // progress tracing for compute cluster management
+        if (trace.m_wasProgressPrinted)
+            ProgressTracing::TraceTrainLoss(trainLossSinceLastLogged);
+
+        if (m_traceLevel > 0)
+            fflush(stderr);
+
+        if (criterion.IsNan())
+            RuntimeError("The training criterion is not a number (NAN).");
+
+        // reset statistics for differential logging
+        epochCriterionLastLogged  = criterion;
+        epochEvalErrorsLastLogged = evalErrors;
+        for (size_t i = 0; i < evalErrors.size(); i++)
+        {
+            if (ContainsAccumulatedResult(evaluationNodes[i]))
+            {
+                // For nodes that accumulate result we report accumulated error for all samples that passed through
+                // network so far, instead of per minibatch error. So, we reset last logged error here.
+                epochEvalErrorsLastLogged[i] = EpochCriterion(0);
+            }
+        }
+    };
+    // prints the pending traces whose values have arrived, waiting for the oldest ones if more than 'maxPending' are left
+    vector<EpochCriterion> fetchedCriteria;
+    auto PrintFetchedProgressTraces = [&](size_t maxPending)
+    {
+        while (!pendingProgressTraces.empty())
+        {
+            if (pendingProgressTraces.size() > maxPending)
+                criterionFetcher.Take(fetchedCriteria);
+            else if (!criterionFetcher.TryTake(fetchedCriteria))
+                break;
+            PrintProgressTrace(pendingProgressTraces.front(), fetchedCriteria[0], vector<EpochCriterion>(fetchedCriteria.begin() + 1, fetchedCriteria.end()));
+            pendingProgressTraces.pop_front();
+        }
+    };
+
     // NOTE: For ResNet, the regularization in BatchNormalization should be disabled.
     if (m_disableRegInBatchNormalization) {
         let bnNodes = net->GetNodesWithType(L"BatchNormalization");
@@ -1008,6 +1379,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     bool isFirstMinibatch = true;
     for (;;)
     {
+        TimelineProfiler::Instance().BeginStep();
+        PerformanceCounters::Instance().BeginMinibatch();
+
         // Per-minibatch performance measurements; only enabled when perfTraceLevel > 0
         Timer fineGrainedPerfMeasurementTimer;
         double readTime = 0;
@@ -1020,8 +1394,12 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         // get minibatch
         // TODO: is it guaranteed that the GPU is already completed at this point, is it safe to overwrite the buffers?
         size_t actualMBSize = 0;
+        size_t readerSpan = TimelineProfiler::Instance().BeginSpan("reader");
+        auto readerStart = std::chrono::steady_clock::now();
         bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, criterionNodes[0],
                                                                                 useDistributedMBReading, useParallelTrain, *inputMatrices, actualMBSize, m_mpi);
+        PerformanceCounters::Instance().Add(PerformanceCounters::ReaderWaitMicroseconds, ElapsedMicroseconds(readerStart));
+        TimelineProfiler::Instance().EndSpan(readerSpan);
 
         if (maxNumSamplesExceeded) // Dropping data.
             wasDataRead = false;
@@ -1085,7 +1463,10 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             // We optionally break the minibatch into sub-minibatches.
             // This, when enabled, is used when a full minibatch does not fit into GPU RAM.
             size_t actualNumSubminibatches = numSubminibatchesNeeded <= 1 ? 1 : smbDispatcher.GetMinibatchIntoCache(*trainSetDataReader, *net, *inputMatrices, numSubminibatchesNeeded);
-            for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
+            bool pipelined = m_pipelineMicroBatches > 1 && actualNumSubminibatches > 1 && learnRatePerSample > 0.01 * m_minLearnRate;
+            if (pipelined)
+                ForwardBackwardPipelined(net, evaluationNodes, featureNodes, labelNodes, smbDispatcher, actualNumSubminibatches);
+            for (size_t ismb = 0; ismb < actualNumSubminibatches && !pipelined; ismb++)
             {
                 if (actualNumSubminibatches > 1)
                 {
@@ -1098,8 +1479,16 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // forward prop for evaluate eval nodes
                 // ===========================================================
 
+                // record the memory per node over forward and backward of one minibatch; buffers grow on first use, so the
+                // first minibatch shows when the peak is reached
+                bool recordMemoryTimeline = !m_memoryTimelineFile.empty() && !m_isMemoryTimelineRecorded && ismb == 0 &&
+                                            numMBsRun == (int) m_memoryTimelineMinibatch;
+                if (recordMemoryTimeline)
+                    net->BeginMemoryTimeline();
+
                 // compute eval node first since when gradient is computed the forward function values
                 // may be changed and need to be recomputed when gradient and function value share the same matrix
+                size_t forwardSpan = TimelineProfiler::Instance().BeginSpan("forward", TimelineProfiler::Track::Gpu);
                 net->ForwardProp(evaluationNodes); // the bulk of this evaluation is reused in ComputeGradient() below
 
                 // ===========================================================
@@ -1107,18 +1496,55 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // ===========================================================
 
                 net->ForwardProp(criterionNodes[0]);
+                TimelineProfiler::Instance().EndSpan(forwardSpan);
 
                 // ===========================================================
                 // backprop
                 // ===========================================================
 
                 if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                {
+                    TimelineSpan backwardSpan("backward", TimelineProfiler::Track::Gpu);
+                    // The aggregator may start to reduce a gradient as soon as backprop has completed it, which it has
+                    // only in the last sub-minibatch. (learnParamsGradients is formed by the first aggregation.)
+                    if (useGradientAggregation && ismb + 1 == actualNumSubminibatches &&
+                        !learnParamsGradients.empty() && m_distGradAgg->BeginOverlappedAggregation(learnParamsGradients))
+                    {
+                        net->Backprop(criterionNodes[0], m_lossScaling.GetScale(), [this](const ComputationNodeBasePtr& nodeBase)
+                        {
+                            ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodeBase);
+                            if (node && node->IsParameterUpdateRequired())
+                                m_distGradAgg->OnGradientComplete(&node->Gradient());
+                        });
+                    }
+                    else
+                        net->Backprop(criterionNodes[0], m_lossScaling.GetScale());
+                }
+
+                if (recordMemoryTimeline)
+                {
+                    m_isMemoryTimelineRecorded = true;
+                    if (auto timeline = net->EndMemoryTimeline())
+                    {
+                        wstring path = m_memoryTimelineFile;
+                        if (m_mpi && m_mpi->NumNodesInUse() > 1)
+                            path += L".rank" + std::to_wstring(m_mpi->CurrentNodeRank());
+                        timeline->Save(path);
+                        timeline->PrintReport(m_memoryTimelineTopN);
+                    }
+                }
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
                     smbDispatcher.DoneWithCurrentSubMinibatch(ismb); // page state out
             }                                                        // end sub-minibatch loop
+            if (m_nonFiniteCheckFrequency > 0)
+            {
+                // a sub-minibatch or a pipelined minibatch cannot be rerun from the network's inputs, nor one whose gradients are being aggregated
+                bool canRerun = actualNumSubminibatches == 1 && !pipelined && !useGradientAggregation;
+                CheckNonFiniteValues(net, criterionNodes[0], evaluationNodes, featureNodes, labelNodes, learnableNodes,
+                                     learnRatePerSample > 0.01 * m_minLearnRate, numMBsRun + 1, canRerun);
+            }
             if (actualNumSubminibatches > 1)
                 smbDispatcher.DoneWithCurrentMinibatch();
         } // if (actualMBSize > 0)
@@ -1168,11 +1594,18 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (learnParamsGradients.size() == 0)
             {
                 // lazily form the list of smoothedGradients to exchange
+                // With a flat parameter buffer and full-precision aggregation, the gradients in the buffer are reduced as one matrix.
+                // (Quantization and sparsification work per gradient matrix, and the buckets follow the gradients as backprop completes them.)
+                bool aggregateFlatGradients = m_flatParameters && m_flatParameters->AreGradientsBound() &&
+                                              m_numGradientBits[epochNumber] == 8 * sizeof(ElemType) && m_gradientDensity >= 1 && m_gradientBucketSizeInMB == 0;
                 learnParamsGradients.reserve(learnableNodes.size());
+                if (aggregateFlatGradients)
+                    learnParamsGradients.push_back(&m_flatParameters->Gradients());
                 for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
                 {
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
-                    if (node->IsParameterUpdateRequired())
+                    if (node->IsParameterUpdateRequired() && !(aggregateFlatGradients && m_flatParameters->Contains(node)) &&
+                        m_vocabularyShardedParameters.find(node) == m_vocabularyShardedParameters.end())
                     {
                         Matrix<ElemType>* currParamsGradient = &(node->Gradient()); // TODO: we can use shared_ptrs now
 
@@ -1204,7 +1637,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
             // aggregate
             m_gradHeader->numEvalNode = evaluationNodes.size(); // TODO: rename numEvalNode (plural)
+            size_t aggregationSpan = TimelineProfiler::Instance().BeginSpan("aggregate gradients");
+            auto aggregationStart = std::chrono::steady_clock::now();
             bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader.get(), isFirstMinibatch);
+            PerformanceCounters::Instance().Add(PerformanceCounters::CommunicationWaitMicroseconds, ElapsedMicroseconds(aggregationStart));
+            TimelineProfiler::Instance().EndSpan(aggregationSpan);
             noMoreSamplesToProcess = !samplesProcessed;
 
             // read out the header--now everything is aggregated
@@ -1230,8 +1667,14 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         }
 
         // update model parameters
-        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
+        // With loss scaling the (aggregated) gradients are unscaled first, a minibatch with overflowing gradients is skipped.
+        bool updateParameters = (aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01);
+        if (updateParameters && m_lossScaling.IsEnabled())
+            updateParameters = UnscaleGradients(learnableNodes);
+
+        if (updateParameters)
         {
+            TimelineSpan updateSpan("update", TimelineProfiler::Track::Gpu);
 #if 1       // BUGBUG: We must skip gaps in our momentum, clipping, regularization etc. criteria.
             // This will break test cases. So for now, we will only enable this for per-sample criteria.
             size_t numSamplesInMinibatch = aggregateNumSamples;
@@ -1242,29 +1685,49 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (numSamplesInMinibatch != aggregateNumSamples)
                 fprintf(stderr, "SGD: using true #samples %d instead of MB size %d\n", (int)numSamplesInMinibatch, (int)aggregateNumSamples);
 #endif
+            // BUGBUG (Issue #95): Access to net MBLayout can no longer be done if we have multiple input layouts
+            double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
+            double globalNormClippingFactor = GetGlobalNormClippingFactor(learnableNodes, numSamplesInMinibatch);
+            vector<bool> isUpdated(learnableNodes.size(), false);
+            m_lazyUpdateCount++;
+            if (m_fusedParameterUpdate)
+                isUpdated = UpdateWeightsFused(learnableNodes, smoothedGradients, smoothedCounts, learnRatePerSample, momentumPerSample, numSamplesInMinibatch, globalNormClippingFactor);
+
+            // the parameters that the fused update did not handle, one by one
             auto smoothedGradientIter = smoothedGradients.begin();
             auto smoothedCountIter = smoothedCounts.begin();
-            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, smoothedCountIter++)
+            auto isUpdatedIter = isUpdated.begin();
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, smoothedCountIter++, isUpdatedIter++)
             {
                 ComputationNodeBasePtr node = *nodeIter;
                 if (node->IsParameterUpdateRequired())
                 {
+                    if (*isUpdatedIter)
+                    {
+                        node->BumpEvalTimeStamp();
+                        continue;
+                    }
 #ifdef _DEBUG
                     if (smoothedGradientIter->HasNan("TrainOneEpoch/UpdateWeights(): "))
                         LogicError("%ls %ls operation has NaNs in smoothedGradient.", node->NodeName().c_str(), node->OperationName().c_str());
 #endif
                     double nodeDependentLearningRatePerSample = learnRatePerSample * node->GetLearningRateMultiplier();
                     double nodeDependentRegMultiplier = dynamic_pointer_cast<LearnableParameter<ElemType>>(node)->GetRegMultiplier();
-                    double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
+                    if (globalNormClippingFactor != 1)
+                        dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient() *= (ElemType) globalNormClippingFactor;
+                    // parameters are updated lazily from their first sparse gradient on
+                    LazyUpdateState* lazyUpdateState = nullptr;
+                    if (m_lazySparseUpdate && (dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient().GetMatrixType() == MatrixType::SPARSE || m_lazyUpdateStates.count(node) > 0))
+                        lazyUpdateState = &m_lazyUpdateStates[node];
                     // TODO: Check why l2Factor is not applied to L1. Bug?
-                    // BUGBUG (Issue #95): Access to net MBLayout can no longer be done if we have multiple input layouts
                     UpdateWeights(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(),
                                   dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient(),
                                   *smoothedGradientIter, *smoothedCountIter,
                                   nodeDependentLearningRatePerSample, momentumPerSample,
                                   numSamplesInMinibatch,
                                   m_L2RegWeight * nodeDependentRegMultiplier, m_L1RegWeight * nodeDependentRegMultiplier,
-                                  m_needAveMultiplier, m_useNesterovMomentum);
+                                  m_needAveMultiplier, m_useNesterovMomentum, lazyUpdateState);
+                    UpdateEmaValue(node);
                     node->BumpEvalTimeStamp();
 #ifdef _DEBUG
                     if (dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().HasNan("TrainOneEpoch/UpdateWeights(): "))
@@ -1289,7 +1752,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         {
             if (nSamplesSinceLastModelSync >= blockSizePerWorker)
             {
+                size_t modelAggregationSpan = TimelineProfiler::Instance().BeginSpan("model aggregation");
+                auto modelAggregationStart = std::chrono::steady_clock::now();
                 bool synced = m_pMASGDHelper->OnArrivingAtSyncPoint(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
+                PerformanceCounters::Instance().Add(PerformanceCounters::CommunicationWaitMicroseconds, ElapsedMicroseconds(modelAggregationStart));
+                TimelineProfiler::Instance().EndSpan(modelAggregationSpan);
                 if (synced)
                 {
                     nSamplesSinceLastModelSync = 0;
@@ -1337,26 +1804,14 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
         // log
         // This shows the criterion since last logged.
+        if (!pendingProgressTraces.empty())
+            PrintFetchedProgressTraces(SIZE_MAX);
         if (numMBsRun <= m_firstMBsToShowResult || (m_numMBsToShowResult && (numMBsRun % m_numMBsToShowResult == 0)))
         {
-            // get the epoch Values updated
-            if (!useGradientAggregation)
-            {
-                // if no aggregation, we directly get the values from the minibatch accumulators
-                timer.Restart();
-                epochCriterion = localEpochCriterion.GetCriterion(0);
-                for (size_t i = 0; i < epochEvalErrors.size(); i++)
-                    epochEvalErrors[i] = localEpochEvalErrors.GetCriterion(i);
-                timer.Stop();
-
-                // Add the last trailing compute
-                totalTimeInMBs += timer.ElapsedSeconds();
-            }
-
-            // epochCriterion aggregates over entire epoch, but we only show difference to last time we logged
-            EpochCriterion epochCriterionSinceLastLogged = epochCriterion - epochCriterionLastLogged;
-            let trainLossSinceLastLogged    =      epochCriterionSinceLastLogged.Average(); // TODO: Check whether old trainSamplesSinceLastLogged matches this ^^ difference
-            let trainSamplesSinceLastLogged = (int)epochCriterionSinceLastLogged.second;
+            // the sample counts are known on the CPU, only the criterion values may have to come from the GPU
+            size_t criterionSamples = useGradientAggregation ? epochCriterion.second : localEpochCriterion.GetAggregateSampleCounts()[0];
+            let trainSamplesSinceLastLogged = (int)(criterionSamples - criterionSamplesLastLogged);
+            criterionSamplesLastLogged = criterionSamples;
 
             // determine progress in percent
             int mbProgNumPrecision = 2;
@@ -1377,68 +1832,32 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             // progress tracing for compute cluster management
             let wasProgressPrinted = ProgressTracing::TraceProgressPercentage(epochNumber, mbProg, false);
 
-            // progress tracing for regular log
-            if (m_traceLevel > 0)
+            ProgressTrace trace = { (int)numMBsRunSinceLastLogged + 1, (int)numMBsRun, mbProg, mbProgNumPrecision, wasProgressPrinted, totalTimeInMBs };
+            if (useGradientAggregation)
             {
-                PREPENDTS(stderr);
-                fprintf(stderr, "%s Epoch[%2d of %d]-Minibatch[%4d-%4d",
-                        prefixMsg.c_str(), epochNumber + 1, (int)m_maxEpochs,
-                        (int)(numMBsRunSinceLastLogged + 1), numMBsRun);
-                if (epochNumber > 0 || (int)epochSize > 0) // got anything?  --TODO: why cast epochSize to (int) for this comparison?
-                    fprintf(stderr, (", %2." + to_string(mbProgNumPrecision) + "f%%").c_str(), mbProg * 100); // --TODO: use a * format?
-                fprintf(stderr, "]: ");
-                epochCriterionSinceLastLogged.LogCriterion(criterionNodes[0]->NodeName());
-                for (size_t i = 0; i < epochEvalErrors.size(); i++)
-                {
-                    const std::wstring& nodeName = evaluationNodes[i]->NodeName();
-                    if (ContainsAccumulatedResult(evaluationNodes[i]))
-                    {
-                        // For aggregation nodes, we don't report per minibatch error. These nodes calculate
-                        // aggregated error for all samples that passed through network, instead of calculating per
-                        // sample error. Aggregated error for all samples will be reported for these nodes.
-                        epochEvalErrors[i].LogCriterion(nodeName);
-                    }
-                    else
-                    {
-                        // Report per minibatch error.
-                        (epochEvalErrors[i] - epochEvalErrorsLastLogged[i]).LogCriterion(nodeName);
-                    }
-                }
-
-                fprintf(stderr, ("time = " + GeneratePaddedFloatOrExpFormat(0, 4, totalTimeInMBs) + "s; samplesPerSecond = %.1f\n").c_str(),
-                        totalTimeInMBs, trainSamplesSinceLastLogged / totalTimeInMBs);
+                // the values were aggregated into the 'out' variables on the CPU
+                PrintProgressTrace(trace, epochCriterion, epochEvalErrors);
             }
-
-            // progress tracing for compute cluster management
-            if (wasProgressPrinted)
-                ProgressTracing::TraceTrainLoss(trainLossSinceLastLogged);
-
-            if (m_traceLevel > 0)
-                fflush(stderr);
-
-            if (epochCriterion.IsNan())
-                RuntimeError("The training criterion is not a number (NAN).");
-
-            // reset statistics for differential logging
-            epochCriterionLastLogged  = epochCriterion;
-            epochEvalErrorsLastLogged = epochEvalErrors;
-            numMBsRunSinceLastLogged = numMBsRun;
-            for (size_t i = 0; i < epochEvalErrors.size(); i++)
+            else
             {
-                if (ContainsAccumulatedResult(evaluationNodes[i]))
-                {
-                    // For nodes that accumulate result we report accumulated error for all samples that passed through
-                    // network so far, instead of per minibatch error. So, we reset last logged error here.
-                    epochEvalErrorsLastLogged[i] = EpochCriterion(0);
-                }
+                // if no aggregation, we get the values from the minibatch accumulators, without waiting for the GPU
+                PrintFetchedProgressTraces(criterionFetcher.NumSlots() - 1);
+                criterionFetcher.Fetch({ &localEpochCriterion, &localEpochEvalErrors });
+                pendingProgressTraces.push_back(trace);
             }
 
+            numMBsRunSinceLastLogged = numMBsRun;
             totalTimeInMBs = 0;
         }
 
         timer.Restart();
         totalEpochSamples += aggregateNumSamplesWithLabel;
 
+        // samples of all workers, as for the progress output
+        PerformanceCounters::Instance().EndMinibatch(aggregateNumSamplesWithLabel);
+        if (net->GetDeviceId() >= 0)
+            UpdateDeviceMemoryCounters(net->GetDeviceId());
+
         // call DataEnd function
         // This signals something from SGD to the reader.
         // DataEnd does reader specific process if sentence ending is reached
@@ -1457,6 +1876,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
     // --- END MAIN MINIBATCH LOOP
 
+    PrintFetchedProgressTraces(0);
+
+    TimelineProfiler::Instance().EndStep();
+
+    if (m_lazySparseUpdate)
+        CatchUpLazyUpdates(learnableNodes, smoothedGradients);
+
     if (useModelAggregation )
     {
         m_pMASGDHelper->OnEpochEnd(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
@@ -1524,6 +1950,243 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     return totalEpochSamples;
 }
 
+// The workers are replicas of the network loaded from a copy of its model. Their parameters are then made to share the
+// values of the network's parameters; everything else, the activations, gradients and the optimizer state, is their own.
+template <class ElemType>
+void SGD<ElemType>::CreateHogwildWorkers(ComputationNetworkPtr net,
+                                         const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                         const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                         const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                         const std::list<Matrix<ElemType>>& smoothedGradients, const std::vector<double>& smoothedCounts)
+{
+    wstring replicaModelPath = m_modelPath + L".hogwild";
+    net->Save(replicaModelPath);
+    for (size_t i = 1; i < m_hogwildThreads; i++)
+    {
+        auto worker = make_shared<HogwildWorker>();
+        auto& replica = worker->net;
+        replica = ComputationNetwork::CreateFromFile<ElemType>(CPUDEVICE, replicaModelPath);
+        for (const auto& node : criterionNodes)
+            worker->criterionNodes.push_back(replica->GetNodeFromName(node->NodeName()));
+        for (const auto& node : evaluationNodes)
+            worker->evaluationNodes.push_back(replica->GetNodeFromName(node->NodeName()));
+        for (const auto& node : learnableNodes)
+        {
+            auto replicaNode = replica->GetNodeFromName(node->NodeName());
+            dynamic_pointer_cast<ComputationNode<ElemType>>(replicaNode)->ValuePtrRef() = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->ValuePtrRef();
+            worker->learnableNodes.push_back(replicaNode);
+        }
+        for (const auto& smoothedGradient : smoothedGradients)
+            worker->smoothedGradients.push_back(smoothedGradient.DeepClone());
+        worker->smoothedCounts = smoothedCounts;
+
+        replica->AllocateAllMatrices(worker->evaluationNodes, {}, worker->criterionNodes[0]);
+        for (size_t pass = 0; pass < 2; pass++)
+        {
+            auto& nodes = (pass == 0) ? replica->FeatureNodes() : replica->LabelNodes();
+            for (const auto& node : nodes)
+                worker->inputMatrices.AddInput(node->NodeName(), node->ValuePtr(), node->GetMBLayout(), node->GetSampleLayout());
+        }
+        m_hogwildWorkers.push_back(worker);
+    }
+    _wunlink(replicaModelPath.c_str());
+}
+
+// One epoch of Hogwild training (Niu et al., 2011): the network and the workers each train on minibatches of their own,
+// and update the shared parameter values whenever they are done with one. Sparse gradients, as of the embeddings of sparse
+// linear and factorization machine models, touch only their columns, so that updates rarely collide.
+template <class ElemType>
+size_t SGD<ElemType>::TrainOneEpochHogwild(ComputationNetworkPtr net,
+                                           const int epochNumber,
+                                           const size_t epochSize,
+                                           IDataReader* trainSetDataReader,
+                                           const double learnRatePerSample,
+                                           size_t tunedMBSize,
+                                           const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                           const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                           StreamMinibatchInputs* inputMatrices,
+                                           const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                           std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                                           /*out*/ EpochCriterion& epochCriterion,
+                                           /*out*/ std::vector<EpochCriterion>& epochEvalErrors)
+{
+    // the trained network is the first worker; its optimizer state is the one that is checkpointed
+    HogwildWorker self;
+    self.net = net;
+    self.criterionNodes = criterionNodes;
+    self.evaluationNodes = evaluationNodes;
+    self.learnableNodes = learnableNodes;
+    self.smoothedGradients.swap(smoothedGradients);
+    self.smoothedCounts.swap(smoothedCounts);
+    for (const auto& input : *inputMatrices)
+        self.inputMatrices.AddInput(input.first, input.second);
+
+    vector<HogwildWorker*> workers{ &self };
+    for (const auto& worker : m_hogwildWorkers)
+        workers.push_back(worker.get());
+
+    trainSetDataReader->StartMinibatchLoop(tunedMBSize, epochNumber, inputMatrices->GetStreamDescriptions(), epochSize);
+    if (m_traceLevel > 0)
+        LOGPRINTF(stderr, "Starting minibatch loop, Hogwild training with %d threads.\n", (int) workers.size());
+
+    std::mutex readerMutex;
+    vector<EpochCriterion> workerCriteria(workers.size());
+    vector<vector<EpochCriterion>> workerEvalErrors(workers.size(), vector<EpochCriterion>(evaluationNodes.size()));
+    vector<std::future<size_t>> results;
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        results.push_back(std::async(std::launch::async, [&, i]()
+        {
+            return TrainHogwildWorker(*workers[i], trainSetDataReader, readerMutex, epochNumber, learnRatePerSample, workerCriteria[i], workerEvalErrors[i]);
+        }));
+    }
+
+    // (all the workers must be done before an exception leaves, as they use this frame)
+    size_t totalEpochSamples = 0;
+    std::exception_ptr workerException;
+    for (auto& result : results)
+    {
+        try
+        {
+            totalEpochSamples += result.get();
+        }
+        catch (...)
+        {
+            if (!workerException)
+                workerException = std::current_exception();
+        }
+    }
+    smoothedGradients.swap(self.smoothedGradients);
+    smoothedCounts.swap(self.smoothedCounts);
+    if (workerException)
+        std::rethrow_exception(workerException);
+
+    epochCriterion = EpochCriterion(0);
+    epochEvalErrors.assign(evaluationNodes.size(), EpochCriterion(0));
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        epochCriterion += workerCriteria[i];
+        for (size_t j = 0; j < evaluationNodes.size(); j++)
+            epochEvalErrors[j] += workerEvalErrors[i][j];
+    }
+    if (epochCriterion.IsNan())
+        RuntimeError("The training criterion is not a number (NAN).");
+
+    // the workers' parameter nodes have seen the updates of the others, but the network's must be told as well
+    for (const auto& node : learnableNodes)
+        node->BumpEvalTimeStamp();
+    return totalEpochSamples;
+}
+
+template <class ElemType>
+size_t SGD<ElemType>::TrainHogwildWorker(HogwildWorker& worker, IDataReader* trainSetDataReader, std::mutex& readerMutex,
+                                         const int epochNumber, const double learnRatePerSample,
+                                         /*out*/ EpochCriterion& epochCriterion,
+                                         /*out*/ std::vector<EpochCriterion>& epochEvalErrors)
+{
+    // the workers are the parallelism; the number of OpenMP threads is a setting of the calling thread
+    omp_set_num_threads(1);
+    auto& net = worker.net;
+    const auto& criterionNode = worker.criterionNodes[0];
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->StartEvaluateMinibatchLoop(worker.evaluationNodes);
+    net->StartEvaluateMinibatchLoop(criterionNode);
+    CriterionAccumulator<ElemType> localEpochCriterion(worker.criterionNodes, CPUDEVICE);
+    CriterionAccumulator<ElemType> localEpochEvalErrors(worker.evaluationNodes, CPUDEVICE);
+    size_t totalEpochSamples = 0;
+    for (;;)
+    {
+        size_t actualMBSize = 0;
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            if (!DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, criterionNode, false, false, worker.inputMatrices, actualMBSize, m_mpi))
+                break;
+            trainSetDataReader->DataEnd();
+        }
+
+        MarkDropoutNodesEvalTimeStampAsOutdated(net, criterionNode);
+        ComputationNetwork::BumpEvalTimeStamp(net->FeatureNodes());
+        ComputationNetwork::BumpEvalTimeStamp(net->LabelNodes());
+        if (actualMBSize == 0)
+            continue;
+
+        net->ForwardProp(worker.evaluationNodes);
+        net->ForwardProp(criterionNode);
+        bool updateParameters = learnRatePerSample > 0.01 * m_minLearnRate;
+        if (updateParameters)
+            net->Backprop(criterionNode);
+
+        size_t numSamplesWithLabelOfNetwork = net->GetNumSamplesWithLabelOfNetwork(actualMBSize);
+        localEpochCriterion.Add(0, numSamplesWithLabelOfNetwork);
+        for (size_t i = 0; i < worker.evaluationNodes.size(); i++)
+            localEpochEvalErrors.Add(i, numSamplesWithLabelOfNetwork);
+        size_t numSamplesWithLabel = CriterionAccumulator<ElemType>::GetNumSamples(criterionNode, numSamplesWithLabelOfNetwork);
+        size_t numSamplesInMinibatch = criterionNode->HasMBLayout() ? numSamplesWithLabel : actualMBSize; // (as in TrainOneEpoch())
+        totalEpochSamples += numSamplesWithLabel;
+        if (!updateParameters || numSamplesInMinibatch == 0)
+            continue;
+
+        // the updates of the shared values are not synchronized with the other workers
+        double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
+        double globalNormClippingFactor = GetGlobalNormClippingFactor(worker.learnableNodes, numSamplesInMinibatch);
+        auto smoothedGradientIter = worker.smoothedGradients.begin();
+        auto smoothedCountIter = worker.smoothedCounts.begin();
+        for (auto nodeIter = worker.learnableNodes.begin(); nodeIter != worker.learnableNodes.end(); nodeIter++, smoothedGradientIter++, smoothedCountIter++)
+        {
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+            if (!node->IsParameterUpdateRequired())
+                continue;
+            double nodeDependentLearningRatePerSample = learnRatePerSample * node->GetLearningRateMultiplier();
+            double nodeDependentRegMultiplier = dynamic_pointer_cast<LearnableParameter<ElemType>>(node)->GetRegMultiplier();
+            if (globalNormClippingFactor != 1)
+                node->Gradient() *= (ElemType) globalNormClippingFactor;
+            UpdateWeights(node->Value(), node->Gradient(), *smoothedGradientIter, *smoothedCountIter,
+                          nodeDependentLearningRatePerSample, momentumPerSample, numSamplesInMinibatch,
+                          m_L2RegWeight * nodeDependentRegMultiplier, m_L1RegWeight * nodeDependentRegMultiplier,
+                          m_needAveMultiplier, m_useNesterovMomentum, nullptr);
+            node->BumpEvalTimeStamp();
+        }
+    }
+
+    epochCriterion = localEpochCriterion.GetCriterion(0);
+    for (size_t i = 0; i < epochEvalErrors.size(); i++)
+        epochEvalErrors[i] = localEpochEvalErrors.GetCriterion(i);
+    return totalEpochSamples;
+}
+
+// pipeline parallelism (m_pipelineMicroBatches): all micro-batches forward, then backward in reverse order, such that the
+// last one goes backward while its values are still there (see ComputationNetwork::FormPipelineStages()).
+// The dispatcher adds up the gradients and criteria, as with sub-minibatches; the evaluation nodes are only computed forward.
+template <class ElemType>
+void SGD<ElemType>::ForwardBackwardPipelined(ComputationNetworkPtr net, const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                             const std::vector<ComputationNodeBasePtr>& featureNodes, const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                             DataReaderHelpers::SubminibatchDispatcher<ElemType>& smbDispatcher, size_t numMicroBatches)
+{
+    size_t forwardSpan = TimelineProfiler::Instance().BeginSpan("forward", TimelineProfiler::Track::Gpu);
+    for (size_t ismb = 0; ismb < numMicroBatches; ismb++)
+    {
+        smbDispatcher.GetSubMinibatchToNet(ismb, /*keepState=*/true); // (imported again for backprop)
+        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+        ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+        net->ForwardPropPipelined(ismb, evaluationNodes);
+        smbDispatcher.AccumulateEvaluation();
+    }
+    TimelineProfiler::Instance().EndSpan(forwardSpan);
+
+    TimelineSpan backwardSpan("backward", TimelineProfiler::Track::Gpu);
+    for (size_t ismb = numMicroBatches; ismb-- > 0;)
+    {
+        if (ismb + 1 < numMicroBatches) // (the last micro-batch is still in the network)
+        {
+            smbDispatcher.GetSubMinibatchToNet(ismb);
+            ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+            ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+        }
+        net->BackpropPipelined(ismb, m_lossScaling.GetScale());
+        smbDispatcher.DoneWithCurrentSubMinibatch(ismb, /*accumulateEvaluation=*/false);
+    }
+}
+
 // -----------------------------------------------------------------------
 // subroutines and helpers follow below
 // -----------------------------------------------------------------------
@@ -1590,30 +2253,73 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
     // To support large dataset, we usually partition whole dataset into several epoch's,
     // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions());
-    else // using only one epoch. Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions(), m_epochSize);
+    size_t requestedSamples = m_useAllDataForPreComputedNode ? requestDataSize // using all the data
+                                                             : m_epochSize;    // using only one epoch. Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
+    // With several workers, each one reads its own share of the data, and the statistics get merged at the end.
+    bool useDistributedMBReading = m_distributedPreCompute &&
+                                   m_mpi != nullptr && m_mpi->NumNodesInUse() > 1 &&
+                                   trainSetDataReader->SupportsDistributedMBRead();
+    size_t numWorkers = useDistributedMBReading ? m_mpi->NumNodesInUse() : 1;
+
+    // statistics cached by an earlier run on the same data (the key reads a minibatch, so it goes before the actual loop)
+    wstring cachePath;
+    if (!m_preComputeCacheDir.empty())
+    {
+        uint64_t key = PreComputeCacheKey(net, trainSetDataReader, nodes, featureNodes, labelNodes, inputMatrices, requestedSamples);
+        cachePath = m_preComputeCacheDir + L"/precompute_" + msra::strfun::utf16(msra::strfun::strprintf("%016llx", (unsigned long long) key)) + L".stats";
+    }
+
+    if (useDistributedMBReading)
+        trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, m_mpi->CurrentNodeRank(), numWorkers, inputMatrices->GetStreamDescriptions(), requestedSamples);
+    else
+        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions(), requestedSamples);
     net->StartEvaluateMinibatchLoop(nodes);
 
     // initialize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(false /*begin accumulating*/);
 
+    if (!cachePath.empty() && LoadPreComputeCache(nodes, cachePath))
+    {
+        for (auto & node : nodes)
+            dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true);
+        fprintf(stderr, "\n");
+        LOGPRINTF(stderr, "Precomputing --> Loaded from the cache '%ls'.\n\n", cachePath.c_str());
+        return true;
+    }
+
     const size_t numIterationsBeforePrintingProgress = 100;
     size_t numItersSinceLastPrintOfProgress = 0;
-    size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy, m_mpi))
+    size_t maxLocalSamples = m_preComputeMaxSamples == SIZE_MAX ? SIZE_MAX : (m_preComputeMaxSamples + numWorkers - 1) / numWorkers;
+    size_t numLocalSamples = 0;
+    size_t actualMBSize;
+    while (numLocalSamples < maxLocalSamples &&
+           DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, useDistributedMBReading, useDistributedMBReading, *inputMatrices, actualMBSize, m_mpi))
     {
         // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
         ComputationNetwork::BumpEvalTimeStamp(featureNodes);
         ComputationNetwork::BumpEvalTimeStamp(labelNodes);
 
         net->ForwardProp(nodes);
+        numLocalSamples += actualMBSize;
 
         numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
     }
 
+    // merge the statistics of all workers (all of them must get here, since this is a collective operation)
+    size_t numSamples = ComputationNetwork::AggregatePreComputedStatistics(nodes, useDistributedMBReading ? m_mpi : nullptr);
+    if (numSamples > 1)
+    {
+        // 95% confidence intervals, assuming independent samples (frames of an utterance are not, so take these as a lower bound)
+        double meanHalfWidth   = 1.96 / sqrt((double) numSamples);
+        double stdDevHalfWidth = 1.96 / sqrt(2.0 * (numSamples - 1));
+        LOGPRINTF(stderr, "Precomputing --> %lu samples from %d worker(s): means are within +/-%.2g standard deviations, standard deviations within +/-%.2g%% (95%% confidence).\n",
+                  (unsigned long) numSamples, (int) numWorkers, meanHalfWidth, 100 * stdDevHalfWidth);
+    }
+
+    if (!cachePath.empty() && (m_mpi == nullptr || m_mpi->IsMainNode()))
+        SavePreComputeCache(nodes, cachePath);
+
     // finalize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true /*done accumulating*/);
@@ -1624,26 +2330,149 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     return true;
 }
 
-// return a reasonable initial learning rate based on the initial mbsize
+// Key of the pre-computation cache. Readers do not expose a fingerprint of their corpus, so the data are represented
+// by the reader configuration and the feature values of the first minibatch; the network by the pre-compute nodes,
+// their inputs and sample layouts, and the amount of data they see.
 template <class ElemType>
-double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
-                                             ComputationNetworkPtr refNet,
-                                             const ComputationNodeBasePtr& refNode, const int epochNumber,
-                                             const double curLearnRate,
-                                             IDataReader* trainSetDataReader,
-                                             const std::vector<ComputationNodeBasePtr>& featureNodes,
-                                             const std::vector<ComputationNodeBasePtr>& labelNodes,
-                                             const std::vector<ComputationNodeBasePtr>& criterionNodes,
-                                             const std::vector<ComputationNodeBasePtr>& evaluationNodes,
-                                             StreamMinibatchInputs* inputMatrices,
-                                             const std::list<ComputationNodeBasePtr>& learnableNodes,
-                                             std::list<Matrix<ElemType>>& smoothedGradients, vector<double> smoothedCounts,
-                                             const bool learnRateInitialized,
-                                             const double largestPrevLearnRatePerSample)
+uint64_t SGD<ElemType>::PreComputeCacheKey(ComputationNetworkPtr net, IDataReader* trainSetDataReader, const std::list<ComputationNodeBasePtr>& nodes,
+                                           const std::vector<ComputationNodeBasePtr>& featureNodes, const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                           StreamMinibatchInputs* inputMatrices, size_t requestedSamples)
 {
-    double bestLearnRatePerSample = curLearnRate;
-
-    size_t numFramesToUseInSearch = m_numSamples4Search[epochNumber];
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+    auto hashBytes = [&hash](const void* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ ((const unsigned char*) data)[i]) * 1099511628211ULL;
+    };
+    auto hashString = [&hashBytes](const wstring& s)
+    {
+        hashBytes(s.c_str(), (s.size() + 1) * sizeof(wchar_t));
+    };
+
+    hashString(m_readerConfigDescription);
+    for (const auto& node : nodes)
+    {
+        hashString(node->NodeName());
+        hashString(node->OperationName());
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            hashString(node->GetInputs()[i]->NodeName());
+            hashString(msra::strfun::utf16(string(node->GetInputs()[i]->GetSampleLayout())));
+        }
+    }
+    hashBytes(&requestedSamples, sizeof(requestedSamples));
+    hashBytes(&m_preComputeMaxSamples, sizeof(m_preComputeMaxSamples));
+
+    // the first minibatch, as every worker sees it without distributed reading
+    trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions(), requestedSamples);
+    size_t actualMBSize;
+    if (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSize, nullptr))
+    {
+        for (const auto& node : featureNodes)
+        {
+            auto featureNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+            if (!featureNode || featureNode->Value().GetMatrixType() != MatrixType::DENSE)
+                continue;
+            unique_ptr<ElemType[]> values(featureNode->Value().CopyToArray());
+            hashBytes(values.get(), featureNode->Value().GetNumElements() * sizeof(ElemType));
+        }
+    }
+    ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+    ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+    return hash;
+}
+
+// The cache holds the partial statistics of all Mean/InvStdDev nodes after merging, by node name.
+// Any worker that cannot use it makes all of them compute the statistics again.
+template <class ElemType>
+bool SGD<ElemType>::LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const std::wstring& cachePath)
+{
+    int found = 0;
+    if (fexists(cachePath))
+    {
+        try
+        {
+            File fstream(cachePath, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+            map<wstring, vector<double>> stats;
+            size_t numNodes;
+            fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+            fstream >> numNodes;
+            for (size_t i = 0; i < numNodes; i++)
+            {
+                wstring name;
+                size_t size;
+                fstream >> name >> size;
+                auto& nodeStats = stats[name];
+                nodeStats.resize(size);
+                for (auto& value : nodeStats)
+                    fstream >> value;
+            }
+            fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+            found = ComputationNetwork::SetPreComputedStatistics(nodes, stats);
+        }
+        catch (const exception& e)
+        {
+            LOGPRINTF(stderr, "Precomputing --> Ignoring the unreadable cache '%ls': %s\n", cachePath.c_str(), e.what());
+        }
+    }
+    int foundHere = found;
+    if (m_mpi != nullptr && m_mpi->NumNodesInUse() > 1)
+        m_mpi->AllReduce(&found, 1, MPI_MIN);
+    if (foundHere && !found) // we loaded it but another worker did not: start over from empty statistics
+    {
+        auto stats = ComputationNetwork::GetPreComputedStatistics(nodes);
+        for (auto& entry : stats)
+            fill(entry.second.begin(), entry.second.end(), 0.0);
+        ComputationNetwork::SetPreComputedStatistics(nodes, stats);
+    }
+    return found != 0;
+}
+
+template <class ElemType>
+void SGD<ElemType>::SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const std::wstring& cachePath)
+{
+    auto stats = ComputationNetwork::GetPreComputedStatistics(nodes);
+    if (stats.size() != nodes.size()) // (only the statistics of Mean/InvStdDev nodes can be cached)
+        return;
+    msra::files::make_intermediate_dirs(cachePath);
+    wstring tmpPath = cachePath + L".tmp";
+    {
+        File fstream(tmpPath, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+        fstream << stats.size();
+        for (const auto& entry : stats)
+        {
+            fstream << entry.first << entry.second.size();
+            for (double value : entry.second)
+                fstream << value;
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+        fstream.Flush();
+    }
+    renameOrDie(tmpPath, cachePath);
+    LOGPRINTF(stderr, "Precomputing --> Saved to the cache '%ls'.\n", cachePath.c_str());
+}
+
+// return a reasonable initial learning rate based on the initial mbsize
+template <class ElemType>
+double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
+                                             ComputationNetworkPtr refNet,
+                                             const ComputationNodeBasePtr& refNode, const int epochNumber,
+                                             const double curLearnRate,
+                                             IDataReader* trainSetDataReader,
+                                             const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                             const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                             const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                             const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                             StreamMinibatchInputs* inputMatrices,
+                                             const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                             std::list<Matrix<ElemType>>& smoothedGradients, vector<double> smoothedCounts,
+                                             const bool learnRateInitialized,
+                                             const double largestPrevLearnRatePerSample)
+{
+    double bestLearnRatePerSample = curLearnRate;
+
+    size_t numFramesToUseInSearch = m_numSamples4Search[epochNumber];
     if (m_epochSize != requestDataSize)
     {
         // ensure the numFramesToUseInSearch does not exceed the total number of frames in the epoch
@@ -1660,6 +2489,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     }
 
     int baseModelEpoch = epochNumber - 1;
+    WaitForCheckPointWrites();
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double learnRate = learnRatePerSample;
@@ -1674,6 +2504,76 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                        /*out*/ prevCriterion,
                        /*out*/ dummyMinibatchSize);
 
+    if (UsingParallelSearch(epochNumber))
+    {
+        // The sequence of candidates is that of the sequential search below, in rounds of one candidate per worker:
+        // in the first round, worker 0 computes the base criterion and worker r tries learnRatePerSample * 0.618^r.
+        size_t numWorkers = m_mpi->NumNodesInUse();
+        size_t rank = m_mpi->CurrentNodeRank();
+        auto candidate = [&](size_t j) { return learnRatePerSample * pow(0.618, (double) j); };
+        EpochCriterion baseCriterion;
+        EpochCriterion bestCriterion(EpochCriterion::Infinity());
+        bool found = false;
+        for (size_t first = 0; !found; first += numWorkers)
+        {
+            size_t j = first + rank;
+            auto criteria = TrainOneMiniEpochPerWorker(net, refNet, refNode, epochNumber, trainSetDataReader,
+                                                       j == 0 ? 0 : candidate(j), m_mbSize[epochNumber],
+                                                       featureNodes, labelNodes, criterionNodes, evaluationNodes,
+                                                       inputMatrices, learnableNodes, smoothedGradients, smoothedCounts,
+                                                       j == 0 ? "BaseAdaptiveLearnRateSearch:" : "AdaptiveLearnRateSearch:",
+                                                       numFramesToUseInSearch);
+            size_t r = 0;
+            if (first == 0)
+            {
+                baseCriterion = criteria[0];
+                if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch)
+                {
+                    if (prevCriterion == numeric_limits<double>::infinity())
+                        prevCriterion = baseCriterion.Average();
+                    double ratio = m_epochSize != requestDataSize ? pow(((double) numFramesToUseInSearch) / m_epochSize, 1.0f / 2) : 0.3;
+                    baseCriterion.first = baseCriterion.second * max(ratio * prevCriterion + (1 - ratio) * baseCriterion.Average(), baseCriterion.Average());
+                }
+                r = 1;
+            }
+            // the first candidate that beats the base criterion, as the sequential search would stop there
+            for (; r < numWorkers && !found; r++)
+            {
+                if (!criteria[r].IsNan() && (criteria[r].Average() <= baseCriterion.Average() || candidate(first + r) <= minLearnRate))
+                {
+                    bestLearnRatePerSample = candidate(first + r);
+                    bestCriterion = criteria[r];
+                    found = true;
+                }
+            }
+        }
+
+        // grid search for the first m_numBestSearchEpoch epochs: one round over log-spaced learning rates from the left
+        // end of the sequential search up to the one found
+        double leftLearnRatePerSample = 0.01 / m_mbSize[epochNumber];
+        if (epochNumber < m_numBestSearchEpoch && bestLearnRatePerSample > leftLearnRatePerSample * 1.2)
+        {
+            auto gridPoint = [&](size_t r) { return leftLearnRatePerSample * pow(bestLearnRatePerSample / leftLearnRatePerSample, (double) r / numWorkers); };
+            auto criteria = TrainOneMiniEpochPerWorker(net, refNet, refNode, epochNumber, trainSetDataReader,
+                                                       gridPoint(rank), m_mbSize[epochNumber],
+                                                       featureNodes, labelNodes, criterionNodes, evaluationNodes,
+                                                       inputMatrices, learnableNodes, smoothedGradients, smoothedCounts,
+                                                       "DetailAdaptiveLearnRateSearch:", numFramesToUseInSearch);
+            for (size_t r = 0; r < numWorkers; r++)
+            {
+                if (!criteria[r].IsNan() && criteria[r].Average() < bestCriterion.Average())
+                {
+                    bestLearnRatePerSample = gridPoint(r);
+                    bestCriterion = criteria[r];
+                }
+            }
+        }
+
+        LOGPRINTF(stderr, " SearchForBestLearnRate Epoch[%d]: Best learningRatePerSample = %.10g, baseCriterion=%.10g (parallel search on %d workers)\n",
+                  (int) epochNumber + 1, bestLearnRatePerSample, baseCriterion.Average(), (int) numWorkers);
+        return bestLearnRatePerSample;
+    }
+
     // if model is not changed this is what we will get
     EpochCriterion baseCriterion;
     vector<EpochCriterion> epochEvalErrors(evaluationNodes.size(), EpochCriterion::Infinity()); // these are ignored in this entire method
@@ -1931,8 +2831,52 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
     LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Evaluating minibatchSizes %d..%d\n",
         (int)epochNumber + 1, (int)RoundToMultipleOf64(minMinibatchSize), (int)RoundToMultipleOf64(maxMinibatchSize));
 
+    // Parallel search, in rounds of one trial minibatch size per worker; the selection is that of the sequential search below.
+    // (Not with minibatchSearchByThroughput, which stops growing the size before the next trial would exceed the memory.)
+    if (UsingParallelSearch(epochNumber) && !m_minibatchSearchByThroughput)
+    {
+        vector<size_t> trialMinibatchSizes;
+        for (float trialMinibatchSizeFloat = (float) minMinibatchSize; trialMinibatchSizeFloat <= maxMinibatchSize; trialMinibatchSizeFloat *= minibatchSizeTuningFactor)
+            trialMinibatchSizes.push_back(RoundToMultipleOf64(trialMinibatchSizeFloat));
+
+        size_t numWorkers = m_mpi->NumNodesInUse();
+        size_t rank = m_mpi->CurrentNodeRank();
+        size_t bestMinibatchSize = 0;
+        bool stopped = false;
+        for (size_t first = 0; first < trialMinibatchSizes.size() && !stopped; first += numWorkers)
+        {
+            size_t j = first + rank;
+            auto criteria = TrainOneMiniEpochPerWorker(net, refNet, refNode, epochNumber, trainSetDataReader,
+                                                       learnRatePerSample, j < trialMinibatchSizes.size() ? trialMinibatchSizes[j] : 0,
+                                                       featureNodes, labelNodes, criterionNodes, evaluationNodes,
+                                                       inputMatrices, learnableNodes, smoothedGradients, smoothedCounts,
+                                                       j == 0 ? "BaseAdaptiveMinibatchSearch:" : "AdaptiveMinibatchSearch:",
+                                                       numFramesToUseInSearch);
+            for (size_t r = 0; r < numWorkers && first + r < trialMinibatchSizes.size() && !stopped; r++)
+            {
+                if (first + r == 0)
+                    baseCriterion = criteria[r];
+                else if (!criteria[r].IsNan() && criteria[r].Average() > (baseCriterion.Average() * (1.0 + (m_minibatchSearchCriterionErrorMargin / 100.0))))
+                {
+                    stopped = true;
+                    break;
+                }
+                bestMinibatchSize = trialMinibatchSizes[first + r];
+            }
+        }
+        if (m_traceLevel > 0)
+        {
+            LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Search successful on %d workers. New minibatchSize is %d. baseCriterion = %.8f\n",
+                      (int)epochNumber + 1, (int)numWorkers, (int)bestMinibatchSize, baseCriterion.Average());
+        }
+        return bestMinibatchSize;
+    }
+
     size_t lastGoodMinibatchSize = 0;
     EpochCriterion lastGoodEpochCriterion(0);
+    // with minibatchSearchByThroughput, the fastest minibatch size so far whose criterion is good
+    size_t fastestMinibatchSize = 0;
+    double fastestThroughput = 0;
     for (float trialMinibatchSizeFloat = (float) minMinibatchSize;
          trialMinibatchSizeFloat <= maxMinibatchSize;
          trialMinibatchSizeFloat *= minibatchSizeTuningFactor)
@@ -1949,6 +2893,7 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
 
         // Train on a few minibatches and so we can observe the epochCriterion as we try increasing
         // minibatches with iteration of this loop.
+        double trainingSeconds = 0;
         TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
                                         m_epochSize, trainSetDataReader,
                                         learnRatePerSample, trialMinibatchSize, featureNodes,
@@ -1957,7 +2902,37 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
                                         learnableNodes, smoothedGradients, smoothedCounts,
                                         /*out*/ epochCriterion, /*out*/ epochEvalErrors,
                                         isFirstIteration ? "BaseAdaptiveMinibatchSearch:" : "AdaptiveMinibatchSearch:",
-                                        numFramesToUseInSearch);
+                                        numFramesToUseInSearch, /*out*/ &trainingSeconds);
+        double throughput = trainingSeconds > 0 ? epochCriterion.second / trainingSeconds : 0;
+        bool isGood = isFirstIteration || epochCriterion.IsNan() ||
+                      epochCriterion.Average() <= (baseCriterion.Average() * (1.0 + (m_minibatchSearchCriterionErrorMargin / 100.0)));
+        if (m_minibatchSearchByThroughput && isGood)
+        {
+            if (m_traceLevel > 0)
+                LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: minibatchSize=%d trains %.1f samples/s\n", (int)epochNumber + 1, (int)trialMinibatchSize, throughput);
+            if (throughput > fastestThroughput)
+            {
+                fastestMinibatchSize = trialMinibatchSize;
+                fastestThroughput = throughput;
+            }
+            // The shared matrix pool grows about linearly with the minibatch size, so the next trial needs about
+            // (factor - 1) times its current size on top. Stop if that would not fit into the free device memory.
+            if (net->GetDeviceId() >= 0)
+            {
+                double poolBytes = (double) net->GetMatrixPoolAllocatedBytes();
+                double freeBytes = (double) GPUWatcher::GetFreeMemoryOnCUDADevice(net->GetDeviceId());
+                if (poolBytes * (minibatchSizeTuningFactor - 1) > freeBytes * (1 - m_minibatchSearchMemoryReserve))
+                {
+                    LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Larger minibatches would not fit into device memory (pool %.1f MB, free %.1f MB).\n",
+                              (int)epochNumber + 1, poolBytes / (1024.0 * 1024.0), freeBytes / (1024.0 * 1024.0));
+                    lastGoodMinibatchSize = trialMinibatchSize;
+                    lastGoodEpochCriterion = epochCriterion;
+                    if (isFirstIteration)
+                        baseCriterion = epochCriterion;
+                    break;
+                }
+            }
+        }
 
         if (isFirstIteration)
         {
@@ -1994,6 +2969,12 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
             }
         }
     }
+    if (m_minibatchSearchByThroughput && fastestMinibatchSize != 0 && fastestMinibatchSize != lastGoodMinibatchSize)
+    {
+        LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: minibatchSize=%d is the fastest (%.1f samples/s), preferred over %d.\n",
+                  (int)epochNumber + 1, (int)fastestMinibatchSize, fastestThroughput, (int)lastGoodMinibatchSize);
+        lastGoodMinibatchSize = fastestMinibatchSize;
+    }
     if (m_traceLevel > 0)
     {
         LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Search successful. New minibatchSize is %d. epochCriterion = %.8f vs baseCriterion = %.8f\n",
@@ -2020,14 +3001,20 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
                                                     /*out*/ EpochCriterion& epochCriterion,
                                                     /*out*/ std::vector<EpochCriterion>& epochEvalErrors,
                                                     std::string prefixMsg,
-                                                    const size_t maxNumOfSamples)
+                                                    const size_t maxNumOfSamples,
+                                                    /*out*/ double* trainingSeconds)
 {
+    Timer timer;
+    timer.Start();
     TrainOneEpoch(net, refNet, refNode, epochNumber, epochSize,
                   trainSetDataReader, learnRatePerSample, minibatchSize, featureNodes,
                   labelNodes, criterionNodes, evaluationNodes,
                   inputMatrices, learnableNodes, smoothedGradients, smoothedCounts,
                   /*out*/ epochCriterion, /*out*/ epochEvalErrors,
                   "  " + prefixMsg, maxNumOfSamples); // indent log msg by 2 (that is 1 more than the Finished message below)
+    timer.Stop(); // (the criterion has been fetched from the device, so its work is done)
+    if (trainingSeconds)
+        *trainingSeconds = timer.ElapsedSeconds();
 
     LOGPRINTF(stderr, " Finished Mini-Epoch[%d]: ", (int)epochNumber+1);
     epochCriterion.LogCriterion(criterionNodes[0]->NodeName());
@@ -2037,6 +3024,7 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
 
     // go back to where we came from
     int baseModelEpoch = epochNumber - 1;
+    WaitForCheckPointWrites();
     let path = GetModelNameForEpoch(baseModelEpoch);
     //fprintf(stderr, "Reverting parameters back to %ls\n", path.c_str());
     net->RereadPersistableParameters<ElemType>(path);
@@ -2054,6 +3042,60 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
                        /*out*/ dummyMinibatchSize);
 }
 
+template <class ElemType>
+std::vector<EpochCriterion> SGD<ElemType>::TrainOneMiniEpochPerWorker(ComputationNetworkPtr net,
+                                                                      ComputationNetworkPtr refNet,
+                                                                      const ComputationNodeBasePtr& refNode, const int epochNumber,
+                                                                      IDataReader* trainSetDataReader,
+                                                                      const double learnRatePerSample,
+                                                                      const size_t minibatchSize,
+                                                                      const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                                                      const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                                                      const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                                                      const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                                                      StreamMinibatchInputs* inputMatrices,
+                                                                      const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                                                      std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double> smoothedCounts,
+                                                                      std::string prefixMsg,
+                                                                      const size_t maxNumOfSamples)
+{
+    // (criterion, #samples) of each worker, summed over the workers to gather them
+    size_t numWorkers = m_mpi->NumNodesInUse();
+    size_t rank = m_mpi->CurrentNodeRank();
+    vector<double> results(2 * numWorkers, 0);
+    if (minibatchSize > 0)
+    {
+        EpochCriterion epochCriterion(EpochCriterion::Infinity());
+        vector<EpochCriterion> epochEvalErrors(evaluationNodes.size(), EpochCriterion::Infinity());
+        m_trainLocally = true;
+        try
+        {
+            TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
+                                            m_epochSize, trainSetDataReader,
+                                            learnRatePerSample, minibatchSize, featureNodes,
+                                            labelNodes, criterionNodes,
+                                            evaluationNodes, inputMatrices,
+                                            learnableNodes, smoothedGradients, smoothedCounts,
+                                            /*out*/ epochCriterion, /*out*/ epochEvalErrors,
+                                            prefixMsg, maxNumOfSamples);
+        }
+        catch (...)
+        {
+            m_trainLocally = false;
+            throw;
+        }
+        m_trainLocally = false;
+        results[2 * rank]     = epochCriterion.first;
+        results[2 * rank + 1] = (double) epochCriterion.second;
+    }
+    m_mpi->AllReduce(results);
+
+    vector<EpochCriterion> criteria;
+    for (size_t r = 0; r < numWorkers; r++)
+        criteria.push_back(EpochCriterion(results[2 * r], (size_t) results[2 * r + 1]));
+    return criteria;
+}
+
 // Attemps to compute the error signal for the whole utterance, which will
 // be fed to the neural network as features. Currently it is a workaround
 // for the two-forward-pass sequence and ctc training, which allows
@@ -2107,6 +3149,12 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
 #endif // !CNTK_PARALLEL_TRAINING_SUPPORT
     }
+    else if (m_gradientDensity < 1)
+    {
+        if (traceLevel > 0)
+            fprintf(stderr, "Initializing dataParallelSGD with top-k sparsification, sending %.3g%% of the gradient entries.\n", 100 * m_gradientDensity);
+        m_distGradAgg = std::make_shared<SparseDistGradAggregator<ElemType>>(m_mpi, m_gradientDensity, m_syncStatsTrace);
+    }
     else
     {
         if (traceLevel > 0)
@@ -2114,7 +3162,7 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         if (Globals::UseV2Aggregator()) // Currently used to check V2 against baselines.
             m_distGradAgg = std::make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, ::CNTK::MPICommunicator());
         else
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace);
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_gradientBucketSizeInMB * 1024 * 1024);
     }
 
     m_gradHeader.reset(DistGradHeader::Create(numEvalNodes), [](DistGradHeader* ptr) { DistGradHeader::Destroy(ptr); });
@@ -2129,7 +3177,10 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
     }
     if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD)
     {
-        m_pMASGDHelper = make_shared<BasicModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID);
+        if (m_overlapModelAggregation)
+            m_pMASGDHelper = make_shared<OverlappedModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID);
+        else
+            m_pMASGDHelper = make_shared<BasicModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID, m_numModelBits, m_zeroThresholdFor1Bit);
     }
     else if (GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD)
     {
@@ -2159,6 +3210,149 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
     }
 }
 
+// Elastic training: after a worker failed, the survivors shrink the communicator to themselves and continue from the model
+// in memory rather than from the last checkpoint. A failure within an aggregation may leave the survivors with different
+// models, so the new main node broadcasts its parameters and optimizer state. The aggregation (and its NCCL communicator)
+// is set up again for the new number of workers; the reader is re-decimated when the epoch is started again.
+template <class ElemType>
+void SGD<ElemType>::RecoverFromWorkerFailure(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, int epochNumber, size_t numEvalNodes,
+                                             const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients,
+                                             vector<double>& smoothedCounts, const char* reason)
+{
+    LOGPRINTF(stderr, "A worker failed (%s), restarting epoch %d with the surviving workers.\n", reason, epochNumber + 1);
+
+    // the aggregators hold requests on, and communicators derived from, the failed communicator
+    m_distGradAgg.reset();
+    m_gradHeader.reset();
+    m_pMASGDHelper.reset();
+    m_mpi->ShrinkToSurvivors("elastic training");
+
+    vector<ElemType> buffer;
+    auto broadcast = [&](Matrix<ElemType>& m)
+    {
+        buffer.resize(m.GetNumElements());
+        ElemType* data = buffer.data();
+        size_t size = buffer.size();
+        m.CopyToArray(data, size);
+        m_mpi->Bcast(data, size, m_mpi->MainNodeRank());
+        m.SetValue(m.GetNumRows(), m.GetNumCols(), m.GetDeviceId(), data);
+    };
+    for (auto& node : learnableNodes)
+        broadcast(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value());
+    for (auto& smoothedGradient : smoothedGradients)
+        broadcast(smoothedGradient);
+    m_mpi->Bcast(smoothedCounts.data(), smoothedCounts.size(), m_mpi->MainNodeRank());
+
+    if (GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD)
+        InitDistGradAgg((int) numEvalNodes, m_numGradientBits[epochNumber], net->GetDeviceId(), m_traceLevel);
+    else
+        InitModelAggregationHandler(m_syncStatsTrace, net->GetDeviceId());
+
+    if (m_syncBatchNormalization)
+    {
+        shared_ptr<NcclComm> comm;
+        if (m_mpi->NumNodesInUse() > 1)
+            comm = std::make_shared<NcclComm>(net->GetDeviceId(), m_mpi);
+        ComputationNetwork::SetBatchNormalizationCommunicator<ElemType>(net, criterionNode, comm);
+    }
+}
+
+// Matrix::FlagNonFiniteValues() into a single flag, read once
+template <class ElemType>
+Matrix<ElemType>& SGD<ElemType>::ResetNonFiniteFlag(DEVICEID_TYPE deviceId)
+{
+    if (!m_nonFiniteFlag || m_nonFiniteFlag->GetDeviceId() != deviceId)
+        m_nonFiniteFlag = make_shared<Matrix<ElemType>>(1, 1, deviceId);
+    m_nonFiniteFlag->SetValue(0);
+    return *m_nonFiniteFlag;
+}
+
+template <class ElemType>
+bool SGD<ElemType>::UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    bool gradientsAreFinite = true;
+    if (m_lossScaling.IsDynamic() && !learnableNodes.empty())
+    {
+        Matrix<ElemType>& flag = ResetNonFiniteFlag(dynamic_pointer_cast<ComputationNode<ElemType>>(learnableNodes.front())->Value().GetDeviceId());
+        for (const auto& node : learnableNodes)
+        {
+            if (node->IsParameterUpdateRequired())
+                dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient().FlagNonFiniteValues(flag);
+        }
+        gradientsAreFinite = flag.Get00Element() == 0;
+    }
+
+    double scale = m_lossScaling.GetScale();
+    if (!m_lossScaling.Update(gradientsAreFinite))
+    {
+        if (m_traceLevel > 0)
+            LOGPRINTF(stderr, "Skipping the update of a minibatch with non-finite gradients, loss scale reduced to %g.\n", m_lossScaling.GetScale());
+        return false;
+    }
+
+    if (scale != 1)
+    {
+        for (const auto& node : learnableNodes)
+        {
+            if (node->IsParameterUpdateRequired())
+                Matrix<ElemType>::Scale((ElemType) (1 / scale), dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+        }
+    }
+    return true;
+}
+
+// Flags NaN/Inf in the criterion and, unless dynamic loss scaling takes care of them, in the gradients of the parameters,
+// on the device, and reads the flag every m_nonFiniteCheckFrequency minibatches only. If it is set, the minibatch (if it
+// can be) is rerun with the check of every node (Globals::EnableNonFiniteValueChecks()), so that the error names the
+// first node whose value or gradient is not finite.
+template <class ElemType>
+void SGD<ElemType>::CheckNonFiniteValues(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                         const std::vector<ComputationNodeBasePtr>& featureNodes, const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                         const std::list<ComputationNodeBasePtr>& learnableNodes, bool hasGradients, size_t numMBsRun, bool canRerun)
+{
+    // The flag stays 0 until it is set, which fails the training.
+    auto criterion = dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNode);
+    if (!m_nonFiniteFlag || m_nonFiniteFlag->GetDeviceId() != criterion->Value().GetDeviceId())
+        ResetNonFiniteFlag(criterion->Value().GetDeviceId());
+
+    criterion->Value().FlagNonFiniteValues(*m_nonFiniteFlag);
+    if (hasGradients && !m_lossScaling.IsDynamic())
+    {
+        for (const auto& node : learnableNodes)
+        {
+            if (node->IsParameterUpdateRequired())
+                dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient().FlagNonFiniteValues(*m_nonFiniteFlag);
+        }
+    }
+
+    if (numMBsRun % m_nonFiniteCheckFrequency != 0 || m_nonFiniteFlag->Get00Element() == 0)
+        return;
+
+    if (canRerun)
+    {
+        LOGPRINTF(stderr, "NaN or Inf values within the last %d minibatches, rerunning minibatch %d with checks of every node.\n", (int) m_nonFiniteCheckFrequency, (int) numMBsRun);
+        Globals::EnableNonFiniteValueChecks();
+        try
+        {
+            ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+            ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+            net->ForwardProp(evaluationNodes);
+            net->ForwardProp(criterionNode);
+            if (hasGradients)
+                net->Backprop(criterionNode, m_lossScaling.GetScale());
+        }
+        catch (...)
+        {
+            Globals::DisableNonFiniteValueChecks();
+            throw;
+        }
+        Globals::DisableNonFiniteValueChecks();
+    }
+    RuntimeError("NaN or Inf values in the training criterion%s within the last %d minibatches (up to minibatch %d)%s.",
+                 hasGradients && !m_lossScaling.IsDynamic() ? " or the gradients" : "", (int) m_nonFiniteCheckFrequency, (int) numMBsRun,
+                 canRerun ? "; they are not in the last one" : "");
+}
+
 // public:
 // UpdateWeights() - actual weight update, implementing various update rules
 template <class ElemType>
@@ -2168,7 +3362,8 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
                                               size_t actualMBSize,
                                   const double L2RegWeight, const double L1RegWeight,
                                               const bool needAveMultiplier,
-                                  const bool useNesterovMomentum) const
+                                  const bool useNesterovMomentum,
+                                  LazyUpdateState* lazyUpdateState) const
 {
     // we use simple linear (instead of log linear) exponentiation here
     const double momentum = MomentumPerMB(momentumPerSample, actualMBSize);
@@ -2188,6 +3383,12 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
     ClipGradient(gradientValues, actualMBSize);
 
     GradientsUpdateType adpType = GradUpdateType();
+
+    // the trust ratio of Lars is taken from the (aggregated) gradient without the L2 term, as in UpdateWeightsFused()
+    double larsTrustRatio = 1;
+    if (adpType == GradientsUpdateType::Lars)
+        larsTrustRatio = GetLarsTrustRatio(functionValues.FrobeniusNorm(), gradientValues.FrobeniusNorm(), L2RegWeight * actualMBSize, m_gradType.larsCoefficient);
+
     double noiseStd = GradientUpdateNoiseStd();
     Matrix<ElemType> sgdUpdateNoise((DEVICEID_TYPE) functionValues.GetDeviceId());
     if (noiseStd > 0)
@@ -2206,14 +3407,31 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
         Matrix<ElemType>::ScaleAndAdd((ElemType)(L2RegWeight * actualMBSize), functionValues, gradientValues);
     }
 
-    if (adpType == GradientsUpdateType::None)
+    // (AdaGrad needs no lazy variant: its sparse update leaves the columns without gradient unchanged, as the dense one does)
+    if (lazyUpdateState)
+    {
+        lazyUpdateState->learnRatePerSample = learnRatePerSample;
+        lazyUpdateState->momentum = momentum;
+    }
+
+    if (adpType == GradientsUpdateType::None && lazyUpdateState)
+    {
+        smoothedGradient.LazyNormalGrad(gradientValues, functionValues, lazyUpdateState->lastUpdates, m_lazyUpdateCount,
+                                        (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum);
+    }
+    else if (adpType == GradientsUpdateType::None)
     {
         smoothedGradient.NormalGrad(gradientValues, functionValues,
                                     (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum);
     }
+    else if ((adpType == GradientsUpdateType::Adam || adpType == GradientsUpdateType::Lamb) && gradientValues.GetMatrixType() == MatrixType::SPARSE)
+    {
+        RuntimeError("UpdateWeights: gradUpdateType=%ls does not support sparse gradients (e.g. of a parameter that multiplies a sparse input); use adagrad, fsadagrad or sgd.",
+                     adpType == GradientsUpdateType::Adam ? L"adam" : L"lamb");
+    }
     else if (adpType == GradientsUpdateType::AdaGrad ||
              (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE) ||
-             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE))
+             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE && !lazyUpdateState))
     {
         // rmsprop for sparse is not implemented yet, delegate it with adagrad
 
@@ -2227,10 +3445,39 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
         static double smoothedCount = 0;
 #endif
 
-        smoothedGradient.FSAdagradUpdate(actualMBSize,
-                                         gradientValues, functionValues, smoothedCount,
-                                         learnRatePerSample, m_gradType.targetAdagradAvDenom,
-                                         momentum, varMomentum);
+        if (lazyUpdateState)
+        {
+            lazyUpdateState->varMomentum = varMomentum;
+            smoothedGradient.LazyFSAdagradUpdate(actualMBSize,
+                                                 gradientValues, functionValues, smoothedCount,
+                                                 lazyUpdateState->lastUpdates, m_lazyUpdateCount,
+                                                 learnRatePerSample, m_gradType.targetAdagradAvDenom,
+                                                 momentum, varMomentum);
+        }
+        else
+            smoothedGradient.FSAdagradUpdate(actualMBSize,
+                                             gradientValues, functionValues, smoothedCount,
+                                             learnRatePerSample, m_gradType.targetAdagradAvDenom,
+                                             momentum, varMomentum);
+    }
+    else if (adpType == GradientsUpdateType::Adam)
+    {
+        const double varMomentum = exp(-1.0 * actualMBSize / m_gradType.varianceTimeConstant);
+        smoothedGradient.AdamUpdate(gradientValues, functionValues, smoothedCount,
+                                    learnRatePerSample, momentum, varMomentum,
+                                    m_gradType.adamEpsilon, m_gradType.weightDecay);
+    }
+    else if (adpType == GradientsUpdateType::Lars)
+    {
+        smoothedGradient.NormalGrad(gradientValues, functionValues,
+                                    (ElemType) (learnRatePerSample * larsTrustRatio), (ElemType) momentum, useNesterovMomentum);
+    }
+    else if (adpType == GradientsUpdateType::Lamb)
+    {
+        const double varMomentum = exp(-1.0 * actualMBSize / m_gradType.varianceTimeConstant);
+        smoothedGradient.LambUpdate(gradientValues, functionValues, smoothedCount,
+                                    learnRatePerSample, momentum, varMomentum,
+                                    m_gradType.adamEpsilon, m_gradType.weightDecay);
     }
     else if (adpType == GradientsUpdateType::RmsProp)
     {
@@ -2257,6 +3504,72 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
 #endif
 }
 
+// protected:
+// Lazily updated parameters lag behind the dense update by the updates their columns skipped since their last gradient.
+// This catches them up (a dense pass), at the end of each epoch, so that the saved and evaluated models are as with dense updates.
+template <class ElemType>
+void SGD<ElemType>::CatchUpLazyUpdates(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+    {
+        auto stateIter = m_lazyUpdateStates.find(*nodeIter);
+        if (stateIter == m_lazyUpdateStates.end())
+            continue;
+        auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value();
+        auto& state = stateIter->second;
+        if (GradUpdateType() == GradientsUpdateType::None)
+            smoothedGradientIter->CatchUpLazyNormalGrad(value, state.lastUpdates, m_lazyUpdateCount, (ElemType) state.momentum, m_useNesterovMomentum);
+        else if (GradUpdateType() == GradientsUpdateType::FSAdaGrad)
+            smoothedGradientIter->CatchUpLazyFSAdagrad(value, state.lastUpdates, m_lazyUpdateCount, state.learnRatePerSample, state.momentum, state.varMomentum);
+        (*nodeIter)->BumpEvalTimeStamp();
+    }
+}
+
+// The moving averages start from the current values of the parameters that are updated.
+template <class ElemType>
+void SGD<ElemType>::InitEmaValues(const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    m_emaValues.clear();
+    m_flatEmaValues.reset();
+    // with a flat parameter buffer, the averages of the parameters in it are views into one copy of it
+    if (m_flatParameters && m_flatParameters->AreValuesBound())
+        m_flatEmaValues = make_shared<Matrix<ElemType>>(m_flatParameters->Values().DeepClone());
+    for (const auto& node : learnableNodes)
+    {
+        if (!node->IsParameterUpdateRequired())
+            continue;
+        const auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        if (m_flatEmaValues && m_flatParameters->Contains(node))
+            m_emaValues[node] = make_shared<Matrix<ElemType>>(FlatParameterBuffer<ElemType>::CorrespondingView(m_flatParameters->Values(), *m_flatEmaValues, value));
+        else
+            m_emaValues[node] = make_shared<Matrix<ElemType>>(value.DeepClone());
+    }
+}
+
+// ema += (1 - emaDecay) * (value - ema), after the update of one parameter by UpdateWeights()
+template <class ElemType>
+void SGD<ElemType>::UpdateEmaValue(const ComputationNodeBasePtr& node) const
+{
+    auto emaIter = m_emaValues.find(node);
+    if (emaIter == m_emaValues.end())
+        return;
+    auto& ema = *emaIter->second;
+    Matrix<ElemType>::AddScaledDifference((ElemType) (1 - m_emaDecay), dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(), ema, ema);
+}
+
+// Exchanges the values of the parameters with their moving averages; a second call swaps them back. Only the matrix
+// pointers are swapped, since the averages are kept on the device of the values with the same dimensions.
+template <class ElemType>
+void SGD<ElemType>::SwapEmaValues()
+{
+    for (auto& ema : m_emaValues)
+    {
+        std::swap(dynamic_pointer_cast<ComputationNode<ElemType>>(ema.first)->ValuePtrRef(), ema.second);
+        ema.first->BumpEvalTimeStamp();
+    }
+}
+
 // protected:
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
@@ -2266,7 +3579,7 @@ void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actual
         double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
         if (m_gradientClippingWithTruncation)
             gradient.InplaceTruncate((ElemType)(maxGradientPerMB));
-        else
+        else if (!m_gradientClippingByGlobalNorm) // (otherwise all gradients have been clipped together, see GetGlobalNormClippingFactor())
         {
             // norm2 normalized
             double gradientNorm = gradient.FrobeniusNorm();
@@ -2279,67 +3592,473 @@ void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actual
     }
 }
 
+// protected:
+// With gradientClippingByGlobalNorm, clippingThresholdPerSample limits the norm of all gradients together.
+// The squares of all dense gradients are summed in a single multi-tensor pass.
+template <class ElemType>
+double SGD<ElemType>::GetGlobalNormClippingFactor(const std::list<ComputationNodeBasePtr>& learnableNodes, size_t actualMBSize) const
+{
+    if (!m_gradientClippingByGlobalNorm || m_gradientClippingWithTruncation || m_clippingThresholdPerSample == std::numeric_limits<double>::infinity())
+        return 1;
+
+    double sumOfSquares = 0;
+    vector<const Matrix<ElemType>*> denseGradients;
+    bool isFlat = m_flatParameters && m_flatParameters->AreGradientsBound(); // then the gradients in the buffer are summed up together
+    if (isFlat)
+        denseGradients.push_back(&m_flatParameters->Gradients());
+    for (const auto& node : learnableNodes)
+    {
+        if (!node->IsParameterUpdateRequired() || (isFlat && m_flatParameters->Contains(node)))
+            continue;
+        const auto& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient();
+        if (gradient.GetMatrixType() == DENSE)
+            denseGradients.push_back(&gradient);
+        else
+            sumOfSquares += pow(gradient.FrobeniusNorm(), 2);
+    }
+    for (double denseSumOfSquares : Matrix<ElemType>::MultiTensorSumOfSquares(denseGradients))
+        sumOfSquares += denseSumOfSquares;
+
+    double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
+    double gradientNorm = sqrt(sumOfSquares);
+    return gradientNorm > maxGradientPerMB ? maxGradientPerMB / gradientNorm : 1;
+}
+
+// protected:
+// The smoothed gradients are allocated by the update on first use; a FlatParameterBuffer must know their size up front.
+template <class ElemType>
+size_t SGD<ElemType>::SmoothedGradientStateSize() const
+{
+    switch (GradUpdateType())
+    {
+    case GradientsUpdateType::FSAdaGrad: return MultiTensorUpdateStateSize(MultiTensorUpdateRule::FSAdaGrad);
+    case GradientsUpdateType::RmsProp:   return MultiTensorUpdateStateSize(MultiTensorUpdateRule::RmsProp);
+    case GradientsUpdateType::Adam:      return MultiTensorUpdateStateSize(MultiTensorUpdateRule::Adam);
+    case GradientsUpdateType::Lamb:      return MultiTensorUpdateStateSize(MultiTensorUpdateRule::Lamb);
+    default:                             return 1;
+    }
+}
+
+// protected:
+// Updates all parameters with dense gradients in one or two passes over all of them (see Matrix::MultiTensorUpdate()),
+// instead of several kernels per parameter as in UpdateWeights(). Sparse gradients and gradient noise are left to UpdateWeights().
+template <class ElemType>
+std::vector<bool> SGD<ElemType>::UpdateWeightsFused(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                                    std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                                                    const double learnRatePerSample, const double momentumPerSample,
+                                                    size_t actualMBSize, const double gradientScale) const
+{
+    vector<bool> isUpdated(learnableNodes.size(), false);
+    if (GradientUpdateNoiseStd() > 0)
+        return isUpdated;
+
+    MultiTensorUpdateParams<ElemType> params;
+    switch (GradUpdateType())
+    {
+    case GradientsUpdateType::None:      params.rule = m_useNesterovMomentum ? MultiTensorUpdateRule::NesterovMomentum : MultiTensorUpdateRule::Momentum; break;
+    case GradientsUpdateType::AdaGrad:   params.rule = MultiTensorUpdateRule::AdaGrad; break;
+    case GradientsUpdateType::FSAdaGrad: params.rule = MultiTensorUpdateRule::FSAdaGrad; break;
+    case GradientsUpdateType::RmsProp:   params.rule = MultiTensorUpdateRule::RmsProp; break;
+    case GradientsUpdateType::Adam:      params.rule = MultiTensorUpdateRule::Adam; break;
+    case GradientsUpdateType::Lars:      if (m_useNesterovMomentum) return isUpdated; // (Nesterov is left to UpdateWeights())
+                                         params.rule = MultiTensorUpdateRule::Lars; break;
+    case GradientsUpdateType::Lamb:      params.rule = MultiTensorUpdateRule::Lamb; break;
+    default: return isUpdated;
+    }
+    const double varMomentum = exp(-1.0 * actualMBSize / m_gradType.varianceTimeConstant);
+    params.momentum = (ElemType) MomentumPerMB(momentumPerSample, actualMBSize);
+    params.varMomentum = (ElemType) varMomentum;
+    params.adamEpsilon = (ElemType) m_gradType.adamEpsilon;
+    params.larsCoefficient = (ElemType) m_gradType.larsCoefficient;
+    params.needAveMultiplier = m_needAveMultiplier;
+    params.rmsGamma = (ElemType) m_rpi.gamma;
+    params.rmsWgtInc = (ElemType) m_rpi.inc;
+    params.rmsWgtMax = (ElemType) m_rpi.max;
+    params.rmsWgtDec = (ElemType) m_rpi.dec;
+    params.rmsWgtMin = (ElemType) m_rpi.min;
+
+    // clipping, see ClipGradient()
+    const bool isClipping = m_clippingThresholdPerSample != std::numeric_limits<double>::infinity();
+    const double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
+    params.gradientClipValue = isClipping && m_gradientClippingWithTruncation ? (ElemType) maxGradientPerMB : 0;
+
+    vector<Matrix<ElemType>*> values, gradients, states, emaValues;
+    vector<MultiTensorUpdateItem<ElemType>> items;
+    auto smoothedGradientIter = smoothedGradients.begin();
+    auto smoothedCountIter = smoothedCounts.begin();
+    size_t k = 0;
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, smoothedCountIter++, k++)
+    {
+        ComputationNodeBasePtr node = *nodeIter;
+        auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        auto& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient();
+        if (!node->IsParameterUpdateRequired() || value.GetMatrixType() != DENSE || gradient.GetMatrixType() != DENSE || smoothedGradientIter->GetMatrixType() != DENSE)
+            continue;
+        if (m_lazyUpdateStates.count(node) > 0) // (updated lazily, see TrainOneEpoch())
+            continue;
+
+        double nodeDependentLearningRatePerSample = learnRatePerSample * node->GetLearningRateMultiplier();
+        double nodeDependentRegMultiplier = dynamic_pointer_cast<LearnableParameter<ElemType>>(node)->GetRegMultiplier();
+        MultiTensorUpdateItem<ElemType> item = {};
+        item.learnRatePerSample = (ElemType) nodeDependentLearningRatePerSample;
+        item.gradientScale = (ElemType) gradientScale;
+        item.l2RegWeight = (ElemType) (m_L2RegWeight * nodeDependentRegMultiplier * actualMBSize);
+        item.l1Threshold = (ElemType) (nodeDependentLearningRatePerSample * m_L1RegWeight * nodeDependentRegMultiplier * actualMBSize);
+        if (params.rule == MultiTensorUpdateRule::FSAdaGrad)
+        {
+            // see Matrix::FSAdagradUpdate()
+            double& smoothedCount = *smoothedCountIter;
+            smoothedCount = varMomentum * smoothedCount + (1.0 - varMomentum) * actualMBSize;
+            item.adaMul = (ElemType) (m_gradType.targetAdagradAvDenom * sqrt(smoothedCount));
+        }
+        else if (params.rule == MultiTensorUpdateRule::Adam || params.rule == MultiTensorUpdateRule::Lamb)
+        {
+            // see Matrix::AdamUpdate() and LambUpdate()
+            double& smoothedCount = *smoothedCountIter;
+            smoothedCount++;
+            item.adaMul = (ElemType) GetAdamBiasCorrection(params.momentum, varMomentum, smoothedCount);
+            item.decoupledDecay = (ElemType) (params.rule == MultiTensorUpdateRule::Adam ? nodeDependentLearningRatePerSample * m_gradType.weightDecay : m_gradType.weightDecay);
+        }
+        auto emaIter = m_emaValues.find(node);
+        emaValues.push_back(emaIter != m_emaValues.end() ? emaIter->second.get() : nullptr);
+        item.emaDecay = (ElemType) m_emaDecay;
+        values.push_back(&value);
+        gradients.push_back(&gradient);
+        states.push_back(&*smoothedGradientIter);
+        items.push_back(item);
+        isUpdated[k] = true;
+    }
+
+    // norm clipping of each gradient, with the norms of all of them from one pass
+    if (isClipping && !m_gradientClippingWithTruncation && !m_gradientClippingByGlobalNorm)
+    {
+        auto sumsOfSquares = Matrix<ElemType>::MultiTensorSumOfSquares(vector<const Matrix<ElemType>*>(gradients.begin(), gradients.end()));
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            double gradientNorm = sqrt(sumsOfSquares[i]) * gradientScale;
+            if (gradientNorm > maxGradientPerMB)
+                items[i].gradientScale = (ElemType) (gradientScale * maxGradientPerMB / gradientNorm);
+        }
+    }
+
+    Matrix<ElemType>::MultiTensorUpdate(values, gradients, states, items, params, emaValues);
+    return isUpdated;
+}
+
 template <class ElemType>
 void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen,
                                        const double learnRatePerSample,
                                        const std::list<Matrix<ElemType>>& smoothedGradients,
                                        const std::vector<double>& smoothedCounts,
                                        const double prevCriterion,
-                                       const size_t minibatchSize)
+                                       const size_t minibatchSize,
+                                       const std::string& readerState)
 {
     // In case of parallel training only the main node should we saving the checkpoint to prevent
     // the parallel training nodes from colliding to write the same file
     if ((m_mpi == nullptr) || m_mpi->IsMainNode())
     {
         wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
-        // Saving into temporary file and then renaming it to the checkPointFileName
-        // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
-        wstring tempFileName = checkPointFileName + L".tmp";
+        size_t numShards = NumCheckPointShards();
+        auto gradients = CheckPointGradients(smoothedGradients, /*shard=*/0); // with sharding, the others are saved by SaveCheckPointShard()
+        auto emaValues = CheckPointEmaValues();
+        auto pMASGDHelper = m_pMASGDHelper;
 
+        WriteCheckPoint([=]()
         {
-            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
-            // Buffer writes in memory then flush to filesystem, which reduces number of small writes
-            fstream.Setvbuf();
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
-            fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+            // Saving into temporary file and then renaming it to the checkPointFileName
+            // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
+            wstring tempFileName = checkPointFileName + L".tmp";
+
+            {
+                File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+                // Buffer writes in memory then flush to filesystem, which reduces number of small writes
+                fstream.Setvbuf();
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
+                fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
+                fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
+                fstream << minibatchSize;
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
+
+                if (numShards > 1)
+                {
+                    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BShards");
+                    fstream << numShards;
+                    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EShards");
+                }
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
-            fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
-            fstream << minibatchSize;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
+                for (const auto& smoothedGradient : gradients)
+                    fstream << *smoothedGradient;
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
 
-            for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
-            {
-                const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
-                fstream << smoothedGradient;
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"BCount");
+
+                for (auto sc : smoothedCounts)
+                    fstream << sc;
+
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECount");
+
+                if (!emaValues.empty())
+                {
+                    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BEma");
+                    fstream << emaValues.size();
+                    for (const auto& ema : emaValues)
+                        fstream << ema.first << *ema.second;
+                    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EEma");
+                }
+
+                // the state of the reader at the end of the epoch, optional
+                if (!readerState.empty())
+                {
+                    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BReaderState");
+                    fstream << readerState;
+                    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EReaderState");
+                }
+
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
+                if (pMASGDHelper)
+                    pMASGDHelper->SaveToCheckPoint(fstream);
+                // Ensuring that data is written
+                fstream.Flush();
             }
 
+            _wunlink(checkPointFileName.c_str());
+            renameOrDie(tempFileName, checkPointFileName);
+        });
+    }
+}
+
+// With sharded checkpoints, each worker but the main node saves its share of the smoothed gradients to its own file.
+template <class ElemType>
+void SGD<ElemType>::SaveCheckPointShard(const size_t epoch, const std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    if (NumCheckPointShards() <= 1 || m_mpi->IsMainNode())
+        return;
+
+    size_t shard = m_mpi->CurrentNodeRank();
+    wstring shardFileName = GetCheckPointShardFileName(int(epoch), shard);
+    auto gradients = CheckPointGradients(smoothedGradients, shard);
+
+    WriteCheckPoint([=]()
+    {
+        wstring tempFileName = shardFileName + L".tmp";
+        {
+            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+            fstream.Setvbuf();
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+            for (const auto& smoothedGradient : gradients)
+                fstream << *smoothedGradient;
             fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+            fstream.Flush();
+        }
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"BCount");
+        _wunlink(shardFileName.c_str());
+        renameOrDie(tempFileName, shardFileName);
+    });
+}
 
-            for (auto sc : smoothedCounts)
-                fstream << sc;
+// Returns the smoothed gradients k with k % NumCheckPointShards() == shard, for asynchronous writing as copies in CPU memory.
+template <class ElemType>
+std::vector<std::shared_ptr<const Matrix<ElemType>>> SGD<ElemType>::CheckPointGradients(const std::list<Matrix<ElemType>>& smoothedGradients, const size_t shard) const
+{
+    bool snapshot = m_asyncCheckPoint && !m_pMASGDHelper;
+    size_t numShards = NumCheckPointShards();
+    // the smoothed gradients in a flat parameter buffer are copied in one transfer (of all of them, hence not with shards)
+    std::shared_ptr<Matrix<ElemType>> flatCopy;
+    if (snapshot && m_flatParameters && numShards == 1)
+    {
+        flatCopy = std::make_shared<Matrix<ElemType>>(1, m_flatParameters->States().GetNumCols(), CPUDEVICE);
+        flatCopy->AssignValuesOf(m_flatParameters->States());
+    }
+    std::vector<std::shared_ptr<const Matrix<ElemType>>> gradients;
+    size_t k = 0;
+    for (const auto& smoothedGradient : smoothedGradients)
+    {
+        if (k++ % numShards != shard)
+            continue;
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECount");
+        if (flatCopy && FlatParameterBuffer<ElemType>::IsViewOf(m_flatParameters->States(), smoothedGradient))
+            gradients.push_back(std::make_shared<Matrix<ElemType>>(FlatParameterBuffer<ElemType>::CorrespondingView(m_flatParameters->States(), *flatCopy, smoothedGradient)));
+        else if (snapshot)
+        {
+            auto copy = std::make_shared<Matrix<ElemType>>(smoothedGradient.GetNumRows(), smoothedGradient.GetNumCols(), CPUDEVICE);
+            copy->AssignValuesOf(smoothedGradient);
+            gradients.push_back(copy);
+        }
+        else
+            gradients.push_back(std::shared_ptr<const Matrix<ElemType>>(&smoothedGradient, [](const Matrix<ElemType>*) {}));
+    }
+    return gradients;
+}
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
-            if (m_pMASGDHelper)
-                m_pMASGDHelper->SaveToCheckPoint(fstream);
-            // Ensuring that data is written
-            fstream.Flush();
+// Returns the moving averages of the parameters (m_emaDecay) by node name, copied to CPU memory like by CheckPointGradients().
+template <class ElemType>
+std::vector<std::pair<std::wstring, std::shared_ptr<const Matrix<ElemType>>>> SGD<ElemType>::CheckPointEmaValues() const
+{
+    bool snapshot = m_asyncCheckPoint && !m_pMASGDHelper;
+    std::shared_ptr<Matrix<ElemType>> flatCopy; // of m_flatEmaValues, in one transfer
+    if (snapshot && m_flatEmaValues)
+    {
+        flatCopy = std::make_shared<Matrix<ElemType>>(1, m_flatEmaValues->GetNumCols(), CPUDEVICE);
+        flatCopy->AssignValuesOf(*m_flatEmaValues);
+    }
+    std::vector<std::pair<std::wstring, std::shared_ptr<const Matrix<ElemType>>>> emaValues;
+    for (const auto& ema : m_emaValues)
+    {
+        std::shared_ptr<const Matrix<ElemType>> matrix = ema.second;
+        if (flatCopy && FlatParameterBuffer<ElemType>::IsViewOf(*m_flatEmaValues, *matrix))
+            matrix = std::make_shared<Matrix<ElemType>>(FlatParameterBuffer<ElemType>::CorrespondingView(*m_flatEmaValues, *flatCopy, *matrix));
+        else if (snapshot)
+        {
+            auto copy = std::make_shared<Matrix<ElemType>>(matrix->GetNumRows(), matrix->GetNumCols(), CPUDEVICE);
+            copy->AssignValuesOf(*matrix);
+            matrix = copy;
         }
+        emaValues.push_back(make_pair(ema.first->NodeName(), matrix));
+    }
+    return emaValues;
+}
+
+template <class ElemType>
+size_t SGD<ElemType>::NumCheckPointShards() const
+{
+    // all workers hold the same smoothed gradients only if the gradients are aggregated
+    if (m_shardedCheckPoint && m_mpi != nullptr && GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD)
+        return m_mpi->NumNodesInUse();
+    return 1;
+}
+
+// Runs 'write' now, or with asyncCheckPoint on a background thread. The state of model averaging (m_pMASGDHelper) is
+// not snapshotted, so its checkpoints are always written synchronously.
+template <class ElemType>
+void SGD<ElemType>::WriteCheckPoint(const std::function<void()>& write)
+{
+    if (m_asyncCheckPoint && !m_pMASGDHelper)
+        m_pendingCheckPointWrites.push_back(std::async(std::launch::async, write));
+    else
+        write();
+}
 
-        _wunlink(checkPointFileName.c_str());
-        renameOrDie(tempFileName, checkPointFileName);
+template <class ElemType>
+void SGD<ElemType>::SaveModel(ComputationNetworkPtr net, const wstring& modelName)
+{
+    if (!m_asyncCheckPoint || m_checkPointStagingDir.empty())
+    {
+        net->Save(modelName);
+        return;
     }
+
+    // save to the staging directory, then move the file to its destination in the background
+    wstring stagingFileName = m_checkPointStagingDir + L"/" + File::FileNameOf(modelName) + L".staging";
+    net->Save(stagingFileName);
+
+    WriteCheckPoint([=]()
+    {
+        wstring tempFileName = modelName + L".tmp";
+        {
+            FILE* from = fopenOrDie(stagingFileName, L"rb");
+            FILE* to = fopenOrDie(tempFileName, L"wb");
+            std::vector<char> buffer(1 << 24);
+            size_t n;
+            while ((n = fread(buffer.data(), 1, buffer.size(), from)) > 0)
+                fwriteOrDie(buffer.data(), 1, n, to);
+            if (ferror(from))
+                RuntimeError("SaveModel: Error reading the staged model '%ls'.", stagingFileName.c_str());
+            fcloseOrDie(from);
+            fcloseOrDie(to);
+        }
+        renameOrDie(tempFileName, modelName);
+        _wunlink(stagingFileName.c_str());
+    });
+}
+
+// Waits until the checkpoints that are being written in the background are complete, on all workers, e.g. before one
+// is read or deleted. Must be called by all workers alike.
+template <class ElemType>
+void SGD<ElemType>::WaitForCheckPointWrites()
+{
+    if (!m_asyncCheckPoint)
+        return;
+
+    auto pendingWrites = std::move(m_pendingCheckPointWrites);
+    m_pendingCheckPointWrites.clear();
+    for (auto& pendingWrite : pendingWrites)
+        pendingWrite.get(); // (rethrows errors of the write)
+    SynchronizeWorkers();
+}
+
+// Saves the model of the epoch (with emaDecay, the moving averages of the parameters) to the snapshot file, from which
+// the replica rereads its parameters on the background thread. Each worker evaluates the whole CV set by itself, as
+// MPI is busy with training; in data-parallel training, all workers hold the same model and so get the same scores.
+template <class ElemType>
+void SGD<ElemType>::StartCrossValidation(ComputationNetworkPtr net, const int epochNumber, IDataReader* validationSetDataReader,
+                                         const std::vector<std::wstring>& cvSetTrainAndEvalNodes, const size_t mbSize)
+{
+    if (m_pendingCrossValidation.valid())
+        LogicError("StartCrossValidation: The previous cross validation has not finished.");
+
+    wstring snapshotPath = GetCrossValidationSnapshotPath();
+    SwapEmaValues();
+    net->Save(snapshotPath);
+    SwapEmaValues();
+
+    m_pendingCrossValidationEpoch = epochNumber;
+    m_pendingCrossValidation = std::async(std::launch::async, [=]()
+    {
+        if (!m_crossValidationReplica)
+            m_crossValidationReplica = ComputationNetwork::CreateFromFile<ElemType>(m_asyncCrossValidationDevice, snapshotPath);
+        else
+            m_crossValidationReplica->RereadPersistableParameters<ElemType>(snapshotPath);
+        SimpleEvaluator<ElemType> evaluator(m_crossValidationReplica, /*mpi=*/nullptr, /*enableDistributedMBReading=*/false, /*numMBsToShowResult=*/0);
+        return evaluator.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, mbSize);
+    });
+}
+
+template <class ElemType>
+int SGD<ElemType>::FinishCrossValidation(/*out*/ std::vector<EpochCriterion>& vScore)
+{
+    if (!m_pendingCrossValidation.valid())
+        return -1;
+    vScore = m_pendingCrossValidation.get(); // (rethrows errors of the evaluation)
+    return m_pendingCrossValidationEpoch;
+}
+
+template <class ElemType>
+void SGD<ElemType>::DiscardCrossValidation()
+{
+    if (!m_pendingCrossValidation.valid())
+        return;
+    m_pendingCrossValidation.wait();
+    m_pendingCrossValidation = std::future<std::vector<EpochCriterion>>();
+}
+
+template <class ElemType>
+std::wstring SGD<ElemType>::GetCrossValidationSnapshotPath() const
+{
+    wstring snapshotPath = m_modelPath + L".cvsnapshot";
+    if (m_mpi != nullptr)
+        snapshotPath += L"." + std::to_wstring(m_mpi->CurrentNodeRank());
+    return snapshotPath;
+}
+
+template <class ElemType>
+void SGD<ElemType>::LogValidationScores(const int epochNumber, const std::vector<std::wstring>& cvSetTrainAndEvalNodes, const std::vector<EpochCriterion>& vScore) const
+{
+    LOGPRINTF(stderr, "Finished Epoch[%2d of %d]: [Validate] ", epochNumber + 1, (int)m_maxEpochs);
+    for (size_t k = 0; k < vScore.size() /*&& k < 2*/; k++)
+        vScore[k].LogCriterion(cvSetTrainAndEvalNodes[k], /*addSemicolon=*/k + 1 < vScore.size());
+        //fprintf(stderr, "%s %ls = %.8f * %d", k ? ";" : "", cvSetTrainAndEvalNodes[k].c_str(), vScore[k].Average(), (int)vScore[k].second);
+    fprintf(stderr, "\n");
 }
 
 template <class ElemType>
@@ -2409,14 +4128,43 @@ void SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
         minibatchSize = m_mbSize[epochNumber];
     }
 
+    // sharded checkpoints: the smoothed gradients k with k % numShards == s are in shard s, which is this file for s = 0
+    size_t numShards = 1;
+    if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BShards"))
+    {
+        fstream >> numShards;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EShards");
+    }
+    std::vector<std::unique_ptr<File>> shardStreams;
+    for (size_t shard = 1; shard < numShards; shard++)
+    {
+        shardStreams.push_back(std::make_unique<File>(GetCheckPointShardFileName(int(epochNumber), shard), FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead));
+        shardStreams.back()->GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+    }
+
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
 
-    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+    size_t k = 0;
+    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++, k++)
     {
         Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
-        fstream >> smoothedGradient;
+        File& shardStream = (k % numShards == 0) ? fstream : *shardStreams[k % numShards - 1];
+        if (m_flatParameters && FlatParameterBuffer<ElemType>::IsViewOf(m_flatParameters->States(), smoothedGradient))
+        {
+            // a view into the flat parameter buffer cannot be resized; one saved before its first update is still unallocated (all zero)
+            Matrix<ElemType> savedGradient(smoothedGradient.GetDeviceId());
+            shardStream >> savedGradient;
+            if (savedGradient.GetNumRows() == smoothedGradient.GetNumRows() && savedGradient.GetNumCols() < smoothedGradient.GetNumCols())
+                smoothedGradient.SetValue(0);
+            else
+                smoothedGradient.SetValue(savedGradient);
+        }
+        else
+            shardStream >> smoothedGradient;
     }
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+    for (auto& shardStream : shardStreams)
+        shardStream->GetMarker(FileMarker::fileMarkerEndSection, L"EGradient");
 
     if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BCount"))
     {
@@ -2427,6 +4175,34 @@ void SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
     else // deal with legacy checkpoints
         std::fill(smoothedCounts.begin(), smoothedCounts.end(), static_cast<double>(minibatchSize));
 
+    // the moving averages of the parameters, by node name; without them, they restart from the values of the model
+    if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BEma"))
+    {
+        size_t numEmaValues;
+        fstream >> numEmaValues;
+        for (size_t k = 0; k < numEmaValues; k++)
+        {
+            wstring nodeName;
+            fstream >> nodeName;
+            auto emaIter = find_if(m_emaValues.begin(), m_emaValues.end(), [&](const pair<const ComputationNodeBasePtr, shared_ptr<Matrix<ElemType>>>& ema) { return ema.first->NodeName() == nodeName; });
+            Matrix<ElemType> unused(CPUDEVICE);
+            fstream >> (emaIter != m_emaValues.end() ? *emaIter->second : unused);
+        }
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EEma");
+    }
+    else
+    {
+        for (auto& ema : m_emaValues)
+            ema.second->SetValue(dynamic_pointer_cast<ComputationNode<ElemType>>(ema.first)->Value());
+    }
+
+    m_checkPointReaderState.clear();
+    if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BReaderState"))
+    {
+        fstream >> m_checkPointReaderState;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EReaderState");
+    }
+
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECKP");
 
     if (m_pMASGDHelper)
@@ -2443,6 +4219,20 @@ wstring SGD<ElemType>::GetCheckPointFileNameForEpoch(const int epoch)
     return GetModelNameForEpoch(epoch) + L".ckp";
 }
 
+template <class ElemType>
+wstring SGD<ElemType>::GetCheckPointShardFileName(const int epoch, const size_t shard)
+{
+    return GetCheckPointFileNameForEpoch(epoch) + L".shard" + std::to_wstring(shard);
+}
+
+template <class ElemType>
+void SGD<ElemType>::DeleteCheckPointFiles(const int epoch)
+{
+    _wunlink(GetCheckPointFileNameForEpoch(epoch).c_str());
+    for (size_t shard = 1; shard < NumCheckPointShards(); shard++)
+        _wunlink(GetCheckPointShardFileName(epoch, shard).c_str());
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetModelNameForEpoch(const int epoch, bool bLastModel)
 {
@@ -2494,6 +4284,10 @@ int SGD<ElemType>::DetermineStartEpoch(const bool makeMode)
 #define EPSILON 1e-5
 
 // this probes the automatic gradient computation with random inputs
+// The gradients come from a single backprop, and are compared at up to m_gradientCheckNumSamples sampled elements per parameter
+// to central differences of the criterion. A perturbed forward only recomputes the nodes that depend on the perturbed parameter,
+// as only its time stamp is bumped. In parallel training, the workers check disjoint shares of the sampled elements, each on its own
+// minibatch, and the failures are summed over all of them.
 template <class ElemType>
 bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
                                   const std::vector<ComputationNodeBasePtr>& criterionNodes,
@@ -2502,71 +4296,65 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
 {
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
 
-    net->StartEvaluateMinibatchLoop(criterionNodes[npos2]);
-
-    vector<string> errMsgs; // TODO: These are created but actually not returned, only their count is checked.
-
-    // gradient checking
-    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+    const auto& criterionNode = criterionNodes[npos2];
+    net->StartEvaluateMinibatchLoop(criterionNode);
+
+    const bool isParallel = m_mpi != nullptr && m_mpi->NumNodesInUse() > 1;
+    const size_t numWorkers = isParallel ? m_mpi->NumNodesInUse() : 1;
+    const size_t rank = isParallel ? m_mpi->CurrentNodeRank() : 0;
+
+    // the gradients to check, of all parameters at once
+    for (const auto& node : learnableNodes)
+        node->BumpEvalTimeStamp();
+    net->ForwardProp(criterionNode);
+    net->Backprop(criterionNode);
+    const double criterion = criterionNode->Get00Element();
+
+    // the same elements on all workers, but others for every call
+    std::mt19937 rng((unsigned int) m_gradientCheckNumCalls++);
+    size_t numChecked = 0;
+    size_t numWrong = 0;
+    for (const auto& learnableNode : learnableNodes)
     {
-        ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
-        char wstrtmp[2048];
-
-        for (size_t itry = 0; itry < min((size_t) 50, node->Value().GetNumElements()); itry++)
+        ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(learnableNode);
+        if (node->Gradient().GetMatrixType() == MatrixType::SPARSE) // no support to sparse matrix yet
+            continue;
+
+        // sample the elements to check, without repetition
+        const size_t numElements = node->Value().GetNumElements();
+        std::vector<size_t> elements(numElements);
+        std::iota(elements.begin(), elements.end(), 0);
+        const size_t numSamples = min(m_gradientCheckNumSamples, numElements);
+        for (size_t i = 0; i < numSamples; i++)
+            std::swap(elements[i], elements[i + rng() % (numElements - i)]);
+        elements.resize(numSamples);
+
+        const size_t numRows = node->Value().GetNumRows();
+        unique_ptr<ElemType[]> values(node->Value().CopyToArray());
+        unique_ptr<ElemType[]> gradients(node->Gradient().CopyToArray());
+        for (size_t i = rank; i < elements.size(); i += numWorkers)
         {
-            // no support to sparse matrix yet
-            int irow = (int)fmod(rand(), node->Value().GetNumRows() - 1);
-            int icol = (int)fmod(rand(), node->Value().GetNumCols() - 1);
-            irow = max(0, irow);
-            icol = max(0, icol);
+            const size_t irow = elements[i] % numRows;
+            const size_t icol = elements[i] / numRows;
+            double eGradErr = gradients[elements[i]];
 
-            fprintf(stderr, "\n");
-            LOGPRINTF(stderr, "###### d%ls######\n", node->NodeName().c_str());
+            // a step relative to the magnitude of the element, such that it does not vanish in its precision
+            double eOrg = values[elements[i]];
+            const double step = EPSILON * max(1.0, fabs(eOrg));
+            double ePos = (ElemType) (eOrg + step); // (the step as represented)
+            double eNeg = (ElemType) (eOrg - step);
 
-            double eOrg = node->Value()(irow, icol);
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
-
-            node->BumpEvalTimeStamp();
-
-            net->ForwardProp(criterionNodes[npos2]);
-            net->Backprop(criterionNodes[npos2]);
-
-            if (node->Gradient().GetMatrixType() == MatrixType::SPARSE)
+            auto evaluateWith = [&](double value)
             {
-                break;
-            }
-
-            // double mbEvalCri =
-            // criterionNode should be a scalar
-            // TODO: why is this value not used?
-            criterionNodes[npos2]->Get00Element();
-            double eGradErr = node->Gradient()(irow, icol);
-            node->Gradient().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
-
-            double ePos = eOrg + EPSILON;
-            double eNeg = eOrg - EPSILON;
-
-            node->Value()(irow, icol) = (ElemType) ePos;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
-
-            node->BumpEvalTimeStamp();
-            net->ForwardProp(criterionNodes[npos2]);
-            // criterionNode should be a scalar
-
-            double mbEvalCriPos = criterionNodes[npos2]->Get00Element(); // TODO: make Get00Element() a function of ComputationNodeBase
-
-            node->Value()(irow, icol) = (ElemType) eNeg;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
-
-            node->BumpEvalTimeStamp();
-            net->ForwardProp(criterionNodes[npos2]);
-
-            // criterionNode should be a scalar
-            double mbEvalCriNeg = criterionNodes[npos2]->Get00Element();
-
-            // back to its original parameter value
-            node->Value()(irow, icol) = (ElemType) eOrg;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+                node->Value()(irow, icol) = (ElemType) value;
+                node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+                node->BumpEvalTimeStamp();
+                net->ForwardProp(criterionNode);
+                return (double) criterionNode->Get00Element(); // criterionNode should be a scalar
+            };
+            double mbEvalCriPos = evaluateWith(ePos);
+            double mbEvalCriNeg = evaluateWith(eNeg);
+            evaluateWith(eOrg); // back to its original parameter value, and the values of the network with it
 
             // check if they are consistent
             double eGradNum = ((mbEvalCriPos - mbEvalCriNeg) / (ePos - eNeg));
@@ -2579,17 +4367,21 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             bool wrong = (std::isnan(diff) || diff > threshold);
             if (wrong)
             {
-                fprintf(stderr, "\n");
-                LOGPRINTF(stderr, "d%ls Numeric gradient = %e, Error BP gradient = %e\n",
-                          node->NodeName().c_str(), eGradNum, eGradErr);
-                sprintf(wstrtmp, "\nd%ls Numeric gradient = %e, Error BP gradient = %e\n",
-                        node->NodeName().c_str(), eGradNum, eGradErr);
-                errMsgs.push_back(wstrtmp);
+                LOGPRINTF(stderr, "d%ls[%d,%d] Numeric gradient = %e, Error BP gradient = %e\n",
+                          node->NodeName().c_str(), (int) irow, (int) icol, eGradNum, eGradErr);
+                numWrong++;
             }
+            numChecked++;
         }
     }
 
-    return errMsgs.empty();
+    if (isParallel)
+    {
+        m_mpi->AllReduce(&numChecked, 1);
+        m_mpi->AllReduce(&numWrong, 1);
+    }
+    LOGPRINTF(stderr, "Gradient check: %d of %d sampled gradient elements are wrong (criterion = %.8g).\n", (int) numWrong, (int) numChecked, criterion);
+    return numWrong == 0;
 }
 
 template <class ElemType>
@@ -2621,9 +4413,12 @@ static GradientsUpdateType ParseGradUpdateType(const wstring& s)
     else if (EqualCI(s, L"adagrad"))                 return GradientsUpdateType::AdaGrad;
     else if (EqualCI(s, L"rmsProp"))                 return GradientsUpdateType::RmsProp;
     else if (EqualCI(s, L"fsAdagrad"))               return GradientsUpdateType::FSAdaGrad;
+    else if (EqualCI(s, L"adam"))                    return GradientsUpdateType::Adam;
+    else if (EqualCI(s, L"lars"))                    return GradientsUpdateType::Lars;
+    else if (EqualCI(s, L"lamb"))                    return GradientsUpdateType::Lamb;
     // legacy, deprecated
     else if (EqualCI(s, L"normal") || EqualCI(s, L"simple")) return GradientsUpdateType::None;
-    else InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad )");
+    else InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad | adam | lars | lamb )");
 }
 
 static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
@@ -2647,7 +4442,6 @@ static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
     else InvalidArgument("autoAdjustLR: Invalid learning rate search type. Valid values are (none | searchBeforeEpoch | adjustAfterEpoch)");
 }
   
-#ifdef ASGD_PARALLEL_SUPPORT
 static AdjustLearningRateAtBeginning AdjustLearningRateAtBeginningType(const wstring& s)
 {
     if      (EqualCI(s.c_str(), L"") || EqualCI(s.c_str(), L"none")) return AdjustLearningRateAtBeginning::None;
@@ -2655,7 +4449,6 @@ static AdjustLearningRateAtBeginning AdjustLearningRateAtBeginningType(const wst
     else if (EqualCI(s.c_str(), L"staircase"))                       return AdjustLearningRateAtBeginning::Staircase;
     else InvalidArgument("AdjustLearningRateatBeginningType: Invalid Type. Valid values are (None | Linearly | Staircase)");
 }
-#endif
   
 template<class ConfigRecordType>
 SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
@@ -2682,6 +4475,11 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_minibatchSizeTuningFrequency = configAALR(L"minibatchSizeTuningFrequency", (size_t) 1);
     m_minibatchSizeTuningMax = configAALR(L"minibatchSizeTuningMax", (size_t) 1048576);
     m_minibatchSearchCriterionErrorMargin = configAALR(L"minibatchSearchCriterionErrorMargin", (size_t) 1);
+    m_minibatchSearchByThroughput = configAALR(L"minibatchSearchByThroughput", false);
+    m_minibatchSearchMemoryReserve = configAALR(L"minibatchSearchMemoryReserve", 0.1);
+    if (m_minibatchSearchMemoryReserve < 0 || m_minibatchSearchMemoryReserve >= 1)
+        InvalidArgument("minibatchSearchMemoryReserve must be in [0, 1).");
+    m_parallelSearch = configAALR(L"parallelSearch", false);
 
     m_numPrevLearnRates = configAALR(L"numPrevLearnRates", (size_t) 5);
     m_numBestSearchEpoch = configAALR(L"numBestSearchEpoch", (size_t) 1);
@@ -2743,9 +4541,32 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numMBsToShowResult = configSGD(L"numMBsToShowResult", (size_t)10);
     m_firstMBsToShowResult = configSGD(L"firstMBsToShowResult", (size_t)0);
     m_numMBsToCUDAProfile = configSGD(L"numMBsToCUDAProfile", (size_t)0);
+    m_timelineProfileFile = (const wstring&) configSGD(L"timelineProfileFile", L"");
+    m_numMBsToTimelineProfile = m_timelineProfileFile.empty() ? 0 : configSGD(L"numMBsToTimelineProfile", (size_t)100);
+    m_performanceCountersFile = (const wstring&) configSGD(L"performanceCountersFile", L"");
+    m_performanceCountersInterval = configSGD(L"performanceCountersInterval", 10.0);
+    m_nodeTimingInterval = configSGD(L"nodeTimingInterval", (size_t)0);
+    m_memoryTimelineFile = (const wstring&) configSGD(L"memoryTimelineFile", L"");
+    m_memoryTimelineMinibatch = configSGD(L"memoryTimelineMinibatch", (size_t)0);
+    m_memoryTimelineTopN = configSGD(L"memoryTimelineTopN", (size_t)20);
 
     m_gradientClippingWithTruncation = configSGD(L"gradientClippingWithTruncation", true);
     m_clippingThresholdPerSample = configSGD(L"clippingThresholdPerSample", numeric_limits<double>::infinity());
+    m_gradientClippingByGlobalNorm = configSGD(L"gradientClippingByGlobalNorm", false);
+    m_fusedParameterUpdate = configSGD(L"fusedParameterUpdate", false);
+    m_nonFiniteCheckFrequency = configSGD(L"nonFiniteCheckFrequency", (size_t) 0);
+    m_flatParameterBuffer = configSGD(L"flatParameterBuffer", false);
+    m_lazySparseUpdate = configSGD(L"lazySparseUpdate", false);
+    m_emaDecay = configSGD(L"emaDecay", 0.0);
+    if (m_emaDecay < 0 || m_emaDecay >= 1)
+        InvalidArgument("emaDecay must be in [0, 1).");
+
+    m_mixedPrecisionGemm = configSGD(L"mixedPrecisionGemm", false);
+    m_lossScale = configSGD(L"lossScale", 1.0);
+    m_dynamicLossScaling = configSGD(L"dynamicLossScaling", false);
+    m_lossScaleWindow = configSGD(L"lossScaleWindow", (size_t) 2000);
+    if (m_lossScale < 1)
+        InvalidArgument("lossScale must be at least 1.");
 
     // sequence-training parameters
     m_hSmoothingWeight = configSGD(L"hSmoothingWeight", 0.95);
@@ -2756,6 +4577,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_seqGammarCalcLMF = configSGD(L"seqGammarLMF", 14.0);
     m_seqGammarCalcbMMIFactor = configSGD(L"seqGammarBMMIFactor", 0.0);
     m_seqGammarCalcWP = configSGD(L"seqGammarWordPen", 0.0);
+    m_seqLatticeCacheMB = configSGD(L"seqLatticeCacheMB", (size_t) 512); // device memory for keeping lattices on the GPU across epochs
     m_disableRegInBatchNormalization = configSGD(L"disableRegInBatchNormalization", false);
 
     m_dropoutRates = configSGD(L"dropoutRate", ConfigRecordType::Array(doubleargvector(vector<double>{0.0})));
@@ -2769,6 +4591,11 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     // parameters for FSAdaGrad
     m_gradType.varianceTimeConstant = configSGD(L"varianceTimeConstant", 2 * 3600 * 100); // default originates from 2h of speech
     m_gradType.targetAdagradAvDenom = configSGD(L"fsAdagradTargetAvDenom", 1.0); // TODO: deprecated parameter kept for back compat (set to 0.0025 inconjunction with reenabling the static bug)
+    // parameters for Adam and Lamb, which also use varianceTimeConstant
+    m_gradType.adamEpsilon = configSGD(L"adamEpsilon", 1e-8);
+    m_gradType.weightDecay = configSGD(L"weightDecay", 0.0);
+    // parameters for Lars
+    m_gradType.larsCoefficient = configSGD(L"larsCoefficient", 0.001);
 
     // extract RMSProp parameters from config, if they exist. Default to reasonable values.
     m_rpi.dec = configSGD(L"rms_wgt_dec", 0.75);
@@ -2791,6 +4618,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     // gradient check setup
     m_doGradientCheck = configSGD(L"gradientcheck", false);
     m_gradientCheckSigDigit = configSGD(L"sigFigs", 6.0); // TODO: why is this a double?
+    m_gradientCheckNumSamples = configSGD(L"gradientCheckSamples", (size_t) 50);
 
     if (m_doGradientCheck && sizeofElemType != sizeof(double))
     {
@@ -2798,6 +4626,9 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     }
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
+    m_distributedPreCompute = configSGD(L"distributedPreCompute", true);
+    m_preComputeMaxSamples = configSGD(L"preComputeMaxSamples", (size_t) SIZE_MAX);
+    m_preComputeCacheDir = (const wstring&) configSGD(L"preComputeCacheDir", L"");
 
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
@@ -2902,9 +4733,15 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = vector<int>{8 * (int)sizeofElemType}; // means no quantization
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientBucketSizeInMB = 0;
+    m_gradientDensity = 1;
     m_enableDistributedMBReading = false;
+    m_enableDistributedMBReadingNotSpecified = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
+    m_overlapModelAggregation = false;
+    m_elasticTraining = false;
+    m_numModelBits = 8 * (int)sizeofElemType;
 
     if (configSGD.Exists(L"ParallelTrain"))
     {
@@ -2927,6 +4764,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_enableDistributedMBReadingNotSpecified = !configParallelTrain.Exists(L"distributedMBReading");
             m_enableDistributedMBReading = configParallelTrain(L"distributedMBReading", false);
             m_syncStatsTrace = configParallelTrain(L"syncPerfStats", (int)0);
+            m_elasticTraining = configParallelTrain(L"elasticTraining", false);
 
         if (configParallelTrain.Exists(L"DataParallelSGD"))
         {
@@ -2935,11 +4773,19 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_numGradientBits = configDataParallelSGD(L"gradientBits", ConfigRecordType::Array(intargvector(vector<int>{defaultGradientBits})));
             m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
             m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+            m_gradientBucketSizeInMB = configDataParallelSGD(L"gradientBucketSizeInMB", (size_t) 0);
+            m_gradientDensity = configDataParallelSGD(L"gradientDensity", 1.0);
             for (size_t i = 0; i < m_numGradientBits.size(); i++)
             {
                 if (m_numGradientBits[i] < 1 || m_numGradientBits[i] > defaultGradientBits)
                     InvalidArgument("gradientBits values must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double.");
+                if (m_gradientDensity < 1 && m_numGradientBits[i] != defaultGradientBits)
+                    InvalidArgument("gradientDensity < 1 (top-k sparsification) cannot be combined with gradientBits < %d.", defaultGradientBits);
             }
+            if (m_gradientDensity <= 0 || m_gradientDensity > 1)
+                InvalidArgument("gradientDensity must be in the range (0, 1].");
+            if (m_gradientDensity < 1 && m_bufferedAsyncGradientAggregation)
+                InvalidArgument("gradientDensity < 1 (top-k sparsification) cannot be combined with useBufferedAsyncGradientAggregation.");
         }
         if (configParallelTrain.Exists(L"ModelAveragingSGD"))
         {
@@ -2973,6 +4819,14 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 fprintf(stderr, "WARNING: option syncPeroid in ModelAveragingSGD is going to be deprecated. Please use blockSizePerWorker instead in the future.\n");
             }
 #endif
+            m_overlapModelAggregation = configMASGD(L"overlapModelAggregation", false);
+            let defaultModelBits = 8 * (int)sizeofElemType;
+            m_numModelBits = configMASGD(L"modelBits", defaultModelBits);
+            m_zeroThresholdFor1Bit = configMASGD(L"useZeroThresholdFor1BitQuantization", m_zeroThresholdFor1Bit);
+            if (m_numModelBits < 1 || m_numModelBits > defaultModelBits)
+                InvalidArgument("modelBits must be in the range [1, %d].", defaultModelBits);
+            if (m_numModelBits < defaultModelBits && m_overlapModelAggregation)
+                InvalidArgument("modelBits < %d (quantized model averaging) cannot be combined with overlapModelAggregation.", defaultModelBits);
         }
         if (configParallelTrain.Exists(L"BlockMomentumSGD"))
         {
@@ -3030,13 +4884,16 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
         if (configParallelTrain.Exists(L"DataParallelASGD"))
         {
-#ifndef ASGD_PARALLEL_SUPPORT
-            InvalidArgument("DataParallelASGD is not enabled in this version.\n");
-#else
             const ConfigRecordType & configDataParallelASGD(configParallelTrain(L"DataParallelASGD", ConfigRecordType::Record()));
             m_nSyncSamplesPerWorker = configDataParallelASGD(L"syncPeriod", ConfigRecordType::Array(intargvector(vector<int>{256})));
             m_isAsyncBufferEnabled = configDataParallelASGD(L"UsePipeline", false);
             m_isSimulateMA = configDataParallelASGD(L"SimModelAverage", false); // using parameter server-based version of ModelAveragingSGD
+#ifdef ASGD_PARALLEL_SUPPORT
+            m_useMPIParameterServer = configDataParallelASGD(L"UseMPIParameterServer", false);
+#else
+            m_useMPIParameterServer = true; // Multiverso is not built in
+#endif
+            m_adjustLearningRateAtBeginning = AdjustLearningRateAtBeginning::None;
             if (configDataParallelASGD.Exists(L"AdjustLearningRateAtBeginning")) // adjust learning rate per m_adjustNumInBatch minibatchs until to original one,
                                                                                  // this option could be used to takcle the unstableness of DataParallelASGD if you get a chance
             {
@@ -3045,7 +4902,6 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 m_adjustCoefficient = configAdjustLearningRateAtBeginning(L"adjustCoefficient", (double)0.1);
                 m_adjustPerMinibatches = configAdjustLearningRateAtBeginning(L"adjustPerMinibatches", (size_t)256);
             }
-#endif
         }
         } // if (!pMPI)
     } // if (configSGD.Exists(L"ParallelTrain"))
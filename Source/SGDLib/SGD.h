@@ -17,14 +17,20 @@
 #include "Config.h"
 #include <chrono>
 #include <random>
+#include <future>
+#include <mutex>
 #include "Profiler.h"
 #include "MASGD.h"
 #include "ASGDHelper.h"
+#include "LossScaling.h"
+#include "FlatParameterBuffer.h"
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
 #define CNTK_CHECKPOINT_VERSION_1 1     // 1 -> no version number 
 #define CNTK_CHECKPOINT_VERSION_2 2      
-#define CURRENT_CNTK_CHECKPOINT_VERSION CNTK_CHECKPOINT_VERSION_2
+#define CNTK_CHECKPOINT_VERSION_3 3     // 3 -> optional sharding of the smoothed gradients (BShards)
+#define CNTK_CHECKPOINT_VERSION_4 4     // 4 -> optional moving averages of the parameters (BEma)
+#define CURRENT_CNTK_CHECKPOINT_VERSION CNTK_CHECKPOINT_VERSION_4
 
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -47,7 +53,10 @@ enum class GradientsUpdateType : int
     None,
     AdaGrad,
     RmsProp,
-    FSAdaGrad
+    FSAdaGrad,
+    Adam,
+    Lars, // momentum SGD with layer-wise trust ratios, for large minibatches
+    Lamb  // Adam with layer-wise trust ratios, for large minibatches
 };
 
 // modelParallelSGD can be combined with dataParallelSGD/modelAveragingSGD/blockMomentumSGD 
@@ -61,7 +70,7 @@ enum class ParallelizationMethod : int
     modelAveragingSGD = 2,
     blockMomentumSGD = 3,
     dataParallelASGD = 4,
-    modelParallelSGD = (1 << 8) // Currently unsupported
+    modelParallelSGD = (1 << 8) // Currently unsupported across workers; within one process, see SGD::m_modelParallelDevices
 };
 
 // configuration parameters associated with RMSProp learning algorithm
@@ -91,6 +100,13 @@ struct GradientUpdateInfo
     // for FSAdaGrad:
     double targetAdagradAvDenom = 1;
     size_t varianceTimeConstant = 2 * 3600 * 100; // originally was: 2h of speech
+
+    // for Adam and Lamb (which also use varianceTimeConstant):
+    double adamEpsilon = 1e-8;
+    double weightDecay = 0; // decoupled weight decay per sample (AdamW), applied as learning rate * weightDecay
+
+    // for Lars:
+    double larsCoefficient = 0.001; // trust coefficient, see GetLarsTrustRatio()
 };
 
 // ---------------------------------------------------------------------------
@@ -196,6 +212,31 @@ protected:
 
     bool m_gradientClippingWithTruncation;
     double m_clippingThresholdPerSample;
+    // clip the norm of all gradients together instead of the norm of each gradient (without truncation)
+    bool m_gradientClippingByGlobalNorm;
+
+    // update all dense parameters together with one or two multi-tensor passes, see Matrix::MultiTensorUpdate()
+    bool m_fusedParameterUpdate;
+
+    // check the criterion and the gradients for NaN/Inf on the device, reading the result every this many minibatches; 0 for no checks
+    size_t m_nonFiniteCheckFrequency;
+
+    // keep the values, gradients and smoothed gradients of the dense parameters in one buffer each, see FlatParameterBuffer
+    bool m_flatParameterBuffer;
+
+    // with block-sparse gradients (e.g. of embeddings of sparse input), momentum SGD and FSAdaGrad update only the columns
+    // present in the gradient and catch up on the skipped updates on their next touch, see Matrix::LazyNormalGrad()
+    bool m_lazySparseUpdate;
+
+    // keep an exponential moving average of each parameter (Polyak averaging), updated after every update with this decay; 0 for none.
+    // Validation uses the averages, and each epoch's model is also saved with them as <model>.ema.
+    double m_emaDecay;
+
+    // mixed precision: GEMMs with half precision inputs on the GPU and (dynamic) loss scaling, see LossScaling.h
+    bool m_mixedPrecisionGemm;
+    double m_lossScale;
+    bool m_dynamicLossScaling;
+    size_t m_lossScaleWindow;
 
     intargvector m_numSamples4Search;
     size_t m_numBestSearchEpoch;
@@ -223,6 +264,13 @@ protected:
     size_t m_minibatchSearchCriterionErrorMargin;
     size_t m_minibatchSizeTuningFrequency;
     size_t m_minibatchSizeTuningMax;
+    // pick the minibatch size of the highest throughput (samples per second) among those whose criterion is within the
+    // margin, and stop growing it before the shared matrix pool would exceed the free device memory less a reserve
+    bool m_minibatchSearchByThroughput;
+    double m_minibatchSearchMemoryReserve; // fraction of the free device memory that the search leaves unused
+    // with parallel training, try the candidates of the learning rate and minibatch size searches concurrently, one per
+    // worker, each training locally on the same samples from the same model, instead of one after another on all workers
+    bool m_parallelSearch;
 
     doubleargvector m_dropoutRates;
     doubleargvector m_batchNormalizationTimeConstant;
@@ -241,13 +289,27 @@ protected:
     size_t m_numMBsToShowResult = 0;
     size_t m_firstMBsToShowResult = 0;
     int m_numMBsToCUDAProfile;
+    size_t m_numMBsToTimelineProfile; // > 0: record a timeline (TimelineProfiler) of this many minibatches into m_timelineProfileFile
+    std::wstring m_timelineProfileFile;
+    std::wstring m_performanceCountersFile; // non-empty: write the PerformanceCounters to this JSON file, suffixed by ".rank<N>" in parallel training
+    double m_performanceCountersInterval;   // seconds between writes of m_performanceCountersFile
+    size_t m_nodeTimingInterval;            // > 0: time forward and backward of each node in every N-th minibatch, and print a roofline profile per epoch
+    std::wstring m_memoryTimelineFile;      // non-empty: write a MemoryTimeline of one minibatch to this CSV file, suffixed by ".rank<N>" in parallel training
+    size_t m_memoryTimelineMinibatch;       // the minibatch of the first epoch that is recorded
+    size_t m_memoryTimelineTopN;            // nodes listed in the report of the MemoryTimeline
+    bool m_isMemoryTimelineRecorded = false;
 
     bool m_doGradientCheck;
     double m_gradientCheckSigDigit;
+    size_t m_gradientCheckNumSamples;    // elements checked per parameter, spread over the parallel workers
+    size_t m_gradientCheckNumCalls = 0; // (seeds the sampling of the elements)
 
     bool m_doUnitTest;
 
     bool m_useAllDataForPreComputedNode;
+    bool m_distributedPreCompute;     // data-parallel workers each read a share of the data for pre-computation and merge their statistics
+    size_t m_preComputeMaxSamples;    // stop pre-computation after this many samples (over all workers)
+    std::wstring m_preComputeCacheDir; // if not empty: reuse the statistics of Mean/InvStdDev nodes cached there by earlier runs on the same data
 
     int m_perfTraceLevel;
 
@@ -271,13 +333,21 @@ protected:
     // n > 1: Show stats after every n sync
     int m_syncStatsTrace;
 
+    // elastic training: when a worker dies, the others continue among themselves from the model in memory, instead of the
+    // job failing (requires an MPI with the ULFM fault-tolerance extensions)
+    bool m_elasticTraining;
+
     // Data parallel SGD training parameters
     intargvector m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
+    size_t m_gradientBucketSizeInMB; // > 0: reduce the gradients in buckets of this size, overlapped with backprop (FP aggregation only)
+    double m_gradientDensity;        // < 1: send only this fraction of the gradient entries, those of largest magnitude (top-k sparsification)
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
+    bool   m_overlapModelAggregation; // model averaging: all-reduce the models in the background while training the next block
+    int    m_numModelBits;            // model averaging: < 8 * sizeof(ElemType): exchange the model changes quantized to this many bits
     bool   m_resetSGDMomentum; 
     bool   m_useNesterovBlockMomentum;
     double m_blockLearningRate; 
@@ -291,6 +361,7 @@ protected:
     intargvector m_nSyncSamplesPerWorker;
     bool m_isAsyncBufferEnabled;
     bool m_isSimulateMA;
+    bool m_useMPIParameterServer; // the built-in parameter server (MPI one-sided communication) rather than Multiverso
     AdjustLearningRateAtBeginning m_adjustLearningRateAtBeginning;
     double m_adjustCoefficient;
     size_t m_adjustPerMinibatches;
@@ -304,6 +375,7 @@ protected:
     double m_seqGammarCalcWP;
     double m_seqGammarCalcbMMIFactor;
     bool m_seqGammarCalcUsesMBR;
+    size_t m_seqLatticeCacheMB;
     
     // decide whether should apply regularization into BatchNormalizationNode
     // true: disable Regularization
@@ -335,13 +407,33 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_asyncCheckPoint(configSGD(L"asyncCheckPoint", false)),
+          m_checkPointStagingDir((const wstring&) configSGD(L"checkPointStagingDir", L"")),
+          m_shardedCheckPoint(configSGD(L"shardedCheckPoint", false)),
+          m_asyncCrossValidation(configSGD(L"asyncCrossValidation", false)),
+          m_asyncCrossValidationDevice(configSGD(L"asyncCrossValidationDevice", (int) CPUDEVICE)),
+          m_pendingCrossValidationEpoch(-1),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_traceNodeNamesReal    (configSGD(L"traceNodeNamesReal",     ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesCategory(configSGD(L"traceNodeNamesCategory", ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesSparse  (configSGD(L"traceNodeNamesSparse",   ConfigRecordType::Array(stringargvector()))),
+          m_recomputeActivations(configSGD(L"recomputeActivations", false)),
+          m_recomputationCheckpoints(configSGD(L"recomputationCheckpoints", ConfigRecordType::Array(stringargvector()))),
+          m_offloadActivations(configSGD(L"offloadActivations", false)),
+          m_fuseBatchNormRelu(configSGD(L"fuseBatchNormRelu", false)),
+          m_syncBatchNormalization(configSGD(L"syncBatchNormalization", false)),
+          m_vocabularyParallel(configSGD(L"vocabularyParallel", false)),
+          m_modelParallelDevices(configSGD(L"modelParallelDevices", ConfigRecordType::Array(intargvector()))),
+          m_nodeDevices(configSGD(L"nodeDevices", ConfigRecordType::Array(stringargvector()))),
+          m_pipelineMicroBatches(configSGD(L"pipelineMicroBatches", (size_t) 0)),
+          m_staticMemoryPlanMaxColumns(configSGD(L"staticMemoryPlanMaxColumns", (size_t) 0)),
+          m_packedSequenceExecution(configSGD(L"packedSequenceExecution", false)),
+          m_hogwildThreads(configSGD(L"hogwildThreads", (size_t) 0)),
           m_prevChosenMinibatchSize(0),
+          m_trainLocally(false),
           m_lastFinishedEpochTrainLoss(0.0),
+          m_lazyUpdateCount(0),
           m_distGradAgg(nullptr),
           m_gradHeader(nullptr)
     {
@@ -363,6 +455,12 @@ public:
             m_parallelizationMethod = ParallelizationMethod::none;
         }
 
+    // describes the configuration of the training reader, as part of the key of the pre-computation cache
+    void SetReaderConfigDescription(const std::wstring& description)
+    {
+        m_readerConfigDescription = description;
+    }
+
     void Train(shared_ptr<ComputationNetwork> net, DEVICEID_TYPE deviceId,
                IDataReader* trainSetDataReader,
                IDataReader* validationSetDataReader, int startEpoch, bool loadNetworkFromCheckpoint);
@@ -391,6 +489,11 @@ protected:
                     const std::vector<ComputationNodeBasePtr>& featureNodes,
                     const std::vector<ComputationNodeBasePtr>& labelNodes,
                     StreamMinibatchInputs* inputMatrices);
+    uint64_t PreComputeCacheKey(ComputationNetworkPtr net, IDataReader* trainSetDataReader, const std::list<ComputationNodeBasePtr>& nodes,
+                                const std::vector<ComputationNodeBasePtr>& featureNodes, const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                StreamMinibatchInputs* inputMatrices, size_t requestedSamples);
+    bool LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const std::wstring& cachePath);
+    void SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const std::wstring& cachePath);
 
     // return a reasonable initial learning rate based on the initial mbsize
     double SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -424,7 +527,26 @@ protected:
                                          /*out*/ EpochCriterion& epochCriterion,
                                          /*out*/ std::vector<EpochCriterion>& epochEvalErrors,
                                          std::string prefixMsg,
-                                         const size_t maxNumOfSamples);
+                                         const size_t maxNumOfSamples,
+                                         /*out*/ double* trainingSeconds = nullptr);
+
+    // Parallel search: each worker trains the mini-epoch of its own candidate locally (a worker without a candidate passes
+    // minibatchSize 0 and only waits); returns the criteria of all workers in rank order.
+    std::vector<EpochCriterion> TrainOneMiniEpochPerWorker(ComputationNetworkPtr net,
+                                                           ComputationNetworkPtr refNet,
+                                                           const ComputationNodeBasePtr& refNode, const int epochNumber,
+                                                           IDataReader* trainSetDataReader,
+                                                           const double learnRatePerSample,
+                                                           const size_t minibatchSize,
+                                                           const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                                           const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                                           const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                                           const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                                           StreamMinibatchInputs* inputMatrices,
+                                                           const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                                           std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double> smoothedCounts,
+                                                           std::string prefixMsg,
+                                                           const size_t maxNumOfSamples);
 
     size_t AdaptiveMinibatchSizing(ComputationNetworkPtr net,
                                    ComputationNetworkPtr refNet,
@@ -491,17 +613,109 @@ protected:
                          const std::string& prefixMsg = "",
                          const size_t maxNumberOfSamples = SIZE_MAX);
 
+    // Hogwild training (m_hogwildThreads): one epoch on all the workers at the same time, without any synchronization of their
+    // parameter updates. Returns the number of samples trained on, as TrainOneEpoch().
+    size_t TrainOneEpochHogwild(ComputationNetworkPtr net,
+                                const int epochNumber,
+                                const size_t epochSize,
+                                IDataReader* trainSetDataReader,
+                                const double learnRatePerSample,
+                                size_t tunedMBSize,
+                                const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                StreamMinibatchInputs* inputMatrices,
+                                const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                                /*out*/ EpochCriterion& epochCriterion,
+                                /*out*/ std::vector<EpochCriterion>& epochEvalErrors);
+
+    // a Hogwild worker: its network, whose parameters share the values of the trained network's, and its own optimizer state
+    struct HogwildWorker
+    {
+        ComputationNetworkPtr net;
+        StreamMinibatchInputs inputMatrices;
+        std::vector<ComputationNodeBasePtr> criterionNodes;
+        std::vector<ComputationNodeBasePtr> evaluationNodes;
+        std::list<ComputationNodeBasePtr> learnableNodes;
+        std::list<Matrix<ElemType>> smoothedGradients;
+        std::vector<double> smoothedCounts;
+    };
+
+    // creates the workers other than the trained network itself (m_hogwildWorkers), from a copy of its model
+    void CreateHogwildWorkers(ComputationNetworkPtr net,
+                              const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                              const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                              const std::list<ComputationNodeBasePtr>& learnableNodes,
+                              const std::list<Matrix<ElemType>>& smoothedGradients, const std::vector<double>& smoothedCounts);
+
+    // trains on minibatches from the reader, which is shared under 'readerMutex', until it runs out; returns the number of samples
+    size_t TrainHogwildWorker(HogwildWorker& worker, IDataReader* trainSetDataReader, std::mutex& readerMutex,
+                              const int epochNumber, const double learnRatePerSample,
+                              /*out*/ EpochCriterion& epochCriterion,
+                              /*out*/ std::vector<EpochCriterion>& epochEvalErrors);
+
+    // forward and backprop of a minibatch in the dispatcher's cache as micro-batches through the pipeline stages of the network
+    void ForwardBackwardPipelined(ComputationNetworkPtr net, const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                  const std::vector<ComputationNodeBasePtr>& featureNodes, const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                  DataReaderHelpers::SubminibatchDispatcher<ElemType>& smbDispatcher, size_t numMicroBatches);
+
     void InitDistGradAgg(int numEvalNodes, int numGradientBits, int deviceId, int traceLevel);
     void InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE devID);
+    void RecoverFromWorkerFailure(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, int epochNumber, size_t numEvalNodes,
+                                  const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients,
+                                  vector<double>& smoothedCounts, const char* reason);
+
+    // Divides the gradients by the loss scale. Returns false if the minibatch is to be skipped because of non-finite gradients.
+    bool UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes);
+
+    // m_nonFiniteFlag on the device, set to 0
+    Matrix<ElemType>& ResetNonFiniteFlag(DEVICEID_TYPE deviceId);
+
+    // device-side NaN/Inf check of a minibatch with m_nonFiniteCheckFrequency; fails with the node that produced them if the minibatch can be rerun
+    void CheckNonFiniteValues(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                              const std::vector<ComputationNodeBasePtr>& featureNodes, const std::vector<ComputationNodeBasePtr>& labelNodes,
+                              const std::list<ComputationNodeBasePtr>& learnableNodes, bool hasGradients, size_t numMBsRun, bool canRerun);
+
+    // factor by which all gradients are scaled to clip their global norm (m_gradientClippingByGlobalNorm), 1 if they are not clipped
+    double GetGlobalNormClippingFactor(const std::list<ComputationNodeBasePtr>& learnableNodes, size_t actualMBSize) const;
+
+    // number of vectors of the size of a parameter that its smoothed gradient holds with the update rule in use
+    size_t SmoothedGradientStateSize() const;
+
+    // fused update of the dense parameters with m_fusedParameterUpdate; returns which of the learnable nodes were updated
+    std::vector<bool> UpdateWeightsFused(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                         std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                                         const double learnRatePerSample, const double momentumPerSample,
+                                         size_t actualMBSize, const double gradientScale) const;
+
+    // state of the lazy sparse updates (m_lazySparseUpdate) of one parameter
+    struct LazyUpdateState
+    {
+        std::vector<size_t> lastUpdates; // per column, the update count (m_lazyUpdateCount) of its last update
+        double learnRatePerSample = 0;   // the rates of the most recent update, with which CatchUpLazyUpdates() catches up
+        double momentum = 0;
+        double varMomentum = 0;
+    };
+
+    // brings the parameters updated lazily up to date, so that they can be saved or evaluated
+    void CatchUpLazyUpdates(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients);
+
+    // moving averages of the parameters (m_emaDecay): (re-)initialized to the current values, updated after UpdateWeights(),
+    // and exchanged with the values, e.g. for validation, by swapping the value matrices
+    void InitEmaValues(const std::list<ComputationNodeBasePtr>& learnableNodes);
+    void UpdateEmaValue(const ComputationNodeBasePtr& node) const;
+    void SwapEmaValues();
 public:
     // UpdateWeights() - actual weight update, implementing various update rules
+    // lazyUpdateState is given for parameters updated lazily (m_lazySparseUpdate).
     void UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemType>& gradientValues,
                        Matrix<ElemType>& smoothedGradient, double& smoothedCount,
                        const double learnRatePerSample, const double momentumPerSample,
                        size_t actualMBSize,
                        const double L2RegWeight, const double L1RegWeight,
                        const bool needAveMultiplier,
-                       const bool useNesterovMomentum) const;
+                       const bool useNesterovMomentum,
+                       LazyUpdateState* lazyUpdateState = nullptr) const;
     // return -1 if nothing exists
     int DetermineStartEpoch(const bool makeMode);
 
@@ -515,7 +729,8 @@ protected:
                             const std::list<Matrix<ElemType>>& smoothedGradients,
                             const std::vector<double>& smoothedCounts,
                             const double prevCriterion,
-                            const size_t minibatchSize);
+                            const size_t minibatchSize,
+                            const std::string& readerState = std::string());
 
     bool TryLoadCheckPointInfo(const size_t epochNumber,
                                /*out*/ size_t& totalSamplesSeen,
@@ -533,6 +748,33 @@ protected:
                             /*out*/ size_t& minibatchSize);
 
     wstring GetCheckPointFileNameForEpoch(const int epoch);
+    wstring GetCheckPointShardFileName(const int epoch, const size_t shard);
+    void DeleteCheckPointFiles(const int epoch);
+
+    // Checkpoint writing. With asyncCheckPoint, the smoothed gradients are copied to CPU memory and written on a
+    // background thread while training continues, and with checkPointStagingDir the model is saved to that (fast,
+    // local) directory and moved to its destination in the background. With shardedCheckPoint in data-parallel
+    // training, where all workers hold the same smoothed gradients, each worker writes a share of them to its own file.
+    void SaveModel(ComputationNetworkPtr net, const wstring& modelName);
+    void SaveCheckPointShard(const size_t epoch, const std::list<Matrix<ElemType>>& smoothedGradients);
+    void WaitForCheckPointWrites();
+    size_t NumCheckPointShards() const;
+    std::vector<std::shared_ptr<const Matrix<ElemType>>> CheckPointGradients(const std::list<Matrix<ElemType>>& smoothedGradients, const size_t shard) const;
+    std::vector<std::pair<std::wstring, std::shared_ptr<const Matrix<ElemType>>>> CheckPointEmaValues() const;
+    void WriteCheckPoint(const std::function<void()>& write);
+
+    // Concurrent cross validation. With asyncCrossValidation, the model of an epoch is saved to a snapshot file, which a
+    // replica of the network on asyncCrossValidationDevice (the CPU by default, or a GPU other than the training one)
+    // evaluates on the CV set on a background thread while the next epoch trains. The result is collected at the end of
+    // the next epoch, so that the learning-rate control by the CV set (UseCVSetControlLRIfCVExists) is one epoch late.
+    void StartCrossValidation(ComputationNetworkPtr net, const int epochNumber, IDataReader* validationSetDataReader,
+                              const std::vector<std::wstring>& cvSetTrainAndEvalNodes, const size_t mbSize);
+    // waits for the pending cross validation, if any; returns its epoch and scores, or -1
+    int FinishCrossValidation(/*out*/ std::vector<EpochCriterion>& vScore);
+    // drops the pending cross validation, e.g. of a model that was rolled back
+    void DiscardCrossValidation();
+    std::wstring GetCrossValidationSnapshotPath() const;
+    void LogValidationScores(const int epochNumber, const std::vector<std::wstring>& cvSetTrainAndEvalNodes, const std::vector<EpochCriterion>& vScore) const;
 
     GradientsUpdateType GradUpdateType() const
     {
@@ -554,6 +796,16 @@ public:
 protected:
     std::wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    bool m_asyncCheckPoint;
+    std::wstring m_checkPointStagingDir;
+    bool m_shardedCheckPoint;
+    std::vector<std::future<void>> m_pendingCheckPointWrites;
+
+    bool m_asyncCrossValidation;
+    DEVICEID_TYPE m_asyncCrossValidationDevice;
+    ComputationNetworkPtr m_crossValidationReplica; // created by the first cross validation, only used on its thread
+    int m_pendingCrossValidationEpoch;
+    std::future<std::vector<EpochCriterion>> m_pendingCrossValidation;
 
     std::wstring m_trainCriterionNodeName;
     std::wstring m_evalCriterionNodeName;
@@ -563,33 +815,96 @@ protected:
     std::vector<std::wstring> m_traceNodeNamesCategory;
     std::vector<std::wstring> m_traceNodeNamesSparse;
 
+    // gradient checkpointing: recompute activations during backprop, in segments that end at the given nodes (default: sqrt(N) segments)
+    bool m_recomputeActivations;
+    std::vector<std::wstring> m_recomputationCheckpoints;
+
+    // keep activations in pinned host memory between forward prop and backprop (GPU only)
+    bool m_offloadActivations;
+
+    // merge ReLUs into the BatchNormalization nodes that feed them (see ComputationNetwork::FuseBatchNormalizationAndRelu())
+    bool m_fuseBatchNormRelu;
+
+    // under data-parallel training, normalize with the batch statistics of the minibatches of all workers (per-channel sums
+    // and sums of squares all-reduced with NCCL). Every worker must then process every minibatch, see BatchNormEngine::SetCommunicator().
+    bool m_syncBatchNormalization;
+
+    // under data-parallel training, shard the weights of the ShardedSoftmaxWithCrossEntropy and ShardedEmbedding nodes by words
+    // across the workers, which exchange the columns of their minibatches with NCCL (see VocabularyShard). As with
+    // m_syncBatchNormalization, every worker must process every minibatch.
+    bool m_vocabularyParallel;
+
+    // model parallelism within one process: the devices over which the nodes are distributed (none: all on the device of the network),
+    // and nodes pinned to one of them, as "nodeName=deviceId" (see ComputationNetwork::PlaceNodesOnDevices())
+    intargvector m_modelParallelDevices;
+    std::vector<std::wstring> m_nodeDevices;
+
+    // pipeline parallelism: train each minibatch as this many micro-batches (cut like sub-minibatches) that flow through the
+    // stages of the network on the model-parallel devices at the same time (0, 1: not pipelined, see ComputationNetwork::FormPipelineStages())
+    size_t m_pipelineMicroBatches;
+
+    // place node values and gradients by a static memory plan for minibatches of up to this many columns (0: share them greedily)
+    size_t m_staticMemoryPlanMaxColumns;
+
+    // compute products of minibatch data on the valid columns only, skipping the gaps of variable-length sequences
+    bool m_packedSequenceExecution;
+
+    // Hogwild training on the CPU with this many threads (0, 1: none). Each thread trains a replica of the network with activations
+    // and gradients of its own on minibatches from the shared reader, and updates the parameter values, which all replicas share,
+    // without locking. The trained network is the replica of the first thread; the others are m_hogwildWorkers.
+    size_t m_hogwildThreads;
+    std::vector<std::shared_ptr<HogwildWorker>> m_hogwildWorkers;
+
     size_t m_prevChosenMinibatchSize;
+    std::wstring m_readerConfigDescription;
+    bool m_trainLocally; // (set while the workers train candidates of a parallel search, which turns off the parallel training)
     double m_lastFinishedEpochTrainLoss;
 
+    // number of parameter updates so far, and the state of the parameters updated lazily (m_lazySparseUpdate)
+    size_t m_lazyUpdateCount;
+    std::map<ComputationNodeBasePtr, LazyUpdateState> m_lazyUpdateStates;
+
+    // moving averages of the parameters (m_emaDecay), allocated on the device of the values
+    std::map<ComputationNodeBasePtr, std::shared_ptr<Matrix<ElemType>>> m_emaValues;
+    // with m_flatParameterBuffer, the buffer that holds the moving averages of the parameters in m_flatParameters
+    std::shared_ptr<Matrix<ElemType>> m_flatEmaValues;
+
+    // with m_flatParameterBuffer, the dense parameters of the model being trained
+    std::shared_ptr<FlatParameterBuffer<ElemType>> m_flatParameters;
+
+    // with m_vocabularyParallel, the parameters that each worker holds a shard of, with complete gradients that are not aggregated
+    std::set<ComputationNodeBasePtr> m_vocabularyShardedParameters;
+
+    // state of the training reader at the end of the epoch of the last loaded checkpoint, empty if not saved
+    std::string m_checkPointReaderState;
+
     std::shared_ptr<IDistGradAggregator<ElemType>> m_distGradAgg;
     std::shared_ptr<struct DistGradHeader> m_gradHeader;
 
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
 
+    LossScaling m_lossScaling;
+    shared_ptr<Matrix<ElemType>> m_nonFiniteFlag; // see ResetNonFiniteFlag()
+
 private:
     void MarkDropoutNodesEvalTimeStampAsOutdated(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode);
     std::shared_ptr<ASGDHelper<ElemType>> m_pASGDHelper;
 
     bool UsingGradientAggregation(size_t epochNumber) const
     {
-        return ((GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD) && (epochNumber >= m_parallelizationStartEpochNum));
+        return ((GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD) && (epochNumber >= m_parallelizationStartEpochNum) && !m_trainLocally);
     }
 
     bool UsingModelAggregation(size_t epochNumber) const
     {
         return ((GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD ||
                  GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD) &&
-                (epochNumber >= m_parallelizationStartEpochNum));
+                (epochNumber >= m_parallelizationStartEpochNum) && !m_trainLocally);
     }
 
     bool UsingAsyncGradientAggregation(size_t epochNumber)
     {
-        return ((GetParallelizationMethod() == ParallelizationMethod::dataParallelASGD) && (epochNumber >= m_parallelizationStartEpochNum));
+        return ((GetParallelizationMethod() == ParallelizationMethod::dataParallelASGD) && (epochNumber >= m_parallelizationStartEpochNum) && !m_trainLocally);
     }
 
     bool UsingParallelTrain(size_t epochNumber)
@@ -597,6 +912,12 @@ private:
         return UsingGradientAggregation(epochNumber) || UsingModelAggregation(epochNumber) || UsingAsyncGradientAggregation(epochNumber);
     }
 
+    bool UsingParallelSearch(size_t epochNumber)
+    {
+        return m_parallelSearch && UsingParallelTrain(epochNumber) && m_mpi->NumNodesInUse() > 1 &&
+               GetParallelizationMethod() != ParallelizationMethod::dataParallelASGD;
+    }
+
     void SynchronizeWorkers()
     {
         if (m_mpi != nullptr && GetParallelizationMethod() != ParallelizationMethod::dataParallelASGD)
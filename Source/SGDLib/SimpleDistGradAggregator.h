@@ -13,6 +13,10 @@
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
 #include "MatrixQuantizerImpl.h"
+#include "Profiler.h"
+#include "PerformanceCounters.h"
+#include <climits>
+#include <cstdint>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -22,8 +26,11 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_nccl(deviceId, mpi)
+    // With bucketSizeInBytes > 0 (and synchronous aggregation), the gradients are reduced in buckets of about that size,
+    // which may start during backprop (see BeginOverlappedAggregation()).
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t bucketSizeInBytes = 0)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_nccl(deviceId, mpi),
+          m_bucketSizeInBytes(useAsyncAggregation ? 0 : bucketSizeInBytes), m_numBucketsStarted(0), m_numBucketsReducing(0)
     {}
 
     ~SimpleDistGradAggregator()
@@ -123,6 +130,21 @@ public:
         }
     }
 
+    bool BeginOverlappedAggregation(const std::vector<Matrix<ElemType>*>& gradients) override
+    {
+        // the buckets are formed by the first aggregation, which hence cannot overlap
+        return !m_buckets.empty() && DenseGradients(gradients) == m_bucketedGradients;
+    }
+
+    void OnGradientComplete(const Matrix<ElemType>* gradient) override
+    {
+        auto iter = m_bucketOfGradient.find(gradient);
+        if (iter == m_bucketOfGradient.end())
+            return;
+        m_buckets[iter->second].m_numComplete++;
+        ProgressBucketReductions(/*flush=*/false);
+    }
+
 private:
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
@@ -149,11 +171,17 @@ private:
 
             for (size_t i = 0; i < gradients.size(); i++)
             {
-                // Make sure none of the gradient matrixes are sparse - we currently do not support aggregation of sparse gradient matrices
-                if (gradients[i]->GetMatrixType() != DENSE)
-                    RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+                // Of the sparse gradient matrices, only block-sparse ones are supported, which are aggregated separately
+                if (IsBlockSparse(*gradients[i]))
+                {
+                    if (m_useAsyncAggregation)
+                        RuntimeError("Asynchronous aggregation of sparse gradient matrices is currently unsupported!");
+                    continue;
+                }
+                else if (gradients[i]->GetMatrixType() != DENSE)
+                    RuntimeError("Gradient aggregation for sparse gradient matrices is currently only supported in SparseBlockCol format!");
 
-                if (!m_nccl.IsSupported() && deviceId != CPUDEVICE)
+                if (!m_nccl.IsSupported() && deviceId != CPUDEVICE && m_bucketSizeInBytes == 0)
                 {
                     m_gpuDataTransferers.push_back(std::make_unique<GPUDataTransferer>(deviceId, m_useAsyncAggregation));
                     m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
@@ -169,6 +197,9 @@ private:
                 m_bufferedGradHeader->Clear();
             }
 
+            if (m_bucketSizeInBytes > 0 && !DenseGradients(gradients).empty())
+                FormBuckets(DenseGradients(gradients));
+
             if (m_mpi->IsMainNode())
             {
                 for (size_t i = 0; i < NumProc() - 1; ++i)
@@ -192,10 +223,26 @@ private:
         }
     }
 
-    void AggregateGradientsImpl(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
+    static bool IsBlockSparse(const Matrix<ElemType>& gradient)
+    {
+        return gradient.GetMatrixType() == SPARSE && gradient.GetFormat() == matrixFormatSparseBlockCol;
+    }
+
+    static std::vector<Matrix<ElemType>*> DenseGradients(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        std::vector<Matrix<ElemType>*> denseGradients;
+        for (auto gradient : gradients)
+        {
+            if (!IsBlockSparse(*gradient))
+                denseGradients.push_back(gradient);
+        }
+        return denseGradients;
+    }
+
+    void AggregateGradientsImpl(const std::vector<Matrix<ElemType>*>& allGradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
     {
         Timer aggregationTimer;
-        int deviceId = gradients[0]->GetDeviceId();
+        int deviceId = allGradients[0]->GetDeviceId();
         if (showSyncPerfStats)
         {
             std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
@@ -203,7 +250,11 @@ private:
             aggregationTimer.Start();
         }
 
+        // the block-sparse gradients are exchanged separately, see AggregateBlockSparseGradients()
+        std::vector<Matrix<ElemType>*> gradients = DenseGradients(allGradients);
         size_t numGradMatrices = gradients.size();
+        if (m_buckets.empty() && !m_nccl.IsSupported() && deviceId >= 0 && m_gpuDataTransferers.size() != numGradMatrices)
+            LogicError("SimpleDistGradAggregator: The gradients to aggregate have changed.");
 
         if (headerCPU->numSamples == 0)
         {
@@ -213,8 +264,8 @@ private:
                 assert(headerCPU->evalErrors[i].first == 0 && headerCPU->evalErrors[i].second == 0);
 
             // If the current node did not process any samples, the gradients should be zero'd
-            for (size_t i = 0; i < numGradMatrices; ++i)
-                gradients[i]->SetValue(0);
+            for (size_t i = 0; i < allGradients.size(); ++i)
+                allGradients[i]->SetValue(0);
 
             if (m_useAsyncAggregation)
             {
@@ -223,8 +274,16 @@ private:
             }
         }
 
+        // Start the reductions of all buckets that backprop has not started
+        if (!m_buckets.empty())
+        {
+            if (gradients != m_bucketedGradients)
+                LogicError("SimpleDistGradAggregator: The gradients to aggregate have changed.");
+            assert(headerCPU->numSamples != 0 || m_numBucketsStarted == 0); // (no backprop without samples)
+            ProgressBucketReductions(/*flush=*/true);
+        }
         // Initiate transfer of the gradient matrices to the CPU if needed
-        if (!m_nccl.IsSupported() && deviceId >= 0)
+        else if (!m_nccl.IsSupported() && deviceId >= 0)
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
                 m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->Data(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
@@ -249,7 +308,10 @@ private:
 
         // Perform async allreduce on the gradient data
         std::vector<MPI_Request> allReduceRequests(numGradMatrices);
-        if (!m_nccl.IsSupported())
+        std::vector<size_t> allReduceTimelineSpans(numGradMatrices, TimelineProfiler::NoSpan);
+        if (!m_buckets.empty())
+            ; // the buckets are being reduced already
+        else if (!m_nccl.IsSupported())
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
             {
@@ -261,13 +323,22 @@ private:
                 }
 
                 // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
+                allReduceTimelineSpans[i] = TimelineProfiler::Instance().BeginSpan("all-reduce", TimelineProfiler::Track::Communication);
                 MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, gradients[i]->GetNumElements(),
                                MPIWrapper::GetDataType(reductionBuffer), MPI_SUM,
                                m_mpi->Communicator(), &allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
             }
         }
         else
+        {
+            m_nccl.WaitForComputeStream();
+            allReduceTimelineSpans.resize(1);
+            allReduceTimelineSpans[0] = TimelineProfiler::Instance().BeginSpan("all-reduce", TimelineProfiler::Track::Communication);
             m_nccl.AllReduce(gradients);
+        }
+
+        // Exchange the block-sparse gradients while the dense ones are being reduced
+        AggregateBlockSparseGradients(allGradients);
 
         // On the main node wait for the headers to arrive and aggregate
         if (m_mpi->IsMainNode())
@@ -308,11 +379,15 @@ private:
         }
 
         // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
-        if (!m_nccl.IsSupported())
+        if (!m_buckets.empty())
+            FinishBucketReductions();
+        else if (!m_nccl.IsSupported())
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
             {
                 MPI_Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+                TimelineProfiler::Instance().EndSpan(allReduceTimelineSpans[i], gradients[i]->GetNumElements() * sizeof(ElemType));
+                PerformanceCounters::Instance().Add(PerformanceCounters::CommunicationBytes, gradients[i]->GetNumElements() * sizeof(ElemType));
                 if (deviceId >= 0)
                     m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->Data());
             }
@@ -323,8 +398,17 @@ private:
             MPI_Wait(&recvAggHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
 
         // Wait for all the transfers to finish
-        if (m_nccl.IsSupported())
+        if (!m_buckets.empty())
+            ; // done by FinishBucketReductions()
+        else if (m_nccl.IsSupported())
+        {
             m_nccl.Sync();
+            size_t numBytes = 0;
+            for (auto gradient : gradients)
+                numBytes += gradient->GetNumElements() * sizeof(ElemType);
+            TimelineProfiler::Instance().EndSpan(allReduceTimelineSpans[0], numBytes);
+            PerformanceCounters::Instance().Add(PerformanceCounters::CommunicationBytes, numBytes);
+        }
         else if (deviceId >= 0)
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
@@ -345,6 +429,232 @@ private:
         }
     }
 
+    // Block-sparse gradients (matrixFormatSparseBlockCol), e.g. of an embedding applied to sparse input, hold only the
+    // columns that the minibatch touched. They are exchanged as such, with all-gathers of varying size of the column ids
+    // and values, and the columns of all workers are summed into a block-sparse gradient again, which the learners apply
+    // sparsely. This is done on the CPU.
+    void AggregateBlockSparseGradients(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        for (auto gradient : gradients)
+        {
+            if (!IsBlockSparse(*gradient))
+                continue;
+
+            size_t numRows = gradient->GetNumRows();
+            size_t numCols = gradient->GetNumCols();
+            gradient->GetMatrixFromSBCFormat(m_sendBlockIds, m_sendBlockValues);
+
+            // the number of columns of each worker
+            int numBlocks = (int) m_sendBlockIds.size();
+            m_blockCounts.resize(NumProc());
+            m_mpi->AllGather(&numBlocks, 1, m_blockCounts.data(), 1);
+
+            m_blockOffsets.resize(NumProc());
+            m_valueCounts.resize(NumProc());
+            m_valueOffsets.resize(NumProc());
+            size_t numBlocksAll = 0;
+            for (size_t r = 0; r < NumProc(); r++)
+            {
+                if (numBlocksAll * numRows + m_blockCounts[r] * numRows > INT_MAX)
+                    RuntimeError("SimpleDistGradAggregator: The sparse gradients of all workers have more than %d elements.", INT_MAX);
+                m_blockOffsets[r] = (int) numBlocksAll;
+                m_valueCounts[r] = (int) (m_blockCounts[r] * numRows);
+                m_valueOffsets[r] = (int) (numBlocksAll * numRows);
+                numBlocksAll += m_blockCounts[r];
+            }
+
+            m_recvBlockIds.resize(numBlocksAll);
+            m_recvBlockValues.resize(numBlocksAll * numRows);
+            m_mpi->AllGatherv(m_sendBlockIds.data(), m_sendBlockIds.size(), m_recvBlockIds.data(), m_blockCounts.data(), m_blockOffsets.data());
+            m_mpi->AllGatherv(m_sendBlockValues.data(), m_sendBlockValues.size(), m_recvBlockValues.data(), m_valueCounts.data(), m_valueOffsets.data());
+
+            // sum up the columns, each column becomes one block
+            if (m_blockOfColumn.size() < numCols)
+                m_blockOfColumn.resize(numCols, SIZE_MAX);
+            m_sendBlockIds.clear(); // (reused for the result)
+            m_sendBlockValues.clear();
+            for (size_t j = 0; j < numBlocksAll; j++)
+            {
+                size_t col = m_recvBlockIds[j];
+                if (col >= numCols)
+                    LogicError("SimpleDistGradAggregator: Column %d out of range for a gradient of %d columns.", (int) col, (int) numCols);
+                size_t& block = m_blockOfColumn[col];
+                if (block == SIZE_MAX)
+                {
+                    block = m_sendBlockIds.size();
+                    m_sendBlockIds.push_back(col);
+                    m_sendBlockValues.resize(m_sendBlockValues.size() + numRows, 0);
+                }
+                const ElemType* src = m_recvBlockValues.data() + j * numRows;
+                ElemType* dst = m_sendBlockValues.data() + block * numRows;
+                for (size_t i = 0; i < numRows; i++)
+                    dst[i] += src[i];
+            }
+            for (auto col : m_sendBlockIds)
+                m_blockOfColumn[col] = SIZE_MAX;
+
+            gradient->SetMatrixFromSBCFormat(m_sendBlockIds.data(), m_sendBlockValues.data(), m_sendBlockIds.size(), numRows, numCols);
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // Reduction in buckets. The gradients are assigned to buckets of about m_bucketSizeInBytes in reverse order, which is
+    // the order in which backprop completes them, and the gradients of a bucket are packed into one buffer for a single
+    // all-reduce. A bucket can be reduced once all its gradients are complete, but the reductions are started in bucket
+    // order, as all workers must issue the collectives in the same order.
+    // -----------------------------------------------------------------------
+
+    struct GradientBucket
+    {
+        std::vector<size_t> m_gradientIndices;          // into m_bucketedGradients
+        size_t m_numElements;
+        std::unique_ptr<Matrix<ElemType>> m_buffer;     // packed gradients; none if the bucket holds a single gradient
+        std::shared_ptr<ElemType> m_cpuBuffer;          // MPI from a GPU: pinned copy of the buffer
+        std::unique_ptr<GPUDataTransferer> m_transferer; // ditto
+        MPI_Request m_request;
+        size_t m_numComplete;                           // number of gradients that backprop has completed
+        size_t m_timelineSpan;                          // of the all-reduce, see TimelineProfiler
+
+        GradientBucket() : m_numElements(0), m_request(MPI_REQUEST_NULL), m_numComplete(0), m_timelineSpan(TimelineProfiler::NoSpan) {}
+    };
+
+    void FormBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        int deviceId = gradients[0]->GetDeviceId();
+        m_bucketedGradients = gradients;
+        for (size_t k = gradients.size(); k-- > 0;)
+        {
+            if (m_buckets.empty() || m_buckets.back().m_numElements * sizeof(ElemType) >= m_bucketSizeInBytes)
+                m_buckets.emplace_back();
+            m_buckets.back().m_gradientIndices.push_back(k);
+            m_buckets.back().m_numElements += gradients[k]->GetNumElements();
+            m_bucketOfGradient[gradients[k]] = m_buckets.size() - 1;
+        }
+
+        for (auto& bucket : m_buckets)
+        {
+            if (bucket.m_gradientIndices.size() > 1)
+                bucket.m_buffer.reset(new Matrix<ElemType>(1, bucket.m_numElements, deviceId));
+            if (!m_nccl.IsSupported() && deviceId != CPUDEVICE)
+            {
+                bucket.m_cpuBuffer = AllocateIntermediateBuffer(deviceId, bucket.m_numElements);
+                bucket.m_transferer = std::make_unique<GPUDataTransferer>(deviceId, /*useConcurrentStreams=*/true);
+            }
+        }
+    }
+
+    Matrix<ElemType>& BucketMatrix(GradientBucket& bucket)
+    {
+        return bucket.m_buffer ? *bucket.m_buffer : *m_bucketedGradients[bucket.m_gradientIndices[0]];
+    }
+
+    // Starts the reductions of the buckets that are complete, or with 'flush' of all; in bucket order.
+    void ProgressBucketReductions(bool flush)
+    {
+        // pack the bucket and, for MPI from a GPU, initiate its transfer to the CPU
+        while (m_numBucketsStarted < m_buckets.size() &&
+               (flush || m_buckets[m_numBucketsStarted].m_numComplete == m_buckets[m_numBucketsStarted].m_gradientIndices.size()))
+        {
+            auto& bucket = m_buckets[m_numBucketsStarted++];
+            if (bucket.m_buffer)
+            {
+                size_t offset = 0;
+                for (auto k : bucket.m_gradientIndices)
+                {
+                    const auto& gradient = *m_bucketedGradients[k];
+                    bucket.m_buffer->ColumnSlice(offset, gradient.GetNumElements()).SetValue(gradient.Reshaped(1, gradient.GetNumElements()));
+                    offset += gradient.GetNumElements();
+                }
+            }
+            if (bucket.m_transferer)
+            {
+                std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(BucketMatrix(bucket).GetDeviceId()));
+                mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+                bucket.m_transferer->CopyGPUToCPUAsync(BucketMatrix(bucket).Data(), bucket.m_numElements, bucket.m_cpuBuffer.get());
+            }
+        }
+
+        // all-reduce, for MPI from a GPU once the transfer has arrived
+        while (m_numBucketsReducing < m_numBucketsStarted)
+        {
+            auto& bucket = m_buckets[m_numBucketsReducing];
+            if (m_nccl.IsSupported())
+            {
+                m_nccl.WaitForComputeStream();
+                bucket.m_timelineSpan = TimelineProfiler::Instance().BeginSpan("all-reduce bucket", TimelineProfiler::Track::Communication);
+                m_nccl.AllReduce(std::vector<Matrix<ElemType>*>{ &BucketMatrix(bucket) });
+            }
+            else
+            {
+                ElemType* reductionBuffer = BucketMatrix(bucket).Data();
+                if (bucket.m_transferer)
+                {
+                    if (flush)
+                        bucket.m_transferer->WaitForCopyGPUToCPUAsync();
+                    else if (!bucket.m_transferer->IsCopyGPUToCPUAsyncComplete())
+                        break;
+                    reductionBuffer = bucket.m_cpuBuffer.get();
+                }
+                bucket.m_timelineSpan = TimelineProfiler::Instance().BeginSpan("all-reduce bucket", TimelineProfiler::Track::Communication);
+                MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, (int) bucket.m_numElements,
+                               MPIWrapper::GetDataType(reductionBuffer), MPI_SUM,
+                               m_mpi->Communicator(), &bucket.m_request) || MpiFail("MPI_Iallreduce");
+            }
+            m_numBucketsReducing++;
+        }
+    }
+
+    void EndBucketTimelineSpan(GradientBucket& bucket)
+    {
+        TimelineProfiler::Instance().EndSpan(bucket.m_timelineSpan, bucket.m_numElements * sizeof(ElemType));
+        PerformanceCounters::Instance().Add(PerformanceCounters::CommunicationBytes, bucket.m_numElements * sizeof(ElemType));
+        bucket.m_timelineSpan = TimelineProfiler::NoSpan;
+    }
+
+    // Waits for all bucket reductions and unpacks the results into the gradients.
+    void FinishBucketReductions()
+    {
+        assert(m_numBucketsReducing == m_buckets.size());
+        if (m_nccl.IsSupported())
+        {
+            m_nccl.Sync();
+            for (auto& bucket : m_buckets)
+                EndBucketTimelineSpan(bucket);
+        }
+        else
+        {
+            for (auto& bucket : m_buckets)
+            {
+                MPI_Wait(&bucket.m_request, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+                EndBucketTimelineSpan(bucket);
+                if (bucket.m_transferer)
+                    bucket.m_transferer->CopyCPUToGPUAsync(bucket.m_cpuBuffer.get(), bucket.m_numElements, BucketMatrix(bucket).Data());
+            }
+            for (auto& bucket : m_buckets)
+            {
+                if (bucket.m_transferer)
+                    bucket.m_transferer->WaitForCopyCPUToGPUAsync();
+            }
+        }
+
+        for (auto& bucket : m_buckets)
+        {
+            if (bucket.m_buffer)
+            {
+                size_t offset = 0;
+                for (auto k : bucket.m_gradientIndices)
+                {
+                    auto& gradient = *m_bucketedGradients[k];
+                    gradient.Reshaped(1, gradient.GetNumElements()).SetValue(bucket.m_buffer->ColumnSlice(offset, gradient.GetNumElements()));
+                    offset += gradient.GetNumElements();
+                }
+            }
+            bucket.m_numComplete = 0;
+        }
+        m_numBucketsStarted = 0;
+        m_numBucketsReducing = 0;
+    }
+
 private:
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
     std::vector<std::shared_ptr<ElemType>> m_intermediateCPUBuffers;
@@ -371,5 +681,21 @@ private:
     bool m_initialized;
 
     NcclComm m_nccl;
+
+    // reduction in buckets
+    size_t m_bucketSizeInBytes; // 0 if not reducing in buckets
+    std::vector<Matrix<ElemType>*> m_bucketedGradients;
+    std::vector<GradientBucket> m_buckets;
+    std::unordered_map<const Matrix<ElemType>*, size_t> m_bucketOfGradient;
+    size_t m_numBucketsStarted;   // buckets [0, m_numBucketsStarted) are packed, resp. in transfer to the CPU
+    size_t m_numBucketsReducing;  // buckets [0, m_numBucketsReducing) are being all-reduced
+
+    // exchange of block-sparse gradients
+    std::vector<size_t> m_sendBlockIds;
+    std::vector<ElemType> m_sendBlockValues;
+    std::vector<size_t> m_recvBlockIds;
+    std::vector<ElemType> m_recvBlockValues;
+    std::vector<int> m_blockCounts, m_blockOffsets, m_valueCounts, m_valueOffsets; // per worker
+    std::vector<size_t> m_blockOfColumn; // SIZE_MAX for columns not seen yet
 };
 } } }
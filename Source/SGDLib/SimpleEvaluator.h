@@ -93,6 +93,10 @@ public:
 
         bool useParallelTrain = (m_mpi != nullptr);
         bool useDistributedMBReading = useParallelTrain && m_enableDistributedMBReading && dataReader->SupportsDistributedMBRead();
+        // With distributed reading, each worker evaluates its subset of the data on its own, and the results are only
+        // aggregated at the end, so that workers do not wait for each other after every minibatch. The progress
+        // shown then covers this worker's subset only.
+        bool aggregatePerMinibatch = useParallelTrain && !useDistributedMBReading;
         if (useDistributedMBReading)
             dataReader->StartDistributedMinibatchLoop(mbSize, 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), inputMatrices.GetStreamDescriptions(), testSize);
         else
@@ -116,20 +120,13 @@ public:
 
         const size_t numIterationsBeforePrintingProgress = 100;
         size_t numItersSinceLastPrintOfProgress = 0;
-        bool noMoreSamplesToProcess = false;
         for (;;)
         {
             size_t actualMBSize = 0;
             bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net, nullptr, useDistributedMBReading, useParallelTrain, inputMatrices, actualMBSize, m_mpi);
-            // in case of distributed reading, we do a few more loops until all ranks have completed
-            // end of epoch
-            if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) 
-                break;
-
-            // Note: If !wasDataRead then the data that GetMinibatchIntoNetwork() was supposed to full in are undefined.
-            // Must not touch them.
+            // end of epoch (with distributed reading, of this worker's subset)
             if (!wasDataRead)
-                actualMBSize = 0; // (undefined if !wasDataRead)
+                break;
 
             if (actualMBSize > 0)
             {
@@ -157,9 +154,9 @@ public:
             } // if (actualMBSize > 0)
 
             // BUGBUG (Issue #95): Once we have multiple layouts, this must be done on a per-node basis.
-            size_t numSamplesWithLabel = wasDataRead ? m_net->GetNumSamplesWithLabelOfNetwork(actualMBSize) : 0;
+            size_t numSamplesWithLabel = m_net->GetNumSamplesWithLabelOfNetwork(actualMBSize);
             size_t aggregateNumSamplesWithLabel = numSamplesWithLabel;
-            if (useParallelTrain)
+            if (aggregatePerMinibatch)
             {
                 if (m_gradHeader == nullptr)
                 {
@@ -192,7 +189,6 @@ public:
                 // Using SimpleDistAggregator for eval results only. At some point we should rename the class to be just
                 // IDistAggregator and SimpleDistAggregator.
                 bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader.get(), /*resetState =*/ false);
-                noMoreSamplesToProcess = !samplesProcessed;
 
                 aggregateNumSamplesWithLabel = m_gradHeader->numSamplesWithLabel;
                 for (size_t i = 0; i < evalResults.size(); i++)
@@ -272,6 +268,13 @@ public:
             DisplayEvalStatistics(numMBsRunLastLogged + 1, numMBsRun, numSamplesLastLogged, evalNodes, evalResults, evalResultsLastLogged);
         }
 
+        if (useParallelTrain && !aggregatePerMinibatch)
+        {
+            // combine the results of the workers' subsets
+            AggregateEpochCriteria(evalResults, m_mpi);
+            m_mpi->AllReduce(&totalEpochSamples, 1);
+        }
+
         if (useParallelTrain && !evalNodesWhichAccumulateResult.empty())
         {
             // Each worker contains accumulated values for part of the data set, we have to aggregate accumulated values
@@ -11,6 +11,7 @@
 #include "Helpers.h"
 #include "File.h"
 #include "fileutil.h"
+#include "OutputPipeline.h"
 #include <vector>
 #include <string>
 #include <stdexcept>
@@ -31,10 +32,18 @@ class SimpleOutputWriter
 
 public:
     SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0)
-        : m_net(net), m_verbosity(verbosity)
+        : m_net(net), m_verbosity(verbosity), m_outputFormat(OutputFormat::text), m_pipelineDepth(2)
     {
     }
 
+    // How the formatted WriteOutput() below writes the files: in text or binary format, and how many minibatches per
+    // output node may be on their way to the files while the next ones are computed (0 to write each one right away).
+    void SetOutputOptions(OutputFormat format, size_t pipelineDepth)
+    {
+        m_outputFormat = format;
+        m_pipelineDepth = pipelineDepth;
+    }
+
     void WriteOutput(IDataReader& dataReader, size_t mbSize, IDataWriter& dataWriter, const std::vector<std::wstring>& outputNodeNames, size_t numOutputSamples = requestDataSize, bool doWriterUnitTest = false)
     {
         ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
@@ -196,11 +205,16 @@ public:
             m_net->AllocateAllMatrices({}, outputNodes, outputNodes[0]);
         }
 
+        if (nodeUnitTest && m_outputFormat == OutputFormat::binary)
+            InvalidArgument("The binary output format cannot be used with nodeUnitTest.");
+        if (nodeUnitTest && formattingOptions.topK > 0)
+            InvalidArgument("The topK output format cannot be used with nodeUnitTest.");
+
         StreamMinibatchInputs inputMatrices = DataReaderHelpers::RetrieveInputMatrices(inputNodes);
         
         // load a label mapping if requested
         std::vector<std::string> labelMapping;
-        if ((formattingOptions.isCategoryLabel || formattingOptions.isSparse) && !formattingOptions.labelMappingFile.empty())
+        if ((formattingOptions.isCategoryLabel || formattingOptions.isSparse || formattingOptions.topK > 0) && !formattingOptions.labelMappingFile.empty())
             File::LoadLabelFile(formattingOptions.labelMappingFile, labelMapping);
 
         // open output files
@@ -211,7 +225,7 @@ public:
             std::wstring nodeOutputPath = outputPath;
             if (nodeOutputPath != L"-")
                 nodeOutputPath += L"." + onode->NodeName();
-            auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | fileOptionsText);
+            auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | (m_outputFormat == OutputFormat::binary ? fileOptionsBinary : fileOptionsText));
             outputStreams[onode] = f;
         }
 
@@ -222,10 +236,29 @@ public:
 
         size_t totalEpochSamples = 0;
 
-        for (auto & onode : outputNodes)
+        if (m_outputFormat == OutputFormat::text)
         {
-            FILE* f = *outputStreams[onode];
-            fprintfOrDie(f, "%s", formattingOptions.prologue.c_str());
+            for (auto & onode : outputNodes)
+            {
+                FILE* f = *outputStreams[onode];
+                fprintfOrDie(f, "%s", formattingOptions.prologue.c_str());
+            }
+        }
+
+        // Write the outputs in stages that overlap with the forward prop of the next minibatches, except for the unit test, which
+        // writes the gradients alongside, and on stdout, where the nodes are interleaved with each other and the progress output.
+        std::unique_ptr<OutputPipeline<ElemType>> pipeline;
+        if (!nodeUnitTest)
+        {
+            std::vector<ComputationNodePtr> pipelineNodes;
+            std::vector<FILE*> pipelineFiles;
+            for (auto & onode : outputNodes)
+            {
+                pipelineNodes.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(onode));
+                pipelineFiles.push_back(*outputStreams[onode]);
+            }
+            pipeline = std::make_unique<OutputPipeline<ElemType>>(pipelineNodes, pipelineFiles, formattingOptions, labelMapping, m_outputFormat,
+                                                                  outputPath == L"-" ? 0 : m_pipelineDepth);
         }
 
         size_t actualMBSize;
@@ -238,14 +271,20 @@ public:
         {
             ComputationNetwork::BumpEvalTimeStamp(inputNodes);
 
-            for (auto & onode : outputNodes)
+            for (size_t k = 0; k < outputNodes.size(); k++)
             {
+                auto& onode = outputNodes[k];
                 // compute the node value
                 // Note: Intermediate values are memoized, so in case of multiple output nodes, we only compute what has not been computed already.
                 m_net->ForwardProp(onode);
 
-                FILE* file = *outputStreams[onode];
-                WriteMinibatch(file, dynamic_pointer_cast<ComputationNode<ElemType>>(onode), formattingOptions, formatChar, valueFormatString, labelMapping, numMBsRun, /* gradient */ false);
+                if (pipeline)
+                    pipeline->Submit(k, numMBsRun);
+                else
+                {
+                    FILE* file = *outputStreams[onode];
+                    WriteMinibatch(file, dynamic_pointer_cast<ComputationNode<ElemType>>(onode), formattingOptions, formatChar, valueFormatString, labelMapping, numMBsRun, /* gradient */ false);
+                }
 
                 if (nodeUnitTest)
                     m_net->Backprop(onode);
@@ -279,10 +318,16 @@ public:
             dataReader.DataEnd();
         } // end loop over minibatches
 
-        for (auto & stream : outputStreams)
+        if (pipeline)
+            pipeline->Finish();
+
+        if (m_outputFormat == OutputFormat::text)
         {
-            FILE* f = *stream.second;
-            fprintfOrDie(f, "%s", formattingOptions.epilogue.c_str());
+            for (auto & stream : outputStreams)
+            {
+                FILE* f = *stream.second;
+                fprintfOrDie(f, "%s", formattingOptions.epilogue.c_str());
+            }
         }
 
         fprintf(stderr, "Written to %ls*\nTotal Samples Evaluated = %lu\n", outputPath.c_str(), (unsigned long)totalEpochSamples);
@@ -295,6 +340,8 @@ public:
 private:
     ComputationNetworkPtr m_net;
     int m_verbosity;
+    OutputFormat m_outputFormat;
+    size_t m_pipelineDepth;
     void operator=(const SimpleOutputWriter&); // (not assignable)
 };
 
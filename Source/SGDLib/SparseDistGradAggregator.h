@@ -0,0 +1,136 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "GradientSparsifier.h"
+#include "TimerUtility.h"
+#include <climits>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Aggregates top-k sparsified gradients (see GradientSparsifier): each worker sends a fraction 'density' of the entries
+// of each gradient, as (index, value) pairs, which are all-gathered and summed. The entries not sent are kept in a
+// residual per gradient and added to the next gradient (error feedback).
+template <class ElemType>
+class SparseDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    SparseDistGradAggregator(const MPIWrapperPtr& mpi, double density, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_density(density), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_initialized(false), m_numEntriesToSend(0)
+    {
+        GradientSparsifier<ElemType>::NumEntriesToSend(1, density); // (validates it)
+    }
+
+    // Aggregate the gradient matrices across all nodes
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) override
+    {
+        ResetState(gradients, resetState);
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        // a node that did not process any samples has no gradient to add; it still sends entries of its residuals
+        if (headerCPU->numSamples == 0)
+        {
+            for (auto gradient : gradients)
+                gradient->SetValue(0);
+        }
+
+        // select the entries to send, for all gradients into one buffer
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            m_sparsifier.Sparsify(*gradients[i], *m_residuals[i], m_numEntries[i],
+                                  m_sendIndices.data() + m_offsets[i], m_sendValues.data() + m_offsets[i]);
+        }
+
+        // exchange the entries and the headers
+        m_mpi->AllGather(m_sendIndices.data(), m_numEntriesToSend, m_recvIndices.data(), m_numEntriesToSend);
+        m_mpi->AllGather(m_sendValues.data(), m_numEntriesToSend, m_recvValues.data(), m_numEntriesToSend);
+
+        size_t headerSize = headerCPU->Size();
+        m_headers.resize(headerSize * NumProc());
+        MPI_Allgather(headerCPU, (int) headerSize, MPI_CHAR, m_headers.data(), (int) headerSize, MPI_CHAR, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+        for (size_t r = 0; r < NumProc(); r++)
+        {
+            if (r != MyRank())
+                headerCPU->Aggregate((DistGradHeader*) (m_headers.data() + r * headerSize), true);
+        }
+
+        // sum up the entries of all workers
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            m_sparsifier.Merge(m_recvIndices.data() + m_offsets[i], m_recvValues.data() + m_offsets[i], m_numEntries[i], *gradients[i],
+                               NumProc(), m_numEntriesToSend);
+        }
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g (sent %d of the gradient entries)\n",
+                    aggregationTimer.ElapsedSeconds(), (int) m_numEntriesToSend);
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    void ResetState(const std::vector<Matrix<ElemType>*>& gradients, bool resetState)
+    {
+        if (!m_initialized)
+        {
+            m_initialized = true;
+            for (auto gradient : gradients)
+            {
+                if (gradient->GetMatrixType() != DENSE)
+                    RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+                if (gradient->GetNumElements() > INT_MAX)
+                    RuntimeError("SparseDistGradAggregator: Gradients with more than %d elements are not supported.", INT_MAX);
+
+                m_residuals.push_back(std::make_unique<Matrix<ElemType>>(gradient->GetNumRows(), gradient->GetNumCols(), gradient->GetDeviceId()));
+                m_residuals.back()->SetValue(0);
+                m_offsets.push_back(m_numEntriesToSend);
+                m_numEntries.push_back(GradientSparsifier<ElemType>::NumEntriesToSend(gradient->GetNumElements(), m_density));
+                m_numEntriesToSend += m_numEntries.back();
+            }
+
+            m_sendIndices.resize(m_numEntriesToSend);
+            m_sendValues.resize(m_numEntriesToSend);
+            m_recvIndices.resize(m_numEntriesToSend * NumProc());
+            m_recvValues.resize(m_numEntriesToSend * NumProc());
+        }
+        else if (resetState)
+        {
+            for (auto& residual : m_residuals)
+                residual->SetValue(0);
+        }
+    }
+
+    double m_density;
+    int m_syncStatsTrace;
+    size_t m_iterationCount;
+    bool m_initialized;
+
+    GradientSparsifier<ElemType> m_sparsifier;
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_residuals; // per gradient
+
+    // the entries to send, of all gradients: those of gradient i start at m_offsets[i]
+    std::vector<size_t> m_offsets;
+    std::vector<size_t> m_numEntries;
+    size_t m_numEntriesToSend;
+    std::vector<int> m_sendIndices;
+    std::vector<ElemType> m_sendValues;
+    std::vector<int> m_recvIndices; // one block of m_numEntriesToSend per worker
+    std::vector<ElemType> m_recvValues;
+    std::vector<char> m_headers;
+};
+
+} } }
@@ -22,6 +22,7 @@ struct SeqGammarCalParam
     double wp;
     double bMMIfactor;
     bool sMBRmode;
+    size_t latticeCacheMB; // device memory for keeping lattices on the GPU across epochs
     SeqGammarCalParam()
     {
         amf = 14.0;
@@ -29,6 +30,7 @@ struct SeqGammarCalParam
         wp = 0.0;
         bMMIfactor = 0.0;
         sMBRmode = false;
+        latticeCacheMB = 512;
     }
 };
 
@@ -47,6 +49,7 @@ public:
         amf = 7.0f;
         boostmmifactor = 0.0f;
         seqsMBRmode = false;
+        latticecachebytes = 0;
     }
     ~GammaCalculation()
     {
@@ -66,8 +69,11 @@ public:
             // prep for parallel implementation (CUDA)
             parallellattice.setdevice(DeviceId);
 
-            if (parallellattice.enabled())                             // send hmm set to GPU if GPU computation enabled
+            if (parallellattice.enabled()) // send hmm set to GPU if GPU computation enabled
+            {
                 parallellattice.entercomputation(m_hset, mbrclassdef); // cache senone2classmap if mpemode
+                parallellattice.setlatticecachesize(latticecachebytes);
+            }
             initialmark = true;
         }
     }
@@ -82,6 +88,9 @@ public:
         wp = (float) gammarParam.wp;
         seqsMBRmode = gammarParam.sMBRmode;
         boostmmifactor = (float) gammarParam.bMMIfactor;
+        latticecachebytes = gammarParam.latticeCacheMB * 1024 * 1024;
+        if (parallellattice.enabled())
+            parallellattice.setlatticecachesize(latticecachebytes);
     }
 
     // ========================================
@@ -109,6 +118,13 @@ public:
         size_t numcols = loglikelihood.GetNumCols();
         Microsoft::MSR::CNTK::Matrix<ElemType> tempmatrix(m_deviceid);
 
+        // On the GPU the lattices read the log LLs from the device and leave the gammas there, so the log LLs only
+        // need to be copied to pred for the CPU computation and for the reference alignment (which is done on the CPU).
+        // The numerator scores are then gathered on the device for the whole minibatch at once, see below.
+        const bool copyloglls = (m_deviceid == CPUDEVICE) || doreferencealign;
+        if (!copyloglls)
+            m_uidofcolumn.assign(numcols, -1);
+
         // copy loglikelihood to pred
         if (numcols > pred.cols())
         {
@@ -139,10 +155,8 @@ public:
             if (samplesInRecurrentStep == 1) // no sequence parallelism
             {
                 tempmatrix = loglikelihood.ColumnSlice(ts, numframes);
-                // if (m_deviceid == CPUDEVICE)
-                {
+                if (copyloglls)
                     CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
-                }
 
                 if (m_deviceid != CPUDEVICE)
                     parallellattice.setloglls(tempmatrix);
@@ -175,10 +189,8 @@ public:
                 Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
                 tempmatrix.CopyColumnsStrided(loglikelihoodForCurrentParallelUtterance, numframes, samplesInRecurrentStep, 1);
 
-                // if (doreferencealign || m_deviceid == CPUDEVICE)
-                {
+                if (copyloglls)
                     CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
-                }
 
                 if (m_deviceid != CPUDEVICE)
                 {
@@ -197,12 +209,23 @@ public:
             array_ref<size_t> boundariesstripe(&boundaries[ts], boundaryframenum);
 
             double numavlogp = 0;
-            foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
+            if (copyloglls)
             {
-                const size_t s = uidsstripe[t];
-                numavlogp += predstripe(s, t) / amf;
+                foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
+                {
+                    const size_t s = uidsstripe[t];
+                    numavlogp += predstripe(s, t) / amf;
+                }
+                numavlogp /= numframes;
+            }
+            else // remember where the numerator scores of this utterance are in the minibatch
+            {
+                for (size_t t = 0; t < numframes; t++)
+                {
+                    const size_t j = (samplesInRecurrentStep > 1) ? (t + validframes[mapi]) * samplesInRecurrentStep + mapi : ts + t;
+                    m_uidofcolumn[j] = (CPUSPARSE_INDEX_TYPE) uidsstripe[t];
+                }
             }
-            numavlogp /= numframes;
 
             // auto_timer dengammatimer;
             double denavlogp = lattices[i]->second.forwardbackward(parallellattice,
@@ -247,10 +270,38 @@ public:
             fprintf(stderr, "dengamma value %f\n", denavlogp);
             ts += numframes;
         }
+        if (!copyloglls)
+            objectValue += (ElemType)(SumNumeratorScoresOnDevice(loglikelihood) / amf);
         functionValues.SetValue(objectValue);
     }
 
 private:
+    // Sum of the log LLs of the reference states (m_uidofcolumn, -1 for gaps) over all frames of the minibatch,
+    // as the inner product with a sparse selection matrix, such that only the result leaves the device.
+    double SumNumeratorScoresOnDevice(const Microsoft::MSR::CNTK::Matrix<ElemType>& loglikelihood)
+    {
+        const size_t numcols = m_uidofcolumn.size();
+        m_selectioncolstarts.resize(numcols + 1);
+        m_selectionrows.clear();
+        m_selectioncolstarts[0] = 0;
+        for (size_t j = 0; j < numcols; j++)
+        {
+            if (m_uidofcolumn[j] >= 0)
+                m_selectionrows.push_back(m_uidofcolumn[j]);
+            m_selectioncolstarts[j + 1] = (CPUSPARSE_INDEX_TYPE) m_selectionrows.size();
+        }
+        if (m_selectionrows.empty())
+            return 0;
+        m_selectionvalues.assign(m_selectionrows.size(), (ElemType) 1);
+
+        if (!m_selection)
+            m_selection.reset(new Microsoft::MSR::CNTK::Matrix<ElemType>(loglikelihood.GetNumRows(), numcols, m_deviceid,
+                                                                         Microsoft::MSR::CNTK::SPARSE, Microsoft::MSR::CNTK::matrixFormatSparseCSC));
+        m_selection->SetMatrixFromCSCFormat(m_selectioncolstarts.data(), m_selectionrows.data(), m_selectionvalues.data(),
+                                            m_selectionrows.size(), loglikelihood.GetNumRows(), numcols);
+        return (double) Microsoft::MSR::CNTK::Matrix<ElemType>::InnerProductOfMatrices(loglikelihood, *m_selection);
+    }
+
     // Helper methods for copying between ssematrix objects and CNTK matrices
     void CopyFromCNTKMatrixToSSEMatrix(const Microsoft::MSR::CNTK::Matrix<ElemType>& src, size_t numCols, msra::math::ssematrixbase& dest)
     {
@@ -376,11 +427,19 @@ protected:
     std::vector<size_t> boundary;
     float boostmmifactor;
     bool seqsMBRmode;
+    size_t latticecachebytes;
 
 private:
     std::unique_ptr<Microsoft::MSR::CNTK::CUDAPageLockedMemAllocator> m_cudaAllocator;
     std::shared_ptr<ElemType> m_intermediateCUDACopyBuffer;
     size_t m_intermediateCUDACopyBufferSize;
+
+    // for SumNumeratorScoresOnDevice()
+    std::vector<CPUSPARSE_INDEX_TYPE> m_uidofcolumn;
+    std::vector<CPUSPARSE_INDEX_TYPE> m_selectioncolstarts;
+    std::vector<CPUSPARSE_INDEX_TYPE> m_selectionrows;
+    std::vector<ElemType> m_selectionvalues;
+    std::unique_ptr<Microsoft::MSR::CNTK::Matrix<ElemType>> m_selection;
 };
 
 }}
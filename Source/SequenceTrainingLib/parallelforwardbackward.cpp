@@ -13,6 +13,7 @@
 #include "latticefunctionskernels.h" // for emulation
 #include "cudalatticeops.h"
 #include <numeric> // for debug
+#include <unordered_map>
 #include "cudalib.h"
 #include "Basics.h"
 
@@ -360,6 +361,48 @@ static void emulatemmierrorsignal(const std::vector<unsigned short>& alignstatei
                 });
 }
 
+// -----------------------------------------------------------------------
+// latticedevicedata --the parts of a lattice that do not change during training, on the device
+// -----------------------------------------------------------------------
+
+struct latticedevicedata
+{
+    std::unique_ptr<edgeinfowithscoresvector> edges;
+    std::unique_ptr<nodeinfovector> nodes;
+    std::unique_ptr<aligninfovector> align;
+    std::unique_ptr<msra::cuda::uintvector> alignoffsets; // edges[j]'s alignment starts at offset alignoffsets[j]
+    std::unique_ptr<sizetvector> backptroffsets;
+    size_t numbytes; // device memory used by the above
+
+    latticedevicedata(size_t deviceid)
+        : edges(msra::cuda::newedgeinfovector(deviceid)),
+          nodes(msra::cuda::newnodeinfovector(deviceid)),
+          align(msra::cuda::newaligninfovector(deviceid)),
+          alignoffsets(msra::cuda::newuintvector(deviceid)),
+          backptroffsets(msra::cuda::newsizetvector(deviceid)),
+          numbytes(0)
+    {
+    }
+
+    template <class edgestype, class nodestype, class aligntype>
+    void assign(const edgestype& e, const nodestype& n, const aligntype& a,
+                const std::vector<unsigned int>& ao, const std::vector<size_t>& bo, size_t nbytes)
+    {
+        edges->assign(e, false);
+        nodes->assign(n, false);
+        align->assign(a, false);
+        alignoffsets->assign(ao, false);
+        backptroffsets->assign(bo, false);
+        numbytes = nbytes;
+    }
+
+    // a cached lattice is only reused if it has the same structure, in case a key is reused for a different lattice
+    bool matches(size_t numedges, size_t numnodes, size_t numaligns) const
+    {
+        return edges->size() == numedges && nodes->size() == numnodes && align->size() == numaligns;
+    }
+};
+
 // -----------------------------------------------------------------------
 // parallelstate (-impl) --holds variables for CUDA access
 // -----------------------------------------------------------------------
@@ -376,11 +419,11 @@ struct parallelstateimpl
           spalignunitid(SIZE_MAX),
           silalignunitid(SIZE_MAX),
           // current lattice, logLLs, and return values
-          edgesgpu(msra::cuda::newedgeinfovector(deviceid)),
-          nodesgpu(msra::cuda::newnodeinfovector(deviceid)),
-          aligngpu(msra::cuda::newaligninfovector(deviceid)),
+          scratchlattice(new latticedevicedata(deviceid)),
+          currentlattice(nullptr),
+          latticecachebytes(0),
+          maxlatticecachebytes(0),
           alignresult(msra::cuda::newushortvector(deviceid)),
-          alignoffsetsgpu(msra::cuda::newuintvector(deviceid)),
           edgeacscoresgpu(msra::cuda::newfloatvector(deviceid)),
           cudalogLLs(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           logppsgpu(msra::cuda::newdoublevector(deviceid)),
@@ -397,8 +440,7 @@ struct parallelstateimpl
           errorsignalneggpu(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           errorsignalgpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           errorsignalneggpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
-          backptrstoragegpu(msra::cuda::newushortvector(deviceid)),
-          backptroffsetsgpu(msra::cuda::newsizetvector(deviceid))
+          backptrstoragegpu(msra::cuda::newushortvector(deviceid))
     {
     }
 
@@ -514,11 +556,14 @@ struct parallelstateimpl
     }
 
     // current lattice
-    std::unique_ptr<edgeinfowithscoresvector> edgesgpu;
-    std::unique_ptr<nodeinfovector> nodesgpu;
-    std::unique_ptr<aligninfovector> aligngpu;
+    // The lattice structure is kept on the device across epochs in 'latticecache' (keyed by the lattice key),
+    // up to 'maxlatticecachebytes'; lattices that do not fit any more are uploaded into 'scratchlattice' each time.
+    std::unique_ptr<latticedevicedata> scratchlattice;
+    std::unordered_map<std::wstring, std::unique_ptr<latticedevicedata>> latticecache;
+    latticedevicedata* currentlattice; // either scratchlattice or an entry of latticecache
+    size_t latticecachebytes;
+    size_t maxlatticecachebytes;
     std::unique_ptr<ushortvector> alignresult; // concatenated alignments; edges[j]'s alignment starts at offset alignoffsets[j]
-    std::unique_ptr<msra::cuda::uintvector> alignoffsetsgpu;
     std::unique_ptr<floatvector> edgeacscoresgpu;
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> cudalogLLs;
 
@@ -533,7 +578,6 @@ struct parallelstateimpl
     std::unique_ptr<doublevector> logEframescorrectgpu;
 
     std::unique_ptr<ushortvector> backptrstoragegpu;
-    std::unique_ptr<sizetvector> backptroffsetsgpu;
 
     std::unique_ptr<ushortvector> uidsgpu;
     std::unique_ptr<ushortvector> senone2classmapgpu;
@@ -546,17 +590,35 @@ struct parallelstateimpl
     // cache current lattice
     // This is a weird mix of const/non-const and private lattice data... :(
     template <class edgestype, class nodestype, class aligntype, class edgealignments, class backpointers>
-    void setutterancedata(const edgestype& edges, const nodestype& nodes, const aligntype& align,
+    void setutterancedata(const std::wstring& key, const edgestype& edges, const nodestype& nodes, const aligntype& align,
                           const msra::math::ssematrixbase& /*logLLs*/, std::vector<float>& edgeacscores,
                           edgealignments& edgeAlignments, backpointers& backPointers)
     {
-        // lattice data
-        edgesgpu->assign(edges, false);
-        nodesgpu->assign(nodes, false);
-        aligngpu->assign(align, false);
-        alignoffsetsgpu->assign(edgeAlignments.getalignoffsets(), false);
+        // lattice data, from the cache if we have seen this lattice before
+        auto iter = latticecache.find(key);
+        if (iter != latticecache.end() && iter->second->matches(edges.size(), nodes.size(), align.size()))
+            currentlattice = iter->second.get();
+        else
+        {
+            const size_t numbytes = edges.size() * sizeof(edges[0]) + nodes.size() * sizeof(nodes[0]) + align.size() * sizeof(align[0]) +
+                                    edgeAlignments.getalignoffsets().size() * sizeof(unsigned int) + backPointers.getbackptroffsets().size() * sizeof(size_t);
+            if (iter != latticecache.end()) // same key but different lattice: replace it
+            {
+                latticecachebytes -= iter->second->numbytes;
+                latticecache.erase(iter);
+            }
+            if (latticecachebytes + numbytes <= maxlatticecachebytes)
+            {
+                auto& entry = latticecache[key];
+                entry.reset(new latticedevicedata(deviceid));
+                latticecachebytes += numbytes;
+                currentlattice = entry.get();
+            }
+            else
+                currentlattice = scratchlattice.get();
+            currentlattice->assign(edges, nodes, align, edgeAlignments.getalignoffsets(), backPointers.getbackptroffsets(), numbytes);
+        }
         backptrstoragegpu->allocate(backPointers.getbackptrstoragesize());
-        backptroffsetsgpu->assign(backPointers.getbackptroffsets(), false);
 
 #ifndef PARALLEL_SIL
         alignresult->assign(edgeAlignments.getalignmentsbuffer(), false);
@@ -581,6 +643,16 @@ struct parallelstateimpl
     {
         loglls.SetValue(*errorsignalgpu);
     }
+    void setlatticecachesize(size_t maxbytes)
+    {
+        maxlatticecachebytes = maxbytes;
+        if (latticecachebytes > maxlatticecachebytes)
+        {
+            currentlattice = nullptr;
+            latticecache.clear();
+            latticecachebytes = 0;
+        }
+    }
     template <class edgealignments>
     void copyalignments(edgealignments& edgeAlignments)
     {
@@ -746,6 +818,11 @@ void lattice::parallelstate::getgamma(Microsoft::MSR::CNTK::Matrix<double>& /*lo
     throw ::logic_error("Double precision not supported for sequence training");
 }
 
+void lattice::parallelstate::setlatticecachesize(size_t maxbytes)
+{
+    pimpl->setlatticecachesize(maxbytes);
+}
+
 // -----------------------------------------------------------------------
 // parallel implementations of key processing steps
 // -----------------------------------------------------------------------
@@ -760,17 +837,17 @@ void lattice::parallelforwardbackwardalign(parallelstate& parallelstate,
     if (!parallelstate->emulation)
     {
         // move lattice to GPU
-        parallelstate->setutterancedata(edges, nodes, align, logLLs,                 // inputs
+        parallelstate->setutterancedata(key, edges, nodes, align, logLLs,            // inputs
                                         edgeacscores, edgealignments, backpointers); // inouts
 
         // launch the kernel
         std::unique_ptr<latticefunctions> latticefunctions(msra::cuda::newlatticefunctions(parallelstate.getdevice()));
         latticefunctions->edgealignment(*parallelstate->hmmsgpu.get(), *parallelstate->lr3transPgpu.get(),
                                         parallelstate->spalignunitid, parallelstate->silalignunitid,
-                                        *parallelstate->cudalogLLs.get(), *parallelstate->nodesgpu.get(),
-                                        *parallelstate->edgesgpu.get(), *parallelstate->aligngpu.get(),
-                                        *parallelstate->alignoffsetsgpu.get(),
-                                        *parallelstate->backptrstoragegpu.get(), *parallelstate->backptroffsetsgpu.get(),
+                                        *parallelstate->cudalogLLs.get(), *parallelstate->currentlattice->nodes,
+                                        *parallelstate->currentlattice->edges, *parallelstate->currentlattice->align,
+                                        *parallelstate->currentlattice->alignoffsets,
+                                        *parallelstate->backptrstoragegpu.get(), *parallelstate->currentlattice->backptroffsets,
                                         *parallelstate->alignresult.get(), *parallelstate->edgeacscoresgpu.get());
     }
     else
@@ -850,9 +927,9 @@ double lattice::parallelforwardbackwardlattice(parallelstate& parallelstate, con
         std::unique_ptr<latticefunctions> latticefunctions(msra::cuda::newlatticefunctions(parallelstate.getdevice())); // final CUDA call
         latticefunctions->forwardbackwardlattice(&batchsizeforward[0], &batchsizebackward[0], batchsizeforward.size(), batchsizebackward.size(),
                                                  parallelstate->spalignunitid, parallelstate->silalignunitid,
-                                                 *parallelstate->edgeacscoresgpu.get(), *parallelstate->edgesgpu.get(),
-                                                 *parallelstate->nodesgpu.get(), *parallelstate->aligngpu.get(),
-                                                 *parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(),
+                                                 *parallelstate->edgeacscoresgpu.get(), *parallelstate->currentlattice->edges,
+                                                 *parallelstate->currentlattice->nodes, *parallelstate->currentlattice->align,
+                                                 *parallelstate->alignresult.get(), *parallelstate->currentlattice->alignoffsets,
                                                  *parallelstate->logppsgpu.get(), *parallelstate->logalphasgpu.get(),
                                                  *parallelstate->logbetasgpu.get(), lmf, wp, amf, boostingfactor,
                                                  returnEframescorrect, *parallelstate->uidsgpu.get(), *parallelstate->senone2classmapgpu.get(),
@@ -920,15 +997,12 @@ void lattice::parallelsMBRerrorsignal(parallelstate& parallelstate, const edgeal
         parallelstate->cacheerrorsignal(errorsignal, cacheerrorsignalneg);
 
         std::unique_ptr<latticefunctions> latticefunctions(msra::cuda::newlatticefunctions(parallelstate.getdevice()));
-        latticefunctions->sMBRerrorsignal(*parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(), *parallelstate->edgesgpu.get(),
-                                          *parallelstate->nodesgpu.get(), *parallelstate->logppsgpu.get(), amf, *parallelstate->logEframescorrectgpu.get(),
+        latticefunctions->sMBRerrorsignal(*parallelstate->alignresult.get(), *parallelstate->currentlattice->alignoffsets, *parallelstate->currentlattice->edges,
+                                          *parallelstate->currentlattice->nodes, *parallelstate->logppsgpu.get(), amf, *parallelstate->logEframescorrectgpu.get(),
                                           logEframescorrecttotal,
                                           *parallelstate->errorsignalgpu.get(), *parallelstate->errorsignalneggpu.get());
 
-        if (errorsignal.rows() > 0 && errorsignal.cols() > 0)
-        {
-            parallelstate->errorsignalgpu->CopySection(errorsignal.rows(), errorsignal.cols(), &errorsignal(0, 0), errorsignal.getcolstride());
-        }
+        // the error signal stays on the GPU, it is retrieved with getgamma() (same as in MMI mode)
     }
     else
     {
@@ -948,8 +1022,8 @@ void lattice::parallelmmierrorsignal(parallelstate& parallelstate, const edgeali
         parallelstate->cacheerrorsignal(errorsignal, cacheerrorsignalneg);
 
         std::unique_ptr<latticefunctions> latticefunctions(msra::cuda::newlatticefunctions(parallelstate.getdevice()));
-        latticefunctions->mmierrorsignal(*parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(), *parallelstate->edgesgpu.get(),
-                                         *parallelstate->nodesgpu.get(), *parallelstate->logppsgpu.get(), *parallelstate->errorsignalgpu.get());
+        latticefunctions->mmierrorsignal(*parallelstate->alignresult.get(), *parallelstate->currentlattice->alignoffsets, *parallelstate->currentlattice->edges,
+                                         *parallelstate->currentlattice->nodes, *parallelstate->logppsgpu.get(), *parallelstate->errorsignalgpu.get());
 
         // parallelstate->errorsignalgpu->fetch (0, errorsignal.rows(), 0, errorsignal.cols(), &errorsignal(0, 0), errorsignal.getcolstride(), true);
     }
@@ -100,6 +100,23 @@ BOOST_AUTO_TEST_CASE(ParseExpressionsAndCompareTree)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ExpressionFingerprint)
+{
+    auto fingerprint = [](const wchar_t* source)
+    {
+        return BS::ParseConfigDictFromString(source, L"Test", vector<wstring>())->Fingerprint();
+    };
+
+    // the same description up to layout and comments
+    let expected = fingerprint(L"a = 13 ; f(x) = x * a ; b = f(2)");
+    BOOST_CHECK_EQUAL(fingerprint(L"a = 13\n# comment\nf(x) = x*a\nb = f (2)"), expected);
+
+    // a different value, name, or operation
+    BOOST_CHECK_NE(fingerprint(L"a = 14 ; f(x) = x * a ; b = f(2)"), expected);
+    BOOST_CHECK_NE(fingerprint(L"a = 13 ; f(y) = y * a ; b = f(2)"), expected);
+    BOOST_CHECK_NE(fingerprint(L"a = 13 ; f(x) = x + a ; b = f(2)"), expected);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}}}
@@ -0,0 +1,184 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BenchmarkHelper.h -- options, CSV results and regression baselines shared by the benchmark drivers
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Splits a comma-separated option value.
+inline std::vector<std::string> SplitBenchmarkList(const std::string& value)
+{
+    std::vector<std::string> items;
+    std::stringstream valueStream(value);
+    for (std::string item; std::getline(valueStream, item, ',');)
+        items.push_back(item);
+    return items;
+}
+
+// The options that all benchmark drivers have:
+//     --device <ids>          comma-separated device ids, -1 = CPU (default: -1)
+//     --precision <p>         float, double or all (default: float)
+//     --output <file>         also write the results to this CSV file
+//     --baseline <file>       compare against the results of an earlier run
+//     --tolerance <fraction>  allowed regression against the baseline
+struct BenchmarkOptions
+{
+    std::vector<int> m_deviceIds;
+    std::string m_precision;
+    std::string m_outputPath;
+    std::string m_baselinePath;
+    double m_tolerance;
+
+    bool RunFloat() const { return m_precision != "double"; }
+    bool RunDouble() const { return m_precision != "float"; }
+};
+
+// Parses the '--option value' pairs of the command line; the options specific to the benchmark are passed to
+// parseOption, which returns false for an unknown option.
+inline BenchmarkOptions ParseBenchmarkOptions(const char* benchmarkName, const std::vector<std::string>& args, double defaultTolerance,
+                                              const std::function<bool(const std::string& option, const std::string& value)>& parseOption)
+{
+    BenchmarkOptions options;
+    options.m_deviceIds = { -1 };
+    options.m_precision = "float";
+    options.m_tolerance = defaultTolerance;
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& option = args[i];
+        if (i + 1 >= args.size())
+            InvalidArgument("%s: Missing value of the option '%s'.", benchmarkName, option.c_str());
+        const std::string& value = args[++i];
+        if (option == "--device")
+        {
+            options.m_deviceIds.clear();
+            for (const auto& id : SplitBenchmarkList(value))
+                options.m_deviceIds.push_back(std::stoi(id));
+        }
+        else if (option == "--precision")
+            options.m_precision = value;
+        else if (option == "--output")
+            options.m_outputPath = value;
+        else if (option == "--baseline")
+            options.m_baselinePath = value;
+        else if (option == "--tolerance")
+            options.m_tolerance = std::stod(value);
+        else if (!parseOption(option, value))
+            InvalidArgument("%s: Unknown option '%s'.", benchmarkName, option.c_str());
+    }
+    if (options.m_precision != "float" && options.m_precision != "double" && options.m_precision != "all")
+        InvalidArgument("%s: Invalid precision '%s', must be 'float', 'double' or 'all'.", benchmarkName, options.m_precision.c_str());
+    return options;
+}
+
+// The results of a run as CSV lines, of which the first numKeyFields fields identify the case and the next one is the
+// metric that is compared against the baseline, either a time (lower is better) or a throughput (higher is better).
+class BenchmarkReport
+{
+public:
+    BenchmarkReport(const char* benchmarkName, const char* csvHeader, size_t numKeyFields, bool isHigherBetter, const char* unit)
+        : m_benchmarkName(benchmarkName), m_csvHeader(csvHeader), m_numKeyFields(numKeyFields), m_isHigherBetter(isHigherBetter), m_unit(unit)
+    {
+    }
+
+    // Reads the results of an earlier run; done before the run, so that a wrong path does not cost a whole run.
+    void ReadBaseline(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+            RuntimeError("%s: Failed to open the baseline '%s'.", m_benchmarkName, path.c_str());
+
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line == m_csvHeader)
+                continue;
+            auto fields = SplitBenchmarkList(line);
+            if (fields.size() <= m_numKeyFields)
+                RuntimeError("%s: Invalid line in the baseline '%s': %s", m_benchmarkName, path.c_str(), line.c_str());
+            m_baseline[GetKey(line)] = std::stod(fields[m_numKeyFields]);
+        }
+    }
+
+    void PrintHeader() const
+    {
+        std::cout << m_csvHeader << std::endl;
+    }
+
+    void Add(const std::string& line)
+    {
+        std::cout << line << std::endl;
+        m_lines.push_back(line);
+    }
+
+    // A case that cannot run in this configuration (e.g. an engine that does not support the device).
+    void Skip(const std::string& caseName, const std::string& device, const std::exception& e) const
+    {
+        std::cerr << "Skipping " << caseName << " on " << device << ": " << e.what() << std::endl;
+    }
+
+    void WriteOutput(const std::string& path) const
+    {
+        std::ofstream output(path);
+        output << m_csvHeader << std::endl;
+        for (const auto& line : m_lines)
+            output << line << std::endl;
+        if (!output)
+            RuntimeError("%s: Failed to write '%s'.", m_benchmarkName, path.c_str());
+    }
+
+    // Reports the cases that regressed by more than the tolerance, returns their number.
+    size_t CompareToBaseline(double tolerance) const
+    {
+        size_t numRegressions = 0;
+        for (const auto& line : m_lines)
+        {
+            auto entry = m_baseline.find(GetKey(line));
+            if (entry == m_baseline.end())
+                continue;
+            double value = std::stod(SplitBenchmarkList(line)[m_numKeyFields]);
+            bool isRegression = m_isHigherBetter ? value < entry->second * (1 - tolerance) : value > entry->second * (1 + tolerance);
+            if (isRegression)
+            {
+                std::cerr << "REGRESSION: " << entry->first << ": " << value << " " << m_unit << " against " << entry->second << " " << m_unit << " in the baseline" << std::endl;
+                numRegressions++;
+            }
+        }
+        if (!m_baseline.empty())
+            std::cerr << numRegressions << " regression(s) against the baseline with a tolerance of " << 100 * tolerance << "%." << std::endl;
+        return numRegressions;
+    }
+
+private:
+    std::string GetKey(const std::string& line) const
+    {
+        size_t keyEnd = 0;
+        for (size_t field = 0; field < m_numKeyFields && keyEnd != std::string::npos; field++)
+            keyEnd = line.find(',', field == 0 ? 0 : keyEnd + 1);
+        return line.substr(0, keyEnd);
+    }
+
+    const char* m_benchmarkName;
+    const char* m_csvHeader;
+    size_t m_numKeyFields;
+    bool m_isHigherBetter;
+    const char* m_unit;
+    std::map<std::string, double> m_baseline;
+    std::vector<std::string> m_lines;
+};
+
+}}}
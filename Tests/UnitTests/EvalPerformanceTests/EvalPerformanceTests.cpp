@@ -0,0 +1,367 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// EvalPerformanceTests.cpp : Latency and throughput benchmark of ForwardPass() of the extended evaluation interface.
+//
+// Usage: evalperformancetests modelPath=<model> [deviceId=-1] [outputNodeNames=<node>[:<node>...]]
+//                             [batchSizes=1:8:32] [numThreads=1:4] [sparsities=0] [iterations=100] [warmup=10]
+//                             [format=csv|json] [evalConfig=<additional eval config>]
+//
+// For every combination of batch size (samples per ForwardPass() call), number of threads (each with its own session
+// of the model), and input sparsity (fraction of zero elements in the random inputs), it runs 'warmup' untimed and
+// then 'iterations' timed calls per thread, and writes one record per combination to stdout:
+// latency percentiles per call, samples per second over all threads, the peak resident memory of the process,
+// and the number of heap allocations per call. Progress goes to stderr.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Eval.h"
+#ifdef _WIN32
+#include "Windows.h"
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace Microsoft::MSR::CNTK;
+
+// -----------------------------------------------------------------------
+// heap allocation counting
+// Replacing the global operator new counts the allocations of the evaluation library as well on Linux,
+// where it binds to this definition; on Windows only those of this executable are counted.
+// -----------------------------------------------------------------------
+
+static atomic<bool> s_countAllocations(false);
+static atomic<size_t> s_numAllocations(0);
+
+void* operator new(size_t size)
+{
+    if (s_countAllocations)
+        s_numAllocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+static size_t PeakResidentMemoryMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize / (1024 * 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (size_t)usage.ru_maxrss / 1024; // (in KB on Linux)
+#endif
+}
+
+// -----------------------------------------------------------------------
+// command line
+// -----------------------------------------------------------------------
+
+struct BenchmarkConfig
+{
+    string m_modelPath;
+    int m_deviceId = -1;
+    vector<wstring> m_outputNodeNames;
+    vector<size_t> m_batchSizes{ 1, 8, 32 };
+    vector<size_t> m_numThreads{ 1 };
+    vector<double> m_sparsities{ 0 };
+    size_t m_iterations = 100;
+    size_t m_warmup = 10;
+    bool m_json = false;
+    string m_evalConfig;
+};
+
+static vector<string> Split(const string& s, char separator)
+{
+    vector<string> parts;
+    size_t begin = 0;
+    for (;;)
+    {
+        size_t end = s.find(separator, begin);
+        parts.push_back(s.substr(begin, end == string::npos ? string::npos : end - begin));
+        if (end == string::npos)
+            return parts;
+        begin = end + 1;
+    }
+}
+
+static BenchmarkConfig ParseCommandLine(int argc, char* argv[])
+{
+    BenchmarkConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (eq == string::npos)
+            throw runtime_error("Expected arguments of the form name=value, but got '" + arg + "'.");
+        string name = arg.substr(0, eq);
+        string value = arg.substr(eq + 1);
+        if (name == "modelPath")
+            config.m_modelPath = value;
+        else if (name == "deviceId")
+            config.m_deviceId = stoi(value);
+        else if (name == "outputNodeNames")
+        {
+            for (const auto& nodeName : Split(value, ':'))
+                config.m_outputNodeNames.push_back(wstring(nodeName.begin(), nodeName.end()));
+        }
+        else if (name == "batchSizes" || name == "numThreads")
+        {
+            vector<size_t> values;
+            for (const auto& v : Split(value, ':'))
+                values.push_back(stoul(v));
+            (name == "batchSizes" ? config.m_batchSizes : config.m_numThreads) = values;
+        }
+        else if (name == "sparsities")
+        {
+            config.m_sparsities.clear();
+            for (const auto& v : Split(value, ':'))
+                config.m_sparsities.push_back(stod(v));
+        }
+        else if (name == "iterations")
+            config.m_iterations = stoul(value);
+        else if (name == "warmup")
+            config.m_warmup = stoul(value);
+        else if (name == "format")
+            config.m_json = (value == "json");
+        else if (name == "evalConfig")
+            config.m_evalConfig = value;
+        else
+            throw runtime_error("Unknown argument '" + name + "'.");
+    }
+    if (config.m_modelPath.empty())
+        throw runtime_error("Usage: evalperformancetests modelPath=<model> [deviceId=-1] [outputNodeNames=a:b] [batchSizes=1:8:32] "
+                            "[numThreads=1:4] [sparsities=0:0.9] [iterations=100] [warmup=10] [format=csv|json] [evalConfig=...]");
+    if (config.m_iterations == 0)
+        throw runtime_error("iterations must be at least 1.");
+    return config;
+}
+
+// -----------------------------------------------------------------------
+// benchmark
+// -----------------------------------------------------------------------
+
+// random inputs of 'numSamples' samples in which a fraction 'sparsity' of the elements is zero
+// (sparse inputs store only the others, but at least one per sample)
+static Values<float> CreateInputs(const VariableSchema& inputLayouts, size_t numSamples, double sparsity, mt19937& rng)
+{
+    uniform_real_distribution<float> valueDistribution(-1, 1);
+    uniform_real_distribution<double> zeroDistribution(0, 1);
+    Values<float> inputs(inputLayouts.size());
+    for (size_t i = 0; i < inputLayouts.size(); i++)
+    {
+        size_t dim = inputLayouts[i].m_numElements;
+        auto& input = inputs[i];
+        if (inputLayouts[i].m_storageType == VariableLayout::Sparse)
+        {
+            size_t nnz = max((size_t)1, (size_t)((1 - sparsity) * dim + 0.5));
+            vector<int> rows(dim);
+            for (size_t r = 0; r < dim; r++)
+                rows[r] = (int)r;
+            input.m_colIndices.push_back(0);
+            for (size_t s = 0; s < numSamples; s++)
+            {
+                shuffle(rows.begin(), rows.end(), rng);
+                sort(rows.begin(), rows.begin() + nnz);
+                for (size_t k = 0; k < nnz; k++)
+                {
+                    input.m_indices.push_back(rows[k]);
+                    input.m_buffer.push_back(valueDistribution(rng));
+                }
+                input.m_colIndices.push_back((int)input.m_indices.size());
+            }
+        }
+        else
+        {
+            input.m_buffer.resize(dim * numSamples);
+            for (auto& value : input.m_buffer)
+                value = zeroDistribution(rng) < sparsity ? 0 : valueDistribution(rng);
+        }
+    }
+    return inputs;
+}
+
+struct BenchmarkResult
+{
+    size_t m_batchSize;
+    size_t m_numThreads;
+    double m_sparsity;
+    vector<double> m_latenciesMs; // of all timed calls, sorted
+    double m_wallTimeSec;
+    size_t m_numAllocations;
+    size_t m_peakMemoryMB;
+
+    double Percentile(double p) const
+    {
+        size_t rank = (size_t)(p / 100 * (m_latenciesMs.size() - 1) + 0.5);
+        return m_latenciesMs[min(rank, m_latenciesMs.size() - 1)];
+    }
+    double SamplesPerSec() const { return m_batchSize * m_latenciesMs.size() / m_wallTimeSec; }
+    double AllocationsPerCall() const { return (double)m_numAllocations / m_latenciesMs.size(); }
+};
+
+static BenchmarkResult Run(IEvaluateModelExtended<float>* model, const BenchmarkConfig& config,
+                           size_t batchSize, size_t numThreads, double sparsity)
+{
+    // one session per thread, sharing the parameters
+    vector<IEvaluateModelExtended<float>*> sessions;
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        sessions.push_back(model->CreateSession());
+        sessions.back()->StartForwardEvaluation(config.m_outputNodeNames);
+    }
+    auto inputLayouts = sessions[0]->GetInputSchema();
+    auto outputLayouts = sessions[0]->GetOutputSchema();
+
+    vector<Values<float>> inputs, outputs;
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        mt19937 rng((unsigned int)t);
+        inputs.push_back(CreateInputs(inputLayouts, batchSize, sparsity, rng));
+        outputs.push_back(outputLayouts.CreateBuffers<float>(vector<size_t>(outputLayouts.size(), batchSize)));
+    }
+
+    for (size_t t = 0; t < numThreads; t++)
+        for (size_t n = 0; n < config.m_warmup; n++)
+            sessions[t]->ForwardPass(inputs[t], outputs[t]);
+
+    vector<vector<double>> latencies(numThreads);
+    for (auto& threadLatencies : latencies)
+        threadLatencies.reserve(config.m_iterations);
+    vector<thread> threads;
+    s_numAllocations = 0;
+    s_countAllocations = true;
+    auto start = chrono::steady_clock::now();
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (size_t n = 0; n < config.m_iterations; n++)
+            {
+                auto callStart = chrono::steady_clock::now();
+                sessions[t]->ForwardPass(inputs[t], outputs[t]);
+                latencies[t].push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - callStart).count());
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    auto wallTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    s_countAllocations = false;
+
+    BenchmarkResult result;
+    result.m_batchSize = batchSize;
+    result.m_numThreads = numThreads;
+    result.m_sparsity = sparsity;
+    for (const auto& threadLatencies : latencies)
+        result.m_latenciesMs.insert(result.m_latenciesMs.end(), threadLatencies.begin(), threadLatencies.end());
+    sort(result.m_latenciesMs.begin(), result.m_latenciesMs.end());
+    result.m_wallTimeSec = wallTime;
+    result.m_numAllocations = s_numAllocations;
+    result.m_peakMemoryMB = PeakResidentMemoryMB();
+
+    for (auto session : sessions)
+        session->Destroy();
+    return result;
+}
+
+static void Print(const BenchmarkResult& r, const BenchmarkConfig& config, bool first)
+{
+    if (config.m_json)
+    {
+        // one JSON object per line
+        printf("{\"deviceId\": %d, \"batchSize\": %" PRIu64 ", \"numThreads\": %" PRIu64 ", \"sparsity\": %g, \"numCalls\": %" PRIu64 ", "
+               "\"p50Ms\": %.4f, \"p90Ms\": %.4f, \"p99Ms\": %.4f, \"maxMs\": %.4f, \"samplesPerSec\": %.1f, "
+               "\"peakMemoryMB\": %" PRIu64 ", \"allocationsPerCall\": %.2f}\n",
+               config.m_deviceId, (uint64_t)r.m_batchSize, (uint64_t)r.m_numThreads, r.m_sparsity, (uint64_t)r.m_latenciesMs.size(),
+               r.Percentile(50), r.Percentile(90), r.Percentile(99), r.m_latenciesMs.back(), r.SamplesPerSec(),
+               (uint64_t)r.m_peakMemoryMB, r.AllocationsPerCall());
+    }
+    else
+    {
+        if (first)
+            printf("deviceId,batchSize,numThreads,sparsity,numCalls,p50Ms,p90Ms,p99Ms,maxMs,samplesPerSec,peakMemoryMB,allocationsPerCall\n");
+        printf("%d,%" PRIu64 ",%" PRIu64 ",%g,%" PRIu64 ",%.4f,%.4f,%.4f,%.4f,%.1f,%" PRIu64 ",%.2f\n",
+               config.m_deviceId, (uint64_t)r.m_batchSize, (uint64_t)r.m_numThreads, r.m_sparsity, (uint64_t)r.m_latenciesMs.size(),
+               r.Percentile(50), r.Percentile(90), r.Percentile(99), r.m_latenciesMs.back(), r.SamplesPerSec(),
+               (uint64_t)r.m_peakMemoryMB, r.AllocationsPerCall());
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        auto config = ParseCommandLine(argc, argv);
+
+        IEvaluateModelExtended<float>* model;
+        GetEvalExtendedF(&model);
+        string modelConfig = "deviceId=" + to_string(config.m_deviceId) + "\nmodelPath=\"" + config.m_modelPath + "\"\n" + config.m_evalConfig;
+        model->Init(modelConfig);
+        model->CreateNetwork(modelConfig);
+        if (config.m_outputNodeNames.empty())
+        {
+            for (const auto& layout : model->GetOutputSchema())
+                config.m_outputNodeNames.push_back(layout.m_name);
+        }
+
+        bool first = true;
+        for (auto numThreads : config.m_numThreads)
+        {
+            for (auto sparsity : config.m_sparsities)
+            {
+                for (auto batchSize : config.m_batchSizes)
+                {
+                    fprintf(stderr, "Running batchSize=%" PRIu64 " numThreads=%" PRIu64 " sparsity=%g\n", (uint64_t)batchSize, (uint64_t)numThreads, sparsity);
+                    Print(Run(model, config, batchSize, numThreads, sparsity), config, first);
+                    first = false;
+                }
+            }
+        }
+
+        model->Destroy();
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -6,6 +6,8 @@
 #include "EvalTestHelper.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <thread>
+#include <numeric>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -406,5 +408,416 @@ BOOST_AUTO_TEST_CASE(EvalRNNTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalSessionsTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    // Sessions share the parameters, but evaluate independently of each other
+    const size_t numSessions = 4;
+    std::vector<IEvaluateModelExtended<float>*> sessions;
+    for (size_t s = 0; s < numSessions; s++)
+    {
+        sessions.push_back(eval->CreateSession());
+        sessions.back()->StartForwardEvaluation({ outputLayouts[0].m_name });
+        BOOST_REQUIRE_EQUAL(sessions.back()->GetInputSchema().size(), inputLayouts.size());
+    }
+    eval->Destroy(); // the sessions keep the parameters alive
+
+    std::vector<std::vector<float>> results(numSessions);
+    std::vector<std::thread> threads;
+    for (size_t s = 0; s < numSessions; s++)
+    {
+        threads.emplace_back([&, s]()
+        {
+            Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+            Values<float> inputBuffer(1);
+            for (size_t n = 0; n < 100; n++)
+            {
+                float x = (float)(s + 1);
+                inputBuffer[0].m_buffer = { x, x, x, x };
+                sessions[s]->ForwardPass(inputBuffer, outputBuffer);
+                results[s].push_back(outputBuffer[0].m_buffer[0]);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t s = 0; s < numSessions; s++)
+    {
+        std::vector<float> expected(100, 8.0f * (s + 1));
+        BOOST_CHECK_EQUAL_COLLECTIONS(results[s].begin(), results[s].end(), expected.begin(), expected.end());
+        sessions[s]->Destroy();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EvalBoundBuffersTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+    BOOST_REQUIRE_EQUAL(outputLayouts.size(), 1);
+
+    // the memory is on the device of the model, so the network computes in it
+    std::vector<float> input(4 * 3);
+    std::vector<float> output(3, -1);
+    eval->BindInput(0, input.data(), -1, 3);
+    eval->BindOutput(0, output.data(), -1, 3);
+
+    std::vector<size_t> numOutputSamples(1);
+    input = { 1, 2, 3, 4, 0, 0, 0, 1, 2, 2, 2, 2 };
+    eval->ForwardPassBound(3, numOutputSamples, true);
+    BOOST_CHECK_EQUAL(numOutputSamples[0], 3);
+    std::vector<float> expected{ 20, 2, 16 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(output.begin(), output.end(), expected.begin(), expected.end());
+
+    // fewer samples in the same memory
+    input[0] = 3;
+    eval->ForwardPassBound(1, numOutputSamples, true);
+    BOOST_CHECK_EQUAL(numOutputSamples[0], 1);
+    BOOST_CHECK_EQUAL(output[0], 24);
+
+    // too many samples for the bound memory
+    BOOST_REQUIRE_THROW(eval->ForwardPassBound(4, numOutputSamples, true), std::exception);
+
+    // the regular path is unaffected
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 1, 1, 1, 1 };
+    eval->ForwardPass(inputBuffer, outputBuffer);
+    BOOST_CHECK_EQUAL(outputBuffer[0].m_buffer[0], 8);
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalStreamingTest)
+{
+    // running sum over the sequence
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "d1 = PastValue(1, o1, timeStep=1, defaultHiddenActivation=0) \n"
+        "o1 = Plus(i1, d1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    IEvaluateModelStreaming<float>* streaming;
+    GetEvalStreamingF(eval, 2, 0, &streaming);
+    size_t a = streaming->OpenStream();
+    size_t b = streaming->OpenStream();
+    BOOST_REQUIRE_THROW(streaming->OpenStream(), std::exception); // at most 2
+
+    auto forwardPass = [&](const std::vector<size_t>& streams, const std::vector<std::vector<float>>& chunks, const std::vector<bool>& endOfStream)
+    {
+        std::vector<Values<float>> inputs(streams.size(), Values<float>(1));
+        std::vector<Values<float>> outputs;
+        for (size_t r = 0; r < streams.size(); r++)
+        {
+            inputs[r][0].m_buffer = chunks[r];
+            outputs.push_back(outputLayouts.CreateBuffers<float>({ chunks[r].size() }));
+        }
+        streaming->ForwardPass(streams, inputs, outputs, endOfStream);
+        std::vector<std::vector<float>> results;
+        for (auto& output : outputs)
+            results.push_back(output[0].m_buffer);
+        return results;
+    };
+
+    auto results = forwardPass({ a, b }, { { 1, 2 }, { 10 } }, { false, false });
+    BOOST_CHECK((results[0] == std::vector<float>{ 1, 3 }));
+    BOOST_CHECK((results[1] == std::vector<float>{ 10 }));
+
+    // a stream keeps its state while it is not evaluated
+    results = forwardPass({ b }, { { 20, 30 } }, { false });
+    BOOST_CHECK((results[0] == std::vector<float>{ 30, 60 }));
+
+    results = forwardPass({ b, a }, { { 1 }, { 3 } }, { true, false });
+    BOOST_CHECK((results[0] == std::vector<float>{ 61 }));
+    BOOST_CHECK((results[1] == std::vector<float>{ 6 }));
+
+    // b is closed, a new stream starts from the initial state
+    size_t c = streaming->OpenStream();
+    results = forwardPass({ a, c }, { { 4 }, { 5 } }, { false, false });
+    BOOST_CHECK((results[0] == std::vector<float>{ 10 }));
+    BOOST_CHECK((results[1] == std::vector<float>{ 5 }));
+
+    streaming->Destroy();
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBeamSearchTest)
+{
+    // Tokens 0 = start, 1 = a, 2 = b, 3 = end. The score of the next token is the context, minus a penalty per
+    // occurrence of the token so far, which the recurrent state counts.
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "token = Input(4) \n"
+        "context = Input(4) \n"
+        "penalty = Input(4) \n"
+        "d1 = PastValue(4, counts, timeStep=1, defaultHiddenActivation=0) \n"
+        "counts = Plus(d1, token) \n"
+        "o1 = Minus(context, ElementTimes(penalty, counts), tag=\"output\") \n"
+        "FeatureNodes = (token) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+    BOOST_REQUIRE_EQUAL(inputLayouts.size(), 3);
+
+    IEvaluateModelBeamSearch<float>* beamSearch;
+    BOOST_REQUIRE_THROW(GetEvalBeamSearchF(eval, L"nonexistent", 2, 0, 3, 3, &beamSearch), std::exception);
+    GetEvalBeamSearchF(eval, L"token", /*beamWidth=*/2, /*startToken=*/0, /*endToken=*/3, /*maxLength=*/3, &beamSearch);
+
+    // the contexts in the order of the input schema
+    auto makeContext = [&](const std::vector<float>& context, const std::vector<float>& penalty)
+    {
+        Values<float> values;
+        for (const auto& layout : inputLayouts)
+        {
+            if (layout.m_name == L"token")
+                continue;
+            values.push_back(ValueBuffer<float, Vector>());
+            values.back().m_buffer = layout.m_name == L"context" ? context : penalty;
+        }
+        return values;
+    };
+    std::vector<Values<float>> contexts{
+        // a is best but penalized when repeated: the beams of the second step both continue the first beam
+        // (a, a and a, b), so the counts of the third step must be those of a, not of b
+        makeContext({ -100, -1, -3, -5 }, { 0, 0.5f, 0, 0 }),
+        // ending right away is best, then after b
+        makeContext({ -100, -3, -1, -0.5f }, { 0, 0, 0, 0 })
+    };
+
+    std::vector<std::vector<BeamSearchHypothesis>> results;
+    beamSearch->Decode(contexts, results);
+    BOOST_REQUIRE_EQUAL(results.size(), 2);
+
+    // cut off at the maximum length
+    BOOST_REQUIRE_EQUAL(results[0].size(), 2);
+    BOOST_CHECK((results[0][0].m_tokens == std::vector<size_t>{ 1, 1, 1 }));
+    BOOST_CHECK_CLOSE(results[0][0].m_score, -4.5, 1e-4);
+    BOOST_CHECK(!results[0][0].m_complete);
+    BOOST_CHECK((results[0][1].m_tokens == std::vector<size_t>{ 1, 1, 2 }));
+    BOOST_CHECK_CLOSE(results[0][1].m_score, -5.5, 1e-4);
+
+    BOOST_REQUIRE_EQUAL(results[1].size(), 2);
+    BOOST_CHECK(results[1][0].m_tokens.empty());
+    BOOST_CHECK_CLOSE(results[1][0].m_score, -0.5, 1e-4);
+    BOOST_CHECK(results[1][0].m_complete);
+    BOOST_CHECK((results[1][1].m_tokens == std::vector<size_t>{ 2 }));
+    BOOST_CHECK_CLOSE(results[1][1].m_score, -1.5, 1e-4);
+
+    // a sequence on its own decodes the same
+    std::vector<Values<float>> single{ contexts[1] };
+    beamSearch->Decode(single, results);
+    BOOST_REQUIRE_EQUAL(results.size(), 1);
+    BOOST_REQUIRE_EQUAL(results[0].size(), 2);
+    BOOST_CHECK(results[0][0].m_tokens.empty());
+    BOOST_CHECK((results[0][1].m_tokens == std::vector<size_t>{ 2 }));
+
+    beamSearch->Destroy();
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchingTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    // Requests of different lengths, evaluated in one minibatch
+    std::vector<Values<float>> inputs(3, Values<float>(1));
+    inputs[0][0].m_buffer = { 1, 1, 1, 1 };
+    inputs[1][0].m_buffer = { 1, 2, 3, 4, 0, 0, 0, 1 };
+    inputs[2][0].m_buffer = { 2, 2, 2, 2 };
+    std::vector<Values<float>> outputs;
+    for (size_t r = 0; r < inputs.size(); r++)
+        outputs.push_back(outputLayouts.CreateBuffers<float>({ 2 }));
+    eval->ForwardPassBatch(inputs, outputs);
+
+    std::vector<std::vector<float>> expected{ { 8 }, { 20, 2 }, { 16 } };
+    for (size_t r = 0; r < inputs.size(); r++)
+    {
+        auto buf = outputs[r][0].m_buffer;
+        BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected[r].begin(), expected[r].end());
+    }
+
+    // The same through the batching front-end
+    IEvaluateModelBatching<float>* batching;
+    GetEvalBatchingF(eval, 2, 1000, &batching);
+    std::vector<std::future<Values<float>>> results;
+    for (auto& input : inputs)
+        results.push_back(batching->Evaluate(Values<float>(input)));
+    for (size_t r = 0; r < inputs.size(); r++)
+    {
+        auto buf = results[r].get()[0].m_buffer;
+        BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected[r].begin(), expected[r].end());
+    }
+
+    auto statistics = batching->GetStatistics();
+    size_t numRequests = 0;
+    for (size_t n = 0; n < statistics.m_batchSizeHistogram.size(); n++)
+        numRequests += n * statistics.m_batchSizeHistogram[n];
+    BOOST_CHECK_EQUAL(numRequests, inputs.size());
+    BOOST_CHECK_EQUAL(std::accumulate(statistics.m_queueTimeHistogram.begin(), statistics.m_queueTimeHistogram.end(), (size_t)0), inputs.size());
+
+    batching->Destroy();
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalCudaGraphsTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    IEvaluateModelExtended<float>* eval;
+    GetEvalExtendedF(&eval);
+    eval->Init("cudaGraphs=true");
+    eval->CreateNetwork(modelDefinition);
+    eval->StartForwardEvaluation({ L"o1" });
+    auto outputLayouts = eval->GetOutputSchema();
+
+    // On the CPU this falls back to the normal forward pass; changing and repeating input shapes must give the same results.
+    std::vector<std::vector<float>> inputs{ { 1, 2, 3, 4 }, { 1, 1, 1, 1 }, { 1, 2, 3, 4, 0, 0, 0, 1 }, { 2, 2, 2, 2 } };
+    std::vector<std::vector<float>> expected{ { 20 }, { 8 }, { 20, 2 }, { 16 } };
+    for (size_t r = 0; r < inputs.size(); r++)
+    {
+        Values<float> inputBuffer(1);
+        inputBuffer[0].m_buffer = inputs[r];
+        Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 2 });
+        eval->ForwardPass(inputBuffer, outputBuffer);
+        auto buf = outputBuffer[0].m_buffer;
+        BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected[r].begin(), expected[r].end());
+    }
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalRegistryTest)
+{
+    auto modelDefinition = [](int c)
+    {
+        return "precision = \"float\" \n"
+               "traceLevel = 1 \n"
+               "run=NDLNetworkBuilder \n"
+               "NDLNetworkBuilder=[ \n"
+               "i1 = Input(4) \n"
+               "o1 = Times(Constant(" + std::to_string(c) + ", rows=1, cols=4), i1, tag=\"output\") \n"
+               "FeatureNodes = (i1) \n"
+               "] \n";
+    };
+
+    // The budget holds the parameters of one model
+    IEvaluateModelRegistry<float>* registry;
+    GetEvalRegistryF(-1, 4 * sizeof(float), &registry);
+    registry->AddModel(L"two", modelDefinition(2), {});
+    registry->AddModel(L"three", modelDefinition(3), {});
+
+    auto evaluate = [&](const std::wstring& name)
+    {
+        auto eval = registry->Acquire(name);
+        Values<float> outputBuffer = eval->GetOutputSchema().CreateBuffers<float>({ 1 });
+        Values<float> inputBuffer(1);
+        inputBuffer[0].m_buffer = { 1, 1, 1, 1 };
+        eval->ForwardPass(inputBuffer, outputBuffer);
+        registry->Release(name);
+        return outputBuffer[0].m_buffer[0];
+    };
+    auto usageOf = [&](const std::wstring& name)
+    {
+        for (const auto& usage : registry->GetUsage())
+            if (usage.m_name == name)
+                return usage;
+        BOOST_FAIL("no usage reported");
+        return ModelUsage();
+    };
+
+    BOOST_CHECK(!usageOf(L"two").m_resident && !usageOf(L"three").m_resident);
+    BOOST_CHECK_EQUAL(usageOf(L"two").m_parameterBytes, 4 * sizeof(float));
+
+    BOOST_CHECK_EQUAL(evaluate(L"two"), 8);
+    BOOST_CHECK_EQUAL(evaluate(L"two"), 8);
+    BOOST_CHECK(usageOf(L"two").m_resident);
+    BOOST_CHECK_EQUAL(usageOf(L"two").m_numPageIns, 1);
+    BOOST_CHECK_EQUAL(usageOf(L"two").m_numAcquisitions, 2);
+
+    // "three" evicts "two"
+    BOOST_CHECK_EQUAL(evaluate(L"three"), 12);
+    BOOST_CHECK(!usageOf(L"two").m_resident && usageOf(L"three").m_resident);
+
+    // An acquired model is not evicted, even beyond the budget
+    registry->Acquire(L"three");
+    BOOST_CHECK_EQUAL(evaluate(L"two"), 8);
+    BOOST_CHECK(usageOf(L"two").m_resident && usageOf(L"three").m_resident);
+    BOOST_CHECK_EQUAL(usageOf(L"two").m_numPageIns, 2);
+    registry->Release(L"three");
+
+    registry->RemoveModel(L"three");
+    BOOST_CHECK_EQUAL(registry->GetUsage().size(), 1);
+    registry->Destroy();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
@@ -0,0 +1,457 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MathBenchmarks.cpp -- microbenchmarks of the Math library kernels with regression baselines
+//
+#include "stdafx.h"
+#include "MathBenchmarks.h"
+#include "Basics.h"
+#include "Matrix.h"
+#include "TensorView.h"
+#include "ConvolveGeometry.h"
+#include "ConvolutionEngine.h"
+#include "BatchNormalizationEngine.h"
+#include "CuDnnFactories.h"
+#include "../../../Source/Math/MatrixQuantizerImpl.h"
+#include "../../../Source/Math/CUDAPageLockedMemAllocator.h"
+#include "../Common/BenchmarkHelper.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct BenchmarkCase
+{
+    string m_name;
+    double m_flops; // per call, 0 if not meaningful
+    double m_bytes; // minimum memory traffic per call
+    // Allocates and initializes the operands, and returns the call to time. Throws if the case is not supported
+    // on the device (e.g. a convolution engine that does not handle the geometry), in which case it is skipped.
+    function<function<void()>()> m_prepare;
+};
+
+struct BenchmarkResult
+{
+    double m_milliseconds;
+    double m_gflops;
+    double m_gbytesPerSecond;
+};
+
+template <class ElemType>
+static shared_ptr<Matrix<ElemType>> RandomMatrix(size_t rows, size_t cols, DEVICEID_TYPE deviceId)
+{
+    return make_shared<Matrix<ElemType>>(Matrix<ElemType>::RandomUniform(rows, cols, deviceId, -1, 1, 1));
+}
+
+template <class Dims>
+static string ShapeName(const Dims& dims)
+{
+    string name;
+    for (size_t dim : dims)
+        name += (name.empty() ? "" : "x") + to_string(dim);
+    return name;
+}
+
+static string ShapeName(initializer_list<size_t> dims)
+{
+    return ShapeName(vector<size_t>(dims));
+}
+
+// -----------------------------------------------------------------------
+// cases
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static void AddGemmCases(vector<BenchmarkCase>& cases, DEVICEID_TYPE deviceId)
+{
+    struct Shape { size_t m, k, n; bool transposeA, transposeB; };
+    // square ones, and the forward (W x), backward (W' g) and weight gradient (g x') products of a
+    // 1024 x 1024 layer at minibatch 256, and of a small layer at a small minibatch
+    for (const auto& s : vector<Shape>{ { 512, 512, 512, false, false }, { 2048, 2048, 2048, false, false },
+                                        { 1024, 1024, 256, false, false }, { 1024, 1024, 256, true, false }, { 1024, 256, 1024, false, true },
+                                        { 4096, 1024, 256, false, false }, { 256, 256, 32, false, false } })
+    {
+        string name = string("gemm/") + (s.transposeA ? "T" : "N") + (s.transposeB ? "T" : "N") + "/" + ShapeName({ s.m, s.k, s.n });
+        cases.push_back({ name, 2.0 * s.m * s.k * s.n, (double) sizeof(ElemType) * (s.m * s.k + s.k * s.n + s.m * s.n), [=]()
+        {
+            auto a = s.transposeA ? RandomMatrix<ElemType>(s.k, s.m, deviceId) : RandomMatrix<ElemType>(s.m, s.k, deviceId);
+            auto b = s.transposeB ? RandomMatrix<ElemType>(s.n, s.k, deviceId) : RandomMatrix<ElemType>(s.k, s.n, deviceId);
+            auto c = make_shared<Matrix<ElemType>>(s.m, s.n, deviceId);
+            return function<void()>([=]() { Matrix<ElemType>::MultiplyAndWeightedAdd(1, *a, s.transposeA, *b, s.transposeB, 0, *c); });
+        } });
+    }
+}
+
+template <class ElemType>
+static void AddTensorOpCases(vector<BenchmarkCase>& cases, DEVICEID_TYPE deviceId)
+{
+    const size_t rows = 2048, cols = 2048, n = rows * cols;
+    const double e = sizeof(ElemType);
+    const TensorShape shape(rows, cols), columnShape(rows, 1), scalarShape(1);
+
+    typedef function<void(TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>& b)> Op;
+    struct TensorCase { const char* name; TensorShape bShape, cShape; double flops, bytes; Op op; };
+    vector<TensorCase> tensorCases =
+    {
+        // elementwise
+        { "sum",     shape,       shape,       (double) n, 3 * e * n, [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>& b) { c.DoSumOf(0, a, b, 1); } },
+        { "product", shape,       shape,       (double) n, 3 * e * n, [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>& b) { c.DoElementwiseProductOf(0, a, b, 1); } },
+        { "sigmoid", shape,       shape,       (double) n, 2 * e * n, [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>&)  { c.DoSigmoidOf(0, a, 1); } },
+        { "bias",    columnShape, shape,       (double) n, 2 * e * n, [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>& b) { c.DoSumOf(0, a, b, 1); } },
+        // reductions
+        { "reduce/columns", shape, columnShape, (double) n, e * n,    [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>&)  { c.DoCopyOf(0, a, 1); } },
+        { "reduce/sum",     shape, scalarShape, (double) n, e * n,    [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>&)  { c.DoCopyOf(0, a, 1); } },
+        { "reduce/max",     shape, scalarShape, (double) n, e * n,    [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>&)  { c.DoUnaryOpOf(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opMax); } },
+    };
+
+    for (const auto& t : tensorCases)
+    {
+        cases.push_back({ string("tensor/") + t.name + "/" + ShapeName({ rows, cols }), t.flops, t.bytes, [=]()
+        {
+            TensorView<ElemType> a(RandomMatrix<ElemType>(n, 1, deviceId), shape);
+            TensorView<ElemType> b(RandomMatrix<ElemType>(t.bShape.GetNumElements(), 1, deviceId), t.bShape);
+            TensorView<ElemType> c(make_shared<Matrix<ElemType>>(t.cShape.GetNumElements(), 1, deviceId), t.cShape);
+            auto op = t.op;
+            return function<void()>([=]() mutable { op(c, a, b); });
+        } });
+    }
+}
+
+static const char* ConvolutionEngineName(ConvolutionEngineKind kind)
+{
+    switch (kind)
+    {
+    case ConvolutionEngineKind::CuDnn:    return "cudnn";
+    case ConvolutionEngineKind::Gemm:     return "gemm";
+    case ConvolutionEngineKind::Winograd: return "winograd";
+    case ConvolutionEngineKind::FFT:      return "fft";
+    default:
+        LogicError("Unexpected convolution engine kind %d.", (int) kind);
+    }
+}
+
+template <class ElemType>
+static void AddConvolutionCases(vector<BenchmarkCase>& cases, DEVICEID_TYPE deviceId)
+{
+    // typical layers of image classification networks; the reference and legacy engines are left out, the one being
+    // meant for correctness only, the other requiring the legacy HWC layout
+    struct Layer { size_t w, h, c, kernel, maps, stride, batch; };
+    const size_t e = sizeof(ElemType);
+    for (const auto& l : vector<Layer>{ { 56, 56, 64, 3, 64, 1, 32 }, { 14, 14, 256, 3, 256, 1, 32 }, { 28, 28, 256, 1, 128, 1, 32 },
+                                        { 56, 56, 32, 7, 32, 1, 16 }, { 224, 224, 3, 7, 64, 2, 16 } })
+    {
+        auto geometry = make_shared<ConvolveGeometry>(TensorShape(l.w, l.h, l.c), TensorShape(l.kernel, l.kernel, l.c), TensorShape(l.maps),
+                                                      TensorShape(l.stride, l.stride, l.c), ConvolveGeometry::BoolVec{ true },
+                                                      ConvolveGeometry::BoolVec{ true, true, false }, TensorShape(0), TensorShape(0));
+        size_t inputSize = geometry->InputShape().GetNumElements();
+        size_t outputSize = geometry->OutputShape().GetNumElements();
+        size_t kernelSize = geometry->KernelShape().GetNumElements();
+        double flops = 2.0 * outputSize * kernelSize * l.batch;
+        double bytes = (double) e * ((inputSize + outputSize) * l.batch + kernelSize * l.maps);
+        string layerName = ShapeName({ l.w, l.h, l.c }) + "/k" + to_string(l.kernel) + "s" + to_string(l.stride) + "m" + to_string(l.maps) + "b" + to_string(l.batch);
+
+        for (auto kind : { ConvolutionEngineKind::CuDnn, ConvolutionEngineKind::Gemm, ConvolutionEngineKind::Winograd, ConvolutionEngineKind::FFT })
+        {
+            for (int pass = 0; pass < 3; pass++)
+            {
+                static const char* passNames[] = { "forward", "backwardData", "backwardKernel" };
+                string name = string("conv/") + layerName + "/" + ConvolutionEngineName(kind) + "/" + passNames[pass];
+                cases.push_back({ name, flops, bytes, [=]()
+                {
+                    shared_ptr<ConvolutionEngine<ElemType>> engine = ConvolutionEngine<ElemType>::Create(geometry, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, kind);
+                    auto in = RandomMatrix<ElemType>(inputSize, l.batch, deviceId);
+                    auto kernel = RandomMatrix<ElemType>(l.maps, kernelSize, deviceId);
+                    auto out = RandomMatrix<ElemType>(outputSize, l.batch, deviceId);
+                    auto workspace = make_shared<Matrix<ElemType>>(deviceId);
+                    switch (pass)
+                    {
+                    case 0:  return function<void()>([=]() { engine->Forward(*in, *kernel, *out, *workspace); });
+                    case 1:  return function<void()>([=]() { engine->BackwardData(*out, *kernel, *in, false, *workspace); });
+                    default: return function<void()>([=]() { engine->BackwardKernel(*out, *in, *kernel, false, false, *workspace); });
+                    }
+                } });
+            }
+        }
+    }
+}
+
+template <class ElemType>
+static void AddBatchNormalizationCases(vector<BenchmarkCase>& cases, DEVICEID_TYPE deviceId)
+{
+    // a convolutional (spatial) and a fully connected layer
+    struct Layer { TensorShape shape; bool spatial; size_t batch; };
+    const double e = sizeof(ElemType);
+    for (const auto& l : vector<Layer>{ { TensorShape(56, 56, 64), true, 32 }, { TensorShape(2048), false, 256 } })
+    {
+        size_t size = l.shape.GetNumElements();
+        size_t statisticsSize = l.spatial ? l.shape[2] : size;
+        double n = (double) size * l.batch;
+        for (auto kind : { BatchNormEngineKind::Cntk, BatchNormEngineKind::CuDnn })
+        {
+            for (bool isBackward : { false, true })
+            {
+                string name = string("batchnorm/") + ShapeName(l.shape.GetDims()) + (l.spatial ? "/spatial" : "") + "/b" + to_string(l.batch) +
+                              "/" + (kind == BatchNormEngineKind::Cntk ? "cntk" : "cudnn") + "/" + (isBackward ? "backward" : "forward");
+                // forward reads the input for the statistics and again to normalize it; backward reads the input and the
+                // gradient for the statistics gradients and again for the input gradient (the FLOPs are approximate)
+                cases.push_back({ name, (isBackward ? 8 : 5) * n, (isBackward ? 5 : 3) * e * n, [=]()
+                {
+                    shared_ptr<BatchNormEngine<ElemType>> engine = BatchNormEngine<ElemType>::Create(deviceId, l.shape, l.spatial, ImageLayoutKind::CHW, kind);
+                    auto in = RandomMatrix<ElemType>(size, l.batch, deviceId);
+                    auto out = RandomMatrix<ElemType>(size, l.batch, deviceId);
+                    auto grad = RandomMatrix<ElemType>(size, l.batch, deviceId);
+                    auto scale = RandomMatrix<ElemType>(statisticsSize, 1, deviceId);
+                    auto bias = RandomMatrix<ElemType>(statisticsSize, 1, deviceId);
+                    auto runMean = RandomMatrix<ElemType>(statisticsSize, 1, deviceId);
+                    auto runVariance = RandomMatrix<ElemType>(statisticsSize, 1, deviceId);
+                    auto saveMean = RandomMatrix<ElemType>(statisticsSize, 1, deviceId);
+                    auto saveInvStdDev = RandomMatrix<ElemType>(statisticsSize, 1, deviceId);
+                    auto scaleGrad = RandomMatrix<ElemType>(statisticsSize, 1, deviceId);
+                    auto biasGrad = RandomMatrix<ElemType>(statisticsSize, 1, deviceId);
+                    auto forward = [=]() { engine->Forward(*in, *scale, *bias, false, 0.1, 0, *runMean, *runVariance, *out, 1e-5, *saveMean, *saveInvStdDev); };
+                    if (!isBackward)
+                        return function<void()>(forward);
+                    forward(); // the saved statistics
+                    return function<void()>([=]() { engine->Backward(*in, *out, *grad, *scale, 0, *saveMean, *saveInvStdDev, *scaleGrad, *biasGrad); });
+                } });
+            }
+        }
+    }
+}
+
+template <class ElemType>
+static void AddSparseCases(vector<BenchmarkCase>& cases, DEVICEID_TYPE deviceId)
+{
+    // embedding of one-hot and bag-of-words inputs: the forward product W x and the weight gradient g x'
+    const size_t vocabulary = 65536, hidden = 512, batch = 256;
+    const double e = sizeof(ElemType);
+    for (size_t wordsPerSample : { 1, 32 })
+    {
+        double nnz = (double) wordsPerSample * batch;
+        for (bool isGradient : { false, true })
+        {
+            string name = string("sparse/") + (wordsPerSample == 1 ? "onehot" : "bow" + to_string(wordsPerSample)) + "/" +
+                          ShapeName({ hidden, vocabulary, batch }) + "/" + (isGradient ? "gradient" : "forward");
+            // only the touched rows of W are read (and written by the gradient)
+            cases.push_back({ name, 2 * hidden * nnz, e * (hidden * nnz * (isGradient ? 2 : 1) + hidden * batch) + nnz * (e + sizeof(CPUSPARSE_INDEX_TYPE)), [=]()
+            {
+                vector<CPUSPARSE_INDEX_TYPE> columnStarts(batch + 1), rowIndices((size_t) nnz);
+                vector<ElemType> values((size_t) nnz, 1);
+                for (size_t j = 0; j <= batch; j++)
+                    columnStarts[j] = (CPUSPARSE_INDEX_TYPE) (j * wordsPerSample);
+                for (size_t i = 0; i < rowIndices.size(); i++) // distinct and sorted within a column
+                    rowIndices[i] = (CPUSPARSE_INDEX_TYPE) (((i / wordsPerSample) * 7919 + (i % wordsPerSample) * (vocabulary / wordsPerSample)) % vocabulary);
+                for (size_t j = 0; j < batch; j++)
+                    sort(rowIndices.begin() + columnStarts[j], rowIndices.begin() + columnStarts[j + 1]);
+                auto x = make_shared<Matrix<ElemType>>(vocabulary, batch, deviceId, MatrixType::SPARSE, matrixFormatSparseCSC);
+                x->SetMatrixFromCSCFormat(columnStarts.data(), rowIndices.data(), values.data(), (size_t) nnz, vocabulary, batch);
+                auto w = RandomMatrix<ElemType>(hidden, vocabulary, deviceId);
+                auto h = RandomMatrix<ElemType>(hidden, batch, deviceId);
+                if (isGradient)
+                    return function<void()>([=]() { Matrix<ElemType>::MultiplyAndWeightedAdd(1, *h, false, *x, true, 1, *w); });
+                return function<void()>([=]() { Matrix<ElemType>::MultiplyAndWeightedAdd(1, *w, false, *x, false, 0, *h); });
+            } });
+        }
+    }
+}
+
+template <class ElemType>
+static void AddQuantizerCases(vector<BenchmarkCase>& cases, DEVICEID_TYPE deviceId)
+{
+    // gradient quantization as done by the data-parallel SGD, into a (page-locked) host buffer and back
+    const size_t rows = 1024, cols = 1024, n = rows * cols;
+    const double e = sizeof(ElemType);
+    for (size_t bits : { 1, 8 })
+    {
+        for (bool isUnquantize : { false, true })
+        {
+            string name = "quantizer/" + to_string(bits) + "bit/" + ShapeName({ rows, cols }) + "/" + (isUnquantize ? "unquantize" : "quantize");
+            double quantizedBytes = (double) n * bits / 8;
+            cases.push_back({ name, 0, isUnquantize ? e * n + quantizedBytes : 3 * e * n + quantizedBytes, [=]()
+            {
+                shared_ptr<MemAllocator> allocator(deviceId == CPUDEVICE ? nullptr : new CUDAPageLockedMemAllocator(deviceId));
+                shared_ptr<MatrixQuantizerImpl<ElemType>> quantizer(MatrixQuantizerImpl<ElemType>::Create(deviceId, false /*useAsync*/));
+                auto quantized = make_shared<QuantizedMatrix<ElemType>>(rows, cols, bits, CPUDEVICE, allocator.get());
+                auto in = RandomMatrix<ElemType>(rows, cols, deviceId);
+                auto residual = make_shared<Matrix<ElemType>>(rows, cols, deviceId);
+                residual->SetValue(0);
+                quantizer->QuantizeAsync(*in, *residual, *quantized, *residual, false);
+                quantizer->WaitQuantizeAsyncDone();
+                if (isUnquantize)
+                    return function<void()>([=]() { quantizer->UnquantizeAsync(*quantized, *in, false); quantizer->WaitUnquantizeAsyncDone(); UNUSED(allocator); });
+                return function<void()>([=]() { quantizer->QuantizeAsync(*in, *residual, *quantized, *residual, false); quantizer->WaitQuantizeAsyncDone(); UNUSED(allocator); });
+            } });
+        }
+    }
+}
+
+template <class ElemType>
+static void AddTransferCases(vector<BenchmarkCase>& cases, DEVICEID_TYPE deviceId)
+{
+    if (deviceId == CPUDEVICE)
+        return;
+
+    const size_t rows = 4096, cols = 4096;
+    const double bytes = (double) sizeof(ElemType) * rows * cols;
+    for (bool isPinned : { false, true })
+    {
+        for (bool isToDevice : { true, false })
+        {
+            string name = string("transfer/") + (isToDevice ? "hostToDevice/" : "deviceToHost/") + (isPinned ? "pinned/" : "pageable/") + ShapeName({ rows, cols });
+            cases.push_back({ name, 0, bytes, [=]()
+            {
+                shared_ptr<ElemType> host(isPinned ? (ElemType*) CUDAPageLockedMemAllocator::Malloc((size_t) bytes, deviceId) : new ElemType[rows * cols],
+                                          [=](ElemType* p) { if (isPinned) CUDAPageLockedMemAllocator::Free(p, deviceId); else delete[] p; });
+                fill(host.get(), host.get() + rows * cols, (ElemType) 1);
+                auto device = RandomMatrix<ElemType>(rows, cols, deviceId);
+                if (isToDevice)
+                    return function<void()>([=]() { device->SetValue(rows, cols, deviceId, host.get()); });
+                return function<void()>([=]() { device->CopySection(rows, cols, host.get(), rows); });
+            } });
+        }
+    }
+    cases.push_back({ "transfer/deviceToDevice/" + ShapeName({ rows, cols }), 0, 2 * bytes, [=]()
+    {
+        auto from = RandomMatrix<ElemType>(rows, cols, deviceId);
+        auto to = make_shared<Matrix<ElemType>>(rows, cols, deviceId);
+        return function<void()>([=]() { to->AssignValuesOf(*from); });
+    } });
+}
+
+template <class ElemType>
+static vector<BenchmarkCase> GetBenchmarkCases(DEVICEID_TYPE deviceId)
+{
+    vector<BenchmarkCase> cases;
+    AddGemmCases<ElemType>(cases, deviceId);
+    AddTensorOpCases<ElemType>(cases, deviceId);
+    AddConvolutionCases<ElemType>(cases, deviceId);
+    AddBatchNormalizationCases<ElemType>(cases, deviceId);
+    AddSparseCases<ElemType>(cases, deviceId);
+    AddQuantizerCases<ElemType>(cases, deviceId);
+    AddTransferCases<ElemType>(cases, deviceId);
+    return cases;
+}
+
+// -----------------------------------------------------------------------
+// timing
+// -----------------------------------------------------------------------
+
+// Milliseconds of 'numCalls' calls. GPU work is timed with events on the compute stream, like the per-node timing of
+// the network; the operations that copy to the host (transfers, quantizers) wait for that themselves.
+static double TimeCalls(DEVICEID_TYPE deviceId, const function<void()>& call, size_t numCalls)
+{
+    if (deviceId == CPUDEVICE)
+    {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < numCalls; i++)
+            call();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    CudaTimer timer;
+    timer.Start();
+    for (size_t i = 0; i < numCalls; i++)
+        call();
+    timer.Stop();
+    return timer.Elapsed();
+}
+
+static BenchmarkResult RunBenchmarkCase(DEVICEID_TYPE deviceId, const BenchmarkCase& benchmarkCase, size_t numSamples)
+{
+    auto call = benchmarkCase.m_prepare();
+
+    // Warm up (this also runs the algorithm selection of cuDNN), and batch short calls so that a sample is long
+    // enough for the timer.
+    const double minSampleMilliseconds = 1;
+    double warmupMilliseconds = TimeCalls(deviceId, call, 1);
+    size_t callsPerSample = (size_t) max(1.0, min(1000.0, ceil(minSampleMilliseconds / max(warmupMilliseconds, 1e-3))));
+
+    vector<double> samples;
+    for (size_t i = 0; i < numSamples; i++)
+        samples.push_back(TimeCalls(deviceId, call, callsPerSample) / callsPerSample);
+    nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+
+    BenchmarkResult result;
+    result.m_milliseconds = samples[samples.size() / 2];
+    result.m_gflops = benchmarkCase.m_flops / result.m_milliseconds * 1e-6;
+    result.m_gbytesPerSecond = benchmarkCase.m_bytes / result.m_milliseconds * 1e-6;
+    return result;
+}
+
+// -----------------------------------------------------------------------
+// driver
+// -----------------------------------------------------------------------
+
+static const char* s_csvHeader = "name,device,precision,milliseconds,gflops,gbytesPerSecond";
+
+template <class ElemType>
+static void RunBenchmarks(DEVICEID_TYPE deviceId, const string& filter, size_t numSamples, BenchmarkReport& report)
+{
+    const char* precision = sizeof(ElemType) == sizeof(float) ? "float" : "double";
+    string device = deviceId == CPUDEVICE ? "cpu" : "gpu" + to_string(deviceId);
+    for (const auto& benchmarkCase : GetBenchmarkCases<ElemType>(deviceId))
+    {
+        if (benchmarkCase.m_name.find(filter) == string::npos)
+            continue;
+
+        BenchmarkResult result;
+        try
+        {
+            result = RunBenchmarkCase(deviceId, benchmarkCase, numSamples);
+        }
+        catch (const exception& e)
+        {
+            report.Skip(benchmarkCase.m_name, device, e);
+            continue;
+        }
+
+        char line[1024];
+        sprintf(line, "%s,%s,%s,%.4f,%.2f,%.2f", benchmarkCase.m_name.c_str(), device.c_str(), precision,
+                result.m_milliseconds, result.m_gflops, result.m_gbytesPerSecond);
+        report.Add(line);
+    }
+}
+
+int RunMathBenchmarks(const vector<string>& args)
+{
+    string filter;
+    size_t numSamples = 10;
+    auto options = ParseBenchmarkOptions("MathBenchmarks", args, 0.1, [&](const string& option, const string& value)
+    {
+        if (option == "--filter")
+            filter = value;
+        else if (option == "--samples")
+            numSamples = (size_t) stoul(value);
+        else
+            return false;
+        return true;
+    });
+    if (numSamples == 0)
+        InvalidArgument("MathBenchmarks: The number of samples must be positive.");
+
+    // results by "name,device,precision", compared by the time
+    BenchmarkReport report("MathBenchmarks", s_csvHeader, 3, false, "ms");
+    if (!options.m_baselinePath.empty())
+        report.ReadBaseline(options.m_baselinePath);
+
+    report.PrintHeader();
+    for (DEVICEID_TYPE deviceId : options.m_deviceIds)
+    {
+        if (options.RunFloat())
+            RunBenchmarks<float>(deviceId, filter, numSamples, report);
+        if (options.RunDouble())
+            RunBenchmarks<double>(deviceId, filter, numSamples, report);
+    }
+
+    if (!options.m_outputPath.empty())
+        report.WriteOutput(options.m_outputPath);
+    return report.CompareToBaseline(options.m_tolerance) > 0 ? 1 : 0;
+}
+
+}}}
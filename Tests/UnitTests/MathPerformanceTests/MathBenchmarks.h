@@ -0,0 +1,38 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MathBenchmarks.h -- microbenchmarks of the Math library kernels with regression baselines
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Runs the benchmark suite: GEMM shapes, TensorOp elementwise ops and reductions, convolution per
+// ConvolutionEngineKind, batch normalization per engine, sparse products, gradient quantizers and
+// host/device transfers, on each requested device and precision.
+//
+// Every case is warmed up once (which also lets cuDNN pick its algorithms) and then timed over a
+// number of samples, of which the median is reported as CSV:
+//     name,device,precision,milliseconds,gflops,gbytesPerSecond
+// FLOPs and bytes are analytical (the minimum work and memory traffic of the operation), so the
+// rates can be compared against the peak of the device. An output file can serve as the baseline
+// of a later run, which then reports each case that got slower by more than the tolerance.
+//
+// Options:
+//     --device <ids>          comma-separated device ids, -1 = CPU (default: -1)
+//     --precision <p>         float, double or all (default: float)
+//     --filter <substring>    run only the cases whose name contains this
+//     --samples <n>           timed samples per case (default: 10)
+//     --output <file>         also write the results to this CSV file
+//     --baseline <file>       compare against the results of an earlier run
+//     --tolerance <fraction>  allowed slowdown against the baseline (default: 0.1)
+//
+// Returns 0, or 1 if a case regressed against the baseline.
+int RunMathBenchmarks(const std::vector<std::string>& args);
+
+}}}
@@ -10,9 +10,13 @@
 #include "Matrix.h"
 #include "CPUMatrix.h"
 #include "TensorView.h"
+#include "CPUVectorKernels.h"
 #include "Sequences.h"
+#include "MathBenchmarks.h"
 #include <chrono>
+#include <functional>
 #include <iostream>
+#include <random>
 #include <vector>
 #include <algorithm>
 
@@ -279,6 +283,154 @@ struct TensorTest
     }
 };
 
+// times the common CPU tensor operations with the generic loops and with the vector kernels of each instruction set
+// up to the one of this CPU, and checks that the results agree
+template <class ElemType>
+void CPUTensorOpKernelTest(size_t rows, size_t cols, int count)
+{
+    cout << "Testing CPU tensor operations on [" << rows << " x " << cols << "], vector kernels up to " << ToString(GetCPUVectorInstructionSet()) << endl;
+
+    let numElements = rows * cols;
+    mt19937 rng(1);
+    uniform_real_distribution<float> nd(-1, 1);
+    vector<ElemType> init(numElements);
+    generate(begin(init), end(init), [&] { return nd(rng); });
+
+    let shape = TensorShape(rows, cols);
+    let biasShape = TensorShape(rows, 1);
+    let scalarShape = TensorShape(1, 1);
+    auto a = TensorView<ElemType>(make_shared<Matrix<ElemType>>(numElements, 1, init.data(), CPUDEVICE), shape);
+    reverse(init.begin(), init.end());
+    auto b = TensorView<ElemType>(make_shared<Matrix<ElemType>>(numElements, 1, init.data(), CPUDEVICE), shape);
+    auto bias = TensorView<ElemType>(make_shared<Matrix<ElemType>>(rows, 1, init.data(), CPUDEVICE), biasShape);
+
+    struct Case
+    {
+        const char* name;
+        TensorShape resultShape;
+        function<void(TensorView<ElemType>&)> fn;
+    };
+    vector<Case> cases =
+    {
+        { "c = a + b",               shape,       [&](TensorView<ElemType>& c) { c.DoSumOf(0, a, b, 1); } },
+        { "c = a + bias",            shape,       [&](TensorView<ElemType>& c) { c.DoSumOf(0, a, bias, 1); } },
+        { "c += a .* b",             shape,       [&](TensorView<ElemType>& c) { c.DoElementwiseProductOf(1, a, b, 1); } },
+        { "c = ReLU(a)",             shape,       [&](TensorView<ElemType>& c) { c.DoLinearRectifierOf(0, a, 1); } },
+        { "bias gradient",           biasShape,   [&](TensorView<ElemType>& c) { c.DoCopyOf(0, a, 1); } },
+        { "sum of squares",          scalarShape, [&](TensorView<ElemType>& c) { c.DoSqrOf(0, a, 1); } },
+        { "max",                     scalarShape, [&](TensorView<ElemType>& c) { c.DoUnaryOpOf(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opMax); } },
+    };
+
+    let maxInstructionSet = GetCPUVectorInstructionSet();
+    for (auto& test : cases)
+    {
+        shared_ptr<Matrix<ElemType>> reference;
+        for (int instructionSet = (int) CPUVectorInstructionSet::None; instructionSet <= (int) maxInstructionSet; instructionSet++)
+        {
+            SetMaxCPUVectorInstructionSet((CPUVectorInstructionSet) instructionSet);
+            let resultElements = test.resultShape.GetNumElements();
+            let sob = make_shared<Matrix<ElemType>>(resultElements, 1, CPUDEVICE);
+            sob->SetValue(0);
+            auto c = TensorView<ElemType>(sob, test.resultShape);
+
+            test.fn(c); // warm-up
+            sob->SetValue(0);
+            auto t_start = chrono::high_resolution_clock::now();
+            for (int i = 0; i < count; ++i)
+                test.fn(c);
+            auto t_end = chrono::high_resolution_clock::now();
+            let ms = chrono::duration<double, milli>(t_end - t_start).count() / count;
+
+            bool isSame = true;
+            if (!reference)
+                reference = sob;
+            else
+                isSame = reference->IsEqualTo(*sob, (ElemType) 1e-5);
+            cout << "   " << test.name << " [" << ToString((CPUVectorInstructionSet) instructionSet) << "]: " << ms << " ms" << (isSame ? "" : " --> FAILED (results differ from generic loops)") << endl;
+        }
+    }
+    SetMaxCPUVectorInstructionSet(maxInstructionSet);
+}
+
+// times GPU tensor operations on the shapes that dominate ResNet and LSTM training, and checks them against the CPU
+// These cover the kernel variants of GPUTensor.cu: contiguous (float4), two-dimensional broadcasting, and the
+// parallel reductions over rows, over columns and over all elements.
+template <class ElemType>
+void GPUTensorOpShapeTest(DEVICEID_TYPE deviceId, int count)
+{
+    struct Shape
+    {
+        const char* name;
+        TensorShape shape;     // of the operands
+        TensorShape biasShape; // broadcast along the other dimensions
+    };
+    vector<Shape> shapes =
+    {
+        { "ResNet conv output [56 x 56 x 64 x 32]", TensorShape(56, 56, 64, 32), TensorShape(1, 1, 64, 1) },
+        { "ResNet conv output [7 x 7 x 512 x 32]",  TensorShape(7, 7, 512, 32),  TensorShape(1, 1, 512, 1) },
+        { "LSTM gates [2048 x 32]",                 TensorShape(2048, 32),       TensorShape(2048, 1) },
+        { "LSTM cell [512 x 32]",                   TensorShape(512, 32),        TensorShape(512, 1) },
+        { "LSTM cell, odd minibatch [512 x 7]",     TensorShape(512, 7),         TensorShape(512, 1) },
+    };
+
+    for (const auto& s : shapes)
+    {
+        cout << "Testing GPU tensor operations on " << s.name << endl;
+        let numElements = s.shape.GetNumElements();
+        let biasElements = s.biasShape.GetNumElements();
+        mt19937 rng(1);
+        uniform_real_distribution<float> nd(-1, 1);
+        vector<ElemType> init(numElements);
+        generate(begin(init), end(init), [&] { return nd(rng); });
+
+        struct Case
+        {
+            const char* name;
+            TensorShape resultShape;
+            function<void(TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>& b, TensorView<ElemType>& bias)> fn;
+        };
+        let scalarShape = TensorShape(1);
+        vector<Case> cases =
+        {
+            { "c = a + b",     s.shape,     [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>& b, TensorView<ElemType>&) { c.DoSumOf(0, a, b, 1); } },
+            { "c = a + bias",  s.shape,     [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>&, TensorView<ElemType>& bias) { c.DoSumOf(0, a, bias, 1); } },
+            { "c = ReLU(a)",   s.shape,     [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>&, TensorView<ElemType>&) { c.DoLinearRectifierOf(0, a, 1); } },
+            { "bias gradient", s.biasShape, [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>&, TensorView<ElemType>&) { c.DoCopyOf(0, a, 1); } },
+            { "sum of all",    scalarShape, [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>&, TensorView<ElemType>&) { c.DoCopyOf(0, a, 1); } },
+            { "max of all",    scalarShape, [](TensorView<ElemType>& c, TensorView<ElemType>& a, TensorView<ElemType>&, TensorView<ElemType>&) { c.DoUnaryOpOf(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opMax); } },
+        };
+
+        for (auto& test : cases)
+        {
+            vector<shared_ptr<Matrix<ElemType>>> results;
+            double ms = 0;
+            for (DEVICEID_TYPE device : { (DEVICEID_TYPE) CPUDEVICE, deviceId })
+            {
+                auto a = TensorView<ElemType>(make_shared<Matrix<ElemType>>(numElements, 1, init.data(), device), s.shape);
+                auto b = TensorView<ElemType>(make_shared<Matrix<ElemType>>(numElements, 1, init.data(), device), s.shape);
+                auto bias = TensorView<ElemType>(make_shared<Matrix<ElemType>>(biasElements, 1, init.data(), device), s.biasShape);
+                let sob = make_shared<Matrix<ElemType>>(test.resultShape.GetNumElements(), 1, device);
+                sob->SetValue(0);
+                auto c = TensorView<ElemType>(sob, test.resultShape);
+
+                test.fn(c, a, b, bias); // warm-up, and the plan for the shape
+                sob->Get00Element();
+                auto t_start = chrono::high_resolution_clock::now();
+                for (int i = 0; i < (device == CPUDEVICE ? 1 : count); ++i)
+                    test.fn(c, a, b, bias);
+                sob->Get00Element(); // waits for the GPU
+                auto t_end = chrono::high_resolution_clock::now();
+                ms = chrono::duration<double, milli>(t_end - t_start).count() / (device == CPUDEVICE ? 1 : count);
+
+                sob->TransferToDeviceIfNotThere(CPUDEVICE, true);
+                results.push_back(sob);
+            }
+            bool isSame = results[0]->IsEqualTo(*results[1], (ElemType) 1e-2);
+            cout << "   " << test.name << ": " << ms << " ms" << (isSame ? "" : " --> FAILED (results differ from the CPU)") << endl;
+        }
+    }
+}
+
 template <class ElemType>
 void MandSTest(int count, int devId)
 {
@@ -336,10 +488,28 @@ void MandSTest(int count, int devId)
     delete[] data3;
 }
 
-int wmain()
+// Runs the benchmark suite (see MathBenchmarks.h for the options); the ad-hoc tests below can be enabled instead.
+#ifdef _WIN32
+int wmain(int argc, wchar_t* argv[])
+#else
+int main(int argc, char* argv[])
+#endif
 {
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+#ifdef _WIN32
+        args.push_back(msra::strfun::utf8(argv[i]));
+#else
+        args.push_back(argv[i]);
+#endif
+
     // MandSTest<float>(100, 2);
 
+    // CPUTensorOpKernelTest<float>(2048, 1024, 100);
+    // CPUTensorOpKernelTest<double>(2048, 1024, 100);
+
+    // GPUTensorOpShapeTest<float>(0, 100);
+
     /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
     SquareMultiplyAndAdd10TimesAvgTest<float>(4096,10);
 
@@ -355,5 +525,13 @@ int wmain()
     MultiplyAndWeightedAddTest<float>(1100,1000,1200);    
     MultiplyAndWeightedAddTest<float>(11000,10000,12000);*/
 
-    return 0;
+    try
+    {
+        return RunMathBenchmarks(args);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return 2;
+    }
 }
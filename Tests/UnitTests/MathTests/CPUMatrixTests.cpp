@@ -4,6 +4,11 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/CPUVectorKernels.h"
+#include "../../../Source/Math/ImageAugmentation.h"
+#include "../../../Source/Math/NarrowElementTypes.h"
+#include "../../../Source/Math/PackedMatrixMultiplier.h"
+#include "../../../Source/Math/RNNCommon.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -898,6 +903,331 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixAssignAugmentedImages, RandomSeedFixture)
+{
+    // Two 2x1 BGR images, the mean is subtracted and the output is transposed to CHW.
+    ImageAugmentationParameters parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.m_width = 2;
+    parameters.m_height = 1;
+    parameters.m_channels = 3;
+    parameters.m_transposeToCHW = true;
+    parameters.m_subtractMean = true;
+
+    const size_t numImages = 2;
+    const uint8_t images[] = { 10, 100, 200, 50, 50, 50, 0, 1, 2, 3, 4, 5 };
+    const float mean[] = { 1, 2, 3, 4, 5, 6 };
+
+    auto layout = GetImageAugmentationWorkspaceLayout(parameters, numImages);
+    SMatrix workspace((layout.m_size + sizeof(float) - 1) / sizeof(float), 1);
+    char* base = reinterpret_cast<char*>(workspace.Data());
+    memcpy(base + layout.m_meanOffset, mean, sizeof(mean));
+    memcpy(base + layout.m_imagesOffset, images, sizeof(images));
+
+    SMatrix m;
+    m.AssignAugmentedImages(workspace, numImages, parameters, 4711);
+    BOOST_CHECK_EQUAL(6u, m.GetNumRows());
+    BOOST_CHECK_EQUAL(2u, m.GetNumCols());
+
+    const float expected[] = { 9, 46, 98, 45, 197, 44, -1, -1, -1, -1, -1, -1 };
+    for (int i = 0; i < 12; i++)
+        BOOST_CHECK_EQUAL(expected[i], m.Data()[i]);
+
+    // Saturation only: gray pixels stay the same, the hue and maximum of colored pixels are kept.
+    parameters.m_subtractMean = false;
+    parameters.m_saturationRadius = 0.5f;
+    layout = GetImageAugmentationWorkspaceLayout(parameters, numImages);
+    base = reinterpret_cast<char*>(workspace.Data());
+    memcpy(base + layout.m_imagesOffset, images, sizeof(images));
+
+    SMatrix m1, m2;
+    m1.AssignAugmentedImages(workspace, numImages, parameters, 4711);
+    m2.AssignAugmentedImages(workspace, numImages, parameters, 4711);
+    BOOST_CHECK(m1.IsEqualTo(m2));
+    BOOST_CHECK_EQUAL(200, m1(4, 0));
+    BOOST_CHECK_EQUAL(50, m1(1, 0));
+    BOOST_CHECK_EQUAL(50, m1(3, 0));
+    BOOST_CHECK_EQUAL(50, m1(5, 0));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixAssignAugmentedImagesMultiView, RandomSeedFixture)
+{
+    // The 10 views of size 2x1 of a single 3x2 gray image.
+    ImageAugmentationParameters parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.m_width = 2;
+    parameters.m_height = 1;
+    parameters.m_channels = 1;
+    parameters.m_numViews = 10;
+    parameters.m_sourceWidth = 3;
+    parameters.m_sourceHeight = 2;
+
+    const size_t numImages = 10;
+    const uint8_t image[] = { 1, 2, 3, 4, 5, 6 };
+
+    auto layout = GetImageAugmentationWorkspaceLayout(parameters, numImages);
+    BOOST_CHECK_EQUAL(layout.m_imagesOffset + sizeof(image), layout.m_size);
+    SMatrix workspace((layout.m_size + sizeof(float) - 1) / sizeof(float), 1);
+    memcpy(reinterpret_cast<char*>(workspace.Data()) + layout.m_imagesOffset, image, sizeof(image));
+
+    SMatrix m;
+    m.AssignAugmentedImages(workspace, numImages, parameters, 4711);
+    BOOST_CHECK_EQUAL(2u, m.GetNumRows());
+    BOOST_CHECK_EQUAL(10u, m.GetNumCols());
+
+    // Top-left, top-right, bottom-left, bottom-right and center, then the same flipped.
+    const float expected[] = { 1, 2, 2, 3, 4, 5, 5, 6, 1, 2, 2, 1, 3, 2, 5, 4, 6, 5, 2, 1 };
+    for (int i = 0; i < 20; i++)
+        BOOST_CHECK_EQUAL(expected[i], m.Data()[i]);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixAssignWidenedValues, RandomSeedFixture)
+{
+    const uint8_t bytes[] = { 0, 1, 128, 255, 7, 9 };
+    SMatrix packed(2, 1);
+    memcpy(packed.Data(), bytes, sizeof(bytes));
+
+    SMatrix m;
+    m.AssignWidenedValuesOf(packed, NarrowElementType::uint8, 3, 2, 0.5f, -1.0f);
+    BOOST_CHECK_EQUAL(3u, m.GetNumRows());
+    BOOST_CHECK_EQUAL(2u, m.GetNumCols());
+    for (int i = 0; i < 6; i++)
+        BOOST_CHECK_EQUAL(0.5f * bytes[i] - 1.0f, m.Data()[i]);
+
+    // Values that are exact in half precision survive the round trip.
+    const float values[] = { 0.0f, -2.5f, 65504.0f, 0.0009765625f, 3.0517578125e-05f, 1.0f };
+    float16 halfs[6];
+    for (int i = 0; i < 6; i++)
+        CastElement(values[i], halfs[i]);
+    packed.Resize(3, 1);
+    memcpy(packed.Data(), halfs, sizeof(halfs));
+
+    DMatrix d;
+    DMatrix packedDouble(2, 1);
+    memcpy(packedDouble.Data(), halfs, sizeof(halfs));
+    d.AssignWidenedValuesOf(packedDouble, NarrowElementType::float16, 2, 3, 1.0, 0.0);
+    for (int i = 0; i < 6; i++)
+        BOOST_CHECK_EQUAL((double)values[i], d.Data()[i]);
+
+    m.AssignWidenedValuesOf(packed, NarrowElementType::float16, 6, 1, 2.0f, 0.0f);
+    for (int i = 0; i < 6; i++)
+        BOOST_CHECK_EQUAL(2 * values[i], m.Data()[i]);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixPackedMultiply, RandomSeedFixture)
+{
+    // m = 37 leaves a partial panel; n covers the blocks of columns, the half block and the single columns of the kernels
+    const size_t m = 37, k = 300;
+    SMatrix a = SMatrix::RandomUniform(m, k, -1.0f, 1.0f, IncrementCounter());
+    SMatrix aT = a.Transpose();
+    CPUVectorInstructionSet maxInstructionSet = GetCPUVectorInstructionSet();
+    for (int instructionSet = (int) CPUVectorInstructionSet::None; instructionSet <= (int) CPUVectorInstructionSet::AVX512; instructionSet++)
+    {
+        SetMaxCPUVectorInstructionSet((CPUVectorInstructionSet) instructionSet);
+        for (bool transposeA : { false, true })
+        {
+            PackedMatrixMultiplier<float> multiplier;
+            multiplier.Pack(transposeA ? aT.Data() : a.Data(), m, k, transposeA);
+            BOOST_CHECK_EQUAL(multiplier.GetNumRows(), m);
+            BOOST_CHECK_EQUAL(multiplier.GetNumCols(), k);
+            for (size_t n : { 1, 3, 4, 7, 8, 13, 16 })
+            {
+                SMatrix b = SMatrix::RandomUniform(k, n, -1.0f, 1.0f, IncrementCounter());
+                SMatrix c0 = SMatrix::RandomUniform(m, n, -1.0f, 1.0f, IncrementCounter());
+                for (float beta : { 0.0f, 0.5f })
+                {
+                    SMatrix expected(c0);
+                    SMatrix::MultiplyAndWeightedAdd(2.0f, a, false, b, false, beta, expected);
+                    SMatrix c(c0);
+                    multiplier.Multiply(2.0f, b.Data(), n, beta, c.Data());
+                    BOOST_CHECK(c.IsEqualTo(expected, 1e-4f));
+                }
+            }
+        }
+    }
+    SetMaxCPUVectorInstructionSet(maxInstructionSet);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixBatchedMultiply, RandomSeedFixture)
+{
+    // one [m x k] resp. [k x n] matrix per column, b optionally shared by the whole batch
+    const size_t m = 5, k = 7, n = 3, batchCount = 11;
+    SMatrix a = SMatrix::RandomUniform(m * k, batchCount, -1.0f, 1.0f, IncrementCounter());
+    SMatrix c0 = SMatrix::RandomUniform(m * n, batchCount, -1.0f, 1.0f, IncrementCounter());
+    for (bool transposeA : { false, true })
+    for (bool transposeB : { false, true })
+    for (bool shareB : { false, true })
+    {
+        SMatrix b = SMatrix::RandomUniform(k * n, shareB ? 1 : batchCount, -1.0f, 1.0f, IncrementCounter());
+        for (float beta : { 0.0f, 0.5f })
+        {
+            SMatrix c(c0);
+            SMatrix::BatchedMultiplyAndWeightedAdd(2.0f, a, transposeA, m * k, b, transposeB, shareB ? 0 : k * n, beta, c, m * n, m, n, k, batchCount);
+            for (size_t i = 0; i < batchCount; i++)
+            {
+                SMatrix ai = a.ColumnSlice(i, 1);
+                SMatrix bi = b.ColumnSlice(shareB ? 0 : i, 1);
+                ai.Reshape(transposeA ? k : m, transposeA ? m : k);
+                bi.Reshape(transposeB ? n : k, transposeB ? k : n);
+                SMatrix expected(m, n);
+                expected.SetValue(m, n, c0.ColumnSlice(i, 1).Data());
+                SMatrix::MultiplyAndWeightedAdd(2.0f, ai, transposeA, bi, transposeB, beta, expected);
+                SMatrix ci = c.ColumnSlice(i, 1);
+                ci.Reshape(m, n);
+                BOOST_CHECK(ci.IsEqualTo(expected, 1e-5f));
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSoftmaxCrossEntropy, RandomSeedFixture)
+{
+    // more rows than one chunk, with the maximum of a column late, to exercise the rescaling of the running sum
+    const size_t n = 5;
+    for (size_t m : { 7, 10000 })
+    {
+        SMatrix logits = SMatrix::RandomUniform(m, n, -5.0f, 5.0f, IncrementCounter());
+        SMatrix labels = SMatrix::RandomUniform(m, n, 0.0f, 1.0f, IncrementCounter());
+        logits(m - 1, 0) = 20.0f;
+
+        SMatrix logSoftmax(m, n);
+        logSoftmax.AssignLogSoftmaxOf(logits, true);
+
+        SMatrix loss, logSumExp;
+        loss.AssignSoftmaxCrossEntropyOf(labels, logits, logSumExp);
+        BOOST_CHECK_EQUAL(loss.GetNumRows(), 1u);
+        BOOST_CHECK_EQUAL(loss.GetNumCols(), n);
+        for (size_t j = 0; j < n; j++)
+        {
+            double expected = 0;
+            for (size_t i = 0; i < m; i++)
+                expected -= labels(i, j) * logSoftmax(i, j);
+            BOOST_CHECK_CLOSE(loss(0, j), expected, 1e-2);
+            BOOST_CHECK_CLOSE(logSumExp(0, j), logits(0, j) - logSoftmax(0, j), 1e-3);
+        }
+
+        SMatrix alpha(1, 1);
+        alpha(0, 0) = 0.5f;
+        SMatrix gradient = SMatrix::RandomUniform(m, n, -1.0f, 1.0f, IncrementCounter());
+        SMatrix expected(gradient);
+        SMatrix softmax(logSoftmax);
+        softmax.InplaceExp();
+        SMatrix::AddScaledDifference(alpha, softmax, labels, expected);
+        SMatrix::AddSoftmaxCrossEntropyGradient(alpha, logits, logSumExp, labels, gradient);
+        BOOST_CHECK(gradient.IsEqualTo(expected, c_epsilonFloatE4));
+    }
+}
+
+// Straightforward evaluation of OptimizedRNNStack on one sequence x [time][xDim], with the parameters in the cuDNN layout.
+static vector<vector<double>> EvaluateRNNReference(const vector<vector<double>>& x, const double* params, const RnnAttributes& attributes)
+{
+    const size_t hiddenSize = attributes.m_hiddenSize;
+    const size_t numDirections = attributes.m_bidirectional ? 2 : 1;
+    const wstring& cell = attributes.m_recurrentOp;
+    const size_t numGates = cell == L"lstm" ? 4 : cell == L"gru" ? 3 : 1;
+    const size_t numSteps = x.size();
+    auto sigmoid = [](double z) { return 1 / (1 + exp(-z)); };
+
+    vector<vector<double>> input = x;
+    for (size_t layer = 0; layer < attributes.m_numLayers; layer++)
+    {
+        const size_t inputDim = input[0].size();
+        vector<vector<double>> output(numSteps, vector<double>(numDirections * hiddenSize));
+        for (size_t direction = 0; direction < numDirections; direction++)
+        {
+            const double* w = params;
+            const double* r = w + numGates * hiddenSize * inputDim;
+            const double* biasW = r + numGates * hiddenSize * hiddenSize;
+            const double* biasR = biasW + numGates * hiddenSize;
+            params = biasR + numGates * hiddenSize;
+
+            vector<double> h(hiddenSize, 0), c(hiddenSize, 0);
+            for (size_t step = 0; step < numSteps; step++)
+            {
+                const size_t t = direction == 0 ? step : numSteps - 1 - step;
+                auto fromInput = [&](size_t gate, size_t k)
+                {
+                    double v = biasW[gate * hiddenSize + k];
+                    for (size_t i = 0; i < inputDim; i++)
+                        v += w[(gate * hiddenSize + k) * inputDim + i] * input[t][i];
+                    return v;
+                };
+                auto fromState = [&](size_t gate, size_t k)
+                {
+                    double v = biasR[gate * hiddenSize + k];
+                    for (size_t i = 0; i < hiddenSize; i++)
+                        v += r[(gate * hiddenSize + k) * hiddenSize + i] * h[i];
+                    return v;
+                };
+                vector<double> next(hiddenSize);
+                for (size_t k = 0; k < hiddenSize; k++)
+                {
+                    if (cell == L"lstm")
+                    {
+                        c[k] = sigmoid(fromInput(1, k) + fromState(1, k)) * c[k] + sigmoid(fromInput(0, k) + fromState(0, k)) * tanh(fromInput(2, k) + fromState(2, k));
+                        next[k] = sigmoid(fromInput(3, k) + fromState(3, k)) * tanh(c[k]);
+                    }
+                    else if (cell == L"gru")
+                    {
+                        double reset = sigmoid(fromInput(0, k) + fromState(0, k));
+                        double update = sigmoid(fromInput(1, k) + fromState(1, k));
+                        next[k] = (1 - update) * tanh(fromInput(2, k) + reset * fromState(2, k)) + update * h[k];
+                    }
+                    else if (cell == L"rnnTanh")
+                        next[k] = tanh(fromInput(0, k) + fromState(0, k));
+                    else
+                        next[k] = max(fromInput(0, k) + fromState(0, k), 0.0);
+                }
+                h = next;
+                copy(h.begin(), h.end(), output[t].begin() + direction * hiddenSize);
+            }
+        }
+        input = output;
+    }
+    return input;
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRNNForward, RandomSeedFixture)
+{
+    const size_t xDim = 3, hiddenSize = 4;
+    const vector<size_t> sequenceLengths{ 5, 3, 3, 1 }; // sorted by decreasing length, as in cuDNN packing
+    const vector<size_t> numSequencesForFrame{ 4, 3, 3, 1, 1 };
+    const size_t numCols = 12;
+
+    for (const wchar_t* cell : { L"lstm", L"gru", L"rnnTanh", L"rnnReLU" })
+    {
+        for (bool bidirectional : { false, true })
+        {
+            RnnAttributes attributes(bidirectional, 2, hiddenSize, cell, -1);
+            auto numParameters = attributes.GetNumParameters(xDim);
+            DMatrix params = DMatrix::RandomUniform(numParameters.first, numParameters.second, -0.5, 0.5, IncrementCounter());
+            DMatrix x = DMatrix::RandomUniform(xDim, numCols, -1.0, 1.0, IncrementCounter());
+            const size_t yDim = (bidirectional ? 2 : 1) * hiddenSize;
+
+            DMatrix y;
+            y.RNNForward(x, params, xDim, yDim, numSequencesForFrame, attributes);
+            BOOST_REQUIRE_EQUAL(y.GetNumRows(), yDim);
+            BOOST_REQUIRE_EQUAL(y.GetNumCols(), numCols);
+
+            for (size_t s = 0; s < sequenceLengths.size(); s++)
+            {
+                // frame t of sequence s is column s of frame t in the packing
+                vector<size_t> columns;
+                for (size_t t = 0, frameStart = 0; t < sequenceLengths[s]; frameStart += numSequencesForFrame[t++])
+                    columns.push_back(frameStart + s);
+                vector<vector<double>> sequence;
+                for (size_t col : columns)
+                    sequence.push_back(vector<double>(x.Data() + col * xDim, x.Data() + (col + 1) * xDim));
+
+                auto expected = EvaluateRNNReference(sequence, params.Data(), attributes);
+                for (size_t t = 0; t < columns.size(); t++)
+                    for (size_t i = 0; i < yDim; i++)
+                        BOOST_CHECK_SMALL(y(i, columns[t]) - expected[t][i], 1e-10);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -116,6 +116,112 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndAdd, RandomSeedFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixSBCFormat, RandomSeedFixture)
+{
+    const size_t m = 30;
+    const size_t n = 50;
+
+    DenseMatrix dm0(m, n);
+    dm0.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    // sparse input that touches only some of the columns of the product
+    SparseMatrix sm1(MatrixFormat::matrixFormatSparseCSC, 80, n, 0);
+    for (size_t col = 0; col < n; col++)
+        sm1.SetValue((col * 7) % 20, col, 1.0 + col);
+
+    SparseMatrix smMul(MatrixFormat::matrixFormatSparseBlockCol, m, 80, 0);
+    SparseMatrix::MultiplyAndAdd(1, dm0, false, sm1, true, smMul);
+
+    std::vector<size_t> blockIds;
+    std::vector<double> values;
+    smMul.GetMatrixFromSBCFormat(blockIds, values);
+    BOOST_CHECK_EQUAL(blockIds.size(), 20u);
+    BOOST_CHECK_EQUAL(values.size(), 20 * m);
+
+    SparseMatrix sm2(MatrixFormat::matrixFormatSparseBlockCol);
+    sm2.SetMatrixFromSBCFormat(blockIds.data(), values.data(), blockIds.size(), m, 80);
+    BOOST_CHECK_EQUAL(sm2.GetBlockSize(), 20u);
+    for (size_t row = 0; row < m; row++)
+    {
+        for (size_t col = 0; col < 80; col++)
+            BOOST_CHECK_EQUAL(sm2(row, col), smMul(row, col));
+    }
+}
+
+// Random CSC matrix with about 5% nonzeros, and the same values as a dense matrix.
+static SparseMatrix RandomSparseMatrix(size_t rows, size_t cols, unsigned long seed, DenseMatrix& asDense)
+{
+    asDense.Resize(rows, cols);
+    asDense.SetUniformRandomValue(-19, 1, seed);
+    asDense.InplaceTruncateBottom(0);
+
+    SparseMatrix sparse(MatrixFormat::matrixFormatSparseCSC, rows, cols, 0);
+    foreach_coord (row, col, asDense)
+    {
+        if (asDense(row, col) != 0)
+            sparse.SetValue(row, col, asDense(row, col));
+    }
+    return sparse;
+}
+
+// The products of dense and sparse matrices in all transpositions against the dense products,
+// large enough that the work is split across threads.
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAddParallel, RandomSeedFixture)
+{
+    const size_t m = 300; // rows of the product
+    const size_t k = 400; // inner dimension
+    const size_t n = 250; // columns of the product
+
+    for (int denseTimesSparse = 0; denseTimesSparse < 2; denseTimesSparse++)
+    {
+        for (int transposeA = 0; transposeA < 2; transposeA++)
+        {
+            for (int transposeB = 0; transposeB < 2; transposeB++)
+            {
+                DenseMatrix a(transposeA ? k : m, transposeA ? m : k);
+                DenseMatrix b(transposeB ? n : k, transposeB ? k : n);
+                DenseMatrix c(m, n);
+                c.SetUniformRandomValue(-1, 1, IncrementCounter());
+                DenseMatrix expected(c);
+
+                if (denseTimesSparse)
+                {
+                    a.SetUniformRandomValue(-1, 1, IncrementCounter());
+                    SparseMatrix sparse = RandomSparseMatrix(b.GetNumRows(), b.GetNumCols(), IncrementCounter(), b);
+                    SparseMatrix::MultiplyAndWeightedAdd(0.5, a, !!transposeA, sparse, !!transposeB, 2, c);
+                }
+                else
+                {
+                    b.SetUniformRandomValue(-1, 1, IncrementCounter());
+                    SparseMatrix sparse = RandomSparseMatrix(a.GetNumRows(), a.GetNumCols(), IncrementCounter(), a);
+                    SparseMatrix::MultiplyAndWeightedAdd(0.5, sparse, !!transposeA, b, !!transposeB, 2, c);
+                }
+                DenseMatrix::MultiplyAndWeightedAdd(0.5, a, !!transposeA, b, !!transposeB, 2, expected);
+
+                BOOST_CHECK(c.IsEqualTo(expected, c_epsilonFloatE4));
+            }
+        }
+    }
+
+    // block-sparse gradient: dense * sparse^T, accumulated over two products
+    DenseMatrix dense(m, k);
+    dense.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix expected(m, n);
+    expected.SetValue(0);
+    SparseMatrix gradient(MatrixFormat::matrixFormatSparseBlockCol, m, n, 0);
+    for (size_t i = 0; i < 2; i++)
+    {
+        DenseMatrix sparseAsDense;
+        SparseMatrix sparse = RandomSparseMatrix(n, k, IncrementCounter(), sparseAsDense);
+        SparseMatrix::MultiplyAndAdd(1, dense, false, sparse, true, gradient);
+        DenseMatrix::MultiplyAndAdd(dense, false, sparseAsDense, true, expected);
+    }
+    foreach_coord (row, col, expected)
+    {
+        BOOST_CHECK(abs(gradient(row, col) - expected(row, col)) < c_epsilonFloatE4);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -233,6 +233,306 @@ BOOST_AUTO_TEST_CASE(ConvolutionForward)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ConvolutionForwardInt8)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    for (size_t maxTempMem : {0, 1, 3})
+    {
+        for (const auto& g : GenerateConvTestConfigs())
+        {
+            auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, maxTempMem, PoolKind::None, ConvolutionEngineKind::Gemm);
+            auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, maxTempMem, PoolKind::None, ConvolutionEngineKind::Gemm);
+            BOOST_REQUIRE(testEng->SupportsInt8Forward());
+
+            size_t n = batchSizeG(rng);
+            vec buf;
+            buf.resize(g->InputShape().GetNumElements() * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+            testEng->SetInt8InputRange(in.MatrixNormInf());
+
+            size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+            buf.resize(g->KernelShape().GetNumElements() * mapCount);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+            size_t crowOut = g->OutputShape().GetNumElements();
+            SingleMatrix out(crowOut, n, deviceId);
+            SingleMatrix outB(crowOut, n, deviceId);
+            SingleMatrix workspace(deviceId);
+            SingleMatrix workspaceB(deviceId);
+
+            // twice, since the kernel is quantized in the first call only
+            for (int pass = 0; pass < 2; pass++)
+            {
+                testEng->Forward(in, kernel, out, workspace);
+                baseEng->Forward(in, kernel, outB, workspaceB);
+
+                std::stringstream tmsg;
+                tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n << ", MaxTempMem: " << maxTempMem << ", Pass: " << pass;
+                std::string emsg;
+
+                // the error of int8 is relative to the range of the result
+                float absErr = 0.04f * std::max(1.0f, outB.MatrixNormInf());
+                BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, 0.0f, absErr), "out are not equal, " << tmsg.str() << ". " << emsg);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionForwardWinogradFFT)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::normal_distribution<float> nd;
+
+    // Winograd and FFT engines fall back to GEMM for the geometries they do not support.
+    auto geometries = GenerateConvTestConfigs();
+    for (bool autoPad : {false, true})
+    {
+        geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(12, 17, 3),
+            TensorShape(3, 3, 3), TensorShape(6), TensorShape(1),
+            ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+            TensorShape(0), TensorShape(0)));
+    }
+    // Large kernels on many channels, for which the FFT engine is faster than GEMM.
+    for (size_t k : {7, 13})
+    {
+        geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(33 - k, 33 - k, 32),
+            TensorShape(k, k, 32), TensorShape(32), TensorShape(1),
+            ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+            TensorShape(0), TensorShape(0)));
+    }
+    // Output smaller than 4x4 (F(2x2, 3x3)).
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(5, 4, 2),
+        TensorShape(3, 3, 2), TensorShape(4), TensorShape(1),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+
+    int deviceId = -1;
+    for (auto engKind : {ConvolutionEngineKind::Winograd, ConvolutionEngineKind::FFT})
+    {
+        for (size_t maxTempMem : {0, 1, 3})
+        {
+            for (const auto& g : geometries)
+            {
+                auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Gemm);
+                auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, maxTempMem, PoolKind::None,
+                                               (ConvolutionEngineKind)((int)engKind | (int)ConvolutionEngineKind::Gemm));
+
+                size_t n = batchSizeG(rng);
+                vec buf;
+                buf.resize(g->InputShape().GetNumElements() * n);
+                std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+                size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+                buf.resize(g->KernelShape().GetNumElements() * mapCount);
+                std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+                size_t crowOut = g->OutputShape().GetNumElements();
+                SingleMatrix out(crowOut, n, deviceId);
+                SingleMatrix outB(crowOut, n, deviceId);
+                SingleMatrix workspace(deviceId);
+                SingleMatrix workspaceB(deviceId);
+
+                // twice, with a different kernel in the second call (the FFT engine keeps the kernel spectra)
+                for (int pass = 0; pass < 2; pass++)
+                {
+                    if (pass > 0)
+                        SingleMatrix::Scale(-0.5f, kernel);
+                    testEng->Forward(in, kernel, out, workspace);
+                    baseEng->Forward(in, kernel, outB, workspaceB);
+
+                    std::stringstream tmsg;
+                    tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n << ", MaxTempMem: " << maxTempMem << ", Pass: " << pass;
+                    std::string emsg;
+
+                    // the error of the transforms is relative to the range of the result
+                    float absErr = 4e-5f * std::max(1.0f, outB.MatrixNormInf());
+                    BOOST_REQUIRE_MESSAGE(!out.HasNan("out"), "out has NaNs, " << tmsg.str());
+                    BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, Err<float>::Rel * 40, absErr), "out are not equal, " << tmsg.str() << ". " << emsg);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionGrouped)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::normal_distribution<float> nd;
+
+    // Depthwise (groups == channels) and grouped convolutions, with and without padding and stride.
+    std::vector<ConvolveGeometryPtr> geometries;
+    for (bool autoPad : {false, true})
+    {
+        for (size_t stride : {1, 2})
+        {
+            geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(11, 9, 8),
+                TensorShape(3, 3, 1), TensorShape(8), TensorShape(stride, stride, 1),
+                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                TensorShape(0), TensorShape(0), /*groups=*/8));
+            geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(7, 10, 6),
+                TensorShape(4, 3, 3), TensorShape(4), TensorShape(stride, stride, 1),
+                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                TensorShape(0), TensorShape(0), /*groups=*/2));
+        }
+    }
+    // Depth multiplier 2: two maps per channel.
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(6, 6, 3),
+        TensorShape(5, 5, 1), TensorShape(6), TensorShape(1),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0), /*groups=*/3));
+
+    int deviceId = -1;
+    for (const auto& g : geometries)
+    {
+        BOOST_REQUIRE_EQUAL(g->OutputShape()[2], g->GetMapCount(2));
+        auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+        auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Direct);
+
+        size_t n = batchSizeG(rng);
+        auto randomMatrix = [&](size_t rows, size_t cols)
+        {
+            vec buf(rows * cols);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            return SingleMatrix(rows, cols, buf.data(), deviceId, matrixFlagNormal);
+        };
+        size_t crowIn = g->InputShape().GetNumElements(), crowOut = g->OutputShape().GetNumElements();
+        size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+        SingleMatrix in = randomMatrix(crowIn, n);
+        SingleMatrix kernel = randomMatrix(mapCount, g->KernelShape().GetNumElements());
+        SingleMatrix srcGrad = randomMatrix(crowOut, n);
+        SingleMatrix workspace(deviceId);
+
+        std::stringstream tmsg;
+        tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n;
+        std::string emsg;
+
+        SingleMatrix out(crowOut, n, deviceId);
+        SingleMatrix outB(crowOut, n, deviceId);
+        testEng->Forward(in, kernel, out, workspace);
+        baseEng->Forward(in, kernel, outB, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, Err<float>::Rel, Err<float>::Abs), "out are not equal, " << tmsg.str() << ". " << emsg);
+
+        // the gradients are accumulated
+        SingleMatrix grad = randomMatrix(crowIn, n);
+        SingleMatrix gradB(grad.DeepClone());
+        testEng->BackwardData(srcGrad, kernel, grad, /*accumulateGradient=*/true, workspace);
+        baseEng->BackwardData(srcGrad, kernel, gradB, /*accumulateGradient=*/true, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, Err<float>::Rel, Err<float>::Abs), "grad are not equal, " << tmsg.str() << ". " << emsg);
+
+        SingleMatrix kernelGrad = randomMatrix(mapCount, g->KernelShape().GetNumElements());
+        SingleMatrix kernelGradB(kernelGrad.DeepClone());
+        testEng->BackwardKernel(srcGrad, in, kernelGrad, /*accumulateGradient=*/true, false, workspace);
+        baseEng->BackwardKernel(srcGrad, in, kernelGradB, /*accumulateGradient=*/true, false, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGrad, kernelGradB, emsg, Err<float>::Rel * 4, Err<float>::Abs * 4),
+                              "kernelGrad are not equal, " << tmsg.str() << ". " << emsg);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionChannelsLast)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::normal_distribution<float> nd;
+
+    // NHWC geometries [C x W x H] (kernel [C x X x Y], maps first) and the same convolutions in CHW.
+    std::vector<std::pair<ConvolveGeometryPtr, ConvolveGeometryPtr>> geometries;
+    for (bool autoPad : {false, true})
+    {
+        for (size_t stride : {1, 2})
+        {
+            geometries.push_back(std::make_pair(
+                std::make_shared<ConvolveGeometry>(TensorShape(8, 11, 9), TensorShape(8, 3, 3), TensorShape(16, 1, 1), TensorShape(1, stride, stride),
+                    ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false, autoPad, autoPad}, TensorShape(0), TensorShape(0)),
+                std::make_shared<ConvolveGeometry>(TensorShape(11, 9, 8), TensorShape(3, 3, 8), TensorShape(16), TensorShape(stride, stride, 1),
+                    ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false}, TensorShape(0), TensorShape(0))));
+        }
+    }
+    geometries.push_back(std::make_pair(
+        std::make_shared<ConvolveGeometry>(TensorShape(3, 7, 6), TensorShape(3, 5, 5), TensorShape(4, 1, 1), TensorShape(1),
+            ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false, true, true}, TensorShape(0), TensorShape(0)),
+        std::make_shared<ConvolveGeometry>(TensorShape(7, 6, 3), TensorShape(5, 5, 3), TensorShape(4), TensorShape(1),
+            ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false}, TensorShape(0), TensorShape(0))));
+
+    // [C x P] -> [P x C] for each column of m
+    auto toChannelsLast = [](const SingleMatrix& m, size_t channels)
+    {
+        size_t rows = m.GetNumRows(), cells = rows / channels;
+        vec buf(m.GetNumElements());
+        for (size_t n = 0; n < m.GetNumCols(); n++)
+            for (size_t p = 0; p < cells; p++)
+                for (size_t c = 0; c < channels; c++)
+                    buf[n * rows + c * cells + p] = m.Data()[n * rows + p * channels + c];
+        return SingleMatrix(m.GetNumRows(), m.GetNumCols(), buf.data(), CPUDEVICE, matrixFlagNormal);
+    };
+
+    int deviceId = -1;
+    for (const auto& gs : geometries)
+    {
+        const auto& g = gs.first;
+        const auto& gCHW = gs.second;
+        BOOST_REQUIRE_EQUAL(g->OutputShape()[0], g->GetMapCount(0));
+        auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::NHWC, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+        auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::NHWC, 0, PoolKind::None, ConvolutionEngineKind::Gemm);
+        auto chwEng = ConvEng::Create(gCHW, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+
+        size_t n = batchSizeG(rng);
+        auto randomMatrix = [&](size_t rows, size_t cols)
+        {
+            vec buf(rows * cols);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            return SingleMatrix(rows, cols, buf.data(), deviceId, matrixFlagNormal);
+        };
+        size_t crowIn = g->InputShape().GetNumElements(), crowOut = g->OutputShape().GetNumElements();
+        size_t channels = g->InputShape()[0], mapCount = g->GetMapCount(0);
+        SingleMatrix in = randomMatrix(crowIn, n);
+        SingleMatrix kernel = randomMatrix(mapCount, g->KernelShape().GetNumElements());
+        SingleMatrix srcGrad = randomMatrix(crowOut, n);
+        SingleMatrix workspace(deviceId);
+
+        std::stringstream tmsg;
+        tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n;
+        std::string emsg;
+
+        SingleMatrix out(crowOut, n, deviceId);
+        SingleMatrix outB(crowOut, n, deviceId);
+        testEng->Forward(in, kernel, out, workspace);
+        baseEng->Forward(in, kernel, outB, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, Err<float>::Rel, Err<float>::Abs), "out are not equal, " << tmsg.str() << ". " << emsg);
+
+        // the same convolution of the same images and kernels in CHW
+        SingleMatrix kernelCHW = toChannelsLast(kernel.Reshaped(g->KernelShape().GetNumElements(), mapCount), channels);
+        kernelCHW.Reshape(mapCount, g->KernelShape().GetNumElements());
+        SingleMatrix outCHW(crowOut, n, deviceId);
+        chwEng->Forward(toChannelsLast(in, channels), kernelCHW, outCHW, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(toChannelsLast(out, mapCount), outCHW, emsg, Err<float>::Rel, Err<float>::Abs),
+                              "out are not equal to CHW, " << tmsg.str() << ". " << emsg);
+
+        // the gradients are accumulated
+        SingleMatrix grad = randomMatrix(crowIn, n);
+        SingleMatrix gradB(grad.DeepClone());
+        testEng->BackwardData(srcGrad, kernel, grad, /*accumulateGradient=*/true, workspace);
+        baseEng->BackwardData(srcGrad, kernel, gradB, /*accumulateGradient=*/true, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, Err<float>::Rel, Err<float>::Abs), "grad are not equal, " << tmsg.str() << ". " << emsg);
+
+        SingleMatrix kernelGrad = randomMatrix(mapCount, g->KernelShape().GetNumElements());
+        SingleMatrix kernelGradB(kernelGrad.DeepClone());
+        testEng->BackwardKernel(srcGrad, in, kernelGrad, /*accumulateGradient=*/true, false, workspace);
+        baseEng->BackwardKernel(srcGrad, in, kernelGradB, /*accumulateGradient=*/true, false, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGrad, kernelGradB, emsg, Err<float>::Rel * 4, Err<float>::Abs * 4),
+                              "kernelGrad are not equal, " << tmsg.str() << ". " << emsg);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ConvolutionBackwardData)
 {
     std::mt19937 rng(0);
@@ -584,6 +884,52 @@ BOOST_AUTO_TEST_CASE(MaxUnpooling)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ConvolutionAlgorithmCacheFile)
+{
+    using Entry = ConvolutionAlgorithmCache::Entry;
+    std::wstring path(L"ConvolutionAlgorithmCache.txt");
+    if (fexists(path))
+        unlinkOrDie(path);
+
+    auto checkEntry = [](ConvolutionAlgorithmCache& cache, const std::string& key, const Entry& expected)
+    {
+        Entry entry = { -1, 0, -1 };
+        BOOST_REQUIRE_MESSAGE(cache.Find(key, entry), "missing entry '" << key << "'");
+        BOOST_REQUIRE_EQUAL(entry.Algo, expected.Algo);
+        BOOST_REQUIRE_EQUAL(entry.WorkspaceSize, expected.WorkspaceSize);
+        BOOST_REQUIRE_EQUAL(entry.NoWorkspaceAlgo, expected.NoWorkspaceAlgo);
+    };
+
+    ConvolutionAlgorithmCache first;
+    first.SetFile(path);
+    first.Add("forward float, Input: 3 x 3 x 1, MB: 8", { 1, 1024, 0 });
+    first.Add("backward data float, Input: 3 x 3 x 1, MB: 8", { 5, (size_t)5 << 32, 2 });
+
+    // a later run
+    ConvolutionAlgorithmCache second;
+    second.SetFile(path);
+    checkEntry(second, "forward float, Input: 3 x 3 x 1, MB: 8", { 1, 1024, 0 });
+    checkEntry(second, "backward data float, Input: 3 x 3 x 1, MB: 8", { 5, (size_t)5 << 32, 2 });
+    Entry entry;
+    BOOST_REQUIRE(!second.Find("forward float, Input: 3 x 3 x 1, MB: 16", entry));
+
+    // the file keeps the entries of both, and the cache without a file does not change it
+    second.Add("forward float, Input: 3 x 3 x 1, MB: 16", { 2, 0, 2 });
+    first.Add("backward filter float, Input: 3 x 3 x 1, MB: 8", { 3, 64, 0 });
+    ConvolutionAlgorithmCache inMemory;
+    inMemory.Add("forward double, Input: 3 x 3 x 1, MB: 8", { 0, 0, 0 });
+    checkEntry(inMemory, "forward double, Input: 3 x 3 x 1, MB: 8", { 0, 0, 0 });
+
+    ConvolutionAlgorithmCache third;
+    third.SetFile(path);
+    checkEntry(third, "forward float, Input: 3 x 3 x 1, MB: 8", { 1, 1024, 0 });
+    checkEntry(third, "forward float, Input: 3 x 3 x 1, MB: 16", { 2, 0, 2 });
+    checkEntry(third, "backward filter float, Input: 3 x 3 x 1, MB: 8", { 3, 64, 0 });
+    BOOST_REQUIRE(!third.Find("forward double, Input: 3 x 3 x 1, MB: 8", entry));
+
+    unlinkOrDie(path);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -537,6 +537,33 @@ BOOST_FIXTURE_TEST_CASE(GPUMatrixCurandSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(GPUMatrixDeterministicScatter, RandomSeedFixture)
+{
+    // 64 source columns into 5 target columns, with gaps (negative indices)
+    const size_t rows = 300, cols = 64, targetCols = 5;
+    GPUMatrix<float> a = GPUMatrix<float>::RandomUniform(rows, cols, c_deviceIdZero, -1, 1, IncrementCounter());
+    std::vector<float> idxValues(cols);
+    for (size_t j = 0; j < cols; j++)
+        idxValues[j] = j % 7 == 6 ? -1.0f : (float)(j % targetCols);
+    GPUMatrix<float> idx(1, cols, c_deviceIdZero, idxValues.data(), matrixFlagNormal);
+    GPUMatrix<float> initial = GPUMatrix<float>::RandomUniform(rows, targetCols, c_deviceIdZero, -1, 1, IncrementCounter());
+
+    GPUMatrix<float> atomic(c_deviceIdZero);
+    atomic.SetValue(initial);
+    atomic.DoScatterColumnsOf(0.5f, idx, a, 2.0f);
+
+    DeterministicReductions::Enable(true);
+    GPUMatrix<float> deterministic1(c_deviceIdZero), deterministic2(c_deviceIdZero);
+    deterministic1.SetValue(initial);
+    deterministic1.DoScatterColumnsOf(0.5f, idx, a, 2.0f);
+    deterministic2.SetValue(initial);
+    deterministic2.DoScatterColumnsOf(0.5f, idx, a, 2.0f);
+    DeterministicReductions::Enable(false);
+
+    BOOST_CHECK(deterministic1.IsEqualTo(atomic, c_epsilonFloatE4));
+    BOOST_CHECK(deterministic1.IsEqualTo(deterministic2, 0));
+}
+
 #if 0 // Temporarily disabling
 BOOST_FIXTURE_TEST_CASE(GPUMatrixLargeInequality, RandomSeedFixture)
 {
@@ -165,10 +165,10 @@ BOOST_FIXTURE_TEST_CASE(GPUSparseTimesDense, RandomSeedFixture)
 
 BOOST_FIXTURE_TEST_CASE(GPUSparseTimesDenseRandom, RandomSeedFixture)
 {
-    const bool matrixTransB = false;
     for (auto sparseFormat : {MatrixFormat::matrixFormatSparseCSR, MatrixFormat::matrixFormatSparseCSC})
     {
         for (bool matrixTransA : {false, true})
+        for (bool matrixTransB : {false, true})
         {
             for (size_t m : {1, 10, 100})
             {
@@ -182,6 +182,11 @@ BOOST_FIXTURE_TEST_CASE(GPUSparseTimesDenseRandom, RandomSeedFixture)
                             dim1 = k;
                             dim2 = m;
                         }
+                        if (matrixTransB)
+                        {
+                            dim3 = n;
+                            dim4 = k;
+                        }
                         // SPARSE
                         GPUMatrix<float> lhsDense(c_deviceIdZero);
                         lhsDense.AssignTruncateBottomOf(GPUMatrix<float>::RandomUniform(dim1, dim2, c_deviceIdZero, -3.0f, 1.0f, IncrementCounter()), 0);
@@ -219,6 +224,49 @@ BOOST_FIXTURE_TEST_CASE(GPUSparseTimesDenseRandom, RandomSeedFixture)
     }
 }
 
+// The products that need the other compressed format convert once and keep it until the sparse matrix is written to.
+BOOST_FIXTURE_TEST_CASE(GPUSparseTimesDenseOtherFormat, RandomSeedFixture)
+{
+    const size_t m = 30, k = 40, n = 20;
+    for (auto sparseFormat : {MatrixFormat::matrixFormatSparseCSR, MatrixFormat::matrixFormatSparseCSC})
+    {
+        GPUMatrix<float> sparseDense(c_deviceIdZero);
+        sparseDense.AssignTruncateBottomOf(GPUMatrix<float>::RandomUniform(k, m, c_deviceIdZero, -3.0f, 1.0f, IncrementCounter()), 0);
+        GPUSparseMatrix<float> sparse(sparseDense, sparseFormat);
+        const GPUMatrix<float> dense = GPUMatrix<float>::RandomUniform(k, n, c_deviceIdZero, -1.0f, 1.0f, IncrementCounter());
+        const GPUMatrix<float> denseT = GPUMatrix<float>::RandomUniform(n, m, c_deviceIdZero, -1.0f, 1.0f, IncrementCounter());
+
+        for (size_t pass = 0; pass < 3; pass++)
+        {
+            // the second pass reuses the converted matrix, the third one must not after new values were written
+            if (pass == 2)
+            {
+                sparseDense.AssignTruncateBottomOf(GPUMatrix<float>::RandomUniform(k, m, c_deviceIdZero, -3.0f, 1.0f, IncrementCounter()), 0);
+                sparse.SetValue(sparseDense);
+            }
+
+            GPUMatrix<float> result(m, n, c_deviceIdZero), expected(m, n, c_deviceIdZero);
+            GPUSparseMatrix<float>::MultiplyAndWeightedAdd(1, sparse, true, dense, false, 0, result);
+            GPUMatrix<float>::MultiplyAndWeightedAdd(1, sparseDense, true, dense, false, 0, expected);
+            BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+
+            GPUMatrix<float> resultT(k, n, c_deviceIdZero), expectedT(k, n, c_deviceIdZero);
+            GPUSparseMatrix<float>::MultiplyAndWeightedAdd(1, sparse, false, denseT, true, 0, resultT);
+            GPUMatrix<float>::MultiplyAndWeightedAdd(1, sparseDense, false, denseT, true, 0, expectedT);
+            BOOST_CHECK(resultT.IsEqualTo(expectedT, c_epsilonFloatE4));
+
+            GPUMatrix<float> resultD(n, m, c_deviceIdZero), expectedD(n, m, c_deviceIdZero);
+            GPUSparseMatrix<float>::MultiplyAndWeightedAdd(1, dense, true, sparse, false, 0, resultD);
+            GPUMatrix<float>::MultiplyAndWeightedAdd(1, dense, true, sparseDense, false, 0, expectedD);
+            BOOST_CHECK(resultD.IsEqualTo(expectedD, c_epsilonFloatE4));
+
+            const float x = GPUSparseMatrix<float>::InnerProductOfMatrices(sparse, sparseDense);
+            const float y = GPUMatrix<float>::InnerProductOfMatrices(sparseDense, sparseDense);
+            BOOST_CHECK(fabsf(x - y) < c_epsilonFloatE3 * fabsf(y));
+        }
+    }
+}
+
 #if 0
 // TODO commented temporarily, this test (or underlying code) needs fixes
 
@@ -261,6 +309,38 @@ BOOST_FIXTURE_TEST_CASE(GPUDenseTimesSparse, RandomSeedFixture)
     BOOST_CHECK(twiceTransposeC.IsEqualTo(matrixC, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(GPUDenseTimesSparseGather, RandomSeedFixture)
+{
+    // an embedding times empty, one-hot and multi-hot columns, some with more nonzeros than the gather kernel stages at once
+    const int m = 300;
+    const int vocabularySize = 1000;
+    const int n = 20;
+    std::vector<int> colStarts(1, 0);
+    std::vector<int> rows;
+    std::vector<float> values;
+    for (int j = 0; j < n; j++)
+    {
+        int numNonzeros = j == 0 ? 0 : (j % 2 ? 1 : 400 + j);
+        for (int q = 0; q < numNonzeros; q++)
+        {
+            rows.push_back(2 * q + (j % 2) * (j + 1));
+            values.push_back(j % 2 ? 1.0f : (float) (q % 3 + 1));
+        }
+        colStarts.push_back((int) rows.size());
+    }
+
+    GPUSparseMatrix<float> input(c_deviceIdZero, matrixFormatSparseCSC);
+    input.SetMatrixFromCSCFormat(colStarts.data(), rows.data(), values.data(), values.size(), vocabularySize, n);
+    const GPUMatrix<float> denseInput = input.CopyToDenseMatrix();
+    const GPUMatrix<float> embedding = GPUMatrix<float>::RandomUniform(m, vocabularySize, c_deviceIdZero, -1, 1, IncrementCounter());
+
+    GPUMatrix<float> result = GPUMatrix<float>::RandomUniform(m, n, c_deviceIdZero, -1, 1, IncrementCounter());
+    GPUMatrix<float> expected(result);
+    GPUSparseMatrix<float>::MultiplyAndWeightedAdd(0.5, embedding, false, input, false, 2, result);
+    GPUMatrix<float>::MultiplyAndWeightedAdd(0.5, embedding, false, denseInput, false, 2, expected);
+    BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE3));
+}
+
 BOOST_FIXTURE_TEST_CASE(GPUSparseTimesSparse, RandomSeedFixture)
 {
     GPUSparseMatrix<float> matrixA;
@@ -322,6 +402,42 @@ BOOST_FIXTURE_TEST_CASE(GPUSparseIsEqual, RandomSeedFixture)
     BOOST_CHECK(!emptyMatrix.IsEqualTo(firstMatrix));
 }
 
+// CSC arrays packed back to back, as the readers hand them over, are taken in one transfer and give the same matrix.
+BOOST_FIXTURE_TEST_CASE(GPUSparseMatrixFromPackedCSC, RandomSeedFixture)
+{
+    const size_t numRows = 50;
+    GPUSparseMatrix<float> packedMatrix(c_deviceIdZero, matrixFormatSparseCSC);
+    GPUSparseMatrix<float> matrix(c_deviceIdZero, matrixFormatSparseCSC);
+    for (size_t numCols : {10, 30, 5, 30})
+    {
+        std::vector<int> colStarts(1, 0), rows;
+        std::vector<float> values;
+        for (size_t j = 0; j < numCols; j++)
+        {
+            for (size_t i = (j * 7) % 3; i < numRows; i += 3 + j % 5)
+            {
+                rows.push_back((int) i);
+                values.push_back((float) (i + 1) / (j + 2));
+            }
+            colStarts.push_back((int) rows.size());
+        }
+        size_t nz = values.size();
+
+        std::vector<char> packed(nz * sizeof(float) + (nz + numCols + 1) * sizeof(int));
+        float* packedValues = reinterpret_cast<float*>(packed.data());
+        int* packedRows = reinterpret_cast<int*>(packedValues + nz);
+        int* packedColStarts = packedRows + nz;
+        std::copy(values.begin(), values.end(), packedValues);
+        std::copy(rows.begin(), rows.end(), packedRows);
+        std::copy(colStarts.begin(), colStarts.end(), packedColStarts);
+
+        packedMatrix.SetMatrixFromCSCFormat(packedColStarts, packedRows, packedValues, nz, numRows, numCols);
+        matrix.SetMatrixFromCSCFormat(colStarts.data(), rows.data(), values.data(), nz, numRows, numCols);
+        BOOST_CHECK_EQUAL(nz, (size_t) packedMatrix.NzCount());
+        BOOST_CHECK(packedMatrix.CopyToDenseMatrix().IsEqualTo(matrix.CopyToDenseMatrix(), c_epsilonFloatE5));
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(GPUSparseDenseConversions, RandomSeedFixture)
 {
     GPUSparseMatrix<float> sparseMatrixA(c_deviceIdZero);
@@ -104,6 +104,34 @@ BOOST_FIXTURE_TEST_CASE(MatrixDataSynchronization_GravitatingTowardsPreferredDev
     BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrixC.GetCurrentMatrixLocation());
 }
 
+// Requires GPU
+BOOST_FIXTURE_TEST_CASE(MatrixDataSynchronization_ResolvedDenseFastPath, RandomSeedFixture)
+{
+    SingleMatrix matrixA = SingleMatrix::RandomGaussian(16, 8, c_deviceIdZero, 0, 2, IncrementCounter());
+    SingleMatrix matrixB = SingleMatrix::RandomGaussian(8, 4, c_deviceIdZero, 0, 2, IncrementCounter());
+
+    // dense matrices on one device take the fast path, which leaves all locations as they are
+    SingleMatrix matrixC(16, 4, c_deviceIdZero);
+    SingleMatrix::Multiply(matrixA, matrixB, matrixC);
+    BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrixA.GetCurrentMatrixLocation());
+    BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrixC.GetCurrentMatrixLocation());
+
+    // a matrix in the BOTH state is not resolved; the general dispatch gives the same result
+    matrixA.GetValue(0, 0);
+    BOOST_CHECK_EQUAL(CurrentDataLocation::BOTH, matrixA.GetCurrentMatrixLocation());
+    SingleMatrix matrixD(16, 4, c_deviceIdZero);
+    SingleMatrix::Multiply(matrixA, matrixB, matrixD);
+    BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrixD.GetCurrentMatrixLocation());
+    BOOST_CHECK(matrixD.IsEqualTo(matrixC, c_epsilonFloatE5));
+
+    // and so are matrices on different devices, which are moved first
+    matrixB.TransferToDeviceIfNotThere(CPUDEVICE, true);
+    SingleMatrix matrixE(16, 4, c_deviceIdZero);
+    SingleMatrix::Multiply(matrixA, matrixB, matrixE);
+    BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrixB.GetCurrentMatrixLocation());
+    BOOST_CHECK(matrixE.IsEqualTo(matrixC, c_epsilonFloatE5));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -37,6 +37,34 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteRead, RandomSeedFixture)
     BOOST_CHECK(matrixCpuCopy.IsEqualTo(matrixCpuRead, c_epsilonFloatE5));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileBinaryReadMemoryMapped, RandomSeedFixture)
+{
+    CPUMatrix<float> matrixCpu = CPUMatrix<float>::RandomUniform(43, 10, -26.3f, 30.2f, IncrementCounter());
+    std::vector<size_t> list{ 3, 1, 4, 1, 5 };
+
+    std::wstring fileNameCpu(L"MCPU.bin");
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsWrite);
+        fileCpu << matrixCpu << list << matrixCpu;
+    }
+
+    // the same values through fread() and through the mapped file
+    for (int options : { 0, (int) fileOptionsMemoryMapped })
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead | options);
+        BOOST_CHECK_EQUAL(fileCpu.IsMemoryMapped(), options != 0);
+
+        CPUMatrix<float> matrixCpuRead1, matrixCpuRead2;
+        std::vector<size_t> listRead;
+        fileCpu >> matrixCpuRead1 >> listRead >> matrixCpuRead2;
+
+        BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead1, c_epsilonFloatE5));
+        BOOST_CHECK(list == listRead);
+        BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead2, c_epsilonFloatE5));
+        BOOST_CHECK_EQUAL(fileCpu.GetPosition(), fileCpu.Size());
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixFileWriteRead, RandomSeedFixture)
 {
     // Test Matrix in Dense mode
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "File.h"
+#include <cfloat>
 #include <memory>
 #ifdef _WIN32
 #include <io.h>
@@ -15,6 +16,8 @@
 #include "../../../Source/Math/MatrixQuantizerImpl.h"
 #include "../../../Source/Math/CUDAPageLockedMemAllocator.h"
 #include "../../../Source/Math/ValueQuantizer.h"
+#include "../../../Source/Math/GradientSparsifier.h"
+#include "../../../Source/Math/CPUVectorKernels.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -471,6 +474,109 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrix1BitQuantizeDouble, RandomSeedFixture)
     TestQuantization<double>(CPUDEVICE, 100, 50, -0.5f, +0.5f, 2915, 5);
 }
 
+// The vector kernels and the generic loops must give the same ranges, bits and residuals.
+template <typename ElemType>
+static void TestQuantizationAcrossInstructionSets(size_t numRows, size_t numCols, size_t numBits, bool zeroThresholdFor1Bit)
+{
+    Matrix<ElemType> inMatrix = Matrix<ElemType>::RandomUniform(numRows, numCols, CPUDEVICE, -1, 1, 3015 + numRows);
+    Matrix<ElemType> initialResidual = Matrix<ElemType>::RandomUniform(numRows, numCols, CPUDEVICE, -0.1, 0.1, 3115 + numRows);
+    std::unique_ptr<MatrixQuantizerImpl<ElemType>> quantizer(MatrixQuantizerImpl<ElemType>::Create(CPUDEVICE, false /*useAsync*/));
+
+    std::vector<char> expectedQuantized;
+    std::vector<ElemType> expectedResidual, expectedOut;
+    let maxInstructionSet = GetCPUVectorInstructionSet();
+    for (int instructionSet = (int) CPUVectorInstructionSet::None; instructionSet <= (int) maxInstructionSet; instructionSet++)
+    {
+        SetMaxCPUVectorInstructionSet((CPUVectorInstructionSet) instructionSet);
+        Matrix<ElemType> residual = initialResidual.DeepClone();
+        QuantizedMatrix<ElemType> quantized(numRows, numCols, numBits, CPUDEVICE);
+        quantizer->QuantizeAsync(inMatrix, residual, quantized, residual, zeroThresholdFor1Bit);
+        quantizer->WaitQuantizeAsyncDone();
+        Matrix<ElemType> out(numRows, numCols, CPUDEVICE);
+        out.SetValue(1);
+        quantizer->UnquantizeAsync(quantized, out, true /*add*/);
+        quantizer->WaitUnquantizeAsyncDone();
+
+        std::vector<char> actualQuantized(quantized.Buffer(), quantized.Buffer() + quantized.GetSize());
+        std::vector<ElemType> actualResidual(residual.Data(), residual.Data() + residual.GetNumElements());
+        std::vector<ElemType> actualOut(out.Data(), out.Data() + out.GetNumElements());
+        if (instructionSet == (int) CPUVectorInstructionSet::None)
+        {
+            expectedQuantized = actualQuantized;
+            expectedResidual = actualResidual;
+            expectedOut = actualOut;
+        }
+        else
+        {
+            BOOST_CHECK(actualQuantized == expectedQuantized);
+            BOOST_CHECK(actualResidual == expectedResidual);
+            BOOST_CHECK(actualOut == expectedOut);
+        }
+    }
+    SetMaxCPUVectorInstructionSet(maxInstructionSet);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixQuantizeAcrossInstructionSets, RandomSeedFixture)
+{
+    // columns shorter than, equal to and longer than the 128 subsets of the range statistics, and with partial vectors of words
+    for (size_t numRows : { 1, 100, 128, 1000, 4099 })
+    {
+        for (bool zeroThresholdFor1Bit : { true, false })
+        {
+            TestQuantizationAcrossInstructionSets<float>(numRows, 7, 1, zeroThresholdFor1Bit);
+            TestQuantizationAcrossInstructionSets<double>(numRows, 7, 1, zeroThresholdFor1Bit);
+        }
+        TestQuantizationAcrossInstructionSets<float>(numRows, 7, 4, false);
+        TestQuantizationAcrossInstructionSets<double>(numRows, 7, 4, false);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTopKSparsify, RandomSeedFixture)
+{
+    const size_t numRows = 13, numCols = 7, numElements = numRows * numCols;
+    const size_t k = GradientSparsifier<float>::NumEntriesToSend(numElements, 0.1);
+    BOOST_CHECK_EQUAL(k, 10u);
+
+    GradientSparsifier<float> sparsifier;
+    Matrix<float> residual(numRows, numCols, CPUDEVICE);
+    residual.SetValue(0);
+    std::vector<float> accumulated(numElements, 0);
+    std::vector<int> indices(2 * k);
+    std::vector<float> values(2 * k);
+    for (size_t step = 0; step < 2; step++)
+    {
+        Matrix<float> gradient = Matrix<float>::RandomUniform(numRows, numCols, CPUDEVICE, -1.0f, 1.0f, IncrementCounter());
+        for (size_t i = 0; i < numElements; i++)
+            accumulated[i] += gradient.Data()[i];
+
+        sparsifier.Sparsify(gradient, residual, k, indices.data() + step * k, values.data() + step * k);
+
+        // the entries sent are those of largest magnitude of gradient + residual, and the residual keeps the others
+        float smallestSent = FLT_MAX;
+        for (size_t i = step * k; i < (step + 1) * k; i++)
+        {
+            BOOST_CHECK_EQUAL(values[i], accumulated[indices[i]]);
+            BOOST_CHECK_EQUAL(residual.Data()[indices[i]], 0.0f);
+            smallestSent = std::min(smallestSent, fabs(values[i]));
+            accumulated[indices[i]] = 0;
+        }
+        for (size_t i = 0; i < numElements; i++)
+        {
+            BOOST_CHECK_CLOSE(residual.Data()[i] + 1, accumulated[i] + 1, c_SinglePrecisionTolerance);
+            BOOST_CHECK_LE(fabs(residual.Data()[i]), smallestSent);
+        }
+    }
+
+    // merging two blocks (as from two workers) sums up their entries
+    Matrix<float> merged(numRows, numCols, CPUDEVICE);
+    sparsifier.Merge(indices.data(), values.data(), k, merged, 2, k);
+    std::vector<float> expected(numElements, 0);
+    for (size_t i = 0; i < 2 * k; i++)
+        expected[indices[i]] += values[i];
+    for (size_t i = 0; i < numElements; i++)
+        BOOST_CHECK_EQUAL(merged.Data()[i], expected[i]);
+}
+
 /*
         Original test cases were using these parameter:
 
@@ -1116,6 +1116,919 @@ BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
         BOOST_CHECK_EQUAL(expectedDiff, actual.Get00Element());
     }
 }
+
+// reference for MultiTensorUpdate(): the single-tensor update functions, applied as in SGD::UpdateWeights()
+static void UpdateOneTensor(MultiTensorUpdateRule rule, const MultiTensorUpdateItem<float>& item, const MultiTensorUpdateParams<float>& params, double& smoothedCount,
+                            SingleMatrix& value, SingleMatrix gradient, SingleMatrix& smoothedGradient)
+{
+    double larsTrustRatio = GetLarsTrustRatio(value.FrobeniusNorm(), gradient.FrobeniusNorm(), item.l2RegWeight, params.larsCoefficient);
+    SingleMatrix::ScaleAndAdd(item.l2RegWeight, value, gradient);
+    if (rule == MultiTensorUpdateRule::Lars)
+        smoothedGradient.NormalGrad(gradient, value, (float) (item.learnRatePerSample * larsTrustRatio), params.momentum, false);
+    else if (rule == MultiTensorUpdateRule::Lamb)
+        smoothedGradient.LambUpdate(gradient, value, smoothedCount, item.learnRatePerSample, params.momentum, params.varMomentum, params.adamEpsilon, item.decoupledDecay);
+    else if (rule == MultiTensorUpdateRule::Momentum || rule == MultiTensorUpdateRule::NesterovMomentum)
+        smoothedGradient.NormalGrad(gradient, value, item.learnRatePerSample, params.momentum, rule == MultiTensorUpdateRule::NesterovMomentum);
+    else if (rule == MultiTensorUpdateRule::AdaGrad)
+        SingleMatrix::ScaleAndAdd(-item.learnRatePerSample / smoothedGradient.Adagrad(gradient, params.needAveMultiplier), gradient, value);
+    else if (rule == MultiTensorUpdateRule::FSAdaGrad)
+        smoothedGradient.FSAdagradUpdate(4, gradient, value, smoothedCount, item.learnRatePerSample, 1.0, params.momentum, params.varMomentum);
+    else if (rule == MultiTensorUpdateRule::Adam)
+        smoothedGradient.AdamUpdate(gradient, value, smoothedCount, item.learnRatePerSample, params.momentum, params.varMomentum, params.adamEpsilon, item.decoupledDecay / item.learnRatePerSample);
+    else
+        SingleMatrix::ScaleAndAdd(-item.learnRatePerSample / smoothedGradient.RmsProp(gradient, params.rmsGamma, params.rmsWgtInc, params.rmsWgtMax, params.rmsWgtDec, params.rmsWgtMin, params.needAveMultiplier), gradient, value);
+    value.InplaceSoftThreshold(item.l1Threshold);
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixMultiTensorUpdate, RandomSeedFixture)
+{
+    const size_t numRows[] = { 3, 5 }, numCols[] = { 4, 2 };
+    MultiTensorUpdateParams<float> params = {};
+    params.momentum = 0.9f;
+    params.varMomentum = 0.99f;
+    params.adamEpsilon = 1e-8f;
+    params.larsCoefficient = 0.01f;
+    params.needAveMultiplier = true;
+    params.rmsGamma = 0.99f, params.rmsWgtInc = 1.2f, params.rmsWgtMax = 10.0f, params.rmsWgtDec = 0.75f, params.rmsWgtMin = 0.1f;
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        for (auto rule : { MultiTensorUpdateRule::Momentum, MultiTensorUpdateRule::NesterovMomentum, MultiTensorUpdateRule::AdaGrad, MultiTensorUpdateRule::FSAdaGrad, MultiTensorUpdateRule::RmsProp, MultiTensorUpdateRule::Adam,
+                           MultiTensorUpdateRule::Lars, MultiTensorUpdateRule::Lamb })
+        {
+            params.rule = rule;
+            vector<SingleMatrix> expectedValues, values, expectedStates, states;
+            vector<MultiTensorUpdateItem<float>> items;
+            for (size_t k = 0; k < 2; k++)
+            {
+                expectedValues.push_back(SingleMatrix::RandomUniform(numRows[k], numCols[k], deviceId, -1, 1, IncrementCounter()));
+                values.push_back(expectedValues.back().DeepClone());
+                expectedStates.push_back(SingleMatrix::Zeros(numRows[k], numCols[k], deviceId));
+                states.push_back(SingleMatrix::Zeros(numRows[k], numCols[k], deviceId));
+                MultiTensorUpdateItem<float> item = {};
+                item.learnRatePerSample = 0.1f * (k + 1);
+                item.gradientScale = 1;
+                item.l2RegWeight = 0.01f;
+                item.l1Threshold = k == 0 ? 0.001f : 0;
+                item.decoupledDecay = k == 1 ? 0.01f * item.learnRatePerSample : 0;
+                item.emaDecay = 0.9f;
+                items.push_back(item);
+            }
+            // moving average of the first value only, initialized on first use
+            SingleMatrix expectedEma = expectedValues[0].DeepClone(), ema(deviceId);
+
+            vector<double> expectedCounts(2, 0), counts(2, 0);
+            for (size_t step = 0; step < 2; step++) // (the second step uses the state of the first)
+            {
+                vector<SingleMatrix> gradients;
+                for (size_t k = 0; k < 2; k++)
+                {
+                    gradients.push_back(SingleMatrix::RandomUniform(numRows[k], numCols[k], deviceId, -1, 1, IncrementCounter()));
+                    UpdateOneTensor(rule, items[k], params, expectedCounts[k], expectedValues[k], gradients[k].DeepClone(), expectedStates[k]);
+                    if (rule == MultiTensorUpdateRule::Adam || rule == MultiTensorUpdateRule::Lamb)
+                        items[k].adaMul = (float) GetAdamBiasCorrection(params.momentum, params.varMomentum, ++counts[k]); // see Matrix::AdamUpdate()
+                    else
+                    {
+                        counts[k] = params.varMomentum * counts[k] + (1.0 - params.varMomentum) * 4; // see Matrix::FSAdagradUpdate()
+                        items[k].adaMul = (float) sqrt(counts[k]);
+                    }
+                }
+                Matrix<float>::MultiTensorUpdate({ &values[0], &values[1] }, { &gradients[0], &gradients[1] }, { &states[0], &states[1] }, items, params, { &ema, nullptr });
+                SingleMatrix::AddScaledDifference(1 - items[0].emaDecay, expectedValues[0], expectedEma, expectedEma);
+            }
+
+            for (size_t k = 0; k < 2; k++)
+                BOOST_CHECK(values[k].IsEqualTo(expectedValues[k], c_epsilonFloatE5));
+            BOOST_CHECK(ema.IsEqualTo(expectedEma, c_epsilonFloatE5));
+        }
+
+        // sums of squares
+        SingleMatrix a = SingleMatrix::RandomUniform(3, 4, deviceId, -1, 1, IncrementCounter());
+        SingleMatrix b = SingleMatrix::RandomUniform(100, 200, deviceId, -1, 1, IncrementCounter());
+        auto sumsOfSquares = SingleMatrix::MultiTensorSumOfSquares({ &a, &b });
+        BOOST_REQUIRE_EQUAL(sumsOfSquares.size(), 2u);
+        BOOST_CHECK_CLOSE(sumsOfSquares[0], pow(a.FrobeniusNorm(), 2), 1e-3);
+        BOOST_CHECK_CLOSE(sumsOfSquares[1], pow(b.FrobeniusNorm(), 2), 1e-3);
+    }
+}
+
+// Adam and AdamW against the textbook formulas with bias-corrected moments
+BOOST_FIXTURE_TEST_CASE(MatrixAdamUpdate, RandomSeedFixture)
+{
+    const size_t numRows = 4, numCols = 3;
+    const double learnRatePerSample = 0.01, momentum = 0.9, varMomentum = 0.999, epsilon = 1e-8;
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        for (double weightDecay : { 0.0, 0.1 })
+        {
+            SingleMatrix value = SingleMatrix::RandomUniform(numRows, numCols, deviceId, -1, 1, IncrementCounter());
+            SingleMatrix smoothedGradient(deviceId);
+            double smoothedCount = 0;
+            unique_ptr<float[]> initialValue(value.CopyToArray());
+            vector<float> expectedValue(initialValue.get(), initialValue.get() + numRows * numCols), m(numRows * numCols, 0), v(numRows * numCols, 0);
+
+            for (size_t t = 1; t <= 3; t++)
+            {
+                SingleMatrix gradient = SingleMatrix::RandomUniform(numRows, numCols, deviceId, -1, 1, IncrementCounter());
+                unique_ptr<float[]> g(gradient.CopyToArray());
+                for (size_t i = 0; i < expectedValue.size(); i++)
+                {
+                    expectedValue[i] -= (float) (learnRatePerSample * weightDecay * expectedValue[i]);
+                    m[i] = (float) (momentum * m[i] + (1 - momentum) * g[i]);
+                    v[i] = (float) (varMomentum * v[i] + (1 - varMomentum) * g[i] * g[i]);
+                    double mHat = m[i] / (1 - pow(momentum, t)), vHat = v[i] / (1 - pow(varMomentum, t));
+                    expectedValue[i] -= (float) (learnRatePerSample * mHat / (sqrt(vHat) + epsilon));
+                }
+                smoothedGradient.AdamUpdate(gradient, value, smoothedCount, learnRatePerSample, momentum, varMomentum, epsilon, weightDecay);
+            }
+            BOOST_CHECK_EQUAL(smoothedCount, 3);
+            BOOST_CHECK_EQUAL(smoothedGradient.GetNumCols(), 2 * numCols);
+
+            unique_ptr<float[]> result(value.CopyToArray());
+            for (size_t i = 0; i < expectedValue.size(); i++)
+                BOOST_CHECK_CLOSE(result[i], expectedValue[i], 1e-2);
+        }
+    }
+}
+
+// LAMB against the formulas of You et al.: the Adam step plus weight decay, scaled to the trust ratio |w| / |step|
+BOOST_FIXTURE_TEST_CASE(MatrixLambUpdate, RandomSeedFixture)
+{
+    const size_t numRows = 5, numCols = 4, n = numRows * numCols;
+    const double learnRatePerSample = 0.01, momentum = 0.9, varMomentum = 0.999, epsilon = 1e-8, weightDecay = 0.01;
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix value = SingleMatrix::RandomUniform(numRows, numCols, deviceId, -1, 1, IncrementCounter());
+        SingleMatrix smoothedGradient(deviceId);
+        double smoothedCount = 0;
+        unique_ptr<float[]> initialValue(value.CopyToArray());
+        vector<double> expectedValue(initialValue.get(), initialValue.get() + n), m(n, 0), v(n, 0), step(n);
+
+        for (size_t t = 1; t <= 2; t++)
+        {
+            SingleMatrix gradient = SingleMatrix::RandomUniform(numRows, numCols, deviceId, -1, 1, IncrementCounter());
+            unique_ptr<float[]> g(gradient.CopyToArray());
+            double weightNorm = 0, stepNorm = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                m[i] = momentum * m[i] + (1 - momentum) * g[i];
+                v[i] = varMomentum * v[i] + (1 - varMomentum) * g[i] * g[i];
+                double mHat = m[i] / (1 - pow(momentum, t)), vHat = v[i] / (1 - pow(varMomentum, t));
+                step[i] = mHat / (sqrt(vHat) + epsilon) + weightDecay * expectedValue[i];
+                weightNorm += expectedValue[i] * expectedValue[i];
+                stepNorm += step[i] * step[i];
+            }
+            for (size_t i = 0; i < n; i++)
+                expectedValue[i] -= learnRatePerSample * sqrt(weightNorm / stepNorm) * step[i];
+            smoothedGradient.LambUpdate(gradient, value, smoothedCount, learnRatePerSample, momentum, varMomentum, epsilon, weightDecay);
+        }
+
+        unique_ptr<float[]> result(value.CopyToArray());
+        for (size_t i = 0; i < n; i++)
+            BOOST_CHECK_CLOSE(result[i], expectedValue[i], 1e-2);
+    }
+}
+
+// lazy updates with block-column gradients, as of an embedding of one-hot input, against dense updates with the same gradients
+BOOST_FIXTURE_TEST_CASE(MatrixLazySparseUpdate, RandomSeedFixture)
+{
+    const size_t dim = 3, vocabSize = 6;
+    const vector<vector<size_t>> wordsPerStep = { { 0, 5 }, { 1, 5 }, { 0, 2 }, { 3, 5 }, { 0, 1 } }; // (word 4 is never seen)
+    const float learnRatePerSample = 0.1f, momentum = 0.9f, varMomentum = 0.99f;
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        for (int rule = 0; rule < 3; rule++) // momentum, Nesterov momentum, FSAdaGrad
+        {
+            SingleMatrix expectedValue = SingleMatrix::RandomUniform(dim, vocabSize, deviceId, -1, 1, IncrementCounter());
+            SingleMatrix value = expectedValue.DeepClone();
+            SingleMatrix expectedSmoothedGradient = SingleMatrix::Zeros(dim, vocabSize, deviceId); // (as allocated by SGD)
+            SingleMatrix smoothedGradient = SingleMatrix::Zeros(dim, vocabSize, deviceId);
+            double expectedSmoothedCount = 0, smoothedCount = 0;
+            vector<size_t> lastUpdates;
+
+            for (size_t step = 0; step < wordsPerStep.size(); step++)
+            {
+                SingleMatrix input = SingleMatrix::Zeros(vocabSize, wordsPerStep[step].size(), deviceId);
+                for (size_t t = 0; t < wordsPerStep[step].size(); t++)
+                    input.SetValue(wordsPerStep[step][t], t, 1);
+                SingleMatrix outputGradient = SingleMatrix::RandomUniform(dim, wordsPerStep[step].size(), deviceId, -1, 1, IncrementCounter());
+                SingleMatrix gradient(deviceId);
+                SingleMatrix::MultiplyAndWeightedAdd(1, outputGradient, false, input, true, 0, gradient);
+                input.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, true);
+                SingleMatrix sparseGradient(deviceId);
+                sparseGradient.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseBlockCol, false);
+                SingleMatrix::MultiplyAndWeightedAdd(1, outputGradient, false, input, true, 0, sparseGradient);
+
+                if (rule < 2)
+                {
+                    expectedSmoothedGradient.NormalGrad(gradient, expectedValue, learnRatePerSample, momentum, rule == 1);
+                    smoothedGradient.LazyNormalGrad(sparseGradient, value, lastUpdates, step + 1, learnRatePerSample, momentum, rule == 1);
+                }
+                else
+                {
+                    expectedSmoothedGradient.FSAdagradUpdate(2, gradient, expectedValue, expectedSmoothedCount, learnRatePerSample, 1.0, momentum, varMomentum);
+                    smoothedGradient.LazyFSAdagradUpdate(2, sparseGradient, value, smoothedCount, lastUpdates, step + 1, learnRatePerSample, 1.0, momentum, varMomentum);
+                }
+            }
+            BOOST_CHECK(!value.IsEqualTo(expectedValue, c_epsilonFloatE5)); // (columns not in the last gradient lag behind)
+
+            if (rule < 2)
+                smoothedGradient.CatchUpLazyNormalGrad(value, lastUpdates, wordsPerStep.size(), momentum, rule == 1);
+            else
+                smoothedGradient.CatchUpLazyFSAdagrad(value, lastUpdates, wordsPerStep.size(), learnRatePerSample, momentum, varMomentum);
+            BOOST_CHECK(value.IsEqualTo(expectedValue, c_epsilonFloatE5));
+            BOOST_CHECK(smoothedGradient.IsEqualTo(expectedSmoothedGradient, c_epsilonFloatE5));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixFusedDropout, RandomSeedFixture)
+{
+    const size_t rows = 64, cols = 128;
+    const float dropoutRate = 0.3f, scale = 1 / (1 - dropoutRate);
+    const uint64_t seed = 1234, offset = 5678;
+
+    SingleMatrix cpuOutput(CPUDEVICE);
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix input = SingleMatrix::Ones(rows, cols, deviceId);
+        SingleMatrix output(deviceId);
+        SingleMatrix::Dropout(0, input, dropoutRate, seed, offset, output);
+
+        // every element is either dropped or scaled, at about the dropout rate
+        SingleMatrix dropped(deviceId);
+        dropped.AssignNumOfDiff(output, SingleMatrix::Zeros(rows, cols, deviceId));
+        size_t numKept = (size_t) dropped.Get00Element();
+        SingleMatrix scaled(deviceId);
+        scaled.AssignNumOfDiff(output, SingleMatrix::Ones(rows, cols, deviceId) * scale);
+        BOOST_CHECK_EQUAL((size_t) scaled.Get00Element(), rows * cols - numKept);
+        BOOST_CHECK_CLOSE(1 - numKept / (double) (rows * cols), dropoutRate, 10);
+
+        // backprop with the same seed and offset regenerates the mask and accumulates into the gradient
+        SingleMatrix gradient = SingleMatrix::Ones(rows, cols, deviceId);
+        SingleMatrix::Dropout(1, input, dropoutRate, seed, offset, gradient);
+        BOOST_CHECK(gradient.IsEqualTo(output + input, c_epsilonFloatE5));
+
+        // a column slice draws its mask from the counters of its first element on
+        SingleMatrix slice(deviceId);
+        SingleMatrix::Dropout(0, input.ColumnSlice(10, 5), dropoutRate, seed, offset + 10 * rows, slice);
+        BOOST_CHECK(slice.IsEqualTo(output.ColumnSlice(10, 5), c_epsilonFloatE5));
+
+        // and the masks do not depend on the device
+        if (deviceId == CPUDEVICE)
+            cpuOutput = output.DeepClone();
+        else
+        {
+            output.TransferToDeviceIfNotThere(CPUDEVICE, true);
+            BOOST_CHECK(output.IsEqualTo(cpuOutput, c_epsilonFloatE5));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixCounterBasedRandomValue, RandomSeedFixture)
+{
+    const size_t rows = 100, cols = 200, n = rows * cols;
+    const uint64_t seed = 0x0123456789ABCDEFull;
+
+    vector<float> cpuUniform, cpuGaussian;
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix uniform(rows, cols, deviceId);
+        uniform.SetCounterBasedUniformRandomValue(-0.5f, 1.5f, seed);
+        SingleMatrix gaussian(rows, cols, deviceId);
+        gaussian.SetCounterBasedGaussianRandomValue(1, 2, seed);
+
+        // element i only depends on (seed, i): a column slice is the matrix of its elements, and another seed differs
+        SingleMatrix slice(rows, 5, deviceId);
+        slice.SetCounterBasedUniformRandomValue(-0.5f, 1.5f, seed);
+        BOOST_CHECK(slice.IsEqualTo(uniform.ColumnSlice(0, 5), 0));
+        SingleMatrix other(rows, cols, deviceId);
+        other.SetCounterBasedUniformRandomValue(-0.5f, 1.5f, seed + 1);
+        BOOST_CHECK(!other.IsEqualTo(uniform, c_epsilonFloatE5));
+
+        unique_ptr<float[]> uniformValues(uniform.CopyToArray());
+        unique_ptr<float[]> gaussianValues(gaussian.CopyToArray());
+        vector<float> u(uniformValues.get(), uniformValues.get() + n), g(gaussianValues.get(), gaussianValues.get() + n);
+        double uniformSum = 0, gaussianSum = 0, gaussianSquareSum = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            BOOST_CHECK(u[i] >= -0.5f && u[i] <= 1.5f);
+            uniformSum += u[i];
+            gaussianSum += g[i];
+            gaussianSquareSum += (g[i] - 1) * (g[i] - 1);
+        }
+        BOOST_CHECK_CLOSE(uniformSum / n, 0.5, 2);
+        BOOST_CHECK_CLOSE(gaussianSum / n, 1, 3);
+        BOOST_CHECK_CLOSE(sqrt(gaussianSquareSum / n), 2, 2);
+
+        // the bits do not depend on the device
+        if (deviceId == CPUDEVICE)
+        {
+            cpuUniform = u;
+            cpuGaussian = g;
+        }
+        else
+        {
+            BOOST_CHECK(u == cpuUniform);
+            BOOST_CHECK(g == cpuGaussian);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixFlagNonFiniteValues, RandomSeedFixture)
+{
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix flag(1, 1, deviceId);
+        flag.SetValue(0);
+        SingleMatrix m = SingleMatrix::RandomUniform(50, 40, deviceId, -1e30f, 1e30f, IncrementCounter());
+        m.FlagNonFiniteValues(flag);
+        BOOST_CHECK_EQUAL(flag.Get00Element(), 0);
+        BOOST_CHECK(!m.HasNonFiniteValues());
+
+        // the flag stays set over later checks of finite matrices
+        for (auto value : { std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() })
+        {
+            SingleMatrix n = m.DeepClone();
+            n.SetValue(49, 39, value);
+            BOOST_CHECK(n.HasNonFiniteValues());
+            flag.SetValue(0);
+            n.FlagNonFiniteValues(flag);
+            m.FlagNonFiniteValues(flag);
+            BOOST_CHECK_EQUAL(flag.Get00Element(), 1);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixBatchNormalizationRelu, RandomSeedFixture)
+{
+    const size_t numMaps = 3, spatialSize = 4, numCols = 5;
+    const double epsilon = 1e-5;
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix in = SingleMatrix::RandomUniform(numMaps * spatialSize, numCols, deviceId, -1, 1, IncrementCounter());
+        SingleMatrix scale = SingleMatrix::RandomUniform(numMaps, 1, deviceId, 0.5f, 2, IncrementCounter());
+        SingleMatrix bias = SingleMatrix::RandomUniform(numMaps, 1, deviceId, -0.5f, 0.5f, IncrementCounter());
+        SingleMatrix mean = SingleMatrix::RandomUniform(numMaps, 1, deviceId, -0.5f, 0.5f, IncrementCounter());
+        SingleMatrix variance = SingleMatrix::RandomUniform(numMaps, 1, deviceId, 0.5f, 2, IncrementCounter());
+        SingleMatrix savedMean(deviceId), savedInvStdDev(deviceId);
+
+        // the fused ReLU clips the normalized output
+        SingleMatrix out(numMaps * spatialSize, numCols, deviceId), outRelu(numMaps * spatialSize, numCols, deviceId);
+        in.BatchNormalizationForward(scale, bias, true, 0, 1, mean, variance, out, epsilon, savedMean, savedInvStdDev);
+        in.BatchNormalizationForward(scale, bias, true, 0, 1, mean, variance, outRelu, epsilon, savedMean, savedInvStdDev, /*reluOutput=*/ true);
+        SingleMatrix expectedRelu = out.DeepClone();
+        expectedRelu.InplaceTruncateBottom(0);
+        BOOST_CHECK(outRelu.IsEqualTo(expectedRelu, c_epsilonFloatE5));
+
+        // backprop through the ReLU recomputes the normalization from the statistics, here those of the inference above
+        savedMean = mean.DeepClone();
+        savedInvStdDev = variance.DeepClone();
+        savedInvStdDev += (float) epsilon;
+        savedInvStdDev.InplaceSqrt();
+        savedInvStdDev.ElementInverse();
+        SingleMatrix gradient = SingleMatrix::RandomUniform(numMaps * spatialSize, numCols, deviceId, -1, 1, IncrementCounter());
+        SingleMatrix expectedGradient(deviceId);
+        expectedGradient.AssignLinearRectifierDerivativeOf(out);
+        expectedGradient.ElementMultiplyWith(gradient);
+        gradient.BatchNormalizationReluBackward(in, scale, bias, savedMean, savedInvStdDev);
+        BOOST_CHECK(gradient.IsEqualTo(expectedGradient, c_epsilonFloatE5));
+    }
+}
+BOOST_FIXTURE_TEST_CASE(MatrixROIPooling, RandomSeedFixture)
+{
+    const size_t width = 6, height = 5, channels = 2, numImg = 2, numRois = 3, pooledWidth = 2, pooledHeight = 2;
+    const size_t planeSize = width * height, roiOutputSize = pooledWidth * pooledHeight * channels;
+
+    // images linear in the coordinates, value(w, h, c) = w + 10 h + 100 c
+    vector<float> images;
+    for (size_t n = 0; n < numImg; n++)
+        for (size_t i = 0; i < planeSize * channels; i++)
+            images.push_back((float) (i % width + 10 * ((i / width) % height) + 100 * (i / planeSize) + n));
+    // ROIs (x, y, w, h) relative to the image size, all sampled inside of the pixel centers
+    vector<float> rois{ 0.25f, 0.2f, 0.5f, 0.6f,   0.1f, 0.15f, 0.7f, 0.7f,   0.3f, 0.4f, 0.4f, 0.4f };
+    rois.insert(rois.end(), rois.begin(), rois.end());
+
+    // ROIAlign of a linear function is its value at the center of each bin
+    vector<float> expected;
+    for (size_t n = 0; n < numImg; n++)
+        for (size_t r = 0; r < numRois; r++)
+            for (size_t i = 0; i < roiOutputSize; i++)
+            {
+                const float* roi = &rois[(n * numRois + r) * 4];
+                float x = roi[0] * width  + (i % pooledWidth + 0.5f) * roi[2] * width / pooledWidth;
+                float y = roi[1] * height + ((i / pooledWidth) % pooledHeight + 0.5f) * roi[3] * height / pooledHeight;
+                expected.push_back((x - 0.5f) + 10 * (y - 0.5f) + 100 * (i / pooledWidth / pooledHeight) + n);
+            }
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix in(planeSize * channels, numImg, images.data(), deviceId);
+        SingleMatrix roiData(4 * numRois, numImg, rois.data(), deviceId);
+        SingleMatrix out(roiOutputSize * numRois, numImg, deviceId);
+        SingleMatrix expectedOut(roiOutputSize * numRois, numImg, expected.data(), deviceId);
+        for (size_t samplingRatio : { 0, 2 })
+        {
+            in.ROIAlignForward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, samplingRatio, roiData, out);
+            BOOST_CHECK(out.IsEqualTo(expectedOut, c_epsilonFloatE4));
+
+            // the weights of each bin sum to 1, and the gradients add to those of the images
+            SingleMatrix pooledGrad = SingleMatrix::Ones(roiOutputSize * numRois, numImg, deviceId);
+            SingleMatrix grad = SingleMatrix::Ones(planeSize * channels, numImg, deviceId);
+            pooledGrad.ROIAlignBackward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, samplingRatio, roiData, grad);
+            BOOST_CHECK_CLOSE(grad.SumOfElements(), (float) (planeSize * channels * numImg + roiOutputSize * numRois * numImg), 1e-3f);
+        }
+
+        // the gradient of each bin is added to that of its max
+        SingleMatrix argmax(roiOutputSize * numRois, numImg, deviceId);
+        in.ROIPoolingForward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, roiData, out, argmax);
+        SingleMatrix pooledGrad = SingleMatrix::Ones(roiOutputSize * numRois, numImg, deviceId);
+        SingleMatrix grad = SingleMatrix::Ones(planeSize * channels, numImg, deviceId);
+        pooledGrad.ROIPoolingBackward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, roiData, grad, argmax);
+        BOOST_CHECK_CLOSE(grad.SumOfElements(), (float) (planeSize * channels * numImg + roiOutputSize * numRois * numImg), 1e-3f);
+        grad.ElementMultiplyWith(in);
+        pooledGrad.ElementMultiplyWith(out);
+        BOOST_CHECK_CLOSE(grad.SumOfElements(), in.SumOfElements() + pooledGrad.SumOfElements(), 1e-3f);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixLambdaRank, RandomSeedFixture)
+{
+    // two queries of three urls each, in descending order of gain within a query
+    vector<float> gains{ 31, 7, 0, 3, 0, 0 };
+    vector<float> scores{ 0.9f, 0.3f, 0.0f, 0.4f, 0.5f, 0.3f };
+    vector<float> queryIds{ 0, 0, 0, 1, 1, 1 };
+    vector<float> expectedRanks{ 0, 1, 2, 1, 0, 2 };
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix gain(1, 6, gains.data(), deviceId);
+        SingleMatrix score(1, 6, scores.data(), deviceId);
+        SingleMatrix queryId(1, 6, queryIds.data(), deviceId);
+
+        SingleMatrix ranks(deviceId);
+        ranks.AssignRanksWithinQueries(score, gain, queryId);
+        BOOST_CHECK(ranks.IsEqualTo(SingleMatrix(1, 6, expectedRanks.data(), deviceId), c_epsilonFloatE5));
+
+        // the first query is in the ideal order, the second one has its only gain at rank 1
+        SingleMatrix ndcg(deviceId), queryStarts(deviceId);
+        ndcg.AssignNDCGContributions(gain, ranks, queryId, false, queryStarts);
+        BOOST_CHECK_CLOSE(ndcg.SumOfElements(), 1 + log(2.0f) / log(3.0f), 1e-3f);
+        BOOST_CHECK_EQUAL(queryStarts.SumOfElements(), 2.0f);
+        ndcg.AssignNDCGContributions(gain, ranks, queryId, true, queryStarts);
+        BOOST_CHECK_CLOSE(ndcg.SumOfElements(), 1.0f, 1e-3f);
+
+        // the lambdas of a pair cancel out, the url with gain in the second query is pushed up and the others down
+        SingleMatrix gradient = SingleMatrix::Ones(1, 6, deviceId);
+        gradient.AddLambdaRankGradient(gain, score, ranks, queryId, 1.0f);
+        BOOST_CHECK_CLOSE(gradient.SumOfElements(), 6.0f, 1e-3f);
+        BOOST_CHECK_LT(gradient(0, 3), 1.0f);
+        BOOST_CHECK_GT(gradient(0, 4), 1.0f);
+        BOOST_CHECK_GT(gradient(0, 5), 1.0f);
+    }
+}
+
+// Brute force over all label paths of a sequence of a linear-chain CRF, the path starting from the label of its first frame.
+struct CRFPathStatistics
+{
+    double logZ = -1e30, labeledScore = 0, bestScore = -1e30;
+    vector<int> bestPath;
+    vector<double> posteriors;      // numLabels x numFrames
+    vector<double> pairPosteriors;  // numLabels x numLabels, summed over the frames
+};
+
+static CRFPathStatistics EnumerateCRFPaths(const vector<float>& scores, const vector<float>& transitions, const vector<float>& labels, const vector<size_t>& columns, int numLabels)
+{
+    CRFPathStatistics result;
+    int numFrames = (int)columns.size();
+    int startLabel = (int)labels[columns[0]];
+    vector<double> pathScores;
+    vector<vector<int>> paths;
+    vector<int> path(numFrames, 0);
+    for (bool done = false; !done;)
+    {
+        double score = 0;
+        for (int t = 0; t < numFrames; t++)
+            score += transitions[path[t] + (t == 0 ? startLabel : path[t - 1]) * numLabels] + scores[path[t] + columns[t] * numLabels];
+        result.logZ = max(result.logZ, score) + log1p(exp(min(result.logZ, score) - max(result.logZ, score)));
+        if (score > result.bestScore)
+        {
+            result.bestScore = score;
+            result.bestPath = path;
+        }
+        pathScores.push_back(score);
+        paths.push_back(path);
+
+        done = true;
+        for (int t = 0; t < numFrames && done; t++)
+        {
+            done = ++path[t] == numLabels;
+            if (done)
+                path[t] = 0;
+        }
+    }
+
+    result.posteriors.assign(numLabels * numFrames, 0);
+    result.pairPosteriors.assign(numLabels * numLabels, 0);
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        double posterior = exp(pathScores[i] - result.logZ);
+        for (int t = 0; t < numFrames; t++)
+        {
+            result.posteriors[paths[i][t] + t * numLabels] += posterior;
+            result.pairPosteriors[paths[i][t] + (t == 0 ? startLabel : paths[i][t - 1]) * numLabels] += posterior;
+        }
+    }
+    for (int t = 0; t < numFrames; t++)
+        result.labeledScore += transitions[(int)labels[columns[t]] + (int)labels[columns[t == 0 ? 0 : t - 1]] * numLabels] + scores[(int)labels[columns[t]] + columns[t] * numLabels];
+    return result;
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixLinearChainCRF, RandomSeedFixture)
+{
+    // two parallel sequences of 4 and 3 frames, 3 labels; column 7 is a gap
+    const int numLabels = 3;
+    const size_t stride = 2;
+    vector<float> sequenceRanges{ 0, 4, 1, 3 };
+    vector<vector<size_t>> sequenceColumns{ { 0, 2, 4, 6 }, { 1, 3, 5 } };
+    vector<float> labels{ 0, 0, 2, 1, 1, 1, 0, 0 };
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> distribution(-2.0f, 2.0f);
+    vector<float> scores(numLabels * 8), transitions(numLabels * numLabels);
+    for (auto& value : scores)
+        value = distribution(rng);
+    for (auto& value : transitions)
+        value = distribution(rng);
+
+    vector<CRFPathStatistics> expected;
+    for (const auto& columns : sequenceColumns)
+        expected.push_back(EnumerateCRFPaths(scores, transitions, labels, columns, numLabels));
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix score(numLabels, 8, scores.data(), deviceId);
+        SingleMatrix transition(numLabels, numLabels, transitions.data(), deviceId);
+        SingleMatrix labelIndices(1, 8, labels.data(), deviceId);
+        SingleMatrix sequences(2, 2, sequenceRanges.data(), deviceId);
+
+        SingleMatrix alpha(deviceId);
+        alpha.AssignCRFForwardScores(score, transition, labelIndices, sequences, stride);
+
+        SingleMatrix losses(deviceId);
+        losses.AssignCRFNegativeLogLikelihoods(alpha, score, transition, labelIndices, sequences, stride);
+        for (int s = 0; s < 2; s++)
+            BOOST_CHECK_CLOSE(losses(0, s), expected[s].logZ - expected[s].labeledScore, 1e-2f);
+
+        SingleMatrix logPosteriors(deviceId);
+        logPosteriors.AssignCRFLogPosteriors(alpha, score, transition, sequences, stride);
+        for (int s = 0; s < 2; s++)
+            for (size_t t = 0; t < sequenceColumns[s].size(); t++)
+                for (int k = 0; k < numLabels; k++)
+                    BOOST_CHECK_SMALL(exp(logPosteriors(k, sequenceColumns[s][t])) - expected[s].posteriors[k + t * numLabels], 1e-4);
+
+        SingleMatrix gradient(deviceId);
+        gradient.AssignCRFTransitionGradient(logPosteriors, alpha, score, transition, labelIndices, sequences, stride);
+        for (int k = 0; k < numLabels; k++)
+        {
+            for (int j = 0; j < numLabels; j++)
+            {
+                double expectedGradient = expected[0].pairPosteriors[k + j * numLabels] + expected[1].pairPosteriors[k + j * numLabels];
+                for (int s = 0; s < 2; s++)
+                    for (size_t t = 0; t < sequenceColumns[s].size(); t++)
+                        if (labels[sequenceColumns[s][t]] == k && labels[sequenceColumns[s][t == 0 ? 0 : t - 1]] == j)
+                            expectedGradient -= 1;
+                BOOST_CHECK_SMALL(gradient(k, j) - expectedGradient, 1e-4);
+            }
+        }
+
+        SingleMatrix path(deviceId), viterbiScores(deviceId), backPointers(deviceId);
+        path.AssignCRFViterbiPath(score, transition, labelIndices, sequences, stride, viterbiScores, backPointers);
+        BOOST_CHECK_EQUAL(path.SumOfElements(), 7.0f);
+        for (int s = 0; s < 2; s++)
+            for (size_t t = 0; t < sequenceColumns[s].size(); t++)
+                BOOST_CHECK_EQUAL(path(expected[s].bestPath[t], sequenceColumns[s][t]), 1.0f);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixSequenceStreamCompaction, RandomSeedFixture)
+{
+    // two parallel sequences of 4 and 3 frames; column 7 is a gap
+    const size_t stride = 2;
+    vector<float> sequenceRanges{ 0, 4, 1, 3 };
+    vector<float> condition{ 1, 0, 0, 2, 3, 0, 0, 5 };
+    // the output: sequences of 2 and 1 frames, packed into 2 parallel sequences; column 3 is a gap
+    const size_t outputStride = 2;
+    vector<float> outputSequenceRanges{ 0, 2, 1, 1 };
+    // indices into sequences of 3 and 4 frames in the reverse order; the 3rd index of the first sequence is out of range
+    vector<float> positionValues{ 1, 3, 2, 0, 3, 2, 1, 0 };
+    vector<float> targetSequenceRanges{ 1, 3, 0, 4 };
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix a(1, 8, condition.data(), deviceId);
+        SingleMatrix sequences(2, 2, sequenceRanges.data(), deviceId);
+        SingleMatrix outputSequences(2, 2, outputSequenceRanges.data(), deviceId);
+
+        SingleMatrix counts(deviceId);
+        counts.AssignNonZeroCountsOfSequences(a, sequences, stride);
+        BOOST_CHECK_EQUAL(counts(0, 0), 2.0f);
+        BOOST_CHECK_EQUAL(counts(0, 1), 1.0f);
+
+        SingleMatrix positions(1, 4, deviceId);
+        positions.SetValue(-7.0f);
+        positions.AssignNonZeroPositionsOfSequences(a, sequences, stride, outputSequences, outputStride);
+        BOOST_CHECK_EQUAL(positions(0, 0), 0.0f);
+        BOOST_CHECK_EQUAL(positions(0, 1), 1.0f);
+        BOOST_CHECK_EQUAL(positions(0, 2), 2.0f);
+        BOOST_CHECK_EQUAL(positions(0, 3), -7.0f);
+
+        SingleMatrix index(1, 8, positionValues.data(), deviceId);
+        SingleMatrix targetSequences(2, 2, targetSequenceRanges.data(), deviceId);
+        SingleMatrix columns(deviceId);
+        columns.AssignColumnsOfSequencePositions(index, sequences, stride, targetSequences, stride);
+        vector<float> expected{ 3, 6, 5, 0, -1, 4, 3, 0 };
+        for (size_t j = 0; j < 7; j++)
+            BOOST_CHECK_EQUAL(columns(0, j), expected[j]);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixWeightedRandomSampling, RandomSeedFixture)
+{
+    // classes 1 and 4 have weight 0
+    vector<float> weightValues{ 1, 0, 2, 3, 0, 4 };
+    const size_t numSamples = 3;
+    const size_t numRuns = 2000;
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        SingleMatrix weights(6, 1, weightValues.data(), deviceId);
+        SingleMatrix samples(deviceId), workspace(deviceId), allSamples(numSamples, numRuns, deviceId);
+        vector<size_t> firstCounts(6, 0);
+        for (bool allowDuplicates : { true, false })
+        {
+            for (size_t r = 0; r < numRuns; r++)
+            {
+                samples.AssignWeightedRandomSamples(weights, numSamples, allowDuplicates, 1, r * 6, workspace);
+                BOOST_REQUIRE_EQUAL(samples.GetNumElements(), numSamples);
+                unique_ptr<float[]> values(samples.CopyToArray());
+                for (size_t j = 0; j < numSamples; j++)
+                {
+                    BOOST_CHECK(values[j] != 1 && values[j] != 4);
+                    for (size_t k = 0; k < j && !allowDuplicates; k++)
+                        BOOST_CHECK(values[j] != values[k]);
+                }
+                firstCounts[(size_t) values[0]]++;
+                if (!allowDuplicates)
+                    allSamples.SetColumn(samples, r);
+            }
+            // the first sample is a draw with replacement either way
+            for (size_t i = 0; i < 6; i++)
+                BOOST_CHECK_SMALL(firstCounts[i] / (double) numRuns - weightValues[i] / 10, 0.04);
+            fill(firstCounts.begin(), firstCounts.end(), 0);
+        }
+
+        SingleMatrix frequencies(deviceId);
+        frequencies.AssignWeightedSampleInclusionFrequencies(weights, numSamples, /*allowDuplicates=*/true, allSamples);
+        for (size_t i = 0; i < 6; i++)
+            BOOST_CHECK_CLOSE(frequencies(i, 0) + 1, weightValues[i] * numSamples / 10 + 1, 1e-4f);
+        frequencies.AssignWeightedSampleInclusionFrequencies(weights, numSamples, /*allowDuplicates=*/false, allSamples);
+        for (size_t i = 0; i < 6; i++)
+            BOOST_CHECK(weightValues[i] == 0 ? frequencies(i, 0) == 0 : frequencies(i, 0) > 0 && frequencies(i, 0) < 1);
+
+        // the class indices times the one-hot columns are the samples again
+        SingleMatrix oneHot(deviceId);
+        oneHot.AssignOneHotColumns(samples, 6);
+        BOOST_CHECK_EQUAL(oneHot.GetMatrixType(), MatrixType::SPARSE);
+        vector<float> classIndexValues{ 0, 1, 2, 3, 4, 5 };
+        SingleMatrix classIndices(1, 6, classIndexValues.data(), deviceId), product(deviceId);
+        SingleMatrix::Multiply(classIndices, false, oneHot, false, product);
+        for (size_t j = 0; j < numSamples; j++)
+            BOOST_CHECK_EQUAL(product(0, j), samples(j, 0));
+    }
+}
+
+// log likelihood of sample n of a Gaussian mixture, computed directly; a parameter has a single column or a column per sample
+static double GMMLogLikelihood(const vector<double>& unnormedPrior, size_t priorColumns, const vector<double>& means, size_t meanColumns,
+                               const vector<double>& logStddevs, size_t stddevColumns, const vector<double>& features, int numComponents, int featureDim, size_t n)
+{
+    const double pi = 3.14159265358979323846;
+    const double* prior = unnormedPrior.data() + (priorColumns == 1 ? 0 : n) * numComponents;
+    double priorSum = 0;
+    for (int c = 0; c < numComponents; c++)
+        priorSum += exp(prior[c]);
+
+    double likelihood = 0;
+    for (int c = 0; c < numComponents; c++)
+    {
+        double stddev = exp(logStddevs[c + (stddevColumns == 1 ? 0 : n) * numComponents]);
+        double density = 1;
+        for (int d = 0; d < featureDim; d++)
+        {
+            double deviation = features[d + n * featureDim] - means[c * featureDim + d + (meanColumns == 1 ? 0 : n) * numComponents * featureDim];
+            density *= exp(-deviation * deviation / (2 * stddev * stddev)) / (sqrt(2 * pi) * stddev);
+        }
+        likelihood += exp(prior[c]) / priorSum * density;
+    }
+    return log(likelihood);
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixGaussianMixture, RandomSeedFixture)
+{
+    // a prior and means shared by all samples, a log stddev per sample
+    const int numComponents = 3;
+    const int featureDim = 4;
+    const size_t numSamples = 5;
+    const size_t priorColumns = 1, meanColumns = 1, stddevColumns = numSamples;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    vector<double> unnormedPrior(numComponents * priorColumns), means(numComponents * featureDim * meanColumns), logStddevs(numComponents * stddevColumns), features(featureDim * numSamples), gradients(numSamples);
+    for (auto* values : { &unnormedPrior, &means, &logStddevs, &features, &gradients })
+        for (auto& value : *values)
+            value = distribution(rng);
+
+    // the expected gradients of sum_n gradients(n) * logLikelihood(n), by central differences
+    auto objective = [&]()
+    {
+        double sum = 0;
+        for (size_t n = 0; n < numSamples; n++)
+            sum += gradients[n] * GMMLogLikelihood(unnormedPrior, priorColumns, means, meanColumns, logStddevs, stddevColumns, features, numComponents, featureDim, n);
+        return sum;
+    };
+    auto numericGradient = [&](vector<double>& values)
+    {
+        const double epsilon = 1e-5;
+        vector<double> result(values.size());
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            double value = values[i];
+            values[i] = value + epsilon;
+            double plus = objective();
+            values[i] = value - epsilon;
+            double minus = objective();
+            values[i] = value;
+            result[i] = (plus - minus) / (2 * epsilon);
+        }
+        return result;
+    };
+    vector<vector<double>> expectedGradients{ numericGradient(unnormedPrior), numericGradient(means), numericGradient(logStddevs), numericGradient(features) };
+
+    for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+    {
+        DoubleMatrix prior(numComponents, priorColumns, unnormedPrior.data(), deviceId);
+        DoubleMatrix mean(numComponents * featureDim, meanColumns, means.data(), deviceId);
+        DoubleMatrix logStddev(numComponents, stddevColumns, logStddevs.data(), deviceId);
+        DoubleMatrix feature(featureDim, numSamples, features.data(), deviceId);
+        DoubleMatrix gradient(1, numSamples, gradients.data(), deviceId);
+
+        DoubleMatrix logLikelihoods(deviceId), posteriors(deviceId);
+        logLikelihoods.AssignGMMLogLikelihoods(prior, mean, logStddev, feature, posteriors);
+        for (size_t n = 0; n < numSamples; n++)
+        {
+            BOOST_CHECK_CLOSE(logLikelihoods(0, n), GMMLogLikelihood(unnormedPrior, priorColumns, means, meanColumns, logStddevs, stddevColumns, features, numComponents, featureDim, n), 1e-8);
+            double posteriorSum = 0;
+            for (int c = 0; c < numComponents; c++)
+                posteriorSum += posteriors(c, n);
+            BOOST_CHECK_CLOSE(posteriorSum, 1.0, 1e-8);
+        }
+
+        // the gradients are added to what is there already
+        DoubleMatrix priorGradient = DoubleMatrix::Ones(numComponents, priorColumns, deviceId);
+        DoubleMatrix meanGradient = DoubleMatrix::Ones(numComponents * featureDim, meanColumns, deviceId);
+        DoubleMatrix logStddevGradient = DoubleMatrix::Ones(numComponents, stddevColumns, deviceId);
+        DoubleMatrix featureGradient = DoubleMatrix::Ones(featureDim, numSamples, deviceId);
+        priorGradient.AddGMMUnnormedPriorGradient(gradient, prior, posteriors);
+        meanGradient.AddGMMMeanGradient(gradient, mean, logStddev, feature, posteriors);
+        logStddevGradient.AddGMMLogStddevGradient(gradient, mean, logStddev, feature, posteriors);
+        featureGradient.AddGMMFeatureGradient(gradient, mean, logStddev, feature, posteriors);
+
+        const DoubleMatrix* actualGradients[] = { &priorGradient, &meanGradient, &logStddevGradient, &featureGradient };
+        for (size_t i = 0; i < expectedGradients.size(); i++)
+        {
+            unique_ptr<double[]> actual(actualGradients[i]->CopyToArray());
+            BOOST_CHECK_EQUAL(actualGradients[i]->GetNumElements(), expectedGradients[i].size());
+            for (size_t j = 0; j < expectedGradients[i].size(); j++)
+                BOOST_CHECK_SMALL(actual[j] - 1 - expectedGradients[i][j], 1e-6);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixCosineWithNegativeSamples, RandomSeedFixture)
+{
+    const size_t dim = 4, numCols = 6, shift = 2, numNegatives = 3;
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    vector<double> left(dim * numCols), right(dim * numCols), gradients((numNegatives + 1) * numCols);
+    for (auto* values : { &left, &right, &gradients })
+        for (auto& value : *values)
+            value = distribution(rng);
+
+    auto cosine = [&](size_t j, size_t k)
+    {
+        double dot = 0, normLeft = 0, normRight = 0;
+        for (size_t i = 0; i < dim; i++)
+        {
+            dot += left[i + j * dim] * right[i + k * dim];
+            normLeft += left[i + j * dim] * left[i + j * dim];
+            normRight += right[i + k * dim] * right[i + k * dim];
+        }
+        return dot / sqrt(normLeft * normRight);
+    };
+
+    for (bool inBatchNegatives : { false, true })
+    {
+        // the documents of each query: shifted, or the most similar other ones
+        vector<vector<size_t>> documents(numCols);
+        for (size_t j = 0; j < numCols; j++)
+        {
+            documents[j].push_back(j);
+            vector<size_t> others;
+            for (size_t k = 0; k < numCols; k++)
+                if (k != j)
+                    others.push_back(k);
+            std::stable_sort(others.begin(), others.end(), [&](size_t a, size_t b) { return cosine(j, a) > cosine(j, b); });
+            for (size_t m = 1; m <= numNegatives; m++)
+                documents[j].push_back(inBatchNegatives ? others[m - 1] : (j + shift + m - 1) % numCols);
+        }
+
+        // the expected input gradients of sum gradients(m, j) * cos(left j, right documents(m, j)), by central differences
+        auto objective = [&]()
+        {
+            double sum = 0;
+            for (size_t j = 0; j < numCols; j++)
+                for (size_t m = 0; m <= numNegatives; m++)
+                    sum += gradients[m + j * (numNegatives + 1)] * cosine(j, documents[j][m]);
+            return sum;
+        };
+        auto numericGradient = [&](vector<double>& values)
+        {
+            const double epsilon = 1e-6;
+            vector<double> result(values.size());
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                double value = values[i];
+                values[i] = value + epsilon;
+                double plus = objective();
+                values[i] = value - epsilon;
+                double minus = objective();
+                values[i] = value;
+                result[i] = (plus - minus) / (2 * epsilon);
+            }
+            return result;
+        };
+        vector<vector<double>> expectedGradients{ numericGradient(left), numericGradient(right) };
+
+        for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+        {
+            DoubleMatrix inputs[] = { DoubleMatrix(dim, numCols, left.data(), deviceId), DoubleMatrix(dim, numCols, right.data(), deviceId) };
+            DoubleMatrix invNorms[] = { DoubleMatrix(deviceId), DoubleMatrix(deviceId) };
+            DoubleMatrix normalized[] = { DoubleMatrix(deviceId), DoubleMatrix(deviceId) };
+            for (int i = 0; i < 2; i++)
+            {
+                invNorms[i].AssignVectorNorm2Of(inputs[i], true);
+                invNorms[i].AssignElementInverseOf(invNorms[i]);
+                normalized[i].SetValue(inputs[i]);
+                normalized[i].RowElementMultiplyWith(invNorms[i]);
+            }
+            DoubleMatrix similarities(deviceId);
+            DoubleMatrix::Multiply(normalized[0], true, normalized[1], false, similarities);
+
+            DoubleMatrix values(deviceId), documentColumns(deviceId);
+            values.AssignSimilaritiesWithNegativeSamples(similarities, shift, numNegatives, inBatchNegatives, documentColumns);
+            BOOST_CHECK_EQUAL(values.GetNumRows(), numNegatives + 1);
+            for (size_t j = 0; j < numCols; j++)
+            {
+                for (size_t m = 0; m <= numNegatives; m++)
+                {
+                    BOOST_CHECK_EQUAL(documentColumns(m, j), (double)documents[j][m]);
+                    BOOST_CHECK_CLOSE(values(m, j), cosine(j, documents[j][m]), 1e-8);
+                }
+            }
+
+            DoubleMatrix gradient((numNegatives + 1), numCols, gradients.data(), deviceId);
+            DoubleMatrix gradientMatrix(deviceId), product(deviceId);
+            gradientMatrix.AssignNegativeSamplesGradientMatrix(gradient, documentColumns);
+            for (int i = 0; i < 2; i++)
+            {
+                if (i == 0)
+                    DoubleMatrix::Multiply(normalized[1], false, gradientMatrix, true, product);
+                else
+                    DoubleMatrix::Multiply(normalized[0], false, gradientMatrix, false, product);
+                DoubleMatrix inputGradient = DoubleMatrix::Ones(dim, numCols, deviceId);
+                inputGradient.AddColumnNormalizationGradient(product, normalized[i], invNorms[i]);
+                unique_ptr<double[]> actual(inputGradient.CopyToArray());
+                for (size_t k = 0; k < expectedGradients[i].size(); k++)
+                    BOOST_CHECK_SMALL(actual[k] - 1 - expectedGradients[i][k], 1e-6);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
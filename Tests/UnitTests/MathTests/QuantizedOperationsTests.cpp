@@ -5,6 +5,8 @@
 #include "stdafx.h"
 #include "../../../Source/Math/QuantizedOperations.h"
 #include "../../../Source/Math/Helpers.h"
+#include "../../../Source/Math/CPUVectorKernels.h"
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -50,6 +52,125 @@ BOOST_FIXTURE_TEST_CASE(MultiplyIntToShort, RandomSeedFixture)
         BOOST_CHECK_EQUAL(round(C_upd[i]), C_expected_upd[i]);
 }
 
+BOOST_FIXTURE_TEST_CASE(MultiplyFloatToInt8, RandomSeedFixture)
+{
+    // The same product as above, quantized to int8, which leaves an error of about one percent
+    int m = 5, n = 4, k = 3;
+    std::vector<float> A = {1,2,3,4,5,6,7,8,9,10,11,12,13,14,15};
+    std::vector<float> B = {16,17,18,19,20,21,22,23,24,25,26,27};
+    std::vector<float> C_expected = { 316, 367, 418, 469, 520, 370, 430, 490, 550, 610, 424, 493, 562, 631, 700, 478, 556, 634, 712, 790 };
+    std::vector<float> C;
+    C.resize(m*n);
+
+    shared_ptr<QuantizerBase<float, int8_t>> quantA(new SymmetricQuantizer<float, int8_t>(0));
+    shared_ptr<QuantizerBase<float, int8_t>> quantB(new SymmetricQuantizer<float, int8_t>(0));
+
+    QuantizedMultiplier<float, int8_t> mult(quantA, true, quantB, false);
+    mult.Multiply(m, n, k, A.data(), B.data(), C.data());
+
+    for (size_t i = 0; i < m*n; i++)
+        BOOST_CHECK_CLOSE(C[i], C_expected[i], 2.0f);
+}
+
+BOOST_FIXTURE_TEST_CASE(MultiplyInt8Channelwise, RandomSeedFixture)
+{
+    // C[m,n] = W[m,k] * X[k,n] with W given as is and transposed
+    int m = 7, n = 13, k = 150;
+    std::mt19937 rng(7);
+    std::normal_distribution<float> dist;
+    std::vector<float> W(m * k), X(k * n), WT(k * m);
+    for (auto& w : W)
+        w = dist(rng);
+    for (auto& x : X)
+        x = dist(rng);
+    // the channels have very different ranges, which per-channel scales must handle
+    for (int i = 0; i < m; i++)
+        for (int d = 0; d < k; d++)
+            W[i + m * d] *= (float)(1 << i);
+    for (int i = 0; i < m; i++)
+        for (int d = 0; d < k; d++)
+            WT[i * k + d] = W[i + m * d];
+
+    std::vector<float> C_expected(m * n), rowMax(m, 0);
+    for (int i = 0; i < m; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            double sum = 0;
+            for (int d = 0; d < k; d++)
+                sum += W[i + m * d] * X[d + k * j];
+            C_expected[i + m * j] = (float)sum;
+            rowMax[i] = std::max(rowMax[i], std::abs((float)sum));
+        }
+    }
+
+    float inputRange = *std::max_element(X.begin(), X.end(), [](float a, float b) { return std::abs(a) < std::abs(b); });
+    for (bool transposed : { false, true })
+    {
+        Int8ChannelwiseMultiplier<float> mult(std::abs(inputRange), transposed);
+        std::vector<float> C(m * n);
+        for (int pass = 0; pass < 2; pass++)
+        {
+            mult.Multiply(m, n, k, transposed ? WT.data() : W.data(), X.data(), C.data());
+            for (int i = 0; i < m; i++)
+                for (int j = 0; j < n; j++)
+                    BOOST_CHECK_SMALL(C[i + m * j] - C_expected[i + m * j], 0.04f * rowMax[i]);
+        }
+    }
+}
+
+template <class ScalarT>
+static void TestQuantizedBlockMultiplier(int m, int k, int n, int range)
+{
+    std::mt19937 rng(m * 1000 + k * 10 + n);
+    std::uniform_int_distribution<int> dist(-range, range);
+    std::vector<ScalarT> A(m * k), B(k * n);
+    for (auto& a : A)
+        a = (ScalarT) dist(rng);
+    for (auto& b : B)
+        b = (ScalarT) dist(rng);
+
+    std::vector<int32_t> C_expected(m * n);
+    for (int r = 0; r < m; r++)
+    {
+        for (int c = 0; c < n; c++)
+        {
+            int32_t sum = 0;
+            for (int i = 0; i < k; i++)
+                sum += (int32_t) A[r * k + i] * (int32_t) B[i * n + c];
+            C_expected[r * n + c] = sum;
+        }
+    }
+
+    QuantizedBlockMultiplier<ScalarT> mult;
+    mult.PrepareB(B.data(), k, n);
+    // twice, to check that the prepared B is kept and C is overwritten
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<int32_t> C(m * n, -1);
+        mult.Multiply(A.data(), m, C.data());
+        BOOST_CHECK_MESSAGE(C == C_expected, "QuantizedBlockMultiplier [" << mult.GetHandlerName() << "] differs for " << sizeof(ScalarT) * 8 << " bit, m=" << m << " k=" << k << " n=" << n);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedBlockMultiplierAllInstructionSets)
+{
+    // all block sizes (128, 64, 32, 16, 8 and the remainder), with rows in groups of four and single rows
+    const int dims[][3] = { { 1, 1, 1 }, { 4, 8, 3 }, { 7, 128, 8 }, { 1, 249, 1 }, { 4, 249, 5 }, { 13, 300, 17 }, { 64, 1000, 33 }, { 2, 384, 9 } };
+
+    let maxInstructionSet = GetCPUVectorInstructionSet();
+    for (int instructionSet = (int) CPUVectorInstructionSet::None; instructionSet <= (int) maxInstructionSet; instructionSet++)
+    {
+        SetMaxCPUVectorInstructionSet((CPUVectorInstructionSet) instructionSet);
+        for (const auto& d : dims)
+        {
+            // small enough for the int16 dot products not to saturate
+            TestQuantizedBlockMultiplier<short>(d[0], d[1], d[2], 1000);
+            TestQuantizedBlockMultiplier<int8_t>(d[0], d[1], d[2], 127);
+        }
+    }
+    SetMaxCPUVectorInstructionSet(maxInstructionSet);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
 
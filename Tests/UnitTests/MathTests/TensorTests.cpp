@@ -85,6 +85,17 @@ BOOST_AUTO_TEST_CASE(BiasGradient2)
     });
 }
 
+BOOST_AUTO_TEST_CASE(FusedElementwiseOps)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // fused element-wise chain with broadcasting
+    tensorTester.OneTensorTest("fused element-wise ops (broadcasting)", 1e-6, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.FusedOpTest(TensorShape{ 512, 256 }, TensorShape{ 512, 1 }, deviceId);
+    });
+}
+
 BOOST_AUTO_TEST_CASE(ColumnSliceMultAndAdd)
 {
     ColumnSliceMultAndAddTest<float>(2048, 2048, 256, 0);
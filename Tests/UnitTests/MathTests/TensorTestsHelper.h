@@ -87,6 +87,28 @@ struct TensorTest
         result.AssignSumOf(input, bias);
         return result;
     }
+
+    // test a fused element-wise chain, Sigmoid(input + bias) .* input, against the same ops one at a time
+    TensorView<ElemType> FusedOpTest(TensorShape layerShape, TensorShape biasShape, DEVICEID_TYPE deviceId)
+    {
+        int randomSeed = 1;
+        let  input = CreateTensor(layerShape, randomSeed++, deviceId);
+        auto bias = CreateTensor(biasShape, randomSeed++, deviceId);
+        FusedElementwiseOp program;
+        program.numSteps = 3;
+        program.steps[0] = { ElementWiseOperator::opSum, 2, { 0, 1 } };
+        program.steps[1] = { ElementWiseOperator::opSigmoid, 1, { FusedElementwiseOp::MaxInputs + 0 } };
+        program.steps[2] = { ElementWiseOperator::opElementwiseProduct, 2, { FusedElementwiseOp::MaxInputs + 1, 0 } };
+        auto result = CreateTensor(layerShape, randomSeed++, deviceId, true);
+        result.AssignFusedOpOf(input, bias, input, program);
+
+        auto expected = CreateTensor(layerShape, randomSeed++, deviceId);
+        expected.AssignSumOf(input, bias);
+        expected.AssignSigmoidOf(expected);
+        expected.AssignElementwiseProductOf(expected, input);
+        BOOST_CHECK(result.GetSOB().IsEqualTo(expected.GetSOB(), (ElemType)1e-6));
+        return result;
+    }
 };
 
 template <class ElemType>
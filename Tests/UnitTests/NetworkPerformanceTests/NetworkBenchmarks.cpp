@@ -0,0 +1,678 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// NetworkBenchmarks.cpp -- end-to-end training throughput of canonical networks with regression baselines
+//
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms
+
+#include "Basics.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/ComputationEnvironment.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "../../../Source/ComputationNetworkLib/RNNNodes.h"
+#include "../Common/BenchmarkHelper.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A network of one replica, with the synthetic minibatch of a step.
+template <class ElemType>
+struct BenchmarkNetwork
+{
+    ComputationNetworkPtr m_net;
+    ComputationNodeBasePtr m_criterion;
+    vector<ComputationNodeBasePtr> m_inputs;
+    size_t m_numSamples; // per step
+    // Loads the minibatch from host memory into the input nodes and sets up their layout, as a reader would.
+    function<void()> m_loadMinibatch;
+};
+
+typedef shared_ptr<ComputationNode<float>> FloatNodePtr;
+
+// Creates the parameters with a deterministic initialization, so that all replicas start from the same model.
+template <class ElemType>
+class ParameterFactory
+{
+public:
+    typedef shared_ptr<ComputationNode<ElemType>> NodePtr;
+
+    ParameterFactory(ComputationNetworkBuilder<ElemType>& builder) : m_builder(builder), m_seed(1)
+    {
+    }
+
+    // uniform in +-sqrt(3 / fanIn), i.e. of unit variance for inputs of unit variance
+    NodePtr Random(const TensorShape& shape, size_t fanIn)
+    {
+        auto parameter = m_builder.CreateLearnableParameter(L"", shape);
+        ElemType range = (ElemType) sqrt(3.0 / fanIn);
+        parameter->Value().SetUniformRandomValue(-range, range, m_seed++);
+        return parameter;
+    }
+
+    NodePtr Random(size_t rows, size_t cols)
+    {
+        return Random(TensorShape(rows, cols), cols);
+    }
+
+    NodePtr Constant(const TensorShape& shape, ElemType value, bool isLearnable = true)
+    {
+        auto parameter = m_builder.CreateLearnableParameter(L"", shape);
+        parameter->Value().SetValue(value);
+        if (!isLearnable)
+            parameter->SetLearningRateMultiplier(0);
+        return parameter;
+    }
+
+private:
+    ComputationNetworkBuilder<ElemType>& m_builder;
+    unsigned long m_seed;
+};
+
+// -----------------------------------------------------------------------
+// synthetic minibatches
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static function<void()> DenseInput(const ComputationNodeBasePtr& input, size_t rows, size_t cols, mt19937& rng)
+{
+    auto data = make_shared<vector<ElemType>>(rows * cols);
+    uniform_real_distribution<double> distribution(-1, 1);
+    for (auto& value : *data)
+        value = (ElemType) distribution(rng);
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(input);
+    return [=]() { node->Value().SetValue(rows, cols, node->GetDeviceId(), data->data()); };
+}
+
+// The given number of distinct ones per column among the rows (one-hot for nonZerosPerColumn = 1).
+template <class ElemType>
+static function<void()> SparseInput(const ComputationNodeBasePtr& input, size_t rows, size_t cols, size_t nonZerosPerColumn, mt19937& rng)
+{
+    auto columnStarts = make_shared<vector<CPUSPARSE_INDEX_TYPE>>(cols + 1);
+    auto rowIndices = make_shared<vector<CPUSPARSE_INDEX_TYPE>>(cols * nonZerosPerColumn);
+    auto values = make_shared<vector<ElemType>>(cols * nonZerosPerColumn, (ElemType) 1);
+    uniform_int_distribution<size_t> distribution(0, rows / nonZerosPerColumn - 1);
+    for (size_t j = 0; j <= cols; j++)
+        (*columnStarts)[j] = (CPUSPARSE_INDEX_TYPE) (j * nonZerosPerColumn);
+    for (size_t i = 0; i < rowIndices->size(); i++) // one in each of nonZerosPerColumn bands, so distinct and sorted
+        (*rowIndices)[i] = (CPUSPARSE_INDEX_TYPE) ((i % nonZerosPerColumn) * (rows / nonZerosPerColumn) + distribution(rng));
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(input);
+    return [=]()
+    {
+        node->Value().SetMatrixFromCSCFormat(columnStarts->data(), rowIndices->data(), values->data(), values->size(), rows, cols);
+    };
+}
+
+// Loads all inputs of a minibatch of 'numSequences' sequences of 'numSteps' steps (0 for a minibatch of frames).
+template <class ElemType>
+static function<void()> MinibatchLoader(const BenchmarkNetwork<ElemType>& network, vector<function<void()>> loaders, size_t numSequences, size_t numSteps)
+{
+    auto layout = network.m_inputs.front()->GetMBLayout();
+    return [=]()
+    {
+        if (numSteps == 0)
+            layout->InitAsFrameMode(numSequences);
+        else
+        {
+            layout->Init(numSequences, numSteps);
+            for (size_t s = 0; s < numSequences; s++)
+                layout->AddSequence(s, s, 0, numSteps);
+        }
+        for (const auto& loader : loaders)
+            loader();
+    };
+}
+
+template <class ElemType>
+static void Compile(BenchmarkNetwork<ElemType>& network, const ComputationNodeBasePtr& criterion, const vector<ComputationNodeBasePtr>& features,
+                    const vector<ComputationNodeBasePtr>& labels)
+{
+    for (const auto& node : features)
+        network.m_net->AddToNodeGroup(L"feature", node);
+    for (const auto& node : labels)
+        network.m_net->AddToNodeGroup(L"label", node);
+    network.m_net->AddToNodeGroup(L"criterion", criterion);
+    network.m_net->CompileNetwork();
+    network.m_net->AllocateAllMatrices({}, {}, criterion);
+    network.m_criterion = criterion;
+    network.m_inputs = features;
+    network.m_inputs.insert(network.m_inputs.end(), labels.begin(), labels.end());
+}
+
+// -----------------------------------------------------------------------
+// models
+// -----------------------------------------------------------------------
+
+// convolution with 'same' padding, followed by batch normalization and optionally ReLU
+template <class ElemType>
+static shared_ptr<ComputationNode<ElemType>> ConvBN(ComputationNetworkBuilder<ElemType>& builder, ParameterFactory<ElemType>& parameters, DEVICEID_TYPE deviceId,
+                                                    const shared_ptr<ComputationNode<ElemType>>& input, size_t inChannels, size_t outChannels,
+                                                    size_t kernel, size_t stride, bool relu)
+{
+    auto w = parameters.Random(TensorShape(outChannels, kernel * kernel * inChannels), kernel * kernel * inChannels);
+    auto conv = builder.Convolution(w, input, TensorShape(kernel, kernel, inChannels), TensorShape(outChannels), TensorShape(stride, stride, inChannels),
+                                    { true }, { true, true, false }, TensorShape(0), TensorShape(0), false, ImageLayoutKind::CHW, 0);
+    auto bn = builder.BatchNormalization(conv, parameters.Constant(TensorShape(outChannels, 1), 1), parameters.Constant(TensorShape(outChannels, 1), 0),
+                                         parameters.Constant(TensorShape(outChannels, 1), 0, false), parameters.Constant(TensorShape(outChannels, 1), 1, false),
+                                         /*spatial=*/true, /*normalizationTimeConstant=*/5000, 0, 1e-5, /*useCntkEngine=*/deviceId == CPUDEVICE);
+    return relu ? builder.RectifiedLinear(bn) : bn;
+}
+
+template <class ElemType>
+static void BuildResNet50(BenchmarkNetwork<ElemType>& network, DEVICEID_TYPE deviceId, size_t minibatchSize, mt19937& rng)
+{
+    const size_t imageSize = 224, numClasses = 1000;
+    ComputationNetworkBuilder<ElemType> builder(*network.m_net);
+    ParameterFactory<ElemType> parameters(builder);
+    auto features = builder.CreateInputNode(L"features", TensorShape(imageSize, imageSize, 3));
+    auto labels = builder.CreateSparseInputNode(L"labels", numClasses);
+
+    auto h = ConvBN(builder, parameters, deviceId, features, 3, 64, 7, 2, true);
+    h = builder.Pooling(h, PoolKind::Max, TensorShape(3, 3, 1), TensorShape(2, 2, 1), { true, true, false }, TensorShape(0), TensorShape(0), ImageLayoutKind::CHW);
+
+    // bottleneck blocks, the first of each stage with a projection shortcut (and a stride of 2 after the first stage)
+    size_t channels = 64;
+    const size_t blocksPerStage[] = { 3, 4, 6, 3 };
+    for (size_t stage = 0; stage < 4; stage++)
+    {
+        size_t width = 64 << stage;
+        for (size_t block = 0; block < blocksPerStage[stage]; block++)
+        {
+            size_t stride = block == 0 && stage > 0 ? 2 : 1;
+            auto branch = ConvBN(builder, parameters, deviceId, h, channels, width, 1, stride, true);
+            branch = ConvBN(builder, parameters, deviceId, branch, width, width, 3, 1, true);
+            branch = ConvBN(builder, parameters, deviceId, branch, width, 4 * width, 1, 1, false);
+            auto shortcut = block == 0 ? ConvBN(builder, parameters, deviceId, h, channels, 4 * width, 1, stride, false) : h;
+            h = builder.RectifiedLinear(builder.Plus(branch, shortcut));
+            channels = 4 * width;
+        }
+    }
+
+    h = builder.Pooling(h, PoolKind::Average, TensorShape(7, 7, 1), TensorShape(1, 1, 1), { false }, TensorShape(0), TensorShape(0), ImageLayoutKind::CHW);
+    auto z = builder.Plus(builder.Times(parameters.Random(TensorShape(numClasses, 1, 1, channels), channels), h), parameters.Constant(TensorShape(numClasses), 0));
+    Compile(network, builder.CrossEntropyWithSoftmax(labels, z), { features }, { labels });
+
+    network.m_numSamples = minibatchSize;
+    network.m_loadMinibatch = MinibatchLoader(network, { DenseInput<ElemType>(features, imageSize * imageSize * 3, minibatchSize, rng),
+                                                         SparseInput<ElemType>(labels, numClasses, minibatchSize, 1, rng) },
+                                              minibatchSize, 0);
+}
+
+template <class ElemType>
+static void BuildLstm(BenchmarkNetwork<ElemType>& network, DEVICEID_TYPE deviceId, size_t numSequences, mt19937& rng)
+{
+    const size_t featureDim = 80, hiddenSize = 1024, numLayers = 3, numClasses = 9000, numSteps = 100;
+    if (deviceId == CPUDEVICE)
+        InvalidArgument("OptimizedRNNStack is only implemented on the GPU.");
+
+    ComputationNetworkBuilder<ElemType> builder(*network.m_net);
+    ParameterFactory<ElemType> parameters(builder);
+    auto features = builder.CreateInputNode(L"features", featureDim);
+    auto labels = builder.CreateSparseInputNode(L"labels", numClasses);
+
+    RnnAttributes attributes(false, numLayers, hiddenSize, L"lstm", -1);
+    auto numParameters = attributes.GetNumParameters(featureDim);
+    auto w = parameters.Random(TensorShape(numParameters.first, numParameters.second), hiddenSize);
+    auto rnn = network.m_net->AddNodeToNetAndAttachInputs(New<OptimizedRNNStackNode<ElemType>>(deviceId, L"rnn", false, numLayers, hiddenSize, L"lstm"), { w, features });
+    auto z = builder.Plus(builder.Times(parameters.Random(numClasses, hiddenSize), rnn), parameters.Constant(TensorShape(numClasses), 0));
+    Compile(network, builder.CrossEntropyWithSoftmax(labels, z), { features }, { labels });
+
+    size_t numFrames = numSequences * numSteps;
+    network.m_numSamples = numFrames;
+    network.m_loadMinibatch = MinibatchLoader(network, { DenseInput<ElemType>(features, featureDim, numFrames, rng),
+                                                         SparseInput<ElemType>(labels, numClasses, numFrames, 1, rng) },
+                                              numSequences, numSteps);
+}
+
+template <class ElemType>
+static void BuildDssm(BenchmarkNetwork<ElemType>& network, DEVICEID_TYPE, size_t minibatchSize, mt19937& rng)
+{
+    const size_t vocabularySize = 50000, trigramsPerSample = 30, hiddenSize = 300, outputSize = 128, numNegatives = 4;
+    ComputationNetworkBuilder<ElemType> builder(*network.m_net);
+    ParameterFactory<ElemType> parameters(builder);
+    auto query = builder.CreateSparseInputNode(L"query", vocabularySize);
+    auto document = builder.CreateSparseInputNode(L"document", vocabularySize);
+    auto labels = builder.CreateInputNode(L"labels", numNegatives + 1);
+
+    auto tower = [&](const shared_ptr<ComputationNode<ElemType>>& input)
+    {
+        auto h = builder.Tanh(builder.Times(parameters.Random(TensorShape(hiddenSize, vocabularySize), trigramsPerSample), input));
+        return builder.Tanh(builder.Times(parameters.Random(outputSize, hiddenSize), h));
+    };
+    auto cosines = builder.CosDistanceWithNegativeSamples(tower(query), tower(document), parameters.Constant(TensorShape(1), 1, false),
+                                                          parameters.Constant(TensorShape(1), (ElemType) numNegatives, false), false);
+    auto criterion = builder.CrossEntropyWithSoftmax(labels, builder.ElementTimes(parameters.Constant(TensorShape(1), 10), cosines));
+    Compile(network, criterion, { query, document }, { labels });
+
+    // the positive document is the first of each column
+    vector<ElemType> labelValues((numNegatives + 1) * minibatchSize, 0);
+    for (size_t j = 0; j < minibatchSize; j++)
+        labelValues[j * (numNegatives + 1)] = 1;
+    auto labelData = make_shared<vector<ElemType>>(move(labelValues));
+    auto labelNode = labels;
+    network.m_numSamples = minibatchSize;
+    network.m_loadMinibatch = MinibatchLoader(network, { SparseInput<ElemType>(query, vocabularySize, minibatchSize, trigramsPerSample, rng),
+                                                         SparseInput<ElemType>(document, vocabularySize, minibatchSize, trigramsPerSample, rng),
+                                                         [=]() { labelNode->Value().SetValue(numNegatives + 1, minibatchSize, labelNode->GetDeviceId(), labelData->data()); } },
+                                              minibatchSize, 0);
+}
+
+// LSTM layer from primitive nodes, the recurrence through PastValue loops
+template <class ElemType>
+static shared_ptr<ComputationNode<ElemType>> LstmLayer(ComputationNetworkBuilder<ElemType>& builder, ParameterFactory<ElemType>& parameters,
+                                                       const shared_ptr<ComputationNode<ElemType>>& input, size_t inputDim, size_t hiddenSize)
+{
+    auto hPrev = builder.PastValue(nullptr, 0, hiddenSize, 1);
+    auto cPrev = builder.PastValue(nullptr, 0, hiddenSize, 1);
+    auto z = builder.Plus(builder.Plus(builder.Times(parameters.Random(4 * hiddenSize, inputDim), input),
+                                       builder.Times(parameters.Random(4 * hiddenSize, hiddenSize), hPrev)),
+                          parameters.Constant(TensorShape(4 * hiddenSize), 0));
+    auto inputGate = builder.Sigmoid(builder.RowSlice(z, 0, hiddenSize));
+    auto forgetGate = builder.Sigmoid(builder.RowSlice(z, hiddenSize, hiddenSize));
+    auto outputGate = builder.Sigmoid(builder.RowSlice(z, 2 * hiddenSize, hiddenSize));
+    auto cellInput = builder.Tanh(builder.RowSlice(z, 3 * hiddenSize, hiddenSize));
+    auto c = builder.Plus(builder.ElementTimes(forgetGate, cPrev), builder.ElementTimes(inputGate, cellInput));
+    auto h = builder.ElementTimes(outputGate, builder.Tanh(c));
+    hPrev->AttachInputs({ h });
+    cPrev->AttachInputs({ c });
+    return h;
+}
+
+// Encoder-decoder with the source followed by the target in one sequence (as in the G2P sample), so that the decoder
+// continues from the state of the encoder, and the labels are the next words.
+template <class ElemType>
+static void BuildSeq2Seq(BenchmarkNetwork<ElemType>& network, DEVICEID_TYPE, size_t numSequences, mt19937& rng)
+{
+    const size_t vocabularySize = 30000, embeddingSize = 512, hiddenSize = 512, numLayers = 2, numSteps = 50;
+    ComputationNetworkBuilder<ElemType> builder(*network.m_net);
+    ParameterFactory<ElemType> parameters(builder);
+    auto words = builder.CreateSparseInputNode(L"words", vocabularySize);
+    auto labels = builder.CreateSparseInputNode(L"labels", vocabularySize);
+
+    auto h = builder.Times(parameters.Random(TensorShape(embeddingSize, vocabularySize), 1), words);
+    size_t dim = embeddingSize;
+    for (size_t layer = 0; layer < numLayers; layer++, dim = hiddenSize)
+        h = LstmLayer(builder, parameters, h, dim, hiddenSize);
+    auto z = builder.Plus(builder.Times(parameters.Random(vocabularySize, hiddenSize), h), parameters.Constant(TensorShape(vocabularySize), 0));
+    Compile(network, builder.CrossEntropyWithSoftmax(labels, z), { words }, { labels });
+
+    size_t numWords = numSequences * numSteps;
+    network.m_numSamples = numWords;
+    network.m_loadMinibatch = MinibatchLoader(network, { SparseInput<ElemType>(words, vocabularySize, numWords, 1, rng),
+                                                         SparseInput<ElemType>(labels, vocabularySize, numWords, 1, rng) },
+                                              numSequences, numSteps);
+}
+
+template <class ElemType>
+struct BenchmarkModel
+{
+    const char* m_name;
+    size_t m_defaultMinibatchSize;
+    function<void(BenchmarkNetwork<ElemType>&, DEVICEID_TYPE, size_t, mt19937&)> m_build;
+};
+
+template <class ElemType>
+static vector<BenchmarkModel<ElemType>> GetBenchmarkModels()
+{
+    return {
+        { "resnet50", 32, BuildResNet50<ElemType> },
+        { "lstm", 32, BuildLstm<ElemType> },
+        { "dssm", 1024, BuildDssm<ElemType> },
+        { "seq2seq", 32, BuildSeq2Seq<ElemType> },
+    };
+}
+
+// -----------------------------------------------------------------------
+// training steps
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+struct Replica
+{
+    DEVICEID_TYPE m_deviceId;
+    BenchmarkNetwork<ElemType> m_network;
+    vector<shared_ptr<ComputationNode<ElemType>>> m_parameters; // the ones that are updated
+    vector<shared_ptr<Matrix<ElemType>>> m_aggregatedGradients; // with more than one replica, dense sums over the replicas
+    shared_ptr<Matrix<ElemType>> m_sync;                         // read to wait for the device
+
+    void Synchronize() const
+    {
+        m_sync->Get00Element();
+    }
+};
+
+struct StepTimes
+{
+    double m_input, m_forward, m_backward, m_aggregation, m_update;
+};
+
+template <class ElemType>
+class Trainer
+{
+public:
+    Trainer(const BenchmarkModel<ElemType>& model, const vector<DEVICEID_TYPE>& deviceIds, size_t minibatchSize)
+    {
+        for (DEVICEID_TYPE deviceId : deviceIds)
+        {
+            Replica<ElemType> replica;
+            replica.m_deviceId = deviceId;
+            replica.m_network.m_net = make_shared<ComputationNetwork>(deviceId);
+            mt19937 rng(1); // the same model and minibatch on all replicas
+            model.m_build(replica.m_network, deviceId, minibatchSize, rng);
+            for (const auto& node : replica.m_network.m_net->LearnableParameterNodes(replica.m_network.m_criterion))
+            {
+                if (!node->IsParameterUpdateRequired())
+                    continue;
+                auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+                replica.m_parameters.push_back(parameter);
+                if (deviceIds.size() > 1)
+                    replica.m_aggregatedGradients.push_back(make_shared<Matrix<ElemType>>(parameter->Value().GetNumRows(), parameter->Value().GetNumCols(), deviceId));
+            }
+            replica.m_sync = make_shared<Matrix<ElemType>>(1, 1, deviceId);
+            m_replicas.push_back(move(replica));
+        }
+
+        // the sums of the replicas are collected on the first device
+        if (m_replicas.size() > 1)
+        {
+            for (const auto& gradient : m_replicas.front().m_aggregatedGradients)
+                m_staging.push_back(make_shared<Matrix<ElemType>>(gradient->GetNumRows(), gradient->GetNumCols(), deviceIds.front()));
+        }
+    }
+
+    size_t GetNumSamples() const
+    {
+        return m_replicas.front().m_network.m_numSamples * m_replicas.size();
+    }
+
+    // Milliseconds of a step; with 'times' each phase is followed by a synchronization and timed.
+    double Step(StepTimes* times)
+    {
+        auto stepStart = chrono::steady_clock::now();
+        auto phaseStart = stepStart;
+        auto endPhase = [&](double* milliseconds)
+        {
+            if (!times)
+                return;
+            for (const auto& replica : m_replicas)
+                replica.Synchronize();
+            auto now = chrono::steady_clock::now();
+            *milliseconds = chrono::duration<double, milli>(now - phaseStart).count();
+            phaseStart = now;
+        };
+
+        for (auto& replica : m_replicas)
+        {
+            replica.m_network.m_loadMinibatch();
+            ComputationNetwork::BumpEvalTimeStamp(replica.m_network.m_inputs);
+        }
+        endPhase(times ? &times->m_input : nullptr);
+
+        for (auto& replica : m_replicas)
+        {
+            ScopedNetworkOperationMode modeGuard(replica.m_network.m_net, NetworkOperationMode::training);
+            replica.m_network.m_net->ForwardProp(replica.m_network.m_criterion);
+        }
+        endPhase(times ? &times->m_forward : nullptr);
+
+        for (auto& replica : m_replicas)
+        {
+            ScopedNetworkOperationMode modeGuard(replica.m_network.m_net, NetworkOperationMode::training);
+            replica.m_network.m_net->Backprop(replica.m_network.m_criterion);
+        }
+        endPhase(times ? &times->m_backward : nullptr);
+
+        Aggregate();
+        endPhase(times ? &times->m_aggregation : nullptr);
+
+        // plain SGD, each replica applies the summed gradients to its copy of the model
+        const ElemType learningRate = (ElemType) 1e-5;
+        for (auto& replica : m_replicas)
+        {
+            for (size_t i = 0; i < replica.m_parameters.size(); i++)
+            {
+                const auto& gradient = m_replicas.size() > 1 ? *replica.m_aggregatedGradients[i] : replica.m_parameters[i]->Gradient();
+                Matrix<ElemType>::ScaleAndAdd(-learningRate, gradient, replica.m_parameters[i]->Value());
+            }
+        }
+        endPhase(times ? &times->m_update : nullptr);
+
+        for (const auto& replica : m_replicas)
+            replica.Synchronize();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - stepStart).count();
+    }
+
+    // the largest of the replicas
+    size_t GetPeakMemoryBytes() const
+    {
+        size_t peakBytes = 0;
+        for (const auto& replica : m_replicas)
+        {
+            size_t numBytes = replica.m_network.m_net->GetMatrixPoolAllocatedBytes();
+            for (const auto& node : replica.m_network.m_net->LearnableParameterNodes(replica.m_network.m_criterion))
+                numBytes += dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().BufferSize();
+            for (const auto& gradient : replica.m_aggregatedGradients)
+                numBytes += gradient->BufferSize();
+            if (&replica == &m_replicas.front())
+                for (const auto& staging : m_staging)
+                    numBytes += staging->BufferSize();
+            peakBytes = max(peakBytes, numBytes);
+        }
+        return peakBytes;
+    }
+
+private:
+    // Sums the gradients of all replicas on the first device and copies the sums back to the others. The gradients of
+    // sparse inputs may be sparse, they are added to a dense sum on their own device first.
+    void Aggregate()
+    {
+        if (m_replicas.size() == 1)
+            return;
+
+        for (size_t i = 0; i < m_staging.size(); i++)
+        {
+            for (auto& replica : m_replicas)
+            {
+                const auto& gradient = replica.m_parameters[i]->Gradient();
+                auto& sum = *replica.m_aggregatedGradients[i];
+                if (gradient.GetMatrixType() == DENSE)
+                    sum.AssignValuesOf(gradient);
+                else
+                {
+                    sum.SetValue(0);
+                    Matrix<ElemType>::ScaleAndAdd(1, gradient, sum);
+                }
+            }
+
+            auto& total = *m_replicas.front().m_aggregatedGradients[i];
+            for (size_t r = 1; r < m_replicas.size(); r++)
+            {
+                m_staging[i]->AssignPeerCopyOf(*m_replicas[r].m_aggregatedGradients[i]);
+                total += *m_staging[i];
+            }
+            for (size_t r = 1; r < m_replicas.size(); r++)
+                m_replicas[r].m_aggregatedGradients[i]->AssignPeerCopyOf(total);
+        }
+    }
+
+    vector<Replica<ElemType>> m_replicas;
+    vector<shared_ptr<Matrix<ElemType>>> m_staging;
+};
+
+static double Median(vector<double> values)
+{
+    nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+// -----------------------------------------------------------------------
+// driver
+// -----------------------------------------------------------------------
+
+static const char* s_csvHeader = "model,devices,precision,minibatch,samplesPerSecond,stepMs,inputMs,forwardMs,backwardMs,aggregationMs,updateMs,peakMemoryMB";
+
+template <class ElemType>
+static void RunBenchmarks(const vector<DEVICEID_TYPE>& deviceIds, const vector<string>& modelNames, size_t minibatchSize, size_t numSteps,
+                          BenchmarkReport& report)
+{
+    const char* precision = sizeof(ElemType) == sizeof(float) ? "float" : "double";
+    string devices;
+    for (DEVICEID_TYPE deviceId : deviceIds)
+        devices += (devices.empty() ? "" : "+") + (deviceId == CPUDEVICE ? string("cpu") : "gpu" + to_string(deviceId));
+
+    for (const auto& model : GetBenchmarkModels<ElemType>())
+    {
+        if (!modelNames.empty() && find(modelNames.begin(), modelNames.end(), model.m_name) == modelNames.end())
+            continue;
+
+        size_t modelMinibatchSize = minibatchSize > 0 ? minibatchSize : model.m_defaultMinibatchSize;
+        double samplesPerSecond, peakMemoryMB;
+        vector<double> steps;
+        vector<StepTimes> phases(numSteps);
+        try
+        {
+            Trainer<ElemType> trainer(model, deviceIds, modelMinibatchSize);
+
+            // warm up (this also runs the algorithm selection of cuDNN and grows the matrix pool)
+            for (size_t i = 0; i < 2; i++)
+                trainer.Step(nullptr);
+
+            for (size_t i = 0; i < numSteps; i++)
+                steps.push_back(trainer.Step(nullptr));
+            double totalMilliseconds = 0;
+            for (double milliseconds : steps)
+                totalMilliseconds += milliseconds;
+            samplesPerSecond = trainer.GetNumSamples() * numSteps / totalMilliseconds * 1000;
+
+            for (auto& times : phases)
+                trainer.Step(&times);
+            peakMemoryMB = trainer.GetPeakMemoryBytes() / (1024.0 * 1024.0);
+        }
+        catch (const exception& e)
+        {
+            report.Skip(model.m_name, devices, e);
+            continue;
+        }
+
+        auto medianPhase = [&](double StepTimes::*phase)
+        {
+            vector<double> values;
+            for (const auto& times : phases)
+                values.push_back(times.*phase);
+            return Median(values);
+        };
+
+        char line[1024];
+        sprintf(line, "%s,%s,%s,%d,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f", model.m_name, devices.c_str(), precision, (int) modelMinibatchSize,
+                samplesPerSecond, Median(steps), medianPhase(&StepTimes::m_input), medianPhase(&StepTimes::m_forward), medianPhase(&StepTimes::m_backward),
+                medianPhase(&StepTimes::m_aggregation), medianPhase(&StepTimes::m_update), peakMemoryMB);
+        report.Add(line);
+    }
+}
+
+// Runs the benchmark suite: training steps of representative networks, built with the ComputationNetworkBuilder and fed
+// from synthetic minibatches held in host memory (so that no reader or I/O is involved):
+//     resnet50  ResNet-50 on 224 x 224 x 3 images, 1000 classes (samples are images)
+//     lstm      3-layer LSTM of 1024 cells with OptimizedRNNStack on 80-dim features, 9000 classes (samples are frames; GPU only)
+//     dssm      DSSM with two 50k-dim sparse letter-trigram towers and 4 negative samples (samples are query/document pairs)
+//     seq2seq   2-layer LSTM encoder-decoder from primitive nodes with PastValue loops, 30k words (samples are words)
+//
+// A step loads the minibatch into the input nodes, runs forward and backward propagation, sums the gradients of the
+// replicas (one per device, each with the given per-device minibatch) and applies plain SGD. Every case is warmed up and
+// then timed over a number of steps; reported as CSV are the samples per second over all devices, the medians of the step
+// and of its phases, and the peak memory of a device (matrix pool, parameters and gradients):
+//     model,devices,precision,minibatch,samplesPerSecond,stepMs,inputMs,forwardMs,backwardMs,aggregationMs,updateMs,peakMemoryMB
+// The phases are timed in extra steps with a device synchronization after each phase, the throughput in steps that only
+// synchronize at their end. An output file can serve as the baseline of a later run, which then reports each case whose
+// throughput dropped by more than the tolerance.
+//
+// Options, besides those of all benchmarks (see BenchmarkOptions; the device ids are those of the replicas, the default
+// tolerance is 0.05):
+//     --model <names>         comma-separated models, or all (default: all)
+//     --minibatch <n>         samples per device and step, sequences for lstm and seq2seq (default: per model)
+//     --steps <n>             timed steps per case (default: 10)
+//
+// Returns 0, or 1 if a case regressed against the baseline.
+static int RunNetworkBenchmarks(const vector<string>& args)
+{
+    vector<string> modelNames;
+    size_t minibatchSize = 0, numSteps = 10;
+    auto options = ParseBenchmarkOptions("NetworkBenchmarks", args, 0.05, [&](const string& option, const string& value)
+    {
+        if (option == "--model")
+        {
+            modelNames.clear();
+            for (const auto& name : SplitBenchmarkList(value))
+                if (name != "all")
+                    modelNames.push_back(name);
+        }
+        else if (option == "--minibatch")
+            minibatchSize = (size_t) stoul(value);
+        else if (option == "--steps")
+            numSteps = (size_t) stoul(value);
+        else
+            return false;
+        return true;
+    });
+    const vector<DEVICEID_TYPE>& deviceIds = options.m_deviceIds;
+    if (numSteps == 0)
+        InvalidArgument("NetworkBenchmarks: The number of steps must be positive.");
+    if (deviceIds.empty() || (deviceIds.size() > 1 && find(deviceIds.begin(), deviceIds.end(), CPUDEVICE) != deviceIds.end()))
+        InvalidArgument("NetworkBenchmarks: Replicas need either the CPU or one or more distinct GPUs.");
+    for (const auto& name : modelNames)
+    {
+        auto models = GetBenchmarkModels<float>();
+        if (find_if(models.begin(), models.end(), [&](const BenchmarkModel<float>& model) { return name == model.m_name; }) == models.end())
+            InvalidArgument("NetworkBenchmarks: Unknown model '%s'.", name.c_str());
+    }
+
+    // throughput by "model,devices,precision,minibatch"
+    BenchmarkReport report("NetworkBenchmarks", s_csvHeader, 4, true, "samples/s");
+    if (!options.m_baselinePath.empty())
+        report.ReadBaseline(options.m_baselinePath);
+
+    report.PrintHeader();
+    if (options.RunFloat())
+        RunBenchmarks<float>(deviceIds, modelNames, minibatchSize, numSteps, report);
+    if (options.RunDouble())
+        RunBenchmarks<double>(deviceIds, modelNames, minibatchSize, numSteps, report);
+
+    if (!options.m_outputPath.empty())
+        report.WriteOutput(options.m_outputPath);
+    return report.CompareToBaseline(options.m_tolerance) > 0 ? 1 : 0;
+}
+
+}}}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t* argv[])
+#else
+int main(int argc, char* argv[])
+#endif
+{
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++)
+#ifdef _WIN32
+        args.push_back(msra::strfun::utf8(argv[i]));
+#else
+        args.push_back(argv[i]);
+#endif
+
+    try
+    {
+        return Microsoft::MSR::CNTK::RunNetworkBenchmarks(args);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return 2;
+    }
+}
@@ -0,0 +1,113 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+const size_t c_numLayers = 8;
+const size_t c_dim = 3;
+const size_t c_numSamples = 4;
+
+// Trains one minibatch of a deep tanh network and returns the criterion and the gradients of all weights, concatenated.
+// With checkpoints == nullptr, all activations are kept from forward prop.
+template <class ElemType>
+static vector<ElemType> ComputeGradients(const vector<wstring>* checkpoints)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", c_dim);
+    auto labels = builder.CreateInputNode(L"labels", c_dim);
+    vector<shared_ptr<ComputationNode<ElemType>>> weights;
+    shared_ptr<ComputationNode<ElemType>> h = features;
+    for (size_t layer = 0; layer < c_numLayers; layer++)
+    {
+        vector<ElemType> values;
+        for (size_t i = 0; i < c_dim * c_dim; i++)
+            values.push_back((ElemType) (0.1 * ((i + layer) % 5) - 0.2));
+        auto w = builder.CreateLearnableParameter(L"W" + to_wstring(layer), c_dim, c_dim);
+        w->Value().SetValue(c_dim, c_dim, c_deviceId, values.data());
+        weights.push_back(w);
+        h = builder.Tanh(builder.Times(w, h), L"h" + to_wstring(layer));
+    }
+    auto criterion = builder.SquareError(labels, h, L"criterion");
+    auto side = builder.Tanh(features, L"side"); // (not part of the criterion)
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->AddToNodeGroup(L"output", side);
+    net->CompileNetwork();
+
+    if (checkpoints)
+        net->EnableActivationRecomputation(*checkpoints);
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    vector<ElemType> featureValues, labelValues;
+    for (size_t i = 0; i < c_dim * c_numSamples; i++)
+    {
+        featureValues.push_back((ElemType) (0.5 - 0.1 * i));
+        labelValues.push_back((ElemType) (0.05 * i));
+    }
+    features->GetMBLayout()->InitAsFrameMode(c_numSamples);
+    features->Value().SetValue(c_dim, c_numSamples, c_deviceId, featureValues.data());
+    labels->Value().SetValue(c_dim, c_numSamples, c_deviceId, labelValues.data());
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->ForwardProp(ComputationNodeBasePtr(criterion));
+    net->Backprop(criterion);
+
+    vector<ElemType> result{ (ElemType) criterion->Get00Element() };
+    for (const auto& w : weights)
+        result.insert(result.end(), w->Gradient().Data(), w->Gradient().Data() + w->Gradient().GetNumElements());
+    return result;
+}
+
+template <class ElemType>
+void ActivationRecomputationTestImpl()
+{
+    auto expected = ComputeGradients<ElemType>(nullptr);
+
+    // sqrt(N) segments
+    vector<wstring> noCheckpoints;
+    auto recomputed = ComputeGradients<ElemType>(&noCheckpoints);
+    BOOST_REQUIRE_EQUAL(recomputed.size(), expected.size());
+    BOOST_CHECK(AreEqual(expected.data(), recomputed.data(), expected.size(), 1e-5f));
+
+    // explicit checkpoints
+    vector<wstring> checkpoints{ L"h2", L"h5" };
+    recomputed = ComputeGradients<ElemType>(&checkpoints);
+    BOOST_REQUIRE_EQUAL(recomputed.size(), expected.size());
+    BOOST_CHECK(AreEqual(expected.data(), recomputed.data(), expected.size(), 1e-5f));
+}
+
+BOOST_AUTO_TEST_SUITE(ActivationRecomputationTestSuite)
+
+BOOST_AUTO_TEST_CASE(ActivationRecomputationTest)
+{
+    ActivationRecomputationTestImpl<float>();
+    ActivationRecomputationTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(ActivationRecomputationUnknownCheckpointTest)
+{
+    vector<wstring> checkpoints{ L"side" }; // (not a node that the criterion is backpropagated through)
+    BOOST_CHECK_THROW(ComputeGradients<float>(&checkpoints), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,95 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "../../../Source/SGDLib/FlatParameterBuffer.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+template <class ElemType>
+void FlatParameterBufferTestImpl()
+{
+    // criterion = SquareError(labels, Times(W, features) + b)
+    vector<ElemType> weights{ 1, 2, 3, 4, 5, 6 };
+    vector<ElemType> bias{ -1, 1 };
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", 3);
+    auto labels = builder.CreateInputNode(L"labels", 2);
+    auto w = builder.CreateLearnableParameter(L"W", 2, 3);
+    auto b = builder.CreateLearnableParameter(L"b", 2, 1);
+    w->Value().SetValue(2, 3, c_deviceId, weights.data());
+    b->Value().SetValue(2, 1, c_deviceId, bias.data());
+    auto criterion = builder.SquareError(labels, builder.Plus(builder.Times(w, features), b), L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    auto& learnableNodes = net->LearnableParameterNodes(criterion);
+    FlatParameterBuffer<ElemType> flat(learnableNodes, /*stateSize=*/2, c_deviceId);
+    BOOST_REQUIRE_EQUAL(flat.NumNodes(), 2u);
+    BOOST_CHECK(flat.Contains(w) && flat.Contains(b));
+    BOOST_CHECK(flat.AreValuesBound());
+    BOOST_CHECK(flat.AreGradientsBound());
+
+    // the values are kept, now in the buffer, each parameter aligned like a separate allocation
+    BOOST_CHECK_EQUAL(w->Value().GetNumRows(), 2u);
+    BOOST_CHECK_EQUAL(w->Value().GetNumCols(), 3u);
+    BOOST_CHECK(AreEqual(weights.data(), w->Value().Data(), weights.size(), 1e-6f));
+    BOOST_CHECK(AreEqual(bias.data(), b->Value().Data(), bias.size(), 1e-6f));
+    BOOST_CHECK(FlatParameterBuffer<ElemType>::IsViewOf(flat.Values(), w->Value()));
+    BOOST_CHECK(FlatParameterBuffer<ElemType>::IsViewOf(flat.Values(), b->Value()));
+    BOOST_CHECK_EQUAL((size_t) (w->Value().Data() - flat.Values().Data()) * sizeof(ElemType) % 256, 0u);
+    BOOST_CHECK_EQUAL((size_t) (b->Value().Data() - flat.Values().Data()) * sizeof(ElemType) % 256, 0u);
+
+    // an operation on the buffer is one on all the gradients
+    flat.Gradients().SetValue(3);
+    BOOST_CHECK_EQUAL(w->Gradient().GetNumRows(), 2u);
+    BOOST_CHECK_EQUAL(w->Gradient().GetNumCols(), 3u);
+    BOOST_CHECK_EQUAL(w->Gradient()(1, 2), 3);
+    BOOST_CHECK_EQUAL(b->Gradient()(1, 0), 3);
+
+    // the smoothed gradients have room for the whole state, all zero
+    auto state = flat.StateOf(w);
+    BOOST_CHECK_EQUAL(state.GetNumRows(), 2u);
+    BOOST_CHECK_EQUAL(state.GetNumCols(), 6u);
+    BOOST_CHECK(FlatParameterBuffer<ElemType>::IsViewOf(flat.States(), state));
+    BOOST_CHECK_EQUAL(state.FrobeniusNorm(), 0);
+
+    // a copy of the buffer maps back to the parameters
+    Matrix<ElemType> copy = flat.Values().DeepClone();
+    auto bias2 = FlatParameterBuffer<ElemType>::CorrespondingView(flat.Values(), copy, b->Value());
+    BOOST_CHECK(AreEqual(bias.data(), bias2.Data(), bias.size(), 1e-6f));
+    BOOST_CHECK(bias2.Data() != b->Value().Data());
+
+    // a node that replaces its gradient leaves the buffer incomplete
+    w->GradientPtrRef() = make_shared<Matrix<ElemType>>(2, 3, c_deviceId);
+    BOOST_CHECK(!flat.AreGradientsBound());
+}
+
+BOOST_AUTO_TEST_SUITE(FlatParameterBufferTestSuite)
+
+BOOST_AUTO_TEST_CASE(FlatParameterBufferTest)
+{
+    FlatParameterBufferTestImpl<float>();
+    FlatParameterBufferTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
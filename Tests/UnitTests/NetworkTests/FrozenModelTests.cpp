@@ -0,0 +1,81 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <cstdio>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU, where the parameters of a frozen model are views on the mapped file.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+template <class ElemType>
+void FrozenModelRoundTripTestImpl()
+{
+    const wstring fileName = wstring(L"FrozenModelTest.") + ElemTypeName<ElemType>();
+
+    // features -> Times(W, features) + b
+    vector<ElemType> weights{ 1, 2, 3, 4, 5, 6 };
+    vector<ElemType> bias{ -1, 1 };
+    {
+        auto net = make_shared<ComputationNetwork>(c_deviceId);
+        ComputationNetworkBuilder<ElemType> builder(*net);
+        auto features = builder.CreateInputNode(L"features", 3);
+        auto w = builder.CreateLearnableParameter(L"W", 2, 3);
+        auto b = builder.CreateLearnableParameter(L"b", 2, 1);
+        w->Value().SetValue(2, 3, c_deviceId, weights.data());
+        b->Value().SetValue(2, 1, c_deviceId, bias.data());
+        auto output = builder.Plus(builder.Times(w, features), b, L"output");
+        net->AddToNodeGroup(L"feature", features);
+        net->AddToNodeGroup(L"output", output);
+        net->CompileNetwork();
+        net->SaveFrozen<ElemType>(fileName);
+    }
+
+    BOOST_REQUIRE(ComputationNetwork::IsFrozenModelFile(fileName));
+
+    {
+        auto net = ComputationNetwork::CreateFromFile<ElemType>(c_deviceId, fileName); // Read() detects the frozen model
+        BOOST_REQUIRE_EQUAL(net->OutputNodes().size(), 1u);
+        BOOST_CHECK(net->OutputNodes()[0]->NodeName() == L"output");
+        BOOST_CHECK_EQUAL(net->OutputNodes()[0]->GetSampleLayout().GetNumElements(), 2u);
+        BOOST_CHECK(net->FrozenParameterStorage() != nullptr);
+
+        auto w = dynamic_pointer_cast<LearnableParameter<ElemType>>(net->GetNodeFromName(L"W"));
+        auto b = dynamic_pointer_cast<LearnableParameter<ElemType>>(net->GetNodeFromName(L"b"));
+        BOOST_REQUIRE(w && b);
+        BOOST_CHECK(!w->Value().OwnBuffer());
+        BOOST_CHECK_EQUAL(w->Value().GetNumRows(), 2u);
+        BOOST_CHECK_EQUAL(w->Value().GetNumCols(), 3u);
+        BOOST_CHECK(AreEqual(weights.data(), w->Value().Data(), weights.size(), 1e-6f));
+        BOOST_CHECK(AreEqual(bias.data(), b->Value().Data(), bias.size(), 1e-6f));
+
+        // the values are aligned within the mapped blob
+        BOOST_CHECK_EQUAL((size_t) w->Value().Data() % 256, 0u);
+        BOOST_CHECK_EQUAL((size_t) b->Value().Data() % 256, 0u);
+    }
+
+    remove(msra::strfun::utf8(fileName).c_str());
+}
+
+BOOST_AUTO_TEST_SUITE(FrozenModelTestSuite)
+
+BOOST_AUTO_TEST_CASE(FrozenModelRoundTripTest)
+{
+    FrozenModelRoundTripTestImpl<float>();
+    FrozenModelRoundTripTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
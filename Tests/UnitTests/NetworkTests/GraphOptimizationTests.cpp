@@ -0,0 +1,112 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+const size_t c_numSamples = 4;
+
+// criterion = SquareError(labels, (Tanh(W * features) + Tanh(W * features)) + (c1 + c2)), with the constants c1 and c2.
+// Returns the network after one minibatch of forward and backprop; 'result' is the criterion and the gradient of W.
+template <class ElemType>
+static ComputationNetworkPtr TrainOneMinibatch(vector<ElemType>& result)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", 3);
+    auto labels = builder.CreateInputNode(L"labels", 2);
+    vector<ElemType> weights{ 0.1f, -0.2f, 0.3f, 0.4f, -0.5f, 0.6f }, c1Values{ 1, 2 }, c2Values{ 10, 20 };
+    auto w = builder.CreateLearnableParameter(L"W", 2, 3);
+    w->Value().SetValue(2, 3, c_deviceId, weights.data());
+    auto c1 = builder.CreateLearnableParameter(L"c1", 2, 1);
+    c1->Value().SetValue(2, 1, c_deviceId, c1Values.data());
+    c1->SetLearningRateMultiplier(0);
+    auto c2 = builder.CreateLearnableParameter(L"c2", 2, 1);
+    c2->Value().SetValue(2, 1, c_deviceId, c2Values.data());
+    c2->SetLearningRateMultiplier(0);
+    auto a = builder.Tanh(builder.Times(w, features, 1, L"h1"), L"a");
+    auto b = builder.Tanh(builder.Times(w, features, 1, L"h2"), L"b");
+    auto constant = builder.Plus(c1, c2, L"constant");
+    auto output = builder.Plus(builder.Plus(a, b, L"sum"), constant, L"output");
+    auto criterion = builder.SquareError(labels, output, L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    vector<ElemType> featureValues, labelValues;
+    for (size_t i = 0; i < 3 * c_numSamples; i++)
+        featureValues.push_back((ElemType) (0.5 - 0.1 * i));
+    for (size_t i = 0; i < 2 * c_numSamples; i++)
+        labelValues.push_back((ElemType) (10 + i));
+    features->GetMBLayout()->InitAsFrameMode(c_numSamples);
+    features->Value().SetValue(3, c_numSamples, c_deviceId, featureValues.data());
+    labels->Value().SetValue(2, c_numSamples, c_deviceId, labelValues.data());
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->ForwardProp(ComputationNodeBasePtr(criterion));
+    net->Backprop(criterion);
+
+    result = { (ElemType) criterion->Get00Element() };
+    result.insert(result.end(), w->Gradient().Data(), w->Gradient().Data() + w->Gradient().GetNumElements());
+    return net;
+}
+
+template <class ElemType>
+void GraphOptimizationTestImpl()
+{
+    vector<ElemType> expected, actual;
+    Globals::DisableGraphOptimization();
+    auto net = TrainOneMinibatch<ElemType>(expected);
+    BOOST_CHECK_EQUAL(net->GetTotalNumberOfNodes(), 13u);
+
+    Globals::EnableGraphOptimization();
+    net = TrainOneMinibatch<ElemType>(actual);
+    Globals::DisableGraphOptimization();
+    BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+    BOOST_CHECK(AreEqual(expected.data(), actual.data(), expected.size(), 1e-5f));
+
+    // the duplicate chain is merged into the first one
+    BOOST_CHECK(!net->NodeNameExists(L"h2") && !net->NodeNameExists(L"b"));
+    auto sum = net->GetNodeFromName(L"sum");
+    BOOST_CHECK(sum->Input(0) == net->GetNodeFromName(L"a") && sum->Input(1) == net->GetNodeFromName(L"a"));
+
+    // the constant subgraph is precomputed, and the constants it used are gone
+    BOOST_CHECK(!net->NodeNameExists(L"c1") && !net->NodeNameExists(L"c2"));
+    auto folded = dynamic_pointer_cast<LearnableParameter<ElemType>>(net->GetNodeFromName(L"constant"));
+    BOOST_REQUIRE(folded);
+    BOOST_CHECK(!folded->IsParameterUpdateRequired());
+    vector<ElemType> expectedConstant{ 11, 22 };
+    BOOST_CHECK(AreEqual(expectedConstant.data(), folded->Value().Data(), expectedConstant.size(), 1e-6f));
+
+    // features, labels, W, h1, a, sum, constant, output, criterion
+    BOOST_CHECK_EQUAL(net->GetTotalNumberOfNodes(), 9u);
+}
+
+BOOST_AUTO_TEST_SUITE(GraphOptimizationTestSuite)
+
+BOOST_AUTO_TEST_CASE(GraphOptimizationTest)
+{
+    GraphOptimizationTestImpl<float>();
+    GraphOptimizationTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
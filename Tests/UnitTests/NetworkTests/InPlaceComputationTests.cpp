@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+const size_t c_dim = 4;
+const size_t c_numSamples = 3;
+
+// Trains one minibatch of SquareError(labels, Sigmoid(ReLU(W * features)) + Negate(Tanh(W * features))) and returns the
+// criterion and the gradient of W. 'inPlace' tells whether ReLU, Sigmoid, Tanh and Negate compute their value over their input's,
+// and 'sharesGradient' whether the input of ReLU gets its gradient in ReLU's gradient matrix.
+template <class ElemType>
+static vector<ElemType> ComputeGradients(vector<bool>& inPlace, bool& sharesGradient)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", c_dim);
+    auto labels = builder.CreateInputNode(L"labels", c_dim);
+    vector<ElemType> weights;
+    for (size_t i = 0; i < c_dim * c_dim; i++)
+        weights.push_back((ElemType) (0.1 * (i % 5) - 0.2));
+    auto w = builder.CreateLearnableParameter(L"W", c_dim, c_dim);
+    w->Value().SetValue(c_dim, c_dim, c_deviceId, weights.data());
+    auto h1 = builder.Times(w, features, 1, L"h1");
+    auto relu = builder.RectifiedLinear(h1, L"relu");
+    auto sigmoid = builder.Sigmoid(relu, L"sigmoid"); // (ReLU's value is needed by its own backprop, so Sigmoid cannot overwrite it)
+    auto tanh = builder.Tanh(builder.Times(w, features, 1, L"h2"), L"tanh");
+    auto negate = builder.Negate(tanh, L"negate");    // (likewise)
+    auto criterion = builder.SquareError(labels, builder.Plus(sigmoid, negate, L"output"), L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    vector<ElemType> featureValues, labelValues;
+    for (size_t i = 0; i < c_dim * c_numSamples; i++)
+    {
+        featureValues.push_back((ElemType) (0.6 - 0.1 * i));
+        labelValues.push_back((ElemType) (0.05 * i));
+    }
+    features->GetMBLayout()->InitAsFrameMode(c_numSamples);
+    features->Value().SetValue(c_dim, c_numSamples, c_deviceId, featureValues.data());
+    labels->Value().SetValue(c_dim, c_numSamples, c_deviceId, labelValues.data());
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->ForwardProp(ComputationNodeBasePtr(criterion));
+    net->Backprop(criterion);
+
+    inPlace = { relu->ValuePtr() == h1->ValuePtr(), sigmoid->ValuePtr() == relu->ValuePtr(),
+                tanh->ValuePtr() == net->GetNodeFromName(L"h2")->ValuePtr(), negate->ValuePtr() == tanh->ValuePtr() };
+    sharesGradient = relu->GradientPtr() == h1->GradientPtr();
+    vector<ElemType> result{ (ElemType) criterion->Get00Element() };
+    result.insert(result.end(), w->Gradient().Data(), w->Gradient().Data() + w->Gradient().GetNumElements());
+    return result;
+}
+
+template <class ElemType>
+void InPlaceComputationTestImpl()
+{
+    vector<bool> inPlace;
+    bool sharesGradient;
+    Globals::DisableInPlaceComputation();
+    auto expected = ComputeGradients<ElemType>(inPlace, sharesGradient);
+    Globals::EnableInPlaceComputation();
+    BOOST_CHECK(inPlace == vector<bool>({ false, false, false, false }));
+    BOOST_CHECK(!sharesGradient);
+
+    auto actual = ComputeGradients<ElemType>(inPlace, sharesGradient);
+    BOOST_CHECK(inPlace == vector<bool>({ true, false, true, false }));
+    BOOST_CHECK(sharesGradient);
+    BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+    BOOST_CHECK(AreEqual(expected.data(), actual.data(), expected.size(), 1e-5f));
+}
+
+BOOST_AUTO_TEST_SUITE(InPlaceComputationTestSuite)
+
+BOOST_AUTO_TEST_CASE(InPlaceComputationTest)
+{
+    InPlaceComputationTestImpl<float>();
+    InPlaceComputationTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
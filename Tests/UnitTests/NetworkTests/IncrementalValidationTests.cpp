@@ -0,0 +1,83 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "../../../Source/ComputationNetworkLib/NonlinearityNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// the validated state of all nodes: [name] -> (sample layout, has MBLayout, needs gradient)
+static map<wstring, tuple<TensorShape, bool, bool>> ValidatedState(const ComputationNetworkPtr& net)
+{
+    map<wstring, tuple<TensorShape, bool, bool>> state;
+    for (const auto& node : net->GetAllNodes())
+        state[node->NodeName()] = make_tuple(node->GetSampleLayout(), node->HasMBLayout(), node->NeedsGradient());
+    return state;
+}
+
+// Edits h = Tanh(W * features) with a recurrence r = h + PastValue(r), and s = Sigmoid(features) on the side, and checks that
+// revalidating only what the edits affect gives the same result as validating the whole network.
+template <class ElemType>
+void IncrementalValidationTestImpl()
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", 4);
+    auto w = builder.CreateLearnableParameter(L"W", 3, 4);
+    auto h = builder.Tanh(builder.Times(w, features, 1, L"z"), L"h");
+    auto p = builder.PastValue(h, 0, 3, 1, L"p");
+    auto r = builder.Plus(h, p, L"r");
+    ComputationNodeBasePtr(p)->SetInput(0, r);
+    auto s = builder.Sigmoid(features, L"s");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"output", r);
+    net->AddToNodeGroup(L"output", s);
+    net->CompileNetwork();
+    BOOST_CHECK_EQUAL(r->GetSampleLayout().GetNumElements(), 3u);
+
+    // a parameter of another dimension, which changes the loop but not s
+    net->ReplaceNode(L"W", New<LearnableParameter<ElemType>>(c_deviceId, L"W", 2, 4));
+    net->CompileNetwork();
+    BOOST_CHECK_EQUAL(h->GetSampleLayout().GetNumElements(), 2u);
+    BOOST_CHECK_EQUAL(p->GetSampleLayout().GetNumElements(), 2u);
+    BOOST_CHECK_EQUAL(r->GetSampleLayout().GetNumElements(), 2u);
+    BOOST_CHECK_EQUAL(s->GetSampleLayout().GetNumElements(), 4u);
+
+    // a new node between the features and their readers
+    auto t = New<TanhNode<ElemType>>(c_deviceId, L"t");
+    t->AttachInputs({ features });
+    net->InsertNode(L"features", t, {});
+    net->CompileNetwork();
+    BOOST_CHECK(s->GetInputs()[0] == t);
+    BOOST_CHECK(ComputationNodeBasePtr(t)->HasMBLayout());
+
+    auto incremental = ValidatedState(net);
+    net->InvalidateCompiledNetwork();
+    net->CompileNetwork();
+    BOOST_CHECK(incremental == ValidatedState(net));
+}
+
+BOOST_AUTO_TEST_SUITE(IncrementalValidationTestSuite)
+
+BOOST_AUTO_TEST_CASE(IncrementalValidationAfterEdits)
+{
+    IncrementalValidationTestImpl<float>();
+    IncrementalValidationTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -0,0 +1,73 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/Common/Include/Sequences.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// two parallel sequences of 3 and 2 time steps, with a gap after the second one, as a reader would build it
+static MBLayoutPtr CreateReaderLayout(UniqueSequenceId firstSeqId, size_t secondLength)
+{
+    auto layout = make_shared<MBLayout>(2, 3, L"");
+    layout->AddSequence(firstSeqId, 0, 0, 3);
+    layout->AddSequence(firstSeqId + 1, 1, 0, secondLength);
+    if (secondLength < 3)
+        layout->AddGap(1, secondLength, 3);
+    return layout;
+}
+
+BOOST_AUTO_TEST_SUITE(MBLayoutTestSuite)
+
+BOOST_AUTO_TEST_CASE(MBLayoutSameStructureTest)
+{
+    auto first = CreateReaderLayout(10, 2);
+    auto second = CreateReaderLayout(20, 2);
+    auto other = CreateReaderLayout(30, 3);
+
+    // the sequence ids differ, the structure does not
+    BOOST_CHECK(*first != *second);
+    BOOST_CHECK(first->HasSameStructure(*second));
+    BOOST_CHECK_EQUAL(first->GetStructureHash(), second->GetStructureHash());
+    BOOST_CHECK(!first->HasSameStructure(*other));
+}
+
+BOOST_AUTO_TEST_CASE(MBLayoutColumnsValidityMaskCacheTest)
+{
+    auto network = make_shared<MBLayout>();
+    network->CopyFrom(CreateReaderLayout(100, 2));
+    const auto& mask = network->GetColumnsValidityMask(c_deviceId);
+    BOOST_REQUIRE_EQUAL(mask.GetNumCols(), 6u);
+    vector<char> expected{ 1, 1, 1, 1, 1, 0 };
+    BOOST_CHECK(equal(expected.begin(), expected.end(), mask.Data()));
+
+    // the next minibatch has the same structure: the mask is kept, and the sequence ids are taken over
+    network->CopyFrom(CreateReaderLayout(200, 2));
+    BOOST_CHECK_EQUAL(network->GetAllSequences()[0].seqId, 200u);
+    BOOST_CHECK(&network->GetColumnsValidityMask(c_deviceId) == &mask);
+
+    // another layout of that structure finds the mask in the cache
+    auto reader = CreateReaderLayout(300, 2);
+    BOOST_CHECK(&reader->GetColumnsValidityMask(c_deviceId) == &mask);
+
+    // a different structure gets a mask of its own
+    network->CopyFrom(CreateReaderLayout(400, 1));
+    BOOST_CHECK_EQUAL(network->GetActualNumSamples(), 4u);
+    const auto& otherMask = network->GetColumnsValidityMask(c_deviceId);
+    BOOST_CHECK(&otherMask != &mask);
+    vector<char> otherExpected{ 1, 1, 1, 0, 1, 0 };
+    BOOST_CHECK(equal(otherExpected.begin(), otherExpected.end(), otherMask.Data()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,292 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNode.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/MatrixPool.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU since there is nothing device specific in the pool.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+template <class ElemType>
+void MatrixPoolBestFitTestImpl()
+{
+    MatrixPool pool;
+
+    auto small = pool.Request<ElemType>(c_deviceId, 100, true);
+    auto medium = pool.Request<ElemType>(c_deviceId, 1000, true);
+    auto large = pool.Request<ElemType>(c_deviceId, 100000, true);
+    BOOST_CHECK_EQUAL(pool.GetNumBuffers<ElemType>(), 3u);
+
+    pool.Release<ElemType>(large);
+    pool.Release<ElemType>(small);
+    pool.Release<ElemType>(medium);
+
+    // The smallest buffer that is large enough wins, regardless of release order.
+    BOOST_CHECK(pool.Request<ElemType>(c_deviceId, 900, true) == medium);
+
+    // If nothing is large enough, the largest smaller buffer is grown.
+    BOOST_CHECK(pool.Request<ElemType>(c_deviceId, 200000, true) == large);
+    BOOST_CHECK(pool.Request<ElemType>(c_deviceId, 50, true) == small);
+    BOOST_CHECK_EQUAL(pool.GetNumBuffers<ElemType>(), 3u);
+
+    size_t numElementsPerColumn, numFixedElements;
+    pool.GetPlannedNumElements<ElemType>(numElementsPerColumn, numFixedElements);
+    BOOST_CHECK_EQUAL(numElementsPerColumn, 100u + 1000u + 200000u);
+    BOOST_CHECK_EQUAL(numFixedElements, 0u);
+}
+
+template <class ElemType>
+void MatrixPoolNoSharingAcrossKindsTestImpl()
+{
+    MatrixPool pool;
+
+    auto perColumn = pool.Request<ElemType>(c_deviceId, 1000, true);
+    pool.Release<ElemType>(perColumn);
+
+    // A buffer that scales with the minibatch is not comparable to a fixed-size one.
+    auto fixed = pool.Request<ElemType>(c_deviceId, 1000, false);
+    BOOST_CHECK(fixed != perColumn);
+
+    pool.Release<ElemType>(fixed);
+    BOOST_CHECK(pool.Request<ElemType>(c_deviceId, 10, false) == fixed);
+    BOOST_CHECK(pool.Request<ElemType>(c_deviceId, 10, true) == perColumn);
+    BOOST_CHECK_EQUAL(pool.GetNumBuffers<ElemType>(), 2u);
+}
+
+template <class ElemType>
+void MatrixPoolSparseSharingTestImpl()
+{
+    MatrixPool pool;
+
+    auto dense = pool.Request<ElemType>(c_deviceId, 1000, false);
+    auto small = pool.RequestSparse<ElemType>(c_deviceId, matrixFormatSparseBlockCol, 100, false);
+    auto large = pool.RequestSparse<ElemType>(c_deviceId, matrixFormatSparseBlockCol, 10000, false);
+    auto csc = pool.RequestSparse<ElemType>(c_deviceId, matrixFormatSparseCSC, 1000, false);
+    BOOST_CHECK(small->GetMatrixType() == SPARSE && small->GetFormat() == matrixFormatSparseBlockCol);
+    BOOST_CHECK(csc->GetMatrixType() == SPARSE && csc->GetFormat() == matrixFormatSparseCSC);
+
+    pool.Release<ElemType>(dense);
+    pool.Release<ElemType>(large);
+    pool.Release<ElemType>(small);
+    pool.Release<ElemType>(csc);
+
+    // sparse matrices are only shared with requests of the same format, by the capacity of their nonzeros
+    BOOST_CHECK(pool.RequestSparse<ElemType>(c_deviceId, matrixFormatSparseBlockCol, 5000, false) == large);
+    BOOST_CHECK(pool.RequestSparse<ElemType>(c_deviceId, matrixFormatSparseCSC, 10, false) == csc);
+    BOOST_CHECK(pool.Request<ElemType>(c_deviceId, 10, false) == dense);
+    BOOST_CHECK(pool.RequestSparse<ElemType>(c_deviceId, matrixFormatSparseBlockCol, 100, false) == small);
+    auto csr = pool.RequestSparse<ElemType>(c_deviceId, matrixFormatSparseCSR, 100, false);
+    BOOST_CHECK(csr != csc);
+    BOOST_CHECK_EQUAL(pool.GetNumBuffers<ElemType>(), 5u);
+
+    BOOST_CHECK_THROW(pool.RequestSparse<ElemType>(c_deviceId, matrixFormatDense, 100, false), std::logic_error);
+}
+
+template <class ElemType>
+void MatrixPoolAllocatedBytesTestImpl()
+{
+    MatrixPool pool;
+
+    auto first = pool.Request<ElemType>(c_deviceId, 10, true);
+    auto second = pool.Request<ElemType>(c_deviceId, 10, true);
+    first->Resize(10, 4);
+    second->Resize(10, 2);
+    BOOST_CHECK_EQUAL(pool.GetAllocatedBytes(), first->BufferSize() + second->BufferSize());
+    BOOST_CHECK_EQUAL(pool.GetAllocatedBytes(), 60 * sizeof(ElemType));
+
+    // Buffers dropped by all owners are no longer accounted for.
+    second.reset();
+    BOOST_CHECK_EQUAL(pool.GetAllocatedBytes(), 40 * sizeof(ElemType));
+    BOOST_CHECK_EQUAL(pool.GetNumBuffers<ElemType>(), 1u);
+}
+
+template <class ElemType>
+void ForwardPropOnlyAllocationTestImpl(bool forwardPropOnly)
+{
+    // h1 -> h2 -> h3 -> output, each a Times with its own weights
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", 4);
+    auto h1 = builder.Times(builder.CreateLearnableParameter(L"W1", 4, 4), features, 1, L"h1");
+    auto h2 = builder.Times(builder.CreateLearnableParameter(L"W2", 4, 4), h1, 1, L"h2");
+    auto h3 = builder.Times(builder.CreateLearnableParameter(L"W3", 4, 4), h2, 1, L"h3");
+    auto output = builder.Times(builder.CreateLearnableParameter(L"W4", 4, 4), h3, 1, L"output");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"output", output);
+    net->CompileNetwork();
+
+    net->AllocateAllMatrices({}, { output }, nullptr, forwardPropOnly);
+
+    // h1 has been consumed when h3 is computed, so h3 can take over its buffer
+    BOOST_CHECK_EQUAL(h1->ValuePtr() == h3->ValuePtr(), forwardPropOnly);
+    BOOST_CHECK(h2->ValuePtr() != h1->ValuePtr() && h2->ValuePtr() != h3->ValuePtr());
+    BOOST_CHECK(output->ValuePtr() != h1->ValuePtr() && output->ValuePtr() != h2->ValuePtr());
+}
+
+template <class ElemType>
+void MatrixPoolStaticPlanTestImpl()
+{
+    MatrixPool pool;
+    pool.EnableStaticPlan();
+
+    // a and b live at the same time; c comes after a, and can take its place
+    auto a = pool.Request<ElemType>(c_deviceId, 64, true, /*isNodeOutput=*/true);
+    auto b = pool.Request<ElemType>(c_deviceId, 32, true, /*isNodeOutput=*/true);
+    pool.Release<ElemType>(a);
+    auto c = pool.Request<ElemType>(c_deviceId, 64, true, /*isNodeOutput=*/true);
+    auto temp = pool.Request<ElemType>(c_deviceId, 64, true); // (not planned)
+    pool.Release<ElemType>(b);
+    pool.Release<ElemType>(c);
+
+    pool.PlanStaticMemory(4);
+    const size_t aBytes = 64 * 4 * sizeof(ElemType), bBytes = 32 * 4 * sizeof(ElemType);
+    BOOST_CHECK_EQUAL(pool.GetPlannedMaxColumns(), 4u);
+    BOOST_CHECK_EQUAL(pool.GetPlannedPeakBytes(), aBytes + bBytes);
+    BOOST_CHECK_EQUAL(pool.GetArenaBytes(), aBytes + bBytes);
+
+    BOOST_CHECK(!a->OwnBuffer() && !b->OwnBuffer() && !c->OwnBuffer());
+    BOOST_CHECK(temp->OwnBuffer());
+    a->Resize(64, 4);
+    b->Resize(32, 4);
+    c->Resize(64, 4);
+    BOOST_CHECK(a->Data() == c->Data());
+    BOOST_CHECK(b->Data() >= a->Data() + 64 * 4 || b->Data() + 32 * 4 <= a->Data());
+
+    // the plan covers up to 4 columns
+    BOOST_CHECK_THROW(a->Resize(64, 5), std::logic_error);
+}
+
+template <class ElemType>
+static vector<ElemType> ComputeGradients(size_t staticMemoryPlanMaxColumns, size_t numSamples, bool& intermediateIsView)
+{
+    // a chain of tanh layers, trained for one minibatch
+    const size_t dim = 3, numLayers = 4;
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", dim);
+    auto labels = builder.CreateInputNode(L"labels", dim);
+    vector<shared_ptr<ComputationNode<ElemType>>> weights;
+    shared_ptr<ComputationNode<ElemType>> h = features;
+    for (size_t layer = 0; layer < numLayers; layer++)
+    {
+        vector<ElemType> values;
+        for (size_t i = 0; i < dim * dim; i++)
+            values.push_back((ElemType) (0.1 * ((i + layer) % 5) - 0.2));
+        auto w = builder.CreateLearnableParameter(L"W" + to_wstring(layer), dim, dim);
+        w->Value().SetValue(dim, dim, c_deviceId, values.data());
+        weights.push_back(w);
+        h = builder.Tanh(builder.Times(w, h), L"h" + to_wstring(layer));
+    }
+    auto criterion = builder.SquareError(labels, h, L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+
+    if (staticMemoryPlanMaxColumns > 0)
+        net->EnableStaticMemoryPlan(staticMemoryPlanMaxColumns);
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    vector<ElemType> featureValues, labelValues;
+    for (size_t i = 0; i < dim * numSamples; i++)
+    {
+        featureValues.push_back((ElemType) (0.5 - 0.1 * i));
+        labelValues.push_back((ElemType) (0.05 * i));
+    }
+    features->GetMBLayout()->InitAsFrameMode(numSamples);
+    features->Value().SetValue(dim, numSamples, c_deviceId, featureValues.data());
+    labels->Value().SetValue(dim, numSamples, c_deviceId, labelValues.data());
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->ForwardProp(ComputationNodeBasePtr(criterion));
+    net->Backprop(criterion);
+
+    intermediateIsView = !dynamic_pointer_cast<ComputationNode<ElemType>>(net->GetNodeFromName(L"h1"))->Value().OwnBuffer();
+    vector<ElemType> result{ (ElemType) criterion->Get00Element() };
+    for (const auto& w : weights)
+        result.insert(result.end(), w->Gradient().Data(), w->Gradient().Data() + w->Gradient().GetNumElements());
+    return result;
+}
+
+template <class ElemType>
+void StaticMemoryPlanTestImpl()
+{
+    bool isView;
+    auto expected = ComputeGradients<ElemType>(0, 4, isView);
+    BOOST_CHECK(!isView);
+
+    // planned for exactly and for more than the minibatch size
+    for (size_t maxColumns : { 4, 16 })
+    {
+        auto planned = ComputeGradients<ElemType>(maxColumns, 4, isView);
+        BOOST_CHECK(isView);
+        BOOST_REQUIRE_EQUAL(planned.size(), expected.size());
+        BOOST_CHECK(AreEqual(expected.data(), planned.data(), expected.size(), 1e-5f));
+    }
+
+    // a minibatch larger than planned for is rejected
+    BOOST_CHECK_THROW(ComputeGradients<ElemType>(2, 4, isView), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE(MatrixPoolTestSuite)
+
+BOOST_AUTO_TEST_CASE(MatrixPoolBestFitTest)
+{
+    MatrixPoolBestFitTestImpl<float>();
+    MatrixPoolBestFitTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolNoSharingAcrossKindsTest)
+{
+    MatrixPoolNoSharingAcrossKindsTestImpl<float>();
+    MatrixPoolNoSharingAcrossKindsTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolSparseSharingTest)
+{
+    MatrixPoolSparseSharingTestImpl<float>();
+    MatrixPoolSparseSharingTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolAllocatedBytesTest)
+{
+    MatrixPoolAllocatedBytesTestImpl<float>();
+    MatrixPoolAllocatedBytesTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(ForwardPropOnlyAllocationTest)
+{
+    // (without shareNodeValueMatrices, only a forward-prop-only allocation shares node values)
+    ForwardPropOnlyAllocationTestImpl<float>(/*forwardPropOnly=*/false);
+    ForwardPropOnlyAllocationTestImpl<float>(/*forwardPropOnly=*/true);
+    ForwardPropOnlyAllocationTestImpl<double>(/*forwardPropOnly=*/true);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolStaticPlanTest)
+{
+    MatrixPoolStaticPlanTestImpl<float>();
+    MatrixPoolStaticPlanTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(StaticMemoryPlanTest)
+{
+    StaticMemoryPlanTestImpl<float>();
+    StaticMemoryPlanTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
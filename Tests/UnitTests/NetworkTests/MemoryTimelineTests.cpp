@@ -0,0 +1,108 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "../../../Source/ComputationNetworkLib/MemoryTimeline.h"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+BOOST_AUTO_TEST_SUITE(MemoryTimelineTestSuite)
+
+BOOST_AUTO_TEST_CASE(MemoryTimelineTest)
+{
+    const size_t numLayers = 4, dim = 16, numSamples = 8;
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", dim);
+    auto labels = builder.CreateInputNode(L"labels", dim);
+    shared_ptr<ComputationNode<float>> h = features;
+    for (size_t layer = 0; layer < numLayers; layer++)
+    {
+        auto w = builder.CreateLearnableParameter(L"W" + to_wstring(layer), dim, dim);
+        w->Value().SetValue(0.01f);
+        h = builder.Tanh(builder.Times(w, h), L"h" + to_wstring(layer));
+    }
+    auto criterion = builder.SquareError(labels, h, L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    features->GetMBLayout()->InitAsFrameMode(numSamples);
+    features->Value().Resize(dim, numSamples);
+    features->Value().SetValue(0.5f);
+    labels->Value().Resize(dim, numSamples);
+    labels->Value().SetValue(0.1f);
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+
+    net->BeginMemoryTimeline();
+    {
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        net->ForwardProp(ComputationNodeBasePtr(criterion));
+        net->Backprop(criterion);
+    }
+    auto timeline = net->EndMemoryTimeline();
+    BOOST_REQUIRE(timeline != nullptr);
+
+    // the computed nodes (Times and Tanh per layer, and the criterion) forward, then all nodes of the criterion backward
+    const auto& events = timeline->GetEvents();
+    size_t numForward = 2 * numLayers + 1, numBackward = net->GetEvalOrder(criterion).size();
+    BOOST_REQUIRE_EQUAL(events.size(), numForward + numBackward);
+    BOOST_CHECK(!events.front().m_isBackward);
+    BOOST_CHECK(events[numForward - 1].m_nodeName == L"criterion" && !events[numForward - 1].m_isBackward);
+    BOOST_CHECK(events[numForward].m_nodeName == L"criterion" && events[numForward].m_isBackward);
+    BOOST_CHECK(events.back().m_isBackward);
+
+    size_t peakBytes = 0;
+    for (const auto& event : events)
+    {
+        BOOST_CHECK_LE(event.m_heldBytes, event.m_allocatedBytes);
+        peakBytes = max(peakBytes, event.m_allocatedBytes);
+        if (event.m_nodeName == L"h0" && !event.m_isBackward)
+            BOOST_CHECK_GE(event.m_valueBytes, dim * numSamples * sizeof(float));
+    }
+    BOOST_CHECK_EQUAL(timeline->GetPeakAllocatedBytes(), peakBytes);
+    BOOST_CHECK_GE(peakBytes, numLayers * dim * dim * sizeof(float));
+
+    // the holders at the peak account for all bytes
+    size_t heldBytes = 0;
+    for (const auto& holder : timeline->GetPeakHolders())
+        heldBytes += holder.second;
+    BOOST_CHECK_EQUAL(heldBytes, peakBytes);
+
+    // recording is over
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+    {
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        net->ForwardProp(ComputationNodeBasePtr(criterion));
+    }
+    BOOST_CHECK_EQUAL(events.size(), numForward + numBackward);
+
+    timeline->Save(L"memoryTimeline.tmp");
+    ifstream file("memoryTimeline.tmp");
+    size_t numLines = 0;
+    for (string line; getline(file, line);)
+        numLines++;
+    file.close();
+    BOOST_CHECK_EQUAL(numLines, events.size() + 1);
+    remove("memoryTimeline.tmp");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,182 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// Plans the placement of criterion = SquareError(labels, W3 * Tanh(W2 * Tanh(W1 * features))) onto devices 0 and 1,
+// which are not touched, so that this runs without GPUs.
+static map<wstring, DEVICEID_TYPE> PlanPlacement(const map<wstring, DEVICEID_TYPE>& manualPlacement)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", 4);
+    auto labels = builder.CreateInputNode(L"labels", 2);
+    auto w1 = builder.CreateLearnableParameter(L"W1", 16, 4);
+    auto w2 = builder.CreateLearnableParameter(L"W2", 16, 16);
+    auto w3 = builder.CreateLearnableParameter(L"W3", 2, 16);
+    auto h1 = builder.Tanh(builder.Times(w1, features, 1, L"z1"), L"h1");
+    auto h2 = builder.Tanh(builder.Times(w2, h1, 1, L"z2"), L"h2");
+    auto criterion = builder.SquareError(labels, builder.Times(w3, h2, 1, L"z3"), L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+
+    map<wstring, DEVICEID_TYPE> placement;
+    for (const auto& iter : net->PlanDevicePlacement(criterion, { 0, 1 }, manualPlacement, { criterion }, /*numSamplesHint=*/32))
+        placement[iter.first->NodeName()] = iter.second;
+    return placement;
+}
+
+const size_t c_numSamples = 6;
+
+// Trains one minibatch of SquareError(labels, W3 * Tanh(W2 * Tanh(W1 * features))) and returns the criterion and the
+// gradients of the parameters, with 'numMicroBatches' > 0 pipelined in that many micro-batches, the second layer labeled
+// as on another device (its matrices stay on the CPU) to form three stages.
+template <class ElemType>
+static vector<ElemType> TrainMinibatch(size_t numMicroBatches)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", 4);
+    auto labels = builder.CreateInputNode(L"labels", 2);
+    vector<shared_ptr<ComputationNode<ElemType>>> weights = { builder.CreateLearnableParameter(L"W1", 8, 4),
+                                                              builder.CreateLearnableParameter(L"W2", 8, 8),
+                                                              builder.CreateLearnableParameter(L"W3", 2, 8) };
+    for (auto& w : weights)
+    {
+        vector<ElemType> values;
+        for (size_t i = 0; i < w->Value().GetNumElements(); i++)
+            values.push_back((ElemType) (0.1 * (i % 7) - 0.3));
+        w->Value().SetValue(w->Value().GetNumRows(), w->Value().GetNumCols(), c_deviceId, values.data());
+    }
+    auto h1 = builder.Tanh(builder.Times(weights[0], features, 1, L"z1"), L"h1");
+    auto z2 = builder.Times(weights[1], h1, 1, L"z2");
+    auto h2 = builder.Tanh(z2, L"h2");
+    auto z3 = builder.Times(weights[2], h2, 1, L"z3");
+    auto criterion = builder.SquareError(labels, z3, L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    vector<ElemType> featureValues, labelValues;
+    for (size_t i = 0; i < 4 * c_numSamples; i++)
+        featureValues.push_back((ElemType) (0.5 - 0.07 * i));
+    for (size_t i = 0; i < 2 * c_numSamples; i++)
+        labelValues.push_back((ElemType) (0.1 * i - 0.4));
+    auto setInputs = [&](size_t first, size_t numSamples)
+    {
+        features->GetMBLayout()->InitAsFrameMode(numSamples);
+        features->Value().SetValue(4, numSamples, c_deviceId, featureValues.data() + 4 * first);
+        labels->Value().SetValue(2, numSamples, c_deviceId, labelValues.data() + 2 * first);
+        ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+    };
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    vector<ElemType> result(1);
+    auto accumulate = [&]()
+    {
+        result[0] += criterion->Get00Element();
+        size_t i = 1;
+        for (auto& w : weights)
+        {
+            const auto& gradient = w->Gradient();
+            result.resize(max(result.size(), i + gradient.GetNumElements()));
+            for (size_t j = 0; j < gradient.GetNumElements(); j++)
+                result[i++] += gradient.Data()[j];
+        }
+    };
+    if (numMicroBatches == 0)
+    {
+        setInputs(0, c_numSamples);
+        net->ForwardProp(ComputationNodeBasePtr(criterion));
+        net->Backprop(criterion);
+        accumulate();
+        return result;
+    }
+
+    for (auto node : vector<ComputationNodeBasePtr>{ z2, h2, z3 })
+        node->ComputationNodeBase::MoveToDevice(1);
+    BOOST_REQUIRE_EQUAL(net->FormPipelineStages(criterion), 3u);
+    size_t samplesPerMicroBatch = c_numSamples / numMicroBatches;
+    for (size_t k = 0; k < numMicroBatches; k++)
+    {
+        setInputs(k * samplesPerMicroBatch, samplesPerMicroBatch);
+        net->ForwardPropPipelined(k, {});
+    }
+    for (size_t k = numMicroBatches; k-- > 0;)
+    {
+        if (k + 1 < numMicroBatches)
+            setInputs(k * samplesPerMicroBatch, samplesPerMicroBatch);
+        net->BackpropPipelined(k);
+        accumulate();
+    }
+    return result;
+}
+
+template <class ElemType>
+void PipelineParallelTestImpl()
+{
+    auto expected = TrainMinibatch<ElemType>(0);
+    for (size_t numMicroBatches : { 1, 3 })
+    {
+        auto actual = TrainMinibatch<ElemType>(numMicroBatches);
+        BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+        BOOST_CHECK(AreEqual(expected.data(), actual.data(), expected.size(), 1e-5f));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(ModelParallelTestSuite)
+
+BOOST_AUTO_TEST_CASE(PlanDevicePlacement)
+{
+    auto placement = PlanPlacement({});
+    BOOST_REQUIRE_EQUAL(placement.size(), 11u);
+
+    // the inputs and the criterion stay on the device of the network
+    BOOST_CHECK_EQUAL(placement[L"features"], c_deviceId);
+    BOOST_CHECK_EQUAL(placement[L"labels"], c_deviceId);
+    BOOST_CHECK_EQUAL(placement[L"criterion"], c_deviceId);
+
+    // the layers form two stages, each parameter is with the node that reads it
+    BOOST_CHECK_EQUAL(placement[L"z1"], 0);
+    BOOST_CHECK_EQUAL(placement[L"z3"], 1);
+    BOOST_CHECK(placement[L"h1"] <= placement[L"z2"] && placement[L"z2"] <= placement[L"h2"] && placement[L"h2"] <= placement[L"z3"]);
+    BOOST_CHECK_EQUAL(placement[L"W1"], placement[L"z1"]);
+    BOOST_CHECK_EQUAL(placement[L"W2"], placement[L"z2"]);
+    BOOST_CHECK_EQUAL(placement[L"W3"], placement[L"z3"]);
+
+    // a node placed by hand, and with it its parameter
+    placement = PlanPlacement({ { L"z2", 1 }, { L"z3", 0 } });
+    BOOST_CHECK_EQUAL(placement[L"z2"], 1);
+    BOOST_CHECK_EQUAL(placement[L"W2"], 1);
+    BOOST_CHECK_EQUAL(placement[L"z3"], 0);
+    BOOST_CHECK_EQUAL(placement[L"W3"], 0);
+}
+
+BOOST_AUTO_TEST_CASE(PipelineParallel)
+{
+    PipelineParallelTestImpl<float>();
+    PipelineParallelTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+template <class ElemType>
+static shared_ptr<ComputationNode<ElemType>> CreateParameter(ComputationNetworkBuilder<ElemType>& builder, const wstring& name, size_t rows, size_t cols, vector<ElemType> values)
+{
+    auto node = builder.CreateLearnableParameter(name, rows, cols);
+    node->Value().SetValue(rows, cols, c_deviceId, values.data());
+    return node;
+}
+
+template <class ElemType>
+void OptimizeForEvaluationTestImpl()
+{
+    // output = BN(Times(W, features)) + (p1 + p2), with a criterion that is not needed for the output
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features  = builder.CreateInputNode(L"features", 3);
+    auto labels    = builder.CreateInputNode(L"labels", 2);
+    auto w         = CreateParameter<ElemType>(builder, L"W", 2, 3, { 1, 2, 3, 4, 5, 6 });
+    auto scale     = CreateParameter<ElemType>(builder, L"scale", 2, 1, { 2, 6 });
+    auto bias      = CreateParameter<ElemType>(builder, L"bias", 2, 1, { 0.5, -1 });
+    auto mean      = CreateParameter<ElemType>(builder, L"mean", 2, 1, { 1, 1 });
+    auto variance  = CreateParameter<ElemType>(builder, L"variance", 2, 1, { 3, 8 });
+    auto p1        = CreateParameter<ElemType>(builder, L"p1", 2, 1, { 1, 2 });
+    auto p2        = CreateParameter<ElemType>(builder, L"p2", 2, 1, { 10, 20 });
+    auto product   = builder.Times(w, features, 1, L"product");
+    auto batchNorm = builder.BatchNormalization(product, scale, bias, mean, variance, /*spatial=*/false, 0, 0, /*epsilon=*/1, /*useCntkEngine=*/true, ImageLayoutKind::CHW, L"batchNorm");
+    auto constant  = builder.Plus(p1, p2, L"constant");
+    auto output    = builder.Plus(batchNorm, constant, L"output");
+    auto criterion = builder.SquareError(labels, output, L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->AddToNodeGroup(L"output", output);
+    net->CompileNetwork();
+
+    net->OptimizeForEvaluation<ElemType>({ output });
+
+    // the criterion and everything only it needs is gone
+    BOOST_CHECK(!net->NodeNameExists(L"criterion"));
+    BOOST_CHECK(!net->NodeNameExists(L"labels"));
+    BOOST_CHECK(net->FinalCriterionNodes().empty());
+    BOOST_REQUIRE_EQUAL(net->OutputNodes().size(), 1u);
+    BOOST_CHECK(net->OutputNodes()[0] == net->GetNodeFromName(L"output"));
+
+    // BatchNormalization is folded into the weights: the factors scale/sqrt(variance+epsilon) are { 1, 2 }
+    BOOST_CHECK(!net->NodeNameExists(L"scale") && !net->NodeNameExists(L"mean") && !net->NodeNameExists(L"variance"));
+    BOOST_CHECK(net->GetNodeFromName(L"batchNorm")->OperationName() == L"Plus");
+    auto foldedWeights = dynamic_pointer_cast<LearnableParameter<ElemType>>(net->GetNodeFromName(L"W"));
+    BOOST_REQUIRE(foldedWeights);
+    BOOST_CHECK(foldedWeights != w);
+    vector<ElemType> expectedWeights{ 1, 4, 3, 8, 5, 12 };
+    BOOST_CHECK(AreEqual(expectedWeights.data(), foldedWeights->Value().Data(), expectedWeights.size(), 1e-5f));
+    vector<ElemType> expectedShift{ -0.5, -3 }; // bias - factor * mean
+    auto foldedBias = dynamic_pointer_cast<LearnableParameter<ElemType>>(net->GetNodeFromName(L"batchNorm.foldedBias"));
+    BOOST_REQUIRE(foldedBias);
+    BOOST_CHECK(AreEqual(expectedShift.data(), foldedBias->Value().Data(), expectedShift.size(), 1e-5f));
+
+    // the original weights are left untouched, since they may be shared
+    vector<ElemType> originalWeights{ 1, 2, 3, 4, 5, 6 };
+    BOOST_CHECK(AreEqual(originalWeights.data(), w->Value().Data(), originalWeights.size(), 1e-6f));
+
+    // the parameter-only subgraph is precomputed
+    BOOST_CHECK(!net->NodeNameExists(L"p1") && !net->NodeNameExists(L"p2"));
+    auto folded = dynamic_pointer_cast<LearnableParameter<ElemType>>(net->GetNodeFromName(L"constant"));
+    BOOST_REQUIRE(folded);
+    vector<ElemType> expectedConstant{ 11, 22 };
+    BOOST_CHECK(AreEqual(expectedConstant.data(), folded->Value().Data(), expectedConstant.size(), 1e-6f));
+
+    // features, W, product, batchNorm, batchNorm.foldedBias, constant, output
+    BOOST_CHECK_EQUAL(net->GetTotalNumberOfNodes(), 7u);
+}
+
+BOOST_AUTO_TEST_SUITE(OptimizeForEvaluationTestSuite)
+
+BOOST_AUTO_TEST_CASE(OptimizeForEvaluationTest)
+{
+    OptimizeForEvaluationTestImpl<float>();
+    OptimizeForEvaluationTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
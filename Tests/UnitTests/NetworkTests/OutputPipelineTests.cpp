@@ -0,0 +1,149 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "../../../Source/SGDLib/OutputPipeline.h"
+#include "TestHelpers.h"
+#include <cstring>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+static string ReadAll(FILE* f)
+{
+    fflush(f);
+    rewind(f);
+    string content;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        content.append(buffer, n);
+    return content;
+}
+
+template <class ElemType>
+void OutputPipelineTextTestImpl(size_t depth)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto node = builder.CreateLearnableParameter(L"W", 2, 3);
+    WriteFormattingOptions options;
+
+    // the pipeline writes the same text as the node itself, minibatch after minibatch
+    FILE* expected = tmpfile();
+    FILE* actual = tmpfile();
+    BOOST_REQUIRE(expected && actual);
+    {
+        OutputPipeline<ElemType> pipeline({ node }, { actual }, options, {}, OutputFormat::text, depth);
+        for (size_t mb = 0; mb < 5; mb++)
+        {
+            vector<ElemType> values{ 1, 2, 3, (ElemType)mb, 5, -6 };
+            node->Value().SetValue(2, 3, c_deviceId, values.data());
+            pipeline.Submit(0, mb);
+            node->WriteMinibatchWithFormatting(expected, FrameRange(), SIZE_MAX, SIZE_MAX, options.transpose, options.isCategoryLabel, options.isSparse, {},
+                                               options.sequenceSeparator, options.sequencePrologue, options.sequenceEpilogue,
+                                               options.elementSeparator, options.sampleSeparator, "%f");
+        }
+        pipeline.Finish();
+    }
+    auto expectedText = ReadAll(expected);
+    BOOST_CHECK(!expectedText.empty());
+    BOOST_CHECK_EQUAL(ReadAll(actual), expectedText);
+    fclose(expected);
+    fclose(actual);
+}
+
+template <class ElemType>
+void OutputPipelineBinaryTestImpl()
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto node = builder.CreateLearnableParameter(L"W", 2, 3);
+    vector<ElemType> values{ 1, 2, 3, 4, 5, 6 };
+    node->Value().SetValue(2, 3, c_deviceId, values.data());
+
+    FILE* f = tmpfile();
+    BOOST_REQUIRE(f);
+    {
+        OutputPipeline<ElemType> pipeline({ node }, { f }, WriteFormattingOptions(), {}, OutputFormat::binary, 2);
+        pipeline.Submit(0, 0);
+        pipeline.Finish();
+    }
+    auto content = ReadAll(f);
+    fclose(f);
+
+    // header (8 + 4 + 4 + 8 bytes), then one sequence of 3 samples, as the node has no MBLayout
+    BOOST_REQUIRE_EQUAL(content.size(), 24 + 16 + values.size() * sizeof(ElemType));
+    BOOST_CHECK_EQUAL(content.substr(0, 8), "CNTKOUT1");
+    uint32_t elemSize;
+    uint64_t dim, seqId, numSamples;
+    memcpy(&elemSize, &content[8], sizeof(elemSize));
+    memcpy(&dim, &content[16], sizeof(dim));
+    memcpy(&seqId, &content[24], sizeof(seqId));
+    memcpy(&numSamples, &content[32], sizeof(numSamples));
+    BOOST_CHECK_EQUAL(elemSize, sizeof(ElemType));
+    BOOST_CHECK_EQUAL(dim, 2u);
+    BOOST_CHECK_EQUAL(seqId, 0u);
+    BOOST_CHECK_EQUAL(numSamples, 3u);
+    BOOST_CHECK(AreEqual(values.data(), (const ElemType*)&content[40], values.size(), 1e-6f));
+}
+
+template <class ElemType>
+void OutputPipelineTopKTestImpl()
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto node = builder.CreateLearnableParameter(L"W", 3, 2);
+    vector<ElemType> values{ 1, 3, 3, 6, 4, 5 };
+    node->Value().SetValue(3, 2, c_deviceId, values.data());
+    WriteFormattingOptions options;
+    options.topK = 2;
+    options.precisionFormat = ".1";
+
+    FILE* f = tmpfile();
+    BOOST_REQUIRE(f);
+    {
+        OutputPipeline<ElemType> pipeline({ node }, { f }, options, {}, OutputFormat::text, 2);
+        pipeline.Submit(0, 0);
+        pipeline.Finish();
+    }
+    // each sample as index:score of its two largest values, in descending order, ties by index
+    BOOST_CHECK_EQUAL(ReadAll(f), "1:3.0 2:3.0\n0:6.0 2:5.0\n");
+    fclose(f);
+}
+
+BOOST_AUTO_TEST_SUITE(OutputPipelineTestSuite)
+
+BOOST_AUTO_TEST_CASE(OutputPipelineText)
+{
+    OutputPipelineTextTestImpl<float>(/*depth=*/0);
+    OutputPipelineTextTestImpl<float>(/*depth=*/2);
+    OutputPipelineTextTestImpl<double>(/*depth=*/3);
+}
+
+BOOST_AUTO_TEST_CASE(OutputPipelineBinary)
+{
+    OutputPipelineBinaryTestImpl<float>();
+    OutputPipelineBinaryTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(OutputPipelineTopK)
+{
+    OutputPipelineTopKTestImpl<float>();
+    OutputPipelineTopKTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
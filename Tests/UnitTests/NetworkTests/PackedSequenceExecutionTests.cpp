@@ -0,0 +1,117 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+const size_t c_dim = 3;
+const size_t c_numParallelSequences = 3;
+const size_t c_numTimeSteps = 4;
+
+template <class ElemType>
+static shared_ptr<ComputationNode<ElemType>> CreateParameter(ComputationNetworkBuilder<ElemType>& builder, const wstring& name, size_t rows, size_t cols)
+{
+    vector<ElemType> values;
+    for (size_t i = 0; i < rows * cols; i++)
+        values.push_back((ElemType) (0.1 * (i % 7) - 0.3));
+    auto node = builder.CreateLearnableParameter(name, rows, cols);
+    node->Value().SetValue(rows, cols, c_deviceId, values.data());
+    return node;
+}
+
+// Trains one minibatch of three sequences of 4, 1, and 2 steps, through a Times and a TransposeTimes node,
+// and returns the criterion and the gradients of the weights, concatenated, and whether the gaps of Times(W1, features) are 0.
+template <class ElemType>
+static vector<ElemType> ComputeGradients(bool packedSequenceExecution, bool& gapsAreZero)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", c_dim);
+    auto labels = builder.CreateInputNode(L"labels", c_dim);
+    auto w1 = CreateParameter<ElemType>(builder, L"W1", 4, c_dim);
+    auto w2 = CreateParameter<ElemType>(builder, L"W2", 4, c_dim);
+    auto h1 = builder.Times(w1, features, 1, L"h1");
+    auto h2 = builder.TransposeTimes(w2, builder.Tanh(h1), L"h2");
+    auto criterion = builder.SquareError(labels, h2, L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+
+    net->EnablePackedSequenceExecution(packedSequenceExecution);
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    auto layout = features->GetMBLayout();
+    layout->Init(c_numParallelSequences, c_numTimeSteps);
+    layout->AddSequence(0, 0, 0, 4);
+    layout->AddSequence(1, 1, 0, 1);
+    layout->AddGap(1, 1, 4);
+    layout->AddSequence(2, 2, 0, 2);
+    layout->AddGap(2, 2, 4);
+
+    const size_t numCols = c_numParallelSequences * c_numTimeSteps;
+    vector<ElemType> featureValues, labelValues;
+    for (size_t j = 0; j < numCols; j++)
+    {
+        bool isGap = layout->IsGap(FrameRange(layout, j / c_numParallelSequences).Sequence(j % c_numParallelSequences));
+        for (size_t i = 0; i < c_dim; i++)
+        {
+            featureValues.push_back(isGap ? 100 : (ElemType) (0.5 - 0.1 * (i + j)));
+            labelValues.push_back(isGap ? 100 : (ElemType) (0.05 * (i + j)));
+        }
+    }
+    features->Value().SetValue(c_dim, numCols, c_deviceId, featureValues.data());
+    labels->Value().SetValue(c_dim, numCols, c_deviceId, labelValues.data());
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->ForwardProp(ComputationNodeBasePtr(criterion));
+    net->Backprop(criterion);
+
+    const auto& h1Value = dynamic_pointer_cast<ComputationNode<ElemType>>(h1)->Value();
+    gapsAreZero = h1Value(0, 1 + 1 * c_numParallelSequences) == 0 && h1Value(0, 2 + 3 * c_numParallelSequences) == 0;
+
+    vector<ElemType> result{ (ElemType) criterion->Get00Element() };
+    for (const auto& w : { w1, w2 })
+        result.insert(result.end(), w->Gradient().Data(), w->Gradient().Data() + w->Gradient().GetNumElements());
+    return result;
+}
+
+template <class ElemType>
+void PackedSequenceExecutionTestImpl()
+{
+    bool gapsAreZero;
+    auto expected = ComputeGradients<ElemType>(/*packedSequenceExecution=*/false, gapsAreZero);
+    BOOST_CHECK(!gapsAreZero);
+
+    auto packed = ComputeGradients<ElemType>(/*packedSequenceExecution=*/true, gapsAreZero);
+    BOOST_CHECK(gapsAreZero); // (the gaps are not computed)
+    BOOST_REQUIRE_EQUAL(packed.size(), expected.size());
+    BOOST_CHECK(AreEqual(expected.data(), packed.data(), expected.size(), 1e-5f));
+}
+
+BOOST_AUTO_TEST_SUITE(PackedSequenceExecutionTestSuite)
+
+BOOST_AUTO_TEST_CASE(PackedSequenceExecutionTest)
+{
+    PackedSequenceExecutionTestImpl<float>();
+    PackedSequenceExecutionTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,166 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <cmath>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+const size_t c_numClasses = 7;
+const size_t c_hiddenDim = 3;
+const size_t c_numFrames = 5;
+const vector<size_t> c_labels{ 1, 4, 0, 4, 6 };
+const vector<size_t> c_samples{ 4, 2, 5 }; // class 4 is an accidental hit of frames 1 and 3
+
+static double Weight(size_t j, size_t i) { return 0.1 * ((i * c_hiddenDim + j) % 7) - 0.3; }
+static double Bias(size_t i) { return 0.1 * (i % 3) - 0.1; }
+static double Frequency(size_t i) { return 0.1 + 0.05 * i; }
+static double Hidden(size_t j, size_t t) { return 0.2 * ((t + 2 * j) % 5) - 0.4; }
+
+// Returns the criterion and the gradients of hidden activation, weights and bias, concatenated.
+template <class ElemType>
+static vector<ElemType> ComputeReference()
+{
+    double criterion = 0;
+    vector<double> hiddenGradient(c_hiddenDim * c_numFrames), weightsGradient(c_hiddenDim * c_numClasses), biasGradient(c_numClasses);
+    for (size_t t = 0; t < c_numFrames; t++)
+    {
+        // candidates: the true class, then the samples
+        vector<size_t> candidates{ c_labels[t] };
+        candidates.insert(candidates.end(), c_samples.begin(), c_samples.end());
+        vector<double> logits;
+        for (size_t k = 0; k < candidates.size(); k++)
+        {
+            size_t c = candidates[k];
+            double z = Bias(c) - log(Frequency(c));
+            for (size_t j = 0; j < c_hiddenDim; j++)
+                z += Weight(j, c) * Hidden(j, t);
+            if (k > 0 && c == c_labels[t])
+                z += LZERO;
+            logits.push_back(z);
+        }
+        double maxLogit = *max_element(logits.begin(), logits.end());
+        double sumExp = 0;
+        for (auto z : logits)
+            sumExp += exp(z - maxLogit);
+        double logSumExp = maxLogit + log(sumExp);
+        criterion += logSumExp - logits[0];
+
+        for (size_t k = 0; k < candidates.size(); k++)
+        {
+            size_t c = candidates[k];
+            double dz = exp(logits[k] - logSumExp) - (k == 0 ? 1 : 0);
+            for (size_t j = 0; j < c_hiddenDim; j++)
+            {
+                hiddenGradient[t * c_hiddenDim + j] += dz * Weight(j, c);
+                weightsGradient[c * c_hiddenDim + j] += dz * Hidden(j, t);
+            }
+            biasGradient[c] += dz;
+        }
+    }
+
+    vector<ElemType> result{ (ElemType) criterion };
+    result.insert(result.end(), hiddenGradient.begin(), hiddenGradient.end());
+    result.insert(result.end(), weightsGradient.begin(), weightsGradient.end());
+    result.insert(result.end(), biasGradient.begin(), biasGradient.end());
+    return result;
+}
+
+template <class ElemType>
+static vector<ElemType> ComputeSampledSoftmax(bool sparseLabels)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto labels = sparseLabels ? builder.CreateSparseInputNode(L"labels", c_numClasses) : builder.CreateInputNode(L"labels", c_numClasses);
+    auto features = builder.CreateInputNode(L"features", c_hiddenDim);
+    auto offset = builder.CreateLearnableParameter(L"offset", c_hiddenDim, 1); // (such that the hidden activation has a gradient)
+    auto hidden = builder.Plus(features, offset, L"hidden");
+    auto weights = builder.CreateLearnableParameter(L"W", c_hiddenDim, c_numClasses);
+    auto bias = builder.CreateLearnableParameter(L"b", c_numClasses, 1);
+    auto samples = builder.CreateLearnableParameter(L"samples", c_numClasses, c_samples.size());
+    auto frequencies = builder.CreateLearnableParameter(L"frequencies", c_numClasses, 1);
+    samples->SetLearningRateMultiplier(0);
+    frequencies->SetLearningRateMultiplier(0);
+    auto criterion = builder.SampledSoftmaxWithCrossEntropy(labels, hidden, weights, bias, samples, frequencies, L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    vector<ElemType> weightValues, biasValues, frequencyValues, hiddenValues;
+    for (size_t i = 0; i < c_numClasses; i++)
+    {
+        for (size_t j = 0; j < c_hiddenDim; j++)
+            weightValues.push_back((ElemType) Weight(j, i));
+        biasValues.push_back((ElemType) Bias(i));
+        frequencyValues.push_back((ElemType) Frequency(i));
+    }
+    for (size_t t = 0; t < c_numFrames; t++)
+        for (size_t j = 0; j < c_hiddenDim; j++)
+            hiddenValues.push_back((ElemType) Hidden(j, t));
+    vector<ElemType> sampleValues(c_numClasses * c_samples.size()), labelValues(c_numClasses * c_numFrames);
+    for (size_t k = 0; k < c_samples.size(); k++)
+        sampleValues[k * c_numClasses + c_samples[k]] = 1;
+    for (size_t t = 0; t < c_numFrames; t++)
+        labelValues[t * c_numClasses + c_labels[t]] = 1;
+
+    weights->Value().SetValue(c_hiddenDim, c_numClasses, c_deviceId, weightValues.data());
+    bias->Value().SetValue(c_numClasses, 1, c_deviceId, biasValues.data());
+    frequencies->Value().SetValue(c_numClasses, 1, c_deviceId, frequencyValues.data());
+    samples->Value().SetValue(c_numClasses, c_samples.size(), c_deviceId, sampleValues.data());
+    offset->Value().SetValue(0);
+    features->GetMBLayout()->InitAsFrameMode(c_numFrames);
+    features->Value().SetValue(c_hiddenDim, c_numFrames, c_deviceId, hiddenValues.data());
+    Matrix<ElemType> denseLabels(c_numClasses, c_numFrames, labelValues.data(), c_deviceId);
+    labels->Value().AssignValuesOf(denseLabels);
+    BOOST_REQUIRE_EQUAL(labels->Value().GetMatrixType() == SPARSE, sparseLabels);
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ labels, features });
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->ForwardProp(ComputationNodeBasePtr(criterion));
+    net->Backprop(criterion);
+
+    vector<ElemType> result{ (ElemType) criterion->Get00Element() };
+    for (const auto& node : { hidden, weights, bias })
+        result.insert(result.end(), node->Gradient().Data(), node->Gradient().Data() + node->Gradient().GetNumElements());
+    return result;
+}
+
+template <class ElemType>
+void SampledSoftmaxTestImpl()
+{
+    auto expected = ComputeReference<ElemType>();
+    for (bool sparseLabels : { false, true })
+    {
+        auto result = ComputeSampledSoftmax<ElemType>(sparseLabels);
+        BOOST_REQUIRE_EQUAL(result.size(), expected.size());
+        BOOST_CHECK(AreEqual(expected.data(), result.data(), expected.size(), 1e-4f));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(SampledSoftmaxTestSuite)
+
+BOOST_AUTO_TEST_CASE(SampledSoftmaxWithCrossEntropyTest)
+{
+    SampledSoftmaxTestImpl<float>();
+    SampledSoftmaxTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
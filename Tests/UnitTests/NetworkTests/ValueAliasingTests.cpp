@@ -0,0 +1,95 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+const size_t c_dim = 6;
+const size_t c_numSamples = 3;
+
+// Trains one minibatch of SquareError(labels, Reshape(Reshape(Tanh(W * Reshape(features))))) and returns the criterion
+// and the gradient of W. 'aliased' tells whether each of the reshapes uses the value matrix of its input.
+template <class ElemType>
+static vector<ElemType> ComputeGradients(vector<bool>& aliased)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    auto features = builder.CreateInputNode(L"features", c_dim);
+    auto labels = builder.CreateInputNode(L"labels", c_dim);
+    vector<ElemType> weights;
+    for (size_t i = 0; i < c_dim * c_dim; i++)
+        weights.push_back((ElemType) (0.1 * (i % 7) - 0.3));
+    auto w = builder.CreateLearnableParameter(L"W", c_dim, c_dim);
+    w->Value().SetValue(c_dim, c_dim, c_deviceId, weights.data());
+    auto x = builder.Reshape(features, TensorShape(c_dim), L"x");
+    auto h = builder.Tanh(builder.Times(w, x), L"h");
+    auto r1 = builder.Reshape(h, TensorShape(2, 3), L"r1");
+    auto r2 = builder.Reshape(r1, TensorShape(c_dim), L"r2");
+    auto criterion = builder.SquareError(labels, r2, L"criterion");
+    net->AddToNodeGroup(L"feature", features);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    vector<ElemType> featureValues, labelValues;
+    for (size_t i = 0; i < c_dim * c_numSamples; i++)
+    {
+        featureValues.push_back((ElemType) (0.5 - 0.1 * i));
+        labelValues.push_back((ElemType) (0.05 * i));
+    }
+    features->GetMBLayout()->InitAsFrameMode(c_numSamples);
+    features->Value().SetValue(c_dim, c_numSamples, c_deviceId, featureValues.data());
+    labels->Value().SetValue(c_dim, c_numSamples, c_deviceId, labelValues.data());
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->ForwardProp(ComputationNodeBasePtr(criterion));
+    net->Backprop(criterion);
+
+    aliased = { x->ValuePtr() == features->ValuePtr(), r1->ValuePtr() == h->ValuePtr(), r2->ValuePtr() == h->ValuePtr() };
+    vector<ElemType> result{ (ElemType) criterion->Get00Element() };
+    result.insert(result.end(), w->Gradient().Data(), w->Gradient().Data() + w->Gradient().GetNumElements());
+    return result;
+}
+
+template <class ElemType>
+void ValueAliasingTestImpl()
+{
+    vector<bool> aliased;
+    Globals::DisableValueAliasing();
+    auto expected = ComputeGradients<ElemType>(aliased);
+    Globals::EnableValueAliasing();
+    BOOST_CHECK(aliased == vector<bool>({ false, false, false }));
+
+    auto actual = ComputeGradients<ElemType>(aliased);
+    BOOST_CHECK(aliased == vector<bool>({ true, true, true }));
+    BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+    BOOST_CHECK(AreEqual(expected.data(), actual.data(), expected.size(), 1e-5f));
+}
+
+BOOST_AUTO_TEST_SUITE(ValueAliasingTestSuite)
+
+BOOST_AUTO_TEST_CASE(ValueAliasingTest)
+{
+    ValueAliasingTestImpl<float>();
+    ValueAliasingTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
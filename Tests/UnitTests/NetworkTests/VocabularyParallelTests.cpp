@@ -0,0 +1,101 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+const size_t c_vocabSize = 7;
+const size_t c_hiddenDim = 3;
+const vector<size_t> c_words{ 1, 4, 0, 4, 6 };
+const vector<size_t> c_labels{ 4, 0, 6, 2, 4 };
+
+// Trains one minibatch of a language model with a single shard, labels = softmax(W^T Tanh(E words)), and returns the
+// criterion and the gradients of E and W, with 'sharded' computed by ShardedEmbedding and ShardedSoftmaxWithCrossEntropy,
+// otherwise by Times and CrossEntropyWithSoftmax (with dense inputs, such that the gradient of E is dense).
+template <class ElemType>
+static vector<ElemType> TrainMinibatch(bool sharded, bool sparseInputs)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+    sparseInputs = sparseInputs && sharded;
+    auto words = sparseInputs ? builder.CreateSparseInputNode(L"words", c_vocabSize) : builder.CreateInputNode(L"words", c_vocabSize);
+    auto labels = sparseInputs ? builder.CreateSparseInputNode(L"labels", c_vocabSize) : builder.CreateInputNode(L"labels", c_vocabSize);
+    auto embeddings = builder.CreateLearnableParameter(L"E", c_hiddenDim, c_vocabSize);
+    auto weights = builder.CreateLearnableParameter(L"W", c_hiddenDim, c_vocabSize);
+    for (auto& w : { embeddings, weights })
+    {
+        vector<ElemType> values;
+        for (size_t i = 0; i < w->Value().GetNumElements(); i++)
+            values.push_back((ElemType) (0.1 * ((3 * i + (w == weights)) % 7) - 0.3));
+        w->Value().SetValue(c_hiddenDim, c_vocabSize, c_deviceId, values.data());
+    }
+    auto x = sharded ? builder.ShardedEmbedding(embeddings, words, L"x") : builder.Times(embeddings, words, 1, L"x");
+    auto h = builder.Tanh(x, L"h");
+    auto criterion = sharded ? builder.ShardedSoftmaxWithCrossEntropy(labels, h, weights, L"criterion")
+                             : builder.CrossEntropyWithSoftmax(labels, builder.TransposeTimes(weights, h, L"z"), L"criterion");
+    net->AddToNodeGroup(L"feature", words);
+    net->AddToNodeGroup(L"label", labels);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    if (sharded)
+        BOOST_CHECK_EQUAL(ComputationNetwork::ShardVocabularyParallelNodes<ElemType>(net, nullptr, 0, 1).size(), 2u);
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    vector<ElemType> wordValues(c_vocabSize * c_words.size()), labelValues(c_vocabSize * c_labels.size());
+    for (size_t t = 0; t < c_words.size(); t++)
+    {
+        wordValues[t * c_vocabSize + c_words[t]] = 1;
+        labelValues[t * c_vocabSize + c_labels[t]] = 1;
+    }
+    words->GetMBLayout()->InitAsFrameMode(c_words.size());
+    words->Value().AssignValuesOf(Matrix<ElemType>(c_vocabSize, c_words.size(), wordValues.data(), c_deviceId));
+    labels->Value().AssignValuesOf(Matrix<ElemType>(c_vocabSize, c_labels.size(), labelValues.data(), c_deviceId));
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ words, labels });
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->ForwardProp(ComputationNodeBasePtr(criterion));
+    net->Backprop(criterion);
+
+    vector<ElemType> result{ (ElemType) criterion->Get00Element() };
+    for (const auto& w : { embeddings, weights })
+        result.insert(result.end(), w->Gradient().Data(), w->Gradient().Data() + w->Gradient().GetNumElements());
+    return result;
+}
+
+template <class ElemType>
+void VocabularyParallelTestImpl()
+{
+    auto expected = TrainMinibatch<ElemType>(/*sharded=*/false, /*sparseInputs=*/false);
+    for (bool sparseInputs : { false, true })
+    {
+        auto actual = TrainMinibatch<ElemType>(/*sharded=*/true, sparseInputs);
+        BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+        BOOST_CHECK(AreEqual(expected.data(), actual.data(), expected.size(), 1e-5f));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(VocabularyParallelTestSuite)
+
+BOOST_AUTO_TEST_CASE(ShardedSoftmaxAndEmbedding)
+{
+    VocabularyParallelTestImpl<float>();
+    VocabularyParallelTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -16,6 +16,7 @@
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
 #include "TextParser.h"
+#include "TextToBinaryConverter.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -33,15 +34,30 @@ public:
     ChunkPtr m_chunk;
 
     CNTKTextFormatReaderTestRunner(const string& filename,
-        const vector<StreamDescriptor>& streams, unsigned int maxErrors) :
+        const vector<StreamDescriptor>& streams, unsigned int maxErrors, bool useMemoryMappedFile = false,
+        const wstring& indexCacheFile = wstring()) :
         m_parser(std::make_shared<CorpusDescriptor>(true), wstring(filename.begin(), filename.end()), streams, true)
     {
         m_parser.SetMaxAllowedErrors(maxErrors);
         m_parser.SetTraceLevel(TextParser<ElemType>::TraceLevel::Info);
         m_parser.SetChunkSize(SIZE_MAX);
         m_parser.SetNumRetries(0);
+        m_parser.SetUseMemoryMappedFile(useMemoryMappedFile);
+        m_parser.SetIndexCache(!indexCacheFile.empty(), indexCacheFile);
         m_parser.Initialize();
     }
+
+    ChunkDescriptions GetChunkDescriptions()
+    {
+        return m_parser.GetChunkDescriptions();
+    }
+
+    vector<SequenceDescription> GetSequencesForChunk(ChunkIdType chunkId)
+    {
+        vector<SequenceDescription> result;
+        m_parser.GetSequencesForChunk(chunkId, result);
+        return result;
+    }
     // Retrieves a chunk of data.
     void LoadChunk()
     {
@@ -82,6 +98,64 @@ struct CNTKTextFormatReaderFixture : ReaderFixture
         : ReaderFixture("/Data/CNTKTextFormatReader/")
     {
     }
+
+    // Loads a chunk of invalid inputs, comparing the produced warnings with the control file.
+    void CNTKTextFormatReaderInvalidInputsTest(bool useMemoryMappedFile)
+    {
+        vector<StreamDescriptor> streams(2);
+        streams[0].m_alias = "A";
+        streams[0].m_name = L"A";
+        streams[0].m_storageType = StorageType::dense;
+        streams[0].m_sampleDimension = 1;
+
+        streams[1].m_alias = "B";
+        streams[1].m_name = L"B";
+        streams[1].m_storageType = StorageType::sparse_csc;
+        streams[1].m_sampleDimension = 10;
+
+        CNTKTextFormatReaderTestRunner<float> testRunner("invalid_inputs.txt", streams, 99999, useMemoryMappedFile);
+
+        auto output = testDataPath() + "/Control/CNTKTextFormatReader/" +
+            (useMemoryMappedFile ? "invalid_inputs_memory_mapped_Output.txt" : "invalid_inputs_Output.txt");
+
+        boost::filesystem::remove(output);
+
+        FILE * redirected = fopen(output.c_str(), "w");
+        if (redirected == nullptr)
+        {
+            BOOST_FAIL("Cannot open output file.");
+        }
+
+        fflush(stderr);
+        // duplicate stderr
+        int stderrDup = _dup(2);
+        // redirect stderr to the output file
+        if (-1 == stderrDup || -1 == _dup2(_fileno(redirected), 2))
+        {
+            BOOST_FAIL("Cannot redirect stderr.");
+        }
+        else 
+        {
+            BOOST_SCOPE_EXIT(stderrDup, redirected)
+            {
+                fflush(stderr);
+                fclose(redirected);
+                // restore stderr
+                if (-1 == _dup2(stderrDup, 2))
+                {
+                    BOOST_FAIL("Cannot restore stderr.");
+                }
+                _close(stderrDup);
+
+            } BOOST_SCOPE_EXIT_END
+
+            testRunner.LoadChunk();
+        }
+
+        auto control = testDataPath() + "/Control/CNTKTextFormatReader/invalid_inputs_Control.txt";
+
+        CheckFilesEquivalent(control, output);
+    }
 };
 
 BOOST_FIXTURE_TEST_SUITE(ReaderTestSuite, CNTKTextFormatReaderFixture)
@@ -634,59 +708,296 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_ref_data_with_escape_sequences)
 // input contains a number of empty sparse samples
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_invalid_inputs)
 {
-    vector<StreamDescriptor> streams(2);
+    CNTKTextFormatReaderInvalidInputsTest(false);
+};
+
+// same input parsed directly from the memory mapped file must produce the same warnings and offsets
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_invalid_inputs_memory_mapped)
+{
+    CNTKTextFormatReaderInvalidInputsTest(true);
+};
+
+// the index saved to the cache file is reused as long as the input file does not change
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_index_cache)
+{
+    auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(directory);
+    BOOST_SCOPE_EXIT(directory)
+    {
+        boost::filesystem::remove_all(directory);
+    } BOOST_SCOPE_EXIT_END
+
+    auto writeInput = [](const string& filename, size_t numSequences)
+    {
+        ofstream input(filename);
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            for (size_t j = 0; j <= i % 3; ++j)
+            {
+                input << i << " |A " << j << "\n";
+            }
+        }
+    };
+
+    string inputFile = (directory / "input.txt").string();
+    wstring cacheFile = (directory / "input.index").wstring();
+    writeInput(inputFile, 10);
+
+    vector<StreamDescriptor> streams(1);
     streams[0].m_alias = "A";
     streams[0].m_name = L"A";
     streams[0].m_storageType = StorageType::dense;
     streams[0].m_sampleDimension = 1;
 
-    streams[1].m_alias = "B";
-    streams[1].m_name = L"B";
-    streams[1].m_storageType = StorageType::sparse_csc;
-    streams[1].m_sampleDimension = 10;
+    CNTKTextFormatReaderTestRunner<float> builder(inputFile, streams, 0, false, cacheFile);
+    BOOST_REQUIRE(boost::filesystem::exists(cacheFile));
+    BOOST_CHECK(!boost::filesystem::exists(cacheFile + L".lock"));
+    auto expected = builder.GetSequencesForChunk(0);
+    BOOST_REQUIRE_EQUAL(expected.size(), 10);
+
+    CNTKTextFormatReaderTestRunner<float> loader(inputFile, streams, 0, true, cacheFile);
+    BOOST_REQUIRE_EQUAL(loader.GetChunkDescriptions().size(), builder.GetChunkDescriptions().size());
+    auto actual = loader.GetSequencesForChunk(0);
+    BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(actual[i].m_id, expected[i].m_id);
+        BOOST_CHECK_EQUAL(actual[i].m_numberOfSamples, expected[i].m_numberOfSamples);
+        BOOST_CHECK_EQUAL(actual[i].m_key.m_sequence, expected[i].m_key.m_sequence);
+    }
 
-    CNTKTextFormatReaderTestRunner<float> testRunner("invalid_inputs.txt", streams, 99999);
+    // The data is read at the offsets from the cache.
+    loader.LoadChunk();
+    vector<SequenceDataPtr> sequence;
+    loader.m_chunk->GetSequence(5, sequence);
+    BOOST_REQUIRE_EQUAL(sequence.size(), 1);
+    BOOST_CHECK_EQUAL(sequence[0]->m_numberOfSamples, 3);
+    BOOST_CHECK_EQUAL(((const float*)sequence[0]->GetDataBuffer())[2], 2.0f);
+
+    // A modified input file invalidates the cache.
+    writeInput(inputFile, 12);
+    CNTKTextFormatReaderTestRunner<float> rebuilder(inputFile, streams, 0, false, cacheFile);
+    BOOST_CHECK_EQUAL(rebuilder.GetSequencesForChunk(0).size(), 12);
+};
 
-    auto output = testDataPath() + "/Control/CNTKTextFormatReader/invalid_inputs_Output.txt";
+template <class T>
+static void ReadBinaryValue(const char*& pos, T& value)
+{
+    memcpy(&value, pos, sizeof(value));
+    pos += sizeof(value);
+}
 
-    boost::filesystem::remove(output);
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_convert_to_binary)
+{
+    auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(directory);
+    BOOST_SCOPE_EXIT(directory)
+    {
+        boost::filesystem::remove_all(directory);
+    } BOOST_SCOPE_EXIT_END
 
-    FILE * redirected = fopen(output.c_str(), "w");
-    if (redirected == nullptr)
+    // 20 sequences, each with one dense sample and 1 to 3 sparse samples.
+    const size_t numSequences = 20;
+    string inputFile = (directory / "input.txt").string();
     {
-        BOOST_FAIL("Cannot open output file.");
+        ofstream input(inputFile);
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            input << i << " |A " << i << " " << -0.5 * i << " |B " << i % 5 << ":" << i << "\n";
+            for (size_t j = 0; j < i % 3; ++j)
+            {
+                input << i << " |B " << j << ":1\n";
+            }
+        }
     }
 
-    fflush(stderr);
-    // duplicate stderr
-    int stderrDup = _dup(2);
-    // redirect stderr to the output file
-    if (-1 == stderrDup || -1 == _dup2(_fileno(redirected), 2))
+    ConfigParameters config;
+    config.Insert("file", inputFile);
+    config.Insert("chunkSizeInBytes", "64");
+    config.Insert("input=[A=[dim=2;format=dense];B=[dim=5;format=sparse]]");
+
+    auto convert = [&](size_t numThreads)
     {
-        BOOST_FAIL("Cannot redirect stderr.");
+        auto outputFile = directory / ("output" + to_string(numThreads) + ".bin");
+        TextToBinaryConverter<float>(config, outputFile.wstring(), numThreads).Convert();
+        ifstream output(outputFile.string(), ios::binary);
+        return vector<char>((istreambuf_iterator<char>(output)), istreambuf_iterator<char>());
+    };
+
+    vector<char> expected = convert(1);
+    // Parallel conversion produces exactly the same output.
+    BOOST_CHECK(convert(3) == expected);
+    BOOST_CHECK(!boost::filesystem::exists(directory / "output3.bin.index"));
+
+    const char* pos = expected.data();
+    int64_t version, numChunks;
+    int32_t numInputs;
+    ReadBinaryValue(pos, version);
+    ReadBinaryValue(pos, numChunks);
+    ReadBinaryValue(pos, numInputs);
+    BOOST_CHECK_EQUAL(version, 1);
+    BOOST_CHECK(numChunks > 1);
+    BOOST_REQUIRE_EQUAL(numInputs, 2);
+
+    // A: name, dense, float, dimension 2; B: name, sparse, csc, float, sequence, dimension 5.
+    int32_t header[7];
+    ReadBinaryValue(pos, header[0]);
+    BOOST_REQUIRE_EQUAL(header[0], 1);
+    BOOST_CHECK_EQUAL(*pos++, 'A');
+    for (size_t i = 0; i < 3; ++i)
+        ReadBinaryValue(pos, header[i]);
+    BOOST_CHECK(vector<int32_t>(header, header + 3) == vector<int32_t>({ 0, 0, 2 }));
+    ReadBinaryValue(pos, header[0]);
+    BOOST_REQUIRE_EQUAL(header[0], 1);
+    BOOST_CHECK_EQUAL(*pos++, 'B');
+    for (size_t i = 0; i < 5; ++i)
+        ReadBinaryValue(pos, header[i]);
+    BOOST_CHECK(vector<int32_t>(header, header + 5) == vector<int32_t>({ 1, 0, 0, 1, 5 }));
+
+    size_t totalSequences = 0, totalSamples = 0;
+    int32_t firstChunkSequences = 0;
+    for (int64_t c = 0; c < numChunks; ++c)
+    {
+        int64_t offset;
+        int32_t chunkSequences, chunkSamples;
+        ReadBinaryValue(pos, offset);
+        ReadBinaryValue(pos, chunkSequences);
+        ReadBinaryValue(pos, chunkSamples);
+        BOOST_CHECK_EQUAL(offset == 0, c == 0);
+        if (c == 0)
+            firstChunkSequences = chunkSequences;
+        totalSequences += chunkSequences;
+        totalSamples += chunkSamples;
     }
-    else 
+    BOOST_CHECK_EQUAL(totalSequences, numSequences);
+    BOOST_CHECK_EQUAL(totalSamples, 39);
+    BOOST_REQUIRE(firstChunkSequences >= 2);
+
+    // The first chunk starts with the dense values of all its sequences, followed by the sparse input.
+    float dense[4];
+    for (size_t i = 0; i < 4; ++i)
+        ReadBinaryValue(pos, dense[i]);
+    BOOST_CHECK(vector<float>(dense, dense + 4) == vector<float>({ 0.0f, 0.0f, 1.0f, -0.5f }));
+
+    pos += (firstChunkSequences - 2) * 2 * sizeof(float);
+    int32_t nnz;
+    ReadBinaryValue(pos, nnz);
+    BOOST_REQUIRE(nnz >= 3);
+    pos += nnz * sizeof(float);
+    // Row indices of multi-sample sequences are offset by sample * dimension.
+    int32_t rows[3];
+    for (size_t i = 0; i < 3; ++i)
+        ReadBinaryValue(pos, rows[i]);
+    BOOST_CHECK(vector<int32_t>(rows, rows + 3) == vector<int32_t>({ 0, 1, 5 }));
+};
+
+#ifdef USE_ZIP
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_convert_to_binary_compressed)
+{
+    auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(directory);
+    BOOST_SCOPE_EXIT(directory)
     {
-        BOOST_SCOPE_EXIT(stderrDup, redirected)
-        {
-            fflush(stderr);
-            fclose(redirected);
-            // restore stderr
-            if (-1 == _dup2(stderrDup, 2))
-            {
-                BOOST_FAIL("Cannot restore stderr.");
-            }
-            _close(stderrDup);
+        boost::filesystem::remove_all(directory);
+    } BOOST_SCOPE_EXIT_END
 
-        } BOOST_SCOPE_EXIT_END
-        
-        testRunner.LoadChunk();
+    string inputFile = (directory / "input.txt").string();
+    {
+        ofstream input(inputFile);
+        for (size_t i = 0; i < 100; ++i)
+        {
+            input << i << " |A " << i % 2 << " 0 |B " << i % 5 << ":1\n";
+        }
     }
 
-    auto control = testDataPath() + "/Control/CNTKTextFormatReader/invalid_inputs_Control.txt";
+    ConfigParameters config;
+    config.Insert("file", inputFile);
+    config.Insert("chunkSizeInBytes", "512");
+    config.Insert("input=[A=[dim=2;format=dense];B=[dim=5;format=sparse]]");
+
+    auto convert = [&](ChunkCodec codec)
+    {
+        auto outputFile = directory / ("output" + to_string((int)codec) + ".bin");
+        TextToBinaryConverter<float>(config, outputFile.wstring(), 2, codec).Convert();
+        ifstream output(outputFile.string(), ios::binary);
+        return vector<char>((istreambuf_iterator<char>(output)), istreambuf_iterator<char>());
+    };
+
+    vector<char> uncompressed = convert(ChunkCodec::None);
+    vector<char> compressed = convert(ChunkCodec::Deflate);
+    BOOST_CHECK(compressed.size() < uncompressed.size());
+
+    // Skips the header up to the offsets table.
+    auto skipHeader = [](const char*& pos, int64_t& version, int64_t& numChunks)
+    {
+        int32_t numInputs, nameLength, type, value;
+        ReadBinaryValue(pos, version);
+        ReadBinaryValue(pos, numChunks);
+        ReadBinaryValue(pos, numInputs);
+        for (int32_t i = 0; i < numInputs; ++i)
+        {
+            ReadBinaryValue(pos, nameLength);
+            pos += nameLength;
+            ReadBinaryValue(pos, type);
+            for (int32_t j = 0; j < (type == 0 ? 2 : 4); ++j)
+                ReadBinaryValue(pos, value);
+        }
+    };
+
+    const char* plain = uncompressed.data();
+    const char* packed = compressed.data();
+    int64_t plainVersion, packedVersion, numChunks, numPackedChunks;
+    skipHeader(plain, plainVersion, numChunks);
+    skipHeader(packed, packedVersion, numPackedChunks);
+    BOOST_CHECK_EQUAL(plainVersion, 1);
+    BOOST_CHECK_EQUAL(packedVersion, 2);
+    BOOST_REQUIRE_EQUAL(numChunks, numPackedChunks);
+    BOOST_REQUIRE(numChunks > 1);
+
+    const char* plainData = plain + numChunks * (sizeof(int64_t) + 2 * sizeof(int32_t));
+    const char* packedData = packed + numChunks * (2 * sizeof(int64_t) + 3 * sizeof(int32_t));
+
+    // Every chunk decompresses into exactly the uncompressed chunk.
+    for (int64_t c = 0; c < numChunks; ++c)
+    {
+        int64_t plainOffset, packedOffset, uncompressedSize;
+        int32_t plainSequences, packedSequences, plainSamples, packedSamples;
+        ChunkCodec codec;
+        ReadBinaryValue(plain, plainOffset);
+        ReadBinaryValue(plain, plainSequences);
+        ReadBinaryValue(plain, plainSamples);
+        ReadBinaryValue(packed, packedOffset);
+        ReadBinaryValue(packed, packedSequences);
+        ReadBinaryValue(packed, packedSamples);
+        ReadBinaryValue(packed, codec);
+        ReadBinaryValue(packed, uncompressedSize);
+        BOOST_CHECK_EQUAL(plainSequences, packedSequences);
+        BOOST_CHECK_EQUAL(plainSamples, packedSamples);
+        BOOST_REQUIRE(codec == ChunkCodec::Deflate);
+
+        int64_t plainEnd = uncompressed.data() + uncompressed.size() - plainData;
+        if (c + 1 < numChunks)
+        {
+            int64_t nextOffset;
+            const char* next = plain;
+            ReadBinaryValue(next, nextOffset);
+            plainEnd = nextOffset;
+        }
+        BOOST_REQUIRE_EQUAL(uncompressedSize, plainEnd - plainOffset);
+
+        int64_t packedEnd = compressed.data() + compressed.size() - packedData;
+        if (c + 1 < numChunks)
+        {
+            const char* next = packed;
+            ReadBinaryValue(next, packedEnd);
+        }
 
-    CheckFilesEquivalent(control, output);
+        vector<char> chunk(uncompressedSize);
+        DecompressChunk(codec, packedData + packedOffset, packedEnd - packedOffset, chunk.data(), chunk.size());
+        BOOST_CHECK(equal(chunk.begin(), chunk.end(), plainData + plainOffset));
+    }
 };
+#endif
 
 // 100 sequences with N samples for each of 3 inputs, where N is chosen at random
 // from [1, 100] for each sequence
@@ -3,10 +3,16 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 #include "stdafx.h"
+#include <fstream>
+#include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
+#include "../../../Source/Readers/HTKDeserializers/MLFLabelStore.h"
+#include "../../../Source/Readers/HTKDeserializers/HTKDataDeserializer.h"
 
 using namespace Microsoft::MSR::CNTK;
 
+#pragma warning(disable: 4459) // declaration of 'boost_scope_exit_aux_args' hides global declaration
+
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
 
 // Fixture specific to the AN4 data
@@ -815,6 +821,185 @@ BOOST_AUTO_TEST_CASE(HTKIVectorBptt)
 
 BOOST_AUTO_TEST_SUITE_END()
 
+BOOST_AUTO_TEST_SUITE(HTKDeserializersTestSuite)
+
+BOOST_AUTO_TEST_CASE(MLFLabelStoreRunsAndCache)
+{
+    MLFLabelStore store;
+    store.AddFrames(5, 3);
+    store.AddFrames(7, 2);
+    store.AddFrames(7, 1); // continues the run
+    store.FinishUtterance("utt_a");
+    store.AddFrames(7, 4); // a new run, runs do not span utterances
+    store.AddFrames(3, 0);
+    store.AddFrames(2, 1);
+    store.FinishUtterance("utt_b");
+    BOOST_CHECK_THROW(store.FinishUtterance("utt_a"), std::runtime_error);
+
+    const std::vector<size_t> expected = { 5, 5, 5, 7, 7, 7, 7, 7, 7, 7, 2 };
+    auto check = [&](const MLFLabelStore& labels)
+    {
+        BOOST_REQUIRE_EQUAL(2u, labels.GetNumberOfUtterances());
+        BOOST_CHECK_EQUAL(11u, labels.GetTotalNumberOfFrames());
+        BOOST_CHECK_EQUAL(4u, labels.GetNumberOfRuns());
+        BOOST_CHECK_EQUAL(8u, labels.GetNumberOfClasses());
+        BOOST_CHECK_EQUAL("utt_a", labels.GetKey(0));
+        BOOST_CHECK_EQUAL("utt_b", labels.GetKey(1));
+        BOOST_CHECK_EQUAL(6u, labels.GetFirstFrame(1));
+        BOOST_CHECK_EQUAL(5u, labels.GetNumberOfFrames(1));
+
+        for (size_t frame = 0; frame < expected.size(); ++frame)
+            BOOST_CHECK_EQUAL(expected[frame], labels.GetClassId(frame));
+
+        std::vector<unsigned short> ids(5);
+        labels.GetClassIds(1, ids.data());
+        for (size_t t = 0; t < ids.size(); ++t)
+            BOOST_CHECK_EQUAL(expected[6 + t], ids[t]);
+    };
+    check(store);
+
+    const std::wstring cacheFile = L"MLFLabelStore.tmp";
+    store.Save(cacheFile, 42);
+    {
+        MLFLabelStore loaded;
+        BOOST_REQUIRE(loaded.TryLoad(cacheFile, 42));
+        check(loaded);
+        BOOST_CHECK_THROW(loaded.AddFrames(1, 1), std::logic_error);
+
+        // Another process saves the same cache while this one uses it.
+        store.Save(cacheFile, 42);
+        check(loaded);
+    }
+
+    // A cache built from a different source is not used.
+    MLFLabelStore other;
+    BOOST_CHECK(!other.TryLoad(cacheFile, 43));
+    BOOST_CHECK_EQUAL(0u, other.GetNumberOfUtterances());
+    BOOST_CHECK(!other.TryLoad(L"MLFLabelStoreMissing.tmp", 42));
+
+    // Neither is a file that is not a cache.
+    FILE* f = fopen("MLFLabelStore.tmp", "wb");
+    fwrite("not a label cache, but long enough for a header", sizeof(char), 47, f);
+    fclose(f);
+    BOOST_CHECK(!other.TryLoad(cacheFile, 42));
+    remove("MLFLabelStore.tmp");
+}
+
+// The stacked features of all samples of an HTK deserializer by (utterance id, frame).
+static std::map<std::pair<size_t, size_t>, std::vector<float>> ReadAllFrames(HTKDataDeserializer& deserializer)
+{
+    size_t sampleSize = deserializer.GetStreamDescriptions()[0]->m_sampleLayout->GetNumElements();
+    std::map<std::pair<size_t, size_t>, std::vector<float>> result;
+    for (const auto& c : deserializer.GetChunkDescriptions())
+    {
+        auto chunk = deserializer.GetChunk(c->m_id);
+        std::vector<SequenceDescription> sequences;
+        deserializer.GetSequencesForChunk(c->m_id, sequences);
+        for (const auto& s : sequences)
+        {
+            std::vector<SequenceDataPtr> data;
+            chunk->GetSequence(s.m_id, data);
+            BOOST_REQUIRE_EQUAL(1u, data.size());
+            BOOST_REQUIRE_EQUAL(s.m_numberOfSamples, data[0]->m_numberOfSamples);
+            const float* samples = static_cast<const float*>(data[0]->GetDataBuffer());
+            for (size_t t = 0; t < s.m_numberOfSamples; ++t)
+                result[std::make_pair(s.m_key.m_sequence, s.m_key.m_sample + t)].assign(samples + t * sampleSize, samples + (t + 1) * sampleSize);
+        }
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(HTKDataDeserializerCompressedChunks)
+{
+    auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(directory);
+    BOOST_SCOPE_EXIT(directory)
+    {
+        boost::filesystem::remove_all(directory);
+    } BOOST_SCOPE_EXIT_END
+
+    // Two utterances of 7 and 4 frames with 3 dimensions, of which the last one is constant.
+    const size_t dimension = 3;
+    const std::vector<size_t> numberOfFrames = { 7, 4 };
+    const std::vector<std::string> keys = { "uttA", "uttB" };
+    std::vector<msra::dbn::matrix> utterances(numberOfFrames.size());
+    std::string scpFile = (directory / "features.scp").string();
+    {
+        std::ofstream scp(scpFile);
+        for (size_t u = 0; u < utterances.size(); ++u)
+        {
+            utterances[u].resize(dimension, numberOfFrames[u]);
+            for (size_t t = 0; t < numberOfFrames[u]; ++t)
+            {
+                utterances[u](0, t) = 50 * std::sin(0.7f * t + u);
+                utterances[u](1, t) = 0.1f * t * t - 3 + u;
+                utterances[u](2, t) = 2.5f;
+            }
+            std::string path = (directory / (keys[u] + ".htk")).string();
+            msra::asr::htkfeatwriter::write(msra::strfun::utf16(path), "USER", 100000, utterances[u]);
+            scp << keys[u] << "=" << path << "[0," << numberOfFrames[u] - 1 << "]\n";
+        }
+    }
+
+    auto corpus = std::make_shared<CorpusDescriptor>(false);
+    auto create = [&](bool frameMode, bool compressChunks)
+    {
+        ConfigParameters config;
+        config.Insert("scpFile", scpFile);
+        config.Insert("dim", "3");
+        config.Insert("contextWindow", "3");
+        config.Insert("frameMode", frameMode ? "true" : "false");
+        config.Insert("compressChunks", compressChunks ? "true" : "false");
+        return std::make_shared<HTKDataDeserializer>(corpus, config, L"features", true);
+    };
+
+    for (bool frameMode : { true, false })
+    {
+        auto uncompressed = ReadAllFrames(*create(frameMode, false));
+        auto compressed = ReadAllFrames(*create(frameMode, true));
+        BOOST_REQUIRE_EQUAL(11u, uncompressed.size());
+        BOOST_REQUIRE_EQUAL(11u, compressed.size());
+
+        for (size_t u = 0; u < utterances.size(); ++u)
+        {
+            // Compression rounds to 65535 levels between the minimum and the maximum of a dimension of the utterance.
+            std::vector<float> maxErrors(dimension);
+            for (size_t i = 0; i < dimension; ++i)
+            {
+                float minValue = utterances[u](i, 0), maxValue = utterances[u](i, 0);
+                for (size_t t = 1; t < numberOfFrames[u]; ++t)
+                {
+                    minValue = std::min(minValue, utterances[u](i, t));
+                    maxValue = std::max(maxValue, utterances[u](i, t));
+                }
+                maxErrors[i] = 0.51f * (maxValue - minValue) / 65534 + 1e-6f * std::max(std::fabs(minValue), std::fabs(maxValue));
+            }
+
+            size_t id = corpus->KeyToId(keys[u]);
+            for (size_t t = 0; t < numberOfFrames[u]; ++t)
+            {
+                const auto& expected = uncompressed[std::make_pair(id, t)];
+                const auto& actual = compressed[std::make_pair(id, t)];
+                BOOST_REQUIRE_EQUAL(3 * dimension, expected.size());
+                BOOST_REQUIRE_EQUAL(3 * dimension, actual.size());
+
+                // The previous, the current and the next frame, repeated at the utterance boundaries.
+                for (size_t n = 0; n < 3; ++n)
+                {
+                    size_t frame = std::min(t + n == 0 ? 0 : t + n - 1, numberOfFrames[u] - 1);
+                    for (size_t i = 0; i < dimension; ++i)
+                    {
+                        BOOST_CHECK_EQUAL(utterances[u](i, frame), expected[n * dimension + i]);
+                        BOOST_CHECK_SMALL(actual[n * dimension + i] - expected[n * dimension + i], maxErrors[i]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
 }
 
 }}}
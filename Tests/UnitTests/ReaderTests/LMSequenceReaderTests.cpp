@@ -0,0 +1,169 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include <fstream>
+#include <boost/scope_exit.hpp>
+#include "Common/ReaderTestHelper.h"
+#include "../../../Source/Readers/LMSequenceReader/TextDeserializer.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+#pragma warning(disable: 4459) // declaration of 'boost_scope_exit_aux_args' hides global declaration
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace Test {
+
+BOOST_AUTO_TEST_SUITE(LMSequenceReaderTestSuite)
+
+// Sentences of a deserializer as (key, word ids of each stream), class-mode streams as their 4-row columns.
+static vector<pair<size_t, vector<vector<size_t>>>> ReadAllSentences(TextDeserializer& deserializer)
+{
+    vector<pair<size_t, vector<vector<size_t>>>> result;
+    auto streams = deserializer.GetStreamDescriptions();
+    for (const auto& c : deserializer.GetChunkDescriptions())
+    {
+        auto chunk = deserializer.GetChunk(c->m_id);
+        vector<SequenceDescription> sequences;
+        deserializer.GetSequencesForChunk(c->m_id, sequences);
+        for (const auto& s : sequences)
+        {
+            BOOST_CHECK_EQUAL(c->m_id, s.m_chunkId);
+            vector<SequenceDataPtr> data;
+            chunk->GetSequence(s.m_id, data);
+            BOOST_REQUIRE_EQUAL(streams.size(), data.size());
+
+            vector<vector<size_t>> values(streams.size());
+            for (size_t i = 0; i < streams.size(); ++i)
+            {
+                BOOST_REQUIRE_EQUAL(s.m_numberOfSamples, data[i]->m_numberOfSamples);
+                if (streams[i]->m_storageType == StorageType::sparse_csc)
+                {
+                    auto sparse = static_pointer_cast<SparseSequenceData>(data[i]);
+                    BOOST_CHECK_EQUAL(s.m_numberOfSamples, sparse->m_totalNnzCount);
+                    const float* ones = static_cast<const float*>(sparse->GetDataBuffer());
+                    for (size_t t = 0; t < s.m_numberOfSamples; ++t)
+                    {
+                        BOOST_CHECK_EQUAL(1u, sparse->m_nnzCounts[t]);
+                        BOOST_CHECK_EQUAL(1.0f, ones[t]);
+                        values[i].push_back(sparse->m_indices[t]);
+                    }
+                }
+                else
+                {
+                    const float* dense = static_cast<const float*>(data[i]->GetDataBuffer());
+                    for (size_t j = 0; j < 4 * s.m_numberOfSamples; ++j)
+                        values[i].push_back((size_t)dense[j]);
+                }
+            }
+            result.push_back(make_pair(s.m_key.m_sequence, values));
+        }
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(TextDeserializerChunksAndLabels)
+{
+    auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(directory);
+    BOOST_SCOPE_EXIT(directory)
+    {
+        boost::filesystem::remove_all(directory);
+    } BOOST_SCOPE_EXIT_END
+
+    // Line 2 is empty, 'zebra' is not in the vocabulary.
+    string textFile = (directory / "text.txt").string();
+    {
+        ofstream text(textFile);
+        text << "the cat sat\n"
+             << "a dog ran </s>\n"
+             << "\n"
+             << "</S> the zebra sat";
+    }
+
+    // Classes 0, 1 and 2 are the word ids [0, 2), [2, 5) and [5, 8).
+    string wordClassFile = (directory / "vocab.txt").string();
+    {
+        ofstream vocabulary(wordClassFile);
+        vocabulary << "0 10 </s> 0\n1 1 <unk> 0\n2 5 the 1\n3 2 cat 1\n4 2 a 1\n5 2 dog 2\n6 2 sat 2\n7 1 ran 2\n";
+    }
+
+    auto create = [&](const string& chunkSizeInBytes, const string& labelMode)
+    {
+        ConfigParameters config;
+        config.Insert("file", textFile);
+        config.Insert("wordclass", wordClassFile);
+        config.Insert("unk", "<unk>");
+        config.Insert("beginSequence", "</s>");
+        config.Insert("endSequence", "</s>");
+        config.Insert("chunkSizeInBytes", chunkSizeInBytes);
+        config.Insert("input=[features=[labelType=input];labels=[labelType=nextWord;mode=" + labelMode + "]]");
+        return make_shared<TextDeserializer>(make_shared<CorpusDescriptor>(true), config, true);
+    };
+
+    // The boundaries are added where missing, and the next words are the input words shifted by one.
+    const vector<size_t> keys = { 0, 1, 3 };
+    const vector<vector<size_t>> words = { { 0, 2, 3, 6 }, { 0, 4, 5, 7 }, { 0, 2, 1, 6 } };
+    const vector<vector<size_t>> nextWords = { { 2, 3, 6, 0 }, { 4, 5, 7, 0 }, { 2, 1, 6, 0 } };
+    const vector<size_t> classColumns[] = { { 0, 0, 0, 2 }, { 1, 0, 0, 2 }, { 2, 1, 2, 5 }, { 3, 1, 2, 5 }, { 4, 1, 2, 5 }, { 5, 2, 5, 8 }, { 6, 2, 5, 8 }, { 7, 2, 5, 8 } };
+
+    auto softmax = create("1000", "softmax");
+    auto streams = softmax->GetStreamDescriptions();
+    BOOST_REQUIRE_EQUAL(2u, streams.size());
+    BOOST_CHECK(streams[1]->m_storageType == StorageType::sparse_csc);
+    BOOST_CHECK_EQUAL(8u, streams[1]->m_sampleLayout->GetNumElements());
+    auto softmaxSentences = ReadAllSentences(*softmax);
+    auto sentences = softmaxSentences;
+    BOOST_REQUIRE_EQUAL(3u, sentences.size());
+    for (size_t i = 0; i < sentences.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(keys[i], sentences[i].first);
+        BOOST_CHECK(sentences[i].second[0] == words[i]);
+        BOOST_CHECK(sentences[i].second[1] == nextWords[i]);
+    }
+
+    auto classes = create("1000", "class");
+    streams = classes->GetStreamDescriptions();
+    BOOST_CHECK(streams[1]->m_storageType == StorageType::dense);
+    BOOST_CHECK_EQUAL(4u, streams[1]->m_sampleLayout->GetNumElements());
+    sentences = ReadAllSentences(*classes);
+    BOOST_REQUIRE_EQUAL(3u, sentences.size());
+    for (size_t i = 0; i < sentences.size(); ++i)
+    {
+        BOOST_CHECK(sentences[i].second[0] == words[i]);
+        vector<size_t> expected;
+        for (size_t id : nextWords[i])
+            expected.insert(expected.end(), classColumns[id].begin(), classColumns[id].end());
+        BOOST_CHECK(sentences[i].second[1] == expected);
+    }
+
+    // A chunk is closed once it reaches chunkSizeInBytes: the first two sentences (26 bytes) exceed 20 bytes.
+    // The chunking does not change the sentences.
+    auto checkChunks = [&](const string& chunkSizeInBytes, const vector<size_t>& expectedSamples)
+    {
+        auto deserializer = create(chunkSizeInBytes, "softmax");
+        auto chunks = deserializer->GetChunkDescriptions();
+        BOOST_REQUIRE_EQUAL(expectedSamples.size(), chunks.size());
+        for (size_t i = 0; i < chunks.size(); ++i)
+            BOOST_CHECK_EQUAL(expectedSamples[i], chunks[i]->m_numberOfSamples);
+        BOOST_CHECK(ReadAllSentences(*deserializer) == softmaxSentences);
+    };
+    checkChunks("1000", { 12 });
+    checkChunks("20", { 8, 4 });
+    checkChunks("1", { 4, 4, 4 });
+
+    // Sentences can be looked up by their line number, the empty line is not a sentence.
+    SequenceDescription description;
+    BOOST_CHECK(classes->GetSequenceDescription(SequenceDescription{ 0, 0, 0, KeyType{ 3, 0 } }, description));
+    BOOST_CHECK_EQUAL(2u, description.m_id);
+    BOOST_CHECK_EQUAL(4u, description.m_numberOfSamples);
+    BOOST_CHECK(!classes->GetSequenceDescription(SequenceDescription{ 0, 0, 0, KeyType{ 2, 0 } }, description));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+
+}}}
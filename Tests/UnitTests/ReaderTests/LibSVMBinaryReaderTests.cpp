@@ -0,0 +1,257 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include <fstream>
+#include <boost/scope_exit.hpp>
+#include "Common/ReaderTestHelper.h"
+#include "../../../Source/Readers/LibSVMBinaryReader/SparseBinaryDeserializer.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+#pragma warning(disable: 4459) // declaration of 'boost_scope_exit_aux_args' hides global declaration
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace Test {
+
+BOOST_AUTO_TEST_SUITE(LibSVMBinaryReaderTestSuite)
+
+template <class T>
+static void WriteBinary(vector<char>& buffer, const vector<T>& values)
+{
+    const char* p = reinterpret_cast<const char*>(values.data());
+    buffer.insert(buffer.end(), p, p + values.size() * sizeof(T));
+}
+
+static void WriteFile(const string& path, const vector<char>& buffer)
+{
+    ofstream file(path, ios::binary);
+    file.write(buffer.data(), buffer.size());
+}
+
+// A sparse sample as (row index, value) pairs.
+typedef vector<pair<int32_t, float>> SparseSample;
+
+// The samples of the sparse and of the dense stream of each sequence of a deserializer.
+struct SparseBinarySequence
+{
+    size_t m_key;
+    ChunkIdType m_chunkId;
+    vector<SparseSample> m_sparse;
+    vector<float> m_dense;
+};
+
+static vector<SparseBinarySequence> ReadAllSequences(SparseBinaryDeserializer& deserializer)
+{
+    vector<SparseBinarySequence> result;
+    for (const auto& c : deserializer.GetChunkDescriptions())
+    {
+        auto chunk = deserializer.GetChunk(c->m_id);
+        vector<SequenceDescription> sequences;
+        deserializer.GetSequencesForChunk(c->m_id, sequences);
+        BOOST_CHECK_EQUAL(c->m_numberOfSequences, sequences.size());
+        for (const auto& s : sequences)
+        {
+            vector<SequenceDataPtr> data;
+            chunk->GetSequence(s.m_id, data);
+            BOOST_REQUIRE_EQUAL(2u, data.size());
+            BOOST_REQUIRE_EQUAL(s.m_numberOfSamples, data[0]->m_numberOfSamples);
+            BOOST_REQUIRE_EQUAL(s.m_numberOfSamples, data[1]->m_numberOfSamples);
+
+            SparseBinarySequence sequence{ s.m_key.m_sequence, s.m_chunkId };
+            auto sparse = static_pointer_cast<SparseSequenceData>(data[0]);
+            const float* values = static_cast<const float*>(sparse->GetDataBuffer());
+            size_t offset = 0;
+            for (size_t t = 0; t < s.m_numberOfSamples; ++t)
+            {
+                SparseSample sample;
+                for (size_t i = offset; i < offset + sparse->m_nnzCounts[t]; ++i)
+                    sample.push_back(make_pair(sparse->m_indices[i], values[i]));
+                offset += sparse->m_nnzCounts[t];
+                sequence.m_sparse.push_back(sample);
+            }
+            BOOST_CHECK_EQUAL(offset, sparse->m_totalNnzCount);
+
+            size_t denseSize = deserializer.GetStreamDescriptions()[1]->m_sampleLayout->GetNumElements() * s.m_numberOfSamples;
+            const float* dense = static_cast<const float*>(data[1]->GetDataBuffer());
+            sequence.m_dense.assign(dense, dense + denseSize);
+            result.push_back(sequence);
+        }
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(SparseBinaryDeserializerLibSvmBinary)
+{
+    auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(directory);
+    BOOST_SCOPE_EXIT(directory)
+    {
+        boost::filesystem::remove_all(directory);
+    } BOOST_SCOPE_EXIT_END
+
+    // Blocks of 2, 0 and 3 samples with a sparse input of dimension 10 and a dense input of dimension 2.
+    const vector<vector<SparseSample>> features = { { { { 1, 1.0f }, { 4, 2.0f } }, {} }, {}, { { { 9, 3.0f } }, { { 0, 4.0f }, { 2, 5.0f }, { 3, 6.0f } }, { { 5, 7.0f } } } };
+    const vector<vector<float>> labels = { { 1, 0, 0, 1 }, {}, { 1, 0, 1, 0, 0, 1 } };
+
+    vector<char> blocks;
+    vector<int64_t> blockOffsets;
+    for (size_t b = 0; b < features.size(); ++b)
+    {
+        blockOffsets.push_back(blocks.size());
+        vector<float> values;
+        vector<int32_t> rowIndices, columnOffsets = { 0 };
+        for (const auto& sample : features[b])
+        {
+            for (const auto& entry : sample)
+            {
+                rowIndices.push_back(entry.first);
+                values.push_back(entry.second);
+            }
+            columnOffsets.push_back((int32_t)values.size());
+        }
+        WriteBinary(blocks, vector<int32_t>{ (int32_t)features[b].size(), (int32_t)values.size() });
+        WriteBinary(blocks, values);
+        WriteBinary(blocks, rowIndices);
+        WriteBinary(blocks, columnOffsets);
+        WriteBinary(blocks, labels[b]);
+    }
+
+    vector<char> file;
+    WriteBinary(file, vector<int64_t>{ 5, (int64_t)blockOffsets.size() });
+    WriteBinary(file, vector<int32_t>{ 1, 1, 1 });
+    file.push_back('f');
+    WriteBinary(file, vector<int32_t>{ 10, 1 });
+    file.push_back('l');
+    WriteBinary(file, vector<int32_t>{ 2 });
+    WriteBinary(file, blockOffsets);
+    file.insert(file.end(), blocks.begin(), blocks.end());
+    string fileName = (directory / "data.bin").string();
+    WriteFile(fileName, file);
+
+    auto create = [&](const string& chunkSizeInBytes)
+    {
+        ConfigParameters config;
+        config.Insert("file", fileName);
+        config.Insert("chunkSizeInBytes", chunkSizeInBytes);
+        config.Insert("f=[rename=features]");
+        return make_shared<SparseBinaryDeserializer>(SparseBinaryFormat::libSvmBinary, config, true);
+    };
+
+    auto deserializer = create("1000");
+    auto streams = deserializer->GetStreamDescriptions();
+    BOOST_REQUIRE_EQUAL(2u, streams.size());
+    BOOST_CHECK(streams[0]->m_name == L"features");
+    BOOST_CHECK(streams[0]->m_storageType == StorageType::sparse_csc);
+    BOOST_CHECK_EQUAL(10u, streams[0]->m_sampleLayout->GetNumElements());
+    BOOST_CHECK(streams[1]->m_name == L"l");
+    BOOST_CHECK(streams[1]->m_storageType == StorageType::dense);
+    BOOST_CHECK_EQUAL(2u, streams[1]->m_sampleLayout->GetNumElements());
+
+    // Every sample is a sequence, the columns of the CSC blocks are the samples.
+    auto expected = ReadAllSequences(*deserializer);
+    BOOST_REQUIRE_EQUAL(5u, expected.size());
+    size_t key = 0;
+    for (size_t b = 0; b < features.size(); ++b)
+    {
+        for (size_t j = 0; j < features[b].size(); ++j, ++key)
+        {
+            BOOST_CHECK_EQUAL(key, expected[key].m_key);
+            BOOST_REQUIRE_EQUAL(1u, expected[key].m_sparse.size());
+            BOOST_CHECK(expected[key].m_sparse[0] == features[b][j]);
+            BOOST_CHECK(expected[key].m_dense == vector<float>(labels[b].begin() + 2 * j, labels[b].begin() + 2 * j + 2));
+        }
+    }
+
+    // Chunks are whole blocks, the empty block is skipped.
+    auto chunked = create("1");
+    auto chunks = chunked->GetChunkDescriptions();
+    BOOST_REQUIRE_EQUAL(2u, chunks.size());
+    BOOST_CHECK_EQUAL(2u, chunks[0]->m_numberOfSamples);
+    BOOST_CHECK_EQUAL(3u, chunks[1]->m_numberOfSamples);
+    auto sequences = ReadAllSequences(*chunked);
+    BOOST_REQUIRE_EQUAL(expected.size(), sequences.size());
+    for (size_t i = 0; i < sequences.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(i < 2 ? 0u : 1u, sequences[i].m_chunkId);
+        BOOST_CHECK(sequences[i].m_sparse == expected[i].m_sparse);
+        BOOST_CHECK(sequences[i].m_dense == expected[i].m_dense);
+    }
+
+    SequenceDescription description;
+    BOOST_CHECK(chunked->GetSequenceDescription(SequenceDescription{ 0, 0, 0, KeyType{ 3, 0 } }, description));
+    BOOST_CHECK_EQUAL(1u, description.m_chunkId);
+    BOOST_CHECK(!chunked->GetSequenceDescription(SequenceDescription{ 0, 0, 0, KeyType{ 5, 0 } }, description));
+}
+
+BOOST_AUTO_TEST_CASE(SparseBinaryDeserializerSparsePC)
+{
+    auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(directory);
+    BOOST_SCOPE_EXIT(directory)
+    {
+        boost::filesystem::remove_all(directory);
+    } BOOST_SCOPE_EXIT_END
+
+    // 7 records of a sparse input of dimension 10 and a label, each followed by the verification code.
+    const int32_t verificationCode = 12345;
+    const vector<SparseSample> features = { { { 1, 1.0f } }, { { 2, 2.0f }, { 7, 3.0f } }, {}, { { 0, 4.0f } }, { { 9, 5.0f }, { 8, 6.0f } }, { { 3, 7.0f } }, { { 4, 8.0f } } };
+    vector<char> file;
+    for (size_t i = 0; i < features.size(); ++i)
+    {
+        vector<float> values;
+        vector<int32_t> rowIndices;
+        for (const auto& entry : features[i])
+        {
+            rowIndices.push_back(entry.first);
+            values.push_back(entry.second);
+        }
+        WriteBinary(file, vector<int32_t>{ (int32_t)values.size() });
+        WriteBinary(file, values);
+        WriteBinary(file, rowIndices);
+        WriteBinary(file, vector<float>{ (float)i });
+        WriteBinary(file, vector<int32_t>{ verificationCode });
+    }
+    string fileName = (directory / "data.bin").string();
+    WriteFile(fileName, file);
+
+    auto create = [&](const string& chunkSizeInBytes, int32_t code)
+    {
+        ConfigParameters config;
+        config.Insert("file", fileName);
+        config.Insert("chunkSizeInBytes", chunkSizeInBytes);
+        config.Insert("microbatchSize", "3");
+        config.Insert("verificationCode", to_string(code));
+        config.Insert("features=[dim=10]");
+        config.Insert("labels=[labelDim=1]");
+        return make_shared<SparseBinaryDeserializer>(SparseBinaryFormat::sparsePC, config, true);
+    };
+
+    // Every 'microbatchSize' records are a sequence, the incomplete last one is dropped.
+    for (const string& chunkSizeInBytes : vector<string>{ "1000", "1" })
+    {
+        auto deserializer = create(chunkSizeInBytes, verificationCode);
+        auto chunks = deserializer->GetChunkDescriptions();
+        BOOST_REQUIRE_EQUAL(chunkSizeInBytes == "1" ? 2u : 1u, chunks.size());
+        BOOST_CHECK_EQUAL(6u, chunks[0]->m_numberOfSamples + (chunks.size() > 1 ? chunks[1]->m_numberOfSamples : 0));
+
+        auto sequences = ReadAllSequences(*deserializer);
+        BOOST_REQUIRE_EQUAL(2u, sequences.size());
+        for (size_t i = 0; i < sequences.size(); ++i)
+        {
+            BOOST_CHECK_EQUAL(i, sequences[i].m_key);
+            BOOST_CHECK(sequences[i].m_sparse == vector<SparseSample>(features.begin() + 3 * i, features.begin() + 3 * i + 3));
+            BOOST_CHECK(sequences[i].m_dense == (vector<float>{ 3.0f * i, 3.0f * i + 1, 3.0f * i + 2 }));
+        }
+    }
+
+    BOOST_CHECK_THROW(create("1000", verificationCode + 1), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+
+}}}
@@ -3,13 +3,30 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 #include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <numeric>
 #include <random>
+#include <set>
+#include <thread>
 
 #include "NoRandomizer.h"
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
 #include "CorpusDescriptor.h"
+#include "ReaderThreadPool.h"
+#include "DecodedDataCache.h"
+#include "AsyncFileReader.h"
+#include "DataSource.h"
+#include "SequencePacker.h"
+#include "TruncatedBpttPacker.h"
+#include "HeapMemoryProvider.h"
+#include "Bundler.h"
+#include "ChunkCache.h"
+#include "FileLock.h"
+#include "SharedMinibatchChannel.h"
+#include "fileutil.h"
 
 #pragma warning(push)
 // disable warning about possible mod 0 operation in uniform_int_distribution
@@ -73,13 +90,19 @@ private:
     TensorShapePtr m_sampleLayout;
     vector<ChunkDescriptionPtr> m_chunkDescriptions;
     vector<vector<float>> m_sequenceData;
+    bool m_supportsConcurrentChunkLoads;
+    atomic<size_t> m_numChunkReads;
+    atomic<size_t> m_numSequenceReads;
 
 public:
     MockDeserializer(size_t numChunks, size_t numSequencesPerChunks, vector<float>& data, uint32_t sequenceLength = 1)
-        : m_numChunks(numChunks),
+        : m_sequenceLength(sequenceLength),
+          m_numChunks(numChunks),
           m_numSequencesPerChunk(numSequencesPerChunks),
           m_sampleLayout(make_shared<TensorShape>(1)),
-          m_sequenceLength(sequenceLength)
+          m_supportsConcurrentChunkLoads(false),
+          m_numChunkReads(0),
+          m_numSequenceReads(0)
     {
         m_sequenceData.reserve(data.size());
         for (float d : data)
@@ -129,6 +152,7 @@ public:
     virtual ChunkPtr GetChunk(ChunkIdType chunkId) override
     {
         assert(chunkId < m_numChunks);
+        m_numChunkReads++;
         size_t chunkBegin = chunkId * m_numSequencesPerChunk;
         size_t chunkEnd = chunkBegin + m_numSequencesPerChunk;
         shared_ptr<Chunk> chunk = make_shared<MockChunk>(chunkBegin, chunkEnd, m_sequenceData, m_sequenceLength);
@@ -140,13 +164,35 @@ public:
         throw logic_error("Not implemented");
     }
 
+    virtual bool SupportsConcurrentChunkLoads() const override
+    {
+        return m_supportsConcurrentChunkLoads;
+    }
+
+    void SetSupportsConcurrentChunkLoads(bool value)
+    {
+        m_supportsConcurrentChunkLoads = value;
+    }
+
     virtual ChunkDescriptions GetChunkDescriptions() override
     {
         return m_chunkDescriptions;
     }
 
+    // Number of GetChunk and GetSequencesForChunk calls so far.
+    size_t GetNumChunkReads() const
+    {
+        return m_numChunkReads;
+    }
+
+    size_t GetNumSequenceReads() const
+    {
+        return m_numSequenceReads;
+    }
+
     virtual void GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& descriptions) override
     {
+        m_numSequenceReads++;
         for (size_t i = chunkId * m_numSequencesPerChunk; i < (chunkId + 1) * m_numSequencesPerChunk; i++)
         {
             descriptions.push_back(SequenceDescription{
@@ -279,6 +325,126 @@ BOOST_AUTO_TEST_CASE(CheckSetCurrentCursorForRandomizers)
     test(expectedNo, unterTestNo, epochSize);
 }
 
+BOOST_AUTO_TEST_CASE(BlockRandomizerRestoreState)
+{
+    size_t chunkSizeInSamples = 10000;
+    size_t sweepNumberOfSamples = 500000;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 5;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    auto test = [&](size_t epochSize)
+    {
+        auto expected = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false);
+        auto underTest = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false);
+
+        // The state at the end of each epoch restores the randomizer of a fresh instance for the next one.
+        for (size_t epoch = 0; epoch < 3; ++epoch)
+        {
+            ReadFullEpoch(expected, epochSize, epoch);
+            auto position = expected->GetCurrentSamplePosition();
+            auto state = expected->GetState();
+            BOOST_CHECK(!state.empty());
+
+            auto nextEpoch = ReadFullEpoch(expected, epochSize, epoch + 1);
+            BOOST_CHECK(underTest->SetState(state));
+            BOOST_CHECK_EQUAL(underTest->GetCurrentSamplePosition(), position);
+            auto restoredNextEpoch = ReadFullEpoch(underTest, epochSize, epoch + 1);
+            BOOST_CHECK_EQUAL_COLLECTIONS(
+                nextEpoch.begin(),
+                nextEpoch.end(),
+                restoredNextEpoch.begin(),
+                restoredNextEpoch.end());
+        }
+    };
+
+    // Inside sweep
+    test(50000);
+
+    // Between sweeps
+    test((size_t)(sweepNumberOfSamples / 1.5));
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerLocalityAwareChunkAssignment)
+{
+    size_t chunkSizeInSamples = 10000;
+    size_t sweepNumberOfSamples = 500000;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 5;
+    size_t numberOfWorkers = 4;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    auto readWorker = [&](size_t sweep, size_t workerRank)
+    {
+        auto randomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false);
+        randomizer->SetLocalityAwareChunkAssignment(make_shared<CorpusDescriptor>(true));
+
+        EpochConfiguration config;
+        config.m_numberOfWorkers = numberOfWorkers;
+        config.m_workerRank = workerRank;
+        config.m_minibatchSizeInSamples = 1000;
+        config.m_totalEpochSizeInSamples = sweepNumberOfSamples;
+        config.m_epochIndex = sweep;
+        randomizer->StartEpoch(config);
+
+        vector<float> result;
+        for (;;)
+        {
+            auto sequences = randomizer->GetNextSequences(config.m_minibatchSizeInSamples);
+            if (!sequences.m_data.empty())
+            {
+                for (auto& s : sequences.m_data[0])
+                {
+                    float* casted = (float*)s->GetDataBuffer();
+                    result.insert(result.end(), casted, casted + s->m_numberOfSamples);
+                }
+            }
+
+            if (sequences.m_endOfEpoch)
+                break;
+        }
+        return result;
+    };
+
+    vector<vector<float>> firstSweep;
+    for (size_t sweep = 0; sweep < 2; ++sweep)
+    {
+        vector<float> all;
+        for (size_t workerRank = 0; workerRank < numberOfWorkers; ++workerRank)
+        {
+            auto data = readWorker(sweep, workerRank);
+
+            // Balanced within the allowed imbalance plus a chunk.
+            BOOST_CHECK_LE(data.size(), sweepNumberOfSamples * 1.05 / numberOfWorkers + chunkSizeInSamples);
+
+            if (sweep == 0)
+            {
+                firstSweep.push_back(data);
+            }
+            else
+            {
+                // The worker reads mostly the same data as in the previous sweep,
+                // only the chunks that did not fit at their home worker can move.
+                auto current = data;
+                sort(current.begin(), current.end());
+                auto previous = firstSweep[workerRank];
+                sort(previous.begin(), previous.end());
+                vector<float> common;
+                set_intersection(previous.begin(), previous.end(), current.begin(), current.end(), back_inserter(common));
+                BOOST_CHECK_GE(common.size(), current.size() * 8 / 10);
+            }
+
+            all.insert(all.end(), data.begin(), data.end());
+        }
+
+        // The workers together read each sample exactly once.
+        sort(all.begin(), all.end());
+        vector<float> expected(sweepNumberOfSamples);
+        iota(expected.begin(), expected.end(), 0.0f);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), all.begin(), all.end());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(RandRollbackToEarlierEpochBetweenSweeps)
 {
     size_t chunkSizeInSamples = 10000;
@@ -605,6 +771,65 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerChaosMonkey)
     BlockRandomizerChaosMonkeyTest(true);
 }
 
+void BlockRandomizerParallelChunkLoadsTest(bool supportsConcurrentChunkLoads)
+{
+    const int numChunks = 50;
+    const int numSequencesPerChunk = 4;
+    const int windowSize = 20;
+    vector<float> data(numChunks * numSequencesPerChunk);
+    iota(data.begin(), data.end(), 0.0f);
+
+    auto serialDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data);
+    auto parallelDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data);
+    parallelDeserializer->SetSupportsConcurrentChunkLoads(supportsConcurrentChunkLoads);
+
+    auto expectedRandomizer = make_shared<BlockRandomizer>(0, windowSize, serialDeserializer, true, false);
+    auto underTestRandomizer = make_shared<BlockRandomizer>(0, windowSize, parallelDeserializer, true, false, false, 8);
+
+    // Parallel loading of chunks must not change the order of sequences, also across sweeps.
+    for (size_t epoch = 0; epoch < 3; ++epoch)
+    {
+        vector<float> expected = ReadFullEpoch(expectedRandomizer, data.size(), epoch);
+        vector<float> actual = ReadFullEpoch(underTestRandomizer, data.size(), epoch);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                      actual.begin(), actual.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerParallelChunkLoads)
+{
+    BlockRandomizerParallelChunkLoadsTest(false);
+    BlockRandomizerParallelChunkLoadsTest(true);
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerKeepDataInMemory)
+{
+    const int numChunks = 50;
+    const int numSequencesPerChunk = 4;
+    const int windowSize = 20;
+    vector<float> data(numChunks * numSequencesPerChunk);
+    iota(data.begin(), data.end(), 0.0f);
+
+    auto streamingDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data);
+    auto cachedDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data);
+
+    auto expectedRandomizer = make_shared<BlockRandomizer>(0, windowSize, streamingDeserializer, true, false);
+    auto underTestRandomizer = make_shared<BlockRandomizer>(0, windowSize, make_shared<ChunkCache>(cachedDeserializer), true, false);
+
+    // The same order of sequences, with each chunk read and described once over all sweeps.
+    for (size_t epoch = 0; epoch < 3; ++epoch)
+    {
+        vector<float> expected = ReadFullEpoch(expectedRandomizer, data.size(), epoch);
+        vector<float> actual = ReadFullEpoch(underTestRandomizer, data.size(), epoch);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                      actual.begin(), actual.end());
+    }
+
+    BOOST_CHECK_EQUAL(cachedDeserializer->GetNumChunkReads(), (size_t)numChunks);
+    BOOST_CHECK_EQUAL(cachedDeserializer->GetNumSequenceReads(), (size_t)numChunks);
+    BOOST_CHECK(streamingDeserializer->GetNumChunkReads() > (size_t)numChunks);
+}
+
 void BlockRandomizerOneEpochLegacyRandomizationTest(bool prefetch)
 {
     vector<float> data(10);
@@ -651,6 +876,82 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochLegacyRandomization)
     BlockRandomizerOneEpochLegacyRandomizationTest(true);
 }
 
+// Sequences of lengths 1 .. 10 (in the sequence descriptions only).
+class VariableLengthMockDeserializer : public MockDeserializer
+{
+public:
+    VariableLengthMockDeserializer(size_t numChunks, size_t numSequencesPerChunks, vector<float>& data)
+        : MockDeserializer(numChunks, numSequencesPerChunks, data)
+    {
+    }
+
+    void GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& descriptions) override
+    {
+        MockDeserializer::GetSequencesForChunk(chunkId, descriptions);
+        for (auto& d : descriptions)
+            d.m_numberOfSamples = 1 + (uint32_t)((d.m_id * 7) % 10);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(SequenceRandomizerLengthBucketing)
+{
+    const size_t numChunks = 10;
+    const size_t numSequencesPerChunk = 100;
+    const size_t minibatchSize = 50;
+
+    vector<float> data(numChunks * numSequencesPerChunk);
+    auto mockDeserializer = make_shared<VariableLengthMockDeserializer>(numChunks, numSequencesPerChunk, data);
+    auto chunkRandomizer = make_shared<ChunkRandomizer>(mockDeserializer, SIZE_MAX);
+    chunkRandomizer->Randomize(0);
+
+    // Returns the ids of all sequences of the sweep and the number of padding
+    // samples of the minibatches, if each was padded to its longest sequence.
+    auto readSweep = [&](size_t bucketSize, size_t& padding)
+    {
+        SequenceRandomizer randomizer(0, mockDeserializer, chunkRandomizer, bucketSize);
+        randomizer.Reset(0);
+
+        vector<size_t> ids;
+        padding = 0;
+        ClosedOpenChunkInterval window;
+        for (;;)
+        {
+            auto sequences = randomizer.GetNextSequenceDescriptions(minibatchSize, window);
+            if (sequences.empty())
+                break;
+
+            uint32_t maxLength = 0;
+            for (const auto& s : sequences)
+                maxLength = max(maxLength, s.m_numberOfSamples);
+            for (const auto& s : sequences)
+            {
+                padding += maxLength - s.m_numberOfSamples;
+                ids.push_back(s.m_id);
+            }
+        }
+        return ids;
+    };
+
+    size_t padding, bucketedPadding, repeatedPadding;
+    auto ids = readSweep(0, padding);
+    auto bucketedIds = readSweep(2 * minibatchSize, bucketedPadding);
+
+    // All sequences are still returned once, in a different order and with much less padding.
+    BOOST_CHECK_EQUAL(bucketedIds.size(), data.size());
+    BOOST_CHECK(is_permutation(ids.begin(), ids.end(), bucketedIds.begin()));
+    BOOST_CHECK(ids != bucketedIds);
+    BOOST_CHECK_LT(bucketedPadding * 2, padding);
+
+    // The buckets are shuffled, the sweep does not simply start with the shortest sequences.
+    vector<size_t> sortedIds(bucketedIds);
+    stable_sort(sortedIds.begin(), sortedIds.end(), [](size_t a, size_t b) { return (a * 7) % 10 < (b * 7) % 10; });
+    BOOST_CHECK(sortedIds != bucketedIds);
+
+    // The order only depends on the seed.
+    BOOST_CHECK(readSweep(2 * minibatchSize, repeatedPadding) == bucketedIds);
+    BOOST_CHECK_EQUAL(repeatedPadding, bucketedPadding);
+}
+
 BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
 {
     vector<float> data(10);
@@ -688,6 +989,609 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+BOOST_AUTO_TEST_CASE(NoRandomizerWithThreadPool)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+
+    // Without parallel deserialization the transformation is left to the caller.
+    BOOST_CHECK(!make_shared<NoRandomizer>(mockDeserializer)->SetSequenceTransformation(nullptr));
+
+    auto threadPool = make_shared<ReaderThreadPool>(4);
+    auto randomizer = make_shared<NoRandomizer>(mockDeserializer, true, threadPool);
+
+    // Transformation replaces each sequence by a sequence of twice the value.
+    vector<float> transformed(data.size());
+    BOOST_REQUIRE(randomizer->SetSequenceTransformation([&](vector<SequenceDataPtr>& sequence)
+    {
+        float value = *(const float*)static_cast<DenseSequenceData&>(*sequence[0]).GetDataBuffer();
+        auto result = make_shared<MockDenseSequenceData>();
+        result->m_data = &transformed[(size_t)value];
+        transformed[(size_t)value] = 2 * value;
+        result->m_numberOfSamples = sequence[0]->m_numberOfSamples;
+        sequence[0] = result;
+    }));
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 0;
+    epochConfiguration.m_totalEpochSizeInSamples = data.size();
+    epochConfiguration.m_epochIndex = 0;
+    randomizer->StartEpoch(epochConfiguration);
+
+    Sequences sequences = randomizer->GetNextSequences(data.size());
+    BOOST_REQUIRE_EQUAL(sequences.m_data.size(), 1u);
+    BOOST_REQUIRE_EQUAL(sequences.m_data[0].size(), data.size());
+
+    vector<float> actual;
+    for (const auto& sequence : sequences.m_data[0])
+        actual.push_back(*(const float*)static_cast<DenseSequenceData&>(*sequence).GetDataBuffer());
+
+    vector<float> expected(data.size());
+    transform(data.begin(), data.end(), expected.begin(), [](float value) { return 2 * value; });
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  actual.begin(), actual.end());
+}
+
+BOOST_AUTO_TEST_CASE(ReaderThreadPoolParallelFor)
+{
+    ReaderThreadPool threadPool(4);
+    BOOST_CHECK_EQUAL(threadPool.GetNumThreads(), 4u);
+
+    // Every index is processed exactly once, for several loops in a row.
+    for (size_t count : { 0, 1, 3, 1000 })
+    {
+        vector<int> calls(count, 0);
+        threadPool.ParallelFor(count, [&calls](size_t i) { calls[i]++; });
+        BOOST_CHECK(all_of(calls.begin(), calls.end(), [](int c) { return c == 1; }));
+    }
+
+    // Exceptions are rethrown on the calling thread, the pool stays usable.
+    BOOST_CHECK_THROW(threadPool.ParallelFor(100, [](size_t i)
+    {
+        if (i == 42)
+            RuntimeError("Failure");
+    }), std::runtime_error);
+
+    atomic<size_t> sum(0);
+    threadPool.ParallelFor(100, [&sum](size_t i) { sum += i; });
+    BOOST_CHECK_EQUAL(sum.load(), 4950u);
+
+    BOOST_CHECK(ParseThreadAffinity(L"NUMA") == ThreadAffinity::Numa);
+    BOOST_CHECK(ParseThreadAffinity(L"none") == ThreadAffinity::None);
+    BOOST_CHECK(ParseThreadAffinity(L"device") == ThreadAffinity::Device);
+    BOOST_CHECK(ParseThreadAffinity(L"compact") == ThreadAffinity::Compact);
+    BOOST_CHECK_THROW(ParseThreadAffinity(L"scatter"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(ReaderThreadPoolAffinity)
+{
+    // Without a reader NUMA node the threads keep all CPUs of the process.
+    auto processCpus = GetThreadCpus(ThreadAffinity::None, 0, 1);
+    BOOST_CHECK(GetThreadCpus(ThreadAffinity::Device, 0, 1, -1).empty());
+    for (size_t i = 0; i < 3; ++i)
+    {
+        auto cpus = GetThreadCpus(ThreadAffinity::Compact, i, 3);
+        BOOST_CHECK(cpus.size() <= 1);
+        for (int cpu : cpus)
+            BOOST_CHECK(find(processCpus.begin(), processCpus.end(), cpu) != processCpus.end());
+    }
+
+    // Pool threads follow the reader NUMA node, and work is done whether or not it can be honored.
+    const auto& nodes = GetNumaNodeCpus();
+    int node = nodes.empty() ? -1 : 0;
+    SetReaderNumaNode(node);
+    {
+        ReaderNumaNodeScope scope;
+        ReaderThreadPool threadPool(3, ThreadAffinity::Device);
+        atomic<size_t> sum(0);
+        threadPool.ParallelFor(100, [&sum](size_t i) { sum += i; });
+        BOOST_CHECK_EQUAL(sum.load(), 4950u);
+    }
+    SetReaderNumaNode(-1);
+}
+
+struct MockSparseSequenceData : SparseSequenceData
+{
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+
+    void* m_data;
+};
+
+// Returns the same sequences for every minibatch.
+class MockSequenceEnumerator : public SequenceEnumerator
+{
+public:
+    MockSequenceEnumerator(const vector<StreamDescriptionPtr>& streams, const Sequences& sequences)
+        : m_streams(streams), m_sequences(sequences)
+    {
+    }
+
+    vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    void StartEpoch(const EpochConfiguration&) override {}
+    void SetConfiguration(const ReaderConfiguration&) override {}
+    void SetCurrentSamplePosition(size_t) override {}
+    size_t GetCurrentSamplePosition() override { return 0; }
+
+    Sequences GetNextSequences(size_t) override
+    {
+        return m_sequences;
+    }
+
+private:
+    vector<StreamDescriptionPtr> m_streams;
+    Sequences m_sequences;
+};
+
+// Zero-fills the buffers, so that the gaps of packed minibatches can be compared.
+class ZeroingMemoryProvider : public HeapMemoryProvider
+{
+public:
+    void* Alloc(size_t elementSize, size_t numberOfElements) override
+    {
+        void* p = HeapMemoryProvider::Alloc(elementSize, numberOfElements);
+        memset(p, 0, elementSize * numberOfElements);
+        return p;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(SequencePackerParallelPacking)
+{
+    const size_t numSequences = 3000;
+    const size_t denseDimension = 32;
+    const size_t sparseDimension = 1000;
+
+    vector<StreamDescriptionPtr> streams;
+    streams.push_back(make_shared<StreamDescription>(StreamDescription{ L"dense", 0, StorageType::dense, ElementType::tfloat, make_shared<TensorShape>(denseDimension) }));
+    streams.push_back(make_shared<StreamDescription>(StreamDescription{ L"sparse", 1, StorageType::sparse_csc, ElementType::tfloat, make_shared<TensorShape>(sparseDimension) }));
+
+    // Short sequences of different lengths, the sparse ones with a varying number of non zero values per sample.
+    std::mt19937 rng(7);
+    vector<vector<float>> denseData(numSequences), sparseData(numSequences);
+    vector<vector<IndexType>> sparseIndices(numSequences);
+    Sequences sequences;
+    sequences.m_data.resize(2);
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        uint32_t length = 1 + rng() % 6;
+        denseData[i].resize(length * denseDimension);
+        iota(denseData[i].begin(), denseData[i].end(), (float)(i * 1000));
+
+        auto dense = make_shared<MockDenseSequenceData>();
+        dense->m_data = denseData[i].data();
+        dense->m_numberOfSamples = length;
+        dense->m_sampleLayout = streams[0]->m_sampleLayout;
+        sequences.m_data[0].push_back(dense);
+
+        auto sparse = make_shared<MockSparseSequenceData>();
+        for (uint32_t j = 0; j < length; ++j)
+        {
+            IndexType nnz = rng() % 10;
+            for (IndexType k = 0; k < nnz; ++k)
+            {
+                sparseIndices[i].push_back(k * 100 + rng() % 100);
+                sparseData[i].push_back((float)sparseData[i].size() + i);
+            }
+            sparse->m_nnzCounts.push_back(nnz);
+        }
+        sparse->m_data = sparseData[i].data();
+        sparse->m_indices = sparseIndices[i].data();
+        sparse->m_totalNnzCount = (IndexType)sparseData[i].size();
+        sparse->m_numberOfSamples = length;
+        sparse->m_sampleLayout = streams[1]->m_sampleLayout;
+        sequences.m_data[1].push_back(sparse);
+    }
+
+    ReaderConfiguration config;
+    config.m_numberOfWorkers = 1;
+    config.m_minibatchSizeInSamples = numSequences;
+    vector<MemoryProviderPtr> providers = { make_shared<ZeroingMemoryProvider>(), make_shared<ZeroingMemoryProvider>() };
+
+    auto enumerator = make_shared<MockSequenceEnumerator>(streams, sequences);
+    SequencePacker serialPacker(enumerator, streams);
+    SequencePacker parallelPacker(enumerator, streams, 2, make_shared<ReaderThreadPool>(4));
+    serialPacker.SetConfiguration(config, providers);
+    parallelPacker.SetConfiguration(config, providers);
+
+    auto serial = serialPacker.ReadMinibatch();
+    auto parallel = parallelPacker.ReadMinibatch();
+    BOOST_REQUIRE_EQUAL(serial.m_data.size(), 2);
+    BOOST_REQUIRE_EQUAL(parallel.m_data.size(), 2);
+
+    // The streams have sequences of the same lengths, so they share the layout.
+    auto layout = parallel.m_data[0]->m_layout;
+    BOOST_CHECK(parallel.m_data[1]->m_layout == layout);
+    BOOST_CHECK(*serial.m_data[0]->m_layout == *layout);
+    size_t numColumns = layout->GetNumCols();
+
+    const char* serialDense = reinterpret_cast<const char*>(serial.m_data[0]->m_data);
+    const char* parallelDense = reinterpret_cast<const char*>(parallel.m_data[0]->m_data);
+    BOOST_CHECK(memcmp(serialDense, parallelDense, numColumns * denseDimension * sizeof(float)) == 0);
+
+    const float* dense = reinterpret_cast<const float*>(parallelDense);
+    const size_t* serialSparse = reinterpret_cast<const size_t*>(serial.m_data[1]->m_data);
+    size_t nnzCount = *reinterpret_cast<const size_t*>(parallel.m_data[1]->m_data);
+    BOOST_REQUIRE_EQUAL(nnzCount, *serialSparse);
+    size_t sparseSize = sizeof(size_t) + nnzCount * (sizeof(float) + sizeof(IndexType)) + (numColumns + 1) * sizeof(IndexType);
+    BOOST_CHECK(memcmp(serialSparse, parallel.m_data[1]->m_data, sparseSize) == 0);
+
+    const float* values = reinterpret_cast<const float*>(reinterpret_cast<const char*>(parallel.m_data[1]->m_data) + sizeof(size_t));
+    const IndexType* indices = reinterpret_cast<const IndexType*>(values + nnzCount);
+    const IndexType* columns = indices + nnzCount;
+    BOOST_CHECK_EQUAL(columns[numColumns], nnzCount);
+
+    // Every sample is found in the column given by the layout.
+    for (const auto& info : layout->GetAllSequences())
+    {
+        if (info.seqId == GAP_SEQUENCE_ID)
+            continue;
+
+        const auto& sparse = static_pointer_cast<SparseSequenceData>(sequences.m_data[1][info.seqId]);
+        for (size_t t = 0, offset = 0; t < info.GetNumTimeSteps(); ++t)
+        {
+            size_t column = layout->GetColumnIndex(info, t);
+            BOOST_CHECK(equal(dense + column * denseDimension, dense + (column + 1) * denseDimension, denseData[info.seqId].begin() + t * denseDimension));
+
+            BOOST_REQUIRE_EQUAL(columns[column + 1] - columns[column], sparse->m_nnzCounts[t]);
+            BOOST_CHECK(equal(values + columns[column], values + columns[column + 1], sparseData[info.seqId].begin() + offset));
+            BOOST_CHECK(equal(indices + columns[column], indices + columns[column + 1], sparseIndices[info.seqId].begin() + offset));
+            offset += sparse->m_nnzCounts[t];
+        }
+    }
+}
+
+// Returns the given sequences one at a time, then the end of the epoch.
+class FiniteSequenceEnumerator : public SequenceEnumerator
+{
+public:
+    FiniteSequenceEnumerator(const vector<StreamDescriptionPtr>& streams, const vector<SequenceDataPtr>& sequences)
+        : m_streams(streams), m_sequences(sequences), m_next(0)
+    {
+    }
+
+    vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    void StartEpoch(const EpochConfiguration&) override {}
+    void SetConfiguration(const ReaderConfiguration&) override {}
+    void SetCurrentSamplePosition(size_t) override {}
+    size_t GetCurrentSamplePosition() override { return 0; }
+
+    Sequences GetNextSequences(size_t) override
+    {
+        Sequences result;
+        if (m_next < m_sequences.size())
+        {
+            result.m_data.resize(1);
+            result.m_data[0].push_back(m_sequences[m_next++]);
+        }
+        else
+        {
+            result.m_endOfEpoch = true;
+        }
+        return result;
+    }
+
+private:
+    vector<StreamDescriptionPtr> m_streams;
+    vector<SequenceDataPtr> m_sequences;
+    size_t m_next;
+};
+
+// Packs one epoch of sequences of the given lengths in truncated BPTT mode, with 2 parallel sequences of 4 samples each,
+// and returns the number of minibatches. Checks that every sample is packed once, and that a sequence that continues
+// from the previous minibatch continues in the same row.
+static size_t PackTruncatedEpoch(const vector<uint32_t>& lengths, bool balanceParallelSequences)
+{
+    const size_t truncationLength = 4;
+    vector<StreamDescriptionPtr> streams;
+    streams.push_back(make_shared<StreamDescription>(StreamDescription{ L"input", 0, StorageType::dense, ElementType::tfloat, make_shared<TensorShape>(1) }));
+
+    // sample t of sequence i has the value 1000 i + t
+    vector<vector<float>> data(lengths.size());
+    vector<SequenceDataPtr> sequences;
+    size_t numSamples = 0;
+    for (size_t i = 0; i < lengths.size(); ++i)
+    {
+        for (uint32_t t = 0; t < lengths[i]; ++t)
+            data[i].push_back((float)(1000 * i + t));
+        auto sequence = make_shared<MockDenseSequenceData>();
+        sequence->m_data = data[i].data();
+        sequence->m_numberOfSamples = lengths[i];
+        sequence->m_sampleLayout = streams[0]->m_sampleLayout;
+        sequences.push_back(sequence);
+        numSamples += lengths[i];
+    }
+
+    ReaderConfiguration config;
+    config.m_numberOfWorkers = 1;
+    config.m_minibatchSizeInSamples = 2 * truncationLength;
+    config.m_truncationSize = truncationLength;
+    TruncatedBPTTPacker packer(make_shared<FiniteSequenceEnumerator>(streams, sequences), streams, 2, balanceParallelSequences);
+    packer.SetConfiguration(config, { make_shared<HeapMemoryProvider>() });
+
+    multiset<float> packed;
+    vector<float> lastInRow(2, -1);
+    size_t numMinibatches = 0;
+    for (auto minibatch = packer.ReadMinibatch(); !minibatch.m_endOfEpoch; minibatch = packer.ReadMinibatch())
+    {
+        numMinibatches++;
+        BOOST_REQUIRE(numMinibatches <= numSamples);
+        const float* values = reinterpret_cast<const float*>(minibatch.m_data[0]->m_data);
+        const auto& layout = minibatch.m_data[0]->m_layout;
+        for (const auto& info : layout->GetAllSequences())
+        {
+            if (info.seqId == GAP_SEQUENCE_ID)
+                continue;
+            size_t begin = (size_t)max<ptrdiff_t>(info.tBegin, 0);
+            size_t end = min<size_t>(info.tEnd, truncationLength);
+            if (info.tBegin < 0)
+                BOOST_CHECK_EQUAL(values[begin * 2 + info.s], lastInRow[info.s] + 1);
+            for (size_t t = begin; t < end; ++t)
+                packed.insert(values[t * 2 + info.s]);
+            lastInRow[info.s] = values[(end - 1) * 2 + info.s];
+        }
+    }
+
+    multiset<float> expected;
+    for (const auto& d : data)
+        expected.insert(d.begin(), d.end());
+    BOOST_CHECK(packed == expected);
+    return numMinibatches;
+}
+
+BOOST_AUTO_TEST_CASE(TruncatedBPTTPackerBalanceParallelSequences)
+{
+    // Without balancing, the second long sequence starts in the first row only after the first one has used up the second.
+    vector<uint32_t> lengths = { 2, 2, 2, 2, 12, 12 };
+    size_t unbalanced = PackTruncatedEpoch(lengths, false);
+    size_t balanced = PackTruncatedEpoch(lengths, true);
+    BOOST_CHECK_LT(balanced, unbalanced);
+    BOOST_CHECK_EQUAL(balanced, 4); // (the 32 samples need at least 4 minibatches of 2 x 4)
+}
+
+// A deserializer of empty sequences with the given keys and lengths, one vector per chunk.
+class KeyedDeserializer : public DataDeserializerBase
+{
+public:
+    KeyedDeserializer(const vector<vector<pair<size_t, uint32_t>>>& chunks) : m_chunks(chunks)
+    {
+        m_streams.push_back(make_shared<StreamDescription>(StreamDescription{ L"input", 0, StorageType::dense, ElementType::tfloat, make_shared<TensorShape>(1) }));
+        m_streams.back()->m_id = 0;
+    }
+
+    ChunkDescriptions GetChunkDescriptions() override
+    {
+        ChunkDescriptions result;
+        for (size_t i = 0; i < m_chunks.size(); ++i)
+        {
+            size_t samples = 0;
+            for (const auto& s : m_chunks[i])
+                samples += s.second;
+            result.push_back(make_shared<ChunkDescription>(ChunkDescription{ (ChunkIdType)i, samples, m_chunks[i].size() }));
+        }
+        return result;
+    }
+
+    void GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result) override
+    {
+        for (size_t i = 0; i < m_chunks[chunkId].size(); ++i)
+        {
+            KeyType key;
+            key.m_sequence = m_chunks[chunkId][i].first;
+            key.m_sample = 0;
+            result.push_back(SequenceDescription{ i, m_chunks[chunkId][i].second, chunkId, key });
+        }
+    }
+
+    ChunkPtr GetChunk(ChunkIdType) override
+    {
+        return nullptr;
+    }
+
+protected:
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override
+    {
+        for (ChunkIdType c = 0; c < m_chunks.size(); ++c)
+        {
+            vector<SequenceDescription> sequences;
+            GetSequencesForChunk(c, sequences);
+            for (const auto& s : sequences)
+            {
+                if (s.m_key.m_sequence == key.m_sequence)
+                {
+                    result = s;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    vector<vector<pair<size_t, uint32_t>>> m_chunks;
+};
+
+BOOST_AUTO_TEST_CASE(BundlerJoinMethods)
+{
+    // Key 3 is missing and key 7 is only in the secondary deserializer, which has longer sequence 4.
+    auto primary = make_shared<KeyedDeserializer>(vector<vector<pair<size_t, uint32_t>>>{ { { 1, 2 }, { 2, 3 }, { 3, 1 } }, { { 4, 5 }, { 5, 1 } }, { { 6, 2 } } });
+    auto secondary = make_shared<KeyedDeserializer>(vector<vector<pair<size_t, uint32_t>>>{ { { 1, 2 } }, { { 2, 3 }, { 4, 7 } }, { { 5, 1 }, { 6, 2 }, { 7, 4 } } });
+
+    auto describe = [&](const string& configString)
+    {
+        ConfigParameters config;
+        config.Parse(configString);
+        Bundler bundler(config, primary, vector<IDataDeserializerPtr>{ primary, secondary }, true);
+
+        vector<size_t> result;
+        for (const auto& c : bundler.GetChunkDescriptions())
+        {
+            vector<SequenceDescription> sequences;
+            bundler.GetSequencesForChunk(c->m_id, sequences);
+            for (const auto& s : sequences)
+            {
+                result.push_back(s.m_key.m_sequence);
+                result.push_back(s.m_numberOfSamples);
+            }
+        }
+        return result;
+    };
+
+    const vector<size_t> expected{ 1, 2, 2, 3, 4, 7, 5, 1, 6, 2 };
+    BOOST_CHECK(describe("joinMethod=lookup") == expected);
+    BOOST_CHECK(describe("joinMethod=merge") == expected);
+
+    // The index is written by the first bundler and mapped by the second one.
+    const wstring indexFile = L"BundlerJoinMethods.join";
+    _wunlink(indexFile.c_str());
+    BOOST_CHECK(describe("joinMethod=merge\njoinIndexFile=BundlerJoinMethods.join") == expected);
+    BOOST_CHECK(fexists(indexFile));
+    BOOST_CHECK(describe("joinIndexFile=BundlerJoinMethods.join") == expected);
+    _wunlink(indexFile.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(DecodedDataCachePutGet)
+{
+    const size_t blockSize = 16;
+    auto check = [blockSize](const wstring& fileName)
+    {
+        // Room for four blocks.
+        DecodedDataCache cache(4 * blockSize + 3, fileName, blockSize);
+
+        string value;
+        auto get = [&cache, &value](size_t key, string& header)
+        {
+            return cache.TryGet(key, [&value, &header](const string& h, size_t size)
+            {
+                header = h;
+                value.assign(size, '\0');
+                return &value[0];
+            });
+        };
+
+        string first(2 * blockSize + 5, 'a'); // three blocks
+        string second(blockSize, 'b');        // one block
+        cache.Put(1, "first", first.data(), first.size());
+        cache.Put(2, "second", second.data(), second.size());
+        BOOST_CHECK_EQUAL(cache.GetSizeInBytes(), first.size() + second.size());
+
+        string header;
+        BOOST_REQUIRE(get(1, header));
+        BOOST_CHECK_EQUAL(header, "first");
+        BOOST_CHECK(value == first);
+        BOOST_CHECK(!get(3, header));
+
+        // The least recently used entry (2) makes room for the new one.
+        string third(blockSize / 2, 'c');
+        cache.Put(3, "third", third.data(), third.size());
+        BOOST_CHECK(!get(2, header));
+        BOOST_REQUIRE(get(3, header));
+        BOOST_CHECK(value == third);
+        BOOST_REQUIRE(get(1, header));
+        BOOST_CHECK(value == first);
+
+        // Replacing an entry frees its old blocks.
+        cache.Put(1, "first", second.data(), second.size());
+        BOOST_REQUIRE(get(1, header));
+        BOOST_CHECK(value == second);
+        BOOST_CHECK_EQUAL(cache.GetSizeInBytes(), second.size() + third.size());
+
+        // Data larger than the cache is not stored and does not evict anything.
+        string huge(5 * blockSize, 'd');
+        cache.Put(4, "huge", huge.data(), huge.size());
+        BOOST_CHECK(!get(4, header));
+        BOOST_CHECK(get(3, header));
+
+        BOOST_CHECK_EQUAL(cache.GetNumHits(), 5u);
+        BOOST_CHECK_EQUAL(cache.GetNumMisses(), 3u);
+    };
+
+    check(L"");
+    check(L"DecodedDataCache.tmp"); // a scratch file, deleted by the cache
+}
+
+BOOST_AUTO_TEST_CASE(AsyncFileReaderRanges)
+{
+    // A few blocks and an unaligned tail.
+    vector<char> content(3 * AsyncFileReader::s_blockSize + 123);
+    for (size_t i = 0; i < content.size(); i++)
+        content[i] = (char)(i * 7 + i / 251);
+    FILE* test = fopen("AsyncFileReader.tmp", "wb");
+    fwrite(content.data(), sizeof(char), content.size(), test);
+    fclose(test);
+
+    for (bool directIO : { false, true })
+    {
+        AsyncFileReader reader(L"AsyncFileReader.tmp", directIO, 4);
+        BOOST_CHECK_EQUAL(reader.GetFileSize(), content.size());
+
+        // Reads outstanding at once, spanning blocks, inside a block and up to the end of the file.
+        vector<pair<size_t, size_t>> ranges = { { 5, 2 * AsyncFileReader::s_blockSize + 7 }, { 4096, 100 }, { content.size() - 1000, 1000 }, { 0, 0 } };
+        vector<future<shared_ptr<char>>> reads;
+        for (const auto& range : ranges)
+            reads.push_back(reader.ReadAsync(range.first, range.second));
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            auto data = reads[i].get();
+            BOOST_CHECK(equal(data.get(), data.get() + ranges[i].second, content.begin() + ranges[i].first));
+        }
+
+        BOOST_CHECK_THROW(reader.Read(content.size() - 1, 2), std::runtime_error);
+    }
+
+    remove("AsyncFileReader.tmp");
+}
+
+#ifdef __unix__
+BOOST_AUTO_TEST_CASE(RemoteDataSourceRanges)
+{
+    vector<char> content(2 * RemoteDataSource::s_blockSize + 123);
+    for (size_t i = 0; i < content.size(); i++)
+        content[i] = (char)(i * 7 + i / 251);
+    FILE* test = fopen("RemoteDataSource.tmp", "wb");
+    fwrite(content.data(), sizeof(char), content.size(), test);
+    fclose(test);
+
+    // The object is served by shell commands instead of curl.
+    DataSourceOptions options;
+    options.m_fetchCommand = "tail -c +$((%begin% + 1)) RemoteDataSource.tmp | head -c $((%end% - %begin% + 1))";
+    options.m_sizeCommand = "wc -c < RemoteDataSource.tmp";
+
+    for (bool cache : { false, true })
+    {
+        options.m_cacheDirectory = cache ? L"RemoteDataSourceCache" : L"";
+        DataSourcePtr source = CreateDataSource(L"https://example.com/RemoteDataSource.tmp", options);
+        BOOST_CHECK(source->IsRemote());
+        BOOST_CHECK_EQUAL(source->GetSize(), content.size());
+
+        vector<pair<size_t, size_t>> ranges = { { 5, RemoteDataSource::s_blockSize + 7 }, { 4096, 100 }, { content.size() - 1000, 1000 }, { 0, 0 } };
+        source->FetchAhead({ { content.size() - 1000, 1000 } });
+        for (const auto& range : ranges)
+        {
+            auto data = source->Read(range.first, range.second);
+            BOOST_CHECK(equal(data.get(), data.get() + range.second, content.begin() + range.first));
+        }
+
+        BOOST_CHECK_THROW(source->Read(content.size() - 1, 2), std::runtime_error);
+    }
+
+    remove("RemoteDataSource.tmp");
+    BOOST_CHECK_EQUAL(system("rm -rf RemoteDataSourceCache"), 0);
+}
+#endif
+
 BOOST_AUTO_TEST_CASE(DefaultCorpusDescriptor)
 {
     const int seed = 13;
@@ -751,6 +1655,288 @@ BOOST_AUTO_TEST_CASE(CorpusDescriptorFromFile)
     remove("test.tmp");
 }
 
+BOOST_AUTO_TEST_CASE(KeyRegistryAddSaveAndLoad)
+{
+    // Enough keys to grow the hash table a few times.
+    const size_t numberOfKeys = 5000;
+    KeyRegistry registry;
+    for (size_t i = 0; i < numberOfKeys; ++i)
+        BOOST_CHECK_EQUAL(i, registry.AddValue("utt_" + std::to_string(i)));
+    BOOST_CHECK_EQUAL(17, registry.AddValue("utt_17"));
+    BOOST_CHECK_EQUAL(numberOfKeys, registry.Size());
+
+    size_t id = 0;
+    BOOST_CHECK(registry.TryGet("utt_4321", id));
+    BOOST_CHECK_EQUAL(4321, id);
+    BOOST_CHECK(!registry.Contains("utt_"));
+    BOOST_CHECK_EQUAL(std::string("utt_123"), registry.GetKey(123));
+    BOOST_CHECK_EQUAL(7, registry.GetKeyLength(123));
+
+    registry.Save(L"KeyRegistry.tmp");
+
+    {
+        KeyRegistry loaded;
+        BOOST_REQUIRE(loaded.TryLoad(L"KeyRegistry.tmp"));
+        BOOST_CHECK(loaded.IsMapped());
+        BOOST_CHECK_EQUAL(numberOfKeys, loaded.Size());
+        for (size_t i = 0; i < numberOfKeys; i += 97)
+        {
+            BOOST_CHECK(loaded.TryGet("utt_" + std::to_string(i), id));
+            BOOST_CHECK_EQUAL(i, id);
+            BOOST_CHECK_EQUAL("utt_" + std::to_string(i), std::string(loaded.GetKey(i)));
+        }
+
+        // Existing keys are resolved from the mapping, a new key copies the registry out of it.
+        BOOST_CHECK_EQUAL(42, loaded.AddValue("utt_42"));
+        BOOST_CHECK(loaded.IsMapped());
+        BOOST_CHECK_EQUAL(numberOfKeys, loaded.AddValue("new"));
+        BOOST_CHECK(!loaded.IsMapped());
+        BOOST_CHECK(loaded.TryGet("utt_4999", id));
+        BOOST_CHECK_EQUAL(4999, id);
+    }
+
+    // Sharing the registry between the deserializers through the corpus.
+    {
+        CorpusDescriptor corpus(false);
+        BOOST_REQUIRE(corpus.TryLoadKeyRegistry(L"KeyRegistry.tmp"));
+        BOOST_CHECK_EQUAL(2500, corpus.KeyToId("utt_2500"));
+        BOOST_CHECK_EQUAL("utt_2500", corpus.IdToKey(2500));
+        BOOST_CHECK(!corpus.IsKeyRegistryModified());
+    }
+
+    // Not a registry.
+    FILE* f = fopen("KeyRegistry.tmp", "wb");
+    fwrite("not a key registry file", sizeof(char), 23, f);
+    fclose(f);
+    KeyRegistry invalid;
+    BOOST_CHECK(!invalid.TryLoad(L"KeyRegistry.tmp"));
+    remove("KeyRegistry.tmp");
+}
+
+BOOST_AUTO_TEST_CASE(FileLockAndCacheProtocol)
+{
+    const wstring lockFile = L"FileLock.tmp.lock";
+
+    // A lock file left behind by a crashed process does not hold the lock.
+    FILE* f = fopen("FileLock.tmp.lock", "wb");
+    fclose(f);
+    {
+        FileLock lock(lockFile);
+        BOOST_REQUIRE(lock.TryLock());
+
+        FileLock other(lockFile);
+        BOOST_CHECK(!other.TryLock());
+        BOOST_CHECK(other.IsAvailable());
+        BOOST_CHECK(!other.Lock(0.1));
+
+        lock.Unlock();
+        BOOST_CHECK(!fexists(lockFile));
+        BOOST_CHECK(other.TryLock());
+    }
+    BOOST_CHECK(!fexists(lockFile));
+
+    // The lock holder builds and saves the cache.
+    f = fopen("FileLock.tmp.lock", "wb");
+    fclose(f);
+    atomic<int> built(0), saved(0);
+    bool loaded = BuildOrWaitForCache(L"FileLock.tmp", 1, false,
+        [&] { return saved > 0; },
+        [&] { built++; },
+        [&] { saved++; });
+    BOOST_CHECK(!loaded);
+    BOOST_CHECK_EQUAL(1, built.load());
+    BOOST_CHECK_EQUAL(1, saved.load());
+    BOOST_CHECK(!fexists(lockFile));
+
+    // Others wait for the holder and load the cache it has saved.
+    {
+        FileLock holder(lockFile);
+        BOOST_REQUIRE(holder.TryLock());
+        thread waiter([&]
+        {
+            loaded = BuildOrWaitForCache(L"FileLock.tmp", 60, false,
+                [&] { return saved > 1; },
+                [&] { built++; },
+                [&] { saved++; });
+        });
+        this_thread::sleep_for(chrono::milliseconds(200));
+        saved++;
+        holder.Unlock();
+        waiter.join();
+    }
+    BOOST_CHECK(loaded);
+    BOOST_CHECK_EQUAL(1, built.load());
+    BOOST_CHECK_EQUAL(2, saved.load());
+
+    // If the holder does not finish in time, the waiting process builds the cache without saving it.
+    {
+        FileLock holder(lockFile);
+        BOOST_REQUIRE(holder.TryLock());
+        loaded = BuildOrWaitForCache(L"FileLock.tmp", 0.1, false,
+            [&] { return false; },
+            [&] { built++; },
+            [&] { saved++; });
+    }
+    BOOST_CHECK(!loaded);
+    BOOST_CHECK_EQUAL(2, built.load());
+    BOOST_CHECK_EQUAL(2, saved.load());
+}
+
+BOOST_AUTO_TEST_CASE(SharedMinibatchChannelRoundTrip)
+{
+    // A dense stream of 3 floats per sample and a sparse stream of 5 rows, sharing a layout of two sequences (and a gap).
+    auto dense = make_shared<StreamDescription>();
+    dense->m_name = L"features";
+    dense->m_id = 0;
+    dense->m_storageType = StorageType::dense;
+    dense->m_elementType = ElementType::tfloat;
+    dense->m_sampleLayout = make_shared<TensorShape>(3);
+    auto sparse = make_shared<StreamDescription>();
+    sparse->m_name = L"labels";
+    sparse->m_id = 1;
+    sparse->m_storageType = StorageType::sparse_csc;
+    sparse->m_elementType = ElementType::tfloat;
+    sparse->m_sampleLayout = make_shared<TensorShape>(5);
+
+    auto layout = make_shared<MBLayout>();
+    layout->Init(2, 3);
+    layout->AddSequence(0, 0, 0, 3);
+    layout->AddSequence(1, 1, 0, 2);
+    layout->AddGap(1, 2, 3);
+    const size_t numCols = layout->GetNumCols();
+
+    vector<float> denseData(3 * numCols);
+    iota(denseData.begin(), denseData.end(), 0.0f);
+
+    // One non-zero value per column.
+    vector<char> sparseData(sizeof(size_t) + numCols * (sizeof(float) + sizeof(IndexType)) + (numCols + 1) * sizeof(IndexType));
+    *reinterpret_cast<size_t*>(sparseData.data()) = numCols;
+    float* values = reinterpret_cast<float*>(sparseData.data() + sizeof(size_t));
+    IndexType* rows = reinterpret_cast<IndexType*>(values + numCols);
+    IndexType* columns = rows + numCols;
+    for (size_t i = 0; i < numCols; ++i)
+    {
+        values[i] = 1.0f + i;
+        rows[i] = (IndexType)(i % 5);
+        columns[i] = (IndexType)i;
+    }
+    columns[numCols] = (IndexType)numCols;
+
+    Minibatch minibatch;
+    for (auto* data : { (void*)denseData.data(), (void*)sparseData.data() })
+    {
+        auto stream = make_shared<StreamMinibatch>();
+        stream->m_data = data;
+        stream->m_layout = layout;
+        minibatch.m_data.push_back(stream);
+    }
+
+    wstring name = L"ReaderLibTests_" + to_wstring(random_device()());
+    BOOST_CHECK_THROW(SharedMinibatchChannel::Open(name, 0.2), std::runtime_error);
+
+    const size_t ringSize = 4096;
+    SharedMinibatchChannel service(name, 1, ringSize, { dense, sparse });
+    auto consumer = SharedMinibatchChannel::Open(name, 10);
+    const auto& streams = consumer->GetStreamDescriptions();
+    BOOST_REQUIRE_EQUAL(2, streams.size());
+    BOOST_CHECK(streams[0]->m_name == L"features" && streams[0]->m_storageType == StorageType::dense);
+    BOOST_CHECK(streams[1]->m_name == L"labels" && streams[1]->m_storageType == StorageType::sparse_csc);
+    BOOST_CHECK_EQUAL(5, streams[1]->m_sampleLayout->GetNumElements());
+
+    size_t slot = 1, otherSlot = 1;
+    BOOST_REQUIRE(consumer->TryAttach(slot));
+    BOOST_CHECK_EQUAL(0, slot);
+    BOOST_CHECK(service.IsAttached(slot));
+    BOOST_CHECK(!consumer->TryAttach(otherSlot));
+
+    // The service completes the command while the consumer waits.
+    auto serveCommand = [&](SharedMinibatchChannel::Command& received)
+    {
+        return thread([&]
+        {
+            while (!service.TryTakeCommand(slot, received))
+                this_thread::yield();
+            service.CompleteCommand(slot, 42);
+        });
+    };
+
+    SharedMinibatchChannel::Command command{}, received{};
+    command.m_type = SharedMinibatchChannel::CommandType::startEpoch;
+    command.m_config.m_minibatchSizeInSamples = 4;
+    command.m_config.m_epochIndex = 3;
+    auto serviceThread = serveCommand(received);
+    BOOST_CHECK_EQUAL(42, consumer->SendCommand(slot, command, [] { return true; }));
+    serviceThread.join();
+    BOOST_CHECK(received.m_type == SharedMinibatchChannel::CommandType::startEpoch);
+    BOOST_CHECK_EQUAL(4, received.m_config.m_minibatchSizeInSamples);
+    BOOST_CHECK_EQUAL(3, received.m_config.m_epochIndex);
+
+    // Enough minibatches to wrap around the ring several times, two at a time.
+    size_t denseSize = denseData.size() * sizeof(float);
+    auto noWait = [] { return false; };
+    for (size_t i = 0; i < 40; i += 2)
+    {
+        BOOST_REQUIRE(service.WriteMinibatch(slot, minibatch, 5 * i, noWait));
+        minibatch.m_endOfEpoch = true;
+        BOOST_REQUIRE(service.WriteMinibatch(slot, minibatch, 5 * i + 5, noWait));
+        minibatch.m_endOfEpoch = false;
+
+        for (size_t j = 0; j < 2; ++j)
+        {
+            SharedMinibatchChannel::MinibatchMessage message;
+            BOOST_REQUIRE(consumer->ReadMinibatch(slot, message, noWait));
+            BOOST_CHECK_EQUAL(5 * (i + j), message.m_samplePosition);
+            BOOST_CHECK_EQUAL(j == 1, message.m_endOfEpoch);
+            BOOST_REQUIRE_EQUAL(2, message.m_streams.size());
+            BOOST_CHECK(message.m_streams[0].m_layout == message.m_streams[1].m_layout);
+            BOOST_CHECK(message.m_streams[0].m_layout->GetAllSequences() == layout->GetAllSequences());
+            BOOST_CHECK_EQUAL(numCols, message.m_streams[0].m_layout->GetNumCols());
+            BOOST_REQUIRE_EQUAL(denseSize, message.m_streams[0].m_size);
+            BOOST_CHECK(memcmp(message.m_streams[0].m_data, denseData.data(), denseSize) == 0);
+            BOOST_REQUIRE_EQUAL(sparseData.size(), message.m_streams[1].m_size);
+            BOOST_CHECK(memcmp(message.m_streams[1].m_data, sparseData.data(), sparseData.size()) == 0);
+            consumer->ReleaseMinibatch(slot);
+        }
+    }
+
+    // The ring is full, and a command drops the minibatches that were not read.
+    size_t numWritten = 0;
+    while (service.WriteMinibatch(slot, minibatch, 0, noWait))
+        numWritten++;
+    BOOST_CHECK_GT(numWritten, 2);
+    command.m_type = SharedMinibatchChannel::CommandType::setCurrentSamplePosition;
+    serviceThread = serveCommand(received);
+    consumer->SendCommand(slot, command, [] { return true; });
+    serviceThread.join();
+    SharedMinibatchChannel::MinibatchMessage message;
+    BOOST_CHECK(!consumer->ReadMinibatch(slot, message, noWait));
+
+    // A minibatch has to fit into half of the ring.
+    vector<float> largeData(ringSize);
+    Minibatch large;
+    auto largeLayout = make_shared<MBLayout>();
+    largeLayout->InitAsFrameMode(ringSize / 3);
+    for (auto* data : { (void*)largeData.data(), (void*)sparseData.data() })
+    {
+        auto stream = make_shared<StreamMinibatch>();
+        stream->m_data = data;
+        stream->m_layout = largeLayout;
+        large.m_data.push_back(stream);
+    }
+    *reinterpret_cast<size_t*>(sparseData.data()) = 0;
+    BOOST_CHECK_THROW(service.WriteMinibatch(slot, large, 0, noWait), std::runtime_error);
+
+    // A detached slot can be attached again once the service has released it.
+    consumer->Detach(slot);
+    BOOST_CHECK(service.IsDetached(slot));
+    BOOST_CHECK(!consumer->TryAttach(slot));
+    service.ReleaseSlot(slot);
+    BOOST_CHECK(consumer->TryAttach(slot));
+
+    service.Shutdown();
+    BOOST_CHECK(consumer->IsShutdown());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
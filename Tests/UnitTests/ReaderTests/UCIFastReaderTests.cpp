@@ -0,0 +1,140 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include <fstream>
+#include <boost/scope_exit.hpp>
+#include "Common/ReaderTestHelper.h"
+#include "../../../Source/Readers/UCIFastReader/UCIDeserializer.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+#pragma warning(disable: 4459) // declaration of 'boost_scope_exit_aux_args' hides global declaration
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace Test {
+
+BOOST_AUTO_TEST_SUITE(UCIFastReaderTestSuite)
+
+// The features and the labels of all samples of a deserializer, in key order.
+static pair<vector<float>, vector<float>> ReadAllSamples(UCIDeserializer& deserializer)
+{
+    auto streams = deserializer.GetStreamDescriptions();
+    size_t featureDimension = streams[0]->m_sampleLayout->GetNumElements();
+    size_t labelDimension = streams[1]->m_sampleLayout->GetNumElements();
+
+    pair<vector<float>, vector<float>> result;
+    size_t key = 0;
+    for (const auto& c : deserializer.GetChunkDescriptions())
+    {
+        auto chunk = deserializer.GetChunk(c->m_id);
+        vector<SequenceDescription> sequences;
+        deserializer.GetSequencesForChunk(c->m_id, sequences);
+        for (const auto& s : sequences)
+        {
+            BOOST_CHECK_EQUAL(key++, s.m_key.m_sequence);
+            vector<SequenceDataPtr> data;
+            chunk->GetSequence(s.m_id, data);
+            BOOST_REQUIRE_EQUAL(2u, data.size());
+            const float* features = static_cast<const float*>(data[0]->GetDataBuffer());
+            const float* labels = static_cast<const float*>(data[1]->GetDataBuffer());
+            result.first.insert(result.first.end(), features, features + featureDimension);
+            result.second.insert(result.second.end(), labels, labels + labelDimension);
+        }
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(UCIDeserializerParseAndCache)
+{
+    auto directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(directory);
+    BOOST_SCOPE_EXIT(directory)
+    {
+        boost::filesystem::remove_all(directory);
+    } BOOST_SCOPE_EXIT_END
+
+    // A category label followed by 3 features, with ',' as the decimal point.
+    string textFile = (directory / "data.txt").string();
+    {
+        ofstream text(textFile);
+        text << "b 1 2 3\n"
+             << "a 0,5 -1 4e2\n"
+             << "c  7\t8 9\n"
+             << "b 10 11 12\n"
+             << "a -0,25 0 1\n";
+    }
+    string labelMappingFile = (directory / "labels.txt").string();
+    {
+        ofstream labels(labelMappingFile);
+        labels << "a\nb\nc\n";
+    }
+    string cacheFile = (directory / "data.cache").string();
+
+    auto create = [&](bool cache)
+    {
+        ConfigParameters config;
+        config.Insert("file", textFile);
+        config.Insert("customDecimalPoint", ",");
+        config.Insert("numParseThreads", "3");
+        config.Insert("chunkSizeInBytes", "40");
+        config.Insert("cache", cache ? "true" : "false");
+        config.Insert("cacheFile", cacheFile);
+        config.Insert("features=[start=1;dim=3]");
+        config.Insert("labels=[start=0;dim=1;labelType=category;labelMappingFile=" + labelMappingFile + "]");
+        return make_shared<UCIDeserializer>(make_shared<CorpusDescriptor>(true), config, true);
+    };
+
+    const vector<float> features = { 1, 2, 3, 0.5f, -1, 400, 7, 8, 9, 10, 11, 12, -0.25f, 0, 1 };
+    const vector<float> labels = { 0, 1, 0, 1, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 0 };
+
+    // Without a cache the samples are parsed into memory, the chunks have 40 / (3 * 4 + 4) = 2 samples.
+    auto parsed = create(false);
+    BOOST_CHECK_EQUAL(3u, parsed->GetChunkDescriptions().size());
+    auto samples = ReadAllSamples(*parsed);
+    BOOST_CHECK(samples.first == features);
+    BOOST_CHECK(samples.second == labels);
+    BOOST_CHECK(!boost::filesystem::exists(cacheFile));
+
+    // The first deserializer writes the cache, the second one maps it.
+    samples = ReadAllSamples(*create(true));
+    BOOST_CHECK(samples.first == features);
+    BOOST_CHECK(samples.second == labels);
+    BOOST_REQUIRE(boost::filesystem::exists(cacheFile));
+    BOOST_CHECK(!boost::filesystem::exists(cacheFile + ".lock"));
+    auto cached = create(true);
+    samples = ReadAllSamples(*cached);
+    BOOST_CHECK(samples.first == features);
+    BOOST_CHECK(samples.second == labels);
+
+    // The second deserializer does read the cache: a change of the cache shows up in its samples.
+    {
+        vector<float> changedFeatures = features;
+        changedFeatures[0] = 42;
+        uintmax_t cacheSize = boost::filesystem::file_size(cacheFile);
+        size_t dataOffset = (size_t)cacheSize - features.size() * sizeof(float) - labels.size() / 3 * sizeof(uint32_t);
+        fstream cache(cacheFile, ios::in | ios::out | ios::binary);
+        cache.seekp(dataOffset);
+        cache.write(reinterpret_cast<const char*>(changedFeatures.data()), sizeof(float));
+        cache.close();
+        BOOST_CHECK(ReadAllSamples(*create(true)).first == changedFeatures);
+    }
+
+    // A change of the text file invalidates the cache.
+    {
+        ofstream text(textFile, ios::app);
+        text << "c 13 14 15\n";
+    }
+    samples = ReadAllSamples(*create(true));
+    BOOST_CHECK_EQUAL(18u, samples.first.size());
+    BOOST_CHECK(vector<float>(samples.first.begin(), samples.first.begin() + features.size()) == features);
+    BOOST_CHECK(ReadAllSamples(*create(true)) == samples);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
+
+}}}
@@ -594,6 +594,59 @@ void TestChangingParameterValues(size_t rank, const DeviceDescriptor& device)
     }
 }
 
+// Alternates between evaluating an intermediate output and training the root, which uses separately compiled networks.
+template <typename ElementType>
+void TestSwitchingOutputsAndBackpropRoots(const DeviceDescriptor& device)
+{
+    const size_t dim = 5, numSamples = 3;
+    auto input = InputVariable({ dim }, AsDataType<ElementType>(), L"features");
+    auto param = Parameter(NDShape({ dim }), AsDataType<ElementType>(), GlorotUniformInitializer(), device);
+    auto sum = Plus(param, input);
+    auto square = ElementTimes(sum, sum);
+
+    std::vector<ElementType> inputData(dim * numSamples);
+    for (size_t i = 0; i < inputData.size(); ++i)
+        inputData[i] = ((ElementType)rand()) / RAND_MAX;
+
+    NDShape valueShape = NDShape({ dim, 1, numSamples });
+    auto inputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(valueShape, inputData, true));
+    auto paramValue = param.Value()->DeepClone(DeviceDescriptor::CPUDevice());
+    auto paramData = paramValue->DataBuffer<ElementType>();
+
+    auto checkSum = [&]() {
+        std::unordered_map<Variable, ValuePtr> outputs = { { sum->Output(), nullptr } };
+        square->Forward({ { input, inputValue } }, outputs, device);
+        std::vector<ElementType> sumData(valueShape.TotalSize());
+        MakeSharedObject<NDArrayView>(valueShape, sumData, false)->CopyFrom(*outputs[sum->Output()]->Data());
+        for (size_t i = 0; i < sumData.size(); ++i)
+            FloatingPointCompare<ElementType>(sumData[i], paramData[i % dim] + inputData[i], "Function output does not match the expected value.");
+    };
+
+    checkSum();
+
+    std::unordered_map<Variable, ValuePtr> outputs = { { square->Output(), nullptr } };
+    auto backpropState = square->Forward({ { input, inputValue } }, outputs, device, { square->Output() });
+
+    // An evaluation between Forward and Backward switches networks, and Backward switches back
+    checkSum();
+
+    std::vector<ElementType> rootGradientData(valueShape.TotalSize(), 1);
+    auto rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(valueShape, rootGradientData, true)->DeepClone(device));
+    std::unordered_map<Variable, ValuePtr> paramGradients = { { param, nullptr } };
+    square->Backward(backpropState, { { square->Output(), rootGradientValue } }, paramGradients);
+
+    std::vector<ElementType> gradientData(dim);
+    MakeSharedObject<NDArrayView>(NDShape({ dim }), gradientData, false)->CopyFrom(*paramGradients[param]->Data());
+    for (size_t j = 0; j < dim; ++j)
+    {
+        ElementType expectedGradient = 0;
+        for (size_t i = 0; i < numSamples; ++i)
+            expectedGradient += 2 * (paramData[j] + inputData[(i * dim) + j]);
+
+        FloatingPointCompare<ElementType>(gradientData[j], expectedGradient, "Parameter gradient does not match the expected value.");
+    }
+}
+
 void TestRecurrenceShapeInference()
 {
     auto testShapeInferenceInRecurrence = [](size_t inputRank, size_t outputRank) {
@@ -655,6 +708,10 @@ void FunctionTests()
     else
         TestChangingParameterValues<double>(3, DeviceDescriptor::CPUDevice());
 
+    TestSwitchingOutputsAndBackpropRoots<float>(DeviceDescriptor::CPUDevice());
+    if (IsGPUAvailable())
+        TestSwitchingOutputsAndBackpropRoots<double>(DeviceDescriptor::GPUDevice(0));
+
     TestTimesNodeShapeInference();
     TestRecurrenceShapeInference();
 
@@ -5,6 +5,7 @@
 
 #include "CNTKLibrary.h"
 #include "Common.h"
+#include <numeric>
 
 using namespace CNTK;
 
@@ -83,7 +84,7 @@ public:
     }
 };
 
-MinibatchSourcePtr TextFormatMinibatchSourceWithMockCommunicator(const std::wstring& dataFilePath, const std::vector<StreamConfiguration>& streamConfigs, size_t epochSize = MinibatchSource::InfinitelyRepeat, bool randomize = true, size_t distributedAfterSampleCount = MinibatchSource::InfiniteSamples, size_t numWorkers = 2, size_t workerRank = 0)
+MinibatchSourcePtr TextFormatMinibatchSourceWithMockCommunicator(const std::wstring& dataFilePath, const std::vector<StreamConfiguration>& streamConfigs, size_t epochSize = MinibatchSource::InfinitelyRepeat, bool randomize = true, size_t distributedAfterSampleCount = MinibatchSource::InfiniteSamples, size_t numWorkers = 2, size_t workerRank = 0, size_t numParallelReaders = 1)
 {
     ::CNTK::Dictionary minibatchSourceConfiguration;
     minibatchSourceConfiguration[L"epochSize"] = epochSize;
@@ -117,6 +118,11 @@ MinibatchSourcePtr TextFormatMinibatchSourceWithMockCommunicator(const std::wstr
     minibatchSourceConfiguration[L"distributedAfterSampleCount"] = distributedAfterSampleCount;
     minibatchSourceConfiguration[L"numWorkers"] = numWorkers;
     minibatchSourceConfiguration[L"workerRank"] = workerRank;
+    if (numParallelReaders > 1)
+    {
+        minibatchSourceConfiguration[L"numParallelReaders"] = numParallelReaders;
+        minibatchSourceConfiguration[L"deterministicParallelReaders"] = true;
+    }
     return CreateCompositeMinibatchSource(minibatchSourceConfiguration);
 }
 
@@ -189,6 +195,53 @@ void TestMinibatchSourceWarmStart(size_t numMBs, size_t minibatchSize, size_t wa
     }
 }
 
+std::vector<size_t> ReadFullSweep(size_t minibatchSize, size_t numParallelReaders)
+{
+    auto featureStreamName = L"features";
+    auto minibatchSource = TextFormatMinibatchSourceWithMockCommunicator(
+        L"SimpleDataTrain_cntk_text.txt",
+        { { featureStreamName, 2 }, { L"labels", 2 } },
+        MinibatchSource::FullDataSweep,
+        /*randomize =*/ false,
+        MinibatchSource::InfiniteSamples,
+        /*numWorkers =*/ 1,
+        /*workerRank =*/ 0,
+        numParallelReaders);
+
+    auto featureStreamInfo = minibatchSource->StreamInfo(featureStreamName);
+    std::vector<size_t> minibatchSizes;
+    for (;;)
+    {
+        auto minibatchData = minibatchSource->GetNextMinibatch(minibatchSize);
+        if (minibatchData.empty())
+            break;
+
+        size_t numSamples = minibatchData[featureStreamInfo].m_numSamples;
+        if (numSamples > minibatchSize)
+            ReportFailure("TestParallelReaders failed: minibatch of %lu samples exceeds the requested %lu", numSamples, minibatchSize);
+
+        minibatchSizes.push_back(numSamples);
+    }
+
+    return minibatchSizes;
+}
+
+void TestParallelReaders(size_t minibatchSize, size_t numParallelReaders)
+{
+    auto singleReaderSizes = ReadFullSweep(minibatchSize, 1);
+    auto parallelReaderSizes = ReadFullSweep(minibatchSize, numParallelReaders);
+
+    // The pipelines read disjoint subsets of the sweep.
+    size_t singleReaderSamples = std::accumulate(singleReaderSizes.begin(), singleReaderSizes.end(), (size_t)0);
+    size_t parallelReaderSamples = std::accumulate(parallelReaderSizes.begin(), parallelReaderSizes.end(), (size_t)0);
+    if (singleReaderSamples != parallelReaderSamples)
+        ReportFailure("TestParallelReaders failed: %lu samples with %lu readers, %lu samples with one reader", parallelReaderSamples, numParallelReaders, singleReaderSamples);
+
+    // In deterministic mode the order of the minibatches does not depend on the timing of the readers.
+    if (ReadFullSweep(minibatchSize, numParallelReaders) != parallelReaderSizes)
+        ReportFailure("TestParallelReaders failed: deterministic parallel readers returned different minibatches in two sweeps");
+}
+
 void MinibatchSourceTests()
 {
     // Test no-randomize minibatch source
@@ -199,4 +252,8 @@ void MinibatchSourceTests()
     // Test randomized minibatch source
     TestMinibatchSourceWarmStart(10, 64, 0, true);
     TestMinibatchSourceWarmStart(10, 64, 128, true);
+
+    // Test minibatch source with parallel reader pipelines
+    TestParallelReaders(64, 2);
+    TestParallelReaders(32, 3);
 }
\ No newline at end of file
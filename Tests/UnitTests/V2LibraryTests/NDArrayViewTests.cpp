@@ -185,6 +185,39 @@ void TestSparseCSCArrayView(size_t numAxes, const DeviceDescriptor& device)
         throw std::runtime_error("The contents of the dense vector that the sparse NDArrayView is copied into do not match the expected values");
 }
 
+// Copies a view from the CPU to every GPU and back with the asynchronous variants of CopyFrom and DeepClone, the GPU to
+// GPU copies going over peer access where the devices have it.
+template <typename ElementType>
+void TestNDArrayViewAsyncCopy(const std::vector<DeviceDescriptor>& gpus)
+{
+    NDShape viewShape({ 7, 5 });
+    std::vector<ElementType> data(viewShape.TotalSize());
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (ElementType)i / 3;
+    auto cpuDataView = MakeSharedObject<NDArrayView>(viewShape, data);
+
+    auto previous = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), viewShape, gpus[0]);
+    previous->CopyFromAsync(*cpuDataView);
+    for (const auto& device : gpus)
+    {
+        NDArrayViewCopyEventPtr copyEvent;
+        auto view = previous->DeepCloneAsync(device, copyEvent);
+        if (view->Device() != device)
+            throw std::runtime_error("DeepCloneAsync: The clone is not on the requested device");
+        copyEvent->Wait();
+        previous = view;
+    }
+
+    auto result = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), viewShape, DeviceDescriptor::CPUDevice());
+    result->CopyFromAsync(*previous)->Wait();
+    const ElementType* resultBuffer = result->template DataBuffer<ElementType>();
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        if (resultBuffer[i] != data[i])
+            throw std::runtime_error("The contents of the asynchronously copied view do not match expected");
+    }
+}
+
 void NDArrayViewTests()
 {
     fprintf(stderr, "\nNDArrayViewTests..\n");
@@ -198,6 +231,15 @@ void NDArrayViewTests()
 
         TestSparseCSCArrayView<float>(1, DeviceDescriptor::GPUDevice(0));
         TestSparseCSCArrayView<double>(4, DeviceDescriptor::GPUDevice(0));
+
+        std::vector<DeviceDescriptor> gpus;
+        for (const auto& device : DeviceDescriptor::AllDevices())
+        {
+            if (device.Type() == DeviceKind::GPU)
+                gpus.push_back(device);
+        }
+        TestNDArrayViewAsyncCopy<float>(gpus);
+        TestNDArrayViewAsyncCopy<double>(gpus);
     }
 
     TestSparseCSCArrayView<float>(2, DeviceDescriptor::CPUDevice());
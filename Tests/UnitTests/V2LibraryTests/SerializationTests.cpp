@@ -410,6 +410,33 @@ void TestFunctionSerialization(const DeviceDescriptor& device)
     TestFunctionSaveAndLoad(BuildLSTMClassifierNet(inputVar, 5, device), device);
 }
 
+void TestSegmentedModelSerialization(bool compressTensors, const DeviceDescriptor& device)
+{
+    const size_t inputDim = 300;
+    auto inputVar = InputVariable({ inputDim }, DataType::Float, L"features");
+    // parameters large enough for segments of their own, and small ones that stay in the protobuf
+    auto function = BuildFFClassifierNet(inputVar, 10, device);
+
+    auto file = L"TestSegmentedModelSerialization.out";
+    Internal::EnableSegmentedModelFormat(compressTensors);
+    function->SaveModel(file);
+    Internal::DisableSegmentedModelFormat();
+
+    auto reloadedFunction = Function::LoadModel(file, device);
+    if (!AreEqual(function, reloadedFunction))
+        throw std::runtime_error("TestSegmentedModelSerialization: original and reloaded functions are not identical.");
+
+    Dictionary originalDict;
+    originalDict[L"small"] = *NDArrayView::RandomUniform<double>({ 10 }, -0.5, 0.5, 1, DeviceDescriptor::CPUDevice());
+    originalDict[L"large"] = std::vector<DictionaryValue>({ *NDArrayView::RandomUniform<float>({ 100, 1000 }, -0.5, 0.5, 2, DeviceDescriptor::CPUDevice()), DictionaryValue(size_t(7)) });
+    Internal::EnableSegmentedModelFormat(compressTensors);
+    originalDict.Save(tempFilePath);
+    Internal::DisableSegmentedModelFormat();
+
+    if (originalDict != Dictionary::Load(tempFilePath))
+        throw std::runtime_error("TestSegmentedModelSerialization: original and deserialized dictionaries are not identical.");
+}
+
 Trainer BuildTrainer(const FunctionPtr& function, const Variable& labels, 
                      LearningRateSchedule lr = LearningRatePerSampleSchedule(0.005), 
                      MomentumSchedule m = MomentumAsTimeConstantSchedule(0.0))
@@ -808,6 +835,7 @@ void SerializationTests()
 
     TestFunctionsForEquality(DeviceDescriptor::CPUDevice());
     TestFunctionSerialization(DeviceDescriptor::CPUDevice());
+    TestSegmentedModelSerialization(/*compressTensors=*/false, DeviceDescriptor::CPUDevice());
     TestModelSerializationDuringTraining(DeviceDescriptor::CPUDevice());
     
     TestCheckpointing(DeviceDescriptor::CPUDevice());
@@ -820,6 +848,7 @@ void SerializationTests()
         TestLearnerSerialization<float>(5, DeviceDescriptor::GPUDevice(0));
         TestLearnerSerialization<double>(10, DeviceDescriptor::GPUDevice(0));
         TestFunctionSerialization(DeviceDescriptor::GPUDevice(0));
+        TestSegmentedModelSerialization(/*compressTensors=*/false, DeviceDescriptor::GPUDevice(0));
         TestModelSerializationDuringTraining(DeviceDescriptor::GPUDevice(0));
         TestCheckpointing(DeviceDescriptor::GPUDevice(0));
         TestLegacyModelSaving(DeviceDescriptor::GPUDevice(0));
@@ -133,10 +133,100 @@ void TrainMNISTClassifier(const DeviceDescriptor& device)
     }
 }
 
+void TestAsyncTrainMinibatch(const DeviceDescriptor& device)
+{
+    const size_t inputDim = 2;
+    const size_t numOutputClasses = 2;
+    const size_t minibatchSize = 50;
+    const size_t numMinibatches = 20;
+
+    auto input = InputVariable({ inputDim }, DataType::Float, L"features");
+    auto labels = InputVariable({ numOutputClasses }, DataType::Float, L"labels");
+    auto CreateTrainer = [&]() {
+        auto timesParam = Parameter(NDArrayView::RandomUniform<float>({ numOutputClasses, inputDim }, -0.05, 0.05, 1, device));
+        auto biasParam = Parameter({ numOutputClasses }, 0.0f, device);
+        auto classifierOutput = Plus(biasParam, Times(timesParam, input));
+        auto trainingLoss = CrossEntropyWithSoftmax(classifierOutput, labels);
+        auto prediction = ClassificationError(classifierOutput, labels);
+        return std::make_shared<Trainer>(classifierOutput, trainingLoss, prediction, std::vector<LearnerPtr>({ SGDLearner(classifierOutput->Parameters(), LearningRatePerSampleSchedule(0.02)) }));
+    };
+    auto syncTrainer = CreateTrainer();
+    auto asyncTrainer = CreateTrainer();
+
+    auto minibatchSource = TextFormatMinibatchSource(L"SimpleDataTrain_cntk_text.txt", { { L"features", inputDim }, { L"labels", numOutputClasses } }, MinibatchSource::FullDataSweep, false);
+    auto featureStreamInfo = minibatchSource->StreamInfo(L"features");
+    auto labelStreamInfo = minibatchSource->StreamInfo(L"labels");
+
+    // submit all minibatches to the async trainer before reading any of its metrics
+    std::vector<double> syncLosses, syncEvalErrors;
+    std::vector<MinibatchMetricsFuturePtr> asyncMetrics;
+    for (size_t i = 0; i < numMinibatches; ++i)
+    {
+        auto minibatchData = minibatchSource->GetNextMinibatch(minibatchSize, device);
+        std::unordered_map<Variable, ValuePtr> arguments = { { input, minibatchData[featureStreamInfo].m_data }, { labels, minibatchData[labelStreamInfo].m_data } };
+        syncTrainer->TrainMinibatch(arguments, device);
+        syncLosses.push_back(syncTrainer->PreviousMinibatchLossAverage());
+        syncEvalErrors.push_back(syncTrainer->PreviousMinibatchEvaluationAverage());
+        asyncMetrics.push_back(asyncTrainer->TrainMinibatchAsync(arguments, device));
+    }
+
+    for (size_t i = 0; i < numMinibatches; ++i)
+    {
+        if (!asyncMetrics[i]->ContinueTraining() || asyncMetrics[i]->SampleCount() != minibatchSize)
+            ReportFailure("TrainMinibatchAsync: Unexpected state of minibatch %d.", (int)i);
+        FloatingPointCompare(asyncMetrics[i]->LossAverage(), syncLosses[i], "TrainMinibatchAsync: Loss does not match the one of TrainMinibatch");
+        FloatingPointCompare(asyncMetrics[i]->EvaluationAverage(), syncEvalErrors[i], "TrainMinibatchAsync: Evaluation criterion does not match the one of TrainMinibatch");
+    }
+}
+
+void TestInputStatisticsWithSampleLimit(const DeviceDescriptor& device)
+{
+    const size_t inputDim = 2;
+    const size_t numOutputClasses = 2;
+    const size_t numSamplesPerSweep = 10000;
+    const size_t maxNumSamples = 1000;
+
+    auto ComputeStatistics = [&](size_t maxSamples, std::vector<float>& means, std::vector<float>& invStdDevs) {
+        auto minibatchSource = TextFormatMinibatchSource(L"SimpleDataTrain_cntk_text.txt", { { L"features", inputDim }, { L"labels", numOutputClasses } }, MinibatchSource::FullDataSweep, false);
+        auto featureStreamInfo = minibatchSource->StreamInfo(L"features");
+        std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>> inputMeansAndInvStdDevs = { { featureStreamInfo, { nullptr, nullptr } } };
+        size_t numSamples = ComputeInputPerDimMeansAndInvStdDevs(minibatchSource, inputMeansAndInvStdDevs, maxSamples, device);
+
+        auto mean = inputMeansAndInvStdDevs[featureStreamInfo].first->DeepClone(DeviceDescriptor::CPUDevice());
+        auto invStdDev = inputMeansAndInvStdDevs[featureStreamInfo].second->DeepClone(DeviceDescriptor::CPUDevice());
+        means.assign(mean->DataBuffer<float>(), mean->DataBuffer<float>() + inputDim);
+        invStdDevs.assign(invStdDev->DataBuffer<float>(), invStdDev->DataBuffer<float>() + inputDim);
+        return numSamples;
+    };
+
+    std::vector<float> means, invStdDevs, partialMeans, partialInvStdDevs;
+    if (ComputeStatistics(SIZE_MAX, means, invStdDevs) != numSamplesPerSweep)
+        ReportFailure("ComputeInputPerDimMeansAndInvStdDevs: Expected the statistics of the full sweep of %d samples.", (int)numSamplesPerSweep);
+    if (ComputeStatistics(maxNumSamples, partialMeans, partialInvStdDevs) != maxNumSamples)
+        ReportFailure("ComputeInputPerDimMeansAndInvStdDevs: Expected the statistics to stop after %d samples.", (int)maxNumSamples);
+
+    // the estimates from the first samples should be within a few of the reported 95% confidence intervals around the full ones
+    for (size_t i = 0; i < inputDim; i++)
+    {
+        if (std::abs(partialMeans[i] - means[i]) * invStdDevs[i] > 4 * 1.96 / std::sqrt((double)maxNumSamples))
+            ReportFailure("ComputeInputPerDimMeansAndInvStdDevs: Mean of dimension %d estimated from %d samples is off by too much.", (int)i, (int)maxNumSamples);
+        if (std::abs(invStdDevs[i] / partialInvStdDevs[i] - 1) > 4 * 1.96 / std::sqrt(2.0 * (maxNumSamples - 1)))
+            ReportFailure("ComputeInputPerDimMeansAndInvStdDevs: Standard deviation of dimension %d estimated from %d samples is off by too much.", (int)i, (int)maxNumSamples);
+    }
+}
+
 void TrainerTests()
 {
     fprintf(stderr, "\nTrainerTests..\n");
 
+    TestInputStatisticsWithSampleLimit(DeviceDescriptor::CPUDevice());
+    TestAsyncTrainMinibatch(DeviceDescriptor::CPUDevice());
+    if (IsGPUAvailable())
+    {
+        TestInputStatisticsWithSampleLimit(DeviceDescriptor::GPUDevice(0));
+        TestAsyncTrainMinibatch(DeviceDescriptor::GPUDevice(0));
+    }
+
     TrainSimpleFeedForwardClassifer(DeviceDescriptor::CPUDevice());
     if (IsGPUAvailable())
     {
@@ -217,10 +217,99 @@ void TestTimesAndPlus(size_t inputDim,
     }
 }
 
+// Elementwise square on the CPU, counting its Specialize() calls
+class NativeSquareKernel final : public NativeUserFunctionKernel
+{
+public:
+    void Specialize(const std::vector<NDShape>& inputShapes, const NDShape& outputShape, const DeviceDescriptor& device) override
+    {
+        if ((inputShapes.size() != 1) || (inputShapes[0] != outputShape) || (device != DeviceDescriptor::CPUDevice()))
+            ReportFailure("NativeSquareKernel: Unexpected shapes or device passed to Specialize().");
+        m_numSpecializations++;
+    }
+
+    void Forward(const std::vector<NDArrayViewPtr>& inputs, const NDArrayViewPtr& output, void* computeStream) override
+    {
+        if (computeStream != nullptr)
+            ReportFailure("NativeSquareKernel: Unexpected compute stream on the CPU.");
+        const float* x = inputs[0]->DataBuffer<float>();
+        float* y = output->WritableDataBuffer<float>();
+        for (size_t i = 0; i < output->Shape().TotalSize(); ++i)
+            y[i] = x[i] * x[i];
+    }
+
+    void Backward(size_t inputIndex, const std::vector<NDArrayViewPtr>& inputs, const NDArrayViewPtr& /*output*/,
+                  const NDArrayViewPtr& outputGradient, const NDArrayViewPtr& inputGradient, void* /*computeStream*/) override
+    {
+        if (inputIndex != 0)
+            ReportFailure("NativeSquareKernel: Unexpected input index %d in Backward().", (int)inputIndex);
+        const float* x = inputs[0]->DataBuffer<float>();
+        const float* dy = outputGradient->DataBuffer<float>();
+        float* dx = inputGradient->WritableDataBuffer<float>();
+        for (size_t i = 0; i < inputGradient->Shape().TotalSize(); ++i)
+            dx[i] += 2 * x[i] * dy[i];
+    }
+
+    size_t m_numSpecializations = 0;
+};
+
+void TestNativeUserFunction(const DeviceDescriptor& device)
+{
+    const size_t dim = 3;
+    auto kernel = std::make_shared<NativeSquareKernel>();
+    auto inputVar = InputVariable({ dim }, DataType::Float, /*needsGradient =*/ true, L"input");
+    auto squareFunc = NativeUserFunction({ inputVar }, { dim }, kernel, L"nativeSquare");
+
+    // the kernel is specialized for each new minibatch size only
+    for (size_t numSamples : { 5, 5, 7 })
+    {
+        std::vector<float> inputData(dim * numSamples);
+        for (size_t i = 0; i < inputData.size(); ++i)
+            inputData[i] = (float)i - 4;
+        NDShape valueShape = inputVar.Shape().AppendShape({ 1, numSamples });
+        auto inputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(valueShape, inputData.data(), inputData.size(), device, true));
+
+        std::unordered_map<Variable, ValuePtr> outputs = { { squareFunc->Output(), nullptr } };
+        auto backpropState = squareFunc->Forward({ { inputVar, inputValue } }, outputs, device, { squareFunc->Output() });
+
+        std::vector<float> rootGradientData(inputData.size(), 1);
+        auto rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(valueShape, rootGradientData.data(), rootGradientData.size(), device, true));
+        std::unordered_map<Variable, ValuePtr> inputGradients = { { inputVar, nullptr } };
+        squareFunc->Backward(backpropState, { { squareFunc->Output(), rootGradientValue } }, inputGradients);
+
+        std::vector<float> outputData(inputData.size()), inputGradientData(inputData.size());
+        MakeSharedObject<NDArrayView>(valueShape, outputData.data(), outputData.size(), DeviceDescriptor::CPUDevice())->CopyFrom(*outputs[squareFunc->Output()]->Data());
+        MakeSharedObject<NDArrayView>(valueShape, inputGradientData.data(), inputGradientData.size(), DeviceDescriptor::CPUDevice())->CopyFrom(*inputGradients[inputVar]->Data());
+
+        std::vector<float> expectedOutputData(inputData.size()), expectedInputGradientData(inputData.size());
+        for (size_t i = 0; i < inputData.size(); ++i)
+        {
+            expectedOutputData[i] = inputData[i] * inputData[i];
+            expectedInputGradientData[i] = 2 * inputData[i];
+        }
+        FloatingPointVectorCompare(outputData, expectedOutputData, "TestNativeUserFunction: Forward prop results do not match expected results");
+        FloatingPointVectorCompare(inputGradientData, expectedInputGradientData, "TestNativeUserFunction: Backprop results do not match expected results");
+    }
+
+    if (kernel->m_numSpecializations != 2)
+        ReportFailure("TestNativeUserFunction: Expected 2 specializations of the kernel, got %d.", (int)kernel->m_numSpecializations);
+
+    // the kernel cannot be restored on load, so a model with a native user function cannot be saved
+    const std::wstring modelFile = L"NativeUserFunction.model";
+    VerifyException([&squareFunc, &modelFile]() {
+        squareFunc->SaveModel(modelFile);
+    }, "Was able to save a model containing a NativeUserFunction.");
+    VerifyException([&squareFunc, &modelFile]() {
+        Plus(squareFunc, squareFunc)->SaveModel(modelFile);
+    }, "Was able to save a model containing a NativeUserFunction.");
+}
+
 void UserDefinedFunctionTests()
 {
     fprintf(stderr, "\nUserDefinedFunctionTests..\n");
 
+    TestNativeUserFunction(DeviceDescriptor::CPUDevice());
+
     TestTimesAndPlus<double>(4, 2, 5, DeviceDescriptor::CPUDevice(), 3, true, true);
     if (IsGPUAvailable())
     {
@@ -278,6 +278,51 @@ void TestSettingParameterValuesManually(const DeviceDescriptor& device)
         throw std::runtime_error("Parameter value does match the expected value.");
 }
 
+template <typename ElementType>
+void ValueCreationFromPackedBufferTest(const vector<size_t>& seqLenList, const DeviceDescriptor device, bool readOnly)
+{
+    vector<size_t> dims{3, 2};
+    size_t numberOfSequences = seqLenList.size();
+    size_t maxSeqLen = *max_element(seqLenList.begin(), seqLenList.end());
+
+    // Dense: the sequences back to back in one buffer
+    vector<vector<ElementType>> data;
+    FillDenseMatrixData(data, seqLenList, dims[0] * dims[1]);
+    vector<ElementType> packedData;
+    for (auto& sequence : data)
+        packedData.insert(packedData.end(), sequence.begin(), sequence.end());
+
+    ValuePtr testValue = Value::CreateFromPackedBuffer(NDShape(dims), packedData.data(), seqLenList, device, readOnly);
+    CheckValue(testValue, {dims[0], dims[1], maxSeqLen, numberOfSequences}, dims[0] * dims[1], data, seqLenList);
+
+    // And back: the gaps are removed again
+    vector<ElementType> copiedData;
+    vector<size_t> copiedSeqLenList;
+    testValue->CopyToPackedBuffer(NDShape(dims), copiedData, copiedSeqLenList);
+    if ((copiedData != packedData) || (copiedSeqLenList != seqLenList))
+        ReportFailure("The data copied back from the Value does not match the packed buffer it was created from");
+
+    // Sparse: one-hot samples in CSC format
+    size_t vocabSize = 17;
+    vector<vector<size_t>> oneHotData(numberOfSequences);
+    vector<SparseIndexType> colStarts, rowIndices;
+    vector<ElementType> nonZeroValues;
+    for (size_t n = 0; n < numberOfSequences; n++)
+    {
+        for (size_t s = 0; s < seqLenList[n]; s++)
+        {
+            oneHotData[n].push_back((s * 10 + n) % vocabSize);
+            colStarts.push_back((SparseIndexType)nonZeroValues.size());
+            rowIndices.push_back((SparseIndexType)oneHotData[n].back());
+            nonZeroValues.push_back(1);
+        }
+    }
+    colStarts.push_back((SparseIndexType)nonZeroValues.size());
+
+    testValue = Value::CreateFromPackedBuffer(NDShape({ vocabSize }), colStarts.data(), rowIndices.data(), nonZeroValues.data(), nonZeroValues.size(), seqLenList, device, readOnly);
+    CheckValue<ElementType>(testValue, {vocabSize, maxSeqLen, numberOfSequences}, vocabSize, oneHotData, seqLenList);
+}
+
 void SparseSequenceBatchValueCreationTest(size_t vocabSize, size_t maxAllowedSequenceLength, const DeviceDescriptor& device)
 {
     srand(1);
@@ -312,6 +357,8 @@ void ValueTests()
     ValueCreationOneHotNoNDMaskTest<double>(DeviceDescriptor::CPUDevice(), true);
     ValueCreationOneHotWithNDMaskTest<double>(DeviceDescriptor::CPUDevice(), false);
     ValueCreationOneHotWithNDMaskTest<float>(DeviceDescriptor::CPUDevice(), true);
+    ValueCreationFromPackedBufferTest<float>({ 4, 4, 4 }, DeviceDescriptor::CPUDevice(), false);
+    ValueCreationFromPackedBufferTest<double>({ 5, 6, 8, 7 }, DeviceDescriptor::CPUDevice(), true);
     SparseSequenceBatchValueCreationTest(300, 7, DeviceDescriptor::CPUDevice());
     SparseSequenceBatchValueCreationTest(2300, 1, DeviceDescriptor::CPUDevice());
 
@@ -327,6 +374,8 @@ void ValueTests()
         ValueCreationOneHotNoNDMaskTest<float>(DeviceDescriptor::GPUDevice(0), true);
         ValueCreationOneHotWithNDMaskTest<float>(DeviceDescriptor::GPUDevice(0), false);
         ValueCreationOneHotWithNDMaskTest<double>(DeviceDescriptor::GPUDevice(0), true);
+        ValueCreationFromPackedBufferTest<double>({ 4, 4, 4 }, DeviceDescriptor::GPUDevice(0), true);
+        ValueCreationFromPackedBufferTest<float>({ 5, 6, 8, 7 }, DeviceDescriptor::GPUDevice(0), false);
         SparseSequenceBatchValueCreationTest(50000, 1, DeviceDescriptor::GPUDevice(0));
         SparseSequenceBatchValueCreationTest(6000, 6, DeviceDescriptor::GPUDevice(0));
     }